@@ -0,0 +1,184 @@
+#pragma once
+
+#include "internal/common.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// atomic<T> is a value which is only touched through atomic operations which take an explicit memory order.
+// The atomic_* functions in common.h are all full barriers (except load, which is acquire, and store, release).
+// That's what you want by default, but lock-free code is easier to read (and cheaper on ARM) when it says
+// how much ordering each access needs:
+//
+//     atomic<s64> Hits;                                  // A statistics counter, nothing is published through it
+//     Hits.fetch_add(1, memory_order::Relaxed);
+//
+//     node->Next = null;
+//     Head.store(node, memory_order::Release);           // Everything written before is visible ...
+//     auto *n = Head.load(memory_order::Acquire);        // ... to whoever sees the new value
+//
+// On x86 every read-modify-write is a locked instruction whatever you pass (a relaxed fetch_add costs the same
+// as a full one), loads are always acquire and stores always release. There the orders only matter for the
+// compiler and for stores: a SeqCst store is an xchg, the rest are plain moves.
+//
+// Two atomics written by different threads shouldn't share a cache line, otherwise every write by one thread
+// takes the line away from the other ("false sharing"). Use padded_atomic<T> (or cache_aligned<T> for anything
+// else) for per thread counters, the heads and tails of queues, etc.
+//
+
+constexpr s64 CACHE_LINE_SIZE = 64;
+
+enum class memory_order : s32 {
+    Relaxed = 0,     // Only the access itself is atomic
+    Acquire,         // Loads: reads and writes after it aren't moved before it
+    Release,         // Stores: reads and writes before it aren't moved after it
+    AcquireRelease,  // Read-modify-writes: both
+    SeqCst,          // Both, plus all SeqCst operations happen in one order every thread agrees on
+};
+
+namespace internal {
+#if COMPILER != MSVC
+constexpr s32 gcc_memory_order(memory_order order) {
+    switch (order) {
+        case memory_order::Relaxed: return __ATOMIC_RELAXED;
+        case memory_order::Acquire: return __ATOMIC_ACQUIRE;
+        case memory_order::Release: return __ATOMIC_RELEASE;
+        case memory_order::AcquireRelease: return __ATOMIC_ACQ_REL;
+        default: return __ATOMIC_SEQ_CST;
+    }
+}
+
+// The failure order of a compare and exchange can't be a release
+constexpr s32 gcc_failure_memory_order(memory_order order) {
+    switch (order) {
+        case memory_order::Release: return __ATOMIC_RELAXED;
+        case memory_order::AcquireRelease: return __ATOMIC_ACQUIRE;
+        default: return gcc_memory_order(order);
+    }
+}
+#endif
+}  // namespace internal
+
+// Orders memory accesses around it (without one attached to an atomic)
+always_inline void atomic_thread_fence(memory_order order = memory_order::SeqCst) {
+#if COMPILER == MSVC
+#if ARCH == X86
+    if (order == memory_order::SeqCst) {
+        _mm_mfence();  // The only reordering x86 does is a later load before an earlier store
+    } else {
+        _ReadWriteBarrier();
+    }
+#else
+    __dmb(_ARM64_BARRIER_ISH);
+#endif
+#else
+    __atomic_thread_fence(internal::gcc_memory_order(order));
+#endif
+}
+
+template <appropriate_for_atomic T>
+struct atomic {
+    T Value{};
+
+    constexpr atomic() {}
+    constexpr atomic(T value) : Value(value) {}
+
+    always_inline T load(memory_order order = memory_order::SeqCst) const {
+#if COMPILER == MSVC && ARCH == X86
+        T value = *(const volatile T *) &Value;
+        if (order != memory_order::Relaxed) _ReadWriteBarrier();
+        return value;
+#elif COMPILER == MSVC
+        return atomic_load(&Value);  // @Platform Always a full barrier on MSVC ARM
+#else
+        return __atomic_load_n(&Value, internal::gcc_memory_order(order));
+#endif
+    }
+
+    always_inline void store(T value, memory_order order = memory_order::SeqCst) {
+#if COMPILER == MSVC && ARCH == X86
+        if (order == memory_order::SeqCst) {
+            atomic_swap(&Value, value);  // A plain store could be moved before a later load
+        } else {
+            if (order != memory_order::Relaxed) _ReadWriteBarrier();
+            *(volatile T *) &Value = value;
+        }
+#elif COMPILER == MSVC
+        atomic_swap(&Value, value);
+#else
+        __atomic_store_n(&Value, value, internal::gcc_memory_order(order));
+#endif
+    }
+
+    // Returns the old value
+    always_inline T exchange(T value, memory_order order = memory_order::SeqCst) {
+#if COMPILER == MSVC
+        return atomic_swap(&Value, value);
+#else
+        return __atomic_exchange_n(&Value, value, internal::gcc_memory_order(order));
+#endif
+    }
+
+    // If the value is _expected_ replaces it with _desired_ and returns true.
+    // Otherwise stores the current value in _expected_ and returns false - ready for the next try in a loop.
+    always_inline bool compare_exchange(T &expected, T desired, memory_order order = memory_order::SeqCst) {
+#if COMPILER == MSVC
+        T old = atomic_compare_and_swap(&Value, desired, expected);
+        if (old == expected) return true;
+        expected = old;
+        return false;
+#else
+        return __atomic_compare_exchange_n(&Value, &expected, desired, false, internal::gcc_memory_order(order), internal::gcc_failure_memory_order(order));
+#endif
+    }
+
+    // These return the old value
+
+    always_inline T fetch_add(T value, memory_order order = memory_order::SeqCst) requires(types::is_integral<T>) {
+#if COMPILER == MSVC
+        return atomic_add(&Value, value);
+#else
+        return __atomic_fetch_add(&Value, value, internal::gcc_memory_order(order));
+#endif
+    }
+
+    always_inline T fetch_sub(T value, memory_order order = memory_order::SeqCst) requires(types::is_integral<T>) {
+        return fetch_add((T) -value, order);
+    }
+
+    always_inline T fetch_and(T value, memory_order order = memory_order::SeqCst) requires(types::is_integral<T>) {
+#if COMPILER == MSVC
+        if constexpr (sizeof(T) == 2) return (T) _InterlockedAnd16((volatile short *) &Value, (short) value);
+        if constexpr (sizeof(T) == 4) return (T) _InterlockedAnd((volatile long *) &Value, (long) value);
+        if constexpr (sizeof(T) == 8) return (T) _InterlockedAnd64((volatile long long *) &Value, (long long) value);
+#else
+        return __atomic_fetch_and(&Value, value, internal::gcc_memory_order(order));
+#endif
+    }
+
+    always_inline T fetch_or(T value, memory_order order = memory_order::SeqCst) requires(types::is_integral<T>) {
+#if COMPILER == MSVC
+        if constexpr (sizeof(T) == 2) return (T) _InterlockedOr16((volatile short *) &Value, (short) value);
+        if constexpr (sizeof(T) == 4) return (T) _InterlockedOr((volatile long *) &Value, (long) value);
+        if constexpr (sizeof(T) == 8) return (T) _InterlockedOr64((volatile long long *) &Value, (long long) value);
+#else
+        return __atomic_fetch_or(&Value, value, internal::gcc_memory_order(order));
+#endif
+    }
+};
+
+// Takes a whole cache line, so writes to it don't slow down threads which use the neighbouring memory
+template <appropriate_for_atomic T>
+struct alignas(CACHE_LINE_SIZE) padded_atomic : atomic<T> {
+    using atomic<T>::atomic;
+};
+
+// The same for any type, e.g. an array of per thread data: cache_aligned<worker_stats> Stats[MAX_THREADS];
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) cache_aligned {
+    T Value;
+};
+
+static_assert(sizeof(padded_atomic<s32>) == CACHE_LINE_SIZE);
+
+LSTD_END_NAMESPACE
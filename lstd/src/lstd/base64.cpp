@@ -0,0 +1,489 @@
+#include "base64.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2, SSSE3 and AVX2 intrinsics
+
+// MSVC lets us use newer instructions without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope const utf8 *BASE64_ALPHABETS[2] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_",
+};
+
+// The sextet of every byte for the standard and the URL-safe alphabet, and the nibble of every byte, -1 if it isn't one
+struct base64_tables {
+    s8 Sextets[2][256];
+    s8 Nibbles[256];
+};
+
+file_scope constexpr base64_tables make_base64_tables() {
+    base64_tables result = {};
+    For_as(alphabet, range(2)) {
+        For(range(256)) result.Sextets[alphabet][it] = -1;
+        For(range(26)) {
+            result.Sextets[alphabet]['A' + it] = (s8) it;
+            result.Sextets[alphabet]['a' + it] = (s8) (26 + it);
+        }
+        For(range(10)) result.Sextets[alphabet]['0' + it] = (s8) (52 + it);
+    }
+    result.Sextets[0]['+'] = 62;
+    result.Sextets[0]['/'] = 63;
+    result.Sextets[1]['-'] = 62;
+    result.Sextets[1]['_'] = 63;
+
+    For(range(256)) result.Nibbles[it] = -1;
+    For(range(10)) result.Nibbles['0' + it] = (s8) it;
+    For(range(6)) {
+        result.Nibbles['a' + it] = (s8) (10 + it);
+        result.Nibbles['A' + it] = (s8) (10 + it);
+    }
+    return result;
+}
+
+file_scope constexpr base64_tables Base64Tables = make_base64_tables();
+
+//
+// Kernels. Each one does as many whole vectors as it can and returns how much of the input it consumed,
+// the rest goes through the scalar loops below. The decoders stop before the first vector with an invalid character.
+//
+using base64_encode_func = s64 (*)(utf8 *out, const byte *in, s64 count, bool url);
+using base64_decode_func = s64 (*)(byte *out, const byte *in, s64 size, bool url);
+using hex_encode_func    = s64 (*)(utf8 *out, const byte *in, s64 count, bool upper);
+using hex_decode_func    = s64 (*)(byte *out, const byte *in, s64 size);
+
+file_scope s64 base64_encode_none(utf8 *, const byte *, s64, bool) { return 0; }
+file_scope s64 base64_decode_none(byte *, const byte *, s64, bool) { return 0; }
+file_scope s64 hex_encode_none(utf8 *, const byte *, s64, bool) { return 0; }
+file_scope s64 hex_decode_none(byte *, const byte *, s64) { return 0; }
+
+#if ARCH == X86
+//
+// SSE2 and SSSE3, 16 bytes at a time
+//
+
+// Two hex digits of every byte: split into nibbles, turn each into '0' + n (+ the distance to 'a'/'A' when n > 9)
+// with a compare instead of a lookup, then interleave high and low nibbles. SSE2 is always there on x86.
+file_scope s64 hex_encode_sse2(utf8 *out, const byte *in, s64 count, bool upper) {
+    __m128i mask    = _mm_set1_epi8(0x0f);
+    __m128i nine    = _mm_set1_epi8(9);
+    __m128i zero    = _mm_set1_epi8('0');
+    __m128i letters = _mm_set1_epi8((upper ? 'A' : 'a') - '0' - 10);
+
+    auto to_ascii = [&](__m128i n) { return _mm_add_epi8(_mm_add_epi8(n, zero), _mm_and_si128(_mm_cmpgt_epi8(n, nine), letters)); };
+
+    s64 done = 0;
+    for (; count - done >= 16; done += 16) {
+        __m128i v  = _mm_loadu_si128((const __m128i *) (in + done));
+        __m128i hi = to_ascii(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = to_ascii(_mm_and_si128(v, mask));
+
+        _mm_storeu_si128((__m128i *) (out + 2 * done), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (out + 2 * done + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return done;
+}
+
+// 0xFF in each byte of _c_ in [lo, hi]. Signed compares, bytes >= 0x80 are never in a range.
+always_inline __m128i in_range_sse2(__m128i c, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), c));
+}
+
+// The nibbles of 16 hex digits, false if one isn't a digit
+always_inline bool hex_nibbles_sse2(__m128i c, __m128i &nibbles) {
+    __m128i digit = in_range_sse2(c, '0', '9');
+    __m128i lower = in_range_sse2(c, 'a', 'f');
+    __m128i upper = in_range_sse2(c, 'A', 'F');
+    if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, lower), upper)) != 0xFFFF) return false;
+
+    __m128i shift = _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(-'0')),
+                                 _mm_or_si128(_mm_and_si128(lower, _mm_set1_epi8(10 - 'a')), _mm_and_si128(upper, _mm_set1_epi8(10 - 'A'))));
+    nibbles = _mm_add_epi8(c, shift);
+    return true;
+}
+
+// 16 digits to 8 bytes, the pairs are joined with one multiply-add (high * 16 + low)
+TARGET_SSSE3 file_scope s64 hex_decode_ssse3(byte *out, const byte *in, s64 size) {
+    s64 done = 0;
+    for (; size - done >= 16; done += 16) {
+        __m128i nibbles;
+        if (!hex_nibbles_sse2(_mm_loadu_si128((const __m128i *) (in + done)), nibbles)) break;
+
+        __m128i pairs = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+        _mm_storel_epi64((__m128i *) (out + done / 2), _mm_packus_epi16(pairs, pairs));
+    }
+    return done;
+}
+
+// The bytes of 4 groups of 3 in the 4 lanes as [b1, b0, b2, b1], where the mulhi and the mullo below find the sextets
+TARGET_SSSE3 file_scope __m128i base64_sextets_ssse3(__m128i v) {
+    v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+// The offset to add to every sextet is picked by a 16 entry shuffle: 0 - 25 map to 13, 26 - 51 to 0 and 52 - 63 to 1 - 12
+TARGET_SSSE3 file_scope __m128i base64_to_ascii_ssse3(__m128i sextets, __m128i offsets) {
+    __m128i index = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+    index         = _mm_or_si128(index, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), sextets), _mm_set1_epi8(13)));
+    return _mm_add_epi8(sextets, _mm_shuffle_epi8(offsets, index));
+}
+
+file_scope __m128i base64_offsets_sse2(bool url) {
+    char n = '0' - 52;
+    return _mm_setr_epi8('a' - 26, n, n, n, n, n, n, n, n, n, n, (url ? '-' : '+') - 62, (url ? '_' : '/') - 63, 'A', 0, 0);
+}
+
+// 12 bytes to 16 characters (the loads are 16 bytes)
+TARGET_SSSE3 file_scope s64 base64_encode_ssse3(utf8 *out, const byte *in, s64 count, bool url) {
+    __m128i offsets = base64_offsets_sse2(url);
+
+    s64 done = 0;
+    for (; count - done >= 16; done += 12) {
+        __m128i sextets = base64_sextets_ssse3(_mm_loadu_si128((const __m128i *) (in + done)));
+        _mm_storeu_si128((__m128i *) (out + done / 3 * 4), base64_to_ascii_ssse3(sextets, offsets));
+    }
+    return done;
+}
+
+// The sextets of 16 characters, false if one isn't in the alphabet
+always_inline bool base64_sextets_from_ascii_sse2(__m128i c, bool url, __m128i &sextets) {
+    __m128i upper = in_range_sse2(c, 'A', 'Z');
+    __m128i lower = in_range_sse2(c, 'a', 'z');
+    __m128i digit = in_range_sse2(c, '0', '9');
+    __m128i s62   = _mm_cmpeq_epi8(c, _mm_set1_epi8(url ? '-' : '+'));
+    __m128i s63   = _mm_cmpeq_epi8(c, _mm_set1_epi8(url ? '_' : '/'));
+
+    __m128i valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, s62)), s63);
+    if (_mm_movemask_epi8(valid) != 0xFFFF) return false;
+
+    __m128i shift = _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift         = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift         = _mm_or_si128(shift, _mm_and_si128(s62, _mm_set1_epi8(62 - (url ? '-' : '+'))));
+    shift         = _mm_or_si128(shift, _mm_and_si128(s63, _mm_set1_epi8(63 - (url ? '_' : '/'))));
+    sextets       = _mm_add_epi8(c, shift);
+    return true;
+}
+
+// 4 sextets in a lane to 24 bits (the first one highest): two multiply-adds, then the bytes are put in order
+TARGET_SSSE3 file_scope __m128i base64_join_ssse3(__m128i sextets) {
+    __m128i v = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+    v         = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// 16 characters to 12 bytes. The stores are 16 bytes, so there must be 8 more characters after the
+// vector for them to stay in the room which base64_decoded_max_size() gives.
+TARGET_SSSE3 file_scope s64 base64_decode_ssse3(byte *out, const byte *in, s64 size, bool url) {
+    s64 done = 0;
+    for (; size - done >= 24; done += 16) {
+        __m128i sextets;
+        if (!base64_sextets_from_ascii_sse2(_mm_loadu_si128((const __m128i *) (in + done)), url, sextets)) break;
+        _mm_storeu_si128((__m128i *) (out + done / 4 * 3), base64_join_ssse3(sextets));
+    }
+    return done;
+}
+
+//
+// AVX2, the same things 32 bytes at a time. The shuffles work within 128 bit lanes.
+//
+
+TARGET_AVX2 file_scope s64 hex_encode_avx2(utf8 *out, const byte *in, s64 count, bool upper) {
+    __m256i mask    = _mm256_set1_epi8(0x0f);
+    __m256i nine    = _mm256_set1_epi8(9);
+    __m256i zero    = _mm256_set1_epi8('0');
+    __m256i letters = _mm256_set1_epi8((upper ? 'A' : 'a') - '0' - 10);
+
+    s64 done = 0;
+    for (; count - done >= 32; done += 32) {
+        __m256i v  = _mm256_loadu_si256((const __m256i *) (in + done));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+        __m256i lo = _mm256_and_si256(v, mask);
+        hi         = _mm256_add_epi8(_mm256_add_epi8(hi, zero), _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), letters));
+        lo         = _mm256_add_epi8(_mm256_add_epi8(lo, zero), _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), letters));
+
+        // The unpacks give bytes [0, 8) and [16, 24), then [8, 16) and [24, 32)
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *) (out + 2 * done), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *) (out + 2 * done + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return done;
+}
+
+TARGET_AVX2 file_scope __m256i in_range_avx2(__m256i c, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+
+TARGET_AVX2 file_scope s64 hex_decode_avx2(byte *out, const byte *in, s64 size) {
+    s64 done = 0;
+    for (; size - done >= 32; done += 32) {
+        __m256i c     = _mm256_loadu_si256((const __m256i *) (in + done));
+        __m256i digit = in_range_avx2(c, '0', '9');
+        __m256i lower = in_range_avx2(c, 'a', 'f');
+        __m256i upper = in_range_avx2(c, 'A', 'F');
+        if ((u32) _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(digit, lower), upper)) != 0xFFFFFFFF) break;
+
+        __m256i shift = _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(-'0')),
+                                        _mm256_or_si256(_mm256_and_si256(lower, _mm256_set1_epi8(10 - 'a')), _mm256_and_si256(upper, _mm256_set1_epi8(10 - 'A'))));
+
+        __m256i pairs  = _mm256_maddubs_epi16(_mm256_add_epi8(c, shift), _mm256_set1_epi16(0x0110));
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), 0x08);  // Lanes 0 and 2 have the bytes
+        _mm_storeu_si128((__m128i *) (out + done / 2), _mm256_castsi256_si128(packed));
+    }
+    return done;
+}
+
+// 24 bytes to 32 characters, two 16 byte loads of 12 bytes each
+TARGET_AVX2 file_scope s64 base64_encode_avx2(utf8 *out, const byte *in, s64 count, bool url) {
+    __m256i shuffle = _mm256_broadcastsi128_si256(_mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i offsets = _mm256_broadcastsi128_si256(base64_offsets_sse2(url));
+
+    s64 done = 0;
+    for (; count - done >= 28; done += 24) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (in + done))),
+                                            _mm_loadu_si128((const __m128i *) (in + done + 12)), 1);
+        v         = _mm256_shuffle_epi8(v, shuffle);
+
+        __m256i t0      = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1      = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i sextets = _mm256_or_si256(t0, t1);
+
+        __m256i index = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+        index         = _mm256_or_si256(index, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets), _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *) (out + done / 3 * 4), _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, index)));
+    }
+    return done;
+}
+
+// 32 characters to 24 bytes, the stores are 32 bytes so there must be 12 more characters after the vector
+TARGET_AVX2 file_scope s64 base64_decode_avx2(byte *out, const byte *in, s64 size, bool url) {
+    char c62 = url ? '-' : '+', c63 = url ? '_' : '/';
+
+    s64 done = 0;
+    for (; size - done >= 44; done += 32) {
+        __m256i c     = _mm256_loadu_si256((const __m256i *) (in + done));
+        __m256i upper = in_range_avx2(c, 'A', 'Z');
+        __m256i lower = in_range_avx2(c, 'a', 'z');
+        __m256i digit = in_range_avx2(c, '0', '9');
+        __m256i s62   = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c62));
+        __m256i s63   = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c63));
+
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, s62)), s63);
+        if ((u32) _mm256_movemask_epi8(valid) != 0xFFFFFFFF) break;
+
+        __m256i shift = _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        shift         = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        shift         = _mm256_or_si256(shift, _mm256_and_si256(s62, _mm256_set1_epi8(62 - c62)));
+        shift         = _mm256_or_si256(shift, _mm256_and_si256(s63, _mm256_set1_epi8(63 - c63)));
+
+        __m256i v = _mm256_maddubs_epi16(_mm256_add_epi8(c, shift), _mm256_set1_epi32(0x01400140));
+        v         = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v         = _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+        v         = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));  // 12 bytes from each lane together
+        _mm256_storeu_si256((__m256i *) (out + done / 4 * 3), v);
+    }
+    return done;
+}
+#endif
+
+file_scope base64_encode_func base64_get_encode() {
+    local_persist cpu_dispatch<base64_encode_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> base64_encode_func {
+#if ARCH == X86
+        if (cpu.AVX2) return base64_encode_avx2;
+        if (cpu.SSSE3) return base64_encode_ssse3;
+#endif
+        return base64_encode_none;
+    });
+}
+
+file_scope base64_decode_func base64_get_decode() {
+    local_persist cpu_dispatch<base64_decode_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> base64_decode_func {
+#if ARCH == X86
+        if (cpu.AVX2) return base64_decode_avx2;
+        if (cpu.SSSE3) return base64_decode_ssse3;
+#endif
+        return base64_decode_none;
+    });
+}
+
+file_scope hex_encode_func hex_get_encode() {
+    local_persist cpu_dispatch<hex_encode_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> hex_encode_func {
+#if ARCH == X86
+        return cpu.AVX2 ? hex_encode_avx2 : hex_encode_sse2;
+#else
+        return hex_encode_none;
+#endif
+    });
+}
+
+file_scope hex_decode_func hex_get_decode() {
+    local_persist cpu_dispatch<hex_decode_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> hex_decode_func {
+#if ARCH == X86
+        if (cpu.AVX2) return hex_decode_avx2;
+        if (cpu.SSSE3) return hex_decode_ssse3;
+#endif
+        return hex_decode_none;
+    });
+}
+
+//
+// Base64
+//
+
+s64 base64_encode(utf8 *out, const byte *in, s64 count, base64_options options) {
+    const utf8 *alphabet = BASE64_ALPHABETS[options.UrlSafe];
+
+    s64 done = base64_get_encode()(out, in, count, options.UrlSafe);
+    utf8 *o  = out + done / 3 * 4;
+
+    for (; count - done >= 3; done += 3) {
+        u32 v = (u32) in[done] << 16 | (u32) in[done + 1] << 8 | in[done + 2];
+        o[0]  = alphabet[v >> 18];
+        o[1]  = alphabet[(v >> 12) & 63];
+        o[2]  = alphabet[(v >> 6) & 63];
+        o[3]  = alphabet[v & 63];
+        o += 4;
+    }
+
+    s64 left = count - done;
+    if (left) {
+        u32 v = (u32) in[done] << 16 | (left == 2 ? (u32) in[done + 1] << 8 : 0);
+        *o++  = alphabet[v >> 18];
+        *o++  = alphabet[(v >> 12) & 63];
+        if (left == 2) *o++ = alphabet[(v >> 6) & 63];
+
+        if (options.Padding) {
+            if (left == 1) *o++ = '=';
+            *o++ = '=';
+        }
+    }
+    return o - out;
+}
+
+string base64_encode(bytes data, base64_options options) {
+    string result;
+    if (!data.Count) return result;
+
+    array_reserve_exact(result, base64_encoded_size(data.Count, options));
+    result.Count  = base64_encode(result.Data, data.Data, data.Count, options);
+    result.Length = result.Count;
+    return result;
+}
+
+parse_result<s64> parse_base64(byte *out, bytes p, base64_options options) {
+    const s8 *sextets = Base64Tables.Sextets[options.UrlSafe];
+
+    s64 i   = base64_get_decode()(out, p.Data, p.Count, options.UrlSafe);
+    byte *o = out + i / 4 * 3;
+
+    // The sextets of the group so far
+    u32 group = 0;
+    s64 n     = 0;
+    for (; i < p.Count; ++i) {
+        s8 v = sextets[(u8) p[i]];
+        if (v < 0) break;
+
+        group = group << 6 | (u32) v;
+        if (++n == 4) {
+            o[0] = (byte) (group >> 16);
+            o[1] = (byte) (group >> 8);
+            o[2] = (byte) group;
+            o += 3;
+            group = 0;
+            n     = 0;
+        }
+    }
+
+    auto rest = [&](s64 at) { return bytes(p.Data + at, p.Count - at); };
+
+    if (n == 1) return {o - out, PARSE_INVALID, rest(i - 1)};  // 6 bits aren't a byte
+
+    if (n) {
+        // 2 characters are 1 byte and 4 unused bits, 3 are 2 bytes and 2 unused bits
+        u32 unused = n == 2 ? 4 : 2;
+        if (group & ((1 << unused) - 1)) return {o - out, PARSE_INVALID, rest(i - 1)};
+
+        group >>= unused;
+        if (n == 3) *o++ = (byte) (group >> 8);
+        *o++ = (byte) group;
+
+        // The padding is optional, but if it's there it must complete the group
+        if (i < p.Count && p[i] == '=') {
+            For(range(4 - n)) {
+                if (i == p.Count || p[i] != '=') return {o - out, PARSE_INVALID, rest(i)};
+                ++i;
+            }
+        }
+    }
+    return {o - out, PARSE_SUCCESS, rest(i)};
+}
+
+parse_result<bytes> parse_base64(bytes p, base64_options options) {
+    byte *out = allocate_array<byte>(base64_decoded_max_size(p.Count));
+
+    auto [size, status, rest] = parse_base64(out, p, options);
+    if (status != PARSE_SUCCESS || !size) {
+        free(out);
+        return {bytes(), status, rest};
+    }
+    return {bytes(out, size), status, rest};
+}
+
+//
+// Hex
+//
+
+s64 hex_encode(utf8 *out, const byte *in, s64 count, bool upper) {
+    s64 done = hex_get_encode()(out, in, count, upper);
+
+    const utf8 *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    For(range(done, count)) {
+        out[2 * it]     = digits[in[it] >> 4];
+        out[2 * it + 1] = digits[in[it] & 0xf];
+    }
+    return 2 * count;
+}
+
+parse_result<s64> parse_hex(byte *out, bytes p) {
+    s64 i = hex_get_decode()(out, p.Data, p.Count);
+
+    for (; i < p.Count; i += 2) {
+        s8 hi = Base64Tables.Nibbles[(u8) p[i]];
+        if (hi < 0) break;
+
+        s8 lo = i + 1 < p.Count ? Base64Tables.Nibbles[(u8) p[i + 1]] : -1;
+        if (lo < 0) return {i / 2, PARSE_INVALID, bytes(p.Data + i, p.Count - i)};  // An odd number of digits
+
+        out[i / 2] = (byte) (hi << 4 | lo);
+    }
+    return {i / 2, PARSE_SUCCESS, bytes(p.Data + i, p.Count - i)};
+}
+
+parse_result<bytes> parse_hex(bytes p) {
+    byte *out = allocate_array<byte>(p.Count / 2 + 1);
+
+    auto [size, status, rest] = parse_hex(out, p);
+    if (status != PARSE_SUCCESS || !size) {
+        free(out);
+        return {bytes(), status, rest};
+    }
+    return {bytes(out, size), status, rest};
+}
+
+LSTD_END_NAMESPACE
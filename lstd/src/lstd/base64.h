@@ -0,0 +1,73 @@
+#pragma once
+
+#include "parse.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Base64 (RFC 4648, standard and URL-safe) and hex encoding of bytes, for blobs in JSON, URLs and logs.
+//
+//     utf8 *text = allocate_array<utf8>(base64_encoded_size(data.Count));
+//     s64 size = base64_encode(text, data.Data, data.Count);
+//
+//     byte *out = allocate_array<byte>(base64_decoded_max_size(text.Count));
+//     auto [written, status, rest] = parse_base64(out, text);
+//
+// or with allocation, base64_encode(data) returns a string and parse_base64(text) returns bytes.
+// Formatting bytes with "{:b}" writes base64 (and "{:#b}" the URL-safe one without padding), "{:x}" writes hex.
+//
+// Every codec does 16 bytes (SSSE3) or 32 bytes (AVX2) per iteration without table lookups in memory:
+// - Encoding base64 shuffles 3 byte groups into 4 byte lanes, splits out the 6 bit indices with two
+//   multiplies (Muła, "Base64 encoding with SIMD instructions") and turns them into letters with a
+//   16 entry shuffle of offsets.
+// - Decoding classifies the characters with range compares (one movemask tells if they are all valid),
+//   adds the offset of their range and packs 4 sextets into 3 bytes with two multiply-adds.
+// - Hex does the same with nibbles.
+// The tails and invalid characters go through the scalar loops, which also find where the parsing stops.
+//
+
+struct base64_options {
+    bool UrlSafe = false;  // '-' and '_' instead of '+' and '/'
+    bool Padding = true;   // Pad the output with '=' to a multiple of 4 characters, parsing accepts both
+};
+
+// Characters base64_encode() writes for _count_ bytes
+constexpr s64 base64_encoded_size(s64 count, base64_options options = {}) {
+    if (options.Padding) return (count + 2) / 3 * 4;
+    return count / 3 * 4 + (count % 3 ? count % 3 + 1 : 0);
+}
+
+// The most bytes _size_ characters decode to, the room parse_base64() needs
+constexpr s64 base64_decoded_max_size(s64 size) { return (size + 3) / 4 * 3; }
+
+// Writes the base64 of the _count_ bytes at _in_ to _out_ (which has room for base64_encoded_size()), returns how many characters
+s64 base64_encode(utf8 *out, const byte *in, s64 count, base64_options options = {});
+
+// Allocates the result with the Context's allocator
+string base64_encode(bytes data, base64_options options = {});
+
+// Decodes base64 characters to _out_ (which has room for base64_decoded_max_size(p.Count)).
+// Stops at the first byte which isn't in the alphabet of _options_ (or after the padding), the Value is the number of bytes written.
+//
+// Returns:
+//   * PARSE_SUCCESS  if the characters before the stop are valid base64 (an empty buffer decodes to nothing),
+//   * PARSE_INVALID  if there is one character too many for a group, the padding doesn't fit
+//                    or unused bits of the last character aren't 0 (so every blob has one encoding).
+//                    _Rest_ is where the problem is.
+parse_result<s64> parse_base64(byte *out, bytes p, base64_options options = {});
+
+// Allocates the result with the Context's allocator (nothing is allocated if parsing fails)
+parse_result<bytes> parse_base64(bytes p, base64_options options = {});
+
+// Writes two hex digits for each of the _count_ bytes at _in_ to _out_, returns 2 * count
+s64 hex_encode(utf8 *out, const byte *in, s64 count, bool upper = false);
+
+// Decodes pairs of hex digits (either case) to _out_ (which has room for p.Count / 2 bytes) until a byte which isn't a hex digit.
+// The Value is the number of bytes written. Returns PARSE_INVALID if there is an odd number of digits,
+// then _Rest_ starts at the last one.
+parse_result<s64> parse_hex(byte *out, bytes p);
+
+// Allocates the result with the Context's allocator (nothing is allocated if parsing fails)
+parse_result<bytes> parse_hex(bytes p);
+
+LSTD_END_NAMESPACE
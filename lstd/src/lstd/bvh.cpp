@@ -0,0 +1,416 @@
+#include "bvh.h"
+
+#include "job_system.h"
+#include "profiler.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Build
+//
+
+file_scope constexpr s64 BVH_BINS = 16;
+
+// Subtrees with fewer primitives are built on the thread which got there, spawning a job costs more than that
+file_scope constexpr s64 BVH_PARALLEL_THRESHOLD = 4096;
+
+struct bvh_builder {
+    bvh *Tree;
+    bvh_build_options Options;
+    bool Parallel;
+
+    v3 *Centroids;  // Of every primitive, in the original order
+    s64 NodeCount;  // Allocated with atomic_inc, the nodes array is reserved up front
+    job_counter Done;
+};
+
+file_scope f32 bvh_area(const aabb3 &box) {
+    v3 e = box.Max - box.Min;
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+file_scope aabb3 bvh_empty_box() {
+    f32 inf = numeric_info<f32>::infinity();
+    return aabb3(v3(inf), v3(-inf));
+}
+
+file_scope void bvh_grow(aabb3 *box, const aabb3 &other) {
+    box->Min = min(box->Min, other.Min);
+    box->Max = max(box->Max, other.Max);
+}
+
+file_scope f32 bvh_axis(const v3 &v, s64 axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+// Partitions Indices[begin, end) in two, returns where the second part starts
+file_scope s64 bvh_split(bvh_builder *b, s64 begin, s64 end) {
+    u32 *indices = b->Tree->Indices.Data;
+
+    aabb3 centroidBounds = aabb3(b->Centroids[indices[begin]], b->Centroids[indices[begin]]);
+    For(range(begin + 1, end)) centroidBounds.add(b->Centroids[indices[it]]);
+
+    v3 extent = centroidBounds.Max - centroidBounds.Min;
+    s64 axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    f32 lo = bvh_axis(centroidBounds.Min, axis), size = bvh_axis(extent, axis);
+    if (size <= 0) return begin + (end - begin) / 2;  // All centroids are the same, any split is as good
+
+    aabb3 binBounds[BVH_BINS];
+    s64 binCounts[BVH_BINS] = {};
+    For(binBounds) it = bvh_empty_box();
+
+    f32 scale = (f32) BVH_BINS / size;
+    auto bin_of = [&](u32 primitive) { return min((s64) ((bvh_axis(b->Centroids[primitive], axis) - lo) * scale), BVH_BINS - 1); };
+
+    For(range(begin, end)) {
+        s64 bin = bin_of(indices[it]);
+        binCounts[bin] += 1;
+        bvh_grow(&binBounds[bin], b->Tree->Bounds[indices[it]]);
+    }
+
+    // Sweep from the right to get the cost of everything right of each plane, then from the left to pick the best
+    f32 rightCost[BVH_BINS];
+    aabb3 acc = bvh_empty_box();
+    s64 accCount = 0;
+    for (s64 i = BVH_BINS - 1; i > 0; --i) {
+        bvh_grow(&acc, binBounds[i]);
+        accCount += binCounts[i];
+        rightCost[i] = accCount ? bvh_area(acc) * (f32) accCount : 0;
+    }
+
+    s64 bestPlane = -1;
+    f32 bestCost = numeric_info<f32>::infinity();
+
+    acc = bvh_empty_box();
+    accCount = 0;
+    For(range(1, BVH_BINS)) {
+        bvh_grow(&acc, binBounds[it - 1]);
+        accCount += binCounts[it - 1];
+        if (!accCount || accCount == end - begin) continue;
+
+        f32 cost = bvh_area(acc) * (f32) accCount + rightCost[it];
+        if (cost < bestCost) bestCost = cost, bestPlane = it;
+    }
+    if (bestPlane == -1) return begin + (end - begin) / 2;
+
+    s64 i = begin, j = end - 1;
+    while (i <= j) {
+        if (bin_of(indices[i]) < bestPlane) {
+            ++i;
+        } else {
+            swap(indices[i], indices[j]);
+            --j;
+        }
+    }
+    return i;
+}
+
+file_scope void bvh_build_node(bvh_builder *b, s64 nodeIndex, s64 begin, s64 end, s64 depth);
+
+// Splits the biggest range until there are four children (or nothing is big enough), so every node is as full as it can be
+file_scope void bvh_build_node(bvh_builder *b, s64 nodeIndex, s64 begin, s64 end, s64 depth) {
+    s64 ranges[4][2] = {{begin, end}};
+    s64 rangeCount = 1;
+
+    while (rangeCount < 4) {
+        s64 biggest = -1;
+        For(range(rangeCount)) {
+            s64 n = ranges[it][1] - ranges[it][0];
+            if (n > b->Options.MaxLeafSize && (biggest == -1 || n > ranges[biggest][1] - ranges[biggest][0])) biggest = it;
+        }
+        if (biggest == -1) break;
+
+        s64 lo = ranges[biggest][0], hi = ranges[biggest][1];
+        s64 mid = bvh_split(b, lo, hi);
+        ranges[biggest][1] = mid;
+        ranges[rangeCount][0] = mid, ranges[rangeCount][1] = hi;
+        ++rangeCount;
+    }
+
+    // Record the depth, the traversal sizes its stack from it
+    s64 seen = atomic_load(&b->Tree->MaxDepth);
+    while (depth > seen) {
+        s64 old = atomic_compare_and_swap(&b->Tree->MaxDepth, depth, seen);
+        if (old == seen) break;
+        seen = old;
+    }
+
+    bvh_node &node = b->Tree->Nodes.Data[nodeIndex];
+    For_as(c, range(4)) {
+        if (c >= rangeCount) {
+            f32 inf = numeric_info<f32>::infinity();
+            node.MinX[c] = node.MinY[c] = node.MinZ[c] = inf;
+            node.MaxX[c] = node.MaxY[c] = node.MaxZ[c] = -inf;
+            node.Child[c] = -1;
+            node.Count[c] = 0;
+            continue;
+        }
+
+        s64 lo = ranges[c][0], hi = ranges[c][1];
+
+        aabb3 box = bvh_empty_box();
+        For(range(lo, hi)) bvh_grow(&box, b->Tree->Bounds[b->Tree->Indices[it]]);
+        node.MinX[c] = box.Min.x, node.MinY[c] = box.Min.y, node.MinZ[c] = box.Min.z;
+        node.MaxX[c] = box.Max.x, node.MaxY[c] = box.Max.y, node.MaxZ[c] = box.Max.z;
+
+        if (hi - lo <= b->Options.MaxLeafSize) {
+            node.Child[c] = (s32) lo;
+            node.Count[c] = (u32) (hi - lo);
+            continue;
+        }
+
+        s64 child = atomic_inc(&b->NodeCount) - 1;
+        node.Child[c] = (s32) child;
+        node.Count[c] = 0;
+
+        if (b->Parallel && hi - lo >= BVH_PARALLEL_THRESHOLD) {
+            job_run([=](void *) { bvh_build_node(b, child, lo, hi, depth + 1); }, null, &b->Done);
+        } else {
+            bvh_build_node(b, child, lo, hi, depth + 1);
+        }
+    }
+}
+
+void bvh_build(bvh &tree, const aabb3 *bounds, s64 count, bvh_build_options options) {
+    PROFILE_ZONE("bvh_build");
+
+    free(tree);
+    if (count <= 0) return;
+
+    assert(count < S32_MAX && "Nodes store 32 bit indices");
+    assert(options.MaxLeafSize > 0);
+
+    array_reserve(tree.Bounds, count);
+    array_reserve(tree.Indices, count);
+    For(range(count)) {
+        array_append(tree.Bounds, bounds[it]);
+        array_append(tree.Indices, (u32) it);
+    }
+
+    // An inner node has at least two children, so there are fewer inner nodes than primitives
+    array_reserve(tree.Nodes, count);
+
+    auto *centroids = allocate_array<v3>(count);
+    defer(free(centroids));
+    For(range(count)) centroids[it] = bounds[it].center();
+
+    bvh_builder builder;
+    builder.Tree = &tree;
+    builder.Options = options;
+    builder.Parallel = options.Parallel && job_system_worker_count() > 0 && count >= BVH_PARALLEL_THRESHOLD;
+    builder.Centroids = centroids;
+    builder.NodeCount = 1;
+
+    bvh_build_node(&builder, 0, 0, count, 1);
+    job_wait(&builder.Done);
+
+    tree.Nodes.Count = builder.NodeCount;
+}
+
+void bvh_build(bvh &tree, const Triangle3D<f32> *triangles, s64 count, bvh_build_options options) {
+    auto *bounds = allocate_array<aabb3>(count);
+    defer(free(bounds));
+
+    For(range(count)) {
+        auto &t = triangles[it];
+        bounds[it] = aabb3(min(min(t.a, t.b), t.c), max(max(t.a, t.b), t.c));
+    }
+    bvh_build(tree, bounds, count, options);
+}
+
+void free(bvh &tree) {
+    free(tree.Nodes);
+    free(tree.Indices);
+    free(tree.Bounds);
+    tree.MaxDepth = 0;
+}
+
+//
+// Queries
+//
+
+// The ray with what the slab test needs per axis
+struct bvh_ray {
+    f32 O[3], InvD[3];
+};
+
+// Slab test of the ray against the four children of _node_. Returns a bit per child that's hit and their entry distances.
+file_scope u32 bvh_node_ray(const bvh_node &node, const bvh_ray &r, f32 maxDistance, f32 *tNear) {
+    u32 mask;
+#if ARCH == X86
+    __m128 tn = _mm_setzero_ps(), tf = _mm_set1_ps(maxDistance);
+    auto slab = [&](const f32 *min, const f32 *max, s64 axis) {
+        __m128 o = _mm_set1_ps(r.O[axis]), inv = _mm_set1_ps(r.InvD[axis]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(min), o), inv);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(max), o), inv);
+        tn = _mm_max_ps(tn, _mm_min_ps(t1, t2));
+        tf = _mm_min_ps(tf, _mm_max_ps(t1, t2));
+    };
+    slab(node.MinX, node.MaxX, 0);
+    slab(node.MinY, node.MaxY, 1);
+    slab(node.MinZ, node.MaxZ, 2);
+    _mm_storeu_ps(tNear, tn);
+    mask = (u32) _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+#elif ARCH == ARM && ANY_ARM_NEON
+    float32x4_t tn = vdupq_n_f32(0.0f), tf = vdupq_n_f32(maxDistance);
+    auto slab = [&](const f32 *min, const f32 *max, s64 axis) {
+        float32x4_t o = vdupq_n_f32(r.O[axis]), inv = vdupq_n_f32(r.InvD[axis]);
+        float32x4_t t1 = vmulq_f32(vsubq_f32(vld1q_f32(min), o), inv);
+        float32x4_t t2 = vmulq_f32(vsubq_f32(vld1q_f32(max), o), inv);
+        tn = vmaxq_f32(tn, vminq_f32(t1, t2));
+        tf = vminq_f32(tf, vmaxq_f32(t1, t2));
+    };
+    slab(node.MinX, node.MaxX, 0);
+    slab(node.MinY, node.MaxY, 1);
+    slab(node.MinZ, node.MaxZ, 2);
+    vst1q_f32(tNear, tn);
+    uint32x4_t bits = {1, 2, 4, 8};
+    mask = vaddvq_u32(vandq_u32(vcleq_f32(tn, tf), bits));
+#else
+    mask = 0;
+    For_as(c, range(4)) {
+        f32 tn = 0, tf = maxDistance;
+        const f32 *mins[3] = {node.MinX, node.MinY, node.MinZ}, *maxs[3] = {node.MaxX, node.MaxY, node.MaxZ};
+        For_as(axis, range(3)) {
+            f32 t1 = (mins[axis][c] - r.O[axis]) * r.InvD[axis], t2 = (maxs[axis][c] - r.O[axis]) * r.InvD[axis];
+            tn = max(tn, min(t1, t2));
+            tf = min(tf, max(t1, t2));
+        }
+        tNear[c] = tn;
+        if (tn <= tf) mask |= 1u << c;
+    }
+#endif
+    // Empty children have inverted bounds, which a ray parallel to an axis can still "hit"
+    For_as(c, range(4)) if (node.Child[c] == -1) mask &= ~(1u << c);
+    return mask;
+}
+
+// Möller-Trumbore, returns infinity if the ray misses
+file_scope f32 bvh_ray_triangle(const ray<f32, 3> &r, const Triangle3D<f32> &t, f32 *u, f32 *v) {
+    constexpr f32 EPSILON = 1e-8f;
+    f32 inf = numeric_info<f32>::infinity();
+
+    v3 edge1 = t.b - t.a, edge2 = t.c - t.a;
+    v3 h = cross(v3(r.Direction), edge2);
+    f32 a = dot(edge1, h);
+    if (abs(a) < EPSILON) return inf;
+
+    f32 f = 1.0f / a;
+    v3 s = v3(r.Base) - t.a;
+    f32 uu = f * dot(s, h);
+    if (uu < 0 || uu > 1) return inf;
+
+    v3 q = cross(s, edge1);
+    f32 vv = f * dot(v3(r.Direction), q);
+    if (vv < 0 || uu + vv > 1) return inf;
+
+    f32 dist = f * dot(edge2, q);
+    if (dist <= EPSILON) return inf;
+
+    *u = uu, *v = vv;
+    return dist;
+}
+
+// Closest hit traversal, children are visited near to far so far subtrees are skipped once something is hit.
+// _test(primitive, maxDistance, &u, &v)_ returns the distance of the hit or infinity.
+template <typename Test>
+file_scope bvh_hit bvh_traverse(const bvh &tree, const ray<f32, 3> &r, f32 maxDistance, Test &&test) {
+    bvh_hit hit;
+    hit.Distance = maxDistance;
+    if (!tree.Nodes.Count) return hit;
+
+    bvh_ray br;
+    br.O[0] = r.Base.x, br.O[1] = r.Base.y, br.O[2] = r.Base.z;
+    br.InvD[0] = 1.0f / r.Direction.x, br.InvD[1] = 1.0f / r.Direction.y, br.InvD[2] = 1.0f / r.Direction.z;
+
+    // A node pushes at most 3 more than it pops
+    s64 stackSize = tree.MaxDepth * 3 + 1;
+    s32 localStack[256];
+    s32 *stack = localStack;
+    if (stackSize > 256) stack = allocate_array<s32>(stackSize, {.Alloc = Context.TempAlloc});
+    defer({
+        if (stack != localStack) free(stack);
+    });
+
+    s64 top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const bvh_node &node = tree.Nodes[stack[--top]];
+
+        f32 tNear[4];
+        u32 mask = bvh_node_ray(node, br, hit.Distance, tNear);
+        if (!mask) continue;
+
+        // Sort the hit children by distance, then leaves are tested now and nodes pushed far first
+        s64 order[4], n = 0;
+        For_as(c, range(4)) {
+            if (!(mask & (1u << c))) continue;
+            s64 k = n++;
+            while (k > 0 && tNear[order[k - 1]] > tNear[c]) order[k] = order[k - 1], --k;
+            order[k] = c;
+        }
+
+        for (s64 k = n - 1; k >= 0; --k) {
+            s64 c = order[k];
+            if (node.Count[c]) {
+                For(range((s64) node.Child[c], (s64) node.Child[c] + node.Count[c])) {
+                    u32 primitive = tree.Indices[it];
+                    f32 u = 0, v = 0;
+                    f32 dist = test(primitive, hit.Distance, &u, &v);
+                    if (dist < hit.Distance) hit.Distance = dist, hit.Primitive = primitive, hit.U = u, hit.V = v;
+                }
+            } else {
+                stack[top++] = node.Child[c];
+            }
+        }
+    }
+    return hit;
+}
+
+bvh_hit bvh_raycast(const bvh &tree, const Triangle3D<f32> *triangles, const ray<f32, 3> &r, f32 maxDistance) {
+    return bvh_traverse(tree, r, maxDistance, [&](u32 primitive, f32, f32 *u, f32 *v) { return bvh_ray_triangle(r, triangles[primitive], u, v); });
+}
+
+bvh_hit bvh_raycast(const bvh &tree, const ray<f32, 3> &r, const delegate<f32(u32 primitive, f32 maxDistance)> &intersect, f32 maxDistance) {
+    return bvh_traverse(tree, r, maxDistance, [&](u32 primitive, f32 maxDist, f32 *, f32 *) { return intersect(primitive, maxDist); });
+}
+
+s64 bvh_overlaps(const bvh &tree, const aabb3 &box, array<u32> &out) {
+    if (!tree.Nodes.Count) return 0;
+
+    s64 before = out.Count;
+
+    s64 stackSize = tree.MaxDepth * 3 + 1;
+    s32 localStack[256];
+    s32 *stack = localStack;
+    if (stackSize > 256) stack = allocate_array<s32>(stackSize, {.Alloc = Context.TempAlloc});
+    defer({
+        if (stack != localStack) free(stack);
+    });
+
+    s64 top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const bvh_node &node = tree.Nodes[stack[--top]];
+
+        For_as(c, range(4)) {
+            if (node.Child[c] == -1) continue;
+            if (node.MinX[c] > box.Max.x || node.MaxX[c] < box.Min.x) continue;
+            if (node.MinY[c] > box.Max.y || node.MaxY[c] < box.Min.y) continue;
+            if (node.MinZ[c] > box.Max.z || node.MaxZ[c] < box.Min.z) continue;
+
+            if (node.Count[c]) {
+                For(range((s64) node.Child[c], (s64) node.Child[c] + node.Count[c])) {
+                    u32 primitive = tree.Indices[it];
+                    if (tree.Bounds[primitive].overlaps(box)) array_append(out, primitive);
+                }
+            } else {
+                stack[top++] = node.Child[c];
+            }
+        }
+    }
+    return out.Count - before;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "math/geometry.h"
+#include "memory/array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A bounding volume hierarchy over boxes (or triangles, which are boxed first) for ray casts and overlap queries.
+//
+//     bvh tree;
+//     bvh_build(tree, mesh.Triangles.Data, mesh.Triangles.Count);
+//     defer(free(tree));
+//
+//     bvh_hit hit = bvh_raycast(tree, mesh.Triangles.Data, ray<f32, 3>(origin, direction));
+//     if (hit.Primitive != -1) { ... hit.Distance, hit.U, hit.V ... }
+//
+//     array<u32> near;
+//     bvh_overlaps(tree, aabb3(p - v3(1), p + v3(1)), near);
+//
+// The build uses the surface area heuristic over 16 bins of the centroids: a split is placed where
+// (left area * left count + right area * right count) is smallest, the chance that a random ray hits a child
+// is proportional to its area. Big subtrees are built as jobs on the job system when it's running (see job_system.h).
+//
+// Nodes are 4-wide: each one holds the bounds of its four children as SoA, so a ray or a box is tested against
+// all four with one SIMD compare, and a node is two cache lines. The nodes are in one flat array and
+// the leaves are ranges of _Indices_, there are no pointers to chase.
+//
+// The tree doesn't keep the primitives (only their bounds), the queries which need them take them again.
+// It doesn't refit: if primitives move, build it again.
+//
+
+struct bvh_node {
+    f32 MinX[4], MinY[4], MinZ[4];
+    f32 MaxX[4], MaxY[4], MaxZ[4];
+
+    // If Count[i] is 0, Child[i] is the index of a node (or -1 if there is no child).
+    // Otherwise the child is a leaf: Indices[Child[i]] .. Indices[Child[i] + Count[i]].
+    s32 Child[4];
+    u32 Count[4];
+};
+
+struct bvh {
+    array<bvh_node> Nodes;  // The root is Nodes[0], empty if the tree was built over nothing
+    array<u32> Indices;     // Primitive indices in leaf order
+    array<aabb3> Bounds;    // Of every primitive, in the original order
+
+    s64 MaxDepth = 0;
+};
+
+struct bvh_build_options {
+    s64 MaxLeafSize = 4;  // Ranges with at most this many primitives become leaves
+    bool Parallel = true;   // Build big subtrees as jobs (if the job system is running)
+};
+
+void bvh_build(bvh &tree, const aabb3 *bounds, s64 count, bvh_build_options options = {});
+void bvh_build(bvh &tree, const Triangle3D<f32> *triangles, s64 count, bvh_build_options options = {});
+
+struct bvh_hit {
+    s64 Primitive = -1;  // -1 if nothing was hit
+    f32 Distance = 0;    // Along the ray's direction (which is normalized)
+    f32 U = 0, V = 0;    // Barycentric coordinates of the hit in the triangle (b and c), see Triangle3D
+};
+
+// The closest triangle the ray hits not further than _maxDistance_. _triangles_ are the ones the tree was built with.
+bvh_hit bvh_raycast(const bvh &tree, const Triangle3D<f32> *triangles, const ray<f32, 3> &r, f32 maxDistance = numeric_info<f32>::infinity());
+
+// For other primitives: _intersect(primitive, maxDistance)_ returns the distance to the primitive along the ray
+// or infinity if it's missed. The closest hit is returned (U and V are 0).
+bvh_hit bvh_raycast(const bvh &tree, const ray<f32, 3> &r, const delegate<f32(u32 primitive, f32 maxDistance)> &intersect,
+                    f32 maxDistance = numeric_info<f32>::infinity());
+
+// Appends the primitives whose bounds overlap _box_ to _out_, returns how many were appended
+s64 bvh_overlaps(const bvh &tree, const aabb3 &box, array<u32> &out);
+
+void free(bvh &tree);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,201 @@
+#include "call_stack.h"
+
+#include "memory/hash_table.h"
+
+import fmt;
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+struct call_stack_state {
+    // Interning a stack which was seen before only takes the lock shared
+    thread::fast_shared_mutex StacksLock;
+    hash_table<u64, call_stack> Stacks;
+
+    thread::fast_mutex SymbolsLock;
+    hash_table<void *, os_function_call> Symbols;
+
+    // Addresses of new stacks waiting for the symbolizer (guarded by _SymbolsLock_), _Pending_ counts the batches
+    array<void *> Queue;
+    thread::semaphore Pending;
+
+    thread::thread Symbolizer;
+    s32 SymbolizerRunning, SymbolizerStop;
+};
+
+file_scope call_stack_state CallStacks;
+
+// Set while we allocate with a lock held. The allocation profiler interns stacks from inside the allocator,
+// so without this an allocation of ours could come back to a lock we hold. Such stacks just aren't interned.
+file_scope thread_local bool InCallStacks = false;
+
+// Expects _SymbolsLock_ to be held
+file_scope void call_stack_queue(const call_stack &stack) {
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        array_append(CallStacks.Queue, stack.Frames, stack.Count);
+    }
+    CallStacks.Pending.signal();
+}
+
+u64 call_stack_capture(s64 framesToSkip) {
+    void *frames[CALL_STACK_MAX_FRAMES];
+    s64 count = os_capture_call_stack(frames, CALL_STACK_MAX_FRAMES, framesToSkip + 1);
+    return call_stack_intern(frames, count);
+}
+
+u64 call_stack_intern(void **frames, s64 count) {
+    auto &s = CallStacks;
+
+    count = min(count, CALL_STACK_MAX_FRAMES);
+    if (count <= 0 || InCallStacks) return 0;
+
+    InCallStacks = true;
+    defer(InCallStacks = false);
+
+    u64 id = hash_bytes(frames, count * sizeof(void *));
+    if (!id) id = 1;  // 0 means no stack
+
+    s.StacksLock.lock_shared();
+    bool known = find(s.Stacks, id).Value != null;
+    s.StacksLock.unlock_shared();
+    if (known) return id;
+
+    call_stack stack;
+    copy_memory(stack.Frames, frames, count * sizeof(void *));
+    stack.Count = count;
+
+    {
+        thread::scoped_lock<thread::fast_shared_mutex> _(&s.StacksLock);
+        if (find(s.Stacks, id).Value) return id;  // Someone else interned it meanwhile
+
+        PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+            add(s.Stacks, id, stack);
+        }
+    }
+
+    if (atomic_load(&s.SymbolizerRunning)) {
+        thread::scoped_lock<thread::fast_mutex> _(&s.SymbolsLock);
+        call_stack_queue(stack);
+    }
+    return id;
+}
+
+bool call_stack_get(u64 id, call_stack *out) {
+    auto &s = CallStacks;
+
+    s.StacksLock.lock_shared();
+    defer(s.StacksLock.unlock_shared());
+
+    auto [key, stack] = find(s.Stacks, id);
+    if (!stack) return false;
+
+    *out = *stack;
+    return true;
+}
+
+os_function_call call_stack_resolve(void *address) {
+    auto &s = CallStacks;
+    {
+        thread::scoped_lock<thread::fast_mutex> _(&s.SymbolsLock);
+        auto [key, cached] = find(s.Symbols, address);
+        if (cached) return *cached;
+    }
+
+    InCallStacks = true;
+    defer(InCallStacks = false);
+
+    // Resolve without the lock, it's the slow part. Two threads may resolve the same address, the first one to finish wins.
+    os_function_call call;
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        call = os_resolve_function_call(address);
+    }
+
+    thread::scoped_lock<thread::fast_mutex> _(&s.SymbolsLock);
+
+    auto [key, cached] = find(s.Symbols, address);
+    if (cached) {
+        free(call.Name);
+        free(call.File);
+        return *cached;
+    }
+
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        add(s.Symbols, address, call);
+    }
+    return call;
+}
+
+file_scope void call_stack_symbolizer_main(void *) {
+    auto &s = CallStacks;
+
+    array<void *> batch;
+    defer(free(batch));
+
+    while (true) {
+        s.Pending.wait();
+        if (atomic_load(&s.SymbolizerStop)) break;
+
+        // Take everything queued so far, the queue stays valid for the producers
+        {
+            thread::scoped_lock<thread::fast_mutex> _(&s.SymbolsLock);
+            swap(batch, s.Queue);
+        }
+
+        For(batch) call_stack_resolve(it);
+        batch.Count = 0;
+    }
+}
+
+void call_stack_symbolizer_start() {
+    auto &s = CallStacks;
+    if (atomic_load(&s.SymbolizerRunning)) return;
+
+    atomic_store(&s.SymbolizerStop, 0);
+    atomic_store(&s.SymbolizerRunning, 1);
+
+    InCallStacks = true;
+    defer(InCallStacks = false);
+
+    // Stacks interned before we started. New ones are queued by call_stack_intern() from now on, a stack interned
+    // right now may be queued twice, which only costs a cache hit.
+    {
+        thread::scoped_lock<thread::fast_shared_mutex> _(&s.StacksLock);
+        thread::scoped_lock<thread::fast_mutex> __(&s.SymbolsLock);
+        For(s.Stacks) call_stack_queue(*it.Value);
+    }
+
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        s.Symbolizer.init_and_launch(call_stack_symbolizer_main, null);
+    }
+}
+
+void call_stack_symbolizer_stop() {
+    auto &s = CallStacks;
+    if (!atomic_load(&s.SymbolizerRunning)) return;
+
+    atomic_store(&s.SymbolizerRunning, 0);
+    atomic_store(&s.SymbolizerStop, 1);
+    s.Pending.signal();
+    s.Symbolizer.wait();
+
+    // What's left is resolved on demand
+    thread::scoped_lock<thread::fast_mutex> _(&s.SymbolsLock);
+    s.Queue.Count = 0;
+    while (s.Pending.try_wait()) {
+    }
+}
+
+void call_stack_print(u64 id) {
+    call_stack stack;
+    if (!call_stack_get(id, &stack)) {
+        print("    (unknown call stack {:#x})\n", id);
+        return;
+    }
+
+    For(range(stack.Count)) {
+        auto call = call_stack_resolve(stack.Frames[it]);
+        print("    {} ({}:{})\n", call.Name, call.File, call.LineNumber);
+    }
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "internal/os_function_call.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// :CallStacks: Capturing a call stack is cheap, os_capture_call_stack() only copies return addresses (the unwind
+// tables are walked on Windows, the frame pointers elsewhere). Making sense of it isn't - symbols come from debug
+// info and resolving one address can take anywhere from microseconds to milliseconds.
+//
+// So hot paths (a sampled allocation, an error which happens often) capture and intern the stack, keep the id and
+// move on. The same stack always gets the same id and is stored once, so code can record millions of them:
+//
+//     if (!parse(...)) {
+//         u64 where = call_stack_capture();  // No symbols, no allocation if this stack was seen before
+//         add_error(errors, code, where);
+//     }
+//
+//     ... later, off the hot path
+//     call_stack_print(error.Where);
+//
+// The symbols are resolved the first time they are asked for and then cached. Start the symbolizer to resolve them
+// on a background thread as new stacks come in, then printing at the end doesn't stall either.
+//
+// Call stacks and symbols are kept in the platform's persistent allocator for the rest of the program.
+//
+constexpr s64 CALL_STACK_MAX_FRAMES = 32;
+
+struct call_stack {
+    void *Frames[CALL_STACK_MAX_FRAMES];  // Innermost call first
+    s64 Count = 0;
+};
+
+// Captures the stack of the calling thread (without this function and _framesToSkip_ more) and interns it.
+// Returns its id, 0 if nothing could be captured.
+u64 call_stack_capture(s64 framesToSkip = 0);
+
+// Interns frames which were already captured, at most CALL_STACK_MAX_FRAMES are kept. Returns the id, 0 if _count_ is 0.
+u64 call_stack_intern(void **frames, s64 count);
+
+// Returns false if _id_ wasn't returned by call_stack_capture() or call_stack_intern()
+bool call_stack_get(u64 id, call_stack *out);
+
+// Starts a thread which resolves the symbols of every stack interned from now on (and of the ones interned before).
+void call_stack_symbolizer_start();
+
+// Waits for the thread to finish the addresses it already took and stops it. Stacks are still interned after this.
+void call_stack_symbolizer_stop();
+
+// The function, file and line of _address_, from the cache or resolved (and cached) now.
+// Don't free the strings in the result, they live as long as the program.
+os_function_call call_stack_resolve(void *address);
+
+// Prints a stack to Context.Log, one call per line: "    name (file:line)"
+void call_stack_print(u64 id);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,414 @@
+#include "compress.h"
+
+#include "job_system.h"
+#include "memory/hasher.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// The codec. Like LZ4_compress_fast(): hash the next 4 bytes, look up the last position with the same hash, and if
+// the bytes there match, emit the literals before it and the match. When nothing matches for a while we start
+// skipping ahead faster (incompressible data goes through at several GB/s).
+//
+// A sequence is a token (4 bits of literal length, 4 bits of match length - 4), more length bytes if a nibble is 15,
+// the literals, and a 2 byte offset. The last sequence has only literals. LZ4 decoders expect the last 5 bytes to
+// be literals and the last match to begin 12 bytes before the end, so we follow that.
+//
+
+file_scope constexpr s64 LZ_MIN_MATCH     = 4;
+file_scope constexpr s64 LZ_LAST_LITERALS = 5;
+file_scope constexpr s64 LZ_MATCH_LIMIT   = 12;  // The last match begins at least this far from the end
+file_scope constexpr s64 LZ_MAX_OFFSET    = 65535;
+
+file_scope constexpr s32 LZ_HASH_BITS = 12;  // 16 KiB of positions, on the stack, fits in L1
+
+file_scope always_inline u32 lz_hash(const byte *p) { return (xxh3::read_u32(p) * 2654435761u) >> (32 - LZ_HASH_BITS); }
+
+// Unaligned, like xxh3::read_u64()
+file_scope always_inline void lz_copy_8(byte *dest, const byte *src) { *(u64 *) dest = xxh3::read_u64(src); }
+
+file_scope always_inline byte *lz_write_length(byte *op, s64 length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (byte) length;
+    return op;
+}
+
+// How many bytes match at _a_ and _b_, 8 at a time, stopping at _limit_ (_a_ is the later one)
+file_scope always_inline s64 lz_match_length(const byte *a, const byte *b, const byte *limit) {
+    const byte *start = a;
+    while (a + 8 <= limit) {
+        u64 diff = xxh3::read_u64(a) ^ xxh3::read_u64(b);
+        if (diff) return a - start + lsb(diff) / 8;  // Little endian, the first different byte is the lowest
+        a += 8, b += 8;
+    }
+    while (a < limit && *a == *b) ++a, ++b;
+    return a - start;
+}
+
+file_scope always_inline byte *lz_write_literals(byte *op, byte *token, const byte *literals, s64 count) {
+    if (count >= 15) {
+        *token = 15 << 4;
+        op     = lz_write_length(op, count - 15);
+    } else {
+        *token = (byte) (count << 4);
+    }
+    copy_memory(op, literals, count);
+    return op + count;
+}
+
+s64 lz_compress(byte *dest, const byte *src, s64 size) {
+    const byte *ip = src, *anchor = src, *end = src + size;
+    byte *op = dest;
+
+    if (size > LZ_MATCH_LIMIT) {
+        const byte *mflimit    = end - LZ_MATCH_LIMIT;
+        const byte *matchlimit = end - LZ_LAST_LITERALS;
+
+        s32 table[1 << LZ_HASH_BITS];  // Offsets from _src_, zero is fine as a start - every candidate is checked
+        zero_memory(table, sizeof(table));
+
+        ++ip;
+        while (true) {
+            // Find a match
+            const byte *match;
+            s64 attempts = 1 << 6;  // Each 64 misses in a row increase the step by one
+            while (true) {
+                if (ip > mflimit) goto last_literals;
+
+                u32 h    = lz_hash(ip);
+                match    = src + table[h];
+                table[h] = (s32) (ip - src);
+                if (match < ip && ip - match <= LZ_MAX_OFFSET && xxh3::read_u32(match) == xxh3::read_u32(ip)) break;
+
+                ip += attempts++ >> 6;
+            }
+
+            // The match may begin earlier
+            while (ip > anchor && match > src && ip[-1] == match[-1]) --ip, --match;
+
+            byte *token = op++;
+            op          = lz_write_literals(op, token, anchor, ip - anchor);
+
+            s64 offset = ip - match;
+            *op++      = (byte) offset;
+            *op++      = (byte) (offset >> 8);
+
+            s64 length = lz_match_length(ip + LZ_MIN_MATCH, match + LZ_MIN_MATCH, matchlimit);
+            ip += LZ_MIN_MATCH + length;
+            if (length >= 15) {
+                *token += 15;
+                op = lz_write_length(op, length - 15);
+            } else {
+                *token += (byte) length;
+            }
+
+            anchor = ip;
+            if (ip > mflimit) break;
+
+            // Positions inside the match are skipped, this one makes the tail of repeats findable
+            table[lz_hash(ip - 2)] = (s32) (ip - 2 - src);
+        }
+    }
+
+last_literals:
+    byte *token = op++;
+    op          = lz_write_literals(op, token, anchor, end - anchor);
+    return op - dest;
+}
+
+s64 lz_decompress(byte *dest, s64 destSize, const byte *src, s64 size) {
+    const byte *ip = src, *iend = src + size;
+    byte *op = dest, *oend = dest + destSize;
+
+    while (ip < iend) {
+        u32 token = *ip++;
+
+        s64 literals = token >> 4;
+        if (literals == 15) {
+            while (true) {
+                if (ip == iend) return -1;
+                u32 b = *ip++;
+                literals += b;
+                if (b != 255) break;
+            }
+        }
+        if (literals > iend - ip || literals > oend - op) return -1;
+        if (literals <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            lz_copy_8(op, ip);  // Most runs are short, copy 16 and move by less
+            lz_copy_8(op + 8, ip + 8);
+        } else {
+            copy_memory(op, ip, literals);
+        }
+        ip += literals;
+        op += literals;
+
+        if (ip == iend) break;  // The last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        s64 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - dest) return -1;
+
+        s64 length = token & 15;
+        if (length == 15) {
+            while (true) {
+                if (ip == iend) return -1;
+                u32 b = *ip++;
+                length += b;
+                if (b != 255) break;
+            }
+        }
+        length += LZ_MIN_MATCH;
+        if (length > oend - op) return -1;
+
+        // The match may overlap what it writes (offset < length repeats the last _offset_ bytes).
+        // With 8 or more between them, 8 byte copies only read what's already written.
+        const byte *match = op - offset;
+        byte *stop        = op + length;
+        if (offset >= 8 && oend - stop >= 8) {
+            while (op < stop) {
+                lz_copy_8(op, match);  // May write past _stop_, the next sequence writes over it
+                op += 8, match += 8;
+            }
+        } else {
+            while (op < stop) *op++ = *match++;
+        }
+        op = stop;
+    }
+    return op - dest;
+}
+
+//
+// Streams
+//
+
+file_scope constexpr u32 COMPRESS_STREAM_MAGIC = 0x3142445A;  // "ZDB1"
+file_scope constexpr u32 COMPRESS_STORED       = 0x80000000;  // In the packed size, the block isn't compressed
+
+// Ahead of each block. A _RawSize_ of 0 ends the stream.
+struct compress_block_header {
+    u32 PackedSize;  // With COMPRESS_STORED if the data is as is
+    u32 RawSize;
+    u32 Check;  // The low half of hash_bytes() of the raw data
+};
+
+struct compress_stream_header {
+    u32 Magic;
+    u32 BlockSize;
+};
+
+file_scope s64 compress_packed_stride(s64 blockSize) { return (sizeof(compress_block_header) + lz_compress_bound(blockSize) + 7) & ~7; }
+
+void compress_writer_init(compress_writer &w, writer *out, s64 blockSize, s64 parallelBlocks, allocator alloc) {
+    free(w);
+
+    if (!blockSize) blockSize = compress_writer::DEFAULT_BLOCK_SIZE;
+    assert(blockSize > 0 && blockSize < COMPRESS_STORED);
+
+    if (!parallelBlocks) parallelBlocks = max<s64>(job_system_worker_count(), 1);
+
+    w.Out            = out;
+    w.BlockSize      = blockSize;
+    w.ParallelBlocks = parallelBlocks;
+    w.Alloc          = alloc ? alloc : Context.Alloc;
+
+    w.Raw         = allocate_array<byte>(blockSize * parallelBlocks, {.Alloc = w.Alloc});
+    w.Packed      = allocate_array<byte>(compress_packed_stride(blockSize) * parallelBlocks, {.Alloc = w.Alloc});
+    w.RawSizes    = allocate_array<s64>(parallelBlocks, {.Alloc = w.Alloc});
+    w.PackedSizes = allocate_array<s64>(parallelBlocks, {.Alloc = w.Alloc});
+
+    compress_stream_header header = {COMPRESS_STREAM_MAGIC, (u32) blockSize};
+    out->write((byte *) &header, sizeof(header));
+}
+
+file_scope void compress_block(compress_writer &w, s64 index) {
+    byte *raw    = w.Raw + index * w.BlockSize;
+    byte *packed = w.Packed + index * compress_packed_stride(w.BlockSize);
+    s64 rawSize  = w.RawSizes[index];
+
+    compress_block_header header;
+    header.RawSize = (u32) rawSize;
+    header.Check   = (u32) hash_bytes(raw, rawSize);
+
+    s64 packedSize = lz_compress(packed + sizeof(header), raw, rawSize);
+    if (packedSize >= rawSize) {
+        copy_memory(packed + sizeof(header), raw, rawSize);
+        header.PackedSize = (u32) rawSize | COMPRESS_STORED;
+        packedSize        = rawSize;
+    } else {
+        header.PackedSize = (u32) packedSize;
+    }
+    copy_memory(packed, &header, sizeof(header));
+    w.PackedSizes[index] = sizeof(header) + packedSize;
+}
+
+// Compresses the blocks which are full (and the one being filled if it has anything) and writes them out
+file_scope void compress_writer_drain(compress_writer &w) {
+    s64 count = w.Block;
+    if (w.Filled) w.RawSizes[count++] = w.Filled;
+    if (!count) return;
+
+    auto body = [&](s64 begin, s64 end) {
+        For(range(begin, end)) compress_block(w, it);
+    };
+    job_parallel_for(count, 1, &body);
+
+    bytes spans[64];
+    s64 spanCount = 0;
+    For(range(count)) {
+        spans[spanCount++] = bytes(w.Packed + it * compress_packed_stride(w.BlockSize), w.PackedSizes[it]);
+        w.PackedBytes += w.PackedSizes[it];
+        if (spanCount == 64) {
+            w.Out->write_vectored(spans, spanCount);
+            spanCount = 0;
+        }
+    }
+    if (spanCount) w.Out->write_vectored(spans, spanCount);
+
+    w.Block = w.Filled = 0;
+}
+
+void compress_writer::write(const byte *data, s64 size) {
+    RawBytes += size;
+    while (size) {
+        s64 n = min(size, BlockSize - Filled);
+        copy_memory(Raw + Block * BlockSize + Filled, data, n);
+        Filled += n;
+        data += n;
+        size -= n;
+
+        if (Filled == BlockSize) {
+            RawSizes[Block++] = BlockSize;
+            Filled            = 0;
+            if (Block == ParallelBlocks) compress_writer_drain(*this);
+        }
+    }
+}
+
+void compress_writer::flush() {
+    compress_writer_drain(*this);
+    Out->flush();
+}
+
+void free(compress_writer &w) {
+    if (w.Out) {
+        compress_writer_drain(w);
+
+        compress_block_header end = {};
+        w.Out->write((byte *) &end, sizeof(end));
+        w.Out->flush();
+    }
+
+    free(w.Raw);
+    free(w.Packed);
+    free(w.RawSizes);
+    free(w.PackedSizes);
+
+    w.Out      = null;
+    w.Raw      = w.Packed = null;
+    w.RawSizes = w.PackedSizes = null;
+    w.Block    = w.Filled = 0;
+    w.RawBytes = w.PackedBytes = 0;
+}
+
+// Returns the next _size_ bytes of the input, from the current chunk if they are all there, otherwise put
+// together in _Carry_. Null if the input ends first.
+file_scope const byte *decompress_take(decompress_reader &r, s64 size) {
+    if (r.Input.Count >= size) {
+        const byte *result = r.Input.Data;
+        r.Input.Data += size;
+        r.Input.Count -= size;
+        return result;
+    }
+
+    r.Carry.Count = 0;
+    while (r.Carry.Count + r.Input.Count < size) {
+        if (r.Input) array_append(r.Carry, r.Input.Data, r.Input.Count);
+        r.Input = r.Read();
+        if (!r.Input) return null;
+    }
+
+    s64 rest = size - r.Carry.Count;
+    array_append(r.Carry, r.Input.Data, rest);
+    r.Input.Data += rest;
+    r.Input.Count -= rest;
+    return r.Carry.Data;
+}
+
+bool decompress_reader_init(decompress_reader &r, const delegate<bytes()> &read, allocator alloc) {
+    free(r);
+
+    r.Read  = read;
+    r.Alloc = alloc ? alloc : Context.Alloc;
+    PUSH_ALLOC(r.Alloc) {
+        array_reserve_exact(r.Carry, sizeof(compress_stream_header));
+    }
+
+    compress_stream_header header;
+    const byte *p = decompress_take(r, sizeof(header));
+    if (!p) return false;
+
+    copy_memory(&header, p, sizeof(header));
+    if (header.Magic != COMPRESS_STREAM_MAGIC || !header.BlockSize || header.BlockSize >= COMPRESS_STORED) return false;
+
+    r.BlockSize = header.BlockSize;
+    r.Block     = allocate_array<byte>(r.BlockSize, {.Alloc = r.Alloc});
+
+    // Big enough for any block, so putting one together never reallocates
+    r.Carry.Count = 0;
+    PUSH_ALLOC(r.Alloc) {
+        array_reserve_exact(r.Carry, compress_packed_stride(r.BlockSize));
+    }
+    return true;
+}
+
+bytes decompress_reader_next(decompress_reader &r) {
+    r.Current = {};
+    if (r.Ended) return {};
+
+    r.Ended = r.Failed = true;  // Until we've read a whole block
+
+    compress_block_header header;
+    const byte *p = decompress_take(r, sizeof(header));
+    if (!p) return {};
+    copy_memory(&header, p, sizeof(header));
+
+    if (!header.RawSize) {
+        r.Failed = header.PackedSize != 0;
+        return {};
+    }
+
+    bool stored    = header.PackedSize & COMPRESS_STORED;
+    s64 packedSize = header.PackedSize & ~COMPRESS_STORED;
+    if (header.RawSize > r.BlockSize || packedSize > lz_compress_bound(r.BlockSize)) return {};
+    if (stored && packedSize != header.RawSize) return {};
+
+    p = decompress_take(r, packedSize);
+    if (!p) return {};
+
+    if (stored) {
+        copy_memory(r.Block, p, packedSize);
+    } else if (lz_decompress(r.Block, header.RawSize, p, packedSize) != header.RawSize) {
+        return {};
+    }
+    if ((u32) hash_bytes(r.Block, header.RawSize) != header.Check) return {};
+
+    r.Ended = r.Failed = false;
+    r.Current = bytes(r.Block, header.RawSize);
+    return r.Current;
+}
+
+void free(decompress_reader &r) {
+    free(r.Block);
+    free(r.Carry);
+
+    r.Block     = null;
+    r.BlockSize = 0;
+    r.Input = r.Current = {};
+    r.Ended = r.Failed = false;
+}
+
+LSTD_END_NAMESPACE
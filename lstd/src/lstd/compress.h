@@ -0,0 +1,141 @@
+#pragma once
+
+#include "io/writer.h"
+#include "memory/delegate.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Fast LZ compression, the block format of LZ4 (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md):
+// literals and back references into the last 64 KiB, found with one hash table lookup per position. It runs at
+// hundreds of MB/s per core and decompresses at GB/s, the ratio is lower than zstd's or deflate's, but when the disk
+// is the bottleneck it's the cheapest way to write less.
+//
+// lz_compress() output can be decoded by any LZ4 block decoder and lz_decompress() reads any LZ4 block.
+//
+//     byte *packed  = allocate_array<byte>(lz_compress_bound(size));
+//     s64 packedSize = lz_compress(packed, data, size);
+//     s64 rawSize    = lz_decompress(out, outSize, packed, packedSize);  // -1 if the data is corrupted
+//
+
+// The most lz_compress() can write for _size_ bytes (incompressible data grows a bit)
+constexpr s64 lz_compress_bound(s64 size) { return size + size / 255 + 16; }
+
+// _dest_ must have room for lz_compress_bound(size) bytes. Returns the compressed size.
+s64 lz_compress(byte *dest, const byte *src, s64 size);
+
+// Returns how many bytes were written to _dest_, or -1 if _src_ isn't valid or doesn't fit in _destSize_.
+// Safe to call on untrusted input, it never reads or writes out of the buffers.
+s64 lz_decompress(byte *dest, s64 destSize, const byte *src, s64 size);
+
+//
+// Streams of compressed blocks. A compress_writer wraps any writer, file_writer for example:
+//
+//     compress_writer w;
+//     compress_writer_init(w, &file);
+//     write(&w, snapshot);
+//     free(w);  // Writes what's left and the end of the stream
+//
+// It collects _BlockSize_ bytes into a block and compresses _ParallelBlocks_ blocks at a time with the job system
+// (see job_parallel_for), so with 8 workers it takes 8 blocks to keep them busy. The compressed blocks go to _Out_
+// in order with one write_vectored(). Each block carries a checksum of its bytes.
+//
+// flush() compresses the partial block and flushes _Out_, so calling it often makes the blocks small and the ratio worse.
+//
+// A decompress_reader reads the stream from chunks of any size, the same way parse_stream does, and returns the
+// blocks one by one - decompress_reader_next() fits parse_stream's _Read_ as is:
+//
+//     auto read = [&]() { return file_reader_next(file); };
+//
+//     decompress_reader r;
+//     if (!decompress_reader_init(r, &read)) { ... not a stream ... }
+//     defer(free(r));
+//
+//     while (true) {
+//         bytes block = decompress_reader_next(r);
+//         if (!block) break;
+//         ...
+//     }
+//     if (r.Failed) { ... corrupted or cut short ... }
+//
+// The stream: a header (a magic number and the block size), then for every block its compressed size (the top bit
+// set if it's stored as is, because it didn't compress), its size and a checksum, followed by the data. A block of
+// size 0 ends the stream.
+//
+
+struct compress_writer : writer {
+    static constexpr s64 DEFAULT_BLOCK_SIZE = 256_KiB;
+
+    writer *Out = null;
+
+    s64 BlockSize      = 0;
+    s64 ParallelBlocks = 0;
+
+    byte *Raw        = null;  // _ParallelBlocks_ blocks of _BlockSize_
+    byte *Packed     = null;  // A header and room for the compressed data of each block
+    s64 *RawSizes    = null;
+    s64 *PackedSizes = null;  // With the header
+
+    s64 Block  = 0;  // The block being filled
+    s64 Filled = 0;  // Bytes in it
+
+    s64 RawBytes    = 0;  // Written to us so far
+    s64 PackedBytes = 0;  // Written to _Out_ so far (blocks which were compressed)
+
+    allocator Alloc;
+
+    compress_writer() {}
+
+    void write(const byte *data, s64 size) override;
+    void flush() override;
+};
+
+// Writes the header of the stream to _out_. _blockSize_ of 0 means DEFAULT_BLOCK_SIZE. _parallelBlocks_ of 0 means
+// one per worker of the job system (one if it isn't running). _alloc_ is Context.Alloc by default.
+void compress_writer_init(compress_writer &w, writer *out, s64 blockSize = 0, s64 parallelBlocks = 0, allocator alloc = {});
+
+// Compresses and writes what's left, ends the stream, flushes _Out_ and frees the buffers.
+void free(compress_writer &w);
+
+struct decompress_reader {
+    delegate<bytes()> Read;
+
+    bytes Input;        // What's left of the chunk _Read_ returned last
+    array<byte> Carry;  // A block header or block which spans chunks
+
+    byte *Block   = null;  // Where blocks are decompressed to
+    s64 BlockSize = 0;     // From the header of the stream
+
+    bytes Current;  // What's left of the block decompress_reader_next returned last, decompress_reader_read consumes from here
+
+    allocator Alloc;
+
+    bool Ended  = false;
+    bool Failed = false;  // The stream is corrupted or ended before its end marker, we report the end after it
+};
+
+// Reads the header of the stream. Returns false if it isn't one of ours. _alloc_ is Context.Alloc by default.
+bool decompress_reader_init(decompress_reader &r, const delegate<bytes()> &read, allocator alloc = {});
+
+// Returns the next decompressed block, empty at the end. The returned bytes stay valid until the next call.
+bytes decompress_reader_next(decompress_reader &r);
+
+// Copies the next _size_ bytes of the stream to _dest_. Returns how many were copied, less than _size_ only at the end.
+inline s64 decompress_reader_read(decompress_reader &r, byte *dest, s64 size) {
+    s64 copied = 0;
+    while (copied < size) {
+        if (!r.Current && !decompress_reader_next(r)) break;
+
+        s64 n = min(size - copied, r.Current.Count);
+        copy_memory(dest + copied, r.Current.Data, n);
+        copied += n;
+
+        r.Current.Data += n;
+        r.Current.Count -= n;
+    }
+    return copied;
+}
+
+void free(decompress_reader &r);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,112 @@
+#include "date_time.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// "YYYY-MM-DDTHH:MM:SS" of the last second formatted on this thread
+struct date_time_format_cache {
+    s64 Second = S64_MIN;  // Local seconds since the epoch (UTC + offset)
+    utf8 Prefix[24];
+    s64 PrefixSize = 0;
+};
+
+file_scope thread_local date_time_format_cache FormatCache;
+
+file_scope always_inline utf8 *write_2_digits(utf8 *out, s32 v) {
+    out[0] = (utf8) ('0' + v / 10);
+    out[1] = (utf8) ('0' + v % 10);
+    return out + 2;
+}
+
+// The date and the time of day without the fraction
+file_scope s64 write_date_and_time(utf8 *out, const date_time &t) {
+    utf8 *p = out;
+
+    // ISO 8601 allows more digits (and a sign) for years outside 0 - 9999
+    s32 year = t.Year;
+    if (year < 0) {
+        *p++ = '-';
+        year = -year;
+    }
+    if (year > 9999) {
+        utf8 digits[10];
+        s64 n = 0;
+        while (year) {
+            digits[n++] = (utf8) ('0' + year % 10);
+            year /= 10;
+        }
+        while (n) *p++ = digits[--n];
+    } else {
+        p = write_2_digits(p, year / 100);
+        p = write_2_digits(p, year % 100);
+    }
+
+    *p++ = '-';
+    p = write_2_digits(p, t.Month);
+    *p++ = '-';
+    p = write_2_digits(p, t.Day);
+    *p++ = 'T';
+    p = write_2_digits(p, t.Hour);
+    *p++ = ':';
+    p = write_2_digits(p, t.Minute);
+    *p++ = ':';
+    p = write_2_digits(p, t.Second);
+    return p - out;
+}
+
+// ".nnn" and "Z" or "+HH:MM"
+file_scope s64 write_fraction_and_offset(utf8 *out, s32 nanosecond, s32 utcOffset, s32 fractionDigits) {
+    utf8 *p = out;
+
+    if (fractionDigits > 0) {
+        if (fractionDigits > 9) fractionDigits = 9;
+
+        u32 v = (u32) nanosecond;
+        For(range(9 - fractionDigits)) v /= 10;
+
+        *p++ = '.';
+        for (s32 i = fractionDigits; i > 0; --i) {
+            p[i - 1] = (utf8) ('0' + v % 10);
+            v /= 10;
+        }
+        p += fractionDigits;
+    }
+
+    if (!utcOffset) {
+        *p++ = 'Z';
+    } else {
+        *p++ = utcOffset < 0 ? '-' : '+';
+
+        s32 minutes = (utcOffset < 0 ? -utcOffset : utcOffset) / 60;
+        p = write_2_digits(p, minutes / 60);
+        *p++ = ':';
+        p = write_2_digits(p, minutes % 60);
+    }
+    return p - out;
+}
+
+s64 date_time_format_iso8601(utf8 *out, const date_time &t, s32 fractionDigits) {
+    s64 n = write_date_and_time(out, t);
+    return n + write_fraction_and_offset(out + n, t.Nanosecond, t.UTCOffset, fractionDigits);
+}
+
+s64 date_time_format_iso8601(utf8 *out, s64 unixNs, s32 utcOffset, s32 fractionDigits) {
+    s64 second = unixNs / NANOSECONDS_PER_SECOND;
+    s64 nanosecond = unixNs % NANOSECONDS_PER_SECOND;
+    if (nanosecond < 0) {
+        nanosecond += NANOSECONDS_PER_SECOND;
+        --second;
+    }
+
+    // The prefix only depends on the local time, so that's the key
+    auto &cache = FormatCache;
+    if (cache.Second != second + utcOffset) {
+        date_time t = date_time_from_unix_ns(second * NANOSECONDS_PER_SECOND, utcOffset);
+        cache.PrefixSize = write_date_and_time(cache.Prefix, t);
+        cache.Second = second + utcOffset;
+    }
+
+    copy_memory(out, cache.Prefix, cache.PrefixSize);
+    return cache.PrefixSize + write_fraction_and_offset(out + cache.PrefixSize, (s32) nanosecond, utcOffset, fractionDigits);
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "internal/common.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Calendar time: breaking a point in time (nanoseconds since the Unix epoch, see os_get_wall_time_ns() in os.clock)
+// into a date and a time of day, and formatting it as ISO 8601.
+//
+//     date_time now = os_get_local_date_time();
+//     print("{}\n", now);       // 2026-10-14T09:30:05.123+02:00
+//     print("{:.6}\n", now);    // 2026-10-14T09:30:05.123456+02:00
+//
+//     // In a logger, straight from the wall clock
+//     utf8 stamp[DATE_TIME_ISO8601_MAX_SIZE];
+//     s64 n = date_time_format_iso8601(stamp, os_get_wall_time_ns(), utcOffset);
+//
+// Days are converted to a date with the algorithm of Neri and Schneider ("Euclidean affine functions and their
+// application to calendar algorithms", 2022) - a few multiplications and shifts, no loops and no tables,
+// the proleptic Gregorian calendar within about ±30000 years of 1970.
+//
+// date_time_format_iso8601() on timestamps keeps the text of the last second it formatted per thread,
+// so lines which are logged within the same second only write the fraction and the offset.
+//
+
+constexpr s64 NANOSECONDS_PER_SECOND = 1000000000;
+constexpr s64 SECONDS_PER_DAY = 86400;
+
+// "-YYYYY-MM-DDTHH:MM:SS.nnnnnnnnn+HH:MM", the longest date_time_format_iso8601() writes
+constexpr s64 DATE_TIME_ISO8601_MAX_SIZE = 40;
+
+struct civil_date {
+    s32 Year;
+    s32 Month;  // 1 - 12
+    s32 Day;    // 1 - 31
+};
+
+namespace internal {
+// The calendar is shifted by this many 400 year eras so the days we work with are never negative
+constexpr u32 CIVIL_ERA_SHIFT = 82;
+constexpr u32 CIVIL_DAY_SHIFT = 719468 + 146097 * CIVIL_ERA_SHIFT;  // Also moves the start of the year to March
+constexpr u32 CIVIL_YEAR_SHIFT = 400 * CIVIL_ERA_SHIFT;
+}  // namespace internal
+
+// _days_ since 1970-01-01
+constexpr civil_date civil_from_days(s64 days) {
+    assert(days > -(s64) internal::CIVIL_DAY_SHIFT && days < (s64) U32_MAX / 4 - internal::CIVIL_DAY_SHIFT && "Date is out of range");
+
+    u32 n = (u32) (days + internal::CIVIL_DAY_SHIFT);
+
+    // Centuries, then years in the century, then the day of the year (which starts in March)
+    u32 n1 = 4 * n + 3;
+    u32 century = n1 / 146097;
+    u32 n2 = n1 % 146097 | 3;
+    u64 p2 = (u64) 2939745 * n2;
+    u32 yearOfCentury = (u32) (p2 >> 32);
+    u32 dayOfYear = (u32) p2 / 2939745 / 4;
+
+    // Month and day from the day of the year (months from March are 30.6 days alternating)
+    u32 n3 = 2141 * dayOfYear + 197913;
+    u32 month = n3 >> 16;
+    u32 day = (n3 & 0xFFFF) / 2141;
+
+    bool janOrFeb = dayOfYear >= 306;
+    s32 year = (s32) (100 * century + yearOfCentury) - (s32) internal::CIVIL_YEAR_SHIFT + janOrFeb;
+    return {year, (s32) (janOrFeb ? month - 12 : month), (s32) day + 1};
+}
+
+// Days since 1970-01-01 of a date (the inverse of civil_from_days)
+constexpr s64 days_from_civil(s32 year, s32 month, s32 day) {
+    bool janOrFeb = month <= 2;
+
+    u32 y = (u32) (year + (s32) internal::CIVIL_YEAR_SHIFT) - janOrFeb;
+    u32 m = janOrFeb ? month + 12 : month;
+
+    u32 century = y / 100;
+    u32 yearDays = 1461 * y / 4 - century + century / 4;
+    u32 monthDays = (979 * m - 2919) / 32;
+    return (s64) (yearDays + monthDays + (u32) day - 1) - internal::CIVIL_DAY_SHIFT;
+}
+
+// 0 is Sunday
+constexpr s32 weekday_from_days(s64 days) {
+    s64 w = (days + 4) % 7;  // 1970-01-01 was a Thursday
+    return (s32) (w < 0 ? w + 7 : w);
+}
+
+constexpr bool is_leap_year(s32 year) { return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0); }
+
+struct date_time {
+    s32 Year = 1970;
+    s32 Month = 1, Day = 1;
+    s32 Hour = 0, Minute = 0, Second = 0;
+    s32 Nanosecond = 0;
+
+    s32 Weekday = 4;  // 0 is Sunday
+
+    // Local time is UTC + this many seconds, 0 for UTC
+    s32 UTCOffset = 0;
+};
+
+// Breaks _unixNs_ (nanoseconds since 1970-01-01 00:00:00 UTC) into the calendar at _utcOffset_ seconds from UTC
+constexpr date_time date_time_from_unix_ns(s64 unixNs, s32 utcOffset = 0) {
+    s64 seconds = unixNs / NANOSECONDS_PER_SECOND;
+    s64 nanoseconds = unixNs % NANOSECONDS_PER_SECOND;
+    if (nanoseconds < 0) {
+        nanoseconds += NANOSECONDS_PER_SECOND;
+        --seconds;
+    }
+    seconds += utcOffset;
+
+    s64 days = seconds / SECONDS_PER_DAY;
+    s64 secondOfDay = seconds % SECONDS_PER_DAY;
+    if (secondOfDay < 0) {
+        secondOfDay += SECONDS_PER_DAY;
+        --days;
+    }
+
+    civil_date date = civil_from_days(days);
+
+    date_time result;
+    result.Year = date.Year;
+    result.Month = date.Month;
+    result.Day = date.Day;
+    result.Hour = (s32) (secondOfDay / 3600);
+    result.Minute = (s32) (secondOfDay / 60 % 60);
+    result.Second = (s32) (secondOfDay % 60);
+    result.Nanosecond = (s32) nanoseconds;
+    result.Weekday = weekday_from_days(days);
+    result.UTCOffset = utcOffset;
+    return result;
+}
+
+// The point in time _t_ is, in nanoseconds since the Unix epoch (_Weekday_ is ignored)
+constexpr s64 date_time_to_unix_ns(const date_time &t) {
+    s64 seconds = days_from_civil(t.Year, t.Month, t.Day) * SECONDS_PER_DAY + t.Hour * 3600 + t.Minute * 60 + t.Second - t.UTCOffset;
+    return seconds * NANOSECONDS_PER_SECOND + t.Nanosecond;
+}
+
+// Writes _t_ as ISO 8601 ("2026-10-14T09:30:05.123Z", or ending in "+02:00" if it has an offset) to _out_,
+// which has room for DATE_TIME_ISO8601_MAX_SIZE. _fractionDigits_ is 0 - 9. Returns the number of bytes written.
+s64 date_time_format_iso8601(utf8 *out, const date_time &t, s32 fractionDigits = 3);
+
+// The same for a timestamp, with the per thread cache of the last second (see the top of the file)
+s64 date_time_format_iso8601(utf8 *out, s64 unixNs, s32 utcOffset = 0, s32 fractionDigits = 3);
+
+LSTD_END_NAMESPACE
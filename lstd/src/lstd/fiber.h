@@ -0,0 +1,54 @@
+#pragma once
+
+#include "memory/delegate.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Fibers: execution contexts (a stack and registers) which you switch between by hand, on one thread.
+// Switching is a function call which saves the callee-saved registers and swaps the stack pointer - no kernel,
+// no scheduler. The job system uses them so a job waiting on a counter can be put aside while the worker runs others.
+//
+//     fiber main, other;
+//     fiber_convert_thread(&main);  // The thread itself becomes a fiber, so there is something to switch back to
+//     fiber_create(&other, run, &other);
+//
+//     fiber_switch(&main, &other);  // Runs _run_ until it switches back to _main_
+//
+// On Windows these are the OS fibers (CreateFiber/SwitchToFiber). On Linux x86-64 it's a small assembly switch,
+// elsewhere ucontext.
+//
+// A fiber can be resumed on a different thread than the one it was suspended on. Thread locals (including Context)
+// are then the new thread's - don't hold pointers to thread local data across a switch.
+//
+struct fiber {
+    void *Handle = null;  // The Win32 fiber, or where the stack pointer (or ucontext) is saved
+
+    // The stack we reserved (not used on Windows, where the OS allocates it)
+    void *Stack   = null;
+    s64 StackSize = 0;
+
+    // Runs when the fiber is first switched to. It must not return - switch to another fiber when done.
+    delegate<void(void *)> Function;
+    void *UserData = null;
+
+    bool IsThread = false;  // Made by fiber_convert_thread
+};
+
+// Turns the calling thread into a fiber, needed before it can switch to other fibers.
+void fiber_convert_thread(fiber *f);
+
+// Undoes fiber_convert_thread, call on the same thread while it is running _f_.
+void fiber_revert_thread(fiber *f);
+
+// Creates a fiber which will run _function(userData)_. The stack is reserved up front and committed by the
+// OS as it's used (with a guard page at the end). Returns false if that fails.
+bool fiber_create(fiber *f, const delegate<void(void *)> &function, void *userData = null, s64 stackSize = 256_KiB);
+
+// Frees the stack. Don't release the fiber which is running.
+void fiber_release(fiber *f);
+
+// Saves the state of the running fiber _from_ and continues _to_ where it left off (or starts it).
+void fiber_switch(fiber *from, fiber *to);
+
+LSTD_END_NAMESPACE
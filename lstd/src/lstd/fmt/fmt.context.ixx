@@ -1,7 +1,12 @@
 module;
 
+#include "../base64.h"
 #include "../io.h"
 
+#if ARCH == X86
+#include <emmintrin.h>
+#endif
+
 export module fmt.context;
 
 import fmt.arg;
@@ -79,6 +84,71 @@ export {
     inline void write_no_specs(fmt_context * f, const utf8 *str, s64 size) { write(f->Out, (const byte *) str, size); }
     inline void write_no_specs(fmt_context * f, utf32 cp) { write(f->Out, cp); }
 
+    // Writes two hex digits per byte ("deadbeef"). This is what "{:x}" on bytes does - much faster than "{:02x}" per byte.
+    void write_hex_bytes(fmt_context * f, const byte *data, s64 count, bool upper = false);
+
+    // Writes lines of 16 bytes like xxd does ("{:#x}" on bytes) - the offset, hex in groups of two bytes and the printable ASCII:
+    //     00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a       Hello, world!.
+    // The offset has 8 digits, past 4 GiB it wraps around.
+    void write_hex_dump(fmt_context * f, const byte *data, s64 count, bool upper = false);
+
+    // Collects what is written to the context and passes it on to the real output in pieces of FMT_CHUNK_SIZE.
+    // Lists (write_list, format_list) write lots of small pieces - a number, a separator, a number... -
+    // and every one of them would otherwise be a virtual call to the output (which may take a lock, or be a console).
+    //
+    // Swaps itself in as _f->Out_ until it goes out of scope.
+    constexpr s64 FMT_CHUNK_SIZE = 4_KiB;
+
+    struct fmt_chunk_writer : writer {
+        fmt_context *F;
+        writer *Out;  // Where _F_ was writing to before
+
+        utf8 Buffer[FMT_CHUNK_SIZE];
+        s64 Used = 0;
+
+        fmt_chunk_writer(fmt_context *f) : F(f), Out(f->Out) { f->Out = this; }
+
+        // Same as the destructors of format_list & co., this is for conciseness.
+        ~fmt_chunk_writer() {
+            flush_chunk();
+            F->Out = Out;
+        }
+
+        void write(const byte *data, s64 count) override {
+            if (Used + count > FMT_CHUNK_SIZE) {
+                flush_chunk();
+                if (count > FMT_CHUNK_SIZE) {
+                    Out->write(data, count);
+                    return;
+                }
+            }
+            copy_memory(Buffer + Used, data, count);
+            Used += count;
+        }
+
+        void flush() override {
+            flush_chunk();
+            Out->flush();
+        }
+
+        void flush_chunk() {
+            if (Used) Out->write((const byte *) Buffer, Used);
+            Used = 0;
+        }
+    };
+
+    // The element types write_list() has a direct path for
+    template <typename T>
+    concept fmt_list_scalar = (types::is_integral<T> && !types::is_same<T, bool>) || types::is_floating_point<T> || types::is_same<T, string>;
+
+    // Writes _count_ values with _separator_ between them, each one with the current specs (like every element
+    // of a format_list, but without collecting fmt_args first). Everything goes through one fmt_chunk_writer,
+    // and integers without specs are formatted right into its buffer.
+    //
+    //     write_list(f, samples.Data, samples.Count, ",");  // A CSV row
+    template <fmt_list_scalar T>
+    void write_list(fmt_context * f, const T *values, s64 count, const string &separator = ", ");
+
     struct format_struct_helper;
     struct format_tuple_helper;
     struct format_list_helper;
@@ -189,6 +259,7 @@ export {
         void operator()(s64 value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
         void operator()(u64 value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
         void operator()(bool value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
+        void operator()(f32 value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
         void operator()(f64 value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
         void operator()(const string &value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
         void operator()(const void *value) { NoSpecs ? write_no_specs(F, value) : write(F, value); }
@@ -206,6 +277,9 @@ export {
 // Note: This is not exported, instead use one of the overloads of the general write() function.
 void write_u64(fmt_context *f, u64 value, bool negative, fmt_specs specs);
 
+// Writes an integer without specs (the common case) - one write to the output, without the padding machinery of write_u64.
+void write_u64_no_specs(fmt_context *f, u64 value, bool negative);
+
 // Writes a float with given formatting specs.
 // Note: This is not exported, instead use one of the overloads of the general write() function.
 void write_float(fmt_context *f, types::is_floating_point auto value, fmt_specs specs);
@@ -222,15 +296,15 @@ void write(fmt_context *f, types::is_integral auto value) {
     if (f->Specs) {
         write_u64(f, absValue, negative, *f->Specs);
     } else {
-        write_u64(f, absValue, negative, {});
+        write_u64_no_specs(f, absValue, negative);
     }
 }
 
 void write(fmt_context *f, types::is_floating_point auto value) {
     if (f->Specs) {
-        write_float(f, (f64) value, *f->Specs);
+        write_float(f, value, *f->Specs);
     } else {
-        write_float(f, (f64) value, {});
+        write_float(f, value, {});
     }
 }
 
@@ -238,11 +312,11 @@ void write_no_specs(fmt_context *f, types::is_integral auto value) {
     u64 absValue  = (u64) value;
     bool negative = sign_bit(value);
     if (negative) absValue = 0 - absValue;
-    write_u64(f, absValue, negative, {});
+    write_u64_no_specs(f, absValue, negative);
 }
 
 void write_no_specs(fmt_context *f, types::is_floating_point auto value) {
-    write_float(f, (f64) value, {});
+    write_float(f, value, {});
 }
 
 inline void write_no_specs(fmt_context *f, bool value) { write_no_specs(f, value ? 1 : 0); }
@@ -299,6 +373,8 @@ void format_tuple<FC>::finish() {
 
 template <typename FC>
 void format_list<FC>::finish() {
+    fmt_chunk_writer chunk(F);
+
     write_no_specs(F, "[");
 
     auto *p = Fields.begin();
@@ -314,6 +390,44 @@ void format_list<FC>::finish() {
     write_no_specs(F, "]");
 }
 
+template <typename UInt>
+utf8 *format_uint_decimal(utf8 *buffer, UInt value, s64 formattedSize);
+
+template <fmt_list_scalar T>
+void write_list(fmt_context *f, const T *values, s64 count, const string &separator) {
+    if (count <= 0) return;
+
+    fmt_chunk_writer chunk(f);
+
+    if constexpr (types::is_integral<T>) {
+        if (!f->Specs) {
+            constexpr s64 MAX_SIZE = numeric_info<u64>::digits10 + 2;  // 20 digits and a sign
+
+            For(range(count)) {
+                if (it) chunk.write((const byte *) separator.Data, separator.Count);
+                if (chunk.Used + MAX_SIZE > FMT_CHUNK_SIZE) chunk.flush_chunk();
+
+                u64 absValue = (u64) values[it];
+                bool negative = sign_bit(values[it]);
+                if (negative) absValue = 0 - absValue;
+
+                utf8 *p = chunk.Buffer + chunk.Used;
+                if (negative) *p++ = '-';
+
+                u32 numDigits = count_digits(absValue);
+                format_uint_decimal(p, absValue, numDigits);
+                chunk.Used = p + numDigits - chunk.Buffer;
+            }
+            return;
+        }
+    }
+
+    For(range(count)) {
+        if (it) write_no_specs(f, separator);
+        write(f, values[it]);
+    }
+}
+
 utf8 DIGITS[] =
     "0001020304050607080910111213141516171819"
     "2021222324252627282930313233343536373839"
@@ -321,8 +435,150 @@ utf8 DIGITS[] =
     "6061626364656667686970717273747576777879"
     "8081828384858687888990919293949596979899";
 
+#if ARCH == X86
+// Returns the 8 decimal digits of _value_ (< 10^8, with leading zeros), one in each 16 bit lane, most significant first.
+// Two divisions split it in halves of 4 digits, then each lane gets divided by a different power of ten
+// with a multiply-high. This is the SSE2 itoa by Wojciech Mula (also used in RapidJSON's benchmarks).
+always_inline __m128i decimal_digits_8_sse2(u32 value) {
+    alignas(16) static const u16 DIV_POWERS[8]   = {8389, 5243, 13108, 32768, 8389, 5243, 13108, 32768};
+    alignas(16) static const u16 SHIFT_POWERS[8] = {1 << (16 - (23 + 2 - 16)), 1 << (16 - (19 + 2 - 16)), 1 << (16 - 1 - 2), 1 << 15,
+                                                    1 << (16 - (23 + 2 - 16)), 1 << (16 - (19 + 2 - 16)), 1 << (16 - 1 - 2), 1 << 15};
+
+    // abcd, efgh = abcdefgh divmod 10000
+    __m128i abcdefgh = _mm_cvtsi32_si128((s32) value);
+    __m128i abcd     = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, _mm_set1_epi32((s32) 0xD1B71759)), 45);
+    __m128i efgh     = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+
+    // [abcd * 4, abcd * 4, abcd * 4, abcd * 4, efgh * 4, efgh * 4, efgh * 4, efgh * 4]
+    __m128i v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+    __m128i v2 = _mm_unpacklo_epi32(_mm_unpacklo_epi16(v1, v1), _mm_unpacklo_epi16(v1, v1));
+
+    // [a, ab, abc, abcd, e, ef, efg, efgh]
+    __m128i v3 = _mm_mulhi_epu16(v2, _mm_load_si128((const __m128i *) DIV_POWERS));
+    __m128i v4 = _mm_mulhi_epu16(v3, _mm_load_si128((const __m128i *) SHIFT_POWERS));
+
+    // Subtract ten times the previous lane: [a, b, c, d, e, f, g, h]
+    __m128i v5 = _mm_mullo_epi16(v4, _mm_set1_epi16(10));
+    return _mm_sub_epi16(v4, _mm_slli_epi64(v5, 16));
+}
+#endif
+
+void write_hex_bytes(fmt_context *f, const byte *data, s64 count, bool upper) {
+    utf8 buffer[1_KiB];
+    while (count) {
+        s64 n = min<s64>(count, sizeof(buffer) / 2);
+        hex_encode(buffer, data, n, upper);
+        write_no_specs(f, buffer, 2 * n);
+
+        data += n, count -= n;
+    }
+}
+
+void write_hex_dump(fmt_context *f, const byte *data, s64 count, bool upper) {
+    constexpr s64 LINE_SIZE = 10 + 39 + 2 + 16 + 1;  // "00000000: ", 8 groups of 4 digits with spaces between, "  ", ASCII, "\n"
+
+    utf8 buffer[LINE_SIZE * 16];
+    s64 used = 0;
+
+    for (s64 offset = 0; offset < count; offset += 16) {
+        s64 n = min<s64>(16, count - offset);
+
+        utf8 *line = buffer + used;
+
+        u32 o               = (u32) offset;
+        byte offsetBytes[4] = {(byte) (o >> 24), (byte) (o >> 16), (byte) (o >> 8), (byte) o};
+        hex_encode(line, offsetBytes, 4, upper);
+        line[8] = ':';
+        line[9] = ' ';
+
+        utf8 hex[32];
+        hex_encode(hex, data + offset, n, upper);
+
+        // Short last line gets spaces instead of digits, so the ASCII column stays aligned
+        utf8 *p = line + 10;
+        For(range(16)) {
+            if (it < n) {
+                *p++ = hex[2 * it];
+                *p++ = hex[2 * it + 1];
+            } else {
+                *p++ = ' ';
+                *p++ = ' ';
+            }
+            if (it % 2 && it != 15) *p++ = ' ';
+        }
+        *p++ = ' ';
+        *p++ = ' ';
+
+        For(range(n)) {
+            byte b = data[offset + it];
+            *p++   = b >= 0x20 && b < 0x7f ? (utf8) b : '.';
+        }
+        *p++ = '\n';
+
+        used += p - line;
+        if (used > (s64) sizeof(buffer) - LINE_SIZE) {
+            write_no_specs(f, buffer, used);
+            used = 0;
+        }
+    }
+    if (used) write_no_specs(f, buffer, used);
+}
+
+// Writes the _formattedSize_ decimal digits of _value_ at _buffer_ (backwards, from the end), returns where they start.
+// Large 64 bit values do 8 or 16 digits at once with SSE2, the rest goes two digits per step through DIGITS.
 template <typename UInt>
-utf8 *format_uint_decimal(utf8 *buffer, UInt value, s64 formattedSize, const string &thousandsSep = "") {
+utf8 *format_uint_decimal(utf8 *buffer, UInt value, s64 formattedSize) {
+    buffer += formattedSize;
+
+#if ARCH == X86
+    if constexpr (sizeof(UInt) == 8) {
+        // There are at least 9 digits here so the stores stay inside the output
+        if (value >= 10000000000000000ull) {
+            u64 low = value % 10000000000000000ull;
+            value /= 10000000000000000ull;
+
+            __m128i high8 = decimal_digits_8_sse2((u32) (low / 100000000));
+            __m128i low8  = decimal_digits_8_sse2((u32) (low % 100000000));
+            __m128i ascii = _mm_add_epi8(_mm_packus_epi16(high8, low8), _mm_set1_epi8('0'));
+
+            buffer -= 16;
+            _mm_storeu_si128((__m128i *) buffer, ascii);
+        } else if (value >= 100000000) {
+            __m128i low8  = decimal_digits_8_sse2((u32) (value % 100000000));
+            __m128i ascii = _mm_add_epi8(_mm_packus_epi16(low8, _mm_setzero_si128()), _mm_set1_epi8('0'));
+            value /= 100000000;
+
+            buffer -= 8;
+            _mm_storel_epi64((__m128i *) buffer, ascii);
+        }
+    }
+#endif
+
+    while (value >= 100) {
+        u32 index = (u32) (value % 100) * 2;
+        value /= 100;
+
+        buffer -= 2;
+        buffer[0] = DIGITS[index];
+        buffer[1] = DIGITS[index + 1];
+    }
+
+    if (value < 10) {
+        *--buffer = (utf8) ('0' + value);
+        return buffer;
+    }
+
+    u32 index = (u32) value * 2;
+    buffer -= 2;
+    buffer[0] = DIGITS[index];
+    buffer[1] = DIGITS[index + 1];
+    return buffer;
+}
+
+// Same as format_uint_decimal but puts _thousandsSep_ between groups of 3 digits,
+// _formattedSize_ must include the separators.
+template <typename UInt>
+utf8 *format_uint_decimal_separated(utf8 *buffer, UInt value, s64 formattedSize, const string &thousandsSep) {
     u32 digitIndex = 0;
 
     buffer += formattedSize;
@@ -357,9 +613,37 @@ utf8 *format_uint_decimal(utf8 *buffer, UInt value, s64 formattedSize, const str
     return buffer;
 }
 
+// Writes the _formattedSize_ digits of _value_ in base 2^BASE_BITS at _buffer_ (backwards), returns where they start.
 template <u32 BASE_BITS, typename UInt>
 utf8 *format_uint_base(utf8 *buffer, UInt value, s64 formattedSize, bool upper = false) {
     buffer += formattedSize;
+
+    if constexpr (BASE_BITS == 4) {
+        const utf8 *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+        // A byte (two digits) per step
+        while (value >= 0x100) {
+            u32 b = (u32) (value & 0xFF);
+            value >>= 8;
+
+            buffer -= 2;
+            buffer[0] = digits[b >> 4];
+            buffer[1] = digits[b & 0xF];
+        }
+    } else if constexpr (BASE_BITS == 1) {
+        // A byte (eight digits) per step. The multiplication puts bit (7 - i) of the byte in the lowest bit of byte i,
+        // so in memory (little-endian) the most significant bit comes first, like we print it.
+        while (value >= 0x100) {
+            u64 b    = (u64) (value & 0xFF);
+            u64 bits = ((b * 0x8040201008040201ull) >> 7) & 0x0101010101010101ull;
+            value >>= 8;
+
+            bits |= 0x3030303030303030ull;  // '0' or '1'
+            buffer -= 8;
+            copy_memory(buffer, &bits, 8);
+        }
+    }
+
     do {
         const utf8 *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
         u32 digit          = (value & ((1 << BASE_BITS) - 1));
@@ -368,22 +652,50 @@ utf8 *format_uint_base(utf8 *buffer, UInt value, s64 formattedSize, bool upper =
     return buffer;
 }
 
+// Writes _cp_ _count_ times. Padding and zeroes used to cost a virtual call per code point,
+// now it's one write_vectored() with every span pointing to the same small run of copies.
+void write_fill(fmt_context *f, utf32 cp, s64 count) {
+    if (count <= 0) return;
+    if (count == 1) {
+        write_no_specs(f, cp);
+        return;
+    }
+
+    utf8 run[64];
+    encode_cp(run, cp);
+    s64 cpSize = get_size_of_cp(run);
+
+    s64 perRun = min<s64>(count, sizeof(run) / cpSize);
+    for (s64 i = 1; i < perRun; ++i) copy_memory(run + i * cpSize, run, cpSize);
+
+    bytes spans[16];
+    while (count) {
+        s64 n = 0;
+        while (count && n < 16) {
+            s64 k      = min(count, perRun);
+            spans[n++] = bytes((byte *) run, k * cpSize);
+            count -= k;
+        }
+        write_vectored(f->Out, spans, n);
+    }
+}
+
 // Writes pad code points and the actual contents with f(),
 // _fSize_ needs to be the size of the output from _f_ in code points (in order to calculate padding properly)
 template <typename F>
 void write_padded_helper(fmt_context *f, const fmt_specs &specs, F &&func, s64 fSize) {
     u32 padding = (u32)(specs.Width > fSize ? specs.Width - fSize : 0);
     if (specs.Align == fmt_alignment::RIGHT) {
-        For(range(padding)) write_no_specs(f, specs.Fill);
+        write_fill(f, specs.Fill, padding);
         func();
     } else if (specs.Align == fmt_alignment::CENTER) {
         u32 leftPadding = padding / 2;
-        For(range(leftPadding)) write_no_specs(f, specs.Fill);
+        write_fill(f, specs.Fill, leftPadding);
         func();
-        For(range(padding - leftPadding)) write_no_specs(f, specs.Fill);
+        write_fill(f, specs.Fill, padding - leftPadding);
     } else {
         func();
-        For(range(padding)) write_no_specs(f, specs.Fill);
+        write_fill(f, specs.Fill, padding);
     }
 }
 
@@ -455,6 +767,16 @@ void write(fmt_context *f, const void *value) {
     write_padded_helper(f, specs, func, numDigits + 2);
 }
 
+void write_u64_no_specs(fmt_context *f, u64 value, bool negative) {
+    utf8 buffer[numeric_info<u64>::digits10 + 2];  // 20 digits and a sign
+
+    u32 numDigits = count_digits(value);
+    utf8 *p = format_uint_decimal(buffer + 1, value, numDigits);
+    if (negative) *--p = '-';
+
+    write_no_specs(f, p, buffer + 1 + numDigits - p);
+}
+
 void write_u64(fmt_context *f, u64 value, bool negative, fmt_specs specs) {
     utf8 type = specs.Type;
     if (!type) type = 'd';
@@ -520,7 +842,7 @@ void write_u64(fmt_context *f, u64 value, bool negative, fmt_specs specs) {
     }
     if (specs.Align == fmt_alignment::NONE) specs.Align = fmt_alignment::RIGHT;
 
-    utf8 U64_FORMAT_BUFFER[numeric_info<u64>::digits + 1]{};
+    utf8 U64_FORMAT_BUFFER[numeric_info<u64>::digits + 1];
 
     if (type == 'n') {
         formattedSize += ((numDigits - 1) / 3);
@@ -530,7 +852,7 @@ void write_u64(fmt_context *f, u64 value, bool negative, fmt_specs specs) {
     write_padded_helper(
         f, specs, [&]() {
             if (prefix.Length) write_no_specs(f, prefix);
-            For(range(padding)) write_no_specs(f, specs.Fill);
+            write_fill(f, specs.Fill, padding);
 
             utf8 *p = null;
             if (type == 'd') {
@@ -543,7 +865,7 @@ void write_u64(fmt_context *f, u64 value, bool negative, fmt_specs specs) {
                 p = format_uint_base<4>(U64_FORMAT_BUFFER, value, numDigits, is_upper(specs.Type));
             } else if (type == 'n') {
                 numDigits = formattedSize;  // To include extra chars (like commas)
-                p         = format_uint_decimal(U64_FORMAT_BUFFER, value, formattedSize, "," /*@Locale*/);
+                p         = format_uint_decimal_separated(U64_FORMAT_BUFFER, value, formattedSize, "," /*@Locale*/);
             } else {
                 assert(false && "Invalid type");  // sanity
             }
@@ -622,7 +944,7 @@ void write_float_exp(fmt_context *f, const string &significand, s32 decimalExp,
             // Write significand, then the zeroes (if required by the precision), then the exp char and then the exponent itself
             // e.g. 1.23400e+5
             write_significand(f, significand, 1, decimalPoint);
-            For(range(numZeros)) write_no_specs(f, U'0');
+            write_fill(f, U'0', numZeros);
             write_no_specs(f, expChar);
             write_exponent(f, exp);
         },
@@ -666,12 +988,12 @@ void write_float_fixed(fmt_context *f, const string &significand, s32 decimalExp
                 if (sign) write_no_specs(f, sign);
 
                 write_significand(f, significand, significand.Count);  // Write the whole significand, without putting the dot anywhere
-                For(range(decimalExp)) write_no_specs(f, U'0');        // Add any needed zeroes to match the magnitude
+                write_fill(f, U'0', decimalExp);                       // Add any needed zeroes to match the magnitude
 
                 // Add the decimal point if needed
                 if (floatSpecs.ShowPoint) {
                     write_no_specs(f, decimalPoint);
-                    For(range(numZeros)) write_no_specs(f, U'0');
+                    write_fill(f, U'0', numZeros);
                 }
                 if (percentage) write_no_specs(f, U'%');
             },
@@ -694,7 +1016,7 @@ void write_float_fixed(fmt_context *f, const string &significand, s32 decimalExp
 
                     // Write the significand, then write any zeroes if needed (for the precision)
                     write_significand(f, significand, decimalPointPos, decimalPoint);
-                    For(range(numZeros)) write_no_specs(f, U'0');
+                    write_fill(f, U'0', numZeros);
                     if (percentage) write_no_specs(f, U'%');
                 },
                 outputSize);
@@ -721,7 +1043,7 @@ void write_float_fixed(fmt_context *f, const string &significand, s32 decimalExp
                     if (pointy) {
                         // Write the decimal point + the zeros + the significand
                         write_no_specs(f, decimalPoint);
-                        For(range(numZeros)) write_no_specs(f, U'0');
+                        write_fill(f, U'0', numZeros);
 
                         write_significand(f, significand, significand.Count);
                     }
@@ -734,6 +1056,15 @@ void write_float_fixed(fmt_context *f, const string &significand, s32 decimalExp
 
 // Writes a float with given formatting specs
 void write_float(fmt_context *f, types::is_floating_point auto value, fmt_specs specs) {
+    // f32 stays f32 so "{}" gives the shortest representation of the f32 (0.1f is "0.1" and not "0.10000000149011612").
+    // '%' goes through f64 though, multiplying by 100 in f32 would lose precision.
+    if constexpr (types::is_same<decltype(value), f32>) {
+        if (specs.Type == '%') {
+            write_float(f, (f64) value, specs);
+            return;
+        }
+    }
+
     fmt_float_specs floatSpecs = fmt_parse_float_specs(&f->Parse, specs);
 
     //
@@ -21,7 +21,7 @@ constexpr u128 POW10_SIGNIFICANDS_128[] = {{0xff77b1fcbebcdc4f, 0x25e8e89c13bb0f
 constexpr u64 LOG10_2_SIGNIFICAND = 0x4d104d427de7fbcc;
 
 // Computes 128-bit result of multiplication of two 64-bit unsigned integers.
-always_inline u128 umul128(u64 x, u64 y) { return (u128) x * (u128) y; }
+always_inline u128 umul128(u64 x, u64 y) { return mul128(x, y); }
 
 // Computes upper 64 bits of multiplication of two 64-bit unsigned integers.
 always_inline u64 umul128_upper64(u64 x, u64 y) { return umul128(x, y).hi; }
@@ -4,19 +4,199 @@ module;
 
 export module fmt.format_float.fallback;
 
-import fmt.format_float.specs;
-
-import lstd.big_integer;
-
 //
-// Formats value using a variation of the Fixed-Precision Positive
-// Floating-Point Printout ((FPP)^2) algorithm by Steele & White:
-// https://fmt.dev/papers/p372-steele.pdf.
+// Exact digit generation, used when Grisu can't decide which way to round (exact ties like "{:.2f}" with 0.125,
+// or more digits than its 64-bit error bound allows).
+//
+// A double is m * 2^e with a 53 bit m, so it splits exactly into an integral part (at most 1024 bits) and a
+// fractional part (at most 1074 bits). We keep both in u32 limbs on the stack, print the integral part by
+// dividing by 10^9 and produce fractional digits by multiplying by 10. No allocations and no big_integer.
 //
 
 LSTD_BEGIN_NAMESPACE
 
-// export s32 steele_white_format_float(string_builder &builder, f64 value, s32 exp, s32 precision, bool binary32) {
-// }
+constexpr s32 EXACT_MAX_LIMBS = 36;  // 1074 fractional bits (rounded up to a whole limb) in 34, 1024 integral bits in 32
+
+struct exact_digit_stream {
+    // Decimal digits of the integral part, most significant first, in [IntegralIndex, IntegralEnd)
+    utf8 Integral[320];
+    s32 IntegralIndex = 0;
+    s32 IntegralEnd   = 0;
+
+    // The fractional part as a fixed point number with 32 * FractionCount bits after the point, least significant limb first
+    u32 Fraction[EXACT_MAX_LIMBS];
+    s32 FractionCount = 0;
+
+    s32 Pending = -1;  // A digit we already produced (when skipping leading zeros) but haven't handed out yet
+};
+
+// Stores v * 2^shift (shift < 32) in limbs starting at _limbs_, returns the number of limbs written
+s32 exact_store_shifted(u32 *limbs, u64 v, s32 shift) {
+    u64 low  = v << shift;
+    u64 high = shift ? v >> (64 - shift) : 0;
+
+    limbs[0] = (u32) low;
+    limbs[1] = (u32) (low >> 32);
+    limbs[2] = (u32) high;
+    return 3;
+}
+
+void exact_init(exact_digit_stream &s, f64 value) {
+    constexpr s32 MANTISSA_BITS = numeric_info<f64>::bits_mantissa;
+
+    u64 br = types::bit_cast<u64>(value);
+
+    u64 m         = br & ((1ull << MANTISSA_BITS) - 1);
+    s32 biasedExp = (s32) (br >> MANTISSA_BITS) & ((1 << numeric_info<f64>::bits_exponent) - 1);
+
+    s32 e = 1 - numeric_info<f64>::exponent_bias - MANTISSA_BITS;  // Subnormals
+    if (biasedExp) {
+        m |= 1ull << MANTISSA_BITS;
+        e = biasedExp - numeric_info<f64>::exponent_bias - MANTISSA_BITS;
+    }
+
+    u32 integral[EXACT_MAX_LIMBS];
+    s32 integralCount = 0;
+
+    if (e >= 0) {
+        s32 limbShift = e / 32;
+        zero_memory(integral, limbShift * sizeof(u32));
+        integralCount = limbShift + exact_store_shifted(integral + limbShift, m, e % 32);
+    } else {
+        s32 k = -e;
+
+        u64 integralPart   = k < 64 ? m >> k : 0;
+        u64 fractionalPart = k < 64 ? m & ((1ull << k) - 1) : m;
+
+        integralCount = exact_store_shifted(integral, integralPart, 0);
+
+        // Scale the fraction from 2^k to a whole number of limbs
+        s.FractionCount = (k + 31) / 32;
+        zero_memory(s.Fraction, s.FractionCount * sizeof(u32));
+        exact_store_shifted(s.Fraction, fractionalPart, s.FractionCount * 32 - k);
+    }
+
+    while (integralCount && !integral[integralCount - 1]) --integralCount;
+
+    // Print the integral part 9 digits at a time from the back
+    utf8 *end = s.Integral + sizeof(s.Integral);
+    utf8 *p   = end;
+    while (integralCount) {
+        u64 rem = 0;
+        for (s32 i = integralCount - 1; i >= 0; --i) {
+            u64 cur     = rem << 32 | integral[i];
+            integral[i] = (u32) (cur / 1000000000);
+            rem         = cur % 1000000000;
+        }
+        if (!integral[integralCount - 1]) --integralCount;
+
+        For(range(9)) {
+            *--p = (utf8) ('0' + rem % 10);
+            rem /= 10;
+        }
+    }
+    while (p != end && *p == '0') ++p;
+
+    s.IntegralIndex = (s32) (p - s.Integral);
+    s.IntegralEnd   = (s32) sizeof(s.Integral);
+}
+
+s32 exact_next_digit(exact_digit_stream &s) {
+    if (s.Pending >= 0) {
+        s32 d     = s.Pending;
+        s.Pending = -1;
+        return d;
+    }
+
+    if (s.IntegralIndex < s.IntegralEnd) return s.Integral[s.IntegralIndex++] - '0';
+
+    u64 carry = 0;
+    For(range(s.FractionCount)) {
+        u64 cur       = (u64) s.Fraction[it] * 10 + carry;
+        s.Fraction[it] = (u32) cur;
+        carry         = cur >> 32;
+    }
+    return (s32) carry;
+}
+
+// Returns true if any of the digits which haven't been produced yet is non-zero
+bool exact_has_more(const exact_digit_stream &s) {
+    if (s.Pending > 0) return true;
+    for (s32 i = s.IntegralIndex; i < s.IntegralEnd; ++i) {
+        if (s.Integral[i] != '0') return true;
+    }
+    For(range(s.FractionCount)) {
+        if (s.Fraction[it]) return true;
+    }
+    return false;
+}
+
+// Appends the digits of _value_ to _builder_'s base buffer (same contract as grisu_to_decimal), correctly rounded (half to even).
+// _precision_ is the number of significant digits, or when _fixed_ - the number of digits after the decimal point.
+// Returns the decimal exponent of the last written digit.
+//
+// The output is limited to the space left in the base buffer, digits past that are dropped.
+export s32 exact_to_decimal(string_builder &builder, f64 value, s32 precision, bool fixed) {
+    assert(value > 0 && is_finite(value));
+
+    exact_digit_stream s;
+    exact_init(s, value);
+
+    // value = 0.d1 d2 d3 ... * 10^exp10 with d1 != 0
+    s32 exp10 = s.IntegralEnd - s.IntegralIndex;
+    if (!exp10) {
+        s32 d = exact_next_digit(s);
+        while (!d) {
+            --exp10;
+            d = exact_next_digit(s);
+        }
+        s.Pending = d;
+    }
+
+    utf8 *buffer = builder.BaseBuffer.Data + builder.BaseBuffer.Occupied;
+    s64 capacity = string_builder::BUFFER_SIZE - builder.BaseBuffer.Occupied;
+
+    s64 count = fixed ? (s64) exp10 + precision : max(precision, 1);
+    if (count > capacity - 1) count = capacity - 1;  // Leave room for the carry in fixed mode
+
+    if (count <= 0) {
+        // No significant digits fit in the precision, e.g. "{:.1f}" with 0.06 - we round to 0 or to 1 at the last place.
+        // When the first digit is exactly at the rounding position a tie goes to the even 0.
+        bool up = false;
+        if (count == 0) {
+            s32 d = exact_next_digit(s);
+            up    = d > 5 || (d == 5 && exact_has_more(s));
+        }
+        buffer[0] = up ? '1' : '0';
+        builder.BaseBuffer.Occupied += 1;
+        return -precision;
+    }
+
+    For(range(count)) buffer[it] = (utf8) ('0' + exact_next_digit(s));
+
+    s32 exp = (s32) (exp10 - count);
+
+    s32 next = exact_next_digit(s);
+    bool up  = next > 5 || (next == 5 && (exact_has_more(s) || (buffer[count - 1] - '0') % 2));
+    if (up) {
+        s64 i = count - 1;
+        while (i >= 0 && buffer[i] == '9') buffer[i--] = '0';
+
+        if (i >= 0) {
+            ++buffer[i];
+        } else {
+            // 9.99 -> 10.0
+            buffer[0] = '1';
+            if (fixed) {
+                buffer[count++] = '0';
+            } else {
+                ++exp;
+            }
+        }
+    }
+
+    builder.BaseBuffer.Occupied += count;
+    return exp;
+}
 
 LSTD_END_NAMESPACE
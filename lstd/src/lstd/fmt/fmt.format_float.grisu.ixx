@@ -5,10 +5,12 @@ module;
 export module fmt.format_float.grisu;
 
 import fmt.format_float.specs;
+import fmt.format_float.fallback;
 
 //
-// Use Grisu + Dragon4 when formatting a float with a given precision:
-// https://www.cs.tufts.edu/~nr/cs257/archive/florian-loitsch/printf.pdf.//
+// Use Grisu when formatting a float with a given precision:
+// https://www.cs.tufts.edu/~nr/cs257/archive/florian-loitsch/printf.pdf.
+// When it can't guarantee the correct rounding we fall back to exact digit generation, see fmt.format_float.fallback.
 //
 
 LSTD_BEGIN_NAMESPACE
@@ -258,11 +260,8 @@ export s32 grisu_to_decimal(string_builder &builder, f64 value, s32 precision, c
 
     s32 exp = 0;
     if (gen_digits(state, normalized, 1, &exp) == gen_digits_result::ERROR) {
-        // exp += state.Size - cachedExp10 - 1;
-        // builder.BaseBuffer.Occupied += state.Size;
-        // fallback_format(value, handler.precision, specs.binary32, buf, exp);
-        // exp += state.Exp10;
-        // builder.BaseBuffer.Occupied += state.Size;
+        // Digits Grisu wrote so far aren't committed (Occupied is untouched), the exact path overwrites them
+        exp = exact_to_decimal(builder, value, precision, fixed);
     } else {
         // Success!
         exp += state.Exp10;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../base64.h"
+#include "../date_time.h"
 #include "../io.h"
 #include "../math.h"
 #include "../memory/guid.h"
@@ -111,16 +113,81 @@ struct formatter<guid> {
     }
 };
 
+// [1, 2, ...] - numbers and strings go straight through write_list(), everything else through format_list
+template <typename T>
+void format_array_like(fmt_context *f, const T *data, s64 count) {
+    if constexpr (fmt_list_scalar<T>) {
+        write_no_specs(f, "[");
+        write_list(f, data, count);
+        write_no_specs(f, "]");
+    } else {
+        format_list(f).entries(data, count)->finish();
+    }
+}
+
 // Formatts array in the following way: [1, 2, ...]
+// Arrays of bytes also allow specifiers:
+//   'x' - hex digits, "48656c6c6f"
+//   'X' - Uppercase version of 'x'
+//   '#x' - a dump like the one of xxd (offsets, hex and ASCII columns, 16 bytes per line)
+//   '#X' - Uppercase version of '#x'
+//   'b' - base64, "SGVsbG8="
+//   '#b' - URL-safe base64 without padding, "SGVsbG8"
 template <typename T>
 struct formatter<array<T>> {
-    void format(const array<T> &src, fmt_context *f) { format_list(f).entries(src.Data, src.Count)->finish(); }
+    void format(const array<T> &src, fmt_context *f) {
+        if constexpr (types::is_same<T, byte>) {
+            char type = f->Specs ? f->Specs->Type : 0;
+            if (type == 'x' || type == 'X') {
+                if (f->Specs->Hash) {
+                    write_hex_dump(f, src.Data, src.Count, type == 'X');
+                } else {
+                    write_hex_bytes(f, src.Data, src.Count, type == 'X');
+                }
+                return;
+            }
+
+            if (type == 'b') {
+                base64_options options = {.UrlSafe = f->Specs->Hash, .Padding = !f->Specs->Hash};
+
+                // Whole groups of 3 bytes until the last piece, so only that one can have padding
+                utf8 buffer[1_KiB];
+                const byte *data = src.Data;
+                s64 count        = src.Count;
+                while (count) {
+                    s64 n = min<s64>(count, sizeof(buffer) / 4 * 3);
+                    write_no_specs(f, buffer, base64_encode(buffer, data, n, options));
+                    data += n, count -= n;
+                }
+                return;
+            }
+        }
+        format_array_like(f, src.Data, src.Count);
+    }
 };
 
 // Formatts stack array in the following way: [1, 2, ...]
 template <typename T, s64 N>
 struct formatter<stack_array<T, N>> {
-    void format(const stack_array<T, N> &src, fmt_context *f) { format_list(f).entries(src.Data, src.Count)->finish(); }
+    void format(const stack_array<T, N> &src, fmt_context *f) { format_array_like(f, src.Data, src.Count); }
+};
+
+// Formats a date_time as ISO 8601: 2026-10-14T09:30:05.123+02:00 (Z instead of the offset for UTC).
+// The precision is the number of digits of the fraction of the second (0 - 9), 3 by default.
+template <>
+struct formatter<date_time> {
+    void format(const date_time &src, fmt_context *f) {
+        s32 digits = 3;
+        if (f->Specs && f->Specs->Precision != -1) digits = f->Specs->Precision;
+
+        if (digits > 9) {
+            f->on_error("Precision of a date_time is at most 9 digits", f->Parse.It.Data - f->Parse.FormatString.Data - 1);
+            return;
+        }
+
+        utf8 buffer[DATE_TIME_ISO8601_MAX_SIZE];
+        write_no_specs(f, buffer, date_time_format_iso8601(buffer, src, digits));
+    }
 };
 
 template <>
@@ -128,6 +195,16 @@ struct formatter<thread::id> {
     void format(thread::id src, fmt_context *f) { write(f, src.Value); }
 };
 
+// Formats a record of :LockProfiling: in the following way:
+//     mutex at file.cpp:42 { Acquisitions: 1000, Contended: 12, WaitNs: 5300, MaxWaitNs: 900 }
+template <>
+struct formatter<thread::lock_profile> {
+    void format(const thread::lock_profile &src, fmt_context *f) {
+        fmt_to_writer(f, "{} at {}:{}", src.Kind, src.Loc.File, src.Loc.Line);  // format_struct adds the space
+        format_struct(f, "").field("Acquisitions", src.Acquisitions)->field("Contended", src.Contended)->field("WaitNs", src.WaitNs)->field("MaxWaitNs", src.MaxWaitNs)->finish();
+    }
+};
+
 //
 // Formatters for math types:
 //
@@ -136,7 +213,7 @@ struct formatter<thread::id> {
 template <typename T, s32 Dim, bool Packed>
 struct formatter<vec<T, Dim, Packed>> {
     void format(const vec<T, Dim, Packed> &src, fmt_context *f) {
-        format_list(f).entries(src.Data, src.DIM)->finish();
+        format_array_like(f, src.Data, src.DIM);
     }
 };
 
@@ -4,6 +4,7 @@ module;
 #include "../io.h"
 #include "../math.h"
 #include "../memory/guid.h"
+#include "../profiler.h"
 
 export module fmt;
 
@@ -159,6 +160,9 @@ export module fmt;
 // You can disable text styles with _Context.FmtDisableAnsiCodes_.
 // That is useful when logging to a file and not a console. The ansi escape codes look like garbage in files.
 //
+// With compiled format strings (see below) each style gets parsed and turned into its escape sequence once
+// (per call site, or in fmt_compile()), after that it's a copy - or nothing when the codes are disabled.
+//
 
 export import fmt.arg;
 export import fmt.parse_context;
@@ -182,6 +186,14 @@ export {
     template <typename... Args>
     s64 fmt_calculate_length(const string &fmtString, Args &&...arguments);
 
+    // Formats into _buffer_ without allocating (see fixed_buffer_writer), output past _size_ bytes is dropped.
+    // Returns how many bytes the whole output needs - if that's more than _size_, the output was truncated.
+    //
+    // Note: The formatting itself doesn't allocate for the built-in types, except for floats with very large precisions
+    // (those fall back to big integer arithmetic). Custom formatters may allocate and error reporting does.
+    template <typename... Args>
+    s64 fmt_to_buffer(byte * buffer, s64 size, const string &fmtString, Args &&...arguments);
+
     // Formats to a string. The caller is responsible for freeing.
     template <typename... Args>
     [[nodiscard("Leak")]] string sprint(const string &fmtString, Args &&...arguments);
@@ -210,6 +222,202 @@ export {
     // Expects a valid format_context (take a look in the implementation of fmt_to_writer).
     // Does all the magic of parsing the format string and formatting the arguments.
     void fmt_parse_and_format(fmt_context * f);
+
+    //
+    // Format strings parsed at compile time:
+    //
+    //    print("{} = {:.2f}\n"_fmt, name, value);
+    //
+    // The literal gets split into literal runs and replacement fields (with their specs already parsed)
+    // when the call gets compiled, so at runtime we just walk that list instead of scanning for braces
+    // and parsing specs again. Use this for format strings in hot paths (e.g. logging).
+    //
+    // Errors which the runtime parser would report (unmatched braces, bad specs, argument index out of range,
+    // switching between automatic and manual indexing, numeric specs on non-numeric arguments, etc.)
+    // become compile errors - look for the call to _fmt_compile_error_ in the error message to see which one.
+    //
+    // Type specifiers (the last char in the specs) and text styles ({!...}) are still checked at runtime,
+    // the former by the formatters and the latter when the call site formats for the first time.
+    //
+
+    // A text style turned into its escape sequence
+    struct fmt_encoded_style {
+        utf8 Data[FMT_TEXT_STYLE_MAX_LENGTH];
+        s64 Count = 0;
+        bool Valid = false;  // False if the style had an error (it was reported when encoding)
+    };
+
+    template <s64 N>
+    struct fmt_literal {
+        utf8 Data[N] = {};
+        static constexpr s64 Count = N - 1;  // Without the null terminator
+
+        constexpr fmt_literal(const utf8 (&str)[N]) {
+            For(range(N)) Data[it] = str[it];
+        }
+    };
+
+    template <fmt_literal Lit>
+    struct fmt_compiled_string {};
+
+    template <fmt_literal Lit>
+    constexpr fmt_compiled_string<Lit> operator"" _fmt() { return {}; }
+
+    struct fmt_segment {
+        enum kind : u8 {
+            LITERAL,  // Written unchanged
+            ARG,      // A replacement field
+            STYLE     // A text style ({!...}), parsed when it gets formatted
+        };
+
+        kind Kind = LITERAL;
+
+        // LITERAL: the bytes to write,
+        // ARG:     _Begin_ points to the closing "}" of the field (formatters report errors relative to it),
+        // STYLE:   _Begin_ points after the "!".
+        s64 Begin = 0, Count = 0;
+
+        s64 ArgId = -1;  // For STYLE: which style in the string this is (they are cached in that order)
+        bool HasSpecs = false;
+        fmt_dynamic_specs Specs;
+    };
+
+    template <fmt_literal Lit, typename... Args>
+    void fmt_to_writer(writer * out, fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    // Exact, but integers, strings, bools and pointers without specs are measured instead of formatted.
+    template <fmt_literal Lit, typename... Args>
+    s64 fmt_calculate_length(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    // An upper bound of fmt_calculate_length() which doesn't format anything (digit counts, string sizes and
+    // bounds for floats from their exponent and precision). Returns -1 if there is a custom type
+    // or a dynamic width/precision in the string. sprint uses this to size its output up front.
+    template <fmt_literal Lit, typename... Args>
+    s64 fmt_estimate_length(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    template <fmt_literal Lit, typename... Args>
+    s64 fmt_to_buffer(byte * buffer, s64 size, fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    template <fmt_literal Lit, typename... Args>
+    [[nodiscard("Leak")]] string sprint(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    template <fmt_literal Lit, typename... Args>
+    string tsprint(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    template <fmt_literal Lit, typename... Args>
+    utf8 *mprint(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    template <fmt_literal Lit, typename... Args>
+    void print(fmt_compiled_string<Lit> fmtString, Args && ...arguments);
+
+    // A format string parsed at runtime. For format strings which aren't literals (localized messages, templates
+    // loaded from files) but get formatted many times - we parse once here instead of on every call:
+    //
+    //    fmt_compiled row = fmt_compile(loadedTemplate);
+    //    defer(free(row));
+    //    For(rows) fmt_to_writer(&out, row, it.Name, it.Value);
+    //
+    // The format string isn't copied, it must outlive the compiled object.
+    //
+    // Syntax errors are reported (through Context.FmtParseErrorHandler) once, in fmt_compile(), and formatting
+    // an invalid fmt_compiled writes nothing. Errors which depend on the arguments (index out of range,
+    // numeric specs on a string, etc.) are reported when formatting, like with a normal format string.
+    struct fmt_compiled {
+        string FormatString;
+        array<fmt_segment> Segments;
+        array<fmt_encoded_style> Styles;
+        bool Valid = false;
+    };
+
+    fmt_compiled fmt_compile(const string &fmtString);
+    void free(fmt_compiled & compiled);
+
+    template <typename... Args>
+    void fmt_to_writer(writer * out, const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    s64 fmt_calculate_length(const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    s64 fmt_estimate_length(const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    s64 fmt_to_buffer(byte * buffer, s64 size, const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    [[nodiscard("Leak")]] string sprint(const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    string tsprint(const fmt_compiled &fmtString, Args &&...arguments);
+
+    template <typename... Args>
+    void print(const fmt_compiled &fmtString, Args &&...arguments);
+
+    // Same as fmt_parse_and_format, but the format string was already parsed into _segments_.
+    // _checkArgs_ is false if the arguments were checked against the segments at compile time.
+    // _styles_ are the encoded text styles (see fmt_encode_styles), if null they get parsed here.
+    void fmt_format_segments(fmt_context * f, const fmt_segment *segments, s64 count, bool checkArgs, const fmt_encoded_style *styles = null);
+
+    //
+    // Deferred logging - the calling thread only copies the arguments, the formatting happens later:
+    //
+    //    deferred_log_decoder decoder(&cout);
+    //    async_log_writer binaryLog;
+    //    async_log_writer_init(binaryLog, &decoder);  // Records get formatted on binaryLog's background thread
+    //    ...
+    //    deferred_log(&binaryLog, "Request {} took {} us\n"_fmt, id, micros);
+    //
+    // deferred_log() writes one record - the id of the call site (one per format string literal and argument types,
+    // registered on first use) and the raw argument values, then calls flush(), so an async_log_writer publishes it whole.
+    // Arguments are stored the way fmt stores them: integers as 64 bit, f32/f64, pointers and strings (the bytes get copied).
+    // Custom types aren't supported, their formatters can't run in an offline decoder - log their fields instead.
+    //
+    // deferred_log_decoder is a writer which turns records back into text and writes that to _Out_. Records can also be
+    // written somewhere (e.g. a file) and decoded later, even by a different program - save deferred_log_serialize_sites()
+    // with them and load it into the decoder with deferred_log_decoder_load_sites(), site ids only mean something
+    // in the process which registered them.
+    //
+    constexpr s64 DEFERRED_LOG_MAX_SITES = 4096;
+    constexpr s64 DEFERRED_LOG_MAX_ARGS  = fmt_internal::MAX_PACKED_ARGS;
+
+    struct deferred_log_site {
+        string FormatString;
+        s64 ArgCount = 0;
+        fmt_type Types[DEFERRED_LOG_MAX_ARGS] = {};
+
+        // The format string parsed at compile time, null for sites loaded with deferred_log_decoder_load_sites()
+        const fmt_segment *Segments = null;
+        s64 SegmentCount = 0;
+    };
+
+    template <fmt_literal Lit, typename... Args>
+    void deferred_log(writer * out, fmt_compiled_string<Lit> fmtString, const Args &...arguments);
+
+    struct deferred_log_decoder : writer {
+        writer *Out = null;
+
+        array<deferred_log_site> Sites;  // Loaded sites, if empty we use the ones registered in this process
+        bytes SiteData;                  // The loaded format strings point here
+
+        bytes Pending;  // A record which was split between writes
+
+        deferred_log_decoder() {}
+        deferred_log_decoder(writer *out) : Out(out) {}
+
+        void write(const byte *data, s64 count) override;
+        void flush() override { Out->flush(); }
+    };
+
+    void free(deferred_log_decoder & decoder);
+
+    // Called once per call site by deferred_log(), returns the site id.
+    u32 deferred_log_register_site(const string &fmtString, const fmt_type *types, s64 argCount, const fmt_segment *segments, s64 segmentCount);
+
+    // The sites registered so far, for decoding the records in another process.
+    [[nodiscard("Leak")]] bytes deferred_log_serialize_sites();
+
+    // Returns false (and leaves _decoder_ untouched) if _data_ isn't a valid site table. The data is copied.
+    bool deferred_log_decoder_load_sites(deferred_log_decoder & decoder, const bytes &data);
 }
 
 fmt_type get_type(fmt_args ars, s64 index) {
@@ -309,9 +517,95 @@ bool fmt_handle_dynamic_specs(fmt_context *f) {
     return true;
 }
 
+// Writes the escape sequence of _style_ to _buffer_ (at least FMT_TEXT_STYLE_MAX_LENGTH bytes), returns the size
+s64 fmt_text_style_to_ansi(utf8 *buffer, fmt_text_style style) {
+    auto *ansiEnd = fmt_internal::color_to_ansi(buffer, style);
+
+    u8 emphasis = (u8) style.Emphasis;
+    if (emphasis) {
+        assert(!style.Background);
+        ansiEnd = fmt_internal::emphasis_to_ansi(ansiEnd, emphasis);
+    }
+    return ansiEnd - buffer;
+}
+
+void write_text_style(fmt_context *f, fmt_text_style style) {
+    if (Context.FmtDisableAnsiCodes) return;
+
+    utf8 ansiBuffer[FMT_TEXT_STYLE_MAX_LENGTH];
+    write_no_specs(f, ansiBuffer, fmt_text_style_to_ansi(ansiBuffer, style));
+}
+
+void fmt_encode_styles(fmt_encoded_style *out, const string &fmtString, const fmt_segment *segments, s64 count) {
+    auto p = fmt_parse_context(fmtString);
+
+    For(range(count)) {
+        const fmt_segment &segment = segments[it];
+        if (segment.Kind != fmt_segment::STYLE) continue;
+
+        auto *e = out + segment.ArgId;
+
+        p.It                  = string(fmtString.Data + segment.Begin, fmtString.Count - segment.Begin);
+        auto [success, style] = fmt_parse_text_style(&p);
+        if (!success) continue;
+        if (!p.It.Count || p.It[0] != '}') {
+            p.on_error("\"}\" expected");
+            continue;
+        }
+
+        e->Count = fmt_text_style_to_ansi(e->Data, style);
+        e->Valid = true;
+    }
+}
+
+// Runtime format strings tend to repeat the same fields ("{:>10.2f}" for every column of a table), so
+// fmt_parse_and_format remembers the last few specs it parsed and reuses them when the text and argument type match.
+// Specs with a dynamic width/precision aren't remembered - parsing them may take an automatic argument index,
+// and neither are specs which reported an error, so it gets reported for every field.
+constexpr s64 FMT_SPECS_CACHE_SIZE = 4;
+
+struct fmt_specs_cache {
+    struct entry {
+        string Text;  // Between the ":" and the "}"
+        fmt_type ArgType = fmt_type::NONE;
+        fmt_dynamic_specs Specs;
+    };
+
+    entry Entries[FMT_SPECS_CACHE_SIZE];
+    s64 Next = 0;  // Replaced round robin
+};
+
+// On a hit, advances _p->It_ to the "}"
+const fmt_dynamic_specs *fmt_specs_cache_find(fmt_specs_cache &cache, fmt_parse_context *p, fmt_type argType) {
+    For(cache.Entries) {
+        s64 n = it.Text.Count;
+        if (it.ArgType != argType || p->It.Count <= n || p->It.Data[n] != '}') continue;
+        if (!equal_memory(p->It.Data, it.Text.Data, n)) continue;
+
+        p->It.Data += n, p->It.Count -= n;
+        return &it.Specs;
+    }
+    return null;
+}
+
+void fmt_specs_cache_add(fmt_specs_cache &cache, const utf8 *begin, const utf8 *end, fmt_type argType, const fmt_dynamic_specs &specs) {
+    if (specs.WidthIndex != -1 || specs.PrecisionIndex != -1) return;
+
+    auto &e   = cache.Entries[cache.Next];
+    e.Text    = string(begin, end - begin);
+    e.ArgType = argType;
+    e.Specs   = specs;
+
+    cache.Next = (cache.Next + 1) % FMT_SPECS_CACHE_SIZE;
+}
+
 void fmt_parse_and_format(fmt_context *f) {
+    PROFILE_ZONE("fmt_parse_and_format");
+
     fmt_parse_context *p = &f->Parse;
 
+    fmt_specs_cache specsCache;
+
     auto write_until = [&](const utf8 *end) {
         if (!p->It.Count) return;
         while (true) {
@@ -375,18 +669,7 @@ void fmt_parse_and_format(fmt_context *f) {
                 return;
             }
 
-            if (!Context.FmtDisableAnsiCodes) {
-                utf8 ansiBuffer[7 + 3 * 4 + 1];
-                auto *ansiEnd = fmt_internal::color_to_ansi(ansiBuffer, style);
-                write_no_specs(f, ansiBuffer, ansiEnd - ansiBuffer);
-
-                u8 emphasis = (u8) style.Emphasis;
-                if (emphasis) {
-                    assert(!style.Background);
-                    ansiEnd = fmt_internal::emphasis_to_ansi(ansiBuffer, emphasis);
-                    write_no_specs(f, ansiBuffer, ansiEnd - ansiBuffer);
-                }
-            }
+            write_text_style(f, style);
         } else {
             // Parse integer specified or a named argument
             s64 argId = fmt_parse_arg_id(p);
@@ -402,15 +685,24 @@ void fmt_parse_and_format(fmt_context *f) {
                 ++p->It.Data, --p->It.Count;  // Skip the :
 
                 fmt_dynamic_specs specs = {};
-                bool success               = fmt_parse_specs(p, currentArg.Type, &specs);
-                if (!success) return;
-                if (!p->It.Count || p->It[0] != '}') {
-                    f->on_error("\"}\" expected");
-                    return;
+                if (auto *cached = fmt_specs_cache_find(specsCache, p, currentArg.Type)) {
+                    specs = *cached;
+                } else {
+                    const utf8 *specsBegin = p->It.Data;
+                    s32 errorCount         = p->ErrorCount;
+
+                    bool success = fmt_parse_specs(p, currentArg.Type, &specs);
+                    if (!success) return;
+                    if (!p->It.Count || p->It[0] != '}') {
+                        f->on_error("\"}\" expected");
+                        return;
+                    }
+
+                    if (p->ErrorCount == errorCount) fmt_specs_cache_add(specsCache, specsBegin, p->It.Data, currentArg.Type, specs);
                 }
 
-                f->Specs = &specs;
-                success  = fmt_handle_dynamic_specs(f);
+                f->Specs     = &specs;
+                bool success = fmt_handle_dynamic_specs(f);
                 if (!success) return;
 
                 fmt_visit_fmt_arg(fmt_context_visitor(f), currentArg);
@@ -443,16 +735,20 @@ s64 fmt_calculate_length(const string &fmtString, Args &&...arguments) {
     return writer.Count;
 }
 
+template <typename... Args>
+s64 fmt_to_buffer(byte *buffer, s64 size, const string &fmtString, Args &&...arguments) {
+    fixed_buffer_writer writer(buffer, size);
+    fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
+    return writer.Count;
+}
+
 // Formats to a string. The caller is responsible for freeing.
 template <typename... Args>
 [[nodiscard("Leak")]] string sprint(const string &fmtString, Args &&...arguments) {
-    auto writer = string_builder_writer();
+    // Formats on the stack and allocates once at the end (see stack_string_writer)
+    stack_string_writer writer;
     fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
-
-    string combined = string_builder_combine(writer.Builder);
-    free(writer);
-
-    return combined;
+    return stack_string_writer_combine(writer);
 }
 
 // Formats to a string. Uses the temporary allocator.
@@ -478,4 +774,1034 @@ void print(const string &fmtString, Args &&...arguments) {
     fmt_to_writer(Context.Log, fmtString, ((Args &&) arguments)...);
 }
 
+//
+// Parsing of format strings into segments, at compile time for "..."_fmt literals and at runtime for fmt_compile().
+// This mirrors fmt_parse_and_format and fmt_parse_specs, error messages are the same.
+//
+
+// Not constexpr on purpose - reaching this while evaluating a format string at compile time turns into a compile error.
+inline void fmt_compile_error(const utf8 *message) { assert(false && "Compile-time format string error reached at runtime"); }
+
+struct fmt_compile_state {
+    const utf8 *Data;
+    s64 Count;
+    s64 Pos = 0;
+
+    // The types of the arguments. When parsing at runtime (fmt_compile()) we don't know them, _ArgCount_ is -1 then
+    // and the arguments get checked against the specs when formatting.
+    const fmt_type *Types;
+    s64 ArgCount;
+
+    s32 NextArgID = 0;
+
+    fmt_segment *Out;  // null if we are just counting
+    s64 SegmentCount = 0;
+    s64 StyleCount = 0;
+
+    // At compile time errors stop compilation, at runtime we remember the first one and bail.
+    const utf8 *Error = null;
+    s64 ErrorPosition = -1;
+
+    constexpr utf8 peek() const { return Pos < Count ? Data[Pos] : 0; }
+    constexpr bool knows_types() const { return ArgCount >= 0; }
+
+    constexpr bool error(const utf8 *message) {
+        if (is_constant_evaluated()) fmt_compile_error(message);
+        if (!Error) Error = message, ErrorPosition = Pos;
+        return false;
+    }
+
+    constexpr void add(const fmt_segment &segment) {
+        if (Out) Out[SegmentCount] = segment;
+        ++SegmentCount;
+    }
+
+    constexpr void add_literal(s64 begin, s64 count) {
+        if (!count) return;
+
+        fmt_segment segment;
+        segment.Kind = fmt_segment::LITERAL;
+        segment.Begin = begin;
+        segment.Count = count;
+        add(segment);
+    }
+};
+
+constexpr fmt_alignment fmt_compile_alignment(utf32 ch) {
+    if (ch == '<') return fmt_alignment::LEFT;
+    if (ch == '>') return fmt_alignment::RIGHT;
+    if (ch == '=') return fmt_alignment::NUMERIC;
+    if (ch == '^') return fmt_alignment::CENTER;
+    return fmt_alignment::NONE;
+}
+
+// The type checks below are skipped when we don't know the argument types (fmt_compile()),
+// fmt_format_segments does them later with the parse context.
+
+constexpr void fmt_compile_require_arithmetic_arg(fmt_compile_state &s, fmt_type type) {
+    if (!s.knows_types() || type == fmt_type::CUSTOM) return;
+    if (!fmt_is_type_arithmetic(type)) s.error("Format specifier requires an arithmetic argument");
+}
+
+constexpr void fmt_compile_require_signed_arithmetic_arg(fmt_compile_state &s, fmt_type type) {
+    if (!s.knows_types() || type == fmt_type::CUSTOM) return;
+
+    fmt_compile_require_arithmetic_arg(s, type);
+    if (fmt_is_type_integral(type) && type != fmt_type::S64) {
+        s.error("Format specifier requires a signed integer argument (got unsigned)");
+    }
+}
+
+constexpr void fmt_compile_check_precision_for_arg(fmt_compile_state &s, fmt_type type) {
+    if (!s.knows_types() || type == fmt_type::CUSTOM) return;
+    if (fmt_is_type_integral(type)) s.error("Precision is not allowed for integer types");
+    if (type == fmt_type::POINTER) s.error("Precision is not allowed for pointer type");
+}
+
+constexpr u32 fmt_compile_uint(fmt_compile_state &s, const utf8 *tooLargeError) {
+    u64 value = 0;
+    while (is_digit(s.peek())) {
+        value = value * 10 + (u64) (s.peek() - '0');
+        if (value > numeric_info<u32>::max()) {
+            s.error(tooLargeError);
+            return 0;
+        }
+        ++s.Pos;
+    }
+    return (u32) value;
+}
+
+// Returns -1 on error.
+constexpr s64 fmt_compile_arg_id(fmt_compile_state &s) {
+    utf8 ch = s.peek();
+    if (ch == '}' || ch == ':') {
+        if (s.NextArgID < 0) return s.error("Cannot switch from manual to automatic argument indexing"), -1;
+        return s.NextArgID++;
+    }
+
+    if (!is_digit(ch)) return s.error("Expected a number - an index to an argument"), -1;
+
+    u32 value = fmt_compile_uint(s, "Argument index is an integer which is too large");
+    if (s.Error) return -1;
+    if (s.Pos == s.Count) return s.error("Format string ended abruptly"), -1;
+
+    ch = s.peek();
+    if (ch != '}' && ch != ':') return s.error("Expected \":\" or \"}\""), -1;
+
+    if (s.NextArgID > 0) return s.error("Cannot switch from automatic to manual argument indexing"), -1;
+    s.NextArgID = -1;
+    return (s64) value;
+}
+
+// Parses {} or {n} for a dynamic width/precision, _s.Pos_ is at the "{". Returns -1 on error.
+constexpr s64 fmt_compile_dynamic_index(fmt_compile_state &s, const utf8 *notClosedError, const utf8 *notIntegerError) {
+    ++s.Pos;  // Skip the {
+
+    s64 index = -1;
+    if (s.Pos < s.Count) {
+        index = fmt_compile_arg_id(s);
+        if (index == -1) return -1;
+    }
+    if (s.peek() != '}') return s.error(notClosedError), -1;
+    ++s.Pos;  // Skip the }
+
+    if (s.knows_types()) {
+        if (index >= s.ArgCount) return s.error("Argument index out of range"), -1;
+        if (!fmt_is_type_integral(s.Types[index])) return s.error(notIntegerError), -1;
+    }
+    return index;
+}
+
+constexpr void fmt_compile_specs(fmt_compile_state &s, fmt_type type, fmt_dynamic_specs &specs) {
+    if (s.peek() == '}') return;  // No specs to parse
+
+    // Fill and align
+    s64 next = s.Pos + get_size_of_cp(s.Data + s.Pos);
+    if (next > s.Count) {
+        s.error("Invalid UTF8 encountered in format string");
+        return;
+    }
+
+    utf32 fill = decode_cp(s.Data + s.Pos);
+    auto align = fmt_compile_alignment(fill);
+    if (align == fmt_alignment::NONE) {
+        if (next < s.Count) align = fmt_compile_alignment(s.Data[next++]);
+    } else {
+        fill = ' ';
+        next = s.Pos + 1;
+    }
+
+    if (align != fmt_alignment::NONE) {
+        if (fill == '{') {
+            s.error("Invalid fill character \"{\"");
+            return;
+        }
+        if (fill == '}') {
+            s.error("Invalid fill character \"}\"");
+            return;
+        }
+
+        s.Pos = next;
+        specs.Fill = fill;
+        specs.Align = align;
+
+        if (align == fmt_alignment::NUMERIC) fmt_compile_require_arithmetic_arg(s, type);
+    }
+    if (s.Pos == s.Count) return;
+
+    // Sign
+    utf8 ch = s.peek();
+    if (ch == '+' || ch == '-' || ch == ' ') {
+        fmt_compile_require_signed_arithmetic_arg(s, type);
+        specs.Sign = ch == '+' ? fmt_sign::PLUS : (ch == '-' ? fmt_sign::MINUS : fmt_sign::SPACE);
+        ++s.Pos;
+    }
+    if (s.Pos == s.Count) return;
+
+    if (s.peek() == '#') {
+        fmt_compile_require_arithmetic_arg(s, type);
+        specs.Hash = true;
+
+        ++s.Pos;
+        if (s.Pos == s.Count) return;
+    }
+
+    // 0 means = alignment with the character 0 as fill
+    if (s.peek() == '0') {
+        fmt_compile_require_arithmetic_arg(s, type);
+        specs.Align = fmt_alignment::NUMERIC;
+        specs.Fill = '0';
+
+        ++s.Pos;
+        if (s.Pos == s.Count) return;
+    }
+
+    // Width
+    if (is_digit(s.peek())) {
+        specs.Width = fmt_compile_uint(s, "We parsed an integer width which was too large");
+    } else if (s.peek() == '{') {
+        specs.WidthIndex = fmt_compile_dynamic_index(s, "Expected a closing \"}\" after parsing an argument ID for a dynamic width", "Width was not an integer");
+    }
+    if (s.Error || s.Pos == s.Count) return;
+
+    // Precision
+    if (s.peek() == '.') {
+        ++s.Pos;  // Skip the .
+
+        if (is_digit(s.peek())) {
+            specs.Precision = (s32) fmt_compile_uint(s, "We parsed an integer precision which was too large");
+        } else if (s.peek() == '{') {
+            specs.PrecisionIndex = fmt_compile_dynamic_index(s, "Expected a closing \"}\" after parsing an argument ID for a dynamic precision", "Precision was not an integer");
+        } else {
+            s.error("Missing precision specifier (we parsed a dot but nothing valid after that)");
+        }
+        if (s.Error) return;
+
+        fmt_compile_check_precision_for_arg(s, type);
+    }
+
+    // If we still haven't reached the end or a '}' we treat the byte as the type specifier.
+    if (s.Pos < s.Count && s.peek() != '}') {
+        specs.Type = s.peek();
+        ++s.Pos;
+    }
+}
+
+// Returns the number of segments. If _s.Out_ is not null, the segments are written to it (it must be large enough).
+// At runtime check _s.Error_ after this.
+constexpr s64 fmt_compile_segments(fmt_compile_state &s) {
+    const utf8 *data = s.Data;
+    s64 count = s.Count;
+
+    s64 literalBegin = 0;
+    while (s.Pos < count && !s.Error) {
+        utf8 ch = data[s.Pos];
+        if (ch == '}') {
+            if (s.Pos + 1 == count || data[s.Pos + 1] != '}') {
+                s.error("Unmatched \"}\" in format string - if you want to print it use \"}}\" to escape");
+                break;
+            }
+            s.add_literal(literalBegin, s.Pos + 1 - literalBegin);  // Keep one }
+
+            s.Pos += 2;
+            literalBegin = s.Pos;
+            continue;
+        }
+
+        if (ch != '{') {
+            ++s.Pos;
+            continue;
+        }
+
+        if (s.Pos + 1 == count) {
+            s.error("Invalid format string");
+            break;
+        }
+        if (data[s.Pos + 1] == '{') {
+            // {{ means we escaped a {
+            s.add_literal(literalBegin, s.Pos + 1 - literalBegin);  // Keep one {
+
+            s.Pos += 2;
+            literalBegin = s.Pos;
+            continue;
+        }
+
+        s.add_literal(literalBegin, s.Pos - literalBegin);
+        ++s.Pos;  // Skip the {
+
+        fmt_segment segment;
+        if (s.peek() == '!') {
+            ++s.Pos;  // Skip the !
+
+            segment.Kind = fmt_segment::STYLE;
+            segment.Begin = s.Pos;
+            segment.ArgId = s.StyleCount++;
+            while (s.Pos < count && data[s.Pos] != '}') ++s.Pos;
+            if (s.Pos == count) {
+                s.error("\"}\" expected");
+                break;
+            }
+            segment.Count = s.Pos - segment.Begin;
+        } else {
+            segment.Kind = fmt_segment::ARG;
+            segment.ArgId = fmt_compile_arg_id(s);
+            if (segment.ArgId == -1) break;
+            if (s.knows_types() && segment.ArgId >= s.ArgCount) {
+                s.error("Argument index out of range");
+                break;
+            }
+
+            if (s.peek() == ':') {
+                ++s.Pos;  // Skip the :
+
+                segment.HasSpecs = true;
+                fmt_compile_specs(s, s.knows_types() ? s.Types[segment.ArgId] : fmt_type::NONE, segment.Specs);
+                if (s.Error) break;
+            }
+            if (s.peek() != '}') {
+                s.error("\"}\" expected");
+                break;
+            }
+
+            segment.Begin = s.Pos;
+        }
+        s.add(segment);
+
+        ++s.Pos;  // Skip the }
+        literalBegin = s.Pos;
+    }
+    if (!s.Error) s.add_literal(literalBegin, count - literalBegin);
+
+    return s.SegmentCount;
+}
+
+template <s64 N>
+struct fmt_segment_list {
+    fmt_segment Data[N ? N : 1];
+};
+
+template <fmt_literal Lit>
+constexpr s64 fmt_count_literal_segments(const fmt_type *types, s64 argCount) {
+    fmt_compile_state s = {.Data = Lit.Data, .Count = Lit.Count, .Types = types, .ArgCount = argCount, .Out = null};
+    return fmt_compile_segments(s);
+}
+
+template <s64 N>
+constexpr s64 fmt_count_styles(const fmt_segment_list<N> &segments) {
+    s64 result = 0;
+    For(range(N)) result += segments.Data[it].Kind == fmt_segment::STYLE;
+    return result;
+}
+
+template <s64 N>
+struct fmt_style_list {
+    fmt_encoded_style Data[N ? N : 1];
+};
+
+// Parses the styles of a literal format string the first time it gets formatted,
+// errors in them get reported then (and only once).
+template <fmt_literal Lit, s64 N>
+const fmt_encoded_style *fmt_literal_styles(const fmt_segment *segments, s64 count) {
+    static const fmt_style_list<N> styles = [&] {
+        fmt_style_list<N> result;
+        fmt_encode_styles(result.Data, string(Lit.Data, Lit.Count), segments, count);
+        return result;
+    }();
+    return styles.Data;
+}
+
+template <fmt_literal Lit, s64 N>
+constexpr fmt_segment_list<N> fmt_compile_literal(const fmt_type *types, s64 argCount) {
+    fmt_segment_list<N> result;
+
+    fmt_compile_state s = {.Data = Lit.Data, .Count = Lit.Count, .Types = types, .ArgCount = argCount, .Out = result.Data};
+    fmt_compile_segments(s);
+    return result;
+}
+
+// Instantiated once per format string and argument types, both the parsing and the type checking happen here.
+template <fmt_literal Lit, typename... Args>
+struct fmt_compiled_segments {
+    static constexpr fmt_type Types[sizeof...(Args) + 1] = {fmt_mapped_type_constant_v<Args>..., fmt_type::NONE};
+
+    static constexpr s64 Count = fmt_count_literal_segments<Lit>(Types, sizeof...(Args));
+    static constexpr fmt_segment_list<Count> Segments = fmt_compile_literal<Lit, Count>(Types, sizeof...(Args));
+
+    static constexpr s64 StyleCount = fmt_count_styles(Segments);
+};
+
+fmt_compiled fmt_compile(const string &fmtString) {
+    fmt_compiled result;
+    result.FormatString = fmtString;
+
+    fmt_compile_state s = {.Data = fmtString.Data, .Count = fmtString.Count, .Types = null, .ArgCount = -1, .Out = null};
+    s64 count = fmt_compile_segments(s);
+    if (s.Error) {
+        fmt_parse_context(fmtString).on_error(s.Error, s.ErrorPosition);
+        return result;
+    }
+
+    array_reserve_exact(result.Segments, count);
+    result.Segments.Count = count;
+
+    s = fmt_compile_state{.Data = fmtString.Data, .Count = fmtString.Count, .Types = null, .ArgCount = -1, .Out = result.Segments.Data};
+    fmt_compile_segments(s);
+
+    if (s.StyleCount) {
+        array_reserve_exact(result.Styles, s.StyleCount);
+        result.Styles.Count = s.StyleCount;
+        For(result.Styles) it = fmt_encoded_style{};
+        fmt_encode_styles(result.Styles.Data, fmtString, result.Segments.Data, count);
+    }
+
+    result.Valid = true;
+    return result;
+}
+
+void free(fmt_compiled &compiled) {
+    free(compiled.Segments);
+    free(compiled.Styles);
+    compiled.Valid = false;
+}
+
+void fmt_format_segments(fmt_context *f, const fmt_segment *segments, s64 count, bool checkArgs, const fmt_encoded_style *styles) {
+    fmt_parse_context *p = &f->Parse;
+
+    For(range(count)) {
+        const fmt_segment &segment = segments[it];
+
+        if (segment.Kind == fmt_segment::LITERAL) {
+            write_no_specs(f, p->FormatString.Data + segment.Begin, segment.Count);
+            continue;
+        }
+
+        if (segment.Kind == fmt_segment::STYLE && styles) {
+            auto *style = styles + segment.ArgId;
+            if (!style->Valid) return;  // The error was reported when encoding
+
+            if (!Context.FmtDisableAnsiCodes) write_no_specs(f, style->Data, style->Count);
+            continue;
+        }
+
+        // Formatters and the text style parser report errors relative to _It_
+        p->It = string(p->FormatString.Data + segment.Begin, p->FormatString.Count - segment.Begin);
+
+        if (segment.Kind == fmt_segment::STYLE) {
+            auto [success, style] = fmt_parse_text_style(p);
+            if (!success) return;
+            if (!p->It.Count || p->It[0] != '}') {
+                f->on_error("\"}\" expected");
+                return;
+            }
+
+            write_text_style(f, style);
+            continue;
+        }
+
+        fmt_arg<fmt_context> arg;
+        if (checkArgs) {
+            arg = fmt_get_arg_from_index(f, segment.ArgId);
+            if (arg.Type == fmt_type::NONE) return;  // The error was reported in _fmt_get_arg_from_index_
+        } else {
+            arg = get_arg<fmt_context>(f->Args, segment.ArgId);  // Checked at compile time
+        }
+
+        if (!segment.HasSpecs) {
+            fmt_visit_fmt_arg(fmt_context_visitor(f), arg);
+            continue;
+        }
+
+        fmt_dynamic_specs specs = segment.Specs;
+        if (checkArgs) {
+            // Same checks as fmt_parse_specs, which couldn't do them because the segments were compiled without the arguments
+            if (specs.Align == fmt_alignment::NUMERIC || specs.Hash) p->require_arithmetic_arg(arg.Type);
+            if (specs.Sign != fmt_sign::NONE) p->require_signed_arithmetic_arg(arg.Type);
+            if (specs.Precision != -1 || specs.PrecisionIndex != -1) p->check_precision_for_arg(arg.Type);
+        }
+
+        f->Specs = &specs;
+
+        bool success = fmt_handle_dynamic_specs(f);
+        if (success) fmt_visit_fmt_arg(fmt_context_visitor(f), arg);
+
+        f->Specs = null;
+        if (!success) return;
+    }
+}
+
+// Exact length of an argument without specs, for the types where it's cheap to know. -1 otherwise.
+s64 fmt_arg_length_no_specs(const fmt_arg<fmt_context> &arg) {
+    switch (arg.Type) {
+        case fmt_type::S64: {
+            s64 v = arg.Value.S64;
+            return count_digits(v < 0 ? 0 - (u64) v : (u64) v) + (v < 0 ? 1 : 0);
+        }
+        case fmt_type::U64:
+            return count_digits(arg.Value.U64);
+        case fmt_type::BOOL:
+            return arg.Value.S64 ? 4 : 5;
+        case fmt_type::STRING:
+            return arg.Value.String.Count;
+        case fmt_type::POINTER:
+            return 2 + count_digits<4>(types::bit_cast<u64>(arg.Value.Pointer));
+        default:
+            return -1;
+    }
+}
+
+// Upper bound of the length of a float with _specs_ (see write_float)
+s64 fmt_estimate_float_length(f64 value, const fmt_specs *specs) {
+    if (!is_finite(value)) return 5;
+
+    s32 type      = specs ? to_lower(specs->Type) : 0;
+    s32 precision = specs ? specs->Precision : -1;
+    if (precision < 0 && type) precision = 6;
+
+    s64 sign = 1, percentage = type == '%' ? 1 : 0;
+
+    if (type == 'f' || type == '%') {
+        // Digits before the point: the binary exponent times log10(2), rounded up, +2 for the * 100 of '%'
+        s32 exp2           = (s32) ((types::bit_cast<u64>(value) >> 52) & 0x7ff) - 1023;
+        s64 integralDigits = exp2 < 0 ? 1 : exp2 * 30103 / 100000 + 2 + 2 * percentage;
+        return sign + integralDigits + 1 + precision + percentage;
+    }
+
+    // At most max(precision, 17) significant digits, a point, and either "e-308" or up to 4 leading "0.000"
+    return sign + max(precision + 1, 17) + 1 + 5;
+}
+
+// Upper bound of the length of an argument, without formatting it. -1 for custom types - only their formatter knows.
+s64 fmt_estimate_arg_length(const fmt_arg<fmt_context> &arg, const fmt_specs *specs) {
+    s64 length = -1;
+    if (!specs) {
+        length = fmt_arg_length_no_specs(arg);
+        if (length >= 0) return length;
+    }
+
+    switch (arg.Type) {
+        case fmt_type::S64:
+        case fmt_type::U64: {
+            u64 v = arg.Type == fmt_type::S64 && arg.Value.S64 < 0 ? 0 - (u64) arg.Value.S64 : arg.Value.U64;
+
+            s32 type = to_lower(specs->Type);
+            if (type == 'b') {
+                length = count_digits<1>(v);
+            } else if (type == 'o') {
+                length = count_digits<3>(v);
+            } else if (type == 'x') {
+                length = count_digits<4>(v);
+            } else if (type == 'c') {
+                length = 4;
+            } else {
+                length = count_digits(v);
+                if (type == 'n') length += (length - 1) / 3;
+            }
+            length = max<s64>(length, specs->Precision) + 3;  // Sign and "0x"
+            break;
+        }
+        case fmt_type::BOOL:
+            length = 5;
+            break;
+        case fmt_type::F32:
+            length = fmt_estimate_float_length(arg.Value.F32, specs);
+            break;
+        case fmt_type::F64:
+            length = fmt_estimate_float_length(arg.Value.F64, specs);
+            break;
+        case fmt_type::STRING:
+            length = arg.Value.String.Count;  // Precision only makes it shorter
+            break;
+        case fmt_type::POINTER:
+            length = 2 + 16;
+            break;
+        default:
+            return -1;
+    }
+
+    if (specs) length += specs->Width * get_size_of_cp(specs->Fill);
+    return length;
+}
+
+s64 fmt_estimate_segments_length(const fmt_args &args, const fmt_segment *segments, s64 count) {
+    s64 result = 0;
+    For(range(count)) {
+        const fmt_segment &segment = segments[it];
+
+        if (segment.Kind == fmt_segment::LITERAL) {
+            result += segment.Count;
+        } else if (segment.Kind == fmt_segment::STYLE) {
+            result += FMT_TEXT_STYLE_MAX_LENGTH;
+        } else {
+            if (segment.Specs.WidthIndex != -1 || segment.Specs.PrecisionIndex != -1) return -1;
+
+            auto arg = get_arg<fmt_context>(args, segment.ArgId);
+            if (arg.Type == fmt_type::NONE) return -1;  // Out of range, the formatter reports that
+
+            s64 length = fmt_estimate_arg_length(arg, segment.HasSpecs ? &segment.Specs : null);
+            if (length < 0) return -1;
+            result += length;
+        }
+    }
+    return result;
+}
+
+// Same as fmt_format_segments into a counting_writer, except that arguments whose length
+// we can get from fmt_arg_length_no_specs() don't get formatted.
+s64 fmt_calculate_segments_length(fmt_context *f, const fmt_segment *segments, s64 count, bool checkArgs) {
+    counting_writer counter;
+    f->Out = &counter;
+
+    For(range(count)) {
+        const fmt_segment &segment = segments[it];
+
+        if (segment.Kind == fmt_segment::LITERAL) {
+            counter.Count += segment.Count;
+            continue;
+        }
+
+        if (segment.Kind == fmt_segment::ARG && !segment.HasSpecs) {
+            fmt_arg<fmt_context> arg;
+            if (checkArgs) {
+                f->Parse.It = string(f->Parse.FormatString.Data + segment.Begin, f->Parse.FormatString.Count - segment.Begin);
+
+                arg = fmt_get_arg_from_index(f, segment.ArgId);
+                if (arg.Type == fmt_type::NONE) break;  // The error was reported in _fmt_get_arg_from_index_
+            } else {
+                arg = get_arg<fmt_context>(f->Args, segment.ArgId);
+            }
+
+            s64 length = fmt_arg_length_no_specs(arg);
+            if (length >= 0) {
+                counter.Count += length;
+                continue;
+            }
+        }
+
+        fmt_format_segments(f, &segment, 1, checkArgs);
+    }
+    return counter.Count;
+}
+
+template <fmt_literal Lit, typename... Args>
+void fmt_to_writer(writer *out, fmt_compiled_string<Lit>, Args &&...arguments) {
+    using compiled = fmt_compiled_segments<Lit, Args...>;
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    auto f    = fmt_context(out, string(Lit.Data, Lit.Count), args);
+
+    const fmt_encoded_style *styles = null;
+    if constexpr (compiled::StyleCount) styles = fmt_literal_styles<Lit, compiled::StyleCount>(compiled::Segments.Data, compiled::Count);
+
+    fmt_format_segments(&f, compiled::Segments.Data, compiled::Count, false, styles);
+    f.flush();
+}
+
+template <fmt_literal Lit, typename... Args>
+s64 fmt_calculate_length(fmt_compiled_string<Lit>, Args &&...arguments) {
+    using compiled = fmt_compiled_segments<Lit, Args...>;
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    auto f    = fmt_context(null, string(Lit.Data, Lit.Count), args);
+    return fmt_calculate_segments_length(&f, compiled::Segments.Data, compiled::Count, false);
+}
+
+template <fmt_literal Lit, typename... Args>
+s64 fmt_estimate_length(fmt_compiled_string<Lit>, Args &&...arguments) {
+    using compiled = fmt_compiled_segments<Lit, Args...>;
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    return fmt_estimate_segments_length(args, compiled::Segments.Data, compiled::Count);
+}
+
+template <fmt_literal Lit, typename... Args>
+s64 fmt_to_buffer(byte *buffer, s64 size, fmt_compiled_string<Lit> fmtString, Args &&...arguments) {
+    fixed_buffer_writer writer(buffer, size);
+    fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
+    return writer.Count;
+}
+
+template <fmt_literal Lit, typename... Args>
+[[nodiscard("Leak")]] string sprint(fmt_compiled_string<Lit> fmtString, Args &&...arguments) {
+    stack_string_writer writer;
+
+    // Long output goes straight to a heap buffer of the right size instead of filling the stack first
+    stack_string_writer_reserve(writer, fmt_estimate_length(fmtString, ((Args &&) arguments)...));
+
+    fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
+    return stack_string_writer_combine(writer);
+}
+
+template <fmt_literal Lit, typename... Args>
+string tsprint(fmt_compiled_string<Lit> fmtString, Args &&...arguments) {
+    PUSH_ALLOC(Context.TempAlloc) {
+        return sprint(fmtString, ((Args &&) arguments)...);
+    }
+}
+
+template <fmt_literal Lit, typename... Args>
+utf8 *mprint(fmt_compiled_string<Lit> fmtString, Args &&...arguments) {
+    PUSH_ALLOC(Context.TempAlloc) {
+        return to_c_string(sprint(fmtString, ((Args &&) arguments)...));
+    }
+}
+
+template <fmt_literal Lit, typename... Args>
+void print(fmt_compiled_string<Lit> fmtString, Args &&...arguments) {
+    assert(Context.Log && "Context log was null. By default it points to cout.");
+    fmt_to_writer(Context.Log, fmtString, ((Args &&) arguments)...);
+}
+
+template <typename... Args>
+void fmt_to_writer(writer *out, const fmt_compiled &fmtString, Args &&...arguments) {
+    if (!fmtString.Valid) return;  // The error was reported in _fmt_compile_
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    auto f    = fmt_context(out, fmtString.FormatString, args);
+
+    fmt_format_segments(&f, fmtString.Segments.Data, fmtString.Segments.Count, true, fmtString.Styles.Data);
+    f.flush();
+}
+
+template <typename... Args>
+s64 fmt_calculate_length(const fmt_compiled &fmtString, Args &&...arguments) {
+    if (!fmtString.Valid) return 0;
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    auto f    = fmt_context(null, fmtString.FormatString, args);
+    return fmt_calculate_segments_length(&f, fmtString.Segments.Data, fmtString.Segments.Count, true);
+}
+
+template <typename... Args>
+s64 fmt_estimate_length(const fmt_compiled &fmtString, Args &&...arguments) {
+    if (!fmtString.Valid) return 0;
+
+    auto args = fmt_args_on_the_stack(fmt_context{}, ((types::remove_reference_t<Args> &&) arguments)...);
+    return fmt_estimate_segments_length(args, fmtString.Segments.Data, fmtString.Segments.Count);
+}
+
+template <typename... Args>
+s64 fmt_to_buffer(byte *buffer, s64 size, const fmt_compiled &fmtString, Args &&...arguments) {
+    fixed_buffer_writer writer(buffer, size);
+    fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
+    return writer.Count;
+}
+
+template <typename... Args>
+[[nodiscard("Leak")]] string sprint(const fmt_compiled &fmtString, Args &&...arguments) {
+    stack_string_writer writer;
+    stack_string_writer_reserve(writer, fmt_estimate_length(fmtString, ((Args &&) arguments)...));
+    fmt_to_writer(&writer, fmtString, ((Args &&) arguments)...);
+    return stack_string_writer_combine(writer);
+}
+
+template <typename... Args>
+string tsprint(const fmt_compiled &fmtString, Args &&...arguments) {
+    PUSH_ALLOC(Context.TempAlloc) {
+        return sprint(fmtString, ((Args &&) arguments)...);
+    }
+}
+
+template <typename... Args>
+void print(const fmt_compiled &fmtString, Args &&...arguments) {
+    assert(Context.Log && "Context log was null. By default it points to cout.");
+    fmt_to_writer(Context.Log, fmtString, ((Args &&) arguments)...);
+}
+
+//
+// Deferred logging
+//
+
+deferred_log_site DeferredLogSites[DEFERRED_LOG_MAX_SITES];
+u32 DeferredLogSiteCount = 0;
+
+u32 deferred_log_register_site(const string &fmtString, const fmt_type *types, s64 argCount, const fmt_segment *segments, s64 segmentCount) {
+    assert(argCount <= DEFERRED_LOG_MAX_ARGS && "Too many arguments for a deferred log");
+
+    u32 id = atomic_add(&DeferredLogSiteCount, 1u);
+    assert(id < DEFERRED_LOG_MAX_SITES && "Too many deferred log sites, increase DEFERRED_LOG_MAX_SITES");
+
+    auto *site = DeferredLogSites + id;
+    site->FormatString = fmtString;
+    site->ArgCount     = argCount;
+    copy_memory(site->Types, types, argCount * sizeof(fmt_type));
+    site->Segments     = segments;
+    site->SegmentCount = segmentCount;
+    return id;
+}
+
+// Instantiated once per call site (format string and argument types), registers it the first time it's reached
+template <fmt_literal Lit, typename... Args>
+u32 deferred_log_site_id() {
+    using compiled = fmt_compiled_segments<Lit, Args...>;
+    static u32 id  = deferred_log_register_site(string(Lit.Data, Lit.Count), compiled::Types, sizeof...(Args), compiled::Segments.Data, compiled::Count);
+    return id;
+}
+
+template <typename T>
+auto deferred_log_map_arg(const T &v) {
+    auto mapped = fmt_map_arg(v);
+    using M     = decltype(mapped);
+
+    static_assert(!types::is_pointer<M> || types::is_same<M, const void *>,
+                  "Custom types can't be logged deferred (their formatters aren't available to the decoder), log their fields instead");
+
+    if constexpr (types::is_same<M, bool>) {
+        return (s64) mapped;  // fmt stores bools as s64 too
+    } else {
+        return mapped;
+    }
+}
+
+template <typename T>
+s64 deferred_log_arg_size(const T &v) {
+    auto mapped = deferred_log_map_arg(v);
+    if constexpr (types::is_same<decltype(mapped), string>) {
+        return sizeof(s64) + mapped.Count;
+    } else {
+        return sizeof(mapped);
+    }
+}
+
+template <typename T>
+void deferred_log_write_arg(writer *out, const T &v) {
+    auto mapped = deferred_log_map_arg(v);
+    if constexpr (types::is_same<decltype(mapped), string>) {
+        s64 count = mapped.Count;
+        out->write((const byte *) &count, sizeof(count));
+        out->write((const byte *) mapped.Data, count);
+    } else {
+        out->write((const byte *) &mapped, sizeof(mapped));
+    }
+}
+
+// A record is this header followed by the arguments
+struct deferred_log_record_header {
+    u32 Size;  // Of the arguments
+    u32 Site;
+};
+
+template <fmt_literal Lit, typename... Args>
+void deferred_log(writer *out, fmt_compiled_string<Lit>, const Args &...arguments) {
+    deferred_log_record_header header = {(u32) (0 + ... + deferred_log_arg_size(arguments)), deferred_log_site_id<Lit, Args...>()};
+    out->write((const byte *) &header, sizeof(header));
+    (deferred_log_write_arg(out, arguments), ...);
+    out->flush();
+}
+
+void deferred_log_format_record(deferred_log_decoder *d, const byte *record) {
+    deferred_log_record_header header;
+    copy_memory(&header, record, sizeof(header));
+
+    const deferred_log_site *site = null;
+    if (d->Sites.Count) {
+        if (header.Site < d->Sites.Count) site = d->Sites.Data + header.Site;
+    } else {
+        if (header.Site < atomic_load(&DeferredLogSiteCount)) site = DeferredLogSites + header.Site;
+    }
+
+    if (!site) {
+        assert(false && "Unknown deferred log site, load the sites of the process which wrote the records");
+        return;
+    }
+
+    fmt_arg<fmt_context> args[DEFERRED_LOG_MAX_ARGS];
+
+    const byte *p = record + sizeof(header);
+    For(range(site->ArgCount)) {
+        auto *arg = args + it;
+        arg->Type = site->Types[it];
+
+        switch (arg->Type) {
+            case fmt_type::S64:
+            case fmt_type::U64:
+            case fmt_type::BOOL:
+                copy_memory(&arg->Value.S64, p, sizeof(s64));
+                p += sizeof(s64);
+                break;
+            case fmt_type::F32:
+                copy_memory(&arg->Value.F32, p, sizeof(f32));
+                p += sizeof(f32);
+                break;
+            case fmt_type::F64:
+                copy_memory(&arg->Value.F64, p, sizeof(f64));
+                p += sizeof(f64);
+                break;
+            case fmt_type::POINTER:
+                copy_memory(&arg->Value.Pointer, p, sizeof(void *));
+                p += sizeof(void *);
+                break;
+            case fmt_type::STRING: {
+                s64 count;
+                copy_memory(&count, p, sizeof(count));
+                p += sizeof(count);
+                arg->Value.String = string((const utf8 *) p, count);
+                p += count;
+                break;
+            }
+            default:
+                assert(false && "Invalid argument type in a deferred log site");
+                return;
+        }
+    }
+
+    fmt_args fmtArgs;
+    fmtArgs.Data  = args;
+    fmtArgs.Count = site->ArgCount;
+    fmtArgs.Types = fmt_internal::IS_UNPACKED_BIT | (u64) site->ArgCount;
+
+    auto f = fmt_context(d->Out, site->FormatString, fmtArgs);
+    if (site->Segments) {
+        fmt_format_segments(&f, site->Segments, site->SegmentCount, false);
+    } else {
+        fmt_parse_and_format(&f);
+    }
+}
+
+// Returns 0 if _data_ doesn't hold a whole record
+s64 deferred_log_record_size(const byte *data, s64 count) {
+    if (count < (s64) sizeof(deferred_log_record_header)) return 0;
+
+    deferred_log_record_header header;
+    copy_memory(&header, data, sizeof(header));
+
+    s64 size = sizeof(header) + header.Size;
+    return count < size ? 0 : size;
+}
+
+void deferred_log_decoder::write(const byte *data, s64 count) {
+    // Finish the record which was split
+    while (Pending.Count && count) {
+        s64 need = sizeof(deferred_log_record_header) - Pending.Count;
+        if (need <= 0) {
+            deferred_log_record_header header;
+            copy_memory(&header, Pending.Data, sizeof(header));
+            need = sizeof(header) + header.Size - Pending.Count;
+        }
+
+        s64 n = min(need, count);
+        array_append(Pending, data, n);
+        data += n;
+        count -= n;
+
+        if (deferred_log_record_size(Pending.Data, Pending.Count)) {
+            deferred_log_format_record(this, Pending.Data);
+            array_reset(Pending);
+        }
+    }
+
+    // Whole records straight from _data_
+    while (s64 size = deferred_log_record_size(data, count)) {
+        deferred_log_format_record(this, data);
+        data += size;
+        count -= size;
+    }
+
+    if (count) array_append(Pending, data, count);
+}
+
+void free(deferred_log_decoder &decoder) {
+    free(decoder.Sites);
+    free(decoder.SiteData);
+    free(decoder.Pending);
+}
+
+//
+// Site table: u32 count, then for each site: u32 argument count, the argument types (one byte each),
+// s64 format string size and the format string.
+//
+
+bytes deferred_log_serialize_sites() {
+    u32 count = atomic_load(&DeferredLogSiteCount);
+
+    bytes result;
+    array_append(result, (const byte *) &count, sizeof(count));
+    For(range(count)) {
+        auto *site = DeferredLogSites + it;
+
+        u32 argCount = (u32) site->ArgCount;
+        array_append(result, (const byte *) &argCount, sizeof(argCount));
+        For_as(i, range(argCount)) array_append(result, (byte) site->Types[i]);
+
+        s64 size = site->FormatString.Count;
+        array_append(result, (const byte *) &size, sizeof(size));
+        array_append(result, (const byte *) site->FormatString.Data, size);
+    }
+    return result;
+}
+
+bool deferred_log_decoder_load_sites(deferred_log_decoder &decoder, const bytes &data) {
+    array<deferred_log_site> sites;
+    bytes siteData;
+    clone(&siteData, data);
+
+    bool valid = false;
+    defer({
+        if (!valid) {
+            free(sites);
+            free(siteData);
+        }
+    });
+
+    const byte *p = siteData.Data, *end = siteData.Data + siteData.Count;
+
+    u32 count;
+    if (end - p < (s64) sizeof(count)) return false;
+    copy_memory(&count, p, sizeof(count));
+    p += sizeof(count);
+
+    For(range(count)) {
+        deferred_log_site site;
+
+        u32 argCount;
+        if (end - p < (s64) sizeof(argCount)) return false;
+        copy_memory(&argCount, p, sizeof(argCount));
+        p += sizeof(argCount);
+
+        if (argCount > DEFERRED_LOG_MAX_ARGS || end - p < argCount) return false;
+        site.ArgCount = argCount;
+        For_as(i, range(argCount)) site.Types[i] = (fmt_type) p[i];
+        p += argCount;
+
+        s64 size;
+        if (end - p < (s64) sizeof(size)) return false;
+        copy_memory(&size, p, sizeof(size));
+        p += sizeof(size);
+
+        if (size < 0 || end - p < size) return false;
+        site.FormatString = string((const utf8 *) p, size);
+        p += size;
+
+        array_append(sites, site);
+    }
+    if (p != end) return false;
+
+    valid = true;
+
+    free(decoder.Sites);
+    free(decoder.SiteData);
+    decoder.Sites    = sites;
+    decoder.SiteData = siteData;
+    return true;
+}
+
 LSTD_END_NAMESPACE
@@ -20,6 +20,7 @@ export {
         string It;  // How much left we have to parse from the format string
 
         s32 NextArgID = 0;
+        s32 ErrorCount = 0;  // Errors reported so far (the handler may not stop the formatting)
 
         fmt_parse_context(const string &formatString = "") : FormatString(formatString), It(formatString) {}
 
@@ -76,6 +77,7 @@ export {
         // This is only used to provide useful error messages.
         inline void on_error(const string &message, s64 position = -1) {
             if (position == -1) position = It.Data - FormatString.Data;
+            ++ErrorCount;
             Context.FmtParseErrorHandler(message, FormatString, position);
         }
     };
@@ -91,6 +91,9 @@ export {
         u8 Emphasis = 0;
     };
 
+    // The longest escape sequence of a text style - a 24 bit color and all four kinds of emphasis
+    constexpr s64 FMT_TEXT_STYLE_MAX_LENGTH = 7 + 3 * 4 + 4 * 4;
+
     namespace fmt_internal {
     // Used when making ANSI escape codes for text styles
     inline utf8 *u8_to_esc(utf8 *p, utf8 delimiter, u8 c) {
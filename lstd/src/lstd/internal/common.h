@@ -2,11 +2,13 @@
 
 /// A header which provides type definitions as well as other helper macros
 
-#include <intrin.h>
-
 #include "../types.h"
 #include "debug_break.h"
 
+#if COMPILER == MSVC
+#include <intrin.h>  // _BitScanReverse, __popcnt64, _mm_pause...
+#endif
+
 //
 // Provides replacements for the math functions found in virtually all standard libraries.
 // Also provides functions for extended precision arithmetic, statistical functions, physics, astronomy, etc.
@@ -417,6 +419,11 @@ constexpr void *const_fill_memory(void *dst, char value, u64 size) {
     return dst;
 }
 
+// Copies and fills of at least this many bytes (between buffers which don't overlap) use non-temporal stores
+// which go around the cache, so a multi-megabyte copy doesn't evict everyone else's data. Set to 3/4 of our share
+// of the last level cache (at least 1 MB) when we detect the CPU features (see get_cpu_features()), unless you've set it before that.
+extern u64 NonTemporalThreshold;
+
 inline void *zero_memory(void *dst, u64 size) { return fill_memory(dst, 0, size); }
 constexpr void *const_zero_memory(void *dst, u64 size) { return const_fill_memory(dst, 0, size); }
 
@@ -427,6 +434,10 @@ constexpr void *const_zero_memory(void *dst, u64 size) { return const_fill_memor
 //	returns 2
 // If the memory regions are equal, the returned value is -1
 extern s64 (*compare_memory)(const void *ptr1, const void *ptr2, u64 size);
+
+// Same as compare_memory(...) == -1, but faster since it doesn't need to find where the difference is.
+extern bool (*equal_memory)(const void *ptr1, const void *ptr2, u64 size);
+
 constexpr s64 const_compare_memory(const void *ptr1, const void *ptr2, u64 size) {
     // @TODO: This doesn't work. Complains about casting.
     auto *s1 = (byte *) ptr1;
@@ -436,6 +447,61 @@ constexpr s64 const_compare_memory(const void *ptr1, const void *ptr2, u64 size)
     return -1;
 }
 
+//
+// Runtime CPU feature detection, used to pick SIMD paths so one binary runs on old CPUs and is fast on new ones.
+// The AVX and AVX-512 flags are only set if the OS also saves the wider registers on context switches.
+// (The X86_SSE4_2-style macros in platform.h tell what the compiler may assume, these tell what the CPU running us has.)
+//
+struct cpu_features {
+    bool SSE2, SSE3, SSSE3, SSE41, SSE42, POPCNT;
+    bool AVX, AVX2, FMA, F16C, BMI1, BMI2;
+    bool AVX512F, AVX512BW, AVX512VL;
+    bool ERMS, FSRM;  // Enhanced REP MOVSB/STOSB, fast short REP MOVSB
+    bool RDTSCP;
+    bool INVARIANT_TSC;  // The time stamp counter runs at a constant rate in all power states and is synced between cores
+};
+
+// Detected with cpuid the first time it's called (the platform layer calls it at startup).
+const cpu_features &get_cpu_features();
+
+// The nominal frequency of the time stamp counter from cpuid (leaf 0x15), 0 if the CPU doesn't report it.
+// Most AMD CPUs and older Intel ones don't, then the counter has to be measured against another clock (see os_clock).
+u64 get_cpu_tsc_frequency();
+
+// Pretends the CPU only has the features in _features_ which it really has, e.g. to test the fallback paths.
+// copy_memory, fill_memory, compare_memory, equal_memory and the kernels picked with cpu_dispatch_get() are rebound.
+// Don't call this while other threads are running kernels.
+void cpu_features_override(const cpu_features &features);
+
+// Undoes cpu_features_override().
+void cpu_features_reset();
+
+// Bumped every time the features change. Starts at 1 so a zeroed cpu_dispatch is never current.
+extern u32 CpuDispatchGeneration;
+
+// A function pointer which is bound to the best implementation for the current features:
+//
+//     local_persist cpu_dispatch<utf8_length_func> kernel;
+//     auto *func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> utf8_length_func {
+//         return cpu.AVX2 ? utf8_length_avx2 : utf8_length_sse2;
+//     });
+//
+// _pick_ runs on the first call and again after the features change.
+template <typename F>
+struct cpu_dispatch {
+    F Func;
+    u32 Generation;
+};
+
+template <typename F, typename Pick>
+always_inline F cpu_dispatch_get(cpu_dispatch<F> &d, Pick pick) {
+    if (d.Generation != CpuDispatchGeneration) {
+        d.Func = pick(get_cpu_features());
+        d.Generation = CpuDispatchGeneration;
+    }
+    return d.Func;
+}
+
 #if COMPILER == MSVC
 #pragma intrinsic(_BitScanReverse)
 #pragma intrinsic(_BitScanReverse64)
@@ -473,6 +539,10 @@ constexpr always_inline s32 msb(T x) {
                 unsigned long r = 0;
                 return _BitScanReverse(&r, x) ? ((s32) r) : -1;
             }
+#else
+            if (!x) return -1;
+            if constexpr (sizeof(T) == 8) return 63 - __builtin_clzll(x);
+            else return 31 - __builtin_clz((u32) x);
 #endif
         }
     }
@@ -502,11 +572,28 @@ constexpr always_inline s32 lsb(types::is_unsigned_integral auto x) {
                 unsigned long r = 0;
                 return _BitScanForward(&r, x) ? ((s32) r) : -1;
             }
+#else
+            if (!x) return -1;
+            if constexpr (sizeof(x) == 8) return __builtin_ctzll(x);
+            else return __builtin_ctz((u32) x);
 #endif
         }
     }
 }
 
+// Returns the number of set bits.
+constexpr always_inline s32 pop_count(u64 x) {
+#if X86_SSE4_2 && COMPILER == MSVC
+    if (!is_constant_evaluated()) return (s32) __popcnt64(x);
+#elif COMPILER != MSVC
+    if (!is_constant_evaluated()) return __builtin_popcountll(x);
+#endif
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (s32) ((x * 0x0101010101010101ULL) >> 56);
+}
+
 constexpr u32 rotate_left_32(u32 x, u32 bits) { return (x << bits) | (x >> (32 - bits)); }
 constexpr u64 rotate_left_64(u64 x, u32 bits) { return (x << bits) | (x >> (64 - bits)); }
 
@@ -595,13 +682,17 @@ always_inline u32 count_digits(types::is_unsigned_integral auto n) {
 
 template <u32 Bits, types::is_integral T>
 constexpr u32 count_digits(T value) {
-    T n = value;
+    if constexpr (types::is_unsigned_integral<T> && sizeof(T) <= 8) {
+        return (u32) msb((T) (value | 1)) / Bits + 1;  // Number of digits in base 2^Bits is [log_2(n) / Bits] + 1
+    } else {
+        T n = value;
 
-    u32 numDigits = 0;
-    do {
-        ++numDigits;
-    } while ((n >>= Bits) != 0);
-    return numDigits;
+        u32 numDigits = 0;
+        do {
+            ++numDigits;
+        } while ((n >>= Bits) != 0);
+        return numDigits;
+    }
 }
 
 //
@@ -648,11 +739,81 @@ always_inline constexpr T atomic_compare_and_swap(T *ptr, T exchange, T comperan
     if constexpr (sizeof(T) == 4) return (T) _InterlockedCompareExchange((volatile long *) ptr, exchange, comperand);
     if constexpr (sizeof(T) == 8) return (T) _InterlockedCompareExchange64((volatile long long *) ptr, exchange, comperand);
 }
+
+// Reads the value in _ptr_ with acquire semantics (reads and writes after this don't get moved before it).
+// Much cheaper than the atomic_compare_and_swap(&value, 0, 0) trick, use this when you just need the value.
+template <appropriate_for_atomic T>
+always_inline T atomic_load(const T *ptr) {
+#if ARCH == X86
+    // x86 doesn't reorder loads with other loads or stores after them, we only need to stop the compiler
+    T value = *(const volatile T *) ptr;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return atomic_compare_and_swap((T *) ptr, (T) 0, (T) 0);
+#endif
+}
+
+// Writes _value_ to _ptr_ with release semantics (reads and writes before this don't get moved after it).
+template <appropriate_for_atomic T>
+always_inline void atomic_store(T *ptr, T value) {
+#if ARCH == X86
+    // x86 doesn't reorder stores with other stores or loads before them, we only need to stop the compiler
+    _ReadWriteBarrier();
+    *(volatile T *) ptr = value;
 #else
-#define atomic_inc(ptr) __sync_add_and_fetch((ptr), 1)
-#define atomic_inc_64(ptr) __sync_add_and_fetch((ptr), 1)
-#error Some atomic operations not implemented
+    atomic_swap(ptr, value);
 #endif
+}
+#else
+// GCC and Clang. These return the same values as the MSVC versions above (atomic_inc returns the incremented value,
+// the rest return the old one), everything is sequentially consistent like the Interlocked functions except the load and store.
+
+template <appropriate_for_atomic T>
+always_inline T atomic_inc(T *ptr) {
+    return __atomic_add_fetch(ptr, (T) 1, __ATOMIC_SEQ_CST);
+}
+
+template <appropriate_for_atomic T>
+always_inline T atomic_add(T *ptr, T value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+template <appropriate_for_atomic T>
+always_inline T atomic_swap(T *ptr, T value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+template <appropriate_for_atomic T>
+always_inline T atomic_compare_and_swap(T *ptr, T exchange, T comperand) {
+    __atomic_compare_exchange_n(ptr, &comperand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comperand;  // Holds the old value whether the exchange happened or not
+}
+
+template <appropriate_for_atomic T>
+always_inline T atomic_load(const T *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+template <appropriate_for_atomic T>
+always_inline void atomic_store(T *ptr, T value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+#endif
+
+// Call in spin-wait loops. On x86 it's the pause instruction: the core doesn't flood the memory system with reads,
+// leaves more of itself to the other hyper-thread and doesn't pay for a mis-speculated memory order when the loop exits.
+always_inline void cpu_pause() {
+#if ARCH == X86 && COMPILER == MSVC
+    _mm_pause();
+#elif ARCH == X86
+    __builtin_ia32_pause();
+#elif ARCH == ARM && COMPILER == MSVC
+    __yield();
+#elif ARCH == ARM
+    __asm__ __volatile__("yield");
+#endif
+}
 
 // Function for swapping endianness. You can check for the endianness by using #if ENDIAN = LITTLE_ENDIAN, etc.
 always_inline constexpr void byte_swap_2(void *ptr) {
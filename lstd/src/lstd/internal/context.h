@@ -100,6 +100,9 @@ struct context {
     // e.g. using the LEAK flag, you can mark the allocations done in a whole scope as leaks (don't get reported when calling DEBUG_memory->report_leaks()).
     u64 AllocOptions = 0;
 
+    // Allocations are counted under this tag, change it with the MEMORY_TAG macro. See memory_tag_get() in allocator.h.
+    u8 MemoryTag = 0;
+
     bool LogAllAllocations = false;  // Used for debugging. Every time an allocation is made, logs info about it.
 
     // Gets called when the program encounters an unhandled expection.
@@ -148,6 +151,9 @@ inline const thread_local context Context;
 // stuff should work if it is copied byte by byte.
 inline const thread_local arena_allocator_data __TempAllocData;
 
+// Not used by default, see frame_allocator in allocator.h
+inline const thread_local frame_allocator_data __FrameTempAllocData;
+
 
 // This is a helper macro to safely modify a variable in the implicit context in a block of code.
 // Usage:
@@ -185,10 +191,72 @@ inline const thread_local arena_allocator_data __TempAllocData;
             } else                                        \
                 LINE_NAME(body) :
 
-#define PUSH_ALLOC(newAlloc)                              \
-    auto LINE_NAME(newContext) = LSTD_NAMESPACE::Context; \
-    LINE_NAME(newContext).Alloc = newAlloc;               \
-    PUSH_CONTEXT(LINE_NAME(newContext))
+// Same as PUSH_CONTEXT and OVERRIDE_CONTEXT but for one variable, only that variable is saved and restored
+// (PUSH_CONTEXT copies the whole context twice, which adds up in hot code):
+//
+//    PUSH_CONTEXT_VAR(FmtDisableAnsiCodes, true) {
+//        ... code with the new value ...
+//    }
+//
+// Changes to other variables inside the block (with OVERRIDE_CONTEXT) aren't undone at the end of it.
+#define OVERRIDE_CONTEXT_VAR(var, newValue) ((LSTD_NAMESPACE::context *) &LSTD_NAMESPACE::Context)->var = (newValue)
+
+#define PUSH_CONTEXT_VAR(var, newValue)                         \
+    auto LINE_NAME(oldValue) = LSTD_NAMESPACE::Context.var;     \
+    auto LINE_NAME(restored) = false;                           \
+    defer({                                                     \
+        if (!LINE_NAME(restored)) {                             \
+            OVERRIDE_CONTEXT_VAR(var, LINE_NAME(oldValue));     \
+        }                                                       \
+    });                                                         \
+    if (true) {                                                 \
+        OVERRIDE_CONTEXT_VAR(var, newValue);                    \
+        goto LINE_NAME(body);                                   \
+    } else                                                      \
+        while (true)                                            \
+            if (true) {                                         \
+                OVERRIDE_CONTEXT_VAR(var, LINE_NAME(oldValue)); \
+                LINE_NAME(restored) = true;                     \
+                break;                                          \
+            } else                                              \
+                LINE_NAME(body) :
+
+// Allocations in the following block go to _newAlloc_ by default. Only saves and restores Context.Alloc.
+//
+// Containers stay with the allocator they first allocated with (growing goes through the allocator in the
+// header of the old block), so instead of pushing an allocator around every append you can bind it once:
+//     array_reserve(arr, 64, array_growth::DEFAULT, TreeAlloc);
+//     reserve(table, 64, 0, TreeAlloc);
+//     builder.Alloc = TreeAlloc;
+#define PUSH_ALLOC(newAlloc) PUSH_CONTEXT_VAR(Alloc, newAlloc)
+
+// Allocations in the following block are counted under the memory tag _name_ (a literal). Only saves and restores Context.MemoryTag.
+// The tag is looked up once per place the macro is used.
+#define MEMORY_TAG(name) PUSH_CONTEXT_VAR(MemoryTag, ([] { static auto tag = LSTD_NAMESPACE::memory_tag_get(name); return tag; }()))
+
+namespace internal {
+// What thread::init_and_launch hands to the new thread (the wrappers in windows_thread.cpp and posix_thread.cpp).
+// These are reused from a free list (see thread.cpp), so launching a thread doesn't hit the allocator.
+struct thread_start_info {
+    owning_delegate<void(void *)> Function;  // Freed when the record goes back to the free list
+    void *UserData = null;
+
+    thread::thread *ThreadPtr = null;
+    void *Module              = null;  // Keeps the module the thread runs in loaded, only used on Windows
+
+    u32 Inherit = thread::THREAD_INHERIT_ALL;
+    context Parent;  // A copy taken at launch, the launching thread may change (or lose) its Context right after
+
+    thread_start_info *NextFree = null;
+};
+
+// Takes a record from the free list (or makes one) and fills it in, including the copy of our Context
+thread_start_info *thread_start_info_acquire(const owning_delegate<void(void *)> &function, void *userData, thread::thread *t, u32 inherit);
+void thread_start_info_release(thread_start_info *ti);
+
+// Called by the new thread first thing, once its Context has the defaults. Copies what ti->Inherit asks for.
+void thread_start_inherit_context(const thread_start_info *ti);
+}  // namespace internal
 
 //
 // These were moved from allocator.h where they made sense to be, but we need to access Context.Alloc here.
@@ -226,23 +294,53 @@ inline void *operator new[](size_t, void *p) noexcept { return p; }
 
 LSTD_BEGIN_NAMESPACE
 
-template <non_void T>
-T *lstd_allocate_impl(s64 count, allocator alloc, u32 alignment, u64 options, source_location loc) {
-    s64 size = count * sizeof(T);
-
-    if (!alloc) alloc = Context.Alloc;
-    assert(alloc && "Context allocator was null. The programmer should set it before calling allocate functions.");
+// allocate_array() and reallocate_array() construct new elements with "new (p) T" one by one. We skip that loop when
+// it wouldn't do anything (scalars and types without constructors) and use one zero_memory() when it would only zero the memory.
+//
+// A constructor written by the user isn't trivial even if it's empty, so types can opt in with a member:
+//     static constexpr bool NO_INIT_CONSTRUCT = true;   // The constructor leaves the memory as is (e.g. vec and mat, see :MathTypesNoInit)
+//     static constexpr bool ZERO_CONSTRUCT = true;      // The constructor only sets members to 0/null (e.g. array and string)
+template <typename T>
+concept no_init_constructible = types::is_scalar<T> || types::is_trivially_default_constructible<T> || requires { requires T::NO_INIT_CONSTRUCT; };
 
-    auto *result = (T *) general_allocate(alloc, size, alignment, options, loc);
+template <typename T>
+concept zero_constructible = !no_init_constructible<T> && requires { requires T::ZERO_CONSTRUCT; };
 
-    if constexpr (!types::is_scalar<T>) {
-        auto *p = result;
-        auto *end = result + count;
+template <non_void T>
+void construct_elements(T *p, s64 count) {
+    if constexpr (no_init_constructible<T>) {
+        return;
+    } else if constexpr (zero_constructible<T>) {
+        zero_memory(p, count * sizeof(T));
+    } else {
+        auto *end = p + count;
         while (p != end) {
             new (p) T;
             ++p;
         }
     }
+}
+
+template <non_void T>
+void destroy_elements(T *p, s64 count) {
+    if constexpr (!types::is_trivially_destructible<T>) {
+        auto *end = p + count;
+        while (p != end) {
+            p->~T();
+            ++p;
+        }
+    }
+}
+
+template <non_void T>
+T *lstd_allocate_impl(s64 count, allocator alloc, u32 alignment, u64 options, source_location loc, bool construct = true) {
+    s64 size = count * sizeof(T);
+
+    if (!alloc) alloc = Context.Alloc;
+    assert(alloc && "Context allocator was null. The programmer should set it before calling allocate functions.");
+
+    auto *result = (T *) general_allocate(alloc, size, alignment, options, loc);
+    if (result && construct) construct_elements(result, count);
     return result;
 }
 
@@ -258,33 +356,13 @@ requires(!types::is_const<T>) T *lstd_reallocate_array_impl(T *block, s64 newCou
     // so we leave that up to the call site.
     assert(newCount != 0);
 
-    auto *header = (allocation_header *) block - 1;
-    s64 oldCount = header->Size / sizeof(T);
-
-    if constexpr (!types::is_scalar<T>) {
-        if (newCount < oldCount) {
-            auto *p = block + newCount;
-            auto *end = block + oldCount;
-            while (p != end) {
-                p->~T();
-                ++p;
-            }
-        }
-    }
+    s64 oldCount = allocation_get_size(block) / sizeof(T);
+    if (newCount < oldCount) destroy_elements(block + newCount, oldCount - newCount);
 
     s64 newSize = newCount * sizeof(T);
     auto *result = (T *) general_reallocate(block, newSize, options, loc);
 
-    if constexpr (!types::is_scalar<T>) {
-        if (oldCount < newCount) {
-            auto *p = result + oldCount;
-            auto *end = result + newCount;
-            while (p != end) {
-                new (p) T;
-                ++p;
-            }
-        }
-    }
+    if (result && oldCount < newCount) construct_elements(result + oldCount, newCount - oldCount);
     return result;
 }
 
@@ -312,6 +390,7 @@ requires(!types::is_const<T>) T *lstd_reallocate_array_impl(T *block, s64 newCou
 // All work as expected.
 //
 // Note: allocate and allocate_array call constructors on non-scalar values, free calls destructors (make sure you pass the right pointer type to free!)
+//       See construct_elements() for the types where we skip that.
 //
 // We allocate a bit of space before the block to store a header with information (the size of the allocation, the alignment,
 // the allocator with which it was allocated, and debugging info if DEBUG_MEMORY is defined - see comments in allocator.h).
@@ -370,6 +449,13 @@ T *allocate_array(s64 count, allocate_options options = {}, source_location loc
     return lstd_allocate_impl<T>(count, options.Alloc, options.Alignment, options.Options, loc);
 }
 
+// Doesn't construct the elements, for callers which overwrite all of them right away (e.g. with copy_memory).
+// free() still calls the destructors, so they must be constructed (or written) by then if T has one.
+template <typename T>
+T *allocate_array_uninitialized(s64 count, allocate_options options = {}, source_location loc = source_location::current()) {
+    return lstd_allocate_impl<T>(count, options.Alloc, options.Alignment, options.Options, loc, false);
+}
+
 // Note: We don't support "non-trivially copyable" types (types that can have logic in the copy constructor).
 // We assume your type can be copied to another place in memory and just work.
 // We assume that the destructor of the old copy doesn't invalidate the new copy.
@@ -383,20 +469,8 @@ template <typename T>
 requires(!types::is_const<T>) void free(T *block, u64 options = 0) {
     if (!block) return;
 
-    s64 sizeT = 1;
     if constexpr (!types::is_same<T, void>) {
-        sizeT = sizeof(T);
-    }
-
-    auto *header = (allocation_header *) block - 1;
-    s64 count = header->Size / sizeT;
-
-    if constexpr (!types::is_same<T, void> && !types::is_scalar<T>) {
-        auto *p = block;
-        while (count--) {
-            p->~T();
-            ++p;
-        }
+        if constexpr (!types::is_trivially_destructible<T>) destroy_elements(block, allocation_get_size((void *) block) / sizeof(T));
     }
 
     general_free(block, options);
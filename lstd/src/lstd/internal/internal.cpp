@@ -8,11 +8,11 @@ import fmt;
 LSTD_BEGIN_NAMESPACE
 
 #if ARCH == X86
-#include <emmintrin.h>  //Intel/AMD SSE intrinsics
+#include <immintrin.h>  // Intel/AMD SSE, AVX2 and AVX-512 intrinsics
 #if COMPILER == MSVC
-#include <intrin.h>  // __cpuid (Visual Studio)
+#include <intrin.h>  // __cpuidex, _xgetbv (Visual Studio)
 #else
-#include <cpuid.h>  // __get_cpuid (GCC / Clang)
+#include <cpuid.h>  // __cpuid_count (GCC / Clang)
 #endif
 #endif
 
@@ -965,35 +965,8 @@ void *kryptonite(void *dst, const void *src, u64 size) {
 #pragma warning(pop)
 #endif
 
-// This sets up copy_memory the first time it's called
-file_scope void *dispatcher(void *dst, const void *src, u64 size) {
-#if ARCH == X86
-#if COMPILER == MSVC
-    s32 cpuid[4] = {-1};
-    __cpuid(cpuid, 1);
-#define bit_SSE2 (1 << 26)
-#define bit_SSSE3 (1 << 9)
-#define bit_SSE4_2 (1 << 20)
-#else
-    u32 cpuid[4];  //	GCC / LLVM (Clang)
-    __get_cpuid(1, &cpuid[0], &cpuid[1], &cpuid[2], &cpuid[3]);
-#endif
-    // Detect SSE4.2, available on Core i and newer processors, they include "fast unaligned" memory access
-    if (cpuid[2] & bit_SSE4_2) {
-        copy_memory = &apex::kryptonite;
-    } else {
-        copy_memory = &apex::tiberium;
-    }
-#else
-    copy_memory = &const_copy_memory;
-#endif
-    // Once we set it, actually run it
-    return copy_memory(dst, src, size);
-}
 }  // namespace apex
 
-void *(*copy_memory)(void *dst, const void *src, u64 size) = apex::dispatcher;
-
 //
 // SSE optimized fill_memory
 // If the platform doesn't support SSE, it still writes 4 bytes at a time (instead of 16)
@@ -1034,7 +1007,229 @@ void *optimized_fill_memory(void *dst, char c, u64 size) {
     return dst;
 }
 
-void *(*fill_memory)(void *dst, char value, u64 size) = optimized_fill_memory;
+//
+// Large copies and fills. Above NonTemporalThreshold we use streaming stores (with the widest vectors the CPU has),
+// they go around the cache so copying a big buffer doesn't evict the working set of every other core. Between a
+// couple of KB and that, CPUs with ERMS (enhanced rep movsb) are fastest with rep movsb/stosb. Everything else
+// (small sizes and overlapping copies) goes to kryptonite and optimized_fill_memory.
+//
+
+u64 NonTemporalThreshold;
+
+#if ARCH == X86
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// With ERMS rep movsb beats vector loops above ~2KB, with FSRM (fast short rep movsb) it's good much earlier
+file_scope u64 RepMovsbThreshold;
+
+using stream_copy_func = void (*)(byte *dst, const byte *src, u64 size);
+using stream_fill_func = void (*)(byte *dst, char c, u64 size);
+
+file_scope stream_copy_func StreamCopy;
+file_scope stream_fill_func StreamFill;
+
+file_scope always_inline void rep_movsb(void *dst, const void *src, u64 size) {
+#if COMPILER == MSVC
+    __movsb((unsigned char *) dst, (const unsigned char *) src, size);
+#else
+    asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(size) : : "memory");
+#endif
+}
+
+file_scope always_inline void rep_stosb(void *dst, char c, u64 size) {
+#if COMPILER == MSVC
+    __stosb((unsigned char *) dst, (unsigned char) c, size);
+#else
+    asm volatile("rep stosb" : "+D"(dst), "+c"(size) : "a"(c) : "memory");
+#endif
+}
+
+// The streaming kernels are only called for sizes way above the vector width and for buffers which don't overlap.
+// Streaming stores need an aligned destination, so we do one unaligned store at the start, continue from the
+// next aligned address (rewriting a few bytes) and finish with an unaligned store which ends at the last byte.
+// The sfence at the end makes the stores visible to other cores in order with what follows.
+
+file_scope void stream_copy_sse2(byte *dst, const byte *src, u64 size) {
+    _mm_storeu_si128((__m128i *) dst, _mm_loadu_si128((const __m128i *) src));
+    u64 head = -(u64) dst & 15;
+    dst += head, src += head, size -= head;
+
+    for (; size >= 64; dst += 64, src += 64, size -= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *) src);
+        __m128i b = _mm_loadu_si128((const __m128i *) src + 1);
+        __m128i c = _mm_loadu_si128((const __m128i *) src + 2);
+        __m128i d = _mm_loadu_si128((const __m128i *) src + 3);
+        _mm_stream_si128((__m128i *) dst, a);
+        _mm_stream_si128((__m128i *) dst + 1, b);
+        _mm_stream_si128((__m128i *) dst + 2, c);
+        _mm_stream_si128((__m128i *) dst + 3, d);
+    }
+    for (; size >= 16; dst += 16, src += 16, size -= 16) _mm_stream_si128((__m128i *) dst, _mm_loadu_si128((const __m128i *) src));
+    if (size) _mm_storeu_si128((__m128i *) (dst + size - 16), _mm_loadu_si128((const __m128i *) (src + size - 16)));
+    _mm_sfence();
+}
+
+TARGET_AVX2 file_scope void stream_copy_avx2(byte *dst, const byte *src, u64 size) {
+    _mm256_storeu_si256((__m256i *) dst, _mm256_loadu_si256((const __m256i *) src));
+    u64 head = -(u64) dst & 31;
+    dst += head, src += head, size -= head;
+
+    for (; size >= 128; dst += 128, src += 128, size -= 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) src);
+        __m256i b = _mm256_loadu_si256((const __m256i *) src + 1);
+        __m256i c = _mm256_loadu_si256((const __m256i *) src + 2);
+        __m256i d = _mm256_loadu_si256((const __m256i *) src + 3);
+        _mm256_stream_si256((__m256i *) dst, a);
+        _mm256_stream_si256((__m256i *) dst + 1, b);
+        _mm256_stream_si256((__m256i *) dst + 2, c);
+        _mm256_stream_si256((__m256i *) dst + 3, d);
+    }
+    for (; size >= 32; dst += 32, src += 32, size -= 32) _mm256_stream_si256((__m256i *) dst, _mm256_loadu_si256((const __m256i *) src));
+    if (size) _mm256_storeu_si256((__m256i *) (dst + size - 32), _mm256_loadu_si256((const __m256i *) (src + size - 32)));
+    _mm_sfence();
+}
+
+TARGET_AVX512 file_scope void stream_copy_avx512(byte *dst, const byte *src, u64 size) {
+    _mm512_storeu_si512(dst, _mm512_loadu_si512(src));
+    u64 head = -(u64) dst & 63;
+    dst += head, src += head, size -= head;
+
+    for (; size >= 256; dst += 256, src += 256, size -= 256) {
+        __m512i a = _mm512_loadu_si512(src);
+        __m512i b = _mm512_loadu_si512(src + 64);
+        __m512i c = _mm512_loadu_si512(src + 128);
+        __m512i d = _mm512_loadu_si512(src + 192);
+        _mm512_stream_si512((__m512i *) dst, a);
+        _mm512_stream_si512((__m512i *) (dst + 64), b);
+        _mm512_stream_si512((__m512i *) (dst + 128), c);
+        _mm512_stream_si512((__m512i *) (dst + 192), d);
+    }
+    for (; size >= 64; dst += 64, src += 64, size -= 64) _mm512_stream_si512((__m512i *) dst, _mm512_loadu_si512(src));
+    if (size) _mm512_storeu_si512(dst + size - 64, _mm512_loadu_si512(src + size - 64));
+    _mm_sfence();
+}
+
+file_scope void stream_fill_sse2(byte *dst, char c, u64 size) {
+    __m128i v = _mm_set1_epi8(c);
+    _mm_storeu_si128((__m128i *) dst, v);
+    u64 head = -(u64) dst & 15;
+    dst += head, size -= head;
+
+    for (; size >= 16; dst += 16, size -= 16) _mm_stream_si128((__m128i *) dst, v);
+    if (size) _mm_storeu_si128((__m128i *) (dst + size - 16), v);
+    _mm_sfence();
+}
+
+TARGET_AVX2 file_scope void stream_fill_avx2(byte *dst, char c, u64 size) {
+    __m256i v = _mm256_set1_epi8(c);
+    _mm256_storeu_si256((__m256i *) dst, v);
+    u64 head = -(u64) dst & 31;
+    dst += head, size -= head;
+
+    for (; size >= 32; dst += 32, size -= 32) _mm256_stream_si256((__m256i *) dst, v);
+    if (size) _mm256_storeu_si256((__m256i *) (dst + size - 32), v);
+    _mm_sfence();
+}
+
+TARGET_AVX512 file_scope void stream_fill_avx512(byte *dst, char c, u64 size) {
+    __m512i v = _mm512_set1_epi8(c);
+    _mm512_storeu_si512(dst, v);
+    u64 head = -(u64) dst & 63;
+    dst += head, size -= head;
+
+    for (; size >= 64; dst += 64, size -= 64) _mm512_stream_si512((__m512i *) dst, v);
+    if (size) _mm512_storeu_si512(dst + size - 64, v);
+    _mm_sfence();
+}
+
+#undef TARGET_AVX2
+#undef TARGET_AVX512
+
+file_scope void *copy_memory_large(void *dst, const void *src, u64 size) {
+    if (size >= RepMovsbThreshold || size >= NonTemporalThreshold) {
+        auto *d = (byte *) dst;
+        auto *s = (const byte *) src;
+        if (d + size <= s || s + size <= d) {
+            if (size >= NonTemporalThreshold) {
+                StreamCopy(d, s, size);
+            } else {
+                rep_movsb(dst, src, size);
+            }
+            return dst;
+        }
+    }
+    return apex::kryptonite(dst, src, size);
+}
+
+file_scope void *fill_memory_large(void *dst, char c, u64 size) {
+    if (size >= NonTemporalThreshold) {
+        StreamFill((byte *) dst, c, size);
+        return dst;
+    }
+    if (size >= RepMovsbThreshold) {
+        rep_stosb(dst, c, size);
+        return dst;
+    }
+    return optimized_fill_memory(dst, c, size);
+}
+
+// Picks the stream kernels and the rep movsb threshold
+file_scope void pick_large_memory_kernels(const cpu_features &cpu) {
+    if (cpu.AVX512F) {
+        StreamCopy = stream_copy_avx512, StreamFill = stream_fill_avx512;
+    } else if (cpu.AVX2) {
+        StreamCopy = stream_copy_avx2, StreamFill = stream_fill_avx2;
+    } else {
+        StreamCopy = stream_copy_sse2, StreamFill = stream_fill_sse2;
+    }
+
+    if (cpu.FSRM) {
+        RepMovsbThreshold = 256;
+    } else if (cpu.ERMS) {
+        RepMovsbThreshold = 2048;
+    } else {
+        RepMovsbThreshold = (u64) -1;  // Never
+    }
+}
+#endif
+
+// These set up copy_memory and fill_memory the first time they are called
+file_scope void *copy_memory_dispatcher(void *dst, const void *src, u64 size) {
+#if ARCH == X86
+    const cpu_features &cpu = get_cpu_features();
+
+    // SSE4.2 is available on Core i and newer processors, they include "fast unaligned" memory access
+    if (cpu.SSE42) {
+        pick_large_memory_kernels(cpu);
+        copy_memory = &copy_memory_large;
+    } else {
+        copy_memory = &apex::tiberium;
+    }
+#else
+    copy_memory = &const_copy_memory;
+#endif
+    // Once we set it, actually run it
+    return copy_memory(dst, src, size);
+}
+
+file_scope void *fill_memory_dispatcher(void *dst, char c, u64 size) {
+#if ARCH == X86
+    pick_large_memory_kernels(get_cpu_features());
+    fill_memory = &fill_memory_large;
+#else
+    fill_memory = &optimized_fill_memory;
+#endif
+    return fill_memory(dst, c, size);
+}
+
+void *(*copy_memory)(void *dst, const void *src, u64 size) = copy_memory_dispatcher;
+void *(*fill_memory)(void *dst, char value, u64 size) = fill_memory_dispatcher;
 
 //
 // Compare memory (optimized code partly taken from https://code.woboq.org/userspace/glibc/string/memcmp.c.html)
@@ -1229,15 +1424,351 @@ s64 optimized_compare_memory(const void *ptr1, const void *ptr2, u64 size) {
     return -1;
 }
 
-s64 (*compare_memory)(const void *ptr1, const void *ptr2, u64 size) = optimized_compare_memory;
+bool optimized_equal_memory(const void *ptr1, const void *ptr2, u64 size) { return optimized_compare_memory(ptr1, ptr2, size) == -1; }
+
+//
+// SIMD compare_memory and equal_memory. compare_memory compares 32 (or 64 with AVX2) bytes per iteration and
+// finds the first mismatch in a block from the compare mask. equal_memory only ORs the XORs of the blocks together
+// and tests once per iteration, it never needs the position. Both finish with an (overlapping) block which ends
+// at the last byte, so only inputs shorter than a vector go through the scalar code.
+//
+
+#if ARCH == X86
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+file_scope always_inline u64 load_u64(const byte *p) { return (u64) _mm_cvtsi128_si64(_mm_loadl_epi64((const __m128i *) p)); }
+
+// For less than 16 bytes
+file_scope s64 compare_memory_short(const byte *a, const byte *b, u64 size) {
+    u64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 diff = load_u64(a + i) ^ load_u64(b + i);
+        if (diff) return i + lsb(diff) / 8;
+    }
+    for (; i < size; ++i) {
+        if (a[i] != b[i]) return i;
+    }
+    return -1;
+}
+
+file_scope bool equal_memory_short(const byte *a, const byte *b, u64 size) {
+    if (size >= 8) return !((load_u64(a) ^ load_u64(b)) | (load_u64(a + size - 8) ^ load_u64(b + size - 8)));
+    For(range(size)) if (a[it] != b[it]) return false;
+    return true;
+}
+
+// Bit i is set if byte i of the two blocks is the same
+file_scope always_inline u32 equal_mask_16(const byte *a, const byte *b) {
+    return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) a), _mm_loadu_si128((const __m128i *) b)));
+}
+
+file_scope always_inline __m128i xor16(const byte *a, const byte *b) {
+    return _mm_xor_si128(_mm_loadu_si128((const __m128i *) a), _mm_loadu_si128((const __m128i *) b));
+}
+
+file_scope always_inline bool zero16(__m128i v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF; }
+
+TARGET_AVX2 file_scope always_inline u32 equal_mask_32(const byte *a, const byte *b) {
+    return (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) a), _mm256_loadu_si256((const __m256i *) b)));
+}
+
+TARGET_AVX2 file_scope always_inline __m256i xor32(const byte *a, const byte *b) {
+    return _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) a), _mm256_loadu_si256((const __m256i *) b));
+}
+
+file_scope s64 compare_memory_sse2(const void *ptr1, const void *ptr2, u64 size) {
+    auto *a = (const byte *) ptr1, *b = (const byte *) ptr2;
+    if (size < 16) return compare_memory_short(a, b, size);
+
+    u64 i = 0;
+    for (; i + 32 <= size; i += 32) {
+        u32 equal = equal_mask_16(a + i, b + i) | equal_mask_16(a + i + 16, b + i + 16) << 16;
+        if (equal != 0xFFFFFFFF) return i + lsb(~equal);
+    }
+    if (i + 16 <= size) {
+        u32 equal = equal_mask_16(a + i, b + i);
+        if (equal != 0xFFFF) return i + lsb(~equal & 0xFFFF);
+        i += 16;
+    }
+    if (i < size) {
+        // The bytes before _i_ are equal, so the first mismatch in this block is the one we want
+        u64 last = size - 16;
+        u32 equal = equal_mask_16(a + last, b + last);
+        if (equal != 0xFFFF) return last + lsb(~equal & 0xFFFF);
+    }
+    return -1;
+}
+
+file_scope bool equal_memory_sse2(const void *ptr1, const void *ptr2, u64 size) {
+    auto *a = (const byte *) ptr1, *b = (const byte *) ptr2;
+    if (size < 16) return equal_memory_short(a, b, size);
+
+    u64 i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128i diff = _mm_or_si128(_mm_or_si128(xor16(a + i, b + i), xor16(a + i + 16, b + i + 16)),
+                                    _mm_or_si128(xor16(a + i + 32, b + i + 32), xor16(a + i + 48, b + i + 48)));
+        if (!zero16(diff)) return false;
+    }
+    for (; i + 16 <= size; i += 16) {
+        if (!zero16(xor16(a + i, b + i))) return false;
+    }
+    return i == size || zero16(xor16(a + size - 16, b + size - 16));
+}
+
+TARGET_AVX2 file_scope s64 compare_memory_avx2(const void *ptr1, const void *ptr2, u64 size) {
+    auto *a = (const byte *) ptr1, *b = (const byte *) ptr2;
+    if (size < 32) return compare_memory_sse2(a, b, size);
+
+    u64 i = 0;
+    for (; i + 64 <= size; i += 64) {
+        u64 equal = (u64) equal_mask_32(a + i, b + i) | (u64) equal_mask_32(a + i + 32, b + i + 32) << 32;
+        if (equal != 0xFFFFFFFFFFFFFFFFull) return i + lsb(~equal);
+    }
+    if (i + 32 <= size) {
+        u32 equal = equal_mask_32(a + i, b + i);
+        if (equal != 0xFFFFFFFF) return i + lsb(~equal);
+        i += 32;
+    }
+    if (i < size) {
+        u64 last = size - 32;
+        u32 equal = equal_mask_32(a + last, b + last);
+        if (equal != 0xFFFFFFFF) return last + lsb(~equal);
+    }
+    return -1;
+}
+
+TARGET_AVX2 file_scope bool equal_memory_avx2(const void *ptr1, const void *ptr2, u64 size) {
+    auto *a = (const byte *) ptr1, *b = (const byte *) ptr2;
+    if (size < 32) return equal_memory_sse2(a, b, size);
+
+    u64 i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i diff = _mm256_or_si256(_mm256_or_si256(xor32(a + i, b + i), xor32(a + i + 32, b + i + 32)),
+                                       _mm256_or_si256(xor32(a + i + 64, b + i + 64), xor32(a + i + 96, b + i + 96)));
+        if (!_mm256_testz_si256(diff, diff)) return false;
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i diff = xor32(a + i, b + i);
+        if (!_mm256_testz_si256(diff, diff)) return false;
+    }
+    if (i == size) return true;
+
+    __m256i diff = xor32(a + size - 32, b + size - 32);
+    return _mm256_testz_si256(diff, diff);
+}
+
+#undef TARGET_AVX2
+#endif
+
+// These set up compare_memory and equal_memory the first time they are called
+file_scope s64 compare_memory_dispatcher(const void *ptr1, const void *ptr2, u64 size) {
+#if ARCH == X86
+    compare_memory = get_cpu_features().AVX2 ? compare_memory_avx2 : compare_memory_sse2;
+#else
+    compare_memory = optimized_compare_memory;
+#endif
+    return compare_memory(ptr1, ptr2, size);
+}
+
+file_scope bool equal_memory_dispatcher(const void *ptr1, const void *ptr2, u64 size) {
+#if ARCH == X86
+    equal_memory = get_cpu_features().AVX2 ? equal_memory_avx2 : equal_memory_sse2;
+#else
+    equal_memory = optimized_equal_memory;
+#endif
+    return equal_memory(ptr1, ptr2, size);
+}
+
+s64 (*compare_memory)(const void *ptr1, const void *ptr2, u64 size) = compare_memory_dispatcher;
+bool (*equal_memory)(const void *ptr1, const void *ptr2, u64 size) = equal_memory_dispatcher;
+
+//
+// CPU features
+//
+
+u32 CpuDispatchGeneration = 1;
+
+file_scope cpu_features DetectedCpuFeatures;
+file_scope cpu_features CurrentCpuFeatures;
+file_scope bool CpuFeaturesDetected;
+
+#if ARCH == X86
+file_scope void cpuid(u32 leaf, u32 subleaf, u32 *regs) {
+#if COMPILER == MSVC
+    __cpuidex((s32 *) regs, (s32) leaf, (s32) subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register states the OS saves on context switches
+file_scope u64 read_xcr0() {
+#if COMPILER == MSVC
+    return _xgetbv(0);
+#else
+    u32 lo, hi;
+    asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64) hi << 32) | lo;
+#endif
+}
+
+// Our share of the last level cache: its size divided by the number of threads which share it.
+// From the deterministic cache parameters leaf (4 on Intel, 0x8000001D on AMD).
+file_scope u64 detect_last_level_cache_share(u32 maxLeaf) {
+    u32 leaves[2] = {4, 0x8000001D};
+
+    u32 regs[4];
+    cpuid(0x80000000, 0, regs);
+    u32 maxExtendedLeaf = regs[0];
+
+    For(leaves) {
+        if (it < 0x80000000 ? maxLeaf < it : maxExtendedLeaf < it) continue;
+
+        u64 share = 0;
+        u32 level = 0;
+        For_as(subleaf, range(16)) {
+            cpuid(it, (u32) subleaf, regs);
+            if (!(regs[0] & 31)) break;  // No more caches
+
+            u32 cacheLevel = (regs[0] >> 5) & 7;
+            if (cacheLevel < level) continue;
+
+            u64 ways = (regs[1] >> 22) + 1;
+            u64 partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+            u64 lineSize = (regs[1] & 0xFFF) + 1;
+            u64 sets = (u64) regs[2] + 1;
+            u64 threads = ((regs[0] >> 14) & 0xFFF) + 1;
+
+            level = cacheLevel;
+            share = ways * partitions * lineSize * sets / threads;
+        }
+        if (share) return share;
+    }
+    return 0;
+}
+
+file_scope cpu_features detect_cpu_features() {
+    cpu_features f = {};
+
+    u32 regs[4];
+    cpuid(0, 0, regs);
+    u32 maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    u32 ecx1 = regs[2], edx1 = regs[3];
+
+    f.SSE2 = edx1 & (1 << 26);
+    f.SSE3 = ecx1 & (1 << 0);
+    f.SSSE3 = ecx1 & (1 << 9);
+    f.SSE41 = ecx1 & (1 << 19);
+    f.SSE42 = ecx1 & (1 << 20);
+    f.POPCNT = ecx1 & (1 << 23);
+
+    bool osxsave = ecx1 & (1 << 27);
+    u64 xcr0 = osxsave ? read_xcr0() : 0;
+    bool ymm = (xcr0 & 6) == 6;               // XMM and YMM state
+    bool zmm = ymm && (xcr0 & 0xE0) == 0xE0;  // Opmask and both halves of the ZMM state
+
+    f.AVX = ymm && (ecx1 & (1 << 28));
+    f.FMA = f.AVX && (ecx1 & (1 << 12));
+    f.F16C = f.AVX && (ecx1 & (1 << 29));
+
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, regs);
+        u32 ebx7 = regs[1], edx7 = regs[3];
+
+        f.BMI1 = ebx7 & (1 << 3);
+        f.AVX2 = f.AVX && (ebx7 & (1 << 5));
+        f.BMI2 = ebx7 & (1 << 8);
+        f.ERMS = ebx7 & (1 << 9);
+        f.AVX512F = zmm && (ebx7 & (1 << 16));
+        f.AVX512BW = f.AVX512F && (ebx7 & (1 << 30));
+        f.AVX512VL = f.AVX512F && (ebx7 & (1u << 31));
+        f.FSRM = edx7 & (1 << 4);
+    }
+
+    cpuid(0x80000000, 0, regs);
+    u32 maxExtendedLeaf = regs[0];
+
+    if (maxExtendedLeaf >= 0x80000001) {
+        cpuid(0x80000001, 0, regs);
+        f.RDTSCP = regs[3] & (1 << 27);
+    }
+
+    if (maxExtendedLeaf >= 0x80000007) {
+        cpuid(0x80000007, 0, regs);
+        f.INVARIANT_TSC = regs[3] & (1 << 8);
+    }
+
+    if (!NonTemporalThreshold) {
+        // Past 3/4 of our share of the last level cache a copy starts evicting what other threads are using
+        u64 share = detect_last_level_cache_share(maxLeaf);
+        NonTemporalThreshold = max<u64>(share / 4 * 3, 1024 * 1024);
+    }
+    return f;
+}
+
+u64 get_cpu_tsc_frequency() {
+    u32 regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 0x15) return 0;
+
+    // EBX/EAX is the ratio of the TSC to the core crystal clock, ECX is the crystal frequency (0 if not enumerated)
+    cpuid(0x15, 0, regs);
+    if (!regs[0] || !regs[1] || !regs[2]) return 0;
+    return (u64) regs[2] * regs[1] / regs[0];
+}
+#else
+file_scope cpu_features detect_cpu_features() { return {}; }
+
+u64 get_cpu_tsc_frequency() { return 0; }
+#endif
+
+const cpu_features &get_cpu_features() {
+    if (!CpuFeaturesDetected) {
+        DetectedCpuFeatures = CurrentCpuFeatures = detect_cpu_features();
+        CpuFeaturesDetected = true;
+    }
+    return CurrentCpuFeatures;
+}
+
+// Makes the memory functions pick again on their next call
+file_scope void rebind_memory_functions() {
+    copy_memory = copy_memory_dispatcher;
+    fill_memory = fill_memory_dispatcher;
+    compare_memory = compare_memory_dispatcher;
+    equal_memory = equal_memory_dispatcher;
+}
+
+void cpu_features_override(const cpu_features &features) {
+    get_cpu_features();  // Make sure we have detected them
+
+    // Can't turn on what the CPU doesn't have. All members are bools.
+    auto *dest = (bool *) &CurrentCpuFeatures;
+    auto *want = (const bool *) &features;
+    auto *has = (const bool *) &DetectedCpuFeatures;
+    For(range(sizeof(cpu_features) / sizeof(bool))) dest[it] = want[it] && has[it];
+
+    ++CpuDispatchGeneration;
+    rebind_memory_functions();
+}
+
+void cpu_features_reset() {
+    get_cpu_features();
+    CurrentCpuFeatures = DetectedCpuFeatures;
+
+    ++CpuDispatchGeneration;
+    rebind_memory_functions();
+}
 
 void default_panic_handler(const string &message, const array<os_function_call> &callStack) {
     if (Context._HandlingPanic) return;
 
-    auto newContext = Context;
-    newContext._HandlingPanic = true;
-
-    PUSH_CONTEXT(newContext) {
+    PUSH_CONTEXT_VAR(_HandlingPanic, true) {
         print("\n\n{!}(context.cpp / default_crash_handler): A panic occured and the program must terminate.\n");
         print("{!GRAY}        Error: {!RED}{}{!}\n\n", message);
         print("        ... and here is the call stack:\n");
@@ -17,4 +17,22 @@ inline os_function_call *clone(os_function_call *dest, os_function_call src) {
     return dest;
 }
 
+// Captures the return addresses on the stack of the calling thread (innermost call first).
+// This is fast - it doesn't resolve symbols, use os_resolve_function_call() for that later (or intern the stack
+// and let call_stack_resolve() cache the symbols, see :CallStacks:). It doesn't allocate or take locks.
+// Returns the number of frames written to _frames_.
+//
+// [Windows] RtlCaptureStackBackTrace, which uses the unwind tables.
+// [POSIX] Follows the frame pointers, frames of code compiled without them (-fomit-frame-pointer) are skipped or end the walk.
+//
+// Defined in *platform*_crash_handler.cpp
+s64 os_capture_call_stack(void **frames, s64 maxFrames, s64 framesToSkip = 0);
+
+// Uses debug info to find the function, file and line of an address (e.g. one returned by os_capture_call_stack()).
+// This is slow. The strings in the result are allocated with the Context's allocator.
+// If the information isn't available, Name is "UnknownFunction" and File is "UnknownFile".
+//
+// Defined in *platform*_crash_handler.cpp
+os_function_call os_resolve_function_call(void *address);
+
 LSTD_END_NAMESPACE
\ No newline at end of file
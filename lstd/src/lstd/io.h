@@ -1,6 +1,13 @@
 #pragma once
 
+#include "io/async_log_writer.h"
 #include "io/buffer_writer.h"
+#include "io/console_reader.h"
 #include "io/console_writer.h"
 #include "io/counting_writer.h"
+#include "io/file_reader.h"
+#include "io/file_writer.h"
+#include "io/reader.h"
+#include "io/socket_reader.h"
+#include "io/socket_writer.h"
 #include "io/string_writer.h"
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "../thread.h"
+#include "writer.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A writer which moves the actual output (console, pipes, files) to a background thread,
+// so a slow terminal doesn't stall the threads which log.
+//
+//     async_log_writer logger;
+//     async_log_writer_init(logger, &cout);
+//
+//     auto newContext = Context;
+//     newContext.Log  = &logger;
+//     OVERRIDE_CONTEXT(newContext);
+//     ...
+//     free(logger);  // Writes out everything that's left and stops the thread
+//
+// Each thread which writes gets its own ring buffer (one producer, one consumer - no locks, a write is a copy
+// and flush() is a single store). write() stages bytes and flush() publishes them as one record, print() ends
+// with a flush(), so lines from different threads don't get mixed up. Anything written but not flushed
+// isn't visible to the background thread yet.
+//
+// The background thread goes over all buffers, hands each one's contents to _Out_ in as few writes as
+// possible and flushes _Out_ when it runs out of work.
+//
+// Memory is bounded by _BufferSize_ per thread which logged (buffers live until free()). When a record doesn't fit,
+// with DROP we throw it away and count it in _Dropped_, with BLOCK we wait for room (a record bigger than
+// the whole buffer can't wait for that, it reaches _Out_ in pieces and may get mixed with other threads' records).
+//
+// The writer is referenced by its background thread, don't move or copy it after init.
+//
+enum class async_log_policy {
+    BLOCK,
+    DROP
+};
+
+struct async_log_buffer {
+    // Touched by the background thread. Positions only grow, we mask them when indexing.
+    alignas(64) s64 Head = 0;
+
+    // Touched by the owning thread
+    alignas(64) s64 Tail = 0;  // Published, the background thread reads up to here
+    s64 Staged = 0;            // End of the record which is being written
+    s64 CachedHead = 0;
+    bool DroppingRecord = false;
+
+    thread::id Owner;
+
+    byte *Data = null;
+    s64 Size   = 0;  // Power of two
+
+    async_log_buffer *Next = null;
+};
+
+struct async_log_writer : writer {
+    writer *Out = null;  // The real output, only the background thread touches it
+
+    s64 BufferSize          = 0;
+    async_log_policy Policy = async_log_policy::BLOCK;
+    allocator Alloc;  // For the buffers, they get allocated by the threads which write
+
+    async_log_buffer *Buffers = null;  // Pushed to the front with a CAS, never removed until free()
+
+    // Different for every init, so thread local lookup caches from a writer which was freed don't match
+    u64 Id = 0;
+
+    s64 Dropped = 0;  // Records thrown away with DROP
+
+    thread::thread Thread;
+    s32 Stop = 0;
+    s32 Idle = 1;  // Set by the background thread after it found nothing to do and flushed _Out_
+
+    async_log_writer() {}
+
+    void write(const byte *data, s64 count) override;
+    void write_vectored(const bytes *spans, s64 count) override;
+    void flush() override;
+};
+
+namespace internal {
+inline u64 AsyncLogWriterNextId = 0;
+
+// The buffer the current thread used last and which writer it belongs to
+inline thread_local u64 AsyncLogCachedId = 0;
+inline thread_local async_log_buffer *AsyncLogCachedBuffer = null;
+
+inline async_log_buffer *async_log_find_buffer(async_log_writer *w, bool create) {
+    if (AsyncLogCachedId == w->Id) return AsyncLogCachedBuffer;
+
+    async_log_buffer *b = atomic_load(&w->Buffers);
+    while (b && b->Owner != Context.ThreadID) b = b->Next;
+
+    if (!b) {
+        if (!create) return null;
+
+        b       = allocate<async_log_buffer>({.Alloc = w->Alloc, .Alignment = 64});
+        b->Data = allocate_array<byte>(w->BufferSize, {.Alloc = w->Alloc});
+        b->Size  = w->BufferSize;
+        b->Owner = Context.ThreadID;
+
+        while (true) {
+            auto *head = atomic_load(&w->Buffers);
+            b->Next    = head;
+            if (atomic_compare_and_swap(&w->Buffers, b, head) == head) break;
+        }
+    }
+
+    AsyncLogCachedId     = w->Id;
+    AsyncLogCachedBuffer = b;
+    return b;
+}
+
+inline void async_log_thread(void *data) {
+    auto *w = (async_log_writer *) data;
+
+    bool unflushed = false;
+    s64 idlePasses = 0;
+    while (true) {
+        // Read before the pass, so after we see Stop we do one more full pass and nothing published before free() is lost
+        bool stop = atomic_load(&w->Stop);
+
+        bool found = false;
+        for (auto *b = atomic_load(&w->Buffers); b; b = b->Next) {
+            s64 tail = atomic_load(&b->Tail);
+            s64 head = b->Head;
+            if (head == tail) continue;
+
+            if (!found) {
+                atomic_store(&w->Idle, 0);
+                found = true;
+            }
+
+            // At most two writes, the ring may wrap
+            s64 begin = head & (b->Size - 1);
+            s64 first = min(tail - head, b->Size - begin);
+            w->Out->write(b->Data + begin, first);
+            if (first != tail - head) w->Out->write(b->Data, tail - head - first);
+
+            atomic_store(&b->Head, tail);
+        }
+
+        if (found) {
+            unflushed  = true;
+            idlePasses = 0;
+            continue;
+        }
+
+        if (unflushed) {
+            w->Out->flush();
+            unflushed = false;
+        }
+        atomic_store(&w->Idle, 1);
+
+        if (stop) break;
+
+        // Stay responsive right after a burst, back off to sleeping when there's nothing coming
+        thread::sleep(idlePasses++ < 64 ? 0 : 1);
+    }
+}
+}  // namespace internal
+
+// Starts the background thread. _bufferSize_ is per thread and gets rounded up to a power of two.
+// _alloc_ (Context.Alloc by default) is used for the buffers, it must be safe to call from any thread.
+inline void async_log_writer_init(async_log_writer &w, writer *out, s64 bufferSize = 64_KiB, async_log_policy policy = async_log_policy::BLOCK, allocator alloc = {}) {
+    assert(out && "Output writer was null");
+    assert(!w.Out && "Writer already initialized, call free() first");
+
+    w.Out        = out;
+    w.BufferSize = ceil_pow_of_2(max<s64>(bufferSize, 64));
+    w.Policy     = policy;
+    w.Alloc      = alloc ? alloc : Context.Alloc;
+    w.Buffers    = null;
+    w.Dropped    = 0;
+    w.Stop       = 0;
+    w.Idle       = 1;
+    w.Id         = atomic_inc(&internal::AsyncLogWriterNextId) + 1;
+
+    w.Thread.init_and_launch(internal::async_log_thread, &w);
+}
+
+// Stops the background thread after it has written everything that was published, then releases the buffers.
+inline void free(async_log_writer &w) {
+    if (!w.Out) return;
+
+    atomic_store(&w.Stop, 1);
+    w.Thread.wait();
+
+    auto *b = w.Buffers;
+    while (b) {
+        auto *next = b->Next;
+        free(b->Data);
+        free(b);
+        b = next;
+    }
+
+    w.Buffers = null;
+    w.Out     = null;
+    w.Id      = 0;
+}
+
+// Publishes the calling thread's record and waits until everything published so far reached _Out_ and _Out_ was flushed.
+inline void async_log_writer_drain(async_log_writer &w) {
+    w.flush();
+
+    while (true) {
+        bool empty = true;
+        for (auto *b = atomic_load(&w.Buffers); b; b = b->Next) {
+            if (atomic_load(&b->Head) != atomic_load(&b->Tail)) {
+                empty = false;
+                break;
+            }
+        }
+
+        // Check Idle after the buffers - the background thread clears it before it consumes anything
+        if (empty && atomic_load(&w.Idle)) return;
+        thread::sleep(0);
+    }
+}
+
+inline void async_log_writer::write(const byte *data, s64 count) {
+    if (!count) return;
+
+    auto *b = internal::async_log_find_buffer(this, true);
+    if (b->DroppingRecord) return;
+
+    while (count) {
+        s64 space = b->Size - (b->Staged - b->CachedHead);
+        if (space < count) {
+            b->CachedHead = atomic_load(&b->Head);
+            space         = b->Size - (b->Staged - b->CachedHead);
+        }
+
+        if (space < count && Policy == async_log_policy::DROP) {
+            b->Staged         = b->Tail;
+            b->DroppingRecord = true;
+            atomic_inc(&Dropped);
+            return;
+        }
+
+        if (space < count && b->Staged - b->Tail + count <= b->Size) {
+            // BLOCK: the record fits once the background thread catches up, wait for it
+            thread::sleep(0);
+            continue;
+        }
+
+        if (!space) {
+            // BLOCK: the record is bigger than the buffer, let the background thread have what we have so far
+            atomic_store(&b->Tail, b->Staged);
+            thread::sleep(0);
+            continue;
+        }
+
+        s64 n     = min(count, space);
+        s64 begin = b->Staged & (b->Size - 1);
+        s64 first = min(n, b->Size - begin);
+        copy_memory(b->Data + begin, data, first);
+        if (first != n) copy_memory(b->Data, data + first, n - first);
+
+        b->Staged += n;
+        data += n;
+        count -= n;
+    }
+}
+
+inline void async_log_writer::write_vectored(const bytes *spans, s64 count) {
+    For(range(count)) async_log_writer::write(spans[it].Data, spans[it].Count);
+}
+
+inline void async_log_writer::flush() {
+    auto *b = internal::async_log_find_buffer(this, false);
+    if (!b) return;
+
+    if (b->DroppingRecord) {
+        b->DroppingRecord = false;
+        return;
+    }
+    atomic_store(&b->Tail, b->Staged);
+}
+
+LSTD_END_NAMESPACE
@@ -47,4 +47,25 @@ struct buffer_writer : writer {
     }
 };
 
+// Writes into a fixed range of bytes and never allocates - safe for signal handlers, crash handlers, lock-free queues.
+// Output which doesn't fit is dropped (possibly in the middle of a code point) but still counted,
+// so _Count_ is the number of bytes the whole output needs. Nothing is null-terminated.
+struct fixed_buffer_writer : writer {
+    byte *Buffer;
+    s64 Size;
+
+    s64 Count = 0;
+
+    fixed_buffer_writer(byte *buffer, s64 size) : Buffer(buffer), Size(size) {}
+
+    void write(const byte *data, s64 size) override {
+        if (Count < Size) copy_memory(Buffer + Count, data, min(size, Size - Count));
+        Count += size;
+    }
+
+    void write_vectored(const bytes *spans, s64 count) override {
+        For(range(count)) fixed_buffer_writer::write(spans[it].Data, spans[it].Count);
+    }
+};
+
 LSTD_END_NAMESPACE
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "reader.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Reads the standard input (see reader.h). Reading force flushes cout first, so prompts are visible.
+//
+// Every fill asks the OS for as much as fits in the buffer, set a bigger buffer before the first read
+// for tools which get a lot of input through a pipe:
+//
+//     cin.BufferSize = 4_MiB;
+//
+// The buffer is allocated with the persistent allocator and is never freed.
+//
+struct console_reader : reader {
+    console_reader() {}
+
+    // Defined in *platform*_common.cpp
+    s64 read_source(byte *dest, s64 size) override;
+    allocator buffer_allocator() override;
+};
+
+inline auto cin = console_reader();
+
+LSTD_END_NAMESPACE
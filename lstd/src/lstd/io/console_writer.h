@@ -4,7 +4,34 @@
 
 LSTD_BEGIN_NAMESPACE
 
+//
+// Output goes through a buffer, how often it reaches the console/pipe/file depends on _Buffering_:
+//
+// - LINE - flush() (print() ends with one) writes out the buffer. Output shows up right away, that's what you
+//          want when a person is watching (prompts without a new line included).
+// - FULL - flush() does nothing, we only write when the buffer is full, on force_flush() and at exit.
+//          One syscall per buffer instead of one per print - for output which goes to a file or another program.
+// - AUTO - LINE if the output is a terminal, FULL with a bigger buffer (PIPE_BUFFER_SIZE) if it was redirected.
+//          Decided on first use. cerr is always LINE in AUTO - errors shouldn't wait in a buffer.
+//
+// Reading from the console force flushes cout first, so prompts are visible in any mode.
+//
+//     cout.set_buffering(console_writer::FULL, 1_MiB);
+//
 struct console_writer : writer {
+    static constexpr s64 PIPE_BUFFER_SIZE = 64_KiB;
+
+    enum output_type {
+        COUT,
+        CERR
+    };
+
+    enum buffering {
+        AUTO,
+        LINE,
+        FULL
+    };
+
     // By default, we are thread-safe.
     // If you don't use seperate threads and aim for maximum console output performance, set this to false.
     bool LockMutex = true;
@@ -12,22 +39,29 @@ struct console_writer : writer {
     byte *Buffer = null, *Current = null;
     s64 Available = 0, BufferSize = 0;
 
-    enum output_type {
-        COUT,
-        CERR
-    };
-
     output_type OutputType;
 
+    buffering Buffering     = AUTO;   // After the first use this is either LINE or FULL
+    s64 RequestedBufferSize = 0;      // 0 for the default
+    bool IsTerminal         = false;  // Valid after the first use
+
     console_writer() {}
     console_writer(output_type type) : OutputType(type) {}
 
     // Defined in *platform*_common.cpp
     void write(const byte *data, s64 size) override;
+    void write_vectored(const bytes *spans, s64 count) override;  // Takes the lock once for all spans
     void flush() override;
+
+    // Writes out the buffer regardless of _Buffering_.
+    void force_flush();
+
+    // Writes out what's buffered so far and switches the mode. _bufferSize_ of 0 means the default
+    // (a small static buffer for terminals, PIPE_BUFFER_SIZE otherwise). Bigger buffers get allocated once and are never freed.
+    void set_buffering(buffering mode, s64 bufferSize = 0);
 };
 
-inline auto cout = console_writer(console_writer::COUT); 
-inline auto cerr = console_writer(console_writer::CERR); 
+inline auto cout = console_writer(console_writer::COUT);
+inline auto cerr = console_writer(console_writer::CERR);
 
 LSTD_END_NAMESPACE
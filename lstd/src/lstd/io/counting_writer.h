@@ -9,6 +9,10 @@ struct counting_writer : writer {
     s64 Count = 0;
 
     void write(const byte *, s64 size) override { Count += size; }
+
+    void write_vectored(const bytes *spans, s64 count) override {
+        For(range(count)) Count += spans[it].Count;
+    }
 };
 
 LSTD_END_NAMESPACE
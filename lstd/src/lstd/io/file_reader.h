@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../internal/context.h"
+#include "../memory/string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Reads a file from start to end in chunks without holding all of it in memory.
+//
+// The buffer is split in two halves. While you work on one, the next part of the file is already being read into
+// the other (an overlapped read on Windows, on POSIX we ask the kernel to read ahead with posix_fadvise instead).
+//
+//     file_reader r;
+//     if (!file_reader_open(r, "data.bin")) return;
+//     defer(free(r));
+//
+//     while (true) {
+//         bytes chunk = file_reader_next(r);
+//         if (!chunk) break;
+//         ...
+//     }
+//
+// file_reader_next fits parse_stream's _Read_ as is:
+//
+//     auto read = [&]() { return file_reader_next(r); };
+//     parse_stream_init(s, &read);
+//
+struct file_reader {
+    static constexpr s64 DEFAULT_BUFFER_SIZE = 128_KiB;  // Both halves
+
+    void *Handle = null;  // null if opening failed
+
+    byte *Buffer   = null;
+    s64 BufferSize = 0;
+    allocator Alloc;
+
+    bytes Current;   // What's left of the chunk file_reader_next returned last, file_reader_read consumes from here
+    s64 Offset = 0;  // In the file, where the next read starts
+
+    s64 Half = 0;  // Which half the next chunk is read into
+
+    // The read in flight (Windows only, an OVERLAPPED), see file_reader_next
+    alignas(8) byte PlatformRequest[32]{};
+    bool Pending = false;
+
+    bool Ended  = false;
+    bool Failed = false;  // A read failed, we report the end of the file after it
+};
+
+// Opens _path_ for reading and starts reading the first chunk. _bufferSize_ of 0 means DEFAULT_BUFFER_SIZE,
+// _alloc_ is Context.Alloc by default. Returns false if the file couldn't be opened. Defined in path.*platform*
+bool file_reader_open(file_reader &r, const string &path, s64 bufferSize = 0, allocator alloc = {});
+
+// Returns the next part of the file (at most half the buffer), empty at the end.
+// The returned bytes stay valid until the next call. Any bytes of the previous chunk file_reader_read didn't consume are dropped.
+bytes file_reader_next(file_reader &r);
+
+// Copies the next _size_ bytes of the file to _dest_. Returns how many were copied, less than _size_ only at the end.
+inline s64 file_reader_read(file_reader &r, byte *dest, s64 size) {
+    s64 copied = 0;
+    while (copied < size) {
+        if (!r.Current && !file_reader_next(r)) break;
+
+        s64 n = min(size - copied, r.Current.Count);
+        copy_memory(dest + copied, r.Current.Data, n);
+        copied += n;
+
+        r.Current.Data += n;
+        r.Current.Count -= n;
+    }
+    return copied;
+}
+
+// Waits for the read in flight, closes the file and frees the buffer.
+void free(file_reader &r);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "writer.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Writes to a file which stays open, through a buffer. path_write_to_file opens and closes the file on every call,
+// with this appending a log line is a copy and the file gets one write each time the buffer fills up.
+//
+//     file_writer log;
+//     if (!file_writer_open(log, "log.txt", file_writer::APPEND)) return;
+//     defer(free(log));
+//
+//     fmt_to_writer(&log, "{} frames\n", frames);
+//
+// The buffer goes out in whole _BufferSize_ pieces, big writes skip the buffer (they still go out in multiples
+// of _BufferSize_ so the writes stay aligned in the file).
+//
+// Like console_writer's FULL mode flush() does nothing (every print() ends with one, that would be a write per line again).
+// force_flush() writes out what's buffered (to the OS, not to the disk), free() does that too.
+//
+// If the OS fails a write we set _Failed_ and drop the rest of the output.
+//
+struct file_writer : writer {
+    static constexpr s64 DEFAULT_BUFFER_SIZE = 64_KiB;
+
+    enum open_mode {
+        APPEND,
+        OVERWRITE_ENTIRE  // Truncates the file
+    };
+
+    void *Handle = null;  // null if opening failed
+
+    byte *Buffer = null, *Current = null;
+    s64 Available = 0, BufferSize = 0;
+
+    allocator Alloc;  // For the buffer
+
+    bool Failed = false;
+
+    file_writer() {}
+
+    void write(const byte *data, s64 size) override;
+    void flush() override {}
+
+    // Writes out the buffer now.
+    void force_flush();
+};
+
+// Opens (creating it if it doesn't exist) _path_ for writing. _bufferSize_ of 0 means DEFAULT_BUFFER_SIZE,
+// _alloc_ is Context.Alloc by default. Returns false if the file couldn't be opened. Defined in path.*platform*
+bool file_writer_open(file_writer &w, const string &path, file_writer::open_mode mode = file_writer::APPEND, s64 bufferSize = 0, allocator alloc = {});
+
+// Writes out the buffer, closes the file and frees the buffer. Defined in path.*platform*
+void free(file_writer &w);
+
+namespace internal {
+// Writes straight to the file, sets _Failed_ if that doesn't work. Defined in path.*platform*
+void file_writer_write_file(file_writer &w, const byte *data, s64 size);
+}  // namespace internal
+
+inline void file_writer::write(const byte *data, s64 size) {
+    if (!Handle || Failed) return;
+
+    if (size < Available) {
+        copy_memory(Current, data, size);
+        Current += size;
+        Available -= size;
+        return;
+    }
+
+    // Top up the buffer and write it out whole
+    s64 fill = Available;
+    copy_memory(Current, data, fill);
+    internal::file_writer_write_file(*this, Buffer, BufferSize);
+    data += fill;
+    size -= fill;
+
+    // Whole buffers worth go to the file without the copy
+    s64 direct = size / BufferSize * BufferSize;
+    if (direct) internal::file_writer_write_file(*this, data, direct);
+
+    copy_memory(Buffer, data + direct, size - direct);
+    Current   = Buffer + (size - direct);
+    Available = BufferSize - (size - direct);
+}
+
+inline void file_writer::force_flush() {
+    if (!Handle || Failed) return;
+
+    s64 size = BufferSize - Available;
+    if (size) internal::file_writer_write_file(*this, Buffer, size);
+
+    Current   = Buffer;
+    Available = BufferSize;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../internal/context.h"
+#include "../memory/array_like.h"
+#include "../memory/string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// The counterpart of writer - reads bytes from an input (the console, a pipe, a socket...) through a buffer.
+// Subclasses override read_source() which is called to fill the buffer, e.g. console_reader:
+//
+//     string line;
+//     while (read_line(&cin, line)) {
+//         ... _line_ points into the buffer of cin, it's valid until the next read ...
+//     }
+//
+// The buffer is allocated on first use (_BufferSize_ bytes, DEFAULT_BUFFER_SIZE if that's 0) and every fill asks
+// the source for as much as fits, so big inputs take few calls. It grows when peek() asks for more than it holds
+// or a line doesn't fit. Readers aren't thread-safe.
+//
+struct reader {
+    static constexpr s64 DEFAULT_BUFFER_SIZE = 64_KiB;
+
+    byte *Buffer = null;
+    s64 BufferSize = 0;  // Set this before the first read to pick the size of the buffer
+
+    bytes Available;  // Read from the source but not consumed yet, points into _Buffer_
+
+    bool Ended = false;  // The source had nothing more to give
+
+    allocator Alloc;  // The allocator for the buffer, null means Context.Alloc (when it's allocated)
+
+    reader() {}
+    virtual ~reader() {}
+
+    // Reads at most _size_ bytes into _dest_, returns how many. 0 means that the input ended.
+    // This should be one call to the OS (or whatever the source is), we call it again if we need more.
+    virtual s64 read_source(byte *dest, s64 size) = 0;
+
+    virtual allocator buffer_allocator() { return Alloc ? Alloc : Context.Alloc; }
+};
+
+namespace internal {
+// Makes room for at least _size_ buffered bytes (moving what's left to the start of the buffer or growing it)
+// and reads from the source once. Returns false if the input ended.
+inline bool reader_fill(reader *r, s64 size) {
+    if (r->Ended) return false;
+
+    if (!r->Buffer || size > r->BufferSize) {
+        s64 newSize = r->Buffer ? max(size, r->BufferSize * 2) : max(size, r->BufferSize ? r->BufferSize : reader::DEFAULT_BUFFER_SIZE);
+
+        byte *buffer = allocate_array<byte>(newSize, {.Alloc = r->buffer_allocator()});
+        if (r->Available.Count) copy_memory(buffer, r->Available.Data, r->Available.Count);
+        if (r->Buffer) free(r->Buffer);
+
+        r->Buffer = buffer;
+        r->BufferSize = newSize;
+        r->Available.Data = buffer;
+    } else if (r->Available.Data != r->Buffer) {
+        if (r->Available.Count) copy_memory(r->Buffer, r->Available.Data, r->Available.Count);
+        r->Available.Data = r->Buffer;
+    }
+
+    byte *end = r->Available.Data + r->Available.Count;
+
+    s64 read = r->read_source(end, r->Buffer + r->BufferSize - end);
+    if (!read) {
+        r->Ended = true;
+        return false;
+    }
+    r->Available.Count += read;
+    return true;
+}
+}  // namespace internal
+
+// Returns the next _size_ bytes without consuming them (fewer only at the end of the input).
+// The result points into the buffer and is valid until the next read.
+inline bytes peek(reader *r, s64 size) {
+    while (r->Available.Count < size && internal::reader_fill(r, size)) {
+    }
+    return bytes(r->Available.Data, min(size, r->Available.Count));
+}
+
+// Consumes _size_ bytes which were returned by peek().
+inline void skip(reader *r, s64 size) {
+    assert(size <= r->Available.Count);
+    r->Available.Data += size;
+    r->Available.Count -= size;
+}
+
+// Copies the next _size_ bytes to _dest_. Returns how many were copied, less than _size_ only at the end of the input.
+// Once the buffer is empty, reads of at least a buffer's worth go straight to _dest_.
+inline s64 read(reader *r, byte *dest, s64 size) {
+    s64 copied = min(size, r->Available.Count);
+    if (copied) copy_memory(dest, r->Available.Data, copied);
+    skip(r, copied);
+
+    while (copied < size && !r->Ended) {
+        if (r->Buffer && size - copied >= r->BufferSize) {
+            s64 n = r->read_source(dest + copied, size - copied);
+            if (!n) r->Ended = true;
+            copied += n;
+            continue;
+        }
+
+        if (!internal::reader_fill(r, 0)) break;
+
+        s64 n = min(size - copied, r->Available.Count);
+        copy_memory(dest + copied, r->Available.Data, n);
+        skip(r, n);
+        copied += n;
+    }
+    return copied;
+}
+
+// Reads up to the next new line and sets _line_ to what's before it (without the '\n' and a '\r' before it).
+// Returns false at the end of the input. The last line doesn't need to end with a new line.
+//
+// _line_ points into the buffer (nothing is copied) and is valid until the next read.
+inline bool read_line(reader *r, string &line) {
+    s64 searched = 0;
+    while (true) {
+        s64 newLine = find(r->Available, (byte) '\n', searched);
+        if (newLine != -1) {
+            s64 size = newLine && r->Available[newLine - 1] == '\r' ? newLine - 1 : newLine;
+            line = string((const utf8 *) r->Available.Data, size);
+            skip(r, newLine + 1);
+            return true;
+        }
+        searched = r->Available.Count;
+
+        // Grows the buffer only when the line fills all of it
+        if (!internal::reader_fill(r, r->Available.Count + 1)) break;
+    }
+
+    if (!r->Available.Count) return false;
+
+    line = string((const utf8 *) r->Available.Data, r->Available.Count);
+    skip(r, r->Available.Count);
+    return true;
+}
+
+// Frees the buffer, the reader can be used again (it allocates a new one).
+inline void free(reader *r) {
+    if (r->Buffer) free(r->Buffer);
+    r->Buffer = null;
+    r->Available = {};
+}
+
+LSTD_END_NAMESPACE
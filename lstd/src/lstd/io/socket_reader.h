@@ -0,0 +1,25 @@
+#pragma once
+
+#include "reader.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Reads from a connected TCP socket (see reader.h and os.*platform*.net). Each fill is one blocking recv
+// of as much as fits in the buffer, read_line() then hands out lines without copying them.
+//
+// The buffer is allocated with _Alloc_ (Context.Alloc if null) on first use, free it with free(&reader).
+//
+struct socket_reader : reader {
+    s64 Socket = -1;  // net_socket::Handle
+
+    bool Failed = false;  // A recv failed, we report the end of the input after it
+
+    socket_reader() {}
+    socket_reader(s64 socket) : Socket(socket) {}
+
+    // Defined in os.*platform*.net
+    s64 read_source(byte *dest, s64 size) override;
+};
+
+LSTD_END_NAMESPACE
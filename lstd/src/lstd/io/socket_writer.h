@@ -0,0 +1,38 @@
+#pragma once
+
+#include "writer.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Writes to a connected TCP socket (see os.*platform*.net). Small writes are combined in a buffer inside the writer,
+// a write which doesn't fit goes out together with what's buffered in one vectored send, so formatting
+// a response piece by piece costs one syscall per BUFFER_SIZE bytes:
+//
+//     socket_writer out(client.Handle);
+//     fmt_to_writer(&out, "HTTP/1.1 200 OK\r\nContent-Length: {}\r\n\r\n", body.Count);
+//     write(&out, body);
+//     flush(&out);
+//
+// Sends block. Nothing is allocated, the writer has no free().
+//
+struct socket_writer : writer {
+    static constexpr s64 BUFFER_SIZE = 8_KiB;
+
+    s64 Socket = -1;  // net_socket::Handle
+
+    byte Buffer[BUFFER_SIZE];
+    s64 Count = 0;
+
+    bool Failed = false;  // A send failed, the connection is probably gone
+
+    socket_writer() {}
+    socket_writer(s64 socket) : Socket(socket) {}
+
+    // Defined in os.*platform*.net
+    void write(const byte *data, s64 size) override;
+    void write_vectored(const bytes *spans, s64 count) override;
+    void flush() override;  // Sends what's buffered
+};
+
+LSTD_END_NAMESPACE
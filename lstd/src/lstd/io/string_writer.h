@@ -17,10 +17,82 @@ struct string_builder_writer : writer {
         //
         string_append(Builder, (const utf8 *) data, size);
     }
+
+    void write_vectored(const bytes *spans, s64 count) override {
+        For(range(count)) string_append(Builder, (const utf8 *) spans[it].Data, spans[it].Count);
+    }
 };
 
 inline void free(string_builder_writer &writer) {
     free(writer.Builder);
 }
 
+// Collects the output in a stack buffer and allocates once, at the exact size, in stack_string_writer_combine().
+// If the output doesn't fit it moves to a heap buffer which grows as needed, that buffer is then the result (no copy).
+// This is what sprint uses - most formatted strings are short and we don't pay for linking and zeroing
+// string_builder buffers.
+struct stack_string_writer : writer {
+    static constexpr s64 STACK_SIZE = 512;
+
+    utf8 StackData[STACK_SIZE];  // Not initialized on purpose, we only read what was written
+    s64 StackCount = 0;
+
+    string Heap;  // Allocated once the output doesn't fit in _StackData_
+
+    stack_string_writer() {}
+
+    void write(const byte *data, s64 size) override {
+        if (!Heap.Allocated) {
+            if (StackCount + size <= STACK_SIZE) {
+                copy_memory(StackData + StackCount, data, size);
+                StackCount += size;
+                return;
+            }
+
+            array_reserve(Heap, max(StackCount + size, 2 * STACK_SIZE));
+            copy_memory(Heap.Data, StackData, StackCount);
+            Heap.Count = StackCount;
+        }
+
+        array_reserve(Heap, size);
+        copy_memory(Heap.Data + Heap.Count, data, size);
+        Heap.Count += size;
+    }
+
+    void write_vectored(const bytes *spans, s64 count) override {
+        For(range(count)) stack_string_writer::write(spans[it].Data, spans[it].Count);
+    }
+};
+
+// Skips the stack buffer when the output is known to need more than it holds. _size_ may be an upper bound
+// (the heap buffer becomes the result, so it's over-allocated by the difference) or -1 if we don't know it.
+inline void stack_string_writer_reserve(stack_string_writer &writer, s64 size) {
+    if (size <= stack_string_writer::STACK_SIZE || writer.StackCount || writer.Heap.Allocated) return;
+    array_reserve_exact(writer.Heap, size);
+}
+
+// Returns what was written and resets the writer. The caller is responsible for freeing.
+[[nodiscard("Leak")]] inline string stack_string_writer_combine(stack_string_writer &writer) {
+    string result;
+    if (writer.Heap.Allocated) {
+        result = writer.Heap;
+        writer.Heap = string();
+    } else if (writer.StackCount) {
+        array_reserve_exact(result, writer.StackCount);
+        copy_memory(result.Data, writer.StackData, writer.StackCount);
+        result.Count = writer.StackCount;
+    }
+    writer.StackCount = 0;
+
+    // Count the code points once at the end, not on every write
+    result.Length = utf8_length(result.Data, result.Count);
+    return result;
+}
+
+// Frees the heap buffer if the output didn't fit and stack_string_writer_combine() wasn't called.
+inline void free(stack_string_writer &writer) {
+    free(writer.Heap);
+    writer.StackCount = 0;
+}
+
 LSTD_END_NAMESPACE
@@ -2,17 +2,24 @@
 
 #include "../internal/common.h"
 #include "../memory/string.h"
+#include "../memory/string_builder.h"
 
 LSTD_BEGIN_NAMESPACE
 
 // Provides a way to write types and bytes with a simple extension API.
 // Subclasses of this stuct override the write/flush methods depending on the output (console, files, buffers, etc.)
 // Types are written with the _write_ overloads.
+//
+// write_vectored() writes several spans in one call (like writev). The default calls write() for each,
+// outputs where a call is expensive (locks, syscalls) override it to handle all spans at once.
 struct writer {
     writer() {}
     virtual ~writer() {}
 
     virtual void write(const byte *data, s64 count) = 0;
+    virtual void write_vectored(const bytes *spans, s64 count) {
+        For(range(count)) write(spans[it].Data, spans[it].Count);
+    }
     virtual void flush() {}
 };
 
@@ -20,6 +27,25 @@ inline void write(writer *w, const byte *data, s64 size) { w->write(data, size);
 inline void write(writer *w, const bytes &data) { w->write(data.Data, data.Count); }
 inline void write(writer *w, const string &str) { w->write((byte *) str.Data, str.Count); }
 
+inline void write_vectored(writer *w, const bytes *spans, s64 count) { w->write_vectored(spans, count); }
+
+// Writes the buffers of the builder without combining them into one string first.
+inline void write(writer *w, const string_builder &builder) {
+    bytes spans[16];
+    s64 count = 0;
+
+    auto *b = &builder.BaseBuffer;
+    while (b) {
+        if (b->Occupied) spans[count++] = bytes((byte *) b->Data, b->Occupied);
+        if (count == 16) {
+            w->write_vectored(spans, count);
+            count = 0;
+        }
+        b = b->Next;
+    }
+    if (count) w->write_vectored(spans, count);
+}
+
 inline void write(writer *w, utf32 cp) {
     utf8 data[4];
     encode_cp(data, cp);
@@ -0,0 +1,700 @@
+#include "job_system.h"
+
+#include "fiber.h"
+#include "internal/context.h"
+#include "memory/array.h"
+#include "memory/reclaim.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+constexpr s64 JOB_DEQUE_CAPACITY = 4096;  // Per worker, a job pushed to a full deque runs right away
+constexpr s64 JOB_IDLE_ROUNDS    = 64;    // Times a worker looks for work before it goes to sleep
+constexpr s64 JOB_FIBER_STACK    = 256_KiB;
+
+//
+// The Chase-Lev deque ("Dynamic Circular Work-Stealing Deque", 2005, with the fixes from Lê et al. 2013).
+// The owner pushes and pops at the bottom without atomic read-modify-writes (except when one job is left),
+// thieves take from the top with a compare and swap. Fixed size, so there is no array to grow and retire.
+//
+struct job_deque {
+    alignas(64) s64 Top    = 0;  // Thieves
+    alignas(64) s64 Bottom = 0;  // The owner
+    alignas(64) job *Slots[JOB_DEQUE_CAPACITY];
+};
+
+// Called only by the owner. Returns false if the deque is full.
+file_scope bool job_deque_push(job_deque &d, job *j) {
+    s64 b = d.Bottom;
+    s64 t = atomic_load(&d.Top);
+    if (b - t >= JOB_DEQUE_CAPACITY) return false;
+
+    d.Slots[b & (JOB_DEQUE_CAPACITY - 1)] = j;
+    atomic_store(&d.Bottom, b + 1);  // Publishes the slot
+    return true;
+}
+
+// Called only by the owner.
+file_scope job *job_deque_pop(job_deque &d) {
+    s64 b = d.Bottom - 1;
+    atomic_swap(&d.Bottom, b);  // A full barrier, thieves must see the new bottom before we read the top
+    s64 t = atomic_load(&d.Top);
+
+    if (t > b) {
+        atomic_store(&d.Bottom, b + 1);  // Empty
+        return null;
+    }
+
+    job *j = d.Slots[b & (JOB_DEQUE_CAPACITY - 1)];
+    if (t == b) {
+        // The last one, race the thieves for it
+        if (atomic_compare_and_swap(&d.Top, t + 1, t) != t) j = null;
+        atomic_store(&d.Bottom, b + 1);
+    }
+    return j;
+}
+
+// Called by any thread. Returns null if the deque is empty or another thief won.
+file_scope job *job_deque_steal(job_deque &d) {
+    s64 t = atomic_load(&d.Top);
+    s64 b = atomic_load(&d.Bottom);
+    if (t >= b) return null;
+
+    job *j = d.Slots[t & (JOB_DEQUE_CAPACITY - 1)];
+    if (atomic_compare_and_swap(&d.Top, t + 1, t) != t) return null;
+    return j;
+}
+
+//
+// With fibers every job runs on a job fiber, the worker's own stack becomes the scheduler (see job_worker_main).
+// A job fiber which waits switches back to the scheduler of whatever worker it's on, the scheduler parks it on the
+// counter and runs something else. When the counter reaches zero the fiber goes to the ready list,
+// any worker can pick it up.
+//
+enum job_fiber_state : s32 {
+    JOB_FIBER_RUNNING,
+    JOB_FIBER_WAITING,  // On _WaitCounter_
+    JOB_FIBER_DONE,     // Out of jobs, back to the pool
+};
+
+struct job_fiber {
+    fiber Fiber;
+    job *Job = null;  // To run when switched to from the pool
+
+    job_fiber_state State    = JOB_FIBER_RUNNING;
+    job_counter *WaitCounter = null;
+
+    job_fiber *Next = null;  // In the pool, the ready list or a counter's waiting list
+};
+
+struct job_worker {
+    // Allocated by the worker itself once it's pinned, so its pages come from the worker's NUMA node.
+    // Null until then, thieves skip it.
+    job_deque *Deque = null;
+    thread::thread Thread;
+
+    s64 Index;
+    u64 Random;  // xorshift state for picking whom to steal from
+
+    s64 Processor = -1;  // The logical processor the worker is pinned to, -1 if it isn't
+    u32 NumaNode  = 0;
+
+    fiber Scheduler;
+    job_fiber *Switched = null;  // The fiber which just switched back to the scheduler
+};
+
+struct job_system_state {
+    job_worker *Workers = null;
+    s64 WorkerCount     = 0;
+    s64 NumaNodeCount   = 1;  // Of the processors the workers are pinned to
+
+    // Jobs submitted from threads which aren't workers
+    thread::mutex GlobalMutex;
+    array<job *> GlobalQueue;
+    s64 GlobalHead = 0;
+
+    // Sleeping. _Queued_ counts jobs in any deque or the global queue (it may be a bit ahead of them).
+    s64 Queued   = 0;
+    s64 Sleepers = 0;
+    thread::mutex SleepMutex;
+    thread::condition_variable SleepCondition;
+
+    s32 Stop = 0;
+
+    // Fibers, see job_fiber
+    bool UseFibers = false;
+    thread::mutex FiberMutex;
+    job_fiber *FreeFibers = null;
+    job_fiber *ReadyHead = null, *ReadyTail = null;
+    s64 ReadyCount      = 0;
+    s64 SuspendedFibers = 0;  // Waiting or ready, they may be using some worker's temporary memory
+    array<job_fiber *> AllFibers;
+};
+
+file_scope job_system_state JobSystem;
+file_scope thread_local s64 WorkerIndex = -1;
+file_scope thread_local job_fiber *CurrentFiber = null;
+
+// A fiber may continue on another thread after a switch. Compilers assume the address of a thread local doesn't
+// change inside a function and may keep it around, so code which switches reads them through these.
+never_inline file_scope s64 job_current_worker() { return WorkerIndex; }
+never_inline file_scope job_fiber *job_current_fiber() { return CurrentFiber; }
+
+file_scope void job_wake_one() {
+    if (!atomic_load(&JobSystem.Sleepers)) return;
+
+    thread::scoped_lock _(&JobSystem.SleepMutex);
+    JobSystem.SleepCondition.notify_one();
+}
+
+file_scope void job_execute(job *j);
+
+// Hands a ready job to the workers
+file_scope void job_schedule(job *j) {
+    auto &s = JobSystem;
+
+    // Counted before it's visible, so a worker never goes to sleep with a job it could have taken
+    atomic_inc(&s.Queued);
+
+    if (WorkerIndex != -1) {
+        if (!job_deque_push(*s.Workers[WorkerIndex].Deque, j)) {
+            atomic_add(&s.Queued, (s64) -1);
+            job_execute(j);
+            return;
+        }
+    } else {
+        thread::scoped_lock _(&s.GlobalMutex);
+        array_append(s.GlobalQueue, j);
+    }
+    job_wake_one();
+}
+
+file_scope void job_make_ready(job_fiber *f) {
+    auto &s = JobSystem;
+
+    f->Next = null;
+    {
+        thread::scoped_lock _(&s.FiberMutex);
+        if (s.ReadyTail) {
+            s.ReadyTail->Next = f;
+        } else {
+            s.ReadyHead = f;
+        }
+        s.ReadyTail = f;
+        atomic_inc(&s.ReadyCount);
+    }
+
+    atomic_inc(&s.Queued);  // Ready fibers are work too, sleeping workers should wake up for them
+    job_wake_one();
+}
+
+file_scope void job_counter_done(job_counter *c) {
+    // The last decrement happens under the lock, so a waiter which saw zero and then took the lock
+    // knows we are done with the counter (it's often on the waiter's stack)
+    while (true) {
+        s64 value = atomic_load(&c->Value);
+        assert(value > 0 && "Counter decremented more times than incremented");
+
+        if (value > 1) {
+            if (atomic_compare_and_swap(&c->Value, value - 1, value) == value) return;
+            continue;
+        }
+
+        c->Lock.lock();
+        if (atomic_compare_and_swap(&c->Value, (s64) 0, (s64) 1) == 1) break;
+        c->Lock.unlock();  // Someone incremented it meanwhile
+    }
+
+    // That was the last one, release the jobs and fibers which waited for it
+    job *list          = c->Continuations;
+    job_fiber *waiting = (job_fiber *) c->WaitingFibers;
+    c->Continuations   = null;
+    c->WaitingFibers   = null;
+    c->Lock.unlock();
+
+    while (list) {
+        job *next  = list->Next;
+        list->Next = null;
+        job_schedule(list);
+        list = next;
+    }
+
+    while (waiting) {
+        job_fiber *next = waiting->Next;
+        job_make_ready(waiting);
+        waiting = next;
+    }
+}
+
+file_scope void job_execute(job *j) {
+    j->Function(j->Data);
+    free(j->Function);
+
+    job_counter *c = j->Counter;
+    free(j);
+
+    if (c) job_counter_done(c);
+}
+
+file_scope job *job_take_global() {
+    auto &s = JobSystem;
+    if (atomic_load(&s.GlobalHead) == atomic_load(&s.GlobalQueue.Count)) return null;  // Peek, we check again under the lock
+
+    thread::scoped_lock _(&s.GlobalMutex);
+    if (s.GlobalHead == s.GlobalQueue.Count) return null;
+
+    job *j = s.GlobalQueue[s.GlobalHead++];
+    if (s.GlobalHead == s.GlobalQueue.Count) {
+        s.GlobalQueue.Count = 0;
+        s.GlobalHead        = 0;
+    }
+    return j;
+}
+
+// Looks for a job: our own deque first (the most recent job, its data is still in the cache),
+// then the shared queue, then the other workers starting from a random one. Workers on our NUMA node
+// are tried before the rest, a job from another node brings its data over the socket interconnect.
+file_scope job *job_take(s64 self, u64 *random) {
+    auto &s = JobSystem;
+
+    job *j = null;
+    if (self != -1) j = job_deque_pop(*s.Workers[self].Deque);
+    if (!j) j = job_take_global();
+
+    if (!j && s.WorkerCount) {
+        u64 x = *random;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *random = x;
+
+        u32 node  = self != -1 ? s.Workers[self].NumaNode : 0;
+        s64 start = (s64) (x % (u64) s.WorkerCount);
+
+        // The first pass is our node, the second the others (there is no second with a single node)
+        For_as(pass, range(s.NumaNodeCount > 1 ? 2 : 1)) {
+            For(range(s.WorkerCount)) {
+                s64 victim = (start + it) % s.WorkerCount;
+                if (victim == self) continue;
+
+                auto *w = s.Workers + victim;
+                if (s.NumaNodeCount > 1 && (w->NumaNode == node) != (pass == 0)) continue;
+
+                auto *d = atomic_load(&w->Deque);
+                if (!d) continue;
+
+                j = job_deque_steal(*d);
+                if (j) break;
+            }
+            if (j) break;
+        }
+    }
+
+    if (j) atomic_add(&s.Queued, (s64) -1);
+    return j;
+}
+
+file_scope job_fiber *job_take_ready() {
+    auto &s = JobSystem;
+    if (!atomic_load(&s.ReadyCount)) return null;
+
+    thread::scoped_lock _(&s.FiberMutex);
+    job_fiber *f = s.ReadyHead;
+    if (!f) return null;
+
+    s.ReadyHead = f->Next;
+    if (!s.ReadyHead) s.ReadyTail = null;
+    f->Next = null;
+
+    atomic_add(&s.ReadyCount, (s64) -1);
+    atomic_add(&s.Queued, (s64) -1);
+    return f;
+}
+
+// Switches from the running job fiber back to the scheduler of the worker we are on
+file_scope void job_fiber_yield(job_fiber *self, job_fiber_state state) {
+    auto *w     = JobSystem.Workers + job_current_worker();
+    self->State = state;
+    w->Switched = self;
+    fiber_switch(&self->Fiber, &w->Scheduler);
+}
+
+// Job fibers run jobs until there are none left (or a waiting fiber became ready), then go back to the pool
+file_scope void job_fiber_main(void *data) {
+    auto *self = (job_fiber *) data;
+
+    while (true) {
+        job *j    = self->Job;
+        self->Job = null;
+
+        while (j) {
+            job_execute(j);
+            if (atomic_load(&JobSystem.ReadyCount)) break;  // Let the scheduler resume it, it's holding up a counter
+
+            u64 random = (u64) self ^ 0x9E3779B97F4A7C15ull;
+            j          = job_take(job_current_worker(), &random);
+        }
+        job_fiber_yield(self, JOB_FIBER_DONE);
+    }
+}
+
+file_scope job_fiber *job_get_free_fiber() {
+    auto &s = JobSystem;
+    {
+        thread::scoped_lock _(&s.FiberMutex);
+        if (s.FreeFibers) {
+            job_fiber *f = s.FreeFibers;
+            s.FreeFibers = f->Next;
+            f->Next      = null;
+            return f;
+        }
+    }
+
+    auto *f = allocate<job_fiber>({.Alloc = internal::platform_get_persistent_allocator()});
+    if (!fiber_create(&f->Fiber, job_fiber_main, f, JOB_FIBER_STACK)) {
+        free(f);
+        return null;
+    }
+
+    thread::scoped_lock _(&s.FiberMutex);
+    array_append(s.AllFibers, f);
+    return f;
+}
+
+// Runs on the scheduler after a job fiber switched back to it. The fiber's stack isn't in use anymore,
+// so only now can it be handed to other threads.
+file_scope void job_fiber_switched(job_worker *w) {
+    auto &s = JobSystem;
+
+    job_fiber *f = w->Switched;
+    w->Switched  = null;
+    CurrentFiber = null;
+
+    if (f->State == JOB_FIBER_DONE) {
+        thread::scoped_lock _(&s.FiberMutex);
+        f->Next      = s.FreeFibers;
+        s.FreeFibers = f;
+        return;
+    }
+
+    assert(f->State == JOB_FIBER_WAITING);
+
+    // The counter reaches zero either before we take the lock (then we see it) or after we release it
+    // (then job_counter_done finds the fiber in the list)
+    job_counter *c = f->WaitCounter;
+    c->Lock.lock();
+    if (atomic_load(&c->Value) > 0) {
+        f->Next          = (job_fiber *) c->WaitingFibers;
+        c->WaitingFibers = f;
+        c->Lock.unlock();
+        return;
+    }
+    c->Lock.unlock();
+    job_make_ready(f);
+}
+
+// Runs _f_ from where it left off (or starts it with a new job) on the calling worker
+file_scope void job_fiber_run(job_worker *w, job_fiber *f) {
+    f->State     = JOB_FIBER_RUNNING;
+    CurrentFiber = f;
+    fiber_switch(&w->Scheduler, &f->Fiber);
+    job_fiber_switched(w);
+}
+
+// The scheduler's part of one round: resume a ready fiber or start a job on a fiber from the pool
+file_scope bool job_worker_run_fibers(job_worker *w) {
+    auto &s = JobSystem;
+
+    if (job_fiber *f = job_take_ready()) {
+        atomic_add(&s.SuspendedFibers, (s64) -1);
+        job_fiber_run(w, f);
+        return true;
+    }
+
+    job *j = job_take(w->Index, &w->Random);
+    if (!j) return false;
+
+    job_fiber *f = job_get_free_fiber();
+    if (!f) {
+        job_execute(j);  // Out of memory for stacks, the job runs without a fiber
+        return true;
+    }
+
+    f->Job = j;
+    job_fiber_run(w, f);
+    return true;
+}
+
+file_scope void job_worker_main(void *data) {
+    auto *w     = (job_worker *) data;
+    auto &s     = JobSystem;
+    WorkerIndex = w->Index;
+
+    if (w->Processor != -1) thread::set_current_affinity((u32) w->Processor);
+
+    // Fresh pages, touched first here: both Windows and Linux back a page from the node of the thread
+    // which touches it first. Anything else the worker allocates for itself (e.g. its TempAlloc pool) is also
+    // made on first use, after this point, so it ends up on our node as well.
+    auto *deque = (job_deque *) os_reserve_memory(sizeof(job_deque));
+    bool committed = deque && os_commit_memory(deque, sizeof(job_deque));
+    assert(committed && "Out of memory for the job deque");
+    zero_memory(deque, sizeof(job_deque));
+    atomic_store(&w->Deque, deque);
+
+    if (s.UseFibers) fiber_convert_thread(&w->Scheduler);
+
+    s64 idle = 0;
+    while (true) {
+        bool ran;
+        if (s.UseFibers) {
+            ran = job_worker_run_fibers(w);
+        } else {
+            job *j = job_take(w->Index, &w->Random);
+            if (j) job_execute(j);
+            ran = j != null;
+        }
+
+        if (ran) {
+            idle = 0;
+            continue;
+        }
+
+        // Suspended fibers still have work to do and will become ready when their counters reach zero
+        if (atomic_load(&s.Stop) && !atomic_load(&s.SuspendedFibers)) break;
+
+        if (++idle < JOB_IDLE_ROUNDS) {
+            thread::sleep(0);
+            continue;
+        }
+
+        // Out of work. Nothing of the jobs we ran can still be using temporary memory,
+        // unless a suspended fiber allocated some and may continue on any thread.
+        if (!atomic_load(&s.SuspendedFibers)) free_all(Context.TempAlloc);
+
+        // Blocks our jobs retired which nobody can be reading anymore (see reclaim.h)
+        reclaim_flush();
+
+        // The submitter bumps _Queued_ before it checks _Sleepers_ and we do the opposite,
+        // so one of us sees the other and the job isn't left sitting in a queue.
+        atomic_inc(&s.Sleepers);
+        {
+            thread::scoped_lock _(&s.SleepMutex);
+            while (atomic_load(&s.Queued) <= 0 && !atomic_load(&s.Stop)) s.SleepCondition.wait(&s.SleepMutex);
+        }
+        atomic_add(&s.Sleepers, (s64) -1);
+        idle = 0;
+    }
+
+    reclaim_thread_release();
+
+    if (s.UseFibers) fiber_revert_thread(&w->Scheduler);
+}
+
+// The processors to pin workers to, in order: one per physical core first (package by package, so a few
+// workers stay on one socket), then the hyperthreads. Returns how many were written to _order_.
+file_scope s64 job_worker_placement(const cpu_topology *t, s64 *order) {
+    bool taken[MAX_LOGICAL_PROCESSORS] = {};
+    s64 count = 0;
+
+    For_as(smt, range(2)) {
+        For_as(package, range(t->PackageCount)) {
+            For(range(t->ProcessorCount)) {
+                auto &p = t->Processors[it];
+                if (taken[it] || p.Package != package) continue;
+
+                if (smt == 0) {
+                    // Skip if another processor of this core came first
+                    bool first = true;
+                    For_as(other, range(it)) {
+                        if (t->Processors[other].Core == p.Core) {
+                            first = false;
+                            break;
+                        }
+                    }
+                    if (!first) continue;
+                }
+
+                taken[it]      = true;
+                order[count++] = it;
+            }
+        }
+    }
+    return count;
+}
+
+void job_system_init(s64 workerCount, bool fibers, bool pinWorkers) {
+    auto &s = JobSystem;
+    assert(!s.WorkerCount && "Job system already running");
+
+    if (!workerCount) workerCount = os_get_hardware_concurrency();
+    assert(workerCount > 0);
+
+    s.GlobalMutex.init();
+    s.SleepMutex.init();
+    s.SleepCondition.init();
+    s.FiberMutex.init();
+    atomic_store(&s.Stop, 0);
+    s.UseFibers = fibers;
+
+    // The deques are written by different threads, so each gets its own cache lines
+    s.Workers = allocate_array<job_worker>(workerCount, {.Alloc = internal::platform_get_persistent_allocator(), .Alignment = 64});
+    s64 order[MAX_LOGICAL_PROCESSORS];
+    auto *topology = os_get_cpu_topology();
+    s64 placements = pinWorkers ? job_worker_placement(topology, order) : 0;
+
+    bool nodes[MAX_LOGICAL_PROCESSORS] = {};
+    s.NumaNodeCount = 0;
+
+    For(range(workerCount)) {
+        auto *w   = s.Workers + it;
+        w->Index  = it;
+        w->Random = 0x9E3779B97F4A7C15ull * (it + 1);
+
+        // More workers than processors share them round robin
+        if (placements) {
+            w->Processor = order[it % placements];
+            w->NumaNode  = topology->Processors[w->Processor].NumaNode;
+        }
+
+        if (!nodes[w->NumaNode]) s.NumaNodeCount++;
+        nodes[w->NumaNode] = true;
+    }
+
+    // The count is set before the threads start, workers steal from each other right away
+    s.WorkerCount = workerCount;
+    For(range(workerCount)) s.Workers[it].Thread.init_and_launch(job_worker_main, s.Workers + it);
+}
+
+void job_system_release() {
+    auto &s = JobSystem;
+    if (!s.WorkerCount) return;
+
+    {
+        thread::scoped_lock _(&s.SleepMutex);
+        atomic_store(&s.Stop, 1);
+        s.SleepCondition.notify_all();
+    }
+    For(range(s.WorkerCount)) {
+        s.Workers[it].Thread.wait();
+        os_release_memory(s.Workers[it].Deque);
+    }
+
+    free(s.Workers);
+    s.Workers     = null;
+    s.WorkerCount = 0;
+
+    free(s.GlobalQueue);
+    s.GlobalHead = 0;
+
+    For(s.AllFibers) {
+        fiber_release(&it->Fiber);
+        free(it);
+    }
+    free(s.AllFibers);
+    s.FreeFibers = null;
+    s.UseFibers  = false;
+
+    s.FiberMutex.release();
+    s.SleepCondition.release();
+    s.SleepMutex.release();
+    s.GlobalMutex.release();
+}
+
+s64 job_system_worker_count() { return JobSystem.WorkerCount; }
+
+s64 job_system_worker_index() { return WorkerIndex; }
+
+void job_run(const owning_delegate<void(void *)> &function, void *data, job_counter *counter, job_counter *dependency) {
+    if (counter) atomic_inc(&counter->Value);
+
+    auto *j     = allocate<job>({.Alloc = internal::platform_get_persistent_allocator()});
+    j->Function = function;
+    j->Data     = data;
+    j->Counter  = counter;
+
+    if (!JobSystem.WorkerCount) {
+        // Everything ran right away, so nothing can be pending on _dependency_
+        job_execute(j);
+        return;
+    }
+
+    if (dependency) {
+        dependency->Lock.lock();
+        if (atomic_load(&dependency->Value)) {
+            j->Next                   = dependency->Continuations;
+            dependency->Continuations = j;
+            dependency->Lock.unlock();
+            return;
+        }
+        dependency->Lock.unlock();
+    }
+    job_schedule(j);
+}
+
+void job_wait(job_counter *counter) {
+    if (!counter) return;
+
+    job_fiber *self = job_current_fiber();
+    if (self && atomic_load(&counter->Value) > 0) {
+        // Give the worker to other jobs, the scheduler parks us on the counter (see job_fiber_switched).
+        // When this returns the counter is zero (and let go of) and we may be on another thread.
+        self->WaitCounter = counter;
+        atomic_inc(&JobSystem.SuspendedFibers);
+        job_fiber_yield(self, JOB_FIBER_WAITING);
+        self->WaitCounter = null;
+        return;
+    }
+
+    u64 random = 0x2545F4914F6CDD1Dull ^ (u64) counter;
+    while (atomic_load(&counter->Value) > 0) {
+        job *j = job_take(WorkerIndex, &random);
+        if (j) {
+            job_execute(j);
+        } else {
+            thread::sleep(0);  // What's left is running on other threads
+        }
+    }
+
+    // Wait for whoever brought it to zero to let go of it, see job_counter_done
+    counter->Lock.lock();
+    counter->Lock.unlock();
+}
+
+void job_counter_add(job_counter *counter, s64 count) { atomic_add(&counter->Value, count); }
+
+void job_counter_signal(job_counter *counter) { job_counter_done(counter); }
+
+struct job_parallel_for_piece {
+    const delegate<void(s64, s64)> *Body;
+    s64 Begin, End;
+};
+
+file_scope void job_parallel_for_run(void *data) {
+    auto *piece = (job_parallel_for_piece *) data;
+    (*piece->Body)(piece->Begin, piece->End);
+}
+
+void job_parallel_for(s64 count, s64 batchSize, const delegate<void(s64 begin, s64 end)> &body) {
+    assert(batchSize > 0);
+    if (count <= 0) return;
+
+    s64 pieceCount = (count + batchSize - 1) / batchSize;
+    if (pieceCount == 1) {
+        body(0, count);
+        return;
+    }
+
+    auto *pieces = allocate_array<job_parallel_for_piece>(pieceCount, {.Alloc = internal::platform_get_persistent_allocator()});
+    defer(free(pieces));
+
+    job_counter done;
+    For(range(pieceCount)) {
+        s64 begin  = it * batchSize;
+        pieces[it] = {&body, begin, min(begin + batchSize, count)};
+        job_run(job_parallel_for_run, pieces + it, &done);
+    }
+    job_wait(&done);
+}
+
+LSTD_END_NAMESPACE
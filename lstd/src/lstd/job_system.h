@@ -0,0 +1,209 @@
+#pragma once
+
+#include "internal/context.h"
+#include "memory/array_like.h"
+#include "memory/hash_table.h"
+#include "thread.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A job system: one worker thread per core which run small pieces of work (jobs) handed to them.
+//
+// Starting a thread for each parallel task allocates, copies the Context and costs a trip to the kernel.
+// Here the workers live as long as the program, and handing them a job is a push to a deque.
+//
+//     job_system_init();  // Workers for os_get_hardware_concurrency() cores
+//
+//     job_counter done;
+//     For(range(64)) job_run(process_chunk, chunks + it, &done);
+//     job_wait(&done);  // Runs jobs itself while it waits instead of sleeping
+//
+//     // Or with a dependency: _upload_ waits for all 64 chunks without blocking anyone
+//     job_run(upload, data, null, &done);
+//
+//     job_parallel_for(count, 1024, [&](s64 begin, s64 end) { ... });
+//
+// Every worker owns a work-stealing deque (Chase-Lev). A worker pushes and pops its own jobs at the bottom,
+// so jobs which spawn jobs stay on the same core and its cache, the others steal from the top when they run out.
+// Jobs submitted from threads which aren't workers go to a shared queue.
+//
+// Each worker is a normal thread, so it has its own Context with its own TempAlloc. Temporary memory is freed
+// when the worker runs out of jobs, so a job shouldn't hand temporary allocations to jobs that run after it.
+//
+// The Context a job runs with is the worker's (copied from the thread which called job_system_init),
+// not the one of the thread which submitted it.
+//
+// By default a job which calls job_wait runs other jobs on top of its own stack until the counter is done.
+// That can go deep, and the waiting job can't continue before the jobs it picked up finish, even if its counter
+// reached zero long ago. With _fibers_ every job runs on a fiber (see fiber.h) and job_wait switches away from it,
+// the job sits on the counter without a stack frame on anyone and continues on whichever worker is free when
+// the counter reaches zero. The catch is that after job_wait the job may be on another thread: don't keep
+// pointers to thread locals (or allocations from TempAlloc) across the wait and don't wait inside a PUSH_CONTEXT.
+//
+
+struct job;
+
+// Counts unfinished jobs. Pass it to job_run, then job_wait on it or make other jobs depend on it.
+// Zero means everything counted is done, a counter can be reused after that.
+struct job_counter {
+    s64 Value = 0;
+
+    // Jobs which wait for _Value_ to reach zero
+    thread::fast_mutex Lock;
+    job *Continuations  = null;
+    void *WaitingFibers = null;  // Jobs which called job_wait, when the job system runs with fibers
+};
+
+struct job {
+    owning_delegate<void(void *)> Function;
+    void *Data = null;
+
+    job_counter *Counter = null;  // Decremented when the job is done
+    job *Next            = null;  // In a continuation list
+};
+
+// Starts _workerCount_ workers (0 means one per logical processor, see os_get_hardware_concurrency()).
+// With _fibers_ jobs run on pooled fibers and job_wait in a job suspends it instead of running other jobs inside it.
+//
+// With _pinWorkers_ each worker stays on one logical processor (see os_get_cpu_topology()): physical cores first,
+// filling a socket before moving to the next, hyperthreads last. A worker's memory is then on its NUMA node and
+// idle workers steal from their own node first. Turn it off if other busy processes share the machine.
+void job_system_init(s64 workerCount = 0, bool fibers = false, bool pinWorkers = true);
+
+// Finishes the jobs which are already queued and stops the workers.
+void job_system_release();
+
+// The number of workers, 0 if the job system isn't running
+s64 job_system_worker_count();
+
+// The index of the worker running on the calling thread, -1 if it isn't a worker
+s64 job_system_worker_index();
+
+// Queues _function(data)_. If _counter_ is given it is incremented now and decremented when the job is done.
+// If _dependency_ is given the job is held back until that counter reaches zero (it doesn't wait if it's zero already).
+//
+// _function_ may be a lambda passed by value, its captures are copied into the job (see owning_delegate),
+// so nothing has to outlive the call: job_run([=](void *) { ... }, null, &done);
+//
+// Falls back to running the job right away if the job system isn't running.
+void job_run(const owning_delegate<void(void *)> &function, void *data = null, job_counter *counter = null, job_counter *dependency = null);
+
+// Waits for the counter to reach zero. Meanwhile the calling thread runs queued jobs, so waiting in a job
+// doesn't take a worker away. In a job with fibers on, the job is suspended and the worker moves on instead.
+void job_wait(job_counter *counter);
+
+// For work which isn't a job (a coroutine, a request to the OS...) but which others should be able to wait on:
+// add to the counter when it starts and signal it when it's done. Jobs waiting for zero are released as usual.
+void job_counter_add(job_counter *counter, s64 count = 1);
+void job_counter_signal(job_counter *counter);
+
+// Runs _body(begin, end)_ over [0, count) in pieces of _batchSize_ on the workers and waits for all of them.
+void job_parallel_for(s64 count, s64 batchSize, const delegate<void(s64 begin, s64 end)> &body);
+
+//
+// Loops on top of job_parallel_for. The bodies are templates (not delegates), so the per element call inlines
+// and only the per piece call is indirect.
+//
+// _grain_ is how many elements one job gets. 0 picks it: about 8 pieces per worker, so a slow piece can be
+// balanced out by the others without paying for a job per element.
+//
+//     parallel_for(points, 0, [](vec3 &p, s64 index) { p = normalize(p); });
+//     parallel_for(table, 0, [](const string &key, entity &e) { update(e); });
+//
+//     f64 sum = parallel_reduce(range(n), 0, 0.0, [&](f64 acc, s64 it) { return acc + values[it]; },
+//                                                 [](f64 a, f64 b) { return a + b; });
+//
+// Every piece reduces into its own partial result and the partials are combined in order on the calling thread,
+// so the result doesn't depend on how pieces were scheduled (which matters for floating point).
+//
+
+inline s64 parallel_grain(s64 count, s64 grain) {
+    if (grain > 0) return grain;
+
+    s64 workers = job_system_worker_count();
+    if (!workers) return count > 0 ? count : 1;  // Everything runs on the caller anyway
+    return max((s64) 1, count / (workers * 8));
+}
+
+// The number of values _r_ iterates over
+constexpr s64 range_count(range r) {
+    s64 start = r.Begin.I, stop = r.End.I, step = r.Begin.Step;
+    if (step > 0) return stop > start ? (stop - start + step - 1) / step : 0;
+    return start > stop ? (start - stop - step - 1) / -step : 0;
+}
+
+// Calls _body(it)_ for every value of _r_
+template <typename Body>
+void parallel_for(range r, s64 grain, Body &&body) {
+    s64 count = range_count(r);
+    s64 start = r.Begin.I, step = r.Begin.Step;
+
+    auto piece = [&](s64 begin, s64 end) {
+        For_as(i, range(begin, end)) body(start + i * step);
+    };
+    job_parallel_for(count, parallel_grain(count, grain), &piece);
+}
+
+// Calls _body(element, index)_ for every element of _arr_ (any array-like: array, stack_array, string...)
+template <is_array_like Arr, typename Body>
+void parallel_for(Arr &arr, s64 grain, Body &&body) {
+    auto *data = arr.Data;
+
+    auto piece = [&](s64 begin, s64 end) {
+        For_as(i, range(begin, end)) body(data[i], i);
+    };
+    job_parallel_for(arr.Count, parallel_grain(arr.Count, grain), &piece);
+}
+
+// Folds _r_ with _body(accumulator, it)_ starting from _identity_ in every piece, then folds the pieces with _combine(a, b)_
+template <typename T, typename Body, typename Combine>
+T parallel_reduce(range r, s64 grain, T identity, Body &&body, Combine &&combine) {
+    s64 count = range_count(r);
+    if (!count) return identity;
+
+    s64 start = r.Begin.I, step = r.Begin.Step;
+
+    grain          = parallel_grain(count, grain);
+    s64 pieceCount = (count + grain - 1) / grain;
+
+    auto *partials = allocate_array<T>(pieceCount, {.Alloc = Context.TempAlloc});
+    defer(free(partials));
+
+    auto piece = [&](s64 begin, s64 end) {
+        T acc = identity;
+        For_as(i, range(begin, end)) acc = body(acc, start + i * step);
+        partials[begin / grain] = acc;
+    };
+    job_parallel_for(count, grain, &piece);
+
+    T result = partials[0];
+    For(range(1, pieceCount)) result = combine(result, partials[it]);
+    return result;
+}
+
+// Folds the elements of _arr_ with _body(accumulator, element)_, see the range version
+template <typename T, is_array_like Arr, typename Body, typename Combine>
+T parallel_reduce(Arr &arr, s64 grain, T identity, Body &&body, Combine &&combine) {
+    auto *data = arr.Data;
+    return parallel_reduce(
+        range(arr.Count), grain, identity, [&](T acc, s64 it) { return body(acc, data[it]); }, combine);
+}
+
+// Calls _body(key, value)_ for every entry of a hash_table. The jobs get ranges of slots (whole words of _Occupied_),
+// so _grain_ counts slots, not entries. Don't add to or remove from the table meanwhile.
+template <any_hash_table T, typename Body>
+void parallel_for(T &table, s64 grain, Body &&body) {
+    grain = (parallel_grain(table.Allocated, grain) + 63) & ~63ll;
+
+    auto piece = [&](s64 begin, s64 end) {
+        s64 index = hash_table_next_filled(table, begin);
+        while (index < end) {
+            body(table.Keys[index], table.Values[index]);
+            index = hash_table_next_filled(table, index + 1);
+        }
+    };
+    job_parallel_for(table.Allocated, grain, &piece);
+}
+
+LSTD_END_NAMESPACE
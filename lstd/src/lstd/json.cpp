@@ -0,0 +1,276 @@
+#include "json.h"
+
+#include "internal/context.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2 and AVX2 intrinsics
+
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Stage 1 - the structural index.
+//
+// The kernels below only classify bytes, 64 at a time, into bit masks (bit i is byte i of the block). Everything
+// after that is plain 64 bit arithmetic shared by all of them:
+//
+// * A quote is escaped if it comes after an odd number of backslashes. The runs of backslashes are found
+//   with an add which carries through them (see json_find_escaped, from simdjson).
+// * The bytes inside strings are the prefix xor of the unescaped quotes - 1 from an opening quote up to
+//   (not including) the closing one.
+// * Outside strings: {}[]:, are structural and so is the first byte of each run of bytes which aren't
+//   white space, structural or a quote (numbers and literals).
+//
+// State carried between blocks: whether the last block ended with an odd run of backslashes, inside a string,
+// or in the middle of a scalar.
+//
+
+struct json_block_masks {
+    u64 Quote;
+    u64 Backslash;
+    u64 Space;
+    u64 Op;       // {}[]:,
+    u64 Control;  // < 0x20, not allowed in strings
+};
+
+using json_classify_func = void (*)(const byte *data, s64 blocks, json_block_masks *out);
+
+file_scope void json_classify_scalar(const byte *data, s64 blocks, json_block_masks *out) {
+    For_as(block, range(blocks)) {
+        json_block_masks m = {};
+        For(range(64)) {
+            byte b = data[block * 64 + it];
+            u64 bit = 1ull << it;
+
+            if (b == '"') m.Quote |= bit;
+            if (b == '\\') m.Backslash |= bit;
+            if (b == ' ' || b == '\t' || b == '\n' || b == '\r') m.Space |= bit;
+            if (b == '{' || b == '}' || b == '[' || b == ']' || b == ':' || b == ',') m.Op |= bit;
+            if (b < 0x20) m.Control |= bit;
+        }
+        out[block] = m;
+    }
+}
+
+#if ARCH == X86
+file_scope void json_classify_sse2(const byte *data, s64 blocks, json_block_masks *out) {
+    const __m128i controlMax = _mm_set1_epi8(0x1F);
+
+    For_as(block, range(blocks)) {
+        json_block_masks m = {};
+        For(range(4)) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (data + block * 64 + it * 16));
+
+            auto eq = [&](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+
+            __m128i space = _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\r')));
+            __m128i op = _mm_or_si128(_mm_or_si128(_mm_or_si128(eq('{'), eq('}')), _mm_or_si128(eq('['), eq(']'))), _mm_or_si128(eq(':'), eq(',')));
+            __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(v, controlMax), controlMax);
+
+            s32 shift = it * 16;
+            m.Quote |= (u64) (u32) _mm_movemask_epi8(eq('"')) << shift;
+            m.Backslash |= (u64) (u32) _mm_movemask_epi8(eq('\\')) << shift;
+            m.Space |= (u64) (u32) _mm_movemask_epi8(space) << shift;
+            m.Op |= (u64) (u32) _mm_movemask_epi8(op) << shift;
+            m.Control |= (u64) (u32) _mm_movemask_epi8(control) << shift;
+        }
+        out[block] = m;
+    }
+}
+
+TARGET_AVX2 file_scope void json_classify_avx2(const byte *data, s64 blocks, json_block_masks *out) {
+    const __m256i controlMax = _mm256_set1_epi8(0x1F);
+
+    For_as(block, range(blocks)) {
+        json_block_masks m = {};
+        For(range(2)) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (data + block * 64 + it * 32));
+
+            // Not a lambda, GCC and Clang won't inline it into a function with a different target
+#define EQ(c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+            __m256i space = _mm256_or_si256(_mm256_or_si256(EQ(' '), EQ('\t')), _mm256_or_si256(EQ('\n'), EQ('\r')));
+            __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(EQ('{'), EQ('}')), _mm256_or_si256(EQ('['), EQ(']'))), _mm256_or_si256(EQ(':'), EQ(',')));
+            __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(v, controlMax), controlMax);
+
+            s32 shift = it * 32;
+            m.Quote |= (u64) (u32) _mm256_movemask_epi8(EQ('"')) << shift;
+            m.Backslash |= (u64) (u32) _mm256_movemask_epi8(EQ('\\')) << shift;
+            m.Space |= (u64) (u32) _mm256_movemask_epi8(space) << shift;
+            m.Op |= (u64) (u32) _mm256_movemask_epi8(op) << shift;
+            m.Control |= (u64) (u32) _mm256_movemask_epi8(control) << shift;
+#undef EQ
+        }
+        out[block] = m;
+    }
+}
+#endif
+
+file_scope u64 json_prefix_xor(u64 x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Returns the bytes which come after an odd number of backslashes. _prevEndsOdd_ is 1 if the previous block
+// ended with an odd run, updated for the next block.
+file_scope u64 json_find_escaped(u64 backslash, u64 &prevEndsOdd) {
+    constexpr u64 EVEN_BITS = 0x5555555555555555ull;
+    constexpr u64 ODD_BITS  = ~EVEN_BITS;
+
+    u64 startEdges    = backslash & ~(backslash << 1);
+    u64 evenStartMask = EVEN_BITS ^ prevEndsOdd;
+    u64 evenStarts    = startEdges & evenStartMask;
+    u64 oddStarts     = startEdges & ~evenStartMask;
+
+    // Adding the start of a run to the run carries to the byte right after it
+    u64 evenCarries = backslash + evenStarts;
+    u64 oddCarries  = backslash + oddStarts;
+
+    bool endsOdd = oddCarries < backslash;  // The carry went out of the block
+    oddCarries |= prevEndsOdd;
+    prevEndsOdd = endsOdd;
+
+    // A run which started at an even position and ended at an odd one (or the reverse) has an odd length
+    u64 evenCarryEnds = evenCarries & ~backslash;
+    u64 oddCarryEnds  = oddCarries & ~backslash;
+    return (evenCarryEnds & ODD_BITS) | (oddCarryEnds & EVEN_BITS);
+}
+
+struct json_stage1_state {
+    u64 PrevEndsOdd  = 0;
+    u64 PrevInString = 0;  // All ones if the last block ended inside a string
+    u64 PrevScalar   = 0;
+};
+
+// Appends the structural offsets of one block to the index. Returns the offset of a control character inside a string, or -1.
+file_scope s64 json_index_block(json_document &doc, json_stage1_state &state, const json_block_masks &m, u32 base) {
+    u64 escaped  = json_find_escaped(m.Backslash, state.PrevEndsOdd);
+    u64 quote    = m.Quote & ~escaped;
+    u64 inString = json_prefix_xor(quote) ^ state.PrevInString;
+    state.PrevInString = (u64) ((s64) inString >> 63);
+
+    if (m.Control & inString) return base + lsb(m.Control & inString);
+
+    u64 scalar      = ~(m.Op | m.Space | quote) & ~inString;
+    u64 scalarStart = scalar & ~(scalar << 1 | state.PrevScalar);
+    state.PrevScalar = scalar >> 63;
+
+    // The opening quotes are the ones inside strings
+    u64 structural = (m.Op & ~inString) | (quote & inString) | scalarStart;
+
+    array_reserve(doc.Index, 64);
+    while (structural) {
+        doc.Index.Data[doc.Index.Count++] = base + lsb(structural);
+        structural &= structural - 1;
+    }
+    return -1;
+}
+
+file_scope parse_status json_fail(json_document &doc, parse_status status, s64 offset) {
+    doc.ErrorOffset = offset;
+    return status;
+}
+
+parse_status json_parse(json_document &doc, bytes input, allocator alloc) {
+    assert(input.Count < numeric_info<u32>::max() && "JSON documents are limited to 4 GiB");
+
+    doc.Input       = input;
+    doc.Alloc       = alloc ? alloc : Context.TempAlloc;
+    doc.ErrorOffset = -1;
+    array_reset(doc.Index);
+    array_reset(doc.Match);
+
+    s64 invalidAt = utf8_find_invalid((const utf8 *) input.Data, input.Count);
+    if (invalidAt != -1) return json_fail(doc, PARSE_INVALID, invalidAt);
+
+    local_persist cpu_dispatch<json_classify_func> kernel;
+    auto classify = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> json_classify_func {
+#if ARCH == X86
+        return cpu.AVX2 ? json_classify_avx2 : json_classify_sse2;
+#else
+        return json_classify_scalar;
+#endif
+    });
+
+    // Structurals are usually a small fraction of the input
+    array_reserve(doc.Index, input.Count / 8 + 1);
+
+    json_stage1_state state;
+
+    // Classify in batches so the kernel call is amortized and the masks stay in cache
+    constexpr s64 BATCH_BLOCKS = 64;
+    json_block_masks masks[BATCH_BLOCKS];
+
+    s64 fullBlocks = input.Count / 64;
+    for (s64 block = 0; block < fullBlocks; block += BATCH_BLOCKS) {
+        s64 count = min(BATCH_BLOCKS, fullBlocks - block);
+        classify(input.Data + block * 64, count, masks);
+
+        For(range(count)) {
+            s64 control = json_index_block(doc, state, masks[it], (u32) ((block + it) * 64));
+            if (control != -1) return json_fail(doc, PARSE_INVALID, control);
+        }
+    }
+
+    if (input.Count % 64) {
+        // White space padding doesn't change anything
+        byte tail[64];
+        fill_memory(tail, ' ', 64);
+        copy_memory(tail, input.Data + fullBlocks * 64, input.Count % 64);
+
+        classify(tail, 1, masks);
+        s64 control = json_index_block(doc, state, masks[0], (u32) (fullBlocks * 64));
+        if (control != -1) return json_fail(doc, PARSE_INVALID, control);
+    }
+
+    if (state.PrevInString) return json_fail(doc, PARSE_EXHAUSTED, input.Count);
+
+    s64 count = doc.Index.Count;
+    array_append(doc.Index, (u32) input.Count);
+
+    if (!count) return json_fail(doc, PARSE_EXHAUSTED, input.Count);
+
+    //
+    // Match the brackets. While a bracket is open, its entry in _Match_ links to the one which encloses it
+    // (so the stack is threaded through the array itself), when it closes it gets overwritten with the closing position.
+    //
+    array_reserve_exact(doc.Match, doc.Index.Count);
+    doc.Match.Count = doc.Index.Count;
+
+    constexpr u32 NO_PARENT = numeric_info<u32>::max();
+
+    u32 top = NO_PARENT;
+    For(range(count)) {
+        byte b = input[doc.Index[it]];
+        if (b == '[' || b == '{') {
+            doc.Match[it] = top;
+            top           = (u32) it;
+        } else if (b == ']' || b == '}') {
+            byte open = b == ']' ? '[' : '{';
+            if (top == NO_PARENT || input[doc.Index[top]] != open) return json_fail(doc, PARSE_INVALID, doc.Index[it]);
+
+            u32 parent     = doc.Match[top];
+            doc.Match[top] = (u32) it;
+            top            = parent;
+        }
+    }
+    if (top != NO_PARENT) return json_fail(doc, PARSE_EXHAUSTED, input.Count);
+
+    // Exactly one root value
+    s64 rootEnd = internal::json_skip(&doc, 0);
+    if (rootEnd != count) return json_fail(doc, PARSE_INVALID, doc.Index[rootEnd]);
+
+    return PARSE_SUCCESS;
+}
+
+LSTD_END_NAMESPACE
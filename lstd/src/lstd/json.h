@@ -0,0 +1,429 @@
+#pragma once
+
+#include "memory/array.h"
+#include "memory/string.h"
+#include "parse.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A JSON reader in two stages (the design of simdjson's On Demand API).
+//
+// json_parse() makes one SIMD pass over the input and records the offset of every structural byte: {}[]:, the
+// opening quote of each string and the first byte of every other scalar (numbers, true, false, null). Quotes,
+// backslashes and white space are classified 64 bytes at a time and strings are found with a prefix xor over the
+// unescaped quotes, so nothing inside a string is mistaken for structure. The same call validates the input as
+// UTF-8 and matches every bracket with its closing one, which makes skipping a whole array or object a single jump.
+//
+// After that nothing is materialized until it's asked for - a json_value is just a position in the index.
+// Numbers are parsed with parse_int/parse_float when they are read. Strings are views into the input when they
+// have no escapes, otherwise they get unescaped into the document's allocator (Context.TempAlloc by default,
+// an arena - so there is nothing to free one by one).
+//
+//     json_document doc;
+//     if (json_parse(doc, input) != PARSE_SUCCESS) { ... doc.ErrorOffset ... }
+//     defer(free(doc));
+//
+//     For(json_array(json_find(json_root(doc), "points"))) {
+//         f64 x = json_get_f64(json_find(it, "x")).Value;
+//     }
+//
+// The input must outlive the document. Offsets are 32 bit, so documents are limited to 4 GiB.
+//
+// json_parse() checks the brackets, strings and encoding. The rest of the grammar (commas, colons, the
+// contents of scalars) is checked when it's read: a malformed field stops the iteration and sets _ErrorOffset_,
+// a malformed scalar returns PARSE_INVALID.
+//
+
+enum json_type : u32 {
+    JSON_NONE = 0,  // A missing value (e.g. json_find() didn't find the key) or something which isn't valid JSON
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+struct json_document {
+    bytes Input;
+
+    array<u32> Index;  // Offsets of the structural bytes, ends with Input.Count so we can always look one ahead
+    array<u32> Match;  // For '[' and '{' the position in _Index_ of the closing bracket, unused for the rest
+
+    allocator Alloc;  // For unescaped strings
+
+    s64 ErrorOffset = -1;  // Where the first error was found, -1 if none
+};
+
+struct json_value {
+    json_document *Doc = null;
+    s64 Index          = -1;  // Position in Doc->Index, -1 for JSON_NONE
+};
+
+template <typename T>
+struct json_result {
+    T Value;
+    parse_status Status;
+};
+
+struct json_field {
+    string Key;
+    json_value Value;
+};
+
+// Defined in json.cpp. Builds the structural index.
+//
+// Returns:
+//   * PARSE_SUCCESS    if the input is one value with balanced brackets and terminated strings,
+//   * PARSE_EXHAUSTED  if the input ended in the middle of a string/array/object (or was empty),
+//   * PARSE_INVALID    for invalid UTF-8, control characters in strings, mismatched brackets or more than one root value.
+//
+// On failure _doc.ErrorOffset_ points into the input where the problem is.
+parse_status json_parse(json_document &doc, bytes input, allocator alloc = {});
+
+inline void free(json_document &doc) {
+    free(doc.Index);
+    free(doc.Match);
+}
+
+inline json_value json_root(json_document &doc) {
+    if (doc.Index.Count < 2) return {};
+    return {&doc, 0};
+}
+
+namespace internal {
+// The byte at a position in the index (0 at the end of the input)
+inline byte json_byte(const json_document *doc, s64 index) {
+    u32 offset = doc->Index[index];
+    return offset < doc->Input.Count ? doc->Input[offset] : 0;
+}
+
+inline bytes json_bytes(const json_document *doc, s64 index) {
+    u32 offset = doc->Index[index];
+    return bytes(doc->Input.Data + offset, doc->Input.Count - offset);
+}
+
+// The position in the index right after the value at _index_
+inline s64 json_skip(const json_document *doc, s64 index) {
+    byte b = json_byte(doc, index);
+    if (b == '[' || b == '{') return doc->Match[index] + 1;
+    return index + 1;
+}
+
+// A literal or a number has to be followed by white space, a structural byte or the end of the input
+inline bool json_is_scalar_end(bytes rest) {
+    if (!rest) return true;
+
+    byte b = rest[0];
+    return b == ' ' || b == '\t' || b == '\n' || b == '\r' || b == ',' || b == ':' || b == ']' || b == '}' || b == '[' || b == '{';
+}
+
+// Returns the length of the number at the start of _p_ if it follows the JSON grammar
+// (-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?), -1 otherwise. Sets _outIsInteger_ if there is no fraction or exponent.
+inline s64 json_scan_number(bytes p, bool *outIsInteger) {
+    auto is_digit = [&](s64 i) { return i < p.Count && p[i] >= '0' && p[i] <= '9'; };
+
+    s64 i = 0;
+    if (i < p.Count && p[i] == '-') ++i;
+
+    if (i < p.Count && p[i] == '0') {
+        ++i;
+    } else if (is_digit(i)) {
+        while (is_digit(i)) ++i;
+    } else {
+        return -1;
+    }
+
+    *outIsInteger = true;
+    if (i < p.Count && p[i] == '.') {
+        ++i;
+        if (!is_digit(i)) return -1;
+        while (is_digit(i)) ++i;
+        *outIsInteger = false;
+    }
+
+    if (i < p.Count && (p[i] == 'e' || p[i] == 'E')) {
+        ++i;
+        if (i < p.Count && (p[i] == '+' || p[i] == '-')) ++i;
+        if (!is_digit(i)) return -1;
+        while (is_digit(i)) ++i;
+        *outIsInteger = false;
+    }
+
+    if (!json_is_scalar_end(bytes(p.Data + i, p.Count - i))) return -1;
+    return i;
+}
+
+inline bool json_expect_literal(bytes p, const char *literal) {
+    s64 length = c_string_length(literal);
+    if (p.Count < length || !equal_memory(p.Data, literal, length)) return false;
+    return json_is_scalar_end(bytes(p.Data + length, p.Count - length));
+}
+
+inline void json_set_error(json_document *doc, s64 index) {
+    if (doc->ErrorOffset == -1) doc->ErrorOffset = doc->Index[index];
+}
+
+// Reads 4 hex digits of a \u escape
+inline s32 json_parse_hex4(const byte *p) {
+    s32 result = 0;
+    For(range(4)) {
+        s32 d = byte_to_digit_default(p[it]);
+        if (d < 0 || d > 15) return -1;
+        result = result << 4 | d;
+    }
+    return result;
+}
+}  // namespace internal
+
+inline json_type json_get_type(json_value v) {
+    if (!v.Doc || v.Index < 0) return JSON_NONE;
+
+    switch (internal::json_byte(v.Doc, v.Index)) {
+        case '{': return JSON_OBJECT;
+        case '[': return JSON_ARRAY;
+        case '"': return JSON_STRING;
+        case 't':
+        case 'f': return JSON_BOOL;
+        case 'n': return JSON_NULL;
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9': return JSON_NUMBER;
+        default: return JSON_NONE;
+    }
+}
+
+inline bool json_is_null(json_value v) {
+    if (json_get_type(v) != JSON_NULL) return false;
+    return internal::json_expect_literal(internal::json_bytes(v.Doc, v.Index), "null");
+}
+
+inline json_result<bool> json_get_bool(json_value v) {
+    if (json_get_type(v) != JSON_BOOL) return {false, PARSE_INVALID};
+
+    bytes p = internal::json_bytes(v.Doc, v.Index);
+    if (internal::json_expect_literal(p, "true")) return {true, PARSE_SUCCESS};
+    if (internal::json_expect_literal(p, "false")) return {false, PARSE_SUCCESS};
+    return {false, PARSE_INVALID};
+}
+
+inline json_result<f64> json_get_f64(json_value v) {
+    if (json_get_type(v) != JSON_NUMBER) return {0, PARSE_INVALID};
+
+    bytes p = internal::json_bytes(v.Doc, v.Index);
+
+    bool isInteger;
+    s64 length = internal::json_scan_number(p, &isInteger);
+    if (length == -1) return {0, PARSE_INVALID};
+
+    auto [value, status, rest] = parse_float<f64, parse_float_options{.AllowPlusSign = false, .ParseSpecialValues = false}>(bytes(p.Data, length));
+    return {value, status};
+}
+
+// Numbers with a fraction or an exponent are PARSE_INVALID, ones that don't fit are PARSE_TOO_MANY_DIGITS (see parse_int).
+inline json_result<s64> json_get_s64(json_value v) {
+    if (json_get_type(v) != JSON_NUMBER) return {0, PARSE_INVALID};
+
+    bytes p = internal::json_bytes(v.Doc, v.Index);
+
+    bool isInteger;
+    s64 length = internal::json_scan_number(p, &isInteger);
+    if (length == -1 || !isInteger) return {0, PARSE_INVALID};
+
+    auto [value, status, rest] = parse_int<s64, parse_int_options{.AllowPlusSign = false}>(bytes(p.Data, length), 10);
+    return {value, status};
+}
+
+// A view into the input when the string has no escapes, otherwise unescaped into _Doc->Alloc_.
+inline json_result<string> json_get_string(json_value v) {
+    if (json_get_type(v) != JSON_STRING) return {{}, PARSE_INVALID};
+
+    // json_parse() made sure the string is terminated
+    bytes p = internal::json_bytes(v.Doc, v.Index);
+    advance_bytes(&p, 1);
+
+    auto [plain, found, rest] = eat_bytes_until_any_of(p, (bytes)(string) "\"\\");
+    if (rest[0] == '"') return {string(plain.Data, plain.Count), PARSE_SUCCESS};
+
+    // Find the end to know how much to allocate, the unescaped string is never longer
+    s64 end = plain.Count;
+    while (true) {
+        auto [part, partFound, partRest] = eat_bytes_until_any_of(bytes(p.Data + end, p.Count - end), (bytes)(string) "\"\\");
+        end += part.Count;
+        if (partRest[0] == '"') break;
+        end += 2;  // The backslash and the byte after it
+    }
+
+    utf8 *result = allocate_array<utf8>(end, {.Alloc = v.Doc->Alloc});
+    copy_memory(result, plain.Data, plain.Count);
+
+    s64 count = plain.Count;
+    s64 i     = plain.Count;
+    while (i < end) {
+        byte b = p[i];
+        if (b != '\\') {
+            result[count++] = b;
+            ++i;
+            continue;
+        }
+
+        byte e = p[i + 1];
+        i += 2;
+        switch (e) {
+            case '"': result[count++] = '"'; break;
+            case '\\': result[count++] = '\\'; break;
+            case '/': result[count++] = '/'; break;
+            case 'b': result[count++] = '\b'; break;
+            case 'f': result[count++] = '\f'; break;
+            case 'n': result[count++] = '\n'; break;
+            case 'r': result[count++] = '\r'; break;
+            case 't': result[count++] = '\t'; break;
+            case 'u': {
+                s32 cp = i + 4 <= end ? internal::json_parse_hex4(p.Data + i) : -1;
+                if (cp == -1) return {{}, PARSE_INVALID};
+                i += 4;
+
+                // Code points outside the BMP are written as an UTF-16 surrogate pair
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    s32 low = i + 6 <= end && p[i] == '\\' && p[i + 1] == 'u' ? internal::json_parse_hex4(p.Data + i + 2) : -1;
+                    if (low < 0xDC00 || low > 0xDFFF) return {{}, PARSE_INVALID};
+                    i += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return {{}, PARSE_INVALID};
+                }
+
+                // At most 4 bytes from 6 (or 12) escaped ones, so it fits
+                encode_cp(result + count, cp);
+                count += get_size_of_cp(result + count);
+                break;
+            }
+            default: return {{}, PARSE_INVALID};
+        }
+    }
+    return {string(result, count), PARSE_SUCCESS};
+}
+
+//
+// Iterating arrays and objects:
+//
+//     For(json_array(v)) { ... it is a json_value ... }
+//     For(json_object(v)) { ... it.Key, it.Value ... }
+//
+// Iterating something which isn't an array/object (or is JSON_NONE) gives nothing.
+//
+struct json_array_iterator {
+    json_document *Doc;
+    s64 Index;  // The current element, -1 at the end
+
+    json_value operator*() const { return {Doc, Index}; }
+
+    json_array_iterator &operator++() {
+        s64 next = internal::json_skip(Doc, Index);
+
+        byte b = internal::json_byte(Doc, next);
+        if (b == ',' && json_get_type({Doc, next + 1}) != JSON_NONE) {
+            Index = next + 1;
+        } else {
+            if (b != ']') internal::json_set_error(Doc, next);
+            Index = -1;
+        }
+        return *this;
+    }
+
+    bool operator==(const json_array_iterator &other) const { return Index == other.Index; }
+};
+
+struct json_array_range {
+    json_value Array;
+
+    json_array_iterator begin() const {
+        if (json_get_type(Array) != JSON_ARRAY) return {null, -1};
+
+        s64 first = Array.Index + 1;
+        if (internal::json_byte(Array.Doc, first) == ']') return {Array.Doc, -1};
+        return {Array.Doc, first};
+    }
+
+    json_array_iterator end() const { return {Array.Doc, -1}; }
+};
+
+struct json_object_iterator {
+    json_document *Doc;
+    s64 Index;  // The key of the current field, -1 at the end
+
+    json_field operator*() const { return {json_get_string({Doc, Index}).Value, {Doc, Index + 2}}; }
+
+    json_object_iterator &operator++() {
+        s64 next = internal::json_skip(Doc, Index + 2);
+
+        byte b = internal::json_byte(Doc, next);
+        if (b == ',') {
+            Index = check(Doc, next + 1);
+        } else {
+            if (b != '}') internal::json_set_error(Doc, next);
+            Index = -1;
+        }
+        return *this;
+    }
+
+    bool operator==(const json_object_iterator &other) const { return Index == other.Index; }
+
+    // A field is a string, a colon and a value. Returns -1 (and sets the error) if the one at _index_ isn't.
+    static s64 check(json_document *doc, s64 index) {
+        if (internal::json_byte(doc, index) != '"') {
+            internal::json_set_error(doc, index);
+            return -1;
+        }
+        if (internal::json_byte(doc, index + 1) != ':' || json_get_type({doc, index + 2}) == JSON_NONE) {
+            internal::json_set_error(doc, index + 1);
+            return -1;
+        }
+        return index;
+    }
+};
+
+struct json_object_range {
+    json_value Object;
+
+    json_object_iterator begin() const {
+        if (json_get_type(Object) != JSON_OBJECT) return {null, -1};
+
+        s64 first = Object.Index + 1;
+        if (internal::json_byte(Object.Doc, first) == '}') return {Object.Doc, -1};
+        return {Object.Doc, json_object_iterator::check(Object.Doc, first)};
+    }
+
+    json_object_iterator end() const { return {Object.Doc, -1}; }
+};
+
+inline json_array_range json_array(json_value v) { return {v}; }
+inline json_object_range json_object(json_value v) { return {v}; }
+
+// The value of the first field with _key_, JSON_NONE if _object_ has no such field (or isn't an object)
+inline json_value json_find(json_value object, const string &key) {
+    For(json_object(object)) {
+        if (it.Key == key) return it.Value;
+    }
+    return {};
+}
+
+// The element at _index_, JSON_NONE if out of range (or _array_ isn't an array).
+// Elements which are arrays/objects are skipped in O(1), so this is linear in the number of elements before _index_.
+inline json_value json_at(json_value array, s64 index) {
+    For(json_array(array)) {
+        if (!index--) return it;
+    }
+    return {};
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,618 @@
+#include "linalg.h"
+
+#include "job_system.h"
+#include "profiler.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2, AVX2 and FMA intrinsics
+
+#if COMPILER == MSVC
+#define TARGET_AVX2_FMA
+#else
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// Columns of a trailing matrix one tile (and one job) updates. A panel of rows times 64 columns is 32 KB.
+file_scope constexpr s64 DENSE_TILE = 64;
+
+// How deep one call of the kernel goes, so the strip of the right hand side it keeps reading stays in the cache
+file_scope constexpr s64 DENSE_DEPTH = 256;
+
+// Updates with fewer multiply-adds run on the calling thread, spawning jobs costs more than that
+file_scope constexpr s64 DENSE_PARALLEL_WORK = 1 << 20;
+
+// Relative to the largest diagonal element of R, smaller ones mean the columns are linearly dependent
+file_scope constexpr f64 DENSE_RANK_TOLERANCE = 1e-12;
+
+void dense_mat_init(dense_mat &m, s64 rows, s64 cols, allocator alloc) {
+    free(m);
+
+    m.R = rows;
+    m.C = cols;
+    m.Stride = (cols + 3) & ~3ll;
+    if (!rows || !cols) return;
+
+    m.Data = allocate_array<f64>(rows * m.Stride, {.Alloc = alloc, .Alignment = 64});
+    zero_memory(m.Data, rows * m.Stride * sizeof(f64));
+}
+
+void free(dense_mat &m) {
+    if (m.Data) free(m.Data);
+    m.Data = null;
+    m.R = m.C = m.Stride = 0;
+}
+
+dense_mat *clone(dense_mat *dest, const dense_mat &src) {
+    dense_mat_init(*dest, src.R, src.C);
+    if (src.Data) copy_elements(dest->Data, src.Data, src.R * src.Stride);
+    return dest;
+}
+
+//
+// The kernel: C += Alpha * A * B, for a M x N block of C.
+// A(i, p) is A[i * ARow + p * ACol], so the same kernel multiplies by a transposed matrix (or a column of one).
+//
+struct dense_gemm_args {
+    f64 *C;
+    s64 LDC;
+    const f64 *A;
+    s64 ARow, ACol;
+    const f64 *B;
+    s64 LDB;
+    s64 M, N, K;
+    f64 Alpha;
+};
+
+using dense_gemm_func = void (*)(const dense_gemm_args &g);
+
+#if ARCH == X86
+struct dense_lane {
+    using T = __m128d;
+    static constexpr s64 WIDTH = 2;
+
+    static always_inline T load(const f64 *p) { return _mm_loadu_pd(p); }
+    static always_inline void store(f64 *p, T v) { _mm_storeu_pd(p, v); }
+    static always_inline T spread(f64 v) { return _mm_set1_pd(v); }
+    static always_inline T mul_add(T a, T b, T c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+};
+#elif ARCH == ARM && ANY_ARM_NEON
+struct dense_lane {
+    using T = float64x2_t;
+    static constexpr s64 WIDTH = 2;
+
+    static always_inline T load(const f64 *p) { return vld1q_f64(p); }
+    static always_inline void store(f64 *p, T v) { vst1q_f64(p, v); }
+    static always_inline T spread(f64 v) { return vdupq_n_f64(v); }
+    static always_inline T mul_add(T a, T b, T c) { return vfmaq_f64(c, a, b); }
+};
+#else
+struct dense_lane {
+    using T = f64;
+    static constexpr s64 WIDTH = 1;
+
+    static always_inline T load(const f64 *p) { return *p; }
+    static always_inline void store(f64 *p, T v) { *p = v; }
+    static always_inline T spread(f64 v) { return v; }
+    static always_inline T mul_add(T a, T b, T c) { return a * b + c; }
+};
+#endif
+
+// _Rows_ rows and _Vecs_ registers of columns of C are kept in registers for the whole depth
+template <s64 Rows, s64 Vecs>
+always_inline void dense_gemm_tile(const dense_gemm_args &g, s64 i, s64 j) {
+    using L = dense_lane;
+
+    typename L::T acc[Rows][Vecs];
+    For_as(r, range(Rows)) For_as(v, range(Vecs)) acc[r][v] = L::load(g.C + (i + r) * g.LDC + j + v * L::WIDTH);
+
+    const f64 *a = g.A + i * g.ARow;
+    const f64 *b = g.B + j;
+    For_as(p, range(g.K)) {
+        typename L::T bv[Vecs];
+        For_as(v, range(Vecs)) bv[v] = L::load(b + v * L::WIDTH);
+
+        For_as(r, range(Rows)) {
+            auto av = L::spread(g.Alpha * a[r * g.ARow]);
+            For_as(v, range(Vecs)) acc[r][v] = L::mul_add(av, bv[v], acc[r][v]);
+        }
+        a += g.ACol;
+        b += g.LDB;
+    }
+
+    For_as(r, range(Rows)) For_as(v, range(Vecs)) L::store(g.C + (i + r) * g.LDC + j + v * L::WIDTH, acc[r][v]);
+}
+
+template <s64 Rows>
+always_inline void dense_gemm_rows(const dense_gemm_args &g, s64 i) {
+    constexpr s64 W = dense_lane::WIDTH;
+
+    s64 j = 0;
+    for (; j + 2 * W <= g.N; j += 2 * W) dense_gemm_tile<Rows, 2>(g, i, j);
+    for (; j < g.N; ++j) {
+        For_as(r, range(Rows)) {
+            f64 sum = 0;
+            For_as(p, range(g.K)) sum += g.A[(i + r) * g.ARow + p * g.ACol] * g.B[p * g.LDB + j];
+            g.C[(i + r) * g.LDC + j] += g.Alpha * sum;
+        }
+    }
+}
+
+file_scope void dense_gemm_baseline(const dense_gemm_args &g) {
+    s64 i = 0;
+    for (; i + 4 <= g.M; i += 4) dense_gemm_rows<4>(g, i);
+    for (; i < g.M; ++i) dense_gemm_rows<1>(g, i);
+}
+
+#if ARCH == X86
+// 4 rows by 8 columns in 8 registers, the edges which don't fill a tile go to the baseline kernel
+TARGET_AVX2_FMA file_scope void dense_gemm_avx2(const dense_gemm_args &g) {
+    s64 m4 = g.M & ~3ll, n8 = g.N & ~7ll;
+
+    for (s64 i = 0; i < m4; i += 4) {
+        for (s64 j = 0; j < n8; j += 8) {
+            f64 *c0 = g.C + i * g.LDC + j, *c1 = c0 + g.LDC, *c2 = c1 + g.LDC, *c3 = c2 + g.LDC;
+
+            __m256d c00 = _mm256_loadu_pd(c0), c01 = _mm256_loadu_pd(c0 + 4);
+            __m256d c10 = _mm256_loadu_pd(c1), c11 = _mm256_loadu_pd(c1 + 4);
+            __m256d c20 = _mm256_loadu_pd(c2), c21 = _mm256_loadu_pd(c2 + 4);
+            __m256d c30 = _mm256_loadu_pd(c3), c31 = _mm256_loadu_pd(c3 + 4);
+
+            const f64 *a = g.A + i * g.ARow;
+            const f64 *b = g.B + j;
+            For_as(p, range(g.K)) {
+                __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+
+                __m256d a0 = _mm256_set1_pd(g.Alpha * a[0]);
+                c00 = _mm256_fmadd_pd(a0, b0, c00);
+                c01 = _mm256_fmadd_pd(a0, b1, c01);
+
+                __m256d a1 = _mm256_set1_pd(g.Alpha * a[g.ARow]);
+                c10 = _mm256_fmadd_pd(a1, b0, c10);
+                c11 = _mm256_fmadd_pd(a1, b1, c11);
+
+                __m256d a2 = _mm256_set1_pd(g.Alpha * a[2 * g.ARow]);
+                c20 = _mm256_fmadd_pd(a2, b0, c20);
+                c21 = _mm256_fmadd_pd(a2, b1, c21);
+
+                __m256d a3 = _mm256_set1_pd(g.Alpha * a[3 * g.ARow]);
+                c30 = _mm256_fmadd_pd(a3, b0, c30);
+                c31 = _mm256_fmadd_pd(a3, b1, c31);
+
+                a += g.ACol;
+                b += g.LDB;
+            }
+
+            _mm256_storeu_pd(c0, c00);
+            _mm256_storeu_pd(c0 + 4, c01);
+            _mm256_storeu_pd(c1, c10);
+            _mm256_storeu_pd(c1 + 4, c11);
+            _mm256_storeu_pd(c2, c20);
+            _mm256_storeu_pd(c2 + 4, c21);
+            _mm256_storeu_pd(c3, c30);
+            _mm256_storeu_pd(c3 + 4, c31);
+        }
+    }
+
+    if (n8 < g.N && m4) {
+        dense_gemm_args right = g;
+        right.C += n8;
+        right.B += n8;
+        right.M = m4;
+        right.N -= n8;
+        dense_gemm_baseline(right);
+    }
+
+    if (m4 < g.M) {
+        dense_gemm_args bottom = g;
+        bottom.C += m4 * g.LDC;
+        bottom.A += m4 * g.ARow;
+        bottom.M -= m4;
+        dense_gemm_baseline(bottom);
+    }
+}
+#endif
+
+file_scope void dense_gemm(f64 *c, s64 ldc, const f64 *a, s64 aRow, s64 aCol, const f64 *b, s64 ldb, s64 m, s64 n, s64 k, f64 alpha) {
+    if (m <= 0 || n <= 0 || k <= 0) return;
+
+    local_persist cpu_dispatch<dense_gemm_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> dense_gemm_func {
+#if ARCH == X86
+        return cpu.AVX2 && cpu.FMA ? dense_gemm_avx2 : dense_gemm_baseline;
+#else
+        return dense_gemm_baseline;
+#endif
+    });
+
+    for (s64 p = 0; p < k; p += DENSE_DEPTH) {
+        func({c, ldc, a + p * aCol, aRow, aCol, b + p * ldb, ldb, m, n, min(DENSE_DEPTH, k - p), alpha});
+    }
+}
+
+// Calls _body(begin, end)_ for tiles of DENSE_TILE columns of [0, n). They go to the job system if
+// there is enough _work_ (in multiply-adds) for it to pay off.
+template <typename Body>
+file_scope void dense_for_column_tiles(s64 n, s64 work, const dense_options &options, Body &&body) {
+    s64 tiles = (n + DENSE_TILE - 1) / DENSE_TILE;
+
+    auto piece = [&](s64 begin, s64 end) {
+        For(range(begin, end)) body(it * DENSE_TILE, min(n, (it + 1) * DENSE_TILE));
+    };
+
+    if (options.Parallel && tiles > 1 && work >= DENSE_PARALLEL_WORK && job_system_worker_count() > 0) {
+        job_parallel_for(tiles, 1, &piece);
+    } else {
+        piece(0, tiles);
+    }
+}
+
+void dot(dense_mat *out, const dense_mat &lhs, const dense_mat &rhs, dense_options options) {
+    assert(lhs.C == rhs.R && out != &lhs && out != &rhs);
+
+    dense_mat_init(*out, lhs.R, rhs.C);
+    dense_for_column_tiles(rhs.C, lhs.R * lhs.C * rhs.C, options, [&](s64 begin, s64 end) {
+        dense_gemm(out->Data + begin, out->Stride, lhs.Data, lhs.Stride, 1, rhs.Data + begin, rhs.Stride, lhs.R, end - begin, lhs.C, 1);
+    });
+}
+
+void dot(f64 *out, const dense_mat &m, const f64 *v) {
+    For_as(i, range(m.R)) {
+        const f64 *r = m.row(i);
+
+        f64 sum = 0;
+        For_as(j, range(m.C)) sum += r[j] * v[j];
+        out[i] = sum;
+    }
+}
+
+//
+// LU, blocked like LAPACK's dgetrf: the panel is factored with partial pivoting (whole rows are swapped, which is
+// cheap since rows are contiguous), then the rows of the panel right of it are solved with L11 and the rest of
+// the matrix gets -= L21 * U12.
+//
+bool dense_lu_decompose(dense_lu &lu, const dense_mat &a, dense_options options) {
+    PROFILE_ZONE("dense_lu_decompose");
+
+    assert(a.R == a.C && "LU needs a square matrix");
+
+    free(lu);
+    clone(&lu.LU, a);
+
+    s64 n = a.R;
+    if (n) lu.Pivots = allocate_array<s64>(n);
+
+    dense_mat &m = lu.LU;
+    s64 nb = max<s64>(options.BlockSize, 1);
+
+    for (s64 k0 = 0; k0 < n; k0 += nb) {
+        s64 k1 = min(k0 + nb, n);
+
+        For_as(j, range(k0, k1)) {
+            s64 pivot = j;
+            f64 largest = abs(m(j, j));
+            For_as(i, range(j + 1, n)) {
+                if (abs(m(i, j)) > largest) {
+                    largest = abs(m(i, j));
+                    pivot = i;
+                }
+            }
+
+            lu.Pivots[j] = pivot;
+            if (pivot != j) {
+                f64 *r0 = m.row(j), *r1 = m.row(pivot);
+                For(range(n)) swap(r0[it], r1[it]);
+                lu.Parity = -lu.Parity;
+            }
+
+            if (largest == 0) {
+                lu.Singular = true;
+                continue;
+            }
+
+            // Eliminate below the pivot, only in the panel for now
+            const f64 *u = m.row(j);
+            f64 inv = 1 / u[j];
+            For_as(i, range(j + 1, n)) {
+                f64 *r = m.row(i);
+                f64 l = r[j] *= inv;
+                For_as(c, range(j + 1, k1)) r[c] -= l * u[c];
+            }
+        }
+
+        if (k1 == n) break;
+
+        s64 rest = n - k1, kb = k1 - k0;
+        dense_for_column_tiles(rest, n * rest * kb, options, [&](s64 begin, s64 end) {
+            s64 c0 = k1 + begin, w = end - begin;
+
+            // U12 = inverse(L11) * A12, row by row
+            For_as(i, range(k0 + 1, k1)) {
+                dense_gemm(m.row(i) + c0, m.Stride, m.row(i) + k0, 0, 1, m.row(k0) + c0, m.Stride, 1, w, i - k0, -1);
+            }
+
+            // A22 -= L21 * U12
+            dense_gemm(m.row(k1) + c0, m.Stride, m.row(k1) + k0, m.Stride, 1, m.row(k0) + c0, m.Stride, rest, w, kb, -1);
+        });
+    }
+    return !lu.Singular;
+}
+
+void dense_lu_solve(const dense_lu &lu, const f64 *b, f64 *x) {
+    const dense_mat &m = lu.LU;
+    s64 n = m.R;
+
+    if (x != b) copy_elements(x, b, n);
+    For(range(n)) if (lu.Pivots[it] != it) swap(x[it], x[lu.Pivots[it]]);
+
+    // Ly = Pb
+    For_as(i, range(1, n)) {
+        const f64 *r = m.row(i);
+
+        f64 sum = x[i];
+        For_as(j, range(i)) sum -= r[j] * x[j];
+        x[i] = sum;
+    }
+
+    // Ux = y
+    for (s64 i = n - 1; i >= 0; --i) {
+        const f64 *r = m.row(i);
+
+        f64 sum = x[i];
+        For_as(j, range(i + 1, n)) sum -= r[j] * x[j];
+        x[i] = sum / r[i];
+    }
+}
+
+void dense_lu_solve(const dense_lu &lu, dense_mat &b, dense_options options) {
+    const dense_mat &m = lu.LU;
+    s64 n = m.R;
+
+    assert(b.R == n);
+
+    For(range(n)) {
+        s64 p = lu.Pivots[it];
+        if (p == it) continue;
+
+        f64 *r0 = b.row(it), *r1 = b.row(p);
+        For_as(j, range(b.C)) swap(r0[j], r1[j]);
+    }
+
+    // Every tile of right hand sides is solved on its own
+    dense_for_column_tiles(b.C, n * n * b.C, options, [&](s64 begin, s64 end) {
+        s64 w = end - begin;
+
+        For_as(i, range(1, n)) dense_gemm(b.row(i) + begin, b.Stride, m.row(i), 0, 1, b.row(0) + begin, b.Stride, 1, w, i, -1);
+
+        for (s64 i = n - 1; i >= 0; --i) {
+            dense_gemm(b.row(i) + begin, b.Stride, m.row(i) + i + 1, 0, 1, b.row(i + 1) + begin, b.Stride, 1, w, n - i - 1, -1);
+
+            f64 inv = 1 / m(i, i);
+            For(range(begin, end)) b(i, it) *= inv;
+        }
+    });
+}
+
+f64 determinant(const dense_lu &lu) {
+    f64 result = (f64) lu.Parity;
+    For(range(lu.LU.R)) result *= lu.LU(it, it);
+    return result;
+}
+
+void free(dense_lu &lu) {
+    free(lu.LU);
+    if (lu.Pivots) free(lu.Pivots);
+    lu.Pivots = null;
+    lu.Parity = 1;
+    lu.Singular = false;
+}
+
+//
+// QR, blocked like LAPACK's dgeqrf: the reflectors of a panel are found column by column, then they are
+// applied to the rest of the matrix at once as I - V T V' (the compact WY form, see dlarft), which is two products.
+//
+void dense_qr_decompose(dense_qr &qr, const dense_mat &a, dense_options options) {
+    PROFILE_ZONE("dense_qr_decompose");
+
+    assert(a.R >= a.C && "QR needs at least as many rows as columns");
+
+    free(qr);
+    clone(&qr.QR, a);
+
+    s64 rows = a.R, cols = a.C;
+    if (!cols) return;
+
+    qr.Tau = allocate_array<f64>(cols);
+
+    dense_mat &m = qr.QR;
+    s64 nb = min(max<s64>(options.BlockSize, 1), cols);
+
+    // The reflectors of a panel with explicit ones and zeros, the triangular factor T and T' * V' * C
+    dense_mat V, T, W;
+    dense_mat_init(V, rows, nb);
+    dense_mat_init(T, nb, nb);
+    dense_mat_init(W, nb, cols);
+    defer(free(V));
+    defer(free(T));
+    defer(free(W));
+
+    f64 *dots = allocate_array<f64>(nb);
+    defer(free(dots));
+
+    for (s64 k0 = 0; k0 < cols; k0 += nb) {
+        s64 k1 = min(k0 + nb, cols);
+
+        For_as(j, range(k0, k1)) {
+            f64 alpha = m(j, j);
+
+            f64 norm2 = 0;
+            For_as(i, range(j + 1, rows)) norm2 += m(i, j) * m(i, j);
+
+            if (norm2 == 0) {
+                qr.Tau[j] = 0;  // Already zero below the diagonal, H_j = I
+                continue;
+            }
+
+            // H_j maps the column to (beta, 0, 0...), the sign of beta is picked so alpha - beta doesn't cancel
+            f64 beta = ::sqrt(alpha * alpha + norm2);
+            if (alpha >= 0) beta = -beta;
+
+            f64 tau = qr.Tau[j] = (beta - alpha) / beta;
+
+            f64 scale = 1 / (alpha - beta);
+            For_as(i, range(j + 1, rows)) m(i, j) *= scale;
+            m(j, j) = beta;
+
+            // The rest of the panel -= tau * v * (v' * panel)
+            s64 w = k1 - j - 1;
+            if (!w) continue;
+
+            const f64 *top = m.row(j) + j + 1;
+            For_as(c, range(w)) dots[c] = top[c];
+            For_as(i, range(j + 1, rows)) {
+                const f64 *r = m.row(i);
+                For_as(c, range(w)) dots[c] += r[j] * r[j + 1 + c];
+            }
+
+            For_as(c, range(w)) m(j, j + 1 + c) -= tau * dots[c];
+            For_as(i, range(j + 1, rows)) {
+                f64 *r = m.row(i);
+                f64 v = tau * r[j];
+                For_as(c, range(w)) r[j + 1 + c] -= v * dots[c];
+            }
+        }
+
+        if (k1 == cols) break;
+
+        s64 kb = k1 - k0, vr = rows - k0;
+
+        For_as(i, range(vr)) {
+            f64 *r = V.row(i);
+            For_as(c, range(kb)) r[c] = i > c ? m(k0 + i, k0 + c) : (i == c ? 1 : 0);
+        }
+
+        // T is upper triangular: T(c, c) = tau_c and T(0:c, c) = -tau_c * T(0:c, 0:c) * V(:, 0:c)' * v_c
+        For_as(c, range(kb)) {
+            f64 tau = qr.Tau[k0 + c];
+
+            For_as(r, range(c)) {
+                f64 sum = 0;
+                For_as(i, range(c, vr)) sum += V(i, r) * V(i, c);  // v_c is zero above row c
+                dots[r] = sum;
+            }
+
+            For_as(r, range(c)) {
+                f64 sum = 0;
+                For_as(q, range(r, c)) sum += T(r, q) * dots[q];
+                T(r, c) = -tau * sum;
+            }
+            T(c, c) = tau;
+            For_as(r, range(c + 1, kb)) T(r, c) = 0;
+        }
+
+        // C -= V * (T' * (V' * C)), every tile of columns on its own
+        s64 rest = cols - k1;
+        dense_for_column_tiles(rest, 2 * vr * kb * rest, options, [&](s64 begin, s64 end) {
+            s64 c0 = k1 + begin, w = end - begin;
+
+            For_as(r, range(kb)) zero_memory(W.row(r) + begin, w * sizeof(f64));
+            dense_gemm(W.Data + begin, W.Stride, V.Data, 1, V.Stride, m.row(k0) + c0, m.Stride, kb, w, vr, 1);
+
+            // T' is lower triangular, going from the bottom row up leaves the rows above for the next ones
+            for (s64 r = kb - 1; r >= 0; --r) {
+                f64 *wr = W.row(r) + begin;
+                For(range(w)) wr[it] *= T(r, r);
+                dense_gemm(wr, W.Stride, T.Data + r, 0, T.Stride, W.Data + begin, W.Stride, 1, w, r, 1);
+            }
+
+            dense_gemm(m.row(k0) + c0, m.Stride, V.Data, V.Stride, 1, W.Data + begin, W.Stride, vr, w, kb, -1);
+        });
+    }
+}
+
+bool dense_qr_solve(const dense_qr &qr, const f64 *b, f64 *x) {
+    const dense_mat &m = qr.QR;
+    s64 rows = m.R, cols = m.C;
+
+    f64 largest = 0;
+    For(range(cols)) largest = max(largest, abs(m(it, it)));
+    For(range(cols)) if (abs(m(it, it)) <= largest * DENSE_RANK_TOLERANCE) return false;
+
+    // y = Q' * b
+    f64 *y = allocate_array<f64>(rows, {.Alloc = Context.TempAlloc});
+    defer(free(y));
+    copy_elements(y, b, rows);
+
+    For_as(j, range(cols)) {
+        f64 tau = qr.Tau[j];
+        if (!tau) continue;
+
+        f64 sum = y[j];
+        For_as(i, range(j + 1, rows)) sum += m(i, j) * y[i];
+        sum *= tau;
+
+        y[j] -= sum;
+        For_as(i, range(j + 1, rows)) y[i] -= m(i, j) * sum;
+    }
+
+    // Rx = y
+    for (s64 i = cols - 1; i >= 0; --i) {
+        const f64 *r = m.row(i);
+
+        f64 sum = y[i];
+        For_as(j, range(i + 1, cols)) sum -= r[j] * x[j];
+        x[i] = sum / r[i];
+    }
+    return true;
+}
+
+void dense_qr_q(dense_mat *out, const dense_qr &qr) {
+    const dense_mat &m = qr.QR;
+    s64 rows = m.R, cols = m.C;
+
+    dense_mat_init(*out, rows, cols);
+    For(range(cols)) (*out)(it, it) = 1;
+
+    f64 *dots = allocate_array<f64>(cols + 1, {.Alloc = Context.TempAlloc});
+    defer(free(dots));
+
+    // Q = H_0 * (H_1 * (... * I)), columns left of j of the partial product are still columns of I which H_j keeps
+    for (s64 j = cols - 1; j >= 0; --j) {
+        f64 tau = qr.Tau[j];
+        if (!tau) continue;
+
+        dense_mat &q = *out;
+        For_as(c, range(j, cols)) dots[c] = q(j, c);
+        For_as(i, range(j + 1, rows)) {
+            f64 v = m(i, j);
+            For_as(c, range(j, cols)) dots[c] += v * q(i, c);
+        }
+
+        For_as(c, range(j, cols)) q(j, c) -= tau * dots[c];
+        For_as(i, range(j + 1, rows)) {
+            f64 v = tau * m(i, j);
+            For_as(c, range(j, cols)) q(i, c) -= v * dots[c];
+        }
+    }
+}
+
+void free(dense_qr &qr) {
+    free(qr.QR);
+    if (qr.Tau) free(qr.Tau);
+    qr.Tau = null;
+}
+
+bool dense_solve(const dense_mat &a, const f64 *b, f64 *x, dense_options options) {
+    dense_lu lu;
+    defer(free(lu));
+
+    if (!dense_lu_decompose(lu, a, options)) return false;
+    dense_lu_solve(lu, b, x);
+    return true;
+}
+
+LSTD_END_NAMESPACE
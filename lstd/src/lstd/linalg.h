@@ -0,0 +1,111 @@
+#pragma once
+
+#include "memory/array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Dense f64 matrices with a size known only at runtime, and blocked LU and QR decompositions for solving
+// systems which are too big for mat<T, R, C> (see math/decompose_lu.h and math/decompose_qr.h for those).
+//
+//     dense_mat a;
+//     dense_mat_init(a, 200, 200);
+//     defer(free(a));
+//     ... a(i, j) = ...
+//
+//     dense_lu lu;
+//     defer(free(lu));
+//     if (dense_lu_decompose(lu, a)) dense_lu_solve(lu, b, x);  // x = inverse(A) * b
+//
+//     dense_qr qr;                                              // For least squares (more rows than columns)
+//     defer(free(qr));
+//     dense_qr_decompose(qr, a);
+//     dense_qr_solve(qr, b, x);                                 // The x with the smallest |Ax - b|
+//
+// Both decompositions work on panels of _BlockSize_ columns: the panel is factored column by column and the rest
+// of the matrix is updated once per panel with a matrix product, which is where almost all the time goes.
+// The product runs on tiles which fit in the cache, with SIMD kernels (AVX2 + FMA, SSE2 or NEON, picked at runtime
+// with cpu_dispatch_get()), and the tiles are spread on the job system when it's running (see job_system.h).
+//
+
+struct dense_mat {
+    f64 *Data = null;  // Row after row, aligned to 64 bytes
+    s64 R = 0, C = 0;
+    s64 Stride = 0;  // Elements from the start of one row to the next, C rounded up to a multiple of 4
+
+    f64 &operator()(s64 i, s64 j) { return Data[i * Stride + j]; }
+    const f64 &operator()(s64 i, s64 j) const { return Data[i * Stride + j]; }
+
+    f64 *row(s64 i) { return Data + i * Stride; }
+    const f64 *row(s64 i) const { return Data + i * Stride; }
+};
+
+// Allocates a zeroed _rows_ x _cols_ matrix. Frees the old contents of _m_.
+void dense_mat_init(dense_mat &m, s64 rows, s64 cols, allocator alloc = {});
+
+void free(dense_mat &m);
+dense_mat *clone(dense_mat *dest, const dense_mat &src);
+
+struct dense_options {
+    s64 BlockSize = 64;    // Columns in a panel
+    bool Parallel = true;  // Spread the updates on the job system (if it's running and the matrix is big enough)
+};
+
+// out = lhs * rhs, _out_ is resized and may not be _lhs_ or _rhs_
+void dot(dense_mat *out, const dense_mat &lhs, const dense_mat &rhs, dense_options options = {});
+
+// out = m * v, _v_ has m.C elements and _out_ has m.R
+void dot(f64 *out, const dense_mat &m, const f64 *v);
+
+//
+// LU with partial pivoting: P * A = L * U, for square matrices.
+//
+struct dense_lu {
+    // L below the diagonal (its diagonal is 1 and isn't stored), U on and above it
+    dense_mat LU;
+
+    // Row i was swapped with row Pivots[i] (in order, starting from row 0)
+    s64 *Pivots = null;
+    s64 Parity = 1;  // 1 if the number of swaps is even, -1 if it's odd
+
+    bool Singular = false;  // A column had no nonzero pivot, then solving returns garbage
+};
+
+// Returns false if the matrix is singular (the decomposition is still done, see decompose_lup in math/decompose_lu.h).
+bool dense_lu_decompose(dense_lu &lu, const dense_mat &a, dense_options options = {});
+
+// Solves Ax = b, both have lu.LU.R elements and may be the same array.
+void dense_lu_solve(const dense_lu &lu, const f64 *b, f64 *x);
+
+// Solves AX = B in place (B becomes X), for many right hand sides at once
+void dense_lu_solve(const dense_lu &lu, dense_mat &b, dense_options options = {});
+
+f64 determinant(const dense_lu &lu);
+
+void free(dense_lu &lu);
+
+//
+// QR with Householder reflections: A = Q * R, for matrices with at least as many rows as columns.
+//
+struct dense_qr {
+    // R on and above the diagonal. Below it column j holds the reflector v_j (whose first element is 1 and isn't stored),
+    // Q = H_0 * H_1 * ... where H_j = I - Tau[j] * v_j * v_j'.
+    dense_mat QR;
+    f64 *Tau = null;
+};
+
+void dense_qr_decompose(dense_qr &qr, const dense_mat &a, dense_options options = {});
+
+// The least squares solution of Ax = b. _b_ has qr.QR.R elements and _x_ has qr.QR.C.
+// Returns false if A doesn't have full column rank (a diagonal element of R is 0 next to the largest one).
+bool dense_qr_solve(const dense_qr &qr, const f64 *b, f64 *x);
+
+// The first C columns of Q (a R x C matrix with orthonormal columns), so that A = Q * R
+void dense_qr_q(dense_mat *out, const dense_qr &qr);
+
+void free(dense_qr &qr);
+
+// Solves Ax = b for a square matrix with LU. Returns false if A is singular.
+bool dense_solve(const dense_mat &a, const f64 *b, f64 *x, dense_options options = {});
+
+LSTD_END_NAMESPACE
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "internal/common.h"
+#include "math/batch.h"
 #include "math/decompose_lu.h"
 #include "math/decompose_qr.h"
+#include "math/half.h"
 // #include "math/decompose_svd.h"
 #include "math/mat_func.h"
+#include "math/quat_batch.h"
 #include "math/quat_func.h"
 #include "math/rect.h"
+#include "math/simd_math.h"
+#include "math/transforms/affine.h"
 #include "math/transforms/orthographic.h"
 #include "math/transforms/perspective.h"
 #include "math/transforms/rotation_2d.h"
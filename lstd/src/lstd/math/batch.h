@@ -0,0 +1,416 @@
+#pragma once
+
+#include "mat.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Batch kernels over many 3D vectors: transform points/directions by a 4x4 matrix, normalize, dot and cross.
+//
+// Two layouts are supported:
+// * SoA (soa_v3) - three separate streams of x, y and z. This is the fast one, every instruction works on
+//   BATCH_WIDTH vectors (8 with AVX, 4 with SSE/NEON, 1 otherwise) with no shuffling.
+// * AoS (an array of vec3) - blocks of BATCH_WIDTH vectors are transposed into SoA on the stack,
+//   run through the same kernel and transposed back.
+//
+// The counts don't have to be multiples of BATCH_WIDTH, the rest is done one by one.
+// Outputs may be the same as the inputs (in-place), but they may not partially overlap.
+//
+// Our vectors are rows (v * M) and the translation is in the last row, so a point is (x, y, z, 1) * M
+// and a direction is (x, y, z, 0) * M. The last column is ignored (no divide by w), use dot() for projective matrices.
+//
+
+struct soa_v3 {
+    f32 *X = null, *Y = null, *Z = null;
+};
+
+struct soa_v3_view {
+    const f32 *X = null, *Y = null, *Z = null;
+
+    soa_v3_view() {}
+    soa_v3_view(const f32 *x, const f32 *y, const f32 *z) : X(x), Y(y), Z(z) {}
+    soa_v3_view(const soa_v3 &s) : X(s.X), Y(s.Y), Z(s.Z) {}
+};
+
+namespace impl {
+
+// A register of floats (8 with AVX, 4 with SSE/NEON, 1 otherwise) with just the operations the kernels below need
+struct batch_f32 {
+#if ARCH == X86 && X86_AVX
+    static constexpr s64 WIDTH = 8;
+    __m256 reg;
+
+    static always_inline batch_f32 load(const f32 *p) { return {_mm256_loadu_ps(p)}; }
+    static always_inline batch_f32 spread(f32 v) { return {_mm256_set1_ps(v)}; }
+    always_inline void store(f32 *p) const { _mm256_storeu_ps(p, reg); }
+
+    friend always_inline batch_f32 operator+(batch_f32 a, batch_f32 b) { return {_mm256_add_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator-(batch_f32 a, batch_f32 b) { return {_mm256_sub_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator*(batch_f32 a, batch_f32 b) { return {_mm256_mul_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator/(batch_f32 a, batch_f32 b) { return {_mm256_div_ps(a.reg, b.reg)}; }
+
+    // a * b + c
+    static always_inline batch_f32 mul_add(batch_f32 a, batch_f32 b, batch_f32 c) {
+#if X86_FMA
+        return {_mm256_fmadd_ps(a.reg, b.reg, c.reg)};
+#else
+        return {_mm256_add_ps(_mm256_mul_ps(a.reg, b.reg), c.reg)};
+#endif
+    }
+
+    static always_inline batch_f32 sqrt(batch_f32 a) { return {_mm256_sqrt_ps(a.reg)}; }
+    static always_inline batch_f32 min(batch_f32 a, batch_f32 b) { return {_mm256_min_ps(a.reg, b.reg)}; }
+    static always_inline batch_f32 max(batch_f32 a, batch_f32 b) { return {_mm256_max_ps(a.reg, b.reg)}; }
+
+    // Bit i is set if a[i] <= b[i]
+    static always_inline u32 mask_le(batch_f32 a, batch_f32 b) { return (u32) _mm256_movemask_ps(_mm256_cmp_ps(a.reg, b.reg, _CMP_LE_OQ)); }
+
+    // a with its sign flipped where s is negative
+    static always_inline batch_f32 xor_sign(batch_f32 a, batch_f32 s) { return {_mm256_xor_ps(a.reg, _mm256_and_ps(s.reg, _mm256_set1_ps(-0.0f)))}; }
+
+    // Loads 8 consecutive records of 4 floats (e.g. quaternions) and transposes them, so _a_ gets the first float of each.
+    // Records 0-3 go to the low halves and 4-7 to the high halves, then a 4x4 transpose within each half.
+    static always_inline void load4(const f32 *p, batch_f32 *a, batch_f32 *b, batch_f32 *c, batch_f32 *d) {
+        __m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 0)), _mm_loadu_ps(p + 16), 1);
+        __m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 20), 1);
+        __m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 24), 1);
+        __m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 12)), _mm_loadu_ps(p + 28), 1);
+
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+        a->reg = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        b->reg = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        c->reg = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        d->reg = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // The inverse of load4
+    static always_inline void store4(f32 *p, batch_f32 a, batch_f32 b, batch_f32 c, batch_f32 d) {
+        __m256 t0 = _mm256_unpacklo_ps(a.reg, b.reg), t1 = _mm256_unpackhi_ps(a.reg, b.reg);
+        __m256 t2 = _mm256_unpacklo_ps(c.reg, d.reg), t3 = _mm256_unpackhi_ps(c.reg, d.reg);
+        __m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        _mm_storeu_ps(p + 0, _mm256_castps256_ps128(r0));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(r1));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(r2));
+        _mm_storeu_ps(p + 12, _mm256_castps256_ps128(r3));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(r0, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(r1, 1));
+        _mm_storeu_ps(p + 24, _mm256_extractf128_ps(r2, 1));
+        _mm_storeu_ps(p + 28, _mm256_extractf128_ps(r3, 1));
+    }
+#elif ARCH == X86
+    static constexpr s64 WIDTH = 4;
+    __m128 reg;
+
+    static always_inline batch_f32 load(const f32 *p) { return {_mm_loadu_ps(p)}; }
+    static always_inline batch_f32 spread(f32 v) { return {_mm_set1_ps(v)}; }
+    always_inline void store(f32 *p) const { _mm_storeu_ps(p, reg); }
+
+    friend always_inline batch_f32 operator+(batch_f32 a, batch_f32 b) { return {_mm_add_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator-(batch_f32 a, batch_f32 b) { return {_mm_sub_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator*(batch_f32 a, batch_f32 b) { return {_mm_mul_ps(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator/(batch_f32 a, batch_f32 b) { return {_mm_div_ps(a.reg, b.reg)}; }
+
+    static always_inline batch_f32 mul_add(batch_f32 a, batch_f32 b, batch_f32 c) {
+#if X86_FMA
+        return {_mm_fmadd_ps(a.reg, b.reg, c.reg)};
+#else
+        return {_mm_add_ps(_mm_mul_ps(a.reg, b.reg), c.reg)};
+#endif
+    }
+
+    static always_inline batch_f32 sqrt(batch_f32 a) { return {_mm_sqrt_ps(a.reg)}; }
+    static always_inline batch_f32 min(batch_f32 a, batch_f32 b) { return {_mm_min_ps(a.reg, b.reg)}; }
+    static always_inline batch_f32 max(batch_f32 a, batch_f32 b) { return {_mm_max_ps(a.reg, b.reg)}; }
+    static always_inline u32 mask_le(batch_f32 a, batch_f32 b) { return (u32) _mm_movemask_ps(_mm_cmple_ps(a.reg, b.reg)); }
+    static always_inline batch_f32 xor_sign(batch_f32 a, batch_f32 s) { return {_mm_xor_ps(a.reg, _mm_and_ps(s.reg, _mm_set1_ps(-0.0f)))}; }
+
+    static always_inline void load4(const f32 *p, batch_f32 *a, batch_f32 *b, batch_f32 *c, batch_f32 *d) {
+        __m128 r0 = _mm_loadu_ps(p), r1 = _mm_loadu_ps(p + 4), r2 = _mm_loadu_ps(p + 8), r3 = _mm_loadu_ps(p + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        a->reg = r0, b->reg = r1, c->reg = r2, d->reg = r3;
+    }
+
+    static always_inline void store4(f32 *p, batch_f32 a, batch_f32 b, batch_f32 c, batch_f32 d) {
+        _MM_TRANSPOSE4_PS(a.reg, b.reg, c.reg, d.reg);
+        _mm_storeu_ps(p, a.reg), _mm_storeu_ps(p + 4, b.reg), _mm_storeu_ps(p + 8, c.reg), _mm_storeu_ps(p + 12, d.reg);
+    }
+#elif ARCH == ARM && ANY_ARM_NEON
+    static constexpr s64 WIDTH = 4;
+    float32x4_t reg;
+
+    static always_inline batch_f32 load(const f32 *p) { return {vld1q_f32(p)}; }
+    static always_inline batch_f32 spread(f32 v) { return {vdupq_n_f32(v)}; }
+    always_inline void store(f32 *p) const { vst1q_f32(p, reg); }
+
+    friend always_inline batch_f32 operator+(batch_f32 a, batch_f32 b) { return {vaddq_f32(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator-(batch_f32 a, batch_f32 b) { return {vsubq_f32(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator*(batch_f32 a, batch_f32 b) { return {vmulq_f32(a.reg, b.reg)}; }
+    friend always_inline batch_f32 operator/(batch_f32 a, batch_f32 b) { return {vdivq_f32(a.reg, b.reg)}; }
+
+    static always_inline batch_f32 mul_add(batch_f32 a, batch_f32 b, batch_f32 c) { return {vfmaq_f32(c.reg, a.reg, b.reg)}; }
+    static always_inline batch_f32 sqrt(batch_f32 a) { return {vsqrtq_f32(a.reg)}; }
+    static always_inline batch_f32 min(batch_f32 a, batch_f32 b) { return {vminq_f32(a.reg, b.reg)}; }
+    static always_inline batch_f32 max(batch_f32 a, batch_f32 b) { return {vmaxq_f32(a.reg, b.reg)}; }
+
+    static always_inline u32 mask_le(batch_f32 a, batch_f32 b) {
+        uint32x4_t bits = {1, 2, 4, 8};
+        return vaddvq_u32(vandq_u32(vcleq_f32(a.reg, b.reg), bits));
+    }
+
+    static always_inline batch_f32 xor_sign(batch_f32 a, batch_f32 s) {
+        uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(s.reg), vdupq_n_u32(0x80000000));
+        return {vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a.reg), sign))};
+    }
+
+    // vld4/vst4 deinterleave and interleave records of 4 floats
+    static always_inline void load4(const f32 *p, batch_f32 *a, batch_f32 *b, batch_f32 *c, batch_f32 *d) {
+        float32x4x4_t r = vld4q_f32(p);
+        a->reg = r.val[0], b->reg = r.val[1], c->reg = r.val[2], d->reg = r.val[3];
+    }
+
+    static always_inline void store4(f32 *p, batch_f32 a, batch_f32 b, batch_f32 c, batch_f32 d) {
+        float32x4x4_t r = {{a.reg, b.reg, c.reg, d.reg}};
+        vst4q_f32(p, r);
+    }
+#else
+    static constexpr s64 WIDTH = 1;
+    f32 reg;
+
+    static always_inline batch_f32 load(const f32 *p) { return {*p}; }
+    static always_inline batch_f32 spread(f32 v) { return {v}; }
+    always_inline void store(f32 *p) const { *p = reg; }
+
+    friend always_inline batch_f32 operator+(batch_f32 a, batch_f32 b) { return {a.reg + b.reg}; }
+    friend always_inline batch_f32 operator-(batch_f32 a, batch_f32 b) { return {a.reg - b.reg}; }
+    friend always_inline batch_f32 operator*(batch_f32 a, batch_f32 b) { return {a.reg * b.reg}; }
+    friend always_inline batch_f32 operator/(batch_f32 a, batch_f32 b) { return {a.reg / b.reg}; }
+
+    static always_inline batch_f32 mul_add(batch_f32 a, batch_f32 b, batch_f32 c) { return {a.reg * b.reg + c.reg}; }
+    static always_inline batch_f32 sqrt(batch_f32 a) { return {::sqrtf(a.reg)}; }
+    static always_inline batch_f32 min(batch_f32 a, batch_f32 b) { return {a.reg < b.reg ? a.reg : b.reg}; }
+    static always_inline batch_f32 max(batch_f32 a, batch_f32 b) { return {a.reg > b.reg ? a.reg : b.reg}; }
+    static always_inline u32 mask_le(batch_f32 a, batch_f32 b) { return a.reg <= b.reg ? 1 : 0; }
+    static always_inline batch_f32 xor_sign(batch_f32 a, batch_f32 s) { return {s.reg < 0 ? -a.reg : a.reg}; }
+
+    static always_inline void load4(const f32 *p, batch_f32 *a, batch_f32 *b, batch_f32 *c, batch_f32 *d) { a->reg = p[0], b->reg = p[1], c->reg = p[2], d->reg = p[3]; }
+    static always_inline void store4(f32 *p, batch_f32 a, batch_f32 b, batch_f32 c, batch_f32 d) { p[0] = a.reg, p[1] = b.reg, p[2] = c.reg, p[3] = d.reg; }
+#endif
+};
+
+// The kernels are written once for a "lane" type, which is either batch_f32 or plain f32 for the tails
+always_inline f32 batch_mul_add(f32 a, f32 b, f32 c) { return a * b + c; }
+always_inline batch_f32 batch_mul_add(batch_f32 a, batch_f32 b, batch_f32 c) { return batch_f32::mul_add(a, b, c); }
+
+always_inline f32 batch_sqrt(f32 a) { return ::sqrtf(a); }
+always_inline batch_f32 batch_sqrt(batch_f32 a) { return batch_f32::sqrt(a); }
+
+always_inline f32 batch_min(f32 a, f32 b) { return a < b ? a : b; }
+always_inline batch_f32 batch_min(batch_f32 a, batch_f32 b) { return batch_f32::min(a, b); }
+
+always_inline f32 batch_max(f32 a, f32 b) { return a > b ? a : b; }
+always_inline batch_f32 batch_max(batch_f32 a, batch_f32 b) { return batch_f32::max(a, b); }
+
+// One bit per lane, set if a <= b
+always_inline u32 batch_mask_le(f32 a, f32 b) { return a <= b ? 1 : 0; }
+always_inline u32 batch_mask_le(batch_f32 a, batch_f32 b) { return batch_f32::mask_le(a, b); }
+
+// _a_ with its sign flipped where _s_ is negative (so batch_xor_sign(a, a) is abs)
+always_inline f32 batch_xor_sign(f32 a, f32 s) { return s < 0 ? -a : a; }
+always_inline batch_f32 batch_xor_sign(batch_f32 a, batch_f32 s) { return batch_f32::xor_sign(a, s); }
+
+// Records of 4 floats, one record per lane: a gets the first floats, b the second...
+always_inline void batch_load4(const f32 *p, f32 *a, f32 *b, f32 *c, f32 *d) { *a = p[0], *b = p[1], *c = p[2], *d = p[3]; }
+always_inline void batch_load4(const f32 *p, batch_f32 *a, batch_f32 *b, batch_f32 *c, batch_f32 *d) { batch_f32::load4(p, a, b, c, d); }
+
+always_inline void batch_store4(f32 *p, f32 a, f32 b, f32 c, f32 d) { p[0] = a, p[1] = b, p[2] = c, p[3] = d; }
+always_inline void batch_store4(f32 *p, batch_f32 a, batch_f32 b, batch_f32 c, batch_f32 d) { batch_f32::store4(p, a, b, c, d); }
+
+always_inline f32 batch_load(const f32 *p, f32) { return *p; }
+always_inline batch_f32 batch_load(const f32 *p, batch_f32) { return batch_f32::load(p); }
+
+always_inline f32 batch_spread(f32 v, f32) { return v; }
+always_inline batch_f32 batch_spread(f32 v, batch_f32) { return batch_f32::spread(v); }
+
+always_inline void batch_store(f32 *p, f32 v) { *p = v; }
+always_inline void batch_store(f32 *p, batch_f32 v) { v.store(p); }
+
+// The 12 elements of the matrix the transforms use (the last column is ignored), spread across a lane
+template <typename Lane>
+struct batch_affine {
+    Lane M[4][3];
+
+    template <bool Packed>
+    batch_affine(const mat<f32, 4, 4, Packed> &m) {
+        For_as(i, range(4)) For_as(j, range(3)) M[i][j] = batch_spread(m(i, j), Lane{});
+    }
+};
+
+template <bool Point, typename Lane>
+always_inline void batch_transform(const batch_affine<Lane> &a, Lane x, Lane y, Lane z, Lane *outX, Lane *outY, Lane *outZ) {
+    Lane r[3];
+    For_as(j, range(3)) {
+        Lane v = Point ? batch_mul_add(x, a.M[0][j], a.M[3][j]) : x * a.M[0][j];
+        v = batch_mul_add(y, a.M[1][j], v);
+        r[j] = batch_mul_add(z, a.M[2][j], v);
+    }
+    *outX = r[0], *outY = r[1], *outZ = r[2];
+}
+
+template <typename Lane>
+always_inline void batch_normalize(Lane x, Lane y, Lane z, Lane *outX, Lane *outY, Lane *outZ) {
+    Lane len = batch_sqrt(batch_mul_add(x, x, batch_mul_add(y, y, z * z)));
+    *outX = x / len, *outY = y / len, *outZ = z / len;
+}
+
+template <typename Lane>
+always_inline Lane batch_dot(Lane ax, Lane ay, Lane az, Lane bx, Lane by, Lane bz) {
+    return batch_mul_add(ax, bx, batch_mul_add(ay, by, az * bz));
+}
+
+template <typename Lane>
+always_inline void batch_cross(Lane ax, Lane ay, Lane az, Lane bx, Lane by, Lane bz, Lane *outX, Lane *outY, Lane *outZ) {
+    Lane x = ay * bz - az * by;
+    Lane y = az * bx - ax * bz;
+    Lane z = ax * by - ay * bx;
+    *outX = x, *outY = y, *outZ = z;
+}
+
+always_inline const batch_affine<batch_f32> &batch_pick(const batch_affine<batch_f32> &wide, const batch_affine<f32> &, batch_f32) { return wide; }
+always_inline const batch_affine<f32> &batch_pick(const batch_affine<batch_f32> &, const batch_affine<f32> &narrow, f32) { return narrow; }
+
+// Calls _op_ with (index, lane) for every full batch and then with (index, f32) for the rest
+template <typename Op>
+always_inline void batch_for_each(s64 count, Op op) {
+    s64 i = 0;
+    for (; i + batch_f32::WIDTH <= count; i += batch_f32::WIDTH) op(i, batch_f32{});
+    for (; i < count; ++i) op(i, 0.0f);
+}
+
+// Calls _op_ with SoA views over consecutive blocks of the AoS _in_ (and _in2_) and
+// writes back what _op_ puts in the out block: xyz to _outVecs_, or just the X stream to _outScalars_.
+template <typename Vec, typename Op>
+void batch_aos_blocks(const Vec *in, const Vec *in2, f32 *outScalars, Vec *outVecs, s64 count, Op op) {
+    constexpr s64 BLOCK = batch_f32::WIDTH * 8;
+
+    alignas(32) f32 a[3][BLOCK], b[3][BLOCK], r[3][BLOCK];
+
+    for (s64 start = 0; start < count; start += BLOCK) {
+        s64 n = min(BLOCK, count - start);
+
+        For(range(n)) a[0][it] = in[start + it].x, a[1][it] = in[start + it].y, a[2][it] = in[start + it].z;
+        if (in2) {
+            For(range(n)) b[0][it] = in2[start + it].x, b[1][it] = in2[start + it].y, b[2][it] = in2[start + it].z;
+        }
+
+        op(soa_v3_view(a[0], a[1], a[2]), soa_v3_view(b[0], b[1], b[2]), soa_v3{r[0], r[1], r[2]}, n);
+
+        if (outVecs) {
+            For(range(n)) outVecs[start + it].x = r[0][it], outVecs[start + it].y = r[1][it], outVecs[start + it].z = r[2][it];
+        } else {
+            For(range(n)) outScalars[start + it] = r[0][it];
+        }
+    }
+}
+
+template <typename Vec>
+concept batch_vec3 = any_vec<Vec> && types::is_same<typename vec_info<Vec>::T, f32> && vec_info<Vec>::DIM == 3;
+
+}  // namespace impl
+
+// How many vectors the SoA kernels process per instruction
+constexpr s64 BATCH_WIDTH = impl::batch_f32::WIDTH;
+
+//
+// SoA
+//
+
+// out = (in, 1) * m
+template <bool Packed>
+void transform_points(soa_v3_view in, soa_v3 out, s64 count, const mat<f32, 4, 4, Packed> &m) {
+    impl::batch_affine<impl::batch_f32> wide(m);
+    impl::batch_affine<f32> narrow(m);
+
+    impl::batch_for_each(count, [&](s64 i, auto lane) {
+        decltype(lane) x, y, z;
+        const auto &a = impl::batch_pick(wide, narrow, lane);
+        impl::batch_transform<true>(a, impl::batch_load(in.X + i, lane), impl::batch_load(in.Y + i, lane), impl::batch_load(in.Z + i, lane), &x, &y, &z);
+        impl::batch_store(out.X + i, x), impl::batch_store(out.Y + i, y), impl::batch_store(out.Z + i, z);
+    });
+}
+
+// out = (in, 0) * m, the translation is ignored
+template <bool Packed>
+void transform_directions(soa_v3_view in, soa_v3 out, s64 count, const mat<f32, 4, 4, Packed> &m) {
+    impl::batch_affine<impl::batch_f32> wide(m);
+    impl::batch_affine<f32> narrow(m);
+
+    impl::batch_for_each(count, [&](s64 i, auto lane) {
+        decltype(lane) x, y, z;
+        const auto &a = impl::batch_pick(wide, narrow, lane);
+        impl::batch_transform<false>(a, impl::batch_load(in.X + i, lane), impl::batch_load(in.Y + i, lane), impl::batch_load(in.Z + i, lane), &x, &y, &z);
+        impl::batch_store(out.X + i, x), impl::batch_store(out.Y + i, y), impl::batch_store(out.Z + i, z);
+    });
+}
+
+// Zero vectors become NaNs, just like normalize()
+inline void normalize(soa_v3_view in, soa_v3 out, s64 count) {
+    impl::batch_for_each(count, [&](s64 i, auto lane) {
+        decltype(lane) x, y, z;
+        impl::batch_normalize(impl::batch_load(in.X + i, lane), impl::batch_load(in.Y + i, lane), impl::batch_load(in.Z + i, lane), &x, &y, &z);
+        impl::batch_store(out.X + i, x), impl::batch_store(out.Y + i, y), impl::batch_store(out.Z + i, z);
+    });
+}
+
+// out[i] = dot(a[i], b[i])
+inline void dot(soa_v3_view a, soa_v3_view b, f32 *out, s64 count) {
+    impl::batch_for_each(count, [&](s64 i, auto lane) {
+        impl::batch_store(out + i, impl::batch_dot(impl::batch_load(a.X + i, lane), impl::batch_load(a.Y + i, lane), impl::batch_load(a.Z + i, lane),
+                                                   impl::batch_load(b.X + i, lane), impl::batch_load(b.Y + i, lane), impl::batch_load(b.Z + i, lane)));
+    });
+}
+
+// out[i] = cross(a[i], b[i])
+inline void cross(soa_v3_view a, soa_v3_view b, soa_v3 out, s64 count) {
+    impl::batch_for_each(count, [&](s64 i, auto lane) {
+        decltype(lane) x, y, z;
+        impl::batch_cross(impl::batch_load(a.X + i, lane), impl::batch_load(a.Y + i, lane), impl::batch_load(a.Z + i, lane),
+                          impl::batch_load(b.X + i, lane), impl::batch_load(b.Y + i, lane), impl::batch_load(b.Z + i, lane), &x, &y, &z);
+        impl::batch_store(out.X + i, x), impl::batch_store(out.Y + i, y), impl::batch_store(out.Z + i, z);
+    });
+}
+
+//
+// AoS, works with packed and aligned vec3<f32>
+//
+
+template <impl::batch_vec3 Vec, bool Packed>
+void transform_points(const Vec *in, Vec *out, s64 count, const mat<f32, 4, 4, Packed> &m) {
+    impl::batch_aos_blocks(in, (const Vec *) null, (f32 *) null, out, count, [&](soa_v3_view a, soa_v3_view, soa_v3 r, s64 n) { transform_points(a, r, n, m); });
+}
+
+template <impl::batch_vec3 Vec, bool Packed>
+void transform_directions(const Vec *in, Vec *out, s64 count, const mat<f32, 4, 4, Packed> &m) {
+    impl::batch_aos_blocks(in, (const Vec *) null, (f32 *) null, out, count, [&](soa_v3_view a, soa_v3_view, soa_v3 r, s64 n) { transform_directions(a, r, n, m); });
+}
+
+template <impl::batch_vec3 Vec>
+void normalize(const Vec *in, Vec *out, s64 count) {
+    impl::batch_aos_blocks(in, (const Vec *) null, (f32 *) null, out, count, [](soa_v3_view a, soa_v3_view, soa_v3 r, s64 n) { normalize(a, r, n); });
+}
+
+template <impl::batch_vec3 Vec>
+void dot(const Vec *a, const Vec *b, f32 *out, s64 count) {
+    impl::batch_aos_blocks(a, b, out, (Vec *) null, count, [](soa_v3_view x, soa_v3_view y, soa_v3 r, s64 n) { dot(x, y, r.X, n); });
+}
+
+template <impl::batch_vec3 Vec>
+void cross(const Vec *a, const Vec *b, Vec *out, s64 count) {
+    impl::batch_aos_blocks(a, b, (f32 *) null, out, count, [](soa_v3_view x, soa_v3_view y, soa_v3 r, s64 n) { cross(x, y, r, n); });
+}
+
+LSTD_END_NAMESPACE
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "vec.h"
+#include "batch.h"
+#include "vec_func.h"
 
 LSTD_BEGIN_NAMESPACE
 
@@ -23,9 +24,6 @@ struct line {
         assert(is_normalized(direction));
     }
 
-    // Constructs a line through both points.
-    line(const VectorT &p1, const VectorT &p2) : line(p1, safe_normalize(p2 - p1)) {}
-
     // A 2D plane and line are equivalent, converts representation. Only for 2D.
     line(const hyperplane<T, 2> &plane);
 
@@ -48,7 +46,7 @@ struct line_segment {
     T length() const { return len(P2 - P1); }
     VectorT interpolate(T t) const { return t * P2 + (T(1) - t) * P1; }
 
-    explicit operator line<T, Dim>() const { return line<T, Dim>(P1, P2); }
+    explicit operator line<T, Dim>() const { return line<T, Dim>(P1, safe_normalize(P2 - P1)); }
 };
 
 template <typename T, s64 Dim>
@@ -58,6 +56,8 @@ struct ray : protected line<T, Dim> {
 
     using line<T, Dim>::line;
     using line<T, Dim>::point_at;
+    using line<T, Dim>::Base;
+    using line<T, Dim>::Direction;
 
     explicit operator line<T, Dim>() const { return (line<T, Dim>) *this; }
 };
@@ -68,24 +68,21 @@ struct hyperplane {
     VectorT Normal;
     T Scalar;
 
-    hyperplane() : Normal(0), Scalar(0) { normal(0) = 1; }
-    hyperplane(const VectorT &base, const VectorT &normal) : normal(normal) {
-        assert(IsNormalized(normal));
-        scalar = Dot(normal, base);
+    hyperplane() : Normal(0), Scalar(0) { Normal[0] = 1; }
+    hyperplane(const VectorT &base, const VectorT &normal) : Normal(normal) {
+        assert(is_normalized(normal));
+        Scalar = dot(normal, base);
     }
-    hyperplane(const VectorT &normal, T scalar) : normal(normal), scalar(scalar) { assert(IsNormalized(normal)); }
+    hyperplane(const VectorT &normal, T scalar) : Normal(normal), Scalar(scalar) { assert(is_normalized(normal)); }
     hyperplane(const line<T, 2> &line) {
         static_assert(Dim == 2, "Plane dimension must be two, which is a line.");
-        normal = {-line.Direction()(1), line.Direction()(0)};
-        scalar = Dot(normal, line.Base());
+        Normal = {-line.Direction[1], line.Direction[0]};
+        Scalar = dot(Normal, line.Base);
     }
 
-    const VectorT &Normal() const { return normal; }
-    T Scalar() const { return scalar; }
-
     template <bool Packed>
-    T Distance(const vec<T, Dim, Packed> &point) {
-        return Dot(point, normal) - scalar;
+    T distance(const vec<T, Dim, Packed> &point) const {
+        return dot(point, Normal) - Scalar;
     }
 };
 
@@ -94,12 +91,12 @@ line<T, Dim>::line(const hyperplane<T, 2> &plane) {
     static_assert(Dim == 2, "line dimension must be two, since it a plane in 2 dimensional space.");
 
     // Intersect plane's line with line through origo perpendicular to plane to find suitable base
-    T a = plane.Normal()(0);
-    T b = plane.Normal()(1);
-    T d = plane.Scalar();
+    T a = plane.Normal[0];
+    T b = plane.Normal[1];
+    T d = plane.Scalar;
     T div = (a * a + b * b);
-    base = {a * d / div, b * d / div};
-    direction = {b, -a};
+    Base = {a * d / div, b * d / div};
+    Direction = {b, -a};
 }
 
 template <typename T>
@@ -110,6 +107,100 @@ struct Triangle3D {
     vec<T, 3, false> a, b, c;  // Corners of the traingle.
 };
 
+// Axis aligned bounding box
+template <typename T, s64 Dim>
+struct aabb {
+    using VectorT = vec<T, Dim>;
+    VectorT Min, Max;
+
+    // :MathTypesNoInit
+    aabb() {}
+    aabb(const VectorT &min, const VectorT &max) : Min(min), Max(max) {}
+
+    VectorT center() const { return (Min + Max) / T(2); }
+    VectorT half_extents() const { return (Max - Min) / T(2); }
+
+    template <bool Packed>
+    bool contains(const vec<T, Dim, Packed> &point) const {
+        For(range(Dim)) if (point[it] < Min[it] || point[it] > Max[it]) return false;
+        return true;
+    }
+
+    bool overlaps(const aabb &other) const {
+        For(range(Dim)) if (other.Max[it] < Min[it] || other.Min[it] > Max[it]) return false;
+        return true;
+    }
+
+    // Grows the box (if needed) to contain _point_
+    template <bool Packed>
+    void add(const vec<T, Dim, Packed> &point) {
+        Min = min(Min, VectorT(point));
+        Max = max(Max, VectorT(point));
+    }
+};
+
+template <typename T, s64 Dim>
+struct sphere {
+    using VectorT = vec<T, Dim>;
+    VectorT Center;
+    T Radius;
+
+    // :MathTypesNoInit
+    sphere() {}
+    sphere(const VectorT &center, T radius) : Center(center), Radius(radius) {}
+};
+
+// Six planes, a point p is inside if dot(Planes[i].xyz, p) + Planes[i].w >= 0 for all of them.
+// The normals point inwards and are normalized, so that's also the distance to the plane.
+template <typename T>
+struct frustum {
+    enum : s64 { Left = 0, Right, Bottom, Top, Near, Far };
+
+    vec<T, 4> Planes[6];
+
+    // :MathTypesNoInit
+    frustum() {}
+
+    // Extracts the planes of a view-projection matrix (Gribb-Hartmann).
+    // Our vectors are rows, so the clip coordinates are the columns: -w <= x, y <= w and 0 <= z <= w (see perspective.h).
+    template <bool Packed>
+    frustum(const mat<T, 4, 4, Packed> &viewProjection) {
+        auto column = [&](s64 j) { return vec<T, 4>(viewProjection(0, j), viewProjection(1, j), viewProjection(2, j), viewProjection(3, j)); };
+
+        vec<T, 4> x = column(0), y = column(1), z = column(2), w = column(3);
+        Planes[Left] = w + x;
+        Planes[Right] = w - x;
+        Planes[Bottom] = w + y;
+        Planes[Top] = w - y;
+        Planes[Near] = z;
+        Planes[Far] = w - z;
+
+        For(Planes) it /= len(vec<T, 3>(it.xyz));
+    }
+
+    template <bool Packed>
+    bool contains(const vec<T, 3, Packed> &point) const {
+        For(Planes) if (dot(vec<T, 3>(it.xyz), vec<T, 3>(point)) + it.w < T(0)) return false;
+        return true;
+    }
+
+    // Conservative: a few spheres/boxes near the corners which are outside pass too
+    bool overlaps(const sphere<T, 3> &s) const {
+        For(Planes) if (dot(vec<T, 3>(it.xyz), s.Center) + it.w < -s.Radius) return false;
+        return true;
+    }
+
+    bool overlaps(const aabb<T, 3> &box) const {
+        vec<T, 3> c = box.center(), e = box.half_extents();
+        For(Planes) if (dot(vec<T, 3>(it.xyz), c) + dot(abs(vec<T, 3>(it.xyz)), e) + it.w < T(0)) return false;
+        return true;
+    }
+};
+
+using aabb3 = aabb<f32, 3>;
+using sphere3 = sphere<f32, 3>;
+using frustumf = frustum<f32>;
+
 //------------------------------------------------------------------------------
 // Intersections
 //------------------------------------------------------------------------------
@@ -388,6 +479,150 @@ U Intersection<ray<T, 3>, Triangle3D<T>>::Interpolate(const U &a, const U &b, co
     return u * b + v * c + w * a;
 }
 
+//------------------------------------------------------------------------------
+// Batch intersections
+//------------------------------------------------------------------------------
+
+//
+// One ray/frustum against many boxes or spheres, for culling and picking. See math/batch.h for how the lanes work.
+//
+// The results are bitmasks: bit (i % 64) of hits[i / 64] is set if the i-th object is hit,
+// so _hits_ must have room for (count + 63) / 64 words. The functions return the number of hits.
+//
+// Like the single versions above, the frustum tests are conservative.
+//
+
+// SoA boxes and spheres, each pointer is a stream of _count_ floats
+struct soa_aabb3 {
+    const f32 *MinX = null, *MinY = null, *MinZ = null;
+    const f32 *MaxX = null, *MaxY = null, *MaxZ = null;
+};
+
+struct soa_sphere3 {
+    const f32 *X = null, *Y = null, *Z = null, *Radius = null;
+};
+
+namespace impl {
+
+// Calls _op_ with (index, lane) for every batch and ORs the returned lane bits into _hits_.
+// The batches start at multiples of the width, which divides 64, so their bits never straddle two words.
+template <typename Op>
+s64 batch_hits(s64 count, u64 *hits, Op op) {
+    For(range((count + 63) / 64)) hits[it] = 0;
+    batch_for_each(count, [&](s64 i, auto lane) { hits[i / 64] |= (u64) op(i, lane) << (i % 64); });
+
+    s64 result = 0;
+    For(range((count + 63) / 64)) result += pop_count(hits[it]);
+    return result;
+}
+
+// Transposes blocks of 64 AoS objects into SoA on the stack and calls _op_(soa, count, hits) for each,
+// the blocks line up with the words of _hits_.
+template <typename Op>
+s64 batch_aos_aabb_blocks(const aabb3 *boxes, s64 count, u64 *hits, Op op) {
+    alignas(32) f32 b[6][64];
+
+    s64 result = 0;
+    for (s64 start = 0; start < count; start += 64) {
+        s64 n = min((s64) 64, count - start);
+        For(range(n)) {
+            auto &box = boxes[start + it];
+            b[0][it] = box.Min.x, b[1][it] = box.Min.y, b[2][it] = box.Min.z;
+            b[3][it] = box.Max.x, b[4][it] = box.Max.y, b[5][it] = box.Max.z;
+        }
+        result += op(soa_aabb3{b[0], b[1], b[2], b[3], b[4], b[5]}, n, hits + start / 64);
+    }
+    return result;
+}
+
+}  // namespace impl
+
+// Slab test. Hits behind the origin of the ray or further than _maxDistance_ don't count.
+// Rays parallel to an axis and exactly on a face of a box may miss it (0 * inf is NaN).
+inline s64 intersect_batch(const ray<f32, 3> &r, soa_aabb3 boxes, s64 count, u64 *hits, f32 maxDistance = numeric_info<f32>::infinity()) {
+    f32 ox = r.Base.x, oy = r.Base.y, oz = r.Base.z;
+    f32 ix = 1.0f / r.Direction.x, iy = 1.0f / r.Direction.y, iz = 1.0f / r.Direction.z;
+
+    return impl::batch_hits(count, hits, [&](s64 i, auto lane) {
+        using namespace impl;
+
+        auto slab = [&](const f32 *min, const f32 *max, f32 o, f32 inv, auto *tNear, auto *tFar) {
+            auto t1 = (batch_load(min + i, lane) - batch_spread(o, lane)) * batch_spread(inv, lane);
+            auto t2 = (batch_load(max + i, lane) - batch_spread(o, lane)) * batch_spread(inv, lane);
+            *tNear = batch_max(*tNear, batch_min(t1, t2));
+            *tFar = batch_min(*tFar, batch_max(t1, t2));
+        };
+
+        auto tNear = batch_spread(0.0f, lane), tFar = batch_spread(maxDistance, lane);
+        slab(boxes.MinX, boxes.MaxX, ox, ix, &tNear, &tFar);
+        slab(boxes.MinY, boxes.MaxY, oy, iy, &tNear, &tFar);
+        slab(boxes.MinZ, boxes.MaxZ, oz, iz, &tNear, &tFar);
+        return batch_mask_le(tNear, tFar);
+    });
+}
+
+inline s64 intersect_batch(const frustumf &f, soa_aabb3 boxes, s64 count, u64 *hits) {
+    return impl::batch_hits(count, hits, [&](s64 i, auto lane) {
+        using namespace impl;
+
+        auto half = batch_spread(0.5f, lane);
+        auto minX = batch_load(boxes.MinX + i, lane), maxX = batch_load(boxes.MaxX + i, lane);
+        auto minY = batch_load(boxes.MinY + i, lane), maxY = batch_load(boxes.MaxY + i, lane);
+        auto minZ = batch_load(boxes.MinZ + i, lane), maxZ = batch_load(boxes.MaxZ + i, lane);
+
+        auto cx = (minX + maxX) * half, cy = (minY + maxY) * half, cz = (minZ + maxZ) * half;
+        auto ex = (maxX - minX) * half, ey = (maxY - minY) * half, ez = (maxZ - minZ) * half;
+
+        // The smallest signed distance of the box's most inward corner over all planes
+        auto closest = batch_spread(numeric_info<f32>::infinity(), lane);
+        For(f.Planes) {
+            auto d = batch_mul_add(cx, batch_spread(it.x, lane), batch_mul_add(cy, batch_spread(it.y, lane), batch_mul_add(cz, batch_spread(it.z, lane), batch_spread(it.w, lane))));
+            d = batch_mul_add(ex, batch_spread(abs(it.x), lane), batch_mul_add(ey, batch_spread(abs(it.y), lane), batch_mul_add(ez, batch_spread(abs(it.z), lane), d)));
+            closest = batch_min(closest, d);
+        }
+        return batch_mask_le(batch_spread(0.0f, lane), closest);
+    });
+}
+
+inline s64 intersect_batch(const frustumf &f, soa_sphere3 spheres, s64 count, u64 *hits) {
+    return impl::batch_hits(count, hits, [&](s64 i, auto lane) {
+        using namespace impl;
+
+        auto x = batch_load(spheres.X + i, lane), y = batch_load(spheres.Y + i, lane), z = batch_load(spheres.Z + i, lane);
+
+        auto closest = batch_spread(numeric_info<f32>::infinity(), lane);
+        For(f.Planes) {
+            auto d = batch_mul_add(x, batch_spread(it.x, lane), batch_mul_add(y, batch_spread(it.y, lane), batch_mul_add(z, batch_spread(it.z, lane), batch_spread(it.w, lane))));
+            closest = batch_min(closest, d);
+        }
+        return batch_mask_le(batch_spread(0.0f, lane) - batch_load(spheres.Radius + i, lane), closest);
+    });
+}
+
+// AoS versions, the boxes are transposed to SoA in blocks
+inline s64 intersect_batch(const ray<f32, 3> &r, const aabb3 *boxes, s64 count, u64 *hits, f32 maxDistance = numeric_info<f32>::infinity()) {
+    return impl::batch_aos_aabb_blocks(boxes, count, hits, [&](soa_aabb3 soa, s64 n, u64 *h) { return intersect_batch(r, soa, n, h, maxDistance); });
+}
+
+inline s64 intersect_batch(const frustumf &f, const aabb3 *boxes, s64 count, u64 *hits) {
+    return impl::batch_aos_aabb_blocks(boxes, count, hits, [&](soa_aabb3 soa, s64 n, u64 *h) { return intersect_batch(f, soa, n, h); });
+}
+
+inline s64 intersect_batch(const frustumf &f, const sphere3 *spheres, s64 count, u64 *hits) {
+    alignas(32) f32 s[4][64];
+
+    s64 result = 0;
+    for (s64 start = 0; start < count; start += 64) {
+        s64 n = min((s64) 64, count - start);
+        For(range(n)) {
+            auto &sp = spheres[start + it];
+            s[0][it] = sp.Center.x, s[1][it] = sp.Center.y, s[2][it] = sp.Center.z, s[3][it] = sp.Radius;
+        }
+        result += intersect_batch(f, soa_sphere3{s[0], s[1], s[2], s[3]}, n, hits + start / 64);
+    }
+    return result;
+}
+
 template <typename T, s64 Dim, s64 Order>
 struct BezierCurve {
     static_assert(Order >= 1, "Bezier curve must have order n>=1.");
@@ -0,0 +1,146 @@
+#include "half.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2 and F16C intrinsics
+
+#if COMPILER == MSVC
+#define TARGET_F16C
+#else
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Every kernel converts as many values as fit in its registers and leaves the rest to the scalar code in half.h,
+// which rounds the same way (to nearest even), so the results don't depend on the path.
+//
+// F16C (vcvtps2ph/vcvtph2ps) does f16 8 values at a time. It's on every x86 CPU with AVX but compilers
+// only use it with -mf16c, so we check for it at runtime. bf16 is integer work: round the f32 bits and take
+// the upper half, which SSE2 and NEON always have.
+//
+
+using f32_to_f16_func = void (*)(const f32 *src, s64 count, f16 *out);
+using f16_to_f32_func = void (*)(const f16 *src, s64 count, f32 *out);
+
+file_scope void f32_to_f16_scalar(const f32 *src, s64 count, f16 *out) {
+    For(range(count)) out[it] = src[it];
+}
+
+file_scope void f16_to_f32_scalar(const f16 *src, s64 count, f32 *out) {
+    For(range(count)) out[it] = src[it];
+}
+
+#if ARCH == X86
+TARGET_F16C file_scope void f32_to_f16_f16c(const f32 *src, s64 count, f16 *out) {
+    s64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128((__m128i *) (out + i), h);
+    }
+    f32_to_f16_scalar(src + i, count - i, out + i);
+}
+
+TARGET_F16C file_scope void f16_to_f32_f16c(const f16 *src, s64 count, f32 *out) {
+    s64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (src + i))));
+    }
+    f16_to_f32_scalar(src + i, count - i, out + i);
+}
+#endif
+
+void f32_to_f16(const f32 *src, s64 count, f16 *out) {
+#if ARCH == X86
+    local_persist cpu_dispatch<f32_to_f16_func> kernel;
+    auto *func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> f32_to_f16_func {
+        return cpu.F16C ? f32_to_f16_f16c : f32_to_f16_scalar;
+    });
+    func(src, count, out);
+#elif ARCH == ARM && ANY_ARM_NEON
+    s64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1_u16((u16 *) (out + i), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+    }
+    f32_to_f16_scalar(src + i, count - i, out + i);
+#else
+    f32_to_f16_scalar(src, count, out);
+#endif
+}
+
+void f16_to_f32(const f16 *src, s64 count, f32 *out) {
+#if ARCH == X86
+    local_persist cpu_dispatch<f16_to_f32_func> kernel;
+    auto *func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> f16_to_f32_func {
+        return cpu.F16C ? f16_to_f32_f16c : f16_to_f32_scalar;
+    });
+    func(src, count, out);
+#elif ARCH == ARM && ANY_ARM_NEON
+    s64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16((const u16 *) (src + i)))));
+    }
+    f16_to_f32_scalar(src + i, count - i, out + i);
+#else
+    f16_to_f32_scalar(src, count, out);
+#endif
+}
+
+void f32_to_bf16(const f32 *src, s64 count, bf16 *out) {
+    s64 i = 0;
+#if ARCH == X86
+    const __m128i one          = _mm_set1_epi32(1);
+    const __m128i roundingBias = _mm_set1_epi32(0x7FFF);
+    const __m128i absMask      = _mm_set1_epi32(0x7FFFFFFF);
+    const __m128i infinity     = _mm_set1_epi32(0x7F800000);
+    const __m128i quietBit     = _mm_set1_epi32(0x400000);
+
+    auto to_bf16 = [&](__m128i f) {
+        __m128i rounded = _mm_add_epi32(_mm_add_epi32(f, roundingBias), _mm_and_si128(_mm_srli_epi32(f, 16), one));
+        __m128i nan     = _mm_cmpgt_epi32(_mm_and_si128(f, absMask), infinity);
+        __m128i result  = _mm_or_si128(_mm_and_si128(nan, _mm_or_si128(f, quietBit)), _mm_andnot_si128(nan, rounded));
+
+        // Arithmetic shift, so the signed saturation in packs keeps the upper halves as they are
+        return _mm_srai_epi32(result, 16);
+    };
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = to_bf16(_mm_loadu_si128((const __m128i *) (src + i)));
+        __m128i b = to_bf16(_mm_loadu_si128((const __m128i *) (src + i + 4)));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
+    }
+#elif ARCH == ARM && ANY_ARM_NEON
+    const uint32x4_t roundingBias = vdupq_n_u32(0x7FFF);
+    const uint32x4_t infinity     = vdupq_n_u32(0x7F800000);
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t f       = vld1q_u32((const u32 *) (src + i));
+        uint32x4_t rounded = vaddq_u32(vaddq_u32(f, roundingBias), vandq_u32(vshrq_n_u32(f, 16), vdupq_n_u32(1)));
+        uint32x4_t nan     = vcgtq_u32(vandq_u32(f, vdupq_n_u32(0x7FFFFFFF)), infinity);
+        uint32x4_t result  = vbslq_u32(nan, vorrq_u32(f, vdupq_n_u32(0x400000)), rounded);
+        vst1_u16((u16 *) (out + i), vshrn_n_u32(result, 16));
+    }
+#endif
+    For(range(i, count)) out[it] = src[it];
+}
+
+void bf16_to_f32(const bf16 *src, s64 count, f32 *out) {
+    s64 i = 0;
+#if ARCH == X86
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_unpacklo_epi16(_mm_setzero_si128(), h));
+        _mm_storeu_si128((__m128i *) (out + i + 4), _mm_unpackhi_epi16(_mm_setzero_si128(), h));
+    }
+#elif ARCH == ARM && ANY_ARM_NEON
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32((u32 *) (out + i), vshll_n_u16(vld1_u16((const u16 *) (src + i)), 16));
+    }
+#endif
+    For(range(i, count)) out[it] = src[it];
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../types.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// 16 bit floats, for storing large arrays of geometry or features in half the memory (and half the bandwidth).
+//
+// * f16 is IEEE 754 binary16: 5 bits of exponent and 10 of mantissa. Up to 65504, about 3 decimal digits.
+// * bf16 is the upper half of an f32: the same range as f32 (8 bits of exponent) but only 7 bits of mantissa.
+//
+// These are storage types. They convert to and from f32 implicitly and arithmetic happens in f32, so
+// vec<f16, 4> works (without SIMD) and the results are rounded back when they are stored in it.
+// Converting rounds to nearest (ties to even) and keeps infinities and NaNs.
+//
+// For arrays use the bulk conversions at the bottom, they use F16C (8 at a time, picked at runtime)
+// or NEON for f16, and SSE2 or NEON for bf16.
+//
+
+namespace internal {
+always_inline u16 f32_bits_to_f16_bits(u32 f) {
+    u32 sign = f & 0x80000000;
+    f ^= sign;
+
+    u16 h;
+    if (f >= 0x47800000) {
+        // 65536 or more (or infinity or NaN). Finite values which would round up to 65536 get there through the last case.
+        h = f > 0x7F800000 ? 0x7E00 : 0x7C00;
+    } else if (f < 0x38800000) {
+        // Below the smallest normal f16 (2^-14). Adding 0.5 lines the mantissa bits up with the f16 subnormal ones,
+        // the float addition does the rounding.
+        f32 x = types::bit_cast<f32>(f) + 0.5f;
+        h     = (u16) (types::bit_cast<u32>(x) - 0x3F000000);
+    } else {
+        u32 odd = (f >> 13) & 1;
+        f += ((u32) (15 - 127) << 23) + 0xFFF + odd;  // Rebias the exponent and round to nearest even
+        h = (u16) (f >> 13);
+    }
+    return h | (u16) (sign >> 16);
+}
+
+always_inline u32 f16_bits_to_f32_bits(u16 h) {
+    u32 f        = (u32) (h & 0x7FFF) << 13;
+    u32 exponent = f & 0x0F800000;
+
+    f += (u32) (127 - 15) << 23;
+    if (exponent == 0x0F800000) {
+        f += (u32) (128 - 16) << 23;  // Infinity or NaN
+    } else if (!exponent) {
+        // Zero or subnormal, renormalize through the float unit
+        f += 1 << 23;
+        f = types::bit_cast<u32>(types::bit_cast<f32>(f) - types::bit_cast<f32>((u32) 113 << 23));
+    }
+    return f | ((u32) (h & 0x8000) << 16);
+}
+
+always_inline u16 f32_bits_to_bf16_bits(u32 f) {
+    if ((f & 0x7FFFFFFF) > 0x7F800000) return (u16) ((f >> 16) | 0x40);  // Keep NaNs quiet, rounding could make them infinity
+    return (u16) ((f + 0x7FFF + ((f >> 16) & 1)) >> 16);
+}
+}  // namespace internal
+
+struct f16 {
+    u16 Bits;
+
+    f16() = default;
+    f16(f32 value) : Bits(internal::f32_bits_to_f16_bits(types::bit_cast<u32>(value))) {}
+
+    static f16 from_bits(u16 bits) {
+        f16 result;
+        result.Bits = bits;
+        return result;
+    }
+
+    operator f32() const { return types::bit_cast<f32>(internal::f16_bits_to_f32_bits(Bits)); }
+
+    f16 &operator+=(f32 rhs) { return *this = (f32) *this + rhs; }
+    f16 &operator-=(f32 rhs) { return *this = (f32) *this - rhs; }
+    f16 &operator*=(f32 rhs) { return *this = (f32) *this * rhs; }
+    f16 &operator/=(f32 rhs) { return *this = (f32) *this / rhs; }
+};
+
+struct bf16 {
+    u16 Bits;
+
+    bf16() = default;
+    bf16(f32 value) : Bits(internal::f32_bits_to_bf16_bits(types::bit_cast<u32>(value))) {}
+
+    static bf16 from_bits(u16 bits) {
+        bf16 result;
+        result.Bits = bits;
+        return result;
+    }
+
+    operator f32() const { return types::bit_cast<f32>((u32) Bits << 16); }
+
+    bf16 &operator+=(f32 rhs) { return *this = (f32) *this + rhs; }
+    bf16 &operator-=(f32 rhs) { return *this = (f32) *this - rhs; }
+    bf16 &operator*=(f32 rhs) { return *this = (f32) *this * rhs; }
+    bf16 &operator/=(f32 rhs) { return *this = (f32) *this / rhs; }
+};
+
+static_assert(sizeof(f16) == 2 && sizeof(bf16) == 2);
+
+// Convert _count_ values from _src_ to _out_ (defined in half.cpp). _out_ may not overlap _src_.
+void f32_to_f16(const f32 *src, s64 count, f16 *out);
+void f16_to_f32(const f16 *src, s64 count, f32 *out);
+void f32_to_bf16(const f32 *src, s64 count, bf16 *out);
+void bf16_to_f32(const bf16 *src, s64 count, f32 *out);
+
+LSTD_END_NAMESPACE
@@ -176,6 +176,8 @@ struct OPTIMIZATION mat : public mat_data<T, R_, C_, Packed> {
     // :MathTypesNoInit By default we don't init (to save on performance) but you can call a constructor with a scalar value of 0 to zero-init.
     mat() {}
 
+    static constexpr bool NO_INIT_CONSTRUCT = true;  // See vec
+
     template <types::is_scalar H>
     mat(H h) {
         For(Stripes) it = StripeVecT(h);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "mat_simd.h"
 #include "mat_util.h"
 
 LSTD_BEGIN_NAMESPACE
@@ -20,19 +21,9 @@ inline auto small_product_rr(const mat<T, R1, Match, Packed> &lhs, const mat<U,
 
 template <typename T, typename U, s64 R1, s64 Match, s64 C2, bool Packed>
 inline mat<T, R1, C2, Packed> dot(const mat<T, R1, Match, Packed> &lhs, const mat<U, Match, C2, Packed> &rhs) {
-    if constexpr (R1 == 4 && Match == 4 && C2 == 4 && types::is_same<T, f32> && types::is_same<U, f32>) {
-        using V = mat_mul_elem_t<T, U>;
-        mat<V, 4, 4, Packed> result;
-
-        __m128 row[4], sum[4];
-        for (s32 i = 0; i < 4; i++) row[i] = _mm_load_ps((f32 *) &rhs.Stripes[i]);
-        for (s32 i = 0; i < 4; i++) {
-            sum[i] = _mm_setzero_ps();
-            for (s32 j = 0; j < 4; j++) {
-                sum[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(lhs(i, j)), row[j]), sum[i]);
-            }
-        }
-        for (s32 i = 0; i < 4; i++) _mm_store_ps((f32 *) &result.Stripes[i], sum[i]);
+    if constexpr (MAT44_F32_KERNELS && R1 == 4 && Match == 4 && C2 == 4 && types::is_same<T, f32> && types::is_same<U, f32>) {
+        mat<f32, 4, 4, Packed> result;
+        impl::mat44_f32_product((const f32 *) &lhs.Stripes[0], (const f32 *) &rhs.Stripes[0], (f32 *) &result.Stripes[0]);
         return result;
     } else {
         if constexpr (R1 <= 4 && Match <= 4 && C2 <= 4) {
@@ -57,8 +48,13 @@ inline mat<T, R1, C2, Packed> dot(const mat<T, R1, Match, Packed> &lhs, const ma
 template <typename Vt, typename Mt, s64 Vd, s64 Mcol, bool Packed>
 inline auto dot(const vec<Vt, Vd, Packed> &v, const mat<Mt, Vd, Mcol, Packed> &mat) {
     using Rt = mat_mul_elem_t<Vt, Mt>;
-    vec<Rt, Mcol, Packed> result = v[0] * mat.Stripes[0];
-    For(range(1, Vd)) result += v[it] * mat.Stripes[it];
+    vec<Rt, Mcol, Packed> result;
+    if constexpr (MAT44_F32_KERNELS && Vd == 4 && Mcol == 4 && types::is_same<Vt, f32> && types::is_same<Mt, f32>) {
+        impl::vec4_mat44_f32_product((const f32 *) &v, (const f32 *) &mat.Stripes[0], (f32 *) &result);
+    } else {
+        result = v[0] * mat.Stripes[0];
+        For(range(1, Vd)) result += v[it] * mat.Stripes[it];
+    }
     return result;
 }
 
@@ -232,9 +228,39 @@ auto inverse(const mat<T, 3, 3, Packed> &m) {
     return result;
 }
 
+// Returns the inverse of a 4x4 affine matrix (one whose last column is 0, 0, 0, 1 - rotations, scales, shears and
+// translations), much cheaper than the general inverse. inverse() checks for this and calls it, call it directly
+// if you know your matrix is affine.
+template <typename T, bool Packed>
+mat<T, 4, 4, Packed> affine_inverse(const mat<T, 4, 4, Packed> &m) {
+    mat<T, 4, 4, Packed> result;
+    if constexpr (MAT44_F32_KERNELS && types::is_same<T, f32>) {
+        impl::mat44_f32_affine_inverse((const f32 *) &m.Stripes[0], (f32 *) &result.Stripes[0]);
+    } else {
+        using Vec3 = vec<T, 3, false>;
+
+        // The inverse of the 3x3 part has the cross products as columns, see mat44_f32_affine_inverse()
+        Vec3 r0 = m.Stripes[0].xyz, r1 = m.Stripes[1].xyz, r2 = m.Stripes[2].xyz, t = m.Stripes[3].xyz;
+        Vec3 c0 = cross(r1, r2), c1 = cross(r2, r0), c2 = cross(r0, r1);
+
+        T invDet = T(1) / dot(r0, c0);
+        c0 *= invDet;
+        c1 *= invDet;
+        c2 *= invDet;
+
+        result.Stripes[0] = {c0.x, c1.x, c2.x, T(0)};
+        result.Stripes[1] = {c0.y, c1.y, c2.y, T(0)};
+        result.Stripes[2] = {c0.z, c1.z, c2.z, T(0)};
+        result.Stripes[3] = {-dot(t, c0), -dot(t, c1), -dot(t, c2), T(1)};
+    }
+    return result;
+}
+
 // Returns the inverse of a 4x4 matrix
 template <typename T, bool Packed>
 auto inverse(const mat<T, 4, 4, Packed> &m) {
+    if (m(0, 3) == T(0) && m(1, 3) == T(0) && m(2, 3) == T(0) && m(3, 3) == T(1)) return affine_inverse(m);
+
     mat<T, 4, 4, Packed> result;
 
     using Vec3 = vec<T, 3, false>;
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "simd.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Kernels for 4x4 f32 matrices, used by dot() and inverse() in mat_func.h.
+// They take the 16 floats of the matrix (row after row), so they work for packed and aligned matrices alike
+// (the loads are unaligned, which costs nothing when the data happens to be aligned).
+//
+// Our vectors are rows (v * M) and the translation is in the last row, see translation.h.
+//
+// MAT44_F32_KERNELS is 0 on architectures we don't have kernels for, then mat_func.h uses the generic code.
+//
+
+#if ARCH == X86 || (ARCH == ARM && ANY_ARM_NEON)
+#define MAT44_F32_KERNELS 1
+#else
+#define MAT44_F32_KERNELS 0
+#endif
+
+#if MAT44_F32_KERNELS
+namespace impl {
+
+#if ARCH == X86
+// a * b + c
+always_inline __m128 mat_mul_add_ps(__m128 a, __m128 b, __m128 c) {
+#if X86_FMA
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// The row vector _v_ times the matrix with rows _b0_.._b3_
+always_inline __m128 mat_row_product(__m128 v, __m128 b0, __m128 b1, __m128 b2, __m128 b3) {
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+    r = mat_mul_add_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), b1, r);
+    r = mat_mul_add_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), b2, r);
+    return mat_mul_add_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), b3, r);
+}
+
+// a.yzx * b.zxy - a.zxy * b.yzx, the w lane is 0 if it's 0 in both
+always_inline __m128 mat_cross_ps(__m128 a, __m128 b) {
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));  // This is the cross product as zxy
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#endif
+
+// out = lhs * rhs. _out_ may not be _lhs_ or _rhs_.
+inline void mat44_f32_product(const f32 *lhs, const f32 *rhs, f32 *out) {
+#if ARCH == X86 && X86_AVX
+    // Two rows at a time. The shuffle broadcasts an element of each row within its 128 bit half.
+    __m256 b0 = _mm256_broadcast_ps((const __m128 *) (rhs + 0));
+    __m256 b1 = _mm256_broadcast_ps((const __m128 *) (rhs + 4));
+    __m256 b2 = _mm256_broadcast_ps((const __m128 *) (rhs + 8));
+    __m256 b3 = _mm256_broadcast_ps((const __m128 *) (rhs + 12));
+
+    auto two_rows = [&](const f32 *a) {
+        __m256 v = _mm256_loadu_ps(a);
+        __m256 r = _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x00), b0);
+#if X86_FMA
+        r = _mm256_fmadd_ps(_mm256_shuffle_ps(v, v, 0x55), b1, r);
+        r = _mm256_fmadd_ps(_mm256_shuffle_ps(v, v, 0xAA), b2, r);
+        r = _mm256_fmadd_ps(_mm256_shuffle_ps(v, v, 0xFF), b3, r);
+#else
+        r = _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x55), b1), r);
+        r = _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xAA), b2), r);
+        r = _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xFF), b3), r);
+#endif
+        return r;
+    };
+
+    __m256 r01 = two_rows(lhs);
+    __m256 r23 = two_rows(lhs + 8);
+    _mm256_storeu_ps(out, r01);
+    _mm256_storeu_ps(out + 8, r23);
+#elif ARCH == X86
+    __m128 b0 = _mm_loadu_ps(rhs + 0), b1 = _mm_loadu_ps(rhs + 4), b2 = _mm_loadu_ps(rhs + 8), b3 = _mm_loadu_ps(rhs + 12);
+    for (s32 i = 0; i < 4; ++i) _mm_storeu_ps(out + i * 4, mat_row_product(_mm_loadu_ps(lhs + i * 4), b0, b1, b2, b3));
+#else
+    float32x4_t b0 = vld1q_f32(rhs + 0), b1 = vld1q_f32(rhs + 4), b2 = vld1q_f32(rhs + 8), b3 = vld1q_f32(rhs + 12);
+    for (s32 i = 0; i < 4; ++i) {
+        float32x4_t v = vld1q_f32(lhs + i * 4);
+        float32x4_t r = vmulq_laneq_f32(b0, v, 0);
+        r = vfmaq_laneq_f32(r, b1, v, 1);
+        r = vfmaq_laneq_f32(r, b2, v, 2);
+        r = vfmaq_laneq_f32(r, b3, v, 3);
+        vst1q_f32(out + i * 4, r);
+    }
+#endif
+}
+
+// out = v * m, _v_ has 4 components
+inline void vec4_mat44_f32_product(const f32 *v, const f32 *m, f32 *out) {
+#if ARCH == X86
+    __m128 r = mat_row_product(_mm_loadu_ps(v), _mm_loadu_ps(m + 0), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12));
+    _mm_storeu_ps(out, r);
+#else
+    float32x4_t x = vld1q_f32(v);
+    float32x4_t r = vmulq_laneq_f32(vld1q_f32(m + 0), x, 0);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 4), x, 1);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 8), x, 2);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 12), x, 3);
+    vst1q_f32(out, r);
+#endif
+}
+
+// The inverse of an affine matrix (the last column is 0, 0, 0, 1), see affine_inverse() in mat_func.h
+//
+// The 3x3 part A with rows r0, r1, r2 has the inverse with columns (r1 x r2, r2 x r0, r0 x r1) / det,
+// and the translation t becomes -t * inverse(A).
+inline void mat44_f32_affine_inverse(const f32 *m, f32 *out) {
+#if ARCH == X86
+    __m128 r0 = _mm_loadu_ps(m + 0), r1 = _mm_loadu_ps(m + 4), r2 = _mm_loadu_ps(m + 8), t = _mm_loadu_ps(m + 12);
+
+    __m128 c0 = mat_cross_ps(r1, r2);
+    __m128 c1 = mat_cross_ps(r2, r0);
+    __m128 c2 = mat_cross_ps(r0, r1);
+    __m128 c3 = _mm_setzero_ps();
+
+    // det = r0 . c0, the w lanes are 0
+    __m128 d = _mm_mul_ps(r0, c0);
+    d = _mm_add_ps(d, _mm_movehl_ps(d, d));
+    d = _mm_add_ss(d, _mm_shuffle_ps(d, d, 1));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(d, d, 0));
+
+    c0 = _mm_mul_ps(c0, invDet);
+    c1 = _mm_mul_ps(c1, invDet);
+    c2 = _mm_mul_ps(c2, invDet);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);  // Now the rows of the result, c3 is zero again
+
+    __m128 translation = _mm_mul_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+    translation = mat_mul_add_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), c1, translation);
+    translation = mat_mul_add_ps(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), c2, translation);
+    translation = _mm_sub_ps(_mm_setr_ps(0, 0, 0, 1), translation);
+
+    _mm_storeu_ps(out + 0, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, translation);
+#else
+    float32x4_t r0 = vld1q_f32(m + 0), r1 = vld1q_f32(m + 4), r2 = vld1q_f32(m + 8), t = vld1q_f32(m + 12);
+
+    auto cross = [](float32x4_t a, float32x4_t b) {
+        // yzx: rotate the xyz lanes, keep w (which is 0)
+        auto yzx = [](float32x4_t v) { return vsetq_lane_f32(0.0f, vextq_f32(vextq_f32(v, v, 3), v, 2), 3); };
+        float32x4_t c = vsubq_f32(vmulq_f32(a, yzx(b)), vmulq_f32(yzx(a), b));
+        return yzx(c);
+    };
+
+    float32x4_t c0 = cross(r1, r2), c1 = cross(r2, r0), c2 = cross(r0, r1);
+    float32x4_t invDet = vdupq_n_f32(1.0f / vaddvq_f32(vmulq_f32(r0, c0)));
+    c0 = vmulq_f32(c0, invDet);
+    c1 = vmulq_f32(c1, invDet);
+    c2 = vmulq_f32(c2, invDet);
+
+    f32 columns[3][4];
+    vst1q_f32(columns[0], c0);
+    vst1q_f32(columns[1], c1);
+    vst1q_f32(columns[2], c2);
+    for (s32 i = 0; i < 3; ++i) {
+        float32x4_t row = {columns[0][i], columns[1][i], columns[2][i], 0.0f};
+        vst1q_f32(out + i * 4, row);
+    }
+
+    float32x4_t translation = vmulq_laneq_f32(vld1q_f32(out + 0), t, 0);
+    translation = vfmaq_laneq_f32(translation, vld1q_f32(out + 4), t, 1);
+    translation = vfmaq_laneq_f32(translation, vld1q_f32(out + 8), t, 2);
+    float32x4_t last = {0.0f, 0.0f, 0.0f, 1.0f};
+    vst1q_f32(out + 12, vsubq_f32(last, translation));
+#endif
+}
+}  // namespace impl
+#endif
+
+LSTD_END_NAMESPACE
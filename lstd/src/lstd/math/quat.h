@@ -27,6 +27,8 @@ struct tquat {
     // :MathTypesNoInit By default we don't init (to save on performance) but you can call a constructor with a scalar value of 0 to zero-init.
     tquat() {}
 
+    static constexpr bool NO_INIT_CONSTRUCT = true;  // See vec
+
     tquat(const tquat &rhs) : Vec(rhs.Vec) {}
     tquat(T scalar, T x, T y, T z) : w(scalar), x(x), y(y), z(z) {}
 
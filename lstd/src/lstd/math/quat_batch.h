@@ -0,0 +1,278 @@
+#pragma once
+
+#include "batch.h"
+#include "quat_func.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Batch kernels over many f32 quaternions: normalize, nlerp, slerp, qmul and conversion to rotation matrices.
+// They work like the ones in batch.h: BATCH_WIDTH quaternions per instruction, the rest one by one.
+//
+// Arrays of quat (AoS) are loaded as is - a quaternion is a record of 4 floats, so BATCH_WIDTH of them are
+// transposed in registers (SSE/AVX shuffles, vld4/vst4 on NEON) instead of going through the stack.
+// SoA (soa_quat) is four streams of w, x, y and z.
+//
+// The interpolation factor is one for all (blending two poses) or one per element (e.g. per bone weights).
+//
+// slerp here doesn't call acos/sin: it uses the polynomial of Eberly ("A Fast and Accurate Algorithm for
+// Computing SLERP") which only needs multiplies and adds. It follows the shorter arc like slerp() in quat_func.h
+// and its weights are within 4e-5 of the exact ones.
+//
+// Outputs may be the same as the inputs (in-place), but they may not partially overlap.
+//
+
+struct soa_quat {
+    f32 *W = null, *X = null, *Y = null, *Z = null;
+};
+
+struct soa_quat_view {
+    const f32 *W = null, *X = null, *Y = null, *Z = null;
+
+    soa_quat_view() {}
+    soa_quat_view(const f32 *w, const f32 *x, const f32 *y, const f32 *z) : W(w), X(x), Y(y), Z(z) {}
+    soa_quat_view(const soa_quat &q) : W(q.W), X(q.X), Y(q.Y), Z(q.Z) {}
+};
+
+namespace impl {
+
+template <typename Lane>
+struct batch_quat {
+    Lane W, X, Y, Z;
+};
+
+// Where the kernels read quaternions from and write them to
+struct batch_quats_soa_in {
+    soa_quat_view Q;
+
+    template <typename Lane>
+    always_inline batch_quat<Lane> load(s64 i, Lane lane) const {
+        return {batch_load(Q.W + i, lane), batch_load(Q.X + i, lane), batch_load(Q.Y + i, lane), batch_load(Q.Z + i, lane)};
+    }
+};
+
+struct batch_quats_aos_in {
+    const f32 *P;  // Records of w, x, y, z
+
+    template <typename Lane>
+    always_inline batch_quat<Lane> load(s64 i, Lane) const {
+        batch_quat<Lane> q;
+        batch_load4(P + i * 4, &q.W, &q.X, &q.Y, &q.Z);
+        return q;
+    }
+};
+
+struct batch_quats_soa_out {
+    soa_quat Q;
+
+    template <typename Lane>
+    always_inline void store(s64 i, const batch_quat<Lane> &q) const {
+        batch_store(Q.W + i, q.W), batch_store(Q.X + i, q.X), batch_store(Q.Y + i, q.Y), batch_store(Q.Z + i, q.Z);
+    }
+};
+
+struct batch_quats_aos_out {
+    f32 *P;
+
+    template <typename Lane>
+    always_inline void store(s64 i, const batch_quat<Lane> &q) const { batch_store4(P + i * 4, q.W, q.X, q.Y, q.Z); }
+};
+
+// One factor for everything, or one per element
+struct batch_weights {
+    const f32 *T;
+    f32 Scalar;
+
+    template <typename Lane>
+    always_inline Lane load(s64 i, Lane lane) const { return T ? batch_load(T + i, lane) : batch_spread(Scalar, lane); }
+};
+
+template <typename Lane>
+always_inline Lane batch_quat_dot(const batch_quat<Lane> &a, const batch_quat<Lane> &b) {
+    return batch_mul_add(a.W, b.W, batch_mul_add(a.X, b.X, batch_mul_add(a.Y, b.Y, a.Z * b.Z)));
+}
+
+template <typename Lane>
+always_inline batch_quat<Lane> batch_quat_normalize(const batch_quat<Lane> &q) {
+    Lane len = batch_sqrt(batch_quat_dot(q, q));
+    return {q.W / len, q.X / len, q.Y / len, q.Z / len};
+}
+
+template <typename Lane>
+always_inline batch_quat<Lane> batch_quat_nlerp(const batch_quat<Lane> &a, const batch_quat<Lane> &b, Lane t) {
+    Lane d = batch_quat_dot(a, b);
+
+    // b or -b, whichever is on the same side as a
+    batch_quat<Lane> r;
+    r.W = batch_mul_add(batch_xor_sign(b.W, d) - a.W, t, a.W);
+    r.X = batch_mul_add(batch_xor_sign(b.X, d) - a.X, t, a.X);
+    r.Y = batch_mul_add(batch_xor_sign(b.Y, d) - a.Y, t, a.Y);
+    r.Z = batch_mul_add(batch_xor_sign(b.Z, d) - a.Z, t, a.Z);
+    return batch_quat_normalize(r);
+}
+
+// sin(t * theta) / sin(theta) as a series in (cos(theta) - 1), the last term is scaled by mu to make up for the cut-off ones
+constexpr f32 EBERLY_MU = 1.85298109240830f;
+constexpr f32 EBERLY_U[8] = {1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9), 1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), EBERLY_MU / (8 * 17)};
+constexpr f32 EBERLY_V[8] = {1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9, 5.0f / 11, 6.0f / 13, 7.0f / 15, EBERLY_MU * 8 / 17};
+
+template <typename Lane>
+always_inline batch_quat<Lane> batch_quat_slerp(const batch_quat<Lane> &a, const batch_quat<Lane> &b, Lane t) {
+    Lane d = batch_quat_dot(a, b);
+    Lane one = batch_spread(1.0f, t);
+
+    Lane xm1 = batch_xor_sign(d, d) - one;  // cos(theta) - 1 of the shorter arc
+    Lane s = one - t;
+    Lane tt = t * t, ss = s * s;
+
+    Lane cT = one, cS = one;
+    for (s64 i = 7; i >= 0; --i) {
+        Lane u = batch_spread(EBERLY_U[i], t), v = batch_spread(EBERLY_V[i], t);
+        cT = batch_mul_add(batch_mul_add(u, tt, batch_spread(0.0f, t) - v) * xm1, cT, one);
+        cS = batch_mul_add(batch_mul_add(u, ss, batch_spread(0.0f, t) - v) * xm1, cS, one);
+    }
+    cT = batch_xor_sign(cT * t, d);
+    cS = cS * s;
+
+    return {batch_mul_add(a.W, cS, b.W * cT), batch_mul_add(a.X, cS, b.X * cT), batch_mul_add(a.Y, cS, b.Y * cT), batch_mul_add(a.Z, cS, b.Z * cT)};
+}
+
+// The same as impl::product() in quat_func.h
+template <typename Lane>
+always_inline batch_quat<Lane> batch_quat_mul(const batch_quat<Lane> &l, const batch_quat<Lane> &r) {
+    batch_quat<Lane> q;
+    q.W = l.W * r.W - l.X * r.X - l.Y * r.Y - l.Z * r.Z;
+    q.X = l.W * r.X + l.X * r.W + l.Y * r.Z - l.Z * r.Y;
+    q.Y = l.W * r.Y - l.X * r.Z + l.Y * r.W + l.Z * r.X;
+    q.Z = l.W * r.Z + l.X * r.Y - l.Y * r.X + l.Z * r.W;
+    return q;
+}
+
+template <typename In, typename Out>
+void batch_quats_normalize(In in, Out out, s64 count) {
+    batch_for_each(count, [&](s64 i, auto lane) { out.store(i, batch_quat_normalize(in.load(i, lane))); });
+}
+
+template <bool Slerp, typename InA, typename InB, typename Out>
+void batch_quats_interpolate(InA a, InB b, batch_weights t, Out out, s64 count) {
+    batch_for_each(count, [&](s64 i, auto lane) {
+        auto qa = a.load(i, lane), qb = b.load(i, lane);
+        auto ti = t.load(i, lane);
+        out.store(i, Slerp ? batch_quat_slerp(qa, qb, ti) : batch_quat_nlerp(qa, qb, ti));
+    });
+}
+
+template <typename InA, typename InB, typename Out>
+void batch_quats_mul(InA a, InB b, Out out, s64 count) {
+    batch_for_each(count, [&](s64 i, auto lane) { out.store(i, batch_quat_mul(a.load(i, lane), b.load(i, lane))); });
+}
+
+// Rotation matrices like the conversion operators of tquat: the 3x3 part, the rest is identity
+template <typename In, s64 R, s64 C, bool Packed>
+void batch_quats_to_mat(In in, mat<f32, R, C, Packed> *out, s64 count) {
+    static_assert(R >= 3 && C >= 3);
+
+    batch_for_each(count, [&](s64 i, auto lane) {
+        using Lane = decltype(lane);
+        auto q = in.load(i, lane);
+
+        Lane two = batch_spread(2.0f, lane), one = batch_spread(1.0f, lane);
+        Lane xx = q.X * q.X, yy = q.Y * q.Y, zz = q.Z * q.Z;
+        Lane xy = q.X * q.Y, xz = q.X * q.Z, yz = q.Y * q.Z;
+        Lane wx = q.W * q.X, wy = q.W * q.Y, wz = q.W * q.Z;
+
+        Lane e[9] = {
+            one - two * (yy + zz), two * (xy - wz),       two * (xz + wy),
+            two * (xy + wz),       one - two * (xx + zz), two * (yz - wx),
+            two * (xz - wy),       two * (yz + wx),       one - two * (xx + yy),
+        };
+
+        constexpr s64 LANES = types::is_same<Lane, f32> ? 1 : batch_f32::WIDTH;
+        f32 values[9][LANES];
+        For(range(9)) batch_store(values[it], e[it]);
+
+        For_as(l, range(LANES)) {
+            auto &m = out[i + l];
+            For_as(r, range(R)) For_as(c, range(C)) m(r, c) = r < 3 && c < 3 ? values[r * 3 + c][l] : f32(r == c);
+        }
+    });
+}
+
+}  // namespace impl
+
+//
+// SoA
+//
+
+inline void normalize(soa_quat_view in, soa_quat out, s64 count) { impl::batch_quats_normalize(impl::batch_quats_soa_in{in}, impl::batch_quats_soa_out{out}, count); }
+
+inline void nlerp(soa_quat_view a, soa_quat_view b, f32 t, soa_quat out, s64 count) {
+    impl::batch_quats_interpolate<false>(impl::batch_quats_soa_in{a}, impl::batch_quats_soa_in{b}, impl::batch_weights{null, t}, impl::batch_quats_soa_out{out}, count);
+}
+
+inline void nlerp(soa_quat_view a, soa_quat_view b, const f32 *t, soa_quat out, s64 count) {
+    impl::batch_quats_interpolate<false>(impl::batch_quats_soa_in{a}, impl::batch_quats_soa_in{b}, impl::batch_weights{t, 0}, impl::batch_quats_soa_out{out}, count);
+}
+
+inline void slerp(soa_quat_view a, soa_quat_view b, f32 t, soa_quat out, s64 count) {
+    impl::batch_quats_interpolate<true>(impl::batch_quats_soa_in{a}, impl::batch_quats_soa_in{b}, impl::batch_weights{null, t}, impl::batch_quats_soa_out{out}, count);
+}
+
+inline void slerp(soa_quat_view a, soa_quat_view b, const f32 *t, soa_quat out, s64 count) {
+    impl::batch_quats_interpolate<true>(impl::batch_quats_soa_in{a}, impl::batch_quats_soa_in{b}, impl::batch_weights{t, 0}, impl::batch_quats_soa_out{out}, count);
+}
+
+// out[i] = qmul(a[i], b[i])
+inline void qmul(soa_quat_view a, soa_quat_view b, soa_quat out, s64 count) {
+    impl::batch_quats_mul(impl::batch_quats_soa_in{a}, impl::batch_quats_soa_in{b}, impl::batch_quats_soa_out{out}, count);
+}
+
+template <s64 R, s64 C, bool Packed>
+void to_mat(soa_quat_view in, mat<f32, R, C, Packed> *out, s64 count) {
+    impl::batch_quats_to_mat(impl::batch_quats_soa_in{in}, out, count);
+}
+
+//
+// AoS
+//
+
+template <bool Packed>
+void normalize(const tquat<f32, Packed> *in, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_normalize(impl::batch_quats_aos_in{(const f32 *) in}, impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool Packed>
+void nlerp(const tquat<f32, Packed> *a, const tquat<f32, Packed> *b, f32 t, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_interpolate<false>(impl::batch_quats_aos_in{(const f32 *) a}, impl::batch_quats_aos_in{(const f32 *) b}, impl::batch_weights{null, t},
+                                         impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool Packed>
+void nlerp(const tquat<f32, Packed> *a, const tquat<f32, Packed> *b, const f32 *t, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_interpolate<false>(impl::batch_quats_aos_in{(const f32 *) a}, impl::batch_quats_aos_in{(const f32 *) b}, impl::batch_weights{t, 0},
+                                         impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool Packed>
+void slerp(const tquat<f32, Packed> *a, const tquat<f32, Packed> *b, f32 t, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_interpolate<true>(impl::batch_quats_aos_in{(const f32 *) a}, impl::batch_quats_aos_in{(const f32 *) b}, impl::batch_weights{null, t},
+                                        impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool Packed>
+void slerp(const tquat<f32, Packed> *a, const tquat<f32, Packed> *b, const f32 *t, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_interpolate<true>(impl::batch_quats_aos_in{(const f32 *) a}, impl::batch_quats_aos_in{(const f32 *) b}, impl::batch_weights{t, 0},
+                                        impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool Packed>
+void qmul(const tquat<f32, Packed> *a, const tquat<f32, Packed> *b, tquat<f32, Packed> *out, s64 count) {
+    impl::batch_quats_mul(impl::batch_quats_aos_in{(const f32 *) a}, impl::batch_quats_aos_in{(const f32 *) b}, impl::batch_quats_aos_out{(f32 *) out}, count);
+}
+
+template <bool QPacked, s64 R, s64 C, bool Packed>
+void to_mat(const tquat<f32, QPacked> *in, mat<f32, R, C, Packed> *out, s64 count) {
+    impl::batch_quats_to_mat(impl::batch_quats_aos_in{(const f32 *) in}, out, count);
+}
+
+LSTD_END_NAMESPACE
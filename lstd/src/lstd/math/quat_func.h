@@ -146,6 +146,29 @@ bool is_normalized(const tquat<T, Packed> &q) {
     return is_normalized(q.Vec);
 }
 
+// Interpolates linearly and normalizes, along the shorter arc (_b_ is negated if it's on the other side of the sphere).
+// Cheaper than slerp. The angular speed isn't constant, but for the small angles between animation keys it's close.
+template <typename T, bool Packed>
+tquat<T, Packed> nlerp(const tquat<T, Packed> &a, const tquat<T, Packed> &b, T t) {
+    vec<T, 4, Packed> to = dot(a.Vec, b.Vec) < 0 ? b.Vec * T(-1) : b.Vec;
+    return tquat<T, Packed>{normalize(a.Vec + (to - a.Vec) * t)};
+}
+
+// Spherical linear interpolation along the shorter arc, rotates with constant angular speed from _a_ (t = 0) to _b_ (t = 1)
+template <typename T, bool Packed>
+tquat<T, Packed> slerp(const tquat<T, Packed> &a, const tquat<T, Packed> &b, T t) {
+    T d = dot(a.Vec, b.Vec);
+    vec<T, 4, Packed> to = d < 0 ? b.Vec * T(-1) : b.Vec;
+    d = abs(d);
+
+    // sin(theta) goes to zero, but then the arc is a line anyway
+    if (d > T(0.9995)) return nlerp(a, tquat<T, Packed>{to}, t);
+
+    T theta = (T) acos(d);
+    T s = (T) sin(theta);
+    return tquat<T, Packed>{a.Vec * ((T) sin((1 - t) * theta) / s) + to * ((T) sin(t * theta) / s)};
+}
+
 template <typename T, bool Packed>
 vec<T, 3, Packed> to_euler_angles(const tquat<T, Packed> &q) {
     assert(is_normalized(q.Vec));
@@ -8,8 +8,9 @@ LSTD_BEGIN_NAMESPACE
 // Additional implementation are included as template specializations.
 
 // @Volatile Currently:
-// 2,4 or 8 dimension f32 or f64 parameters accepted.
-// Uses SSE2 or AVX acceleration if enabled in the compiler.
+// 2,4 or 8 dimension f32, f64, s32 or s64 parameters accepted.
+// Uses SSE2 (simd_sse2.h) and AVX/AVX2 (simd_avx.h) acceleration if enabled in the compiler,
+// or NEON (simd_neon.h) on AArch64.
 template <typename T, s64 Dim>
 union alignas(16) simd {
     // @Cleanup: This looks messy
@@ -66,6 +67,13 @@ union alignas(16) simd {
         return result;
     }
 
+    // a * b + c
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        simd result;
+        for (s64 i = 0; i < Dim; ++i) result.reg[i] = a.reg[i] * b.reg[i] + c.reg[i];
+        return result;
+    }
+
     static inline simd spread(T value) {
         simd result;
         for (s64 i = 0; i < Dim; ++i) result.reg[i] = value;
@@ -134,4 +142,12 @@ union alignas(16) simd {
 
 LSTD_END_NAMESPACE
 
+#if ARCH == X86
 #include "simd_sse2.h"
+
+#if X86_AVX
+#include "simd_avx.h"
+#endif
+#elif ARCH == ARM && ANY_ARM_NEON
+#include "simd_neon.h"
+#endif
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "../types.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// 256 bit specializations, used instead of the two SSE halves (simd_sse2.h) when compiling with AVX (AVX2 for the integer ones).
+//
+// These keep the layout of the SSE versions (16 byte alignment) and load/store the lanes unaligned.
+// A __m256 member would make every vector which uses them 32 byte aligned, while our allocators only give 16
+// (Context.AllocAlignment), and the compiler would use aligned moves on arrays of them. Unaligned loads of
+// data which is aligned cost the same as aligned ones.
+//
+
+namespace internal {
+// Sums the 8 lanes
+always_inline f32 simd_horizontal_add(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// Sums the 4 lanes
+always_inline f64 simd_horizontal_add(__m256d v) {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+    return _mm_cvtsd_f64(s);
+}
+}  // namespace internal
+
+// Specialization for 8xf32, using AVX
+template <>
+union alignas(16) simd<f32, 8> {
+    __m128 reg[2];
+    f32 v[8];
+
+    always_inline __m256 load() const { return _mm256_loadu_ps(v); }
+
+    static always_inline simd from(__m256 value) {
+        simd r;
+        _mm256_storeu_ps(r.v, value);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(_mm256_mul_ps(lhs.load(), rhs.load())); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(_mm256_div_ps(lhs.load(), rhs.load())); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(_mm256_add_ps(lhs.load(), rhs.load())); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(_mm256_sub_ps(lhs.load(), rhs.load())); }
+
+    static inline simd mul(const simd &lhs, f32 rhs) { return from(_mm256_mul_ps(lhs.load(), _mm256_set1_ps(rhs))); }
+    static inline simd div(const simd &lhs, f32 rhs) { return from(_mm256_div_ps(lhs.load(), _mm256_set1_ps(rhs))); }
+    static inline simd add(const simd &lhs, f32 rhs) { return from(_mm256_add_ps(lhs.load(), _mm256_set1_ps(rhs))); }
+    static inline simd sub(const simd &lhs, f32 rhs) { return from(_mm256_sub_ps(lhs.load(), _mm256_set1_ps(rhs))); }
+
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+#if X86_FMA
+        return from(_mm256_fmadd_ps(a.load(), b.load(), c.load()));
+#else
+        return from(_mm256_add_ps(_mm256_mul_ps(a.load(), b.load()), c.load()));
+#endif
+    }
+
+    static inline simd spread(f32 value) { return from(_mm256_set1_ps(value)); }
+
+    static inline simd set(f32 a, f32 b, f32 c, f32 d, f32 e, f32 f, f32 g, f32 h) { return from(_mm256_setr_ps(a, b, c, d, e, f, g, h)); }
+
+    template <s32 Count>
+    static inline f32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 8, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        __m256 m = _mm256_mul_ps(lhs.load(), rhs.load());
+        if constexpr (Count < 8) {
+            __m256i mask = _mm256_setr_epi32(-1, Count > 1 ? -1 : 0, Count > 2 ? -1 : 0, Count > 3 ? -1 : 0, Count > 4 ? -1 : 0, Count > 5 ? -1 : 0, Count > 6 ? -1 : 0, 0);
+            m = _mm256_and_ps(m, _mm256_castsi256_ps(mask));
+        }
+        return internal::simd_horizontal_add(m);
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3, s32 i4, s32 i5, s32 i6, s32 i7>
+    static inline simd shuffle(const simd &arg) {
+#if X86_AVX2
+        return from(_mm256_permutevar8x32_ps(arg.load(), _mm256_setr_epi32(i7, i6, i5, i4, i3, i2, i1, i0)));
+#else
+        simd r;
+        r.v[7] = arg.v[i0];
+        r.v[6] = arg.v[i1];
+        r.v[5] = arg.v[i2];
+        r.v[4] = arg.v[i3];
+        r.v[3] = arg.v[i4];
+        r.v[2] = arg.v[i5];
+        r.v[1] = arg.v[i6];
+        r.v[0] = arg.v[i7];
+        return r;
+#endif
+    }
+};
+
+// Specialization for 4xf64, using AVX
+template <>
+union alignas(16) simd<f64, 4> {
+    __m128d reg[2];
+    f64 v[4];
+
+    always_inline __m256d load() const { return _mm256_loadu_pd(v); }
+
+    static always_inline simd from(__m256d value) {
+        simd r;
+        _mm256_storeu_pd(r.v, value);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(_mm256_mul_pd(lhs.load(), rhs.load())); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(_mm256_div_pd(lhs.load(), rhs.load())); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(_mm256_add_pd(lhs.load(), rhs.load())); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(_mm256_sub_pd(lhs.load(), rhs.load())); }
+
+    static inline simd mul(const simd &lhs, f64 rhs) { return from(_mm256_mul_pd(lhs.load(), _mm256_set1_pd(rhs))); }
+    static inline simd div(const simd &lhs, f64 rhs) { return from(_mm256_div_pd(lhs.load(), _mm256_set1_pd(rhs))); }
+    static inline simd add(const simd &lhs, f64 rhs) { return from(_mm256_add_pd(lhs.load(), _mm256_set1_pd(rhs))); }
+    static inline simd sub(const simd &lhs, f64 rhs) { return from(_mm256_sub_pd(lhs.load(), _mm256_set1_pd(rhs))); }
+
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+#if X86_FMA
+        return from(_mm256_fmadd_pd(a.load(), b.load(), c.load()));
+#else
+        return from(_mm256_add_pd(_mm256_mul_pd(a.load(), b.load()), c.load()));
+#endif
+    }
+
+    static inline simd spread(f64 value) { return from(_mm256_set1_pd(value)); }
+
+    static inline simd set(f64 x, f64 y, f64 z, f64 w) { return from(_mm256_setr_pd(x, y, z, w)); }
+
+    template <s32 Count>
+    static inline f64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        __m256d m = _mm256_mul_pd(lhs.load(), rhs.load());
+        if constexpr (Count < 4) {
+            __m256i mask = _mm256_setr_epi64x(-1, Count > 1 ? -1 : 0, Count > 2 ? -1 : 0, 0);
+            m = _mm256_and_pd(m, _mm256_castsi256_pd(mask));
+        }
+        return internal::simd_horizontal_add(m);
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+#if X86_AVX2
+        return from(_mm256_permute4x64_pd(arg.load(), _MM_SHUFFLE(i0, i1, i2, i3)));
+#else
+        simd r;
+        r.v[3] = arg.v[i0];
+        r.v[2] = arg.v[i1];
+        r.v[1] = arg.v[i2];
+        r.v[0] = arg.v[i3];
+        return r;
+#endif
+    }
+};
+
+#if X86_AVX2
+// Specialization for 8xs32, using AVX2. Division is per lane.
+template <>
+union alignas(16) simd<s32, 8> {
+    __m128i reg[2];
+    s32 v[8];
+
+    always_inline __m256i load() const { return _mm256_loadu_si256((const __m256i *) v); }
+
+    static always_inline simd from(__m256i value) {
+        simd r;
+        _mm256_storeu_si256((__m256i *) r.v, value);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(_mm256_mullo_epi32(lhs.load(), rhs.load())); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(_mm256_add_epi32(lhs.load(), rhs.load())); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(_mm256_sub_epi32(lhs.load(), rhs.load())); }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        for (s32 i = 0; i < 8; ++i) r.v[i] = lhs.v[i] / rhs.v[i];
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, s32 rhs) { return from(_mm256_mullo_epi32(lhs.load(), _mm256_set1_epi32(rhs))); }
+    static inline simd add(const simd &lhs, s32 rhs) { return from(_mm256_add_epi32(lhs.load(), _mm256_set1_epi32(rhs))); }
+    static inline simd sub(const simd &lhs, s32 rhs) { return from(_mm256_sub_epi32(lhs.load(), _mm256_set1_epi32(rhs))); }
+
+    static inline simd div(const simd &lhs, s32 rhs) {
+        simd r;
+        for (s32 i = 0; i < 8; ++i) r.v[i] = lhs.v[i] / rhs;
+        return r;
+    }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return add(mul(a, b), c); }
+
+    static inline simd spread(s32 value) { return from(_mm256_set1_epi32(value)); }
+
+    static inline simd set(s32 a, s32 b, s32 c, s32 d, s32 e, s32 f, s32 g, s32 h) { return from(_mm256_setr_epi32(a, b, c, d, e, f, g, h)); }
+
+    template <s32 Count>
+    static inline s32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 8, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        simd m = mul(lhs, rhs);
+        s32 sum = m.v[0];
+        for (s32 i = 1; i < Count; ++i) sum += m.v[i];
+        return sum;
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3, s32 i4, s32 i5, s32 i6, s32 i7>
+    static inline simd shuffle(const simd &arg) {
+        return from(_mm256_permutevar8x32_epi32(arg.load(), _mm256_setr_epi32(i7, i6, i5, i4, i3, i2, i1, i0)));
+    }
+};
+
+// Specialization for 4xs64, using AVX2. Multiplication and division are per lane (a 64 bit multiply needs AVX-512).
+template <>
+union alignas(16) simd<s64, 4> {
+    __m128i reg[2];
+    s64 v[4];
+
+    always_inline __m256i load() const { return _mm256_loadu_si256((const __m256i *) v); }
+
+    static always_inline simd from(__m256i value) {
+        simd r;
+        _mm256_storeu_si256((__m256i *) r.v, value);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] * rhs.v[i];
+        return r;
+    }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] / rhs.v[i];
+        return r;
+    }
+
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(_mm256_add_epi64(lhs.load(), rhs.load())); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(_mm256_sub_epi64(lhs.load(), rhs.load())); }
+
+    static inline simd mul(const simd &lhs, s64 rhs) { return mul(lhs, spread(rhs)); }
+    static inline simd div(const simd &lhs, s64 rhs) { return div(lhs, spread(rhs)); }
+    static inline simd add(const simd &lhs, s64 rhs) { return from(_mm256_add_epi64(lhs.load(), _mm256_set1_epi64x(rhs))); }
+    static inline simd sub(const simd &lhs, s64 rhs) { return from(_mm256_sub_epi64(lhs.load(), _mm256_set1_epi64x(rhs))); }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return add(mul(a, b), c); }
+
+    static inline simd spread(s64 value) { return from(_mm256_set1_epi64x(value)); }
+
+    static inline simd set(s64 x, s64 y, s64 z, s64 w) { return from(_mm256_setr_epi64x(x, y, z, w)); }
+
+    template <s32 Count>
+    static inline s64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        s64 sum = lhs.v[0] * rhs.v[0];
+        for (s32 i = 1; i < Count; ++i) sum += lhs.v[i] * rhs.v[i];
+        return sum;
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+        return from(_mm256_permute4x64_epi64(arg.load(), _MM_SHUFFLE(i0, i1, i2, i3)));
+    }
+};
+#endif
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,967 @@
+#pragma once
+
+#include "../internal/common.h"
+#include "simd.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// sin, cos, sincos, exp, log, atan2 and rsqrt for simd<f32, Dim> and simd<f64, Dim>, computed for all lanes at once
+// with polynomials instead of calling the scalar cephes routines (see internal/common.h) lane by lane.
+//
+//     simd<f32, 4> s, c;
+//     simd_sincos(angles, &s, &c);
+//
+//     f32 s1, c1;
+//     simd_sincos(angle, &s1, &c1);  // Plain f32 and f64 work too, the result is the same as in a lane
+//
+// The polynomials are cephes' (sinf, cosf, expf, logf, atanf for f32 and sin, cos, exp, log, atan for f64),
+// the branches are replaced with selects so every lane does the same work. The max errors, measured against
+// the correctly rounded result over millions of random arguments:
+//
+//                       f32                                   f64
+//     sin, cos          2 ULP for |x| < 100,                  2 ULP for |x| < 1e8
+//                       1e-7 absolute for |x| < 8192
+//     exp               2 ULP                                 2 ULP
+//     log               1 ULP                                 1 ULP
+//     atan2             3 ULP                                 2 ULP
+//     rsqrt             2 ULP                                 2 ULP
+//
+// atan2 returns [-PI, PI] like the C library, not [0, TAU] like cephes' atan2.
+//
+// sin and cos reduce the argument with three parts of PI/2 (Cody-Waite), the error grows past the ranges above
+// (slower with FMA) and the result is garbage past 2^22 (f32) / 2^51 (f64). exp returns inf past the largest finite
+// result and 0 below the smallest normal one (denormal results are flushed). log returns NaN for negative arguments
+// and -inf for 0, denormal arguments are fine.
+//
+// The _fast variants are for graphics, where 4-5 correct digits are enough:
+//
+//     sin_fast, cos_fast    4e-5 absolute for |x| < 100 (lower degree polynomials, a shorter reduction)
+//     exp_fast              6e-5 relative, no inf, 0 or NaN handling (the argument is clamped to the finite range)
+//     log_fast              1e-5 absolute, for positive normal arguments only
+//     atan2_fast            1.6e-3 radians
+//     rsqrt_fast            3e-7 relative, from the hardware estimate and Newton steps. The f64 one goes through
+//                           the f32 estimate, so the argument has to be in the range of f32.
+//
+// Lanes are 128 bits (SSE2, NEON) or 256 bits (AVX), simd<..., Dim> which doesn't fill a lane is padded,
+// architectures without SIMD run the same code on one element at a time.
+//
+
+namespace impl {
+
+template <typename T>
+struct simd_math_constants;
+
+template <>
+struct simd_math_constants<f32> {
+    using U = u32;
+
+    static constexpr U MANTISSA_BITS = 23;
+    static constexpr U MANTISSA_MASK = 0x007FFFFF;
+    static constexpr U SIGN_MASK = 0x80000000;
+    static constexpr f32 EXPONENT_BIAS = 127;
+
+    // x + ROUND - ROUND rounds x to the nearest integer (for |x| < 2^22), and the integer is in the low bits of x + ROUND
+    static constexpr f32 ROUND = 12582912.0f;  // 1.5 * 2^23
+    static constexpr f32 POW2_MAGIC = 8388608.0f;  // 2^23
+
+    static constexpr f32 MIN_NORMAL = 1.17549435e-38f;
+    static constexpr f32 DENORMAL_SCALE = 16777216.0f;  // 2^24
+    static constexpr f32 DENORMAL_SCALE_BITS = 24;
+
+    static constexpr f32 TWO_OVER_PI = 0.636619772367581343f;
+    static constexpr f32 PIO2_1 = 1.5703125f, PIO2_2 = 4.837512969970703125e-4f, PIO2_3 = 7.54978995489188216e-8f;
+    static constexpr f32 SIN[] = {-1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f};
+    static constexpr f32 COS[] = {2.443315711809948e-5f, -1.388731625493765e-3f, 4.166664568298827e-2f};
+
+    static constexpr f32 LOG2E = 1.44269504088896341f;
+    static constexpr f32 LN2_HI = 0.693359375f, LN2_LO = -2.12194440e-4f;
+    static constexpr f32 MAX_LOG = 88.7228391f, MIN_LOG = -87.3365447f;  // ln(largest finite), ln(smallest normal)
+    static constexpr f32 EXP[] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+    static constexpr f32 SQRT_HALF = 0.707106781186547524f;
+    static constexpr f32 LOG[] = {7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f, -1.2420140846e-1f, 1.4249322787e-1f,
+                                  -1.6668057665e-1f, 2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f};
+
+    static constexpr f32 PI = 3.14159265358979323846f, PIO2 = 1.57079632679489661923f, PIO4 = 0.785398163397448309616f;
+    static constexpr f32 PI_LO = -8.74227766e-8f, PIO2_LO = -4.37113883e-8f;  // PI - (f32) PI, PI / 2 - (f32) (PI / 2)
+    static constexpr f32 ATAN_REDUCE = 2.41421356237309505f;  // 1 / tan(PI / 8)
+    static constexpr f32 ATAN[] = {8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f};
+};
+
+template <>
+struct simd_math_constants<f64> {
+    using U = u64;
+
+    static constexpr U MANTISSA_BITS = 52;
+    static constexpr U MANTISSA_MASK = 0x000FFFFFFFFFFFFFull;
+    static constexpr U SIGN_MASK = 0x8000000000000000ull;
+    static constexpr f64 EXPONENT_BIAS = 1023;
+
+    static constexpr f64 ROUND = 6755399441055744.0;  // 1.5 * 2^52
+    static constexpr f64 POW2_MAGIC = 4503599627370496.0;  // 2^52
+
+    static constexpr f64 MIN_NORMAL = 2.2250738585072014e-308;
+    static constexpr f64 DENORMAL_SCALE = 18014398509481984.0;  // 2^54
+    static constexpr f64 DENORMAL_SCALE_BITS = 54;
+
+    static constexpr f64 TWO_OVER_PI = 0.636619772367581343075535053490;
+    static constexpr f64 PIO2_1 = 1.57079625129699707031, PIO2_2 = 7.54978941586159635335e-8, PIO2_3 = 5.39030285815811905290e-15;
+    static constexpr f64 SIN[] = {1.58962301576546568060e-10, -2.50507477628578072866e-8, 2.75573136213857245213e-6,
+                                  -1.98412698295895385996e-4, 8.33333333332211858878e-3, -1.66666666666666307295e-1};
+    static constexpr f64 COS[] = {-1.13585365213876817300e-11, 2.08757008419747316778e-9, -2.75573141792967388112e-7,
+                                  2.48015872888517045348e-5, -1.38888888888730564116e-3, 4.16666666666665929218e-2};
+
+    static constexpr f64 LOG2E = 1.4426950408889634073599;
+    static constexpr f64 LN2_HI = 6.93145751953125e-1, LN2_LO = 1.42860682030941723212e-6;
+    static constexpr f64 MAX_LOG = 7.09782712893383996843e2, MIN_LOG = -7.08396418532264106224e2;
+    static constexpr f64 EXP_P[] = {1.26177193074810590878e-4, 3.02994407707441961300e-2, 9.99999999999999999910e-1};
+    static constexpr f64 EXP_Q[] = {3.00198505138664455042e-6, 2.52448340349684104192e-3, 2.27265548208155028766e-1, 2.00000000000000000009e0};
+
+    static constexpr f64 SQRT_HALF = 0.70710678118654752440;
+    static constexpr f64 LOG_P[] = {1.01875663804580931796e-4, 4.97494994976747001425e-1, 4.70579119878881725854e0,
+                                    1.44989225341610930846e1, 1.79368678507819816313e1, 7.70838733755885391666e0};
+    static constexpr f64 LOG_Q[] = {1, 1.12873587189167450590e1, 4.52279145837532221105e1, 8.29875266912776603211e1,
+                                    7.11544750618563894466e1, 2.31251620126765340583e1};
+    static constexpr f64 LOG_LN2_HI = 0.693359375, LOG_LN2_LO = -2.121944400546905827679e-4;
+
+    static constexpr f64 PI = 3.14159265358979323846, PIO2 = 1.57079632679489661923, PIO4 = 0.785398163397448309616;
+    static constexpr f64 PI_LO = 1.2246467991473532e-16, PIO2_LO = 6.123233995736766e-17;
+    static constexpr f64 ATAN_REDUCE = 1.51515151515151515;  // 1 / 0.66
+    static constexpr f64 ATAN_P[] = {-8.750608600031904122785e-1, -1.615753718733365076637e1, -7.500855792314704667340e1,
+                                     -1.228866684490136173410e2, -6.485021904942025371773e1};
+    static constexpr f64 ATAN_Q[] = {1, 2.485846490142306297962e1, 1.650270098316988542046e2, 4.328810604912902668951e2,
+                                     4.853903996359136964868e2, 1.945506571482613964425e2};
+};
+
+//
+// Lanes: a register type V and the operations the kernels need. Masks are V with all bits set or clear.
+//
+
+#if ARCH == X86
+struct simd_math_f32x4 {
+    using T = f32;
+    using V = __m128;
+    static constexpr s64 WIDTH = 4;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 11;
+
+    static always_inline V load(const f32 *p) { return _mm_loadu_ps(p); }
+    static always_inline void store(f32 *p, V v) { _mm_storeu_ps(p, v); }
+    static always_inline V spread(f32 v) { return _mm_set1_ps(v); }
+    static always_inline V spread_bits(u32 v) { return _mm_castsi128_ps(_mm_set1_epi32((s32) v)); }
+
+    static always_inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    static always_inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static always_inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static always_inline V div(V a, V b) { return _mm_div_ps(a, b); }
+    static always_inline V mul_add(V a, V b, V c) {
+#if X86_FMA
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+    static always_inline V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static always_inline V rsqrt_estimate(V a) { return _mm_rsqrt_ps(a); }
+    static always_inline V min(V a, V b) { return _mm_min_ps(a, b); }
+    static always_inline V max(V a, V b) { return _mm_max_ps(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return _mm_and_ps(a, b); }
+    static always_inline V bit_or(V a, V b) { return _mm_or_ps(a, b); }
+    static always_inline V bit_xor(V a, V b) { return _mm_xor_ps(a, b); }
+    static always_inline V and_not(V a, V b) { return _mm_andnot_ps(a, b); }  // ~a & b
+
+    static always_inline V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static always_inline V le(V a, V b) { return _mm_cmple_ps(a, b); }
+    static always_inline V eq(V a, V b) { return _mm_cmpeq_ps(a, b); }
+    static always_inline V unordered(V a, V b) { return _mm_cmpunord_ps(a, b); }
+
+    // mask ? a : b
+    static always_inline V select(V mask, V a, V b) {
+#if X86_SSE4_1
+        return _mm_blendv_ps(b, a, mask);
+#else
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+#endif
+    }
+
+    static always_inline V shift_left_mantissa(V a) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_castps_si128(a), 23)); }
+    static always_inline V shift_right_mantissa(V a) { return _mm_castsi128_ps(_mm_srli_epi32(_mm_castps_si128(a), 23)); }
+
+    // All ones where (bits of a) & bit is set
+    static always_inline V test_bit(V a, u32 bit) {
+        __m128i b = _mm_set1_epi32((s32) bit);
+        return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_castps_si128(a), b), b));
+    }
+};
+
+struct simd_math_f64x2 {
+    using T = f64;
+    using V = __m128d;
+    static constexpr s64 WIDTH = 2;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 11;
+
+    static always_inline V load(const f64 *p) { return _mm_loadu_pd(p); }
+    static always_inline void store(f64 *p, V v) { _mm_storeu_pd(p, v); }
+    static always_inline V spread(f64 v) { return _mm_set1_pd(v); }
+    static always_inline V spread_bits(u64 v) { return _mm_castsi128_pd(_mm_set1_epi64x((s64) v)); }
+
+    static always_inline V add(V a, V b) { return _mm_add_pd(a, b); }
+    static always_inline V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static always_inline V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static always_inline V div(V a, V b) { return _mm_div_pd(a, b); }
+    static always_inline V mul_add(V a, V b, V c) {
+#if X86_FMA
+        return _mm_fmadd_pd(a, b, c);
+#else
+        return _mm_add_pd(_mm_mul_pd(a, b), c);
+#endif
+    }
+    static always_inline V sqrt(V a) { return _mm_sqrt_pd(a); }
+    static always_inline V rsqrt_estimate(V a) { return _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(a))); }
+    static always_inline V min(V a, V b) { return _mm_min_pd(a, b); }
+    static always_inline V max(V a, V b) { return _mm_max_pd(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return _mm_and_pd(a, b); }
+    static always_inline V bit_or(V a, V b) { return _mm_or_pd(a, b); }
+    static always_inline V bit_xor(V a, V b) { return _mm_xor_pd(a, b); }
+    static always_inline V and_not(V a, V b) { return _mm_andnot_pd(a, b); }
+
+    static always_inline V lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static always_inline V le(V a, V b) { return _mm_cmple_pd(a, b); }
+    static always_inline V eq(V a, V b) { return _mm_cmpeq_pd(a, b); }
+    static always_inline V unordered(V a, V b) { return _mm_cmpunord_pd(a, b); }
+
+    static always_inline V select(V mask, V a, V b) {
+#if X86_SSE4_1
+        return _mm_blendv_pd(b, a, mask);
+#else
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+#endif
+    }
+
+    static always_inline V shift_left_mantissa(V a) { return _mm_castsi128_pd(_mm_slli_epi64(_mm_castpd_si128(a), 52)); }
+    static always_inline V shift_right_mantissa(V a) { return _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(a), 52)); }
+
+    // _bit_ is in the low half of each lane, so we compare 32 bit halves (SSE2 has no 64 bit compare)
+    // and copy the result of the low half to the high half
+    static always_inline V test_bit(V a, u32 bit) {
+        __m128i b = _mm_set1_epi64x(bit);
+        __m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_castpd_si128(a), b), b);
+        return _mm_castsi128_pd(_mm_shuffle_epi32(m, _MM_SHUFFLE(2, 2, 0, 0)));
+    }
+};
+
+#if X86_AVX
+// Without AVX2 there are no 256 bit integer instructions, then the bit shifts and tests are done on the two halves
+struct simd_math_f32x8 {
+    using T = f32;
+    using V = __m256;
+    using Half = simd_math_f32x4;
+    static constexpr s64 WIDTH = 8;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 11;
+
+    static always_inline V load(const f32 *p) { return _mm256_loadu_ps(p); }
+    static always_inline void store(f32 *p, V v) { _mm256_storeu_ps(p, v); }
+    static always_inline V spread(f32 v) { return _mm256_set1_ps(v); }
+    static always_inline V spread_bits(u32 v) { return _mm256_castsi256_ps(_mm256_set1_epi32((s32) v)); }
+
+    static always_inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static always_inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static always_inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static always_inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static always_inline V mul_add(V a, V b, V c) {
+#if X86_FMA
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+    static always_inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static always_inline V rsqrt_estimate(V a) { return _mm256_rsqrt_ps(a); }
+    static always_inline V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static always_inline V max(V a, V b) { return _mm256_max_ps(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return _mm256_and_ps(a, b); }
+    static always_inline V bit_or(V a, V b) { return _mm256_or_ps(a, b); }
+    static always_inline V bit_xor(V a, V b) { return _mm256_xor_ps(a, b); }
+    static always_inline V and_not(V a, V b) { return _mm256_andnot_ps(a, b); }
+
+    static always_inline V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static always_inline V le(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static always_inline V eq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static always_inline V unordered(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+    static always_inline V select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+
+    template <typename F>
+    static always_inline V halves(V a, F f) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(f(_mm256_castps256_ps128(a))), f(_mm256_extractf128_ps(a, 1)), 1);
+    }
+
+#if X86_AVX2
+    static always_inline V shift_left_mantissa(V a) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_castps_si256(a), 23)); }
+    static always_inline V shift_right_mantissa(V a) { return _mm256_castsi256_ps(_mm256_srli_epi32(_mm256_castps_si256(a), 23)); }
+    static always_inline V test_bit(V a, u32 bit) {
+        __m256i b = _mm256_set1_epi32((s32) bit);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_castps_si256(a), b), b));
+    }
+#else
+    static always_inline V shift_left_mantissa(V a) { return halves(a, [](__m128 h) { return Half::shift_left_mantissa(h); }); }
+    static always_inline V shift_right_mantissa(V a) { return halves(a, [](__m128 h) { return Half::shift_right_mantissa(h); }); }
+    static always_inline V test_bit(V a, u32 bit) { return halves(a, [=](__m128 h) { return Half::test_bit(h, bit); }); }
+#endif
+};
+
+struct simd_math_f64x4 {
+    using T = f64;
+    using V = __m256d;
+    using Half = simd_math_f64x2;
+    static constexpr s64 WIDTH = 4;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 11;
+
+    static always_inline V load(const f64 *p) { return _mm256_loadu_pd(p); }
+    static always_inline void store(f64 *p, V v) { _mm256_storeu_pd(p, v); }
+    static always_inline V spread(f64 v) { return _mm256_set1_pd(v); }
+    static always_inline V spread_bits(u64 v) { return _mm256_castsi256_pd(_mm256_set1_epi64x((s64) v)); }
+
+    static always_inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static always_inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static always_inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static always_inline V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static always_inline V mul_add(V a, V b, V c) {
+#if X86_FMA
+        return _mm256_fmadd_pd(a, b, c);
+#else
+        return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+    }
+    static always_inline V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static always_inline V rsqrt_estimate(V a) { return _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a))); }
+    static always_inline V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static always_inline V max(V a, V b) { return _mm256_max_pd(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return _mm256_and_pd(a, b); }
+    static always_inline V bit_or(V a, V b) { return _mm256_or_pd(a, b); }
+    static always_inline V bit_xor(V a, V b) { return _mm256_xor_pd(a, b); }
+    static always_inline V and_not(V a, V b) { return _mm256_andnot_pd(a, b); }
+
+    static always_inline V lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static always_inline V le(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static always_inline V eq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static always_inline V unordered(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_UNORD_Q); }
+    static always_inline V select(V mask, V a, V b) { return _mm256_blendv_pd(b, a, mask); }
+
+    template <typename F>
+    static always_inline V halves(V a, F f) {
+        return _mm256_insertf128_pd(_mm256_castpd128_pd256(f(_mm256_castpd256_pd128(a))), f(_mm256_extractf128_pd(a, 1)), 1);
+    }
+
+#if X86_AVX2
+    static always_inline V shift_left_mantissa(V a) { return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(a), 52)); }
+    static always_inline V shift_right_mantissa(V a) { return _mm256_castsi256_pd(_mm256_srli_epi64(_mm256_castpd_si256(a), 52)); }
+    static always_inline V test_bit(V a, u32 bit) {
+        __m256i b = _mm256_set1_epi64x(bit);
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_castpd_si256(a), b), b));
+    }
+#else
+    static always_inline V shift_left_mantissa(V a) { return halves(a, [](__m128d h) { return Half::shift_left_mantissa(h); }); }
+    static always_inline V shift_right_mantissa(V a) { return halves(a, [](__m128d h) { return Half::shift_right_mantissa(h); }); }
+    static always_inline V test_bit(V a, u32 bit) { return halves(a, [=](__m128d h) { return Half::test_bit(h, bit); }); }
+#endif
+};
+
+#define SIMD_MATH_WIDE 1
+using simd_math_wide_f32 = simd_math_f32x8;
+using simd_math_wide_f64 = simd_math_f64x4;
+#endif
+
+#define SIMD_MATH_NARROW 1
+using simd_math_narrow_f32 = simd_math_f32x4;
+using simd_math_narrow_f64 = simd_math_f64x2;
+#elif ARCH == ARM && ANY_ARM_NEON
+struct simd_math_f32x4 {
+    using T = f32;
+    using V = float32x4_t;
+    static constexpr s64 WIDTH = 4;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 8;
+
+    static always_inline V bits(uint32x4_t a) { return vreinterpretq_f32_u32(a); }
+    static always_inline uint32x4_t ints(V a) { return vreinterpretq_u32_f32(a); }
+
+    static always_inline V load(const f32 *p) { return vld1q_f32(p); }
+    static always_inline void store(f32 *p, V v) { vst1q_f32(p, v); }
+    static always_inline V spread(f32 v) { return vdupq_n_f32(v); }
+    static always_inline V spread_bits(u32 v) { return bits(vdupq_n_u32(v)); }
+
+    static always_inline V add(V a, V b) { return vaddq_f32(a, b); }
+    static always_inline V sub(V a, V b) { return vsubq_f32(a, b); }
+    static always_inline V mul(V a, V b) { return vmulq_f32(a, b); }
+    static always_inline V div(V a, V b) { return vdivq_f32(a, b); }
+    static always_inline V mul_add(V a, V b, V c) { return vfmaq_f32(c, a, b); }
+    static always_inline V sqrt(V a) { return vsqrtq_f32(a); }
+    static always_inline V rsqrt_estimate(V a) { return vrsqrteq_f32(a); }
+    static always_inline V min(V a, V b) { return vminq_f32(a, b); }
+    static always_inline V max(V a, V b) { return vmaxq_f32(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return bits(vandq_u32(ints(a), ints(b))); }
+    static always_inline V bit_or(V a, V b) { return bits(vorrq_u32(ints(a), ints(b))); }
+    static always_inline V bit_xor(V a, V b) { return bits(veorq_u32(ints(a), ints(b))); }
+    static always_inline V and_not(V a, V b) { return bits(vbicq_u32(ints(b), ints(a))); }
+
+    static always_inline V lt(V a, V b) { return bits(vcltq_f32(a, b)); }
+    static always_inline V le(V a, V b) { return bits(vcleq_f32(a, b)); }
+    static always_inline V eq(V a, V b) { return bits(vceqq_f32(a, b)); }
+    static always_inline V unordered(V a, V b) { return bits(vmvnq_u32(vandq_u32(vceqq_f32(a, a), vceqq_f32(b, b)))); }
+    static always_inline V select(V mask, V a, V b) { return vbslq_f32(ints(mask), a, b); }
+
+    static always_inline V shift_left_mantissa(V a) { return bits(vshlq_n_u32(ints(a), 23)); }
+    static always_inline V shift_right_mantissa(V a) { return bits(vshrq_n_u32(ints(a), 23)); }
+    static always_inline V test_bit(V a, u32 bit) { return bits(vtstq_u32(ints(a), vdupq_n_u32(bit))); }
+};
+
+struct simd_math_f64x2 {
+    using T = f64;
+    using V = float64x2_t;
+    static constexpr s64 WIDTH = 2;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 8;
+
+    static always_inline V bits(uint64x2_t a) { return vreinterpretq_f64_u64(a); }
+    static always_inline uint64x2_t ints(V a) { return vreinterpretq_u64_f64(a); }
+
+    static always_inline V load(const f64 *p) { return vld1q_f64(p); }
+    static always_inline void store(f64 *p, V v) { vst1q_f64(p, v); }
+    static always_inline V spread(f64 v) { return vdupq_n_f64(v); }
+    static always_inline V spread_bits(u64 v) { return bits(vdupq_n_u64(v)); }
+
+    static always_inline V add(V a, V b) { return vaddq_f64(a, b); }
+    static always_inline V sub(V a, V b) { return vsubq_f64(a, b); }
+    static always_inline V mul(V a, V b) { return vmulq_f64(a, b); }
+    static always_inline V div(V a, V b) { return vdivq_f64(a, b); }
+    static always_inline V mul_add(V a, V b, V c) { return vfmaq_f64(c, a, b); }
+    static always_inline V sqrt(V a) { return vsqrtq_f64(a); }
+    static always_inline V rsqrt_estimate(V a) { return vrsqrteq_f64(a); }
+    static always_inline V min(V a, V b) { return vminq_f64(a, b); }
+    static always_inline V max(V a, V b) { return vmaxq_f64(a, b); }
+
+    static always_inline V bit_and(V a, V b) { return bits(vandq_u64(ints(a), ints(b))); }
+    static always_inline V bit_or(V a, V b) { return bits(vorrq_u64(ints(a), ints(b))); }
+    static always_inline V bit_xor(V a, V b) { return bits(veorq_u64(ints(a), ints(b))); }
+    static always_inline V and_not(V a, V b) { return bits(vbicq_u64(ints(b), ints(a))); }
+
+    static always_inline V lt(V a, V b) { return bits(vcltq_f64(a, b)); }
+    static always_inline V le(V a, V b) { return bits(vcleq_f64(a, b)); }
+    static always_inline V eq(V a, V b) { return bits(vceqq_f64(a, b)); }
+    static always_inline V unordered(V a, V b) {
+        uint64x2_t ordered = vandq_u64(vceqq_f64(a, a), vceqq_f64(b, b));
+        return bits(veorq_u64(ordered, vdupq_n_u64(~0ull)));
+    }
+    static always_inline V select(V mask, V a, V b) { return vbslq_f64(ints(mask), a, b); }
+
+    static always_inline V shift_left_mantissa(V a) { return bits(vshlq_n_u64(ints(a), 52)); }
+    static always_inline V shift_right_mantissa(V a) { return bits(vshrq_n_u64(ints(a), 52)); }
+    static always_inline V test_bit(V a, u32 bit) { return bits(vtstq_u64(ints(a), vdupq_n_u64(bit))); }
+};
+
+#define SIMD_MATH_NARROW 1
+using simd_math_narrow_f32 = simd_math_f32x4;
+using simd_math_narrow_f64 = simd_math_f64x2;
+#endif
+
+#if !defined SIMD_MATH_WIDE
+#define SIMD_MATH_WIDE 0
+#endif
+
+#if !defined SIMD_MATH_NARROW
+#define SIMD_MATH_NARROW 0
+
+// One element at a time, masks are all bits set or clear like in the SIMD lanes
+template <typename T_>
+struct simd_math_scalar {
+    using T = T_;
+    using V = T_;
+    using U = typename simd_math_constants<T>::U;
+    static constexpr s64 WIDTH = 1;
+    static constexpr s64 RSQRT_ESTIMATE_BITS = 60;  // The estimate is exact
+
+    static always_inline U ints(V a) { return bit_cast<U>(a); }
+    static always_inline V bits(U a) { return bit_cast<V>(a); }
+    static always_inline V mask(bool b) { return bits(b ? ~(U) 0 : 0); }
+
+    static always_inline V load(const T *p) { return *p; }
+    static always_inline void store(T *p, V v) { *p = v; }
+    static always_inline V spread(T v) { return v; }
+    static always_inline V spread_bits(U v) { return bits(v); }
+
+    static always_inline V add(V a, V b) { return a + b; }
+    static always_inline V sub(V a, V b) { return a - b; }
+    static always_inline V mul(V a, V b) { return a * b; }
+    static always_inline V div(V a, V b) { return a / b; }
+    static always_inline V mul_add(V a, V b, V c) { return a * b + c; }
+    static always_inline V sqrt(V a) { return (T) ::sqrt(a); }
+    static always_inline V rsqrt_estimate(V a) { return 1 / (T) ::sqrt(a); }
+    static always_inline V min(V a, V b) { return a < b ? a : b; }
+    static always_inline V max(V a, V b) { return a > b ? a : b; }
+
+    static always_inline V bit_and(V a, V b) { return bits(ints(a) & ints(b)); }
+    static always_inline V bit_or(V a, V b) { return bits(ints(a) | ints(b)); }
+    static always_inline V bit_xor(V a, V b) { return bits(ints(a) ^ ints(b)); }
+    static always_inline V and_not(V a, V b) { return bits(~ints(a) & ints(b)); }
+
+    static always_inline V lt(V a, V b) { return mask(a < b); }
+    static always_inline V le(V a, V b) { return mask(a <= b); }
+    static always_inline V eq(V a, V b) { return mask(a == b); }
+    static always_inline V unordered(V a, V b) { return mask(a != a || b != b); }
+    static always_inline V select(V m, V a, V b) { return ints(m) ? a : b; }
+
+    static always_inline V shift_left_mantissa(V a) { return bits(ints(a) << simd_math_constants<T>::MANTISSA_BITS); }
+    static always_inline V shift_right_mantissa(V a) { return bits(ints(a) >> simd_math_constants<T>::MANTISSA_BITS); }
+    static always_inline V test_bit(V a, u32 bit) { return mask(ints(a) & bit); }
+};
+
+using simd_math_narrow_f32 = simd_math_scalar<f32>;
+using simd_math_narrow_f64 = simd_math_scalar<f64>;
+#endif
+
+//
+// The kernels, written once for every lane
+//
+
+// Horner's scheme, the coefficients go from the highest power down
+template <typename L, s64 N>
+always_inline typename L::V simd_math_poly(typename L::V x, const typename L::T (&c)[N]) {
+    auto r = L::spread(c[0]);
+    For(range(1, N)) r = L::mul_add(r, x, L::spread(c[it]));
+    return r;
+}
+
+template <typename L>
+always_inline typename L::V simd_math_sign(typename L::V x) {
+    return L::bit_and(x, L::spread_bits(simd_math_constants<typename L::T>::SIGN_MASK));
+}
+
+template <typename L>
+always_inline typename L::V simd_math_abs(typename L::V x) {
+    return L::and_not(L::spread_bits(simd_math_constants<typename L::T>::SIGN_MASK), x);
+}
+
+// 2^n for integer n in the normal range: n + 2^MANTISSA_BITS + BIAS has n + BIAS in the low bits of its mantissa,
+// shifting it left puts them in the exponent
+template <typename L>
+always_inline typename L::V simd_math_pow2i(typename L::V n) {
+    using C = simd_math_constants<typename L::T>;
+    return L::shift_left_mantissa(L::add(n, L::spread(C::POW2_MAGIC + C::EXPONENT_BIAS)));
+}
+
+// Splits positive, finite _x_ into a mantissa in [0.5, 1) and an exponent
+template <typename L>
+always_inline typename L::V simd_math_split(typename L::V x, typename L::V *e) {
+    using C = simd_math_constants<typename L::T>;
+
+    // The exponent field ORed into the mantissa of 2^MANTISSA_BITS, minus that is the field as a float
+    auto field = L::bit_or(L::shift_right_mantissa(x), L::spread(C::POW2_MAGIC));
+    *e = L::sub(L::sub(field, L::spread(C::POW2_MAGIC)), L::spread(C::EXPONENT_BIAS - 1));
+    return L::bit_or(L::bit_and(x, L::spread_bits(C::MANTISSA_MASK)), L::spread((typename L::T) 0.5));
+}
+
+// Reduces to r in [-PI/4, PI/4], x = j * PI/2 + r. _q_ gets j + ROUND, whose low bits are the quadrant.
+template <typename L, bool Fast>
+always_inline typename L::V simd_math_reduce_pio2(typename L::V x, typename L::V *q) {
+    using C = simd_math_constants<typename L::T>;
+
+    *q = L::mul_add(x, L::spread(C::TWO_OVER_PI), L::spread(C::ROUND));
+    auto j = L::sub(*q, L::spread(C::ROUND));
+
+    auto r = L::mul_add(j, L::spread(-C::PIO2_1), x);
+    r = L::mul_add(j, L::spread(-C::PIO2_2), r);
+    if constexpr (!Fast) r = L::mul_add(j, L::spread(-C::PIO2_3), r);
+    return r;
+}
+
+template <typename L, bool Fast>
+always_inline void simd_math_sincos_reduced(typename L::V r, typename L::V *s, typename L::V *c) {
+    using T = typename L::T;
+    using C = simd_math_constants<T>;
+
+    auto z = L::mul(r, r);
+    if constexpr (Fast) {
+        // Taylor to r^5 and r^6
+        constexpr T SIN_FAST[] = {T(1) / 120, T(-1) / 6};
+        constexpr T COS_FAST[] = {T(-1) / 720, T(1) / 24, T(-1) / 2};
+        *s = L::mul_add(L::mul(r, z), simd_math_poly<L>(z, SIN_FAST), r);
+        *c = L::mul_add(z, simd_math_poly<L>(z, COS_FAST), L::spread(1));
+    } else {
+        *s = L::mul_add(L::mul(r, z), simd_math_poly<L>(z, C::SIN), r);
+        *c = L::mul_add(L::mul(z, z), simd_math_poly<L>(z, C::COS), L::mul_add(z, L::spread((T) -0.5), L::spread(1)));
+    }
+}
+
+template <typename L, bool Fast>
+always_inline void simd_math_sincos(typename L::V x, typename L::V *sinOut, typename L::V *cosOut) {
+    using T = typename L::T;
+
+    typename L::V q, s, c;
+    auto r = simd_math_reduce_pio2<L, Fast>(x, &q);
+    simd_math_sincos_reduced<L, Fast>(r, &s, &c);
+
+    // Quadrant:  0     1     2     3
+    //     sin:   s     c    -s    -c
+    //     cos:   c    -s    -c     s
+    auto odd = L::test_bit(q, 1), two = L::test_bit(q, 2);
+    auto negativeZero = L::spread((T) -0.0);
+    if (sinOut) *sinOut = L::bit_xor(L::select(odd, c, s), L::bit_and(two, negativeZero));
+    if (cosOut) *cosOut = L::bit_xor(L::select(odd, s, c), L::bit_and(L::bit_xor(odd, two), negativeZero));
+}
+
+template <typename L, bool Fast>
+always_inline typename L::V simd_math_exp(typename L::V x) {
+    using T = typename L::T;
+    using C = simd_math_constants<T>;
+
+    auto clamped = L::min(L::max(x, L::spread(C::MIN_LOG)), L::spread(C::MAX_LOG));
+
+    auto q = L::mul_add(clamped, L::spread(C::LOG2E), L::spread(C::ROUND));
+    auto n = L::sub(q, L::spread(C::ROUND));
+    auto r = L::mul_add(n, L::spread(-C::LN2_HI), clamped);
+    r = L::mul_add(n, L::spread(-C::LN2_LO), r);
+
+    typename L::V p;
+    if constexpr (Fast) {
+        constexpr T EXP_FAST[] = {T(1) / 24, T(1) / 6, T(1) / 2, 1, 1};
+        p = simd_math_poly<L>(r, EXP_FAST);
+    } else if constexpr (sizeof(T) == 4) {
+        p = L::mul_add(L::mul(r, r), simd_math_poly<L>(r, C::EXP), L::add(r, L::spread(1)));
+    } else {
+        // 1 + 2r P(r^2) / (Q(r^2) - r P(r^2))
+        auto rr = L::mul(r, r);
+        auto px = L::mul(r, simd_math_poly<L>(rr, C::EXP_P));
+        p = L::mul_add(L::spread(2), L::div(px, L::sub(simd_math_poly<L>(rr, C::EXP_Q), px)), L::spread(1));
+    }
+
+    // n goes up to 2^(MANTISSA_BITS...) + 1 at the top of the range, one past the largest exponent,
+    // so positive n scale by 2 * 2^(n - 1)
+    auto positive = L::lt(L::spread(0), n);
+    auto one = L::spread(1);
+    p = L::mul(p, L::select(positive, L::spread(2), one));
+    auto result = L::mul(p, simd_math_pow2i<L>(L::sub(n, L::bit_and(positive, one))));
+
+    if constexpr (!Fast) {
+        result = L::select(L::lt(L::spread(C::MAX_LOG), x), L::spread(numeric_info<T>::infinity()), result);
+        result = L::select(L::lt(x, L::spread(C::MIN_LOG)), L::spread(0), result);
+        result = L::select(L::unordered(x, x), x, result);
+    }
+    return result;
+}
+
+template <typename L, bool Fast>
+always_inline typename L::V simd_math_log(typename L::V x) {
+    using T = typename L::T;
+    using C = simd_math_constants<T>;
+
+    auto in = x;
+    typename L::V scaleBits = L::spread(0);
+    if constexpr (!Fast) {
+        // Denormals have no implicit leading one, scale them into the normal range first
+        auto denormal = L::lt(x, L::spread(C::MIN_NORMAL));
+        x = L::select(denormal, L::mul(x, L::spread(C::DENORMAL_SCALE)), x);
+        scaleBits = L::bit_and(denormal, L::spread(C::DENORMAL_SCALE_BITS));
+    }
+
+    typename L::V e;
+    auto m = simd_math_split<L>(x, &e);
+    e = L::sub(e, scaleBits);
+
+    // m in [sqrt(0.5), sqrt(2))
+    auto small = L::lt(m, L::spread(C::SQRT_HALF));
+    e = L::sub(e, L::bit_and(small, L::spread(1)));
+    m = L::add(m, L::bit_and(small, m));
+
+    typename L::V result;
+    if constexpr (Fast) {
+        // 2 atanh((m - 1) / (m + 1)) to the fifth power
+        auto f = L::div(L::sub(m, L::spread(1)), L::add(m, L::spread(1)));
+        auto ff = L::mul(f, f);
+        constexpr T LOG_FAST[] = {T(2) / 5, T(2) / 3, 2};
+        result = L::mul_add(e, L::spread((T) 0.693147180559945309), L::mul(f, simd_math_poly<L>(ff, LOG_FAST)));
+    } else {
+        auto f = L::sub(m, L::spread(1));
+        auto z = L::mul(f, f);
+
+        typename L::V y;
+        if constexpr (sizeof(T) == 4) {
+            y = L::mul(L::mul(f, z), simd_math_poly<L>(f, C::LOG));
+            y = L::mul_add(e, L::spread(C::LN2_LO), y);
+        } else {
+            y = L::mul(f, L::div(L::mul(z, simd_math_poly<L>(f, C::LOG_P)), simd_math_poly<L>(f, C::LOG_Q)));
+            y = L::mul_add(e, L::spread(C::LOG_LN2_LO), y);
+        }
+        y = L::mul_add(z, L::spread((T) -0.5), y);
+        result = L::add(f, y);
+
+        if constexpr (sizeof(T) == 4) {
+            result = L::mul_add(e, L::spread(C::LN2_HI), result);
+        } else {
+            result = L::mul_add(e, L::spread(C::LOG_LN2_HI), result);
+        }
+
+        T inf = numeric_info<T>::infinity();
+        result = L::select(L::eq(in, L::spread(0)), L::spread(-inf), result);
+        result = L::select(L::eq(in, L::spread(inf)), in, result);
+        result = L::select(L::bit_or(L::lt(in, L::spread(0)), L::unordered(in, in)), L::spread(numeric_info<T>::quiet_NaN()), result);
+    }
+    return result;
+}
+
+template <typename L, bool Fast>
+always_inline typename L::V simd_math_atan2(typename L::V y, typename L::V x) {
+    using T = typename L::T;
+    using C = simd_math_constants<T>;
+
+    auto ax = simd_math_abs<L>(x), ay = simd_math_abs<L>(y);
+    auto swap = L::lt(ax, ay);
+    auto num = L::min(ax, ay), den = L::max(ax, ay);
+
+    // atan2(0, 0) is 0 (or PI), atan2(inf, inf) is PI/4: make the ratio 0 and 1
+    auto bothInf = L::eq(num, L::spread(numeric_info<T>::infinity()));
+    num = L::select(bothInf, L::spread(1), num);
+    den = L::select(L::bit_or(bothInf, L::eq(den, L::spread(0))), L::spread(1), den);
+
+    // The sign bit, so that atan2(0, -0) is PI
+    auto negativeX = L::lt(L::bit_or(simd_math_sign<L>(x), L::spread(1)), L::spread(0));
+
+    typename L::V r;
+    if constexpr (Fast) {
+        // atan(a) ~ PI/4 a - a (a - 1) (0.2447 + 0.0663 a) for a in [0, 1]
+        auto a = L::div(num, den);
+        auto t = L::mul_add(a, L::spread((T) 0.0663), L::spread((T) 0.2447));
+        r = L::sub(L::mul(L::spread(C::PIO4), a), L::mul(L::mul(a, L::sub(a, L::spread(1))), t));
+        r = L::select(swap, L::sub(L::spread(C::PIO2), r), r);
+        r = L::select(negativeX, L::sub(L::spread(C::PI), r), r);
+    } else {
+        // A ratio above the reduction point becomes (a - 1) / (a + 1), whose atan is atan(a) - PI/4.
+        // Scaling _num_ up rather than _den_ down doesn't lose the comparison to denormals (and overflowing is still right).
+        auto big = L::lt(den, L::mul(num, L::spread(C::ATAN_REDUCE)));
+        auto a = L::div(L::select(big, L::sub(num, den), num), L::select(big, L::add(num, den), den));
+
+        auto z = L::mul(a, a);
+        typename L::V poly;
+        if constexpr (sizeof(T) == 4) {
+            poly = L::mul(z, simd_math_poly<L>(z, C::ATAN));
+        } else {
+            poly = L::div(L::mul(z, simd_math_poly<L>(z, C::ATAN_P)), simd_math_poly<L>(z, C::ATAN_Q));
+        }
+        r = L::mul_add(a, poly, a);
+
+        // The low parts of PI/4, PI/2 and PI are added before the high ones so their bits don't get rounded away
+        r = L::add(L::bit_and(big, L::spread(C::PIO4)), L::add(r, L::bit_and(big, L::spread(C::PIO2_LO * (T) 0.5))));
+        r = L::select(swap, L::add(L::sub(L::spread(C::PIO2), r), L::spread(C::PIO2_LO)), r);
+        r = L::select(negativeX, L::add(L::sub(L::spread(C::PI), r), L::spread(C::PI_LO)), r);
+    }
+
+    r = L::bit_or(r, simd_math_sign<L>(y));
+    return L::select(L::unordered(x, y), L::add(x, y), r);
+}
+
+template <typename L, bool Fast>
+always_inline typename L::V simd_math_rsqrt(typename L::V x) {
+    using T = typename L::T;
+
+    if constexpr (!Fast) {
+        return L::div(L::spread(1), L::sqrt(x));
+    } else {
+        // Newton: r' = r (1.5 - 0.5 x r^2), every step doubles the correct bits
+        auto r = L::rsqrt_estimate(x);
+        auto half = L::mul(x, L::spread((T) 0.5));
+        for (s64 bits = L::RSQRT_ESTIMATE_BITS; bits < 22; bits *= 2) {
+            r = L::mul(r, L::mul_add(L::mul(half, r), L::mul(r, L::spread(-1)), L::spread((T) 1.5)));
+        }
+        return r;
+    }
+}
+
+//
+// Runs a kernel over _Count_ elements, in wide lanes while they fit and narrow ones after that.
+// The last narrow lane is padded with zeroes.
+//
+template <typename T>
+struct simd_math_lanes;
+
+template <>
+struct simd_math_lanes<f32> {
+#if SIMD_MATH_WIDE
+    using Wide = simd_math_wide_f32;
+#endif
+    using Narrow = simd_math_narrow_f32;
+};
+
+template <>
+struct simd_math_lanes<f64> {
+#if SIMD_MATH_WIDE
+    using Wide = simd_math_wide_f64;
+#endif
+    using Narrow = simd_math_narrow_f64;
+};
+
+// _op.template run<L>(in, out)_ reads the inputs and writes the outputs of one lane
+template <s64 Inputs, s64 Outputs, typename T, typename Op>
+always_inline void simd_math_run(const T *const *in, T *const *out, s64 count, Op op) {
+    s64 i = 0;
+
+#if SIMD_MATH_WIDE
+    using W = typename simd_math_lanes<T>::Wide;
+    for (; i + W::WIDTH <= count; i += W::WIDTH) {
+        typename W::V a[Inputs], r[Outputs];
+        For_as(k, range(Inputs)) a[k] = W::load(in[k] + i);
+        op.template run<W>(a, r);
+        For_as(k, range(Outputs)) W::store(out[k] + i, r[k]);
+    }
+#endif
+
+    using N = typename simd_math_lanes<T>::Narrow;
+    for (; i < count; i += N::WIDTH) {
+        typename N::V a[Inputs], r[Outputs];
+        if (i + N::WIDTH <= count) {
+            For_as(k, range(Inputs)) a[k] = N::load(in[k] + i);
+            op.template run<N>(a, r);
+            For_as(k, range(Outputs)) N::store(out[k] + i, r[k]);
+        } else {
+            T padded[N::WIDTH] = {};
+            For_as(k, range(Inputs)) {
+                For_as(j, range(count - i)) padded[j] = in[k][i + j];
+                a[k] = N::load(padded);
+            }
+            op.template run<N>(a, r);
+            For_as(k, range(Outputs)) {
+                N::store(padded, r[k]);
+                For_as(j, range(count - i)) out[k][i + j] = padded[j];
+            }
+        }
+    }
+}
+
+template <bool Fast>
+struct simd_math_sin_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { simd_math_sincos<L, Fast>(a[0], r, null); }
+};
+
+template <bool Fast>
+struct simd_math_cos_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { simd_math_sincos<L, Fast>(a[0], null, r); }
+};
+
+template <bool Fast>
+struct simd_math_sincos_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { simd_math_sincos<L, Fast>(a[0], r, r + 1); }
+};
+
+template <bool Fast>
+struct simd_math_exp_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { r[0] = simd_math_exp<L, Fast>(a[0]); }
+};
+
+template <bool Fast>
+struct simd_math_log_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { r[0] = simd_math_log<L, Fast>(a[0]); }
+};
+
+template <bool Fast>
+struct simd_math_atan2_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { r[0] = simd_math_atan2<L, Fast>(a[0], a[1]); }
+};
+
+template <bool Fast>
+struct simd_math_rsqrt_op {
+    template <typename L>
+    always_inline void run(const typename L::V *a, typename L::V *r) { r[0] = simd_math_rsqrt<L, Fast>(a[0]); }
+};
+
+template <typename T>
+concept simd_math_scalar_type = types::is_same<T, f32> || types::is_same<T, f64>;
+
+// Every simd<> specialization keeps its _Dim_ elements one after another at the start
+template <typename T, s64 Dim>
+always_inline const T *simd_math_elements(const simd<T, Dim> &x) { return (const T *) &x; }
+
+template <typename T, s64 Dim>
+always_inline T *simd_math_elements(simd<T, Dim> &x) { return (T *) &x; }
+}  // namespace impl
+
+#define SIMD_MATH_UNARY(name, op)                                                   \
+    template <impl::simd_math_scalar_type T, s64 Dim>                               \
+    always_inline simd<T, Dim> name(const simd<T, Dim> &x) {                        \
+        simd<T, Dim> result;                                                        \
+        const T *in[] = {impl::simd_math_elements(x)};                              \
+        T *out[] = {impl::simd_math_elements(result)};                              \
+        impl::simd_math_run<1, 1>(in, out, Dim, op{});                              \
+        return result;                                                              \
+    }                                                                               \
+                                                                                    \
+    template <impl::simd_math_scalar_type T>                                        \
+    always_inline T name(T x) {                                                     \
+        T result;                                                                   \
+        const T *in[] = {&x};                                                       \
+        T *out[] = {&result};                                                       \
+        impl::simd_math_run<1, 1>(in, out, 1, op{});                                \
+        return result;                                                              \
+    }
+
+#define SIMD_MATH_SINCOS(name, op)                                                  \
+    template <impl::simd_math_scalar_type T, s64 Dim>                               \
+    always_inline void name(const simd<T, Dim> &x, simd<T, Dim> *s, simd<T, Dim> *c) { \
+        const T *in[] = {impl::simd_math_elements(x)};                              \
+        T *out[] = {impl::simd_math_elements(*s), impl::simd_math_elements(*c)};    \
+        impl::simd_math_run<1, 2>(in, out, Dim, op{});                              \
+    }                                                                               \
+                                                                                    \
+    template <impl::simd_math_scalar_type T>                                        \
+    always_inline void name(T x, T *s, T *c) {                                      \
+        const T *in[] = {&x};                                                       \
+        T *out[] = {s, c};                                                          \
+        impl::simd_math_run<1, 2>(in, out, 1, op{});                                \
+    }
+
+#define SIMD_MATH_ATAN2(name, op)                                                   \
+    template <impl::simd_math_scalar_type T, s64 Dim>                               \
+    always_inline simd<T, Dim> name(const simd<T, Dim> &y, const simd<T, Dim> &x) { \
+        simd<T, Dim> result;                                                        \
+        const T *in[] = {impl::simd_math_elements(y), impl::simd_math_elements(x)}; \
+        T *out[] = {impl::simd_math_elements(result)};                              \
+        impl::simd_math_run<2, 1>(in, out, Dim, op{});                              \
+        return result;                                                              \
+    }                                                                               \
+                                                                                    \
+    template <impl::simd_math_scalar_type T>                                        \
+    always_inline T name(T y, T x) {                                                \
+        T result;                                                                   \
+        const T *in[] = {&y, &x};                                                   \
+        T *out[] = {&result};                                                       \
+        impl::simd_math_run<2, 1>(in, out, 1, op{});                                \
+        return result;                                                              \
+    }
+
+SIMD_MATH_UNARY(simd_sin, impl::simd_math_sin_op<false>)
+SIMD_MATH_UNARY(simd_cos, impl::simd_math_cos_op<false>)
+SIMD_MATH_SINCOS(simd_sincos, impl::simd_math_sincos_op<false>)
+SIMD_MATH_UNARY(simd_exp, impl::simd_math_exp_op<false>)
+SIMD_MATH_UNARY(simd_log, impl::simd_math_log_op<false>)
+SIMD_MATH_ATAN2(simd_atan2, impl::simd_math_atan2_op<false>)
+SIMD_MATH_UNARY(simd_rsqrt, impl::simd_math_rsqrt_op<false>)
+
+SIMD_MATH_UNARY(simd_sin_fast, impl::simd_math_sin_op<true>)
+SIMD_MATH_UNARY(simd_cos_fast, impl::simd_math_cos_op<true>)
+SIMD_MATH_SINCOS(simd_sincos_fast, impl::simd_math_sincos_op<true>)
+SIMD_MATH_UNARY(simd_exp_fast, impl::simd_math_exp_op<true>)
+SIMD_MATH_UNARY(simd_log_fast, impl::simd_math_log_op<true>)
+SIMD_MATH_ATAN2(simd_atan2_fast, impl::simd_math_atan2_op<true>)
+SIMD_MATH_UNARY(simd_rsqrt_fast, impl::simd_math_rsqrt_op<true>)
+
+#undef SIMD_MATH_UNARY
+#undef SIMD_MATH_SINCOS
+#undef SIMD_MATH_ATAN2
+
+LSTD_END_NAMESPACE
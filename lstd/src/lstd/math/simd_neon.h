@@ -0,0 +1,393 @@
+#pragma once
+
+#include <arm_neon.h>
+
+#include "../types.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// NEON specializations with the same interface (and layout) as the SSE ones in simd_sse2.h.
+// AArch64 only: we need vdivq, the f64 vectors and the across-lane adds, which 32 bit ARM doesn't have
+// (and we don't target 32 bit platforms anyway, see platform.h).
+//
+// NEON has no shuffle with an immediate, shuffles of 32 bit lanes are a table lookup (TBL) with constant indices.
+//
+
+namespace internal {
+// Bytes for vqtbl1q_u8 which put the 4 byte lanes l0, l1, l2, l3 of the source in lanes 0, 1, 2, 3
+template <s32 l0, s32 l1, s32 l2, s32 l3>
+always_inline uint8x16_t simd_neon_shuffle_bytes() {
+    static constexpr u8 bytes[16] = {l0 * 4, l0 * 4 + 1, l0 * 4 + 2, l0 * 4 + 3, l1 * 4, l1 * 4 + 1, l1 * 4 + 2, l1 * 4 + 3,
+                                     l2 * 4, l2 * 4 + 1, l2 * 4 + 2, l2 * 4 + 3, l3 * 4, l3 * 4 + 1, l3 * 4 + 2, l3 * 4 + 3};
+    return vld1q_u8(bytes);
+}
+
+// All ones in the first _Count_ 32 bit lanes, zeroes after
+template <s32 Count>
+always_inline uint32x4_t simd_neon_first_lanes() {
+    static constexpr u32 mask[4] = {0xFFFFFFFF, Count > 1 ? 0xFFFFFFFF : 0, Count > 2 ? 0xFFFFFFFF : 0, Count > 3 ? 0xFFFFFFFF : 0};
+    return vld1q_u32(mask);
+}
+}  // namespace internal
+
+// Specialization for 4xf32, using NEON
+template <>
+union alignas(16) simd<f32, 4> {
+    float32x4_t reg;
+    f32 v[4];
+
+    static inline simd from(float32x4_t value) {
+        simd r;
+        r.reg = value;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(vmulq_f32(lhs.reg, rhs.reg)); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(vdivq_f32(lhs.reg, rhs.reg)); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_f32(lhs.reg, rhs.reg)); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_f32(lhs.reg, rhs.reg)); }
+
+    static inline simd mul(const simd &lhs, f32 rhs) { return from(vmulq_n_f32(lhs.reg, rhs)); }
+    static inline simd div(const simd &lhs, f32 rhs) { return from(vdivq_f32(lhs.reg, vdupq_n_f32(rhs))); }
+    static inline simd add(const simd &lhs, f32 rhs) { return from(vaddq_f32(lhs.reg, vdupq_n_f32(rhs))); }
+    static inline simd sub(const simd &lhs, f32 rhs) { return from(vsubq_f32(lhs.reg, vdupq_n_f32(rhs))); }
+
+    // a * b + c, fused (a single rounding)
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return from(vfmaq_f32(c.reg, a.reg, b.reg)); }
+
+    static inline simd spread(f32 value) { return from(vdupq_n_f32(value)); }
+
+    static inline simd set(f32 x, f32 y, f32 z, f32 w) {
+        simd r;
+        r.v[0] = x;
+        r.v[1] = y;
+        r.v[2] = z;
+        r.v[3] = w;
+        return r;
+    }
+
+    template <s32 Count>
+    static inline f32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        float32x4_t m = vmulq_f32(lhs.reg, rhs.reg);
+        if constexpr (Count < 4) m = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(m), internal::simd_neon_first_lanes<Count>()));
+        return vaddvq_f32(m);
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+        auto bytes = internal::simd_neon_shuffle_bytes<i3, i2, i1, i0>();
+        return from(vreinterpretq_f32_u8(vqtbl1q_u8(vreinterpretq_u8_f32(arg.reg), bytes)));
+    }
+};
+
+// Specialization for 8xf32, using NEON
+template <>
+union alignas(16) simd<f32, 8> {
+    float32x4_t reg[2];
+    f32 v[8];
+
+    static inline simd from(float32x4_t lo, float32x4_t hi) {
+        simd r;
+        r.reg[0] = lo;
+        r.reg[1] = hi;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(vmulq_f32(lhs.reg[0], rhs.reg[0]), vmulq_f32(lhs.reg[1], rhs.reg[1])); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(vdivq_f32(lhs.reg[0], rhs.reg[0]), vdivq_f32(lhs.reg[1], rhs.reg[1])); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_f32(lhs.reg[0], rhs.reg[0]), vaddq_f32(lhs.reg[1], rhs.reg[1])); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_f32(lhs.reg[0], rhs.reg[0]), vsubq_f32(lhs.reg[1], rhs.reg[1])); }
+
+    static inline simd mul(const simd &lhs, f32 rhs) { return from(vmulq_n_f32(lhs.reg[0], rhs), vmulq_n_f32(lhs.reg[1], rhs)); }
+    static inline simd div(const simd &lhs, f32 rhs) { return div(lhs, spread(rhs)); }
+    static inline simd add(const simd &lhs, f32 rhs) { return add(lhs, spread(rhs)); }
+    static inline simd sub(const simd &lhs, f32 rhs) { return sub(lhs, spread(rhs)); }
+
+    // a * b + c, fused (a single rounding)
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        return from(vfmaq_f32(c.reg[0], a.reg[0], b.reg[0]), vfmaq_f32(c.reg[1], a.reg[1], b.reg[1]));
+    }
+
+    static inline simd spread(f32 value) { return from(vdupq_n_f32(value), vdupq_n_f32(value)); }
+
+    static inline simd set(f32 a, f32 b, f32 c, f32 d, f32 e, f32 f, f32 g, f32 h) {
+        simd r;
+        f32 values[8] = {a, b, c, d, e, f, g, h};
+        for (s32 i = 0; i < 8; ++i) r.v[i] = values[i];
+        return r;
+    }
+
+    template <s32 Count>
+    static inline f32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 8, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        float32x4_t lo = vmulq_f32(lhs.reg[0], rhs.reg[0]);
+        if constexpr (Count < 4) lo = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(lo), internal::simd_neon_first_lanes<Count>()));
+        if constexpr (Count <= 4) return vaddvq_f32(lo);
+
+        float32x4_t hi = vmulq_f32(lhs.reg[1], rhs.reg[1]);
+        if constexpr (Count > 4 && Count < 8) hi = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(hi), internal::simd_neon_first_lanes<(Count > 4 ? Count - 4 : 1)>()));
+        return vaddvq_f32(vaddq_f32(lo, hi));
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3, s32 i4, s32 i5, s32 i6, s32 i7>
+    static inline simd shuffle(const simd &arg) {
+        simd r;
+        r.v[7] = arg.v[i0];
+        r.v[6] = arg.v[i1];
+        r.v[5] = arg.v[i2];
+        r.v[4] = arg.v[i3];
+        r.v[3] = arg.v[i4];
+        r.v[2] = arg.v[i5];
+        r.v[1] = arg.v[i6];
+        r.v[0] = arg.v[i7];
+        return r;
+    }
+};
+
+// Specialization for 2xf64, using NEON
+template <>
+union alignas(16) simd<f64, 2> {
+    float64x2_t reg;
+    f64 v[2];
+
+    static inline simd from(float64x2_t value) {
+        simd r;
+        r.reg = value;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(vmulq_f64(lhs.reg, rhs.reg)); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(vdivq_f64(lhs.reg, rhs.reg)); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_f64(lhs.reg, rhs.reg)); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_f64(lhs.reg, rhs.reg)); }
+
+    static inline simd mul(const simd &lhs, f64 rhs) { return from(vmulq_n_f64(lhs.reg, rhs)); }
+    static inline simd div(const simd &lhs, f64 rhs) { return from(vdivq_f64(lhs.reg, vdupq_n_f64(rhs))); }
+    static inline simd add(const simd &lhs, f64 rhs) { return from(vaddq_f64(lhs.reg, vdupq_n_f64(rhs))); }
+    static inline simd sub(const simd &lhs, f64 rhs) { return from(vsubq_f64(lhs.reg, vdupq_n_f64(rhs))); }
+
+    // a * b + c, fused (a single rounding)
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return from(vfmaq_f64(c.reg, a.reg, b.reg)); }
+
+    static inline simd spread(f64 value) { return from(vdupq_n_f64(value)); }
+
+    static inline simd set(f64 x, f64 y) {
+        simd r;
+        r.v[0] = x;
+        r.v[1] = y;
+        return r;
+    }
+
+    template <s32 Count>
+    static inline f64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 2, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        float64x2_t m = vmulq_f64(lhs.reg, rhs.reg);
+        if constexpr (Count == 1) return vgetq_lane_f64(m, 0);
+        return vaddvq_f64(m);
+    }
+
+    // Same order as the SSE version, lane 1 gets _arg[i0]_ and lane 0 gets _arg[i1]_
+    template <s32 i0, s32 i1>
+    static inline simd shuffle(const simd &arg) {
+        float64x1_t lo = i1 ? vget_high_f64(arg.reg) : vget_low_f64(arg.reg);
+        float64x1_t hi = i0 ? vget_high_f64(arg.reg) : vget_low_f64(arg.reg);
+        return from(vcombine_f64(lo, hi));
+    }
+};
+
+// Specialization for 4xf64, using NEON
+template <>
+union alignas(16) simd<f64, 4> {
+    float64x2_t reg[2];
+    f64 v[4];
+
+    static inline simd from(float64x2_t lo, float64x2_t hi) {
+        simd r;
+        r.reg[0] = lo;
+        r.reg[1] = hi;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(vmulq_f64(lhs.reg[0], rhs.reg[0]), vmulq_f64(lhs.reg[1], rhs.reg[1])); }
+    static inline simd div(const simd &lhs, const simd &rhs) { return from(vdivq_f64(lhs.reg[0], rhs.reg[0]), vdivq_f64(lhs.reg[1], rhs.reg[1])); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_f64(lhs.reg[0], rhs.reg[0]), vaddq_f64(lhs.reg[1], rhs.reg[1])); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_f64(lhs.reg[0], rhs.reg[0]), vsubq_f64(lhs.reg[1], rhs.reg[1])); }
+
+    static inline simd mul(const simd &lhs, f64 rhs) { return from(vmulq_n_f64(lhs.reg[0], rhs), vmulq_n_f64(lhs.reg[1], rhs)); }
+    static inline simd div(const simd &lhs, f64 rhs) { return div(lhs, spread(rhs)); }
+    static inline simd add(const simd &lhs, f64 rhs) { return add(lhs, spread(rhs)); }
+    static inline simd sub(const simd &lhs, f64 rhs) { return sub(lhs, spread(rhs)); }
+
+    // a * b + c, fused (a single rounding)
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        return from(vfmaq_f64(c.reg[0], a.reg[0], b.reg[0]), vfmaq_f64(c.reg[1], a.reg[1], b.reg[1]));
+    }
+
+    static inline simd spread(f64 value) { return from(vdupq_n_f64(value), vdupq_n_f64(value)); }
+
+    static inline simd set(f64 x, f64 y, f64 z, f64 w) {
+        simd r;
+        r.v[0] = x;
+        r.v[1] = y;
+        r.v[2] = z;
+        r.v[3] = w;
+        return r;
+    }
+
+    template <s32 Count>
+    static inline f64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        float64x2_t lo = vmulq_f64(lhs.reg[0], rhs.reg[0]);
+        if constexpr (Count == 1) return vgetq_lane_f64(lo, 0);
+        if constexpr (Count == 2) return vaddvq_f64(lo);
+
+        float64x2_t hi = vmulq_f64(lhs.reg[1], rhs.reg[1]);
+        if constexpr (Count == 3) return vaddvq_f64(lo) + vgetq_lane_f64(hi, 0);
+        return vaddvq_f64(vaddq_f64(lo, hi));
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+        simd r;
+        r.v[3] = arg.v[i0];
+        r.v[2] = arg.v[i1];
+        r.v[1] = arg.v[i2];
+        r.v[0] = arg.v[i3];
+        return r;
+    }
+};
+
+// Specialization for 4xs32, using NEON. Division is per lane.
+template <>
+union alignas(16) simd<s32, 4> {
+    int32x4_t reg;
+    s32 v[4];
+
+    static inline simd from(int32x4_t value) {
+        simd r;
+        r.reg = value;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) { return from(vmulq_s32(lhs.reg, rhs.reg)); }
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_s32(lhs.reg, rhs.reg)); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_s32(lhs.reg, rhs.reg)); }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] / rhs.v[i];
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, s32 rhs) { return from(vmulq_n_s32(lhs.reg, rhs)); }
+    static inline simd add(const simd &lhs, s32 rhs) { return from(vaddq_s32(lhs.reg, vdupq_n_s32(rhs))); }
+    static inline simd sub(const simd &lhs, s32 rhs) { return from(vsubq_s32(lhs.reg, vdupq_n_s32(rhs))); }
+
+    static inline simd div(const simd &lhs, s32 rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] / rhs;
+        return r;
+    }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return from(vmlaq_s32(c.reg, a.reg, b.reg)); }
+
+    static inline simd spread(s32 value) { return from(vdupq_n_s32(value)); }
+
+    static inline simd set(s32 x, s32 y, s32 z, s32 w) {
+        simd r;
+        r.v[0] = x;
+        r.v[1] = y;
+        r.v[2] = z;
+        r.v[3] = w;
+        return r;
+    }
+
+    template <s32 Count>
+    static inline s32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        int32x4_t m = vmulq_s32(lhs.reg, rhs.reg);
+        if constexpr (Count < 4) m = vreinterpretq_s32_u32(vandq_u32(vreinterpretq_u32_s32(m), internal::simd_neon_first_lanes<Count>()));
+        return vaddvq_s32(m);
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+        auto bytes = internal::simd_neon_shuffle_bytes<i3, i2, i1, i0>();
+        return from(vreinterpretq_s32_u8(vqtbl1q_u8(vreinterpretq_u8_s32(arg.reg), bytes)));
+    }
+};
+
+// Specialization for 2xs64, using NEON. Multiplication and division are per lane, NEON has no 64 bit multiply.
+template <>
+union alignas(16) simd<s64, 2> {
+    int64x2_t reg;
+    s64 v[2];
+
+    static inline simd from(int64x2_t value) {
+        simd r;
+        r.reg = value;
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.v[0] = lhs.v[0] * rhs.v[0];
+        r.v[1] = lhs.v[1] * rhs.v[1];
+        return r;
+    }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.v[0] = lhs.v[0] / rhs.v[0];
+        r.v[1] = lhs.v[1] / rhs.v[1];
+        return r;
+    }
+
+    static inline simd add(const simd &lhs, const simd &rhs) { return from(vaddq_s64(lhs.reg, rhs.reg)); }
+    static inline simd sub(const simd &lhs, const simd &rhs) { return from(vsubq_s64(lhs.reg, rhs.reg)); }
+
+    static inline simd mul(const simd &lhs, s64 rhs) { return mul(lhs, spread(rhs)); }
+    static inline simd div(const simd &lhs, s64 rhs) { return div(lhs, spread(rhs)); }
+    static inline simd add(const simd &lhs, s64 rhs) { return from(vaddq_s64(lhs.reg, vdupq_n_s64(rhs))); }
+    static inline simd sub(const simd &lhs, s64 rhs) { return from(vsubq_s64(lhs.reg, vdupq_n_s64(rhs))); }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return add(mul(a, b), c); }
+
+    static inline simd spread(s64 value) { return from(vdupq_n_s64(value)); }
+
+    static inline simd set(s64 x, s64 y) {
+        simd r;
+        r.v[0] = x;
+        r.v[1] = y;
+        return r;
+    }
+
+    template <s32 Count>
+    static inline s64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 2, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+        return Count == 1 ? lhs.v[0] * rhs.v[0] : lhs.v[0] * rhs.v[0] + lhs.v[1] * rhs.v[1];
+    }
+
+    // Same order as simd<f64, 2>
+    template <s32 i0, s32 i1>
+    static inline simd shuffle(const simd &arg) {
+        int64x1_t lo = i1 ? vget_high_s64(arg.reg) : vget_low_s64(arg.reg);
+        int64x1_t hi = i0 ? vget_high_s64(arg.reg) : vget_low_s64(arg.reg);
+        return from(vcombine_s64(lo, hi));
+    }
+};
+
+LSTD_END_NAMESPACE
@@ -2,6 +2,14 @@
 
 #include <emmintrin.h>
 
+#if X86_SSE4_1
+#include <smmintrin.h>  // _mm_mullo_epi32
+#endif
+
+#if X86_FMA
+#include <immintrin.h>
+#endif
+
 #include "../types.h"
 
 LSTD_BEGIN_NAMESPACE
@@ -77,6 +85,17 @@ union alignas(16) simd<f32, 4> {
         return r;
     }
 
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        simd r;
+#if X86_FMA
+        r.reg = _mm_fmadd_ps(a.reg, b.reg, c.reg);
+#else
+        r.reg = _mm_add_ps(_mm_mul_ps(a.reg, b.reg), c.reg);
+#endif
+        return r;
+    }
+
     template <s32 Count>
     static inline f32 dot(const simd &lhs, const simd &rhs) {
         static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
@@ -99,6 +118,8 @@ union alignas(16) simd<f32, 4> {
     }
 };
 
+// With AVX these are in simd_avx.h
+#if !X86_AVX
 // Specialization for 8xf32, using SSE
 template <>
 union alignas(16) simd<f32, 8> {
@@ -179,6 +200,19 @@ union alignas(16) simd<f32, 8> {
         return r;
     }
 
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        simd r;
+#if X86_FMA
+        r.reg[0] = _mm_fmadd_ps(a.reg[0], b.reg[0], c.reg[0]);
+        r.reg[1] = _mm_fmadd_ps(a.reg[1], b.reg[1], c.reg[1]);
+#else
+        r.reg[0] = _mm_add_ps(_mm_mul_ps(a.reg[0], b.reg[0]), c.reg[0]);
+        r.reg[1] = _mm_add_ps(_mm_mul_ps(a.reg[1], b.reg[1]), c.reg[1]);
+#endif
+        return r;
+    }
+
     template <s32 Count>
     static inline f32 dot(const simd &lhs, const simd &rhs) {
         static_assert(Count <= 8, "Number of elements to dot must be smaller or equal to dimension.");
@@ -217,6 +251,8 @@ union alignas(16) simd<f32, 8> {
     }
 };
 
+#endif
+
 // Specialization for 2xf64, using SSE
 template <>
 union alignas(16) simd<f64, 2> {
@@ -287,6 +323,17 @@ union alignas(16) simd<f64, 2> {
         return r;
     }
 
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        simd r;
+#if X86_FMA
+        r.reg = _mm_fmadd_pd(a.reg, b.reg, c.reg);
+#else
+        r.reg = _mm_add_pd(_mm_mul_pd(a.reg, b.reg), c.reg);
+#endif
+        return r;
+    }
+
     template <s32 Count>
     static inline f64 dot(const simd &lhs, const simd &rhs) {
         static_assert(Count <= 2, "Number of elements to dot must be smaller or equal to dimension.");
@@ -308,6 +355,7 @@ union alignas(16) simd<f64, 2> {
     }
 };
 
+#if !X86_AVX
 // Specialization for 4xf64, using SSE
 template <>
 union alignas(16) simd<f64, 4> {
@@ -388,6 +436,19 @@ union alignas(16) simd<f64, 4> {
         return r;
     }
 
+    // a * b + c, with a single rounding if we have FMA
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) {
+        simd r;
+#if X86_FMA
+        r.reg[0] = _mm_fmadd_pd(a.reg[0], b.reg[0], c.reg[0]);
+        r.reg[1] = _mm_fmadd_pd(a.reg[1], b.reg[1], c.reg[1]);
+#else
+        r.reg[0] = _mm_add_pd(_mm_mul_pd(a.reg[0], b.reg[0]), c.reg[0]);
+        r.reg[1] = _mm_add_pd(_mm_mul_pd(a.reg[1], b.reg[1]), c.reg[1]);
+#endif
+        return r;
+    }
+
     template <s32 Count>
     static inline f64 dot(const simd &lhs, const simd &rhs) {
         static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
@@ -417,5 +478,155 @@ union alignas(16) simd<f64, 4> {
         return r;
     }
 };
+#endif
+
+//
+// Integer vectors. There are no SIMD integer divisions, those are done per lane.
+//
+
+// Specialization for 4xs32, using SSE2 (and SSE4.1 for multiplication if available)
+template <>
+union alignas(16) simd<s32, 4> {
+    __m128i reg;
+    s32 v[4];
+
+    static inline simd mul(const simd &lhs, const simd &rhs) {
+        simd r;
+#if X86_SSE4_1
+        r.reg = _mm_mullo_epi32(lhs.reg, rhs.reg);
+#else
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] * rhs.v[i];
+#endif
+        return r;
+    }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] / rhs.v[i];
+        return r;
+    }
+
+    static inline simd add(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.reg = _mm_add_epi32(lhs.reg, rhs.reg);
+        return r;
+    }
+
+    static inline simd sub(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.reg = _mm_sub_epi32(lhs.reg, rhs.reg);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, s32 rhs) { return mul(lhs, spread(rhs)); }
+
+    static inline simd div(const simd &lhs, s32 rhs) {
+        simd r;
+        for (s32 i = 0; i < 4; ++i) r.v[i] = lhs.v[i] / rhs;
+        return r;
+    }
+
+    static inline simd add(const simd &lhs, s32 rhs) { return add(lhs, spread(rhs)); }
+    static inline simd sub(const simd &lhs, s32 rhs) { return sub(lhs, spread(rhs)); }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return add(mul(a, b), c); }
+
+    static inline simd spread(s32 value) {
+        simd r;
+        r.reg = _mm_set1_epi32(value);
+        return r;
+    }
+
+    static inline simd set(s32 x, s32 y, s32 z, s32 w) {
+        simd r;
+        r.reg = _mm_setr_epi32(x, y, z, w);
+        return r;
+    }
+
+    template <s32 Count>
+    static inline s32 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 4, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+
+        simd m = mul(lhs, rhs);
+        s32 sum = m.v[0];
+        for (s32 i = 1; i < Count; ++i) sum += m.v[i];
+        return sum;
+    }
+
+    template <s32 i0, s32 i1, s32 i2, s32 i3>
+    static inline simd shuffle(const simd &arg) {
+        simd r;
+        r.reg = _mm_shuffle_epi32(arg.reg, _MM_SHUFFLE(i0, i1, i2, i3));
+        return r;
+    }
+};
+
+// Specialization for 2xs64, using SSE2. Multiplication is per lane, there is no 64 bit multiply before AVX-512.
+template <>
+union alignas(16) simd<s64, 2> {
+    __m128i reg;
+    s64 v[2];
+
+    static inline simd mul(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.v[0] = lhs.v[0] * rhs.v[0];
+        r.v[1] = lhs.v[1] * rhs.v[1];
+        return r;
+    }
+
+    static inline simd div(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.v[0] = lhs.v[0] / rhs.v[0];
+        r.v[1] = lhs.v[1] / rhs.v[1];
+        return r;
+    }
+
+    static inline simd add(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.reg = _mm_add_epi64(lhs.reg, rhs.reg);
+        return r;
+    }
+
+    static inline simd sub(const simd &lhs, const simd &rhs) {
+        simd r;
+        r.reg = _mm_sub_epi64(lhs.reg, rhs.reg);
+        return r;
+    }
+
+    static inline simd mul(const simd &lhs, s64 rhs) { return mul(lhs, spread(rhs)); }
+    static inline simd div(const simd &lhs, s64 rhs) { return div(lhs, spread(rhs)); }
+    static inline simd add(const simd &lhs, s64 rhs) { return add(lhs, spread(rhs)); }
+    static inline simd sub(const simd &lhs, s64 rhs) { return sub(lhs, spread(rhs)); }
+
+    static inline simd mul_add(const simd &a, const simd &b, const simd &c) { return add(mul(a, b), c); }
+
+    static inline simd spread(s64 value) {
+        simd r;
+        r.reg = _mm_set1_epi64x(value);
+        return r;
+    }
+
+    static inline simd set(s64 x, s64 y) {
+        simd r;
+        r.reg = _mm_set_epi64x(y, x);
+        return r;
+    }
+
+    template <s32 Count>
+    static inline s64 dot(const simd &lhs, const simd &rhs) {
+        static_assert(Count <= 2, "Number of elements to dot must be smaller or equal to dimension.");
+        static_assert(Count > 0, "Count must not be zero.");
+        return Count == 1 ? lhs.v[0] * rhs.v[0] : lhs.v[0] * rhs.v[0] + lhs.v[1] * rhs.v[1];
+    }
+
+    // Same order as simd<f64, 2>, lane 1 gets _arg[i0]_ and lane 0 gets _arg[i1]_
+    template <s32 i0, s32 i1>
+    static inline simd shuffle(const simd &arg) {
+        simd r;
+        r.reg = _mm_shuffle_epi32(arg.reg, _MM_SHUFFLE(i0 * 2 + 1, i0 * 2, i1 * 2 + 1, i1 * 2));
+        return r;
+    }
+};
 
 LSTD_END_NAMESPACE
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "../mat_func.h"
+#include "../quat.h"
+#include "../quat_func.h"
+#include "identity.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A 3D transform without projection - rotation, scale, shear and translation - in 12 numbers instead of the 16 of
+// a mat<T, 4, 4> (48 bytes for f32, a mat4 is 64).
+//
+// It's the same thing as a mat<T, 4, 3>: our vectors are rows, so a point is (x, y, z, 1) * M, the upper 3x3 is the
+// linear part and the translation is in the last row. We keep the matrix by columns though, so each column is
+// one vec<T, 4> (which is a SIMD register for f32 and f64) and the fourth element of column j is the j-th element
+// of the translation. A point is then three 4-wide dot products, and composing two transforms is 9 multiply-adds
+// instead of the 64 multiplies of a 4x4 product.
+//
+//     affine3<f32> local(position, orientation, v3(1));  // Scale, then rotate, then translate
+//     affine3<f32> world = dot(local, parentWorld);      // First _local_, then _parentWorld_, like dot() of matrices
+//
+//     v3 p = dot(v3(0, 1, 0), world);                    // A point (the translation applies)
+//     v3 d = transform_direction(v3(0, 1, 0), world);    // A direction (it doesn't)
+//
+//     m44 gpu = world;                                   // Only when the full matrix is needed
+//
+template <typename T>
+struct affine3 {
+    using ColumnT = vec<T, 4, false>;
+    ColumnT Columns[3];
+
+    // :MathTypesNoInit By default we don't init (to save on performance), assign identity() to start from nothing.
+    affine3() {}
+
+    static constexpr bool NO_INIT_CONSTRUCT = true;  // See vec
+
+    affine3(const identity_helper &) {
+        Columns[0] = ColumnT(1, 0, 0, 0);
+        Columns[1] = ColumnT(0, 1, 0, 0);
+        Columns[2] = ColumnT(0, 0, 1, 0);
+    }
+
+    // Scales by _scale_, then rotates by _rotation_ (which must be normalized), then moves by _translation_
+    template <bool Packed, bool QPacked>
+    affine3(const vec<T, 3, Packed> &translation, const tquat<T, QPacked> &rotation, const vec<T, 3, Packed> &scale) {
+        auto r = (mat<T, 3, 3, false>) rotation;
+        For(range(3)) Columns[it] = ColumnT(scale.x * r(0, it), scale.y * r(1, it), scale.z * r(2, it), translation[it]);
+    }
+
+    // From a matrix with 0, 0, 0, 1 as the last column (the column is ignored)
+    template <typename U, bool Packed>
+    explicit affine3(const mat<U, 4, 4, Packed> &m) {
+        For(range(3)) Columns[it] = ColumnT(T(m(0, it)), T(m(1, it)), T(m(2, it)), T(m(3, it)));
+    }
+
+    template <typename U, bool Packed>
+    explicit affine3(const mat<U, 4, 3, Packed> &m) {
+        For(range(3)) Columns[it] = ColumnT(T(m(0, it)), T(m(1, it)), T(m(2, it)), T(m(3, it)));
+    }
+
+    template <typename U, bool Packed>
+    operator mat<U, 4, 4, Packed>() const {
+        mat<U, 4, 4, Packed> m;
+        For_as(i, range(4)) {
+            For_as(j, range(3)) m(i, j) = U(Columns[j][i]);
+            m(i, 3) = U(i == 3);
+        }
+        return m;
+    }
+
+    template <typename U, bool Packed>
+    operator mat<U, 4, 3, Packed>() const {
+        mat<U, 4, 3, Packed> m;
+        For_as(i, range(4)) { For_as(j, range(3)) m(i, j) = U(Columns[j][i]); }
+        return m;
+    }
+
+    vec<T, 3, false> translation() const { return {Columns[0].w, Columns[1].w, Columns[2].w}; }
+
+    void set_translation(const vec<T, 3, false> &t) {
+        Columns[0].w = t.x;
+        Columns[1].w = t.y;
+        Columns[2].w = t.z;
+    }
+};
+
+using affine32 = affine3<f32>;
+using affine64 = affine3<f64>;
+
+// (p|1)*A, transforms a point
+template <typename T, bool Packed>
+vec<T, 3, Packed> dot(const vec<T, 3, Packed> &p, const affine3<T> &a) {
+    vec<T, 4, false> v(p.x, p.y, p.z, T(1));
+    return {dot(v, a.Columns[0]), dot(v, a.Columns[1]), dot(v, a.Columns[2])};
+}
+
+// (d|0)*A, transforms a direction (the translation doesn't apply)
+template <typename T, bool Packed>
+vec<T, 3, Packed> transform_direction(const vec<T, 3, Packed> &d, const affine3<T> &a) {
+    vec<T, 4, false> v(d.x, d.y, d.z, T(0));
+    return {dot(v, a.Columns[0]), dot(v, a.Columns[1]), dot(v, a.Columns[2])};
+}
+
+// The transform which does _lhs_ and then _rhs_ (the product of the matrices, in the same order)
+template <typename T>
+affine3<T> dot(const affine3<T> &lhs, const affine3<T> &rhs) {
+    using ColumnT = typename affine3<T>::ColumnT;
+
+    // Column j of the product is the columns of _lhs_ weighted by column j of _rhs_, the last row of the
+    // implicit 4x4 _lhs_ is (0, 0, 0, 1) so the fourth weight only goes to the translation.
+    affine3<T> result;
+    For(range(3)) {
+        auto &c = rhs.Columns[it];
+
+        ColumnT r = mul_add(lhs.Columns[2], ColumnT(c.z), ColumnT(0, 0, 0, c.w));
+        r = mul_add(lhs.Columns[1], ColumnT(c.y), r);
+        result.Columns[it] = mul_add(lhs.Columns[0], ColumnT(c.x), r);
+    }
+    return result;
+}
+
+// The inverse of any invertible affine transform (see affine_inverse() for mat4)
+template <typename T>
+affine3<T> inverse(const affine3<T> &a) {
+    using Vec3 = vec<T, 3, false>;
+
+    // With the columns of the 3x3 part as c0, c1 and c2 the rows of its inverse are their cross products
+    Vec3 c0 = a.Columns[0].xyz, c1 = a.Columns[1].xyz, c2 = a.Columns[2].xyz;
+    Vec3 r0 = cross(c1, c2), r1 = cross(c2, c0), r2 = cross(c0, c1);
+
+    T invDet = T(1) / dot(c0, r0);
+    r0 *= invDet;
+    r1 *= invDet;
+    r2 *= invDet;
+
+    // The translation of the inverse is -t times the inverse of the 3x3 part
+    Vec3 t = a.translation();
+
+    affine3<T> result;
+    For(range(3)) {
+        Vec3 column(r0[it], r1[it], r2[it]);
+        result.Columns[it] = typename affine3<T>::ColumnT(column.x, column.y, column.z, -dot(t, column));
+    }
+    return result;
+}
+
+// The inverse of a rotation and translation (no scale or shear), the 3x3 part is just transposed
+template <typename T>
+affine3<T> rigid_inverse(const affine3<T> &a) {
+    using Vec3 = vec<T, 3, false>;
+
+    Vec3 t = a.translation();
+
+    affine3<T> result;
+    For(range(3)) {
+        Vec3 column(a.Columns[0][it], a.Columns[1][it], a.Columns[2][it]);
+        result.Columns[it] = typename affine3<T>::ColumnT(column.x, column.y, column.z, -dot(t, column));
+    }
+    return result;
+}
+
+template <typename T>
+bool almost_equal(const affine3<T> &lhs, const affine3<T> &rhs) {
+    return almost_equal(lhs.Columns[0], rhs.Columns[0]) && almost_equal(lhs.Columns[1], rhs.Columns[1]) &&
+           almost_equal(lhs.Columns[2], rhs.Columns[2]);
+}
+
+LSTD_END_NAMESPACE
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../mat.h"
+#include "../simd_math.h"
 
 LSTD_BEGIN_NAMESPACE
 
@@ -33,8 +34,8 @@ struct rotation_2d_helper : non_copyable {
 
     template <typename U, s64 RC, s64 CC, bool MPacked>
     void set_impl(mat<U, RC, CC, MPacked> &m) const {
-        T C = (T) cos(Angle);
-        T S = (T) sin(Angle);
+        T C, S;
+        simd_sincos(Angle, &S, &C);
 
         // Indices according to follow vector order
         m(0, 0) = U(C);
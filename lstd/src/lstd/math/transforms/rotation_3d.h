@@ -2,6 +2,7 @@
 
 #include "../mat_func.h"
 #include "../quat.h"
+#include "../simd_math.h"
 #include "identity.h"
 
 LSTD_BEGIN_NAMESPACE
@@ -39,8 +40,8 @@ struct rotation_3d_axis_helper : non_copyable {
 
     template <typename U, s64 R, s64 C_, bool MPacked>
     void set_impl(mat<U, R, C_, MPacked> &m) const {
-        T C = (T) cos(Angle);
-        T S = (T) sin(Angle);
+        f32 C, S;
+        simd_sincos(Angle, &S, &C);
 
         assert(0 <= Axis && Axis < 3);
 
@@ -235,8 +236,8 @@ struct rotation_3d_axis_angle_helper : non_copyable {
     void set_impl(mat<U, RC, CC, MPacked> &m) const {
         assert(is_normalized(Axis));
 
-        T C = (T) cos(Angle);
-        T S = (T) sin(Angle);
+        T C, S;
+        simd_sincos(Angle, &S, &C);
 
         // 3x3 rotation sub-matrix
         using RotMat = mat<U, 3, 3, Packed>;
@@ -305,8 +306,9 @@ rotation_3d_tri_axis_helper<T>::operator tquat<U, QPacked>() const {
 template <typename T, bool Packed>
 template <typename U, bool QPacked>
 rotation_3d_axis_angle_helper<T, Packed>::operator tquat<U, QPacked>() const {
-    auto halfAngle = U(Angle) * U(0.5);
-    return tquat<U, QPacked>((U) cos(halfAngle), vec<U, 3, QPacked>(Axis) * (U) sin(halfAngle));
+    U c, s;
+    simd_sincos(U(Angle) * U(0.5), &s, &c);
+    return tquat<U, QPacked>(c, vec<U, 3, QPacked>(Axis) * s);
 }
 
 LSTD_END_NAMESPACE
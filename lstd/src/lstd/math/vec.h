@@ -189,6 +189,12 @@ VEC_DATA_DEF(f64, 3, 4);  // :SimdForVec3: We turn on SIMD for vectors with thre
 VEC_DATA_DEF(f64, 4, 4);
 VEC_DATA_DEF(f64, 8, 8);
 
+// Small SIMD integer vectors. Not for three components, the fourth lane would be divided by zero.
+VEC_DATA_DEF(s32, 4, 4);
+VEC_DATA_DEF(s32, 8, 8);
+VEC_DATA_DEF(s64, 2, 2);
+VEC_DATA_DEF(s64, 4, 4);
+
 template <typename T_, s64 Dim, bool Packed = false>
 struct vec : public vec_data<T_, Dim, Packed> {
     static_assert(Dim >= 1, "Dimension must be >= 1");
@@ -203,6 +209,9 @@ struct vec : public vec_data<T_, Dim, Packed> {
     // :MathTypesNoInit By default we don't init (to save on performance) but you can call a constructor with a scalar value of 0 to zero-init.
     vec() : vec_data<T, DIM, PACKED>() {}
 
+    // allocate_array() doesn't loop over the elements to call the constructor above (see construct_elements())
+    static constexpr bool NO_INIT_CONSTRUCT = true;
+
     // Sets all elements to the same value
     explicit vec(T all) {
         if constexpr (!has_simd<vec>) {
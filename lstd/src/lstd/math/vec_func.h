@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../memory/stack_array.h"
+#include "simd_math.h"
 #include "vec_util.h"
 
 LSTD_BEGIN_NAMESPACE
@@ -31,6 +32,20 @@ auto dot(const Vec &lhs, const Vec &rhs) {
     }
 }
 
+// Returns a * b + c (element-wise). With FMA (see simd_avx.h) floats are rounded once instead of twice,
+// so the result may differ from writing a * b + c in the last bit.
+template <any_vec Vec>
+always_inline Vec mul_add(const Vec &a, const Vec &b, const Vec &c) {
+    if constexpr (!has_simd<Vec>) {
+        Vec result;
+        For(range(Vec::DIM)) result.Data[it] = a.Data[it] * b.Data[it] + c.Data[it];
+        return result;
+    } else {
+        using SimdT = decltype(Vec::Simd);
+        return {Vec::FROM_SIMD, SimdT::mul_add(a.Simd, b.Simd, c.Simd)};
+    }
+}
+
 // Returns true if the vector's length is too small for precise calculations (i.e. normalization).
 // "Too small" means smaller than the square root of the smallest number representable by the underlying scalar.
 // This value is ~10^-18 for floats and ~10^-154 for doubles.
@@ -173,20 +188,30 @@ always_inline Vec clamp(const Vec &arg, typename vec_info<Vec>::T lower, typenam
     return result;
 }
 
-// Returns the element-wise natural log of the vector
+// Returns the element-wise natural log of the vector.
+// Vectors with SIMD use simd_log() (see simd_math.h), which may differ from the scalar ln() in the last bit.
 template <any_vec Vec>
 always_inline Vec ln(const Vec &vec) {
-    Vec result;
-    For(range(Vec::DIM)) result[it] = ln(vec[it]);
-    return result;
+    if constexpr (has_simd<Vec>) {
+        return {Vec::FROM_SIMD, simd_log(vec.Simd)};
+    } else {
+        Vec result;
+        For(range(Vec::DIM)) result[it] = ln(vec[it]);
+        return result;
+    }
 }
 
-// Returns the element-wise exp of the vector
+// Returns the element-wise exp of the vector.
+// Vectors with SIMD use simd_exp() (see simd_math.h), which may differ from the scalar exp() in the last bit.
 template <any_vec Vec>
 always_inline Vec exp(const Vec &vec) {
-    Vec result;
-    For(range(Vec::DIM)) result[it] = exp(vec[it]);
-    return result;
+    if constexpr (has_simd<Vec>) {
+        return {Vec::FROM_SIMD, simd_exp(vec.Simd)};
+    } else {
+        Vec result;
+        For(range(Vec::DIM)) result[it] = exp(vec[it]);
+        return result;
+    }
 }
 
 // Returns the element-wise sqrt of the vector
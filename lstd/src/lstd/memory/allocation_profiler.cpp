@@ -0,0 +1,118 @@
+#include "../call_stack.h"
+#include "../internal/context.h"
+#include "allocator.h"
+#include "hash_table.h"
+
+import fmt;
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+struct allocation_profiler_sample {
+    // These are estimates of what was actually allocated from this stack (not just what was sampled)
+    f64 Count;
+    f64 Bytes;
+};
+
+// Samples are keyed by the id of their interned call stack (see :CallStacks:). We store them in the persistent allocator so
+// the profiler doesn't show up in the stats (or the leaks) of the user's allocators.
+file_scope hash_table<u64, allocation_profiler_sample> ProfilerSamples;
+file_scope thread::fast_mutex ProfilerMutex;
+
+file_scope thread_local s64 BytesUntilSample = -1;  // -1 means we haven't picked the first gap on this thread yet
+file_scope thread_local u64 ProfilerRandomState = 0;
+file_scope thread_local bool InProfiler = false;  // Allocations made while taking a sample shouldn't get sampled
+
+// xorshift64*, we don't need anything better for picking sample gaps
+file_scope f64 profiler_random_unit() {
+    if (!ProfilerRandomState) ProfilerRandomState = (u64) &ProfilerRandomState ^ (u64) os_get_time() ^ 0x9E3779B97F4A7C15ull;
+
+    ProfilerRandomState ^= ProfilerRandomState >> 12;
+    ProfilerRandomState ^= ProfilerRandomState << 25;
+    ProfilerRandomState ^= ProfilerRandomState >> 27;
+    u64 r = ProfilerRandomState * 0x2545F4914F6CDD1Dull;
+
+    return ((r >> 11) + 1) * (1.0 / 9007199254740993.0);  // In (0, 1]
+}
+
+// Exponentially distributed with mean _rate_, which turns sampling into a Poisson process over allocated bytes.
+file_scope s64 profiler_pick_gap(s64 rate) {
+    return (s64) (-::log(profiler_random_unit()) * rate) + 1;
+}
+
+void allocation_profiler_start(s64 sampleRate) {
+    assert(sampleRate > 0);
+    atomic_swap(&AllocationProfilerSampleRate, sampleRate);
+}
+
+void allocation_profiler_stop() { atomic_swap(&AllocationProfilerSampleRate, 0ll); }
+
+void allocation_profiler_reset() {
+    thread::scoped_lock<thread::fast_mutex> _(&ProfilerMutex);
+
+    InProfiler = true;
+    free(ProfilerSamples);
+    InProfiler = false;
+}
+
+void allocation_profiler_maybe_sample(s64 userSize) {
+    if (InProfiler) return;
+
+    s64 rate = AllocationProfilerSampleRate;
+    if (!rate) return;
+
+    if (BytesUntilSample < 0) BytesUntilSample = profiler_pick_gap(rate);
+
+    BytesUntilSample -= userSize;
+    if (BytesUntilSample > 0) return;
+
+    BytesUntilSample = profiler_pick_gap(rate);
+
+    InProfiler = true;
+    defer(InProfiler = false);
+
+    // Skip this function and general_allocate(). Only the addresses, they are resolved when printing
+    // (or by the symbolizer thread in the meantime, see call_stack_symbolizer_start()).
+    void *frames[ALLOCATION_PROFILER_MAX_FRAMES];
+    s64 frameCount = os_capture_call_stack(frames, ALLOCATION_PROFILER_MAX_FRAMES, 2);
+
+    u64 stack = call_stack_intern(frames, frameCount);
+    if (!stack) return;
+
+    // An allocation of _userSize_ bytes gets sampled with probability 1 - e^(-size / rate),
+    // so each sample stands for 1 / p allocations like it.
+    f64 p = 1.0 - ::exp(-(f64) userSize / rate);
+    f64 weight = p > 0 ? 1.0 / p : 1.0;
+
+    thread::scoped_lock<thread::fast_mutex> _(&ProfilerMutex);
+
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        auto [key, value] = find(ProfilerSamples, stack);
+        if (!value) value = add(ProfilerSamples, stack, allocation_profiler_sample{0, 0}).Value;
+
+        value->Count += weight;
+        value->Bytes += weight * userSize;
+    }
+}
+
+void allocation_profiler_print_collapsed() {
+    // Don't sample the allocations we make while resolving symbols
+    InProfiler = true;
+    defer(InProfiler = false);
+
+    thread::scoped_lock<thread::fast_mutex> _(&ProfilerMutex);
+
+    // The same addresses appear in many stacks, call_stack_resolve() caches what it resolved
+    For(ProfilerSamples) {
+        call_stack stack;
+        if (!call_stack_get(*it.Key, &stack)) continue;
+
+        // Collapsed stacks go from the outermost call to the leaf
+        for (s64 i = stack.Count - 1; i >= 0; --i) {
+            print("{}{}", call_stack_resolve(stack.Frames[i]).Name, i ? ";" : "");
+        }
+        print(" {}\n", (s64) it.Value->Bytes);
+    }
+}
+
+LSTD_END_NAMESPACE
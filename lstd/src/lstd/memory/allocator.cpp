@@ -3,6 +3,7 @@
 #include "../internal/context.h"
 #include "../io.h"
 #include "../math.h"
+#include "../profiler.h"
 
 import path;
 import fmt;
@@ -19,44 +20,52 @@ import os;
 LSTD_BEGIN_NAMESPACE
 
 #if defined DEBUG_MEMORY
-void debug_memory::unlink_header(allocation_header *h) {
-    assert(Head);
+//
+// These operate on the list of a single shard and expect the shard to be locked.
+//
+file_scope void shard_unlink_header(debug_memory_shard *shard, allocation_header *h) {
+    assert(shard->Head);
     assert(h);
     assert(h->DEBUG_Previous);
 
+    // Don't leave the verify cursor pointing to a header which is about to get freed
+    if (shard->VerifyCursor == h) shard->VerifyCursor = h->DEBUG_Next;
+
     if (h->DEBUG_Previous == h) {
-        Head = null;
-    } else if (Head == h) {
+        shard->Head = null;
+    } else if (shard->Head == h) {
         h->DEBUG_Next->DEBUG_Previous = h->DEBUG_Previous;
-        Head = h->DEBUG_Next;
+        shard->Head = h->DEBUG_Next;
     } else {
         h->DEBUG_Previous->DEBUG_Next = h->DEBUG_Next;
         if (h->DEBUG_Next) {
             h->DEBUG_Next->DEBUG_Previous = h->DEBUG_Previous;
         } else {
-            Head->DEBUG_Previous = h->DEBUG_Previous;
+            shard->Head->DEBUG_Previous = h->DEBUG_Previous;
         }
     }
 }
 
-void debug_memory::add_header(allocation_header *h) {
-    h->DEBUG_Next = Head;
-    if (Head) {
-        h->DEBUG_Previous = Head->DEBUG_Previous;
-        Head->DEBUG_Previous = h;
+file_scope void shard_add_header(debug_memory_shard *shard, allocation_header *h) {
+    h->DEBUG_Next = shard->Head;
+    if (shard->Head) {
+        h->DEBUG_Previous = shard->Head->DEBUG_Previous;
+        shard->Head->DEBUG_Previous = h;
     } else {
         h->DEBUG_Previous = h;
     }
-    Head = h;
+    shard->Head = h;
 }
 
-void debug_memory::swap_header(allocation_header *o, allocation_header *n) {
-    assert(Head);
+file_scope void shard_swap_header(debug_memory_shard *shard, allocation_header *o, allocation_header *n) {
+    assert(shard->Head);
     assert(o);
     assert(n);
 
-    if (Head == o) {
-        Head = n;
+    if (shard->VerifyCursor == o) shard->VerifyCursor = n;
+
+    if (shard->Head == o) {
+        shard->Head = n;
         n->DEBUG_Next = o->DEBUG_Next;
 
         if (!o->DEBUG_Next) {
@@ -70,13 +79,82 @@ void debug_memory::swap_header(allocation_header *o, allocation_header *n) {
         n->DEBUG_Previous = o->DEBUG_Previous;
         n->DEBUG_Previous->DEBUG_Next = n;
         if (!o->DEBUG_Next) {
-            Head->DEBUG_Previous = n;
+            shard->Head->DEBUG_Previous = n;
         } else {
             n->DEBUG_Next->DEBUG_Previous = n;
         }
     }
 }
 
+void debug_memory::init() {
+    For(range(DEBUG_MEMORY_SHARD_COUNT)) Shards[it].Mutex.init();
+}
+
+void debug_memory::release() {
+    For(range(DEBUG_MEMORY_SHARD_COUNT)) Shards[it].Mutex.release();
+}
+
+debug_memory_shard *debug_memory::get_shard(allocation_header *header) {
+    // Headers are at least 8-aligned and usually further apart than that, so skip the low bits
+    u64 h = (u64) header >> 6;
+    h ^= h >> 17;
+    return &Shards[h % DEBUG_MEMORY_SHARD_COUNT];
+}
+
+void debug_memory::unlink_header(allocation_header *h) {
+    auto *shard = get_shard(h);
+    thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+    shard_unlink_header(shard, h);
+}
+
+void debug_memory::add_header(allocation_header *h) {
+    auto *shard = get_shard(h);
+    thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+    shard_add_header(shard, h);
+}
+
+void debug_memory::swap_header(allocation_header *o, allocation_header *n) {
+    auto *oldShard = get_shard(o);
+    auto *newShard = get_shard(n);
+
+    if (oldShard == newShard) {
+        thread::scoped_lock<thread::mutex> _(&oldShard->Mutex);
+        shard_swap_header(oldShard, o, n);
+    } else {
+        // The headers live in different shards, we don't lock both at once to avoid lock ordering problems
+        unlink_header(o);
+        add_header(n);
+    }
+}
+
+void debug_memory::unlink_headers_in_range(void *begin, void *end) {
+    For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+        auto *shard = &Shards[i];
+        thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+
+        auto *h = shard->Head;
+        while (h) {
+            auto *tmp = h->DEBUG_Next;
+            if ((byte *) h >= (byte *) begin && (byte *) h < (byte *) end) shard_unlink_header(shard, h);
+            h = tmp;
+        }
+    }
+}
+
+void debug_memory::unlink_headers_of_allocator(allocator alloc) {
+    For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+        auto *shard = &Shards[i];
+        thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+
+        auto *h = shard->Head;
+        while (h) {
+            auto *tmp = h->DEBUG_Next;
+            if (h->Alloc == alloc) shard_unlink_header(shard, h);
+            h = tmp;
+        }
+    }
+}
+
 // Copied from test.h
 //
 // We check if the path contains src/ and use the rest after that.
@@ -104,46 +182,56 @@ constexpr string get_short_file_name(const string &str) {
     return result[{findResult, result.Length}];
 }
 
-void debug_memory::report_leaks() {
-    thread::scoped_lock<thread::mutex> _(&Mutex);
-
-    // First we check their integrity of the heap
-    maybe_verify_heap();
-
-    allocation_header **leaks;
-    // We want to ignore the allocation below since it's not the user's fault and we shouldn't count it as a leak
-    s64 leaksID;
+file_scope void verify_heap_unlocked(debug_memory *d);
 
+void debug_memory::report_leaks() {
+    // What we print about a leak, copied while the shards are locked
+    struct leak {
+        const utf8 *FileName;
+        s64 FileLine;
+        s64 Size;
+        s64 ID, RID;
+    };
+
+    leak *leaks = null;
     s64 leaksCount = 0;
     {
-        auto *it = Head;
-        while (it) {
-            if (!it->MarkedAsLeak) ++leaksCount;
-            it = it->DEBUG_Next;
+        For(range(DEBUG_MEMORY_SHARD_COUNT)) Shards[it].Mutex.lock();
+        defer({
+            For(range(DEBUG_MEMORY_SHARD_COUNT)) Shards[it].Mutex.unlock();
+        });
+
+        // First we check their integrity of the heap
+        verify_heap_unlocked(this);
+
+        For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+            auto *it = Shards[i].Head;
+            while (it) {
+                if (!it->MarkedAsLeak) ++leaksCount;
+                it = it->DEBUG_Next;
+            }
         }
-    }
-
-    // @Cleanup @Platform @TODO @Memory Don't use the platform allocator. In the future we should have a seperate allocator for debug info.
-    leaks = allocate_array<allocation_header *>(leaksCount, {.Alloc = internal::platform_get_persistent_allocator()});
-    defer(free(leaks));
+        if (!leaksCount) return;
 
-    leaksID = ((allocation_header *) leaks - 1)->ID;
+        // Allocating or printing with the shards locked would deadlock (both come back here through the
+        // general allocator), so the list goes straight to an OS block and the printing happens after unlocking.
+        leaks = (leak *) os_allocate_block(leaksCount * sizeof(leak));
 
-    {
         auto *p = leaks;
-        auto *it = Head;
-        while (it) {
-            if (!it->MarkedAsLeak && it->ID != leaksID) *p++ = it;
-            it = it->DEBUG_Next;
+        For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+            auto *it = Shards[i].Head;
+            while (it) {
+                if (!it->MarkedAsLeak) *p++ = {it->FileName, it->FileLine, it->Size, it->ID, it->RID};
+                it = it->DEBUG_Next;
+            }
         }
     }
+    defer(os_free_block(leaks));
 
-    if (leaksCount) {
-        print(">>> Warning: The module {!YELLOW}\"{}\"{!} terminated but it still had {!YELLOW}{}{!} allocations which were unfreed. Here they are:\n", os_get_current_module(), leaksCount);
-    }
+    print(">>> Warning: The module {!YELLOW}\"{}\"{!} terminated but it still had {!YELLOW}{}{!} allocations which were unfreed. Here they are:\n", os_get_current_module(), leaksCount);
 
     For_as(i, range(leaksCount)) {
-        auto *it = leaks[i];
+        auto *it = leaks + i;
 
         string file = "Unknown";
 
@@ -205,25 +293,454 @@ file_scope void verify_header_unlocked(allocation_header *header) {
     //
 }
 
+// Expects all shards to be locked
+file_scope void verify_heap_unlocked(debug_memory *d) {
+    For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+        auto *it = d->Shards[i].Head;
+        while (it) {
+            verify_header_unlocked(it);
+            it = it->DEBUG_Next;
+        }
+    }
+}
+
 void debug_memory::verify_header(allocation_header *header) {
     // We need to lock here because another thread can free a header while we are reading from it.
-    thread::scoped_lock<thread::mutex> _(&Mutex);
+    auto *shard = get_shard(header);
+    thread::scoped_lock<thread::mutex> _(&shard->Mutex);
     verify_header_unlocked(header);
 }
 
 void debug_memory::maybe_verify_heap() {
+    if (atomic_inc(&VerifyCounter) % MemoryVerifyHeapFrequency) return;
+
+    if (MemoryVerifyHeapBatch == 0) {
+        verify_heap();
+        return;
+    }
+
+    // Pick the shards round robin
+    auto *shard = &Shards[(VerifyCounter / MemoryVerifyHeapFrequency) % DEBUG_MEMORY_SHARD_COUNT];
+
     // We need to lock here because another thread can free a header while we are reading from it.
-    if (AllocationCount % MemoryVerifyHeapFrequency) return;
+    thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+
+    For(range(MemoryVerifyHeapBatch)) {
+        // Start from the beginning when we have gone through the whole list
+        if (!shard->VerifyCursor) shard->VerifyCursor = shard->Head;
+        if (!shard->VerifyCursor) break;
+
+        verify_header_unlocked(shard->VerifyCursor);
+        shard->VerifyCursor = shard->VerifyCursor->DEBUG_Next;
+    }
+}
+
+void debug_memory::verify_heap() {
+    For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+        auto *shard = &Shards[i];
+
+        // We need to lock here because another thread can free a header while we are reading from it.
+        thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+
+        auto *it = shard->Head;
+        while (it) {
+            verify_header_unlocked(it);
+            it = it->DEBUG_Next;
+        }
+    }
+}
+#endif
+
+file_scope allocator_func_t AllocatorRegistryFunctions[ALLOCATOR_REGISTRY_SIZE];
+file_scope void *AllocatorRegistryContexts[ALLOCATOR_REGISTRY_SIZE];
+file_scope s64 AllocatorRegistryCount;
+file_scope thread::fast_mutex AllocatorRegistryMutex;
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+file_scope void stats_on_registry_remove(s64 registryIndex);
+#endif
+
+// Most of the time a thread allocates with the same allocator over and over.
+file_scope thread_local s64 AllocatorRegistryLastIndex = -1;
+
+s64 allocator_registry_find_or_add(allocator alloc) {
+    s64 last = AllocatorRegistryLastIndex;
+    if (last != -1 && AllocatorRegistryFunctions[last] == alloc.Function && AllocatorRegistryContexts[last] == alloc.Context) return last;
+
+    // We write an entry before incrementing the count, so we don't need the lock to read. A removed entry has a null
+    // function and a new one gets its function last (see below), so a half written entry never matches.
+    s64 count = atomic_compare_and_swap(&AllocatorRegistryCount, 0ll, 0ll);
+    For(range(count)) {
+        if (AllocatorRegistryFunctions[it] == alloc.Function && AllocatorRegistryContexts[it] == alloc.Context) {
+            AllocatorRegistryLastIndex = it;
+            return it;
+        }
+    }
+
+    thread::scoped_lock<thread::fast_mutex> _(&AllocatorRegistryMutex);
+
+    // Another thread may have added it in the mean time
+    For(range(count, AllocatorRegistryCount)) {
+        if (AllocatorRegistryFunctions[it] == alloc.Function && AllocatorRegistryContexts[it] == alloc.Context) {
+            AllocatorRegistryLastIndex = it;
+            return it;
+        }
+    }
+
+    // Reuse a slot of a removed allocator before taking a new one
+    For(range(AllocatorRegistryCount)) {
+        if (AllocatorRegistryFunctions[it]) continue;
+
+        atomic_store(&AllocatorRegistryContexts[it], alloc.Context);
+        atomic_store(&AllocatorRegistryFunctions[it], alloc.Function);
+
+        AllocatorRegistryLastIndex = it;
+        return it;
+    }
+
+    if (AllocatorRegistryCount == ALLOCATOR_REGISTRY_SIZE) {
+        assert(false && "Allocator registry is full. Allocators which go away should call allocator_registry_remove(), see allocator.h");
+        return -1;
+    }
+
+    s64 index = AllocatorRegistryCount;
+    AllocatorRegistryFunctions[index] = alloc.Function;
+    AllocatorRegistryContexts[index] = alloc.Context;
+    atomic_inc(&AllocatorRegistryCount);
+
+    AllocatorRegistryLastIndex = index;
+    return index;
+}
+
+void allocator_registry_remove(allocator alloc) {
+    thread::scoped_lock<thread::fast_mutex> _(&AllocatorRegistryMutex);
+
+    For(range(AllocatorRegistryCount)) {
+        if (AllocatorRegistryFunctions[it] != alloc.Function || AllocatorRegistryContexts[it] != alloc.Context) continue;
+
+        // The function first, so lock free readers stop matching before the context changes
+        atomic_store(&AllocatorRegistryFunctions[it], (allocator_func_t) null);
+        atomic_store(&AllocatorRegistryContexts[it], (void *) null);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+        // The next allocator in this slot starts with clean stats
+        stats_on_registry_remove(it);
+#endif
+        return;
+    }
+}
+
+allocator allocator_registry_get(s64 index) {
+    assert(index >= 0 && index < AllocatorRegistryCount);
+    return {AllocatorRegistryFunctions[index], AllocatorRegistryContexts[index]};
+}
+
+file_scope const utf8 *MemoryTagNames[MEMORY_TAG_COUNT] = {"untagged"};
+file_scope s64 MemoryTagCount = 1;
+file_scope thread::fast_mutex MemoryTagMutex;
+
+u8 memory_tag_get(const utf8 *name) {
+    // Expected to be called once per MEMORY_TAG (see context.h), so we don't bother with a lock free search
+    thread::scoped_lock<thread::fast_mutex> _(&MemoryTagMutex);
+
+    For(range(MemoryTagCount)) {
+        if (compare_c_string(MemoryTagNames[it], name) == -1) return (u8) it;
+    }
+
+    if (MemoryTagCount == MEMORY_TAG_COUNT) return 0;
+
+    MemoryTagNames[MemoryTagCount] = name;
+    atomic_inc(&MemoryTagCount);
+    return (u8) (MemoryTagCount - 1);
+}
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+file_scope allocator_stats AllocatorStats[ALLOCATOR_STATS_COUNT];
+file_scope memory_tag_stats MemoryTagStats[MEMORY_TAG_COUNT];
+
+file_scope allocator_stats *get_stats(s64 registryIndex) {
+    if (registryIndex < 0 || registryIndex >= ALLOCATOR_STATS_COUNT) return null;
+    return &AllocatorStats[registryIndex];
+}
+
+file_scope void stats_on_registry_remove(s64 registryIndex) {
+    auto *stats = get_stats(registryIndex);
+    if (stats) zero_memory(stats, sizeof(allocator_stats));
+}
+
+file_scope void stats_add_bytes(allocator_stats *stats, s64 bytes) {
+    s64 current = atomic_add(&stats->CurrentBytes, bytes) + bytes;
+
+    s64 peak = stats->PeakBytes;
+    while (current > peak) {
+        s64 oldPeak = atomic_compare_and_swap(&stats->PeakBytes, current, peak);
+        if (oldPeak == peak) break;
+        peak = oldPeak;
+    }
+}
+
+file_scope void tag_stats_add_bytes(u8 tag, s64 bytes) {
+    auto *stats = &MemoryTagStats[tag];
+
+    s64 current = atomic_add(&stats->CurrentBytes, bytes) + bytes;
+
+    s64 peak = stats->PeakBytes;
+    while (current > peak) {
+        s64 oldPeak = atomic_compare_and_swap(&stats->PeakBytes, current, peak);
+        if (oldPeak == peak) break;
+        peak = oldPeak;
+    }
+
+    // Warn when we cross the budget, not on every allocation after that
+    s64 budget = stats->Budget;
+    if (budget && current > budget && current - bytes <= budget && !Context._LoggingAnAllocation) {
+        PUSH_CONTEXT_VAR(_LoggingAnAllocation, true) {
+            print("{!YELLOW}>>> Warning: Memory tag \"{}\" went over its budget ({} bytes), now at {} bytes{!}\n", MemoryTagNames[tag], budget, current);
+        }
+    }
+}
+
+file_scope void stats_on_allocate(s64 registryIndex, u8 tag, s64 userSize) {
+    atomic_inc(&MemoryTagStats[tag].AllocationCount);
+    tag_stats_add_bytes(tag, userSize);
+
+    auto *stats = get_stats(registryIndex);
+    if (!stats) return;
+
+    atomic_inc(&stats->AllocationCount);
+    stats_add_bytes(stats, userSize);
+
+    s64 bucket = msb((u64) userSize | 1);
+    if (bucket >= ALLOCATOR_STATS_HISTOGRAM_BUCKETS) bucket = ALLOCATOR_STATS_HISTOGRAM_BUCKETS - 1;
+    atomic_inc(&stats->SizeHistogram[bucket]);
+}
+
+file_scope void stats_on_allocate_batch(s64 registryIndex, u8 tag, s64 userSize, s64 count) {
+    atomic_add(&MemoryTagStats[tag].AllocationCount, count);
+    tag_stats_add_bytes(tag, userSize * count);
+
+    auto *stats = get_stats(registryIndex);
+    if (!stats) return;
+
+    atomic_add(&stats->AllocationCount, count);
+    stats_add_bytes(stats, userSize * count);
+
+    s64 bucket = msb((u64) userSize | 1);
+    if (bucket >= ALLOCATOR_STATS_HISTOGRAM_BUCKETS) bucket = ALLOCATOR_STATS_HISTOGRAM_BUCKETS - 1;
+    atomic_add(&stats->SizeHistogram[bucket], count);
+}
+
+file_scope void stats_on_reallocate(s64 registryIndex, u8 tag, s64 oldUserSize, s64 newUserSize) {
+    tag_stats_add_bytes(tag, newUserSize - oldUserSize);
+
+    auto *stats = get_stats(registryIndex);
+    if (!stats) return;
+
+    atomic_inc(&stats->ReallocationCount);
+    stats_add_bytes(stats, newUserSize - oldUserSize);
+}
+
+file_scope void stats_on_free(s64 registryIndex, u8 tag, s64 userSize) {
+    atomic_inc(&MemoryTagStats[tag].FreeCount);
+    atomic_add(&MemoryTagStats[tag].CurrentBytes, -userSize);
+
+    auto *stats = get_stats(registryIndex);
+    if (!stats) return;
+
+    atomic_inc(&stats->FreeCount);
+    atomic_add(&stats->CurrentBytes, -userSize);
+}
+
+file_scope void stats_on_free_batch(s64 registryIndex, u8 tag, s64 userSize, s64 count) {
+    atomic_add(&MemoryTagStats[tag].FreeCount, count);
+    atomic_add(&MemoryTagStats[tag].CurrentBytes, -userSize * count);
+
+    auto *stats = get_stats(registryIndex);
+    if (!stats) return;
+
+    atomic_add(&stats->FreeCount, count);
+    atomic_add(&stats->CurrentBytes, -userSize * count);
+}
+
+allocator_stats allocator_get_stats(allocator alloc) {
+    allocator_stats result;
+    zero_memory(&result, sizeof(result));
+
+    auto *stats = get_stats(allocator_registry_find_or_add(alloc));
+    if (stats) copy_memory(&result, stats, sizeof(result));
+    return result;
+}
+
+void allocator_reset_stats(allocator alloc) {
+    auto *stats = get_stats(allocator_registry_find_or_add(alloc));
+    if (stats) zero_memory(stats, sizeof(allocator_stats));
+}
+
+void memory_tag_set_budget(u8 tag, s64 bytes) {
+    assert(tag < MEMORY_TAG_COUNT);
+    atomic_swap(&MemoryTagStats[tag].Budget, bytes);
+}
+
+memory_tag_stats memory_tag_get_stats(u8 tag) {
+    assert(tag < MEMORY_TAG_COUNT);
+
+    memory_tag_stats result;
+    copy_memory(&result, &MemoryTagStats[tag], sizeof(result));
+    result.Name = tag < atomic_load(&MemoryTagCount) ? MemoryTagNames[tag] : null;
+    return result;
+}
+#else
+allocator_stats allocator_get_stats(allocator alloc) {
+    allocator_stats result;
+    zero_memory(&result, sizeof(result));
+    return result;
+}
+
+void allocator_reset_stats(allocator alloc) {}
 
-    auto *it = Head;
-    while (it) {
-        verify_header_unlocked(it);
-        it = it->DEBUG_Next;
+void memory_tag_set_budget(u8 tag, s64 bytes) {}
+
+memory_tag_stats memory_tag_get_stats(u8 tag) {
+    memory_tag_stats result;
+    zero_memory(&result, sizeof(result));
+    result.Name = tag < atomic_load(&MemoryTagCount) ? MemoryTagNames[tag] : null;
+    return result;
+}
+#endif
+
+void allocator_print_stats(allocator alloc) {
+    auto stats = allocator_get_stats(alloc);
+
+    print("Allocator {{Function: {}, Context: {}}}:\n", (void *) alloc.Function, alloc.Context);
+    print("    Current: {!YELLOW}{}{!} bytes, peak: {!YELLOW}{}{!} bytes\n", stats.CurrentBytes, stats.PeakBytes);
+    print("    Allocations: {}, reallocations: {}, frees: {}\n", stats.AllocationCount, stats.ReallocationCount, stats.FreeCount);
+
+    For(range(ALLOCATOR_STATS_HISTOGRAM_BUCKETS)) {
+        if (!stats.SizeHistogram[it]) continue;
+        print("    [{:>10}, {:>10}): {}\n", 1ll << it, it == ALLOCATOR_STATS_HISTOGRAM_BUCKETS - 1 ? -1 : (1ll << (it + 1)), stats.SizeHistogram[it]);
     }
 }
+
+void allocator_print_all_stats() {
+    s64 count = atomic_compare_and_swap(&AllocatorRegistryCount, 0ll, 0ll);
+    For(range(count)) {
+        auto alloc = allocator_registry_get(it);
+        if (alloc.Function) allocator_print_stats(alloc);
+    }
+}
+
+void memory_tag_print_stats() {
+    s64 count = atomic_load(&MemoryTagCount);
+    For(range(count)) {
+        auto stats = memory_tag_get_stats((u8) it);
+        if (!stats.AllocationCount) continue;
+
+        print("Memory tag \"{}\":\n", stats.Name);
+        print("    Current: {!YELLOW}{}{!} bytes, peak: {!YELLOW}{}{!} bytes", stats.CurrentBytes, stats.PeakBytes);
+        if (stats.Budget) {
+            print(", budget: {} bytes{}", stats.Budget, stats.PeakBytes > stats.Budget ? " (went over)" : "");
+        }
+        print("\n    Allocations: {}, frees: {}\n", stats.AllocationCount, stats.FreeCount);
+    }
+}
+
+// Returns the size of the header we will use for a new allocation.
+// _registryIndex_ is -1 when the allocator didn't fit in the registry, then we must use the full header.
+file_scope u32 choose_header(s64 registryIndex, s64 userSize) {
+#if !defined DEBUG_MEMORY
+    if (registryIndex != -1 && userSize <= ALLOCATION_SMALL_MAX_SIZE) return sizeof(allocation_header_small);
+#endif
+    return sizeof(allocation_header);
+}
+
+file_scope s64 round_up_to_alignment(s64 size, u32 alignment) { return (size + alignment - 1) & -(s64) alignment; }
+
+// The size of the block we request from the allocator implementation
+file_scope s64 get_required_block_size(s64 userSize, u32 alignment, u32 headerSize, allocator alloc) {
+    s64 tail = userSize;
+#if defined DEBUG_MEMORY
+    tail += NO_MANS_LAND_SIZE;  // This is for the bytes after the requested block
+#endif
+
+    if (alloc.Function == guard_page_allocator) {
+        // The guard page allocator places the block so it ends on a page boundary, so when the size is a multiple
+        // of the alignment the block starts aligned and the padding after the header is known. We request exactly
+        // that much, so the allocation ends as close to the guard page as the alignment allows.
+        assert(alignment <= os_get_page_size() && "Guard page allocations can't be aligned to more than a page");
+        return round_up_to_alignment(headerSize, alignment) + round_up_to_alignment(tail, alignment);
+    }
+    return tail + alignment + headerSize + (headerSize % alignment);
+}
+
+#if defined DEBUG_MEMORY
+// See DEBUG_NO_FILL and debug_memory::FillMaxSize
+file_scope bool debug_skip_fill(s64 userSize, u64 options) {
+    if (options & DEBUG_NO_FILL) return true;
+    return DEBUG_memory && DEBUG_memory->FillMaxSize >= 0 && userSize > DEBUG_memory->FillMaxSize;
+}
+#endif
+
+// What we need to know about an existing allocation, regardless of which header it uses
+struct decoded_header {
+    allocator Alloc;
+    s64 Size;
+    u32 Alignment;
+    u32 HeaderSize;
+    void *Block;  // The pointer the allocator implementation returned
+
+    s64 RegistryIndex;  // -1 if the allocator isn't in the registry
+
+    u8 Tag;
+};
+
+file_scope decoded_header decode_header(void *ptr) {
+    decoded_header result;
+
+#if !defined DEBUG_MEMORY
+    if (allocation_is_small(ptr)) {
+        auto *header = (allocation_header_small *) ptr - 1;
+        result.Alloc = allocator_registry_get(header->AllocatorIndex);
+        result.Size = header->Size;
+        result.Alignment = 1u << header->AlignmentShift;
+        result.HeaderSize = sizeof(allocation_header_small);
+        result.Block = (char *) header - header->AlignmentPadding;
+        result.RegistryIndex = header->AllocatorIndex;
+        result.Tag = header->Tag;
+        return result;
+    }
+#endif
+
+    auto *header = (allocation_header *) ptr - 1;
+    result.Alloc = header->Alloc;
+    result.Size = header->Size;
+    result.Alignment = header->Alignment;
+    result.HeaderSize = sizeof(allocation_header);
+    result.Block = (char *) header - header->AlignmentPadding;
+    result.RegistryIndex = header->AllocatorIndex == 0xFFFF ? -1 : header->AllocatorIndex;
+    result.Tag = header->Tag;
+    return result;
+}
+
+// _headerSize_ is what choose_header() returned, _registryIndex_ is -1 if the allocator isn't in the registry
+file_scope void *encode_header(void *p, s64 userSize, u32 align, allocator alloc, s64 registryIndex, u32 headerSize, u8 tag, u64 flags) {
+#if !defined DEBUG_MEMORY
+    if (headerSize == sizeof(allocation_header_small)) {
+        u32 padding = calculate_padding_for_pointer_with_header(p, align, sizeof(allocation_header_small));
+
+        auto *result = (allocation_header_small *) ((char *) p + padding) - 1;
+        result->Size = (u16) userSize;
+        result->AlignmentPadding = (u16) (padding - sizeof(allocation_header_small));
+        result->AllocatorIndex = (u16) registryIndex;
+        result->Tag = tag;
+        result->AlignmentShift = (u8) msb(align);
+        result->Kind = ALLOCATION_HEADER_SMALL;
+
+        p = result + 1;
+        assert((((u64) p & ~((s64) align - 1)) == (u64) p) && "Pointer wasn't properly aligned.");
+        return p;
+    }
 #endif
 
-file_scope void *encode_header(void *p, s64 userSize, u32 align, allocator alloc, u64 flags) {
     u32 padding = calculate_padding_for_pointer_with_header(p, align, sizeof(allocation_header));
     u32 alignmentPadding = padding - sizeof(allocation_header);
 
@@ -247,6 +764,13 @@ file_scope void *encode_header(void *p, s64 userSize, u32 align, allocator alloc
     result->Alignment = align;
     result->AlignmentPadding = alignmentPadding;
 
+    result->AllocatorIndex = registryIndex == -1 ? 0xFFFF : (u16) registryIndex;
+    result->Tag = tag;
+
+#if !defined DEBUG_MEMORY
+    result->Kind = ALLOCATION_HEADER_FULL;
+#endif
+
     //
     // This is now safe since we handle alignment here (and not in general_(re)allocate).
     // Before I wrote the fix the program was crashing because I was using SIMD types,
@@ -271,7 +795,8 @@ file_scope void *encode_header(void *p, s64 userSize, u32 align, allocator alloc
     assert((((u64) p & ~((s64) align - 1)) == (u64) p) && "Pointer wasn't properly aligned.");
 
 #if defined DEBUG_MEMORY
-    fill_memory(p, CLEAN_LAND_FILL, userSize);
+    result->DEBUG_NoFill = debug_skip_fill(userSize, flags);
+    if (!result->DEBUG_NoFill) fill_memory(p, CLEAN_LAND_FILL, userSize);
 
     fill_memory((char *) p - NO_MANS_LAND_SIZE, NO_MANS_LAND_FILL, NO_MANS_LAND_SIZE);
     fill_memory((char *) p + userSize, NO_MANS_LAND_FILL, NO_MANS_LAND_SIZE);
@@ -305,6 +830,8 @@ file_scope void log_file_and_line(source_location loc) {
 }
 
 void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options, source_location loc) {
+    PROFILE_ZONE("general_allocate");
+
     options |= Context.AllocOptions;
 
     if (alignment == 0) {
@@ -317,8 +844,6 @@ void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options
     s64 id = -1;
 
     if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
-
         DEBUG_memory->maybe_verify_heap();
 
         id = DEBUG_memory->AllocationCount;
@@ -330,10 +855,7 @@ void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options
 #endif
 
     if (Context.LogAllAllocations && !Context._LoggingAnAllocation) {
-        auto newContext = Context;
-        newContext._LoggingAnAllocation = true;
-
-        PUSH_CONTEXT(newContext) {
+        PUSH_CONTEXT_VAR(_LoggingAnAllocation, true) {
             write(Context.Log, ">>> Allocation made at: ");
             log_file_and_line(loc);
             write(Context.Log, "\n");
@@ -343,15 +865,22 @@ void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options
     alignment = alignment < POINTER_SIZE ? POINTER_SIZE : alignment;
     assert(is_pow_of_2(alignment));
 
-    s64 required = userSize + alignment + sizeof(allocation_header) + (sizeof(allocation_header) % alignment);
-#if defined DEBUG_MEMORY
-    required += NO_MANS_LAND_SIZE;  // This is for the bytes after the requested block
-#endif
+    s64 registryIndex = allocator_registry_find_or_add(alloc);
+    u32 headerSize = choose_header(registryIndex, userSize);
+
+    s64 required = get_required_block_size(userSize, alignment, headerSize, alloc);
 
     void *block = alloc.Function(allocator_mode::ALLOCATE, alloc.Context, required, null, 0, options);
     assert(block);
 
-    auto *result = encode_header(block, userSize, alignment, alloc, options);
+    u8 tag = Context.MemoryTag;
+    auto *result = encode_header(block, userSize, alignment, alloc, registryIndex, headerSize, tag, options);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    stats_on_allocate(registryIndex, tag, userSize);
+#endif
+
+    if (AllocationProfilerSampleRate) allocation_profiler_maybe_sample(userSize);
 
 #if defined DEBUG_MEMORY
     auto *header = (allocation_header *) result - 1;
@@ -359,11 +888,7 @@ void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options
     header->FileName = loc.File;
     header->FileLine = loc.Line;
 
-    if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
-
-        DEBUG_memory->add_header(header);
-    }
+    if (DEBUG_memory) DEBUG_memory->add_header(header);
 #endif
 
     return result;
@@ -372,25 +897,21 @@ void *general_allocate(allocator alloc, s64 userSize, u32 alignment, u64 options
 void *general_reallocate(void *ptr, s64 newUserSize, u64 options, source_location loc) {
     options |= Context.AllocOptions;
 
-    auto *header = (allocation_header *) ptr - 1;
+    auto old = decode_header(ptr);
 
-    if (header->Size == newUserSize) return ptr;
+    if (old.Size == newUserSize) return ptr;
 
 #if defined DEBUG_MEMORY
-    if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
+    // With DEBUG_MEMORY all allocations use the full header
+    auto *header = (allocation_header *) ptr - 1;
 
-        DEBUG_memory->maybe_verify_heap();
-    }
+    if (DEBUG_memory) DEBUG_memory->maybe_verify_heap();
 
     auto id = header->ID;
 #endif
 
     if (Context.LogAllAllocations && !Context._LoggingAnAllocation) {
-        auto newContext = Context;
-        newContext._LoggingAnAllocation = true;
-
-        PUSH_CONTEXT(newContext) {
+        PUSH_CONTEXT_VAR(_LoggingAnAllocation, true) {
             write(Context.Log, ">>> Reallocation made at: ");
             log_file_and_line(loc);
             write(Context.Log, "\n");
@@ -399,56 +920,59 @@ void *general_reallocate(void *ptr, s64 newUserSize, u64 options, source_locatio
 
     // The header stores the size of the requested allocation
     // (so the user code can look at the header and not be confused with garbage)
-    s64 extra = sizeof(allocation_header) + header->Alignment + (sizeof(allocation_header) % header->Alignment);
+    s64 oldUserSize = old.Size;
 
-    s64 oldUserSize = header->Size;
+    auto alloc = old.Alloc;
 
-    s64 oldSize = oldUserSize + extra;
-    s64 newSize = newUserSize + extra;
+    s64 oldSize = get_required_block_size(oldUserSize, old.Alignment, old.HeaderSize, alloc);
+    s64 newSize = get_required_block_size(newUserSize, old.Alignment, old.HeaderSize, alloc);
 
-#if defined DEBUG_MEMORY
-    oldSize += NO_MANS_LAND_SIZE;
-    newSize += NO_MANS_LAND_SIZE;
-#endif
-
-    auto alloc = header->Alloc;
-
-    void *block = (char *) header - header->AlignmentPadding;
+    void *block = old.Block;
     void *p;
 
+    // A small header can't store a size larger than ALLOCATION_SMALL_MAX_SIZE, in that case we must move the block.
+    bool canResizeInPlace = true;
+#if !defined DEBUG_MEMORY
+    if (old.HeaderSize == sizeof(allocation_header_small) && newUserSize > ALLOCATION_SMALL_MAX_SIZE) canResizeInPlace = false;
+#endif
+
     // Try to resize the block, this returns null if the block can't be resized and we need to move it.
-    void *newBlock = alloc.Function(allocator_mode::RESIZE, alloc.Context, newSize, block, oldSize, options);
+    void *newBlock = null;
+    if (canResizeInPlace) newBlock = alloc.Function(allocator_mode::RESIZE, alloc.Context, newSize, block, oldSize, options);
+
     if (!newBlock) {
         // Memory needs to be moved
+        u32 newHeaderSize = choose_header(old.RegistryIndex, newUserSize);
+        newSize = get_required_block_size(newUserSize, old.Alignment, newHeaderSize, alloc);
+
         void *newBlock = alloc.Function(allocator_mode::ALLOCATE, alloc.Context, newSize, null, 0, options);
         assert(newBlock);
 
-        auto *newPointer = encode_header(newBlock, newUserSize, header->Alignment, alloc, options);
-
-        auto *newHeader = (allocation_header *) newPointer - 1;
+        // The moved allocation stays under the tag it was made with
+        auto *newPointer = encode_header(newBlock, newUserSize, old.Alignment, alloc, old.RegistryIndex, newHeaderSize, old.Tag, options);
 
-        copy_memory(newPointer, ptr, header->Size);
+        copy_memory(newPointer, ptr, oldUserSize < newUserSize ? oldUserSize : newUserSize);
 
 #if defined DEBUG_MEMORY
+        auto *newHeader = (allocation_header *) newPointer - 1;
+
         newHeader->ID = id;
         newHeader->RID = header->RID + 1;
 
-        if (DEBUG_memory) {
-            thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
+        if (DEBUG_memory) DEBUG_memory->swap_header(header, newHeader);
 
-            DEBUG_memory->swap_header(header, newHeader);
-        }
-
-        fill_memory(block, DEAD_LAND_FILL, oldSize);
+        // With DEBUG_NO_FILL only the old header is marked as dead
+        fill_memory(block, DEAD_LAND_FILL, header->DEBUG_NoFill ? (char *) ptr - (char *) block : oldSize);
 
         newHeader->FileName = loc.File;
         newHeader->FileLine = loc.Line;
 
         newHeader->MarkedAsLeak = header->MarkedAsLeak;
+        newHeader->DEBUG_NoFill = newHeader->DEBUG_NoFill || header->DEBUG_NoFill;
 #endif
         alloc.Function(allocator_mode::FREE, alloc.Context, 0, block, oldSize, options);
 
-        p = (void *) (newHeader + 1);
+        p = newPointer;
     } else {
         // The block was resized sucessfully and it doesn't need moving
         assert(block == newBlock);  // Sanity
@@ -458,25 +982,41 @@ void *general_reallocate(void *ptr, s64 newUserSize, u64 options, source_locatio
 
         header->FileName = loc.File;
         header->FileLine = loc.Line;
+
+        header->DEBUG_NoFill = header->DEBUG_NoFill || debug_skip_fill(newUserSize, options);
 #endif
-        header->Size = newUserSize;
 
-        p = (void *) (header + 1);
+#if !defined DEBUG_MEMORY
+        if (old.HeaderSize == sizeof(allocation_header_small)) {
+            ((allocation_header_small *) ptr - 1)->Size = (u16) newUserSize;
+        } else
+#endif
+        {
+            ((allocation_header *) ptr - 1)->Size = newUserSize;
+        }
+
+        p = ptr;
     }
 
 #if defined DEBUG_MEMORY
-    if (oldSize < newSize) {
-        // If we are expanding the memory, fill the new stuff with CLEAN_LAND_FILL
-        fill_memory((char *) p + oldUserSize, CLEAN_LAND_FILL, newSize - oldSize);
-    } else {
-        // If we are shrinking the memory, fill the old stuff with DEAD_LAND_FILL
-        fill_memory((char *) header + oldSize, DEAD_LAND_FILL, oldSize - newSize);
+    if (!((allocation_header *) p - 1)->DEBUG_NoFill) {
+        if (oldUserSize < newUserSize) {
+            // If we are expanding the memory, fill the new stuff with CLEAN_LAND_FILL
+            fill_memory((char *) p + oldUserSize, CLEAN_LAND_FILL, newUserSize - oldUserSize);
+        } else if (p == ptr) {
+            // If we shrank in place, fill the old stuff with DEAD_LAND_FILL
+            fill_memory((char *) p + newUserSize, DEAD_LAND_FILL, oldUserSize - newUserSize);
+        }
     }
 
     // Fill the no mans land fill and check the heap for corruption
     fill_memory((char *) p + newUserSize, NO_MANS_LAND_FILL, NO_MANS_LAND_SIZE);
 #endif
 
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    stats_on_reallocate(old.RegistryIndex, old.Tag, oldUserSize, newUserSize);
+#endif
+
     return p;
 }
 
@@ -485,32 +1025,28 @@ void general_free(void *ptr, u64 options) {
 
     options |= Context.AllocOptions;
 
-    auto *header = (allocation_header *) ptr - 1;
+    auto info = decode_header(ptr);
 
-    auto alloc = header->Alloc;
-    void *block = (char *) header - header->AlignmentPadding;
+    auto alloc = info.Alloc;
+    void *block = info.Block;
 
-    s64 extra = header->Alignment + sizeof(allocation_header) + (sizeof(allocation_header) % header->Alignment);
-    s64 size = header->Size + extra;
+    s64 size = get_required_block_size(info.Size, info.Alignment, info.HeaderSize, alloc);
 
 #if defined DEBUG_MEMORY
-    if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
+    auto *header = (allocation_header *) ptr - 1;
 
-        DEBUG_memory->maybe_verify_heap();
-    }
+    if (DEBUG_memory) DEBUG_memory->maybe_verify_heap();
 
     auto id = header->ID;
 
-    size += NO_MANS_LAND_SIZE;
-
-    if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
+    if (DEBUG_memory) DEBUG_memory->unlink_header(header);
 
-        DEBUG_memory->unlink_header(header);
-    }
+    // With DEBUG_NO_FILL only the header is marked as dead
+    fill_memory(block, DEAD_LAND_FILL, header->DEBUG_NoFill ? (char *) ptr - (char *) block : size);
+#endif
 
-    fill_memory(block, DEAD_LAND_FILL, size);
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    stats_on_free(info.RegistryIndex, info.Tag, info.Size);
 #endif
 
     alloc.Function(allocator_mode::FREE, alloc.Context, 0, block, size, options);
@@ -518,25 +1054,150 @@ void general_free(void *ptr, u64 options) {
 
 void free_all(allocator alloc, u64 options) {
 #if defined DEBUG_MEMORY
-    if (DEBUG_memory) {
-        thread::scoped_lock<thread::mutex> _(&DEBUG_memory->Mutex);
+    // Remove allocations made with the allocator from the the linked list so we don't corrupt the heap
+    // The frame allocator keeps the allocations of recent frames alive, it unlinks the headers of the buffer it clears by itself.
+    if (DEBUG_memory && alloc.Function != frame_allocator) DEBUG_memory->unlink_headers_of_allocator(alloc);
+#endif
 
-        // Remove allocations made with the allocator from the the linked list so we don't corrupt the heap
-        auto *h = DEBUG_memory->Head;
-        while (h) {
-            auto *tmp = h->DEBUG_Next;
-            DEBUG_memory->unlink_header(h);
-            h = tmp;
+    options |= Context.AllocOptions;
+
+    auto result = alloc.Function(allocator_mode::FREE_ALL, alloc.Context, 0, 0, 0, options);
+    assert((result != (void *) -1) && "Allocator doesn't support FREE_ALL");
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    // Everything is freed at once, we don't know how many allocations there were
+    auto *stats = get_stats(allocator_registry_find_or_add(alloc));
+    if (stats) atomic_swap(&stats->CurrentBytes, 0ll);
+#endif
+}
+
+void general_allocate_batch(void **out, s64 count, allocator alloc, s64 userSize, u32 alignment, u64 options, source_location loc) {
+    if (count <= 0) return;
+
+    options |= Context.AllocOptions;
+
+    if (alignment == 0) {
+        auto contextAlignment = Context.AllocAlignment;
+        assert(is_pow_of_2(contextAlignment));
+        alignment = contextAlignment;
+    }
+
+#if defined DEBUG_MEMORY
+    if (DEBUG_memory) DEBUG_memory->maybe_verify_heap();
+#endif
+
+    if (Context.LogAllAllocations && !Context._LoggingAnAllocation) {
+        PUSH_CONTEXT_VAR(_LoggingAnAllocation, true) {
+            write(Context.Log, ">>> Batch allocation made at: ");
+            log_file_and_line(loc);
+            write(Context.Log, "\n");
         }
     }
+
+    alignment = alignment < POINTER_SIZE ? POINTER_SIZE : alignment;
+    assert(is_pow_of_2(alignment));
+
+    s64 registryIndex = allocator_registry_find_or_add(alloc);
+    u32 headerSize = choose_header(registryIndex, userSize);
+
+    s64 required = get_required_block_size(userSize, alignment, headerSize, alloc);
+
+    // The allocator fills as many as it can, we allocate the rest one by one (this way allocators which
+    // grow by themselves, like the temporary allocator, get the chance to add a pool).
+    void **filled = out;
+
+    void *result = alloc.Function(allocator_mode::ALLOCATE_BATCH, alloc.Context, required, out, count, options);
+    if (result != (void *) -1) filled = (void **) result;
+
+    while (filled != out + count) {
+        *filled = alloc.Function(allocator_mode::ALLOCATE, alloc.Context, required, null, 0, options);
+        assert(*filled);
+        ++filled;
+    }
+
+    u8 tag = Context.MemoryTag;
+
+    For(range(count)) {
+        out[it] = encode_header(out[it], userSize, alignment, alloc, registryIndex, headerSize, tag, options);
+
+#if defined DEBUG_MEMORY
+        auto *header = (allocation_header *) out[it] - 1;
+
+        header->FileName = loc.File;
+        header->FileLine = loc.Line;
+
+        if (DEBUG_memory) DEBUG_memory->add_header(header);
+#endif
+    }
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    stats_on_allocate_batch(registryIndex, tag, userSize, count);
 #endif
 
+    if (AllocationProfilerSampleRate) allocation_profiler_maybe_sample(userSize * count);
+}
+
+void general_free_batch(void **blocks, s64 count, u64 options) {
     options |= Context.AllocOptions;
 
-    auto result = alloc.Function(allocator_mode::FREE_ALL, alloc.Context, 0, 0, 0, options);
-    assert((result != (void *) -1) && "Allocator doesn't support FREE_ALL");
+#if defined DEBUG_MEMORY
+    if (DEBUG_memory) DEBUG_memory->maybe_verify_heap();
+#endif
+
+    // We collect the raw blocks of a run (same allocator, size and tag) here and free them with one call
+    constexpr s64 RUN_CAPACITY = 64;
+    void *run[RUN_CAPACITY];
+    s64 runCount = 0;
+
+    allocator runAlloc;
+    s64 runSize = 0, runUserSize = 0, runRegistryIndex = -1;
+    u8 runTag = 0;
+
+    auto flush = [&]() {
+        if (!runCount) return;
+
+        void *result = runAlloc.Function(allocator_mode::FREE_BATCH, runAlloc.Context, runSize, run, runCount, options);
+        if (result == (void *) -1) {
+            For(range(runCount)) runAlloc.Function(allocator_mode::FREE, runAlloc.Context, 0, run[it], runSize, options);
+        }
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+        stats_on_free_batch(runRegistryIndex, runTag, runUserSize, runCount);
+#endif
+        runCount = 0;
+    };
+
+    For(range(count)) {
+        void *ptr = blocks[it];
+        if (!ptr) continue;
+
+        auto info = decode_header(ptr);
+        s64 size = get_required_block_size(info.Size, info.Alignment, info.HeaderSize, info.Alloc);
+
+        if (runCount && (info.Alloc != runAlloc || size != runSize || info.Size != runUserSize || info.Tag != runTag || runCount == RUN_CAPACITY)) flush();
+
+#if defined DEBUG_MEMORY
+        auto *header = (allocation_header *) ptr - 1;
+        if (DEBUG_memory) DEBUG_memory->unlink_header(header);
+
+        fill_memory(info.Block, DEAD_LAND_FILL, header->DEBUG_NoFill ? (char *) ptr - (char *) info.Block : size);
+#endif
+
+        runAlloc = info.Alloc;
+        runSize = size;
+        runUserSize = info.Size;
+        runRegistryIndex = info.RegistryIndex;
+        runTag = info.Tag;
+        run[runCount++] = info.Block;
+    }
+    flush();
 }
 
+namespace internal {
+void *owning_delegate_allocate(s64 size, u32 alignment) { return general_allocate(platform_get_persistent_allocator(), size, alignment); }
+void owning_delegate_free(void *block) { general_free(block); }
+}  // namespace internal
+
 LSTD_END_NAMESPACE
 
 using LSTD_NAMESPACE::general_allocate;
@@ -37,13 +37,22 @@ enum class allocator_mode { ADD_POOL = 0,
                             ALLOCATE,
                             RESIZE,
                             FREE,
-                            FREE_ALL };
+                            FREE_ALL,
+                            ALLOCATE_BATCH,
+                            FREE_BATCH };
 
 // This is an option when allocating.
 // Allocations marked explicitly as leaks don't get reported with DEBUG_memory->report_leaks().
 // This is handled internally when passed, so allocator implementations needn't pay attention to it.
 constexpr u64 LEAK = 1ull << 63;
 
+// This is an option when allocating (only matters with DEBUG_MEMORY).
+// The block isn't filled with CLEAN_LAND_FILL when allocated or with DEAD_LAND_FILL when freed (only its header is),
+// use it for big buffers which are overwritten right away anyway. No man's land is still put around the block and checked.
+// The flag sticks to the allocation, reallocations and frees of it skip the fills as well.
+// See also debug_memory::FillMaxSize. Like LEAK, this is handled internally.
+constexpr u64 DEBUG_NO_FILL = 1ull << 62;
+
 // This specifies what the signature of each allocation function should look like.
 //
 // _mode_ is what we are doing currently: adding a pool, allocating, resizing, freeing a block or freeing everything
@@ -59,8 +68,8 @@ constexpr u64 LEAK = 1ull << 63;
 // _oldSize_ is the old size of memory block, used only when resizing
 //
 // The last pointer to u64 is reserved for options. The allocator implementation decides how to treat those.
-// We just provide a way to pass those. Note: The LEAK option means that bit number 64 is reserved for special use.
-// That means that the maximum integer you have to work with is the bottom 63 bits of the options.
+// We just provide a way to pass those. Note: The LEAK and DEBUG_NO_FILL options mean that bits number 64 and 63 are reserved for special use.
+// That means that the maximum integer you have to work with is the bottom 62 bits of the options.
 // I expect people to this as a bit field anyway.
 //
 //
@@ -72,6 +81,12 @@ constexpr u64 LEAK = 1ull << 63;
 //     or null - memory can't be resized and needs to be moved.
 //     In the second case we allocate a new block and copy the old data there (in general_reallocate).
 //
+// !!! ALLOCATE_BATCH and FREE_BATCH are optional (used by general_allocate_batch() and general_free_batch()).
+//     _size_ is the size of each block, _oldMemory_ is an array of block pointers (void **) and _oldSize_ is the count.
+//     ALLOCATE_BATCH fills as many entries as it can and returns a pointer one past the last filled entry.
+//     FREE_BATCH returns null on success. Return (void*) -1 from either if you don't support it,
+//     then we fall back to calling ALLOCATE/FREE for each block.
+//
 // !!! Alignment is handled internally. Allocator implementations needn't pay attention to it.
 //     When an aligned allocation is being made, we send a request at least _alignment_ bytes larger,
 //     so when the allocator function returns an unaligned pointer we can freely bump it.
@@ -134,9 +149,11 @@ inline constexpr u8 CLEAN_LAND_FILL = 0xCD;
 // we do that by padding this structure. Info about that is saved in the header itself.
 // Right now this uses 32 bytes when DEBUG_MEMORY is not defined, 96 bytes when storing debug info.
 //
-// @TODO: This is way too bug of an overhead. We CAN make this smaller!
-//        We should be careful in aranging this header. We can split allocations into medium/large,
-//        etc. and use a smaller header for medium allocations to reduce overhead (like https://nothings.org/stb/stb_malloc.h).
+// When DEBUG_MEMORY is not defined, small allocations (see ALLOCATION_SMALL_MAX_SIZE) use the 8 byte
+// allocation_header_small instead (like https://nothings.org/stb/stb_malloc.h splits allocations into medium/large).
+// The last byte before the returned pointer tells which header the allocation has (see _Kind_).
+//
+// Don't read headers directly, use allocation_get_size() and allocation_get_alignment().
 //
 struct allocation_header {
 #if defined DEBUG_MEMORY
@@ -196,6 +213,19 @@ struct allocation_header {
     u16 Alignment;         // We allow a maximum of 65535 bit (8191 byte) alignment
     u16 AlignmentPadding;  // Offset from the block that needs to be there in order for the result to be aligned
 
+    // Index of _Alloc_ in the allocator registry (0xFFFF if the registry was full), so freeing and
+    // resizing don't have to look the allocator up to keep its stats.
+    u16 AllocatorIndex;
+
+    // The memory tag which was current when the allocation was made (see memory_tag_get())
+    u8 Tag;
+
+#if !defined DEBUG_MEMORY
+    // Always ALLOCATION_HEADER_FULL. This must be the last byte of the header
+    // because that's where allocation_header_small stores its _Kind_ as well.
+    u8 Kind;
+#endif
+
 #if defined DEBUG_MEMORY
     // When allocating we can mark the next allocation as a leak.
     // That means that it's irrelevant if we don't free it before the end of the program (since the OS claims back the memory anyway).
@@ -203,6 +233,10 @@ struct allocation_header {
     // Headers with this bool set to true get skipped.
     bool MarkedAsLeak;
 
+    // Set when the allocation was made with DEBUG_NO_FILL (or was bigger than debug_memory::FillMaxSize).
+    // We don't fill the block with CLEAN_LAND_FILL and DEAD_LAND_FILL then.
+    bool DEBUG_NoFill;
+
     // This is used to detect buffer underruns.
     // There may be padding after this member, but we treat this region as "(allocation_header *) p + 1 - 4 bytes".
     // This doesn't matter since we just need AT LEAST 4 bytes free.
@@ -216,6 +250,92 @@ struct allocation_header {
 // 32, 96
 // constexpr s64 a = sizeof(allocation_header);
 
+// Allocators get a slot here the first time they allocate something.
+// We use the index to refer to an allocator with 2 bytes in small headers and to keep statistics (see allocator_stats).
+//
+// Allocators which go away (an arena per job or per frame at a new address) should give their slot back with
+// allocator_registry_remove() once nothing they allocated is alive anymore, virtual_arena_release() and
+// concurrent_arena_release() do that. Otherwise the slots run out - then we assert, and in release builds
+// fall back to using the full header and not keeping stats.
+inline constexpr s64 ALLOCATOR_REGISTRY_SIZE = 1024;
+
+// Tags are 6 bits in allocation_header_small
+inline constexpr s64 MEMORY_TAG_COUNT = 64;
+
+// Returns -1 if the registry is full.
+s64 allocator_registry_find_or_add(allocator alloc);
+allocator allocator_registry_get(s64 index);
+
+// Frees the slot of _alloc_ (if it has one) and resets its stats. Small headers refer to the slot,
+// so this must be called after everything allocated with _alloc_ has been freed (e.g. after free_all()).
+void allocator_registry_remove(allocator alloc);
+
+#if !defined DEBUG_MEMORY
+inline constexpr u8 ALLOCATION_HEADER_FULL = 1;
+inline constexpr u8 ALLOCATION_HEADER_SMALL = 2;
+
+// Allocations with size up to this use allocation_header_small (if the allocator fits in the registry, see below).
+inline constexpr s64 ALLOCATION_SMALL_MAX_SIZE = 0xFFFF;
+
+// When reallocating a small allocation to a size larger than ALLOCATION_SMALL_MAX_SIZE we move it to a new block with a full header.
+struct allocation_header_small {
+    u16 Size;
+    u16 AlignmentPadding;
+
+    // Index in the allocator registry. Storing the allocator itself takes 16 bytes.
+    // The registry has 1024 slots, so we keep the memory tag in the spare bits.
+    u16 AllocatorIndex : 10;
+    u16 Tag : 6;
+
+    u8 AlignmentShift;  // log2 of the alignment
+    u8 Kind;            // Always ALLOCATION_HEADER_SMALL
+};
+
+static_assert(ALLOCATOR_REGISTRY_SIZE <= 1 << 10 && MEMORY_TAG_COUNT <= 1 << 6, "Registry indices and tags must fit in allocation_header_small");
+
+always_inline bool allocation_is_small(void *ptr) {
+    u8 kind = *((u8 *) ptr - 1);
+    assert((kind == ALLOCATION_HEADER_FULL || kind == ALLOCATION_HEADER_SMALL) && "Header was corrupted or the pointer wasn't allocated by us");
+    return kind == ALLOCATION_HEADER_SMALL;
+}
+#endif
+
+// Returns the size of an allocation (NOT including the size of the header and padding).
+// _ptr_ must be a pointer returned by general_allocate.
+inline s64 allocation_get_size(void *ptr) {
+#if !defined DEBUG_MEMORY
+    if (allocation_is_small(ptr)) return ((allocation_header_small *) ptr - 1)->Size;
+#endif
+    return ((allocation_header *) ptr - 1)->Size;
+}
+
+// Returns the alignment an allocation was made with.
+// _ptr_ must be a pointer returned by general_allocate.
+inline u32 allocation_get_alignment(void *ptr) {
+#if !defined DEBUG_MEMORY
+    if (allocation_is_small(ptr)) return 1u << ((allocation_header_small *) ptr - 1)->AlignmentShift;
+#endif
+    return ((allocation_header *) ptr - 1)->Alignment;
+}
+
+// Returns the allocator an allocation was made with (the one reallocate_array() and free() go through).
+// _ptr_ must be a pointer returned by general_allocate.
+inline allocator allocation_get_allocator(void *ptr) {
+#if !defined DEBUG_MEMORY
+    if (allocation_is_small(ptr)) return allocator_registry_get(((allocation_header_small *) ptr - 1)->AllocatorIndex);
+#endif
+    return ((allocation_header *) ptr - 1)->Alloc;
+}
+
+// Returns the memory tag an allocation was made with (see memory_tag_get()).
+// _ptr_ must be a pointer returned by general_allocate.
+inline u8 allocation_get_tag(void *ptr) {
+#if !defined DEBUG_MEMORY
+    if (allocation_is_small(ptr)) return ((allocation_header_small *) ptr - 1)->Tag;
+#endif
+    return ((allocation_header *) ptr - 1)->Tag;
+}
+
 // Calculates the required padding in bytes which needs to be added to _ptr_ in order to be aligned
 inline u16 calculate_padding_for_pointer(void *ptr, s32 alignment) {
     assert(alignment > 0 && is_pow_of_2(alignment));
@@ -238,51 +358,84 @@ inline u16 calculate_padding_for_pointer_with_header(void *ptr, s32 alignment, u
 
 // #if'd so programs don't compile when debug info shouldn't be used.
 #if defined DEBUG_MEMORY
-struct debug_memory {
-    s64 AllocationCount = 0;
+// We keep a linked list of all allocations. You can use these lists to visualize them.
+// In order to not have every allocating thread fight for one lock, the list is split into shards,
+// headers are assigned a shard by their address (see debug_memory::get_shard()).
+inline constexpr s64 DEBUG_MEMORY_SHARD_COUNT = 16;
 
-    // We keep a linked list of all allocations. You can use this list to visualize them.
-    // _Head_ is the last allocation done.
+struct debug_memory_shard {
+    // _Head_ is the last allocation done in this shard.
     allocation_header *Head = null;
 
-    // Currently this mutex should be released in the OS implementations (e.g. windows_common.cpp).
+    // The next header to check in maybe_verify_heap(). We verify the heap incrementally, a few headers per call.
+    allocation_header *VerifyCursor = null;
+
     // We need to lock it before modifying the linked list for example.
-    //
-    // @TODO: @Speed: Lock-free linked list!
     thread::mutex Mutex;
+};
 
-    // After every allocation we check the heap for corruption.
+struct debug_memory {
+    s64 AllocationCount = 0;
+
+    debug_memory_shard Shards[DEBUG_MEMORY_SHARD_COUNT];
+
+    // Used to pick which shard to verify next
+    s64 VerifyCounter = 0;
+
+    // After every allocation we may check the heap for corruption.
     // The problem is that this involves iterating over a (possibly) large linked list of every allocation made.
-    // We use the frequency variable below to specify how often we perform that expensive operation.
+    // We use the frequency variable below to specify how often we perform that operation and each time we
+    // check only _MemoryVerifyHeapBatch_ headers (continuing from where we stopped the last time in that shard).
     // By default we check the heap every 255 allocations, but if a problem is found you may want to decrease
     // this to 1 so you catch the corruption at just the right time.
     u8 MemoryVerifyHeapFrequency = 255;
 
+    // Set this to 0 to verify the entire heap each time (very slow with a lot of allocations).
+    s64 MemoryVerifyHeapBatch = 64;
+
+    // Allocations bigger than this (in bytes) are treated as if they were made with DEBUG_NO_FILL.
+    // Filling multi-megabyte buffers on every allocation and free adds up. -1 means there is no limit.
+    s64 FillMaxSize = -1;
+
     // Set this to true to print a list of unfreed memory blocks when the library uninitializes.
     // Yes, the OS claims back all the memory the program has allocated anyway, and we are not promoting C++ style RAII
     // which make EVEN program termination slow, we are just providing this information to the programmer because they might
     // want to debug crashes/bugs related to memory. (I had to debug a bug with loading/unloading DLLs during runtime).
     bool CheckForLeaksAtTermination = false;
 
+    // Currently these should be called in the OS implementations (e.g. os.win64.common.ixx).
+    void init();     // Inits the mutexes
+    void release();  // Releases the mutexes
+
+    debug_memory_shard *get_shard(allocation_header *header);
+
+    // These lock the shard of the header.
     void unlink_header(allocation_header *header);                                 // Removes a header from the list
     void add_header(allocation_header *header);                                    // This adds the header to the front - making it the new head
     void swap_header(allocation_header *oldHeader, allocation_header *newHeader);  // Replaces _oldHeader_ with _newHeader_ in the list
 
+    // Removes all headers which point inside [begin, end).
+    // Used when memory is released in bulk (e.g. free_all or rewinding an arena), so we don't report them as leaks or verify garbage.
+    void unlink_headers_in_range(void *begin, void *end);
+
+    // Removes all headers of allocations made with _alloc_.
+    void unlink_headers_of_allocator(allocator alloc);
+
     // Assuming that the heap is not corrupted, this reports any unfreed allocations.
     // Yes, the OS claims back all the memory the program has allocated anyway, and we are not promoting C++ style RAII
     // which make EVEN program termination slow, we are just providing this information to the programmer because they might
     // want to debug crashes/bugs related to memory. (I had to debug a bug with loading/unloading DLLs during runtime).
     void report_leaks();
 
-    // Verifies the integrity of headers in all allocations (only if DEBUG_MEMORY is on).
+    // Verifies the integrity of some headers (only if DEBUG_MEMORY is on).
     //
     // We call this function when a new allocation is made.
-    // The problem is that it involves iterating over a linked list of every allocation made.
-    // We use the frequency variable in the _Context_ to specify how often we perform that expensive operation.
-    // By default we check the heap every 255 allocations, but if a problem is found you may want to decrease it to 1 so
-    // your program runs way slower but you catch the corruption at just the right time.
+    // Every _MemoryVerifyHeapFrequency_ calls we check _MemoryVerifyHeapBatch_ headers of one of the shards (round robin).
     void maybe_verify_heap();
 
+    // Verifies the integrity of every header in every shard.
+    void verify_heap();
+
     // Verifies the integrity of a single header (only if DEBUG_MEMORY is on).
     void verify_header(allocation_header *header);
 };
@@ -305,6 +458,120 @@ void general_free(void *ptr, u64 options = 0);
 // Note: Not all allocators must support this.
 void free_all(allocator alloc, u64 options = 0);
 
+// Allocates _count_ blocks of _userSize_ bytes each with the same alignment and fills _out_ with pointers to them.
+// The header, options and stats work is done once for the whole batch and the allocator gets a single
+// ALLOCATE_BATCH call (if it supports it). Use this when allocating many same-size objects in a burst.
+// The blocks are independent, free them individually or with general_free_batch().
+void general_allocate_batch(void **out, s64 count, allocator alloc, s64 userSize, u32 alignment = 0, u64 options = 0, source_location loc = {});
+
+// Frees _count_ blocks. Consecutive blocks which come from the same allocator and have the same size
+// are given to the allocator together with FREE_BATCH. Null pointers are skipped.
+void general_free_batch(void **blocks, s64 count, u64 options = 0);
+
+//
+// Allocation statistics.
+//
+// Unlike DEBUG_MEMORY these are cheap (a few atomic adds per allocation) and are kept in all configurations,
+// unless FORCE_NO_ALLOCATOR_STATS is defined. Use them to right-size pools and pick size classes.
+//
+// We keep stats for the first ALLOCATOR_STATS_COUNT allocators in the registry.
+// Note: reallocations change the byte counters but not the histogram.
+//
+inline constexpr s64 ALLOCATOR_STATS_COUNT = 128;
+inline constexpr s64 ALLOCATOR_STATS_HISTOGRAM_BUCKETS = 32;  // Bucket i counts allocations with size in [2^i, 2^(i + 1)), the last one counts everything larger.
+
+struct allocator_stats {
+    s64 CurrentBytes;  // Requested by the user (doesn't include headers and padding)
+    s64 PeakBytes;
+
+    s64 AllocationCount;
+    s64 ReallocationCount;
+    s64 FreeCount;
+
+    s64 SizeHistogram[ALLOCATOR_STATS_HISTOGRAM_BUCKETS];
+};
+
+// Returns a snapshot of the stats of _alloc_ (all zeroes if it hasn't allocated anything or stats are disabled).
+allocator_stats allocator_get_stats(allocator alloc);
+
+// Sets all counters of _alloc_ to 0.
+void allocator_reset_stats(allocator alloc);
+
+// Prints the stats of one allocator or of every allocator which has allocated something to Context.Log.
+void allocator_print_stats(allocator alloc);
+void allocator_print_all_stats();
+
+//
+// Memory tags.
+//
+// Attribute allocations to the subsystem which made them, e.g.
+//
+//     MEMORY_TAG("renderer") {
+//         ... allocations in here are counted under "renderer" ...
+//     }
+//
+// The current tag is Context.MemoryTag (0 - "untagged" by default). MEMORY_TAG (see context.h) saves and restores it,
+// so tags nest like a stack and new threads inherit the tag of their parent. Each allocation remembers its tag
+// (in spare bits of the header), so reallocating or freeing it later counts against the same tag, whatever the
+// current one is at that point.
+//
+// Like the allocator stats these cost a few atomic adds per allocation and are gone with FORCE_NO_ALLOCATOR_STATS.
+// Note: Memory released with free_all() (arenas, the temporary allocator) isn't subtracted since we don't know
+//       what was in it. Tag the memory you free one block at a time.
+//
+struct memory_tag_stats {
+    const utf8 *Name;
+
+    s64 CurrentBytes;  // Requested by the user (doesn't include headers and padding)
+    s64 PeakBytes;
+
+    s64 AllocationCount;
+    s64 FreeCount;
+
+    s64 Budget;  // 0 if there is no budget, see memory_tag_set_budget()
+};
+
+// Returns the tag with _name_, the first call with a new name adds it. The name isn't copied (pass a literal).
+// When all MEMORY_TAG_COUNT tags are taken this returns 0.
+u8 memory_tag_get(const utf8 *name);
+
+// We print a warning every time the current bytes of _tag_ go over _bytes_. 0 removes the budget.
+void memory_tag_set_budget(u8 tag, s64 bytes);
+
+// Returns a snapshot of the stats of _tag_ (all zeroes if stats are disabled).
+memory_tag_stats memory_tag_get_stats(u8 tag);
+
+// Prints the stats of every tag which has allocated something to Context.Log.
+void memory_tag_print_stats();
+
+//
+// Sampled allocation profiler.
+//
+// While running, roughly every _sampleRate_ allocated bytes the call stack of the allocating thread is captured and
+// attributed an estimate of the bytes allocated from that place. Small allocations are therefore almost free and large
+// ones are (almost) always sampled. The gap between samples is randomized (exponentially distributed) so periodic
+// allocation patterns don't get over- or under-counted.
+//
+// The result is printed in the "collapsed stack" format (one line per unique stack: "outer;inner;leaf <bytes>")
+// which flamegraph.pl, speedscope and friends read directly.
+//
+inline constexpr s64 ALLOCATION_PROFILER_MAX_FRAMES = 32;
+
+// 0 means the profiler isn't running. Don't set this directly, use allocation_profiler_start().
+inline s64 AllocationProfilerSampleRate = 0;
+
+void allocation_profiler_start(s64 sampleRate = 512_KiB);
+void allocation_profiler_stop();
+
+// Drops all samples collected so far (the profiler keeps running if it was started).
+void allocation_profiler_reset();
+
+// Prints the collected samples to Context.Log. Resolving symbols is slow, so do this at the end of the program.
+void allocation_profiler_print_collapsed();
+
+// Called by general_allocate() when the profiler is running.
+void allocation_profiler_maybe_sample(s64 userSize);
+
 //
 // Allocators don't allocate with os_allocate_block() but instead should require the programmer to have already passed
 // a block of memory (a pool) which they divide into smaller allocations. The pool may be allocated by another allocator
@@ -452,6 +719,11 @@ inline void *allocator_pool_remove_from_linked_list(allocator_pool **base, alloc
 
 struct tlsf_allocator_data {
     tlsf_t State = null;  // We use a vendor library that implements the algorithm.
+
+    // Linked list of the pools which were added. Each one starts with this header, the rest is handed to tlsf
+    // (the first pool also holds _State_). We keep them around for FREE_ALL and tlsf_trim().
+    allocator_pool *Base = null;
+    s64 PoolsCount = 0;
 };
 
 // Two-Level Segregated Fit memory allocator implementation. Wrapper around tlsf.h/cpp (in vendor folder),
@@ -461,9 +733,118 @@ struct tlsf_allocator_data {
 // * Extremely low overhead per allocation (4 bytes)
 // * Low overhead per TLSF management of pools (~3kB)
 // * Low fragmentation
+// * FREE_ALL is O(number of pools), it builds the free lists from scratch, one free block per pool
 //
+// The first pool can't be removed while there are others (_State_ lives in it).
 void *tlsf_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
 
+//
+// Trimming: allocators never give pools back by themselves, after a peak the memory stays committed even if it's
+// all free again. These walk the pools and purge the pages which are fully inside free space (os_purge_memory()),
+// the OS takes the memory back but the addresses stay valid, touching them again just faults in fresh pages.
+// Nothing is moved, so live blocks are untouched. They return how many bytes were purged. See also arena_trim().
+//
+// These aren't thread-safe, call them where you would call the allocator (under the same lock if it's shared).
+// Free space at the start and end of a block which isn't a whole page stays, so this only pays off for
+// large free ranges (e.g. a pool that emptied out after a spike).
+//
+s64 tlsf_trim(tlsf_allocator_data *data);
+
+// Starts a thread which calls _trim(userData)_ every _intervalMs_ until allocator_trimmer_stop(), e.g.
+//
+//     allocator_trimmer_start(5000, [](void *) {
+//         thread::scoped_lock _(&HeapMutex);
+//         tlsf_trim(&Heap);
+//     });
+//
+// With null it trims the persistent allocator (which has a lock of its own). There is one trimmer thread,
+// starting it again restarts it with the new function.
+void allocator_trimmer_start(u32 intervalMs, void (*trim)(void *) = null, void *userData = null);
+void allocator_trimmer_stop();
+
+// Size classes are 16, 24, 32, 48, 64, 96, 128, ... 4096 (every power of 2 and the value halfway to the next one).
+// Note that the size the allocator sees includes the allocation header and the alignment padding (see general_allocate).
+inline constexpr s64 SLAB_SIZE_CLASS_COUNT = 17;
+inline constexpr s64 SLAB_MAX_BLOCK_SIZE = 4096;
+
+struct slab_allocator_data {
+    allocator_pool *Base = null;  // Linked list of pools, slabs are carved out of these.
+    s64 PoolsCount = 0;
+
+    // Each time a size class runs out of blocks we take a slab of this size from a pool.
+    // Change this before the first allocation. Must be at least SLAB_MAX_BLOCK_SIZE.
+    s64 SlabSize = 16_KiB;
+
+    // Freed blocks are pushed here (the first 8 bytes of a free block point to the next free block).
+    void *FreeLists[SLAB_SIZE_CLASS_COUNT] = {};
+
+    // We don't split a new slab into blocks up front, we bump a pointer until it's exhausted.
+    // This way we don't touch memory which we haven't handed out yet.
+    byte *SlabCurrent[SLAB_SIZE_CLASS_COUNT] = {};
+    byte *SlabEnd[SLAB_SIZE_CLASS_COUNT] = {};
+};
+
+//
+// Slab allocator.
+//
+// Meant for lots of small allocations (e.g. nodes, small arrays and strings) where tlsf's general
+// purpose search and block splitting is measureable. Every allocation is rounded up to a size class
+// and blocks of one class are served from a slab dedicated to it.
+//
+// * O(1) cost for alloc and free (pop/push on a free list, we get the class from _oldSize_)
+// * O(1) FREE_ALL (well, O(number of pools) - we just reset the lists and the pools)
+// * RESIZE succeeds only when the new size fits in the same size class
+// * No per-block overhead other than rounding up to the size class
+//
+// Requests larger than SLAB_MAX_BLOCK_SIZE fail (return null), use tlsf for those.
+// Like the arena allocator this one doesn't handle running out of pools - add another with allocator_add_pool().
+//
+// Memory of a slab is never given back to the pool (unless you call FREE_ALL), so a size class
+// which had a lot of allocations at some point keeps its slabs.
+void *slab_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
+struct pool_allocator_data {
+    allocator_pool *Base = null;  // Linked list of pools, elements are carved out of these.
+    s64 PoolsCount = 0;
+
+    // The size of every block handed out. Note that this is the size the allocator sees, which includes the
+    // allocation header and the alignment padding, use pool_allocator_element_size() to calculate it.
+    // Set this before the first allocation (and don't change it while there are live blocks).
+    s64 ElementSize = 0;
+
+    // Freed elements are pushed here (the first 8 bytes of a free element point to the next free element).
+    void *FreeList = null;
+};
+
+// Returns the size of the block general_allocate() requests for an allocation of _userSize_ bytes with _alignment_.
+// This is an upper bound (it assumes the largest header), so it's safe to use in all configurations.
+inline s64 pool_allocator_element_size(s64 userSize, u32 alignment = POINTER_SIZE) {
+    alignment = alignment < POINTER_SIZE ? POINTER_SIZE : alignment;
+
+    s64 result = userSize + alignment + sizeof(allocation_header) + (sizeof(allocation_header) % alignment);
+#if defined DEBUG_MEMORY
+    result += NO_MANS_LAND_SIZE;
+#endif
+    return (result + POINTER_SIZE - 1) & ~(POINTER_SIZE - 1);  // So free list links are aligned
+}
+
+// Returns true if the next ALLOCATE can be served without adding another pool.
+bool pool_allocator_has_room(pool_allocator_data *data);
+
+//
+// Pool allocator.
+//
+// Hands out blocks of a single size (data->ElementSize). Use it for things which get allocated and
+// freed at a high rate and are the same size (tree nodes, records, etc.). See also object_pool<T> in object_pool.h.
+//
+// * O(1) cost for alloc and free (pop/push on the free list)
+// * No per-block overhead except the allocation header which general_allocate() puts anyway
+// * RESIZE succeeds in place when the new size still fits in an element
+//
+// Requests larger than ElementSize fail (return null).
+// Like the arena allocator this one doesn't handle running out of pools - add another with allocator_add_pool().
+void *pool_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
 //
 // General purpose allocator.
 //
@@ -497,8 +878,97 @@ struct arena_allocator_data {
 // This is the simplest but not the best behaviour in some cases.
 // Be wary that if you have many pools performance will not be optimal. In that case I suggest
 // writing a specialized allocator (by taking arena_allocator as an example - implemented in arena_allocator.cpp).
+//
+// RESIZE and FREE work in place only for the last block bumped from its pool (which is the common case when
+// building a string or pushing to an array in the temporary allocator). Otherwise RESIZE returns null
+// (and the block gets moved) and FREE does nothing.
 void *arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
 
+// A saved position in an arena. See arena_mark() and arena_rewind().
+struct arena_marker {
+    allocator_pool *Pool = null;  // The last pool which had something allocated in it, null if the arena was empty
+    s64 Used = 0;
+    s64 TotalUsed = 0;
+};
+
+// Use these to treat an arena as a stack of scratch memory for nested operations, e.g.
+//
+//     auto mark = arena_mark(Context.TempAlloc);
+//     defer(arena_rewind(Context.TempAlloc, mark));
+//
+// Everything allocated after the mark is freed by the rewind (without freeing all of the arena).
+// Note: Allocations made after the mark which ended up in a pool before the marked one (because there was space
+//       left there, see how ALLOCATE searches pools) stay allocated until free_all. They are not corrupted, just not reclaimed.
+arena_marker arena_mark(arena_allocator_data *data);
+void arena_rewind(arena_allocator_data *data, arena_marker marker);
+
+// For allocators which use arena_allocator_data as their context (arena_allocator and default_temp_allocator, e.g. Context.TempAlloc)
+inline arena_marker arena_mark(allocator alloc) { return arena_mark((arena_allocator_data *) alloc.Context); }
+inline void arena_rewind(allocator alloc, arena_marker marker) { arena_rewind((arena_allocator_data *) alloc.Context, marker); }
+
+// Purges what's after _Used_ in each pool (see tlsf_trim()), call it after a FREE_ALL (or arena_rewind()) of a spike
+s64 arena_trim(arena_allocator_data *data);
+
+struct virtual_arena_allocator_data {
+    byte *Base = null;   // Start of the reserved range, null if nothing has been reserved yet
+    s64 Reserved = 0;    // Size of the reserved address space
+    s64 Committed = 0;   // How much (from the start) is backed by memory
+    s64 Used = 0;
+};
+
+// By default the first allocation reserves this much address space (it doesn't cost memory until it's used).
+inline constexpr s64 VIRTUAL_ARENA_DEFAULT_RESERVE = 16_GiB;
+
+// We commit at least this much at once in order to not call the OS very often.
+inline constexpr s64 VIRTUAL_ARENA_COMMIT_GRANULARITY = 64_KiB;
+
+//
+// Virtual memory arena allocator.
+//
+// Same as the arena allocator (bumps a pointer, FREE_ALL resets it), but instead of pools it reserves a large
+// range of address space and commits pages on demand. This means that it grows contiguously and never runs out
+// of space (until the reservation is exhausted) and that ALLOCATE doesn't search a list of pools.
+//
+// This is an exception to :BigPhilosophyTime: - the allocator itself calls the OS to commit memory, that's the whole point.
+// Since there are no pools, ADD_POOL and REMOVE_POOL are not supported. Call virtual_arena_reserve() to
+// specify the size of the reservation, otherwise the first allocation reserves VIRTUAL_ARENA_DEFAULT_RESERVE.
+//
+// Like the arena allocator, RESIZE and FREE work in place only for the last allocated block.
+// FREE_ALL doesn't decommit the memory (we expect it to be reused), call virtual_arena_decommit() for that.
+void *virtual_arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
+// Reserves the address space for the arena. Must be called before any allocations.
+void virtual_arena_reserve(virtual_arena_allocator_data *data, s64 size);
+
+// Gives back all committed memory beyond what is currently used (rounded up to VIRTUAL_ARENA_COMMIT_GRANULARITY).
+void virtual_arena_decommit(virtual_arena_allocator_data *data);
+
+// Releases the reservation and the registry slot of the arena. All memory allocated with the arena becomes invalid.
+void virtual_arena_release(virtual_arena_allocator_data *data);
+
+//
+// Guard page allocator, a debug tool for catching buffer overruns (like Electric Fence).
+//
+// Every block gets its own pages from the OS and is placed so that it ends right before a page which isn't
+// committed (PROT_NONE on POSIX), so writing or reading past the end faults on the spot instead of
+// being noticed (maybe) the next time no man's land is checked. Accesses inside the block cost nothing extra.
+//
+// general_allocate() packs the allocation against the end of the block, so the fault happens on the first byte
+// after it when the size is a multiple of the alignment, otherwise after at most _alignment_ - 1 bytes of padding
+// (no man's land fills the first bytes of that with DEBUG_MEMORY).
+//
+// FREE gives the pages back to the OS, so touching a freed block faults as well. RESIZE always fails (the end of
+// the block must stay on the guard page), so reallocations move. There is no FREE_ALL.
+//
+// This is an exception to :BigPhilosophyTime: - each block costs at least two pages (64 KiB of address space on Windows)
+// and a few system calls, so push it around the big allocations you suspect, e.g.
+//
+//     PUSH_ALLOC(allocator(guard_page_allocator)) {
+//         pixels = allocate_array<u32>(width * height);
+//     }
+//
+void *guard_page_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
 //
 // :TemporaryAllocator: See context.h
 //
@@ -517,4 +987,85 @@ void *arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMem
 //
 void *default_temp_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
 
+inline constexpr s64 FRAME_ALLOCATOR_MAX_BUFFERS = 4;
+
+struct frame_allocator_data {
+    arena_allocator_data Arenas[FRAME_ALLOCATOR_MAX_BUFFERS];
+
+    // How many frames an allocation stays alive (2 means double buffering). Change this before the first allocation.
+    s64 BufferCount = 2;
+    s64 Current = 0;  // The arena we are allocating from this frame
+};
+
+//
+// N-buffered temporary allocator.
+//
+// Like default_temp_allocator (each buffer is one and grows by itself) but FREE_ALL doesn't free everything.
+// Instead it rotates to the next buffer and clears only that one (the oldest). So memory allocated in a frame
+// stays valid for _BufferCount_ - 1 more calls to free_all. Use this when results of one frame are consumed
+// by the next stage in the following frame and you don't want to copy them to a longer-lived allocator.
+//
+// To use it as the temporary allocator of a thread:
+//
+//     auto newContext = Context;
+//     newContext.TempAlloc = {frame_allocator, (void *) &__FrameTempAllocData};
+//     OVERRIDE_CONTEXT(newContext);
+//
+// Note: FREE and RESIZE work in place only for the last block of the current frame (a block from an older
+//       frame gets moved by RESIZE and stays allocated on FREE until its buffer comes around again).
+// Note: Use arena_mark(frame_allocator_current_arena(...)) instead of arena_mark() directly on the allocator.
+void *frame_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
+inline arena_allocator_data *frame_allocator_current_arena(frame_allocator_data *data) { return &data->Arenas[data->Current]; }
+
+struct concurrent_arena_allocator_data {
+    allocator_pool *Base = null;     // Linked list of pools, only ever appended to
+    allocator_pool *Current = null;  // The pool we bump from, the ones before it are full
+
+    // The size of the pools we add when we run out (bigger if a single block needs more).
+    // Change these before the first allocation.
+    s64 PoolSize = 1_MiB;
+    s64 ChunkSize = 16_KiB;  // How much a thread takes for itself at once, see below
+
+    s64 PoolsCount = 0;
+    s64 TotalUsed = 0;   // Bytes taken from the pools, including the parts of chunks threads haven't used yet
+    s64 Generation = 0;  // Changed by FREE_ALL, so threads drop the chunks they had
+
+    s32 GrowLock = 0;
+};
+
+//
+// Thread-safe arena allocator.
+//
+// The arena allocator bumps _Used_ of its pools with plain arithmetic, so one arena can't be shared by
+// threads, and Context.TempAlloc is per thread. Allocate with this one when jobs produce results which outlive
+// the job (e.g. the outputs of parallel_for pieces which the calling thread combines) and free them all at once.
+//
+//     concurrent_arena_allocator_data resultsData;
+//     allocator results = {concurrent_arena_allocator, &resultsData};
+//
+//     parallel_for(range(n), 0, [&](s64 it) {
+//         auto *r = allocate<result>({.Alloc = results});
+//         ...
+//     });
+//     ...
+//     free_all(results);                       // Not while anyone is still allocating
+//     concurrent_arena_release(&resultsData);  // Gives the pools back
+//
+// Every thread takes a chunk of _ChunkSize_ bytes at a time from the current pool with one atomic add and
+// bumps inside it without touching anything shared, so threads don't fight over the pool's cursor on every
+// allocation. Blocks bigger than a quarter of a chunk are bumped from the pool directly. When the pool is
+// full we add one of _PoolSize_ (with os_allocate_block()), adding is the only thing which takes a lock.
+//
+// * RESIZE and FREE work in place only for the last block a thread bumped from its chunk
+// * FREE_ALL resets the pools but keeps them, it must not run at the same time as allocations
+// * ADD_POOL and REMOVE_POOL aren't supported, the allocator manages its own pools
+//
+// A thread remembers chunks of a few arenas at once, an arena it hasn't used for a while costs it a new chunk
+// (and the rest of the old one stays unused until FREE_ALL).
+void *concurrent_arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options);
+
+// Frees the pools and the registry slot of the arena. All memory allocated with the arena becomes invalid.
+void concurrent_arena_release(concurrent_arena_allocator_data *data);
+
 LSTD_END_NAMESPACE
@@ -11,6 +11,17 @@ LSTD_BEGIN_NAMESPACE
 #pragma warning(disable : 4146)
 #endif
 
+// Returns the pool in which _block_ is the block which was bumped last, null if it's not.
+file_scope allocator_pool *arena_find_last_block_pool(arena_allocator_data *data, void *block, s64 size) {
+    auto *p = data->Base;
+    while (p) {
+        byte *end = (byte *) (p + 1) + p->Used;
+        if ((byte *) block + size == end && (byte *) block >= (byte *) (p + 1)) return p;
+        p = p->Next;
+    }
+    return null;
+}
+
 void *arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
     auto *data = (arena_allocator_data *) context;
 
@@ -56,17 +67,29 @@ void *arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMem
             return result;
         }
         case allocator_mode::RESIZE: {
-            // Implementing a fast RESIZE requires finding in which block the memory is in.
-            // We might store a header which tells us that but right now I don't think it's worth it.
-            // We simply return null and let the reallocate function allocate a new block and copy the contents.
+            // We can resize in place only the last block in a pool (by moving the pointer).
+            // For other blocks we return null and let the reallocate function allocate a new block and copy the contents.
             //
             // If you are dealing with very very large blocks and copying is expensive, you should
             // implement a specialized allocator. If you are dealing with appending to strings
             // (which causes string to try to reallocate), we provide a string_builder utility which will help with that.
-            return null;
+            auto *p = arena_find_last_block_pool(data, oldMemory, oldSize);
+            if (!p) return null;
+
+            if (p->Used - oldSize + size > p->Size) return null;  // Not enough space
+
+            p->Used += size - oldSize;
+            data->TotalUsed += size - oldSize;
+
+            return oldMemory;
         }
         case allocator_mode::FREE: {
-            // We don't free individual allocations in the arena allocator
+            // We don't free individual allocations in the arena allocator, unless it's the last block in a pool
+            auto *p = arena_find_last_block_pool(data, oldMemory, oldSize);
+            if (p) {
+                p->Used -= oldSize;
+                data->TotalUsed -= oldSize;
+            }
 
             // null means success FREE
             return null;
@@ -84,12 +107,94 @@ void *arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMem
             // (void *) -1 means that the allocator doesn't support FREE_ALL (by design)
             return null;
         }
+        case allocator_mode::ALLOCATE_BATCH: {
+            auto **out = (void **) oldMemory;
+            auto **end = out + oldSize;
+
+            // Bump as many blocks as fit from each pool, in order
+            auto *p = data->Base;
+            while (p && out != end) {
+                byte *usable = (byte *) (p + 1);
+                while (out != end && p->Used + size < p->Size) {
+                    *out++ = usable + p->Used;
+                    p->Used += size;
+                    data->TotalUsed += size;
+                }
+                p = p->Next;
+            }
+            return out;
+        }
+        case allocator_mode::FREE_BATCH: {
+            // Same as FREE but from the back, so a batch which was allocated last gets reclaimed entirely
+            auto **blocks = (void **) oldMemory;
+            for (s64 i = oldSize - 1; i >= 0; --i) {
+                auto *p = arena_find_last_block_pool(data, blocks[i], size);
+                if (p) {
+                    p->Used -= size;
+                    data->TotalUsed -= size;
+                }
+            }
+            return null;
+        }
         default:
             assert(false);
     }
     return null;
 }
 
+arena_marker arena_mark(arena_allocator_data *data) {
+    arena_marker result;
+    result.TotalUsed = data->TotalUsed;
+
+    auto *p = data->Base;
+    while (p) {
+        if (p->Used) {
+            result.Pool = p;
+            result.Used = p->Used;
+        }
+        p = p->Next;
+    }
+    return result;
+}
+
+void arena_rewind(arena_allocator_data *data, arena_marker marker) {
+    // Everything after the marked position in the marked pool and everything in later pools gets freed
+    bool rewinding = !marker.Pool;
+
+    auto *p = data->Base;
+    while (p) {
+        s64 newUsed = -1;
+        if (p == marker.Pool) {
+            assert(p->Used >= marker.Used && "Rewinding to a mark which is ahead of the arena. Did you call free_all after making the mark?");
+            newUsed = marker.Used;
+            rewinding = true;
+        } else if (rewinding) {
+            newUsed = 0;
+        }
+
+        if (newUsed != -1 && newUsed != p->Used) {
+#if defined DEBUG_MEMORY
+            // Remove the freed allocations from the linked list so we don't corrupt the heap
+            if (DEBUG_memory) DEBUG_memory->unlink_headers_in_range((byte *) (p + 1) + newUsed, (byte *) (p + 1) + p->Used);
+#endif
+            data->TotalUsed -= p->Used - newUsed;
+            p->Used = newUsed;
+        }
+        p = p->Next;
+    }
+
+    // Allocations after the mark which landed in earlier pools aren't reclaimed (see comment in allocator.h)
+    assert(data->TotalUsed >= marker.TotalUsed);
+}
+
+s64 arena_trim(arena_allocator_data *data) {
+    s64 purged = 0;
+    for (auto *p = data->Base; p; p = p->Next) {
+        if (p->Used < p->Size) purged += os_purge_memory((byte *) (p + 1) + p->Used, p->Size - p->Used);
+    }
+    return purged;
+}
+
 void *default_temp_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
     auto *data = (arena_allocator_data *) context;
 
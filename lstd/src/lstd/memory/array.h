@@ -38,6 +38,9 @@ struct array {
     s64 Count = 0;
     s64 Allocated = 0;
 
+    // An empty array is all zeroes, allocate_array() doesn't call the constructor (see construct_elements())
+    static constexpr bool ZERO_CONSTRUCT = true;
+
     constexpr array() {}
     constexpr array(T *data, s64 count) : Data(data), Count(count), Allocated(0) {}
     constexpr array(const initializer_list<T> &items) {
@@ -110,27 +113,90 @@ void destroy_at(T *at) {
     }
 }
 
+// True for array types which can keep their elements inside the object itself (small_array, see small_array.h)
+template <typename T>
+concept array_has_inline_storage = requires(T t) {
+    {t.INLINE_COUNT};
+    {t.Storage};
+};
+
+// True if the array's elements are currently in its inline storage.
+// That memory is part of the object itself, so we never free or reallocate it.
+constexpr bool array_is_inline(const is_array auto &arr) {
+    if constexpr (array_has_inline_storage<types::remove_cvref_t<decltype(arr)>>) {
+        return (const void *) arr.Data == (const void *) arr.Storage;
+    } else {
+        return false;
+    }
+}
+
+// How much an array grows when it runs out of space, see array_reserve().
+enum class array_growth : u8 {
+    DEFAULT = 0,   // DOUBLE for small buffers, ONE_AND_HALF rounded up to whole pages once the buffer is larger than ARRAY_LARGE_BUFFER_SIZE
+    DOUBLE,        // The next power of two bigger than the required count (starting at 8)
+    ONE_AND_HALF,  // 1.5x the current size (at least the required count), wastes less memory for big buffers
+    EXACT          // Exactly the required count, use this when you know the final size
+};
+
+inline constexpr s64 ARRAY_LARGE_BUFFER_SIZE = 1_MiB;
+inline constexpr s64 ARRAY_PAGE_SIZE = 4_KiB;
+
+// Returns the number of elements to allocate when an array with _allocated_ elements needs at least _required_.
+constexpr s64 array_grow_target(s64 allocated, s64 required, s64 elementSize, array_growth growth) {
+    if (growth == array_growth::DEFAULT) {
+        growth = required * elementSize > ARRAY_LARGE_BUFFER_SIZE ? array_growth::ONE_AND_HALF : array_growth::DOUBLE;
+
+        if (growth == array_growth::ONE_AND_HALF) {
+            // Round to pages, so big allocations which come straight from the OS don't waste the tail of the last one
+            s64 bytes = max(required, allocated + allocated / 2) * elementSize;
+            bytes = (bytes + ARRAY_PAGE_SIZE - 1) / ARRAY_PAGE_SIZE * ARRAY_PAGE_SIZE;
+            return bytes / elementSize;
+        }
+    }
+
+    if (growth == array_growth::DOUBLE) return max(ceil_pow_of_2(required + 1), 8);
+    if (growth == array_growth::ONE_AND_HALF) return max(max(required, allocated + allocated / 2), 8);
+    return required;
+}
+
 // Makes sure the array has reserved enough space for at least _n_ new elements.
-// This may reserve way more than required. The reserve amount is equal to the next power of two bigger than (_n_ + Count), starting at 8.
+// This may reserve more than required, depending on _growth_ (see array_growth), by default the reserve amount is
+// the next power of two bigger than (_n_ + Count), starting at 8, and for large buffers it grows by 1.5x in whole pages.
 //
-// Allocates a buffer (using the Context's allocator) if the array hasn't already allocated.
+// Allocates a buffer (using _alloc_, or the Context's allocator if that's null) if the array hasn't already allocated.
 // If this object is just a view (Allocated == 0) i.e. this is the first time it is allocating, the old
 // elements are copied (again, we do a simple bytes copy, we don't handle copy constructors).
-void array_reserve(is_array auto &arr, s64 n) {
-    if (arr.Count + n < arr.Allocated) return;
-
-    s64 target = max(ceil_pow_of_2(n + arr.Count + 1), 8);
-
-    if (arr.Allocated) {
+//
+// Growing goes through reallocate_array() which first asks the allocator to resize the block in place
+// and only copies if that fails. Huge append-only buffers should be allocated from a virtual arena
+// (see virtual_arena_allocator), there the last block grows by committing more pages, without copying.
+//
+// The buffer always grows with the allocator it was first allocated with (_alloc_ is ignored after that),
+// so reserving once with an allocator binds the array to it, no need for PUSH_ALLOC around every append.
+void array_reserve(is_array auto &arr, s64 n, array_growth growth = array_growth::DEFAULT, allocator alloc = {}) {
+    if (arr.Count + n <= arr.Allocated) return;
+
+    using T = types::remove_pointer_t<decltype(arr.Data)>;
+    s64 target = array_grow_target(arr.Allocated, arr.Count + n, sizeof(T), growth);
+
+    if (array_is_inline(arr)) {
+        // Spill out of the inline storage of a small_array
+        auto *oldInline = arr.Data;
+        arr.Data = allocate_array<T>(target, {.Alloc = alloc});
+        if (arr.Count) copy_elements(arr.Data, oldInline, arr.Count);
+    } else if (arr.Allocated) {
         arr.Data = reallocate_array(arr.Data, target);
     } else {
         auto *oldView = arr.Data;
-        arr.Data = allocate_array<types::remove_pointer_t<decltype(arr.Data)>>(target);
+        arr.Data = allocate_array<T>(target, {.Alloc = alloc});
         if (arr.Count) copy_elements(arr.Data, oldView, arr.Count);
     }
     arr.Allocated = target;
 }
 
+// Reserves exactly enough space for _n_ more elements (if there isn't enough already).
+void array_reserve_exact(is_array auto &arr, s64 n) { array_reserve(arr, n, array_growth::EXACT); }
+
 // Call destructor on each element if the buffer is allocated.
 // Don't free the buffer, just move Count to 0
 void array_reset(is_array auto &arr) {
@@ -147,9 +213,18 @@ void array_reset(is_array auto &arr) {
 // Free any memory and reset Count.
 void free(is_array auto &arr) {
     array_reset(arr);
+    if (array_is_inline(arr)) return;
+
     if (arr.Allocated) free(arr.Data);
-    arr.Data = null;
-    arr.Allocated = 0;
+
+    if constexpr (array_has_inline_storage<types::remove_cvref_t<decltype(arr)>>) {
+        // Small arrays go back to their inline storage
+        arr.Data = (decltype(arr.Data)) arr.Storage;
+        arr.Allocated = arr.INLINE_COUNT;
+    } else {
+        arr.Data = null;
+        arr.Allocated = 0;
+    }
 }
 
 // Checks if there is enough reserved space for _n_ elements
@@ -187,20 +262,27 @@ auto *array_insert_at(T &arr, s64 index, const array_data_t<T> &element) {
 // clone(arr.insert(index), toBeCloned);
 //
 // Because _insert_ returns a pointer where the object is placed, clone() can place the deep copy there directly.
-auto *array_insert_at(is_array auto &arr, s64 index) { return insert(arr, index, {}); }
+auto *array_insert_at(is_array auto &arr, s64 index) { return array_insert_at(arr, index, {}); }
 
-// Insert a buffer of elements at a specified index.
-template <is_array T>
-auto *array_insert_at(T &arr, s64 index, const array_data_t<T> *ptr, s64 size) {
-    array_reserve(arr, size);
+// Makes space for _n_ elements at _index_ (moving the following elements forward) and returns a pointer to it in the buffer.
+// The new elements are not initialized, write to them directly.
+auto *array_insert_uninitialized(is_array auto &arr, s64 index, s64 n) {
+    array_reserve(arr, n);
 
     s64 offset = translate_index(index, arr.Count, true);
     auto *where = arr.Data + offset;
     if (offset < arr.Count) {
-        copy_elements(where + size, where, arr.Count - offset);
+        copy_elements(where + n, where, arr.Count - offset);
     }
+    arr.Count += n;
+    return where;
+}
+
+// Insert a buffer of elements at a specified index.
+template <is_array T>
+auto *array_insert_at(T &arr, s64 index, const array_data_t<T> *ptr, s64 size) {
+    auto *where = array_insert_uninitialized(arr, index, size);
     copy_elements(where, ptr, size);
-    arr.Count += size;
     return where;
 }
 
@@ -209,8 +291,7 @@ template <typename T>
 auto *array_insert_at(T &arr, s64 index, T &arr2) { return array_insert_at(arr, index, arr2.Data, arr2.Count); }
 
 // Removes element at specified index and moves following elements back
-template <typename T>
-void array_remove_at(array<T> &arr, s64 index) {
+void array_remove_at(is_array auto &arr, s64 index) {
     // If the array is a view, we don't want to modify the original!
     if (!arr.Allocated) array_reserve(arr, 0);
 
@@ -241,7 +322,7 @@ void array_remove(T &arr, const array_data_t<T> &element) {
 
     assert(index != -1 && "Element not in list");
 
-    string_remove_at(arr, index);
+    array_remove_at(arr, index);
 }
 
 // Removes element at specified index and moves the last element to the empty slot.
@@ -291,6 +372,14 @@ auto *array_append(T &arr, const array_data_t<T> &element) { return array_insert
 // Because _append_ returns a pointer where the object is placed, clone() can place the deep copy there directly.
 auto *array_append(is_array auto &arr) { return array_append(arr, {}); }
 
+// Grows the array by _n_ elements and returns a pointer to the first one.
+// The new elements are not initialized, write to them directly, e.g. when assembling a packet:
+//
+//     auto *header = (packet_header *) array_append_uninitialized(buffer, sizeof(packet_header));
+//     header->Size = ...;
+//
+auto *array_append_uninitialized(is_array auto &arr, s64 n) { return array_insert_uninitialized(arr, arr.Count, n); }
+
 // Appends a buffer of elements to the end and returns a pointer to it in the buffer
 template <is_array T>
 auto *array_append(T &arr, const array_data_t<T> *ptr, s64 size) { return array_insert_at(arr, arr.Count, ptr, size); }
@@ -299,41 +388,75 @@ auto *array_append(T &arr, const array_data_t<T> *ptr, s64 size) { return array_
 template <is_array T>
 auto *array_append(T &arr, T &arr2) { return array_insert_at(arr, arr.Count, arr2); }
 
-// Replace all occurences of a subarray from an array with another array
+// Replace all occurences of a subarray from an array with another array.
+//
+// We count the occurences first, so we know the final size and the work is done in a single pass:
+// when the result isn't larger we compact in place, otherwise we build it directly in a new buffer (one allocation).
+//
+// The arguments are views, so you can pass any array-like (stack arrays, strings, etc.) as the target and replacement.
 template <is_array T>
-void array_replace_all(T &arr, const T &arr2, const T &arr3) {
+void array_replace_all(T &arr, const array<array_data_t<T>> &arr2, const array<array_data_t<T>> &arr3) {
     if (!arr.Data || arr.Count == 0) return;
     if (!arr2.Data || arr2.Count == 0) return;
 
     if (arr3.Count) assert(arr3.Data);
 
+    using E = array_data_t<T>;
+
+    // We only search after the read position, which compacting in place hasn't touched yet
+    array<E> view(arr.Data, arr.Count);
+
+    s64 matches = 0;
+    for (s64 i = 0; i < view.Count && (i = find(view, arr2, i)) != -1; i += arr2.Count) ++matches;
+    if (!matches) return;
+
     s64 diff = arr3.Count - arr2.Count;
+    s64 newCount = arr.Count + matches * diff;
 
-    s64 i = 0;
-    while (i < arr.Count && (i = find(arr, arr2, i)) != -1) {
-        // We need to reserve in any case (even if the diff is 0 or negative),
-        // because we need to make sure we can modify the array (it's not a view).
-        array_reserve(arr, abs(diff));
+    bool inPlace = diff <= 0;
 
-        auto *data = arr.Data + i;
+    // Make sure we can modify the array (it's not a view)
+    if (inPlace && !arr.Allocated) array_reserve(arr, 0);
+    view.Data = arr.Data;
 
-        // Call the destructor on the old elements
-        For(range(arr2.Count)) {
-            destroy_at(data + it);
-        }
+    // We don't destroy the elements of a view, we don't own them
+    bool owned = arr.Allocated;
 
-        // Make space for the new elements
-        if (diff) {
-            copy_elements(data + arr3.Count, data + arr2.Count, arr.Count - i - arr2.Count);
-        }
+    E *dest = arr.Data;
+    s64 target = 0;
+    if (!inPlace) {
+        target = array_grow_target(0, newCount, sizeof(E), array_growth::DEFAULT);
 
-        // Copy replacement elements
-        copy_elements(data, arr3.Data, arr3.Count);
+        // Stay with the allocator of the old buffer (see array_reserve())
+        allocator alloc = owned && !array_is_inline(arr) ? allocation_get_allocator(arr.Data) : allocator{};
+        dest = allocate_array<E>(target, {.Alloc = alloc});
+    }
+
+    // Copy the parts in between matches and the replacements. When compacting in place _w_ never gets ahead of _r_.
+    s64 r = 0, w = 0;
+    while (true) {
+        s64 next = r < view.Count ? find(view, arr2, r) : -1;
+        s64 until = next == -1 ? arr.Count : next;
+
+        if (!inPlace || w != r) copy_elements(dest + w, arr.Data + r, until - r);
+        w += until - r;
 
-        arr.Count += diff;
+        if (next == -1) break;
+
+        if (owned) For(range(arr2.Count)) destroy_at(arr.Data + next + it);
+        copy_elements(dest + w, arr3.Data, arr3.Count);
+
+        w += arr3.Count;
+        r = next + arr2.Count;
+    }
+    assert(w == newCount);
 
-        i += arr3.Count;
+    if (!inPlace) {
+        if (owned && !array_is_inline(arr)) free(arr.Data);
+        arr.Data = dest;
+        arr.Allocated = target;
     }
+    arr.Count = newCount;
 }
 
 // Replace all occurences of an element from an array with another element.
@@ -348,7 +471,7 @@ void array_replace_all(T &arr, const array_data_t<T> &target, const array_data_t
 // Replace all occurences of an element from an array with an array.
 // Wrapper.
 template <is_array T>
-void array_replace_all(T &arr, const array_data_t<T> &target, const T &replace) {
+void array_replace_all(T &arr, const array_data_t<T> &target, const array<array_data_t<T>> &replace) {
     auto targetArr = to_stack_array(target);
     array_replace_all(arr, targetArr, replace);
 }
@@ -356,7 +479,7 @@ void array_replace_all(T &arr, const array_data_t<T> &target, const T &replace)
 // Replace all occurences of a subarray from an array with an element.
 // Wrapper.
 template <is_array T>
-void array_replace_all(T &arr, const T &target, const array_data_t<T> &replace) {
+void array_replace_all(T &arr, const array<array_data_t<T>> &target, const array_data_t<T> &replace) {
     auto replaceArr = to_stack_array(replace);
     array_replace_all(arr, target, replaceArr);
 }
@@ -364,7 +487,7 @@ void array_replace_all(T &arr, const T &target, const array_data_t<T> &replace)
 // Removes all occurences of a subarray from an array
 // Wrapper.
 template <is_array T>
-void array_remove_all(T &arr, const T &target) {
+void array_remove_all(T &arr, const array<array_data_t<T>> &target) {
     array_replace_all(arr, target, {});  // Replace with an empty array
 }
 
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "array.h"
+#include "hash_set.h"
+#include "hash_table.h"
+
+#if ARCH == X86
+#include <emmintrin.h>
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Linear time algorithms over arrays, instead of loops over array_remove_at() (which move the rest of the array every time).
+//
+//     array_unique(ids);                                      // Drops repeated values, keeps the first of each (hash_set)
+//     array_unique_sorted(sortedIDs);                         // Same without the set, for sorted (or grouped) data
+//
+//     s64 alive = array_partition(entities, [](auto &e) { return e.Health > 0; });  // The alive ones go first
+//     array_stable_partition(tasks, [](auto &t) { return t.Urgent; });              // Same, both halves keep their order
+//
+//     hash_table<u32, array<order>> byCustomer;
+//     group_by(orders, [](auto &o) { return o.CustomerID; }, byCustomer);
+//
+//     sorted_intersection(a, b, common);                      // Appends to _common_
+//
+// Elements are moved around with copy_elements() and swap (shallow copies, see the note on copying in array.h),
+// the ones which get removed are destroyed like with array_remove_at().
+//
+// The sorted set operations take two sorted arrays without duplicates and append the result to _out_ (which must be
+// neither of them), in order, and return how many elements they added. They compare with operator<, intersecting
+// u32 and u64 arrays compares blocks of 4 (or 2) elements with each other with SIMD.
+//
+
+// Removes every element which is equal to an earlier one, the rest keep their order. Returns how many were removed.
+// Uses a hash_set of the elements (so they need get_hash(), see hash.h) allocated with the Context's allocator.
+template <is_array T>
+s64 array_unique(T &arr) {
+    using E = array_data_t<T>;
+
+    // If the array is a view, we don't want to modify the original!
+    if (!arr.Allocated) array_reserve(arr, 0);
+
+    hash_set<E> seen;
+    reserve(seen, arr.Count);
+    defer(free(seen));
+
+    s64 kept = 0;
+    For(range(arr.Count)) {
+        E *p = arr.Data + it;
+        if (!set_add(seen, *p)) {
+            destroy_at(p);
+            continue;
+        }
+        if (kept != it) copy_elements(arr.Data + kept, p, 1);
+        ++kept;
+    }
+
+    s64 removed = arr.Count - kept;
+    arr.Count = kept;
+    return removed;
+}
+
+// Removes every element which is equal to the one before it, so in a sorted array all duplicates.
+// Doesn't allocate. Returns how many were removed.
+template <is_array T>
+s64 array_unique_sorted(T &arr) {
+    if (!arr.Count) return 0;
+
+    // If the array is a view, we don't want to modify the original!
+    if (!arr.Allocated) array_reserve(arr, 0);
+
+    s64 kept = 1;
+    For(range(1, arr.Count)) {
+        auto *p = arr.Data + it;
+        if (*p == arr.Data[kept - 1]) {
+            destroy_at(p);
+            continue;
+        }
+        if (kept != it) copy_elements(arr.Data + kept, p, 1);
+        ++kept;
+    }
+
+    s64 removed = arr.Count - kept;
+    arr.Count = kept;
+    return removed;
+}
+
+// Moves the elements for which _pred(element)_ is true before the ones for which it's false.
+// Returns how many it was true for. Doesn't keep the order (see array_stable_partition()), but does at most n / 2 swaps.
+template <is_array_like Arr, typename Pred>
+s64 array_partition(Arr &arr, Pred &&pred) {
+    auto *first = arr.Data, *last = arr.Data + arr.Count;
+    while (true) {
+        while (first != last && pred(*first)) ++first;
+        while (first != last && !pred(*(last - 1))) --last;
+        if (first == last) break;
+
+        swap(*first, *(last - 1));
+        ++first, --last;
+    }
+    return first - arr.Data;
+}
+
+// Like array_partition() but both groups keep their order. Needs a buffer for the false ones, allocated with _alloc_
+// (the Context's allocator by default) and freed before returning.
+template <is_array_like Arr, typename Pred>
+s64 array_stable_partition(Arr &arr, Pred &&pred, allocator alloc = {}) {
+    using E = array_data_t<Arr>;
+
+    auto *scratch = allocate_array_uninitialized<E>(arr.Count, {.Alloc = alloc});
+    defer(free((void *) scratch));  // Not free(scratch), the elements were copied back and stay alive
+
+    s64 kept = 0, moved = 0;
+    For(range(arr.Count)) {
+        E *p = arr.Data + it;
+        if (pred(*p)) {
+            if (kept != it) copy_elements(arr.Data + kept, p, 1);
+            ++kept;
+        } else {
+            copy_elements(scratch + moved++, p, 1);
+        }
+    }
+    if (moved) copy_elements(arr.Data + kept, scratch, moved);
+    return kept;
+}
+
+// Appends each element of _arr_ to the array at _key(element)_ in _out_ (a hash_table from the key type to arrays
+// of the elements), adding the arrays which aren't there yet. Within a group the elements keep their order.
+// The arrays are allocated with the Context's allocator, free them (and then the table) when done.
+template <is_array_like Arr, typename Key, any_hash_table Table>
+void group_by(const Arr &arr, Key &&key, Table &out) {
+    For(arr) {
+        auto k = key(it);
+
+        auto *group = find(out, k).Value;
+        if (!group) group = add(out, k).Value;
+        array_append(*group, it);
+    }
+}
+
+namespace internal {
+// Matches 4 elements of _a_ against 4 of _b_ per step (all 16 pairs, rotating _b_), then moves on in the one whose
+// block ends first. Leaves what's left (less than a block of either) to the scalar loop. Only for arrays without
+// duplicates: an element of _a_ then matches at most one element of _b_, so it's never appended twice.
+template <typename T>
+s64 sorted_intersection_simd(const T *a, s64 na, const T *b, s64 nb, T *out, s64 &i, s64 &j) {
+    s64 count = 0;
+
+#if ARCH == X86
+    if constexpr (sizeof(T) == 4) {
+        while (i + 4 <= na && j + 4 <= nb) {
+            __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *) (b + j));
+
+            __m128i m = _mm_cmpeq_epi32(va, vb);
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+
+            s32 mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+            while (mask) {
+                out[count++] = a[i + lsb((u32) mask)];
+                mask &= mask - 1;
+            }
+
+            T aLast = a[i + 3], bLast = b[j + 3];
+            if (aLast <= bLast) i += 4;
+            if (bLast <= aLast) j += 4;
+        }
+    } else {
+        while (i + 2 <= na && j + 2 <= nb) {
+            __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *) (b + j));
+
+            // SSE2 only compares 32 bit lanes, a 64 bit lane is equal if both of its halves are
+            auto eq64 = [](__m128i x, __m128i y) {
+                __m128i e = _mm_cmpeq_epi32(x, y);
+                return _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+            };
+            __m128i m = _mm_or_si128(eq64(va, vb), eq64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+
+            s32 mask = _mm_movemask_pd(_mm_castsi128_pd(m));
+            while (mask) {
+                out[count++] = a[i + lsb((u32) mask)];
+                mask &= mask - 1;
+            }
+
+            T aLast = a[i + 1], bLast = b[j + 1];
+            if (aLast <= bLast) i += 2;
+            if (bLast <= aLast) j += 2;
+        }
+    }
+#elif ARCH == ARM && ANY_ARM_NEON
+    if constexpr (sizeof(T) == 4) {
+        const u32 bitValues[4] = {1, 2, 4, 8};
+        uint32x4_t bits = vld1q_u32(bitValues);
+
+        while (i + 4 <= na && j + 4 <= nb) {
+            uint32x4_t va = vld1q_u32((const u32 *) (a + i));
+            uint32x4_t vb = vld1q_u32((const u32 *) (b + j));
+
+            uint32x4_t m = vceqq_u32(va, vb);
+            m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 1)));
+            m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 2)));
+            m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 3)));
+
+            u32 mask = vaddvq_u32(vandq_u32(m, bits));
+            while (mask) {
+                out[count++] = a[i + lsb(mask)];
+                mask &= mask - 1;
+            }
+
+            T aLast = a[i + 3], bLast = b[j + 3];
+            if (aLast <= bLast) i += 4;
+            if (bLast <= aLast) j += 4;
+        }
+    } else {
+        const u64 bitValues[2] = {1, 2};
+        uint64x2_t bits = vld1q_u64(bitValues);
+
+        while (i + 2 <= na && j + 2 <= nb) {
+            uint64x2_t va = vld1q_u64((const u64 *) (a + i));
+            uint64x2_t vb = vld1q_u64((const u64 *) (b + j));
+
+            uint64x2_t m = vorrq_u64(vceqq_u64(va, vb), vceqq_u64(va, vextq_u64(vb, vb, 1)));
+
+            u64 mask = vaddvq_u64(vandq_u64(m, bits));
+            while (mask) {
+                out[count++] = a[i + lsb(mask)];
+                mask &= mask - 1;
+            }
+
+            T aLast = a[i + 1], bLast = b[j + 1];
+            if (aLast <= bLast) i += 2;
+            if (bLast <= aLast) j += 2;
+        }
+    }
+#endif
+    return count;
+}
+}  // namespace internal
+
+// Appends the elements which are in both _a_ and _b_ to _out_
+template <is_array_like Arr, is_array Out>
+s64 sorted_intersection(const Arr &a, const Arr &b, Out &out) {
+    using E = array_data_t<Arr>;
+
+    s64 before = out.Count;
+    array_reserve(out, min(a.Count, b.Count));
+
+    const E *pa = a.Data, *pb = b.Data;
+    E *dest = out.Data + out.Count;
+
+    s64 i = 0, j = 0, n = 0;
+    if constexpr (types::is_same<E, u32> || types::is_same<E, u64>) {
+        n = internal::sorted_intersection_simd(pa, a.Count, pb, b.Count, dest, i, j);
+    }
+
+    while (i < a.Count && j < b.Count) {
+        if (pa[i] < pb[j]) {
+            ++i;
+        } else if (pb[j] < pa[i]) {
+            ++j;
+        } else {
+            dest[n++] = pa[i];
+            ++i, ++j;
+        }
+    }
+
+    out.Count += n;
+    return out.Count - before;
+}
+
+// Appends the elements which are in _a_, _b_ or both to _out_
+template <is_array_like Arr, is_array Out>
+s64 sorted_union(const Arr &a, const Arr &b, Out &out) {
+    s64 before = out.Count;
+    array_reserve(out, a.Count + b.Count);
+
+    s64 i = 0, j = 0;
+    while (i < a.Count && j < b.Count) {
+        if (a.Data[i] < b.Data[j]) {
+            array_append(out, a.Data[i++]);
+        } else if (b.Data[j] < a.Data[i]) {
+            array_append(out, b.Data[j++]);
+        } else {
+            array_append(out, a.Data[i]);
+            ++i, ++j;
+        }
+    }
+    array_append(out, a.Data + i, a.Count - i);
+    array_append(out, b.Data + j, b.Count - j);
+
+    return out.Count - before;
+}
+
+// Appends the elements of _a_ which aren't in _b_ to _out_
+template <is_array_like Arr, is_array Out>
+s64 sorted_difference(const Arr &a, const Arr &b, Out &out) {
+    s64 before = out.Count;
+    array_reserve(out, a.Count);
+
+    s64 i = 0, j = 0;
+    while (i < a.Count && j < b.Count) {
+        if (a.Data[i] < b.Data[j]) {
+            array_append(out, a.Data[i++]);
+        } else if (b.Data[j] < a.Data[i]) {
+            ++j;
+        } else {
+            ++i, ++j;
+        }
+    }
+    array_append(out, a.Data + i, a.Count - i);
+
+    return out.Count - before;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "../internal/context.h"
+
+#if ARCH == X86
+#include <emmintrin.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Operations on runs of 64 bit words, used by bitset and bit_array below (and you can use them on your own bitmaps).
+// The binary ops go through 128 bits at a time with SSE2, so bulk intersections of big bitmaps are bound by memory bandwidth.
+//
+
+enum class bits_op : u8 { AND, OR, XOR, AND_NOT };
+
+// dst = a op b. _dst_ may be the same as _a_ or _b_.
+template <bits_op Op>
+void bits_apply(u64 *dst, const u64 *a, const u64 *b, s64 words) {
+    s64 i = 0;
+#if ARCH == X86
+    for (; i + 2 <= words; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+
+        __m128i r;
+        if constexpr (Op == bits_op::AND) r = _mm_and_si128(x, y);
+        if constexpr (Op == bits_op::OR) r = _mm_or_si128(x, y);
+        if constexpr (Op == bits_op::XOR) r = _mm_xor_si128(x, y);
+        if constexpr (Op == bits_op::AND_NOT) r = _mm_andnot_si128(y, x);  // Note: _mm_andnot_si128 negates the first argument
+        _mm_storeu_si128((__m128i *) (dst + i), r);
+    }
+#endif
+    for (; i < words; ++i) {
+        if constexpr (Op == bits_op::AND) dst[i] = a[i] & b[i];
+        if constexpr (Op == bits_op::OR) dst[i] = a[i] | b[i];
+        if constexpr (Op == bits_op::XOR) dst[i] = a[i] ^ b[i];
+        if constexpr (Op == bits_op::AND_NOT) dst[i] = a[i] & ~b[i];
+    }
+}
+
+inline s64 bits_pop_count(const u64 *words, s64 count) {
+    s64 result = 0;
+    For(range(count)) result += pop_count(words[it]);
+    return result;
+}
+
+// Returns the index of the first set bit at or after _start_, or -1 if there are none.
+inline s64 bits_find_first_set(const u64 *words, s64 count, s64 start) {
+    s64 w = start / 64;
+    if (w >= count) return -1;
+
+    u64 word = words[w] & (~0ull << (start % 64));
+    while (true) {
+        if (word) return w * 64 + lsb(word);
+        if (++w == count) return -1;
+        word = words[w];
+    }
+}
+
+// Sets (or clears) the bits [begin, end), whole words at a time.
+inline void bits_set_range(u64 *words, s64 begin, s64 end, bool value) {
+    if (begin >= end) return;
+
+    s64 firstWord = begin / 64, lastWord = (end - 1) / 64;
+
+    u64 firstMask = ~0ull << (begin % 64);
+    u64 lastMask = ~0ull >> (63 - (end - 1) % 64);
+
+    if (firstWord == lastWord) firstMask &= lastMask;
+
+    auto apply = [&](s64 w, u64 mask) {
+        if (value) {
+            words[w] |= mask;
+        } else {
+            words[w] &= ~mask;
+        }
+    };
+
+    apply(firstWord, firstMask);
+    if (firstWord == lastWord) return;
+
+    if (lastWord - firstWord > 1) fill_memory(words + firstWord + 1, value ? 0xFF : 0, (lastWord - firstWord - 1) * sizeof(u64));
+    apply(lastWord, lastMask);
+}
+
+//
+// A fixed number of bits stored inline.
+//
+//     bitset<1024> visible;
+//     set(visible, id);
+//     ...
+//     bits_and(visible, visible, inFrustum);
+//     For(visible) draw(it);  // Iterates the indices of the set bits
+//
+// A dynamic version is bit_array, all functions below work on both.
+template <s64 N>
+struct bitset {
+    static constexpr s64 Count = N;
+    static constexpr s64 WORDS = (N + 63) / 64;
+
+    u64 Words[WORDS]{};  // Bits past N are always 0
+};
+
+//
+// A bitset which can be resized (allocates with the Context's allocator). Free with free().
+//
+struct bit_array {
+    u64 *Words = null;
+    s64 Count = 0;      // In bits
+    s64 Allocated = 0;  // In words
+
+    bit_array() {}
+};
+
+template <typename T>
+struct is_bitset_helper : types::false_t {};
+
+template <s64 N>
+struct is_bitset_helper<bitset<N>> : types::true_t {};
+
+template <>
+struct is_bitset_helper<bit_array> : types::true_t {};
+
+template <typename T>
+concept any_bitset = is_bitset_helper<types::remove_cvref_t<T>>::value;
+
+// Number of 64 bit words used
+constexpr s64 bits_word_count(const any_bitset auto &bits) { return (bits.Count + 63) / 64; }
+
+// Changes the number of bits, new bits are 0.
+inline void resize(bit_array &bits, s64 count) {
+    s64 words = (count + 63) / 64;
+    if (words > bits.Allocated) {
+        s64 target = max<s64>(ceil_pow_of_2(words), 4);
+        if (bits.Allocated) {
+            bits.Words = reallocate_array(bits.Words, target);
+        } else {
+            bits.Words = allocate_array<u64>(target);
+        }
+        zero_memory(bits.Words + bits.Allocated, (target - bits.Allocated) * sizeof(u64));
+        bits.Allocated = target;
+    }
+
+    // Clear the bits we drop, so they are 0 if we grow again
+    if (count < bits.Count) bits_set_range(bits.Words, count, bits.Count, false);
+    bits.Count = count;
+}
+
+inline void free(bit_array &bits) {
+    if (bits.Allocated) free(bits.Words);
+    bits.Words = null;
+    bits.Count = bits.Allocated = 0;
+}
+
+inline bit_array *clone(bit_array *dest, const bit_array &src) {
+    resize(*dest, src.Count);
+    copy_memory(dest->Words, src.Words, bits_word_count(src) * sizeof(u64));
+    return dest;
+}
+
+bool get(const any_bitset auto &bits, s64 index) {
+    assert(index >= 0 && index < bits.Count);
+    return bits.Words[index / 64] & (1ull << (index % 64));
+}
+
+void set(any_bitset auto &bits, s64 index, bool value = true) {
+    assert(index >= 0 && index < bits.Count);
+    if (value) {
+        bits.Words[index / 64] |= 1ull << (index % 64);
+    } else {
+        bits.Words[index / 64] &= ~(1ull << (index % 64));
+    }
+}
+
+void clear(any_bitset auto &bits, s64 index) { set(bits, index, false); }
+
+void toggle(any_bitset auto &bits, s64 index) {
+    assert(index >= 0 && index < bits.Count);
+    bits.Words[index / 64] ^= 1ull << (index % 64);
+}
+
+// Sets the bits [begin, end)
+void set_range(any_bitset auto &bits, s64 begin, s64 end, bool value = true) {
+    assert(begin >= 0 && begin <= end && end <= bits.Count);
+    bits_set_range(bits.Words, begin, end, value);
+}
+
+// Clears the bits [begin, end)
+void clear_range(any_bitset auto &bits, s64 begin, s64 end) { set_range(bits, begin, end, false); }
+
+void clear_all(any_bitset auto &bits) { zero_memory(bits.Words, bits_word_count(bits) * sizeof(u64)); }
+
+// Returns the number of set bits
+s64 count_set(const any_bitset auto &bits) { return bits_pop_count(bits.Words, bits_word_count(bits)); }
+
+bool any(const any_bitset auto &bits) { return bits_find_first_set(bits.Words, bits_word_count(bits), 0) != -1; }
+
+// Returns the index of the first set bit at or after _start_, or -1 if there are none
+s64 find_first_set(const any_bitset auto &bits, s64 start = 0) {
+    if (start >= bits.Count) return -1;
+    return bits_find_first_set(bits.Words, bits_word_count(bits), start);
+}
+
+// dst = a & b (all three must have the same number of bits, _dst_ may be one of the arguments)
+template <any_bitset T>
+void bits_and(T &dst, const T &a, const T &b) {
+    assert(dst.Count == a.Count && a.Count == b.Count);
+    bits_apply<bits_op::AND>(dst.Words, a.Words, b.Words, bits_word_count(a));
+}
+
+// dst = a | b
+template <any_bitset T>
+void bits_or(T &dst, const T &a, const T &b) {
+    assert(dst.Count == a.Count && a.Count == b.Count);
+    bits_apply<bits_op::OR>(dst.Words, a.Words, b.Words, bits_word_count(a));
+}
+
+// dst = a ^ b
+template <any_bitset T>
+void bits_xor(T &dst, const T &a, const T &b) {
+    assert(dst.Count == a.Count && a.Count == b.Count);
+    bits_apply<bits_op::XOR>(dst.Words, a.Words, b.Words, bits_word_count(a));
+}
+
+// dst = a & ~b
+template <any_bitset T>
+void bits_and_not(T &dst, const T &a, const T &b) {
+    assert(dst.Count == a.Count && a.Count == b.Count);
+    bits_apply<bits_op::AND_NOT>(dst.Words, a.Words, b.Words, bits_word_count(a));
+}
+
+template <any_bitset T>
+bool operator==(const T &a, const T &b) {
+    if (a.Count != b.Count) return false;
+    return equal_memory(a.Words, b.Words, bits_word_count(a) * sizeof(u64));
+}
+
+template <any_bitset T>
+bool operator!=(const T &a, const T &b) { return !(a == b); }
+
+// Iterates the indices of the set bits, e.g. For(bits) { ... it is the index ... }
+struct bits_iterator {
+    const u64 *Words;
+    s64 WordCount;
+    s64 Index;
+
+    bits_iterator &operator++() {
+        Index = bits_find_first_set(Words, WordCount, Index + 1);
+        if (Index == -1) Index = WordCount * 64;
+        return *this;
+    }
+
+    bool operator==(const bits_iterator &other) const { return Index == other.Index; }
+    bool operator!=(const bits_iterator &other) const { return Index != other.Index; }
+
+    s64 operator*() const { return Index; }
+};
+
+bits_iterator begin(const any_bitset auto &bits) {
+    s64 words = bits_word_count(bits);
+    s64 first = bits_find_first_set(bits.Words, words, 0);
+    return {bits.Words, words, first == -1 ? words * 64 : first};
+}
+
+bits_iterator end(const any_bitset auto &bits) {
+    s64 words = bits_word_count(bits);
+    return {bits.Words, words, words * 64};
+}
+
+LSTD_END_NAMESPACE
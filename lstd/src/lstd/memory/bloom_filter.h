@@ -0,0 +1,188 @@
+#pragma once
+
+#include "array.h"
+#include "hash.h"
+
+#if ARCH == X86
+#include <emmintrin.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A blocked Bloom filter - a set which answers "definitely not in here" or "probably in here" and takes a few bits per key.
+//
+//     bloom_filter seen;
+//     bloom_filter_init(seen, expectedCount);
+//     For(keys) add(seen, it);
+//     ...
+//     if (!has(seen, key)) return;  // Skip the expensive lookup
+//
+// A classic Bloom filter sets k bits spread across the whole table, so a lookup is k cache misses. Here each key
+// picks one block of 512 bits (one cache line) and sets 8 bits in it, one in each 64 bit word. A lookup is one
+// miss and the 8 bits are tested together with SIMD. The price is a slightly higher false positive rate for the
+// same memory: with the default 12 bits per key it is around 0.5%.
+//
+// Keys are hashed with get_hash() (see hash.h), you can also pass your own hashes with add_prehashed/has_prehashed.
+// Keys can't be removed, if you need that see cuckoo_filter.h.
+//
+constexpr s64 BLOOM_FILTER_BLOCK_WORDS = 8;
+
+struct bloom_filter {
+    u64 *Words = null;  // _BlockCount_ * BLOOM_FILTER_BLOCK_WORDS, aligned to 64 bytes
+    s64 BlockCount = 0;
+
+    bloom_filter() {}
+};
+
+namespace internal {
+// Finalizer from MurmurHash3. We use the high half of the hash to pick the block and the low to pick the bits, so they
+// must be independent - hashes given to add_prehashed() or weak get_hash() overloads might not be, so mix them up once more.
+always_inline u64 filter_remix(u64 h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Each of the 8 words of a block gets one bit, the top 6 bits of (low half of hash * salt) pick which one.
+constexpr u32 BLOOM_FILTER_SALTS[BLOOM_FILTER_BLOCK_WORDS] = {0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D,
+                                                              0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31};
+
+always_inline u64 *bloom_filter_block(const bloom_filter &f, u64 h) {
+    // Maps the high half of the hash to [0, BlockCount) without a division
+    u64 block = ((h >> 32) * (u64) f.BlockCount) >> 32;
+    return f.Words + block * BLOOM_FILTER_BLOCK_WORDS;
+}
+
+always_inline void bloom_filter_mask(u64 h, u64 *mask) {
+    For(range(BLOOM_FILTER_BLOCK_WORDS)) mask[it] = 1ull << (((u32) h * BLOOM_FILTER_SALTS[it]) >> 26);
+}
+
+constexpr u32 BLOOM_FILTER_MAGIC = 0x3146424C;  // "LBF1"
+
+struct bloom_filter_header {
+    u32 Magic;
+    u32 Reserved;
+    u64 BlockCount;
+};
+}  // namespace internal
+
+inline void free(bloom_filter &f) {
+    if (f.Words) free(f.Words);
+    f.Words = null;
+    f.BlockCount = 0;
+}
+
+// Allocates a filter for about _expectedCount_ keys. More bits per key means fewer false positives
+// (8 bits ~ 2%, 12 bits ~ 0.5%, 16 bits ~ 0.1%). Frees the old contents of _f_.
+inline void bloom_filter_init(bloom_filter &f, s64 expectedCount, s64 bitsPerKey = 12, allocator alloc = {}) {
+    free(f);
+
+    s64 bits = max<s64>(expectedCount, 1) * max<s64>(bitsPerKey, 1);
+    f.BlockCount = (bits + BLOOM_FILTER_BLOCK_WORDS * 64 - 1) / (BLOOM_FILTER_BLOCK_WORDS * 64);
+    assert(f.BlockCount <= 0xFFFFFFFFll && "Bloom filter too big");
+
+    f.Words = allocate_array<u64>(f.BlockCount * BLOOM_FILTER_BLOCK_WORDS, {.Alloc = alloc, .Alignment = 64});
+    zero_memory(f.Words, f.BlockCount * BLOOM_FILTER_BLOCK_WORDS * sizeof(u64));
+}
+
+// Removes all keys, keeps the memory.
+inline void reset(bloom_filter &f) {
+    if (f.Words) zero_memory(f.Words, f.BlockCount * BLOOM_FILTER_BLOCK_WORDS * sizeof(u64));
+}
+
+inline void add_prehashed(bloom_filter &f, u64 hash) {
+    assert(f.BlockCount && "Bloom filter not initialized, call bloom_filter_init()");
+
+    u64 h = internal::filter_remix(hash);
+    u64 *block = internal::bloom_filter_block(f, h);
+
+    u64 mask[BLOOM_FILTER_BLOCK_WORDS];
+    internal::bloom_filter_mask(h, mask);
+    For(range(BLOOM_FILTER_BLOCK_WORDS)) block[it] |= mask[it];
+}
+
+// Returns false if the key was definitely never added, true if it probably was.
+inline bool has_prehashed(const bloom_filter &f, u64 hash) {
+    if (!f.BlockCount) return false;
+
+    u64 h = internal::filter_remix(hash);
+    const u64 *block = internal::bloom_filter_block(f, h);
+
+    alignas(16) u64 mask[BLOOM_FILTER_BLOCK_WORDS];
+    internal::bloom_filter_mask(h, mask);
+
+#if ARCH == X86
+    // Collect the bits of the mask which aren't set in the block, the key is in if there are none
+    __m128i missing = _mm_setzero_si128();
+    For(range(BLOOM_FILTER_BLOCK_WORDS / 2)) {
+        __m128i b = _mm_load_si128((const __m128i *) block + it);
+        __m128i m = _mm_load_si128((const __m128i *) mask + it);
+        missing = _mm_or_si128(missing, _mm_andnot_si128(b, m));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+    u64 missing = 0;
+    For(range(BLOOM_FILTER_BLOCK_WORDS)) missing |= mask[it] & ~block[it];
+    return !missing;
+#endif
+}
+
+template <typename T>
+void add(bloom_filter &f, const T &key) { add_prehashed(f, get_hash(key)); }
+
+template <typename T>
+bool has(const bloom_filter &f, const T &key) { return has_prehashed(f, get_hash(key)); }
+
+inline bloom_filter *clone(bloom_filter *dest, const bloom_filter &src) {
+    free(*dest);
+    if (!src.BlockCount) return dest;
+
+    dest->BlockCount = src.BlockCount;
+    dest->Words = allocate_array<u64>(src.BlockCount * BLOOM_FILTER_BLOCK_WORDS, {.Alignment = 64});
+    copy_elements(dest->Words, src.Words, src.BlockCount * BLOOM_FILTER_BLOCK_WORDS);
+    return dest;
+}
+
+//
+// Serialization to a flat buffer: a small header followed by the words as they are in memory (so the format is
+// only portable between machines with the same endianness). Use this to ship a filter built offline, or to save one to disk.
+//
+
+// Allocates the result with _alloc_ (Context.Alloc by default), free it with free().
+inline bytes serialize(const bloom_filter &f, allocator alloc = {}) {
+    internal::bloom_filter_header header = {internal::BLOOM_FILTER_MAGIC, 0, (u64) f.BlockCount};
+    s64 wordBytes = f.BlockCount * BLOOM_FILTER_BLOCK_WORDS * sizeof(u64);
+
+    bytes result;
+    PUSH_ALLOC(alloc ? alloc : Context.Alloc) {
+        array_reserve_exact(result, sizeof(header) + wordBytes);
+    }
+    copy_memory(result.Data, &header, sizeof(header));
+    if (wordBytes) copy_memory(result.Data + sizeof(header), f.Words, wordBytes);
+    result.Count = sizeof(header) + wordBytes;
+    return result;
+}
+
+// Reads a filter written by serialize(). Returns false (and leaves _dest_ untouched) if _data_ isn't a valid filter.
+inline bool deserialize(bloom_filter *dest, const bytes &data, allocator alloc = {}) {
+    internal::bloom_filter_header header;
+    if (data.Count < (s64) sizeof(header)) return false;
+    copy_memory(&header, data.Data, sizeof(header));
+
+    if (header.Magic != internal::BLOOM_FILTER_MAGIC || header.BlockCount > 0xFFFFFFFFull) return false;
+
+    s64 wordBytes = (s64) header.BlockCount * BLOOM_FILTER_BLOCK_WORDS * sizeof(u64);
+    if (data.Count != (s64) sizeof(header) + wordBytes) return false;
+
+    free(*dest);
+    if (!header.BlockCount) return true;
+
+    dest->BlockCount = (s64) header.BlockCount;
+    dest->Words = allocate_array<u64>(dest->BlockCount * BLOOM_FILTER_BLOCK_WORDS, {.Alloc = alloc, .Alignment = 64});
+    copy_memory(dest->Words, data.Data + sizeof(header), wordBytes);
+    return true;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,542 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// An ordered map implemented as a B+ tree. Use it instead of hash_table when you need the keys in order -
+// range scans, "the first key >= x", etc. Keys are compared only with operator<.
+//
+//     btree_map<s64, sample> samples;
+//     set(samples, timestamp, s);
+//
+//     auto *s = find(samples, timestamp);  // null if missing
+//
+//     For(get_range(samples, from, to)) {  // Keys in [from, to), in order
+//         ... *it.Key, *it.Value ...
+//     }
+//
+// All values are in the leaves and the leaves are linked together, so iterating a range is a walk through
+// consecutive arrays and doesn't touch the inner nodes. The keys of a node are stored contiguously (values separately),
+// so the binary search in a node touches only the key array. The node size is _NodeBytes_ (for the keys of a leaf,
+// or keys + child pointers of an inner node), the default is 4 cache lines.
+//
+// Finding, adding and removing is O(log n).
+// Removing doesn't merge nodes, so a tree which shrinks a lot keeps its height (and empty leaves, which
+// iteration skips). Rebuild it with bulk_load() if that matters.
+//
+// If you have the data sorted already, bulk_load() builds the tree bottom up in O(n) with full nodes.
+//
+// Pointers to values are invalidated by adding and removing (elements move inside and between nodes).
+//
+template <typename K_, typename V_, s64 NodeBytes = 256>
+struct btree_map {
+    using K = K_;
+    using V = V_;
+
+    static constexpr s64 LEAF_CAPACITY = max<s64>(NodeBytes / sizeof(K), 4);
+    static constexpr s64 INNER_CAPACITY = max<s64>(NodeBytes / (sizeof(K) + sizeof(void *)), 4);
+
+    struct node {
+        s64 Count;  // Number of keys
+        bool IsLeaf;
+    };
+
+    struct leaf : node {
+        K Keys[LEAF_CAPACITY];
+        V Values[LEAF_CAPACITY];
+        leaf *Next, *Prev;
+    };
+
+    // Child i has the keys in [Keys[i - 1], Keys[i]).
+    struct inner : node {
+        K Keys[INNER_CAPACITY];
+        node *Children[INNER_CAPACITY + 1];
+    };
+
+    node *Root = null;
+    leaf *First = null;  // The leftmost leaf, iteration starts here
+
+    s64 Count = 0;
+
+    btree_map() {}
+
+    struct key_value {
+        const K *Key;
+        V *Value;
+    };
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        leaf *Leaf;  // null for end()
+        s64 Index;
+
+        iterator_(leaf *l = null, s64 index = 0) : Leaf(l), Index(index) { skip_empty(); }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_empty();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Leaf == other.Leaf && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        key_value operator*() const { return {Leaf->Keys + Index, Leaf->Values + Index}; }
+
+       private:
+        // Moves to the next leaf when we are past the end of this one
+        void skip_empty() {
+            while (Leaf && Index >= Leaf->Count) {
+                Leaf = Leaf->Next;
+                Index = 0;
+            }
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(First); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(First); }
+    const_iterator end() const { return const_iterator(); }
+
+    // A pair of iterators, returned by get_range() so you can use it in For()
+    template <bool Const>
+    struct range_ {
+        iterator_<Const> Begin, End;
+
+        iterator_<Const> begin() const { return Begin; }
+        iterator_<Const> end() const { return End; }
+    };
+};
+
+template <typename T>
+struct is_btree_map : types::false_t {};
+
+template <typename K, typename V, s64 NodeBytes>
+struct is_btree_map<btree_map<K, V, NodeBytes>> : types::true_t {};
+
+template <typename T>
+concept any_btree_map = is_btree_map<T>::value;
+
+namespace internal {
+// Index of the first key which is not less than _key_
+template <typename K>
+s64 btree_lower_bound(const K *keys, s64 count, const K &key) {
+    s64 first = 0;
+    while (count > 0) {
+        s64 half = count / 2;
+        if (keys[first + half] < key) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+// Index of the first key which is greater than _key_
+template <typename K>
+s64 btree_upper_bound(const K *keys, s64 count, const K &key) {
+    s64 first = 0;
+    while (count > 0) {
+        s64 half = count / 2;
+        if (!(key < keys[first + half])) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+template <any_btree_map T>
+auto *btree_find_leaf(const T &map, const typename T::K &key) {
+    using inner = typename T::inner;
+    using leaf = typename T::leaf;
+
+    auto *n = map.Root;
+    if (!n) return (leaf *) null;
+
+    while (!n->IsLeaf) {
+        auto *in = (inner *) n;
+        n = in->Children[btree_upper_bound(in->Keys, in->Count, key)];
+    }
+    return (leaf *) n;
+}
+
+template <any_btree_map T>
+auto *btree_new_leaf() {
+    auto *l = allocate<typename T::leaf>();
+    l->Count = 0;
+    l->IsLeaf = true;
+    l->Next = l->Prev = null;
+    return l;
+}
+
+template <any_btree_map T>
+auto *btree_new_inner() {
+    auto *in = allocate<typename T::inner>();
+    in->Count = 0;
+    in->IsLeaf = false;
+    return in;
+}
+
+template <any_btree_map T>
+void btree_free_node(typename T::node *n) {
+    using inner = typename T::inner;
+    using leaf = typename T::leaf;
+
+    if (n->IsLeaf) {
+        auto *l = (leaf *) n;
+        For(range(l->Count)) {
+            destroy_at(l->Keys + it);
+            destroy_at(l->Values + it);
+        }
+    } else {
+        auto *in = (inner *) n;
+        For(range(in->Count + 1)) btree_free_node<T>(in->Children[it]);
+        For(range(in->Count)) destroy_at(in->Keys + it);
+    }
+    free(n);
+}
+
+// Result of inserting into a subtree. If the node split, _Right_ is the new node to its right
+// and _Separator_ is the smallest key in it.
+template <any_btree_map T>
+struct btree_insert_result {
+    typename T::V *Value;
+    bool Added;
+
+    typename T::node *Right;
+    typename T::K Separator;
+};
+
+template <any_btree_map T>
+btree_insert_result<T> btree_insert_leaf(T &map, typename T::leaf *l, const typename T::K &key, const typename T::V &value) {
+    using leaf = typename T::leaf;
+    constexpr s64 CAP = T::LEAF_CAPACITY;
+
+    s64 pos = btree_lower_bound(l->Keys, l->Count, key);
+    if (pos < l->Count && !(key < l->Keys[pos])) {
+        l->Values[pos] = value;
+        return {l->Values + pos, false, null, {}};
+    }
+
+    leaf *target = l, *right = null;
+    if (l->Count == CAP) {
+        // Split in half, the new leaf goes to the right
+        right = btree_new_leaf<T>();
+
+        s64 mid = CAP / 2;
+        right->Count = CAP - mid;
+        copy_elements(right->Keys, l->Keys + mid, right->Count);
+        copy_elements(right->Values, l->Values + mid, right->Count);
+        l->Count = mid;
+
+        right->Next = l->Next;
+        right->Prev = l;
+        if (l->Next) l->Next->Prev = right;
+        l->Next = right;
+
+        if (pos > mid) {
+            target = right;
+            pos -= mid;
+        }
+    }
+
+    copy_elements(target->Keys + pos + 1, target->Keys + pos, target->Count - pos);
+    copy_elements(target->Values + pos + 1, target->Values + pos, target->Count - pos);
+    copy_elements(target->Keys + pos, &key, 1);
+    copy_elements(target->Values + pos, &value, 1);
+    ++target->Count;
+
+    btree_insert_result<T> result = {target->Values + pos, true, right, {}};
+    if (right) result.Separator = right->Keys[0];
+    return result;
+}
+
+template <any_btree_map T>
+btree_insert_result<T> btree_insert(T &map, typename T::node *n, const typename T::K &key, const typename T::V &value) {
+    using inner = typename T::inner;
+    using leaf = typename T::leaf;
+    constexpr s64 CAP = T::INNER_CAPACITY;
+
+    if (n->IsLeaf) return btree_insert_leaf(map, (leaf *) n, key, value);
+
+    auto *in = (inner *) n;
+
+    s64 i = btree_upper_bound(in->Keys, in->Count, key);
+
+    auto result = btree_insert(map, in->Children[i], key, value);
+    if (!result.Right) return result;
+
+    // The child split, add the separator at _i_ and the new child at _i_ + 1
+    inner *target = in, *right = null;
+    typename T::K separator;
+
+    if (in->Count == CAP) {
+        // Left keeps keys [0, mid) and children [0, mid], Keys[mid] goes up to the parent
+        right = btree_new_inner<T>();
+
+        s64 mid = CAP / 2;
+        separator = in->Keys[mid];
+
+        right->Count = CAP - mid - 1;
+        copy_elements(right->Keys, in->Keys + mid + 1, right->Count);
+        copy_elements(right->Children, in->Children + mid + 1, right->Count + 1);
+        in->Count = mid;
+
+        if (i > mid) {
+            target = right;
+            i -= mid + 1;
+        }
+    }
+
+    copy_elements(target->Keys + i + 1, target->Keys + i, target->Count - i);
+    copy_elements(target->Children + i + 2, target->Children + i + 1, target->Count - i);
+    copy_elements(target->Keys + i, &result.Separator, 1);
+    target->Children[i + 1] = result.Right;
+    ++target->Count;
+
+    result.Right = right;
+    if (right) result.Separator = separator;
+    return result;
+}
+
+// Builds the inner levels on top of _nodes_ (one level of the tree, in order) whose smallest keys are _firstKeys_.
+// Consumes both arrays.
+template <any_btree_map T>
+void btree_build_levels(T &map, array<typename T::node *> &nodes, array<typename T::K> &firstKeys) {
+    using inner = typename T::inner;
+    constexpr s64 CHILDREN = T::INNER_CAPACITY + 1;
+
+    while (nodes.Count > 1) {
+        array<typename T::node *> parents;
+        array<typename T::K> parentKeys;
+
+        // Spread the children evenly, so the last node doesn't end up with a single child
+        s64 groups = (nodes.Count + CHILDREN - 1) / CHILDREN;
+        s64 perGroup = nodes.Count / groups, extra = nodes.Count % groups;
+
+        s64 child = 0;
+        For(range(groups)) {
+            s64 n = perGroup + (it < extra ? 1 : 0);
+
+            auto *in = btree_new_inner<T>();
+            in->Count = n - 1;
+            copy_elements(in->Children, nodes.Data + child, n);
+            copy_elements(in->Keys, firstKeys.Data + child + 1, n - 1);
+
+            array_append(parents, (typename T::node *) in);
+            array_append(parentKeys, firstKeys.Data[child]);
+            child += n;
+        }
+
+        free(nodes);
+        free(firstKeys);
+        nodes = parents;
+        firstKeys = parentKeys;
+    }
+
+    map.Root = nodes.Count ? nodes.Data[0] : null;
+    free(nodes);
+    free(firstKeys);
+}
+}  // namespace internal
+
+template <any_btree_map T>
+s64 count(const T &map) { return map.Count; }
+
+// Call destructor on each key and value and free all nodes.
+template <any_btree_map T>
+void free(T &map) {
+    if (map.Root) internal::btree_free_node<T>(map.Root);
+    map.Root = null;
+    map.First = null;
+    map.Count = 0;
+}
+
+// Returns a pointer to the value of _key_, or null if it's not in the map.
+template <any_btree_map T>
+auto *find(const T &map, const typename T::K &key) {
+    using V = typename T::V;
+
+    auto *l = internal::btree_find_leaf(map, key);
+    if (!l) return (V *) null;
+
+    s64 pos = internal::btree_lower_bound(l->Keys, l->Count, key);
+    if (pos == l->Count || key < l->Keys[pos]) return (V *) null;
+    return (V *) l->Values + pos;
+}
+
+template <any_btree_map T>
+bool has(const T &map, const typename T::K &key) { return find(map, key) != null; }
+
+// Adds _key_ with a shallow copy of _value_, or overwrites the value if the key is already in the map.
+// Returns a pointer to the value in the map.
+template <any_btree_map T>
+auto *set(T &map, const typename T::K &key, const typename T::V &value) {
+    if (!map.Root) {
+        auto *l = internal::btree_new_leaf<T>();
+        map.Root = l;
+        map.First = l;
+    }
+
+    auto result = internal::btree_insert(map, map.Root, key, value);
+    if (result.Added) ++map.Count;
+
+    if (result.Right) {
+        // The root split, the tree grows by one level
+        auto *root = internal::btree_new_inner<T>();
+        root->Count = 1;
+        copy_elements(root->Keys, &result.Separator, 1);
+        root->Children[0] = map.Root;
+        root->Children[1] = result.Right;
+        map.Root = root;
+    }
+    return result.Value;
+}
+
+// Removes _key_ (calls the destructor on the key and value). Returns true if the key was in the map.
+template <any_btree_map T>
+bool remove(T &map, const typename T::K &key) {
+    auto *l = internal::btree_find_leaf(map, key);
+    if (!l) return false;
+
+    s64 pos = internal::btree_lower_bound(l->Keys, l->Count, key);
+    if (pos == l->Count || key < l->Keys[pos]) return false;
+
+    destroy_at(l->Keys + pos);
+    destroy_at(l->Values + pos);
+
+    copy_elements(l->Keys + pos, l->Keys + pos + 1, l->Count - pos - 1);
+    copy_elements(l->Values + pos, l->Values + pos + 1, l->Count - pos - 1);
+    --l->Count;
+    --map.Count;
+    return true;
+}
+
+// Returns an iterator to the first element whose key is not less than _key_ (end() if there is none).
+template <any_btree_map T>
+auto lower_bound(const T &map, const typename T::K &key) {
+    using iterator = typename T::iterator;
+
+    auto *l = internal::btree_find_leaf(map, key);
+    if (!l) return iterator();
+    return iterator(l, internal::btree_lower_bound(l->Keys, l->Count, key));
+}
+
+// Returns an iterator to the first element whose key is greater than _key_ (end() if there is none).
+template <any_btree_map T>
+auto upper_bound(const T &map, const typename T::K &key) {
+    using iterator = typename T::iterator;
+
+    auto *l = internal::btree_find_leaf(map, key);
+    if (!l) return iterator();
+    return iterator(l, internal::btree_upper_bound(l->Keys, l->Count, key));
+}
+
+// Returns the elements with keys in [begin, end), in order, e.g.
+//     For(get_range(map, 10, 20)) { ... }
+template <any_btree_map T>
+auto get_range(const T &map, const typename T::K &begin, const typename T::K &end) {
+    using range_t = typename T::template range_<false>;
+    if (!(begin < end)) return range_t{};
+    return range_t{lower_bound(map, begin), lower_bound(map, end)};
+}
+
+// Replaces the contents of the map with shallow copies of _keys_ and _values_, which must be sorted by key
+// (without duplicates). Builds the tree bottom up with full nodes, which is O(n).
+template <any_btree_map T>
+void bulk_load(T &map, const array<typename T::K> &keys, const array<typename T::V> &values) {
+    using node = typename T::node;
+    using leaf = typename T::leaf;
+
+    constexpr s64 CAP = T::LEAF_CAPACITY;
+
+    assert(keys.Count == values.Count && "Keys and values must have the same count");
+
+    free(map);
+    if (!keys.Count) return;
+
+    array<node *> nodes;
+    array<typename T::K> firstKeys;
+
+    leaf *prev = null;
+    for (s64 i = 0; i < keys.Count; i += CAP) {
+        auto *l = internal::btree_new_leaf<T>();
+        l->Count = min(CAP, keys.Count - i);
+        copy_elements(l->Keys, keys.Data + i, l->Count);
+        copy_elements(l->Values, values.Data + i, l->Count);
+
+        For(range(i + 1, i + l->Count)) assert(keys.Data[it - 1] < keys.Data[it] && "Keys must be sorted and unique");
+
+        l->Prev = prev;
+        if (prev) {
+            prev->Next = l;
+        } else {
+            map.First = l;
+        }
+        prev = l;
+
+        array_append(nodes, (node *) l);
+        array_append(firstKeys, l->Keys[0]);
+    }
+
+    map.Count = keys.Count;
+    internal::btree_build_levels(map, nodes, firstKeys);
+}
+
+// The clone has full leaves (it's built like with bulk_load), so it may be smaller than _src_.
+template <typename K, typename V, s64 NodeBytes>
+btree_map<K, V, NodeBytes> *clone(btree_map<K, V, NodeBytes> *dest, const btree_map<K, V, NodeBytes> &src) {
+    using T = btree_map<K, V, NodeBytes>;
+    using node = typename T::node;
+    using leaf = typename T::leaf;
+
+    free(*dest);
+
+    array<node *> nodes;
+    array<K> firstKeys;
+
+    leaf *l = null;
+    For(src) {
+        if (!l || l->Count == T::LEAF_CAPACITY) {
+            auto *next = internal::btree_new_leaf<T>();
+            next->Prev = l;
+            if (l) {
+                l->Next = next;
+            } else {
+                dest->First = next;
+            }
+            l = next;
+
+            array_append(nodes, (node *) l);
+            array_append(firstKeys, *it.Key);
+        }
+        clone(l->Keys + l->Count, *it.Key);
+        clone(l->Values + l->Count, *it.Value);
+        ++l->Count;
+    }
+
+    dest->Count = src.Count;
+    internal::btree_build_levels(*dest, nodes, firstKeys);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
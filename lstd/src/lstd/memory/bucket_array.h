@@ -1,22 +1,119 @@
 #pragma once
 
 #include "../internal/context.h"
+#include "array.h"
 
 LSTD_BEGIN_NAMESPACE
 
+// Stores elements in fixed size buckets, so pointers to elements stay valid when the array grows.
+//
+// We keep a directory of pointers to the buckets, so getting the element at an index is O(1)
+// (the index is bucket * ELEMENTS_PER_BUCKET + slot). Each bucket has a bitmask of the slots in use,
+// removing an element just clears its bit and add() fills the first free slot it finds (starting from the first
+// bucket which may have room) before allocating a new bucket. So indices of elements don't change on removal either.
+//
+// Buckets can be iterated independently (see get_range()), e.g. hand each job a range of buckets.
 template <typename T_, s64 ElementsPerBucket = 128>
 struct bucket_array {
     using T = T_;
     constexpr static s64 ELEMENTS_PER_BUCKET = ElementsPerBucket;
+    constexpr static s64 MASK_WORDS = (ElementsPerBucket + 63) / 64;
 
     struct bucket {
         T *Elements = null;
-        s64 Count = 0, Allocated = 0;
-        bucket *Next = null;
+        s64 Count = 0;
+        u64 Occupied[MASK_WORDS]{};
     };
 
-    bucket BaseBucket;
-    bucket *BucketHead = null;  // null means BaseBucket
+    array<bucket *> Buckets;
+
+    // Number of elements in all buckets
+    s64 Count = 0;
+
+    // All buckets before this one are full
+    s64 FirstBucketWithRoom = 0;
+
+    //
+    // Iterator:
+    //
+    // Goes through the occupied slots of the buckets in [FirstBucket, EndBucket).
+    //
+    template <bool Const>
+    struct iterator_ {
+        using bucket_array_t = types::select_t<Const, const bucket_array<T, ElementsPerBucket>, bucket_array<T, ElementsPerBucket>>;
+        using element_t = types::select_t<Const, const T, T>;
+
+        bucket_array_t *Parent;
+        s64 Index;  // Global index of the element
+        s64 EndIndex;
+
+        iterator_(bucket_array_t *parent, s64 index, s64 endIndex) : Parent(parent), Index(index), EndIndex(endIndex) {
+            assert(parent);
+            skip_free_slots();
+        }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_free_slots();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        element_t &operator*() { return Parent->Buckets[Index / ELEMENTS_PER_BUCKET]->Elements[Index % ELEMENTS_PER_BUCKET]; }
+
+       private:
+        void skip_free_slots() {
+            while (Index < EndIndex) {
+                auto *b = Parent->Buckets[Index / ELEMENTS_PER_BUCKET];
+                s64 slot = Index % ELEMENTS_PER_BUCKET;
+
+                // Skip empty buckets entirely
+                if (!b->Count) {
+                    Index += ELEMENTS_PER_BUCKET - slot;
+                    continue;
+                }
+
+                u64 word = b->Occupied[slot / 64] >> (slot % 64);
+                if (word) {
+                    Index += lsb(word);
+                    break;
+                }
+                Index += min(64 - slot % 64, ELEMENTS_PER_BUCKET - slot);
+            }
+            if (Index > EndIndex) Index = EndIndex;
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    // A range of whole buckets
+    template <bool Const>
+    struct range_ {
+        using bucket_array_t = types::select_t<Const, const bucket_array<T, ElementsPerBucket>, bucket_array<T, ElementsPerBucket>>;
+
+        bucket_array_t *Parent;
+        s64 FirstBucket, EndBucket;
+
+        iterator_<Const> begin() const { return iterator_<Const>(Parent, FirstBucket * ELEMENTS_PER_BUCKET, EndBucket * ELEMENTS_PER_BUCKET); }
+        iterator_<Const> end() const { return iterator_<Const>(Parent, EndBucket * ELEMENTS_PER_BUCKET, EndBucket * ELEMENTS_PER_BUCKET); }
+    };
+
+    using bucket_range = range_<false>;
+    using const_bucket_range = range_<true>;
+
+    iterator begin() { return iterator(this, 0, Buckets.Count * ELEMENTS_PER_BUCKET); }
+    iterator end() { return iterator(this, Buckets.Count * ELEMENTS_PER_BUCKET, Buckets.Count * ELEMENTS_PER_BUCKET); }
+    const_iterator begin() const { return const_iterator(this, 0, Buckets.Count * ELEMENTS_PER_BUCKET); }
+    const_iterator end() const { return const_iterator(this, Buckets.Count * ELEMENTS_PER_BUCKET, Buckets.Count * ELEMENTS_PER_BUCKET); }
 
     bucket_array() {}
 };
@@ -30,67 +127,143 @@ struct is_bucket_array_helper<bucket_array<T, ElementsPerBucket>> : types::true_
 template <typename T>
 concept is_bucket_array = is_bucket_array_helper<T>::value;
 
+// Calls the destructors of the elements which are still in the array and frees all buckets.
 template <is_bucket_array T>
 void free(T &arr) {
-    auto *b = arr.BucketHead->Next;  // The first bucket is on the stack
-    while (b) {
-        auto *toFree = b;
-        b = b->Next;
-        free(toFree);
+    using V = typename T::T;
+
+    For_as(b, arr.Buckets) {
+        For(range(T::ELEMENTS_PER_BUCKET)) {
+            if (b->Occupied[it / 64] & (1ull << (it % 64))) b->Elements[it].~V();
+        }
+        free(b->Elements);
+        free(b);
     }
+    free(arr.Buckets);
+    arr.Count = 0;
+    arr.FirstBucketWithRoom = 0;
 }
 
+// Returns a pointer to the element at _index_ or null if that slot is free (or out of range).
 template <is_bucket_array T>
-auto *get_bucket_head(T &arr) {
-    if (!arr.BucketHead) return &arr.BaseBucket;
-    return arr.BucketHead;
+auto *get(const T &arr, s64 index) {
+    using V = typename T::T;
+
+    if (index < 0 || index >= arr.Buckets.Count * T::ELEMENTS_PER_BUCKET) return (V *) null;
+
+    auto *b = arr.Buckets.Data[index / T::ELEMENTS_PER_BUCKET];
+    s64 slot = index % T::ELEMENTS_PER_BUCKET;
+    if (!(b->Occupied[slot / 64] & (1ull << (slot % 64)))) return (V *) null;
+    return (V *) b->Elements + slot;
+}
+
+// Returns the index of an element in the array (for passing to get() and remove()), or -1 if it's not from this array.
+template <is_bucket_array T>
+s64 index_of(const T &arr, const typename T::T *element) {
+    For_as(bucketIndex, range(arr.Buckets.Count)) {
+        auto *b = arr.Buckets.Data[bucketIndex];
+        if (element >= b->Elements && element < b->Elements + T::ELEMENTS_PER_BUCKET) {
+            return bucketIndex * T::ELEMENTS_PER_BUCKET + (element - b->Elements);
+        }
+    }
+    return -1;
 }
 
 // Search based on predicate
 template <is_bucket_array T>
 auto *find(const T &arr, const delegate<bool(typename T::T *)> &predicate) {
-    auto *b = get_bucket_head(arr);
-    while (b) {
-        auto index = b->Elements.find(predicate);
-        if (index != -1) return (typename T::T *) b->Elements[index];
-        b = b->Next;
+    for (auto &it : arr) {
+        if (predicate((typename T::T *) &it)) return (typename T::T *) &it;
     }
-    return null;
+    return (typename T::T *) null;
 }
 
+// Puts a deep copy of _element_ in the first free slot (allocating a new bucket with _alloc_ if all are full).
+// If _outIndex_ is not null, stores the index of the new element there.
 template <is_bucket_array T>
-auto *append(T &arr, const typename T::T &element, allocator alloc = {}) {
+auto *add(T &arr, const typename T::T &element, allocator alloc = {}, s64 *outIndex = null) {
+    using V = typename T::T;
+
     if (!alloc) alloc = Context.Alloc;
 
-    auto *b = get_bucket_head(arr), *last = b;
-    while (b) {
-        if (b->Allocated != b->Count) {
-            clone(b->Elements + b->Count, element);
-            ++b->Count;
-            return b->Elements + b->Count - 1;
+    while (arr.FirstBucketWithRoom < arr.Buckets.Count && arr.Buckets[arr.FirstBucketWithRoom]->Count == T::ELEMENTS_PER_BUCKET) {
+        ++arr.FirstBucketWithRoom;
+    }
+
+    if (arr.FirstBucketWithRoom == arr.Buckets.Count) {
+        auto *nb = allocate<typename T::bucket>({.Alloc = alloc});
+        nb->Elements = allocate_array<V>(T::ELEMENTS_PER_BUCKET, {.Alloc = alloc});
+
+        PUSH_ALLOC(alloc) {
+            array_append(arr.Buckets, nb);
         }
-        last = b;
-        b = b->Next;
     }
 
-    b = last->Next = allocate<T::bucket>({.Alloc = alloc});
-    b->Elements = allocate_array<typename T::T>(T::ELEMENTS_PER_BUCKET, {.Alloc = alloc});
-    b->Allocated = T::ELEMENTS_PER_BUCKET;
-    clone(b->Elements, element);
-    b->Count = 1;
-    return b->Elements;
+    s64 bucketIndex = arr.FirstBucketWithRoom;
+    auto *b = arr.Buckets[bucketIndex];
+
+    s64 slot = -1;
+    For(range(T::MASK_WORDS)) {
+        u64 freeSlots = ~b->Occupied[it];
+        if (freeSlots) {
+            slot = it * 64 + lsb(freeSlots);
+            break;
+        }
+    }
+    assert(slot != -1 && slot < T::ELEMENTS_PER_BUCKET);
+
+    b->Occupied[slot / 64] |= 1ull << (slot % 64);
+    ++b->Count;
+    ++arr.Count;
+
+    clone(b->Elements + slot, element);
+
+    if (outIndex) *outIndex = bucketIndex * T::ELEMENTS_PER_BUCKET + slot;
+    return b->Elements + slot;
+}
+
+// Calls the destructor of the element at _index_ and marks its slot as free.
+// Returns false if there was no element there.
+template <is_bucket_array T>
+bool remove(T &arr, s64 index) {
+    using V = typename T::T;
+
+    auto *element = get(arr, index);
+    if (!element) return false;
+
+    element->~V();
+
+    s64 bucketIndex = index / T::ELEMENTS_PER_BUCKET;
+    s64 slot = index % T::ELEMENTS_PER_BUCKET;
+
+    auto *b = arr.Buckets[bucketIndex];
+    b->Occupied[slot / 64] &= ~(1ull << (slot % 64));
+    --b->Count;
+    --arr.Count;
+
+    arr.FirstBucketWithRoom = min(arr.FirstBucketWithRoom, bucketIndex);
+    return true;
+}
+
+template <is_bucket_array T>
+s64 bucket_count(const T &arr) { return arr.Buckets.Count; }
+
+// Returns something you can iterate with a range-based for loop, which goes through the elements of buckets [firstBucket, endBucket).
+// Ranges which don't overlap can be iterated from different threads at the same time (as long as no one is adding or removing).
+template <is_bucket_array T>
+auto get_range(T &arr, s64 firstBucket, s64 endBucket) {
+    assert(firstBucket >= 0 && firstBucket <= endBucket && endBucket <= arr.Buckets.Count);
+    return typename T::bucket_range{&arr, firstBucket, endBucket};
 }
 
 template <is_bucket_array T, typename U>
-auto *find_or_create(const T &arr, const U &toMatch, const delegate<U(typename T::T *)> &map, allocator alloc = {}) {
-    if (!alloc) alloc = Context.Alloc;
+auto *find_or_create(T &arr, const U &toMatch, const delegate<U(typename T::T *)> &map, allocator alloc = {}) {
+    using V = typename T::T;
 
-    T *result = find(arr, [&](T *element) { return map(element) == toMatch; });
+    V *result = find(arr, [&](V *element) { return map(element) == toMatch; });
     if (result) return result;
 
-    result = allocate<T>({.Alloc = alloc});
-    append(arr, *result);
-    return result;
+    return add(arr, V{}, alloc);
 }
 
 LSTD_END_NAMESPACE
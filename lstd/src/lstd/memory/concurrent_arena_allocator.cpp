@@ -0,0 +1,185 @@
+#include "allocator.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+// A part of a pool which one thread bumps from without atomics
+struct concurrent_arena_chunk {
+    concurrent_arena_allocator_data *Arena = null;
+    s64 Generation = 0;
+
+    byte *Cursor = null, *End = null;
+};
+
+// How many arenas a thread keeps a chunk of at the same time
+constexpr s64 CONCURRENT_ARENA_CACHED_CHUNKS = 4;
+
+file_scope thread_local concurrent_arena_chunk Chunks[CONCURRENT_ARENA_CACHED_CHUNKS];
+file_scope thread_local s64 NextChunk = 0;  // Replaced round robin
+
+// Generations are unique across all arenas, so a chunk of an arena which was released doesn't match
+// a new arena at the same address
+file_scope s64 LastGeneration = 0;
+
+file_scope s64 concurrent_arena_new_generation() { return atomic_add(&LastGeneration, (s64) 1) + 1; }
+
+file_scope s64 concurrent_arena_generation(concurrent_arena_allocator_data *data) {
+    s64 generation = atomic_load(&data->Generation);
+    if (generation) return generation;
+
+    // First use, the thread which loses the race takes the winner's
+    s64 fresh = concurrent_arena_new_generation();
+    s64 old = atomic_compare_and_swap(&data->Generation, fresh, (s64) 0);
+    return old ? old : fresh;
+}
+
+file_scope concurrent_arena_chunk *concurrent_arena_find_chunk(concurrent_arena_allocator_data *data) {
+    s64 generation = concurrent_arena_generation(data);
+    For(Chunks) {
+        if (it.Arena == data && it.Generation == generation) return &it;
+    }
+    return null;
+}
+
+// Appends a pool big enough for _size_ after _full_ (unless another thread did it already)
+file_scope bool concurrent_arena_grow(concurrent_arena_allocator_data *data, allocator_pool *full, s64 size) {
+    while (atomic_compare_and_swap(&data->GrowLock, 1, 0) != 0) cpu_pause();
+    defer(atomic_store(&data->GrowLock, 0));
+
+    if (atomic_load(&data->Current) != full) return true;  // Someone else moved on while we waited
+
+    // After a FREE_ALL the pools after the current one are empty again
+    if (full && full->Next) {
+        atomic_store(&data->Current, full->Next);
+        return true;
+    }
+
+    s64 poolSize = max(data->PoolSize, size + (s64) sizeof(allocator_pool));
+
+    auto *pool = (allocator_pool *) os_allocate_block(poolSize);
+    if (!pool) return false;
+
+    pool->Next = null;
+    pool->Size = poolSize - sizeof(allocator_pool);
+    pool->Used = 0;
+
+    if (full) {
+        atomic_store(&full->Next, pool);
+    } else {
+        atomic_store(&data->Base, pool);
+    }
+    atomic_inc(&data->PoolsCount);
+    atomic_store(&data->Current, pool);
+    return true;
+}
+
+// Bumps _size_ bytes from the current pool. A thread which overshoots leaves the pool's _Used_ past its size,
+// which marks it full for everyone.
+file_scope byte *concurrent_arena_bump(concurrent_arena_allocator_data *data, s64 size) {
+    while (true) {
+        auto *p = atomic_load(&data->Current);
+        if (p) {
+            s64 used = atomic_add(&p->Used, size);
+            if (used + size <= p->Size) {
+                atomic_add(&data->TotalUsed, size);
+                return (byte *) (p + 1) + used;
+            }
+
+            auto *next = atomic_load(&p->Next);
+            if (next) {
+                atomic_compare_and_swap(&data->Current, next, p);
+                continue;
+            }
+        }
+        if (!concurrent_arena_grow(data, p, size)) return null;  // Out of memory
+    }
+}
+
+void *concurrent_arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    auto *data = (concurrent_arena_allocator_data *) context;
+
+    switch (mode) {
+        case allocator_mode::ADD_POOL:
+        case allocator_mode::REMOVE_POOL: {
+            assert(false && "Concurrent arenas manage their own pools. Set _PoolSize_ instead.");
+            return null;
+        }
+        case allocator_mode::ALLOCATE: {
+            if (size > data->ChunkSize / 4) return concurrent_arena_bump(data, size);
+
+            auto *c = concurrent_arena_find_chunk(data);
+            if (!c || c->Cursor + size > c->End) {
+                s64 generation = concurrent_arena_generation(data);
+
+                byte *chunk = concurrent_arena_bump(data, data->ChunkSize);
+                if (!chunk) return null;
+
+                if (!c) {
+                    c = Chunks + NextChunk;
+                    NextChunk = (NextChunk + 1) % CONCURRENT_ARENA_CACHED_CHUNKS;
+                }
+                c->Arena = data;
+                c->Generation = generation;
+                c->Cursor = chunk;
+                c->End = chunk + data->ChunkSize;
+            }
+
+            void *result = c->Cursor;
+            c->Cursor += size;
+            return result;
+        }
+        case allocator_mode::RESIZE: {
+            // Only the last block of our chunk can grow or shrink in place
+            auto *c = concurrent_arena_find_chunk(data);
+            if (!c || (byte *) oldMemory + oldSize != c->Cursor) return null;
+            if ((byte *) oldMemory + size > c->End) return null;
+
+            c->Cursor = (byte *) oldMemory + size;
+            return oldMemory;
+        }
+        case allocator_mode::FREE: {
+            auto *c = concurrent_arena_find_chunk(data);
+            if (c && (byte *) oldMemory + oldSize == c->Cursor) c->Cursor = (byte *) oldMemory;
+
+            // null means success FREE
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            auto *p = data->Base;
+            while (p) {
+                p->Used = 0;
+                p = p->Next;
+            }
+
+            data->Current = data->Base;
+            data->TotalUsed = 0;
+            atomic_store(&data->Generation, concurrent_arena_new_generation());
+
+            return null;
+        }
+        case allocator_mode::ALLOCATE_BATCH:
+        case allocator_mode::FREE_BATCH:
+            return (void *) -1;  // Falls back to allocating/freeing blocks one by one
+        default:
+            assert(false);
+    }
+    return null;
+}
+
+void concurrent_arena_release(concurrent_arena_allocator_data *data) {
+    auto *p = data->Base;
+    while (p) {
+        auto *next = p->Next;
+        os_free_block(p);
+        p = next;
+    }
+
+    data->Base = data->Current = null;
+    data->PoolsCount = data->TotalUsed = 0;
+    atomic_store(&data->Generation, (s64) 0);
+
+    allocator_registry_remove({concurrent_arena_allocator, data});
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "../internal/context.h"
+#include "hash_table.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// A hash table which can be used from many threads at the same time.
+//
+// The entries are split between _ShardCount_ normal hash_tables (picked by the high bits of the hash,
+// the shard itself uses the low bits), each guarded by its own reader/writer lock.
+// Lookups only take their shard shared, so read-mostly tables (global caches etc.) scale with the number
+// of threads instead of being serialized by a single mutex. Writers only block the threads that hit the same shard.
+//
+// Pointers into a shard aren't valid after its lock is released (another thread may grow or remove from it),
+// so unlike hash_table, find() copies the value out. If you need to look at a value in place
+// (e.g. it's large), use find_and_visit().
+//
+// The shards allocate with _Alloc_ (if it's set, otherwise with the Context's allocator of the thread
+// which causes the allocation). Since any thread can add to the table you should usually set it
+// to something thread safe (the persistent allocator for global caches).
+//
+// Iteration isn't supported, most of the time it's a race anyway. Use for_each() which locks each shard in turn.
+template <typename K_, typename V_, s64 ShardCount = 16>
+struct concurrent_hash_table {
+    using K = K_;
+    using V = V_;
+
+    static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "Shard count must be a power of two");
+    static constexpr s64 SHARD_COUNT = ShardCount;
+    static constexpr s64 SHARD_SHIFT = 64 - msb((u64) ShardCount);  // We use the top bits of the hash to pick a shard
+
+    // Each shard on its own cache line so threads working on different shards don't fight over it
+    struct alignas(64) shard {
+        thread::fast_shared_mutex Mutex;
+        hash_table<K, V> Table;
+    };
+
+    shard Shards[ShardCount];
+
+    allocator Alloc;
+
+    concurrent_hash_table() {}
+};
+
+template <typename T>
+struct is_concurrent_hash_table : types::false_t {};
+
+template <typename K, typename V, s64 ShardCount>
+struct is_concurrent_hash_table<concurrent_hash_table<K, V, ShardCount>> : types::true_t {};
+
+template <typename T>
+concept any_concurrent_hash_table = is_concurrent_hash_table<T>::value;
+
+template <any_concurrent_hash_table T>
+auto *concurrent_hash_table_get_shard(T &table, u64 hash) {
+    if constexpr (T::SHARD_COUNT == 1) {
+        return &table.Shards[0];
+    } else {
+        return &table.Shards[hash >> T::SHARD_SHIFT];
+    }
+}
+
+// Frees the memory of all shards. Not thread safe, make sure no one else is using the table.
+template <any_concurrent_hash_table T>
+void free(T &table) {
+    For(table.Shards) free(it.Table);
+}
+
+// Destroys all entries but keeps the memory around. Locks every shard in turn.
+template <any_concurrent_hash_table T>
+void reset(T &table) {
+    For(table.Shards) {
+        thread::scoped_lock<thread::fast_shared_mutex> _(&it.Mutex);
+        reset(it.Table);
+    }
+}
+
+// Reserves space in every shard for _target_ / SHARD_COUNT elements (assuming the hash spreads the keys evenly).
+template <any_concurrent_hash_table T>
+void reserve(T &table, s64 target, u32 alignment = 0) {
+    For(table.Shards) {
+        thread::scoped_lock<thread::fast_shared_mutex> _(&it.Mutex);
+        PUSH_ALLOC(table.Alloc ? table.Alloc : Context.Alloc) {
+            reserve(it.Table, target / T::SHARD_COUNT, alignment);
+        }
+    }
+}
+
+// Only a snapshot, other threads may change the table while we are counting.
+template <any_concurrent_hash_table T>
+s64 count(T &table) {
+    s64 result = 0;
+    For(table.Shards) result += atomic_compare_and_swap(&it.Table.Count, 0ll, 0ll);
+    return result;
+}
+
+// Copies the value into _out_ (if it's not null) and returns true if the key was found.
+// This method is useful if you have cached the hash.
+template <any_concurrent_hash_table T>
+bool find_prehashed(T &table, u64 hash, const typename T::K &key, typename T::V *out = null) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::shared_lock _(&s->Mutex);
+
+    auto [kp, vp] = find_prehashed(s->Table, hash, key);
+    if (!vp) return false;
+
+    if (out) *out = *vp;
+    return true;
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_concurrent_hash_table T>
+bool find(T &table, const typename T::K &key, typename T::V *out = null) { return find_prehashed(table, get_hash(key), key, out); }
+
+// Calls _visit_ with a pointer to the value while the shard is still locked (shared, so don't modify the value!).
+// Returns false (and doesn't call _visit_) if the key wasn't found.
+template <any_concurrent_hash_table T, typename Visit>
+bool find_and_visit_prehashed(T &table, u64 hash, const typename T::K &key, Visit visit) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::shared_lock _(&s->Mutex);
+
+    auto [kp, vp] = find_prehashed(s->Table, hash, key);
+    if (!vp) return false;
+
+    visit((const typename T::V *) vp);
+    return true;
+}
+
+template <any_concurrent_hash_table T, typename Visit>
+bool find_and_visit(T &table, const typename T::K &key, Visit visit) { return find_and_visit_prehashed(table, get_hash(key), key, visit); }
+
+template <any_concurrent_hash_table T>
+bool has_prehashed(T &table, u64 hash, const typename T::K &key) { return find_prehashed(table, hash, key); }
+
+template <any_concurrent_hash_table T>
+bool has(T &table, const typename T::K &key) { return find(table, key); }
+
+// Adds the key and value without checking if the key is already in the table (like hash_table's add).
+// This method is useful if you have cached the hash.
+template <any_concurrent_hash_table T>
+void add_prehashed(T &table, u64 hash, const typename T::K &key, const typename T::V &value) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+    PUSH_ALLOC(table.Alloc ? table.Alloc : Context.Alloc) {
+        add_prehashed(s->Table, hash, key, value);
+    }
+}
+
+template <any_concurrent_hash_table T>
+void add(T &table, const typename T::K &key, const typename T::V &value) { add_prehashed(table, get_hash(key), key, value); }
+
+// Adds the key and value if the key isn't in the table, otherwise overwrites the value.
+// Returns true if the key was already there.
+template <any_concurrent_hash_table T>
+bool set_prehashed(T &table, u64 hash, const typename T::K &key, const typename T::V &value) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+
+    auto [kp, vp] = find_prehashed(s->Table, hash, key);
+    if (vp) {
+        *vp = value;
+        return true;
+    }
+
+    PUSH_ALLOC(table.Alloc ? table.Alloc : Context.Alloc) {
+        add_prehashed(s->Table, hash, key, value);
+    }
+    return false;
+}
+
+template <any_concurrent_hash_table T>
+bool set(T &table, const typename T::K &key, const typename T::V &value) { return set_prehashed(table, get_hash(key), key, value); }
+
+// Adds the key and value only if the key isn't in the table yet (check and insert happen under the same lock,
+// so two threads racing to fill a cache entry don't both add it).
+// Returns true if we added it. If the key was already there and _existing_ is not null, copies the existing value there.
+template <any_concurrent_hash_table T>
+bool add_if_missing_prehashed(T &table, u64 hash, const typename T::K &key, const typename T::V &value, typename T::V *existing = null) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+
+    auto [kp, vp] = find_prehashed(s->Table, hash, key);
+    if (vp) {
+        if (existing) *existing = *vp;
+        return false;
+    }
+
+    PUSH_ALLOC(table.Alloc ? table.Alloc : Context.Alloc) {
+        add_prehashed(s->Table, hash, key, value);
+    }
+    return true;
+}
+
+template <any_concurrent_hash_table T>
+bool add_if_missing(T &table, const typename T::K &key, const typename T::V &value, typename T::V *existing = null) {
+    return add_if_missing_prehashed(table, get_hash(key), key, value, existing);
+}
+
+// Returns true if the key was found and removed.
+// This method is useful if you have cached the hash.
+template <any_concurrent_hash_table T>
+bool remove_prehashed(T &table, u64 hash, const typename T::K &key) {
+    auto *s = concurrent_hash_table_get_shard(table, hash);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+    return remove_prehashed(s->Table, hash, key);
+}
+
+template <any_concurrent_hash_table T>
+bool remove(T &table, const typename T::K &key) { return remove_prehashed(table, get_hash(key), key); }
+
+// Calls _visit_ with pointers to every key and value, holding each shard shared while we go through it.
+// Don't call functions which modify the table from _visit_ (that deadlocks when it hits the same shard).
+template <any_concurrent_hash_table T, typename Visit>
+void for_each(T &table, Visit visit) {
+    For(table.Shards) {
+        thread::shared_lock _(&it.Mutex);
+        for (auto [kp, vp] : it.Table) visit((const typename T::K *) kp, (const typename T::V *) vp);
+    }
+}
+
+template <typename K, typename V, s64 ShardCount>
+concurrent_hash_table<K, V, ShardCount> *clone(concurrent_hash_table<K, V, ShardCount> *dest, const concurrent_hash_table<K, V, ShardCount> &src) {
+    assert(false && "We don't deep copy concurrent hash tables");
+    return null;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "../internal/context.h"
+#include "signal.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A signal which any thread can emit, connect to and disconnect from at the same time.
+//
+// The callbacks are kept in an immutable list (a snapshot). connect() and disconnect() make a new list with the
+// change applied and swap it in (copy on write), an emit walks whichever list was current when it started.
+// So emitting never takes a lock and never waits for anyone: it's two atomic increments and a load on top of
+// calling the callbacks. Writers are serialized by a lock between them.
+//
+// That has a few consequences:
+// * A callback connected during an emit is called from the next emit on.
+// * A callback disconnected during an emit may still be called by emits which are already running
+//   (including the one which disconnected it). If the callback's object is about to be freed,
+//   call synchronize() after disconnect(), it returns once those emits are done.
+// * Disconnected callbacks don't leave holes, every list has only the live ones.
+// * Callbacks can connect and disconnect (even themselves) while being emitted.
+//
+// The old lists can't be freed while an emit may be reading them. Each emit marks itself in a per-thread-ish
+// counter (one of _STRIPE_COUNT_, each on its own cache line so emitting threads don't fight over it) for the
+// current epoch. A replaced list is freed once the epoch has moved on twice, which happens whenever the counters
+// of the previous epoch drain. We try that on every connect/disconnect and at the end of emits (without waiting
+// if another thread holds the lock), so lists only pile up while emits keep overlapping for a very long time.
+//
+// Connection ids are never reused, unlike signal's (which are indices into its array).
+//
+// As with signal the callbacks are owning_delegates. What a disconnected callback allocated is freed together
+// with the last list which had it.
+//
+// The lists are allocated with _Alloc_ (if it's set, otherwise with the Context's allocator of the thread which
+// connects or disconnects). Since any thread may do that, you should usually set it to something thread safe.
+//
+template <typename Signature, typename Collector = collector_default<typename delegate<Signature>::return_t>>
+struct concurrent_signal;
+
+template <typename R, typename... Args, typename Collector>
+struct concurrent_signal<R(Args...), Collector> : public non_copyable {
+    using result_t = R;
+    using callback_t = owning_delegate<R(Args...)>;
+    using collector_result_t = typename Collector::result_t;
+
+    static constexpr s64 STRIPE_COUNT = 8;
+
+    struct slot {
+        s64 ID;
+        callback_t Callback;
+    };
+
+    // Never modified after it's published, only replaced (emits don't look at anything but _Count_ and the slots)
+    struct snapshot {
+        s64 Count;
+
+        s64 RetiredEpoch;
+        snapshot *NextRetired;
+        s64 Removed;  // The slot disconnect() took out when it replaced this list, freed with it
+
+        slot *slots() { return (slot *) (this + 1); }
+    };
+
+    // How many emits which started in an even/odd epoch are still running
+    struct alignas(64) stripe {
+        s64 Emitting[2];
+    };
+
+    // Read by every emit, written only on connect/disconnect
+    alignas(64) snapshot *Current = null;
+    s64 Epoch = 0;
+
+    stripe Stripes[STRIPE_COUNT];
+
+    alignas(64) thread::fast_mutex Lock;
+    snapshot *Retired = null;  // Newest first
+    s64 NextID = 0;
+
+    internal::collector_invocation<Collector, R(Args...)> Invoker;
+
+    allocator Alloc;
+
+    concurrent_signal() {}
+
+    // Frees every list. Not thread safe, make sure no one is emitting or connecting anymore.
+    void release() {
+        if (Current) {
+            For(range(Current->Count)) free(Current->slots()[it].Callback);
+            general_free(Current);
+        }
+        Current = null;
+
+        free_retired(Retired);
+        Retired = null;
+    }
+
+    // Adds a callback, returns an id which you can pass to disconnect(). Returns -1 if _cb_ is null.
+    s64 connect(const callback_t &cb) {
+        if (!cb) return -1;
+
+        thread::scoped_lock _(&Lock);
+
+        s64 count = Current ? Current->Count : 0;
+
+        auto *s = new_snapshot(count + 1);
+        if (count) copy_memory(s->slots(), Current->slots(), count * sizeof(slot));
+
+        s64 id = NextID++;
+        s->slots()[count] = {id, cb};
+
+        replace(s);
+        return id;
+    }
+
+    // Removes a callback. Returns false if there is no callback with that id (e.g. it was already disconnected).
+    bool disconnect(s64 id) {
+        thread::scoped_lock _(&Lock);
+
+        if (!Current) return false;
+
+        auto *slots = Current->slots();
+
+        s64 index = -1;
+        For(range(Current->Count)) {
+            if (slots[it].ID == id) {
+                index = it;
+                break;
+            }
+        }
+        if (index == -1) return false;
+
+        s64 count = Current->Count - 1;
+
+        snapshot *s = null;
+        if (count) {
+            s = new_snapshot(count);
+            copy_memory(s->slots(), slots, index * sizeof(slot));
+            copy_memory(s->slots() + index, slots + index + 1, (count - index) * sizeof(slot));
+        }
+
+        Current->Removed = index;
+        replace(s);
+        return true;
+    }
+
+    // The number of connected callbacks. Only a snapshot, other threads may be changing it.
+    s64 count() {
+        auto mark = begin_emit();  // So the list isn't freed while we look at it
+        auto *s = atomic_load(&Current);
+        s64 result = s ? s->Count : 0;
+        end_emit(mark);
+        return result;
+    }
+
+    // Emit a signal, i.e. invoke all callbacks and collect return types with the Collector.
+    // If the result is an array, the caller is responsible for freeing the memory.
+    //
+    // Safe to call from any number of threads, callbacks are called on the emitting thread.
+    [[nodiscard]] collector_result_t emit(Args... args) {
+        auto mark = begin_emit();
+
+        Collector collector;
+
+        auto *s = atomic_load(&Current);
+        if (s) {
+            auto *slots = s->slots();
+            For(range(s->Count)) {
+                if (!Invoker.invoke(collector, slots[it].Callback, ((Args &&) args)...)) break;
+            }
+        }
+
+        end_emit(mark);
+
+        if constexpr (!types::is_same<collector_result_t, void>) {
+            return collector.result();
+        }
+    }
+
+    // Waits until every emit which started before this call is done (so callbacks disconnected before it
+    // won't be called anymore) and frees the lists they were using.
+    //
+    // Don't call it from a callback, it would wait for its own emit.
+    void synchronize() {
+        s64 target = atomic_load(&Epoch) + 2;
+        while (true) {
+            {
+                thread::scoped_lock _(&Lock);
+                advance();
+                if (Epoch >= target) break;
+            }
+            thread::sleep(0);
+        }
+    }
+
+    // The counter an emit was counted in, it decrements the same one at the end
+    using emit_mark = s64 *;
+
+    emit_mark begin_emit() {
+        // Thread ids on Windows are multiples of 4, so hash them instead of masking the low bits
+        static_assert(STRIPE_COUNT == 8);
+        u64 stripe = (Context.ThreadID.Value * 0x9E3779B97F4A7C15ull) >> 61;
+
+        // The increment has to happen before we read _Current_, a writer which sees zero after swapping the list
+        // then knows we'll see the new one. The atomic read-modify-write is a full barrier.
+        s64 *counter = &Stripes[stripe].Emitting[atomic_load(&Epoch) & 1];
+        atomic_inc(counter);
+        return counter;
+    }
+
+    void end_emit(emit_mark counter) {
+        atomic_add(counter, (s64) -1);
+
+        // Free old lists if we can do it right now, writers do it too
+        if (atomic_load(&Retired) && Lock.try_lock()) {
+            advance();
+            Lock.unlock();
+        }
+    }
+
+    //
+    // The rest are called with _Lock_ held
+    //
+
+    snapshot *new_snapshot(s64 count) {
+        s64 size = sizeof(snapshot) + count * sizeof(slot);
+
+        auto *s = (snapshot *) general_allocate(Alloc ? Alloc : Context.Alloc, size, 0);
+        s->Count = count;
+        s->RetiredEpoch = 0;
+        s->NextRetired = null;
+        s->Removed = -1;
+        return s;
+    }
+
+    void replace(snapshot *s) {
+        auto *old = atomic_swap(&Current, s);
+        if (old) {
+            old->RetiredEpoch = Epoch;
+            old->NextRetired = Retired;
+            atomic_store(&Retired, old);
+        }
+        advance();
+    }
+
+    s64 emitting(s64 parity) {
+        s64 result = 0;
+        For(Stripes) result += atomic_load(&it.Emitting[parity]);
+        return result;
+    }
+
+    // Moves to the next epoch if every emit of the previous one is done, then frees the lists retired at least
+    // two epochs ago. An emit which saw a list marks itself with the epoch it read before loading it, that's
+    // at most the one the list was retired in. So after two moves none of them can still be running.
+    void advance() {
+        // New emits count in the current epoch's parity, so the other one only drains
+        if (emitting((Epoch + 1) & 1) == 0) atomic_store(&Epoch, Epoch + 1);
+
+        // The list is newest first, find the first which is old enough and free everything after it
+        snapshot **link = &Retired;
+        while (*link && (*link)->RetiredEpoch + 2 > Epoch) link = &(*link)->NextRetired;
+
+        auto *s = *link;
+        atomic_store(link, (snapshot *) null);
+        free_retired(s);
+    }
+
+    void free_retired(snapshot *s) {
+        while (s) {
+            auto *next = s->NextRetired;
+            if (s->Removed != -1) free(s->slots()[s->Removed].Callback);
+            general_free(s);
+            s = next;
+        }
+    }
+};
+
+LSTD_END_NAMESPACE
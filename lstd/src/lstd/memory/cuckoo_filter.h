@@ -0,0 +1,293 @@
+#pragma once
+
+#include "bloom_filter.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A cuckoo filter - like a Bloom filter (see bloom_filter.h) it answers "definitely not in here" or "probably in here",
+// but it also supports removing keys. Use it when the set changes over time (e.g. a cache of what's on disk).
+//
+//     cuckoo_filter cached;
+//     cuckoo_filter_init(cached, expectedCount);
+//     add(cached, key);     // Returns false if the filter is full
+//     ...
+//     if (has(cached, key)) ...
+//     remove(cached, key);  // Only remove keys which you have added!
+//
+// We store a 16 bit fingerprint of each key in one of two buckets, a bucket holds 4 fingerprints in a single u64.
+// A lookup reads at most two buckets and compares all 4 fingerprints in a bucket at once. The false positive rate
+// is about 8 / 2^16 ~ 0.012% no matter how full the filter is, and it can be filled to ~95% before inserts start to fail.
+//
+// The second bucket is (first bucket ^ hash of the fingerprint), so we can find it from either bucket and move
+// fingerprints around without knowing the original keys. When both buckets are full, add() kicks a random
+// fingerprint out to its other bucket, which may kick out another, etc.
+//
+// Note: Adding the same key more than 8 times fills both of its buckets, so don't use this as a multiset.
+//
+constexpr s64 CUCKOO_FILTER_BUCKET_SLOTS = 4;
+constexpr s64 CUCKOO_FILTER_MAX_KICKS = 500;
+
+struct cuckoo_filter {
+    u64 *Buckets = null;  // Each has 4 fingerprints of 16 bits, 0 means the slot is empty
+    s64 BucketCount = 0;  // Always a power of 2
+    s64 Count = 0;
+
+    // When we run out of kicks we are left holding a fingerprint which has no place to go.
+    // We keep it here (so has() doesn't report a false negative) and treat the filter as full.
+    u16 Victim = 0;
+    s64 VictimBucket = 0;
+
+    u64 KickState = 0x2545F4914F6CDD1Dull;  // Random number generator for picking which slot to kick
+
+    cuckoo_filter() {}
+};
+
+namespace internal {
+constexpr u64 CUCKOO_FILTER_LANES = 0x0001000100010001ull;
+
+always_inline u16 cuckoo_filter_fingerprint(u64 h) {
+    u16 fp = (u16) (h >> 48);
+    return fp ? fp : 1;  // 0 marks an empty slot
+}
+
+always_inline s64 cuckoo_filter_alt_bucket(const cuckoo_filter &f, s64 bucket, u16 fp) {
+    return (s64) (((u64) bucket ^ hash_u64(fp)) & (u64) (f.BucketCount - 1));
+}
+
+// True if any of the 16 bit lanes of _x_ is 0
+always_inline bool cuckoo_filter_has_zero_lane(u64 x) { return (x - CUCKOO_FILTER_LANES) & ~x & (CUCKOO_FILTER_LANES << 15); }
+
+always_inline bool cuckoo_filter_bucket_has(u64 bucket, u16 fp) { return cuckoo_filter_has_zero_lane(bucket ^ (fp * CUCKOO_FILTER_LANES)); }
+
+always_inline u16 cuckoo_filter_get_slot(u64 bucket, s64 slot) { return (u16) (bucket >> (slot * 16)); }
+
+always_inline void cuckoo_filter_set_slot(u64 &bucket, s64 slot, u16 fp) {
+    bucket = (bucket & ~(0xFFFFull << (slot * 16))) | ((u64) fp << (slot * 16));
+}
+
+// Puts _fp_ in an empty slot of _bucket_, returns false if it's full.
+inline bool cuckoo_filter_try_insert(cuckoo_filter &f, s64 bucket, u16 fp) {
+    u64 &b = f.Buckets[bucket];
+    if (!cuckoo_filter_has_zero_lane(b)) return false;
+
+    For(range(CUCKOO_FILTER_BUCKET_SLOTS)) {
+        if (!cuckoo_filter_get_slot(b, it)) {
+            cuckoo_filter_set_slot(b, it, fp);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Clears one slot of _bucket_ which holds _fp_, returns false if there is none.
+inline bool cuckoo_filter_try_remove(cuckoo_filter &f, s64 bucket, u16 fp) {
+    u64 &b = f.Buckets[bucket];
+    if (!cuckoo_filter_bucket_has(b, fp)) return false;
+
+    For(range(CUCKOO_FILTER_BUCKET_SLOTS)) {
+        if (cuckoo_filter_get_slot(b, it) == fp) {
+            cuckoo_filter_set_slot(b, it, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr u32 CUCKOO_FILTER_MAGIC = 0x3146434C;  // "LCF1"
+
+struct cuckoo_filter_header {
+    u32 Magic;
+    u16 Victim;
+    u16 Reserved;
+    u64 BucketCount;
+    u64 Count;
+    u64 VictimBucket;
+};
+}  // namespace internal
+
+inline void free(cuckoo_filter &f) {
+    if (f.Buckets) free(f.Buckets);
+    f.Buckets = null;
+    f.BucketCount = f.Count = 0;
+    f.Victim = 0;
+    f.VictimBucket = 0;
+}
+
+// Allocates a filter for about _expectedCount_ keys. Frees the old contents of _f_.
+inline void cuckoo_filter_init(cuckoo_filter &f, s64 expectedCount, allocator alloc = {}) {
+    free(f);
+
+    // Leave some room, inserts start failing at around 95% load
+    s64 buckets = (max<s64>(expectedCount, 1) * 100 / 95 + CUCKOO_FILTER_BUCKET_SLOTS - 1) / CUCKOO_FILTER_BUCKET_SLOTS;
+    f.BucketCount = max<s64>(ceil_pow_of_2(buckets), 2);
+
+    f.Buckets = allocate_array<u64>(f.BucketCount, {.Alloc = alloc, .Alignment = 64});
+    zero_memory(f.Buckets, f.BucketCount * sizeof(u64));
+}
+
+// Number of keys in the filter
+inline s64 count(const cuckoo_filter &f) { return f.Count; }
+
+// Removes all keys, keeps the memory.
+inline void reset(cuckoo_filter &f) {
+    if (f.Buckets) zero_memory(f.Buckets, f.BucketCount * sizeof(u64));
+    f.Count = 0;
+    f.Victim = 0;
+}
+
+// Returns false if the filter is full (the key isn't added then).
+inline bool add_prehashed(cuckoo_filter &f, u64 hash) {
+    assert(f.BucketCount && "Cuckoo filter not initialized, call cuckoo_filter_init()");
+    if (f.Victim) return false;
+
+    u64 h = internal::filter_remix(hash);
+    u16 fp = internal::cuckoo_filter_fingerprint(h);
+
+    s64 i1 = (s64) (h & (u64) (f.BucketCount - 1));
+    s64 i2 = internal::cuckoo_filter_alt_bucket(f, i1, fp);
+
+    if (internal::cuckoo_filter_try_insert(f, i1, fp) || internal::cuckoo_filter_try_insert(f, i2, fp)) {
+        ++f.Count;
+        return true;
+    }
+
+    // Both are full, start kicking
+    s64 bucket = (f.KickState & 1) ? i1 : i2;
+    For(range(CUCKOO_FILTER_MAX_KICKS)) {
+        // xorshift64
+        f.KickState ^= f.KickState << 13;
+        f.KickState ^= f.KickState >> 7;
+        f.KickState ^= f.KickState << 17;
+
+        s64 slot = (s64) (f.KickState % CUCKOO_FILTER_BUCKET_SLOTS);
+
+        u16 kicked = internal::cuckoo_filter_get_slot(f.Buckets[bucket], slot);
+        internal::cuckoo_filter_set_slot(f.Buckets[bucket], slot, fp);
+        fp = kicked;
+
+        bucket = internal::cuckoo_filter_alt_bucket(f, bucket, fp);
+        if (internal::cuckoo_filter_try_insert(f, bucket, fp)) {
+            ++f.Count;
+            return true;
+        }
+    }
+
+    // The new key is in, but some other fingerprint is left without a place
+    f.Victim = fp;
+    f.VictimBucket = bucket;
+    ++f.Count;
+    return true;
+}
+
+// Returns false if the key was definitely never added (or was removed), true if it probably is in.
+inline bool has_prehashed(const cuckoo_filter &f, u64 hash) {
+    if (!f.BucketCount) return false;
+
+    u64 h = internal::filter_remix(hash);
+    u16 fp = internal::cuckoo_filter_fingerprint(h);
+
+    s64 i1 = (s64) (h & (u64) (f.BucketCount - 1));
+    s64 i2 = internal::cuckoo_filter_alt_bucket(f, i1, fp);
+
+    if (internal::cuckoo_filter_bucket_has(f.Buckets[i1], fp) || internal::cuckoo_filter_bucket_has(f.Buckets[i2], fp)) return true;
+    return f.Victim == fp && (f.VictimBucket == i1 || f.VictimBucket == i2);
+}
+
+// Removes a key which was added before. Removing a key which was never added may remove another key
+// with the same fingerprint, causing a false negative for it later. Returns false if the key wasn't found.
+inline bool remove_prehashed(cuckoo_filter &f, u64 hash) {
+    if (!f.BucketCount) return false;
+
+    u64 h = internal::filter_remix(hash);
+    u16 fp = internal::cuckoo_filter_fingerprint(h);
+
+    s64 i1 = (s64) (h & (u64) (f.BucketCount - 1));
+    s64 i2 = internal::cuckoo_filter_alt_bucket(f, i1, fp);
+
+    bool removed = false;
+    if (f.Victim == fp && (f.VictimBucket == i1 || f.VictimBucket == i2)) {
+        f.Victim = 0;
+        removed = true;
+    } else {
+        removed = internal::cuckoo_filter_try_remove(f, i1, fp) || internal::cuckoo_filter_try_remove(f, i2, fp);
+    }
+    if (!removed) return false;
+
+    --f.Count;
+
+    // We may have freed a slot for the victim
+    if (f.Victim) {
+        s64 alt = internal::cuckoo_filter_alt_bucket(f, f.VictimBucket, f.Victim);
+        if (internal::cuckoo_filter_try_insert(f, f.VictimBucket, f.Victim) || internal::cuckoo_filter_try_insert(f, alt, f.Victim)) {
+            f.Victim = 0;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool add(cuckoo_filter &f, const T &key) { return add_prehashed(f, get_hash(key)); }
+
+template <typename T>
+bool has(const cuckoo_filter &f, const T &key) { return has_prehashed(f, get_hash(key)); }
+
+template <typename T>
+bool remove(cuckoo_filter &f, const T &key) { return remove_prehashed(f, get_hash(key)); }
+
+inline cuckoo_filter *clone(cuckoo_filter *dest, const cuckoo_filter &src) {
+    free(*dest);
+    if (!src.BucketCount) return dest;
+
+    dest->Buckets = allocate_array<u64>(src.BucketCount, {.Alignment = 64});
+    copy_elements(dest->Buckets, src.Buckets, src.BucketCount);
+    dest->BucketCount = src.BucketCount;
+    dest->Count = src.Count;
+    dest->Victim = src.Victim;
+    dest->VictimBucket = src.VictimBucket;
+    dest->KickState = src.KickState;
+    return dest;
+}
+
+// Same format idea as the serialization of bloom_filter - a header and the buckets as they are in memory.
+// Allocates the result with _alloc_ (Context.Alloc by default), free it with free().
+inline bytes serialize(const cuckoo_filter &f, allocator alloc = {}) {
+    internal::cuckoo_filter_header header = {internal::CUCKOO_FILTER_MAGIC, f.Victim, 0, (u64) f.BucketCount, (u64) f.Count, (u64) f.VictimBucket};
+    s64 bucketBytes = f.BucketCount * sizeof(u64);
+
+    bytes result;
+    PUSH_ALLOC(alloc ? alloc : Context.Alloc) {
+        array_reserve_exact(result, sizeof(header) + bucketBytes);
+    }
+    copy_memory(result.Data, &header, sizeof(header));
+    if (bucketBytes) copy_memory(result.Data + sizeof(header), f.Buckets, bucketBytes);
+    result.Count = sizeof(header) + bucketBytes;
+    return result;
+}
+
+// Reads a filter written by serialize(). Returns false (and leaves _dest_ untouched) if _data_ isn't a valid filter.
+inline bool deserialize(cuckoo_filter *dest, const bytes &data, allocator alloc = {}) {
+    internal::cuckoo_filter_header header;
+    if (data.Count < (s64) sizeof(header)) return false;
+    copy_memory(&header, data.Data, sizeof(header));
+
+    if (header.Magic != internal::CUCKOO_FILTER_MAGIC) return false;
+    if (header.BucketCount & (header.BucketCount - 1)) return false;  // Not a power of 2
+    if (header.BucketCount > (1ull << 40) || header.VictimBucket >= max<u64>(header.BucketCount, 1)) return false;
+
+    s64 bucketBytes = (s64) header.BucketCount * sizeof(u64);
+    if (data.Count != (s64) sizeof(header) + bucketBytes) return false;
+
+    free(*dest);
+    if (!header.BucketCount) return true;
+
+    dest->Buckets = allocate_array<u64>((s64) header.BucketCount, {.Alloc = alloc, .Alignment = 64});
+    copy_memory(dest->Buckets, data.Data + sizeof(header), bucketBytes);
+    dest->BucketCount = (s64) header.BucketCount;
+    dest->Count = (s64) header.Count;
+    dest->Victim = header.Victim;
+    dest->VictimBucket = (s64) header.VictimBucket;
+    return true;
+}
+
+LSTD_END_NAMESPACE
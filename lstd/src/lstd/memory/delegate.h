@@ -143,4 +143,112 @@ struct delegate<R(A...)> {
     }
 };
 
+namespace internal {
+// The blocks of owning_delegates which don't fit inline, from the persistent allocator (see allocator.cpp)
+void *owning_delegate_allocate(s64 size, u32 alignment);
+void owning_delegate_free(void *block);
+}  // namespace internal
+
+//
+// Like delegate, except that it keeps a copy of the functor/lambda instead of a pointer to it.
+// Use it for closures which are called later, by code which the caller doesn't wait for (another thread,
+// a job, a signal), so they don't need a variable which outlives them or a separate allocation:
+//
+//     s64 index = ...;
+//     job_run([index, results](void *) { results[index] = compute(index); });
+//
+// Callables of up to _InlineSize_ bytes (aligned to at most 8) are stored inside the object. Bigger ones
+// are copied to a block from the persistent allocator, so that works from any thread.
+//
+// As with the rest of the library there is no destructor and copies are shallow (they share the block).
+// Whoever ends up with the delegate calls free() on it once. The functions which take one
+// (thread::init_and_launch, job_run, signal::connect) take over the block and free it when they're done with it.
+//
+// The callable is copied bytewise (the same assumption we make for elements of arrays) and its destructor never
+// runs, so don't capture objects which depend on one.
+//
+// Anything a delegate can be made from works here too: a free function, an object and a method, or a pointer to
+// a functor. A pointer is kept as a pointer (not copied), so then the functor has to outlive the delegate again.
+//
+template <typename Signature, s64 InlineSize = 48>
+struct owning_delegate;
+
+template <typename R, typename... A, s64 InlineSize>
+struct owning_delegate<R(A...), InlineSize> {
+    using stub_t = R (*)(void *, A &&...);
+    using return_t = R;
+
+    static constexpr s64 INLINE_SIZE = InlineSize;
+
+    // Holds the callable itself, or a pointer to it when it's in _Heap_ (or when we were given a pointer)
+    alignas(8) byte Storage[InlineSize]{};
+    stub_t Invoker = null;
+
+    void *Heap = null;  // The block the callable was copied to, if it didn't fit in _Storage_
+
+    template <typename F>
+    static R invoke(void *data, A &&... args) {
+        return (*(F *) data)((A &&)(args)...);
+    }
+
+    template <typename F>
+    static R invoke_pointer(void *data, A &&... args) {
+        return (**(F **) data)((A &&)(args)...);
+    }
+
+    owning_delegate() {}
+    owning_delegate(null_t) {}
+
+    // Construct with method
+    template <typename Type, typename Signature>
+    owning_delegate(Type *object, Signature method) : owning_delegate(delegate<R(A...)>(object, method)) {}
+
+    // Construct with a free function, a functor/lambda (copied) or a pointer to a functor (not copied)
+    template <typename F>
+    requires(!types::is_same<types::remove_cvref_t<F>, owning_delegate> && !types::is_null<types::remove_cvref_t<F>>)
+    owning_delegate(F &&f) {
+        using T = types::decay_t<F>;  // Functions decay to function pointers
+
+        if constexpr (types::is_pointer<T> && !types::is_function<types::remove_pointer_t<T>>) {
+            // A pointer to a functor, call through it like delegate does
+            *(T *) &Storage[0] = f;
+            Invoker = &owning_delegate::invoke_pointer<types::remove_pointer_t<T>>;
+        } else if constexpr (sizeof(T) <= InlineSize && alignof(T) <= 8) {
+            copy_memory(Storage, &f, sizeof(T));
+            Invoker = &owning_delegate::invoke<T>;
+        } else {
+            Heap = internal::owning_delegate_allocate(sizeof(T), alignof(T));
+            copy_memory(Heap, &f, sizeof(T));
+
+            *(T **) &Storage[0] = (T *) Heap;
+            Invoker = &owning_delegate::invoke_pointer<T>;
+        }
+    }
+
+    // Assign null pointer. Doesn't free the block, see free().
+    owning_delegate &operator=(null_t) {
+        zero_memory(Storage, InlineSize);
+        Invoker = null;
+        Heap = null;
+        return *this;
+    }
+
+    bool operator==(null_t) const { return !Invoker; }
+    bool operator!=(null_t) const { return Invoker; }
+
+    operator bool() const { return Invoker; }
+
+    // Calls the delegate
+    R operator()(A... args) const {
+        return (*Invoker)((void *) &Storage[0], (A &&)(args)...);
+    }
+};
+
+// Frees the block of a callable which didn't fit inline (if there is one) and resets _d_ to null
+template <typename R, typename... A, s64 InlineSize>
+void free(owning_delegate<R(A...), InlineSize> &d) {
+    if (d.Heap) internal::owning_delegate_free(d.Heap);
+    d = null;
+}
+
 LSTD_END_NAMESPACE
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A double ended queue which stores its elements in fixed size blocks.
+// Pushing and popping at both ends is O(1) and never moves elements, so pointers to them stay valid
+// until they are popped (unlike ring_buffer, which moves everything when it grows).
+//
+// We keep a directory of pointers to the blocks, so getting the element at an index is O(1).
+// Blocks are allocated when an end runs out of space and freed when an end leaves them.
+//
+// Elements of one block are contiguous in memory, use front_span() and consume() for batch processing (see ring_buffer).
+//
+// Note: We flag this as not array-like, the elements aren't contiguous (see array_like.h).
+template <typename T_, s64 ElementsPerBlock = 64>
+struct deque {
+    using T = T_;
+    static constexpr bool IS_ARRAY = false;
+    static constexpr s64 ELEMENTS_PER_BLOCK = ElementsPerBlock;
+
+    array<T *> Blocks;
+
+    s64 First = 0;  // Index of the first element in Blocks[0]
+    s64 Count = 0;
+
+    deque() {}
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        using deque_t = types::select_t<Const, const deque<T, ElementsPerBlock>, deque<T, ElementsPerBlock>>;
+        using element_t = types::select_t<Const, const T, T>;
+
+        deque_t *Parent;
+        s64 Index;
+
+        iterator_(deque_t *parent, s64 index) : Parent(parent), Index(index) {}
+
+        iterator_ &operator++() {
+            ++Index;
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        element_t &operator*() { return (*Parent)[Index]; }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, Count); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, Count); }
+
+    // _index_ is from the front (0 is the first element). Negative indices start from the back.
+    T &operator[](s64 index) {
+        s64 i = First + translate_index(index, Count);
+        return Blocks.Data[i / ELEMENTS_PER_BLOCK][i % ELEMENTS_PER_BLOCK];
+    }
+
+    const T &operator[](s64 index) const {
+        s64 i = First + translate_index(index, Count);
+        return Blocks.Data[i / ELEMENTS_PER_BLOCK][i % ELEMENTS_PER_BLOCK];
+    }
+};
+
+template <typename T>
+struct is_deque : types::false_t {};
+
+template <typename T, s64 ElementsPerBlock>
+struct is_deque<deque<T, ElementsPerBlock>> : types::true_t {};
+
+template <typename T>
+concept any_deque = is_deque<T>::value;
+
+// Call destructor on each element and free all blocks.
+template <any_deque T>
+void free(T &dq) {
+    For(range(dq.Count)) destroy_at(&dq[it]);
+    For(dq.Blocks) free(it);
+    free(dq.Blocks);
+    dq.First = dq.Count = 0;
+}
+
+// Adds a shallow copy of _element_ at the back and returns a pointer to it (which stays valid until it's popped).
+template <any_deque T>
+auto *push_back(T &dq, const typename T::T &element) {
+    constexpr s64 B = T::ELEMENTS_PER_BLOCK;
+
+    s64 i = dq.First + dq.Count;
+    if (i == dq.Blocks.Count * B) array_append(dq.Blocks, allocate_array<typename T::T>(B));
+
+    auto *where = dq.Blocks.Data[i / B] + i % B;
+    copy_elements(where, &element, 1);
+    ++dq.Count;
+    return where;
+}
+
+// Adds a shallow copy of _element_ at the front and returns a pointer to it (which stays valid until it's popped).
+template <any_deque T>
+auto *push_front(T &dq, const typename T::T &element) {
+    constexpr s64 B = T::ELEMENTS_PER_BLOCK;
+
+    if (dq.First == 0) {
+        // Moves only the block pointers, not the elements
+        array_insert_at(dq.Blocks, 0, allocate_array<typename T::T>(B));
+        dq.First = B;
+    }
+    --dq.First;
+
+    auto *where = dq.Blocks.Data[0] + dq.First;
+    copy_elements(where, &element, 1);
+    ++dq.Count;
+    return where;
+}
+
+// Removes the first element and returns it (doesn't call the destructor, the caller owns the result).
+template <any_deque T>
+auto pop_front(T &dq) {
+    constexpr s64 B = T::ELEMENTS_PER_BLOCK;
+
+    assert(dq.Count && "Popping from an empty deque");
+
+    auto result = dq.Blocks.Data[0][dq.First];
+    ++dq.First;
+    --dq.Count;
+
+    if (dq.First == B) {
+        free(dq.Blocks.Data[0]);
+        array_remove_at(dq.Blocks, 0);
+        dq.First = 0;
+    }
+    return result;
+}
+
+// Removes the last element and returns it (doesn't call the destructor, the caller owns the result).
+template <any_deque T>
+auto pop_back(T &dq) {
+    constexpr s64 B = T::ELEMENTS_PER_BLOCK;
+
+    assert(dq.Count && "Popping from an empty deque");
+
+    --dq.Count;
+    s64 i = dq.First + dq.Count;
+    auto result = dq.Blocks.Data[i / B][i % B];
+
+    // The last block is empty now
+    if (i % B == 0 && i / B == dq.Blocks.Count - 1) {
+        free(dq.Blocks.Data[dq.Blocks.Count - 1]);
+        array_remove_at(dq.Blocks, -1);
+        if (!dq.Blocks.Count) dq.First = 0;
+    }
+    return result;
+}
+
+// Returns a view of the elements from the front which are in the same block (contiguous in memory).
+template <any_deque T>
+auto front_span(const T &dq) {
+    using V = typename T::T;
+    if (!dq.Count) return array<V>();
+    return array<V>(dq.Blocks.Data[0] + dq.First, min(dq.Count, T::ELEMENTS_PER_BLOCK - dq.First));
+}
+
+// Drops _n_ elements from the front (calling their destructors), use after processing a front_span().
+template <any_deque T>
+void consume(T &dq, s64 n) {
+    assert(n <= dq.Count);
+    For(range(n)) {
+        auto element = pop_front(dq);
+        destroy_at(&element);
+    }
+}
+
+template <typename T, s64 ElementsPerBlock>
+deque<T, ElementsPerBlock> *clone(deque<T, ElementsPerBlock> *dest, const deque<T, ElementsPerBlock> &src) {
+    free(*dest);
+    For(src) clone(push_back(*dest, {}), it);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
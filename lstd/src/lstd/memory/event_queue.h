@@ -0,0 +1,255 @@
+#pragma once
+
+#include "hash_table.h"
+#include "signal.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Records signal emissions made on any thread and runs them later, in one pass, on the thread which calls
+// dispatch() (the UI thread, the main loop...).
+//
+//     event_queue Events;
+//
+//     // On a worker
+//     Events.post(&window.Resized, width, height);
+//
+//     // Once per frame on the main thread. Every posted emit runs here, in the order they were posted.
+//     Events.dispatch();
+//
+// Posting copies the arguments into the queue's arena under a short lock (no callback runs and nobody is woken up),
+// so callbacks run on the owner thread and don't need locks around what they share with it.
+// dispatch() swaps the arena with a second one and runs the events without holding the lock, so posting (even from
+// a callback) never waits for a dispatch. Events posted during a dispatch run in the next one.
+// The arena blocks are kept for the next batches, after warming up posting doesn't allocate.
+//
+// Events which are posted many times before the owner gets to them can be coalesced:
+// * post_coalesced(signal, args...) drops the event if an identical one (same signal, same get_hash() of every
+//   argument) is already waiting.
+// * post_coalesced_by(key, signal, args...) replaces the waiting event of _signal_ with the same _key_, so only
+//   the latest arguments are emitted (e.g. a window which was resized many times in one frame).
+//   The event runs at the position of the latest post.
+//
+// If the owner thread sleeps instead of polling, set _Wake_. It's called by the post which puts the first event
+// in an empty batch, so there is one wake up per batch instead of one per event.
+//
+// The arguments are copied bytewise (see owning_delegate): what they point to has to be alive when the event is
+// dispatched. The signal has to be alive too. Results of the emits are dropped, so collectors which allocate
+// (collector_array) can't be used.
+//
+// The arena and the coalescing tables allocate with _Alloc_ (if it's set, otherwise with the Context's allocator
+// of the thread which posts). Since any thread may do that, you should usually set it to something thread safe.
+//
+struct event_queue : non_copyable {
+    static constexpr s64 BLOCK_SIZE = 64_KiB;
+
+    struct alignas(16) record {
+        void (*Invoke)(void *call);
+        record *Next;
+        bool Dead;  // Replaced by a later post_coalesced_by
+
+        // The recorded call follows
+        void *call() { return this + 1; }
+    };
+
+    struct alignas(16) block {
+        block *Next;
+        s64 Used, Size;
+
+        byte *data() { return (byte *) (this + 1); }
+    };
+
+    struct batch {
+        block *Blocks = null;
+        block *Current = null;  // The one we allocate from, the ones after it are empty
+
+        record *First = null, *Last = null;
+        s64 Count = 0;
+
+        hash_table<u64, record *> Coalesced;  // Events which were posted with a key
+    };
+
+    thread::fast_mutex Lock;
+    batch Batches[2];
+    s64 Posting = 0;  // The batch posts go in, dispatch() runs the other one
+
+    s32 Dispatching = 0;
+
+    owning_delegate<void()> Wake;
+
+    allocator Alloc;
+
+    event_queue() {}
+
+    // Frees the arenas. Not thread safe, make sure no one is posting anymore.
+    void release() {
+        For(Batches) {
+            auto *b = it.Blocks;
+            while (b) {
+                auto *next = b->Next;
+                general_free(b);
+                b = next;
+            }
+            free(it.Coalesced);
+            it = {};
+        }
+        free(Wake);
+    }
+
+    // Emits _signal_ with _args_ in the next dispatch()
+    template <typename Signal, typename... Args>
+    void post(Signal *signal, Args &&... args) {
+        post_record(signal, 0, RECORD, ((Args &&) args)...);
+    }
+
+    // Like post(), unless the same event is already waiting, then does nothing
+    template <typename Signal, typename... Args>
+    void post_coalesced(Signal *signal, Args &&... args) {
+        u64 key = get_hash(signal);
+        ((key = hash_u64(key ^ get_hash(args))), ...);
+        post_record(signal, key, DROP_DUPLICATE, ((Args &&) args)...);
+    }
+
+    // Like post(), and cancels the event of _signal_ with the same _key_ if it's still waiting
+    template <typename Signal, typename... Args>
+    void post_coalesced_by(u64 key, Signal *signal, Args &&... args) {
+        key = hash_u64(get_hash(signal) ^ key);
+        post_record(signal, key, REPLACE_DUPLICATE, ((Args &&) args)...);
+    }
+
+    // Runs every event posted so far on the calling thread. Returns how many ran (not counting coalesced ones).
+    // Only one thread may dispatch at a time.
+    s64 dispatch() {
+        s32 wasDispatching = atomic_swap(&Dispatching, 1);
+        assert(!wasDispatching && "Dispatching from two threads (or from a callback)");
+
+        Lock.lock();
+        auto &b = Batches[Posting];
+        Posting ^= 1;
+        Lock.unlock();
+
+        s64 result = 0;
+        for (auto *r = b.First; r; r = r->Next) {
+            if (r->Dead) continue;
+            r->Invoke(r->call());
+            ++result;
+        }
+
+        // Keep the blocks for a next batch
+        for (auto *blk = b.Blocks; blk; blk = blk->Next) blk->Used = 0;
+        b.Current = b.Blocks;
+        b.First = b.Last = null;
+        b.Count = 0;
+        reset(b.Coalesced);
+
+        atomic_store(&Dispatching, 0);
+        return result;
+    }
+
+    // The number of events which wait for a dispatch. Only a snapshot, other threads may be posting.
+    s64 pending() {
+        thread::scoped_lock _(&Lock);
+        return Batches[Posting].Count;
+    }
+
+    //
+    // The rest are implementation details
+    //
+
+    enum post_mode { RECORD, DROP_DUPLICATE, REPLACE_DUPLICATE };
+
+    template <typename Call>
+    static void invoke(void *call) {
+        (*(Call *) call)();
+    }
+
+    template <typename Signal, typename... Args>
+    void post_record(Signal *signal, u64 key, post_mode mode, Args &&... args) {
+        // The captures are the copies of the arguments
+        auto call = [signal, args...]() {
+            using emit_result_t = decltype(signal->emit(args...));
+            static_assert(!is_array<emit_result_t>, "The result of a dispatched emit would leak, don't use collectors which allocate");
+
+            if constexpr (types::is_same<emit_result_t, void>) {
+                signal->emit(args...);
+            } else {
+                [[maybe_unused]] auto result = signal->emit(args...);
+            }
+        };
+
+        using call_t = decltype(call);
+        static_assert(alignof(call_t) <= 16);
+
+        s64 size = (sizeof(record) + sizeof(call_t) + 15) & ~15;
+
+        bool wake = false;
+        {
+            thread::scoped_lock _(&Lock);
+            auto &b = Batches[Posting];
+
+            PUSH_ALLOC(Alloc ? Alloc : Context.Alloc) {
+                if (mode != RECORD) {
+                    auto [kp, vp] = find(b.Coalesced, key);
+                    if (vp) {
+                        if (mode == DROP_DUPLICATE) return;
+                        (*vp)->Dead = true;
+                        --b.Count;
+                    }
+                }
+
+                auto *r = (record *) allocate_in_batch(b, size);
+                r->Invoke = &event_queue::invoke<call_t>;
+                r->Next = null;
+                r->Dead = false;
+                copy_memory(r->call(), &call, sizeof(call_t));
+
+                wake = !b.Last;
+                if (b.Last) {
+                    b.Last->Next = r;
+                } else {
+                    b.First = r;
+                }
+                b.Last = r;
+
+                if (mode != RECORD) set(b.Coalesced, key, r);
+            }
+
+            ++b.Count;
+        }
+
+        if (wake && Wake) Wake();
+    }
+
+    // Called with _Lock_ held and _Alloc_ pushed
+    byte *allocate_in_batch(batch &b, s64 size) {
+        auto *blk = b.Current;
+        if (!blk || blk->Used + size > blk->Size) {
+            if (blk && blk->Next && size <= blk->Next->Size) {
+                blk = blk->Next;
+            } else {
+                s64 blockSize = max(BLOCK_SIZE, size);
+
+                auto *fresh = (block *) general_allocate(Context.Alloc, sizeof(block) + blockSize, 16);
+                fresh->Used = 0;
+                fresh->Size = blockSize;
+
+                // After the current one, so the empty blocks from previous batches stay at the end
+                if (blk) {
+                    fresh->Next = blk->Next;
+                    blk->Next = fresh;
+                } else {
+                    fresh->Next = b.Blocks;
+                    b.Blocks = fresh;
+                }
+                blk = fresh;
+            }
+            b.Current = blk;
+        }
+
+        byte *result = blk->data() + blk->Used;
+        blk->Used += size;
+        return result;
+    }
+};
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,34 @@
+#include "allocator.h"
+
+LSTD_BEGIN_NAMESPACE
+
+void *frame_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    auto *data = (frame_allocator_data *) context;
+    assert(data->BufferCount >= 1 && data->BufferCount <= FRAME_ALLOCATOR_MAX_BUFFERS);
+
+    if (mode == allocator_mode::FREE_ALL) {
+        // Rotate and clear the buffer which is now the oldest, the others stay alive
+        data->Current = (data->Current + 1) % data->BufferCount;
+
+        auto *arena = frame_allocator_current_arena(data);
+        if (!arena->Base) return null;  // Nothing was ever allocated there
+
+#if defined DEBUG_MEMORY
+        // Remove the freed allocations from the linked list so we don't corrupt the heap
+        if (DEBUG_memory) {
+            auto *p = arena->Base;
+            while (p) {
+                DEBUG_memory->unlink_headers_in_range(p + 1, (byte *) (p + 1) + p->Used);
+                p = p->Next;
+            }
+        }
+#endif
+        return default_temp_allocator(mode, arena, size, oldMemory, oldSize, options);
+    }
+
+    // Everything else goes to the buffer of the current frame.
+    // Blocks from older frames aren't the last block in any of its pools, so FREE and RESIZE leave them alone.
+    return default_temp_allocator(mode, frame_allocator_current_arena(data), size, oldMemory, oldSize, options);
+}
+
+LSTD_END_NAMESPACE
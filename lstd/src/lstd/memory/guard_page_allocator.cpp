@@ -0,0 +1,55 @@
+#include "allocator.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope s64 round_up_to(s64 value, s64 granularity) { return (value + granularity - 1) / granularity * granularity; }
+
+void *guard_page_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    s64 pageSize = os_get_page_size();
+
+    switch (mode) {
+        case allocator_mode::ADD_POOL:
+        case allocator_mode::REMOVE_POOL: {
+            assert(false && "The guard page allocator gets every block from the OS, it doesn't use pools.");
+            return null;
+        }
+        case allocator_mode::ALLOCATE: {
+            // The page after the committed ones stays reserved only, that's the guard page
+            s64 committed = round_up_to(size, pageSize);
+
+            auto *base = (byte *) os_reserve_memory(committed + pageSize);
+            if (!base) return null;
+
+            if (!os_commit_memory(base, committed)) {
+                os_release_memory(base);
+                return null;
+            }
+            return base + committed - size;
+        }
+        case allocator_mode::RESIZE: {
+            // Growing or shrinking in place would move the end of the block away from the guard page
+            return size == oldSize ? oldMemory : null;
+        }
+        case allocator_mode::FREE: {
+            // The block starts less than a page after the start of the reservation
+            os_release_memory((void *) ((u64) oldMemory / pageSize * pageSize));
+
+            // null means success FREE
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            // We don't keep a list of the blocks
+            return (void *) -1;
+        }
+        case allocator_mode::ALLOCATE_BATCH:
+        case allocator_mode::FREE_BATCH:
+            return (void *) -1;  // Falls back to allocating/freeing blocks one by one
+        default:
+            assert(false);
+    }
+    return null;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,87 @@
+#include "guid.h"
+
+#include "../random.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// A separate generator from thread_rng(), so ids don't depend on how many numbers the thread took from that
+struct guid_generator {
+    rng Rng;
+    bool Seeded;
+
+    // For v7
+    u64 LastMs;
+    u32 Counter;
+};
+
+file_scope thread_local guid_generator Generator;
+
+file_scope guid_generator &get_generator() {
+    guid_generator &g = Generator;
+    if (!g.Seeded) {
+        rng_seed_os(g.Rng);
+        g.Seeded = true;
+    }
+    return g;
+}
+
+file_scope always_inline void guid_write_v4(guid &out, guid_generator &g) {
+    u64 words[2] = {rng_next(g.Rng), rng_next(g.Rng)};
+    copy_memory(out.Data.Data, words, 16);
+
+    out.Data[6] = (byte) ((out.Data[6] & 0x0F) | 0x40);  // Version 4
+    out.Data[8] = (byte) ((out.Data[8] & 0x3F) | 0x80);  // Variant 1
+}
+
+// The counter restarts from a random value with the top bit clear on every new millisecond,
+// so there is room for at least 2048 guids before we have to borrow the next millisecond.
+file_scope always_inline void guid_write_v7(guid &out, guid_generator &g, u64 now) {
+    if (now > g.LastMs) {
+        g.LastMs = now;
+        g.Counter = (u32) (rng_next(g.Rng) & 0x7FF);
+    } else if (++g.Counter > 0xFFF) {
+        // More than 4096 in a millisecond (or the clock went back), keep sorting after the last one
+        ++g.LastMs;
+        g.Counter = (u32) (rng_next(g.Rng) & 0x7FF);
+    }
+
+    u64 ms   = g.LastMs;
+    u64 rand = rng_next(g.Rng);
+
+    For(range(6)) out.Data[it] = (byte) (ms >> (40 - 8 * it));
+    out.Data[6] = (byte) (0x70 | (g.Counter >> 8));  // Version 7
+    out.Data[7] = (byte) g.Counter;
+    copy_memory(out.Data.Data + 8, &rand, 8);
+    out.Data[8] = (byte) ((out.Data[8] & 0x3F) | 0x80);  // Variant 1
+}
+
+guid guid_new() {
+    guid result;
+    guid_write_v4(result, get_generator());
+    return result;
+}
+
+guid guid_new_v7() {
+    guid result;
+    guid_write_v7(result, get_generator(), internal::platform_unix_time_ms());
+    return result;
+}
+
+void guid_new_batch(array<guid> out) {
+    // Work on a copy so the compiler doesn't reload the thread local state after every store
+    guid_generator &tls = get_generator();
+    guid_generator g    = tls;
+    For(out) guid_write_v4(it, g);
+    tls = g;
+}
+
+void guid_new_v7_batch(array<guid> out) {
+    guid_generator &tls = get_generator();
+    guid_generator g    = tls;
+
+    u64 now = internal::platform_unix_time_ms();
+    For(out) guid_write_v7(it, g, now);
+    tls = g;
+}
+
+LSTD_END_NAMESPACE
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "array.h"
+#include "hasher.h"
 #include "stack_array.h"
 
 LSTD_BEGIN_NAMESPACE
@@ -22,14 +24,40 @@ struct guid {
     constexpr auto operator<=>(const guid &) const = default;
 };
 
-// Hash for guid
-inline u64 get_hash(guid value) {
-    u64 hash = 5381;
-    For(value.Data) hash = ((hash << 5) + hash) + it;
-    return hash;
+// Hash for guid.
+// Reads the two 64 bit halves and folds their 128 bit product (like the 9-16 byte path of XXH3),
+// so every byte of the guid affects the result and v7 guids whose first bytes are the same (the timestamp) still spread.
+constexpr u64 get_hash(guid value) {
+    u64 lo = xxh3::read_u64(value.Data.Data), hi = xxh3::read_u64(value.Data.Data + 8);
+    return xxh3::avalanche(lo + hi + xxh3::mul128_fold64(lo ^ xxh3::PRIME64_1, hi ^ xxh3::PRIME64_2));
 }
 
-// Guaranteed to generate a unique id each time (time-based)
+//
+// Guids are generated from a per-thread random generator (xoshiro256**, see random.h) which is seeded once
+// per thread from the operating system, after that generating one is a few shifts and adds.
+//
+// Guaranteed to be unique for all practical purposes (122 random bits for v4, 74 for v7),
+// but NOT unguessable - don't use them as secrets (session tokens, keys, etc.).
+//
+// Note: after a fork() both processes continue from the same generator state in the forking thread.
+//
+
+// Random guid (RFC 9562 version 4)
 guid guid_new();
 
+// Time-ordered guid (RFC 9562 version 7): a 48 bit Unix timestamp in milliseconds, a 12 bit counter and 62 random bits.
+// Guids made on the same thread sort in the order they were generated (by their bytes, or their text), which keeps
+// inserts into ordered indices (B-trees, sorted files) at the end.
+guid guid_new_v7();
+
+// Fill every element of _out_ (out.Count of them, the array isn't resized).
+// Cheaper than calling guid_new() in a loop, the generator state stays in registers.
+void guid_new_batch(array<guid> out);
+void guid_new_v7_batch(array<guid> out);
+
+namespace internal {
+// Implemented per platform, the timestamp of v7 guids
+u64 platform_unix_time_ms();
+}  // namespace internal
+
 LSTD_END_NAMESPACE
@@ -2,6 +2,10 @@
 
 #include "hasher.h"
 
+#if X86_SSE4_2
+#include <nmmintrin.h>  // _mm_crc32_u64
+#endif
+
 //
 // !!! THESE ARE NOT SUPPOSED TO BE CRYPTOGRAPHICALLY SECURE !!!
 //
@@ -21,44 +25,97 @@ LSTD_BEGIN_NAMESPACE
 // because we are reinterpreting the float's bits as unsigned numbers
 template <typename T>
 constexpr u64 get_hash(const T &value) {
-    hasher h(0);
-    h.add((const char *) &value, sizeof(T));
-    return h.hash();
+    return hash_bytes(&value, sizeof(T));
+}
+
+// Hashes a single 64 bit value (integers, pointers, enums).
+//
+// The identity would be the fastest "hash", but hash_table maps hashes to slots by taking the low bits, so aligned
+// pointers (low bits always 0) and sequential IDs pile up into long runs. This spreads every input bit across
+// the whole 64 bit result (the shard picking of concurrent_hash_table uses the high bits).
+//
+// With SSE4.2 we use a hardware CRC32C of the low half, xored into the high half (which keeps every input distinct),
+// and a multiply-xorshift to spread both halves over the result. Two CRCs of the whole value with different seeds
+// wouldn't do: CRC is linear, so they differ by a constant and the result would only have 32 bits of entropy.
+// Otherwise we use the multiply-xorshift finalizer from splitmix64.
+//
+// At compile time we calculate the CRC in software, so the result is the same as at runtime.
+#if X86_SSE4_2
+always_inline constexpr u32 crc32c_u32(u32 crc, u32 x) {
+    if (!is_constant_evaluated()) return _mm_crc32_u32(crc, x);
+
+    For(range(32)) {
+        crc ^= x & 1;
+        crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        x >>= 1;
+    }
+    return crc;
+}
+#endif
+
+always_inline constexpr u64 hash_u64(u64 x) {
+#if X86_SSE4_2
+    x ^= (u64) crc32c_u32(0x9E3779B9, (u32) x) << 32;
+    x *= 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 32;
+    return x;
+#else
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+#endif
 }
 
 // Partial specialization for pointers
 template <typename T>
 requires(types::is_pointer_v<T>) constexpr u64 get_hash(const T value) {
-    return (u64) value;
+    return hash_u64((u64) value);
 }
 
 // Partial specialization for arrays of known size
 template <typename T>
 requires(types::is_array_v<T> &&types::is_array_of_known_bounds_v<T>) constexpr u64 get_hash(const T value) {
-    hasher h(0);
-    h.add((const char *) value, sizeof(types::remove_extent_t<T>) * types::extent_v<T>);
-    return h.hash();
+    return hash_bytes(value, sizeof(types::remove_extent_t<T>) * types::extent_v<T>);
 }
 
 // Hashes for integer types
-#define TRIVIAL_HASH(T) \
-    constexpr u64 get_hash(T value) { return (u64) value; }
+#define SCALAR_HASH(T) \
+    constexpr u64 get_hash(T value) { return hash_u64((u64) value); }
 
-TRIVIAL_HASH(s8);
-TRIVIAL_HASH(u8);
+SCALAR_HASH(s8);
+SCALAR_HASH(u8);
 
-TRIVIAL_HASH(s16);
-TRIVIAL_HASH(u16);
+SCALAR_HASH(s16);
+SCALAR_HASH(u16);
 
-TRIVIAL_HASH(s32);
-TRIVIAL_HASH(u32);
+SCALAR_HASH(s32);
+SCALAR_HASH(u32);
 
-TRIVIAL_HASH(s64);
-TRIVIAL_HASH(u64);
+SCALAR_HASH(s64);
+SCALAR_HASH(u64);
 
-TRIVIAL_HASH(bool);
+SCALAR_HASH(bool);
+
+#undef SCALAR_HASH
+
+// The hash and equality hash_table uses by default (pass others as its _Hash_ and _Equal_ template arguments).
+// They have no state, tables make one whenever they need it.
+//
+// A policy which declares _is_transparent_ also takes other types than the key (with the same hash for the same
+// contents), then find(), has() and remove() accept those without making a key first.
+// See the ones for string in string.h.
+template <typename K>
+struct key_hash {
+    constexpr u64 operator()(const K &key) const { return get_hash(key); }
+};
 
-#undef TRIVIAL_HASH
+template <typename K>
+struct key_equal {
+    constexpr bool operator()(const K &one, const K &other) const { return one == other; }
+};
 
 // @TODO: Have a macro that declares types with HASH_AS_ARRAY_LIKE which uses the hasher automatially. For now we don't even hash arrays.
 
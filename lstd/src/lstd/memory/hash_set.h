@@ -0,0 +1,317 @@
+#pragma once
+
+#include "../memory/allocator.h"
+#include "hash.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// This returns the type of the _Keys_ member of an hash set
+template <typename HashSetT>
+using hash_set_key_t = typename types::remove_pointer_t<decltype(HashSetT::Keys)>;
+
+// #undefed at the end of the file
+#define key_t hash_set_key_t
+
+// A set of keys which works exactly like hash_table (same probing, same growth policy, same API)
+// but doesn't store values. Use this instead of hash_table<K, bool> for membership tests,
+// that way we don't allocate (and drag through the cache) a Values array we never look at.
+//
+// We store 2 arrays, one for the hashes and one for the keys. A hash of 0 means the slot is empty.
+// See the comment above hash_table for more details.
+//
+// The template parameter _BlockAlloc_ works like in hash_table.
+template <typename K_, bool BlockAlloc = true>
+struct hash_set {
+    using K = K_;
+    static constexpr bool BLOCK_ALLOC = BlockAlloc;
+
+    static constexpr s64 MINIMUM_SIZE = 32;
+    static constexpr s64 FIRST_VALID_HASH = 2;
+
+    // Number of valid items
+    s64 Count = 0;
+
+    // Number of slots allocated
+    s64 Allocated = 0;
+
+    u64 *Hashes = null;
+    K *Keys = null;
+
+    hash_set() {}
+
+    // We don't use destructors for freeing memory anymore.
+    // ~hash_set() { free(); }
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        using hash_set_t = types::select_t<Const, const hash_set<K, BlockAlloc>, hash_set<K, BlockAlloc>>;
+        using key_ptr_t = types::select_t<Const, const K *, K *>;
+
+        hash_set_t *Parent;
+        s64 Index;
+
+        iterator_(hash_set_t *parent, s64 index = 0) : Parent(parent), Index(index) {
+            assert(parent);
+
+            // Find the first key
+            skip_empty_slots();
+        }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_empty_slots();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        // Returns a pointer to the key (like the iterator of hash_table returns pointers to the key and value)
+        key_ptr_t operator*() { return Parent->Keys + Index; }
+
+       private:
+        void skip_empty_slots() {
+            for (; Index < Parent->Allocated; ++Index) {
+                if (Parent->Hashes[Index] < FIRST_VALID_HASH) continue;
+                break;
+            }
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(this, Allocated); }
+    const_iterator begin() const { return const_iterator(this); }
+    const_iterator end() const { return const_iterator(this, Allocated); }
+};
+
+template <typename T>
+struct is_hash_set : types::false_t {};
+
+template <typename K, bool BlockAlloc>
+struct is_hash_set<hash_set<K, BlockAlloc>> : types::true_t {};
+
+template <typename T>
+concept any_hash_set = is_hash_set<T>::value;
+
+template <any_hash_set T>
+key_t<T> *add_prehashed(T &set, u64 hash, const key_t<T> &key);
+
+// Makes sure the hash set has reserved enough space for at least n elements.
+// Works exactly like reserve() for hash_table, see the comment there.
+template <any_hash_set T>
+void reserve(T &set, s64 target, u32 alignment = 0) {
+    using K = key_t<T>;
+
+    if (set.Count + target < set.Allocated) return;
+    target = max<s64>(ceil_pow_of_2(target + set.Count + 1), set.MINIMUM_SIZE);
+
+    auto allocateNewBlock = [&]() {
+        if constexpr (set.BLOCK_ALLOC) {
+            s64 padding = 0;
+            if (alignment != 0) padding = (target * sizeof(u64)) % alignment;
+
+            byte *block = allocate_array<byte>(target * (sizeof(u64) + sizeof(K)) + padding, {.Alignment = alignment});
+            set.Hashes = (u64 *) block;
+            set.Keys = (K *) (block + target * sizeof(u64) + padding);
+        } else {
+            set.Hashes = allocate_array<u64>(target, {.Alignment = alignment});
+            set.Keys = allocate_array<K>(target, {.Alignment = alignment});
+        }
+        zero_memory(set.Hashes, target * sizeof(u64));
+    };
+
+    if (set.Allocated) {
+        auto oldAlignment = allocation_get_alignment(set.Hashes);
+        if (alignment == 0) {
+            alignment = oldAlignment;
+        } else {
+            assert(alignment == oldAlignment && "Reserving with an alignment but the object already has arrays with a different alignment. Specify alignment 0 to automatically use the old one.");
+        }
+
+        auto *oldHashes = set.Hashes;
+        auto *oldKeys = set.Keys;
+        auto oldAllocated = set.Allocated;
+
+        allocateNewBlock();
+        set.Allocated = target;
+        set.Count = 0;
+
+        // Add the old items
+        For(range(oldAllocated)) {
+            if (oldHashes[it] >= set.FIRST_VALID_HASH) add_prehashed(set, oldHashes[it], oldKeys[it]);
+        }
+
+        free(oldHashes);
+        if constexpr (!set.BLOCK_ALLOC) free(oldKeys);
+    } else {
+        assert(!set.Count);
+        allocateNewBlock();
+        set.Allocated = target;
+    }
+}
+
+// Free any memory allocated by this object and reset count
+template <any_hash_set T>
+void free(T &set) {
+    if (set.Allocated) {
+        free(set.Hashes);
+        if constexpr (!set.BLOCK_ALLOC) free(set.Keys);
+    }
+    set.Hashes = null;
+    set.Keys = null;
+    set.Count = set.Allocated = 0;
+}
+
+// Don't free the hash set, just destroy contents and reset count
+template <any_hash_set T>
+void reset(T &set) {
+    using K = key_t<T>;
+
+    For(range(set.Allocated)) {
+        if (set.Hashes[it]) {
+            set.Keys[it].~K();
+            set.Hashes[it] = 0;
+        }
+    }
+    set.Count = 0;
+}
+
+// Looks for key in the hash set using the given hash.
+// Returns a pointer to the key in the set, or null if it's not there.
+// This method is useful if you have cached the hash.
+template <any_hash_set T>
+key_t<T> *find_prehashed(const T &set, u64 hash, const key_t<T> &key) {
+    if (!set.Count) return null;
+
+    if (hash < set.FIRST_VALID_HASH) hash += set.FIRST_VALID_HASH;  // Same as in add_prehashed()
+
+    s64 index = hash & (set.Allocated - 1);
+    For(range(set.Allocated)) {
+        if (!set.Hashes[index]) break;  // An empty slot ends the run
+
+        if (set.Hashes[index] == hash && set.Keys[index] == key) return set.Keys + index;
+
+        ++index;
+        if (index >= set.Allocated) index = 0;
+    }
+    return null;
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_hash_set T>
+key_t<T> *find(const T &set, const key_t<T> &key) { return find_prehashed(set, get_hash(key), key); }
+
+// Adds the key to the set using the given hash. Doesn't check if it's already there (like add() for hash_table),
+// use set_add() if the key may already be in the set.
+// Returns a pointer to the added key.
+template <any_hash_set T>
+key_t<T> *add_prehashed(T &set, u64 hash, const key_t<T> &key) {
+    if ((set.Count + 1) * 2 >= set.Allocated) reserve(set, set.Count);  // Make sure the hash set is never more than 50% full
+
+    assert(set.Count < set.Allocated);
+
+    if (hash < set.FIRST_VALID_HASH) hash += set.FIRST_VALID_HASH;
+
+    s64 index = hash & (set.Allocated - 1);
+    while (set.Hashes[index]) {
+        ++index;
+        if (index >= set.Allocated) index = 0;
+    }
+
+    ++set.Count;
+
+    set.Hashes[index] = hash;
+    new (set.Keys + index) key_t<T>(key);
+    return set.Keys + index;
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_hash_set T>
+key_t<T> *add(T &set, const key_t<T> &key) { return add_prehashed(set, get_hash(key), key); }
+
+// Adds the key only if it's not in the set already.
+// Returns true if it was added.
+template <any_hash_set T>
+bool set_add_prehashed(T &set, u64 hash, const key_t<T> &key) {
+    if (find_prehashed(set, hash, key)) return false;
+    add_prehashed(set, hash, key);
+    return true;
+}
+
+template <any_hash_set T>
+bool set_add(T &set, const key_t<T> &key) { return set_add_prehashed(set, get_hash(key), key); }
+
+// Returns true if the key was found and removed.
+// Uses backward-shift deletion like remove_prehashed() for hash_table (see the comment there), so we don't leave tombstones.
+template <any_hash_set T>
+bool remove_prehashed(T &set, u64 hash, const key_t<T> &key) {
+    auto *kp = find_prehashed(set, hash, key);
+    if (!kp) return false;
+
+    using K = key_t<T>;
+
+    s64 mask = set.Allocated - 1;
+
+    s64 hole = kp - set.Keys;
+    set.Keys[hole].~K();
+
+    s64 index = (hole + 1) & mask;
+    while (set.Hashes[index]) {
+        s64 ideal = set.Hashes[index] & mask;
+        if (((hole - ideal) & mask) < ((index - ideal) & mask)) {
+            set.Hashes[hole] = set.Hashes[index];
+            copy_memory(set.Keys + hole, set.Keys + index, sizeof(K));
+            hole = index;
+        }
+        index = (index + 1) & mask;
+    }
+
+    set.Hashes[hole] = 0;
+    --set.Count;
+    return true;
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_hash_set T>
+bool remove(T &set, const key_t<T> &key) { return remove_prehashed(set, get_hash(key), key); }
+
+template <any_hash_set T>
+bool has(const T &set, const key_t<T> &key) { return find(set, key) != null; }
+
+template <any_hash_set T>
+bool has_prehashed(const T &set, u64 hash, const key_t<T> &key) { return find_prehashed(set, hash, key) != null; }
+
+template <any_hash_set T>
+bool operator==(const T &t, const T &u) {
+    if (t.Count != u.Count) return false;
+    for (auto *k : t) {
+        if (!has(u, *k)) return false;
+    }
+    return true;
+}
+
+template <any_hash_set T>
+bool operator!=(const T &t, const T &u) { return !(t == u); }
+
+#undef key_t
+
+template <typename K, bool BlockAlloc>
+hash_set<K, BlockAlloc> *clone(hash_set<K, BlockAlloc> *dest, const hash_set<K, BlockAlloc> &src) {
+    free(*dest);
+    for (auto *k : src) add(*dest, *k);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
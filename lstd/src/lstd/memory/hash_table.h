@@ -3,6 +3,8 @@
 #include "../memory/allocator.h"
 #include "hash.h"
 
+#include <xmmintrin.h>  // For _mm_prefetch
+
 LSTD_BEGIN_NAMESPACE
 
 // This returns the type of the _Keys_ member of an hash table
@@ -28,6 +30,9 @@ struct key_value_pair {
 //
 // We store 3 arrays, one for the values, one for the keys and one for the hashed keys.
 // Read the comment above reserve() for more information on how the arrays get allocated.
+// A 4th one, _Occupied_, has a bit for every slot which is filled. Iterating goes through it 64 slots at a time
+// instead of reading every hash, with the table at most half full (and often much emptier after removes) that's
+// most of the cost of a loop over a big table.
 //
 // When storing a value, we map its hash to a slot index and if that slot is free, we put the key and value there,
 // otherwise we keep incrementing the slot index until we find an empty slot. Because the hash table can never be full, we
@@ -35,9 +40,9 @@ struct key_value_pair {
 //
 // When looking up a value we perform the same process to find the correct slot.
 //
-// We use hash values to indicate whether slots are empty of removed. A hash of 0 means that slot is not used, so new
-// values an be put there. A hash of 1 means that slot used to be valid, but has been removed. A hash of 2 or h igher
-// (FIRST_VALID_HASH) means this is a currently used slot.
+// We use hash values to indicate whether slots are empty. A hash of 0 means that slot is not used, so new
+// values an be put there. A hash of 2 or higher (FIRST_VALID_HASH) means this is a currently used slot.
+// (A hash of 1 used to mark removed slots, we don't leave those anymore - see remove_prehashed()).
 //
 // Whether we hash a key, if the result is less than 2, we just add 2 to it to put it in the valid range.
 // This leads to possibly more collisions, but it's a small price to pay.
@@ -46,10 +51,17 @@ struct key_value_pair {
 // all contiguously or by seperate allocation calls. You want to allocate them next to each other because that's good for the cache,
 // but if the hash table is too large then the block won't fit in the cache anyways so you should consider setting this to false to reduce
 // the size of the allocation request.
-template <typename K_, typename V_, bool BlockAlloc = true>
+//
+// _Hash_ and _Equal_ are what keys are hashed and compared with (see key_hash in hash.h). The functions which don't
+// take a hash use _Hash_, the _prehashed ones expect the hash you pass to come from it as well. If the policies are
+// transparent, find(), has() and remove() also take other types than K: hash_table<string, V> can be looked up
+// with a literal without making a string (which counts code points) first.
+template <typename K_, typename V_, bool BlockAlloc = true, typename Hash = key_hash<K_>, typename Equal = key_equal<K_>>
 struct hash_table {
     using K = K_;
     using V = V_;
+    using key_hash_t = Hash;
+    using key_equal_t = Equal;
     static constexpr bool BLOCK_ALLOC = BlockAlloc;
 
     static constexpr s64 MINIMUM_SIZE = 32;
@@ -61,13 +73,18 @@ struct hash_table {
     // Number of slots allocated
     s64 Allocated = 0;
 
-    // Number of slots that can't be used (valid + removed items)
+    // Number of slots that can't be used. Since removing doesn't leave tombstones this is always equal to _Count_,
+    // we keep it around because code which looks at it predates that.
     s64 SlotsFilled = 0;
 
     u64 *Hashes = null;
     K *Keys = null;
     V *Values = null;
 
+    // Bit (i % 64) of word (i / 64) is set if slot i is filled. Null for tables which don't own their arrays
+    // (see hash_table_image_open()), their loops look at the hashes instead.
+    u64 *Occupied = null;
+
     hash_table() {}
 
     // We don't use destructors for freeing memory anymore.
@@ -78,7 +95,7 @@ struct hash_table {
     //
     template <bool Const>
     struct iterator_ {
-        using hash_table_t = types::select_t<Const, const hash_table<K, V>, hash_table<K, V>>;
+        using hash_table_t = types::select_t<Const, const hash_table, hash_table>;
 
         hash_table_t *Parent;
         s64 Index;
@@ -110,12 +127,7 @@ struct hash_table {
         }
 
        private:
-        void skip_empty_slots() {
-            for (; Index < Parent->Allocated; ++Index) {
-                if (Parent->Hashes[Index] < FIRST_VALID_HASH) continue;
-                break;
-            }
-        }
+        void skip_empty_slots() { Index = hash_table_next_filled(*Parent, Index); }
     };
 
     using iterator = iterator_<false>;
@@ -142,18 +154,91 @@ struct hash_table {
 template <typename T>
 struct is_hash_table : types::false_t {};
 
-template <typename K, typename V, bool BlockAlloc>
-struct is_hash_table<hash_table<K, V, BlockAlloc>> : types::true_t {};
+template <typename K, typename V, bool BlockAlloc, typename Hash, typename Equal>
+struct is_hash_table<hash_table<K, V, BlockAlloc, Hash, Equal>> : types::true_t {};
 
 template <typename T>
 concept any_hash_table = is_hash_table<T>::value;
 
+// Types other than the key which the table can be looked up with (its policies are transparent and take _Q_)
+template <typename T, typename Q>
+concept hash_table_lookup_key = !types::is_same<types::remove_cvref_t<Q>, key_t<T>> && requires(const key_t<T> &key, const Q &q) {
+    typename T::key_hash_t::is_transparent;
+    typename T::key_equal_t::is_transparent;
+    { typename T::key_hash_t{}(q) } -> types::is_convertible<u64>;
+    { typename T::key_equal_t{}(key, q) } -> types::is_convertible<bool>;
+};
+
+// The hash of _key_ with the table's _Hash_
+template <any_hash_table T, typename Q>
+constexpr u64 hash_table_hash(const T &table, const Q &key) { return typename T::key_hash_t{}(key); }
+
+// The number of u64s in _Occupied_ for _slots_ slots
+constexpr s64 hash_table_occupied_words(s64 slots) { return (slots + 63) / 64; }
+
+// Returns the first filled slot at or after _index_, _Allocated_ if there are none.
+template <any_hash_table T>
+s64 hash_table_next_filled(const T &table, s64 index) {
+    if (!table.Occupied) {
+        while (index < table.Allocated && table.Hashes[index] < table.FIRST_VALID_HASH) ++index;
+        return index;
+    }
+
+    while (index < table.Allocated) {
+        u64 word = table.Occupied[index / 64] >> (index % 64);
+        if (word) return index + lsb(word);
+        index = (index / 64 + 1) * 64;
+    }
+    return table.Allocated;
+}
+
+// Allocates the arrays for _slots_ slots (a power of two) and sets _Allocated_. The arrays aren't zeroed, but the
+// hashes and _Occupied_ must be before anything is added (reserve() does that right away, incremental_hash_table
+// a bit at a time). The old arrays (if any) aren't freed.
+//
+// If _BLOCK_ALLOC_ is true it ensures that the allocated arrays are next to each other.
+// A null _alloc_ means the Context's allocator.
+template <any_hash_table T>
+void hash_table_allocate(T &table, s64 slots, u32 alignment = 0, allocator alloc = {}) {
+    using K = key_t<T>;
+    using V = value_t<T>;
+
+    if constexpr (table.BLOCK_ALLOC) {
+        s64 padding1 = 0, padding2 = 0;
+        if (alignment != 0) {
+            padding1 = (slots * sizeof(u64)) % alignment;
+            padding2 = (slots * sizeof(V)) % alignment;
+        }
+
+        // _Occupied_ goes after the values
+        s64 occupiedOffset = slots * (sizeof(u64) + sizeof(K) + sizeof(V)) + padding1 + padding2;
+        occupiedOffset = (occupiedOffset + sizeof(u64) - 1) & ~(s64) (sizeof(u64) - 1);
+
+        s64 sizeInBytes = occupiedOffset + hash_table_occupied_words(slots) * sizeof(u64);
+
+        byte *block = allocate_array<byte>(sizeInBytes, {.Alloc = alloc, .Alignment = alignment});
+        table.Hashes = (u64 *) block;
+        table.Keys = (K *) (block + slots * sizeof(u64) + padding1);
+        table.Values = (V *) (block + slots * (sizeof(u64) + sizeof(K)) + padding2);
+        table.Occupied = (u64 *) (block + occupiedOffset);
+    } else {
+        table.Hashes = allocate_array<u64>(slots, {.Alloc = alloc, .Alignment = alignment});
+        table.Keys = allocate_array<K>(slots, {.Alloc = alloc, .Alignment = alignment});
+        table.Values = allocate_array<V>(slots, {.Alloc = alloc, .Alignment = alignment});
+        table.Occupied = allocate_array<u64>(hash_table_occupied_words(slots), {.Alloc = alloc});
+    }
+    table.Allocated = slots;
+}
+
 // Makes sure the hash table has reserved enough space for at least n elements.
 // Note that it may reserve way more than required.
 // Reserves space equal to the next power of two bigger than _size_, starting at _MINIMUM_SIZE_.
 //
-// Allocates a buffer if the hash table doesn't already point to allocated memory (using the Context's allocator).
-// If _BLOCK_ALLOC_ is true it ensures that the allocated arrays are next to each other.
+// Allocates a buffer if the hash table doesn't already point to allocated memory (using _alloc_, or the Context's
+// allocator if that's null). See hash_table_allocate().
+//
+// Like arrays, a table grows with the allocator its arrays were allocated with (_alloc_ is ignored after the first
+// allocation), so reserving once with an allocator binds the table to it.
 //
 // You don't need to call this before using the hash table.
 // The first time an element is added to the hash table, it reserves with _MINIMUM_SIZE_ and no specified alignment.
@@ -162,39 +247,15 @@ concept any_hash_table = is_hash_table<T>::value;
 // This is also called when adding an element and the hash table is more than half full (SlotsFilled * 2 >= Allocated).
 // In that case the _target_ is exactly _SlotsFilled_.
 // You may want to call this manually if you are adding a bunch of items and causing the hash table to reallocate a lot.
+//
+// Growing moves every entry at once, see incremental_hash_table if that's too much of a stall.
 template <any_hash_table T>
-void reserve(T &table, s64 target, u32 alignment = 0) {
-    using K = key_t<T>;
-    using V = value_t<T>;
-
+void reserve(T &table, s64 target, u32 alignment = 0, allocator alloc = {}) {
     if (table.SlotsFilled + target < table.Allocated) return;
     target = max<s64>(ceil_pow_of_2(target + table.SlotsFilled + 1), table.MINIMUM_SIZE);
 
-    auto allocateNewBlock = [&]() {
-        if constexpr (table.BLOCK_ALLOC) {
-            s64 padding1 = 0, padding2 = 0;
-            if (alignment != 0) {
-                padding1 = (target * sizeof(u64)) % alignment;
-                padding2 = (target * sizeof(V)) % alignment;
-            }
-
-            s64 sizeInBytes = target * (sizeof(u64) + sizeof(K) + sizeof(V)) + padding1 + padding2;
-
-            byte *block = allocate_array<byte>(sizeInBytes, {.Alignment = alignment});
-            table.Hashes = (u64 *) block;
-            table.Keys = (K *) (block + target * sizeof(u64) + padding1);
-            table.Values = (V *) (block + target * (sizeof(u64) + sizeof(K)) + padding2);
-            zero_memory(table.Hashes, target * sizeof(u64));
-        } else {
-            table.Hashes = allocate_array<u64>(target, {.Alignment = alignment});
-            table.Keys = allocate_array<K>(target, {.Alignment = alignment});
-            table.Values = allocate_array<V>(target, {.Alignment = alignment});
-            zero_memory(table.Hashes, target * sizeof(u64));
-        }
-    };
-
     if (table.Allocated) {
-        auto oldAlignment = ((allocation_header *) table.Hashes - 1)->Alignment;
+        auto oldAlignment = allocation_get_alignment(table.Hashes);
         if (alignment == 0) {
             alignment = oldAlignment;
         } else {
@@ -204,9 +265,15 @@ void reserve(T &table, s64 target, u32 alignment = 0) {
         auto *oldHashes = table.Hashes;
         auto *oldKeys = table.Keys;
         auto *oldValues = table.Values;
+        auto *oldOccupied = table.Occupied;
         auto oldAllocated = table.Allocated;
 
-        allocateNewBlock();
+        hash_table_allocate(table, target, alignment, allocation_get_allocator(oldHashes));
+        zero_memory(table.Hashes, target * sizeof(u64));
+        zero_memory(table.Occupied, hash_table_occupied_words(target) * sizeof(u64));
+
+        // The old items are added with the new size (and counted again)
+        table.Count = table.SlotsFilled = 0;
 
         // Add the old items
         For(range(oldAllocated)) {
@@ -218,14 +285,16 @@ void reserve(T &table, s64 target, u32 alignment = 0) {
         if constexpr (!table.BLOCK_ALLOC) {
             free(oldKeys);
             free(oldValues);
+            free(oldOccupied);
         }
     } else {
         // It's impossible to have a view into a hash table (currently).
         // So there were no previous elements.
         assert(!table.Count);
-        allocateNewBlock();
+        hash_table_allocate(table, target, alignment, alloc);
+        zero_memory(table.Hashes, target * sizeof(u64));
+        zero_memory(table.Occupied, hash_table_occupied_words(target) * sizeof(u64));
     }
-    table.Allocated = target;
 }
 
 // Free any memory allocated by this object and reset count
@@ -236,11 +305,13 @@ void free(T &table) {
         if constexpr (!table.BLOCK_ALLOC) {
             free(table.Keys);
             free(table.Values);
+            free(table.Occupied);
         }
     }
     table.Hashes = null;
     table.Keys = null;
     table.Values = null;
+    table.Occupied = null;
     table.Count = table.SlotsFilled = table.Allocated = 0;
 }
 
@@ -260,21 +331,27 @@ void reset(T &table) {
             }
             ++index, ++p;
         }
+        zero_memory(table.Occupied, hash_table_occupied_words(table.Allocated) * sizeof(u64));
     }
     table.Count = table.SlotsFilled = 0;
 }
 
-// Looks for key in the hash table using the given hash.
-// In normal _find_ we calculate the hash of the key using the global get_hash() specialized functions.
-// This method is useful if you have cached the hash.
-template <any_hash_table T>
-key_value_pair<T> find_prehashed(const T &table, u64 hash, const key_t<T> &key) {
+namespace internal {
+// _key_ is a K or a hash_table_lookup_key
+template <any_hash_table T, typename Q>
+key_value_pair<T> hash_table_find(const T &table, u64 hash, const Q &key) {
     if (!table.Count) return {null, null};
 
+    if (hash < table.FIRST_VALID_HASH) hash += table.FIRST_VALID_HASH;  // Same as in add_prehashed()
+
+    typename T::key_equal_t equal;
+
     s64 index = hash & (table.Allocated - 1);
     For(range(table.Allocated)) {
+        if (!table.Hashes[index]) break;  // An empty slot ends the run, the key would've been put here
+
         if (table.Hashes[index] == hash) {
-            if (table.Keys[index] == key) {
+            if (equal(table.Keys[index], key)) {
                 return {table.Keys + index, table.Values + index};
             }
         }
@@ -286,15 +363,79 @@ key_value_pair<T> find_prehashed(const T &table, u64 hash, const key_t<T> &key)
     }
     return {null, null};
 }
+}  // namespace internal
 
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// Looks for key in the hash table using the given hash.
+// In normal _find_ we calculate the hash of the key with the table's _Hash_.
+// This method is useful if you have cached the hash.
+template <any_hash_table T>
+key_value_pair<T> find_prehashed(const T &table, u64 hash, const key_t<T> &key) { return internal::hash_table_find(table, hash, key); }
+
+// Looks up a key of another type (see hash_table_lookup_key), _hash_ is what the table's _Hash_ returns for it.
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) key_value_pair<T> find_prehashed(const T &table, u64 hash, const Q &key) {
+    return internal::hash_table_find(table, hash, key);
+}
+
+// We calculate the hash of the key with the table's _Hash_.
 template <any_hash_table T>
 key_value_pair<T> find(const T &table, const key_t<T> &key) {
-    return find_prehashed(table, get_hash(key), key);
+    return find_prehashed(table, hash_table_hash(table, key), key);
+}
+
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) key_value_pair<T> find(const T &table, const Q &key) {
+    return find_prehashed(table, hash_table_hash(table, key), key);
+}
+
+// How many lookups find_batch() has in flight. Enough to cover the latency of a trip to memory,
+// but small enough that the prefetched lines are still in L1 when we get to them.
+constexpr s64 HASH_TABLE_FIND_BATCH_SIZE = 16;
+
+// Looks up _count_ keys at once, writes the results (like find_prehashed() returns them) to _out_.
+//
+// When the table is larger than the cache almost every lookup is a cache miss. Instead of waiting for each one in turn,
+// we first prefetch the home slots of a group of keys and then resolve them, so the misses overlap.
+// Worth it for join-like operations over big tables, for small tables just call find() in a loop.
+template <any_hash_table T>
+void find_batch_prehashed(const T &table, const u64 *hashes, const key_t<T> *keys, s64 count, key_value_pair<T> *out) {
+    if (!table.Count) {
+        For(range(count)) out[it] = {null, null};
+        return;
+    }
+
+    s64 mask = table.Allocated - 1;
+
+    for (s64 first = 0; first < count; first += HASH_TABLE_FIND_BATCH_SIZE) {
+        s64 last = min(first + HASH_TABLE_FIND_BATCH_SIZE, count);
+
+        For(range(first, last)) {
+            u64 hash = hashes[it];
+            if (hash < table.FIRST_VALID_HASH) hash += table.FIRST_VALID_HASH;  // Same as in find_prehashed()
+
+            s64 index = hash & mask;
+            _mm_prefetch((const char *) (table.Hashes + index), _MM_HINT_T0);
+            _mm_prefetch((const char *) (table.Keys + index), _MM_HINT_T0);
+        }
+
+        For(range(first, last)) out[it] = find_prehashed(table, hashes[it], keys[it]);
+    }
+}
+
+// We calculate the hashes of the keys with the table's _Hash_.
+template <any_hash_table T>
+void find_batch(const T &table, const key_t<T> *keys, s64 count, key_value_pair<T> *out) {
+    u64 hashes[HASH_TABLE_FIND_BATCH_SIZE];
+
+    for (s64 first = 0; first < count; first += HASH_TABLE_FIND_BATCH_SIZE) {
+        s64 n = min(HASH_TABLE_FIND_BATCH_SIZE, count - first);
+        For(range(n)) hashes[it] = hash_table_hash(table, keys[first + it]);
+        find_batch_prehashed(table, hashes, keys + first, n, out + first);
+    }
 }
 
 // Adds key and value to the hash table using the given hash.
-// In normal _add_ we calculate the hash of the key using the global get_hash() specialized functions.
+// In normal _add_ we calculate the hash of the key with the table's _Hash_.
 // This method is useful if you have cached the hash.
 // Returns pointers to the added key and value.
 template <any_hash_table T>
@@ -316,6 +457,7 @@ key_value_pair<T> add_prehashed(T &table, u64 hash, const key_t<T> &key, const v
     ++table.SlotsFilled;
 
     table.Hashes[index] = hash;
+    table.Occupied[index / 64] |= 1ull << (index % 64);
     new (table.Keys + index) key_t<T>(key);
     new (table.Values + index) value_t<T>(value);
     return {table.Keys + index, table.Values + index};
@@ -331,7 +473,7 @@ key_value_pair<T> add_prehashed(T &table, u64 hash, const key_t<T> &key, const v
 //
 // Because _add_ returns a pointer where the object is placed, clone() can place the deep copy there directly.
 //
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// We calculate the hash of the key with the table's _Hash_.
 template <any_hash_table T>
 key_value_pair<T> add(T &table, const key_t<T> &key) { return add(table, key, value_t<T>()); }
 
@@ -343,14 +485,14 @@ key_value_pair<T> add(T &table, u64 hash) {
     return add_prehashed(table, hash, key_t<T>(), value_t<T>());
 }
 
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// We calculate the hash of the key with the table's _Hash_.
 // Returns pointers to the added key and value.
 template <any_hash_table T>
 key_value_pair<T> add(T &table, const key_t<T> &key, const value_t<T> &value) {
-    return add_prehashed(table, get_hash(key), key, value);
+    return add_prehashed(table, hash_table_hash(table, key), key, value);
 }
 
-// In normal _set_ we calculate the hash of the key using the global get_hash() specialized functions.
+// In normal _set_ we calculate the hash of the key with the table's _Hash_.
 // This method is useful if you have cached the hash.
 template <any_hash_table T>
 key_value_pair<T> set_prehashed(T &table, u64 hash, const key_t<T> &key, const value_t<T> &value) {
@@ -359,46 +501,104 @@ key_value_pair<T> set_prehashed(T &table, u64 hash, const key_t<T> &key, const v
         *vp = value;
         return {kp, vp};
     }
-    return add(table, key, value);
+    return add_prehashed(table, hash, key, value);
 }
 
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// We calculate the hash of the key with the table's _Hash_.
 template <any_hash_table T>
 key_value_pair<T> set(T &table, const key_t<T> &key, const value_t<T> &value) {
-    return set_prehashed(table, get_hash(key), key, value);
+    return set_prehashed(table, hash_table_hash(table, key), key, value);
+}
+
+namespace internal {
+// Does the backward shift, see remove_prehashed()
+template <any_hash_table T>
+void hash_table_remove_slot(T &table, s64 hole) {
+    using K = key_t<T>;
+    using V = value_t<T>;
+
+    s64 mask = table.Allocated - 1;
+
+    table.Keys[hole].~K();
+    table.Values[hole].~V();
+
+    s64 index = (hole + 1) & mask;
+    while (table.Hashes[index]) {
+        s64 ideal = table.Hashes[index] & mask;
+
+        // Distances (going forward, wrapping around) from the ideal slot of the entry to the hole and to where it is now.
+        // If the hole is closer, the entry can move there without ending up before its ideal slot.
+        if (((hole - ideal) & mask) < ((index - ideal) & mask)) {
+            table.Hashes[hole] = table.Hashes[index];
+            copy_memory(table.Keys + hole, table.Keys + index, sizeof(K));
+            copy_memory(table.Values + hole, table.Values + index, sizeof(V));
+            hole = index;
+        }
+        index = (index + 1) & mask;
+    }
+
+    // The slots entries were moved into stay filled, only the last hole is cleared
+    table.Hashes[hole] = 0;
+    table.Occupied[hole / 64] &= ~(1ull << (hole % 64));
+    --table.Count;
+    --table.SlotsFilled;
 }
+}  // namespace internal
 
 // Returns true if the key was found and removed.
-// In normal _remove_ we calculate the hash of the key using the global get_hash() specialized functions.
+// In normal _remove_ we calculate the hash of the key with the table's _Hash_.
 // This method is useful if you have cached the hash.
+//
+// We don't leave a tombstone in the removed slot (which would still count as filled and make the table grow under
+// insert/remove churn even when _Count_ is stable). Instead we do backward-shift deletion: the following entries of
+// the run are moved back into the hole, unless that would move them before the slot their hash maps to.
+// This way every run stays contiguous and find_prehashed() can stop at the first empty slot.
 template <any_hash_table T>
 bool remove_prehashed(T &table, u64 hash, const key_t<T> &key) {
-    auto *ptr = find(table, hash, key);
-    if (ptr) {
-        s64 index = ptr - table.Values;
-        table.Hashes[index] = 1;
-        return true;
-    }
-    return false;
+    auto [kp, vp] = find_prehashed(table, hash, key);
+    if (!kp) return false;
+
+    internal::hash_table_remove_slot(table, kp - table.Keys);
+    return true;
+}
+
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) bool remove_prehashed(T &table, u64 hash, const Q &key) {
+    auto [kp, vp] = find_prehashed(table, hash, key);
+    if (!kp) return false;
+
+    internal::hash_table_remove_slot(table, kp - table.Keys);
+    return true;
 }
 
 // Returns true if the key was found and removed.
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// We calculate the hash of the key with the table's _Hash_.
 template <any_hash_table T>
 bool remove(T &table, const key_t<T> &key) {
-    return remove_prehashed(table, get_hash(key), key);
+    return remove_prehashed(table, hash_table_hash(table, key), key);
+}
+
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) bool remove(T &table, const Q &key) {
+    return remove_prehashed(table, hash_table_hash(table, key), key);
 }
 
 // Returns true if the hash table has the given key.
-// We calculate the hash of the key using the global get_hash() specialized functions.
+// We calculate the hash of the key with the table's _Hash_.
 template <any_hash_table T>
 bool has(const T &table, const key_t<T> &key) { return find(table, key).Key != null; }
 
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) bool has(const T &table, const Q &key) { return find(table, key).Key != null; }
+
 // Returns true if the hash table has the given key.
-// In normal _hash_ we calculate the hash of the key using the global get_hash() specialized functions.
+// In normal _hash_ we calculate the hash of the key with the table's _Hash_.
 // This method is useful if you have cached the hash.
 template <any_hash_table T>
-bool has_prehashed(const T &table, u64 hash, const key_t<T> &key) { return find_prehashed(table, hash, key) != null; }
+bool has_prehashed(const T &table, u64 hash, const key_t<T> &key) { return find_prehashed(table, hash, key).Key != null; }
+
+template <any_hash_table T, typename Q>
+requires(hash_table_lookup_key<T, Q>) bool has_prehashed(const T &table, u64 hash, const Q &key) { return find_prehashed(table, hash, key).Key != null; }
 
 template <any_hash_table T>
 bool operator==(const T &t, const T &u) {
@@ -417,8 +617,8 @@ bool operator!=(const T &t, const T &u) { return !(t == u); }
 #undef key_t
 #undef value_t
 
-template <typename K, typename V, bool BlockAlloc>
-hash_table<K, V, BlockAlloc> *clone(hash_table<K, V, BlockAlloc> *dest, const hash_table<K, V, BlockAlloc> &src) {
+template <typename K, typename V, bool BlockAlloc, typename Hash, typename Equal>
+hash_table<K, V, BlockAlloc, Hash, Equal> *clone(hash_table<K, V, BlockAlloc, Hash, Equal> *dest, const hash_table<K, V, BlockAlloc, Hash, Equal> &src) {
     free(*dest);
     for (auto [k, v] : src) add(*dest, *k, *v);
     return dest;
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "../job_system.h"
+#include "hash_table.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Builds a hash_table from arrays of keys and values at once, for indices which are rebuilt after loading data.
+//
+//     hash_table<u64, u32> rowByID;
+//     hash_table_build(rowByID, ids, rows);
+//
+// Adding millions of entries one at a time grows the table over and over (every growth re-adds everything
+// so far) and hashes keys one after another. Here the table is sized once and the work is split up:
+//
+// 1. The keys are hashed in parallel chunks, each chunk also counts how many of its keys land in each
+//    partition - a power of two of contiguous slot ranges, picked by the high bits of the home slot.
+// 2. The key indices are scattered into partition order (a counting sort, chunks keep the input order).
+// 3. Every partition is filled by one job. Its keys probe only inside its own slots, so no two jobs touch
+//    the same slot (or the same word of _Occupied_, partitions are multiples of 64 slots) and nothing is locked.
+//    A key whose probe would run past the end of its partition is left for the end.
+// 4. Those few leftovers are added on the calling thread with normal (wrapping) probing.
+//
+// The result is the same as calling set() with each pair in order: if a key repeats, the last value wins.
+// Small builds (or no job system) take the same path in one partition on the calling thread.
+//
+// Whatever was in the table before is removed (the arrays are reused if they are big enough).
+//
+
+// Below this many keys the build runs on the calling thread
+constexpr s64 HASH_TABLE_BUILD_PARALLEL_THRESHOLD = 32768;
+
+// A partition has at least this many slots
+constexpr s64 HASH_TABLE_BUILD_MIN_PARTITION = 4096;
+
+struct hash_table_build_options {
+    bool Parallel = true;  // Use the job system (if it's running and there are enough keys)
+};
+
+namespace internal {
+// Adds (or overwrites) probing only slots [index, end), returns false if it ran out of slots there
+template <any_hash_table T>
+bool hash_table_build_insert(T &table, s64 index, s64 end, u64 hash, const hash_table_key_t<T> &key, const hash_table_value_t<T> &value, s64 &added) {
+    typename T::key_equal_t equal;
+
+    for (; index < end; ++index) {
+        u64 h = table.Hashes[index];
+        if (!h) {
+            table.Hashes[index] = hash;
+            table.Occupied[index / 64] |= 1ull << (index % 64);
+            new (table.Keys + index) hash_table_key_t<T>(key);
+            new (table.Values + index) hash_table_value_t<T>(value);
+            ++added;
+            return true;
+        }
+
+        if (h == hash && equal(table.Keys[index], key)) {
+            table.Values[index] = value;
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace internal
+
+template <any_hash_table T>
+void hash_table_build(T &table, const hash_table_key_t<T> *keys, const hash_table_value_t<T> *values, s64 count, hash_table_build_options options = {}) {
+    assert(count >= 0 && count < (s64) U32_MAX);
+
+    reset(table);
+    reserve(table, 2 * count + 1);  // Stays under half full, like after adding them one by one
+
+    if (!count) return;
+
+    s64 slots = table.Allocated;
+    s64 mask = slots - 1;
+
+    bool parallel = options.Parallel && job_system_worker_count() > 0 && count >= HASH_TABLE_BUILD_PARALLEL_THRESHOLD;
+
+    // Enough partitions to keep every worker busy while the uneven ones finish, all of them big
+    s64 partitions = 1;
+    if (parallel) {
+        s64 wanted = ceil_pow_of_2(job_system_worker_count() * 4);
+        while (partitions < wanted && slots / (partitions * 2) >= HASH_TABLE_BUILD_MIN_PARTITION) partitions *= 2;
+    }
+    s64 partitionSlots = slots / partitions;
+    s32 partitionShift = msb((u64) partitionSlots);
+
+    s64 chunks = parallel ? min(count, job_system_worker_count() * 4) : 1;
+    s64 chunkSize = (count + chunks - 1) / chunks;
+    chunks = (count + chunkSize - 1) / chunkSize;
+
+    auto *hashes = allocate_array_uninitialized<u64>(count);
+    auto *order = allocate_array_uninitialized<u32>(count);
+    auto *offsets = allocate_array_uninitialized<s64>(chunks * partitions);  // Per chunk and partition, counts then where they go
+    auto *starts = allocate_array_uninitialized<s64>(partitions + 1);
+    auto *leftovers = allocate_array_uninitialized<s64>(partitions);  // The first ones of each partition in _order_ are left over
+    auto *added = allocate_array_uninitialized<s64>(partitions);
+    zero_memory(offsets, chunks * partitions * sizeof(s64));
+    defer({
+        free(hashes);
+        free(order);
+        free(offsets);
+        free(starts);
+        free(leftovers);
+        free(added);
+    });
+
+    auto hash_chunk = [&](s64 begin, s64 end) {
+        For_as(c, range(begin, end)) {
+            s64 *counts = offsets + c * partitions;
+            For(range(c * chunkSize, min(count, (c + 1) * chunkSize))) {
+                u64 h = hash_table_hash(table, keys[it]);
+                if (h < table.FIRST_VALID_HASH) h += table.FIRST_VALID_HASH;  // Same as in add_prehashed()
+
+                hashes[it] = h;
+                ++counts[(h & mask) >> partitionShift];
+            }
+        }
+    };
+
+    auto scatter_chunk = [&](s64 begin, s64 end) {
+        For_as(c, range(begin, end)) {
+            s64 *cursors = offsets + c * partitions;
+            For(range(c * chunkSize, min(count, (c + 1) * chunkSize))) order[cursors[(hashes[it] & mask) >> partitionShift]++] = (u32) it;
+        }
+    };
+
+    auto fill_partitions = [&](s64 begin, s64 end) {
+        For_as(p, range(begin, end)) {
+            s64 slotEnd = (p + 1) * partitionSlots;
+            added[p] = 0;
+
+            // Leftovers are moved to the front of the partition's range of _order_, we've read past them already
+            s64 left = starts[p];
+            For_as(i, range(starts[p], starts[p + 1])) {
+                u32 k = order[i];
+
+                s64 home = hashes[k] & mask;
+                if (!internal::hash_table_build_insert(table, home, slotEnd, hashes[k], keys[k], values[k], added[p])) order[left++] = k;
+            }
+            leftovers[p] = left - starts[p];
+        }
+    };
+
+    if (parallel) {
+        job_parallel_for(chunks, 1, &hash_chunk);
+    } else {
+        hash_chunk(0, chunks);
+    }
+
+    // Partition by partition, chunk by chunk, so every partition has its keys in input order
+    s64 next = 0;
+    For_as(p, range(partitions)) {
+        starts[p] = next;
+        For_as(c, range(chunks)) {
+            s64 n = offsets[c * partitions + p];
+            offsets[c * partitions + p] = next;
+            next += n;
+        }
+    }
+    starts[partitions] = next;
+
+    if (parallel) {
+        job_parallel_for(chunks, 1, &scatter_chunk);
+        job_parallel_for(partitions, 1, &fill_partitions);
+    } else {
+        scatter_chunk(0, chunks);
+        fill_partitions(0, partitions);
+    }
+
+    s64 total = 0;
+    For(range(partitions)) total += added[it];
+
+    // A key always repeats in the same partition, and leftovers go in their order, so the last value still wins
+    For_as(p, range(partitions)) {
+        For_as(i, range(starts[p], starts[p] + leftovers[p])) {
+            u32 k = order[i];
+
+            // Past the end of the partition and, if it comes to that, around the end of the table. No job is writing
+            // anymore. The table is never full, so the run ends before it gets back to _home_.
+            s64 home = hashes[k] & mask;
+            if (!internal::hash_table_build_insert(table, home, slots, hashes[k], keys[k], values[k], total)) {
+                bool inserted = internal::hash_table_build_insert(table, 0, home, hashes[k], keys[k], values[k], total);
+                assert(inserted);
+            }
+        }
+    }
+
+    table.Count = table.SlotsFilled = total;
+}
+
+template <any_hash_table T, is_array_like KeysArr, is_array_like ValuesArr>
+void hash_table_build(T &table, const KeysArr &keys, const ValuesArr &values, hash_table_build_options options = {}) {
+    assert(keys.Count == values.Count);
+    hash_table_build(table, keys.Data, values.Data, keys.Count, options);
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,230 @@
+#include "hasher.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2 and AVX2 intrinsics
+#if COMPILER == MSVC
+#include <intrin.h>  // _umul128 (Visual Studio)
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// The scalar parts of the algorithm are in hasher.h (so they can be used at compile time), here we have the SIMD
+// versions of the stripe loop, the dispatch between them and the streaming state.
+//
+// See https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md for a description of the algorithm.
+//
+
+using namespace xxh3;
+
+#if ARCH == X86
+file_scope void accumulate_sse2(u64 *acc, const byte *in, const byte *secret, s64 stripes) {
+    auto *xacc = (__m128i *) acc;
+
+    For_as(s, range(stripes)) {
+        auto *stripe = (const __m128i *) (in + s * hasher::STRIPE_SIZE);
+        auto *key = (const __m128i *) (secret + s * 8);
+        For(range(4)) {
+            __m128i data = _mm_loadu_si128(stripe + it);
+            __m128i dataKey = _mm_xor_si128(data, _mm_loadu_si128(key + it));
+            __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);  // Low 32 bits times high 32 bits of each lane
+            __m128i dataSwap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[it] = _mm_add_epi64(product, _mm_add_epi64(xacc[it], dataSwap));
+        }
+    }
+}
+
+file_scope void scramble_sse2(u64 *acc, const byte *secret) {
+    auto *xacc = (__m128i *) acc;
+    auto *key = (const __m128i *) secret;
+
+    __m128i prime = _mm_set1_epi32((s32) PRIME32_1);
+    For(range(4)) {
+        __m128i a = xacc[it];
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128(key + it));
+
+        // 64 bit multiply by a 32 bit number with 32 bit multiplies
+        __m128i aHi = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i productLo = _mm_mul_epu32(a, prime);
+        __m128i productHi = _mm_mul_epu32(aHi, prime);
+        xacc[it] = _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32));
+    }
+}
+
+// MSVC lets us use AVX2 intrinsics without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+TARGET_AVX2 file_scope void accumulate_avx2(u64 *acc, const byte *in, const byte *secret, s64 stripes) {
+    auto *xacc = (__m256i *) acc;
+
+    For_as(s, range(stripes)) {
+        auto *stripe = (const __m256i *) (in + s * hasher::STRIPE_SIZE);
+        auto *key = (const __m256i *) (secret + s * 8);
+        For(range(2)) {
+            __m256i data = _mm256_loadu_si256(stripe + it);
+            __m256i dataKey = _mm256_xor_si256(data, _mm256_loadu_si256(key + it));
+            __m256i dataKeyHi = _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            __m256i product = _mm256_mul_epu32(dataKey, dataKeyHi);
+            __m256i dataSwap = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[it] = _mm256_add_epi64(product, _mm256_add_epi64(xacc[it], dataSwap));
+        }
+    }
+}
+
+TARGET_AVX2 file_scope void scramble_avx2(u64 *acc, const byte *secret) {
+    auto *xacc = (__m256i *) acc;
+    auto *key = (const __m256i *) secret;
+
+    __m256i prime = _mm256_set1_epi32((s32) PRIME32_1);
+    For(range(2)) {
+        __m256i a = xacc[it];
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256(key + it));
+
+        __m256i aHi = _mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m256i productLo = _mm256_mul_epu32(a, prime);
+        __m256i productHi = _mm256_mul_epu32(aHi, prime);
+        xacc[it] = _mm256_add_epi64(productLo, _mm256_slli_epi64(productHi, 32));
+    }
+}
+
+#undef TARGET_AVX2
+#endif
+
+using accumulate_func = void (*)(u64 *acc, const byte *in, const byte *secret, s64 stripes);
+using scramble_func = void (*)(u64 *acc, const byte *secret);
+
+struct hasher_stripe_funcs {
+    accumulate_func Accumulate;
+    scramble_func Scramble;
+};
+
+// Picked the first time we hash a long input
+file_scope hasher_stripe_funcs get_stripe_funcs() {
+    local_persist cpu_dispatch<hasher_stripe_funcs> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> hasher_stripe_funcs {
+#if ARCH == X86
+        if (cpu.AVX2) return {accumulate_avx2, scramble_avx2};
+        return {accumulate_sse2, scramble_sse2};
+#else
+        return {accumulate_scalar<byte>, scramble_scalar};
+#endif
+    });
+}
+
+// Accumulates _stripes_ stripes, continuing a block which already has _*stripesSoFar_ stripes in it
+file_scope void consume_stripes(hasher_stripe_funcs f, u64 *acc, s64 *stripesSoFar, const byte *in, s64 stripes, const byte *secret) {
+    constexpr s64 SECRET_LIMIT = hasher::SECRET_SIZE - hasher::STRIPE_SIZE;
+
+    s64 toEndOfBlock = hasher::STRIPES_PER_BLOCK - *stripesSoFar;
+    if (toEndOfBlock <= stripes) {
+        f.Accumulate(acc, in, secret + *stripesSoFar * 8, toEndOfBlock);
+        f.Scramble(acc, secret + SECRET_LIMIT);
+        f.Accumulate(acc, in + toEndOfBlock * hasher::STRIPE_SIZE, secret, stripes - toEndOfBlock);
+        *stripesSoFar = stripes - toEndOfBlock;
+    } else {
+        f.Accumulate(acc, in, secret + *stripesSoFar * 8, stripes);
+        *stripesSoFar += stripes;
+    }
+}
+
+file_scope u64 hash_long(const byte *in, u64 size, const byte *secret) {
+    auto f = get_stripe_funcs();
+    return xxh3::hash_long(in, size, secret, f.Accumulate, f.Scramble);
+}
+
+u64 hash_bytes(const void *data, s64 size, u64 seed) {
+    auto *in = (const byte *) data;
+    if (size <= MIDSIZE_MAX) return hash_short(in, (u64) size, seed);
+
+    if (!seed) return hash_long(in, (u64) size, DEFAULT_SECRET);
+
+    alignas(64) byte secret[hasher::SECRET_SIZE];
+    init_secret(secret, seed);
+    return hash_long(in, (u64) size, secret);
+}
+
+hasher::hasher(u64 seed) : Seed(seed) {
+    init_acc(Acc);
+    init_secret(Secret, seed);
+}
+
+bool hasher::add(const char *data, s64 size) {
+    if (!data) return false;
+
+    auto *in = (const byte *) data;
+    const byte *end = in + size;
+
+    Count += size;
+
+    // We only consume the buffer when more data arrives, that way it's never empty when we get to hash()
+    if (BufferSize + size <= MAX_BUFFER_SIZE) {
+        copy_memory(Buffer + BufferSize, in, size);
+        BufferSize += size;
+        return true;
+    }
+
+    constexpr s64 BUFFER_STRIPES = MAX_BUFFER_SIZE / STRIPE_SIZE;
+
+    auto f = get_stripe_funcs();
+
+    if (BufferSize) {
+        s64 fill = MAX_BUFFER_SIZE - BufferSize;
+        copy_memory(Buffer + BufferSize, in, fill);
+        in += fill;
+
+        consume_stripes(f, Acc, &StripesSoFar, Buffer, BUFFER_STRIPES, Secret);
+        BufferSize = 0;
+    }
+
+    // Consume directly from the input, leaving at least one byte for the buffer
+    if (end - in > MAX_BUFFER_SIZE) {
+        do {
+            consume_stripes(f, Acc, &StripesSoFar, in, BUFFER_STRIPES, Secret);
+            in += MAX_BUFFER_SIZE;
+        } while (end - in > MAX_BUFFER_SIZE);
+
+        // hash() may need the last stripe we consumed if what's left is less than a stripe
+        copy_memory(Buffer + MAX_BUFFER_SIZE - STRIPE_SIZE, in - STRIPE_SIZE, STRIPE_SIZE);
+    }
+
+    copy_memory(Buffer, in, end - in);
+    BufferSize = end - in;
+    return true;
+}
+
+u64 hasher::hash() {
+    if (Count <= (u64) MIDSIZE_MAX) return hash_short(Buffer, Count, Seed);
+
+    constexpr s64 SECRET_LIMIT = SECRET_SIZE - STRIPE_SIZE;
+
+    auto f = get_stripe_funcs();
+
+    // Work on a copy, so the user can keep adding data after this
+    alignas(64) u64 acc[8];
+    copy_memory(acc, Acc, sizeof(acc));
+    s64 stripesSoFar = StripesSoFar;
+
+    if (BufferSize >= STRIPE_SIZE) {
+        s64 stripes = (BufferSize - 1) / STRIPE_SIZE;
+        consume_stripes(f, acc, &stripesSoFar, Buffer, stripes, Secret);
+        f.Accumulate(acc, Buffer + BufferSize - STRIPE_SIZE, Secret + SECRET_LIMIT - 7, 1);
+    } else {
+        // The last stripe is made of the end of the previous buffer and what we have now
+        alignas(64) byte lastStripe[STRIPE_SIZE];
+        s64 catchUp = STRIPE_SIZE - BufferSize;
+        copy_memory(lastStripe, Buffer + MAX_BUFFER_SIZE - catchUp, catchUp);
+        copy_memory(lastStripe + catchUp, Buffer, BufferSize);
+        f.Accumulate(acc, lastStripe, Secret + SECRET_LIMIT - 7, 1);
+    }
+
+    return merge_acc(acc, Secret + 11, Count * PRIME64_1);
+}
+
+LSTD_END_NAMESPACE
@@ -2,133 +2,342 @@
 
 #include "../internal/common.h"
 
+#if COMPILER == MSVC
+#include <intrin.h>  // _umul128
+#endif
+
 LSTD_BEGIN_NAMESPACE
 
 //
-// Hasher based on Yann Collet's descriptions, see http://cyan4973.github.io/xxHash/
+// Hasher based on Yann Collet's XXH3, see https://github.com/Cyan4973/xxHash
+// (64 bit variant, gives the same results as XXH3_64bits_withSeed).
 //
 // Example use:
 //    hasher h(..seed..);
 //    h.add(&value);
 //    ...
-//    u64 result = h.get_hash();
-// @Speed: Not so fast atm..
+//    u64 result = h.hash();
+//
+// Or if you have the whole buffer, just call hash_bytes() (which is faster, especially for short inputs).
+//
+// Long inputs are processed in stripes of 64 bytes with 8 accumulators. At runtime we pick a SSE2 or an AVX2
+// version of the stripe loop the first time we need it, depending on what the CPU supports.
+//
+// The scalar version of the whole algorithm is in this header and is constexpr (see const_hash_bytes()),
+// so hashes calculated at compile time match the ones calculated at runtime.
+//
+
+// Defined in hasher.cpp
+u64 hash_bytes(const void *data, s64 size, u64 seed = 0);
 
 struct hasher {
-    // Temporarily store up to 31 bytes between multiple add() calls
-    static constexpr s64 MAX_BUFFER_SIZE = 31 + 1;
+    static constexpr s64 STRIPE_SIZE = 64;
+    static constexpr s64 SECRET_SIZE = 192;
+    static constexpr s64 STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_SIZE) / 8;
+
+    // Inputs up to 240 bytes are hashed with the short paths of hash_bytes(), so we keep them whole in _Buffer_.
+    // After that we consume the buffer 4 stripes at a time.
+    static constexpr s64 MAX_BUFFER_SIZE = 256;
+
+    alignas(64) u64 Acc[8];
+    alignas(64) byte Secret[SECRET_SIZE];  // Derived from the seed
+    alignas(64) byte Buffer[MAX_BUFFER_SIZE];
 
-    char Buffer[MAX_BUFFER_SIZE]{};
-    char *BufferPtr = Buffer;
-    char *BufferEnd = Buffer + MAX_BUFFER_SIZE;
+    s64 BufferSize = 0;
+    s64 StripesSoFar = 0;  // In the current block
 
     u64 Count = 0;
+    u64 Seed;
+
+    // Defined in hasher.cpp
+    hasher(u64 seed);
+
+    bool add(const char *data, s64 size);
+    u64 hash();
+};
+
+//
+// The scalar implementation. The functions are templated on the character type of the input
+// because we can't reinterpret pointers at compile time (so we can hash string literals directly).
+//
+namespace xxh3 {
+constexpr u64 PRIME32_1 = 0x9E3779B1U;
+constexpr u64 PRIME32_2 = 0x85EBCA77U;
+constexpr u64 PRIME32_3 = 0xC2B2AE3DU;
+constexpr u64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr u64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr u64 PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr u64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr u64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+constexpr s64 MIDSIZE_MAX = 240;
+constexpr s64 SECRET_LIMIT = hasher::SECRET_SIZE - hasher::STRIPE_SIZE;
 
-    u64 State[4]{};
+// The default secret of XXH3
+alignas(64) inline constexpr byte DEFAULT_SECRET[hasher::SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
 
-    hasher(u64 seed) {
-        State[0] = seed + 11400714785074694791ULL + 14029467366897019727ULL;
-        State[1] = seed + 14029467366897019727ULL;
-        State[2] = seed;
-        State[3] = seed - 11400714785074694791ULL;
+// Unaligned little endian reads (at runtime on x86 these are just loads)
+template <typename C>
+always_inline constexpr u64 read_u64(const C *p) {
+    if (is_constant_evaluated()) {
+        u64 result = 0;
+        For(range(8)) result |= (u64) (u8) p[it] << (8 * it);
+        return result;
     }
+    return *(const u64 *) p;
+}
 
-    // @Speed: SIMD this shit
-    bool add(const char *data, s64 size) {
-        if (!data) return false;
+template <typename C>
+always_inline constexpr u32 read_u32(const C *p) {
+    if (is_constant_evaluated()) {
+        u32 result = 0;
+        For(range(4)) result |= (u32) (u8) p[it] << (8 * it);
+        return result;
+    }
+    return *(const u32 *) p;
+}
 
-        Count += size;
+always_inline constexpr void write_u64(byte *p, u64 value) {
+    For(range(8)) p[it] = (byte) (value >> (8 * it));
+}
 
-        if (BufferPtr + size < BufferEnd) {
-            copy_memory(BufferPtr, data, size);
-            BufferPtr += size;
-            return true;
-        }
+always_inline constexpr u64 swap_u64(u64 x) {
+    x = ((x << 8) & 0xFF00FF00FF00FF00ULL) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+    x = ((x << 16) & 0xFFFF0000FFFF0000ULL) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+    return (x << 32) | (x >> 32);
+}
 
-        if (BufferPtr != Buffer) {
-            s64 available = BufferEnd - BufferPtr;
-            copy_memory(BufferPtr, data, available);
-            data += available;
+always_inline constexpr u32 swap_u32(u32 x) { return x << 24 & 0xFF000000 | x << 8 & 0x00FF0000 | x >> 8 & 0x0000FF00 | x >> 24 & 0x000000FF; }
 
-            process(Buffer);
-        }
+// Multiplies two 64 bit numbers and xors the low and the high half of the 128 bit result
+always_inline constexpr u64 mul128_fold64(u64 lhs, u64 rhs) {
+    if (!is_constant_evaluated()) {
+#if COMPILER == MSVC
+        u64 hi;
+        u64 lo = _umul128(lhs, rhs, &hi);
+        return lo ^ hi;
+#else
+        unsigned __int128 product = (unsigned __int128) lhs * rhs;
+        return (u64) product ^ (u64) (product >> 64);
+#endif
+    }
 
-        const char *stop = data + size - MAX_BUFFER_SIZE;
-        while (data <= stop) {
-            process(data);
-            data += 32;
-        }
+    u64 loLo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    u64 hiLo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+    u64 loHi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    u64 hiHi = (lhs >> 32) * (rhs >> 32);
+
+    u64 cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    u64 hi = (hiLo >> 32) + (cross >> 32) + hiHi;
+    u64 lo = (cross << 32) | (loLo & 0xFFFFFFFF);
+    return lo ^ hi;
+}
+
+always_inline constexpr u64 xxh64_avalanche(u64 h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+always_inline constexpr u64 avalanche(u64 h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+always_inline constexpr u64 rrmxmx(u64 h, u64 size) {
+    h ^= rotate_left_64(h, 49) ^ rotate_left_64(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + size;
+    h *= 0x9FB21C651E98DF25ULL;
+    return h ^ (h >> 28);
+}
+
+template <typename C>
+always_inline constexpr u64 mix16(const C *in, const byte *secret, u64 seed) {
+    u64 lo = read_u64(in), hi = read_u64(in + 8);
+    return mul128_fold64(lo ^ (read_u64(secret) + seed), hi ^ (read_u64(secret + 8) - seed));
+}
+
+//
+// Short inputs (up to 240 bytes) - these always use the default secret and mix the seed in directly.
+//
 
-        copy_memory(Buffer, data, size);
-        BufferPtr = Buffer + size;
-        return true;
+template <typename C>
+constexpr u64 hash_0_to_16(const C *in, u64 size, const byte *secret, u64 seed) {
+    if (size > 8) {
+        u64 bitflip1 = (read_u64(secret + 24) ^ read_u64(secret + 32)) + seed;
+        u64 bitflip2 = (read_u64(secret + 40) ^ read_u64(secret + 48)) - seed;
+        u64 lo = read_u64(in) ^ bitflip1;
+        u64 hi = read_u64(in + size - 8) ^ bitflip2;
+        return avalanche(size + swap_u64(lo) + hi + mul128_fold64(lo, hi));
     }
 
-    u64 hash() {
-        u64 result = 0;
-        if (Count >= MAX_BUFFER_SIZE) {
-            result += rotate_left_64(State[0], 1);
-            result += rotate_left_64(State[1], 7);
-            result += rotate_left_64(State[2], 12);
-            result += rotate_left_64(State[3], 18);
-
-            result ^= rotate_left_64(State[0] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-            result *= 11400714785074694791ULL;
-            result += 9650029242287828579ULL;
-
-            result ^= rotate_left_64(State[1] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-            result *= 11400714785074694791ULL;
-            result += 9650029242287828579ULL;
-
-            result ^= rotate_left_64(State[2] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-            result *= 11400714785074694791ULL;
-            result += 9650029242287828579ULL;
-
-            result ^= rotate_left_64(State[3] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-            result *= 11400714785074694791ULL;
-            result += 9650029242287828579ULL;
-        } else {
-            result = State[2] + 2870177450012600261ULL;
-        }
+    if (size >= 4) {
+        seed ^= (u64) swap_u32((u32) seed) << 32;
+        u64 bitflip = (read_u64(secret + 8) ^ read_u64(secret + 16)) - seed;
+        u64 input = read_u32(in + size - 4) + ((u64) read_u32(in) << 32);
+        return rrmxmx(input ^ bitflip, size);
+    }
 
-        result += Count;
+    if (size) {
+        u32 combined = ((u32) (u8) in[0] << 16) | ((u32) (u8) in[size >> 1] << 24) | (u32) (u8) in[size - 1] | ((u32) size << 8);
+        u64 bitflip = (read_u32(secret) ^ read_u32(secret + 4)) + seed;
+        return xxh64_avalanche((u64) combined ^ bitflip);
+    }
 
-        auto *p = Buffer;
-        while (p + 8 < BufferPtr) {
-            result = rotate_left_64(result ^ (rotate_left_64(*(u64 *) p * 14029467366897019727ULL, 31)), 27);
-            result *= 11400714785074694791ULL;
-            result += 9650029242287828579ULL;
+    return xxh64_avalanche(seed ^ (read_u64(secret + 56) ^ read_u64(secret + 64)));
+}
 
-            p += 8;
+template <typename C>
+constexpr u64 hash_17_to_128(const C *in, u64 size, const byte *secret, u64 seed) {
+    u64 acc = size * PRIME64_1;
+    if (size > 32) {
+        if (size > 64) {
+            if (size > 96) {
+                acc += mix16(in + 48, secret + 96, seed);
+                acc += mix16(in + size - 64, secret + 112, seed);
+            }
+            acc += mix16(in + 32, secret + 64, seed);
+            acc += mix16(in + size - 48, secret + 80, seed);
         }
+        acc += mix16(in + 16, secret + 32, seed);
+        acc += mix16(in + size - 32, secret + 48, seed);
+    }
+    acc += mix16(in, secret, seed);
+    acc += mix16(in + size - 16, secret + 16, seed);
+    return avalanche(acc);
+}
 
-        if (p + 4 <= BufferPtr) {
-            result = rotate_left_64(result ^ (*(u32 *) p) * 11400714785074694791ULL, 23);
-            result *= 14029467366897019727ULL;
-            result += 1609587929392839161ULL;
-            p += 4;
-        }
+template <typename C>
+constexpr u64 hash_129_to_240(const C *in, u64 size, const byte *secret, u64 seed) {
+    u64 acc = size * PRIME64_1;
+    s64 rounds = (s64) size / 16;
 
-        while (p != BufferPtr) {
-            result = rotate_left_64(result ^ (*p++) * 2870177450012600261ULL, 11) * 11400714785074694791ULL;
+    For(range(8)) acc += mix16(in + 16 * it, secret + 16 * it, seed);
+    acc = avalanche(acc);
+
+    For(range(8, rounds)) acc += mix16(in + 16 * it, secret + 16 * (it - 8) + 3, seed);
+    acc += mix16(in + size - 16, secret + 136 - 17, seed);
+    return avalanche(acc);
+}
+
+template <typename C>
+constexpr u64 hash_short(const C *in, u64 size, u64 seed) {
+    if (size <= 16) return hash_0_to_16(in, size, DEFAULT_SECRET, seed);
+    if (size <= 128) return hash_17_to_128(in, size, DEFAULT_SECRET, seed);
+    return hash_129_to_240(in, size, DEFAULT_SECRET, seed);
+}
+
+//
+// Long inputs - the stripe loop. _accumulate_ runs over _stripes_ stripes, moving 8 bytes through the secret for
+// each one, _scramble_ runs at the end of every block (when we run out of secret).
+//
+
+template <typename C>
+constexpr void accumulate_scalar(u64 *acc, const C *in, const byte *secret, s64 stripes) {
+    For_as(s, range(stripes)) {
+        const C *stripe = in + s * hasher::STRIPE_SIZE;
+        const byte *key = secret + s * 8;
+        For(range(8)) {
+            u64 data = read_u64(stripe + 8 * it);
+            u64 dataKey = data ^ read_u64(key + 8 * it);
+            acc[it ^ 1] += data;
+            acc[it] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
         }
+    }
+}
 
-        result ^= result >> 33;
-        result *= 14029467366897019727ULL;
-        result ^= result >> 29;
-        result *= 1609587929392839161ULL;
-        result ^= result >> 32;
-        return result;
+constexpr void scramble_scalar(u64 *acc, const byte *secret) {
+    For(range(8)) {
+        u64 a = acc[it];
+        a ^= a >> 47;
+        a ^= read_u64(secret + 8 * it);
+        a *= PRIME32_1;
+        acc[it] = a;
     }
+}
+
+constexpr void init_acc(u64 *acc) {
+    acc[0] = PRIME32_3;
+    acc[1] = PRIME64_1;
+    acc[2] = PRIME64_2;
+    acc[3] = PRIME64_3;
+    acc[4] = PRIME64_4;
+    acc[5] = PRIME32_2;
+    acc[6] = PRIME64_5;
+    acc[7] = PRIME32_1;
+}
 
-   private:
-    void process(const void *data) {
-        auto *block = (const u64 *) data;
-        State[0] = rotate_left_64(State[0] + block[0] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-        State[1] = rotate_left_64(State[1] + block[1] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-        State[2] = rotate_left_64(State[2] + block[2] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
-        State[3] = rotate_left_64(State[3] + block[3] * 14029467366897019727ULL, 31) * 11400714785074694791ULL;
+// Derives a secret from the seed, used for long inputs
+constexpr void init_secret(byte *secret, u64 seed) {
+    For(range(hasher::SECRET_SIZE / 16)) {
+        write_u64(secret + 16 * it, read_u64(DEFAULT_SECRET + 16 * it) + seed);
+        write_u64(secret + 16 * it + 8, read_u64(DEFAULT_SECRET + 16 * it + 8) - seed);
     }
-};
+}
+
+constexpr u64 merge_acc(const u64 *acc, const byte *secret, u64 start) {
+    u64 result = start;
+    For(range(4)) result += mul128_fold64(acc[2 * it] ^ read_u64(secret + 16 * it), acc[2 * it + 1] ^ read_u64(secret + 16 * it + 8));
+    return avalanche(result);
+}
+
+// _accumulate_ and _scramble_ are the scalar versions above at compile time and the SIMD ones at runtime (see hasher.cpp).
+template <typename C, typename Accumulate, typename Scramble>
+constexpr u64 hash_long(const C *in, u64 size, const byte *secret, Accumulate accumulate, Scramble scramble) {
+    constexpr s64 BLOCK_SIZE = hasher::STRIPE_SIZE * hasher::STRIPES_PER_BLOCK;
+
+    alignas(64) u64 acc[8];
+    init_acc(acc);
+
+    s64 blocks = (s64) (size - 1) / BLOCK_SIZE;
+    For(range(blocks)) {
+        accumulate(acc, in + it * BLOCK_SIZE, secret, hasher::STRIPES_PER_BLOCK);
+        scramble(acc, secret + SECRET_LIMIT);
+    }
+
+    // The last partial block, the last stripe is always done separately (it may overlap with the previous one)
+    s64 stripes = ((s64) (size - 1) - BLOCK_SIZE * blocks) / hasher::STRIPE_SIZE;
+    accumulate(acc, in + blocks * BLOCK_SIZE, secret, stripes);
+    accumulate(acc, in + size - hasher::STRIPE_SIZE, secret + SECRET_LIMIT - 7, 1);
+
+    return merge_acc(acc, secret + 11, size * PRIME64_1);
+}
+}  // namespace xxh3
+
+// Same as hash_bytes(), but can be evaluated at compile time (e.g. on string literals).
+// At runtime this just calls hash_bytes().
+template <typename C>
+constexpr u64 const_hash_bytes(const C *data, s64 size, u64 seed = 0) {
+    static_assert(sizeof(C) == 1, "Pass a pointer to bytes or characters");
+
+    if (!is_constant_evaluated()) return hash_bytes(data, size, seed);
+
+    if (size <= xxh3::MIDSIZE_MAX) return xxh3::hash_short(data, (u64) size, seed);
+
+    byte secret[hasher::SECRET_SIZE];
+    xxh3::init_secret(secret, seed);
+
+    auto accumulate = [](u64 *acc, const C *in, const byte *secret, s64 stripes) { xxh3::accumulate_scalar(acc, in, secret, stripes); };
+    return xxh3::hash_long(data, (u64) size, secret, accumulate, xxh3::scramble_scalar);
+}
 
 LSTD_END_NAMESPACE
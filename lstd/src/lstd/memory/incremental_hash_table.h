@@ -0,0 +1,318 @@
+#pragma once
+
+#include "hash_table.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// A hash_table which grows without stalling. It has the same API (find, add, set, remove, has, free,
+// with their _prehashed variants, and for loops).
+//
+// When a hash_table is half full, the add which finds out allocates bigger arrays and moves every entry there.
+// For a table with millions of entries that one add takes hundreds of milliseconds. Here the bigger arrays are
+// allocated a bit earlier (at 7/16 full) and every add zeroes the next ZERO_SLOTS of their hashes, so they are ready
+// (and their pages touched) when the table is half full. That add just switches to them and keeps the old arrays
+// around. New entries go to the new arrays and every add after that (and every remove) moves the next
+// MIGRATE_SLOTS slots of the old arrays over, until nothing is left and the old arrays are freed. Meanwhile lookups
+// check the new arrays and then the old ones.
+//
+// The move is done after Allocated / MIGRATE_SLOTS adds, by then the new arrays are at most 3/4 of the way to their
+// own growth. Call migrate() when you have the time (e.g. once per frame) to finish it sooner.
+//
+// Lookups don't move anything, so what find() returned stays valid until the next add or remove (like with hash_table).
+// Pointers into the old arrays point to the entry until it's moved, writes to it before that are moved along.
+//
+// This costs a few percent on every add and a second lookup for keys which aren't in the new arrays while moving,
+// use it when the spikes matter more than the throughput.
+template <typename K_, typename V_, bool BlockAlloc = true, typename Hash = key_hash<K_>, typename Equal = key_equal<K_>>
+struct incremental_hash_table {
+    using K = K_;
+    using V = V_;
+    using table_t = hash_table<K, V, BlockAlloc, Hash, Equal>;
+
+    static constexpr s64 MIGRATE_SLOTS = 64;
+
+    // There are Allocated / 16 adds between allocating _Next_ and needing it, zeroing its 2 * Allocated hashes takes 32
+    // slots per add. We do more, so removes in between don't make the last add zero the rest.
+    // A multiple of 64, so every step zeroes whole words of _Occupied_.
+    static constexpr s64 ZERO_SLOTS = 512;
+
+    // Number of valid items (in both tables)
+    s64 Count = 0;
+
+    table_t Current;  // New entries go here
+    table_t Old;      // Not allocated unless we are growing. Slots before _Migrated_ were moved to _Current_.
+    s64 Migrated = 0;
+
+    table_t Next;  // Allocated before we grow, hashes (and bits of _Occupied_) before _Zeroed_ are zeroed
+    s64 Zeroed = 0;
+
+    incremental_hash_table() {}
+
+    //
+    // Iterator: the entries in _Current_ and then the ones in _Old_ which weren't moved yet.
+    //
+    template <bool Const>
+    struct iterator_ {
+        using incremental_hash_table_t = types::select_t<Const, const incremental_hash_table, incremental_hash_table>;
+        using inner_table_t = types::select_t<Const, const table_t, table_t>;
+
+        incremental_hash_table_t *Parent;
+        s64 Index;  // Slots of _Current_ first, then of _Old_
+
+        iterator_(incremental_hash_table_t *parent, s64 index = 0) : Parent(parent), Index(index) {
+            assert(parent);
+
+            // Find the first pair
+            skip_empty_slots();
+        }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_empty_slots();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        key_value_pair<inner_table_t> operator*() {
+            s64 current = Parent->Current.Allocated;
+            if (Index < current) return {Parent->Current.Keys + Index, Parent->Current.Values + Index};
+            return {Parent->Old.Keys + (Index - current), Parent->Old.Values + (Index - current)};
+        }
+
+       private:
+        void skip_empty_slots() {
+            s64 current = Parent->Current.Allocated;
+            if (Index < current) {
+                Index = hash_table_next_filled(Parent->Current, Index);
+                if (Index < current) return;
+            }
+
+            // Moved slots are skipped as well
+            Index = max(Index, current + Parent->Migrated);
+            if (Index < current + Parent->Old.Allocated) Index = current + hash_table_next_filled(Parent->Old, Index - current);
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(this, Current.Allocated + Old.Allocated); }
+    const_iterator begin() const { return const_iterator(this); }
+    const_iterator end() const { return const_iterator(this, Current.Allocated + Old.Allocated); }
+
+    //
+    // Operators:
+    //
+
+    // Returns a pointer to the value associated with _key_.
+    // If the key doesn't exist, this adds a new element and returns it.
+    V *operator[](const K &key) {
+        auto [kp, vp] = find(*this, key);
+        if (vp) return vp;
+        return add(*this, key, V()).Value;
+    }
+};
+
+template <typename T>
+struct is_incremental_hash_table : types::false_t {};
+
+template <typename K, typename V, bool BlockAlloc, typename Hash, typename Equal>
+struct is_incremental_hash_table<incremental_hash_table<K, V, BlockAlloc, Hash, Equal>> : types::true_t {};
+
+template <typename T>
+concept any_incremental_hash_table = is_incremental_hash_table<T>::value;
+
+// Moves up to _slots_ slots of the old arrays to the new ones. Returns true if there is nothing left to move (the old
+// arrays are freed then). Called by add() and remove(), call it yourself to finish growing sooner.
+template <any_incremental_hash_table T>
+bool migrate(T &table, s64 slots = T::MIGRATE_SLOTS) {
+    auto &old = table.Old;
+    if (!old.Allocated) return true;
+
+    s64 end = min(table.Migrated + slots, old.Allocated);
+    For(range(table.Migrated, end)) {
+        // Shallow copies, like when a hash_table rehashes. The old slots are left as they are, see remove_prehashed().
+        u64 hash = old.Hashes[it];
+        if (hash >= old.FIRST_VALID_HASH) add_prehashed(table.Current, hash, old.Keys[it], old.Values[it]);
+    }
+    table.Migrated = end;
+
+    if (end < old.Allocated) return false;
+
+    free(old);
+    table.Migrated = 0;
+    return true;
+}
+
+// Makes sure the table has space for at least _target_ more elements. Unlike growing on add, this moves every
+// entry at once (when there are any), it's what you call up front when you know the size.
+template <any_incremental_hash_table T>
+void reserve(T &table, s64 target, u32 alignment = 0) {
+    while (!migrate(table, table.Old.Allocated)) {
+    }
+    reserve(table.Current, target, alignment);
+
+    // May be too small now
+    free(table.Next);
+    table.Zeroed = 0;
+}
+
+// Free any memory allocated by this object and reset count
+template <any_incremental_hash_table T>
+void free(T &table) {
+    free(table.Current);
+    free(table.Old);
+    free(table.Next);
+    table.Migrated = table.Zeroed = 0;
+    table.Count = 0;
+}
+
+// Looks for key in the new arrays and, while growing, in the old ones.
+// _key_ can also be of another type the table can be looked up with (see hash_table_lookup_key).
+template <any_incremental_hash_table T, typename Q>
+requires(types::is_same<Q, typename T::K> || hash_table_lookup_key<typename T::table_t, Q>)
+key_value_pair<typename T::table_t> find_prehashed(const T &table, u64 hash, const Q &key) {
+    auto result = find_prehashed(table.Current, hash, key);
+    if (result.Key || !table.Old.Allocated) return result;
+
+    // Slots before _Migrated_ are also in _Current_, so a key found there would've been found above
+    return find_prehashed(table.Old, hash, key);
+}
+
+// We calculate the hash of the key with the table's _Hash_.
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> find(const T &table, const typename T::K &key) {
+    return find_prehashed(table, hash_table_hash(table.Current, key), key);
+}
+
+template <any_incremental_hash_table T, typename Q>
+requires(hash_table_lookup_key<typename T::table_t, Q>) key_value_pair<typename T::table_t> find(const T &table, const Q &key) {
+    return find_prehashed(table, hash_table_hash(table.Current, key), key);
+}
+
+// Adds key and value using the given hash. Returns pointers to the added key and value.
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> add_prehashed(T &table, u64 hash, const typename T::K &key, const typename T::V &value) {
+    auto &current = table.Current;
+    auto &next = table.Next;
+
+    if (current.Allocated && !next.Allocated && (current.SlotsFilled + 1) * 16 >= current.Allocated * 7) {
+        hash_table_allocate(next, current.Allocated * 2, allocation_get_alignment(current.Hashes), allocation_get_allocator(current.Hashes));
+        table.Zeroed = 0;
+    }
+
+    if (next.Allocated && table.Zeroed < next.Allocated) {
+        // Finish it if this add is the one which needs it
+        bool full = (current.SlotsFilled + 1) * 2 >= current.Allocated;
+
+        s64 end = full ? next.Allocated : min(table.Zeroed + T::ZERO_SLOTS, next.Allocated);
+        zero_memory(next.Hashes + table.Zeroed, (end - table.Zeroed) * sizeof(u64));
+
+        s64 words = hash_table_occupied_words(end) - table.Zeroed / 64;
+        zero_memory(next.Occupied + table.Zeroed / 64, words * sizeof(u64));
+        table.Zeroed = end;
+    }
+
+    // The same condition on which hash_table grows (it's never more than 50% full), but we do it before it can
+    if (current.Allocated && (current.SlotsFilled + 1) * 2 >= current.Allocated) {
+        // Only if someone reserved less than what was already there, the adds don't outrun migrate()
+        while (!migrate(table, table.Old.Allocated)) {
+        }
+
+        table.Old = current;
+        table.Current = next;
+        table.Next = typename T::table_t();
+        table.Migrated = table.Zeroed = 0;
+    }
+
+    migrate(table);
+
+    ++table.Count;
+    return add_prehashed(table.Current, hash, key, value);
+}
+
+// We calculate the hash of the key with the table's _Hash_.
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> add(T &table, const typename T::K &key, const typename T::V &value) {
+    return add_prehashed(table, hash_table_hash(table.Current, key), key, value);
+}
+
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> add(T &table, const typename T::K &key) { return add(table, key, typename T::V()); }
+
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> set_prehashed(T &table, u64 hash, const typename T::K &key, const typename T::V &value) {
+    auto [kp, vp] = find_prehashed(table, hash, key);
+    if (vp) {
+        *vp = value;
+        return {kp, vp};
+    }
+    return add_prehashed(table, hash, key, value);
+}
+
+// We calculate the hash of the key with the table's _Hash_.
+template <any_incremental_hash_table T>
+key_value_pair<typename T::table_t> set(T &table, const typename T::K &key, const typename T::V &value) {
+    return set_prehashed(table, hash_table_hash(table.Current, key), key, value);
+}
+
+// Returns true if the key was found and removed.
+//
+// Entries in the old arrays aren't removed by shifting the next ones back (like hash_table does), that could move
+// an entry which wasn't moved yet before _Migrated_. We leave a tombstone (a hash of 1, which hash_table's lookups
+// probe past and migrate() skips). A key which was already moved has a stale copy there, it gets one too,
+// otherwise find() would see it after the key is removed from _Current_.
+template <any_incremental_hash_table T>
+bool remove_prehashed(T &table, u64 hash, const typename T::K &key) {
+    using K = typename T::K;
+    using V = typename T::V;
+
+    migrate(table);
+
+    bool removed = remove_prehashed(table.Current, hash, key);
+
+    if (table.Old.Allocated) {
+        auto [kp, vp] = find_prehashed(table.Old, hash, key);
+        if (kp) {
+            s64 index = kp - table.Old.Keys;
+            if (index < table.Migrated) {
+                table.Old.Hashes[index] = 1;  // The copy of what we just removed from _Current_
+            } else if (!removed) {
+                kp->~K();
+                vp->~V();
+                table.Old.Hashes[index] = 1;
+                removed = true;
+            }
+            table.Old.Occupied[index / 64] &= ~(1ull << (index % 64));
+        }
+    }
+
+    if (removed) --table.Count;
+    return removed;
+}
+
+// We calculate the hash of the key with the table's _Hash_.
+template <any_incremental_hash_table T>
+bool remove(T &table, const typename T::K &key) {
+    return remove_prehashed(table, hash_table_hash(table.Current, key), key);
+}
+
+template <any_incremental_hash_table T>
+bool has(const T &table, const typename T::K &key) { return find(table, key).Key != null; }
+
+template <any_incremental_hash_table T, typename Q>
+requires(hash_table_lookup_key<typename T::table_t, Q>) bool has(const T &table, const Q &key) { return find(table, key).Key != null; }
+
+template <any_incremental_hash_table T>
+bool has_prehashed(const T &table, u64 hash, const typename T::K &key) { return find_prehashed(table, hash, key).Key != null; }
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "hash_table.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// The key which marks empty slots unless you pick one: all bits set, null for pointers
+template <typename K>
+constexpr K int_hash_table_default_empty() {
+    if constexpr (types::is_pointer<K>) {
+        return null;
+    } else {
+        return (K) -1;
+    }
+}
+
+// A hash table for integer, enum and pointer keys (ids, handles, addresses) with the same API as hash_table
+// (find, add, set, remove, has, reserve, free, reset and for loops) minus the _prehashed variants.
+//
+// hash_table keeps a 64 bit hash for every slot in its own array, for a u64 key that's twice the memory of the keys
+// and a lookup touches two arrays (the hashes and then the keys). Here the keys are hashed again on every probe
+// (hash_u64, a couple of instructions) and a slot is marked empty with a key nobody uses, _EMPTY_ (all bits set
+// by default, null for pointers). The key and the value are stored next to each other, so a lookup usually takes
+// one cache miss.
+//
+// Don't add _EMPTY_ as a key, pick another one with the template argument if you need it.
+//
+// Collisions are probed linearly and removes shift the following entries back (like hash_table), so there are
+// no tombstones. The table grows when it's 3/4 full.
+template <typename K_, typename V_, K_ Empty = int_hash_table_default_empty<K_>()>
+requires(types::is_integral<K_> || types::is_enum<K_> || types::is_pointer<K_>) struct int_hash_table {
+    using K = K_;
+    using V = V_;
+
+    static constexpr K EMPTY = Empty;
+    static constexpr s64 MINIMUM_SIZE = 16;
+
+    struct slot {
+        K Key;
+        V Value;
+    };
+
+    // Pointers to the key and value in a slot, what find() and add() return (like key_value_pair for hash_table)
+    struct entry {
+        K *Key;
+        V *Value;
+    };
+
+    // Number of valid items
+    s64 Count = 0;
+
+    // Number of slots allocated (a power of 2)
+    s64 Allocated = 0;
+
+    slot *Slots = null;
+
+    int_hash_table() {}
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        using int_hash_table_t = types::select_t<Const, const int_hash_table, int_hash_table>;
+
+        int_hash_table_t *Parent;
+        s64 Index;
+
+        iterator_(int_hash_table_t *parent, s64 index = 0) : Parent(parent), Index(index) {
+            assert(parent);
+
+            // Find the first pair
+            skip_empty_slots();
+        }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_empty_slots();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        entry operator*() {
+            auto *s = Parent->Slots + Index;
+            return {&s->Key, &s->Value};
+        }
+
+       private:
+        void skip_empty_slots() {
+            for (; Index < Parent->Allocated; ++Index) {
+                if (Parent->Slots[Index].Key != EMPTY) break;
+            }
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(this, Allocated); }
+    const_iterator begin() const { return const_iterator(this); }
+    const_iterator end() const { return const_iterator(this, Allocated); }
+
+    //
+    // Operators:
+    //
+
+    // Returns a pointer to the value associated with _key_.
+    // If the key doesn't exist, this adds a new element and returns it.
+    V *operator[](K key) {
+        auto [kp, vp] = find(*this, key);
+        if (vp) return vp;
+        return add(*this, key, V()).Value;
+    }
+};
+
+template <typename T>
+struct is_int_hash_table : types::false_t {};
+
+template <typename K, typename V, K Empty>
+struct is_int_hash_table<int_hash_table<K, V, Empty>> : types::true_t {};
+
+template <typename T>
+concept any_int_hash_table = is_int_hash_table<T>::value;
+
+// The slot _key_ maps to
+template <any_int_hash_table T>
+always_inline s64 int_hash_table_home(const T &table, typename T::K key) {
+    return (s64) (hash_u64((u64) key) & (u64) (table.Allocated - 1));
+}
+
+// Makes sure the table has space for at least _target_ more elements without growing.
+// Reserves the next power of 2 slots which keeps it at most 3/4 full, starting at _MINIMUM_SIZE_.
+//
+// Allocates with the Context's allocator. The old entries are moved (byte by byte, see the type policy in context.h).
+template <any_int_hash_table T>
+void reserve(T &table, s64 target, u32 alignment = 0) {
+    using slot = typename T::slot;
+
+    if ((table.Count + target) * 4 <= table.Allocated * 3) return;
+
+    s64 newAllocated = max<s64>(ceil_pow_of_2((table.Count + target) * 4 / 3 + 1), table.MINIMUM_SIZE);
+
+    if (table.Allocated) {
+        u32 oldAlignment = allocation_get_alignment(table.Slots);
+        if (alignment == 0) {
+            alignment = oldAlignment;
+        } else {
+            assert(alignment == oldAlignment && "Reserving with an alignment but the object already has arrays with a different alignment. Specify alignment 0 to automatically use the old one.");
+        }
+    }
+
+    slot *oldSlots = table.Slots;
+    s64 oldAllocated = table.Allocated;
+
+    table.Slots = allocate_array<slot>(newAllocated, {.Alignment = alignment});
+    table.Allocated = newAllocated;
+    For(range(newAllocated)) table.Slots[it].Key = table.EMPTY;
+
+    For(range(oldAllocated)) {
+        if (oldSlots[it].Key == table.EMPTY) continue;
+
+        s64 index = int_hash_table_home(table, oldSlots[it].Key);
+        while (table.Slots[index].Key != table.EMPTY) index = (index + 1) & (newAllocated - 1);
+        copy_memory(table.Slots + index, oldSlots + it, sizeof(slot));
+    }
+
+    if (oldAllocated) free(oldSlots);
+}
+
+// Free any memory allocated by this object and reset count
+template <any_int_hash_table T>
+void free(T &table) {
+    if (table.Allocated) free(table.Slots);
+    table.Slots = null;
+    table.Count = table.Allocated = 0;
+}
+
+// Don't free the table, just destroy contents and reset count
+template <any_int_hash_table T>
+void reset(T &table) {
+    using V = typename T::V;
+
+    For(range(table.Allocated)) {
+        auto &s = table.Slots[it];
+        if (s.Key == table.EMPTY) continue;
+
+        s.Value.~V();
+        s.Key = table.EMPTY;
+    }
+    table.Count = 0;
+}
+
+// Looks for _key_, returns null pointers if it's not in the table
+template <any_int_hash_table T>
+typename T::entry find(const T &table, typename T::K key) {
+    if (!table.Count || key == table.EMPTY) return {null, null};
+
+    s64 mask = table.Allocated - 1;
+    s64 index = int_hash_table_home(table, key);
+    while (true) {
+        auto *s = table.Slots + index;
+        if (s->Key == key) return {&s->Key, &s->Value};
+        if (s->Key == table.EMPTY) return {null, null};  // An empty slot ends the run, the key would've been put here
+        index = (index + 1) & mask;
+    }
+}
+
+// Adds key and value to the table. Returns pointers to the added key and value.
+// Like hash_table, this doesn't check if the key is already there (use _set_ for that).
+template <any_int_hash_table T>
+typename T::entry add(T &table, typename T::K key, const typename T::V &value) {
+    assert(key != table.EMPTY && "Can't add the key which marks empty slots (see the template arguments of int_hash_table)");
+
+    if ((table.Count + 1) * 4 > table.Allocated * 3) reserve(table, 1);
+
+    s64 mask = table.Allocated - 1;
+    s64 index = int_hash_table_home(table, key);
+    while (table.Slots[index].Key != table.EMPTY) index = (index + 1) & mask;
+
+    auto *s = table.Slots + index;
+    s->Key = key;
+    new (&s->Value) typename T::V(value);
+    ++table.Count;
+    return {&s->Key, &s->Value};
+}
+
+// Inserts a default constructed value at _key_ and returns pointers to it, see the same function in hash_table.h.
+template <any_int_hash_table T>
+typename T::entry add(T &table, typename T::K key) { return add(table, key, typename T::V()); }
+
+// Adds the key or replaces its value if it's already there
+template <any_int_hash_table T>
+typename T::entry set(T &table, typename T::K key, const typename T::V &value) {
+    auto [kp, vp] = find(table, key);
+    if (vp) {
+        *vp = value;
+        return {kp, vp};
+    }
+    return add(table, key, value);
+}
+
+// Returns true if the key was found and removed.
+// Does the same backward-shift deletion as hash_table (see remove_prehashed() in hash_table.h).
+template <any_int_hash_table T>
+bool remove(T &table, typename T::K key) {
+    using slot = typename T::slot;
+    using V = typename T::V;
+
+    auto [kp, vp] = find(table, key);
+    if (!kp) return false;
+
+    s64 mask = table.Allocated - 1;
+
+    s64 hole = (slot *) kp - table.Slots;  // _Key_ is the first member
+    table.Slots[hole].Value.~V();
+
+    s64 index = (hole + 1) & mask;
+    while (table.Slots[index].Key != table.EMPTY) {
+        s64 ideal = int_hash_table_home(table, table.Slots[index].Key);
+
+        // Moves the entry back if that doesn't put it before its ideal slot
+        if (((hole - ideal) & mask) < ((index - ideal) & mask)) {
+            copy_memory(table.Slots + hole, table.Slots + index, sizeof(slot));
+            hole = index;
+        }
+        index = (index + 1) & mask;
+    }
+
+    table.Slots[hole].Key = table.EMPTY;
+    --table.Count;
+    return true;
+}
+
+// Returns true if the table has the given key.
+template <any_int_hash_table T>
+bool has(const T &table, typename T::K key) { return find(table, key).Key != null; }
+
+template <typename K, typename V, K Empty>
+int_hash_table<K, V, Empty> *clone(int_hash_table<K, V, Empty> *dest, const int_hash_table<K, V, Empty> &src) {
+    free(*dest);
+    for (auto [k, v] : src) add(*dest, *k, *v);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
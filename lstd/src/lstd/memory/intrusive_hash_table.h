@@ -0,0 +1,248 @@
+#pragma once
+
+#include "../memory/allocator.h"
+#include "hash.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// The part of an object which an intrusive_hash_table uses to chain it into a bucket
+template <typename T>
+struct hash_link {
+    T *Next = null;
+    u64 Hash = 0;  // Kept so growing and mismatching entries in a bucket don't hash or compare keys
+};
+
+//
+// A hash table which doesn't own its elements, objects are chained into buckets through a hash_link they contain
+// and the key is one of their members:
+//
+//     struct entity {
+//         u64 Id;
+//         string Name;
+//
+//         hash_link<entity> ByIdLink;
+//         hash_link<entity> ByNameLink;
+//     };
+//
+//     intrusive_hash_table<entity, u64, &entity::Id, &entity::ByIdLink> ById;
+//     intrusive_hash_table<entity, string, &entity::Name, &entity::ByNameLink> ByName;
+//
+//     auto *e = pool_allocate(entityPool);
+//     add(ById, e);
+//     add(ByName, e);
+//
+//     auto *found = find(ByName, "player");
+//
+// The only allocation is the array of bucket heads (8 bytes per bucket), adding and removing objects never allocates,
+// so objects from a pool or an arena can be in as many tables as they have links.
+// hash_table on the other hand copies the keys and values into its own arrays.
+//
+// The table grows (doubles the buckets and relinks every object, without touching the keys) when it has more objects
+// than buckets. Removing an object is O(chain length) since the links are singly linked.
+//
+// Don't change the key of an object while it's in the table, remove it first.
+// Like hash_table, this doesn't check if the key is already there, add() an object with the same key twice
+// and find() returns the last one.
+//
+template <typename T_, typename K_, K_ T_::*Key, hash_link<T_> T_::*Link, typename Hash = key_hash<K_>, typename Equal = key_equal<K_>>
+struct intrusive_hash_table {
+    using T = T_;
+    using K = K_;
+
+    using key_hash_t = Hash;
+    using key_equal_t = Equal;
+
+    static constexpr K T::*KEY = Key;
+    static constexpr hash_link<T> T::*LINK = Link;
+
+    static constexpr s64 MINIMUM_SIZE = 16;
+
+    // Number of objects in the table
+    s64 Count = 0;
+
+    // Number of buckets allocated (a power of 2)
+    s64 Allocated = 0;
+
+    T **Buckets = null;
+
+    intrusive_hash_table() {}
+
+    //
+    // Iterator:
+    //
+    struct iterator {
+        const intrusive_hash_table *Parent;
+        s64 Bucket;
+        T *Current;
+
+        iterator(const intrusive_hash_table *parent, s64 bucket) : Parent(parent), Bucket(bucket), Current(null) {
+            assert(parent);
+            skip_empty_buckets();
+        }
+
+        iterator &operator++() {
+            Current = (Current->*Link).Next;
+            if (!Current) {
+                ++Bucket;
+                skip_empty_buckets();
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return Parent == other.Parent && Bucket == other.Bucket && Current == other.Current; }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+        T *operator*() { return Current; }
+
+       private:
+        void skip_empty_buckets() {
+            for (; Bucket < Parent->Allocated; ++Bucket) {
+                Current = Parent->Buckets[Bucket];
+                if (Current) return;
+            }
+            Current = null;
+        }
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, Allocated); }
+};
+
+template <typename T>
+struct is_intrusive_hash_table : types::false_t {};
+
+template <typename T, typename K, K T::*Key, hash_link<T> T::*Link, typename Hash, typename Equal>
+struct is_intrusive_hash_table<intrusive_hash_table<T, K, Key, Link, Hash, Equal>> : types::true_t {};
+
+template <typename T>
+concept any_intrusive_hash_table = is_intrusive_hash_table<T>::value;
+
+// Types other than the key which the table can be looked up with, see hash_table_lookup_key in hash_table.h
+template <typename T, typename Q>
+concept intrusive_hash_table_lookup_key = !types::is_same<types::remove_cvref_t<Q>, typename T::K> && requires(const typename T::K &key, const Q &q) {
+    typename T::key_hash_t::is_transparent;
+    typename T::key_equal_t::is_transparent;
+    { typename T::key_hash_t{}(q) } -> types::is_convertible<u64>;
+    { typename T::key_equal_t{}(key, q) } -> types::is_convertible<bool>;
+};
+
+// Makes sure the table has at least as many buckets as _target_ objects (on top of the ones already in it), so
+// adding them doesn't grow it. Reserves the next power of 2, starting at _MINIMUM_SIZE_.
+//
+// Allocates with the Context's allocator. The objects are relinked into the new buckets with their stored hashes.
+template <any_intrusive_hash_table T>
+void reserve(T &table, s64 target) {
+    using object_t = typename T::T;
+
+    if (table.Count + target <= table.Allocated) return;
+
+    s64 newAllocated = max<s64>(ceil_pow_of_2(table.Count + target), table.MINIMUM_SIZE);
+
+    object_t **oldBuckets = table.Buckets;
+    s64 oldAllocated = table.Allocated;
+
+    table.Buckets = allocate_array<object_t *>(newAllocated);
+    table.Allocated = newAllocated;
+    zero_memory(table.Buckets, newAllocated * sizeof(object_t *));
+
+    u64 mask = (u64) (newAllocated - 1);
+    For(range(oldAllocated)) {
+        object_t *object = oldBuckets[it];
+        while (object) {
+            auto &link = object->*T::LINK;
+            object_t *next = link.Next;
+
+            object_t **bucket = table.Buckets + (link.Hash & mask);
+            link.Next = *bucket;
+            *bucket = object;
+
+            object = next;
+        }
+    }
+
+    if (oldAllocated) free(oldBuckets);
+}
+
+// Frees the buckets and forgets the objects (they aren't touched)
+template <any_intrusive_hash_table T>
+void free(T &table) {
+    if (table.Allocated) free(table.Buckets);
+    table.Buckets = null;
+    table.Count = table.Allocated = 0;
+}
+
+// Forgets the objects but keeps the buckets
+template <any_intrusive_hash_table T>
+void reset(T &table) {
+    if (table.Allocated) zero_memory(table.Buckets, table.Allocated * sizeof(*table.Buckets));
+    table.Count = 0;
+}
+
+// Adds _object_ to the table, links it through its _Link_ and hashes its _Key_ member.
+template <any_intrusive_hash_table T>
+void add(T &table, typename T::T *object) {
+    if (table.Count + 1 > table.Allocated) reserve(table, 1);
+
+    auto &link = object->*T::LINK;
+    link.Hash = typename T::key_hash_t{}(object->*T::KEY);
+
+    auto **bucket = table.Buckets + (link.Hash & (u64) (table.Allocated - 1));
+    link.Next = *bucket;
+    *bucket = object;
+    ++table.Count;
+}
+
+namespace internal {
+// _key_ is a K or an intrusive_hash_table_lookup_key
+template <any_intrusive_hash_table T, typename Q>
+typename T::T *intrusive_hash_table_find(const T &table, const Q &key) {
+    if (!table.Count) return null;
+
+    u64 hash = typename T::key_hash_t{}(key);
+    typename T::key_equal_t equal;
+
+    auto *object = table.Buckets[hash & (u64) (table.Allocated - 1)];
+    while (object) {
+        auto &link = object->*T::LINK;
+        if (link.Hash == hash && equal(object->*T::KEY, key)) return object;
+        object = link.Next;
+    }
+    return null;
+}
+}  // namespace internal
+
+// Returns the object with _key_ (the one added last if there are many), null if there isn't one
+template <any_intrusive_hash_table T>
+typename T::T *find(const T &table, const typename T::K &key) { return internal::intrusive_hash_table_find(table, key); }
+
+template <any_intrusive_hash_table T, typename Q>
+requires(intrusive_hash_table_lookup_key<T, Q>) typename T::T *find(const T &table, const Q &key) {
+    return internal::intrusive_hash_table_find(table, key);
+}
+
+template <any_intrusive_hash_table T>
+bool has(const T &table, const typename T::K &key) { return find(table, key) != null; }
+
+template <any_intrusive_hash_table T, typename Q>
+requires(intrusive_hash_table_lookup_key<T, Q>) bool has(const T &table, const Q &key) {
+    return find(table, key) != null;
+}
+
+// Unlinks _object_ (not just any object with the same key). Returns false if it's not in the table.
+template <any_intrusive_hash_table T>
+bool remove(T &table, typename T::T *object) {
+    if (!table.Count) return false;
+
+    auto &link = object->*T::LINK;
+
+    auto **p = table.Buckets + (link.Hash & (u64) (table.Allocated - 1));
+    while (*p && *p != object) p = &((*p)->*T::LINK).Next;
+    if (!*p) return false;
+
+    *p = link.Next;
+    link.Next = null;
+    --table.Count;
+    return true;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "../internal/common.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Lists which don't own their elements, the links live in the objects themselves:
+//
+//     struct entity {
+//         ...
+//         list_link<entity> AllLink;
+//         list_link<entity> DirtyLink;
+//     };
+//
+//     intrusive_list<entity, &entity::AllLink> All;
+//     intrusive_list<entity, &entity::DirtyLink> Dirty;
+//
+//     auto *e = pool_allocate(entityPool);
+//     push_back(All, e);
+//     push_back(Dirty, e);  // The same object in two lists, no allocations at all
+//
+// An object can be in as many lists as it has links, but only in one list per link.
+// The lists never allocate or free, the caller makes sure objects outlive the lists they are in.
+//
+// intrusive_slist is singly linked (a stack): push and pop at the front are O(1), removing anything else walks
+// the list. intrusive_list is doubly linked, so removing any object is O(1).
+//
+// Iterating yields pointers to the objects. Don't remove the object the iterator is on (the loop reads its link
+// to get to the next one), use remove_if() for that.
+//
+
+template <typename T>
+struct slist_link {
+    T *Next = null;
+};
+
+template <typename T>
+struct list_link {
+    T *Prev = null, *Next = null;
+};
+
+template <typename T_, slist_link<T_> T_::*Link>
+struct intrusive_slist {
+    using T = T_;
+
+    T *Head = null;
+    s64 Count = 0;
+
+    intrusive_slist() {}
+
+    //
+    // Iterator:
+    //
+    struct iterator {
+        T *Current;
+
+        iterator &operator++() {
+            Current = (Current->*Link).Next;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return Current == other.Current; }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+        T *operator*() { return Current; }
+    };
+
+    iterator begin() const { return {Head}; }
+    iterator end() const { return {null}; }
+};
+
+template <typename T_, list_link<T_> T_::*Link>
+struct intrusive_list {
+    using T = T_;
+
+    T *Head = null;
+    T *Tail = null;
+    s64 Count = 0;
+
+    intrusive_list() {}
+
+    //
+    // Iterator:
+    //
+    struct iterator {
+        T *Current;
+
+        iterator &operator++() {
+            Current = (Current->*Link).Next;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return Current == other.Current; }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+        T *operator*() { return Current; }
+    };
+
+    iterator begin() const { return {Head}; }
+    iterator end() const { return {null}; }
+};
+
+template <typename T>
+struct is_intrusive_slist : types::false_t {};
+
+template <typename T, slist_link<T> T::*Link>
+struct is_intrusive_slist<intrusive_slist<T, Link>> : types::true_t {};
+
+template <typename T>
+concept any_intrusive_slist = is_intrusive_slist<T>::value;
+
+template <typename T>
+struct is_intrusive_list : types::false_t {};
+
+template <typename T, list_link<T> T::*Link>
+struct is_intrusive_list<intrusive_list<T, Link>> : types::true_t {};
+
+template <typename T>
+concept any_intrusive_list = is_intrusive_list<T>::value;
+
+//
+// intrusive_slist:
+//
+
+template <typename T, slist_link<T> T::*Link>
+void push_front(intrusive_slist<T, Link> &list, T *object) {
+    (object->*Link).Next = list.Head;
+    list.Head = object;
+    ++list.Count;
+}
+
+// Returns null if the list is empty
+template <typename T, slist_link<T> T::*Link>
+T *pop_front(intrusive_slist<T, Link> &list) {
+    T *object = list.Head;
+    if (!object) return null;
+
+    list.Head = (object->*Link).Next;
+    (object->*Link).Next = null;
+    --list.Count;
+    return object;
+}
+
+// O(n), walks the list to find the link which points to _object_. Returns false if it's not in the list.
+template <typename T, slist_link<T> T::*Link>
+bool remove(intrusive_slist<T, Link> &list, T *object) {
+    T **p = &list.Head;
+    while (*p && *p != object) p = &((*p)->*Link).Next;
+    if (!*p) return false;
+
+    *p = (object->*Link).Next;
+    (object->*Link).Next = null;
+    --list.Count;
+    return true;
+}
+
+// Unlinks every object for which _predicate_ returns true, in one pass. Returns how many were removed.
+template <typename T, slist_link<T> T::*Link, typename Predicate>
+s64 remove_if(intrusive_slist<T, Link> &list, Predicate predicate) {
+    s64 removed = 0;
+
+    T **p = &list.Head;
+    while (*p) {
+        T *object = *p;
+        if (predicate(object)) {
+            *p = (object->*Link).Next;
+            (object->*Link).Next = null;
+            ++removed;
+        } else {
+            p = &(object->*Link).Next;
+        }
+    }
+    list.Count -= removed;
+    return removed;
+}
+
+// Forgets all objects, doesn't touch their links
+template <typename T, slist_link<T> T::*Link>
+void reset(intrusive_slist<T, Link> &list) {
+    list.Head = null;
+    list.Count = 0;
+}
+
+//
+// intrusive_list:
+//
+
+template <typename T, list_link<T> T::*Link>
+void push_front(intrusive_list<T, Link> &list, T *object) {
+    auto &link = object->*Link;
+    link.Prev = null;
+    link.Next = list.Head;
+
+    if (list.Head) {
+        (list.Head->*Link).Prev = object;
+    } else {
+        list.Tail = object;
+    }
+    list.Head = object;
+    ++list.Count;
+}
+
+template <typename T, list_link<T> T::*Link>
+void push_back(intrusive_list<T, Link> &list, T *object) {
+    auto &link = object->*Link;
+    link.Prev = list.Tail;
+    link.Next = null;
+
+    if (list.Tail) {
+        (list.Tail->*Link).Next = object;
+    } else {
+        list.Head = object;
+    }
+    list.Tail = object;
+    ++list.Count;
+}
+
+// Links _object_ right after _after_ (which must be in the list)
+template <typename T, list_link<T> T::*Link>
+void insert_after(intrusive_list<T, Link> &list, T *after, T *object) {
+    auto &link = object->*Link;
+    auto &afterLink = after->*Link;
+
+    link.Prev = after;
+    link.Next = afterLink.Next;
+
+    if (afterLink.Next) {
+        (afterLink.Next->*Link).Prev = object;
+    } else {
+        list.Tail = object;
+    }
+    afterLink.Next = object;
+    ++list.Count;
+}
+
+// O(1). _object_ must be in this list.
+template <typename T, list_link<T> T::*Link>
+void remove(intrusive_list<T, Link> &list, T *object) {
+    auto &link = object->*Link;
+
+    if (link.Prev) {
+        (link.Prev->*Link).Next = link.Next;
+    } else {
+        assert(list.Head == object && "Object isn't in this list");
+        list.Head = link.Next;
+    }
+
+    if (link.Next) {
+        (link.Next->*Link).Prev = link.Prev;
+    } else {
+        list.Tail = link.Prev;
+    }
+
+    link.Prev = link.Next = null;
+    --list.Count;
+}
+
+// Returns null if the list is empty
+template <typename T, list_link<T> T::*Link>
+T *pop_front(intrusive_list<T, Link> &list) {
+    T *object = list.Head;
+    if (object) remove(list, object);
+    return object;
+}
+
+// Returns null if the list is empty
+template <typename T, list_link<T> T::*Link>
+T *pop_back(intrusive_list<T, Link> &list) {
+    T *object = list.Tail;
+    if (object) remove(list, object);
+    return object;
+}
+
+// Unlinks every object for which _predicate_ returns true, in one pass. Returns how many were removed.
+template <typename T, list_link<T> T::*Link, typename Predicate>
+s64 remove_if(intrusive_list<T, Link> &list, Predicate predicate) {
+    s64 removed = 0;
+
+    T *object = list.Head;
+    while (object) {
+        T *next = (object->*Link).Next;
+        if (predicate(object)) {
+            remove(list, object);
+            ++removed;
+        }
+        object = next;
+    }
+    return removed;
+}
+
+// Forgets all objects, doesn't touch their links
+template <typename T, list_link<T> T::*Link>
+void reset(intrusive_list<T, Link> &list) {
+    list.Head = list.Tail = null;
+    list.Count = 0;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "../internal/common.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Bounded queues for passing messages between threads without locks.
+//
+// Both store _Capacity_ elements inside the object (so big queues should be allocated, not put on the stack),
+// the capacity must be a power of two. Elements are copied in and out with operator=.
+//
+// try_push() returns false if the queue is full and try_pop() returns false if it's empty, none of the functions block.
+// The batch variants push/pop as many elements as they can and return how many that was.
+//
+// The members written by different threads are on different cache lines, so producers and consumers don't
+// invalidate each other's caches on every operation.
+//
+
+// Single producer, single consumer. Exactly one thread may push and exactly one (other) thread may pop.
+// Both sides are wait-free.
+template <typename T_, s64 Capacity>
+struct spsc_queue {
+    using T = T_;
+
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static constexpr s64 CAPACITY = Capacity;
+
+    // Touched by the consumer. Positions only grow, we mask them when indexing.
+    alignas(64) s64 Head = 0;
+    s64 CachedTail = 0;  // The last _Tail_ the consumer saw, so it doesn't read the producer's cache line on every pop
+
+    // Touched by the producer
+    alignas(64) s64 Tail = 0;
+    s64 CachedHead = 0;
+
+    alignas(64) T Data[Capacity];
+
+    spsc_queue() {}
+};
+
+template <typename T>
+struct is_spsc_queue : types::false_t {};
+
+template <typename T, s64 Capacity>
+struct is_spsc_queue<spsc_queue<T, Capacity>> : types::true_t {};
+
+template <typename T>
+concept any_spsc_queue = is_spsc_queue<T>::value;
+
+// Call only from the producer thread.
+template <any_spsc_queue Q>
+s64 try_push_batch(Q &q, const typename Q::T *elements, s64 n) {
+    s64 tail = q.Tail;
+
+    s64 space = Q::CAPACITY - (tail - q.CachedHead);
+    if (space < n) {
+        q.CachedHead = atomic_load(&q.Head);
+        space = Q::CAPACITY - (tail - q.CachedHead);
+    }
+
+    n = min(n, space);
+    For(range(n)) q.Data[(tail + it) & (Q::CAPACITY - 1)] = elements[it];
+
+    if (n) atomic_store(&q.Tail, tail + n);  // Publishes the elements
+    return n;
+}
+
+// Call only from the producer thread.
+template <any_spsc_queue Q>
+bool try_push(Q &q, const typename Q::T &element) { return try_push_batch(q, &element, 1) == 1; }
+
+// Call only from the consumer thread.
+template <any_spsc_queue Q>
+s64 try_pop_batch(Q &q, typename Q::T *out, s64 n) {
+    s64 head = q.Head;
+
+    s64 available = q.CachedTail - head;
+    if (available < n) {
+        q.CachedTail = atomic_load(&q.Tail);
+        available = q.CachedTail - head;
+    }
+
+    n = min(n, available);
+    For(range(n)) out[it] = q.Data[(head + it) & (Q::CAPACITY - 1)];
+
+    if (n) atomic_store(&q.Head, head + n);  // Gives the slots back to the producer
+    return n;
+}
+
+// Call only from the consumer thread.
+template <any_spsc_queue Q>
+bool try_pop(Q &q, typename Q::T *out) { return try_pop_batch(q, out, 1) == 1; }
+
+// Multiple producers, multiple consumers (Dmitry Vyukov's bounded queue).
+//
+// Each cell has a sequence number which tells which "lap" around the buffer it is on, a producer
+// claims a position with a CAS on _EnqueuePos_ only when the cell at it is free for that lap (and the same
+// for consumers). So threads only contend on the position counters, never on a lock.
+template <typename T_, s64 Capacity>
+struct mpmc_queue {
+    using T = T_;
+
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static constexpr s64 CAPACITY = Capacity;
+
+    struct cell {
+        s64 Sequence;
+        T Data;
+    };
+
+    alignas(64) cell Cells[Capacity];
+
+    alignas(64) s64 EnqueuePos = 0;
+    alignas(64) s64 DequeuePos = 0;
+
+    mpmc_queue() {
+        For(range(Capacity)) Cells[it].Sequence = it;
+    }
+};
+
+template <typename T>
+struct is_mpmc_queue : types::false_t {};
+
+template <typename T, s64 Capacity>
+struct is_mpmc_queue<mpmc_queue<T, Capacity>> : types::true_t {};
+
+template <typename T>
+concept any_mpmc_queue = is_mpmc_queue<T>::value;
+
+template <any_mpmc_queue Q>
+bool try_push(Q &q, const typename Q::T &element) {
+    s64 pos = atomic_load(&q.EnqueuePos);
+
+    typename Q::cell *c;
+    while (true) {
+        c = &q.Cells[pos & (Q::CAPACITY - 1)];
+
+        s64 diff = atomic_load(&c->Sequence) - pos;
+        if (diff == 0) {
+            // The cell is free, try to claim the position
+            s64 old = atomic_compare_and_swap(&q.EnqueuePos, pos + 1, pos);
+            if (old == pos) break;
+            pos = old;
+        } else if (diff < 0) {
+            return false;  // Full, the cell still holds an element from the previous lap
+        } else {
+            pos = atomic_load(&q.EnqueuePos);  // Another producer got here first
+        }
+    }
+
+    c->Data = element;
+    atomic_store(&c->Sequence, pos + 1);  // Hands the cell to the consumers
+    return true;
+}
+
+template <any_mpmc_queue Q>
+bool try_pop(Q &q, typename Q::T *out) {
+    s64 pos = atomic_load(&q.DequeuePos);
+
+    typename Q::cell *c;
+    while (true) {
+        c = &q.Cells[pos & (Q::CAPACITY - 1)];
+
+        s64 diff = atomic_load(&c->Sequence) - (pos + 1);
+        if (diff == 0) {
+            s64 old = atomic_compare_and_swap(&q.DequeuePos, pos + 1, pos);
+            if (old == pos) break;
+            pos = old;
+        } else if (diff < 0) {
+            return false;  // Empty
+        } else {
+            pos = atomic_load(&q.DequeuePos);
+        }
+    }
+
+    *out = c->Data;
+    atomic_store(&c->Sequence, pos + Q::CAPACITY);  // Frees the cell for the next lap
+    return true;
+}
+
+template <any_mpmc_queue Q>
+s64 try_push_batch(Q &q, const typename Q::T *elements, s64 n) {
+    s64 pushed = 0;
+    while (pushed < n && try_push(q, elements[pushed])) ++pushed;
+    return pushed;
+}
+
+template <any_mpmc_queue Q>
+s64 try_pop_batch(Q &q, typename Q::T *out, s64 n) {
+    s64 popped = 0;
+    while (popped < n && try_pop(q, out + popped)) ++popped;
+    return popped;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,535 @@
+#pragma once
+
+#include "../thread.h"
+#include "array.h"
+#include "delegate.h"
+#include "hash_table.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Caches which throw out what wasn't used for the longest time when they get full:
+//
+//     lru_cache<string, texture> textures;
+//     textures.MaxBytes = 512_MiB;
+//     textures.Evicted = &free_texture;  // void free_texture(string &path, texture &t)
+//
+//     auto *t = get(textures, path);
+//     if (!t) t = put(textures, path, load_texture(path), bytes);
+//
+// The cache is full when it has more than _MaxCount_ entries or their sizes (what you pass to put(), e.g. the bytes of
+// a decoded asset) add up to more than _MaxBytes_, 0 means no limit. put() evicts until it isn't full anymore, except
+// for the entry it just added (so one which is bigger than the whole budget still goes in, alone).
+//
+// The caches don't own their keys and values (like hash_table), _Evicted_ is called with every entry which put() pushes
+// out (or replaces, putting a key which is there evicts the old entry) so you can free them. remove() and free() don't call it.
+//
+// lru_cache evicts the least recently used entry. Every hit links its entry at the front of a list, which writes
+// a few nodes. clock_cache approximates that with a bit per entry: a hit only sets the bit (and doesn't write at all
+// if it's already set), eviction sweeps the entries in a circle giving the ones with the bit a second chance.
+// Hits are cheaper and can run at the same time (see sharded_cache), the price is a coarser idea of recency.
+//
+// get(), put(), remove() and evict() are O(1) (a sweep of clock_cache is O(1) amortized).
+// Pointers returned by get() and put() are valid until the next put().
+//
+
+template <typename K_, typename V_>
+struct lru_cache {
+    using K = K_;
+    using V = V_;
+
+    static constexpr u32 NO_NODE = (u32) -1;
+
+    // A hit can't run alongside other hits (see sharded_cache)
+    static constexpr bool SHARED_HITS = false;
+
+    struct node {
+        K Key;
+        V Value;
+        s64 Bytes;
+        u32 Prev, Next;  // Next links the free list when the node isn't used
+    };
+
+    array<node> Nodes;
+    hash_table<K, u32> Index;
+
+    u32 Head = NO_NODE;  // Most recently used
+    u32 Tail = NO_NODE;  // Least recently used, the next one to go
+    u32 FreeHead = NO_NODE;
+
+    s64 Count = 0;
+    s64 Bytes = 0;
+
+    s64 MaxCount = 0;
+    s64 MaxBytes = 0;
+    delegate<void(K &key, V &value)> Evicted;
+
+    lru_cache() {}
+};
+
+template <typename K_, typename V_>
+struct clock_cache {
+    using K = K_;
+    using V = V_;
+
+    static constexpr u32 NO_SLOT = (u32) -1;
+
+    // get() only sets _Referenced_ (atomically), so hits can run under a shared lock
+    static constexpr bool SHARED_HITS = true;
+
+    struct slot {
+        K Key;
+        V Value;
+        s64 Bytes;
+        s32 Referenced;
+        bool Used;
+        u32 NextFree;
+    };
+
+    array<slot> Slots;
+    hash_table<K, u32> Index;
+
+    u32 Hand = 0;  // Where the next sweep starts
+    u32 FreeHead = NO_SLOT;
+
+    s64 Count = 0;
+    s64 Bytes = 0;
+
+    s64 MaxCount = 0;
+    s64 MaxBytes = 0;
+    delegate<void(K &key, V &value)> Evicted;
+
+    clock_cache() {}
+};
+
+template <typename T>
+struct is_lru_cache : types::false_t {};
+
+template <typename K, typename V>
+struct is_lru_cache<lru_cache<K, V>> : types::true_t {};
+
+template <typename T>
+concept any_lru_cache = is_lru_cache<T>::value;
+
+template <typename T>
+struct is_clock_cache : types::false_t {};
+
+template <typename K, typename V>
+struct is_clock_cache<clock_cache<K, V>> : types::true_t {};
+
+template <typename T>
+concept any_clock_cache = is_clock_cache<T>::value;
+
+template <typename T>
+concept any_cache = any_lru_cache<T> || any_clock_cache<T>;
+
+template <any_cache T>
+bool cache_is_full(const T &cache) {
+    return (cache.MaxCount && cache.Count > cache.MaxCount) || (cache.MaxBytes && cache.Bytes > cache.MaxBytes);
+}
+
+//
+// lru_cache:
+//
+
+template <any_lru_cache T>
+void lru_cache_unlink(T &cache, u32 index) {
+    auto &n = cache.Nodes[index];
+    if (n.Prev != T::NO_NODE) {
+        cache.Nodes[n.Prev].Next = n.Next;
+    } else {
+        cache.Head = n.Next;
+    }
+    if (n.Next != T::NO_NODE) {
+        cache.Nodes[n.Next].Prev = n.Prev;
+    } else {
+        cache.Tail = n.Prev;
+    }
+}
+
+template <any_lru_cache T>
+void lru_cache_link_front(T &cache, u32 index) {
+    auto &n = cache.Nodes[index];
+    n.Prev = T::NO_NODE;
+    n.Next = cache.Head;
+    if (cache.Head != T::NO_NODE) cache.Nodes[cache.Head].Prev = index;
+    cache.Head = index;
+    if (cache.Tail == T::NO_NODE) cache.Tail = index;
+}
+
+// Unlinks the node and puts it on the free list, the key and value are left to the caller
+template <any_lru_cache T>
+void lru_cache_release(T &cache, u32 index) {
+    auto &n = cache.Nodes[index];
+    lru_cache_unlink(cache, index);
+    remove(cache.Index, n.Key);
+
+    cache.Bytes -= n.Bytes;
+    --cache.Count;
+
+    n.Next = cache.FreeHead;
+    cache.FreeHead = index;
+}
+
+// Returns the value of _key_ and marks it as the most recently used, null if it's not in the cache
+template <any_lru_cache T>
+typename T::V *get(T &cache, const typename T::K &key) {
+    auto *index = find(cache.Index, key).Value;
+    if (!index) return null;
+
+    if (cache.Head != *index) {
+        lru_cache_unlink(cache, *index);
+        lru_cache_link_front(cache, *index);
+    }
+    return &cache.Nodes[*index].Value;
+}
+
+// Evicts the least recently used entry (calls _Evicted_). Returns false if the cache is empty.
+template <any_lru_cache T>
+bool evict(T &cache) {
+    if (cache.Tail == T::NO_NODE) return false;
+
+    u32 index = cache.Tail;
+    lru_cache_release(cache, index);
+
+    auto &n = cache.Nodes[index];
+    if (cache.Evicted) cache.Evicted(n.Key, n.Value);
+    return true;
+}
+
+// Adds _key_ as the most recently used entry (an entry which is already there for it is evicted first),
+// then evicts until the cache isn't full.
+// _bytes_ is what the entry counts against _MaxBytes_.
+template <any_lru_cache T>
+typename T::V *put(T &cache, const typename T::K &key, const typename T::V &value, s64 bytes = 0) {
+    using K = typename T::K;
+    using V = typename T::V;
+
+    // The old entry goes out whole (key and value), so _Evicted_ can free both
+    if (auto *existing = find(cache.Index, key).Value) {
+        u32 old = *existing;
+        lru_cache_release(cache, old);
+
+        auto &n = cache.Nodes[old];
+        if (cache.Evicted) cache.Evicted(n.Key, n.Value);
+    }
+
+    u32 index;
+    if (cache.FreeHead != T::NO_NODE) {
+        index = cache.FreeHead;
+        cache.FreeHead = cache.Nodes[index].Next;
+    } else {
+        index = (u32) cache.Nodes.Count;
+        array_append(cache.Nodes, {});
+    }
+
+    auto &n = cache.Nodes[index];
+    new (&n.Key) K(key);
+    new (&n.Value) V(value);
+    n.Bytes = bytes;
+
+    add(cache.Index, key, index);
+    lru_cache_link_front(cache, index);
+
+    cache.Bytes += bytes;
+    ++cache.Count;
+
+    // The new entry is at the head, so it's the last one left
+    while (cache_is_full(cache) && cache.Tail != index) evict(cache);
+
+    return &cache.Nodes[index].Value;
+}
+
+// Returns true if the key was found and removed. _Evicted_ isn't called, the value is copied to _out_ if it's not null.
+template <any_lru_cache T>
+bool remove(T &cache, const typename T::K &key, typename T::V *out = null) {
+    auto *index = find(cache.Index, key).Value;
+    if (!index) return false;
+
+    u32 i = *index;
+    lru_cache_release(cache, i);
+    if (out) *out = cache.Nodes[i].Value;
+    return true;
+}
+
+// Returns true if the key is in the cache, doesn't count as a use
+template <any_lru_cache T>
+bool has(const T &cache, const typename T::K &key) { return has(cache.Index, key); }
+
+// Forgets every entry (without calling _Evicted_) but keeps the memory around
+template <any_lru_cache T>
+void reset(T &cache) {
+    reset(cache.Index);
+    cache.Nodes.Count = 0;
+    cache.Head = cache.Tail = cache.FreeHead = T::NO_NODE;
+    cache.Count = cache.Bytes = 0;
+}
+
+// Doesn't call _Evicted_
+template <any_lru_cache T>
+void free(T &cache) {
+    free(cache.Nodes);
+    free(cache.Index);
+    cache.Head = cache.Tail = cache.FreeHead = T::NO_NODE;
+    cache.Count = cache.Bytes = 0;
+}
+
+//
+// clock_cache:
+//
+
+template <any_clock_cache T>
+void clock_cache_release(T &cache, u32 index) {
+    auto &s = cache.Slots[index];
+    remove(cache.Index, s.Key);
+
+    s.Used = false;
+    s.NextFree = cache.FreeHead;
+    cache.FreeHead = index;
+
+    cache.Bytes -= s.Bytes;
+    --cache.Count;
+}
+
+// Returns the value of _key_ and marks it as used, null if it's not in the cache.
+// Only an atomic write to the entry (if it wasn't marked already), see sharded_cache.
+template <any_clock_cache T>
+typename T::V *get(T &cache, const typename T::K &key) {
+    auto *index = find(cache.Index, key).Value;
+    if (!index) return null;
+
+    auto &s = cache.Slots[*index];
+    if (!atomic_load(&s.Referenced)) atomic_store(&s.Referenced, 1);
+    return &s.Value;
+}
+
+// Sweeps from the hand: entries which were used since the last sweep lose the mark and stay, the first one which
+// wasn't is evicted (calls _Evicted_). _keep_ is skipped. Returns false if there was nothing to evict.
+template <any_clock_cache T>
+bool evict(T &cache, u32 keep = T::NO_SLOT) {
+    if (cache.Count == 0 || (cache.Count == 1 && keep != T::NO_SLOT)) return false;
+
+    // Two rounds at most, the first clears every mark
+    while (true) {
+        if (cache.Hand >= cache.Slots.Count) cache.Hand = 0;
+
+        u32 index = cache.Hand++;
+        auto &s = cache.Slots[index];
+        if (!s.Used || index == keep) continue;
+
+        if (s.Referenced) {
+            s.Referenced = 0;
+            continue;
+        }
+
+        clock_cache_release(cache, index);
+        if (cache.Evicted) cache.Evicted(s.Key, s.Value);
+        return true;
+    }
+}
+
+// Adds _key_ (an entry which is already there for it is evicted first), then evicts until the cache isn't full.
+// _bytes_ is what the entry counts against _MaxBytes_.
+template <any_clock_cache T>
+typename T::V *put(T &cache, const typename T::K &key, const typename T::V &value, s64 bytes = 0) {
+    using K = typename T::K;
+    using V = typename T::V;
+
+    // The old entry goes out whole (key and value), so _Evicted_ can free both
+    if (auto *existing = find(cache.Index, key).Value) {
+        u32 old = *existing;
+        clock_cache_release(cache, old);
+
+        auto &s = cache.Slots[old];
+        if (cache.Evicted) cache.Evicted(s.Key, s.Value);
+    }
+
+    u32 index;
+    if (cache.FreeHead != T::NO_SLOT) {
+        index = cache.FreeHead;
+        cache.FreeHead = cache.Slots[index].NextFree;
+    } else {
+        index = (u32) cache.Slots.Count;
+        array_append(cache.Slots, {});
+    }
+
+    // New entries start unmarked, so ones which are never used again are the first to go
+    auto &s = cache.Slots[index];
+    new (&s.Key) K(key);
+    new (&s.Value) V(value);
+    s.Bytes = bytes;
+    s.Referenced = 0;
+    s.Used = true;
+
+    add(cache.Index, key, index);
+
+    cache.Bytes += bytes;
+    ++cache.Count;
+
+    while (cache_is_full(cache) && evict(cache, index)) {
+    }
+
+    return &cache.Slots[index].Value;
+}
+
+// Returns true if the key was found and removed. _Evicted_ isn't called, the value is copied to _out_ if it's not null.
+template <any_clock_cache T>
+bool remove(T &cache, const typename T::K &key, typename T::V *out = null) {
+    auto *index = find(cache.Index, key).Value;
+    if (!index) return false;
+
+    u32 i = *index;
+    clock_cache_release(cache, i);
+    if (out) *out = cache.Slots[i].Value;
+    return true;
+}
+
+// Returns true if the key is in the cache, doesn't count as a use
+template <any_clock_cache T>
+bool has(const T &cache, const typename T::K &key) { return has(cache.Index, key); }
+
+// Forgets every entry (without calling _Evicted_) but keeps the memory around
+template <any_clock_cache T>
+void reset(T &cache) {
+    reset(cache.Index);
+    cache.Slots.Count = 0;
+    cache.Hand = 0;
+    cache.FreeHead = T::NO_SLOT;
+    cache.Count = cache.Bytes = 0;
+}
+
+// Doesn't call _Evicted_
+template <any_clock_cache T>
+void free(T &cache) {
+    free(cache.Slots);
+    free(cache.Index);
+    cache.Hand = 0;
+    cache.FreeHead = T::NO_SLOT;
+    cache.Count = cache.Bytes = 0;
+}
+
+//
+// A cache (lru_cache or clock_cache) which can be used from many threads at the same time.
+//
+// Like concurrent_hash_table the entries are split between _ShardCount_ caches by the high bits of the hash,
+// each with its own lock, and get() copies the value out instead of returning a pointer. Every shard gets an equal
+// part of the limits (see sharded_cache_set_limits()), so the least recently used entry of a shard is evicted,
+// not of the whole cache. _Evicted_ is called with the shard locked.
+//
+// Hits take the shard's lock exclusively with lru_cache (they relink the entry) and shared with clock_cache,
+// that's the one to pick for caches which are mostly read from many threads.
+//
+// The shards allocate with _Alloc_ (if it's set, otherwise with the Context's allocator of the thread which causes
+// the allocation), set it to something thread safe.
+//
+template <typename Cache_, s64 ShardCount = 16>
+requires(any_cache<Cache_>) struct sharded_cache {
+    using cache_t = Cache_;
+    using K = typename cache_t::K;
+    using V = typename cache_t::V;
+
+    static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "Shard count must be a power of two");
+    static constexpr s64 SHARD_COUNT = ShardCount;
+    static constexpr s64 SHARD_SHIFT = 64 - msb((u64) ShardCount);
+
+    // Each shard on its own cache line so threads working on different shards don't fight over it
+    struct alignas(64) shard {
+        thread::fast_shared_mutex Mutex;
+        cache_t Cache;
+    };
+
+    shard Shards[ShardCount];
+
+    allocator Alloc;
+
+    sharded_cache() {}
+};
+
+template <typename T>
+struct is_sharded_cache : types::false_t {};
+
+template <typename Cache, s64 ShardCount>
+struct is_sharded_cache<sharded_cache<Cache, ShardCount>> : types::true_t {};
+
+template <typename T>
+concept any_sharded_cache = is_sharded_cache<T>::value;
+
+template <any_sharded_cache T>
+auto *sharded_cache_get_shard(T &cache, const typename T::K &key) {
+    if constexpr (T::SHARD_COUNT == 1) {
+        return &cache.Shards[0];
+    } else {
+        return &cache.Shards[key_hash<typename T::K>{}(key) >> T::SHARD_SHIFT];
+    }
+}
+
+// Splits the limits evenly between the shards and sets _evicted_ as every shard's _Evicted_.
+// Call it before using the cache.
+template <any_sharded_cache T>
+void sharded_cache_set_limits(T &cache, s64 maxCount, s64 maxBytes, const delegate<void(typename T::K &, typename T::V &)> &evicted = {}) {
+    For(cache.Shards) {
+        it.Cache.MaxCount = maxCount ? max<s64>(1, maxCount / T::SHARD_COUNT) : 0;
+        it.Cache.MaxBytes = maxBytes ? max<s64>(1, maxBytes / T::SHARD_COUNT) : 0;
+        it.Cache.Evicted = evicted;
+    }
+}
+
+// Copies the value into _out_ (if it's not null) and returns true if the key was found. Counts as a use.
+template <any_sharded_cache T>
+bool get(T &cache, const typename T::K &key, typename T::V *out = null) {
+    auto *s = sharded_cache_get_shard(cache, key);
+
+    typename T::V *value;
+    if constexpr (T::cache_t::SHARED_HITS) {
+        thread::shared_lock _(&s->Mutex);
+        value = get(s->Cache, key);
+        if (value && out) *out = *value;
+    } else {
+        thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+        value = get(s->Cache, key);
+        if (value && out) *out = *value;
+    }
+    return value != null;
+}
+
+template <any_sharded_cache T>
+void put(T &cache, const typename T::K &key, const typename T::V &value, s64 bytes = 0) {
+    auto *s = sharded_cache_get_shard(cache, key);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+    PUSH_ALLOC(cache.Alloc ? cache.Alloc : Context.Alloc) {
+        put(s->Cache, key, value, bytes);
+    }
+}
+
+template <any_sharded_cache T>
+bool remove(T &cache, const typename T::K &key, typename T::V *out = null) {
+    auto *s = sharded_cache_get_shard(cache, key);
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&s->Mutex);
+    return remove(s->Cache, key, out);
+}
+
+template <any_sharded_cache T>
+bool has(T &cache, const typename T::K &key) {
+    auto *s = sharded_cache_get_shard(cache, key);
+
+    thread::shared_lock _(&s->Mutex);
+    return has(s->Cache, key);
+}
+
+// Only a snapshot, other threads may change the cache while we are counting.
+template <any_sharded_cache T>
+s64 count(T &cache) {
+    s64 result = 0;
+    For(cache.Shards) result += atomic_load(&it.Cache.Count);
+    return result;
+}
+
+// Frees the memory of all shards. Not thread safe, make sure no one else is using the cache.
+template <any_sharded_cache T>
+void free(T &cache) {
+    For(cache.Shards) free(it.Cache);
+}
+
+LSTD_END_NAMESPACE
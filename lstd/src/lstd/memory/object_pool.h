@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../internal/context.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// A typed wrapper around pool_allocator which gets more memory by itself.
+// When the pool runs out of space we allocate a block for _ObjectsPerBlock_ more objects with the Context's allocator.
+//
+//     object_pool<ast_node> pool;
+//
+//     auto *node = pool_allocate(pool);
+//     ...
+//     free(node);  // Objects know which allocator they came from, so the normal free() puts them back in the pool.
+//
+//     free(pool);  // Releases all blocks (doesn't call destructors of objects which are still alive!)
+//
+// Note: Allocations store a pointer to _Data_, so don't move the pool after the first allocation.
+template <typename T>
+struct object_pool {
+    s64 ObjectsPerBlock = 64;  // Change this before the first allocation.
+    pool_allocator_data Data;
+};
+
+template <typename T>
+allocator object_pool_get_allocator(object_pool<T> &pool) { return allocator(pool_allocator, &pool.Data); }
+
+// Calls the constructor of T (like allocate<T>).
+template <typename T>
+T *pool_allocate(object_pool<T> &pool, source_location loc = source_location::current()) {
+    constexpr u32 alignment = alignof(T) < POINTER_SIZE ? POINTER_SIZE : alignof(T);
+
+    if (!pool.Data.ElementSize) pool.Data.ElementSize = pool_allocator_element_size(sizeof(T), alignment);
+
+    if (!pool_allocator_has_room(&pool.Data)) {
+        assert(pool.ObjectsPerBlock > 0);
+
+        s64 size = sizeof(allocator_pool) + pool.ObjectsPerBlock * pool.Data.ElementSize;
+        auto *block = allocate_array<byte>(size);
+        allocator_add_pool(object_pool_get_allocator(pool), block, size);
+    }
+    return allocate<T>({.Alloc = object_pool_get_allocator(pool), .Alignment = alignment}, loc);
+}
+
+template <typename T>
+void free(object_pool<T> &pool) {
+    auto alloc = object_pool_get_allocator(pool);
+    if (!pool.Data.Base) return;
+
+    free_all(alloc);
+
+    auto *p = pool.Data.Base;
+    while (p) {
+        auto *next = p->Next;
+        allocator_remove_pool(alloc, p);
+        free((byte *) p);
+        p = next;
+    }
+    pool.Data.FreeList = null;
+}
+
+LSTD_END_NAMESPACE
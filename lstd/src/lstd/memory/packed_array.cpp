@@ -0,0 +1,288 @@
+#include "packed_array.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // AVX2 intrinsics
+
+// MSVC lets us use newer instructions without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// Words for _count_ values of _bitWidth_ bits, with the padding one
+file_scope s64 packed_word_count(s64 count, u32 bitWidth) { return (s64) (((u64) count * bitWidth + 63) / 64) + 1; }
+
+//
+// Kernels: out[k] = base + the _width_ bit value at bit + k * width, for k in [0, count)
+//
+using packed_unpack_func = void (*)(u32 *out, const u64 *words, u64 bit, u32 width, u32 base, s64 count);
+
+// The smallest and largest of _count_ values (count > 0)
+using packed_min_max_func = void (*)(const u32 *values, s64 count, u32 &min, u32 &max);
+
+file_scope void packed_unpack_scalar(u32 *out, const u64 *words, u64 bit, u32 width, u32 base, s64 count) {
+    For(range(count)) {
+        out[it] = base + internal::packed_read(words, bit, width);
+        bit += width;
+    }
+}
+
+file_scope void packed_min_max_scalar(const u32 *values, s64 count, u32 &min, u32 &max) {
+    u32 lo = values[0], hi = values[0];
+    For(range(1, count)) {
+        lo = values[it] < lo ? values[it] : lo;
+        hi = values[it] > hi ? values[it] : hi;
+    }
+    min = lo;
+    max = hi;
+}
+
+#if ARCH == X86
+// Every lane loads 32 bits from the byte its value starts at and shifts the value down, so widths up to 25 bits
+TARGET_AVX2 file_scope void packed_unpack_avx2(u32 *out, const u64 *words, u64 bit, u32 width, u32 base, s64 count) {
+    if (width > 25) {
+        packed_unpack_scalar(out, words, bit, width, base, count);
+        return;
+    }
+
+    const byte *bytes = (const byte *) words;
+
+    __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((s32) width));
+    __m256i mask = _mm256_set1_epi32((s32) ((1ull << width) - 1));
+    __m256i seven = _mm256_set1_epi32(7);
+    __m256i baseV = _mm256_set1_epi32((s32) base);
+
+    s64 k = 0;
+    for (; k + 8 <= count; k += 8) {
+        // Bits relative to the byte the first of the 8 values starts in
+        __m256i bits = _mm256_add_epi32(lanes, _mm256_set1_epi32((s32) (bit & 7)));
+        const byte *first = bytes + bit / 8;
+
+        __m256i v = _mm256_i32gather_epi32((const int *) first, _mm256_srli_epi32(bits, 3), 1);
+        v = _mm256_srlv_epi32(v, _mm256_and_si256(bits, seven));
+        v = _mm256_add_epi32(_mm256_and_si256(v, mask), baseV);
+        _mm256_storeu_si256((__m256i *) (out + k), v);
+
+        bit += 8 * width;
+    }
+    packed_unpack_scalar(out + k, words, bit, width, base, count - k);
+}
+
+TARGET_AVX2 file_scope void packed_min_max_avx2(const u32 *values, s64 count, u32 &min, u32 &max) {
+    if (count < 8) {
+        packed_min_max_scalar(values, count, min, max);
+        return;
+    }
+
+    __m256i lo = _mm256_loadu_si256((const __m256i *) values), hi = lo;
+
+    s64 k = 8;
+    for (; k + 8 <= count; k += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (values + k));
+        lo = _mm256_min_epu32(lo, v);
+        hi = _mm256_max_epu32(hi, v);
+    }
+
+    // The last 8 overlap the ones before, which doesn't change the result
+    __m256i v = _mm256_loadu_si256((const __m256i *) (values + count - 8));
+    lo = _mm256_min_epu32(lo, v);
+    hi = _mm256_max_epu32(hi, v);
+
+    u32 los[8], his[8];
+    _mm256_storeu_si256((__m256i *) los, lo);
+    _mm256_storeu_si256((__m256i *) his, hi);
+    packed_min_max_scalar(los, 8, min, max);
+
+    u32 unused;
+    packed_min_max_scalar(his, 8, unused, max);
+}
+#endif
+
+file_scope packed_unpack_func packed_get_unpack() {
+    local_persist cpu_dispatch<packed_unpack_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> packed_unpack_func {
+#if ARCH == X86
+        return cpu.AVX2 ? packed_unpack_avx2 : packed_unpack_scalar;
+#else
+        return packed_unpack_scalar;
+#endif
+    });
+}
+
+file_scope packed_min_max_func packed_get_min_max() {
+    local_persist cpu_dispatch<packed_min_max_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> packed_min_max_func {
+#if ARCH == X86
+        return cpu.AVX2 ? packed_min_max_avx2 : packed_min_max_scalar;
+#else
+        return packed_min_max_scalar;
+#endif
+    });
+}
+
+// ORs the values minus _base_ into zeroed words, one word at a time
+file_scope void packed_pack_into(u64 *words, u64 bit, u32 width, u32 base, const u32 *values, s64 count) {
+    if (!width) return;
+
+    u64 *w = words + bit / 64;
+    u32 offset = bit % 64;
+
+    u64 acc = *w;
+    For(range(count)) {
+        u64 v = values[it] - base;
+        acc |= v << offset;
+
+        offset += width;
+        if (offset >= 64) {
+            *w++ = acc;
+            offset -= 64;
+            acc = offset ? v >> (width - offset) : 0;
+        }
+    }
+    *w |= acc;
+}
+
+void packed_array_init(packed_array &arr, u32 bitWidth, s64 count) {
+    assert(bitWidth >= 1 && bitWidth <= 32);
+    assert(count >= 0);
+
+    free(arr);
+
+    arr.BitWidth = bitWidth;
+    arr.Allocated = packed_word_count(max<s64>(count, 64), bitWidth);
+    arr.Words = allocate_array<u64>(arr.Allocated);
+    zero_memory(arr.Words, arr.Allocated * sizeof(u64));
+    arr.Count = count;
+}
+
+void packed_array_pack(packed_array &arr, const u32 *values, s64 count, u32 bitWidth) {
+    if (!bitWidth) {
+        u32 lo = 0, hi = 0;
+        if (count) packed_get_min_max()(values, count, lo, hi);
+        bitWidth = packed_bit_width(hi);
+    }
+
+    packed_array_init(arr, bitWidth, count);
+    packed_pack_into(arr.Words, 0, bitWidth, 0, values, count);
+}
+
+void packed_array_unpack(u32 *out, const packed_array &arr, s64 first, s64 count) {
+    assert(first >= 0 && count >= 0 && first + count <= arr.Count);
+    packed_get_unpack()(out, arr.Words, (u64) first * arr.BitWidth, arr.BitWidth, 0, count);
+}
+
+void resize(packed_array &arr, s64 count) {
+    assert(arr.BitWidth && "Call packed_array_init() first");
+
+    s64 words = packed_word_count(count, arr.BitWidth);
+    if (words > arr.Allocated) {
+        s64 target = max<s64>(ceil_pow_of_2(words), 4);
+        arr.Words = reallocate_array(arr.Words, target);
+        zero_memory(arr.Words + arr.Allocated, (target - arr.Allocated) * sizeof(u64));
+        arr.Allocated = target;
+    }
+
+    // Clear the values we drop, so they are 0 if we grow again
+    For(range(count, arr.Count)) internal::packed_write(arr.Words, (u64) it * arr.BitWidth, arr.BitWidth, 0);
+    arr.Count = count;
+}
+
+void free(packed_array &arr) {
+    if (arr.Allocated) free(arr.Words);
+    arr.Words = null;
+    arr.Count = arr.Allocated = 0;
+    arr.BitWidth = 0;
+}
+
+packed_array *clone(packed_array *dest, const packed_array &src) {
+    free(*dest);
+    if (!src.BitWidth) return dest;
+
+    packed_array_init(*dest, src.BitWidth, src.Count);
+    copy_memory(dest->Words, src.Words, packed_word_count(src.Count, src.BitWidth) * sizeof(u64));
+    return dest;
+}
+
+void packed_for_pack(packed_for_array &arr, const u32 *values, s64 count) {
+    free(arr);
+    arr.Count = count;
+    if (!count) return;
+
+    s64 blocks = (count + PACKED_FOR_BLOCK - 1) / PACKED_FOR_BLOCK;
+    arr.Blocks = allocate_array<packed_for_block>(blocks);
+
+    auto min_max = packed_get_min_max();
+
+    // The widths first, to know how many words we need
+    u64 bit = 0;
+    For(range(blocks)) {
+        s64 n = min(PACKED_FOR_BLOCK, count - it * PACKED_FOR_BLOCK);
+
+        u32 lo, hi;
+        min_max(values + it * PACKED_FOR_BLOCK, n, lo, hi);
+
+        packed_for_block &b = arr.Blocks[it];
+        b.BitOffset = bit;
+        b.Base = lo;
+        b.BitWidth = hi == lo ? 0 : packed_bit_width(hi - lo);
+        bit += (u64) n * b.BitWidth;
+    }
+
+    s64 words = (s64) ((bit + 63) / 64) + 1;
+    arr.Words = allocate_array<u64>(words);
+    zero_memory(arr.Words, words * sizeof(u64));
+
+    For(range(blocks)) {
+        s64 n = min(PACKED_FOR_BLOCK, count - it * PACKED_FOR_BLOCK);
+
+        const packed_for_block &b = arr.Blocks[it];
+        packed_pack_into(arr.Words, b.BitOffset, b.BitWidth, b.Base, values + it * PACKED_FOR_BLOCK, n);
+    }
+}
+
+void packed_for_unpack(u32 *out, const packed_for_array &arr, s64 first, s64 count) {
+    assert(first >= 0 && count >= 0 && first + count <= arr.Count);
+
+    auto unpack = packed_get_unpack();
+
+    s64 end = first + count;
+    while (first < end) {
+        s64 block = first / PACKED_FOR_BLOCK;
+        s64 n = min((block + 1) * PACKED_FOR_BLOCK, end) - first;
+
+        const packed_for_block &b = arr.Blocks[block];
+        unpack(out, arr.Words, b.BitOffset + (u64) (first % PACKED_FOR_BLOCK) * b.BitWidth, b.BitWidth, b.Base, n);
+
+        out += n;
+        first += n;
+    }
+}
+
+void free(packed_for_array &arr) {
+    if (arr.Words) free(arr.Words);
+    if (arr.Blocks) free(arr.Blocks);
+    arr.Words = null;
+    arr.Blocks = null;
+    arr.Count = 0;
+}
+
+packed_for_array *clone(packed_for_array *dest, const packed_for_array &src) {
+    free(*dest);
+    dest->Count = src.Count;
+    if (!src.Count) return dest;
+
+    s64 blocks = (src.Count + PACKED_FOR_BLOCK - 1) / PACKED_FOR_BLOCK;
+    s64 words = (packed_for_size(src) - blocks * (s64) sizeof(packed_for_block)) / (s64) sizeof(u64);
+
+    dest->Blocks = allocate_array<packed_for_block>(blocks);
+    dest->Words = allocate_array<u64>(words);
+    copy_memory(dest->Blocks, src.Blocks, blocks * sizeof(packed_for_block));
+    copy_memory(dest->Words, src.Words, words * sizeof(u64));
+    return dest;
+}
+
+LSTD_END_NAMESPACE
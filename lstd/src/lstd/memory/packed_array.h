@@ -0,0 +1,142 @@
+#pragma once
+
+#include "../internal/context.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Arrays of small unsigned integers stored in as many bits as they need, for compact indices (posting lists,
+// offsets, ids of a few million things) which would otherwise take a whole u32 per value.
+//
+//     packed_array ids;
+//     defer(free(ids));
+//     packed_array_pack(ids, values, count);  // The bit width is picked from the largest value
+//
+//     u32 v = get(ids, 42);                   // Random access is a couple of shifts
+//     packed_array_unpack(out, ids, 0, ids.Count);
+//
+// Values are back to back in little endian u64 words (value i starts at bit i * BitWidth), there is always one
+// more word allocated than they need, so reading a value which ends in the last word can load the one after it.
+//
+// Bulk unpacking gathers 8 values at a time with AVX2 (for widths up to 25 bits, a 32 bit load from the byte
+// a value starts at always covers it), wider values and other CPUs go through the scalar loop.
+//
+// packed_for_array is the frame of reference variant: every block of PACKED_FOR_BLOCK values stores its minimum
+// and the values minus it, in as many bits as that block needs. Sorted lists (doc ids in a posting list) and
+// values which cluster take a few bits per value, a block of equal values takes none.
+//
+
+struct packed_array {
+    u64 *Words = null;
+    s64 Count = 0;
+    s64 Allocated = 0;  // In words, including the padding one
+
+    u32 BitWidth = 0;  // 1 - 32
+
+    packed_array() {}
+};
+
+// The number of bits values up to _maxValue_ need (at least 1)
+always_inline u32 packed_bit_width(u32 maxValue) { return count_digits_base_2(maxValue); }
+
+namespace internal {
+// The _width_ bit value at _bit_ (the word after it must be readable)
+always_inline u32 packed_read(const u64 *words, u64 bit, u32 width) {
+    u64 w = bit / 64;
+    u32 offset = bit % 64;
+
+    // Two shifts for the second word, shifting by 64 is undefined when _offset_ is 0
+    u64 value = (words[w] >> offset) | ((words[w + 1] << 1) << (63 - offset));
+    return (u32) (value & ((1ull << width) - 1));
+}
+
+always_inline void packed_write(u64 *words, u64 bit, u32 width, u32 value) {
+    u64 w = bit / 64;
+    u32 offset = bit % 64;
+    u64 mask = (1ull << width) - 1;
+
+    words[w] = (words[w] & ~(mask << offset)) | ((u64) value << offset);
+    if (offset + width > 64) {
+        u32 spill = 64 - offset;
+        words[w + 1] = (words[w + 1] & ~(mask >> spill)) | ((u64) value >> spill);
+    }
+}
+}  // namespace internal
+
+// Allocates _count_ zeroed values of _bitWidth_ bits. Frees the old contents of _arr_.
+void packed_array_init(packed_array &arr, u32 bitWidth, s64 count = 0);
+
+// Replaces the contents with _values_, in _bitWidth_ bits or (if it's 0) the fewest bits which fit the largest value
+void packed_array_pack(packed_array &arr, const u32 *values, s64 count, u32 bitWidth = 0);
+
+// Writes _count_ values starting at _first_ to _out_
+void packed_array_unpack(u32 *out, const packed_array &arr, s64 first, s64 count);
+
+// Changes the number of values, new ones are 0. Keeps the bit width.
+void resize(packed_array &arr, s64 count);
+
+void free(packed_array &arr);
+packed_array *clone(packed_array *dest, const packed_array &src);
+
+inline u32 get(const packed_array &arr, s64 index) {
+    assert(index >= 0 && index < arr.Count);
+    return internal::packed_read(arr.Words, (u64) index * arr.BitWidth, arr.BitWidth);
+}
+
+inline void set(packed_array &arr, s64 index, u32 value) {
+    assert(index >= 0 && index < arr.Count);
+    assert((u64) value < (1ull << arr.BitWidth) && "Value doesn't fit in the bit width");
+    internal::packed_write(arr.Words, (u64) index * arr.BitWidth, arr.BitWidth, value);
+}
+
+// Appends a value (which must fit in the bit width)
+inline void add(packed_array &arr, u32 value) {
+    resize(arr, arr.Count + 1);
+    set(arr, arr.Count - 1, value);
+}
+
+//
+// Frame of reference, see the top of the file. Read only, pack again to change it.
+//
+constexpr s64 PACKED_FOR_BLOCK = 128;
+
+struct packed_for_block {
+    u64 BitOffset;  // Where the block's first value starts in _Words_
+    u32 Base;       // The smallest value in the block
+    u32 BitWidth;   // 0 - 32, 0 if all values in the block are the same
+};
+
+struct packed_for_array {
+    u64 *Words = null;
+    packed_for_block *Blocks = null;
+    s64 Count = 0;
+
+    packed_for_array() {}
+};
+
+// Replaces the contents with _values_
+void packed_for_pack(packed_for_array &arr, const u32 *values, s64 count);
+
+void packed_for_unpack(u32 *out, const packed_for_array &arr, s64 first, s64 count);
+
+void free(packed_for_array &arr);
+packed_for_array *clone(packed_for_array *dest, const packed_for_array &src);
+
+inline u32 get(const packed_for_array &arr, s64 index) {
+    assert(index >= 0 && index < arr.Count);
+
+    const packed_for_block &b = arr.Blocks[index / PACKED_FOR_BLOCK];
+    return b.Base + internal::packed_read(arr.Words, b.BitOffset + (u64) (index % PACKED_FOR_BLOCK) * b.BitWidth, b.BitWidth);
+}
+
+// Bytes used by the values and the block headers
+inline s64 packed_for_size(const packed_for_array &arr) {
+    s64 blocks = (arr.Count + PACKED_FOR_BLOCK - 1) / PACKED_FOR_BLOCK;
+    if (!blocks) return 0;
+
+    const packed_for_block &last = arr.Blocks[blocks - 1];
+    u64 bits = last.BitOffset + (u64) (arr.Count - (blocks - 1) * PACKED_FOR_BLOCK) * last.BitWidth;
+    return (s64) ((bits + 63) / 64 + 1) * sizeof(u64) + blocks * sizeof(packed_for_block);
+}
+
+LSTD_END_NAMESPACE
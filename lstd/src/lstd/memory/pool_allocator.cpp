@@ -0,0 +1,129 @@
+#include "allocator.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// Returns the first pool which has space for one more element.
+// We never split pools into elements up front, we bump _Used_ until the pool is exhausted,
+// because that way we don't touch memory which we haven't handed out yet.
+file_scope allocator_pool *pool_find_with_room(pool_allocator_data *data) {
+    auto *p = data->Base;
+    while (p) {
+        if (p->Used + data->ElementSize <= p->Size) return p;
+        p = p->Next;
+    }
+    return null;
+}
+
+bool pool_allocator_has_room(pool_allocator_data *data) { return data->FreeList || pool_find_with_room(data); }
+
+void *pool_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    auto *data = (pool_allocator_data *) context;
+
+    switch (mode) {
+        case allocator_mode::ADD_POOL: {
+            auto *pool = (allocator_pool *) oldMemory;  // _oldMemory_ is the parameter which should contain the block to be added
+                                                        // the _size_ parameter contains the size of the block
+
+            if (!allocator_pool_initialize(pool, size)) return null;
+            allocator_pool_add_to_linked_list(&data->Base, pool);
+            ++data->PoolsCount;
+            return pool;
+        }
+        case allocator_mode::REMOVE_POOL: {
+            auto *pool = (allocator_pool *) oldMemory;
+
+            // The free list may point inside the pool, so we can't remove it while it's in use.
+            // Call FREE_ALL first.
+            assert(pool->Used == 0 && "Removing a pool which still has elements handed out");
+
+            void *result = allocator_pool_remove_from_linked_list(&data->Base, pool);
+            if (result) {
+                --data->PoolsCount;
+                assert(data->PoolsCount >= 0);
+                return result;
+            }
+            return null;
+        }
+        case allocator_mode::ALLOCATE: {
+            assert(data->ElementSize >= POINTER_SIZE && "Element size not set");
+            if (size > data->ElementSize) return null;  // Too large, use another allocator for this
+
+            if (data->FreeList) {
+                void *result = data->FreeList;
+                data->FreeList = *(void **) result;
+                return result;
+            }
+
+            auto *p = pool_find_with_room(data);
+            if (!p) return null;  // Not enough space
+
+            void *result = (byte *) (p + 1) + p->Used;
+            p->Used += data->ElementSize;
+            return result;
+        }
+        case allocator_mode::RESIZE: {
+            // Every block is ElementSize bytes so we can grow in place as long as we don't go over that
+            if (size <= data->ElementSize) return oldMemory;
+            return null;
+        }
+        case allocator_mode::FREE: {
+            *(void **) oldMemory = data->FreeList;
+            data->FreeList = oldMemory;
+
+            // null means success FREE
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            data->FreeList = null;
+
+            auto *p = data->Base;
+            while (p) {
+                p->Used = 0;
+                p = p->Next;
+            }
+
+            // null means successful FREE_ALL
+            // (void *) -1 means that the allocator doesn't support FREE_ALL (by design)
+            return null;
+        }
+        case allocator_mode::ALLOCATE_BATCH: {
+            assert(data->ElementSize >= POINTER_SIZE && "Element size not set");
+            if (size > data->ElementSize) return oldMemory;  // Nothing filled
+
+            auto **out = (void **) oldMemory;
+            auto **end = out + oldSize;
+
+            while (out != end && data->FreeList) {
+                *out = data->FreeList;
+                data->FreeList = *(void **) *out;
+                ++out;
+            }
+
+            while (out != end) {
+                auto *p = pool_find_with_room(data);
+                if (!p) break;  // Not enough space
+
+                // Take as many elements as we can from this pool
+                byte *usable = (byte *) (p + 1);
+                while (out != end && p->Used + data->ElementSize <= p->Size) {
+                    *out++ = usable + p->Used;
+                    p->Used += data->ElementSize;
+                }
+            }
+            return out;
+        }
+        case allocator_mode::FREE_BATCH: {
+            auto **blocks = (void **) oldMemory;
+            For(range(oldSize)) {
+                *(void **) blocks[it] = data->FreeList;
+                data->FreeList = blocks[it];
+            }
+            return null;
+        }
+        default:
+            assert(false);
+    }
+    return null;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "sort.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A priority queue built on a d-ary heap stored in an array.
+//
+//     priority_queue<timer, 4, timer_comparison> timers;
+//
+//     s64 handle = push(timers, t);
+//     ...
+//     update(timers, handle, rescheduled);  // Decrease-key (or increase), O(log n)
+//     remove(timers, handle);               // e.g. when the timer is cancelled
+//     ...
+//     while (count(timers) && top(timers).Deadline <= now) fire(pop(timers));
+//
+// The element which compares smallest is on top. The comparison follows the convention of sort() (see sort.h) -
+// takes pointers to two elements and returns < 0, 0 or > 0. For a max-heap flip the comparison.
+//
+// _Arity_ is the number of children of each node. 2 is the classic binary heap, 4 makes the heap half as deep and
+// puts the children of a node next to each other in memory (one cache line for small elements), which is usually
+// faster for big queues since sifting down touches fewer lines. It costs more comparisons per level though.
+//
+// push() returns a handle which you can use to update or remove the element later. We keep a map from handles
+// to positions in the heap (_Positions_), so finding an element doesn't require a search. A handle becomes
+// invalid after its element is popped or removed, handles get reused after that.
+template <typename T_, s64 Arity = 2, typename Compare = internal::default_sort_comparison<T_>>
+struct priority_queue {
+    using T = T_;
+
+    static_assert(Arity >= 2);
+    static constexpr s64 ARITY = Arity;
+
+    struct entry {
+        T Value;
+        s64 Handle;
+    };
+
+    array<entry> Heap;
+
+    // For each handle, the index of its element in _Heap_.
+    // Free handles form a linked list, they store (-2 - next free handle), so all of them are negative.
+    array<s64> Positions;
+    s64 FreeHandle = -1;
+
+    Compare Cmp;
+
+    priority_queue() {}
+    priority_queue(Compare cmp) : Cmp(cmp) {}
+};
+
+template <typename T>
+struct is_priority_queue : types::false_t {};
+
+template <typename T, s64 Arity, typename Compare>
+struct is_priority_queue<priority_queue<T, Arity, Compare>> : types::true_t {};
+
+template <typename T>
+concept any_priority_queue = is_priority_queue<T>::value;
+
+namespace internal {
+template <any_priority_queue Q>
+s64 priority_queue_new_handle(Q &pq) {
+    s64 handle = pq.FreeHandle;
+    if (handle != -1) {
+        pq.FreeHandle = -2 - pq.Positions.Data[handle];
+    } else {
+        handle = pq.Positions.Count;
+        array_append(pq.Positions, (s64) 0);
+    }
+    return handle;
+}
+
+template <any_priority_queue Q>
+void priority_queue_free_handle(Q &pq, s64 handle) {
+    pq.Positions.Data[handle] = -2 - pq.FreeHandle;
+    pq.FreeHandle = handle;
+}
+
+// Moves the element at _index_ up until its parent isn't greater. We move a hole instead of swapping.
+template <any_priority_queue Q>
+void priority_queue_sift_up(Q &pq, s64 index) {
+    auto *heap = pq.Heap.Data;
+
+    auto e = heap[index];
+    while (index > 0) {
+        s64 parent = (index - 1) / Q::ARITY;
+        if (pq.Cmp(&e.Value, &heap[parent].Value) >= 0) break;
+
+        heap[index] = heap[parent];
+        pq.Positions.Data[heap[index].Handle] = index;
+        index = parent;
+    }
+    heap[index] = e;
+    pq.Positions.Data[e.Handle] = index;
+}
+
+// Moves the element at _index_ down until none of its children are smaller.
+template <any_priority_queue Q>
+void priority_queue_sift_down(Q &pq, s64 index) {
+    auto *heap = pq.Heap.Data;
+    s64 count = pq.Heap.Count;
+
+    auto e = heap[index];
+    while (true) {
+        s64 first = index * Q::ARITY + 1;
+        if (first >= count) break;
+
+        s64 last = min(first + Q::ARITY, count);
+
+        s64 best = first;
+        for (s64 c = first + 1; c < last; ++c) {
+            if (pq.Cmp(&heap[c].Value, &heap[best].Value) < 0) best = c;
+        }
+        if (pq.Cmp(&heap[best].Value, &e.Value) >= 0) break;
+
+        heap[index] = heap[best];
+        pq.Positions.Data[heap[index].Handle] = index;
+        index = best;
+    }
+    heap[index] = e;
+    pq.Positions.Data[e.Handle] = index;
+}
+}  // namespace internal
+
+template <any_priority_queue Q>
+s64 count(const Q &pq) { return pq.Heap.Count; }
+
+// Reserves space for at least _n_ more elements.
+template <any_priority_queue Q>
+void reserve(Q &pq, s64 n) {
+    array_reserve(pq.Heap, n);
+    array_reserve(pq.Positions, n);
+}
+
+// Call destructor on each element and reset count, keeps the memory for reuse. All handles become invalid.
+template <any_priority_queue Q>
+void reset(Q &pq) {
+    For(pq.Heap) destroy_at(&it.Value);
+    array_reset(pq.Heap);
+    array_reset(pq.Positions);
+    pq.FreeHandle = -1;
+}
+
+// Call destructor on each element and free any memory.
+template <any_priority_queue Q>
+void free(Q &pq) {
+    reset(pq);
+    free(pq.Heap);
+    free(pq.Positions);
+}
+
+// Returns true if _handle_ refers to an element which is still in the queue.
+template <any_priority_queue Q>
+bool has(const Q &pq, s64 handle) { return handle >= 0 && handle < pq.Positions.Count && pq.Positions.Data[handle] >= 0; }
+
+// Adds a shallow copy of _element_, returns a handle to it. O(log n)
+template <any_priority_queue Q>
+s64 push(Q &pq, const typename Q::T &element) {
+    s64 handle = internal::priority_queue_new_handle(pq);
+    array_append(pq.Heap, {element, handle});
+    internal::priority_queue_sift_up(pq, pq.Heap.Count - 1);
+    return handle;
+}
+
+// Returns the smallest element without removing it.
+template <any_priority_queue Q>
+auto &top(const Q &pq) {
+    assert(pq.Heap.Count && "Priority queue is empty");
+    return pq.Heap.Data[0].Value;
+}
+
+// Returns the handle of the smallest element.
+template <any_priority_queue Q>
+s64 top_handle(const Q &pq) {
+    assert(pq.Heap.Count && "Priority queue is empty");
+    return pq.Heap.Data[0].Handle;
+}
+
+// Returns the element of a handle.
+template <any_priority_queue Q>
+auto &get(const Q &pq, s64 handle) {
+    assert(has(pq, handle));
+    return pq.Heap.Data[pq.Positions.Data[handle]].Value;
+}
+
+// Removes the smallest element and returns it (doesn't call the destructor, the caller owns the result). O(log n)
+template <any_priority_queue Q>
+auto pop(Q &pq) {
+    assert(pq.Heap.Count && "Popping from an empty priority queue");
+
+    auto result = pq.Heap.Data[0];
+    internal::priority_queue_free_handle(pq, result.Handle);
+
+    --pq.Heap.Count;
+    if (pq.Heap.Count) {
+        pq.Heap.Data[0] = pq.Heap.Data[pq.Heap.Count];
+        internal::priority_queue_sift_down(pq, 0);
+    }
+    return result.Value;
+}
+
+// Changes the element of _handle_ and moves it to its new place (works if it got smaller or bigger). O(log n)
+template <any_priority_queue Q>
+void update(Q &pq, s64 handle, const typename Q::T &element) {
+    assert(has(pq, handle));
+
+    s64 index = pq.Positions.Data[handle];
+    pq.Heap.Data[index].Value = element;
+
+    internal::priority_queue_sift_up(pq, index);
+    internal::priority_queue_sift_down(pq, pq.Positions.Data[handle]);
+}
+
+// Removes the element of _handle_ (calls its destructor). Returns false if the handle is invalid. O(log n)
+template <any_priority_queue Q>
+bool remove(Q &pq, s64 handle) {
+    if (!has(pq, handle)) return false;
+
+    s64 index = pq.Positions.Data[handle];
+    destroy_at(&pq.Heap.Data[index].Value);
+    internal::priority_queue_free_handle(pq, handle);
+
+    --pq.Heap.Count;
+    if (index != pq.Heap.Count) {
+        // Move the last element into the gap, it may need to go either way
+        s64 moved = pq.Heap.Data[pq.Heap.Count].Handle;
+        pq.Heap.Data[index] = pq.Heap.Data[pq.Heap.Count];
+
+        internal::priority_queue_sift_up(pq, index);
+        internal::priority_queue_sift_down(pq, pq.Positions.Data[moved]);
+    }
+    return true;
+}
+
+// Replaces the contents of the queue with shallow copies of _elements_ in O(n) (instead of O(n log n) with n pushes).
+// The handle of each element is its index in _elements_.
+template <any_priority_queue Q>
+void heapify(Q &pq, const array<typename Q::T> &elements) {
+    reset(pq);
+    reserve(pq, elements.Count);
+
+    For(range(elements.Count)) {
+        array_append(pq.Heap, {elements.Data[it], it});
+        array_append(pq.Positions, it);
+    }
+
+    // Sift down every node which has children, starting from the last one
+    if (elements.Count > 1) {
+        for (s64 i = (elements.Count - 2) / Q::ARITY; i >= 0; --i) internal::priority_queue_sift_down(pq, i);
+    }
+}
+
+// Handles into _src_ are also valid for _dest_.
+template <typename T, s64 Arity, typename Compare>
+priority_queue<T, Arity, Compare> *clone(priority_queue<T, Arity, Compare> *dest, const priority_queue<T, Arity, Compare> &src) {
+    free(*dest);
+    array_reserve(dest->Heap, src.Heap.Count);
+    For(src.Heap) {
+        auto *e = array_append(dest->Heap);
+        clone(&e->Value, it.Value);
+        e->Handle = it.Handle;
+    }
+    clone(&dest->Positions, src.Positions);
+    dest->FreeHandle = src.FreeHandle;
+    dest->Cmp = src.Cmp;
+    return dest;
+}
+
+LSTD_END_NAMESPACE
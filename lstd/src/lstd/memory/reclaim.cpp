@@ -0,0 +1,256 @@
+#include "reclaim.h"
+
+#include "../thread.h"
+#include "array.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+// A thread scans its retired blocks when it has this many (or twice as many as survived the last scan)
+constexpr s64 RECLAIM_SCAN_THRESHOLD = 64;
+
+struct reclaim_retired {
+    void *Block;
+    void (*Free)(void *);
+    s64 Epoch;  // The global epoch when it was retired, unused for hazard pointers
+};
+
+// One per thread which uses reclamation, never freed. A thread which releases its record leaves it
+// in the registry for the next thread which needs one.
+struct alignas(CACHE_LINE_SIZE) reclaim_record {
+    // (epoch << 1) | 1 while the thread is in a guard, 0 outside. Written by its thread, read by whoever advances.
+    atomic<s64> State;
+    atomic<void *> Hazards[HAZARD_POINTERS_PER_THREAD];
+
+    atomic<s32> InUse;
+    reclaim_record *Next = null;  // In the registry
+
+    // Only touched by the thread which owns the record
+    s64 Nesting = 0;
+    array<reclaim_retired> Retired, HazardRetired;
+    s64 NextScan = RECLAIM_SCAN_THRESHOLD, NextHazardScan = RECLAIM_SCAN_THRESHOLD;
+};
+
+struct reclaim_state {
+    alignas(CACHE_LINE_SIZE) atomic<s64> Epoch;
+
+    atomic<reclaim_record *> Records;  // Push only
+
+    // What threads left behind when they released their records
+    alignas(CACHE_LINE_SIZE) thread::fast_mutex OrphansLock;
+    array<reclaim_retired> Orphans, HazardOrphans;
+    atomic<s64> OrphanCount;
+};
+
+file_scope reclaim_state Reclaim;
+file_scope thread_local reclaim_record *ThisRecord = null;
+
+file_scope reclaim_record *reclaim_get_record() {
+    if (ThisRecord) return ThisRecord;
+
+    auto &s = Reclaim;
+
+    // Reuse one which a thread gave back
+    for (auto *r = s.Records.load(memory_order::Acquire); r; r = r->Next) {
+        s32 expected = 0;
+        if (r->InUse.load(memory_order::Relaxed) == 0 && r->InUse.compare_exchange(expected, 1)) {
+            ThisRecord = r;
+            return r;
+        }
+    }
+
+    auto *r = allocate<reclaim_record>({.Alloc = internal::platform_get_persistent_allocator(), .Alignment = CACHE_LINE_SIZE});
+    r->InUse.store(1, memory_order::Relaxed);
+
+    auto *head = s.Records.load(memory_order::Relaxed);
+    do {
+        r->Next = head;
+    } while (!s.Records.compare_exchange(head, r, memory_order::Release));
+
+    ThisRecord = r;
+    return r;
+}
+
+file_scope void reclaim_append(array<reclaim_retired> &retired, const reclaim_retired &r) {
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        array_append(retired, r);
+    }
+}
+
+file_scope void reclaim_free(const reclaim_retired &r) {
+    if (r.Free) {
+        r.Free(r.Block);
+    } else {
+        general_free(r.Block);
+    }
+}
+
+// Moves the epoch on if every thread in a guard has seen the current one
+file_scope void reclaim_try_advance() {
+    auto &s = Reclaim;
+
+    s64 epoch = s.Epoch.load();
+    for (auto *r = s.Records.load(memory_order::Acquire); r; r = r->Next) {
+        s64 state = r->State.load();
+        if ((state & 1) && (state >> 1) != epoch) return;
+    }
+    s.Epoch.compare_exchange(epoch, epoch + 1);
+}
+
+// Frees the blocks which were retired at least two epochs ago and keeps the rest
+file_scope void reclaim_free_old(array<reclaim_retired> &retired) {
+    s64 epoch = Reclaim.Epoch.load();
+
+    s64 kept = 0;
+    For(retired) {
+        if (it.Epoch + 2 <= epoch) {
+            reclaim_free(it);
+        } else {
+            retired[kept++] = it;
+        }
+    }
+    retired.Count = kept;
+}
+
+// Frees the blocks no hazard pointer points to and keeps the rest
+file_scope void reclaim_free_unprotected(array<reclaim_retired> &retired) {
+    if (!retired.Count) return;
+
+    // Records are few and so are the hazards, a linear search beats building a set
+    array<void *> hazards;
+    defer(free(hazards));
+
+    PUSH_ALLOC(internal::platform_get_persistent_allocator()) {
+        for (auto *r = Reclaim.Records.load(memory_order::Acquire); r; r = r->Next) {
+            For(r->Hazards) {
+                void *p = it.load();
+                if (p) array_append(hazards, p);
+            }
+        }
+    }
+
+    s64 kept = 0;
+    For(retired) {
+        if (has(hazards, it.Block)) {
+            retired[kept++] = it;
+        } else {
+            reclaim_free(it);
+        }
+    }
+    retired.Count = kept;
+}
+
+void reclaim_enter() {
+    auto *r = reclaim_get_record();
+    if (r->Nesting++) return;
+
+    // SeqCst, our reads of the structure can't happen before whoever advances can see that we are in
+    r->State.store((Reclaim.Epoch.load(memory_order::Relaxed) << 1) | 1);
+}
+
+void reclaim_exit() {
+    auto *r = ThisRecord;
+    assert(r && r->Nesting > 0 && "reclaim_exit() without reclaim_enter()");
+
+    if (--r->Nesting) return;
+    r->State.store(0, memory_order::Release);
+}
+
+void reclaim_retire(void *block, void (*free)(void *)) {
+    if (!block) return;
+
+    auto *r = reclaim_get_record();
+    reclaim_append(r->Retired, {block, free, Reclaim.Epoch.load()});
+
+    if (r->Retired.Count >= r->NextScan) {
+        reclaim_try_advance();
+        reclaim_free_old(r->Retired);
+        r->NextScan = max(RECLAIM_SCAN_THRESHOLD, r->Retired.Count * 2);
+    }
+}
+
+void *hazard_protect(s64 slot, void **source) {
+    assert(slot >= 0 && slot < HAZARD_POINTERS_PER_THREAD);
+    auto &hazard = reclaim_get_record()->Hazards[slot];
+
+    // After publishing we look again, if it's still there it couldn't have been retired before we published
+    void *p = atomic_load(source);
+    while (true) {
+        hazard.store(p);
+
+        void *again = atomic_load(source);
+        if (again == p) return p;
+        p = again;
+    }
+}
+
+void hazard_set(s64 slot, void *pointer) {
+    assert(slot >= 0 && slot < HAZARD_POINTERS_PER_THREAD);
+    reclaim_get_record()->Hazards[slot].store(pointer);
+}
+
+void hazard_clear(s64 slot) {
+    assert(slot >= 0 && slot < HAZARD_POINTERS_PER_THREAD);
+    reclaim_get_record()->Hazards[slot].store(null, memory_order::Release);
+}
+
+void hazard_retire(void *block, void (*free)(void *)) {
+    if (!block) return;
+
+    auto *r = reclaim_get_record();
+    reclaim_append(r->HazardRetired, {block, free, 0});
+
+    if (r->HazardRetired.Count >= r->NextHazardScan) {
+        reclaim_free_unprotected(r->HazardRetired);
+        r->NextHazardScan = max(RECLAIM_SCAN_THRESHOLD, r->HazardRetired.Count * 2);
+    }
+}
+
+void reclaim_flush() {
+    auto &s = Reclaim;
+
+    reclaim_try_advance();
+
+    if (auto *r = ThisRecord) {
+        reclaim_free_old(r->Retired);
+        reclaim_free_unprotected(r->HazardRetired);
+    }
+
+    if (s.OrphanCount.load(memory_order::Relaxed) && s.OrphansLock.try_lock()) {
+        defer(s.OrphansLock.unlock());
+
+        reclaim_free_old(s.Orphans);
+        reclaim_free_unprotected(s.HazardOrphans);
+        s.OrphanCount.store(s.Orphans.Count + s.HazardOrphans.Count, memory_order::Relaxed);
+    }
+}
+
+void reclaim_thread_release() {
+    auto *r = ThisRecord;
+    if (!r) return;
+
+    assert(!r->Nesting && "Releasing the reclamation record of a thread which is in a guard");
+    For(r->Hazards) it.store(null, memory_order::Release);
+
+    reclaim_flush();
+
+    // The rest goes to whoever flushes next
+    if (r->Retired.Count || r->HazardRetired.Count) {
+        auto &s = Reclaim;
+        thread::scoped_lock _(&s.OrphansLock);
+
+        For(r->Retired) reclaim_append(s.Orphans, it);
+        For(r->HazardRetired) reclaim_append(s.HazardOrphans, it);
+        s.OrphanCount.store(s.Orphans.Count + s.HazardOrphans.Count, memory_order::Relaxed);
+
+        r->Retired.Count = r->HazardRetired.Count = 0;
+    }
+
+    // The arrays stay with the record for the next thread which takes it
+    r->NextScan = r->NextHazardScan = RECLAIM_SCAN_THRESHOLD;
+    r->InUse.store(0, memory_order::Release);
+    ThisRecord = null;
+}
+
+LSTD_END_NAMESPACE
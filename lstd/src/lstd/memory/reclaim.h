@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../atomic.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Deferred freeing for lock-free structures: a node which was unlinked may still be read by threads which loaded
+// a pointer to it before, so it can't be freed right away. Retire it instead and it's freed once nobody can
+// be looking at it anymore.
+//
+// Epoch based reclamation (the default, cheap for short reads):
+//
+//     {
+//         reclaim_guard _;                 // Nothing retired from here on is freed before we leave
+//         auto *node = atomic_load(&Head);
+//         ... read node ...
+//     }
+//
+//     // In a writer, after the node is unreachable for new readers:
+//     reclaim_retire(node);               // general_free()d later
+//     reclaim_retire(node, free_node);    // Or with your own function
+//
+// There is a global epoch and a thread in a guard announces the epoch it saw when it entered. The epoch moves on
+// only when every thread in a guard has seen the current one, so something retired in epoch E is unreachable
+// for everyone once the epoch reaches E + 2. Entering and leaving a guard is a store and a fence, nothing is
+// shared between readers. Guards nest.
+//
+// Don't block or stay in a guard for long, no memory retired by anyone is freed while you are in it.
+// Guards and hazard slots belong to the thread, so hold neither across job_wait() when the job system runs with fibers.
+// For references which are held for a long time (across blocking calls, while iterating slowly...) use hazard
+// pointers instead, they only hold back what they point to:
+//
+//     void *p = hazard_protect(0, (void **) &Head);   // Loads Head and keeps what it pointed to alive
+//     ...
+//     hazard_clear(0);
+//
+//     hazard_retire(node);                            // Freed when no hazard pointer points to it
+//
+// Each thread has _HAZARD_POINTERS_PER_THREAD_ slots. Memory retired with one scheme must only be read under
+// the same scheme.
+//
+// Every thread which uses either gets a record on first use (allocated with the persistent allocator, never freed,
+// reused by later threads). Retired blocks are freed on the thread which retired them, when it has retired a bunch
+// of them or calls reclaim_flush(). Call reclaim_thread_release() before a thread exits, blocks it couldn't free
+// yet are handed to the next thread which flushes. Job system workers do both by themselves (they flush when they
+// run out of work and release when the job system stops).
+//
+
+constexpr s64 HAZARD_POINTERS_PER_THREAD = 4;
+
+// Enters a critical section for the calling thread, see the comment above.
+void reclaim_enter();
+void reclaim_exit();
+
+struct reclaim_guard : non_copyable {
+    reclaim_guard() { reclaim_enter(); }
+    ~reclaim_guard() { reclaim_exit(); }
+};
+
+// Frees _block_ with _free_ (general_free by default) once no thread can be in a guard which started before this call.
+void reclaim_retire(void *block, void (*free)(void *) = null);
+
+// Loads the pointer at _source_ and publishes it in hazard slot _slot_ of the calling thread (retrying until
+// it's still the same after publishing). Until the slot is cleared or reused, what it points to isn't freed
+// by hazard_retire().
+void *hazard_protect(s64 slot, void **source);
+
+// Publishes an already loaded pointer, the caller must check that it's still reachable afterwards.
+void hazard_set(s64 slot, void *pointer);
+void hazard_clear(s64 slot);
+
+// Frees _block_ with _free_ (general_free by default) once no hazard slot points to it.
+void hazard_retire(void *block, void (*free)(void *) = null);
+
+// Tries to move the epoch on and frees what the calling thread retired (and what exited threads left behind)
+// which is safe to free now. Call it when a thread is idle.
+void reclaim_flush();
+
+// Flushes and gives the record of the calling thread back, it must not be in a guard or hold hazard pointers.
+void reclaim_thread_release();
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A FIFO (or LIFO, you can push and pop at both ends) which stores its elements in a circular buffer.
+// All pushes and pops are O(1) (pushing grows the buffer when it's full, that moves the elements).
+//
+//     ring_buffer<job> jobs;
+//     push_back(jobs, j);
+//     ...
+//     while (jobs.Count) {
+//         job j = pop_front(jobs);
+//     }
+//
+// The capacity is always a power of two, so wrapping an index is just a mask.
+//
+// For batch consumption, use front_span() to get the elements which are contiguous in memory,
+// process them and then drop them with consume().
+//
+// Note: We flag this as not array-like, the elements aren't in order in _Data_ (see array_like.h).
+template <typename T_>
+struct ring_buffer {
+    using T = T_;
+    static constexpr bool IS_ARRAY = false;
+
+    T *Data = null;
+    s64 Count = 0;
+    s64 Allocated = 0;  // Always 0 or a power of two
+    s64 Head = 0;       // Index in _Data_ of the first element
+
+    ring_buffer() {}
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        using ring_buffer_t = types::select_t<Const, const ring_buffer<T>, ring_buffer<T>>;
+        using element_t = types::select_t<Const, const T, T>;
+
+        ring_buffer_t *Parent;
+        s64 Index;
+
+        iterator_(ring_buffer_t *parent, s64 index) : Parent(parent), Index(index) {}
+
+        iterator_ &operator++() {
+            ++Index;
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        element_t &operator*() { return (*Parent)[Index]; }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, Count); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, Count); }
+
+    // _index_ is from the front (0 is the first element). Negative indices start from the back.
+    T &operator[](s64 index) { return Data[(Head + translate_index(index, Count)) & (Allocated - 1)]; }
+    const T &operator[](s64 index) const { return Data[(Head + translate_index(index, Count)) & (Allocated - 1)]; }
+};
+
+template <typename T>
+struct is_ring_buffer : types::false_t {};
+
+template <typename T>
+struct is_ring_buffer<ring_buffer<T>> : types::true_t {};
+
+template <typename T>
+concept any_ring_buffer = is_ring_buffer<T>::value;
+
+// Makes sure there is space for at least _n_ more elements without growing.
+// When we grow, the elements are moved to the beginning of the new buffer (so they are not wrapped anymore).
+template <any_ring_buffer T>
+void reserve(T &rb, s64 n) {
+    using V = typename T::T;
+
+    if (rb.Count + n <= rb.Allocated) return;
+
+    s64 target = max<s64>(ceil_pow_of_2(rb.Count + n), 8);
+
+    auto *data = allocate_array<V>(target);
+    if (rb.Count) {
+        s64 firstPart = min(rb.Count, rb.Allocated - rb.Head);
+        copy_elements(data, rb.Data + rb.Head, firstPart);
+        copy_elements(data + firstPart, rb.Data, rb.Count - firstPart);
+    }
+    if (rb.Allocated) free(rb.Data);
+
+    rb.Data = data;
+    rb.Allocated = target;
+    rb.Head = 0;
+}
+
+// Call destructor on each element, keeps the memory.
+template <any_ring_buffer T>
+void reset(T &rb) {
+    For(range(rb.Count)) destroy_at(&rb[it]);
+    rb.Count = 0;
+    rb.Head = 0;
+}
+
+// Call destructor on each element and free the memory.
+template <any_ring_buffer T>
+void free(T &rb) {
+    reset(rb);
+    if (rb.Allocated) free(rb.Data);
+    rb.Data = null;
+    rb.Allocated = 0;
+}
+
+// Adds a shallow copy of _element_ at the back and returns a pointer to it.
+template <any_ring_buffer T>
+auto *push_back(T &rb, const typename T::T &element) {
+    reserve(rb, 1);
+
+    auto *where = rb.Data + ((rb.Head + rb.Count) & (rb.Allocated - 1));
+    copy_elements(where, &element, 1);
+    ++rb.Count;
+    return where;
+}
+
+// Adds shallow copies of _n_ elements at the back (with at most two copies).
+template <any_ring_buffer T>
+void push_back(T &rb, const typename T::T *elements, s64 n) {
+    reserve(rb, n);
+
+    s64 tail = (rb.Head + rb.Count) & (rb.Allocated - 1);
+    s64 firstPart = min(n, rb.Allocated - tail);
+    copy_elements(rb.Data + tail, elements, firstPart);
+    copy_elements(rb.Data, elements + firstPart, n - firstPart);
+    rb.Count += n;
+}
+
+// Adds a shallow copy of _element_ at the front and returns a pointer to it.
+template <any_ring_buffer T>
+auto *push_front(T &rb, const typename T::T &element) {
+    reserve(rb, 1);
+
+    rb.Head = (rb.Head - 1) & (rb.Allocated - 1);
+    copy_elements(rb.Data + rb.Head, &element, 1);
+    ++rb.Count;
+    return rb.Data + rb.Head;
+}
+
+// Removes the first element and returns it (doesn't call the destructor, the caller owns the result).
+template <any_ring_buffer T>
+auto pop_front(T &rb) {
+    assert(rb.Count && "Popping from an empty ring buffer");
+
+    auto result = rb.Data[rb.Head];
+    rb.Head = (rb.Head + 1) & (rb.Allocated - 1);
+    --rb.Count;
+    return result;
+}
+
+// Removes the last element and returns it (doesn't call the destructor, the caller owns the result).
+template <any_ring_buffer T>
+auto pop_back(T &rb) {
+    assert(rb.Count && "Popping from an empty ring buffer");
+
+    --rb.Count;
+    return rb.Data[(rb.Head + rb.Count) & (rb.Allocated - 1)];
+}
+
+// Returns a view of the elements from the front which are contiguous in memory (all of them if the buffer isn't wrapped).
+// The view is invalidated by pushing.
+template <any_ring_buffer T>
+auto front_span(const T &rb) {
+    using V = typename T::T;
+    if (!rb.Count) return array<V>();
+    return array<V>(rb.Data + rb.Head, min(rb.Count, rb.Allocated - rb.Head));
+}
+
+// Drops _n_ elements from the front (calling their destructors), use after processing a front_span().
+template <any_ring_buffer T>
+void consume(T &rb, s64 n) {
+    assert(n <= rb.Count);
+
+    For(range(n)) destroy_at(&rb[it]);
+    rb.Head = (rb.Head + n) & (rb.Allocated - 1);
+    rb.Count -= n;
+}
+
+template <typename T>
+ring_buffer<T> *clone(ring_buffer<T> *dest, const ring_buffer<T> &src) {
+    free(*dest);
+    reserve(*dest, src.Count);
+    For(src) clone(push_back(*dest, {}), it);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
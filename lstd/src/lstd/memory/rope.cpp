@@ -0,0 +1,241 @@
+#include "rope.h"
+
+#include "../internal/context.h"
+#include "hash.h"
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope s64 node_bytes(rope_node *n) { return n ? n->Bytes : 0; }
+file_scope s64 node_length(rope_node *n) { return n ? n->Length : 0; }
+
+// Recalculates the cached counts of _n_ from its children
+file_scope void update(rope_node *n) {
+    n->Bytes = n->ChunkBytes + node_bytes(n->Left) + node_bytes(n->Right);
+    n->Length = n->ChunkLength + node_length(n->Left) + node_length(n->Right);
+}
+
+file_scope rope_node *new_node(rope &r, const utf8 *data, s64 bytes, s64 length) {
+    auto *n = allocate<rope_node>();
+    n->Priority = hash_u64(++r.Seed);
+    copy_memory(n->Chunk, data, bytes);
+    n->ChunkBytes = bytes;
+    n->ChunkLength = length;
+    update(n);
+    return n;
+}
+
+file_scope void free_nodes(rope_node *n) {
+    if (!n) return;
+    free_nodes(n->Left);
+    free_nodes(n->Right);
+    free(n);
+}
+
+// Joins two trees, everything in _a_ goes before everything in _b_.
+file_scope rope_node *merge(rope_node *a, rope_node *b) {
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->Priority > b->Priority) {
+        a->Right = merge(a->Right, b);
+        update(a);
+        return a;
+    } else {
+        b->Left = merge(a, b->Left);
+        update(b);
+        return b;
+    }
+}
+
+// Splits _n_ into the first _index_ code points (_outLeft_) and the rest (_outRight_).
+// If the split point falls inside a chunk, the chunk is cut into two nodes.
+file_scope void split(rope &r, rope_node *n, s64 index, rope_node **outLeft, rope_node **outRight) {
+    if (!n) {
+        *outLeft = *outRight = null;
+        return;
+    }
+
+    s64 leftLength = node_length(n->Left);
+    if (index <= leftLength) {
+        split(r, n->Left, index, outLeft, &n->Left);
+        update(n);
+        *outRight = n;
+    } else if (index >= leftLength + n->ChunkLength) {
+        split(r, n->Right, index - leftLength - n->ChunkLength, &n->Right, outRight);
+        update(n);
+        *outLeft = n;
+    } else {
+        // Cut the chunk, _n_ keeps the head and its left subtree, the tail goes in front of the right subtree
+        s64 offset = index - leftLength;
+        s64 byteOffset = get_cp_at_index(n->Chunk, offset) - n->Chunk;
+
+        auto *tail = new_node(r, n->Chunk + byteOffset, n->ChunkBytes - byteOffset, n->ChunkLength - offset);
+        n->ChunkBytes = byteOffset;
+        n->ChunkLength = offset;
+
+        rope_node *right = n->Right;
+        n->Right = null;
+        update(n);
+
+        *outLeft = n;
+        *outRight = merge(tail, right);
+    }
+}
+
+// Builds a tree from _str_, cut into chunks at code point boundaries.
+file_scope rope_node *build(rope &r, const string &str) {
+    rope_node *result = null;
+
+    const utf8 *p = str.Data, *end = str.Data + str.Count;
+    while (p != end) {
+        const utf8 *chunkStart = p;
+        s64 length = 0;
+        while (p != end) {
+            s64 size = get_size_of_cp(p);
+            if (p + size - chunkStart > ROPE_CHUNK_SIZE) break;
+            p += size;
+            ++length;
+        }
+        result = merge(result, new_node(r, chunkStart, p - chunkStart, length));
+    }
+    return result;
+}
+
+// If _str_ fits in the chunk which contains _index_, inserts it there and returns true.
+file_scope bool insert_in_place(rope_node *root, s64 index, const string &str) {
+    // First find the node (so we don't touch the counts if it doesn't fit)
+    rope_node *n = root;
+    s64 k = index;
+    while (true) {
+        s64 leftLength = node_length(n->Left);
+        if (n->Left && k < leftLength) {
+            n = n->Left;
+        } else if (k <= leftLength + n->ChunkLength) {
+            k -= leftLength;
+            break;
+        } else {
+            k -= leftLength + n->ChunkLength;
+            n = n->Right;
+        }
+    }
+    if (n->ChunkBytes + str.Count > ROPE_CHUNK_SIZE) return false;
+
+    s64 offset = k;
+
+    // Walk the same path again and add to the counts
+    rope_node *p = root;
+    k = index;
+    while (true) {
+        p->Bytes += str.Count;
+        p->Length += str.Length;
+        if (p == n) break;
+
+        s64 leftLength = node_length(p->Left);
+        if (p->Left && k < leftLength) {
+            p = p->Left;
+        } else {
+            k -= leftLength + p->ChunkLength;
+            p = p->Right;
+        }
+    }
+
+    s64 byteOffset = get_cp_at_index(n->Chunk, offset) - n->Chunk;
+    copy_memory(n->Chunk + byteOffset + str.Count, n->Chunk + byteOffset, n->ChunkBytes - byteOffset);
+    copy_memory(n->Chunk + byteOffset, str.Data, str.Count);
+    n->ChunkBytes += str.Count;
+    n->ChunkLength += str.Length;
+    return true;
+}
+
+void rope_insert_at(rope &r, s64 index, const string &str) {
+    if (!str.Count) return;
+
+    index = translate_index(index, rope_length(r), true);
+
+    if (r.Root && insert_in_place(r.Root, index, str)) return;
+
+    rope_node *left, *right;
+    split(r, r.Root, index, &left, &right);
+    r.Root = merge(merge(left, build(r, str)), right);
+}
+
+void rope_remove_range(rope &r, s64 begin, s64 end) {
+    s64 length = rope_length(r);
+    begin = translate_index(begin, length, true);
+    end = translate_index(end, length, true);
+    assert(end >= begin);
+
+    if (begin == end) return;
+
+    rope_node *left, *middle, *right;
+    split(r, r.Root, begin, &left, &middle);
+    split(r, middle, end - begin, &middle, &right);
+
+    free_nodes(middle);
+    r.Root = merge(left, right);
+}
+
+utf32 rope_get(const rope &r, s64 index) {
+    index = translate_index(index, rope_length(r));
+
+    rope_node *n = r.Root;
+    while (true) {
+        s64 leftLength = node_length(n->Left);
+        if (index < leftLength) {
+            n = n->Left;
+        } else if (index < leftLength + n->ChunkLength) {
+            return decode_cp(get_cp_at_index(n->Chunk, index - leftLength));
+        } else {
+            index -= leftLength + n->ChunkLength;
+            n = n->Right;
+        }
+    }
+}
+
+file_scope void traverse(rope_node *n, const delegate<void(const string &)> &func) {
+    if (!n) return;
+    traverse(n->Left, func);
+
+    string chunk;
+    chunk.Data = n->Chunk;
+    chunk.Count = n->ChunkBytes;
+    chunk.Length = n->ChunkLength;
+    func(chunk);
+
+    traverse(n->Right, func);
+}
+
+void rope_traverse(const rope &r, const delegate<void(const string &)> &func) { traverse(r.Root, func); }
+
+string rope_to_string(const rope &r) {
+    string result;
+    string_reserve(result, rope_count(r));
+
+    auto appender = [&](const string &chunk) {
+        copy_memory(result.Data + result.Count, chunk.Data, chunk.Count);
+        result.Count += chunk.Count;
+        result.Length += chunk.Length;
+    };
+    rope_traverse(r, &appender);
+    return result;
+}
+
+void free(rope &r) {
+    free_nodes(r.Root);
+    r.Root = null;
+}
+
+rope *clone(rope *dest, const rope &src) {
+    free(*dest);
+
+    auto appender = [&](const string &chunk) { dest->Root = merge(dest->Root, new_node(*dest, chunk.Data, chunk.Count, chunk.Length)); };
+    rope_traverse(src, &appender);
+    return dest;
+}
+
+void write(writer *w, const rope &r) {
+    auto writeChunk = [&](const string &chunk) { w->write((const byte *) chunk.Data, chunk.Count); };
+    rope_traverse(r, &writeChunk);
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../io/writer.h"
+#include "delegate.h"
+#include "string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A rope - a string stored as a balanced tree of chunks, for editing large texts.
+//
+// Inserting into and removing from a normal string moves everything after the edit (and translating
+// a code point index to a byte offset walks the whole string up to it). With a rope these are O(log n) -
+// each node caches the byte and code point counts of its subtree, so we find the chunk which contains
+// an index by walking down the tree, and edits only touch that chunk (or split and merge subtrees).
+//
+//     rope text;
+//     defer(free(text));
+//
+//     rope_insert_at(text, 0, fileContents);
+//     rope_insert_at(text, 1000, "inserted");
+//     rope_remove_range(text, 5, 10);
+//
+//     write(&console, text);  // Writes the chunks one after another, never makes one big string
+//
+// Indices are in code points and may be negative (like with string). A chunk never splits a code point.
+//
+// The tree is a treap - each node has a random priority and parents have higher priorities than their children,
+// which keeps the tree balanced (expected depth O(log n)) without rotations bookkeeping.
+//
+// Small inserts go into the chunk at the index if there is room, so typing character by character
+// fills chunks instead of creating a node per insert.
+//
+
+// So a node with its header is about 1 KiB
+constexpr s64 ROPE_CHUNK_SIZE = 1_KiB - 64;
+
+struct rope_node {
+    rope_node *Left = null, *Right = null;
+    u64 Priority = 0;
+
+    // Of the whole subtree
+    s64 Bytes = 0;
+    s64 Length = 0;
+
+    // Of this node's chunk
+    s64 ChunkBytes = 0;
+    s64 ChunkLength = 0;
+    utf8 Chunk[ROPE_CHUNK_SIZE];
+};
+
+struct rope {
+    rope_node *Root = null;
+    u64 Seed = 0;  // For node priorities
+
+    rope() {}
+};
+
+// Number of code points
+inline s64 rope_length(const rope &r) { return r.Root ? r.Root->Length : 0; }
+
+// Number of bytes
+inline s64 rope_count(const rope &r) { return r.Root ? r.Root->Bytes : 0; }
+
+// Inserts _str_ before the code point at _index_ (_index_ may be equal to the length to append).
+void rope_insert_at(rope &r, s64 index, const string &str);
+
+inline void rope_append(rope &r, const string &str) { rope_insert_at(r, rope_length(r), str); }
+
+// Removes the code points in [begin, end).
+void rope_remove_range(rope &r, s64 begin, s64 end);
+
+// Returns the code point at _index_.
+utf32 rope_get(const rope &r, s64 index);
+
+// Calls _func_ with each chunk in order (the views are valid until the rope is modified).
+void rope_traverse(const rope &r, const delegate<void(const string &)> &func);
+
+// Allocates one contiguous string with the contents of the rope (using the Context's allocator).
+[[nodiscard("Leak")]] string rope_to_string(const rope &r);
+
+// Frees all nodes.
+void free(rope &r);
+
+rope *clone(rope *dest, const rope &src);
+
+// Writes the chunks in order, without flattening the rope.
+void write(writer *w, const rope &r);
+
+LSTD_END_NAMESPACE
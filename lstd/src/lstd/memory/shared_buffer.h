@@ -0,0 +1,124 @@
+#pragma once
+
+#include "delegate.h"
+#include "string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// An immutable, reference counted block of bytes, for handing one big payload (a loaded file, a network
+// message, a generated string) to many consumers (threads, queues, caches) without copying it for each one.
+//
+//     shared_buffer payload = make_shared_buffer(fileContents);  // The only copy
+//     defer(free(payload));
+//
+//     For(consumers) {
+//         shared_buffer ref;
+//         clone(&ref, payload);  // Doesn't copy, just takes a reference - the consumer free()s it when it's done
+//         send(it, ref);
+//     }
+//
+//     string s = payload;  // A view, valid while the reference it came from is alive
+//
+// The count and the bytes are in one allocation (header first), so taking a reference is one atomic increment
+// and reading the bytes doesn't chase another pointer. free() drops a reference, the last one frees the block
+// (with the allocator it was made with, whichever thread that happens on).
+//
+// The contents never change after the buffer is made, that's what makes sharing between threads safe without a lock.
+// The bytes are zero terminated (not counted in _Count_), so they can go to C APIs as they are.
+//
+
+struct alignas(16) shared_buffer_header {
+    s64 RefCount;
+    s64 Count;   // In bytes
+    s64 Length;  // In code points, -1 until a string view is asked for (it's not needed for binary payloads)
+};
+
+struct shared_buffer {
+    shared_buffer_header *Header = null;
+
+    shared_buffer() {}
+
+    const byte *data() const { return Header ? (const byte *) (Header + 1) : null; }
+    s64 count() const { return Header ? Header->Count : 0; }
+
+    // Views of the contents. They don't reference the buffer, keep the shared_buffer alive while using them.
+    operator string() const;
+    operator bytes() const { return bytes((byte *) data(), count()); }
+};
+
+// Allocates a buffer with _count_ bytes and lets _fill_ write them, for contents which aren't in memory yet
+// (read from a file, decompressed, formatted) so they don't get copied. _fill_ runs before anyone can see the buffer.
+[[nodiscard("Leak")]] inline shared_buffer make_shared_buffer(s64 count, const delegate<void(byte *data)> &fill, allocator alloc = {}) {
+    assert(count >= 0);
+
+    shared_buffer result;
+
+    auto *block = allocate_array_uninitialized<byte>(sizeof(shared_buffer_header) + count + 1, {.Alloc = alloc, .Alignment = 16});
+    result.Header = (shared_buffer_header *) block;
+
+    result.Header->RefCount = 1;
+    result.Header->Count = count;
+    result.Header->Length = -1;
+
+    byte *data = block + sizeof(shared_buffer_header);
+    if (fill) fill(data);
+    data[count] = 0;
+
+    return result;
+}
+
+// Copies _count_ bytes from _data_ into a new buffer
+[[nodiscard("Leak")]] inline shared_buffer make_shared_buffer(const void *data, s64 count, allocator alloc = {}) {
+    auto copy = [&](byte *out) { copy_memory(out, data, count); };
+    return make_shared_buffer(count, &copy, alloc);
+}
+
+// Copies _str_ into a new buffer (its length is kept, so string views of it are free)
+[[nodiscard("Leak")]] inline shared_buffer make_shared_buffer(const string &str, allocator alloc = {}) {
+    shared_buffer result = make_shared_buffer(str.Data, str.Count, alloc);
+    result.Header->Length = str.Length;
+    return result;
+}
+
+inline shared_buffer::operator string() const {
+    if (!Header) return {};
+
+    // Threads which race here compute the same value, so storing it twice is harmless
+    s64 length = atomic_load(&Header->Length);
+    if (length < 0) {
+        length = utf8_length((const utf8 *) data(), Header->Count);
+        atomic_store(&Header->Length, length);
+    }
+
+    string result;
+    result.Data = (utf8 *) data();
+    result.Count = Header->Count;
+    result.Length = length;
+    return result;
+}
+
+// Makes _dest_ another reference to the contents of _src_ (no copy)
+inline shared_buffer *clone(shared_buffer *dest, const shared_buffer &src) {
+    if (src.Header) atomic_inc(&src.Header->RefCount);
+    dest->Header = src.Header;
+    return dest;
+}
+
+// Drops this reference, the last one frees the buffer
+inline void free(shared_buffer &buffer) {
+    if (!buffer.Header) return;
+
+    if (atomic_add(&buffer.Header->RefCount, (s64) -1) == 1) free<byte>((byte *) buffer.Header);
+    buffer.Header = null;
+}
+
+// The number of live references, only a hint when other threads hold some
+inline s64 shared_buffer_ref_count(const shared_buffer &buffer) { return buffer.Header ? atomic_load(&buffer.Header->RefCount) : 0; }
+
+inline bool operator==(const shared_buffer &lhs, const shared_buffer &rhs) {
+    if (lhs.Header == rhs.Header) return true;
+    return lhs.count() == rhs.count() && equal_memory(lhs.data(), rhs.data(), lhs.count());
+}
+
+LSTD_END_NAMESPACE
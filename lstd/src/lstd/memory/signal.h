@@ -103,13 +103,15 @@ struct collector_invocation;
 // Specialization for regular signals.
 template <typename Collector, typename R, typename... Args>
 struct collector_invocation<Collector, R(Args...)> {
-    bool invoke(Collector &collector, const delegate<R(Args...)> &cb, Args... args) { return collector(cb(args...)); }
+    template <typename Callback>
+    bool invoke(Collector &collector, const Callback &cb, Args... args) { return collector(cb(args...)); }
 };
 
 // Specialization for signals with void return type.
 template <typename Collector, typename... Args>
 struct collector_invocation<Collector, void(Args...)> {
-    bool invoke(Collector &collector, const delegate<void(Args...)> &cb, Args... args) {
+    template <typename Callback>
+    bool invoke(Collector &collector, const Callback &cb, Args... args) {
         cb(args...);
         return collector();
     }
@@ -119,10 +121,12 @@ struct collector_invocation<Collector, void(Args...)> {
 template <typename Signature, typename Collector = collector_default<typename delegate<Signature>::return_t>>
 struct signal;
 
+// The callbacks are owning_delegates, so a lambda can be connected by value and doesn't have to outlive the signal.
+// Disconnecting a callback (or releasing the signal) frees whatever it allocated.
 template <typename R, typename... Args, typename Collector>
 struct signal<R(Args...), Collector> : public non_copyable {
     using result_t = R;
-    using callback_t = delegate<R(Args...)>;
+    using callback_t = owning_delegate<R(Args...)>;
     using collector_result_t = typename Collector::result_t;
 
     array<callback_t> Callbacks;
@@ -140,6 +144,7 @@ struct signal<R(Args...), Collector> : public non_copyable {
     // ~signal() { release(); }
 
     void release() {
+        For(Callbacks) free(it);
         free(Callbacks);
         free(ToRemove);
     }
@@ -156,7 +161,7 @@ struct signal<R(Args...), Collector> : public non_copyable {
         if (!CurrentlyEmitting) {
             assert(index <= Callbacks.Count);
             if (Callbacks[index]) {
-                Callbacks[index] = null;
+                free(Callbacks[index]);
                 return true;
             }
             return false;
@@ -181,7 +186,7 @@ struct signal<R(Args...), Collector> : public non_copyable {
 
         For(ToRemove) {
             assert(it <= Callbacks.Count);
-            if (Callbacks[it]) Callbacks[it] = null;
+            if (Callbacks[it]) free(Callbacks[it]);
         }
         array_reset(ToRemove);
 
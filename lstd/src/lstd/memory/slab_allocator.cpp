@@ -0,0 +1,167 @@
+#include "allocator.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// Returns the index of the smallest size class which fits _size_.
+// Classes go: 16, 24, 32, 48, 64, 96, 128, ... (powers of 2 and the midpoints between them).
+file_scope always_inline s64 slab_size_class(s64 size) {
+    if (size <= 16) return 0;
+
+    s32 p = msb((u64) size - 1);  // 2^p < size <= 2^(p + 1)
+    return 2 * (p - 4) + (size <= (3ll << (p - 1)) ? 1 : 2);
+}
+
+file_scope always_inline s64 slab_class_size(s64 index) {
+    if (index == 0) return 16;
+    if (index & 1) return 3ll << ((index - 1) / 2 + 3);
+    return 1ll << (index / 2 + 4);
+}
+
+// Takes _data->SlabSize_ bytes from the first pool which has enough space left.
+file_scope byte *slab_take_from_pools(slab_allocator_data *data) {
+    auto *p = data->Base;
+    while (p) {
+        if (p->Used + data->SlabSize <= p->Size) {
+            byte *result = (byte *) (p + 1) + p->Used;
+            p->Used += data->SlabSize;
+            return result;
+        }
+        p = p->Next;
+    }
+    return null;
+}
+
+void *slab_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    auto *data = (slab_allocator_data *) context;
+
+    switch (mode) {
+        case allocator_mode::ADD_POOL: {
+            auto *pool = (allocator_pool *) oldMemory;  // _oldMemory_ is the parameter which should contain the block to be added
+                                                        // the _size_ parameter contains the size of the block
+
+            if (!allocator_pool_initialize(pool, size)) return null;
+            allocator_pool_add_to_linked_list(&data->Base, pool);
+            ++data->PoolsCount;
+            return pool;
+        }
+        case allocator_mode::REMOVE_POOL: {
+            auto *pool = (allocator_pool *) oldMemory;
+
+            // Free lists may point inside the pool, so we can't remove it while it's in use.
+            // Call FREE_ALL first.
+            assert(pool->Used == 0 && "Removing a pool which still has slabs handed out");
+
+            void *result = allocator_pool_remove_from_linked_list(&data->Base, pool);
+            if (result) {
+                --data->PoolsCount;
+                assert(data->PoolsCount >= 0);
+                return result;
+            }
+            return null;
+        }
+        case allocator_mode::ALLOCATE: {
+            if (size > SLAB_MAX_BLOCK_SIZE) return null;  // Too large, use another allocator for this
+            assert(data->SlabSize >= SLAB_MAX_BLOCK_SIZE);
+
+            s64 c = slab_size_class(size);
+
+            if (data->FreeLists[c]) {
+                void *result = data->FreeLists[c];
+                data->FreeLists[c] = *(void **) result;
+                return result;
+            }
+
+            s64 blockSize = slab_class_size(c);
+            if (!data->SlabCurrent[c] || data->SlabCurrent[c] + blockSize > data->SlabEnd[c]) {
+                // The rest of the old slab (less than one block) is wasted
+                byte *slab = slab_take_from_pools(data);
+                if (!slab) return null;  // Not enough space
+
+                data->SlabCurrent[c] = slab;
+                data->SlabEnd[c] = slab + data->SlabSize;
+            }
+
+            void *result = data->SlabCurrent[c];
+            data->SlabCurrent[c] += blockSize;
+            return result;
+        }
+        case allocator_mode::RESIZE: {
+            if (size > SLAB_MAX_BLOCK_SIZE) return null;
+
+            // We can grow/shrink in place only if the block has the same size class
+            if (slab_size_class(size) == slab_size_class(oldSize)) return oldMemory;
+            return null;
+        }
+        case allocator_mode::FREE: {
+            s64 c = slab_size_class(oldSize);
+            *(void **) oldMemory = data->FreeLists[c];
+            data->FreeLists[c] = oldMemory;
+
+            // null means success FREE
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            For(range(SLAB_SIZE_CLASS_COUNT)) {
+                data->FreeLists[it] = null;
+                data->SlabCurrent[it] = null;
+                data->SlabEnd[it] = null;
+            }
+
+            auto *p = data->Base;
+            while (p) {
+                p->Used = 0;
+                p = p->Next;
+            }
+
+            // null means successful FREE_ALL
+            // (void *) -1 means that the allocator doesn't support FREE_ALL (by design)
+            return null;
+        }
+        case allocator_mode::ALLOCATE_BATCH: {
+            if (size > SLAB_MAX_BLOCK_SIZE) return oldMemory;  // Nothing filled
+            assert(data->SlabSize >= SLAB_MAX_BLOCK_SIZE);
+
+            auto **out = (void **) oldMemory;
+            auto **end = out + oldSize;
+
+            s64 c = slab_size_class(size);
+            s64 blockSize = slab_class_size(c);
+
+            while (out != end && data->FreeLists[c]) {
+                *out = data->FreeLists[c];
+                data->FreeLists[c] = *(void **) *out;
+                ++out;
+            }
+
+            while (out != end) {
+                if (!data->SlabCurrent[c] || data->SlabCurrent[c] + blockSize > data->SlabEnd[c]) {
+                    byte *slab = slab_take_from_pools(data);
+                    if (!slab) break;  // Not enough space
+
+                    data->SlabCurrent[c] = slab;
+                    data->SlabEnd[c] = slab + data->SlabSize;
+                }
+
+                *out++ = data->SlabCurrent[c];
+                data->SlabCurrent[c] += blockSize;
+            }
+            return out;
+        }
+        case allocator_mode::FREE_BATCH: {
+            // All blocks have the same size, so they go to the same free list
+            s64 c = slab_size_class(size);
+
+            auto **blocks = (void **) oldMemory;
+            For(range(oldSize)) {
+                *(void **) blocks[it] = data->FreeLists[c];
+                data->FreeLists[c] = blocks[it];
+            }
+            return null;
+        }
+        default:
+            assert(false);
+    }
+    return null;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// A handle to an element of a slot_map. Stays valid until that element is removed,
+// after that the map rejects the handle (even if its slot has been reused by another element).
+// A zero-initialized handle is never valid, so you can use it as "null".
+struct slot_map_handle {
+    u32 Index = 0;
+    u32 Generation = 0;
+};
+
+inline bool operator==(slot_map_handle a, slot_map_handle b) { return a.Index == b.Index && a.Generation == b.Generation; }
+inline bool operator!=(slot_map_handle a, slot_map_handle b) { return !(a == b); }
+
+// A container which hands out stable handles to its elements (use it for entity tables, connection tables, etc.
+// where other systems hold on to references and the element may be gone by the time they use them).
+//
+//     slot_map<entity> entities;
+//
+//     auto handle = add(entities, e);
+//     ...
+//     auto *e = find(entities, handle);  // null if the entity was removed in the meantime
+//     remove(entities, handle);
+//
+//     For(entities) { ... }  // Iterates the elements, tightly packed in memory
+//
+// Adding, removing and looking up are O(1).
+//
+// The elements live in _Data_ without holes (removing moves the last element into the gap, so don't keep
+// pointers to elements across removals, keep handles). A handle points into _Slots_ which says where the element
+// is in _Data_ and which generation the slot is on. Removing bumps the generation of the slot, so old handles to it
+// stop matching. Free slots form a linked list through their _DenseIndex_ and get reused first.
+template <typename T_>
+struct slot_map {
+    using T = T_;
+
+    static constexpr u32 NO_SLOT = (u32) -1;
+
+    struct slot {
+        u32 DenseIndex = 0;  // Index in _Data_, or the next free slot if this one is free
+        u32 Generation = 1;
+    };
+
+    array<T> Data;
+    array<u32> DenseToSlot;  // For each element, which slot points to it (so we can fix the slot of the element we move on remove)
+    array<slot> Slots;
+
+    u32 FreeHead = NO_SLOT;
+
+    slot_map() {}
+
+    //
+    // Iterators:
+    //
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    iterator begin() { return Data.begin(); }
+    iterator end() { return Data.end(); }
+    const_iterator begin() const { return Data.begin(); }
+    const_iterator end() const { return Data.end(); }
+};
+
+template <typename T>
+struct is_slot_map : types::false_t {};
+
+template <typename T>
+struct is_slot_map<slot_map<T>> : types::true_t {};
+
+template <typename T>
+concept any_slot_map = is_slot_map<T>::value;
+
+template <any_slot_map T>
+s64 count(const T &map) { return map.Data.Count; }
+
+// Reserves space for at least _n_ more elements.
+template <any_slot_map T>
+void reserve(T &map, s64 n) {
+    array_reserve(map.Data, n);
+    array_reserve(map.DenseToSlot, n);
+    array_reserve(map.Slots, n);
+}
+
+// Call destructor on each element, free any memory and reset count.
+// All handles become invalid (even after you add new elements).
+template <any_slot_map T>
+void free(T &map) {
+    free(map.Data);
+    free(map.DenseToSlot);
+    free(map.Slots);
+    map.FreeHead = T::NO_SLOT;
+}
+
+// Call destructor on each element and reset count, keeps the memory for reuse.
+// All handles handed out so far become invalid.
+template <any_slot_map T>
+void reset(T &map) {
+    For(map.DenseToSlot) {
+        auto *s = map.Slots.Data + it;
+        ++s->Generation;
+        if (!s->Generation) s->Generation = 1;
+
+        s->DenseIndex = map.FreeHead;
+        map.FreeHead = it;
+    }
+    array_reset(map.Data);
+    array_reset(map.DenseToSlot);
+}
+
+// Returns a pointer to the element, or null if the handle is stale (the element was removed) or invalid.
+template <any_slot_map T>
+auto *find(const T &map, slot_map_handle handle) {
+    using V = typename T::T;
+
+    if (handle.Index >= map.Slots.Count) return (V *) null;
+
+    auto s = map.Slots.Data[handle.Index];
+    if (s.Generation != handle.Generation) return (V *) null;
+    return (V *) map.Data.Data + s.DenseIndex;
+}
+
+template <any_slot_map T>
+bool has(const T &map, slot_map_handle handle) { return find(map, handle) != null; }
+
+// Adds a copy of _element_ (without calling the copy constructor, like array_append) and returns a handle to it.
+template <any_slot_map T>
+slot_map_handle add(T &map, const typename T::T &element) {
+    u32 dense = (u32) map.Data.Count;
+    assert(map.Data.Count < T::NO_SLOT && "Too many elements in slot map");
+
+    u32 index = map.FreeHead;
+    if (index != T::NO_SLOT) {
+        map.FreeHead = map.Slots.Data[index].DenseIndex;
+    } else {
+        index = (u32) map.Slots.Count;
+        array_append(map.Slots);
+    }
+
+    auto *s = map.Slots.Data + index;
+    s->DenseIndex = dense;
+
+    array_append(map.Data, element);
+    array_append(map.DenseToSlot, index);
+
+    return {index, s->Generation};
+}
+
+// Returns true if the element was found and removed.
+// The last element gets moved into the place of the removed one (pointers to it become invalid, handles don't).
+template <any_slot_map T>
+bool remove(T &map, slot_map_handle handle) {
+    if (!has(map, handle)) return false;
+
+    auto *s = map.Slots.Data + handle.Index;
+    u32 dense = s->DenseIndex;
+
+    u32 last = (u32) map.Data.Count - 1;
+    if (dense != last) map.Slots.Data[map.DenseToSlot[last]].DenseIndex = dense;
+
+    array_remove_unordered(map.Data, dense);
+    array_remove_unordered(map.DenseToSlot, dense);
+
+    // Wraps after 4 billion removals of the same slot, skip 0 so zero-initialized handles stay invalid
+    ++s->Generation;
+    if (!s->Generation) s->Generation = 1;
+
+    s->DenseIndex = map.FreeHead;
+    map.FreeHead = handle.Index;
+    return true;
+}
+
+// Returns the handle of the element at _index_ in _Data_ (e.g. while iterating).
+template <any_slot_map T>
+slot_map_handle get_handle(const T &map, s64 index) {
+    u32 s = map.DenseToSlot[index];
+    return {s, map.Slots.Data[s].Generation};
+}
+
+// Handles into _src_ are also valid for _dest_.
+template <typename T>
+slot_map<T> *clone(slot_map<T> *dest, const slot_map<T> &src) {
+    free(*dest);
+    clone(&dest->Data, src.Data);
+    clone(&dest->DenseToSlot, src.DenseToSlot);
+    clone(&dest->Slots, src.Slots);
+    dest->FreeHead = src.FreeHead;
+    return dest;
+}
+
+LSTD_END_NAMESPACE
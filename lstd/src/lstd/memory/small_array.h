@@ -0,0 +1,90 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A dynamic array which keeps up to _N_ elements inside the object itself and only allocates
+// (with the Context's allocator) when it grows past that. Most arrays are small, so this
+// saves us the allocation (and the cache miss) in the common case.
+//
+//     small_array<token, 8> tokens;
+//     array_append(tokens, t);  // No allocation until the 9th element
+//     ...
+//     free(tokens);             // Frees only if we spilled to the heap
+//
+// :CodeReusability: This is considered array_like and satisfies is_array, so all array_* functions in array.h work on it.
+//
+// When the elements are inline, _Data_ points to _Storage_ (and _Allocated_ is N), which means the object must
+// not be copied with a plain memory copy while that is the case. The copy constructor and operator= below
+// take care of that. Once the array spilled copies are shallow (like array's), so use clone() for a deep copy.
+//
+template <typename T_, s64 N>
+struct small_array {
+    using T = T_;
+
+    static_assert(N > 0, "Use array<T> if you don't want inline storage");
+    static constexpr s64 INLINE_COUNT = N;
+
+    T *Data = (T *) Storage;
+    s64 Count = 0;
+    s64 Allocated = N;
+
+    // Not T[N] because that would default construct the elements
+    alignas(T) byte Storage[N * sizeof(T)];
+
+    small_array() {}
+
+    small_array(const small_array &other) { *this = other; }
+
+    small_array &operator=(const small_array &other) {
+        if (this == &other) return *this;
+
+        Count = other.Count;
+        Allocated = other.Allocated;
+        if (array_is_inline(other)) {
+            Data = (T *) Storage;
+            copy_elements(Data, other.Data, other.Count);
+        } else {
+            Data = other.Data;
+        }
+        return *this;
+    }
+
+    //
+    // Iterators:
+    //
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    iterator begin() { return Data; }
+    iterator end() { return Data + Count; }
+    const_iterator begin() const { return Data; }
+    const_iterator end() const { return Data + Count; }
+
+    //
+    // Operators:
+    //
+    T &operator[](s64 index) { return Data[translate_index(index, Count)]; }
+    const T &operator[](s64 index) const { return Data[translate_index(index, Count)]; }
+
+    explicit operator bool() const { return Count; }
+
+    // A view into the elements (invalidated when the small array grows or is freed)
+    operator array<T>() const { return array<T>(Data, Count); }
+};
+
+template <typename T, s64 N>
+struct is_array_helper<small_array<T, N>> : types::true_t {};
+
+// Be careful not to call this with _dest_ pointing to _src_!
+// Returns just _dest_.
+template <typename T, s64 N>
+small_array<T, N> *clone(small_array<T, N> *dest, const small_array<T, N> &src) {
+    array_reset(*dest);
+    array_append(*dest, src.Data, src.Count);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
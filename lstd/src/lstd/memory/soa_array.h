@@ -0,0 +1,259 @@
+#pragma once
+
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// An array of structs stored as a struct of arrays: every field of T gets its own contiguous stream,
+// so a loop which only reads or writes a few fields of many elements doesn't pull the rest through the
+// cache, and the streams can be fed straight to SIMD kernels.
+//
+//     struct particle { v3 Position; v3 Velocity; f32 Life; };
+//
+//     soa_array<particle> particles;
+//     defer(free(particles));
+//     add(particles, {position, velocity, 1.0f});
+//
+//     // One field at a time, an array<f32> view of the stream
+//     auto life = soa_field<&particle::Life>(particles);
+//     For(life) it -= dt;
+//
+//     // Or element by element through proxies
+//     For(particles) it.field<&particle::Position>() += it.field<&particle::Velocity>() * dt;
+//
+//     particle p = particles[3];  // Gathers the fields
+//     particles[3] = p;           // Scatters them back
+//
+// The fields are found with the aggregate reflection in type_info.h (see types::visit_fields), so T is
+// a plain struct and nothing has to be declared twice. Fields can be named by member pointer (checked at
+// compile time) or by index.
+//
+// All streams live in one block (like a hash_table with BLOCK_ALLOC), each one starts on a 64 byte boundary.
+// Growing moves every stream, so views from soa_field() and proxies are invalidated by add() and reserve().
+// Elements are copied as bytes (T must be trivially copyable), like array_append().
+//
+
+// Every stream starts on its own cache line, which is also enough for any SIMD load
+constexpr s64 SOA_ARRAY_ALIGNMENT = 64;
+
+template <typename T>
+struct soa_ref;
+
+namespace internal {
+template <typename Pack>
+struct soa_layout;
+
+template <typename... Fields>
+struct soa_layout<types::type_pack<Fields...>> {
+    static constexpr s64 SIZES[] = {sizeof(Fields)...};
+    static constexpr s64 ROW_SIZE = (sizeof(Fields) + ...);
+};
+
+// Where stream _field_ starts in a block for _count_ elements
+template <typename Layout>
+constexpr s64 soa_stream_offset(s64 count, s64 field) {
+    s64 offset = 0;
+    For(range(field)) offset += (count * Layout::SIZES[it] + SOA_ARRAY_ALIGNMENT - 1) & ~(SOA_ARRAY_ALIGNMENT - 1);
+    return offset;
+}
+
+// _Key_ is an index or a member pointer of T
+template <typename T, auto Key>
+constexpr s64 soa_field_index() {
+    if constexpr (types::is_member_object_pointer<decltype(Key)>) {
+        static_assert(types::is_same<typename types::internal::member_pointer_class<decltype(Key)>::type, T>, "Member of another struct");
+        return types::field_index<Key>;
+    } else {
+        static_assert(Key >= 0 && Key < types::field_count<T>, "Field index out of range");
+        return Key;
+    }
+}
+}  // namespace internal
+
+template <typename T_>
+requires(types::is_trivially_copyable<T_> && types::field_count<T_> > 0) struct soa_array {
+    using T = T_;
+    using fields_t = types::fields_t<T>;
+    using layout_t = internal::soa_layout<fields_t>;
+
+    static constexpr s64 FIELDS = types::field_count<T>;
+
+    void *Streams[FIELDS] = {};  // The first one is the start of the block
+    s64 Count = 0;
+    s64 Allocated = 0;
+
+    soa_array() {}
+
+    // We don't use destructors for freeing memory anymore.
+    // ~soa_array() { free(); }
+
+    soa_ref<T> operator[](s64 index) {
+        assert(index >= 0 && index < Count);
+        return {this, index};
+    }
+
+    //
+    // Iterators, they give proxies:
+    //
+    struct iterator {
+        soa_array *Array;
+        s64 Index;
+
+        soa_ref<T> operator*() const { return {Array, Index}; }
+
+        iterator &operator++() {
+            ++Index;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return Index == other.Index; }
+        bool operator!=(const iterator &other) const { return Index != other.Index; }
+    };
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, Count}; }
+};
+
+template <typename T>
+struct is_soa_array : types::false_t {};
+
+template <typename T>
+struct is_soa_array<soa_array<T>> : types::true_t {};
+
+template <typename T>
+concept any_soa_array = is_soa_array<T>::value;
+
+template <any_soa_array A>
+s64 count(const A &arr) { return arr.Count; }
+
+// Makes sure there is space for at least _n_ more elements, grows like array_reserve() (_growth_ is the same).
+// A null _alloc_ means the Context's allocator, after the first allocation the array stays with that allocator.
+template <any_soa_array A>
+void reserve(A &arr, s64 n, array_growth growth = array_growth::DEFAULT, allocator alloc = {}) {
+    using layout = typename A::layout_t;
+
+    if (arr.Count + n <= arr.Allocated) return;
+
+    s64 target = array_grow_target(arr.Allocated, arr.Count + n, layout::ROW_SIZE, growth);
+    if (arr.Allocated) alloc = allocation_get_allocator(arr.Streams[0]);
+
+    s64 size = internal::soa_stream_offset<layout>(target, A::FIELDS);
+    byte *block = allocate_array<byte>(size, {.Alloc = alloc, .Alignment = SOA_ARRAY_ALIGNMENT});
+
+    void *old = arr.Streams[0];
+
+    For(range(A::FIELDS)) {
+        byte *stream = block + internal::soa_stream_offset<layout>(target, it);
+        if (arr.Count) copy_memory(stream, arr.Streams[it], arr.Count * layout::SIZES[it]);
+        arr.Streams[it] = stream;
+    }
+
+    if (arr.Allocated) free(old);
+    arr.Allocated = target;
+}
+
+// Don't free the block, just move Count to 0
+template <any_soa_array A>
+void reset(A &arr) { arr.Count = 0; }
+
+template <any_soa_array A>
+void free(A &arr) {
+    if (arr.Allocated) free(arr.Streams[0]);
+    For(range(A::FIELDS)) arr.Streams[it] = null;
+    arr.Count = arr.Allocated = 0;
+}
+
+// An array<F> view of the stream of one field, _Key_ is its index or a member pointer (e.g. &particle::Life)
+template <auto Key, any_soa_array A>
+auto soa_field(const A &arr) {
+    constexpr s64 I = internal::soa_field_index<typename A::T, Key>();
+    using F = types::field_t<typename A::T, I>;
+    return array<F>((F *) arr.Streams[I], arr.Count);
+}
+
+// Gathers the fields of element _index_
+template <any_soa_array A>
+auto get(const A &arr, s64 index) {
+    assert(index >= 0 && index < arr.Count);
+
+    typename A::T result;
+    s64 field = 0;
+    types::visit_fields(result, [&](auto &...fields) {
+        ((fields = ((types::remove_cvref_t<decltype(fields)> *) arr.Streams[field++])[index]), ...);
+    });
+    return result;
+}
+
+// Scatters _element_ into the streams at _index_
+template <any_soa_array A>
+void set(A &arr, s64 index, const typename A::T &element) {
+    assert(index >= 0 && index < arr.Count);
+
+    s64 field = 0;
+    types::visit_fields(element, [&](const auto &...fields) {
+        ((((types::remove_cvref_t<decltype(fields)> *) arr.Streams[field++])[index] = fields), ...);
+    });
+}
+
+// Adds a copy of _element_ at the end and returns its index
+template <any_soa_array A>
+s64 add(A &arr, const typename A::T &element) {
+    reserve(arr, 1);
+    ++arr.Count;
+    set(arr, arr.Count - 1, element);
+    return arr.Count - 1;
+}
+
+// Moves the last element into the place of the removed one
+template <any_soa_array A>
+void remove_unordered(A &arr, s64 index) {
+    using layout = typename A::layout_t;
+
+    assert(index >= 0 && index < arr.Count);
+
+    s64 last = arr.Count - 1;
+    if (index != last) {
+        For(range(A::FIELDS)) {
+            byte *stream = (byte *) arr.Streams[it];
+            copy_memory(stream + index * layout::SIZES[it], stream + last * layout::SIZES[it], layout::SIZES[it]);
+        }
+    }
+    --arr.Count;
+}
+
+template <typename T>
+soa_array<T> *clone(soa_array<T> *dest, const soa_array<T> &src) {
+    using layout = typename soa_array<T>::layout_t;
+
+    free(*dest);
+    if (!src.Count) return dest;
+
+    reserve(*dest, src.Count, array_growth::EXACT);
+    For(range(soa_array<T>::FIELDS)) copy_memory(dest->Streams[it], src.Streams[it], src.Count * layout::SIZES[it]);
+    dest->Count = src.Count;
+    return dest;
+}
+
+// A reference to element _Index_ of an soa_array, see the top of the file
+template <typename T>
+struct soa_ref {
+    soa_array<T> *Array;
+    s64 Index;
+
+    // The field, by index or member pointer
+    template <auto Key>
+    auto &field() const {
+        constexpr s64 I = internal::soa_field_index<T, Key>();
+        return ((types::field_t<T, I> *) Array->Streams[I])[Index];
+    }
+
+    operator T() const { return get(*Array, Index); }
+
+    soa_ref &operator=(const T &element) {
+        set(*Array, Index, element);
+        return *this;
+    }
+};
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "../thread.h"
+#include "array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Sorting for array-likes (anything with Data and Count, see array_like.h).
+//
+//     sort(arr);                                            // Introsort, not stable
+//     sort(arr, [](auto *a, auto *b) { return a->Size - b->Size; });
+//     radix_sort(keys);                                     // Integers and floats, stable
+//     radix_sort(entities, [](auto &e) { return e.Depth; });  // Sorts by a key extracted from each element
+//     sort_by_key(keys, values);                            // Sorts _keys_ and moves _values_ along with them
+//     parallel_sort(arr);                                   // Sorts chunks on different threads and merges them
+//
+// Comparison functions follow the same convention as quick_sort in stack_array.h -
+// they take pointers to two elements and return < 0, 0 or > 0. Any callable works (not just function pointers),
+// so lambdas get inlined.
+//
+// Elements are moved around with operator= and swap (shallow copies, see the note on copying in array.h).
+//
+// The radix sorts and parallel_sort need a scratch buffer as big as the array,
+// it's allocated with _alloc_ (the Context's allocator by default) and freed before returning.
+//
+
+namespace internal {
+// Below this size we finish with insertion sort, it beats partitioning on small ranges.
+constexpr s64 SORT_INSERTION_THRESHOLD = 24;
+
+template <typename T>
+struct default_sort_comparison {
+    s32 operator()(const T *lhs, const T *rhs) const {
+        if (*lhs < *rhs) return -1;
+        if (*rhs < *lhs) return 1;
+        return 0;
+    }
+};
+
+template <typename T, typename Compare>
+void insertion_sort(T *first, T *last, Compare &compare) {
+    if (first == last) return;
+
+    for (T *it = first + 1; it != last; ++it) {
+        T value = *it;
+
+        T *hole = it;
+        while (hole != first && compare(&value, hole - 1) < 0) {
+            *hole = *(hole - 1);
+            --hole;
+        }
+        *hole = value;
+    }
+}
+
+template <typename T, typename Compare>
+void heap_sift_down(T *first, s64 root, s64 count, Compare &compare) {
+    while (true) {
+        s64 child = 2 * root + 1;
+        if (child >= count) return;
+
+        if (child + 1 < count && compare(first + child, first + child + 1) < 0) ++child;
+        if (compare(first + root, first + child) >= 0) return;
+
+        swap(first[root], first[child]);
+        root = child;
+    }
+}
+
+template <typename T, typename Compare>
+void heap_sort(T *first, T *last, Compare &compare) {
+    s64 count = last - first;
+    for (s64 i = count / 2 - 1; i >= 0; --i) heap_sift_down(first, i, count, compare);
+    for (s64 i = count - 1; i > 0; --i) {
+        swap(first[0], first[i]);
+        heap_sift_down(first, 0, i, compare);
+    }
+}
+
+// Moves the median of _a_, _b_ and _c_ to _result_.
+template <typename T, typename Compare>
+void move_median_to(T *result, T *a, T *b, T *c, Compare &compare) {
+    if (compare(a, b) < 0) {
+        if (compare(b, c) < 0) {
+            swap(*result, *b);
+        } else if (compare(a, c) < 0) {
+            swap(*result, *c);
+        } else {
+            swap(*result, *a);
+        }
+    } else if (compare(a, c) < 0) {
+        swap(*result, *a);
+    } else if (compare(b, c) < 0) {
+        swap(*result, *c);
+    } else {
+        swap(*result, *b);
+    }
+}
+
+// Hoare partition around *pivot. No bounds checks - the median of three guarantees
+// there is an element on each side which stops the scans.
+template <typename T, typename Compare>
+T *unguarded_partition(T *first, T *last, T *pivot, Compare &compare) {
+    while (true) {
+        while (compare(first, pivot) < 0) ++first;
+        --last;
+        while (compare(pivot, last) < 0) --last;
+        if (!(first < last)) return first;
+        swap(*first, *last);
+        ++first;
+    }
+}
+
+// Quick sort which falls back to heap sort when the recursion gets too deep (so the worst case is O(n log n)),
+// leaves small ranges for the insertion sort pass.
+template <typename T, typename Compare>
+void introsort_loop(T *first, T *last, s64 depthLimit, Compare &compare) {
+    while (last - first > SORT_INSERTION_THRESHOLD) {
+        if (depthLimit == 0) {
+            heap_sort(first, last, compare);
+            return;
+        }
+        --depthLimit;
+
+        T *mid = first + (last - first) / 2;
+        move_median_to(first, first + 1, mid, last - 1, compare);
+
+        T *cut = unguarded_partition(first + 1, last, first, compare);
+
+        // Recurse on the smaller half, loop on the bigger one
+        if (cut - first < last - cut) {
+            introsort_loop(first, cut, depthLimit, compare);
+            first = cut;
+        } else {
+            introsort_loop(cut, last, depthLimit, compare);
+            last = cut;
+        }
+    }
+}
+
+template <typename T, typename Compare>
+void introsort(T *first, T *last, Compare &compare) {
+    s64 count = last - first;
+    if (count < 2) return;
+
+    introsort_loop(first, last, 2 * (msb((u64) count) + 1), compare);
+    insertion_sort(first, last, compare);
+}
+
+// Maps a key to an unsigned integer with the same ordering, so we can sort byte by byte.
+// Signed integers get their sign bit flipped, negative floats get all bits flipped (positive ones only the sign bit).
+template <types::is_arithmetic K>
+always_inline u64 radix_key(K key) {
+    if constexpr (types::is_floating_point<K>) {
+        if constexpr (sizeof(K) == 4) {
+            u32 bits = *(u32 *) &key;
+            return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+        } else {
+            u64 bits = *(u64 *) &key;
+            return (bits & 0x8000000000000000ull) ? ~bits : bits | 0x8000000000000000ull;
+        }
+    } else if constexpr (types::is_signed_integral<K>) {
+        return (u64) key ^ (1ull << (sizeof(K) * 8 - 1));
+    } else {
+        return (u64) key;
+    }
+}
+
+// LSD radix sort on 8 bit digits. We build the histograms of all digits in one pass,
+// then skip the digits which are the same for every key (e.g. the upper bytes of small numbers).
+//
+// Sorts _data_ and moves _values_ (may be null) along with it. _scratch_ and _valuesScratch_ must be as big as the input.
+// The result is always in _data_ and _values_.
+template <typename T, typename V, typename Extract>
+void radix_sort(T *data, T *scratch, V *values, V *valuesScratch, s64 count, Extract &extract) {
+    using K = types::remove_cvref_t<decltype(extract(*data))>;
+    constexpr s64 DIGITS = sizeof(K);
+
+    s64 histograms[DIGITS][256];
+    zero_memory(histograms, sizeof(histograms));
+
+    For(range(count)) {
+        u64 key = radix_key(extract(data[it]));
+        For_as(d, range(DIGITS)) ++histograms[d][(key >> (d * 8)) & 0xFF];
+    }
+
+    T *src = data, *dst = scratch;
+    V *valuesSrc = values, *valuesDst = valuesScratch;
+
+    u64 firstKey = count ? radix_key(extract(data[0])) : 0;
+    For_as(d, range(DIGITS)) {
+        s64 *histogram = histograms[d];
+
+        // Every key has the same digit, this pass wouldn't move anything
+        if (histogram[(firstKey >> (d * 8)) & 0xFF] == count) continue;
+
+        // Turn the counts into starting offsets
+        s64 offset = 0;
+        For(range(256)) {
+            s64 c = histogram[it];
+            histogram[it] = offset;
+            offset += c;
+        }
+
+        For(range(count)) {
+            s64 target = histogram[(radix_key(extract(src[it])) >> (d * 8)) & 0xFF]++;
+            dst[target] = src[it];
+            if (values) valuesDst[target] = valuesSrc[it];
+        }
+
+        swap(src, dst);
+        swap(valuesSrc, valuesDst);
+    }
+
+    if (src != data) {
+        copy_elements(data, src, count);
+        if (values) copy_elements(values, valuesSrc, count);
+    }
+}
+
+// Stable merge of the sorted runs [a, aEnd) and [b, bEnd) into _dest_.
+template <typename T, typename Compare>
+void merge(T *dest, const T *a, const T *aEnd, const T *b, const T *bEnd, Compare &compare) {
+    while (a != aEnd && b != bEnd) {
+        if (compare(b, a) < 0) {
+            *dest++ = *b++;
+        } else {
+            *dest++ = *a++;
+        }
+    }
+    while (a != aEnd) *dest++ = *a++;
+    while (b != bEnd) *dest++ = *b++;
+}
+
+template <typename T, typename Compare>
+struct parallel_sort_job {
+    T *Src, *Dest;
+    s64 Begin, Mid, End;  // When sorting chunks only [Begin, End) is used (it's sorted in place)
+    Compare *Cmp;
+
+    static void sort_chunk(void *data) {
+        auto *job = (parallel_sort_job *) data;
+        introsort(job->Src + job->Begin, job->Src + job->End, *job->Cmp);
+    }
+
+    static void merge_runs(void *data) {
+        auto *job = (parallel_sort_job *) data;
+        T *s = job->Src;
+        merge(job->Dest + job->Begin, s + job->Begin, s + job->Mid, s + job->Mid, s + job->End, *job->Cmp);
+    }
+};
+
+// Runs _function_ for each job, the calling thread takes the last one instead of waiting idle.
+template <typename Job>
+void run_jobs(Job *jobs, s64 count, void (*function)(void *)) {
+    thread::thread threads[64];
+    For(range(count - 1)) threads[it].init_and_launch(function, jobs + it);
+    function(jobs + count - 1);
+    For(range(count - 1)) threads[it].wait();
+}
+}  // namespace internal
+
+// Sorts [first, last) with introsort (quick sort + heap sort for the worst case + insertion sort for small ranges).
+// Not stable - equal elements may change order.
+template <typename T, typename Compare = internal::default_sort_comparison<T>>
+void sort(T *first, T *last, Compare compare = {}) {
+    internal::introsort(first, last, compare);
+}
+
+template <is_array_like Arr, typename Compare = internal::default_sort_comparison<array_data_t<Arr>>>
+void sort(Arr &arr, Compare compare = {}) {
+    internal::introsort(arr.Data, arr.Data + arr.Count, compare);
+}
+
+// Stable radix sort for arrays of integers or floats. O(n) - much faster than sort() for big arrays of numbers.
+//
+// Negative zero sorts before positive zero and NaNs go to the ends (depending on their sign bit).
+template <is_array_like Arr>
+requires(types::is_arithmetic<array_data_t<Arr>>) void radix_sort(Arr &arr, allocator alloc = {}) {
+    using T = array_data_t<Arr>;
+    if (arr.Count < 2) return;
+
+    auto identity = [](T key) { return key; };
+
+    T *scratch = allocate_array<T>(arr.Count, {.Alloc = alloc});
+    internal::radix_sort(arr.Data, scratch, (T *) null, (T *) null, arr.Count, identity);
+    free(scratch);
+}
+
+// Stable radix sort by a key which _key_ extracts from each element, the key must be an integer or a float.
+//
+//     radix_sort(drawCalls, [](const draw_call &d) { return d.SortKey; });
+//
+template <is_array_like Arr, typename Extract>
+requires requires(Extract e, array_data_t<Arr> &element) { e(element); }
+void radix_sort(Arr &arr, Extract key, allocator alloc = {}) {
+    using T = array_data_t<Arr>;
+    if (arr.Count < 2) return;
+
+    T *scratch = allocate_array<T>(arr.Count, {.Alloc = alloc});
+    internal::radix_sort(arr.Data, scratch, (T *) null, (T *) null, arr.Count, key);
+    free(scratch);
+}
+
+// Sorts _keys_ (integers or floats) with a stable radix sort and applies the same permutation to _values_
+// (for data which is stored as parallel arrays). Both must have the same count.
+template <is_array_like Keys, is_array_like Values>
+requires(types::is_arithmetic<array_data_t<Keys>>) void sort_by_key(Keys &keys, Values &values, allocator alloc = {}) {
+    using K = array_data_t<Keys>;
+    using V = array_data_t<Values>;
+
+    assert(keys.Count == values.Count && "Keys and values must have the same count");
+    if (keys.Count < 2) return;
+
+    auto identity = [](K key) { return key; };
+
+    K *keysScratch = allocate_array<K>(keys.Count, {.Alloc = alloc});
+    V *valuesScratch = allocate_array<V>(values.Count, {.Alloc = alloc});
+    internal::radix_sort(keys.Data, keysScratch, values.Data, valuesScratch, keys.Count, identity);
+    free(keysScratch);
+    free(valuesScratch);
+}
+
+// Below this many elements per thread parallel_sort() just calls sort(), launching threads isn't worth it.
+constexpr s64 PARALLEL_SORT_MIN_CHUNK = 16 * 1024;
+
+// Splits the array into chunks, sorts each on its own thread, then merges pairs of runs in parallel until one is left.
+//
+// _threadCount_ of 0 means os_get_hardware_concurrency(). We launch new threads for each pass (there is no thread pool),
+// so this pays off only for big arrays - small ones go directly to sort().
+// Not stable (the chunks are sorted with introsort).
+template <is_array_like Arr, typename Compare = internal::default_sort_comparison<array_data_t<Arr>>>
+void parallel_sort(Arr &arr, Compare compare = {}, s64 threadCount = 0, allocator alloc = {}) {
+    using T = array_data_t<Arr>;
+    using job = internal::parallel_sort_job<T, Compare>;
+
+    if (!threadCount) threadCount = os_get_hardware_concurrency();
+
+    // A power of two so runs merge in pairs evenly
+    s64 chunks = min(min(threadCount, arr.Count / PARALLEL_SORT_MIN_CHUNK), (s64) 64);
+    if (chunks < 2) {
+        internal::introsort(arr.Data, arr.Data + arr.Count, compare);
+        return;
+    }
+    chunks = 1ll << msb((u64) chunks);
+
+    job jobs[64];
+
+    s64 chunkSize = arr.Count / chunks;
+    For(range(chunks)) {
+        s64 begin = it * chunkSize;
+        s64 end = it == chunks - 1 ? arr.Count : begin + chunkSize;
+        jobs[it] = {arr.Data, null, begin, begin, end, &compare};
+    }
+    internal::run_jobs(jobs, chunks, job::sort_chunk);
+
+    T *scratch = allocate_array<T>(arr.Count, {.Alloc = alloc});
+
+    T *src = arr.Data, *dst = scratch;
+    for (s64 runs = chunks; runs > 1; runs /= 2) {
+        // Merge runs 2i and 2i + 1 (run i is [jobs[i].Begin, jobs[i].End) from the previous pass)
+        s64 pairs = runs / 2;
+        For(range(pairs)) {
+            jobs[it] = {src, dst, jobs[2 * it].Begin, jobs[2 * it].End, jobs[2 * it + 1].End, &compare};
+        }
+
+        internal::run_jobs(jobs, pairs, job::merge_runs);
+        swap(src, dst);
+    }
+
+    if (src != arr.Data) copy_elements(arr.Data, src, arr.Count);
+    free(scratch);
+}
+
+LSTD_END_NAMESPACE
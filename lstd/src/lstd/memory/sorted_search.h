@@ -0,0 +1,251 @@
+#pragma once
+
+#include "array.h"
+
+#if ARCH == X86
+#include <emmintrin.h>
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Searching sorted data (with operator<, like sort() in sort.h).
+//
+//     s64 i = lower_bound(keys, key);   // The first element which is not less than _key_, keys.Count if there is none
+//     s64 j = upper_bound(keys, key);   // The first element which is greater than _key_
+//     bool found = i < keys.Count && !(key < keys[i]);
+//
+// These are branchless binary searches: the loop always runs log2(n) times and the comparison picks the next half
+// with a conditional move, so there are no mispredictions (half the steps of a normal binary search mispredict).
+// For s32, u32 and f32 the last 16 or so candidates are counted with SIMD instead, which beats the last few
+// dependent loads.
+//
+// A binary search over a large array still misses the cache on most steps, because the elements it looks at are
+// far apart. For big sets which are built once and searched a lot, build an eytzinger_array: the same keys in
+// the order of a breadth first walk of the implicit binary tree (the root first, then its two children, etc.).
+// The first levels of the tree are then next to each other in memory (and stay in the cache), and the 16
+// (for 4 byte keys) descendants four levels down are on one cache line, so we can prefetch them while the
+// current level is being compared. That's 2-4x faster than binary search on arrays which don't fit in L2.
+//
+//     eytzinger_array<u32> index;
+//     eytzinger_build(index, sortedIDs);
+//     defer(free(index));
+//
+//     s64 row = find(index, id);  // The index of _id_ in _sortedIDs_ or -1, so it works with parallel arrays of values
+//
+
+namespace internal {
+// Below this many candidates lower_bound/upper_bound finish with a SIMD count
+constexpr s64 SORTED_SEARCH_LINEAR_THRESHOLD = 16;
+
+template <typename T>
+constexpr bool SORTED_SEARCH_HAS_SIMD = types::is_same<T, s32> || types::is_same<T, u32> || types::is_same<T, f32>;
+
+always_inline void sorted_search_prefetch(const void *p) {
+#if ARCH == X86
+    _mm_prefetch((const char *) p, _MM_HINT_T0);
+#elif COMPILER != MSVC
+    __builtin_prefetch(p);
+#endif
+}
+
+// Counts the elements of _data_ which are less than _value_ (less or equal when _Upper_).
+// Sorted data has these first, so this is lower_bound (or upper_bound) of a small range.
+template <bool Upper, typename T>
+s64 sorted_search_count(const T *data, s64 count, T value) {
+    s64 i = 0, result = 0;
+
+#if ARCH == X86
+    if constexpr (types::is_same<T, f32>) {
+        __m128 v = _mm_set1_ps(value);
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(data + i);
+            __m128 m = Upper ? _mm_cmple_ps(x, v) : _mm_cmplt_ps(x, v);
+            acc = _mm_sub_epi32(acc, _mm_castps_si128(m));  // True lanes are -1
+        }
+        alignas(16) s32 lanes[4];
+        _mm_store_si128((__m128i *) lanes, acc);
+        result = (s64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    } else {
+        // SSE2 has no unsigned compare, flipping the sign bit maps the order of u32 to the order of s32
+        const __m128i bias = _mm_set1_epi32(types::is_same<T, u32> ? (s32) 0x80000000 : 0);
+
+        __m128i v = _mm_xor_si128(_mm_set1_epi32((s32) value), bias);
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4) {
+            __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (data + i)), bias);
+
+            // x <= v is the complement of x > v, count those and subtract at the end
+            acc = _mm_sub_epi32(acc, Upper ? _mm_cmpgt_epi32(x, v) : _mm_cmplt_epi32(x, v));
+        }
+        alignas(16) s32 lanes[4];
+        _mm_store_si128((__m128i *) lanes, acc);
+        result = (s64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        if (Upper) result = i - result;
+    }
+#elif ARCH == ARM && ANY_ARM_NEON
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t m;
+        if constexpr (types::is_same<T, f32>) {
+            float32x4_t x = vld1q_f32(data + i), v = vdupq_n_f32(value);
+            m = Upper ? vcleq_f32(x, v) : vcltq_f32(x, v);
+        } else if constexpr (types::is_same<T, u32>) {
+            uint32x4_t x = vld1q_u32(data + i), v = vdupq_n_u32(value);
+            m = Upper ? vcleq_u32(x, v) : vcltq_u32(x, v);
+        } else {
+            int32x4_t x = vld1q_s32(data + i), v = vdupq_n_s32(value);
+            m = Upper ? vcleq_s32(x, v) : vcltq_s32(x, v);
+        }
+        acc = vsubq_u32(acc, m);  // True lanes are all ones, -1
+    }
+    result = vaddvq_u32(acc);
+#endif
+
+    for (; i < count; ++i) result += Upper ? !(value < data[i]) : data[i] < value;
+    return result;
+}
+
+template <bool Upper, typename T>
+s64 sorted_search(const T *data, s64 count, const T &value) {
+    if (count <= 0) return 0;
+
+    // The answer is always in [base, base + count]
+    const T *base = data;
+
+    constexpr s64 STOP = SORTED_SEARCH_HAS_SIMD<T> ? SORTED_SEARCH_LINEAR_THRESHOLD : 1;
+    while (count > STOP) {
+        s64 half = count / 2;
+
+        // Both candidates for the next step, they are loaded while this one resolves
+        sorted_search_prefetch(base + half / 2);
+        sorted_search_prefetch(base + half + half / 2);
+
+        bool right = Upper ? !(value < base[half]) : base[half] < value;
+        base = right ? base + half : base;
+        count -= half;
+    }
+
+    if constexpr (SORTED_SEARCH_HAS_SIMD<T>) {
+        return (base - data) + sorted_search_count<Upper>(base, count, value);
+    } else {
+        return (base - data) + (Upper ? !(value < *base) : *base < value);
+    }
+}
+}  // namespace internal
+
+// Index of the first element of _arr_ which is not less than _value_, arr.Count if there is none. _arr_ must be sorted.
+template <is_array_like Arr>
+s64 lower_bound(const Arr &arr, const array_data_t<Arr> &value) {
+    return internal::sorted_search<false>((const array_data_t<Arr> *) arr.Data, arr.Count, value);
+}
+
+// Index of the first element of _arr_ which is greater than _value_, arr.Count if there is none. _arr_ must be sorted.
+template <is_array_like Arr>
+s64 upper_bound(const Arr &arr, const array_data_t<Arr> &value) {
+    return internal::sorted_search<true>((const array_data_t<Arr> *) arr.Data, arr.Count, value);
+}
+
+// Index of an element equal to _value_ in sorted _arr_ (the first one if there are many), -1 if there is none
+template <is_array_like Arr>
+s64 binary_search(const Arr &arr, const array_data_t<Arr> &value) {
+    s64 i = lower_bound(arr, value);
+    return i < arr.Count && !(value < arr.Data[i]) ? i : -1;
+}
+
+//
+// Eytzinger layout, see the top of the file
+//
+template <typename T>
+struct eytzinger_array {
+    T *Keys = null;     // _Count_ + 1 slots, the tree starts at _Keys[1]_ (so the children of k are 2k and 2k + 1)
+    u32 *Ranks = null;  // The index in the sorted input of each key (same slots as _Keys_)
+    s64 Count = 0;
+
+    eytzinger_array() {}
+};
+
+namespace internal {
+template <typename T, typename Arr>
+s64 eytzinger_fill(eytzinger_array<T> &e, const Arr &sorted, s64 next, s64 k) {
+    if (k > e.Count) return next;
+
+    next = eytzinger_fill(e, sorted, next, 2 * k);
+    e.Keys[k] = sorted.Data[next];
+    e.Ranks[k] = (u32) next;
+    return eytzinger_fill(e, sorted, next + 1, 2 * k + 1);
+}
+
+// The slot of the first key which is not less than _value_ (greater than, when _Upper_), 0 if there is none
+template <bool Upper, typename T>
+s64 eytzinger_search(const eytzinger_array<T> &e, const T &value) {
+    const T *keys = e.Keys;
+    s64 n = e.Count;
+
+    // The 16 descendants of k four levels down start at 16k, which is on a cache line boundary since _Keys_ is aligned
+    constexpr s64 PREFETCH_STRIDE = sizeof(T) <= 64 ? 64 / sizeof(T) : 1;
+
+    s64 k = 1;
+    while (k <= n) {
+        sorted_search_prefetch(keys + k * PREFETCH_STRIDE);
+
+        bool right = Upper ? !(value < keys[k]) : keys[k] < value;
+        k = 2 * k + right;
+    }
+
+    // The steps right after the last step left are the trailing ones of _k_, undoing them and that last left step
+    // gives the node we last went left at (0 if we always went right).
+    return k >> (lsb(~(u64) k) + 1);
+}
+}  // namespace internal
+
+template <typename T>
+void free(eytzinger_array<T> &e) {
+    free(e.Keys);
+    free(e.Ranks);
+    e.Keys = null;
+    e.Ranks = null;
+    e.Count = 0;
+}
+
+// Builds _e_ from the sorted _sorted_ (which isn't referenced afterwards). Frees what _e_ had before.
+template <typename T, is_array_like Arr>
+void eytzinger_build(eytzinger_array<T> &e, const Arr &sorted, allocator alloc = {}) {
+    free(e);
+    assert(sorted.Count < (s64) U32_MAX);
+
+    e.Count = sorted.Count;
+    e.Keys = allocate_array<T>(e.Count + 1, {.Alloc = alloc, .Alignment = 64});
+    e.Ranks = allocate_array<u32>(e.Count + 1, {.Alloc = alloc});
+
+    internal::eytzinger_fill(e, sorted, 0, 1);
+}
+
+// The index in the sorted input of the first key which is not less than _value_, Count if there is none
+template <typename T>
+s64 lower_bound(const eytzinger_array<T> &e, const T &value) {
+    s64 k = internal::eytzinger_search<false>(e, value);
+    return k ? e.Ranks[k] : e.Count;
+}
+
+// The index in the sorted input of the first key which is greater than _value_, Count if there is none
+template <typename T>
+s64 upper_bound(const eytzinger_array<T> &e, const T &value) {
+    s64 k = internal::eytzinger_search<true>(e, value);
+    return k ? e.Ranks[k] : e.Count;
+}
+
+// The index in the sorted input of a key equal to _value_ (the first one if there are many), -1 if there is none
+template <typename T>
+s64 find(const eytzinger_array<T> &e, const T &value) {
+    s64 k = internal::eytzinger_search<false>(e, value);
+    return k && !(value < e.Keys[k]) ? (s64) e.Ranks[k] : -1;
+}
+
+template <typename T>
+bool has(const eytzinger_array<T> &e, const T &value) { return find(e, value) != -1; }
+
+LSTD_END_NAMESPACE
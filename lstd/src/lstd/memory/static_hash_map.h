@@ -0,0 +1,161 @@
+#pragma once
+
+#include "hash.h"
+
+LSTD_BEGIN_NAMESPACE
+
+template <typename K, typename V>
+struct static_hash_map_entry {
+    K Key;
+    V Value;
+};
+
+// A read-only hash map over a fixed set of keys which is built entirely at compile time.
+// Use this for tables keyed by literals (command names, format options, etc.), there is no startup cost
+// and no allocations, and every lookup is exactly one probe.
+//
+//     static constexpr auto Commands = make_static_hash_map<string, s32>({
+//         {"help", CMD_HELP},
+//         {"quit", CMD_QUIT},
+//     });
+//
+//     auto *command = find(Commands, name);  // null if _name_ is not one of the keys
+//
+// We build a perfect hash with "hash and displace" (see the CHD paper by Belazzougui, Botelho and Dietzfelbinger):
+// the keys are split into buckets by their hash and for each bucket (biggest first) we search for a displacement
+// which sends all of its keys to free slots. A lookup reads the displacement of the key's bucket and goes straight
+// to the only slot where the key can be.
+//
+// The hashes come from get_hash(), which gives the same results at compile time and at runtime.
+template <typename K_, typename V_, s64 N>
+struct static_hash_map {
+    using K = K_;
+    using V = V_;
+
+    static_assert(N > 0, "Static hash map needs at least one key");
+
+    static constexpr s64 COUNT = N;
+    static constexpr s64 SLOTS = ceil_pow_of_2(N * 2);          // At most half full so we find displacements quickly
+    static constexpr s64 BUCKETS = ceil_pow_of_2((N + 3) / 4);  // About 4 keys per bucket
+
+    K Keys[SLOTS]{};
+    V Values[SLOTS]{};
+    bool Filled[SLOTS]{};
+
+    u32 Displacements[BUCKETS]{};
+};
+
+template <typename T>
+struct is_static_hash_map : types::false_t {};
+
+template <typename K, typename V, s64 N>
+struct is_static_hash_map<static_hash_map<K, V, N>> : types::true_t {};
+
+template <typename T>
+concept any_static_hash_map = is_static_hash_map<T>::value;
+
+// Where a key with this hash goes for a given displacement of its bucket
+constexpr s64 static_hash_map_slot(u64 hash, u32 displacement, s64 slots) {
+    u64 x = hash + displacement * 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (s64) (x & (slots - 1));
+}
+
+// Not constexpr on purpose, calling these stops the compilation with an error pointing here.
+inline void static_hash_map_error_duplicate_key() {}
+inline void static_hash_map_error_no_displacement_found() {}
+
+template <typename K, typename V, s64 N>
+consteval static_hash_map<K, V, N> make_static_hash_map(const static_hash_map_entry<K, V> (&entries)[N]) {
+    using map_t = static_hash_map<K, V, N>;
+    constexpr s64 BUCKET_MASK = map_t::BUCKETS - 1;
+
+    map_t result;
+
+    u64 hashes[N]{};
+    For(range(N)) hashes[it] = get_hash(entries[it].Key);
+
+    For_as(i, range(N)) {
+        For_as(j, range(i + 1, N)) {
+            if (hashes[i] == hashes[j] && entries[i].Key == entries[j].Key) static_hash_map_error_duplicate_key();
+        }
+    }
+
+    s64 bucketSizes[map_t::BUCKETS]{};
+    For(range(N)) ++bucketSizes[hashes[it] & BUCKET_MASK];
+
+    // Place the big buckets first while there are still many free slots
+    s64 order[map_t::BUCKETS]{};
+    For(range(map_t::BUCKETS)) order[it] = it;
+    For_as(i, range(1, map_t::BUCKETS)) {
+        for (s64 j = i; j > 0 && bucketSizes[order[j - 1]] < bucketSizes[order[j]]; --j) {
+            s64 temp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = temp;
+        }
+    }
+
+    For_as(b, order) {
+        if (!bucketSizes[b]) break;
+
+        s64 keys[N]{};
+        s64 keysCount = 0;
+        For(range(N)) {
+            if ((hashes[it] & BUCKET_MASK) == b) keys[keysCount++] = it;
+        }
+
+        s64 slots[N]{};
+
+        u32 displacement = 0;
+        while (true) {
+            bool fits = true;
+            For_as(k, range(keysCount)) {
+                slots[k] = static_hash_map_slot(hashes[keys[k]], displacement, map_t::SLOTS);
+                if (result.Filled[slots[k]]) fits = false;
+
+                // Two keys of the same bucket may also collide with each other
+                For_as(other, range(k)) {
+                    if (slots[other] == slots[k]) fits = false;
+                }
+                if (!fits) break;
+            }
+            if (fits) break;
+
+            ++displacement;
+            if (displacement == 1 << 20) static_hash_map_error_no_displacement_found();
+        }
+
+        result.Displacements[b] = displacement;
+        For_as(k, range(keysCount)) {
+            result.Keys[slots[k]] = entries[keys[k]].Key;
+            result.Values[slots[k]] = entries[keys[k]].Value;
+            result.Filled[slots[k]] = true;
+        }
+    }
+    return result;
+}
+
+// Returns a pointer to the value, or null if the key is not in the map.
+// This method is useful if you have cached the hash.
+template <any_static_hash_map T>
+constexpr const typename T::V *find_prehashed(const T &map, u64 hash, const typename T::K &key) {
+    s64 slot = static_hash_map_slot(hash, map.Displacements[hash & (T::BUCKETS - 1)], T::SLOTS);
+    if (map.Filled[slot] && map.Keys[slot] == key) return &map.Values[slot];
+    return null;
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_static_hash_map T>
+constexpr const typename T::V *find(const T &map, const typename T::K &key) { return find_prehashed(map, get_hash(key), key); }
+
+template <any_static_hash_map T>
+constexpr bool has(const T &map, const typename T::K &key) { return find(map, key) != null; }
+
+template <any_static_hash_map T>
+constexpr bool has_prehashed(const T &map, u64 hash, const typename T::K &key) { return find_prehashed(map, hash, key) != null; }
+
+LSTD_END_NAMESPACE
@@ -2,6 +2,19 @@
 
 #include "../internal/context.h"
 
+#if ARCH == X86
+#include <immintrin.h>  // SSE2, SSSE3 and AVX2 intrinsics
+
+// MSVC lets us use newer instructions without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 LSTD_BEGIN_NAMESPACE
 
 string::code_point_ref &string::code_point_ref::operator=(utf32 other) {
@@ -41,7 +54,7 @@ utf8 *string_to_c_string_temp(const string &s) { return string_to_c_string(s, Co
 
 // Sets the _index_'th code point in the string.
 void string_set(string &s, s64 index, utf32 codePoint) {
-    utf8 *targetOctet = (utf8 *) get_cp_at_index(s.Data, translate_index(index, s.Length));
+    utf8 *targetOctet = (utf8 *) string_get_cp_at_index(s, translate_index(index, s.Length));
 
     s64 cpSize = get_size_of_cp(codePoint);
     s64 cpTargetSize = get_size_of_cp(targetOctet);
@@ -71,21 +84,21 @@ void string_insert_at(string &s, s64 index, utf32 codePoint) {
     utf8 data[4];
     encode_cp(data, codePoint);
 
-    s64 offset = (s64)(get_cp_at_index(s.Data, translate_index(index, s.Length, true)) - s.Data);
+    s64 offset = (s64)(string_get_cp_at_index(s, translate_index(index, s.Length, true)) - s.Data);
     array_insert_at(s, offset, data, get_size_of_cp(data));
 
     ++s.Length;
 }
 
 void string_insert_at(string &s, s64 index, const utf8 *str, s64 size) {
-    s64 offset = (s64)(get_cp_at_index(s.Data, translate_index(index, s.Length, true)) - s.Data);
+    s64 offset = (s64)(string_get_cp_at_index(s, translate_index(index, s.Length, true)) - s.Data);
 
     array_insert_at(s, offset, str, size);
     s.Length += utf8_length(str, size);
 }
 
 void string_remove_at(string &s, s64 index) {
-    auto *target = get_cp_at_index(s.Data, translate_index(index, s.Length, true));
+    auto *target = string_get_cp_at_index(s, translate_index(index, s.Length, true));
     s64 offset = (s64)(target - s.Data);
 
     array_remove_range(s, offset, offset + get_size_of_cp(target));
@@ -97,7 +110,7 @@ void string_remove_range(string &s, s64 begin, s64 end) {
     s64 tbegin = translate_index(begin, s.Length);
     s64 tend = translate_index(end, s.Length, true);
 
-    auto *t1 = get_cp_at_index(s.Data, tbegin), *t2 = get_cp_at_index(s.Data, tend);
+    auto *t1 = string_get_cp_at_index(s, tbegin), *t2 = string_get_cp_at_index(s, tend);
 
     s64 bi = (s64)(t1 - s.Data), ei = (s64)(t2 - s.Data);
     array_remove_range(s, bi, ei);
@@ -111,4 +124,736 @@ string *clone(string *dest, const string &src) {
     return dest;
 }
 
+//
+// SIMD versions of utf8_length(). A byte starts a code point unless it's a continuation byte (10xxxxxx),
+// which as a signed byte is < -64. We compare 16 (or 32) bytes at a time, which gives -1 for each byte
+// that starts a code point, and subtract that from per-byte counters. The counters are 8 bit, so every 255
+// iterations we sum them into 64 bit totals with _mm_sad_epu8.
+//
+
+file_scope s64 utf8_length_scalar(const utf8 *str, s64 size) {
+    s64 length = 0;
+    while (size--) {
+        if ((*str++ & 0xc0) != 0x80) ++length;
+    }
+    return length;
+}
+
+#if ARCH == X86
+file_scope s64 utf8_length_sse2(const utf8 *str, s64 size) {
+    const __m128i limit = _mm_set1_epi8(-65);
+
+    s64 length = 0;
+    __m128i totals = _mm_setzero_si128();
+
+    while (size >= 16) {
+        s64 iterations = min<s64>(size / 16, 255);
+
+        __m128i counters = _mm_setzero_si128();
+        For(range(iterations)) {
+            __m128i v = _mm_loadu_si128((const __m128i *) str);
+            counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(v, limit));
+            str += 16;
+        }
+        totals = _mm_add_epi64(totals, _mm_sad_epu8(counters, _mm_setzero_si128()));
+        size -= iterations * 16;
+    }
+    length += _mm_cvtsi128_si64(totals) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(totals, totals));
+
+    return length + utf8_length_scalar(str, size);
+}
+
+TARGET_AVX2 file_scope s64 utf8_length_avx2(const utf8 *str, s64 size) {
+    const __m256i limit = _mm256_set1_epi8(-65);
+
+    s64 length = 0;
+    __m256i totals = _mm256_setzero_si256();
+
+    while (size >= 32) {
+        s64 iterations = min<s64>(size / 32, 255);
+
+        __m256i counters = _mm256_setzero_si256();
+        For(range(iterations)) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) str);
+            counters = _mm256_sub_epi8(counters, _mm256_cmpgt_epi8(v, limit));
+            str += 32;
+        }
+        totals = _mm256_add_epi64(totals, _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+        size -= iterations * 32;
+    }
+    length += _mm256_extract_epi64(totals, 0) + _mm256_extract_epi64(totals, 1) + _mm256_extract_epi64(totals, 2) + _mm256_extract_epi64(totals, 3);
+
+    // The rest is less than 32 bytes
+    return length + (size >= 16 ? utf8_length_sse2(str, size) : utf8_length_scalar(str, size));
+}
+#endif
+
+using utf8_length_func = s64 (*)(const utf8 *str, s64 size);
+
+s64 internal::utf8_length_simd(const utf8 *str, s64 size) {
+    local_persist cpu_dispatch<utf8_length_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> utf8_length_func {
+#if ARCH == X86
+        return cpu.AVX2 ? utf8_length_avx2 : utf8_length_sse2;
+#else
+        return utf8_length_scalar;
+#endif
+    });
+    return func(str, size);
+}
+
+//
+// SIMD UTF-8 validation, the lookup algorithm from "Validating UTF-8 In Less Than One Instruction Per Byte"
+// (John Keiser, Daniel Lemire, 2021), also used by simdjson.
+//
+// Almost every error is visible by looking at two consecutive bytes: we look up the high nibble of the previous
+// byte, its low nibble and the high nibble of the current byte in three 16 entry tables (with pshufb). Each table
+// entry is a set of the errors which are possible with that nibble, ANDing the three gives the errors which
+// actually happened. What's left are sequences that are too long or too short for their lead byte, which we
+// check by looking 2 and 3 bytes back.
+//
+// The SIMD code only tells us that a block has an error, to get the exact offset we run the scalar validator
+// from the last code point which started before the block.
+//
+#if ARCH == X86
+namespace utf8_validation {
+constexpr u8 TOO_SHORT = 1 << 0;       // 11______ 0_______ or 11______ 11______
+constexpr u8 TOO_LONG = 1 << 1;        // 0_______ 10______
+constexpr u8 OVERLONG_3 = 1 << 2;      // 11100000 100_____
+constexpr u8 TOO_LARGE = 1 << 3;       // 11110100 1001____, 11110100 101_____ or 11110101+ 10______
+constexpr u8 SURROGATE = 1 << 4;       // 11101101 101_____
+constexpr u8 OVERLONG_2 = 1 << 5;      // 1100000_ 10______
+constexpr u8 TOO_LARGE_1000 = 1 << 6;  // 11110100 1000____ or 11110101+ 1000____
+constexpr u8 OVERLONG_4 = 1 << 6;      // 11110000 1000____
+constexpr u8 TWO_CONTS = 1 << 7;       // 10______ 10______
+constexpr u8 CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+// Indexed with the high nibble of the previous byte
+alignas(32) constexpr u8 BYTE_1_HIGH[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,  // 0_______ (ASCII)
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                      // 10______ (continuation)
+    TOO_SHORT | OVERLONG_2,                                                          // 1100____
+    TOO_SHORT,                                                                       // 1101____
+    TOO_SHORT | OVERLONG_3 | SURROGATE,                                              // 1110____
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4                              // 1111____
+};
+
+// Indexed with the low nibble of the previous byte
+alignas(32) constexpr u8 BYTE_1_LOW[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,  // ____0000
+    CARRY | OVERLONG_2,                            // ____0001
+    CARRY,                                         // ____001_
+    CARRY,
+    CARRY | TOO_LARGE,                   // ____0100
+    CARRY | TOO_LARGE | TOO_LARGE_1000,  // ____0101
+    CARRY | TOO_LARGE | TOO_LARGE_1000,  // ____011_
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,  // ____1___
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,  // ____1101
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+// Indexed with the high nibble of the current byte
+alignas(32) constexpr u8 BYTE_2_HIGH[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,  // 0_______
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,            // 1000____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                              // 1001____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                               // 101_____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT  // 11______
+};
+
+// Bytes greater than these at the end of a block start a sequence which continues in the next block
+alignas(32) constexpr u8 INCOMPLETE_MAX[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF,
+};
+}  // namespace utf8_validation
+
+// Called with the block where the SIMD code found an error (or the tail after the last block). Everything before
+// _block_ is valid, except maybe a sequence which started in the last 3 bytes, so we go back to its lead byte.
+file_scope s64 utf8_find_invalid_from(const utf8 *str, s64 size, const utf8 *block) {
+    s64 start = block - str;
+
+    s64 back = 0;
+    while (back < 3 && start - back > 0 && (str[start - back - 1] & 0xc0) == 0x80) ++back;
+    if (back < 3 && start - back > 0 && (u8) str[start - back - 1] >= 0xC0) start -= back + 1;
+    s64 result = internal::utf8_find_invalid_scalar(str + start, size - start);
+    return result == -1 ? -1 : start + result;
+}
+
+TARGET_SSSE3 file_scope s64 utf8_find_invalid_ssse3(const utf8 *str, s64 size) {
+    using namespace utf8_validation;
+
+    const __m128i byte1High = _mm_load_si128((const __m128i *) BYTE_1_HIGH);
+    const __m128i byte1Low = _mm_load_si128((const __m128i *) BYTE_1_LOW);
+    const __m128i byte2High = _mm_load_si128((const __m128i *) BYTE_2_HIGH);
+    const __m128i incompleteMax = _mm_load_si128((const __m128i *) (INCOMPLETE_MAX + 16));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    __m128i prevInput = _mm_setzero_si128();
+    __m128i prevIncomplete = _mm_setzero_si128();
+
+    const utf8 *p = str, *end = str + size;
+    for (; end - p >= 16; p += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *) p);
+
+        __m128i error;
+        if (!_mm_movemask_epi8(input)) {
+            // All ASCII, the only possible error is a sequence cut off at the end of the previous block
+            error = prevIncomplete;
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, prevInput, 15);
+
+            __m128i b1High = _mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+            __m128i b1Low = _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibble));
+            __m128i b2High = _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+            __m128i special = _mm_and_si128(_mm_and_si128(b1High, b1Low), b2High);
+
+            // Third and fourth bytes of 3 and 4 byte sequences must be continuations
+            __m128i prev2 = _mm_alignr_epi8(input, prevInput, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, prevInput, 13);
+            __m128i isThird = _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xE0 - 0x80)));
+            __m128i isFourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xF0 - 0x80)));
+            __m128i must23 = _mm_and_si128(_mm_or_si128(isThird, isFourth), _mm_set1_epi8((char) 0x80));
+
+            error = _mm_xor_si128(must23, special);
+            prevIncomplete = _mm_subs_epu8(input, incompleteMax);
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF) return utf8_find_invalid_from(str, size, p);
+
+        if (!_mm_movemask_epi8(input)) prevIncomplete = _mm_setzero_si128();
+        prevInput = input;
+    }
+
+    // The tail (and a sequence cut off by the last block) is checked by the scalar code
+    return utf8_find_invalid_from(str, size, p);
+}
+
+TARGET_AVX2 file_scope s64 utf8_find_invalid_avx2(const utf8 *str, s64 size) {
+    using namespace utf8_validation;
+
+    const __m256i byte1High = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) BYTE_1_HIGH));
+    const __m256i byte1Low = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) BYTE_1_LOW));
+    const __m256i byte2High = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) BYTE_2_HIGH));
+    const __m256i incompleteMax = _mm256_load_si256((const __m256i *) INCOMPLETE_MAX);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i prevInput = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+
+    const utf8 *p = str, *end = str + size;
+    for (; end - p >= 32; p += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *) p);
+
+        __m256i error;
+        if (!_mm256_movemask_epi8(input)) {
+            error = prevIncomplete;
+        } else {
+            // alignr works within 128 bit lanes, so first make a register with the high lane of the previous
+            // block and the low lane of this one
+            __m256i shifted = _mm256_permute2x128_si256(prevInput, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+
+            __m256i b1High = _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+            __m256i b1Low = _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble));
+            __m256i b2High = _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+            __m256i special = _mm256_and_si256(_mm256_and_si256(b1High, b1Low), b2High);
+
+            __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+            __m256i isThird = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char) (0xE0 - 0x80)));
+            __m256i isFourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char) (0xF0 - 0x80)));
+            __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThird, isFourth), _mm256_set1_epi8((char) 0x80));
+
+            error = _mm256_xor_si256(must23, special);
+            prevIncomplete = _mm256_subs_epu8(input, incompleteMax);
+        }
+
+        if (!_mm256_testz_si256(error, error)) return utf8_find_invalid_from(str, size, p);
+
+        if (!_mm256_movemask_epi8(input)) prevIncomplete = _mm256_setzero_si256();
+        prevInput = input;
+    }
+
+    return utf8_find_invalid_from(str, size, p);
+}
+#endif
+
+s64 internal::utf8_find_invalid_simd(const utf8 *str, s64 size) {
+    using find_invalid_func = s64 (*)(const utf8 *str, s64 size);
+
+    local_persist cpu_dispatch<find_invalid_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> find_invalid_func {
+#if ARCH == X86
+        if (cpu.AVX2) return utf8_find_invalid_avx2;
+        if (cpu.SSSE3) return utf8_find_invalid_ssse3;
+#endif
+        return internal::utf8_find_invalid_scalar;
+    });
+    return func(str, size);
+}
+
+//
+// SIMD searches, see the comment above their declarations in string.h
+//
+
+file_scope s64 utf8_find_substring_scalar(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize) {
+    for (s64 i = 0; i + needleSize <= size; ++i) {
+        if (str[i] == needle[0] && equal_memory(str + i, needle, needleSize)) return i;
+    }
+    return -1;
+}
+
+// Builds the tables for the nibble lookup. Bit h of LowNibbles[l] is set if the set contains the byte (h << 4 | l),
+// HighNibbles[h] is (1 << h) for ASCII and 0 for the rest.
+struct ascii_set_tables {
+    alignas(16) u8 LowNibbles[16];
+    alignas(16) u8 HighNibbles[16];
+};
+
+file_scope ascii_set_tables ascii_set_tables_build(const utf8 *set, s64 setSize) {
+    ascii_set_tables t = {};
+    For(range(8)) t.HighNibbles[it] = (u8) (1 << it);
+    For(range(setSize)) {
+        u8 b = (u8) set[it];
+        t.LowNibbles[b & 0x0F] |= (u8) (1 << (b >> 4));
+    }
+    return t;
+}
+
+file_scope s64 utf8_find_any_of_ascii_scalar(const utf8 *str, s64 size, const ascii_set_tables &t, bool notAnyOf) {
+    For(range(size)) {
+        u8 b = (u8) str[it];
+        bool in = t.LowNibbles[b & 0x0F] & t.HighNibbles[b >> 4];
+        if (in != notAnyOf) return it;
+    }
+    return -1;
+}
+
+#if ARCH == X86
+file_scope s64 utf8_find_substring_sse2(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize) {
+    if (needleSize > size) return -1;
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+
+    s64 i = 0;
+    for (; i + 16 + needleSize - 1 <= size; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i *) (str + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i *) (str + i + needleSize - 1));
+
+        u32 mask = (u32) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            s64 candidate = i + lsb(mask);
+            if (needleSize <= 2 || equal_memory(str + candidate + 1, needle + 1, needleSize - 2)) return candidate;
+            mask &= mask - 1;
+        }
+    }
+
+    s64 rest = utf8_find_substring_scalar(str + i, size - i, needle, needleSize);
+    return rest == -1 ? -1 : i + rest;
+}
+
+TARGET_AVX2 file_scope s64 utf8_find_substring_avx2(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize) {
+    if (needleSize > size) return -1;
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+
+    s64 i = 0;
+    for (; i + 32 + needleSize - 1 <= size; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i *) (str + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i *) (str + i + needleSize - 1));
+
+        u32 mask = (u32) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            s64 candidate = i + lsb(mask);
+            if (needleSize <= 2 || equal_memory(str + candidate + 1, needle + 1, needleSize - 2)) return candidate;
+            mask &= mask - 1;
+        }
+    }
+
+    s64 rest = utf8_find_substring_sse2(str + i, size - i, needle, needleSize);
+    return rest == -1 ? -1 : i + rest;
+}
+
+TARGET_SSSE3 file_scope s64 utf8_find_any_of_ascii_ssse3(const utf8 *str, s64 size, const ascii_set_tables &t, bool notAnyOf) {
+    const __m128i lowTable = _mm_load_si128((const __m128i *) t.LowNibbles);
+    const __m128i highTable = _mm_load_si128((const __m128i *) t.HighNibbles);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    s64 i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (str + i));
+
+        __m128i lo = _mm_shuffle_epi8(lowTable, _mm_and_si128(v, nibble));
+        __m128i hi = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+
+        // Bytes whose masks don't intersect (aren't in the set)
+        u32 notIn = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero));
+        u32 mask = notAnyOf ? notIn : ~notIn & 0xFFFF;
+        if (mask) return i + lsb(mask);
+    }
+
+    s64 rest = utf8_find_any_of_ascii_scalar(str + i, size - i, t, notAnyOf);
+    return rest == -1 ? -1 : i + rest;
+}
+
+TARGET_AVX2 file_scope s64 utf8_find_any_of_ascii_avx2(const utf8 *str, s64 size, const ascii_set_tables &t, bool notAnyOf) {
+    const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) t.LowNibbles));
+    const __m256i highTable = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) t.HighNibbles));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    s64 i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (str + i));
+
+        __m256i lo = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+        u32 notIn = (u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero));
+        u32 mask = notAnyOf ? notIn : ~notIn;
+        if (mask) return i + lsb(mask);
+    }
+
+    s64 rest = utf8_find_any_of_ascii_scalar(str + i, size - i, t, notAnyOf);
+    return rest == -1 ? -1 : i + rest;
+}
+#endif
+
+s64 internal::utf8_find_substring_simd(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize) {
+    using find_substring_func = s64 (*)(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize);
+
+    local_persist cpu_dispatch<find_substring_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> find_substring_func {
+#if ARCH == X86
+        return cpu.AVX2 ? utf8_find_substring_avx2 : utf8_find_substring_sse2;
+#else
+        return utf8_find_substring_scalar;
+#endif
+    });
+    return func(str, size, needle, needleSize);
+}
+
+s64 internal::utf8_find_any_of_ascii_simd(const utf8 *str, s64 size, const utf8 *set, s64 setSize, bool notAnyOf) {
+    using find_any_of_func = s64 (*)(const utf8 *str, s64 size, const ascii_set_tables &t, bool notAnyOf);
+
+    local_persist cpu_dispatch<find_any_of_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> find_any_of_func {
+#if ARCH == X86
+        if (cpu.AVX2) return utf8_find_any_of_ascii_avx2;
+        if (cpu.SSSE3) return utf8_find_any_of_ascii_ssse3;
+#endif
+        return utf8_find_any_of_ascii_scalar;
+    });
+
+    ascii_set_tables t = ascii_set_tables_build(set, setSize);
+    return func(str, size, t, notAnyOf);
+}
+
+//
+// ASCII fast paths for case conversion and comparison. A lowercase/uppercase ASCII letter differs from the other
+// case only in bit 5, so we find the letters with two signed compares (bytes >= 0x80 are negative and never match)
+// and flip that bit.
+//
+
+#if ARCH == X86
+// 0x20 for each byte which is in [lo, hi], 0 otherwise
+file_scope always_inline __m128i ascii_case_bits(__m128i v, char lo, char hi) {
+    __m128i in = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+    return _mm_and_si128(in, _mm_set1_epi8(0x20));
+}
+#endif
+
+s64 internal::ascii_prefix_equal_ignore_case(const utf8 *a, const utf8 *b, s64 size) {
+    s64 i = 0;
+#if ARCH == X86
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+
+        __m128i lx = _mm_or_si128(x, ascii_case_bits(x, 'A', 'Z'));
+        __m128i ly = _mm_or_si128(y, ascii_case_bits(y, 'A', 'Z'));
+
+        // Stop at the first difference or non-ASCII byte
+        u32 equal = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(lx, ly));
+        u32 nonAscii = (u32) _mm_movemask_epi8(_mm_or_si128(x, y));
+        u32 stop = (~equal | nonAscii) & 0xFFFF;
+        if (stop) return i + lsb(stop);
+    }
+#endif
+    for (; i < size; ++i) {
+        u8 x = (u8) a[i], y = (u8) b[i];
+        if ((x | y) >= 0x80 || to_lower(x) != to_lower(y)) break;
+    }
+    return i;
+}
+
+template <bool Upper>
+file_scope void string_convert_case(string &s) {
+    // Make sure we can modify the string (it's not a view)
+    string_reserve(s, 0);
+
+    s64 i = 0;
+    while (i < s.Count) {
+#if ARCH == X86
+        if (s.Count - i >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (s.Data + i));
+            if (!_mm_movemask_epi8(v)) {
+                __m128i bits = Upper ? ascii_case_bits(v, 'a', 'z') : ascii_case_bits(v, 'A', 'Z');
+                _mm_storeu_si128((__m128i *) (s.Data + i), _mm_xor_si128(v, bits));
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        utf8 *p = s.Data + i;
+
+        s64 size = get_size_of_cp(p);
+        if (!size) {
+            ++i;  // Invalid, skip the stray continuation byte
+            continue;
+        }
+
+        utf32 cp = decode_cp(p);
+        utf32 converted = Upper ? to_upper(cp) : to_lower(cp);
+
+        s64 newSize = get_size_of_cp(converted);
+        if (newSize != size) {
+            // A few code points have a different size in the other case (e.g. U+0131 dotless i to I)
+            array_remove_range(s, i, i + size);
+            array_insert_uninitialized(s, i, newSize);
+            p = s.Data + i;
+        }
+        encode_cp(p, converted);
+        i += newSize;
+    }
+}
+
+void string_to_upper(string &s) { string_convert_case<true>(s); }
+void string_to_lower(string &s) { string_convert_case<false>(s); }
+
+//
+// utf8 <-> utf16 transcoding (used by the Windows layer for every path and API call). ASCII is widened 16 bytes at a
+// time with unpack (and narrowed back with packus after checking no code unit is >= 0x80). When a block contains
+// anything else we convert the ASCII before it, then one code point with the scalar code, and try a block again.
+//
+// The vector paths assume 16 bit utf16 (wchar_t on Windows).
+//
+
+void internal::utf8_to_utf16_simd(const utf8 *str, s64 length, utf16 *out) {
+#if ARCH == X86
+    if constexpr (sizeof(utf16) == 2) {
+        // 16 code points left means at least 16 bytes left, so the loads never read past the end
+        while (length >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *) str);
+
+            u32 nonAscii = (u32) _mm_movemask_epi8(v);
+            if (!nonAscii) {
+                _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+                _mm_storeu_si128((__m128i *) out + 1, _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+                str += 16, out += 16, length -= 16;
+                continue;
+            }
+
+            s64 ascii = lsb(nonAscii);
+            For(range(ascii)) out[it] = (utf16) str[it];
+            str += ascii, out += ascii, length -= ascii;
+
+            utf32 cp = decode_cp(str);
+            out += encode_utf16_cp(out, cp);
+            str += get_size_of_cp(cp);
+            --length;
+        }
+    }
+#endif
+    For(range(length)) {
+        utf32 cp = decode_cp(str);
+        out += encode_utf16_cp(out, cp);
+        str += get_size_of_cp(cp);
+    }
+    *out = 0;
+}
+
+s64 internal::utf16_to_utf8_simd(const utf16 *str, s64 count, utf8 *out) {
+    utf8 *begin = out;
+#if ARCH == X86
+    if constexpr (sizeof(utf16) == 2) {
+        const __m128i notAscii = _mm_set1_epi16((s16) 0xFF80);
+        while (count >= 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *) str);
+            __m128i b = _mm_loadu_si128((const __m128i *) str + 1);
+
+            // 2 bits per code unit, set for the ones < 0x80
+            u32 ascii = (u32) _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(a, notAscii), _mm_setzero_si128()));
+            ascii |= (u32) _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, notAscii), _mm_setzero_si128())) << 16;
+            if (ascii == 0xFFFFFFFF) {
+                _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(a, b));
+                str += 16, out += 16, count -= 16;
+                continue;
+            }
+
+            s64 asciiCount = lsb(~ascii) / 2;
+            For(range(asciiCount)) out[it] = (utf8) str[it];
+            str += asciiCount, out += asciiCount, count -= asciiCount;
+
+            utf32 cp;
+            s64 units = decode_utf16_cp(str, count, &cp);
+            str += units, count -= units;
+            encode_cp(out, cp);
+            out += get_size_of_cp(out);
+        }
+    }
+#endif
+    while (count > 0) {
+        utf32 cp;
+        s64 units = decode_utf16_cp(str, count, &cp);
+        str += units, count -= units;
+        encode_cp(out, cp);
+        out += get_size_of_cp(out);
+    }
+    return out - begin;
+}
+
+//
+// utf8 <-> utf32 works the same way. Widening ASCII to 32 bits is two rounds of unpack (bytes to 16 bits, then to 32),
+// narrowing back is packs + packus after checking all 16 code points are < 0x80 (code points are at most 0x10FFFF,
+// so the signed compare is fine).
+//
+
+#if ARCH == X86
+file_scope always_inline void widen_ascii_to_utf32(__m128i v, utf32 *out) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo   = _mm_unpacklo_epi8(v, zero);
+    __m128i hi   = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *) out + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *) out + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *) out + 3, _mm_unpackhi_epi16(hi, zero));
+}
+#endif
+
+void internal::utf8_to_utf32_simd(const utf8 *str, s64 length, utf32 *out) {
+#if ARCH == X86
+    // 16 code points left means at least 16 bytes left, so the loads never read past the end
+    while (length >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) str);
+
+        u32 nonAscii = (u32) _mm_movemask_epi8(v);
+        if (!nonAscii) {
+            widen_ascii_to_utf32(v, out);
+            str += 16, out += 16, length -= 16;
+            continue;
+        }
+
+        s64 ascii = lsb(nonAscii);
+        For(range(ascii)) out[it] = (utf32) str[it];
+        str += ascii, out += ascii, length -= ascii;
+
+        utf32 cp = decode_cp(str);
+        *out++   = cp;
+        str += get_size_of_cp(cp);
+        --length;
+    }
+#endif
+    For(range(length)) {
+        utf32 cp = decode_cp(str);
+        *out++   = cp;
+        str += get_size_of_cp(cp);
+    }
+    *out = 0;
+}
+
+s64 internal::utf32_to_utf8_simd(const utf32 *str, s64 count, utf8 *out) {
+    utf8 *begin = out;
+#if ARCH == X86
+    const __m128i asciiMax = _mm_set1_epi32(0x7F);
+    while (count >= 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) str);
+        __m128i b = _mm_loadu_si128((const __m128i *) str + 1);
+        __m128i c = _mm_loadu_si128((const __m128i *) str + 2);
+        __m128i d = _mm_loadu_si128((const __m128i *) str + 3);
+
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (!_mm_movemask_epi8(_mm_cmpgt_epi32(any, asciiMax))) {
+            _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+            str += 16, out += 16, count -= 16;
+            continue;
+        }
+
+        // 4 bits per code point, set for the ones > 0x7F
+        u32 wide = (u32) _mm_movemask_epi8(_mm_cmpgt_epi32(a, asciiMax));
+        wide |= (u32) _mm_movemask_epi8(_mm_cmpgt_epi32(b, asciiMax)) << 16;
+
+        s64 asciiCount = wide ? lsb(wide) / 4 : 8;
+        For(range(asciiCount)) out[it] = (utf8) str[it];
+        str += asciiCount, out += asciiCount, count -= asciiCount;
+
+        encode_cp(out, *str);
+        out += get_size_of_cp(out);
+        ++str, --count;
+    }
+#endif
+    For(range(count)) {
+        encode_cp(out, str[it]);
+        out += get_size_of_cp(out);
+    }
+    return out - begin;
+}
+
+s64 utf8_to_utf32_block(const utf8 **str, const utf8 *end, utf32 *out, s64 capacity) {
+    const utf8 *p = *str;
+    s64 written   = 0;
+
+#if ARCH == X86
+    // Here the bound is the bytes, every byte makes at most one code point
+    while (end - p >= 16 && capacity - written >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+
+        u32 nonAscii = (u32) _mm_movemask_epi8(v);
+        if (!nonAscii) {
+            widen_ascii_to_utf32(v, out + written);
+            p += 16, written += 16;
+            continue;
+        }
+
+        s64 ascii = lsb(nonAscii);
+        For(range(ascii)) out[written + it] = (utf32) p[it];
+        p += ascii, written += ascii;
+
+        // The sequence can still be cut off by _end_ when it starts near the end of the block
+        s64 size = get_size_of_cp(p);
+        if (!size || size > end - p) {
+            out[written++] = 0xFFFD;
+            ++p;
+            continue;
+        }
+        out[written++] = decode_cp(p);
+        p += size;
+    }
+#endif
+    while (p < end && written < capacity) {
+        s64 size = get_size_of_cp(p);
+        if (!size || size > end - p) {
+            out[written++] = 0xFFFD;
+            ++p;
+            continue;
+        }
+        out[written++] = decode_cp(p);
+        p += size;
+    }
+
+    *str = p;
+    return written;
+}
+
 LSTD_END_NAMESPACE
@@ -2,6 +2,7 @@
 
 #include "../memory/allocator.h"
 #include "array.h"
+#include "hash.h"
 
 LSTD_BEGIN_NAMESPACE
 
@@ -14,9 +15,21 @@ LSTD_BEGIN_NAMESPACE
 //
 // Functions on this object allow negative reversed indexing which begins at
 // the end of the string, so -1 is the last code point -2 the one before that, etc. (Python-style)
+struct string;
+
+// Returns a pointer to the code point at _index_ in _s_ (which must be in bounds, see translate_index()).
+// If the string is all ASCII (Length == Count) this is O(1), otherwise we walk from the start.
+// For random access to long non-ASCII strings see string_index.h.
+constexpr const utf8 *string_get_cp_at_index(const string &s, s64 index);
+
+// Returns the index of the code point which begins at byte _offset_. O(1) for ASCII strings.
+constexpr s64 string_get_cp_index_at_offset(const string &s, s64 offset);
+
 struct string : array<utf8> {
     s64 Length = 0;  // Length of the string in unicode code points
 
+    static constexpr bool ZERO_CONSTRUCT = true;  // See array
+
     constexpr string() {}
 
     // Create a string from a null terminated c-string.
@@ -27,7 +40,7 @@ struct string : array<utf8> {
     constexpr string(const char8_t *str) : array<utf8>((utf8 *) str, c_string_length(str)), Length(utf8_length((utf8 *) str, Count)) {}
 
     // Create a string from a buffer and a length.
-    // Note that this constructor doesn't validate if the passed in string is valid utf8.
+    // Note that this constructor doesn't validate if the passed in string is valid utf8 (see make_validated_string).
     constexpr string(const utf8 *str, s64 size) : array<utf8>((utf8 *) str, size), Length(utf8_length(str, size)) {}
 
     // Create a string from a buffer and a length.
@@ -96,7 +109,7 @@ struct string : array<utf8> {
 
         auto operator*() { return (*Parent)[Index]; }
 
-        operator const utf8 *() const { return get_cp_at_index(Parent->Data, translate_index(Index, Parent->Length, true)); }
+        operator const utf8 *() const { return string_get_cp_at_index(*Parent, translate_index(Index, Parent->Length, true)); }
     };
 
    public:
@@ -132,7 +145,7 @@ struct string : array<utf8> {
 
     // The non-const version allows to modify the character by simply =.
     code_point_ref operator[](s64 index) { return code_point_ref(this, translate_index(index, Length)); }
-    constexpr utf32 operator[](s64 index) const { return decode_cp(get_cp_at_index(Data, translate_index(index, Length))); }
+    constexpr utf32 operator[](s64 index) const { return decode_cp(string_get_cp_at_index(*this, translate_index(index, Length))); }
 
     // Substring operator:
     // constexpr string operator()(s64 begin, s64 end) const;
@@ -147,8 +160,30 @@ struct string : array<utf8> {
 template <>
 struct is_array_helper<string> : types::true_t {};
 
+constexpr const utf8 *string_get_cp_at_index(const string &s, s64 index) {
+    if (s.Length == s.Count) return s.Data + index;
+    return get_cp_at_index(s.Data, index);
+}
+
+constexpr s64 string_get_cp_index_at_offset(const string &s, s64 offset) {
+    if (s.Length == s.Count) return offset;
+    return utf8_length(s.Data, offset);
+}
+
+// Makes a view of _str_ like string(str, size), but checks that it's valid utf8 first (see utf8_find_invalid).
+// Use this for input which comes from outside (files, sockets). If the input is invalid, the result is a view of
+// the valid part before the first bad sequence. _outInvalidAt_ (if not null) receives the byte offset of
+// that sequence, or -1 if everything was valid.
+constexpr string make_validated_string(const utf8 *str, s64 size, s64 *outInvalidAt = null) {
+    s64 invalidAt = utf8_find_invalid(str, size);
+    if (outInvalidAt) *outInvalidAt = invalidAt;
+    return string(str, invalidAt == -1 ? size : invalidAt);
+}
+
+constexpr string make_validated_string(const bytes &data, s64 *outInvalidAt = null) { return make_validated_string((const utf8 *) data.Data, data.Count, outInvalidAt); }
+
 // Make sure you call the string_ overloads because array_ functions don't calculate the Length (which we cache).
-inline void string_reserve(string &s, s64 n) { array_reserve(s, n); }
+inline void string_reserve(string &s, s64 n, array_growth growth = array_growth::DEFAULT) { array_reserve(s, n, growth); }
 
 inline void string_reset(string &s) { array_reset(s), s.Length = 0; }
 inline void free(string &s) { free((array<utf8> &) s), s.Length = 0; }
@@ -191,6 +226,13 @@ void string_remove_at(string &s, s64 index);
 // Remove a range of code points. [begin, end)
 void string_remove_range(string &s, s64 begin, s64 end);
 
+// Converts the string to upper case in place. ASCII parts are converted 16 bytes at a time,
+// the rest code point by code point with to_upper().
+void string_to_upper(string &s);
+
+// Converts the string to lower case in place, see string_to_upper().
+void string_to_lower(string &s);
+
 // Append a non encoded character to a string.
 inline void string_append(string &s, utf32 codePoint) { return string_insert_at(s, s.Length, codePoint); }
 
@@ -248,12 +290,41 @@ inline void string_replace_all(string &s, const string &oldStr, utf32 newCp) {
 // Comparison and searching:
 //
 
+namespace internal {
+// Byte comparisons which also work at compile time. At runtime they go to the SIMD compare_memory/equal_memory.
+constexpr bool bytes_equal(const utf8 *a, const utf8 *b, s64 count) {
+    if (!is_constant_evaluated()) return equal_memory(a, b, count);
+
+    For(range(count)) if (a[it] != b[it]) return false;
+    return true;
+}
+
+constexpr s64 bytes_mismatch(const utf8 *a, const utf8 *b, s64 count) {
+    if (!is_constant_evaluated()) return compare_memory(a, b, count);
+
+    For(range(count)) if (a[it] != b[it]) return it;
+    return -1;
+}
+}  // namespace internal
+
 // Compares two utf8 encoded strings and returns the index
 // of the code point at which they are different or _-1_ if they are the same.
 constexpr s64 compare(const string &s, const string &other) {
     if (!s && !other) return -1;
     if (!s || !other) return 0;
 
+    if (!is_constant_evaluated()) {
+        // Find the first different byte and count the code points before the one it's in
+        s64 n = min(s.Count, other.Count);
+        s64 diff = internal::bytes_mismatch(s.Data, other.Data, n);
+        if (diff == -1) {
+            if (s.Count == other.Count) return -1;
+            return utf8_length(s.Data, n) - 1;  // One is a prefix of the other, the loop below returns the last common index
+        }
+        while (diff && (s.Data[diff] & 0xc0) == 0x80) --diff;
+        return utf8_length(s.Data, diff);
+    }
+
     auto *p1 = s.Data, *p2 = other.Data;
     auto *e1 = p1 + s.Count, *e2 = p2 + other.Count;
 
@@ -268,16 +339,35 @@ constexpr s64 compare(const string &s, const string &other) {
     return index;
 }
 
+namespace internal {
+// Defined in string.cpp. Returns the number of bytes at the start of _a_ and _b_ which are ASCII and equal
+// ignoring case (checks 16 at a time with SSE2). The callers continue code point by code point from there.
+s64 ascii_prefix_equal_ignore_case(const utf8 *a, const utf8 *b, s64 size);
+
+// Skips the common ASCII prefix of two strings for the ignore case comparisons below. We stop one code point
+// before the end of the shorter string, so the loop after that handles the end exactly like before.
+constexpr s64 skip_ascii_prefix_ignore_case(const utf8 *&p1, const utf8 *&p2, s64 count1, s64 count2) {
+    if (is_constant_evaluated()) return 0;
+
+    s64 n = min(count1, count2);
+    if (n < 16) return 0;
+
+    s64 skip = min(ascii_prefix_equal_ignore_case(p1, p2, n), n - 1);
+    p1 += skip, p2 += skip;
+    return skip;
+}
+}  // namespace internal
+
 // Compares two utf8 encoded strings while ignoring case and returns the index
 // of the code point at which they are different or _-1_ if they are the same.
 constexpr s64 compare_ignore_case(const string &s, const string &other) {
     if (!s && !other) return -1;
     if (!s || !other) return 0;
 
-    auto *p1 = s.Data, *p2 = other.Data;
+    const utf8 *p1 = s.Data, *p2 = other.Data;
     auto *e1 = p1 + s.Count, *e2 = p2 + other.Count;
 
-    s64 index = 0;
+    s64 index = internal::skip_ascii_prefix_ignore_case(p1, p2, s.Count, other.Count);
     while (to_lower(decode_cp(p1)) == to_lower(decode_cp(p2))) {
         p1 += get_size_of_cp(p1);
         p2 += get_size_of_cp(p2);
@@ -297,6 +387,14 @@ constexpr s32 compare_lexicographically(const string &a, const string &b) {
     if (!a) return -1;
     if (!b) return 1;
 
+    if (!is_constant_evaluated()) {
+        // In utf8 the order of the bytes is the order of the code points, so the first different byte decides
+        s64 n = min(a.Count, b.Count);
+        s64 diff = internal::bytes_mismatch(a.Data, b.Data, n);
+        if (diff == -1) return a.Count == b.Count ? 0 : (a.Count < b.Count ? -1 : 1);
+        return (u8) a.Data[diff] < (u8) b.Data[diff] ? -1 : 1;
+    }
+
     auto *p1 = a.Data, *p2 = b.Data;
     auto *e1 = p1 + a.Count, *e2 = p2 + b.Count;
 
@@ -321,10 +419,10 @@ constexpr s32 compare_lexicographically_ignore_case(const string &a, const strin
     if (!a) return -1;
     if (!b) return 1;
 
-    auto *p1 = a.Data, *p2 = b.Data;
+    const utf8 *p1 = a.Data, *p2 = b.Data;
     auto *e1 = p1 + a.Count, *e2 = p2 + b.Count;
 
-    s64 index = 0;
+    s64 index = internal::skip_ascii_prefix_ignore_case(p1, p2, a.Count, b.Count);
     while (to_lower(decode_cp(p1)) == to_lower(decode_cp(p2))) {
         p1 += get_size_of_cp(p1);
         p2 += get_size_of_cp(p2);
@@ -336,6 +434,18 @@ constexpr s32 compare_lexicographically_ignore_case(const string &a, const strin
     return ((s64) to_lower(decode_cp(p1)) - (s64) to_lower(decode_cp(p2))) < 0 ? -1 : 1;
 }
 
+namespace internal {
+// Defined in string.cpp. SIMD versions of find_substring() and find_any_of() (SSE2/SSSE3 or AVX2, picked at runtime),
+// they work on bytes and return byte offsets (or -1).
+//
+// The substring search compares the first and the last byte of the needle with 16 (or 32) positions at once and
+// only checks the rest of the needle at positions where both matched. The set search looks up the two nibbles of each
+// byte in two tables of bit masks (with pshufb) - a byte is in the set if the masks intersect. This is exact for
+// ASCII sets of any size (there are only 8 possible high nibbles, one bit each).
+s64 utf8_find_substring_simd(const utf8 *str, s64 size, const utf8 *needle, s64 needleSize);
+s64 utf8_find_any_of_ascii_simd(const utf8 *str, s64 size, const utf8 *set, s64 setSize, bool notAnyOf);
+}  // namespace internal
+
 // Searches for the first occurence of a substring which is after a specified _start_ index.
 // Returns -1 if no index was found.
 constexpr s64 find_substring(const string &haystack, const string &needle, s64 start = 0) {
@@ -345,9 +455,14 @@ constexpr s64 find_substring(const string &haystack, const string &needle, s64 s
 
     if (start >= haystack.Length || start <= -haystack.Length) return -1;
 
-    auto *p = get_cp_at_index(haystack.Data, translate_index(start, haystack.Length));
+    auto *p = string_get_cp_at_index(haystack, translate_index(start, haystack.Length));
     auto *end = haystack.Data + haystack.Count;
 
+    if (!is_constant_evaluated() && end - p >= 16) {
+        s64 offset = internal::utf8_find_substring_simd(p, end - p, needle.Data, needle.Count);
+        return offset == -1 ? -1 : string_get_cp_index_at_offset(haystack, p - haystack.Data + offset);
+    }
+
     auto *needleEnd = needle.Data + needle.Count;
 
     while (p != end) {
@@ -366,7 +481,7 @@ constexpr s64 find_substring(const string &haystack, const string &needle, s64 s
         auto *search = p + 1;
         auto *progress = needle.Data + 1;
         while (search != end && progress != needleEnd && *search == *progress) ++search, ++progress;
-        if (progress == needleEnd) return utf8_length(haystack.Data, p - haystack.Data);
+        if (progress == needleEnd) return string_get_cp_index_at_offset(haystack, p - haystack.Data);
         ++p;
     }
     return -1;
@@ -390,7 +505,7 @@ constexpr s64 find_substring_reverse(const string &haystack, const string &needl
     if (start >= haystack.Length || start <= -haystack.Length) return -1;
     if (start == 0) start = haystack.Length;
 
-    auto *p = get_cp_at_index(haystack.Data, translate_index(start, haystack.Length, true) - 1);
+    auto *p = string_get_cp_at_index(haystack, translate_index(start, haystack.Length, true) - 1);
     auto *end = haystack.Data + haystack.Count;
 
     auto *needleEnd = needle.Data + needle.Count;
@@ -411,7 +526,7 @@ constexpr s64 find_substring_reverse(const string &haystack, const string &needl
         auto *search = p + 1;
         auto *progress = needle.Data + 1;
         while (search != end && progress != needleEnd && *search == *progress) ++search, ++progress;
-        if (progress == needleEnd) return utf8_length(haystack.Data, p - haystack.Data);
+        if (progress == needleEnd) return string_get_cp_index_at_offset(haystack, p - haystack.Data);
         --p;
     }
     return -1;
@@ -439,7 +554,7 @@ constexpr s64 find_substring_not(const string &s, const string &eat, s64 start =
 
     if (start >= s.Length || start <= -s.Length) return -1;
 
-    auto *p = get_cp_at_index(s.Data, translate_index(start, s.Length));
+    auto *p = string_get_cp_at_index(s, translate_index(start, s.Length));
     auto *end = s.Data + s.Count;
 
     auto *eatEnd = eat.Data + eat.Count;
@@ -454,7 +569,7 @@ constexpr s64 find_substring_not(const string &s, const string &eat, s64 start =
         auto *search = p + 1;
         auto *progress = eat.Data + 1;
         while (search != end && progress != eatEnd && *search != *progress) ++search, ++progress;
-        if (progress == eatEnd) return utf8_length(s.Data, p - s.Data);
+        if (progress == eatEnd) return string_get_cp_index_at_offset(s, p - s.Data);
         ++p;
     }
     return -1;
@@ -483,7 +598,7 @@ constexpr s64 find_substring_reverse_not(const string &s, const string &eat, s64
     if (start >= s.Length || start <= -s.Length) return -1;
     if (start == 0) start = s.Length;
 
-    auto *p = get_cp_at_index(s.Data, translate_index(start, s.Length, true) - 1);
+    auto *p = string_get_cp_at_index(s, translate_index(start, s.Length, true) - 1);
     auto *end = s.Data + s.Count;
 
     auto *eatEnd = eat.Data + eat.Count;
@@ -499,7 +614,7 @@ constexpr s64 find_substring_reverse_not(const string &s, const string &eat, s64
         auto *search = p + 1;
         auto *progress = eat.Data + 1;
         while (search != end && progress != eatEnd && *search != *progress) ++search, ++progress;
-        if (progress == eatEnd) return utf8_length(s.Data, p - s.Data);
+        if (progress == eatEnd) return string_get_cp_index_at_offset(s, p - s.Data);
         --p;
     }
     return -1;
@@ -528,10 +643,17 @@ constexpr s64 find_any_of(const string &s, const string &anyOfThese, s64 start =
     if (start >= s.Length || start <= -s.Length) return -1;
 
     start = translate_index(start, s.Length);
-    auto *p = get_cp_at_index(s.Data, start);
+    auto *p = string_get_cp_at_index(s, start);
+
+    // Delimiter sets are usually ASCII
+    s64 rest = s.Data + s.Count - p;
+    if (!is_constant_evaluated() && anyOfThese.Length == anyOfThese.Count && rest >= 16) {
+        s64 offset = internal::utf8_find_any_of_ascii_simd(p, rest, anyOfThese.Data, anyOfThese.Count, false);
+        return offset == -1 ? -1 : string_get_cp_index_at_offset(s, p - s.Data + offset);
+    }
 
     For(range(start, s.Length)) {
-        if (find_cp(anyOfThese, decode_cp(p)) != -1) return utf8_length(s.Data, p - s.Data);
+        if (find_cp(anyOfThese, decode_cp(p)) != -1) return it;
         p += get_size_of_cp(p);
     }
     return -1;
@@ -548,10 +670,10 @@ constexpr s64 find_reverse_any_of(const string &s, const string &anyOfThese, s64
     if (start == 0) start = s.Length;
 
     start = translate_index(start, s.Length, true) - 1;
-    auto *p = get_cp_at_index(s.Data, start);
+    auto *p = string_get_cp_at_index(s, start);
 
     For(range(start, -1, -1)) {
-        if (find_cp(anyOfThese, decode_cp(p)) != -1) return utf8_length(s.Data, p - s.Data);
+        if (find_cp(anyOfThese, decode_cp(p)) != -1) return string_get_cp_index_at_offset(s, p - s.Data);
         p -= get_size_of_cp(p);
     }
     return -1;
@@ -567,10 +689,17 @@ constexpr s64 find_not_any_of(const string &s, const string &anyOfThese, s64 sta
     if (start >= s.Length || start <= -s.Length) return -1;
 
     start = translate_index(start, s.Length);
-    auto *p = get_cp_at_index(s.Data, start);
+    auto *p = string_get_cp_at_index(s, start);
+
+    // Delimiter sets are usually ASCII
+    s64 rest = s.Data + s.Count - p;
+    if (!is_constant_evaluated() && anyOfThese.Length == anyOfThese.Count && rest >= 16) {
+        s64 offset = internal::utf8_find_any_of_ascii_simd(p, rest, anyOfThese.Data, anyOfThese.Count, true);
+        return offset == -1 ? -1 : string_get_cp_index_at_offset(s, p - s.Data + offset);
+    }
 
     For(range(start, s.Length)) {
-        if (find_cp(anyOfThese, decode_cp(p)) == -1) return utf8_length(s.Data, p - s.Data);
+        if (find_cp(anyOfThese, decode_cp(p)) == -1) return it;
         p += get_size_of_cp(p);
     }
     return -1;
@@ -587,10 +716,10 @@ constexpr s64 find_reverse_not_any_of(const string &s, const string &anyOfThese,
     if (start == 0) start = s.Length;
 
     start = translate_index(start, s.Length, true) - 1;
-    auto *p = get_cp_at_index(s.Data, start);
+    auto *p = string_get_cp_at_index(s, start);
 
     For(range(start, -1, -1)) {
-        if (find_cp(anyOfThese, decode_cp(p)) == -1) return utf8_length(s.Data, p - s.Data);
+        if (find_cp(anyOfThese, decode_cp(p)) == -1) return string_get_cp_index_at_offset(s, p - s.Data);
         p -= get_size_of_cp(p);
     }
     return -1;
@@ -635,9 +764,13 @@ constexpr string substring(const string &s, s64 begin, s64 end) {
     s64 beginIndex = translate_index(begin, s.Length);
     s64 endIndex = translate_index(end, s.Length, true);
 
-    const utf8 *beginPtr = get_cp_at_index(s.Data, beginIndex);
+    const utf8 *beginPtr = string_get_cp_at_index(s, beginIndex);
     const utf8 *endPtr = beginPtr;
-    For(range(beginIndex, endIndex)) endPtr += get_size_of_cp(endPtr);
+    if (s.Length == s.Count) {
+        endPtr = s.Data + endIndex;
+    } else {
+        For(range(beginIndex, endIndex)) endPtr += get_size_of_cp(endPtr);
+    }
 
     return string(beginPtr, endPtr - beginPtr);
 }
@@ -645,13 +778,13 @@ constexpr string substring(const string &s, s64 begin, s64 end) {
 // Returns true if _s_ begins with _str_
 constexpr bool match_beginning(const string &s, const string &str) {
     if (str.Count > s.Count) return false;
-    return compare_memory(s.Data, str.Data, str.Count) == -1;
+    return internal::bytes_equal(s.Data, str.Data, str.Count);
 }
 
 // Returns true if _s_ ends with _str_
 constexpr bool match_end(const string &s, const string &str) {
     if (str.Count > s.Count) return false;
-    return compare_memory(s.Data + s.Count - str.Count, str.Data, str.Count) == -1;
+    return internal::bytes_equal(s.Data + s.Count - str.Count, str.Data, str.Count);
 }
 
 // Returns a substring with white space removed at the start.
@@ -669,11 +802,165 @@ constexpr string trim_end(const string &s) { return substring(s, 0, find_reverse
 // We can do this because we don't store strings with a zero terminator.
 constexpr string trim(const string &s) { return trim_end(trim_start(s)); }
 
+//
+// Lazy splitting. These return ranges which find the next piece only when you step to it and give substring views
+// into _s_, so nothing is allocated:
+//
+//     For(split(line, ",")) { ... }         // "a,,b" -> "a", "", "b"
+//     For(split_whitespace(s)) { ... }      // "  a \t b\n" -> "a", "b"
+//     For(lines(file)) { ... }              // Splits on \n, strips \r, no empty line after a trailing \n
+//
+// Delimiters are code points, _delims_ is a set (like in find_any_of()). ASCII sets are searched with SIMD.
+//
+
+namespace internal {
+// Byte offset of the first code point in _str_ which is in _set_ (or isn't, with _notAnyOf_), or -1.
+constexpr s64 utf8_find_any_of(const utf8 *str, s64 size, const string &set, bool notAnyOf) {
+    if (!is_constant_evaluated() && set.Length == set.Count && size >= 16) {
+        return utf8_find_any_of_ascii_simd(str, size, set.Data, set.Count, notAnyOf);
+    }
+
+    const utf8 *p = str, *end = str + size;
+    while (p < end) {
+        if ((find_cp(set, decode_cp(p)) != -1) != notAnyOf) return p - str;
+
+        s64 cpSize = get_size_of_cp(p);
+        p += cpSize ? cpSize : 1;  // Skip stray continuation bytes
+    }
+    return -1;
+}
+}  // namespace internal
+
+enum class string_split_mode {
+    Split,       // Every delimiter ends a piece, so there are empty pieces between consecutive delimiters
+    Whitespace,  // Runs of delimiters count as one, no empty pieces
+    Lines        // Like Split, but strips \r and doesn't make an empty piece at the very end
+};
+
+struct string_split_range {
+    string Source;
+    string Delims;
+    string_split_mode Mode;
+
+    struct iterator {
+        const string_split_range *Range = null;
+        const utf8 *Begin = null, *End = null;  // The current piece
+        const utf8 *Next = null;                // Where the next piece starts, null after the last one
+        const utf8 *Stop = null;                // The end of the source
+
+        constexpr iterator() {}
+        constexpr iterator(const string_split_range *range) : Range(range) {
+            // Splitting a null string gives the same as splitting ""
+            Next = range->Source.Data ? range->Source.Data : "";
+            Stop = Next + range->Source.Count;
+            ++*this;
+        }
+
+        constexpr string operator*() const { return string(Begin, End - Begin); }
+
+        constexpr iterator &operator++() {
+            if (!Next) {
+                Range = null;  // Done
+                return *this;
+            }
+
+            const utf8 *p = Next, *end = Stop;
+            if (Range->Mode == string_split_mode::Whitespace) {
+                s64 skip = internal::utf8_find_any_of(p, end - p, Range->Delims, true);
+                if (skip == -1) {
+                    Range = null;
+                    return *this;
+                }
+                p += skip;
+            } else if (Range->Mode == string_split_mode::Lines && p == end) {
+                Range = null;
+                return *this;
+            }
+
+            s64 delim = internal::utf8_find_any_of(p, end - p, Range->Delims, false);
+            Begin = p;
+            End = delim == -1 ? end : p + delim;
+            Next = delim == -1 ? null : End + get_size_of_cp(End);
+
+            if (Range->Mode == string_split_mode::Lines && End > Begin && End[-1] == '\r') --End;
+            return *this;
+        }
+
+        constexpr bool operator==(const iterator &other) const { return Range == other.Range && (!Range || Begin == other.Begin); }
+        constexpr bool operator!=(const iterator &other) const { return !(*this == other); }
+    };
+
+    constexpr iterator begin() const { return iterator(this); }
+    constexpr iterator end() const { return iterator(); }
+};
+
+// Splits at each code point which is in _delims_. "a,,b" gives "a", "", "b" and "" gives one empty piece.
+constexpr string_split_range split(const string &s, const string &delims) {
+    assert(delims.Data && delims.Length);
+    return {s, delims, string_split_mode::Split};
+}
+
+// Splits at runs of white space (or of code points in _delims_) and skips the empty pieces.
+constexpr string_split_range split_whitespace(const string &s, const string &delims = " \n\r\t\v\f") {
+    assert(delims.Data && delims.Length);
+    return {s, delims, string_split_mode::Whitespace};
+}
+
+// Splits into lines, which end with \n or \r\n ("a\n" is one line and "" is no lines).
+constexpr string_split_range lines(const string &s) { return {s, "\n", string_split_mode::Lines}; }
+
+//
+// Going over the code points of a string front to back:
+//
+//     For(code_points(s)) { ... }  // _it_ is an utf32
+//
+// The string's own iterator finds every code point by index (walking from the start), this decodes STRING_CODE_POINTS_BLOCK
+// of them at a time with utf8_to_utf32_block into a buffer and hands them out from there.
+//
+constexpr s64 STRING_CODE_POINTS_BLOCK = 64;
+
+struct string_code_points {
+    const utf8 *Next = null, *End = null;
+
+    utf32 Buffer[STRING_CODE_POINTS_BLOCK];
+    s64 Count = 0, Index = 0;
+
+    void refill() {
+        Index = 0;
+        Count = utf8_to_utf32_block(&Next, End, Buffer, STRING_CODE_POINTS_BLOCK);
+    }
+
+    struct sentinel {};
+
+    struct iterator {
+        string_code_points *Parent;
+
+        utf32 operator*() const { return Parent->Buffer[Parent->Index]; }
+
+        iterator &operator++() {
+            if (++Parent->Index == Parent->Count) Parent->refill();
+            return *this;
+        }
+
+        bool operator!=(sentinel) const { return Parent->Index != Parent->Count; }
+        bool operator==(sentinel) const { return Parent->Index == Parent->Count; }
+    };
+
+    // Iterating starts from where _Next_ is, so a range is gone over once
+    iterator begin() { return refill(), iterator{this}; }
+    sentinel end() const { return {}; }
+};
+
+inline string_code_points code_points(const string &s) { return {s.Data, s.Data + s.Count}; }
+
 //
 // Operators:
 //
 
-constexpr bool operator==(const string &one, const string &other) { return compare_lexicographically(one, other) == 0; }
+// Equal strings are byte-for-byte equal, so we don't need to decode anything (and can stop early when the sizes differ)
+constexpr bool operator==(const string &one, const string &other) {
+    return one.Count == other.Count && internal::bytes_equal(one.Data, other.Data, one.Count);
+}
 constexpr bool operator!=(const string &one, const string &other) { return !(one == other); }
 constexpr bool operator<(const string &one, const string &other) { return compare_lexicographically(one, other) < 0; }
 constexpr bool operator>(const string &one, const string &other) { return compare_lexicographically(one, other) > 0; }
@@ -701,11 +988,68 @@ constexpr string string::operator[](substring_indices range) const { return subs
 // Returns just _dest_.
 string *clone(string *dest, const string &src);
 
-// Hash for strings
-inline u64 get_hash(const string &value) {
-    u64 hash = 5381;
-    For(value) hash = ((hash << 5) + hash) + it;
-    return hash;
+// Hash for strings.
+// We hash the bytes directly (not the decoded code points), equal strings are byte-for-byte equal anyway.
+// Works at compile time too (and gives the same result).
+constexpr u64 get_hash(const string &value) { return const_hash_bytes(value.Data, value.Count); }
+
+// Lets hash_table<string, V> be looked up with a literal or a view of bytes without making a string first
+// (which counts the code points, a pass over the whole key).
+template <>
+struct key_hash<string> {
+    using is_transparent = void;
+
+    constexpr u64 operator()(const array<utf8> &key) const { return const_hash_bytes(key.Data, key.Count); }
+    constexpr u64 operator()(const bytes &key) const { return const_hash_bytes(key.Data, key.Count); }
+    constexpr u64 operator()(const utf8 *key) const { return const_hash_bytes(key, c_string_length(key)); }
+};
+
+template <>
+struct key_equal<string> {
+    using is_transparent = void;
+
+    constexpr bool operator()(const string &one, const array<utf8> &other) const {
+        return one.Count == other.Count && internal::bytes_equal(one.Data, other.Data, one.Count);
+    }
+    bool operator()(const string &one, const bytes &other) const {
+        return one.Count == other.Count && internal::bytes_equal(one.Data, (const utf8 *) other.Data, one.Count);
+    }
+    constexpr bool operator()(const string &one, const utf8 *other) const {
+        return one.Count == c_string_length(other) && internal::bytes_equal(one.Data, other, one.Count);
+    }
+};
+
+// A string which remembers its hash, use this for keys of tables which are looked up a lot (e.g. symbol tables).
+// get_hash() just returns the cached value, and comparing two hashed strings looks at the hashes before the bytes.
+//
+// The hash is calculated when constructing, so if you change the string afterwards call rehash().
+// Like string, this doesn't own the buffer (free() frees the string).
+struct hashed_string {
+    string Str;
+    u64 Hash = 0;
+
+    constexpr hashed_string() {}
+    constexpr hashed_string(const string &str) : Str(str), Hash(get_hash(str)) {}
+    constexpr hashed_string(const utf8 *str) : hashed_string(string(str)) {}
+    constexpr hashed_string(const char8_t *str) : hashed_string(string(str)) {}
+};
+
+inline void rehash(hashed_string &s) { s.Hash = get_hash(s.Str); }
+
+inline void free(hashed_string &s) { free(s.Str); }
+
+constexpr u64 get_hash(const hashed_string &value) { return value.Hash; }
+
+inline bool operator==(const hashed_string &one, const hashed_string &other) {
+    if (one.Hash != other.Hash || one.Str.Count != other.Str.Count) return false;
+    return equal_memory(one.Str.Data, other.Str.Data, one.Str.Count);
+}
+inline bool operator!=(const hashed_string &one, const hashed_string &other) { return !(one == other); }
+
+inline hashed_string *clone(hashed_string *dest, const hashed_string &src) {
+    clone(&dest->Str, src.Str);
+    dest->Hash = src.Hash;
+    return dest;
 }
 
 LSTD_END_NAMESPACE
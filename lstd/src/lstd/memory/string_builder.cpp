@@ -13,10 +13,14 @@ void free(string_builder &builder) {
 
     builder.CurrentBuffer = null;  // null means BaseBuffer
     builder.BaseBuffer.Occupied = 0;
+    builder.BaseBuffer.Next = null;
+    builder.IndirectionCount = 0;
+    builder.Count = 0;
 }
 
-void reset(string_builder &builder) {
+void string_builder_reset(string_builder &builder) {
     builder.CurrentBuffer = null;  // null means BaseBuffer
+    builder.Count = 0;
 
     auto *b = &builder.BaseBuffer;
     while (b) {
@@ -33,29 +37,56 @@ void string_append(string_builder &builder, utf32 cp) {
 
 void string_append(string_builder &builder, const string &str) { string_append(builder, str.Data, str.Count); }
 
-void string_append(string_builder &builder, const utf8 *data, s64 size) {
-    auto *currentBuffer = string_builder_get_current_buffer(builder);
+// Allocates a buffer with room for _capacity_ bytes
+file_scope string_builder::buffer *string_builder_new_buffer(string_builder &builder, s64 capacity) {
+    if (!builder.Alloc) builder.Alloc = Context.Alloc;
 
-    s64 availableSpace = builder.BUFFER_SIZE - currentBuffer->Occupied;
-    if (availableSpace >= size) {
-        copy_memory(currentBuffer->Data + currentBuffer->Occupied, data, size);
-        currentBuffer->Occupied += size;
-    } else {
-        copy_memory(currentBuffer->Data + currentBuffer->Occupied, data, availableSpace);
-        currentBuffer->Occupied += availableSpace;
+    auto *b = (string_builder::buffer *) allocate_array<byte>(offset_of(string_builder::buffer, Data) + capacity, {.Alloc = builder.Alloc});
+    b->Occupied = 0;
+    b->Capacity = capacity;
+    b->Next = null;
 
-        // If the entire string doesn't fit inside the available space,
-        // allocate the next buffer and continue appending.
-        if (!builder.Alloc) builder.Alloc = Context.Alloc;
-        auto *b = allocate<string_builder::buffer>({.Alloc = builder.Alloc});
+    builder.IndirectionCount++;
+    return b;
+}
 
-        currentBuffer->Next = b;
-        builder.CurrentBuffer = b;
+void string_append(string_builder &builder, const utf8 *data, s64 size) {
+    builder.Count += size;
+
+    auto *currentBuffer = string_builder_get_current_buffer(builder);
+    while (true) {
+        s64 n = min(currentBuffer->Capacity - currentBuffer->Occupied, size);
+        copy_memory(currentBuffer->Data + currentBuffer->Occupied, data, n);
+        currentBuffer->Occupied += n;
+
+        data += n;
+        size -= n;
+        if (!size) break;
+
+        // The rest doesn't fit, continue in the next buffer.
+        // After a reset the old buffers are still linked, reuse them before allocating new ones.
+        auto *b = currentBuffer->Next;
+        if (!b) {
+            s64 capacity = min(currentBuffer->Capacity * 2, string_builder::MAX_BUFFER_SIZE);
+            b = string_builder_new_buffer(builder, max(capacity, size));
+            currentBuffer->Next = b;
+        }
 
-        builder.IndirectionCount++;
+        builder.CurrentBuffer = b;
+        currentBuffer = b;
+    }
+}
 
-        string_append(builder, data + availableSpace, size - availableSpace);
+void string_builder_reserve(string_builder &builder, s64 size) {
+    // Room in the current buffer and in the empty ones after it (left over from before a reset)
+    auto *b = string_builder_get_current_buffer(builder);
+    s64 available = b->Capacity - b->Occupied;
+    while (b->Next) {
+        b = b->Next;
+        available += b->Capacity;
     }
+
+    if (available < size) b->Next = string_builder_new_buffer(builder, size - available);
 }
 
 string_builder::buffer *string_builder_get_current_buffer(string_builder &builder) {
@@ -65,12 +96,19 @@ string_builder::buffer *string_builder_get_current_buffer(string_builder &builde
 
 string string_builder_combine(const string_builder &builder) {
     string result;
-    string_reserve(result, (builder.IndirectionCount + 1) * builder.BUFFER_SIZE);
+    if (!builder.Count) return result;
+
+    array_reserve_exact(result, builder.Count);
+
+    // Copy the bytes directly and count the code points once at the end, appending
+    // buffer by buffer would count them for each buffer.
     auto *b = &builder.BaseBuffer;
     while (b) {
-        string_append(result, b->Data, b->Occupied);
+        copy_memory(result.Data + result.Count, b->Data, b->Occupied);
+        result.Count += b->Occupied;
         b = b->Next;
     }
+    result.Length = utf8_length(result.Data, result.Count);
     return result;
 }
 
@@ -5,19 +5,30 @@
 
 LSTD_BEGIN_NAMESPACE
 
-// This is good for building large strings because it doesn't have to constantly reallocate
+// This is good for building large strings because it doesn't have to constantly reallocate.
+//
+// The first buffer is part of the object. Each buffer we allocate after it is twice as big as the previous one
+// (up to MAX_BUFFER_SIZE), so large outputs take a handful of allocations. An append which doesn't fit in that
+// gets a buffer of its own size. If you know roughly how much is coming, call string_builder_reserve() first.
 struct string_builder {
-    static constexpr s64 BUFFER_SIZE = 1_KiB;
+    static constexpr s64 BUFFER_SIZE = 1_KiB;  // Size of _BaseBuffer_
+    static constexpr s64 MAX_BUFFER_SIZE = 4_MiB;
 
     struct buffer {
-        utf8 Data[BUFFER_SIZE]{};
         s64 Occupied = 0;
+        s64 Capacity = BUFFER_SIZE;
         buffer *Next = null;
+
+        // Must be the last member. Allocated buffers have _Capacity_ bytes here.
+        utf8 Data[BUFFER_SIZE]{};
     };
 
     // Counts how many buffers have been dynamically allocated.
     s64 IndirectionCount = 0;
 
+    // Total number of bytes appended (in all buffers), so string_builder_combine() allocates exactly once.
+    s64 Count = 0;
+
     buffer BaseBuffer;
     buffer *CurrentBuffer = null;  // null means BaseBuffer. We don't point directly to BaseBuffer because if we copy this object by value then the copy has the base buffer of the original buffer.
 
@@ -45,9 +56,14 @@ void string_append(string_builder &builder, const string &str);
 // Append _size_ bytes from _data_ to the builder
 void string_append(string_builder &builder, const utf8 *data, s64 size);
 
+// Makes sure the next _size_ bytes can be appended without allocating, with at most one allocation now.
+void string_builder_reserve(string_builder &builder, s64 size);
+
 string_builder::buffer *string_builder_get_current_buffer(string_builder &builder);
 
 // Merges all buffers in one string. The caller is responsible for freeing.
+// Allocates exactly _builder.Count_ bytes, once. If you just want to send the contents somewhere,
+// use write(writer *, const string_builder &) instead, which doesn't make a contiguous copy at all.
 [[nodiscard("Leak")]] string string_builder_combine(const string_builder &builder);
 
 // @API Remove this, iterators? Literally anything else..
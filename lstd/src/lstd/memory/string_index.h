@@ -0,0 +1,101 @@
+#pragma once
+
+#include "string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Breadcrumbs for random access by code point in long non-ASCII strings.
+//
+// Indexing a string by code point (s[i], substring()) walks from the start, so loops like
+//
+//     For(range(s.Length)) { ... s[it] ... }
+//
+// are O(n^2). With an index each access is O(STRING_INDEX_STRIDE):
+//
+//     string_index index;
+//     defer(free(index));
+//     For(range(s.Length)) { ... string_index_get(index, s, it) ... }
+//
+// We remember the byte offset of every STRING_INDEX_STRIDE-th code point, a lookup jumps to the nearest one
+// before the index and walks the rest. ASCII strings (Length == Count) don't need that - their lookups are
+// always O(1) and we don't build anything.
+//
+// The index is built on the first lookup. It remembers the Data, Count and Length of the string it was built
+// for and rebuilds itself when they change, so appending, inserting and removing invalidate it automatically.
+// If you edit the string in a way which keeps these three the same but moves code points (e.g. remove a
+// code point and insert one of the same size somewhere else), call reset() on the index.
+//
+constexpr s64 STRING_INDEX_STRIDE = 64;
+
+struct string_index {
+    array<s64> Offsets;  // Byte offset of code point (i * STRING_INDEX_STRIDE)
+
+    // What the index was built for
+    const utf8 *Data = null;
+    s64 Count = -1;
+    s64 Length = -1;
+
+    string_index() {}
+};
+
+inline void free(string_index &index) {
+    free(index.Offsets);
+    index.Data = null;
+    index.Count = index.Length = -1;
+}
+
+// Forces a rebuild on the next lookup, keeps the memory.
+inline void reset(string_index &index) {
+    array_reset(index.Offsets);
+    index.Data = null;
+    index.Count = index.Length = -1;
+}
+
+namespace internal {
+inline void string_index_build(string_index &index, const string &s) {
+    array_reset(index.Offsets);
+    array_reserve_exact(index.Offsets, s.Length / STRING_INDEX_STRIDE + 1);
+
+    const utf8 *p = s.Data;
+    For(range(s.Length)) {
+        if (it % STRING_INDEX_STRIDE == 0) array_append(index.Offsets, (s64) (p - s.Data));
+        p += get_size_of_cp(p);
+    }
+
+    index.Data = s.Data;
+    index.Count = s.Count;
+    index.Length = s.Length;
+}
+}  // namespace internal
+
+// Returns the byte offset of the code point at _cpIndex_ (negative indices count from the end, like everywhere else).
+// _cpIndex_ may also be s.Length (the end of the string).
+inline s64 string_index_get_offset(string_index &index, const string &s, s64 cpIndex) {
+    s64 i = translate_index(cpIndex, s.Length, true);
+    if (s.Length == s.Count) return i;
+    if (i == s.Length) return s.Count;
+
+    if (index.Data != s.Data || index.Count != s.Count || index.Length != s.Length) internal::string_index_build(index, s);
+
+    const utf8 *p = s.Data + index.Offsets.Data[i / STRING_INDEX_STRIDE];
+    For(range(i % STRING_INDEX_STRIDE)) p += get_size_of_cp(p);
+    return p - s.Data;
+}
+
+// Same as s[cpIndex], but O(STRING_INDEX_STRIDE).
+inline utf32 string_index_get(string_index &index, const string &s, s64 cpIndex) {
+    assert(translate_index(cpIndex, s.Length) < s.Length);
+    return decode_cp(s.Data + string_index_get_offset(index, s, cpIndex));
+}
+
+// Same as substring(s, begin, end), but O(STRING_INDEX_STRIDE).
+inline string string_index_substring(string_index &index, const string &s, s64 begin, s64 end) {
+    if (begin == end) return "";
+
+    s64 b = string_index_get_offset(index, s, translate_index(begin, s.Length));
+    s64 e = string_index_get_offset(index, s, translate_index(end, s.Length, true));
+    return string(s.Data + b, e - b);
+}
+
+LSTD_END_NAMESPACE
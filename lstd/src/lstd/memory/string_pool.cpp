@@ -0,0 +1,110 @@
+#include "string_pool.h"
+
+#include "../internal/context.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope string_pool GlobalStringPool;
+
+string_pool *get_global_string_pool() { return &GlobalStringPool; }
+
+// Copies _str_ (and a zero terminator) into the pool's memory. Called with the lock held exclusively.
+file_scope utf8 *string_pool_store(string_pool &pool, const string &str) {
+    s64 size = str.Count + 1;
+
+    utf8 *result;
+    if (size > STRING_POOL_CHUNK_SIZE / 4) {
+        result = allocate_array<utf8>(size, {.Alloc = pool.Alloc});
+        array_append(pool.Chunks, result);
+    } else {
+        if (size > pool.CurrentLeft) {
+            pool.Current = allocate_array<utf8>(STRING_POOL_CHUNK_SIZE, {.Alloc = pool.Alloc});
+            pool.CurrentLeft = STRING_POOL_CHUNK_SIZE;
+            array_append(pool.Chunks, pool.Current);
+        }
+        result = pool.Current;
+        pool.Current += size;
+        pool.CurrentLeft -= size;
+    }
+
+    copy_memory(result, str.Data, str.Count);
+    result[str.Count] = '\0';
+    return result;
+}
+
+interned_string find_interned(string_pool &pool, const string &str) {
+    if (!str.Count) return {};
+
+    u64 hash = get_hash(str);
+
+    thread::shared_lock _(&pool.Mutex);
+
+    auto [kp, vp] = find_prehashed(pool.IDs, hash, str);
+    if (!vp) return {};
+    return {*vp, (u32) (hash >> 32)};
+}
+
+interned_string intern(string_pool &pool, const string &str) {
+    if (!str.Count) return {};
+
+    u64 hash = get_hash(str);
+
+    // Most of the time the string is already there
+    {
+        thread::shared_lock _(&pool.Mutex);
+
+        auto [kp, vp] = find_prehashed(pool.IDs, hash, str);
+        if (vp) return {*vp, (u32) (hash >> 32)};
+    }
+
+    thread::scoped_lock<thread::fast_shared_mutex> _(&pool.Mutex);
+
+    // Another thread may have added it while we weren't holding the lock
+    auto [kp, vp] = find_prehashed(pool.IDs, hash, str);
+    if (vp) return {*vp, (u32) (hash >> 32)};
+
+    if (!pool.Alloc) pool.Alloc = internal::platform_get_persistent_allocator();
+
+    string stored;
+    stored.Data = string_pool_store(pool, str);
+    stored.Count = str.Count;
+    stored.Length = str.Length;
+
+    u32 id;
+    PUSH_ALLOC(pool.Alloc) {
+        if (!pool.Strings.Count) array_append(pool.Strings, string());  // ID 0 is the empty string
+
+        id = (u32) pool.Strings.Count;
+        array_append(pool.Strings, stored);
+        add_prehashed(pool.IDs, hash, stored, id);
+    }
+    return {id, (u32) (hash >> 32)};
+}
+
+string get_string(string_pool &pool, interned_string s) {
+    if (!s.ID) return "";
+
+    thread::shared_lock _(&pool.Mutex);
+
+    assert(s.ID < pool.Strings.Count && "Handle is not from this pool");
+    return pool.Strings.Data[s.ID];
+}
+
+s64 count(string_pool &pool) {
+    thread::shared_lock _(&pool.Mutex);
+    return pool.IDs.Count;
+}
+
+void free(string_pool &pool) {
+    For(pool.Chunks) free(it);
+    free(pool.Chunks);
+    free(pool.IDs);
+    free(pool.Strings);
+
+    pool.Current = null;
+    pool.CurrentLeft = 0;
+}
+
+LSTD_END_NAMESPACE
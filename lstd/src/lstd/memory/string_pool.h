@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../thread.h"
+#include "hash_table.h"
+#include "string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Deduplicates strings - interning the same contents twice gives the same handle.
+// Use it for identifiers which get compared and hashed over and over (symbol names, keys of config entries, etc.),
+// comparing two handles is comparing two integers and hashing one doesn't look at the bytes.
+//
+//     auto a = intern("position");
+//     auto b = intern(parsedName);
+//     if (a == b) { ... }
+//
+//     string s = get_string(a);  // A view into the pool
+//
+// Handles from different pools aren't comparable. intern() and get_string() without a pool use a global one.
+//
+// The pool is thread safe. Lookups of strings which are already interned only take the lock shared.
+//
+// The bytes of interned strings are copied into big chunks (and zero terminated, so you can pass them to C APIs),
+// nothing is freed until the pool itself is freed. So views returned by get_string() stay valid for the lifetime
+// of the pool. Chunks and the tables are allocated with _Alloc_, if it's not set we use the persistent allocator.
+//
+
+// A handle to a string in a string_pool. The default value is the empty string.
+struct interned_string {
+    u32 ID = 0;
+    u32 Hash = 0;  // The high 32 bits of get_hash() of the contents, for when you need a hash that matches across pools
+};
+
+inline bool operator==(interned_string a, interned_string b) { return a.ID == b.ID; }
+inline bool operator!=(interned_string a, interned_string b) { return a.ID != b.ID; }
+
+// Hashes the ID, not the contents.
+constexpr u64 get_hash(interned_string value) { return hash_u64(value.ID); }
+
+// Strings bigger than a quarter of this get their own allocation.
+constexpr s64 STRING_POOL_CHUNK_SIZE = 64_KiB;
+
+struct string_pool {
+    thread::fast_shared_mutex Mutex;
+
+    hash_table<string, u32> IDs;  // Contents to ID, the keys point into the chunks
+    array<string> Strings;        // ID to contents, _Strings[0]_ is the empty string
+
+    array<utf8 *> Chunks;  // All blocks we've allocated, including the ones for big strings
+    utf8 *Current = null;  // Where the next string goes in the last chunk
+    s64 CurrentLeft = 0;
+
+    allocator Alloc;
+
+    string_pool() {}
+};
+
+// Returns the handle for _str_, copies it into the pool if it's not there yet.
+interned_string intern(string_pool &pool, const string &str);
+
+// Returns the handle for _str_ if it's been interned already, otherwise the handle of the empty string.
+// Doesn't add anything, use this to look up input which shouldn't grow the pool.
+interned_string find_interned(string_pool &pool, const string &str);
+
+// Returns a view of the contents of _s_, valid until the pool is freed.
+string get_string(string_pool &pool, interned_string s);
+
+// Number of unique strings in the pool (not counting the empty string).
+s64 count(string_pool &pool);
+
+// Frees all strings, every handle and view from this pool becomes invalid. Not thread safe.
+void free(string_pool &pool);
+
+// The pool used by the overloads below.
+string_pool *get_global_string_pool();
+
+inline interned_string intern(const string &str) { return intern(*get_global_string_pool(), str); }
+inline interned_string find_interned(const string &str) { return find_interned(*get_global_string_pool(), str); }
+inline string get_string(interned_string s) { return get_string(*get_global_string_pool(), s); }
+
+LSTD_END_NAMESPACE
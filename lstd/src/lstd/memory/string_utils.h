@@ -18,6 +18,7 @@
 // * encode_cp
 // * decode_cp
 // * is_valid_utf8
+// * utf8_find_invalid - validates a whole buffer
 //
 // These work only for ascii:
 // * is_digit
@@ -32,6 +33,7 @@
 // Conversions:
 // * utf8_to_utf16
 // * utf8_to_utf32
+// * utf8_to_utf32_block - decodes bytes in chunks, see code_points() in string.h
 // * utf16_to_utf8
 // * utf32_to_utf8
 //
@@ -59,9 +61,16 @@ constexpr s64 c_string_length(T str) {
     return length;
 }
 
-// Retrieve the length (in code points) for a utf8 string
+namespace internal {
+// Defined in string.cpp. Counts 16 or 32 bytes at a time with SSE2 or AVX2 (picked at runtime).
+s64 utf8_length_simd(const utf8 *str, s64 size);
+}  // namespace internal
+
+// Retrieve the length (in code points) for a utf8 string.
+// This runs in every string constructor, so at runtime long strings go through a SIMD version.
 constexpr s64 utf8_length(const utf8 *str, s64 size) {
     if (!str || size == 0) return 0;
+    if (!is_constant_evaluated() && size >= 16) return internal::utf8_length_simd(str, size);
 
     s64 length = 0;
     while (size--) {
@@ -70,6 +79,66 @@ constexpr s64 utf8_length(const utf8 *str, s64 size) {
     return length;
 }
 
+namespace internal {
+// Defined in string.cpp. Uses SSSE3 or AVX2 (picked at runtime).
+s64 utf8_find_invalid_simd(const utf8 *str, s64 size);
+
+constexpr s64 utf8_find_invalid_scalar(const utf8 *str, s64 size) {
+    s64 i = 0;
+    while (i < size) {
+        u8 b = (u8) str[i];
+        if (b < 0x80) {
+            ++i;
+            continue;
+        }
+
+        // Number of continuation bytes and the range allowed for the first one (which excludes overlong
+        // encodings, surrogates and code points above 0x10FFFF)
+        s64 n = 0;
+        u8 lo = 0x80, hi = 0xBF;
+        if (b >= 0xC2 && b <= 0xDF) {
+            n = 1;
+        } else if (b == 0xE0) {
+            n = 2, lo = 0xA0;
+        } else if ((b >= 0xE1 && b <= 0xEC) || b == 0xEE || b == 0xEF) {
+            n = 2;
+        } else if (b == 0xED) {
+            n = 2, hi = 0x9F;
+        } else if (b == 0xF0) {
+            n = 3, lo = 0x90;
+        } else if (b >= 0xF1 && b <= 0xF3) {
+            n = 3;
+        } else if (b == 0xF4) {
+            n = 3, hi = 0x8F;
+        } else {
+            return i;
+        }
+
+        if (size - i - 1 < n) return i;
+
+        u8 c = (u8) str[i + 1];
+        if (c < lo || c > hi) return i;
+        For(range(2, n + 1)) {
+            if (((u8) str[i + it] & 0xc0) != 0x80) return i;
+        }
+        i += n + 1;
+    }
+    return -1;
+}
+}  // namespace internal
+
+// Returns the byte offset of the first invalid (or truncated) utf8 sequence, or -1 if the whole buffer is valid.
+// Rejects overlong encodings, surrogates (U+D800 to U+DFFF) and code points above U+10FFFF.
+// At runtime long buffers are checked 16 or 32 bytes at a time, ASCII text goes at about the speed of a memory read.
+constexpr s64 utf8_find_invalid(const utf8 *str, s64 size) {
+    if (!str || size <= 0) return -1;
+    if (!is_constant_evaluated() && size >= 16) return internal::utf8_find_invalid_simd(str, size);
+    return internal::utf8_find_invalid_scalar(str, size);
+}
+
+// Checks whether a whole buffer is valid utf8, see utf8_find_invalid().
+constexpr bool is_valid_utf8(const utf8 *str, s64 size) { return utf8_find_invalid(str, size) == -1; }
+
 template <c_string T>
 constexpr s64 compare_c_string(T one, T other) {
     assert(one);
@@ -122,6 +191,8 @@ constexpr bool is_print(utf32 x) { return x > 31 && x != 127; }
 
 // Convert code point to uppercase
 constexpr utf32 to_upper(utf32 cp) {
+    if (cp < 0x80) return (cp >= 'a' && cp <= 'z') ? cp - 32 : cp;  // Most text is ASCII, skip the tables
+
     if (((0x0061 <= cp) && (0x007a >= cp)) || ((0x00e0 <= cp) && (0x00f6 >= cp)) ||
         ((0x00f8 <= cp) && (0x00fe >= cp)) || ((0x03b1 <= cp) && (0x03c1 >= cp)) ||
         ((0x03c3 <= cp) && (0x03cb >= cp))) {
@@ -187,6 +258,8 @@ constexpr utf32 to_upper(utf32 cp) {
 
 // Convert code point to lowercase
 constexpr utf32 to_lower(utf32 cp) {
+    if (cp < 0x80) return (cp >= 'A' && cp <= 'Z') ? cp + 32 : cp;
+
     if (((0x0041 <= cp) && (0x005a >= cp)) || ((0x00c0 <= cp) && (0x00d6 >= cp)) ||
         ((0x00d8 <= cp) && (0x00de >= cp)) || ((0x0391 <= cp) && (0x03a1 >= cp)) ||
         ((0x03a3 <= cp) && (0x03ab >= cp))) {
@@ -414,17 +487,50 @@ constexpr const utf8 *get_cp_at_index(const utf8 *str, s64 index) {
     return str;
 }
 
+namespace internal {
+// Writes one code point as utf16 (1 or 2 code units), returns how many code units were written.
+constexpr s64 encode_utf16_cp(utf16 *out, utf32 cp) {
+    if (cp > 0xffff) {
+        out[0] = (utf16)((cp >> 10) + (0xD800u - (0x10000 >> 10)));
+        out[1] = (utf16)((cp & 0x3FF) + 0xDC00u);
+        return 2;
+    }
+    out[0] = (utf16) cp;
+    return 1;
+}
+
+// Reads one code point from utf16 (_count_ is how many code units are left), returns how many code units were read.
+constexpr s64 decode_utf16_cp(const utf16 *str, s64 count, utf32 *outCp) {
+    utf32 lead = (utf32) str[0];
+    if (lead >= 0xD800 && lead <= 0xDBFF) {
+        if (count >= 2 && (utf32) str[1] >= 0xDC00 && (utf32) str[1] <= 0xDFFF) {
+            *outCp = ((lead - 0xD800) << 10) + ((utf32) str[1] - 0xDC00) + 0x0010000;
+            return 2;
+        }
+        assert(false && "Invalid utf16 string");
+    }
+    *outCp = lead;
+    return 1;
+}
+
+// Defined in string.cpp. Convert runs of ASCII 16 code units at a time with SSE2, everything else one code point at a time.
+void utf8_to_utf16_simd(const utf8 *str, s64 length, utf16 *out);
+s64 utf16_to_utf8_simd(const utf16 *str, s64 count, utf8 *out);
+void utf8_to_utf32_simd(const utf8 *str, s64 length, utf32 *out);
+s64 utf32_to_utf8_simd(const utf32 *str, s64 count, utf8 *out);
+}  // namespace internal
+
 // Converts utf8 to utf16 and stores in _out_ (assumes there is enough space).
 // Also adds a null-terminator at the end.
+//
+// The result is never longer than the utf8 byte count (+ 1 for the null-terminator),
+// each utf8 byte makes at most one utf16 code unit.
 constexpr void utf8_to_utf16(const utf8 *str, s64 length, utf16 *out) {
+    if (!is_constant_evaluated() && length >= 16) return internal::utf8_to_utf16_simd(str, length, out);
+
     For(range(length)) {
         utf32 cp = decode_cp(str);
-        if (cp > 0xffff) {
-            *out++ = (u16)((cp >> 10) + (0xD800u - (0x10000 >> 10)));
-            *out++ = (u16)((cp & 0x3FF) + 0xDC00u);
-        } else {
-            *out++ = (u16) cp;
-        }
+        out += internal::encode_utf16_cp(out, cp);
         str += get_size_of_cp(cp);
     }
     *out = 0;
@@ -433,6 +539,8 @@ constexpr void utf8_to_utf16(const utf8 *str, s64 length, utf16 *out) {
 // Converts utf8 to utf32 and stores in _out_ (assumes there is enough space).
 // Also adds a null-terminator at the end.
 constexpr void utf8_to_utf32(const utf8 *str, s64 length, utf32 *out) {
+    if (!is_constant_evaluated() && length >= 16) return internal::utf8_to_utf32_simd(str, length, out);
+
     For(range(length)) {
         utf32 cp = decode_cp(str);
         *out++ = cp;
@@ -441,42 +549,63 @@ constexpr void utf8_to_utf32(const utf8 *str, s64 length, utf32 *out) {
     *out = 0;
 }
 
-// Converts a null-terminated utf16 to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space).
-constexpr void utf16_to_utf8(const utf16 *str, utf8 *out, s64 *outByteLength) {
+// Decodes utf8 from [*str, end) into _out_ until _capacity_ code points are written or the bytes run out.
+// Advances _*str_ past what was decoded and returns how many code points were written. Unlike the conversions above
+// this goes by bytes, not by a code point count, and never reads past _end_: a sequence which is cut off by _end_
+// or a stray continuation byte decodes as U+FFFD (one per byte).
+//
+// Defined in string.cpp (ASCII is widened 16 bytes at a time like above).
+s64 utf8_to_utf32_block(const utf8 **str, const utf8 *end, utf32 *out, s64 capacity);
+
+// Converts _count_ utf16 code units to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space,
+// at most 3 bytes per code unit). Doesn't add a null-terminator.
+constexpr void utf16_to_utf8(const utf16 *str, s64 count, utf8 *out, s64 *outByteLength) {
+    if (!is_constant_evaluated() && count >= 16) {
+        *outByteLength = internal::utf16_to_utf8_simd(str, count, out);
+        return;
+    }
+
     s64 byteLength = 0;
-    while (*str) {
-        utf32 cp = *str;
-        if ((cp >= 0xD800) && (cp <= 0xDBFF)) {
-            utf32 trail = cp = *++str;
-            if (!*str) assert(false && "Invalid utf16 string");
-
-            if ((trail >= 0xDC00) && (trail <= 0xDFFF)) {
-                cp = ((cp - 0xD800) << 10) + (trail - 0xDC00) + 0x0010000;
-            } else {
-                assert(false && "Invalid utf16 string");
-            }
-        }
+    while (count > 0) {
+        utf32 cp;
+        s64 units = internal::decode_utf16_cp(str, count, &cp);
+        str += units;
+        count -= units;
 
         encode_cp(out, cp);
         s64 cpSize = get_size_of_cp(out);
         out += cpSize;
         byteLength += cpSize;
-        ++str;
     }
     *outByteLength = byteLength;
 }
 
-// Converts a null-terminated utf32 to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space).
-constexpr void utf32_to_utf8(const utf32 *str, utf8 *out, s64 *outByteLength) {
+// Converts a null-terminated utf16 to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space).
+constexpr void utf16_to_utf8(const utf16 *str, utf8 *out, s64 *outByteLength) {
+    utf16_to_utf8(str, c_string_length(str), out, outByteLength);
+}
+
+// Converts _count_ utf32 code points to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space,
+// at most 4 bytes per code point). Doesn't add a null-terminator.
+constexpr void utf32_to_utf8(const utf32 *str, s64 count, utf8 *out, s64 *outByteLength) {
+    if (!is_constant_evaluated() && count >= 16) {
+        *outByteLength = internal::utf32_to_utf8_simd(str, count, out);
+        return;
+    }
+
     s64 byteLength = 0;
-    while (*str) {
-        encode_cp(out, *str);
+    For(range(count)) {
+        encode_cp(out, str[it]);
         s64 cpSize = get_size_of_cp(out);
         out += cpSize;
         byteLength += cpSize;
-        ++str;
     }
     *outByteLength = byteLength;
 }
 
+// Converts a null-terminated utf32 to utf8 and stores in _out_ and _outByteLength_ (assumes there is enough space).
+constexpr void utf32_to_utf8(const utf32 *str, utf8 *out, s64 *outByteLength) {
+    utf32_to_utf8(str, c_string_length(str), out, outByteLength);
+}
+
 LSTD_END_NAMESPACE
@@ -0,0 +1,425 @@
+#pragma once
+
+#include "hash_table.h"
+
+#if ARCH == X86
+#include <emmintrin.h>
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// This hash table has the same API as hash_table (find, add, set, remove, reserve, free, etc. with their _prehashed variants)
+// but a different layout which allows a much higher load factor (7/8 instead of 1/2) and fewer cache misses per lookup.
+//
+// Next to the full 64 bit hash of each slot (kept for rehashing, so prehashed keys with custom hashes survive a resize)
+// we store a 1 byte control value, which is all that probing looks at:
+//   - EMPTY (0x80) - never used since the last rehash
+//   - DELETED (0xFE) - a tombstone, the slot can be reused
+//   - 0..127 - the slot is used, the value is 7 bits of the hash of the key (h2)
+//
+// The slots are split into groups of 16. The other bits of the hash (h1) pick the group where we start probing.
+// We compare the control bytes of a whole group with h2 at once (SSE2 or NEON), so we look at the keys only of slots
+// which are very likely to match. If a group has an EMPTY slot the probe stops there (the key would've been put there).
+// Groups are probed in a triangular sequence which visits every group (the number of groups is a power of 2).
+//
+// This is the layout of Google's "Swiss table" (abseil's flat_hash_map), except that our groups are aligned,
+// so we don't need to mirror the first control bytes at the end of the array.
+//
+// Note: We mix the hash before using it, so weak hashes (like the identity for integers) still spread.
+template <typename K_, typename V_>
+struct swiss_table {
+    using K = K_;
+    using V = V_;
+
+    static constexpr s64 GROUP_WIDTH = 16;
+    static constexpr s64 MINIMUM_SIZE = 16;
+
+    static constexpr s8 EMPTY = (s8) 0x80;
+    static constexpr s8 DELETED = (s8) 0xFE;
+
+    // Number of valid items
+    s64 Count = 0;
+
+    // Number of slots allocated (a power of 2, at least GROUP_WIDTH)
+    s64 Allocated = 0;
+
+    // Number of slots which aren't EMPTY (valid + deleted items)
+    s64 SlotsFilled = 0;
+
+    s8 *Control = null;  // Aligned to 16 bytes
+    u64 *Hashes = null;  // Mixed hashes (see swiss_table_mix_hash()), only read when rehashing
+    K *Keys = null;
+    V *Values = null;
+
+    swiss_table() {}
+
+    //
+    // Iterator:
+    //
+    template <bool Const>
+    struct iterator_ {
+        using swiss_table_t = types::select_t<Const, const swiss_table<K, V>, swiss_table<K, V>>;
+
+        swiss_table_t *Parent;
+        s64 Index;
+
+        iterator_(swiss_table_t *parent, s64 index = 0) : Parent(parent), Index(index) {
+            assert(parent);
+
+            // Find the first pair
+            skip_empty_slots();
+        }
+
+        iterator_ &operator++() {
+            ++Index;
+            skip_empty_slots();
+            return *this;
+        }
+
+        iterator_ operator++(s32) {
+            iterator_ pre = *this;
+            ++(*this);
+            return pre;
+        }
+
+        bool operator==(const iterator_ &other) const { return Parent == other.Parent && Index == other.Index; }
+        bool operator!=(const iterator_ &other) const { return !(*this == other); }
+
+        key_value_pair<swiss_table_t> operator*() {
+            return {Parent->Keys + Index, Parent->Values + Index};
+        }
+
+       private:
+        void skip_empty_slots() {
+            for (; Index < Parent->Allocated; ++Index) {
+                if (Parent->Control[Index] < 0) continue;
+                break;
+            }
+        }
+    };
+
+    using iterator = iterator_<false>;
+    using const_iterator = iterator_<true>;
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(this, Allocated); }
+    const_iterator begin() const { return const_iterator(this); }
+    const_iterator end() const { return const_iterator(this, Allocated); }
+
+    //
+    // Operators:
+    //
+
+    // Returns a pointer to the value associated with _key_.
+    // If the key doesn't exist, this adds a new element and returns it.
+    V *operator[](const K &key) {
+        auto [kp, vp] = find(*this, key);
+        if (vp) return vp;
+        return add(*this, key, V()).Value;
+    }
+};
+
+template <typename T>
+struct is_swiss_table : types::false_t {};
+
+template <typename K, typename V>
+struct is_swiss_table<swiss_table<K, V>> : types::true_t {};
+
+template <typename T>
+concept any_swiss_table = is_swiss_table<T>::value;
+
+//
+// Helpers for probing. You shouldn't need to call these yourself.
+//
+
+// Spreads the bits of the hash, h1 and h2 are taken from different ends of the result.
+always_inline u64 swiss_table_mix_hash(u64 hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+always_inline s8 swiss_table_h2(u64 hash) { return (s8) (hash & 0x7F); }
+always_inline u64 swiss_table_h1(u64 hash) { return hash >> 7; }
+
+#if ARCH == ARM && ANY_ARM_NEON
+// NEON has no movemask. Keep one distinct bit per lane of each half and add the halves up.
+always_inline u32 swiss_table_neon_movemask(uint8x16_t m) {
+    const u8 bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(m, vld1q_u8(bitValues));
+    return (u32) vaddv_u8(vget_low_u8(bits)) | ((u32) vaddv_u8(vget_high_u8(bits)) << 8);
+}
+#endif
+
+// Returns a bit mask of the slots in the group whose control byte equals _value_
+always_inline u32 swiss_table_match(const s8 *group, s8 value) {
+#if ARCH == X86
+    __m128i ctrl = _mm_load_si128((const __m128i *) group);
+    return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#elif ARCH == ARM && ANY_ARM_NEON
+    return swiss_table_neon_movemask(vceqq_s8(vld1q_s8(group), vdupq_n_s8(value)));
+#else
+    u32 mask = 0;
+    For(range(16)) mask |= (u32) (group[it] == value) << it;
+    return mask;
+#endif
+}
+
+// Returns a bit mask of the slots in the group which are EMPTY or DELETED (their high bit is set)
+always_inline u32 swiss_table_match_empty_or_deleted(const s8 *group) {
+#if ARCH == X86
+    __m128i ctrl = _mm_load_si128((const __m128i *) group);
+    return (u32) _mm_movemask_epi8(ctrl);
+#elif ARCH == ARM && ANY_ARM_NEON
+    return swiss_table_neon_movemask(vcltzq_s8(vld1q_s8(group)));
+#else
+    u32 mask = 0;
+    For(range(16)) mask |= (u32) (group[it] < 0) << it;
+    return mask;
+#endif
+}
+
+// Returns the index of the slot where a new key with this (mixed) hash should go.
+// Assumes the table has at least one EMPTY or DELETED slot.
+template <any_swiss_table T>
+s64 swiss_table_find_insert_slot(const T &table, u64 mixed) {
+    s64 groupMask = table.Allocated / table.GROUP_WIDTH - 1;
+    s64 group = (s64) swiss_table_h1(mixed) & groupMask;
+
+    for (s64 step = 1;; ++step) {
+        u32 available = swiss_table_match_empty_or_deleted(table.Control + group * table.GROUP_WIDTH);
+        if (available) return group * table.GROUP_WIDTH + lsb(available);
+
+        group = (group + step) & groupMask;
+    }
+}
+
+// Makes sure the table has reserved enough space for at least n more elements (while staying under a 7/8 load).
+// Reserves space equal to the next power of two, starting at _MINIMUM_SIZE_. Tombstones are dropped when rehashing.
+//
+// Allocates with the Context's allocator, the hashes, keys and values arrays are allocated in the same block as the control bytes.
+// You can call this before using the table to set a custom alignment for the keys and values.
+template <any_swiss_table T>
+void reserve(T &table, s64 target, u32 alignment = 0) {
+    using K = hash_table_key_t<T>;
+    using V = hash_table_value_t<T>;
+
+    if ((table.SlotsFilled + target) * 8 < table.Allocated * 7) return;
+
+    s64 newAllocated = max<s64>(ceil_pow_of_2((table.Count + target) * 8 / 7 + 1), table.MINIMUM_SIZE);
+
+    if (alignment == 0) {
+        alignment = table.Allocated ? allocation_get_alignment(table.Control) : 16;
+    }
+    if (alignment < 16) alignment = 16;  // The control bytes are loaded with aligned 16 byte loads
+
+    // Each array starts on an _alignment_ boundary
+    auto round_up = [&](s64 n) { return (n + alignment - 1) & ~((s64) alignment - 1); };
+
+    s64 hashesOffset = round_up(newAllocated);
+    s64 keysOffset = hashesOffset + round_up(newAllocated * sizeof(u64));
+    s64 valuesOffset = keysOffset + round_up(newAllocated * sizeof(K));
+    s64 sizeInBytes = valuesOffset + newAllocated * sizeof(V);
+
+    auto *oldControl = table.Control;
+    auto *oldHashes = table.Hashes;
+    auto *oldKeys = table.Keys;
+    auto *oldValues = table.Values;
+    auto oldAllocated = table.Allocated;
+
+    byte *block = allocate_array<byte>(sizeInBytes, {.Alignment = alignment});
+    table.Control = (s8 *) block;
+    table.Hashes = (u64 *) (block + hashesOffset);
+    table.Keys = (K *) (block + keysOffset);
+    table.Values = (V *) (block + valuesOffset);
+    fill_memory(table.Control, (byte) table.EMPTY, newAllocated);
+
+    table.Allocated = newAllocated;
+    table.SlotsFilled = table.Count;
+
+    // Move the old items (byte by byte, see the type policy in context.h)
+    For(range(oldAllocated)) {
+        if (oldControl[it] < 0) continue;
+
+        // Not get_hash() of the key, the hash may have been given to add_prehashed()
+        u64 mixed = oldHashes[it];
+        s64 index = swiss_table_find_insert_slot(table, mixed);
+
+        table.Control[index] = swiss_table_h2(mixed);
+        table.Hashes[index] = mixed;
+        copy_memory(table.Keys + index, oldKeys + it, sizeof(K));
+        copy_memory(table.Values + index, oldValues + it, sizeof(V));
+    }
+
+    if (oldAllocated) free(oldControl);
+}
+
+// Free any memory allocated by this object and reset count
+template <any_swiss_table T>
+void free(T &table) {
+    if (table.Allocated) free(table.Control);
+    table.Control = null;
+    table.Hashes = null;
+    table.Keys = null;
+    table.Values = null;
+    table.Count = table.SlotsFilled = table.Allocated = 0;
+}
+
+// Don't free the table, just destroy contents and reset count
+template <any_swiss_table T>
+void reset(T &table) {
+    using K = hash_table_key_t<T>;
+    using V = hash_table_value_t<T>;
+
+    For(range(table.Allocated)) {
+        if (table.Control[it] >= 0) {
+            table.Keys[it].~K();
+            table.Values[it].~V();
+        }
+    }
+    if (table.Allocated) fill_memory(table.Control, (byte) table.EMPTY, table.Allocated);
+    table.Count = table.SlotsFilled = 0;
+}
+
+// Looks for key in the table using the given hash.
+// In normal _find_ we calculate the hash of the key using the global get_hash() specialized functions.
+// This method is useful if you have cached the hash.
+template <any_swiss_table T>
+key_value_pair<T> find_prehashed(const T &table, u64 hash, const hash_table_key_t<T> &key) {
+    if (!table.Count) return {null, null};
+
+    u64 mixed = swiss_table_mix_hash(hash);
+    s8 h2 = swiss_table_h2(mixed);
+
+    s64 groupMask = table.Allocated / table.GROUP_WIDTH - 1;
+    s64 group = (s64) swiss_table_h1(mixed) & groupMask;
+
+    For_as(step, range(1, groupMask + 2)) {
+        const s8 *ctrl = table.Control + group * table.GROUP_WIDTH;
+
+        u32 candidates = swiss_table_match(ctrl, h2);
+        while (candidates) {
+            s64 index = group * table.GROUP_WIDTH + lsb(candidates);
+            if (table.Keys[index] == key) return {table.Keys + index, table.Values + index};
+            candidates &= candidates - 1;
+        }
+
+        // If the key was in the table it would've been put in this group
+        if (swiss_table_match(ctrl, table.EMPTY)) break;
+
+        group = (group + step) & groupMask;
+    }
+    return {null, null};
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_swiss_table T>
+key_value_pair<T> find(const T &table, const hash_table_key_t<T> &key) {
+    return find_prehashed(table, get_hash(key), key);
+}
+
+// Adds key and value to the table using the given hash.
+// Like hash_table, this doesn't check if the key is already there (use _set_ for that).
+// Returns pointers to the added key and value.
+template <any_swiss_table T>
+key_value_pair<T> add_prehashed(T &table, u64 hash, const hash_table_key_t<T> &key, const hash_table_value_t<T> &value) {
+    if ((table.SlotsFilled + 1) * 8 >= table.Allocated * 7) reserve(table, 1);
+
+    u64 mixed = swiss_table_mix_hash(hash);
+    s64 index = swiss_table_find_insert_slot(table, mixed);
+
+    // Reusing a tombstone doesn't fill a new slot
+    if (table.Control[index] == table.EMPTY) ++table.SlotsFilled;
+    ++table.Count;
+
+    table.Control[index] = swiss_table_h2(mixed);
+    table.Hashes[index] = mixed;
+    new (table.Keys + index) hash_table_key_t<T>(key);
+    new (table.Values + index) hash_table_value_t<T>(value);
+    return {table.Keys + index, table.Values + index};
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_swiss_table T>
+key_value_pair<T> add(T &table, const hash_table_key_t<T> &key, const hash_table_value_t<T> &value) {
+    return add_prehashed(table, get_hash(key), key, value);
+}
+
+// Inserts an empty value at a specified key and returns pointers to the key and value in the buffers.
+// See the comment above the same function in hash_table.h.
+template <any_swiss_table T>
+key_value_pair<T> add(T &table, const hash_table_key_t<T> &key) { return add(table, key, hash_table_value_t<T>()); }
+
+// In normal _set_ we calculate the hash of the key using the global get_hash() specialized functions.
+// This method is useful if you have cached the hash.
+template <any_swiss_table T>
+key_value_pair<T> set_prehashed(T &table, u64 hash, const hash_table_key_t<T> &key, const hash_table_value_t<T> &value) {
+    auto [kp, vp] = find_prehashed(table, hash, key);
+    if (vp) {
+        *vp = value;
+        return {kp, vp};
+    }
+    return add_prehashed(table, hash, key, value);
+}
+
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_swiss_table T>
+key_value_pair<T> set(T &table, const hash_table_key_t<T> &key, const hash_table_value_t<T> &value) {
+    return set_prehashed(table, get_hash(key), key, value);
+}
+
+// Returns true if the key was found and removed.
+// In normal _remove_ we calculate the hash of the key using the global get_hash() specialized functions.
+// This method is useful if you have cached the hash.
+template <any_swiss_table T>
+bool remove_prehashed(T &table, u64 hash, const hash_table_key_t<T> &key) {
+    using K = hash_table_key_t<T>;
+    using V = hash_table_value_t<T>;
+
+    auto [kp, vp] = find_prehashed(table, hash, key);
+    if (!kp) return false;
+
+    s64 index = kp - table.Keys;
+    const s8 *group = table.Control + (index & ~(table.GROUP_WIDTH - 1));
+
+    table.Keys[index].~K();
+    table.Values[index].~V();
+
+    // If the group still has an EMPTY slot no probe ever went past it, so we don't need a tombstone
+    if (swiss_table_match(group, table.EMPTY)) {
+        table.Control[index] = table.EMPTY;
+        --table.SlotsFilled;
+    } else {
+        table.Control[index] = table.DELETED;
+    }
+    --table.Count;
+    return true;
+}
+
+// Returns true if the key was found and removed.
+// We calculate the hash of the key using the global get_hash() specialized functions.
+template <any_swiss_table T>
+bool remove(T &table, const hash_table_key_t<T> &key) {
+    return remove_prehashed(table, get_hash(key), key);
+}
+
+// Returns true if the table has the given key.
+template <any_swiss_table T>
+bool has(const T &table, const hash_table_key_t<T> &key) { return find(table, key).Key != null; }
+
+// Returns true if the table has the given key.
+// This method is useful if you have cached the hash.
+template <any_swiss_table T>
+bool has_prehashed(const T &table, u64 hash, const hash_table_key_t<T> &key) { return find_prehashed(table, hash, key).Key != null; }
+
+template <typename K, typename V>
+swiss_table<K, V> *clone(swiss_table<K, V> *dest, const swiss_table<K, V> &src) {
+    free(*dest);
+    for (auto [k, v] : src) add(*dest, *k, *v);
+    return dest;
+}
+
+LSTD_END_NAMESPACE
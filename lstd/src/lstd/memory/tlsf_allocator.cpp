@@ -1,7 +1,15 @@
 #include "allocator.h"
 
+import os;
+
 LSTD_BEGIN_NAMESPACE
 
+// The handle tlsf knows the pool by, the first pool starts after the control structure
+file_scope pool_t tlsf_pool_handle(tlsf_allocator_data *data, allocator_pool *pool) {
+    if (pool == data->Base) return tlsf_get_pool(data->State);
+    return (pool_t) (pool + 1);
+}
+
 void *tlsf_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
     auto *data = (tlsf_allocator_data *) context;
 
@@ -15,17 +23,35 @@ void *tlsf_allocator(allocator_mode mode, void *context, s64 size, void *oldMemo
             auto *pool = (allocator_pool *) oldMemory;  // _oldMemory_ is the parameter which should contain the block to be added,
                                                         // the _size_ parameter contains the size of the block
 
+            if (!allocator_pool_initialize(pool, size)) return null;
+
             if (!data->State) {
-                data->State = tlsf_create_with_pool(pool, (u64) size);
-                return data->State;
+                data->State = tlsf_create_with_pool(pool + 1, (u64) pool->Size);
+                if (!data->State) return null;
             } else {
-                return tlsf_add_pool(data->State, pool, (u64) size);
+                if (!tlsf_add_pool(data->State, pool + 1, (u64) pool->Size)) return null;
             }
+
+            allocator_pool_add_to_linked_list(&data->Base, pool);
+            ++data->PoolsCount;
+            return pool;
         }
         case allocator_mode::REMOVE_POOL: {
             auto *pool = (allocator_pool *) oldMemory;
-            tlsf_remove_pool(data->State, pool); // This function assumes the block exists, strange asserts may occur if the caller is not careful.
-            return pool;
+
+            if (pool == data->Base) {
+                assert(!pool->Next && "The first pool holds the allocator's state, remove the others first");
+                data->State = null;
+            } else {
+                tlsf_remove_pool(data->State, tlsf_pool_handle(data, pool));  // This assumes nothing is allocated in the pool
+            }
+
+            void *result = allocator_pool_remove_from_linked_list(&data->Base, pool);
+            if (result) {
+                --data->PoolsCount;
+                assert(data->PoolsCount >= 0);
+            }
+            return result;
         }
         case allocator_mode::ALLOCATE: {
             return tlsf_malloc(data->State, size);
@@ -38,9 +64,29 @@ void *tlsf_allocator(allocator_mode mode, void *context, s64 size, void *oldMemo
             return null;
         }
         case allocator_mode::FREE_ALL: {
+            // Creating the state again empties the free lists and makes each pool one big free block,
+            // we don't have to walk the blocks which were allocated
+            auto *p = data->Base;
+            data->State = tlsf_create_with_pool(p + 1, (u64) p->Size);
+
+            for (p = p->Next; p; p = p->Next) tlsf_add_pool(data->State, p + 1, (u64) p->Size);
+
             // null means successful FREE_ALL
-            // (void *) -1 means that the allocator doesn't support FREE_ALL (by design)
-            return (void *) -1;
+            return null;
+        }
+        case allocator_mode::ALLOCATE_BATCH: {
+            // tlsf has no bulk path, but at least we save the round trips through general_allocate
+            auto **out = (void **) oldMemory;
+            For(range(oldSize)) {
+                out[it] = tlsf_malloc(data->State, size);
+                if (!out[it]) return out + it;
+            }
+            return out + oldSize;
+        }
+        case allocator_mode::FREE_BATCH: {
+            auto **blocks = (void **) oldMemory;
+            For(range(oldSize)) tlsf_free(data->State, blocks[it]);
+            return null;
         }
         default:
             assert(false);
@@ -48,4 +94,21 @@ void *tlsf_allocator(allocator_mode mode, void *context, s64 size, void *oldMemo
     return null;
 }
 
+file_scope void tlsf_trim_walker(void *ptr, u64 size, int used, void *user) {
+    if (used) return;
+
+    // The first 16 bytes of a free block are its links in the free list and the last 8 bytes are the header
+    // of the next block (it points back to this one), the rest isn't read by tlsf
+    byte *begin = (byte *) ptr + 2 * sizeof(void *);
+    byte *end   = (byte *) ptr + size - sizeof(void *);
+
+    *(s64 *) user += os_purge_memory(begin, end - begin);
+}
+
+s64 tlsf_trim(tlsf_allocator_data *data) {
+    s64 purged = 0;
+    for (auto *p = data->Base; p; p = p->Next) tlsf_walk_pool(tlsf_pool_handle(data, p), tlsf_trim_walker, &purged);
+    return purged;
+}
+
 LSTD_END_NAMESPACE
@@ -0,0 +1,52 @@
+#include "allocator.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+struct allocator_trimmer_state {
+    thread::thread Thread;
+    thread::semaphore Stop;  // Signaled to wake the thread up early and make it quit
+    bool Running = false;
+};
+
+file_scope allocator_trimmer_state Trimmer;
+
+// Only one thread starts and stops the trimmer at a time
+file_scope thread::fast_mutex TrimmerLock;
+
+void allocator_trimmer_start(u32 intervalMs, void (*trim)(void *), void *userData) {
+    thread::scoped_lock _(&TrimmerLock);
+
+    if (Trimmer.Running) {
+        Trimmer.Stop.signal();
+        Trimmer.Thread.wait();
+    }
+
+    // Throw away a signal which came after the last thread quit
+    while (Trimmer.Stop.try_wait()) {
+    }
+
+    Trimmer.Running = true;
+    Trimmer.Thread.init_and_launch([=](void *) {
+        // The semaphore is our sleep, it times out unless we are told to stop
+        while (!Trimmer.Stop.wait_for(intervalMs)) {
+            if (trim) {
+                trim(userData);
+            } else {
+                internal::platform_trim_persistent_allocator();
+            }
+        }
+    });
+}
+
+void allocator_trimmer_stop() {
+    thread::scoped_lock _(&TrimmerLock);
+    if (!Trimmer.Running) return;
+
+    Trimmer.Stop.signal();
+    Trimmer.Thread.wait();
+    Trimmer.Running = false;
+}
+
+LSTD_END_NAMESPACE
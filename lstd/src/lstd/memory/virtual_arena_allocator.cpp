@@ -0,0 +1,127 @@
+#include "allocator.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope s64 round_up_to(s64 value, s64 granularity) { return (value + granularity - 1) / granularity * granularity; }
+
+void virtual_arena_reserve(virtual_arena_allocator_data *data, s64 size) {
+    assert(!data->Base && "Address space already reserved");
+
+    size = round_up_to(size, os_get_allocation_granularity());
+
+    data->Base = (byte *) os_reserve_memory(size);
+    if (!data->Base) return;
+
+    data->Reserved = size;
+    data->Committed = 0;
+    data->Used = 0;
+}
+
+void virtual_arena_decommit(virtual_arena_allocator_data *data) {
+    if (!data->Base) return;
+
+    s64 keep = round_up_to(data->Used, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+    if (keep < data->Committed) {
+        os_decommit_memory(data->Base + keep, data->Committed - keep);
+        data->Committed = keep;
+    }
+}
+
+void virtual_arena_release(virtual_arena_allocator_data *data) {
+    if (!data->Base) return;
+
+    os_release_memory(data->Base);
+    data->Base = null;
+    data->Reserved = data->Committed = data->Used = 0;
+
+    allocator_registry_remove({virtual_arena_allocator, data});
+}
+
+// Makes sure the first _used_ bytes of the range are committed
+file_scope bool virtual_arena_ensure_committed(virtual_arena_allocator_data *data, s64 used) {
+    if (used <= data->Committed) return true;
+    if (used > data->Reserved) return false;  // The reservation is exhausted
+
+    s64 newCommitted = round_up_to(used, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+    if (newCommitted > data->Reserved) newCommitted = data->Reserved;
+
+    if (!os_commit_memory(data->Base + data->Committed, newCommitted - data->Committed)) return false;
+    data->Committed = newCommitted;
+    return true;
+}
+
+void *virtual_arena_allocator(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    auto *data = (virtual_arena_allocator_data *) context;
+
+    switch (mode) {
+        case allocator_mode::ADD_POOL:
+        case allocator_mode::REMOVE_POOL: {
+            assert(false && "Virtual arenas don't use pools. Call virtual_arena_reserve() instead.");
+            return null;
+        }
+        case allocator_mode::ALLOCATE: {
+            if (!data->Base) {
+                virtual_arena_reserve(data, size > VIRTUAL_ARENA_DEFAULT_RESERVE ? size : VIRTUAL_ARENA_DEFAULT_RESERVE);
+                if (!data->Base) return null;
+            }
+
+            if (!virtual_arena_ensure_committed(data, data->Used + size)) return null;  // Not enough space
+
+            void *result = data->Base + data->Used;
+            data->Used += size;
+            return result;
+        }
+        case allocator_mode::RESIZE: {
+            // We can resize in place only the last allocated block
+            if ((byte *) oldMemory + oldSize != data->Base + data->Used) return null;
+
+            s64 newUsed = data->Used - oldSize + size;
+            if (!virtual_arena_ensure_committed(data, newUsed)) return null;
+
+            data->Used = newUsed;
+            return oldMemory;
+        }
+        case allocator_mode::FREE: {
+            // We don't free individual allocations, unless it's the last block
+            if ((byte *) oldMemory + oldSize == data->Base + data->Used) data->Used -= oldSize;
+
+            // null means success FREE
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            data->Used = 0;
+
+            // null means successful FREE_ALL
+            // (void *) -1 means that the allocator doesn't support FREE_ALL (by design)
+            return null;
+        }
+        case allocator_mode::ALLOCATE_BATCH: {
+            auto **out = (void **) oldMemory;
+
+            if (!data->Base) {
+                virtual_arena_reserve(data, size * oldSize > VIRTUAL_ARENA_DEFAULT_RESERVE ? size * oldSize : VIRTUAL_ARENA_DEFAULT_RESERVE);
+                if (!data->Base) return out;
+            }
+
+            // Commit for the whole batch at once
+            if (!virtual_arena_ensure_committed(data, data->Used + size * oldSize)) return out;  // Not enough space
+
+            For(range(oldSize)) {
+                out[it] = data->Base + data->Used;
+                data->Used += size;
+            }
+            return out + oldSize;
+        }
+        case allocator_mode::FREE_BATCH: {
+            // Individual frees only reclaim the last block, FREE does that for us
+            return (void *) -1;
+        }
+        default:
+            assert(false);
+    }
+    return null;
+}
+
+LSTD_END_NAMESPACE
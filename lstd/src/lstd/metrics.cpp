@@ -0,0 +1,262 @@
+#include "metrics.h"
+
+#include "memory/allocator.h"
+#include "thread.h"
+
+import fmt;
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope thread::fast_mutex MetricsLock;  // Guards registering, recording doesn't touch the registry
+file_scope metric *Metrics[METRICS_CAPACITY];
+file_scope s64 MetricCount;
+
+file_scope s32 NextMetricShard;
+
+s32 internal::metric_assign_shard() {
+    MetricShard = atomic_inc(&NextMetricShard) & 0x7fffffff;
+    return MetricShard;
+}
+
+file_scope bool metric_register(metric *m, const char *name, const char *help, metric_kind kind) {
+    assert(!m->Name && "Registered already");
+
+    m->Name = name;
+    m->Help = help;
+    m->Kind = kind;
+
+    thread::scoped_lock _(&MetricsLock);
+    if (MetricCount == METRICS_CAPACITY) return false;
+
+    Metrics[MetricCount++] = m;
+    return true;
+}
+
+bool metric_register(metric_counter &m, const char *name, const char *help) { return metric_register(&m, name, help, metric_kind::Counter); }
+bool metric_register(metric_gauge &m, const char *name, const char *help) { return metric_register(&m, name, help, metric_kind::Gauge); }
+bool metric_register(metric_histogram &m, const char *name, const char *help) { return metric_register(&m, name, help, metric_kind::Histogram); }
+
+s64 metric_get(const metric_counter &m) {
+    s64 sum = 0;
+    For(m.Shards) sum += it.load(memory_order::Relaxed);
+    return sum;
+}
+
+void metric_record(metric_histogram &m, s64 value) {
+    if (value < 0) value = 0;
+
+    auto &shard = m.Shards[internal::metric_shard() % METRIC_HISTOGRAM_SHARDS].Value;
+    shard.Buckets[metric_histogram_bucket(value)].fetch_add(1, memory_order::Relaxed);
+    shard.Count.fetch_add(1, memory_order::Relaxed);
+    shard.Sum.fetch_add(value, memory_order::Relaxed);
+
+    // Plain loads first, the compare and exchange only happens for a new extreme
+    s64 min = m.Min.load(memory_order::Relaxed);
+    while (value < min && !m.Min.compare_exchange(min, value, memory_order::Relaxed)) {
+    }
+
+    s64 max = m.Max.load(memory_order::Relaxed);
+    while (value > max && !m.Max.compare_exchange(max, value, memory_order::Relaxed)) {
+    }
+}
+
+metric_histogram_snapshot metric_get(const metric_histogram &m) {
+    metric_histogram_snapshot s;
+    zero_memory(&s, sizeof(s));
+
+    For(m.Shards) {
+        auto &shard = it.Value;
+        For_as(b, range(METRIC_HISTOGRAM_BUCKETS)) s.Buckets[b] += shard.Buckets[b].load(memory_order::Relaxed);
+        s.Count += shard.Count.load(memory_order::Relaxed);
+        s.Sum += shard.Sum.load(memory_order::Relaxed);
+    }
+
+    s.Min = m.Min.load(memory_order::Relaxed);
+    s.Max = m.Max.load(memory_order::Relaxed);
+    return s;
+}
+
+void metric_histogram_merge(metric_histogram_snapshot &into, const metric_histogram_snapshot &other) {
+    For(range(METRIC_HISTOGRAM_BUCKETS)) into.Buckets[it] += other.Buckets[it];
+    into.Count += other.Count;
+    into.Sum += other.Sum;
+    into.Min = min(into.Min, other.Min);
+    into.Max = max(into.Max, other.Max);
+}
+
+s64 metric_histogram_percentile(const metric_histogram_snapshot &s, f64 percentile) {
+    s64 total = 0;
+    For(s.Buckets) total += it;
+    if (!total) return 0;
+
+    // The rank of the value we are looking for, 1-based (rounded up)
+    f64 exact = clamp(percentile, 0.0, 100.0) / 100.0 * (f64) total;
+
+    s64 rank = (s64) exact;
+    if ((f64) rank < exact) ++rank;
+    rank = max(rank, (s64) 1);
+
+    s64 seen = 0;
+    For(range(METRIC_HISTOGRAM_BUCKETS)) {
+        seen += s.Buckets[it];
+        if (seen < rank) continue;
+
+        s64 upper = it == METRIC_HISTOGRAM_BUCKETS - 1 ? numeric_info<s64>::max() : metric_histogram_bucket_lower_bound(it + 1) - 1;
+        return min(upper, s.Max);
+    }
+    return s.Max;
+}
+
+void metric_reset(metric_counter &m) {
+    For(m.Shards) it.store(0, memory_order::Relaxed);
+}
+
+void metric_reset(metric_gauge &m) { m.Value.store(0, memory_order::Relaxed); }
+
+void metric_reset(metric_histogram &m) {
+    For(m.Shards) {
+        For_as(b, it.Value.Buckets) b.store(0, memory_order::Relaxed);
+        it.Value.Count.store(0, memory_order::Relaxed);
+        it.Value.Sum.store(0, memory_order::Relaxed);
+    }
+    m.Min.store(numeric_info<s64>::max(), memory_order::Relaxed);
+    m.Max.store(numeric_info<s64>::min(), memory_order::Relaxed);
+}
+
+void metrics_for_each(const delegate<void(metric *)> &f) {
+    // Metrics are never unregistered, so what we saw under the lock stays valid
+    s64 count;
+    {
+        thread::scoped_lock _(&MetricsLock);
+        count = MetricCount;
+    }
+    For(range(count)) f(Metrics[it]);
+}
+
+//
+// Prometheus text format, see https://prometheus.io/docs/instrumenting/exposition_formats/
+// The format strings are compiled ("..."_fmt), integers without specs go through the fast path of fmt.
+//
+
+// Label values escape backslashes (Windows paths in lock locations), quotes and new lines
+file_scope void prometheus_write_label_value(writer *out, const char *value) {
+    const char *run = value;
+    for (const char *p = value; *p; ++p) {
+        const char *escaped = *p == '\\' ? "\\\\" : *p == '"' ? "\\\"" : *p == '\n' ? "\\n" : null;
+        if (!escaped) continue;
+
+        write(out, (const byte *) run, p - run);
+        write(out, string(escaped));
+        run = p + 1;
+    }
+    write(out, string(run));
+}
+
+file_scope void prometheus_write_header(writer *out, const char *name, const char *help, const char *type) {
+    if (*help) fmt_to_writer(out, "# HELP {} {}\n"_fmt, name, help);
+    fmt_to_writer(out, "# TYPE {} {}\n"_fmt, name, type);
+}
+
+file_scope void prometheus_write_histogram(writer *out, metric_histogram *m) {
+    auto s = metric_get(*m);
+
+    s64 highest = -1;
+    For(range(METRIC_HISTOGRAM_BUCKETS)) {
+        if (s.Buckets[it]) highest = it;
+    }
+
+    // One bucket per power of two. The count of the +Inf bucket and _count come from the buckets too,
+    // the total can be ahead of them in a snapshot and Prometheus wants them to agree.
+    s64 cumulative = 0;
+    if (highest >= 0) {
+        For_as(group, range(highest / METRIC_HISTOGRAM_SUB_BUCKETS + 1)) {
+            For_as(sub, range(METRIC_HISTOGRAM_SUB_BUCKETS)) cumulative += s.Buckets[group * METRIC_HISTOGRAM_SUB_BUCKETS + sub];
+
+            s64 le = metric_histogram_bucket_lower_bound((group + 1) * METRIC_HISTOGRAM_SUB_BUCKETS) - 1;
+            fmt_to_writer(out, "{}_bucket{{le=\"{}\"}} {}\n"_fmt, m->Name, le, cumulative);
+        }
+    }
+    fmt_to_writer(out, "{}_bucket{{le=\"+Inf\"}} {}\n"_fmt, m->Name, cumulative);
+    fmt_to_writer(out, "{}_sum {}\n"_fmt, m->Name, s.Sum);
+    fmt_to_writer(out, "{}_count {}\n"_fmt, m->Name, cumulative);
+}
+
+file_scope void prometheus_write_memory_tags(writer *out) {
+    memory_tag_stats tags[MEMORY_TAG_COUNT];
+    s64 count = 0;
+    For(range(MEMORY_TAG_COUNT)) {
+        auto stats = memory_tag_get_stats((u8) it);
+        if (stats.Name && stats.AllocationCount) tags[count++] = stats;
+    }
+    if (!count) return;
+
+    // Every sample of a metric has to follow its header, so this goes over the tags once per metric
+    struct {
+        const char *Name, *Help, *Type;
+        s64 memory_tag_stats::*Field;
+    } columns[] = {
+        {"lstd_memory_tag_bytes", "Bytes allocated under the memory tag and not freed yet", "gauge", &memory_tag_stats::CurrentBytes},
+        {"lstd_memory_tag_peak_bytes", "The most bytes the memory tag had at once", "gauge", &memory_tag_stats::PeakBytes},
+        {"lstd_memory_tag_allocations_total", "Allocations made under the memory tag", "counter", &memory_tag_stats::AllocationCount},
+        {"lstd_memory_tag_frees_total", "Allocations of the memory tag which were freed", "counter", &memory_tag_stats::FreeCount},
+    };
+
+    For_as(c, columns) {
+        prometheus_write_header(out, c.Name, c.Help, c.Type);
+        For_as(tag, range(count)) {
+            fmt_to_writer(out, "{}{{tag=\""_fmt, c.Name);
+            prometheus_write_label_value(out, tags[tag].Name);
+            fmt_to_writer(out, "\"}} {}\n"_fmt, tags[tag].*c.Field);
+        }
+    }
+}
+
+file_scope void prometheus_write_lock_profiles(writer *out) {
+#if defined LSTD_LOCK_PROFILING
+    struct {
+        const char *Name, *Help;
+        s64 thread::lock_profile::*Field;
+    } columns[] = {
+        {"lstd_lock_acquisitions_total", "Times locks made at the location were locked", &thread::lock_profile::Acquisitions},
+        {"lstd_lock_contended_total", "Acquisitions which had to wait", &thread::lock_profile::Contended},
+        {"lstd_lock_wait_ns_total", "Nanoseconds spent waiting for the locks", &thread::lock_profile::WaitNs},
+    };
+
+    For_as(c, columns) {
+        prometheus_write_header(out, c.Name, c.Help, "counter");
+
+        auto column = c;
+        auto sample = [&](const thread::lock_profile &p) {
+            fmt_to_writer(out, "{}{{kind=\"{}\",location=\""_fmt, column.Name, p.Kind);
+            prometheus_write_label_value(out, p.Loc.File);
+            fmt_to_writer(out, ":{}\"}} {}\n"_fmt, p.Loc.Line, p.*column.Field);
+        };
+        thread::lock_profile_for_each(&sample);
+    }
+#endif
+}
+
+void metrics_write_prometheus(writer *out) {
+    auto each = [&](metric *m) {
+        switch (m->Kind) {
+            case metric_kind::Counter:
+                prometheus_write_header(out, m->Name, m->Help, "counter");
+                fmt_to_writer(out, "{} {}\n"_fmt, m->Name, metric_get(*(metric_counter *) m));
+                break;
+            case metric_kind::Gauge:
+                prometheus_write_header(out, m->Name, m->Help, "gauge");
+                fmt_to_writer(out, "{} {}\n"_fmt, m->Name, metric_get(*(metric_gauge *) m));
+                break;
+            case metric_kind::Histogram:
+                prometheus_write_header(out, m->Name, m->Help, "histogram");
+                prometheus_write_histogram(out, (metric_histogram *) m);
+                break;
+        }
+    };
+    metrics_for_each(&each);
+
+    prometheus_write_memory_tags(out);
+    prometheus_write_lock_profiles(out);
+}
+
+LSTD_END_NAMESPACE
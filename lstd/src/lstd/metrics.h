@@ -0,0 +1,158 @@
+#pragma once
+
+#include "atomic.h"
+#include "io/writer.h"
+#include "memory/delegate.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// :Metrics: Numbers a running program keeps about itself - requests served, bytes in flight, how long things take -
+// recorded without locks from any thread and read (or exported) from another.
+//
+//     metric_counter Requests;
+//     metric_histogram Latency;
+//
+//     metric_register(Requests, "http_requests_total", "Requests served");
+//     metric_register(Latency, "http_request_duration_ns", "Time from the request line to the last byte sent");
+//
+//     metric_add(Requests);
+//     metric_record(Latency, os_get_timestamp_ns() - start);
+//
+//     metrics_write_prometheus(&out);  // The text format Prometheus scrapes (e.g. in the handler of /metrics)
+//
+// Counters only go up. They are split into METRIC_SHARDS cache lines and every thread adds to its own one, so threads
+// which count the same thing don't fight over a line. Reading sums the shards - a read is slower than a write,
+// which is the right way around. A gauge is a single value which is set (or moved up and down).
+//
+// Histograms are log-linear like HdrHistogram: every power of two is split into METRIC_HISTOGRAM_SUB_BUCKETS buckets,
+// so any value from 0 to 2^63 is kept with a relative error of at most 1/16 in a fixed array. Recording is
+// a bit scan and an atomic add. A snapshot is a plain copy of the counts, snapshots merge by adding them up
+// (e.g. the histograms of several processes, or the last minute out of snapshots taken every second).
+//
+// Metrics are owned by the caller (usually globals) and must live until the end of the program once registered.
+// Names aren't copied, pass literals. The registry keeps up to METRICS_CAPACITY metrics, the Prometheus export
+// also includes the memory tags (see memory_tag_get()) and the lock profiles (see :LockProfiling:).
+//
+
+constexpr s64 METRICS_CAPACITY = 256;
+
+constexpr s64 METRIC_SHARDS                = 16;
+constexpr s64 METRIC_HISTOGRAM_SHARDS      = 4;  // Fewer, a shard of a histogram is 7.5 KiB
+constexpr s64 METRIC_HISTOGRAM_SUB_BITS    = 4;
+constexpr s64 METRIC_HISTOGRAM_SUB_BUCKETS = 1 << METRIC_HISTOGRAM_SUB_BITS;
+
+// Values below METRIC_HISTOGRAM_SUB_BUCKETS get a bucket each, after that every power of two up to 2^63
+constexpr s64 METRIC_HISTOGRAM_BUCKETS = (64 - METRIC_HISTOGRAM_SUB_BITS) * METRIC_HISTOGRAM_SUB_BUCKETS;
+
+enum class metric_kind : s32 { Counter, Gauge, Histogram };
+
+struct metric {
+    const char *Name = null;  // Set by metric_register()
+    const char *Help = "";
+    metric_kind Kind = metric_kind::Counter;
+};
+
+struct metric_counter : metric {
+    padded_atomic<s64> Shards[METRIC_SHARDS];
+};
+
+struct metric_gauge : metric {
+    padded_atomic<s64> Value;
+};
+
+struct metric_histogram_shard {
+    atomic<s64> Buckets[METRIC_HISTOGRAM_BUCKETS];
+    atomic<s64> Count, Sum;
+};
+
+struct metric_histogram : metric {
+    cache_aligned<metric_histogram_shard> Shards[METRIC_HISTOGRAM_SHARDS];
+
+    // Exact, not per shard. They are written only when a value goes past them, which stops happening quickly.
+    atomic<s64> Min = numeric_info<s64>::max();
+    atomic<s64> Max = numeric_info<s64>::min();
+};
+
+struct metric_histogram_snapshot {
+    s64 Buckets[METRIC_HISTOGRAM_BUCKETS];
+    s64 Count;
+    s64 Sum;
+
+    s64 Min;  // numeric_info<s64>::max() if _Count_ is 0
+    s64 Max;  // numeric_info<s64>::min() if _Count_ is 0
+};
+
+namespace internal {
+inline thread_local s32 MetricShard = -1;
+
+// Hands out shards to threads round robin, the first time a thread records something
+s32 metric_assign_shard();
+
+always_inline s32 metric_shard() {
+    s32 shard = MetricShard;
+    return shard >= 0 ? shard : metric_assign_shard();
+}
+}  // namespace internal
+
+// Adds _m_ to the registry (for metrics_write_prometheus and metrics_for_each) under _name_.
+// Returns false if the registry is full, the metric still works but isn't exported.
+bool metric_register(metric_counter &m, const char *name, const char *help = "");
+bool metric_register(metric_gauge &m, const char *name, const char *help = "");
+bool metric_register(metric_histogram &m, const char *name, const char *help = "");
+
+always_inline void metric_add(metric_counter &m, s64 n = 1) {
+    m.Shards[internal::metric_shard() % METRIC_SHARDS].fetch_add(n, memory_order::Relaxed);
+}
+
+// The sum of the shards. Adds which happen while we read may or may not be in it.
+s64 metric_get(const metric_counter &m);
+
+always_inline void metric_set(metric_gauge &m, s64 value) { m.Value.store(value, memory_order::Relaxed); }
+always_inline void metric_add(metric_gauge &m, s64 n = 1) { m.Value.fetch_add(n, memory_order::Relaxed); }
+always_inline s64 metric_get(const metric_gauge &m) { return m.Value.load(memory_order::Relaxed); }
+
+// The bucket _value_ goes to. Negative values are counted as 0.
+constexpr s64 metric_histogram_bucket(s64 value) {
+    if (value < METRIC_HISTOGRAM_SUB_BUCKETS) return value < 0 ? 0 : value;
+
+    s64 exponent = msb((u64) value);  // >= METRIC_HISTOGRAM_SUB_BITS
+    s64 sub      = (value >> (exponent - METRIC_HISTOGRAM_SUB_BITS)) & (METRIC_HISTOGRAM_SUB_BUCKETS - 1);
+    return (exponent - METRIC_HISTOGRAM_SUB_BITS + 1) * METRIC_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// The smallest value which goes to _bucket_, the bucket holds the values up to the lower bound of the next one
+constexpr s64 metric_histogram_bucket_lower_bound(s64 bucket) {
+    if (bucket < METRIC_HISTOGRAM_SUB_BUCKETS) return bucket;
+
+    s64 group = bucket / METRIC_HISTOGRAM_SUB_BUCKETS;  // >= 1
+    s64 sub   = bucket % METRIC_HISTOGRAM_SUB_BUCKETS;
+    return (METRIC_HISTOGRAM_SUB_BUCKETS + sub) << (group - 1);
+}
+
+void metric_record(metric_histogram &m, s64 value);
+
+// Copies the counts. Values recorded while we copy may or may not be in it, or be in _Count_ but not in a bucket yet.
+metric_histogram_snapshot metric_get(const metric_histogram &m);
+
+// Adds the counts of _other_ to _into_
+void metric_histogram_merge(metric_histogram_snapshot &into, const metric_histogram_snapshot &other);
+
+// The value below which _percentile_ (0 to 100) of the recorded values are. It's the upper end of the bucket
+// the value falls in (clamped to _Max_), so it's never below the real one. 0 if nothing was recorded.
+s64 metric_histogram_percentile(const metric_histogram_snapshot &s, f64 percentile);
+
+// Sets the counter's shards, the gauge or the histogram's buckets to 0 (they stay registered)
+void metric_reset(metric_counter &m);
+void metric_reset(metric_gauge &m);
+void metric_reset(metric_histogram &m);
+
+// Calls _f_ with every registered metric, in the order they were registered. Check _Kind_ and cast.
+void metrics_for_each(const delegate<void(metric *)> &f);
+
+// Writes every registered metric (and the memory tags and lock profiles) in the Prometheus text exposition format.
+// A histogram is written with a bucket per power of two up to its highest value, cumulative like Prometheus wants,
+// and _sum and _count.
+void metrics_write_prometheus(writer *out);
+
+LSTD_END_NAMESPACE
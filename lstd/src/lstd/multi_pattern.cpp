@@ -0,0 +1,343 @@
+#include "multi_pattern.h"
+
+#include "memory/sort.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSSE3 and AVX2 intrinsics
+
+// MSVC lets us use newer instructions without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Building the automaton
+//
+
+file_scope void build_byte_classes(multi_pattern &m) {
+    bool used[256] = {};
+    For(m.Patterns) {
+        For_as(i, range(it.Count)) used[(u8) it.Data[i]] = true;
+    }
+
+    // Class 0 is every byte which isn't in a pattern
+    m.ClassCount = 1;
+    For(range(256)) m.ByteClass[it] = used[it] ? (u16) m.ClassCount++ : 0;
+}
+
+file_scope s32 add_state(multi_pattern &m) {
+    s32 state = (s32) m.Longest.Count;
+    For(range(m.ClassCount)) array_append(m.Next, -1);
+    array_append(m.Longest, -1);
+    return state;
+}
+
+file_scope void build_automaton(multi_pattern &m) {
+    build_byte_classes(m);
+    add_state(m);
+
+    // The trie, -1 where there is no edge. _Longest_ is only the pattern which ends at the state for now.
+    For_enumerate_as(it_index, pattern, m.Patterns) {
+        s32 s = 0;
+        For_as(i, range(pattern.Count)) {
+            s64 edge = (s64) s * m.ClassCount + m.ByteClass[(u8) pattern.Data[i]];
+            if (m.Next[edge] == -1) {
+                s32 fresh    = add_state(m);  // May move m.Next
+                m.Next[edge] = fresh;
+            }
+            s = m.Next[edge];
+        }
+        if (m.Longest[s] == -1) m.Longest[s] = (s32) it_index;  // The first of identical patterns wins
+    }
+
+    // Breadth first, so the failure state of a state (which is shorter) is complete before we get to it.
+    // A missing edge goes where the failure state goes, that's what makes it a DFA.
+    array<s32> fail;
+    array<s32> queue;
+    defer({
+        free(fail);
+        free(queue);
+    });
+    For(range(m.Longest.Count)) array_append(fail, 0);
+
+    For(range(m.ClassCount)) {
+        s32 &next = m.Next[it];
+        if (next == -1) {
+            next = 0;
+        } else {
+            array_append(queue, next);
+        }
+    }
+
+    for (s64 head = 0; head < queue.Count; ++head) {
+        s32 u = queue[head];
+        For(range(m.ClassCount)) {
+            s32 v    = m.Next[(s64) u * m.ClassCount + it];
+            s32 jump = m.Next[(s64) fail[u] * m.ClassCount + it];
+            if (v == -1) {
+                m.Next[(s64) u * m.ClassCount + it] = jump;
+                continue;
+            }
+
+            fail[v] = jump;
+            if (m.Longest[v] == -1) m.Longest[v] = m.Longest[jump];
+            array_append(queue, v);
+        }
+    }
+}
+
+//
+// Teddy. Bucket b has bit b. TeddyLow[j][n] has the bits of the buckets with a pattern whose byte j has n as its
+// low nibble, TeddyHigh the same for the high nibble. A position where the lookups of the next _TeddySize_ bytes
+// have a bit in common is a candidate for the patterns of that bucket.
+//
+// Patterns are sorted before they are split, so ones with the same beginning share a bucket and don't add bits
+// to the masks of other buckets (which would cause more false candidates).
+//
+
+file_scope void build_teddy(multi_pattern &m) {
+    m.Teddy     = true;
+    m.TeddySize = (s32) min(m.MinLength, (s64) 3);
+
+    For(range(m.Patterns.Count)) array_append(m.TeddyPatterns, (s32) it);
+    sort(m.TeddyPatterns, [&](s32 *a, s32 *b) { return compare_lexicographically(m.Patterns[*a], m.Patterns[*b]); });
+
+    zero_memory(m.TeddyLow, sizeof(m.TeddyLow));
+    zero_memory(m.TeddyHigh, sizeof(m.TeddyHigh));
+
+    s64 perBucket = (m.Patterns.Count + MULTI_PATTERN_TEDDY_BUCKETS - 1) / MULTI_PATTERN_TEDDY_BUCKETS;
+    For(range(MULTI_PATTERN_TEDDY_BUCKETS + 1)) m.TeddyBucketBegin[it] = (s32) min(it * perBucket, m.Patterns.Count);
+
+    For_as(bucket, range(MULTI_PATTERN_TEDDY_BUCKETS)) {
+        For_as(i, range(m.TeddyBucketBegin[bucket], m.TeddyBucketBegin[bucket + 1])) {
+            const string &pattern = m.Patterns[m.TeddyPatterns[i]];
+            For(range(m.TeddySize)) {
+                u8 c = (u8) pattern.Data[it];
+                m.TeddyLow[it][c & 0x0F] |= (u8) (1 << bucket);
+                m.TeddyHigh[it][c >> 4] |= (u8) (1 << bucket);
+            }
+        }
+    }
+}
+
+// Checks the patterns in the buckets of _bits_ at _pos_, returns the longest which is there
+file_scope multi_pattern_match teddy_verify(const multi_pattern &m, const byte *data, s64 size, s64 pos, u32 bits) {
+    multi_pattern_match best;
+    while (bits) {
+        s32 bucket = lsb(bits);
+        bits &= bits - 1;
+
+        For_as(i, range(m.TeddyBucketBegin[bucket], m.TeddyBucketBegin[bucket + 1])) {
+            s32 index             = m.TeddyPatterns[i];
+            const string &pattern = m.Patterns[index];
+            if (pattern.Count > size - pos || (best && pattern.Count <= best.End - best.Begin)) continue;
+
+            if (equal_memory(data + pos, pattern.Data, pattern.Count)) best = {index, pos, pos + pattern.Count};
+        }
+    }
+    return best;
+}
+
+file_scope multi_pattern_match teddy_find_scalar(const multi_pattern &m, const byte *data, s64 size, s64 from) {
+    for (s64 pos = from; pos + m.MinLength <= size; ++pos) {
+        u32 bits = 0xFF;
+        For(range(m.TeddySize)) {
+            u8 c = data[pos + it];
+            bits &= m.TeddyLow[it][c & 0x0F] & m.TeddyHigh[it][c >> 4];
+        }
+        if (!bits) continue;
+
+        multi_pattern_match match = teddy_verify(m, data, size, pos, bits);
+        if (match) return match;
+    }
+    return {};
+}
+
+#if ARCH == X86
+TARGET_SSSE3 file_scope multi_pattern_match teddy_find_ssse3(const multi_pattern &m, const byte *data, s64 size, s64 from) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero   = _mm_setzero_si128();
+
+    __m128i low[3], high[3];
+    For(range(m.TeddySize)) {
+        low[it]  = _mm_loadu_si128((const __m128i *) m.TeddyLow[it]);
+        high[it] = _mm_loadu_si128((const __m128i *) m.TeddyHigh[it]);
+    }
+
+    s64 pos = from;
+    for (; pos + 16 + m.TeddySize - 1 <= size; pos += 16) {
+        __m128i candidates = _mm_set1_epi8(-1);
+        For(range(m.TeddySize)) {
+            __m128i v  = _mm_loadu_si128((const __m128i *) (data + pos + it));
+            __m128i lo = _mm_shuffle_epi8(low[it], _mm_and_si128(v, nibble));
+            __m128i hi = _mm_shuffle_epi8(high[it], _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            candidates = _mm_and_si128(candidates, _mm_and_si128(lo, hi));
+        }
+
+        u32 mask = ~(u32) _mm_movemask_epi8(_mm_cmpeq_epi8(candidates, zero)) & 0xFFFF;
+        if (!mask) continue;
+
+        alignas(16) u8 bits[16];
+        _mm_store_si128((__m128i *) bits, candidates);
+        while (mask) {
+            s64 k = lsb(mask);
+            mask &= mask - 1;
+
+            multi_pattern_match match = teddy_verify(m, data, size, pos + k, bits[k]);
+            if (match) return match;
+        }
+    }
+    return teddy_find_scalar(m, data, size, pos);
+}
+
+TARGET_AVX2 file_scope multi_pattern_match teddy_find_avx2(const multi_pattern &m, const byte *data, s64 size, s64 from) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero   = _mm256_setzero_si256();
+
+    __m256i low[3], high[3];
+    For(range(m.TeddySize)) {
+        low[it]  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) m.TeddyLow[it]));
+        high[it] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) m.TeddyHigh[it]));
+    }
+
+    s64 pos = from;
+    for (; pos + 32 + m.TeddySize - 1 <= size; pos += 32) {
+        __m256i candidates = _mm256_set1_epi8(-1);
+        For(range(m.TeddySize)) {
+            __m256i v  = _mm256_loadu_si256((const __m256i *) (data + pos + it));
+            __m256i lo = _mm256_shuffle_epi8(low[it], _mm256_and_si256(v, nibble));
+            __m256i hi = _mm256_shuffle_epi8(high[it], _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            candidates = _mm256_and_si256(candidates, _mm256_and_si256(lo, hi));
+        }
+
+        u32 mask = ~(u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero));
+        if (!mask) continue;
+
+        alignas(32) u8 bits[32];
+        _mm256_store_si256((__m256i *) bits, candidates);
+        while (mask) {
+            s64 k = lsb(mask);
+            mask &= mask - 1;
+
+            multi_pattern_match match = teddy_verify(m, data, size, pos + k, bits[k]);
+            if (match) return match;
+        }
+    }
+    return teddy_find_ssse3(m, data, size, pos);
+}
+#endif
+
+//
+// Searching with the automaton. The longest pattern which ends at a position begins the earliest of the ones which
+// end there, we keep the one which begins first. Once we are _MaxLength_ past where it begins nothing which ends
+// later can begin before it.
+//
+
+file_scope multi_pattern_match automaton_find(const multi_pattern &m, const byte *data, s64 size, s64 from) {
+    multi_pattern_match best;
+
+    s32 s = 0;
+    for (s64 pos = from; pos < size; ++pos) {
+        s = m.Next[(s64) s * m.ClassCount + m.ByteClass[data[pos]]];
+
+        s32 index = m.Longest[s];
+        if (index != -1) {
+            s64 begin = pos + 1 - m.Patterns[index].Count;
+            if (!best || begin <= best.Begin) best = {index, begin, pos + 1};
+        }
+        if (best && pos + 1 >= best.Begin + m.MaxLength) break;
+    }
+    return best;
+}
+
+bool multi_pattern_compile(multi_pattern &m, const array<string> &patterns, allocator alloc) {
+    free(m);
+
+    if (!patterns.Count) return false;
+    For(patterns) {
+        if (!it.Count) return false;
+    }
+
+    PUSH_ALLOC(alloc ? alloc : Context.Alloc) {
+        m.MinLength = numeric_info<s64>::max();
+        For(patterns) {
+            string copy;
+            clone(&copy, it);
+            array_append(m.Patterns, copy);
+
+            m.MinLength = min(m.MinLength, it.Count);
+            m.MaxLength = max(m.MaxLength, it.Count);
+        }
+
+        build_automaton(m);
+        if (patterns.Count <= MULTI_PATTERN_TEDDY_MAX) build_teddy(m);
+    }
+    return true;
+}
+
+void free(multi_pattern &m) {
+    For(m.Patterns) free(it);
+    free(m.Patterns);
+    free(m.Next);
+    free(m.Longest);
+    free(m.TeddyPatterns);
+    m = {};
+}
+
+multi_pattern_match multi_pattern_find(const multi_pattern &m, const bytes &data, s64 start) {
+    if (!m.Patterns.Count || start < 0 || start >= data.Count) return {};
+
+    if (m.Teddy) {
+#if ARCH == X86
+        using teddy_func = multi_pattern_match (*)(const multi_pattern &m, const byte *data, s64 size, s64 from);
+
+        local_persist cpu_dispatch<teddy_func> kernel;
+        auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> teddy_func {
+            if (cpu.AVX2) return teddy_find_avx2;
+            if (cpu.SSSE3) return teddy_find_ssse3;
+            return null;
+        });
+        if (func) return func(m, data.Data, data.Count, start);
+#endif
+    }
+    return automaton_find(m, data.Data, data.Count, start);
+}
+
+multi_pattern_match multi_pattern_find(const multi_pattern &m, const string &text, s64 start) {
+    return multi_pattern_find(m, bytes((byte *) text.Data, text.Count), start);
+}
+
+s64 multi_pattern_for_each(const multi_pattern &m, const string &text, const delegate<bool(const multi_pattern_match &)> &f) {
+    s64 found = 0, start = 0;
+    while (true) {
+        multi_pattern_match match = multi_pattern_find(m, text, start);
+        if (!match) break;
+
+        ++found;
+        if (!f(match)) break;
+
+        start = match.End;  // Patterns aren't empty, so we always move forward
+    }
+    return found;
+}
+
+s64 multi_pattern_find_all(const multi_pattern &m, const string &text, array<multi_pattern_match> out) {
+    s64 found = 0, start = 0;
+    while (found < out.Count) {
+        multi_pattern_match match = multi_pattern_find(m, text, start);
+        if (!match) break;
+
+        out[found++] = match;
+        start        = match.End;
+    }
+    return found;
+}
+
+LSTD_END_NAMESPACE
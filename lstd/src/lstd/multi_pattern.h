@@ -0,0 +1,80 @@
+#pragma once
+
+#include "memory/array.h"
+#include "memory/delegate.h"
+#include "memory/string.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Looking for many literal strings at once. Calling find_substring for every needle reads the text once per needle,
+// this reads it once for all of them:
+//
+//     multi_pattern keywords;
+//     multi_pattern_compile(keywords, words);  // array<string>, the patterns are copied
+//     defer(free(keywords));
+//
+//     multi_pattern_match m = multi_pattern_find(keywords, text);  // m.Pattern is the index in _words_, -1 if none
+//
+//     multi_pattern_for_each(keywords, text, &on_match);  // bool on_match(const multi_pattern_match &m), false stops
+//
+// A search returns the leftmost match, the longest one if several patterns match there. Going over all of them
+// continues after the end of each one (like regex_find_all), so matches don't overlap.
+//
+// Patterns are compiled to an Aho-Corasick automaton with the failure links folded in - a complete DFA, one table
+// lookup per byte whatever the number of patterns. Bytes which aren't in any pattern share a class, so a state is
+// (distinct bytes + 1) entries.
+//
+// For up to MULTI_PATTERN_TEDDY_MAX patterns on x86 we search with Teddy (the SIMD algorithm from Hyperscan) instead:
+// the patterns are split into 8 buckets and the low and high nibbles of their first 1 to 3 bytes are looked up with
+// pshufb, 16 (or 32 with AVX2) positions at a time. A position where some bucket has all of its bytes is checked
+// against the patterns of that bucket. It skips over text without candidates much faster than the automaton walks it.
+//
+// The compiled matcher is never written to when searching, so threads can share one.
+//
+
+constexpr s64 MULTI_PATTERN_TEDDY_MAX     = 32;
+constexpr s64 MULTI_PATTERN_TEDDY_BUCKETS = 8;
+
+struct multi_pattern_match {
+    s64 Pattern = -1;          // Index of the pattern
+    s64 Begin = -1, End = -1;  // Byte offsets, the match is [Begin, End)
+
+    operator bool() const { return Pattern != -1; }
+};
+
+struct multi_pattern {
+    array<string> Patterns;  // Copies
+    s64 MinLength = 0, MaxLength = 0;
+
+    // The automaton. State 0 is the start, every entry of _Next_ is a state (there are no missing transitions).
+    u16 ByteClass[256];
+    s32 ClassCount = 0;
+    array<s32> Next;     // _ClassCount_ entries for each state
+    array<s32> Longest;  // The longest pattern which ends at each state, -1 if none does
+
+    // Teddy, see multi_pattern.cpp
+    bool Teddy    = false;
+    s32 TeddySize = 0;  // How many bytes of each pattern are looked up, 1 to 3
+    u8 TeddyLow[3][16], TeddyHigh[3][16];
+    s32 TeddyBucketBegin[MULTI_PATTERN_TEDDY_BUCKETS + 1];
+    array<s32> TeddyPatterns;  // Indices of the patterns by bucket
+};
+
+// Returns false if there are no patterns or one of them is empty (it would match everywhere).
+// Frees the old contents of _m_.
+bool multi_pattern_compile(multi_pattern &m, const array<string> &patterns, allocator alloc = {});
+
+void free(multi_pattern &m);
+
+// The leftmost match at or after _start_ (longest if several begin there)
+multi_pattern_match multi_pattern_find(const multi_pattern &m, const bytes &data, s64 start = 0);
+multi_pattern_match multi_pattern_find(const multi_pattern &m, const string &text, s64 start = 0);
+
+// Writes up to _out.Count_ matches, returns how many
+s64 multi_pattern_find_all(const multi_pattern &m, const string &text, array<multi_pattern_match> out);
+
+// Calls _f_ for every match until it returns false. Returns the number of matches it was called with.
+s64 multi_pattern_for_each(const multi_pattern &m, const string &text, const delegate<bool(const multi_pattern_match &)> &f);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,484 @@
+module;
+
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+
+#if OS == WINDOWS
+#include "lstd/types/windows.h"  // Declarations of Win32 functions
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if OS == LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+//
+// A channel between processes: a ring of fixed size message slots in a named shared memory mapping.
+//
+// os_write_shared_block/os_read_shared_block map and copy a whole block on every call. Here the mapping stays open,
+// sending copies the message into a free slot and receiving copies it out, nothing goes through the kernel unless
+// someone has to sleep because the ring is empty (or full).
+//
+//     // Process A
+//     auto ch = os_channel_create("sidecar", 1024, 4_KiB);
+//     defer(free(ch));
+//     os_channel_send(ch, message.Data, message.Count);
+//
+//     // Process B
+//     auto ch = os_channel_open("sidecar");
+//     defer(free(ch));
+//
+//     byte buffer[4_KiB];  // At least os_channel_message_size(ch)
+//     s64 size = os_channel_receive(ch, buffer);
+//
+// Any number of processes (and threads) can send and receive, the ring is the bounded MPMC queue by Dmitry Vyukov:
+// every slot has a sequence number which says if it's free or full for the current lap, so producers and consumers
+// only contend on their own position counter.
+//
+// Sleeping is a futex on a word in the mapping on Linux (futexes work across processes if they aren't private),
+// and a pair of named events on Windows.
+//
+
+export module os.channel;
+
+import fmt;
+
+#if OS == WINDOWS
+import os.win64.common;
+import os.win64.memory;
+#else
+import os.posix.common;
+import os.posix.memory;
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// Lives at the start of the mapping, followed by the slots
+struct os_channel_header {
+    static constexpr u32 MAGIC = 0x4348414e;  // "CHAN"
+
+    u32 Magic;
+    s32 Ready;  // Set by the creator when the slots are set up, openers wait for this
+
+    s64 SlotCount;   // A power of 2
+    s64 SlotStride;  // Slot header + MessageSize, rounded up to a cache line
+    s64 MessageSize;
+
+    // In different cache lines so senders and receivers don't fight over one
+    alignas(64) s64 EnqueuePos;
+    alignas(64) s64 DequeuePos;
+
+    // Incremented after every send/receive, sleepers wait for these to change. _*Waiters_ lets us skip the wake up
+    // syscall when nobody sleeps.
+    alignas(64) s32 SentSequence;
+    s32 ReceiverWaiters;
+
+    alignas(64) s32 ReceivedSequence;
+    s32 SenderWaiters;
+};
+
+struct os_channel_slot {
+    s64 Sequence;
+    s64 Size;
+    // The message follows
+};
+
+export {
+    // Pass as _timeoutMs_ to wait until it's possible
+    constexpr u32 OS_CHANNEL_WAIT_FOREVER = 0xffffffff;
+
+    struct os_channel {
+        os_channel_header *Header = null;  // null if creating/opening failed
+        s64 MappedSize            = 0;
+
+        bool Creator = false;  // The creator removes the name when it frees the channel (on POSIX)
+        string Name;
+
+#if OS == WINDOWS
+        void *Mapping = null;
+        void *SentEvent = null, *ReceivedEvent = null;
+#endif
+    };
+
+    // Creates a channel which holds up to _slotCount_ (rounded up to a power of 2) messages of at most _messageSize_
+    // bytes. Fails if a channel with that name already exists. On POSIX _name_ shouldn't contain slashes.
+    [[nodiscard("Leak")]] os_channel os_channel_create(const string &name, s64 slotCount = 1024, s64 messageSize = 4_KiB);
+
+    // Opens a channel another process created
+    [[nodiscard("Leak")]] os_channel os_channel_open(const string &name);
+
+    void free(os_channel &ch);
+
+    // The biggest message which fits in a slot
+    s64 os_channel_message_size(const os_channel &ch);
+
+    // Copies the message to a free slot, waits up to _timeoutMs_ if the ring is full.
+    // Returns false if it timed out (with 0 this never waits).
+    bool os_channel_send(os_channel &ch, const void *data, s64 size, u32 timeoutMs = OS_CHANNEL_WAIT_FOREVER);
+
+    // Copies the oldest message to _out_ (which must fit os_channel_message_size() bytes), waits up to _timeoutMs_
+    // if the ring is empty. Returns the size of the message or -1 if it timed out.
+    s64 os_channel_receive(os_channel &ch, void *out, u32 timeoutMs = OS_CHANNEL_WAIT_FOREVER);
+}
+
+always_inline os_channel_slot *os_channel_get_slot(os_channel &ch, s64 pos) {
+    auto *slots = (byte *) ch.Header + sizeof(os_channel_header);
+    return (os_channel_slot *) (slots + (pos & (ch.Header->SlotCount - 1)) * ch.Header->SlotStride);
+}
+
+//
+// Sleeping and waking up
+//
+#if OS == WINDOWS
+// _sequence_ is the value the caller saw before deciding to sleep. The events are auto reset, so a SetEvent between
+// that and the wait isn't lost; it just makes the wait return right away.
+bool os_channel_wait(os_channel &ch, s32 *sequence, s32 seen, bool sender, u32 timeoutMs) {
+    if (atomic_load(sequence) != seen) return true;
+    return WaitForSingleObject(sender ? ch.ReceivedEvent : ch.SentEvent, timeoutMs) == WAIT_OBJECT_0;
+}
+
+void os_channel_wake(os_channel &ch, bool senders) { SetEvent(senders ? ch.ReceivedEvent : ch.SentEvent); }
+#elif OS == LINUX
+bool os_channel_wait(os_channel &ch, s32 *sequence, s32 seen, bool sender, u32 timeoutMs) {
+    timespec ts = {(time_t) (timeoutMs / 1000), (long) (timeoutMs % 1000) * 1000000};
+
+    // Not FUTEX_WAIT_PRIVATE, the other side is in another process
+    long r = syscall(SYS_futex, sequence, FUTEX_WAIT, seen, timeoutMs == OS_CHANNEL_WAIT_FOREVER ? null : &ts, null, 0);
+    return r == 0 || errno != ETIMEDOUT;
+}
+
+void os_channel_wake(os_channel &ch, bool senders) {
+    s32 *sequence = senders ? &ch.Header->ReceivedSequence : &ch.Header->SentSequence;
+    syscall(SYS_futex, sequence, FUTEX_WAKE, 1, null, null, 0);
+}
+#else
+// @Platform No cross process futex, poll every millisecond
+bool os_channel_wait(os_channel &ch, s32 *sequence, s32 seen, bool sender, u32 timeoutMs) {
+    if (atomic_load(sequence) != seen) return true;
+    if (!timeoutMs) return false;
+
+    timespec ts = {0, 1000000};
+    nanosleep(&ts, null);
+    return true;
+}
+
+void os_channel_wake(os_channel &ch, bool senders) {}
+#endif
+
+void os_channel_set_up(os_channel &ch, void *view, s64 slotCount, s64 stride, s64 messageSize) {
+    auto *h        = (os_channel_header *) view;
+    h->Magic       = os_channel_header::MAGIC;
+    h->SlotCount   = slotCount;
+    h->SlotStride  = stride;
+    h->MessageSize = messageSize;
+
+    ch.Header = h;
+    For(range(slotCount)) os_channel_get_slot(ch, it)->Sequence = it;
+
+    atomic_store(&h->Ready, 1);
+}
+
+#if OS == WINDOWS
+// Event names are derived from the channel name so every process opens the same ones
+bool os_channel_open_events(os_channel &ch) {
+    ch.SentEvent = CreateEventW(null, false, false, internal::platform_utf16_temp(tsprint("{}_sent", ch.Name)));
+    if (!ch.SentEvent) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateEventW");
+        return false;
+    }
+
+    ch.ReceivedEvent = CreateEventW(null, false, false, internal::platform_utf16_temp(tsprint("{}_received", ch.Name)));
+    if (!ch.ReceivedEvent) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateEventW");
+        return false;
+    }
+    return true;
+}
+#endif
+
+os_channel os_channel_create(const string &name, s64 slotCount, s64 messageSize) {
+    assert(slotCount > 0 && messageSize > 0);
+
+    slotCount  = ceil_pow_of_2(slotCount);
+    s64 stride = (sizeof(os_channel_slot) + messageSize + 63) & ~63;
+    s64 size   = sizeof(os_channel_header) + slotCount * stride;
+
+    os_channel ch;
+    ch.Creator = true;
+    clone(&ch.Name, name);
+
+#if OS == WINDOWS
+    ch.Mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, null, PAGE_READWRITE, (DWORD) (size >> 32), (DWORD) size, internal::platform_utf16_temp(name));
+    if (!ch.Mapping) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateFileMappingW");
+        return ch;
+    }
+
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        internal::platform_report_error(tsprint("A channel named \"{}\" already exists", name));
+        free(ch);
+        return ch;
+    }
+
+    void *view = MapViewOfFile(ch.Mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+    if (!view) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "MapViewOfFile");
+        free(ch);
+        return ch;
+    }
+
+    ch.MappedSize = size;
+    os_channel_set_up(ch, view, slotCount, stride, messageSize);  // The mapping starts zeroed
+
+    if (!os_channel_open_events(ch)) free(ch);
+#else
+    const char *shmName = string_to_c_string_temp(tsprint("/{}", name));
+
+    int fd = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        internal::posix_report_errno("shm_open");
+        return ch;
+    }
+    defer(close(fd));
+
+    if (ftruncate(fd, size) == -1) {
+        internal::posix_report_errno("ftruncate");
+        shm_unlink(shmName);
+        return ch;
+    }
+
+    void *view = mmap(null, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        internal::posix_report_errno("mmap");
+        shm_unlink(shmName);
+        return ch;
+    }
+
+    ch.MappedSize = size;
+    os_channel_set_up(ch, view, slotCount, stride, messageSize);  // ftruncate fills with zeroes
+#endif
+    return ch;
+}
+
+os_channel os_channel_open(const string &name) {
+    os_channel ch;
+    clone(&ch.Name, name);
+
+#if OS == WINDOWS
+    ch.Mapping = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, false, internal::platform_utf16_temp(name));
+    if (!ch.Mapping) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "OpenFileMappingW");
+        return ch;
+    }
+
+    // 0 maps the whole thing
+    void *view = MapViewOfFile(ch.Mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if (!view) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "MapViewOfFile");
+        free(ch);
+        return ch;
+    }
+#else
+    int fd = shm_open(string_to_c_string_temp(tsprint("/{}", name)), O_RDWR, 0);
+    if (fd == -1) {
+        internal::posix_report_errno("shm_open");
+        return ch;
+    }
+    defer(close(fd));
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        internal::posix_report_errno("fstat");
+        return ch;
+    }
+
+    void *view = mmap(null, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        internal::posix_report_errno("mmap");
+        return ch;
+    }
+    ch.MappedSize = info.st_size;
+#endif
+
+    auto *h = (os_channel_header *) view;
+
+#if OS == WINDOWS
+    bool valid = h->Magic == os_channel_header::MAGIC;  // Views are at least a page, the header fits
+#else
+    bool valid = ch.MappedSize >= (s64) sizeof(os_channel_header) && h->Magic == os_channel_header::MAGIC;
+#endif
+    if (!valid) {
+        internal::platform_report_error(tsprint("\"{}\" is not a channel", name));
+        ch.Header = h;  // So free() unmaps it
+        free(ch);
+        return ch;
+    }
+
+    // The creator may still be setting up the slots
+    while (!atomic_load(&h->Ready)) thread::sleep(0);
+    ch.Header     = h;
+    ch.MappedSize = sizeof(os_channel_header) + h->SlotCount * h->SlotStride;
+
+#if OS == WINDOWS
+    if (!os_channel_open_events(ch)) free(ch);
+#endif
+    return ch;
+}
+
+void free(os_channel &ch) {
+#if OS == WINDOWS
+    if (ch.Header) UnmapViewOfFile(ch.Header);
+    if (ch.Mapping) CloseHandle(ch.Mapping);
+    if (ch.SentEvent) CloseHandle(ch.SentEvent);
+    if (ch.ReceivedEvent) CloseHandle(ch.ReceivedEvent);
+    ch.Mapping = ch.SentEvent = ch.ReceivedEvent = null;
+#else
+    if (ch.Header) munmap(ch.Header, ch.MappedSize);
+
+    // Processes which have it open keep their mapping, new ones can't find it anymore
+    if (ch.Creator && ch.Name) shm_unlink(string_to_c_string_temp(tsprint("/{}", ch.Name)));
+#endif
+
+    ch.Header     = null;
+    ch.MappedSize = 0;
+    free(ch.Name);
+}
+
+s64 os_channel_message_size(const os_channel &ch) {
+    assert(ch.Header);
+    return ch.Header->MessageSize;
+}
+
+// Returns false if the ring is full
+bool os_channel_try_send(os_channel &ch, const void *data, s64 size) {
+    auto *h = ch.Header;
+
+    s64 pos = atomic_load(&h->EnqueuePos);
+    os_channel_slot *slot;
+    while (true) {
+        slot     = os_channel_get_slot(ch, pos);
+        s64 diff = atomic_load(&slot->Sequence) - pos;
+        if (diff == 0) {
+            // The slot is free in this lap, claim the position
+            s64 old = atomic_compare_and_swap(&h->EnqueuePos, pos + 1, pos);
+            if (old == pos) break;
+            pos = old;
+        } else if (diff < 0) {
+            return false;  // A receiver hasn't emptied it since the last lap
+        } else {
+            pos = atomic_load(&h->EnqueuePos);  // Someone else claimed it
+        }
+    }
+
+    slot->Size = size;
+    copy_memory(slot + 1, data, size);
+    atomic_store(&slot->Sequence, pos + 1);  // Publishes the message
+    return true;
+}
+
+// Returns -1 if the ring is empty
+s64 os_channel_try_receive(os_channel &ch, void *out) {
+    auto *h = ch.Header;
+
+    s64 pos = atomic_load(&h->DequeuePos);
+    os_channel_slot *slot;
+    while (true) {
+        slot     = os_channel_get_slot(ch, pos);
+        s64 diff = atomic_load(&slot->Sequence) - (pos + 1);
+        if (diff == 0) {
+            s64 old = atomic_compare_and_swap(&h->DequeuePos, pos + 1, pos);
+            if (old == pos) break;
+            pos = old;
+        } else if (diff < 0) {
+            return -1;  // Not sent yet
+        } else {
+            pos = atomic_load(&h->DequeuePos);
+        }
+    }
+
+    s64 size = slot->Size;
+    copy_memory(out, slot + 1, size);
+    atomic_store(&slot->Sequence, pos + h->SlotCount);  // Free for the next lap
+    return size;
+}
+
+// Wakes the other side
+void os_channel_after_transfer(os_channel &ch, bool sent) {
+    auto *h = ch.Header;
+
+    atomic_inc(sent ? &h->SentSequence : &h->ReceivedSequence);
+    if (atomic_load(sent ? &h->ReceiverWaiters : &h->SenderWaiters)) os_channel_wake(ch, !sent);
+}
+
+bool os_channel_send(os_channel &ch, const void *data, s64 size, u32 timeoutMs) {
+    assert(ch.Header && "Channel wasn't created/opened");
+    assert(size >= 0 && size <= ch.Header->MessageSize && "Message doesn't fit in a slot");
+
+    auto *h = ch.Header;
+
+    time_t start = os_get_time();
+    while (true) {
+        s32 seen = atomic_load(&h->ReceivedSequence);
+        if (os_channel_try_send(ch, data, size)) break;
+
+        u32 left = timeoutMs;
+        if (timeoutMs != OS_CHANNEL_WAIT_FOREVER) {
+            f64 elapsed = os_time_to_seconds(os_get_time() - start) * 1000;
+            if (elapsed >= timeoutMs) return false;
+            left = timeoutMs - (u32) elapsed;
+        }
+
+        atomic_inc(&h->SenderWaiters);
+        os_channel_wait(ch, &h->ReceivedSequence, seen, true, left);
+        atomic_add(&h->SenderWaiters, -1);
+    }
+
+    os_channel_after_transfer(ch, true);
+
+#if OS == WINDOWS
+    // Coalesced wake ups (an event set twice is set once) could leave another sender asleep while there is room
+    if (atomic_load(&h->SenderWaiters)) os_channel_wake(ch, true);
+#endif
+    return true;
+}
+
+s64 os_channel_receive(os_channel &ch, void *out, u32 timeoutMs) {
+    assert(ch.Header && "Channel wasn't created/opened");
+
+    auto *h = ch.Header;
+
+    s64 size;
+
+    time_t start = os_get_time();
+    while (true) {
+        s32 seen = atomic_load(&h->SentSequence);
+        if ((size = os_channel_try_receive(ch, out)) != -1) break;
+
+        u32 left = timeoutMs;
+        if (timeoutMs != OS_CHANNEL_WAIT_FOREVER) {
+            f64 elapsed = os_time_to_seconds(os_get_time() - start) * 1000;
+            if (elapsed >= timeoutMs) return -1;
+            left = timeoutMs - (u32) elapsed;
+        }
+
+        atomic_inc(&h->ReceiverWaiters);
+        os_channel_wait(ch, &h->SentSequence, seen, false, left);
+        atomic_add(&h->ReceiverWaiters, -1);
+    }
+
+    os_channel_after_transfer(ch, false);
+
+#if OS == WINDOWS
+    // See os_channel_send
+    if (atomic_load(&h->ReceiverWaiters)) os_channel_wake(ch, false);
+#endif
+    return size;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,232 @@
+module;
+
+#include "lstd/date_time.h"
+#include "lstd/thread.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // _mm_lfence
+#if COMPILER == MSVC
+#include <intrin.h>  // __rdtsc, __rdtscp
+#else
+#include <x86intrin.h>  // __rdtsc, __rdtscp
+#endif
+#endif
+
+//
+// Cheap time stamps, for code which takes them millions of times per second (tracing, profiling).
+//
+// os_get_time() is a QueryPerformanceCounter/clock_gettime call. When the CPU has an invariant time stamp counter
+// (constant rate, synced between cores - every x86 CPU of the last decade) we read it directly instead, which is
+// an instruction, and convert to nanoseconds with a multiply and a shift.
+//
+// The frequency of the counter comes from cpuid when the CPU reports it, otherwise we measure it against
+// os_get_time() the first time it's needed (about 10 ms, call os_clock_calibrate() at startup to pick when).
+// Without an invariant counter everything falls back to os_get_time().
+//
+// For code which only needs millisecond precision there is a coarse clock: a background thread stores the time
+// every tick, reading it is a load.
+//
+//     os_coarse_clock_start();
+//     s64 then = os_get_coarse_timestamp_ns();
+//
+// These clocks are monotonic and start at an arbitrary point. For the calendar date and time use
+// os_get_wall_time_ns() (nanoseconds since the Unix epoch) with the functions in date_time.h:
+//
+//     date_time now = os_get_local_date_time();
+//
+
+export module os.clock;
+
+#if OS == WINDOWS
+import os.win64.common;
+#else
+import os.posix.common;
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+struct os_clock_state {
+    s32 Calibrated;  // 0 - not yet, 1 - in progress, 2 - done
+    bool UseCycleCounter;
+
+    u64 Frequency;              // Of the cycle counter
+    u64 NanosecondsPerCycle32;  // 32.32 fixed point
+
+    u64 BaseCycles;
+    s64 BaseNanoseconds;  // os_time_to_nanoseconds(os_get_time()) when we read _BaseCycles_
+
+    // The coarse clock
+    s64 CoarseNanoseconds;
+    s32 CoarseRunning, CoarseStop;
+    u32 CoarsePeriodMs;
+    thread::thread CoarseThread;
+};
+
+os_clock_state ClockState;
+
+export {
+    // The raw time stamp counter. Not ordered with the instructions around it, use os_read_cycle_counter_ordered
+    // to measure a short piece of code. Falls back to os_get_time() on other architectures.
+    always_inline u64 os_read_cycle_counter() {
+#if ARCH == X86
+        return __rdtsc();
+#else
+        return (u64) os_get_time();
+#endif
+    }
+
+    // Waits for the instructions before it to finish before reading the counter
+    always_inline u64 os_read_cycle_counter_ordered() {
+#if ARCH == X86
+        _mm_lfence();
+        return __rdtsc();
+#else
+        return (u64) os_get_time();
+#endif
+    }
+
+    // Also returns the processor the counter was read on (IA32_TSC_AUX, the core index on Windows and Linux).
+    // Only call this if get_cpu_features().RDTSCP.
+    always_inline u64 os_read_cycle_counter_and_processor(u32 *processor) {
+#if ARCH == X86
+        return __rdtscp(processor);
+#else
+        *processor = 0;
+        return (u64) os_get_time();
+#endif
+    }
+
+    // Finds the frequency of the cycle counter, measuring for _ms_ if cpuid doesn't tell us.
+    // Called by the functions below the first time they need it, it's fine to call it again to recalibrate.
+    void os_clock_calibrate(u32 ms = 10);
+
+    // False if the CPU has no invariant time stamp counter, then the timestamp functions use os_get_time()
+    bool os_clock_uses_cycle_counter();
+
+    // In Hz, 0 if os_clock_uses_cycle_counter() is false
+    u64 os_get_cycle_counter_frequency();
+
+    // Converts a number of cycles (a difference of two counter reads) to nanoseconds
+    always_inline s64 os_cycles_to_nanoseconds(u64 cycles) {
+        if (atomic_load(&ClockState.Calibrated) != 2) os_clock_calibrate();
+
+        // (cycles * mul) >> 32 without overflowing for any difference we would measure
+        u64 mul = ClockState.NanosecondsPerCycle32;
+        u64 hi = cycles >> 32, lo = cycles & 0xffffffff;
+        return (s64) (hi * mul + lo * (mul >> 32) + ((lo * (mul & 0xffffffff)) >> 32));
+    }
+
+    // Monotonic nanoseconds since an arbitrary point (the same for all threads). An rdtsc when possible.
+    always_inline s64 os_get_timestamp_ns() {
+        if (atomic_load(&ClockState.Calibrated) != 2) os_clock_calibrate();
+
+        if (ClockState.UseCycleCounter) {
+            return ClockState.BaseNanoseconds + os_cycles_to_nanoseconds(os_read_cycle_counter() - ClockState.BaseCycles);
+        }
+        return os_time_to_nanoseconds(os_get_time());
+    }
+
+    // Starts the background thread which updates the coarse clock every _periodMs_.
+    // How often it really wakes up depends on the timer resolution of the OS (1 ms on Linux, 15.6 ms on Windows
+    // unless someone called timeBeginPeriod).
+    void os_coarse_clock_start(u32 periodMs = 1);
+
+    void os_coarse_clock_stop();
+
+    // The time at the last tick, in the same units as os_get_timestamp_ns(). Precise if the clock isn't running.
+    always_inline s64 os_get_coarse_timestamp_ns() {
+        if (!atomic_load(&ClockState.CoarseRunning)) return os_get_timestamp_ns();
+        return atomic_load(&ClockState.CoarseNanoseconds);
+    }
+
+    // The wall clock broken into the calendar, in UTC or in the local time zone of the machine
+    inline date_time os_get_utc_date_time() { return date_time_from_unix_ns(os_get_wall_time_ns()); }
+
+    inline date_time os_get_local_date_time() {
+        s64 now = os_get_wall_time_ns();
+        return date_time_from_unix_ns(now, os_get_utc_offset(now / NANOSECONDS_PER_SECOND));
+    }
+}
+
+void os_clock_calibrate(u32 ms) {
+    auto &s = ClockState;
+
+    // Someone else is calibrating, wait for them
+    if (atomic_compare_and_swap(&s.Calibrated, 1, 0) == 1) {
+        while (atomic_load(&s.Calibrated) == 1) thread::sleep(0);
+        return;
+    }
+    atomic_store(&s.Calibrated, 1);
+
+    u64 frequency = 0;
+    if (get_cpu_features().INVARIANT_TSC) {
+        frequency = get_cpu_tsc_frequency();
+        if (!frequency) {
+            // Measure against the OS clock. We spin instead of sleeping so a late wake up doesn't matter,
+            // both clocks are read back to back at both ends.
+            time_t t0 = os_get_time();
+            u64 c0    = os_read_cycle_counter_ordered();
+
+            s64 elapsed;
+            u64 c1;
+            do {
+                c1      = os_read_cycle_counter_ordered();
+                elapsed = os_time_to_nanoseconds(os_get_time() - t0);
+            } while (elapsed < (s64) ms * 1000000);
+
+            frequency = (c1 - c0) * 1000000000ull / (u64) elapsed;  // Fine for counters under 18 GHz and ms under 1000
+        }
+    }
+
+    s.UseCycleCounter = frequency != 0;
+    s.Frequency       = frequency;
+    if (frequency) {
+        s.NanosecondsPerCycle32 = (1000000000ull << 32) / frequency;
+
+        s.BaseNanoseconds = os_time_to_nanoseconds(os_get_time());
+        s.BaseCycles      = os_read_cycle_counter();
+    }
+
+    atomic_store(&s.Calibrated, 2);
+}
+
+bool os_clock_uses_cycle_counter() {
+    if (atomic_load(&ClockState.Calibrated) != 2) os_clock_calibrate();
+    return ClockState.UseCycleCounter;
+}
+
+u64 os_get_cycle_counter_frequency() {
+    if (atomic_load(&ClockState.Calibrated) != 2) os_clock_calibrate();
+    return ClockState.Frequency;
+}
+
+void os_coarse_clock_tick(void *) {
+    auto &s = ClockState;
+    while (!atomic_load(&s.CoarseStop)) {
+        atomic_store(&s.CoarseNanoseconds, os_get_timestamp_ns());
+        thread::sleep(s.CoarsePeriodMs);
+    }
+}
+
+void os_coarse_clock_start(u32 periodMs) {
+    auto &s = ClockState;
+    if (atomic_load(&s.CoarseRunning)) return;
+
+    s.CoarsePeriodMs = periodMs;
+    atomic_store(&s.CoarseStop, 0);
+    atomic_store(&s.CoarseNanoseconds, os_get_timestamp_ns());  // So the first read isn't 0
+
+    s.CoarseThread.init_and_launch(os_coarse_clock_tick, null);
+    atomic_store(&s.CoarseRunning, 1);
+}
+
+void os_coarse_clock_stop() {
+    auto &s = ClockState;
+    if (!atomic_load(&s.CoarseRunning)) return;
+
+    atomic_store(&s.CoarseRunning, 0);
+    atomic_store(&s.CoarseStop, 1);
+    s.CoarseThread.wait();
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,241 @@
+module;
+
+#include "lstd/memory/hash_table.h"
+#include "lstd/memory/signal.h"
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+
+//
+// Reloading a dynamic library while the program runs, e.g. gameplay code or a plugin which is being worked on.
+//
+// The library is never loaded from where the build writes it. We copy it next to it as "<name>.hot<version><ext>"
+// and load the copy, so the linker can overwrite the original (Windows doesn't let you write to a loaded DLL,
+// and dlopen would just return the library it loaded already).
+//
+// Functions are bound by name once. A binding is a slot which holds the current address, calling through it is a load
+// and an indirect call. When the library changes we load the new copy, look up every bound name in it and store
+// the new addresses, then unload the old copy.
+//
+//     hot_library game;
+//     if (!hot_library_load(game, "bin/game.dll")) ...
+//     defer(free(game));
+//
+//     auto update = hot_library_bind<void(f32)>(game, "game_update");
+//
+//     while (running) {
+//         hot_library_poll(game);  // Between frames, no code from the library is running here
+//         update.get()(dt);
+//     }
+//
+// On Windows changes come from a path_watcher on the directory of the library, on POSIX we compare the
+// modification time on every poll (one stat call).
+//
+// The old copy is unloaded right after the swap, so poll where nothing from the library is running and nothing
+// holds an address read before the swap (a pointer to a function or to static data of the library).
+// Other threads may read the slots while we swap, they get the old or the new address (not half of one),
+// but they must not be in the old code once we unload it.
+//
+// Only addresses move. State the library keeps in globals starts over with every version, connect to _Reloaded_
+// to hand it over (or keep the state in memory the program owns and pass it in).
+//
+
+export module os.hot_library;
+
+import fmt;
+import path;
+import path.general;  // path_change
+
+#if OS == WINDOWS
+import os.win64.dynamic_library;
+#else
+import os.posix.dynamic_library;
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    struct hot_library {
+        string Path;        // Where the build writes the library
+        string LoadedPath;  // The copy we loaded
+
+        dynamic_library Library = null;
+        s64 Version             = 0;  // Incremented on every reload
+
+        hash_table<string, void **> Slots;  // Bound name -> its slot, the slots don't move
+
+#if OS == WINDOWS
+        path_watcher Watcher;
+#else
+        time_t LastModification = 0;
+#endif
+
+        bool Dirty = false;  // We couldn't copy the library (the build is still writing it), try again on the next poll
+
+        // Emitted by hot_library_poll after a reload, on the thread which polls
+        signal<void(hot_library &)> Reloaded;
+    };
+
+    // Calls through the current address of a bound function
+    template <typename F>
+    struct hot_symbol {
+        void **Slot = null;
+
+        F *get() const { return (F *) atomic_load(Slot); }
+    };
+
+    // Returns false if the library couldn't be copied or loaded.
+    bool hot_library_load(hot_library & h, const string &path);
+
+    // Unloads the library and deletes the copy. Doesn't touch the original.
+    void free(hot_library & h);
+
+    // Returns the slot which holds the address of _name_ (null in the slot if the library doesn't export it).
+    // It stays valid until the library is freed. Binding a name twice gives the same slot.
+    void **hot_library_bind_slot(hot_library & h, const string &name);
+
+    template <typename F>
+    hot_symbol<F> hot_library_bind(hot_library & h, const string &name) {
+        return {hot_library_bind_slot(h, name)};
+    }
+
+    // Reloads the library if it changed since the last poll. Returns true if it did.
+    bool hot_library_poll(hot_library & h);
+
+    // Loads the current version of the library and swaps the bound addresses to it. Returns false (and keeps the old
+    // version) if it couldn't be copied or loaded, or if it doesn't export every bound name - that's usually a build
+    // which isn't finished, the next change retries.
+    bool hot_library_reload(hot_library & h);
+}
+
+file_scope string hot_library_copy_path(hot_library &h, s64 version) {
+    auto [root, extension] = path_split_extension(h.Path);
+    return sprint("{}.hot{}{}", root, version, extension);
+}
+
+// The old copy (if there is one) is unloaded, the new one is loaded with the bound addresses looked up already.
+file_scope bool hot_library_swap(hot_library &h) {
+    string copy = hot_library_copy_path(h, h.Version + 1);
+    if (!path_copy(h.Path, copy, true)) {
+        free(copy);
+        h.Dirty = true;
+        return false;
+    }
+    h.Dirty = false;
+
+    dynamic_library library = os_dynamic_library_load(copy);
+
+    bool complete = library;
+    if (library) {
+        for (auto [name, slot] : h.Slots) {
+            if (!os_dynamic_library_get_symbol(library, *name)) complete = false;
+        }
+    }
+
+    if (!complete) {
+        free(library);
+        path_delete_file(copy);
+        free(copy);
+        return false;
+    }
+
+    // Looked up in the cache this time
+    for (auto [name, slot] : h.Slots) atomic_store(*slot, os_dynamic_library_get_symbol(library, *name));
+
+    if (h.Library) {
+        free(h.Library);
+        path_delete_file(h.LoadedPath);
+        free(h.LoadedPath);
+    }
+
+    h.Library    = library;
+    h.LoadedPath = copy;
+    ++h.Version;
+    return true;
+}
+
+bool hot_library_load(hot_library &h, const string &path) {
+    assert(!h.Library && "Already loaded, call free() first");
+
+    clone(&h.Path, path);
+
+#if OS == WINDOWS
+    string directory = path_directory(path);
+    path_watcher_start(h.Watcher, directory.Count ? directory : ".", false);
+#else
+    h.LastModification = path_last_modification_time(path);
+#endif
+
+    return hot_library_swap(h);
+}
+
+void free(hot_library &h) {
+    if (h.Library) {
+        free(h.Library);
+        path_delete_file(h.LoadedPath);
+    }
+
+    for (auto [name, slot] : h.Slots) {
+        free(*name);
+        free(*slot);
+    }
+    free(h.Slots);
+
+#if OS == WINDOWS
+    free(h.Watcher);
+#endif
+
+    free(h.Path);
+    free(h.LoadedPath);
+    h.Reloaded.release();
+
+    h.Library = null;
+    h.Version = 0;
+    h.Dirty   = false;
+}
+
+void **hot_library_bind_slot(hot_library &h, const string &name) {
+    auto [kp, vp] = find(h.Slots, name);
+    if (vp) return *vp;
+
+    auto *slot = allocate<void *>();
+    *slot      = h.Library ? os_dynamic_library_get_symbol(h.Library, name) : null;
+
+    string key;
+    clone(&key, name);
+    add(h.Slots, key, slot);
+
+    return slot;
+}
+
+bool hot_library_poll(hot_library &h) {
+    bool changed = h.Dirty;
+
+#if OS == WINDOWS
+    auto &events = path_watcher_poll(h.Watcher);
+    if (h.Watcher.Overflowed) changed = true;
+
+    // Not recursive, so the paths of the events are file names
+    string name = path_base_name(h.Path);
+    For(events) {
+        if (it.Kind != path_change::Removed && compare_ignore_case(it.Path, name) == -1) changed = true;
+    }
+#else
+    time_t modified = path_last_modification_time(h.Path);
+    if (modified != h.LastModification) {
+        h.LastModification = modified;
+        changed            = true;
+    }
+#endif
+
+    if (!changed) return false;
+    return hot_library_reload(h);
+}
+
+bool hot_library_reload(hot_library &h) {
+    if (!hot_library_swap(h)) return false;
+
+    h.Reloaded.emit(h);
+    return true;
+}
+
+LSTD_END_NAMESPACE
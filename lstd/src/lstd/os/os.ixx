@@ -16,7 +16,15 @@ export module os;
 export import os.win64.common;
 export import os.win64.memory;
 export import os.win64.dynamic_library;
+export import os.win64.async_io;
+export import os.win64.net;
 #else
-#error Implement.
+export import os.posix.common;
+export import os.posix.memory;
+export import os.posix.dynamic_library;
+export import os.posix.net;
 #endif
 
+export import os.channel;
+export import os.clock;
+export import os.hot_library;
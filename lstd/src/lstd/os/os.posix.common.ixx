@@ -0,0 +1,489 @@
+module;
+
+#include "lstd/io.h"
+#include "lstd/memory/array.h"
+#include "lstd/memory/delegate.h"
+#include "lstd/memory/string.h"
+#include "lstd/profiler.h"
+
+#if OS != WINDOWS
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+//
+// General platform functions, POSIX version. See os.win64.common for the docs of the exported functions.
+//
+
+export module os.posix.common;
+
+import os.posix.memory;
+
+import fmt;
+import path;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    void exit(s32 exitCode = 0);
+    void abort();
+
+    void exit_schedule(const delegate<void()> &function);
+    void exit_call_scheduled_functions();
+    array<delegate<void()>> *exit_get_scheduled_functions();
+
+    // CLOCK_MONOTONIC in nanoseconds. clock_gettime is answered from the vDSO - no syscall, about as cheap as QueryPerformanceCounter.
+    time_t os_get_time();
+    f64 os_time_to_seconds(time_t time);
+    s64 os_time_to_nanoseconds(time_t time);  // Time stamps are already nanoseconds here
+
+    // CLOCK_REALTIME in nanoseconds since the Unix epoch
+    s64 os_get_wall_time_ns();
+
+    // tm_gmtoff of localtime_r, which follows the daylight saving rules at _unixSeconds_
+    s32 os_get_utc_offset(s64 unixSeconds);
+
+    // Note: Don't free the result of this function.
+    string os_get_current_module();
+
+    // Note: Don't free the result of this function.
+    string os_get_working_dir();
+    void os_set_working_dir(const string &dir);
+
+    // Note: Don't free the result of this function.
+    array<string> os_get_command_line_arguments();
+
+    u32 os_get_pid();
+    s64 os_get_peak_memory_usage();
+
+    // Note: Don't free the result of this function.
+    bytes os_read_from_console();
+
+    struct os_get_env_result {
+        string Value;
+        bool Success;
+    };
+
+    [[nodiscard("Leak")]] os_get_env_result os_get_env(const string &name, bool silent = false);
+    void os_set_env(const string &name, const string &value);
+    void os_remove_env(const string &name);
+
+    // There is no clipboard without a display server, these report an error (and return an empty string).
+    [[nodiscard("Leak")]] string os_get_clipboard_content();
+    void os_set_clipboard_content(const string &content);
+}
+
+#if OS != WINDOWS
+
+struct posix_common_state {
+    static constexpr s64 CONSOLE_BUFFER_SIZE = 1_KiB;
+
+    byte CinBuffer[CONSOLE_BUFFER_SIZE];
+    byte CoutBuffer[CONSOLE_BUFFER_SIZE];
+    byte CerrBuffer[CONSOLE_BUFFER_SIZE];
+
+    thread::mutex CoutMutex, CinMutex;
+
+    array<delegate<void()>> ExitFunctions;
+    thread::mutex ExitScheduleMutex;
+
+    string ModuleName;
+
+    string WorkingDir;
+    thread::mutex WorkingDirMutex;
+
+    array<string> Argv;
+
+    s32 ModuleNameInit, ArgvInit;  // See platform_init_once()
+};
+
+// :GlobalStateNoConstructors:
+byte State[sizeof(posix_common_state)];
+
+#define S ((posix_common_state *) &State[0])
+#define PERSISTENT internal::platform_get_persistent_allocator()
+
+extern "C" bool lstd_profile_startup();
+
+void init_global_vars() {
+    zero_memory(&State, sizeof(posix_common_state));
+
+    internal::platform_init_allocators();
+
+    S->CinMutex.init();
+    S->CoutMutex.init();
+    S->ExitScheduleMutex.init();
+    S->WorkingDirMutex.init();
+}
+
+// dladdr finds the module an address is in, so this gives the shared library when we are linked into one
+void get_module_name() {
+    PROFILE_FUNCTION();
+
+    Dl_info info;
+    if (!dladdr((void *) get_module_name, &info) || !info.dli_fname) return;
+
+    char resolved[PATH_MAX];
+    const char *name = realpath(info.dli_fname, resolved) ? resolved : info.dli_fname;
+
+    PUSH_ALLOC(PERSISTENT) {
+        S->ModuleName = path_normalize(string(name));
+    }
+}
+
+// The arguments are in /proc/self/cmdline separated by zeroes. We read it instead of getting argv from main,
+// since we initialize before main runs (and when linked into a shared library there is no main of ours at all).
+void parse_arguments() {
+    PROFILE_FUNCTION();
+
+    int fd = open("/proc/self/cmdline", O_RDONLY);
+    if (fd == -1) return;
+    defer(close(fd));
+
+    array<byte> content;
+    defer(free(content));
+
+    PUSH_ALLOC(PERSISTENT) {
+        byte chunk[4_KiB];
+        while (true) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+            array_append(content, chunk, n);
+        }
+
+        s64 start = 0;
+        bool first = true;
+        For(range(content.Count)) {
+            if (content[it]) continue;
+
+            // Skip the exe name
+            if (!first) {
+                string arg;
+                clone(&arg, string((const utf8 *) content.Data + start, it - start));
+                array_append(S->Argv, arg);
+            }
+            first = false;
+            start = it + 1;
+        }
+    }
+}
+
+export namespace internal {
+
+// Called when the program starts and at the start of every thread we launch (see posix_thread.cpp).
+void platform_init_context() {
+    context newContext   = {};
+    newContext.ThreadID  = thread::id((u64) pthread_self());
+    newContext.TempAlloc = {default_temp_allocator, (void *) &__TempAllocData};
+    newContext.Log       = &cout;
+    OVERRIDE_CONTEXT(newContext);
+}
+
+// Like on Windows, the module name, the arguments and the platform allocators are set up on first use.
+// See :StartupProfile: in os.win64.common.
+void platform_init_global_state() {
+    get_cpu_features();
+
+    init_global_vars();
+
+#if defined LSTD_PROFILER
+    if (lstd_profile_startup()) profiler_start();
+#endif
+}
+
+void platform_uninit_state() {
+    cout.force_flush();
+    cerr.force_flush();
+
+    S->CinMutex.release();
+    S->CoutMutex.release();
+    S->ExitScheduleMutex.release();
+    S->WorkingDirMutex.release();
+}
+}  // namespace internal
+
+always_inline int console_writer_fd(console_writer *w) { return w->OutputType == console_writer::COUT ? STDOUT_FILENO : STDERR_FILENO; }
+
+// Writes everything, write() may take less than asked for (pipes) or get interrupted by a signal
+void write_all(int fd, const byte *data, s64 size) {
+    while (size) {
+        ssize_t n = ::write(fd, data, size);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+// See os.win64.common
+// One read() of at most _size_ bytes from stdin, 0 at the end of the input (or on error). Expects CinMutex to be locked.
+s64 console_read(byte *dest, s64 size) {
+    cout.force_flush();  // The prompt may be sitting in the buffer
+
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, dest, (size_t) size);
+    } while (n == -1 && errno == EINTR);
+
+    return n > 0 ? (s64) n : 0;
+}
+
+void console_writer_init_buffer(console_writer *w) {
+    w->IsTerminal = isatty(console_writer_fd(w));
+
+    if (w->Buffering == console_writer::AUTO) {
+        w->Buffering = w->IsTerminal || w->OutputType == console_writer::CERR ? console_writer::LINE : console_writer::FULL;
+    }
+
+    s64 size = w->RequestedBufferSize;
+    if (!size) size = w->Buffering == console_writer::FULL ? console_writer::PIPE_BUFFER_SIZE : S->CONSOLE_BUFFER_SIZE;
+
+    if (size <= S->CONSOLE_BUFFER_SIZE) {
+        w->Buffer = w->OutputType == console_writer::COUT ? S->CoutBuffer : S->CerrBuffer;
+        size      = S->CONSOLE_BUFFER_SIZE;
+    } else {
+        w->Buffer = allocate_array<byte>(size, {.Alloc = PERSISTENT});
+    }
+
+    w->Current    = w->Buffer;
+    w->BufferSize = w->Available = size;
+}
+
+void console_writer_write_out(console_writer *w) {
+    s64 size = w->BufferSize - w->Available;
+    if (!size) return;
+
+    write_all(console_writer_fd(w), w->Buffer, size);
+
+    w->Current   = w->Buffer;
+    w->Available = w->BufferSize;
+}
+
+// Expects the lock to be held
+void console_writer_append(console_writer *w, const byte *data, s64 size) {
+    if (!w->Buffer) console_writer_init_buffer(w);
+
+    if (size > w->Available) {
+        console_writer_write_out(w);
+
+        if (size > w->BufferSize) {
+            write_all(console_writer_fd(w), data, size);
+            return;
+        }
+    }
+
+    copy_memory(w->Current, data, size);
+
+    w->Current += size;
+    w->Available -= size;
+}
+
+export {
+    void exit(s32 exitCode) {
+        // :PlatformExitTermination
+        exit_call_scheduled_functions();
+        internal::platform_uninit_state();
+        _exit(exitCode);
+    }
+
+    void abort() { _exit(3); }
+
+    void exit_schedule(const delegate<void()> &function) {
+        thread::scoped_lock _(&S->ExitScheduleMutex);
+
+        PUSH_ALLOC(PERSISTENT) {
+            array_append(S->ExitFunctions, function);
+        }
+    }
+
+    void exit_call_scheduled_functions() {
+        thread::scoped_lock _(&S->ExitScheduleMutex);
+        For(S->ExitFunctions) it();
+    }
+
+    array<delegate<void()>> *exit_get_scheduled_functions() { return &S->ExitFunctions; }
+
+    time_t os_get_time() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (time_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    f64 os_time_to_seconds(time_t time) { return (f64) time * 1e-9; }
+
+    s64 os_time_to_nanoseconds(time_t time) { return time; }
+
+    s64 os_get_wall_time_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (s64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    s32 os_get_utc_offset(s64 unixSeconds) {
+        time_t t = (time_t) unixSeconds;
+
+        tm local;
+        if (!localtime_r(&t, &local)) return 0;
+        return (s32) local.tm_gmtoff;
+    }
+
+    string os_get_current_module() {
+        internal::platform_init_once(&S->ModuleNameInit, get_module_name);
+        return S->ModuleName;
+    }
+
+    string os_get_working_dir() {
+        char buffer[PATH_MAX];
+        if (!getcwd(buffer, sizeof(buffer))) {
+            internal::posix_report_errno("getcwd");
+            return "";
+        }
+
+        thread::scoped_lock _(&S->WorkingDirMutex);
+        PUSH_ALLOC(PERSISTENT) {
+            free(S->WorkingDir);
+            S->WorkingDir = path_normalize(string(buffer));
+        }
+        return S->WorkingDir;
+    }
+
+    void os_set_working_dir(const string &dir) {
+        assert(path_is_absolute(dir));
+
+        if (chdir(string_to_c_string_temp(dir)) == -1) {
+            internal::posix_report_errno("chdir");
+            return;
+        }
+
+        thread::scoped_lock _(&S->WorkingDirMutex);
+        PUSH_ALLOC(PERSISTENT) {
+            clone(&S->WorkingDir, dir);
+        }
+    }
+
+    [[nodiscard("Leak")]] os_get_env_result os_get_env(const string &name, bool silent) {
+        const char *value = getenv(string_to_c_string_temp(name));
+        if (!value) {
+            if (!silent) {
+                internal::platform_report_error(tsprint("Couldn't find environment variable with value \"{}\"", name));
+            }
+            return {"", false};
+        }
+
+        string result;
+        PUSH_ALLOC(PERSISTENT) {
+            clone(&result, string(value));
+        }
+        return {result, true};
+    }
+
+    void os_set_env(const string &name, const string &value) {
+        // Two temporaries, the second one mustn't overwrite the first
+        char *name8 = string_to_c_string(name, PERSISTENT);
+        defer(free(name8));
+
+        if (setenv(name8, string_to_c_string_temp(value), 1) == -1) internal::posix_report_errno("setenv");
+    }
+
+    void os_remove_env(const string &name) {
+        if (unsetenv(string_to_c_string_temp(name)) == -1) internal::posix_report_errno("unsetenv");
+    }
+
+    [[nodiscard("Leak")]] string os_get_clipboard_content() {
+        internal::platform_report_error("There is no clipboard on this platform");
+        return "";
+    }
+
+    void os_set_clipboard_content(const string &content) {
+        internal::platform_report_error("There is no clipboard on this platform");
+    }
+
+    array<string> os_get_command_line_arguments() {
+        internal::platform_init_once(&S->ArgvInit, parse_arguments);
+        return S->Argv;
+    }
+
+    u32 os_get_pid() { return (u32) getpid(); }
+
+    s64 os_get_peak_memory_usage() {
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == -1) return 0;
+#if OS == MACOS
+        return (s64) usage.ru_maxrss;  // Bytes on macOS..
+#else
+        return (s64) usage.ru_maxrss * 1024;  // .. KiB everywhere else
+#endif
+    }
+
+    bytes os_read_from_console() {
+        thread::scoped_lock _(&S->CinMutex);
+        return bytes(S->CinBuffer, console_read(S->CinBuffer, S->CONSOLE_BUFFER_SIZE));
+    }
+
+    s64 console_reader::read_source(byte *dest, s64 size) {
+        thread::scoped_lock _(&S->CinMutex);
+        return console_read(dest, size);
+    }
+
+    allocator console_reader::buffer_allocator() { return Alloc ? Alloc : PERSISTENT; }
+
+    void console_writer::write(const byte *data, s64 size) {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
+
+        console_writer_append(this, data, size);
+    }
+
+    void console_writer::write_vectored(const bytes *spans, s64 count) {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
+
+        For(range(count)) console_writer_append(this, spans[it].Data, spans[it].Count);
+    }
+
+    void console_writer::flush() {
+        if (Buffering != console_writer::LINE) return;
+        force_flush();
+    }
+
+    void console_writer::force_flush() {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
+
+        if (Buffer) console_writer_write_out(this);
+    }
+
+    void console_writer::set_buffering(buffering mode, s64 bufferSize) {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
+
+        if (Buffer) {
+            console_writer_write_out(this);
+            if (Buffer != S->CoutBuffer && Buffer != S->CerrBuffer) free(Buffer);
+        }
+
+        Buffer = Current = null;
+        Available = BufferSize = 0;
+
+        Buffering           = mode;
+        RequestedBufferSize = bufferSize;
+    }
+}
+
+#endif
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,71 @@
+module;
+
+#include "lstd/memory/hash_table.h"
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+
+#if OS != WINDOWS
+#include <dlfcn.h>
+#endif
+
+//
+// Simple wrapper around dynamic libraries and getting addresses of procedures, POSIX version.
+// See os.win64.dynamic_library for the docs.
+//
+
+export module os.posix.dynamic_library;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    struct dynamic_library_t {
+        void *Handle = null;  // From dlopen
+
+        hash_table<string, void *> Symbols;  // Looked up so far, misses too (as null)
+        thread::fast_mutex Lock;
+    };
+
+    using dynamic_library = dynamic_library_t *;
+
+#if OS != WINDOWS
+    [[nodiscard("Leak")]] dynamic_library os_dynamic_library_load(const string &path) {
+        void *handle = dlopen(string_to_c_string_temp(path), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) return null;
+
+        auto *library   = allocate<dynamic_library_t>();
+        library->Handle = handle;
+        return library;
+    }
+
+    // :OverloadFree: We follow the convention to overload the "free" function
+    // as a standard way to release resources (may not be just memory blocks).
+    void free(dynamic_library library) {
+        if (!library) return;
+
+        dlclose(library->Handle);
+
+        for (auto [k, v] : library->Symbols) free(*k);
+        free(library->Symbols);
+        free<dynamic_library_t>(library);  // Not this overload
+    }
+
+    void *os_dynamic_library_get_symbol(dynamic_library library, const string &name) {
+        thread::scoped_lock _(&library->Lock);
+
+        auto [kp, vp] = find(library->Symbols, name);
+        if (vp) return *vp;
+
+        void *address = dlsym(library->Handle, string_to_c_string_temp(name));
+
+        string key;
+        clone(&key, name);
+        add(library->Symbols, key, address);
+
+        return address;
+    }
+
+    void *os_dynamic_library_get_symbol(dynamic_library library, const char *name) { return os_dynamic_library_get_symbol(library, string(name)); }
+#endif
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,504 @@
+module;
+
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+
+#if OS != WINDOWS
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>  // strerror
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//
+// Platform specific memory functions, POSIX version. See os.win64.memory for the docs of the exported functions.
+//
+
+export module os.posix.memory;
+
+import fmt;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    // Blocks are mapped straight from the OS (mmap), so they always start at a page (+ a small header, see below).
+    [[nodiscard("Leak")]] void *os_allocate_block(s64 size);
+
+    // Grows/shrinks the mapping in place with mremap, returns null if the pages after the block are taken.
+    [[nodiscard("Leak")]] void *os_resize_block(void *ptr, s64 newSize);
+
+    s64 os_get_block_size(void *ptr);
+    void os_free_block(void *ptr);
+
+    [[nodiscard("Leak")]] void *os_reserve_memory(s64 size);
+    bool os_commit_memory(void *address, s64 size);
+    void os_decommit_memory(void *address, s64 size);
+    void os_release_memory(void *address);
+
+    // See os.win64.memory, here it's madvise(MADV_DONTNEED) on the pages fully inside the range (they read as zeroes after)
+    s64 os_purge_memory(void *address, s64 size);
+
+    struct os_allocate_large_block_result {
+        void *Block = null;
+        s64 PageSize = 0;
+    };
+
+    // Tries explicit huge pages (MAP_HUGETLB, these have to be reserved by the admin in /proc/sys/vm/nr_hugepages),
+    // then falls back to normal pages and asks for transparent huge pages with madvise. In that case _PageSize_ is
+    // the normal page size since we don't know if the kernel will give us huge ones.
+    [[nodiscard("Leak")]] os_allocate_large_block_result os_allocate_large_block(s64 size);
+
+    void os_free_large_block(void *block);
+
+    s64 os_get_page_size();
+    s64 os_get_allocation_granularity();  // The page size, mmap has no coarser granularity
+
+    // POSIX shared memory (shm_open), _name_ shouldn't contain slashes
+    void os_write_shared_block(const string &name, void *data, s64 size);
+    void os_read_shared_block(const string &name, void *out, s64 size);
+
+    // See os.win64.memory
+    template <typename... Types>
+    [[nodiscard("Leak")]] auto os_allocate_packed(s64 extraDynamicSize) {
+        constexpr s64 TYPE_SIZE[]     = {sizeof(Types)...};
+        constexpr s64 TOTAL_TYPE_SIZE = (sizeof(Types) + ...);
+
+        using result_t = tuple<types::add_pointer_t<types::remove_pointer_t<types::decay_t<Types>>>..., void *>;
+        result_t result;
+
+        s64 size = TOTAL_TYPE_SIZE + extraDynamicSize;
+
+        void *block = os_allocate_block(size);
+
+        s64 offset = 0;
+        static_for<0, sizeof...(Types)>([&](auto i) {
+            using element_t = tuple_get_t<i, result_t>;
+
+            auto *p = (element_t) ((byte *) block + offset);
+            tuple_get<i>(result) = p;
+
+            using element_t_no_pointer = types::remove_pointer_t<element_t>;
+            if constexpr (!types::is_scalar<element_t_no_pointer>) {
+                new (p) element_t_no_pointer;
+            }
+
+            offset += TYPE_SIZE[i];
+        });
+
+        tuple_get<sizeof...(Types)>(result) = (byte *) block + offset;
+
+        return result;
+    }
+}
+
+#if OS != WINDOWS
+
+struct posix_memory_state {
+    // The same two allocators as in os.win64.memory. We don't keep the per-thread cache in front of the persistent
+    // allocator here - the futex mutex doesn't enter the kernel when it isn't contended, which is the common case
+    // for global state.
+    allocator PersistentAlloc;
+    thread::mutex PersistentAllocMutex;
+
+    allocator TempAlloc;
+    void *TempStorageBlock;
+    s64 TempStorageSize;
+    thread::mutex TempAllocMutex;
+
+    // The blocks are created on first use, see platform_init_once()
+    s32 PersistentAllocInit, TempAllocInit;
+
+    // Sizes of large blocks (munmap needs them and a header would cost a whole huge page)
+    struct large_block {
+        void *Block;
+        s64 Size;
+    };
+    large_block LargeBlocks[64];
+    s64 LargeBlockCount;
+    thread::mutex LargeBlocksMutex;
+
+    s64 PageSize;
+};
+
+// :GlobalStateNoConstructors:
+byte State[sizeof(posix_memory_state)];
+
+#define S ((posix_memory_state *) &State[0])
+
+void create_temp_storage_block(s64);
+void create_persistent_alloc_block(s64);
+
+// The starting sizes of the blocks, see posix_common.cpp
+extern "C" s64 lstd_persistent_storage_starting_size();
+extern "C" s64 lstd_temporary_storage_starting_size();
+
+export namespace internal {
+// See os.win64.memory
+template <typename F>
+always_inline void platform_init_once(s32 *state, F &&init) {
+    if (atomic_load(state) == 2) return;
+
+    if (atomic_compare_and_swap(state, 1, 0) == 0) {
+        init();
+        atomic_store(state, 2);
+    } else {
+        while (atomic_load(state) != 2) thread::sleep(0);
+    }
+}
+
+void platform_report_warning(string message, source_location loc = source_location::current()) {
+    print(">>> {!YELLOW}Platform warning{!} {}:{} (in function: {}): {}.\n", loc.File, loc.Line, loc.Function, message);
+}
+
+void platform_report_error(string message, source_location loc = source_location::current()) {
+    print(">>> {!RED}Platform error{!} {}:{} (in function: {}): {}.\n", loc.File, loc.Line, loc.Function, message);
+}
+
+// Reports _call_ with the message for _errno_
+void posix_report_errno(const char *call, source_location loc = source_location::current()) {
+    platform_report_error(tsprint("{} failed with: {}", call, strerror(errno)), loc);
+}
+}  // namespace internal
+
+// See win64_temp_alloc. thread::mutex isn't recursive, so pools are added and removed with arena_allocator()
+// directly and free_all() (which comes back here) runs after TempAllocMutex is released.
+void *posix_temp_alloc(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    void *result;
+    {
+        thread::scoped_lock _(&S->TempAllocMutex);
+
+        // Growing replaces the arena, _context_ may be the old one if another thread grew it meanwhile
+        context = S->TempAlloc.Context;
+
+        result = arena_allocator(mode, context, size, oldMemory, oldSize, options);
+        if (mode != allocator_mode::ALLOCATE || result) return result;
+
+        if (size > S->TempStorageSize) {
+            arena_allocator(allocator_mode::REMOVE_POOL, context, 0, S->TempStorageBlock, 0, 0);
+            os_free_block((byte *) S->TempStorageBlock - sizeof(arena_allocator_data));
+
+            create_temp_storage_block(size * 2);
+            result = arena_allocator(allocator_mode::ALLOCATE, S->TempAlloc.Context, size, null, 0, options);
+        }
+    }
+
+    // Printing may allocate, so not with the lock held
+    if (result) {
+        internal::platform_report_warning("Not enough memory in the temporary allocator; expanding the pool");
+        return result;
+    }
+
+    free_all({posix_temp_alloc, atomic_load(&S->TempAlloc.Context)});
+
+    thread::scoped_lock _(&S->TempAllocMutex);
+    return arena_allocator(allocator_mode::ALLOCATE, S->TempAlloc.Context, size, null, 0, options);
+}
+
+// Called with TempAllocMutex held (or before the allocator is handed out). The context is read without the lock
+// by platform_get_temporary_allocator(), so it's published with an atomic store after the pool is added.
+void create_temp_storage_block(s64 size) {
+    auto [data, pool] = os_allocate_packed<arena_allocator_data>(size);
+    arena_allocator(allocator_mode::ADD_POOL, data, size, pool, 0, 0);
+    atomic_store(&S->TempAlloc.Context, (void *) data);
+
+    S->TempStorageBlock = pool;
+    S->TempStorageSize = size;
+}
+
+void *posix_persistent_alloc(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    // Global state of the library lives here, it's never freed all at once
+    if (mode == allocator_mode::FREE_ALL) return (void *) -1;
+
+    void *result;
+    bool grew = false;
+    {
+        thread::scoped_lock _(&S->PersistentAllocMutex);
+
+        result = tlsf_allocator(mode, context, size, oldMemory, oldSize, options);
+        if (mode == allocator_mode::ALLOCATE && !result) {
+            // Another pool for the same heap, straight to tlsf_allocator() since allocator_add_pool() would come back here
+            void *pool = os_allocate_block(size * 3);
+            tlsf_allocator(allocator_mode::ADD_POOL, context, size * 3, pool, 0, 0);
+
+            result = tlsf_allocator(allocator_mode::ALLOCATE, context, size, null, 0, options);
+            grew   = true;
+        }
+    }
+
+    // Printing may allocate from this allocator
+    if (grew) internal::platform_report_warning("Not enough memory in the persistent allocator; adding a pool");
+    return result;
+}
+
+void create_persistent_alloc_block(s64 size) {
+    auto [data, pool] = os_allocate_packed<tlsf_allocator_data>(size);
+    S->PersistentAlloc = {posix_persistent_alloc, data};
+    tlsf_allocator(allocator_mode::ADD_POOL, data, size, pool, 0, 0);
+}
+
+export namespace internal {
+allocator platform_get_persistent_allocator() {
+    platform_init_once(&S->PersistentAllocInit, [] { create_persistent_alloc_block(lstd_persistent_storage_starting_size()); });
+    return S->PersistentAlloc;
+}
+
+// See tlsf_trim()
+s64 platform_trim_persistent_allocator() {
+    auto alloc = platform_get_persistent_allocator();
+
+    thread::scoped_lock _(&S->PersistentAllocMutex);
+    return tlsf_trim((tlsf_allocator_data *) alloc.Context);
+}
+
+allocator platform_get_temporary_allocator() {
+    platform_init_once(&S->TempAllocInit, [] {
+        S->TempAlloc.Function = posix_temp_alloc;
+        create_temp_storage_block(lstd_temporary_storage_starting_size());
+    });
+    return {S->TempAlloc.Function, atomic_load(&S->TempAlloc.Context)};
+}
+
+// There is no per-thread cache here, see posix_memory_state
+void platform_flush_persistent_allocator_cache() {}
+
+void platform_init_allocators() {
+    S->PageSize = sysconf(_SC_PAGESIZE);
+
+    S->TempAllocMutex.init();
+    S->PersistentAllocMutex.init();
+    S->LargeBlocksMutex.init();
+
+    // The blocks are created when the allocators are first asked for
+}
+}  // namespace internal
+
+//
+// Blocks from os_allocate_block() start with a header with the size of the mapping, the pointer we return is right after it.
+// The header is 16 bytes so the result stays aligned for anything the allocators put in it.
+//
+constexpr s64 BLOCK_HEADER_SIZE = 16;
+
+always_inline s64 round_up_to_page(s64 size) { return (size + S->PageSize - 1) / S->PageSize * S->PageSize; }
+always_inline s64 *block_header(void *ptr) { return (s64 *) ((byte *) ptr - BLOCK_HEADER_SIZE); }
+
+// Reserved ranges get one committed page in front of them with the size (os_release_memory() doesn't take one)
+always_inline s64 reserve_header_size() { return S->PageSize; }
+
+export {
+    void *os_allocate_block(s64 size) {
+        assert(size < MAX_ALLOCATION_REQUEST);
+
+        s64 mapped = round_up_to_page(size + BLOCK_HEADER_SIZE);
+
+        void *p = mmap(null, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            internal::posix_report_errno("mmap");
+            return null;
+        }
+
+        *(s64 *) p = mapped;
+        return (byte *) p + BLOCK_HEADER_SIZE;
+    }
+
+    void *os_resize_block(void *ptr, s64 newSize) {
+        assert(ptr);
+        assert(newSize < MAX_ALLOCATION_REQUEST);
+
+        s64 *header = block_header(ptr);
+        s64 mapped  = round_up_to_page(newSize + BLOCK_HEADER_SIZE);
+        if (mapped == *header) return ptr;
+
+#if OS == LINUX
+        // No MREMAP_MAYMOVE - like on Windows we only resize in place, the caller decides whether to move
+        if (mremap(header, *header, mapped, 0) == MAP_FAILED) {
+            if (errno != ENOMEM) internal::posix_report_errno("mremap");
+            return null;
+        }
+#else
+        // Shrinking can always be done in place, growing only with mremap
+        if (mapped > *header) return null;
+        munmap((byte *) header + mapped, *header - mapped);
+#endif
+        *header = mapped;
+        return ptr;
+    }
+
+    s64 os_get_block_size(void *ptr) { return *block_header(ptr) - BLOCK_HEADER_SIZE; }
+
+    void os_free_block(void *ptr) {
+        s64 *header = block_header(ptr);
+        if (munmap(header, *header) == -1) internal::posix_report_errno("munmap");
+    }
+
+    void *os_reserve_memory(s64 size) {
+        assert(size > 0 && size < MAX_ALLOCATION_REQUEST);
+
+        s64 total = reserve_header_size() + round_up_to_page(size);
+
+        // MAP_NORESERVE so reserving a huge range doesn't count against overcommit
+        void *p = mmap(null, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            internal::posix_report_errno("mmap");
+            return null;
+        }
+
+        if (mprotect(p, reserve_header_size(), PROT_READ | PROT_WRITE) == -1) {
+            internal::posix_report_errno("mprotect");
+            munmap(p, total);
+            return null;
+        }
+
+        *(s64 *) p = total;
+        return (byte *) p + reserve_header_size();
+    }
+
+    bool os_commit_memory(void *address, s64 size) {
+        assert(address);
+
+        byte *begin = (byte *) ((u64) address / S->PageSize * S->PageSize);
+        byte *end   = (byte *) round_up_to_page((s64) address + size);
+
+        // Anonymous pages are zero the first time they are touched (and after os_decommit_memory())
+        return mprotect(begin, end - begin, PROT_READ | PROT_WRITE) == 0;
+    }
+
+    void os_decommit_memory(void *address, s64 size) {
+        assert(address);
+
+        byte *begin = (byte *) round_up_to_page((s64) address);
+        byte *end   = (byte *) ((u64) ((byte *) address + size) / S->PageSize * S->PageSize);
+        if (end <= begin) return;
+
+        // MADV_DONTNEED drops the pages right away, they read as zeroes if touched again
+        if (madvise(begin, end - begin, MADV_DONTNEED) == -1) internal::posix_report_errno("madvise");
+        mprotect(begin, end - begin, PROT_NONE);
+    }
+
+    s64 os_purge_memory(void *address, s64 size) {
+        assert(address);
+
+        byte *begin = (byte *) round_up_to_page((s64) address);
+        byte *end   = (byte *) ((u64) ((byte *) address + size) / S->PageSize * S->PageSize);
+        if (end <= begin) return 0;
+
+        if (madvise(begin, end - begin, MADV_DONTNEED) == -1) {
+            internal::posix_report_errno("madvise");
+            return 0;
+        }
+        return end - begin;
+    }
+
+    void os_release_memory(void *address) {
+        assert(address);
+
+        byte *base = (byte *) address - reserve_header_size();
+        if (munmap(base, *(s64 *) base) == -1) internal::posix_report_errno("munmap");
+    }
+
+    os_allocate_large_block_result os_allocate_large_block(s64 size) {
+        assert(size > 0 && size < MAX_ALLOCATION_REQUEST);
+
+        os_allocate_large_block_result result;
+
+        s64 mapped = 0;
+
+#if defined MAP_HUGETLB
+        constexpr s64 HUGE_PAGE_SIZE = 2_MiB;
+
+        s64 rounded = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+        void *p = mmap(null, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            result.Block    = p;
+            result.PageSize = HUGE_PAGE_SIZE;
+            mapped          = rounded;
+        }
+#endif
+
+        if (!result.Block) {
+            mapped = round_up_to_page(size);
+
+            void *q = mmap(null, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (q == MAP_FAILED) {
+                internal::posix_report_errno("mmap");
+                return result;
+            }
+
+#if defined MADV_HUGEPAGE
+            madvise(q, mapped, MADV_HUGEPAGE);
+#endif
+            result.Block    = q;
+            result.PageSize = S->PageSize;
+        }
+
+        thread::scoped_lock _(&S->LargeBlocksMutex);
+        assert(S->LargeBlockCount < (s64) (sizeof(S->LargeBlocks) / sizeof(S->LargeBlocks[0])) && "Too many large blocks");
+        S->LargeBlocks[S->LargeBlockCount++] = {result.Block, mapped};
+
+        return result;
+    }
+
+    void os_free_large_block(void *block) {
+        thread::scoped_lock _(&S->LargeBlocksMutex);
+
+        For(range(S->LargeBlockCount)) {
+            if (S->LargeBlocks[it].Block != block) continue;
+
+            munmap(block, S->LargeBlocks[it].Size);
+            S->LargeBlocks[it] = S->LargeBlocks[--S->LargeBlockCount];
+            return;
+        }
+        assert(false && "Not a block from os_allocate_large_block()");
+    }
+
+    s64 os_get_page_size() { return S->PageSize; }
+    s64 os_get_allocation_granularity() { return S->PageSize; }
+
+    void os_write_shared_block(const string &name, void *data, s64 size) {
+        string shmName = tsprint("/{}", name);
+
+        int fd = shm_open(string_to_c_string_temp(shmName), O_RDWR | O_CREAT, 0644);
+        if (fd == -1) {
+            internal::posix_report_errno("shm_open");
+            return;
+        }
+        defer(close(fd));
+
+        if (ftruncate(fd, size) == -1) {
+            internal::posix_report_errno("ftruncate");
+            return;
+        }
+
+        void *result = mmap(null, size, PROT_WRITE, MAP_SHARED, fd, 0);
+        if (result == MAP_FAILED) {
+            internal::posix_report_errno("mmap");
+            return;
+        }
+        copy_memory(result, data, size);
+        munmap(result, size);
+    }
+
+    void os_read_shared_block(const string &name, void *out, s64 size) {
+        string shmName = tsprint("/{}", name);
+
+        int fd = shm_open(string_to_c_string_temp(shmName), O_RDONLY, 0);
+        if (fd == -1) {
+            internal::posix_report_errno("shm_open");
+            return;
+        }
+        defer(close(fd));
+
+        void *result = mmap(null, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (result == MAP_FAILED) {
+            internal::posix_report_errno("mmap");
+            return;
+        }
+        copy_memory(out, result, size);
+        munmap(result, size);
+    }
+}
+
+#endif
+
+LSTD_END_NAMESPACE
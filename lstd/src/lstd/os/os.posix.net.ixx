@@ -0,0 +1,818 @@
+module;
+
+#include "lstd/io/socket_reader.h"
+#include "lstd/io/socket_writer.h"
+#include "lstd/memory/delegate.h"
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+
+#if OS != WINDOWS
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if OS == LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif OS == MACOS
+#include <sys/event.h>
+#endif
+
+//
+// TCP and UDP sockets, POSIX version. See os.win64.net for the docs of the exported functions.
+//
+// Sockets are completion based on Windows (the OS does the recv and tells us when it's done) but readiness based
+// here, so the poller turns one into the other: an attached socket is non-blocking, a request is tried right away
+// and if the socket isn't ready it waits in the socket's queue until epoll (kqueue on macOS) says it is.
+// Sockets are registered edge-triggered once, when attached, so submitting a request never calls epoll_ctl -
+// it's one recv/send when the socket is ready and another one when it becomes ready if it wasn't.
+//
+
+export module os.posix.net;
+
+import os.posix.memory;
+
+import fmt;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    enum class socket_type {
+        TCP = 0,
+        UDP,
+    };
+
+    struct net_address {
+        alignas(8) byte Data[28]{};
+        s32 Size = 0;
+    };
+
+    struct net_socket {
+        s64 Handle       = -1;
+        socket_type Type = socket_type::TCP;
+    };
+
+    bool net_address_resolve(net_address &out, const string &host, u16 port, socket_type type = socket_type::TCP);
+    u16 net_address_port(const net_address &address);
+
+    [[nodiscard("Leak")]] net_socket socket_listen(const string &host, u16 port, s32 backlog = 128);
+    [[nodiscard("Leak")]] net_socket socket_accept(net_socket &listener, net_address *from = null);
+    [[nodiscard("Leak")]] net_socket socket_connect(const string &host, u16 port);
+    [[nodiscard("Leak")]] net_socket socket_udp_open(const string &host = "", u16 port = 0);
+
+    net_address socket_get_address(const net_socket &s);
+
+    s64 socket_send(net_socket &s, const byte *data, s64 size);
+    s64 socket_send_vectored(net_socket &s, const bytes *spans, s64 count);
+    s64 socket_recv(net_socket &s, byte *dest, s64 size);
+
+    s64 socket_send_to(net_socket &s, const net_address &to, const byte *data, s64 size);
+    s64 socket_recv_from(net_socket &s, byte *dest, s64 size, net_address *from = null);
+
+    void socket_shutdown_send(net_socket &s);
+
+    // Requests waiting on the socket complete with ECANCELED.
+    void free(net_socket &s);
+
+    enum class net_op {
+        Recv = 0,
+        Send,
+    };
+
+    struct net_poller;
+
+    struct net_request {
+        net_socket *Socket = null;
+        net_op Op          = net_op::Recv;
+        byte *Data         = null;
+        s64 Size           = 0;
+
+        delegate<void(net_request *)> Callback;
+        void *UserData = null;
+
+        s64 Transferred = 0;
+        u32 Error       = 0;  // errno, 0 on success
+
+        s32 Done = 0;
+
+        net_poller *Poller       = null;
+        net_request *NextPending = null;  // In the socket's queue while it waits for the socket to be ready
+    };
+
+    struct net_poller {
+        s64 Handle = -1;  // The epoll/kqueue
+        s64 WakeFd = -1;  // An eventfd which tells the threads to stop (Linux only, kqueue has user events)
+
+        s64 InFlight = 0;
+
+        thread::thread *Threads = null;
+        s64 ThreadCount         = 0;
+    };
+
+    bool net_poller_init(net_poller &p, s64 threads = 1);
+    void free(net_poller &p);
+
+    // Also makes the socket non-blocking, so blocking calls on it return errors when it isn't ready.
+    // Use only requests on an attached socket.
+    bool net_poller_attach(net_poller &p, net_socket &s);
+
+    void net_submit(net_poller &p, net_request *request);
+    s64 net_poll(net_poller &p, u32 timeoutMs = 0);
+    void net_wait(net_poller &p, net_request *request);
+}
+
+#if OS != WINDOWS
+
+//
+// What waits on an attached socket. Found by the descriptor (not by a pointer we give the kernel), so an event which
+// arrives after the socket was closed can't touch freed memory - at worst it makes a new socket with the same
+// descriptor retry its requests, which just find it not ready. States are allocated a page at a time with the
+// persistent allocator and never freed, descriptors are reused by the OS anyway.
+//
+struct net_socket_state {
+    thread::fast_mutex Lock;
+    net_request *Recv = null, *RecvTail = null;
+    net_request *Send = null, *SendTail = null;
+};
+
+constexpr s64 NET_STATES_PER_PAGE = 1024;
+constexpr s64 NET_STATE_PAGES     = 1024;  // Descriptors up to a million
+
+file_scope net_socket_state *NetStates[NET_STATE_PAGES];
+
+constexpr s64 NET_EVENTS_PER_WAIT = 64;
+
+#if OS == LINUX
+constexpr int NET_SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int NET_SEND_FLAGS = 0;  // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+// Creates the page of _fd_ if _create_
+file_scope net_socket_state *net_get_state(s64 fd, bool create) {
+    if (fd < 0 || fd >= NET_STATES_PER_PAGE * NET_STATE_PAGES) return null;
+
+    auto **page = NetStates + fd / NET_STATES_PER_PAGE;
+
+    auto *states = atomic_load(page);
+    if (!states && create) {
+        auto *fresh = allocate_array<net_socket_state>(NET_STATES_PER_PAGE, {.Alloc = internal::platform_get_persistent_allocator()});
+
+        // The thread which loses the race takes the winner's
+        states = atomic_compare_and_swap(page, fresh, (net_socket_state *) null);
+        if (states) {
+            free(fresh);
+        } else {
+            states = fresh;
+        }
+    }
+    return states ? states + fd % NET_STATES_PER_PAGE : null;
+}
+
+// No SIGPIPE when the other side is gone, no Nagle for TCP
+file_scope void net_configure(int fd, socket_type type) {
+    int one = 1;
+#if OS == MACOS
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (type == socket_type::TCP) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+file_scope int net_open(const net_address &address, socket_type type) {
+    int family = ((sockaddr *) address.Data)->sa_family;
+    int kind   = type == socket_type::TCP ? SOCK_STREAM : SOCK_DGRAM;
+
+    int fd = socket(family, kind, 0);
+    if (fd == -1) {
+        internal::posix_report_errno("socket");
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+file_scope const char *net_port_string(char *buffer, u16 port) {
+    char *p = buffer + 5;
+    *p = 0;
+    do {
+        *--p = '0' + port % 10;
+        port /= 10;
+    } while (port);
+    return p;
+}
+
+bool net_address_resolve(net_address &out, const string &host, u16 port, socket_type type) {
+    out = {};
+
+    addrinfo hints;
+    zero_memory(&hints, sizeof(hints));
+    hints.ai_family   = host ? AF_UNSPEC : AF_INET;
+    hints.ai_socktype = type == socket_type::TCP ? SOCK_STREAM : SOCK_DGRAM;
+    hints.ai_flags    = host ? 0 : AI_PASSIVE;
+
+    char service[6];
+
+    addrinfo *result = null;
+    int error = getaddrinfo(host ? string_to_c_string_temp(host) : null, net_port_string(service, port), &hints, &result);
+    if (error != 0 || !result) {
+        internal::platform_report_error(tsprint("getaddrinfo failed with: {}", gai_strerror(error)));
+        return false;
+    }
+    defer(freeaddrinfo(result));
+
+    if (result->ai_addrlen > sizeof(out.Data)) return false;
+
+    copy_memory(out.Data, result->ai_addr, result->ai_addrlen);
+    out.Size = (s32) result->ai_addrlen;
+    return true;
+}
+
+u16 net_address_port(const net_address &address) { return (u16) ((address.Data[2] << 8) | address.Data[3]); }
+
+[[nodiscard("Leak")]] net_socket socket_listen(const string &host, u16 port, s32 backlog) {
+    net_address address;
+    if (!net_address_resolve(address, host, port)) return {};
+
+    int fd = net_open(address, socket_type::TCP);
+    if (fd == -1) return {};
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(fd, (sockaddr *) address.Data, address.Size) == -1) {
+        internal::posix_report_errno("bind");
+        close(fd);
+        return {};
+    }
+
+    if (listen(fd, backlog) == -1) {
+        internal::posix_report_errno("listen");
+        close(fd);
+        return {};
+    }
+    return {fd, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_accept(net_socket &listener, net_address *from) {
+    net_address address;
+    socklen_t size = sizeof(address.Data);
+
+    int fd;
+    do {
+        fd = accept((int) listener.Handle, (sockaddr *) address.Data, &size);
+    } while (fd == -1 && errno == EINTR);
+
+    if (fd == -1) {
+        internal::posix_report_errno("accept");
+        return {};
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    net_configure(fd, socket_type::TCP);
+
+    if (from) {
+        *from      = address;
+        from->Size = (s32) size;
+    }
+    return {fd, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_connect(const string &host, u16 port) {
+    net_address address;
+    if (!net_address_resolve(address, host, port)) return {};
+
+    int fd = net_open(address, socket_type::TCP);
+    if (fd == -1) return {};
+
+    int result;
+    do {
+        result = connect(fd, (sockaddr *) address.Data, address.Size);
+    } while (result == -1 && errno == EINTR);
+
+    if (result == -1) {
+        internal::posix_report_errno("connect");
+        close(fd);
+        return {};
+    }
+    net_configure(fd, socket_type::TCP);
+    return {fd, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_udp_open(const string &host, u16 port) {
+    net_address address;
+    if (!net_address_resolve(address, host, port, socket_type::UDP)) return {};
+
+    int fd = net_open(address, socket_type::UDP);
+    if (fd == -1) return {};
+
+    if (bind(fd, (sockaddr *) address.Data, address.Size) == -1) {
+        internal::posix_report_errno("bind");
+        close(fd);
+        return {};
+    }
+    net_configure(fd, socket_type::UDP);
+    return {fd, socket_type::UDP};
+}
+
+net_address socket_get_address(const net_socket &s) {
+    net_address result;
+    socklen_t size = sizeof(result.Data);
+    if (getsockname((int) s.Handle, (sockaddr *) result.Data, &size) == -1) {
+        internal::posix_report_errno("getsockname");
+        return {};
+    }
+    result.Size = (s32) size;
+    return result;
+}
+
+s64 socket_send(net_socket &s, const byte *data, s64 size) {
+    bytes span((byte *) data, size);
+    return socket_send_vectored(s, &span, 1);
+}
+
+s64 socket_send_vectored(net_socket &s, const bytes *spans, s64 count) {
+    constexpr s64 MAX_BUFFERS = 64;
+
+    s64 total = 0;
+    For(range(count)) total += spans[it].Count;
+
+    iovec buffers[MAX_BUFFERS];
+    s64 first = 0, n = 0;
+
+    // sendmsg because writev can't take MSG_NOSIGNAL. It may send less than we gave it, then we go on from there.
+    while (true) {
+        while (n < MAX_BUFFERS && first < count) {
+            auto &span = spans[first++];
+            if (span.Count) buffers[n++] = {span.Data, (size_t) span.Count};
+        }
+        if (!n) break;
+
+        msghdr message;
+        zero_memory(&message, sizeof(message));
+        message.msg_iov    = buffers;
+        message.msg_iovlen = (decltype(message.msg_iovlen)) n;
+
+        ssize_t sent = sendmsg((int) s.Handle, &message, NET_SEND_FLAGS);
+        if (sent == -1) {
+            if (errno == EINTR) continue;
+            internal::posix_report_errno("sendmsg");
+            return -1;
+        }
+
+        // Drop what went out, keep the rest for the next call
+        s64 done = 0;
+        while (done < n && (size_t) sent >= buffers[done].iov_len) sent -= buffers[done++].iov_len;
+        if (done < n) {
+            buffers[done].iov_base = (byte *) buffers[done].iov_base + sent;
+            buffers[done].iov_len -= sent;
+        }
+        copy_memory(buffers, buffers + done, (n - done) * sizeof(iovec));
+        n -= done;
+    }
+    return total;
+}
+
+s64 socket_recv(net_socket &s, byte *dest, s64 size) {
+    ssize_t n;
+    do {
+        n = recv((int) s.Handle, dest, size, 0);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+        internal::posix_report_errno("recv");
+        return -1;
+    }
+    return n;
+}
+
+s64 socket_send_to(net_socket &s, const net_address &to, const byte *data, s64 size) {
+    ssize_t n;
+    do {
+        n = sendto((int) s.Handle, data, size, NET_SEND_FLAGS, (sockaddr *) to.Data, to.Size);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+        internal::posix_report_errno("sendto");
+        return -1;
+    }
+    return n;
+}
+
+s64 socket_recv_from(net_socket &s, byte *dest, s64 size, net_address *from) {
+    net_address address;
+    socklen_t addressSize = sizeof(address.Data);
+
+    ssize_t n;
+    do {
+        n = recvfrom((int) s.Handle, dest, size, 0, (sockaddr *) address.Data, &addressSize);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+        internal::posix_report_errno("recvfrom");
+        return -1;
+    }
+
+    if (from) {
+        *from      = address;
+        from->Size = (s32) addressSize;
+    }
+    return n;
+}
+
+void socket_shutdown_send(net_socket &s) {
+    if (s.Handle != -1) shutdown((int) s.Handle, SHUT_WR);
+}
+
+file_scope void net_finish(net_request *r) {
+    auto *p = r->Poller;
+    atomic_add(&p->InFlight, (s64) -1);
+
+    atomic_store(&r->Done, 1);
+    if (r->Callback) r->Callback(r);
+}
+
+// Runs the callbacks of a list of finished requests, outside the socket's lock
+file_scope void net_finish_list(net_request *r) {
+    while (r) {
+        auto *next = r->NextPending;  // The request may be reused from its callback
+        net_finish(r);
+        r = next;
+    }
+}
+
+void free(net_socket &s) {
+    if (s.Handle == -1) return;
+
+    // Take what waits on the socket before closing it, the descriptor may be reused right after
+    net_request *cancelled = null;
+    if (auto *st = net_get_state(s.Handle, false)) {
+        thread::scoped_lock _(&st->Lock);
+
+        if (st->Recv) {
+            st->RecvTail->NextPending = st->Send;
+            cancelled = st->Recv;
+        } else {
+            cancelled = st->Send;
+        }
+        st->Recv = st->RecvTail = st->Send = st->SendTail = null;
+    }
+
+    close((int) s.Handle);
+    s = {};
+
+    for (auto *r = cancelled; r; r = r->NextPending) r->Error = ECANCELED;
+    net_finish_list(cancelled);
+}
+
+//
+// socket_writer and socket_reader (see io/)
+//
+
+void socket_writer::write(const byte *data, s64 size) {
+    if (Count + size <= BUFFER_SIZE) {
+        copy_memory(Buffer + Count, data, size);
+        Count += size;
+        return;
+    }
+
+    bytes span((byte *) data, size);
+    write_vectored(&span, 1);
+}
+
+void socket_writer::write_vectored(const bytes *spans, s64 count) {
+    s64 total = 0;
+    For(range(count)) total += spans[it].Count;
+
+    if (Count + total <= BUFFER_SIZE) {
+        For(range(count)) {
+            copy_memory(Buffer + Count, spans[it].Data, spans[it].Count);
+            Count += spans[it].Count;
+        }
+        return;
+    }
+
+    // What's buffered and the new data go out in one call
+    bytes all[16];
+    all[0] = bytes(Buffer, Count);
+
+    net_socket s = {Socket, socket_type::TCP};
+
+    s64 first = 0;
+    while (first < count) {
+        s64 n = min(count - first, (s64) 15);
+        copy_memory(all + 1, spans + first, n * sizeof(bytes));
+        if (socket_send_vectored(s, all, n + 1) < 0) Failed = true;
+
+        all[0] = {};
+        first += n;
+    }
+    Count = 0;
+}
+
+void socket_writer::flush() {
+    if (!Count) return;
+
+    net_socket s = {Socket, socket_type::TCP};
+    if (socket_send(s, Buffer, Count) < 0) Failed = true;
+    Count = 0;
+}
+
+s64 socket_reader::read_source(byte *dest, s64 size) {
+    net_socket s = {Socket, socket_type::TCP};
+
+    s64 n = socket_recv(s, dest, size);
+    if (n < 0) {
+        Failed = true;
+        return 0;
+    }
+    return n;
+}
+
+//
+// Event-driven I/O
+//
+
+// Does as much of the request as the socket allows without blocking. Returns false if it has to wait.
+file_scope bool net_try(net_request *r) {
+    int fd = (int) r->Socket->Handle;
+
+    if (r->Op == net_op::Recv) {
+        while (true) {
+            ssize_t n = recv(fd, r->Data, r->Size, 0);
+            if (n >= 0) {
+                r->Transferred = n;
+                return true;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+            r->Error = errno;
+            return true;
+        }
+    }
+
+    // A send is done when all of it went out
+    while (r->Transferred < r->Size) {
+        ssize_t n = send(fd, r->Data + r->Transferred, r->Size - r->Transferred, NET_SEND_FLAGS);
+        if (n >= 0) {
+            r->Transferred += n;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+        r->Error = errno;
+        return true;
+    }
+    return true;
+}
+
+// Moves the requests at the front of the queue which can be done now to _done_
+file_scope void net_drain(net_request *&head, net_request *&tail, net_request *&done, net_request *&doneTail) {
+    while (head && net_try(head)) {
+        auto *r = head;
+        head    = r->NextPending;
+        if (!head) tail = null;
+
+        r->NextPending = null;
+        if (doneTail) {
+            doneTail->NextPending = r;
+        } else {
+            done = r;
+        }
+        doneTail = r;
+    }
+}
+
+// Returns how many requests were done
+file_scope s64 net_on_ready(s64 fd, bool readable, bool writable) {
+    auto *st = net_get_state(fd, false);
+    if (!st) return 0;
+
+    net_request *done = null, *doneTail = null;
+    {
+        thread::scoped_lock _(&st->Lock);
+        if (readable) net_drain(st->Recv, st->RecvTail, done, doneTail);
+        if (writable) net_drain(st->Send, st->SendTail, done, doneTail);
+    }
+
+    s64 count = 0;
+    for (auto *r = done; r; r = r->NextPending) ++count;
+
+    net_finish_list(done);
+    return count;
+}
+
+// Returns false if the poller was told to stop
+file_scope bool net_dequeue(net_poller &p, s32 timeoutMs, s64 *completed) {
+    bool stop = false;
+
+#if OS == LINUX
+    epoll_event events[NET_EVENTS_PER_WAIT];
+
+    int count = epoll_wait((int) p.Handle, events, NET_EVENTS_PER_WAIT, timeoutMs);
+    For(range(count > 0 ? count : 0)) {
+        auto &e = events[it];
+        if (e.data.fd == p.WakeFd) {
+            stop = true;
+            continue;
+        }
+
+        // Errors and hang ups wake both directions, the retried calls report them
+        bool failed = e.events & (EPOLLERR | EPOLLHUP);
+        s64 done = net_on_ready(e.data.fd, failed || (e.events & (EPOLLIN | EPOLLRDHUP)), failed || (e.events & EPOLLOUT));
+        if (completed) *completed += done;
+    }
+#elif OS == MACOS
+    struct kevent events[NET_EVENTS_PER_WAIT];
+
+    timespec timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000};
+
+    int count = kevent((int) p.Handle, null, 0, events, NET_EVENTS_PER_WAIT, timeoutMs < 0 ? null : &timeout);
+    For(range(count > 0 ? count : 0)) {
+        auto &e = events[it];
+        if (e.filter == EVFILT_USER) {
+            stop = true;
+            continue;
+        }
+
+        bool failed = e.flags & (EV_EOF | EV_ERROR);
+        s64 done = net_on_ready((s64) e.ident, failed || e.filter == EVFILT_READ, failed || e.filter == EVFILT_WRITE);
+        if (completed) *completed += done;
+    }
+#endif
+    return !stop;
+}
+
+file_scope void net_poller_thread(void *data) {
+    auto *p = (net_poller *) data;
+    while (net_dequeue(*p, -1, null)) {
+    }
+}
+
+bool net_poller_init(net_poller &p, s64 threads) {
+    assert(p.Handle == -1 && "Already initialized, call free() first");
+
+#if OS == LINUX
+    p.Handle = epoll_create1(EPOLL_CLOEXEC);
+    if (p.Handle == -1) {
+        internal::posix_report_errno("epoll_create1");
+        return false;
+    }
+
+    // Level-triggered and never read, so it wakes every thread
+    p.WakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event e;
+    zero_memory(&e, sizeof(e));
+    e.events  = EPOLLIN;
+    e.data.fd = (int) p.WakeFd;
+    if (p.WakeFd == -1 || epoll_ctl((int) p.Handle, EPOLL_CTL_ADD, (int) p.WakeFd, &e) == -1) {
+        internal::posix_report_errno("eventfd");
+        if (p.WakeFd != -1) close((int) p.WakeFd);
+        close((int) p.Handle);
+        p.Handle = p.WakeFd = -1;
+        return false;
+    }
+#elif OS == MACOS
+    p.Handle = kqueue();
+    if (p.Handle == -1) {
+        internal::posix_report_errno("kqueue");
+        return false;
+    }
+
+    // Not EV_CLEAR, once triggered it stays so and wakes every thread
+    struct kevent e;
+    EV_SET(&e, 0, EVFILT_USER, EV_ADD, 0, 0, null);
+    kevent((int) p.Handle, &e, 1, null, 0, null);
+#endif
+
+    p.InFlight    = 0;
+    p.ThreadCount = threads;
+    if (threads) {
+        p.Threads = allocate_array<thread::thread>(threads);
+        For(range(threads)) p.Threads[it].init_and_launch(net_poller_thread, &p);
+    }
+    return true;
+}
+
+void free(net_poller &p) {
+    if (p.Handle == -1) return;
+
+    while (atomic_load(&p.InFlight)) {
+        if (p.ThreadCount) {
+            thread::sleep(1);
+        } else {
+            net_poll(p, 1);
+        }
+    }
+
+#if OS == LINUX
+    u64 one = 1;
+    ssize_t written = write((int) p.WakeFd, &one, sizeof(one));
+    (void) written;
+#elif OS == MACOS
+    struct kevent e;
+    EV_SET(&e, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, null);
+    kevent((int) p.Handle, &e, 1, null, 0, null);
+#endif
+
+    For(range(p.ThreadCount)) p.Threads[it].wait();
+    free(p.Threads);
+
+    if (p.WakeFd != -1) close((int) p.WakeFd);
+    close((int) p.Handle);
+
+    p.Handle = p.WakeFd = -1;
+    p.Threads           = null;
+    p.ThreadCount       = 0;
+}
+
+bool net_poller_attach(net_poller &p, net_socket &s) {
+    if (!net_get_state(s.Handle, true)) {
+        internal::platform_report_error("The socket's descriptor is too big for the poller");
+        return false;
+    }
+
+    int fd = (int) s.Handle;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#if OS == LINUX
+    epoll_event e;
+    zero_memory(&e, sizeof(e));
+    e.events  = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    e.data.fd = fd;
+    if (epoll_ctl((int) p.Handle, EPOLL_CTL_ADD, fd, &e) == -1) {
+        internal::posix_report_errno("epoll_ctl");
+        return false;
+    }
+#elif OS == MACOS
+    struct kevent e[2];
+    EV_SET(&e[0], fd, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, null);
+    EV_SET(&e[1], fd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, null);
+    if (kevent((int) p.Handle, e, 2, null, 0, null) == -1) {
+        internal::posix_report_errno("kevent");
+        return false;
+    }
+#endif
+    return true;
+}
+
+void net_submit(net_poller &p, net_request *r) {
+    assert(r->Socket && r->Socket->Handle != -1 && "Request has no socket");
+
+    auto *st = net_get_state(r->Socket->Handle, false);
+    assert(st && "Socket isn't attached to a poller");
+
+    r->Transferred = 0;
+    r->Error       = 0;
+    r->Done        = 0;
+    r->Poller      = &p;
+    r->NextPending = null;
+
+    atomic_add(&p.InFlight, (s64) 1);
+
+    // Tried and queued under the lock, so an edge which comes in between finds the request queued
+    {
+        thread::scoped_lock _(&st->Lock);
+
+        auto *&head = r->Op == net_op::Recv ? st->Recv : st->Send;
+        auto *&tail = r->Op == net_op::Recv ? st->RecvTail : st->SendTail;
+
+        if (head || !net_try(r)) {
+            if (tail) {
+                tail->NextPending = r;
+            } else {
+                head = r;
+            }
+            tail = r;
+            return;
+        }
+    }
+    net_finish(r);
+}
+
+s64 net_poll(net_poller &p, u32 timeoutMs) {
+    s64 completed = 0;
+    net_dequeue(p, (s32) timeoutMs, &completed);
+    return completed;
+}
+
+void net_wait(net_poller &p, net_request *request) {
+    while (!atomic_load(&request->Done)) {
+        if (p.ThreadCount) {
+            thread::sleep(0);
+        } else {
+            net_poll(p, 1);
+        }
+    }
+}
+
+#endif
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,353 @@
+module;
+
+#include "lstd/memory/delegate.h"
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+#include "lstd/types/windows.h"  // Declarations of Win32 functions
+
+//
+// Asynchronous file reads and writes on top of an I/O completion port.
+//
+// The functions in path.nt block until the OS is done. Here you hand requests to the OS and carry on,
+// which is what it takes to keep the hundreds of reads in flight an NVMe drive needs to run at full speed.
+//
+//     async_io io;
+//     async_io_init(io);
+//     defer(free(io));
+//
+//     auto file = async_io_open(io, "data.bin");
+//     defer(free(file));
+//
+//     async_io_request requests[512];
+//     For(range(512)) {
+//         auto *r     = requests + it;
+//         r->File     = &file;
+//         r->Offset   = it * 64_KiB;
+//         r->Data     = buffer + it * 64_KiB;
+//         r->Size     = 64_KiB;
+//         r->Callback = &on_read;  // Optional, you can also async_io_wait on the request
+//         async_io_queue(io, r);
+//     }
+//     async_io_submit(io);  // One batch
+//
+// Completions are collected either by completion threads the engine starts (callbacks run there) or, with 0 of
+// them, by whoever calls async_io_poll - a main loop or a worker of your own job system.
+//
+// At most _MaxInFlight_ requests are given to the OS at a time, the rest wait in the queue and are submitted
+// from the completion side as earlier ones finish, so you can queue a whole file's worth of reads at once.
+//
+
+export module os.win64.async_io;
+
+import os.win64.memory;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    enum class async_io_op {
+        Read = 0,
+        Write,
+    };
+
+    // A file opened with async_io_open, associated with the engine's completion port.
+    struct async_io_file {
+        void *Handle = null;  // null if opening failed
+        s64 Size     = 0;     // When it was opened
+    };
+
+    //
+    // One read or write. Requests are owned by the caller (the engine doesn't allocate per request),
+    // they must stay alive and not move until they are done. Queue one again to reuse it.
+    //
+    struct async_io_request {
+        // The OVERLAPPED the OS works with. It's first, so we get the request back from the completion.
+        alignas(8) byte PlatformRequest[32]{};
+
+        // Filled by the caller
+        async_io_file *File = null;
+        async_io_op Op      = async_io_op::Read;
+        s64 Offset          = 0;
+        byte *Data          = null;
+        s64 Size            = 0;  // Less than 4 GiB, one ReadFile/WriteFile
+
+        // Runs on the thread which collected the completion (a completion thread or one calling async_io_poll)
+        delegate<void(async_io_request *)> Callback;
+        void *UserData = null;
+
+        // Results
+        s64 Transferred = 0;  // Less than _Size_ for a read which reached the end of the file
+        u32 Error       = 0;  // Win32 error code, 0 on success
+
+        // Set (right before _Callback_ runs) when the request is done, read it with atomic_load.
+        // If you async_io_wait on a request, don't also reuse it from its callback.
+        s32 Done = 0;
+
+        async_io_request *NextQueued = null;
+    };
+
+    struct async_io {
+        void *Port = null;
+
+        s64 MaxInFlight = 0;
+        s64 InFlight    = 0;  // Given to the OS and not completed yet, atomic
+
+        // Queued and not submitted yet
+        thread::mutex QueueMutex;
+        async_io_request *QueueHead = null, *QueueTail = null;
+
+        thread::thread *Threads = null;
+        s64 ThreadCount         = 0;
+    };
+
+    // Creates the completion port and starts _completionThreads_ threads which wait for completions and run callbacks.
+    // With 0 threads nothing completes until you call async_io_poll.
+    // _maxInFlight_ caps how many requests the OS has at once.
+    bool async_io_init(async_io &io, s64 completionThreads = 1, s64 maxInFlight = 256);
+
+    // Submits everything still queued, waits for all of it to complete, stops the threads and closes the port.
+    void free(async_io &io);
+
+    // Opens _path_ for async requests. With _write_ the file is opened for writing too (created if it doesn't exist).
+    [[nodiscard("Leak")]] async_io_file async_io_open(async_io &io, const string &path, bool write = false);
+
+    // Requests on the file must be done before closing it.
+    void free(async_io_file &file);
+
+    // Adds _request_ to the queue. Nothing reaches the OS until async_io_submit, so you can build a batch first.
+    void async_io_queue(async_io &io, async_io_request *request);
+
+    // Gives queued requests to the OS, as many as fit under _MaxInFlight_.
+    void async_io_submit(async_io &io);
+
+    // Collects completions on the calling thread and runs their callbacks. Waits up to _timeoutMs_ for the first one.
+    // Returns how many requests completed.
+    s64 async_io_poll(async_io &io, u32 timeoutMs = 0);
+
+    // Blocks until _request_ is done (polls for it if there are no completion threads).
+    void async_io_wait(async_io &io, async_io_request *request);
+}
+
+// Completion keys
+constexpr ULONG_PTR ASYNC_IO_KEY_IO     = 0;
+constexpr ULONG_PTR ASYNC_IO_KEY_FAILED = 1;  // Failed before reaching the OS, we posted it ourselves with _Error_ already set
+constexpr ULONG_PTR ASYNC_IO_KEY_STOP   = 2;  // Tells a completion thread to exit
+
+constexpr s64 ASYNC_IO_ENTRIES_PER_WAIT = 64;
+
+static_assert(sizeof(OVERLAPPED) <= sizeof(async_io_request::PlatformRequest));
+
+void async_io_issue(async_io &io, async_io_request *r) {
+    assert(r->File && r->File->Handle && "Request has no file");
+    assert(r->Size >= 0 && r->Size <= numeric_info<u32>::max() && "Request is too big for one read/write");
+
+    auto *o = (OVERLAPPED *) r->PlatformRequest;
+    zero_memory(o, sizeof(OVERLAPPED));
+    o->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset     = (DWORD) r->Offset;
+    o->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD) (r->Offset >> 32);
+
+    BOOL ok;
+    if (r->Op == async_io_op::Read) {
+        ok = ReadFile((HANDLE) r->File->Handle, r->Data, (DWORD) r->Size, null, o);
+    } else {
+        ok = WriteFile((HANDLE) r->File->Handle, r->Data, (DWORD) r->Size, null, o);
+    }
+
+    // Completing right away still posts to the port, so only failures need handling here
+    if (!ok) {
+        DWORD error = GetLastError();
+        if (error == ERROR_IO_PENDING) return;
+
+        r->Error = error == ERROR_HANDLE_EOF ? 0 : error;
+        PostQueuedCompletionStatus((HANDLE) io.Port, 0, ASYNC_IO_KEY_FAILED, o);
+    }
+}
+
+void async_io_complete(async_io &io, const OVERLAPPED_ENTRY &entry) {
+    auto *r = (async_io_request *) entry.lpOverlapped;
+
+    r->Transferred = entry.dwNumberOfBytesTransferred;
+    if (entry.lpCompletionKey == ASYNC_IO_KEY_IO) {
+        DWORD transferred;
+        if (GetOverlappedResult((HANDLE) r->File->Handle, entry.lpOverlapped, &transferred, false)) {
+            r->Error = 0;
+        } else {
+            DWORD error = GetLastError();
+            r->Error    = error == ERROR_HANDLE_EOF ? 0 : error;
+        }
+    }
+
+    atomic_add(&io.InFlight, (s64) -1);
+
+    atomic_store(&r->Done, 1);
+    if (r->Callback) r->Callback(r);
+
+    // Room for more, keep the OS busy
+    if (atomic_load(&io.QueueHead)) async_io_submit(io);
+}
+
+// Returns false if a stop packet was among the completions
+bool async_io_dequeue(async_io &io, u32 timeoutMs, s64 *completed) {
+    OVERLAPPED_ENTRY entries[ASYNC_IO_ENTRIES_PER_WAIT];
+
+    ULONG count = 0;
+    if (!GetQueuedCompletionStatusEx((HANDLE) io.Port, entries, ASYNC_IO_ENTRIES_PER_WAIT, &count, timeoutMs, false)) return true;  // Timed out
+
+    bool stop = false;
+    For(range(count)) {
+        if (entries[it].lpCompletionKey == ASYNC_IO_KEY_STOP) {
+            stop = true;
+            continue;
+        }
+        async_io_complete(io, entries[it]);
+        if (completed) ++*completed;
+    }
+    return !stop;
+}
+
+void async_io_thread(void *data) {
+    auto *io = (async_io *) data;
+    while (async_io_dequeue(*io, INFINITE, null)) {
+    }
+}
+
+bool async_io_init(async_io &io, s64 completionThreads, s64 maxInFlight) {
+    assert(!io.Port && "Already initialized, call free() first");
+    assert(maxInFlight > 0);
+
+    io.Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, null, 0, 0);
+    if (!io.Port) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateIoCompletionPort(INVALID_HANDLE_VALUE, null, 0, 0)");
+        return false;
+    }
+
+    io.MaxInFlight = maxInFlight;
+    io.InFlight    = 0;
+    io.QueueHead = io.QueueTail = null;
+    io.QueueMutex.init();
+
+    io.ThreadCount = completionThreads;
+    if (completionThreads) {
+        io.Threads = allocate_array<thread::thread>(completionThreads);
+        For(range(completionThreads)) io.Threads[it].init_and_launch(async_io_thread, &io);
+    }
+    return true;
+}
+
+void free(async_io &io) {
+    if (!io.Port) return;
+
+    async_io_submit(io);
+    while (atomic_load(&io.InFlight) || atomic_load(&io.QueueHead)) {
+        if (io.ThreadCount) {
+            thread::sleep(1);
+        } else {
+            async_io_poll(io, 1);
+        }
+    }
+
+    For(range(io.ThreadCount)) PostQueuedCompletionStatus((HANDLE) io.Port, 0, ASYNC_IO_KEY_STOP, null);
+    For(range(io.ThreadCount)) io.Threads[it].wait();
+    free(io.Threads);
+
+    CloseHandle((HANDLE) io.Port);
+    io.QueueMutex.release();
+
+    io.Port        = null;
+    io.Threads     = null;
+    io.ThreadCount = 0;
+}
+
+[[nodiscard("Leak")]] async_io_file async_io_open(async_io &io, const string &path, bool write) {
+    DWORD access      = write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    DWORD disposition = write ? OPEN_ALWAYS : OPEN_EXISTING;
+
+    HANDLE file = CreateFileW(internal::platform_utf16_temp(path), access, FILE_SHARE_READ, null, disposition, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, null);
+    if (file == INVALID_HANDLE_VALUE) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateFileW");
+        return {};
+    }
+
+    if (!CreateIoCompletionPort(file, (HANDLE) io.Port, ASYNC_IO_KEY_IO, 0)) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateIoCompletionPort");
+        CloseHandle(file);
+        return {};
+    }
+
+    LARGE_INTEGER size = {0};
+    GetFileSizeEx(file, &size);
+
+    async_io_file result;
+    result.Handle = file;
+    result.Size   = size.QuadPart;
+    return result;
+}
+
+void free(async_io_file &file) {
+    if (file.Handle) CloseHandle((HANDLE) file.Handle);
+    file = {};
+}
+
+void async_io_queue(async_io &io, async_io_request *request) {
+    request->Transferred = 0;
+    request->Error       = 0;
+    request->Done        = 0;
+    request->NextQueued  = null;
+
+    thread::scoped_lock _(&io.QueueMutex);
+    if (io.QueueTail) {
+        io.QueueTail->NextQueued = request;
+    } else {
+        io.QueueHead = request;
+    }
+    io.QueueTail = request;
+}
+
+void async_io_submit(async_io &io) {
+    // Take what fits under the lock, talk to the OS without it
+    async_io_request *batch = null;
+    {
+        thread::scoped_lock _(&io.QueueMutex);
+
+        s64 room = io.MaxInFlight - atomic_load(&io.InFlight);
+        if (room <= 0 || !io.QueueHead) return;
+
+        batch = io.QueueHead;
+
+        auto *last = batch;
+        s64 count  = 1;
+        while (count < room && last->NextQueued) {
+            last = last->NextQueued;
+            ++count;
+        }
+
+        io.QueueHead = last->NextQueued;
+        if (!io.QueueHead) io.QueueTail = null;
+        last->NextQueued = null;
+
+        atomic_add(&io.InFlight, count);
+    }
+
+    while (batch) {
+        auto *next = batch->NextQueued;  // The request may complete (and be reused) as soon as it's issued
+        async_io_issue(io, batch);
+        batch = next;
+    }
+}
+
+s64 async_io_poll(async_io &io, u32 timeoutMs) {
+    s64 completed = 0;
+    async_io_dequeue(io, timeoutMs, &completed);
+    return completed;
+}
+
+void async_io_wait(async_io &io, async_io_request *request) {
+    while (!atomic_load(&request->Done)) {
+        if (io.ThreadCount) {
+            thread::sleep(0);
+        } else {
+            async_io_poll(io, 1);
+        }
+    }
+}
+
+LSTD_END_NAMESPACE
@@ -4,6 +4,7 @@ module;
 #include "lstd/memory/array.h"
 #include "lstd/memory/delegate.h"
 #include "lstd/memory/string.h"
+#include "lstd/profiler.h"
 #include "lstd/types/windows.h"  // Declarations of Win32 functions
 
 //
@@ -54,6 +55,18 @@ export {
     // Converts a time stamp acquired by os_get_time() to seconds
     f64 os_time_to_seconds(time_t time);
 
+    // Converts a time stamp (or a difference of two) acquired by os_get_time() to nanoseconds, in integers.
+    // See os.clock for cheaper time stamps.
+    s64 os_time_to_nanoseconds(time_t time);
+
+    // The wall clock: nanoseconds since 1970-01-01 00:00:00 UTC (with the precision of the system clock).
+    // Unlike os_get_time() this can jump, when the clock is set or synced. See date_time.h for the calendar.
+    s64 os_get_wall_time_ns();
+
+    // How many seconds local time is ahead of UTC (negative west of Greenwich), for _unixSeconds_ since the epoch.
+    // Windows applies the daylight saving rule which is in effect now (not the one at _unixSeconds_).
+    s32 os_get_utc_offset(s64 unixSeconds);
+
     //
     // Note: The functions above don't have the "os_" prefix because they are not really doing stuff with the OS.
     // The functions below have the "os_" prefix and can be easily queried with autocomplete.
@@ -84,6 +97,9 @@ export {
     // Returns an ID which uniquely identifies the current process on the system
     u32 os_get_pid();
 
+    // Returns the largest amount of physical memory (in bytes) the process has used so far (peak working set / RSS).
+    s64 os_get_peak_memory_usage();
+
     // Reads input from the console (at most 1 KiB).
     // Subsequent calls overwrite an internal buffer, so you need to save the information before that.
     // Note: Don't free the result of this function.
@@ -128,6 +144,8 @@ struct win64_common_state {
     thread::mutex ExitScheduleMutex;        // Used when modifying the ExitFunctions array
 
     LARGE_INTEGER PerformanceFrequency;  // Used to time stuff
+    f64 SecondsPerTick;                  // 1 / PerformanceFrequency, so converting is a multiply
+    s64 NanosecondsPerTick;              // 0 if the frequency doesn't divide 1e9 (it's 10 MHz on every modern Windows)
 
     string ModuleName;  // Caches the module name (retrieve this with os_get_current_module())
 
@@ -135,6 +153,9 @@ struct win64_common_state {
     thread::mutex WorkingDirMutex;
 
     array<string> Argv;
+
+    // These parts are set up on first use, see platform_init_once()
+    s32 ConsoleInit, ModuleNameInit, ArgvInit, PerformanceFrequencyInit;
 };
 
 // :GlobalStateNoConstructors:
@@ -157,17 +178,19 @@ string utf16_to_utf8(const utf16 *str, allocator alloc = {}) { return internal::
 
 void report_warning_no_allocations(string message) {
     DWORD ignored;
+    HANDLE cerrHandle = GetStdHandle(STD_ERROR_HANDLE);  // The console may not be set up yet (or be setting up)
 
     string preMessage = ">>> Warning (in windows_common.cpp): ";
-    WriteFile(S->CerrHandle, preMessage.Data, (DWORD) preMessage.Count, &ignored, null);
+    WriteFile(cerrHandle, preMessage.Data, (DWORD) preMessage.Count, &ignored, null);
 
-    WriteFile(S->CerrHandle, message.Data, (DWORD) message.Count, &ignored, null);
+    WriteFile(cerrHandle, message.Data, (DWORD) message.Count, &ignored, null);
 
     string postMessage = ".\n";
-    WriteFile(S->CerrHandle, postMessage.Data, (DWORD) postMessage.Count, &ignored, null);
+    WriteFile(cerrHandle, postMessage.Data, (DWORD) postMessage.Count, &ignored, null);
 }
 
 extern "C" bool lstd_init_global();
+extern "C" bool lstd_profile_startup();
 
 // This zeroes out the global variables (stored in State) and initializes the mutexes
 void init_global_vars() {
@@ -185,7 +208,7 @@ void init_global_vars() {
     if (lstd_init_global()) {
         DEBUG_memory = allocate<debug_memory>({.Alloc = PERSISTENT});  // @Leak This is ok
         new (DEBUG_memory) debug_memory;
-        DEBUG_memory->Mutex.init();
+        DEBUG_memory->init();
     } else {
         DEBUG_memory = null;
     }
@@ -193,6 +216,8 @@ void init_global_vars() {
 }
 
 void setup_console() {
+    PROFILE_FUNCTION();
+
     if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
         AllocConsole();
 
@@ -223,6 +248,8 @@ void setup_console() {
 constexpr u32 ERROR_INSUFFICIENT_BUFFER = 122;
 
 void get_module_name() {
+    PROFILE_FUNCTION();
+
     // Get the module name
     utf16 *buffer = allocate_array<utf16>(MAX_PATH, {.Alloc = PERSISTENT});
     defer(free(buffer));
@@ -249,6 +276,8 @@ void get_module_name() {
 }
 
 void parse_arguments() {
+    PROFILE_FUNCTION();
+
     // Get the arguments
     utf16 **argv;
     s32 argc;
@@ -271,6 +300,16 @@ void parse_arguments() {
     For(range(1, argc)) array_append(S->Argv, utf16_to_utf8(argv[it], PERSISTENT));
 }
 
+void get_performance_frequency() {
+    QueryPerformanceFrequency(&S->PerformanceFrequency);
+
+    s64 frequency         = S->PerformanceFrequency.QuadPart;
+    S->SecondsPerTick     = 1.0 / frequency;
+    S->NanosecondsPerTick = 1000000000 % frequency == 0 ? 1000000000 / frequency : 0;
+}
+
+always_inline void console_init() { internal::platform_init_once(&S->ConsoleInit, setup_console); }
+
 export namespace internal {
 
 // This needs to be called when our program runs, but also when a new thread starts!
@@ -285,18 +324,22 @@ void platform_init_context() {
 }
 
 //
-// Initializes the state we need to function.
+// Initializes the state we need to function. This runs before main (and before the constructors of global variables),
+// so it only does what can't wait. The platform allocators, the console, the module name, the arguments and the
+// frequency of the performance counter are set up the first time they are needed (see platform_init_once()).
+//
+// :StartupProfile: If lstd_profile_startup() returns true (see windows_common.cpp) and LSTD_PROFILER is defined,
+// we start the profiler here, so the zones of the startup (and of everything lazily initialized later) are recorded.
+// Call profiler_stop() and export them wherever you like, e.g. at the top of main.
 //
 void platform_init_global_state() {
-    init_global_vars();
+    get_cpu_features();  // Detect them before anything picks a SIMD path
 
-    setup_console();
-
-    get_module_name();
-
-    parse_arguments();
+    init_global_vars();
 
-    QueryPerformanceFrequency(&S->PerformanceFrequency);
+#if defined LSTD_PROFILER
+    if (lstd_profile_startup()) profiler_start();
+#endif
 }
 
 //
@@ -317,6 +360,10 @@ void platform_uninit_state() {
     }
 #endif
 
+    // Output in FULL buffering mode is still waiting in the buffers
+    cout.force_flush();
+    cerr.force_flush();
+
     // Uninit mutexes
     S->CinMutex.release();
     S->CoutMutex.release();
@@ -324,12 +371,82 @@ void platform_uninit_state() {
     S->WorkingDirMutex.release();
 #if defined DEBUG_MEMORY
     if (lstd_init_global()) {
-        DEBUG_memory->Mutex.release();
+        DEBUG_memory->release();
     }
 #endif
 }
 }  // namespace internal
 
+HANDLE console_writer_handle(console_writer *w) { return w->OutputType == console_writer::COUT ? S->CoutHandle : S->CerrHandle; }
+
+// Called on first use and after set_buffering(), resolves AUTO and picks the buffer
+// One ReadFile of at most _size_ bytes from stdin, 0 at the end of the input (or on error). Expects CinMutex to be locked.
+s64 console_read(byte *dest, s64 size) {
+    cout.force_flush();  // The prompt may be sitting in the buffer
+    console_init();
+
+    // ReadFile takes a 32 bit size
+    DWORD read = 0;
+    if (!ReadFile(S->CinHandle, dest, (DWORD) min(size, (s64) 0xFFFFFFFF), &read, null)) return 0;
+    return (s64) read;
+}
+
+void console_writer_init_buffer(console_writer *w) {
+    console_init();
+
+    DWORD mode;
+    w->IsTerminal = GetConsoleMode(console_writer_handle(w), &mode);  // Fails for pipes and files
+
+    if (w->Buffering == console_writer::AUTO) {
+        w->Buffering = w->IsTerminal || w->OutputType == console_writer::CERR ? console_writer::LINE : console_writer::FULL;
+    }
+
+    s64 size = w->RequestedBufferSize;
+    if (!size) size = w->Buffering == console_writer::FULL ? console_writer::PIPE_BUFFER_SIZE : S->CONSOLE_BUFFER_SIZE;
+
+    if (size <= S->CONSOLE_BUFFER_SIZE) {
+        w->Buffer = w->OutputType == console_writer::COUT ? S->CoutBuffer : S->CerrBuffer;
+        size      = S->CONSOLE_BUFFER_SIZE;
+    } else {
+        w->Buffer = allocate_array<byte>(size, {.Alloc = PERSISTENT});
+    }
+
+    w->Current    = w->Buffer;
+    w->BufferSize = w->Available = size;
+}
+
+void console_writer_write_out(console_writer *w) {
+    s64 size = w->BufferSize - w->Available;
+    if (!size) return;
+
+    DWORD ignored;
+    WriteFile(console_writer_handle(w), w->Buffer, (DWORD) size, &ignored, null);
+
+    w->Current   = w->Buffer;
+    w->Available = w->BufferSize;
+}
+
+// Expects the lock to be held
+void console_writer_append(console_writer *w, const byte *data, s64 size) {
+    if (!w->Buffer) console_writer_init_buffer(w);
+
+    if (size > w->Available) {
+        console_writer_write_out(w);
+
+        if (size > w->BufferSize) {
+            // Doesn't fit in the buffer at all, don't copy it in pieces
+            DWORD ignored;
+            WriteFile(console_writer_handle(w), data, (DWORD) size, &ignored, null);
+            return;
+        }
+    }
+
+    copy_memory(w->Current, data, size);
+
+    w->Current += size;
+    w->Available -= size;
+}
+
 export {
     void exit(s32 exitCode) {
         // :PlatformExitTermination
@@ -366,10 +483,43 @@ export {
     }
 
     f64 os_time_to_seconds(time_t time) {
-        return (f64) time / S->PerformanceFrequency.QuadPart;
+        internal::platform_init_once(&S->PerformanceFrequencyInit, get_performance_frequency);
+        return (f64) time * S->SecondsPerTick;
+    }
+
+    s64 os_time_to_nanoseconds(time_t time) {
+        internal::platform_init_once(&S->PerformanceFrequencyInit, get_performance_frequency);
+        if (S->NanosecondsPerTick) return time * S->NanosecondsPerTick;
+
+        // Split so the multiply doesn't overflow
+        s64 frequency = S->PerformanceFrequency.QuadPart;
+        return time / frequency * 1000000000 + time % frequency * 1000000000 / frequency;
+    }
+
+    // FILETIME is in 100 ns since 1601-01-01
+    constexpr s64 FILETIME_UNIX_EPOCH = 116444736000000000;
+
+    s64 os_get_wall_time_ns() {
+        FILETIME ft;
+        GetSystemTimePreciseAsFileTime(&ft);
+        s64 ticks = (s64) (((u64) ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+        return (ticks - FILETIME_UNIX_EPOCH) * 100;
+    }
+
+    s32 os_get_utc_offset(s64 unixSeconds) {
+        u64 ticks = (u64) (unixSeconds * 10000000 + FILETIME_UNIX_EPOCH);
+
+        FILETIME utc, local;
+        utc.dwLowDateTime = (DWORD) ticks;
+        utc.dwHighDateTime = (DWORD) (ticks >> 32);
+        if (!FileTimeToLocalFileTime(&utc, &local)) return 0;
+
+        s64 localTicks = (s64) (((u64) local.dwHighDateTime << 32) | local.dwLowDateTime);
+        return (s32) ((localTicks - (s64) ticks) / 10000000);
     }
 
     string os_get_current_module() {
+        internal::platform_init_once(&S->ModuleNameInit, get_module_name);
         return S->ModuleName;
     }
 
@@ -394,7 +544,7 @@ export {
     void os_set_working_dir(const string &dir) {
         assert(path_is_absolute(dir));
 
-        WIN_CHECKBOOL(SetCurrentDirectoryW(utf8_to_utf16(dir)));
+        WIN_CHECKBOOL(SetCurrentDirectoryW(internal::platform_utf16_temp(dir)));
 
         thread::scoped_lock _(&S->WorkingDirMutex);
         PUSH_ALLOC(PERSISTENT) {
@@ -441,11 +591,11 @@ export {
             assert(false);
         }
 
-        WIN_CHECKBOOL(SetEnvironmentVariableW(utf8_to_utf16(name), utf8_to_utf16(value)));
+        WIN_CHECKBOOL(SetEnvironmentVariableW(internal::platform_utf16_temp(name), internal::platform_utf16_temp(value)));
     }
 
     void os_remove_env(const string &name) {
-        WIN_CHECKBOOL(SetEnvironmentVariableW(utf8_to_utf16(name), null));
+        WIN_CHECKBOOL(SetEnvironmentVariableW(internal::platform_utf16_temp(name), null));
     }
 
     [[nodiscard("Leak")]] string os_get_clipboard_content() {
@@ -499,53 +649,77 @@ export {
         CloseClipboard();
     }
 
-    array<string> os_get_command_line_arguments() { return S->Argv; }
+    array<string> os_get_command_line_arguments() {
+        internal::platform_init_once(&S->ArgvInit, parse_arguments);
+        return S->Argv;
+    }
 
     u32 os_get_pid() { return (u32) GetCurrentProcessId(); }
 
+    s64 os_get_peak_memory_usage() {
+        PROCESS_MEMORY_COUNTERS counters;
+        counters.cb = sizeof(counters);
+        if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return (s64) counters.PeakWorkingSetSize;
+    }
+
     bytes os_read_from_console() {
-        DWORD read;
-        ReadFile(S->CinHandle, S->CinBuffer, (DWORD) S->CONSOLE_BUFFER_SIZE, &read, null);
-        return bytes(S->CinBuffer, (s64) read);
+        thread::scoped_lock _(&S->CinMutex);
+        return bytes(S->CinBuffer, console_read(S->CinBuffer, S->CONSOLE_BUFFER_SIZE));
     }
 
+    s64 console_reader::read_source(byte *dest, s64 size) {
+        thread::scoped_lock _(&S->CinMutex);
+        return console_read(dest, size);
+    }
+
+    allocator console_reader::buffer_allocator() { return Alloc ? Alloc : PERSISTENT; }
+
     void console_writer::write(const byte *data, s64 size) {
         thread::mutex *mutex = null;
         if (LockMutex) mutex = &S->CoutMutex;
         thread::scoped_lock _(mutex);
 
-        if (size > Available) {
-            flush();
-        }
+        console_writer_append(this, data, size);
+    }
 
-        copy_memory(Current, data, size);
+    void console_writer::write_vectored(const bytes *spans, s64 count) {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
 
-        Current += size;
-        Available -= size;
+        For(range(count)) console_writer_append(this, spans[it].Data, spans[it].Count);
     }
 
     void console_writer::flush() {
+        if (Buffering != console_writer::LINE) return;  // FULL (or AUTO before the first write, so there is nothing to flush)
+        force_flush();
+    }
+
+    void console_writer::force_flush() {
         thread::mutex *mutex = null;
         if (LockMutex) mutex = &S->CoutMutex;
         thread::scoped_lock _(mutex);
 
-        if (!Buffer) {
-            if (OutputType == console_writer::COUT) {
-                Buffer = Current = S->CoutBuffer;
-            } else {
-                Buffer = Current = S->CerrBuffer;
-            }
+        if (Buffer) console_writer_write_out(this);
+    }
 
-            BufferSize = Available = S->CONSOLE_BUFFER_SIZE;
-        }
+    void console_writer::set_buffering(buffering mode, s64 bufferSize) {
+        thread::mutex *mutex = null;
+        if (LockMutex) mutex = &S->CoutMutex;
+        thread::scoped_lock _(mutex);
 
-        HANDLE target = OutputType == console_writer::COUT ? S->CoutHandle : S->CerrHandle;
+        if (Buffer) {
+            console_writer_write_out(this);
+            if (Buffer != S->CoutBuffer && Buffer != S->CerrBuffer) free(Buffer);
+        }
 
-        DWORD ignored;
-        WriteFile(target, Buffer, (DWORD)(BufferSize - Available), &ignored, null);
+        Buffer = Current = null;
+        Available = BufferSize = 0;
 
-        Current = Buffer;
-        Available = S->CONSOLE_BUFFER_SIZE;
+        // The next write picks the buffer
+        Buffering = mode;
+        RequestedBufferSize = bufferSize;
     }
 }
 
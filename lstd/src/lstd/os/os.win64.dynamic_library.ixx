@@ -1,11 +1,17 @@
 module;
 
+#include "lstd/memory/hash_table.h"
 #include "lstd/memory/string.h"
+#include "lstd/thread.h"
 #include "lstd/types/windows.h"  // Declarations of Win32 functions
 
 //
 // Simple wrapper around dynamic libraries and getting addresses of procedures.
 //
+// Symbols are cached per library. GetProcAddress searches the export table by name every time,
+// after the first lookup of a name it's a hash table lookup. For reloading a library while the program runs
+// see the os.hot_library module.
+//
 
 export module os.win64.dynamic_library;
 
@@ -20,25 +26,53 @@ wchar_t *utf8_to_utf16_temp(const string &str) { return utf8_to_utf16(str, {});
 
 export {
     struct dynamic_library_t {
+        void *Handle = null;  // HMODULE
+
+        hash_table<string, void *> Symbols;  // Looked up so far, misses too (as null)
+        thread::fast_mutex Lock;
     };
 
     using dynamic_library = dynamic_library_t *;
 
-    dynamic_library os_dynamic_library_load(const string &path) {
-        return (dynamic_library) LoadLibraryW(utf8_to_utf16_temp(path));
+    // Returns null if the library couldn't be loaded
+    [[nodiscard("Leak")]] dynamic_library os_dynamic_library_load(const string &path) {
+        HMODULE handle = LoadLibraryW(utf8_to_utf16_temp(path));
+        if (!handle) return null;
+
+        auto *library   = allocate<dynamic_library_t>();
+        library->Handle = (void *) handle;
+        return library;
     }
 
     // :OverloadFree: We follow the convention to overload the "free" function
     // as a standard way to release resources (may not be just memory blocks).
     void free(dynamic_library library) {
-        if (library) {
-            FreeLibrary((HMODULE) library);
-        }
+        if (!library) return;
+
+        FreeLibrary((HMODULE) library->Handle);
+
+        for (auto [k, v] : library->Symbols) free(*k);
+        free(library->Symbols);
+        free<dynamic_library_t>(library);  // Not this overload
     }
 
-    void *os_dynamic_library_get_symbol(dynamic_library library, const char *name) {
-        return (void *) GetProcAddress((HMODULE) library, name);
+    // Returns null if the library doesn't export _name_. Thread-safe.
+    void *os_dynamic_library_get_symbol(dynamic_library library, const string &name) {
+        thread::scoped_lock _(&library->Lock);
+
+        auto [kp, vp] = find(library->Symbols, name);
+        if (vp) return *vp;
+
+        void *address = (void *) GetProcAddress((HMODULE) library->Handle, string_to_c_string_temp(name));
+
+        string key;
+        clone(&key, name);
+        add(library->Symbols, key, address);
+
+        return address;
     }
+
+    void *os_dynamic_library_get_symbol(dynamic_library library, const char *name) { return os_dynamic_library_get_symbol(library, string(name)); }
 }
 
 LSTD_END_NAMESPACE
@@ -1,6 +1,7 @@
 module;
 
 #include "lstd/memory/string.h"
+#include "lstd/thread.h"
 #include "lstd/types/windows.h"  // Declarations of Win32 functions
 
 //
@@ -28,6 +29,48 @@ export {
     // Frees a memory block allocated by os_allocate_block()
     void os_free_block(void *ptr);
 
+    // Reserves a range of virtual address space without backing it with memory.
+    // The range must be committed (os_commit_memory()) before it is used. Returns null on failure.
+    // The size is rounded up to the allocation granularity of the OS.
+    [[nodiscard("Leak")]] void *os_reserve_memory(s64 size);
+
+    // Backs pages in a reserved range with memory. The memory is zeroed.
+    // _address_ and _size_ are rounded to page boundaries. Returns false on failure (e.g. out of memory).
+    bool os_commit_memory(void *address, s64 size);
+
+    // Gives the memory in the range back to the OS, but keeps the address space reserved.
+    void os_decommit_memory(void *address, s64 size);
+
+    // Tells the OS that the contents of the pages fully inside the range aren't needed anymore, unlike
+    // os_decommit_memory() the range stays accessible, so this works on any block (e.g. ones from os_allocate_block()).
+    // The pages are dropped from the working set, touching them again gives either the old contents or zeroes.
+    // Returns how many bytes that was.
+    s64 os_purge_memory(void *address, s64 size);
+
+    // Releases a range reserved with os_reserve_memory() (committed or not).
+    void os_release_memory(void *address);
+
+    struct os_allocate_large_block_result {
+        void *Block = null;
+        s64 PageSize = 0;  // The size of the pages backing the block, check this to see if we got large pages
+    };
+
+    // Allocates a block backed by large pages (usually 2 MiB), this reduces TLB misses for big pools which
+    // are handed to allocators. The size is rounded up to a multiple of the page size.
+    //
+    // Large pages require the "Lock pages in memory" privilege (SeLockMemoryPrivilege) which we try to enable
+    // the first time this is called. If that fails (or there are no contiguous physical pages available),
+    // we fall back to normal pages - check _PageSize_ in the result.
+    //
+    // Free the block with os_free_large_block() (NOT os_free_block()).
+    [[nodiscard("Leak")]] os_allocate_large_block_result os_allocate_large_block(s64 size);
+
+    void os_free_large_block(void *block);
+
+    // The size of a page and the granularity at which address space is reserved.
+    s64 os_get_page_size();
+    s64 os_get_allocation_granularity();
+
     // Creates/opens a shared memory block and writes data to it (use this for communication between processes)
     void os_write_shared_block(const string &name, void *data, s64 size);
 
@@ -84,10 +127,14 @@ export {
     }
 }
 
+struct win64_persistent_alloc_cache;
+
 struct win64_memory_state {
     allocator PersistentAlloc;  // Used to store global state, a tlsf allocator
     thread::mutex PersistentAllocMutex;
 
+    win64_persistent_alloc_cache *OrphanedPersistentCaches;  // Caches of threads which exited, see :RemoteFree:
+
     // We don't use the temporary allocator bundled with the Context because we don't want to mess with the user's memory.
     allocator TempAlloc;  // Used for temporary storage (e.g. converting strings from utf8 to utf16 for windows calls).
                           // Memory returned is only guaranteed to be valid until the next TempAlloc call, because we call free_all
@@ -95,6 +142,9 @@ struct win64_memory_state {
     void *TempStorageBlock;
     s64 TempStorageSize;
     thread::mutex TempAllocMutex;
+
+    // The blocks are created on first use, see platform_init_once()
+    s32 PersistentAllocInit, TempAllocInit;
 };
 
 // :GlobalStateNoConstructors:
@@ -106,7 +156,28 @@ byte State[sizeof(win64_memory_state)];
 void create_temp_storage_block(s64);
 void create_persistent_alloc_block(s64);
 
+// The starting sizes of the blocks, see windows_common.cpp
+extern "C" s64 lstd_persistent_storage_starting_size();
+extern "C" s64 lstd_temporary_storage_starting_size();
+
 export namespace internal {
+// Runs _init_ the first time it's called for _state_ (0 - not yet, 1 - in progress, 2 - done).
+// Other threads which get here meanwhile wait for it to finish.
+//
+// We initialize platform state this way instead of before main, a tool which runs for a few milliseconds
+// shouldn't pay for the console, the argument list, etc. if it never asks for them.
+template <typename F>
+always_inline void platform_init_once(s32 *state, F &&init) {
+    if (atomic_load(state) == 2) return;
+
+    if (atomic_compare_and_swap(state, 1, 0) == 0) {
+        init();
+        atomic_store(state, 2);
+    } else {
+        while (atomic_load(state) != 2) thread::sleep(0);
+    }
+}
+
 // @TODO: Add option to print call stack?
 void platform_report_warning(string message, source_location loc = source_location::current()) {
     print(">>> {!YELLOW}Platform warning{!} {}:{} (in function: {}): {}.\n", loc.File, loc.Line, loc.Function, message);
@@ -121,78 +192,360 @@ void platform_report_error(string message, source_location loc = source_location
 // An extension to the arena allocator. Calls free_all when not enough space. Because we are not running a game
 // there is no clear point at which to free_all the temporary allocator, that's why we assume that no allocation
 // made with TempAlloc should persist beyond the next allocation.
+//
+// thread::mutex isn't recursive, so nothing here goes through the allocator_* wrappers while holding
+// TempAllocMutex (they would come back to this function). Pools are added and removed with arena_allocator()
+// directly and free_all() runs after the lock is released.
 void *win64_temp_alloc(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
-    auto *data = (arena_allocator_data *) context;
+    void *result;
+    {
+        thread::scoped_lock _(&S->TempAllocMutex);
 
-    thread::scoped_lock _(&S->TempAllocMutex);
+        // Growing replaces the arena, _context_ may be the old one if another thread grew it meanwhile
+        context = S->TempAlloc.Context;
+
+        result = arena_allocator(mode, context, size, oldMemory, oldSize, options);
+        if (mode != allocator_mode::ALLOCATE || result) return result;
 
-    auto *result = arena_allocator(mode, context, size, oldMemory, oldSize, options);
-    if (mode == allocator_mode::ALLOCATE) {
         if (size > S->TempStorageSize) {
             // If we try to allocate a block with size bigger than the temporary storage block, we make a new, larger temporary storage block
-
-            internal::platform_report_warning("Not enough memory in the temporary allocator; expanding the pool");
-
-            allocator_remove_pool(S->TempAlloc, S->TempStorageBlock);
+            arena_allocator(allocator_mode::REMOVE_POOL, context, 0, S->TempStorageBlock, 0, 0);
             os_free_block((byte *) S->TempStorageBlock - sizeof(arena_allocator_data));
 
             create_temp_storage_block(size * 2);
-            result = arena_allocator(allocator_mode::ALLOCATE, context, size, null, 0, options);
-        } else if (!result) {
-            // If we couldn't allocate but the temporary storage block has enough space, we just call free_all
-            free_all(S->TempAlloc);
-            result = arena_allocator(allocator_mode::ALLOCATE, context, size, null, 0, options);
+            result = arena_allocator(allocator_mode::ALLOCATE, S->TempAlloc.Context, size, null, 0, options);
         }
     }
 
-    return result;
+    // Printing may allocate, so the warning comes after the lock is released
+    if (result) {
+        internal::platform_report_warning("Not enough memory in the temporary allocator; expanding the pool");
+        return result;
+    }
+
+    // If we couldn't allocate but the temporary storage block has enough space, we just call free_all.
+    // It comes back here with FREE_ALL (and under DEBUG_MEMORY unlinks the headers), so the lock is released first.
+    free_all({win64_temp_alloc, atomic_load(&S->TempAlloc.Context)});
+
+    thread::scoped_lock _(&S->TempAllocMutex);
+    return arena_allocator(allocator_mode::ALLOCATE, S->TempAlloc.Context, size, null, 0, options);
 }
 
+// Called with TempAllocMutex held (or before the allocator is handed out). The context is read without the lock
+// by platform_get_temporary_allocator(), so it's published with an atomic store after the pool is added.
 void create_temp_storage_block(s64 size) {
     // We allocate the arena allocator data and the starting pool in one big block in order to reduce fragmentation.
     auto [data, pool] = os_allocate_packed<arena_allocator_data>(size);
-    S->TempAlloc = {win64_temp_alloc, data};
-    allocator_add_pool(S->TempAlloc, pool, size);
+    arena_allocator(allocator_mode::ADD_POOL, data, size, pool, 0, 0);
+    atomic_store(&S->TempAlloc.Context, (void *) data);
 
     S->TempStorageBlock = pool;
     S->TempStorageSize = size;
 }
 
-void *win64_persistent_alloc(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
-    auto *data = (tlsf_allocator_data *) context;
+// Gives the persistent heap another pool. Called with PersistentAllocMutex held, so it goes to tlsf_allocator()
+// directly instead of through allocator_add_pool(), which would come back to the locked path below.
+void add_persistent_alloc_pool(s64 size) {
+    void *pool = os_allocate_block(size);
+    tlsf_allocator(allocator_mode::ADD_POOL, S->PersistentAlloc.Context, size, pool, 0, 0);
+}
+
+// The locked path, every call here goes straight to the shared tlsf heap.
+void *win64_persistent_alloc_locked(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    void *result;
+    bool grew = false;
+    {
+        thread::scoped_lock _(&S->PersistentAllocMutex);
+
+        result = tlsf_allocator(mode, context, size, oldMemory, oldSize, options);
+        if (mode == allocator_mode::ALLOCATE && !result) {
+            add_persistent_alloc_pool(size * 3);
+            result = tlsf_allocator(allocator_mode::ALLOCATE, context, size, null, 0, options);
+            grew   = true;
+        }
+    }
+
+    // Printing may allocate from this allocator, so not with the lock held
+    if (grew) internal::platform_report_warning("Not enough memory in the persistent allocator; adding a pool");
+    return result;
+}
 
+//
+// Every thread keeps a small cache (a magazine per size class) in front of the persistent allocator.
+// Allocations and frees of small blocks are served from thread-local free lists without touching the mutex.
+// When a free list underflows we take PERSISTENT_CACHE_BATCH blocks from tlsf at once, when it overflows
+// PERSISTENT_CACHE_CAPACITY we return a batch. So we lock once every PERSISTENT_CACHE_BATCH operations
+// instead of on every single one.
+//
+// Blocks in the cache are always allocated with the full size of their class, that's how we can hand
+// a block freed with any size of a class to any request of the same class.
+//
+// :RemoteFree: Every cached block is prefixed by a pointer to the cache which owns it. A block freed on another
+// thread (e.g. allocated by a producer and freed by a consumer) is pushed with a CAS onto a per-class list of
+// its owner, which takes the whole list at once when its free list runs empty. The freeing thread never takes
+// the lock and doesn't touch the free lists (or the tlsf metadata) of the owner.
+//
+// Caches are never freed. When a thread exits its cache is flushed, marked as orphaned and reused by the next
+// thread which starts. Remote frees which arrive at an orphaned cache are returned to tlsf by the thread freeing them.
+//
+constexpr s64 PERSISTENT_CACHE_GRANULARITY = 16;
+constexpr s64 PERSISTENT_CACHE_MAX_SIZE = 1_KiB;
+constexpr s64 PERSISTENT_CACHE_CLASS_COUNT = PERSISTENT_CACHE_MAX_SIZE / PERSISTENT_CACHE_GRANULARITY;
+constexpr s64 PERSISTENT_CACHE_CAPACITY = 32;
+constexpr s64 PERSISTENT_CACHE_BATCH = 16;
+constexpr s64 PERSISTENT_CACHE_PREFIX = sizeof(void *);  // The owner of the block
+
+struct win64_persistent_alloc_cache {
+    void *FreeLists[PERSISTENT_CACHE_CLASS_COUNT];  // The first 8 bytes of a free block point to the next one
+    s64 Counts[PERSISTENT_CACHE_CLASS_COUNT];
+
+    // Blocks owned by this cache which other threads freed. Stored as s64 because that's what our atomics work with.
+    s64 RemoteFrees[PERSISTENT_CACHE_CLASS_COUNT];
+
+    s32 Orphaned;  // Set when the owning thread exits
+    win64_persistent_alloc_cache *NextOrphan;
+};
+
+// Null until the thread allocates a small block.
+thread_local win64_persistent_alloc_cache *PersistentAllocCache;
+
+always_inline s64 persistent_cache_class(s64 size) { return (size + PERSISTENT_CACHE_GRANULARITY - 1) / PERSISTENT_CACHE_GRANULARITY - 1; }
+
+always_inline win64_persistent_alloc_cache *persistent_cache_owner(void *block) { return *((win64_persistent_alloc_cache **) block - 1); }
+
+// Returns the cache of the calling thread, reuses an orphaned one if there is any.
+win64_persistent_alloc_cache *persistent_cache_get(void *context) {
+    if (PersistentAllocCache) return PersistentAllocCache;
+
+    win64_persistent_alloc_cache *cache;
+    {
+        thread::scoped_lock _(&S->PersistentAllocMutex);
+
+        cache = S->OrphanedPersistentCaches;
+        if (cache) S->OrphanedPersistentCaches = cache->NextOrphan;
+    }
+
+    if (cache) {
+        cache->NextOrphan = null;
+        atomic_swap(&cache->Orphaned, 0);
+    } else {
+        // The locked path adds a pool if the heap is full
+        cache = (win64_persistent_alloc_cache *) win64_persistent_alloc_locked(allocator_mode::ALLOCATE, context, sizeof(win64_persistent_alloc_cache), null, 0, 0);
+        zero_memory(cache, sizeof(win64_persistent_alloc_cache));
+    }
+
+    PersistentAllocCache = cache;
+    return cache;
+}
+
+// Frees a cached block straight to tlsf. Expects the persistent allocator to be locked.
+void persistent_cache_free_to_heap(void *context, void *block) {
+    tlsf_allocator(allocator_mode::FREE, context, 0, (byte *) block - PERSISTENT_CACHE_PREFIX, 0, 0);
+}
+
+// Returns _count_ blocks from the free list of class _c_ to the shared heap.
+void persistent_cache_release(win64_persistent_alloc_cache *cache, void *context, s64 c, s64 count) {
     thread::scoped_lock _(&S->PersistentAllocMutex);
+    while (count-- && cache->FreeLists[c]) {
+        void *block = cache->FreeLists[c];
+        cache->FreeLists[c] = *(void **) block;
+        --cache->Counts[c];
 
-    auto *result = tlsf_allocator(mode, context, size, oldMemory, oldSize, options);
-    if (mode == allocator_mode::ALLOCATE) {
-        if (!result) {
-            internal::platform_report_warning("Not enough memory in the persistent allocator; adding a pool");
+        persistent_cache_free_to_heap(context, block);
+    }
+}
+
+// Moves everything other threads freed for class _c_ to our free list.
+void persistent_cache_take_remote(win64_persistent_alloc_cache *cache, s64 c) {
+    void *block = (void *) atomic_swap(&cache->RemoteFrees[c], 0ll);
+    while (block) {
+        void *next = *(void **) block;
 
-            create_persistent_alloc_block(size * 3);
+        *(void **) block = cache->FreeLists[c];
+        cache->FreeLists[c] = block;
+        ++cache->Counts[c];
+
+        block = next;
+    }
+}
+
+// Returns everything in the remote lists of an orphaned cache to the heap.
+// Several threads may do this at once, each takes whole lists with a swap so every block is freed once.
+void persistent_cache_free_orphan_remote(win64_persistent_alloc_cache *cache, void *context) {
+    thread::scoped_lock _(&S->PersistentAllocMutex);
+    For(range(PERSISTENT_CACHE_CLASS_COUNT)) {
+        void *block = (void *) atomic_swap(&cache->RemoteFrees[it], 0ll);
+        while (block) {
+            void *next = *(void **) block;
+            persistent_cache_free_to_heap(context, block);
+            block = next;
         }
-        result = tlsf_allocator(allocator_mode::ALLOCATE, context, size, null, 0, options);
     }
-    return result;
+}
+
+void persistent_cache_remote_free(win64_persistent_alloc_cache *owner, void *context, s64 c, void *block) {
+    s64 head;
+    do {
+        head = atomic_compare_and_swap(&owner->RemoteFrees[c], 0ll, 0ll);
+        *(s64 *) block = head;
+    } while (atomic_compare_and_swap(&owner->RemoteFrees[c], (s64) block, head) != head);
+
+    // The owner exited (and may have already flushed its remote lists), nobody will take this one, so we free it.
+    if (atomic_compare_and_swap(&owner->Orphaned, 0, 0)) persistent_cache_free_orphan_remote(owner, context);
+}
+
+void *win64_persistent_alloc(allocator_mode mode, void *context, s64 size, void *oldMemory, s64 oldSize, u64 options) {
+    switch (mode) {
+        case allocator_mode::ALLOCATE: {
+            if (size > PERSISTENT_CACHE_MAX_SIZE) break;
+
+            auto *cache = persistent_cache_get(context);
+
+            s64 c = persistent_cache_class(size);
+            if (!cache->FreeLists[c]) persistent_cache_take_remote(cache, c);
+
+            if (!cache->FreeLists[c]) {
+                s64 classSize = (c + 1) * PERSISTENT_CACHE_GRANULARITY;
+
+                // Refill the magazine with one lock
+                {
+                    thread::scoped_lock _(&S->PersistentAllocMutex);
+                    For(range(PERSISTENT_CACHE_BATCH)) {
+                        void *raw = tlsf_allocator(allocator_mode::ALLOCATE, context, classSize + PERSISTENT_CACHE_PREFIX, null, 0, options);
+                        if (!raw) break;
+
+                        *(win64_persistent_alloc_cache **) raw = cache;
+                        void *block = (byte *) raw + PERSISTENT_CACHE_PREFIX;
+
+                        *(void **) block = cache->FreeLists[c];
+                        cache->FreeLists[c] = block;
+                        ++cache->Counts[c];
+                    }
+                }
+
+                // The heap is out of memory, the locked path adds another pool.
+                // Note that we still allocate the full class size since this block will end up in the cache when freed.
+                if (!cache->FreeLists[c]) {
+                    void *raw = win64_persistent_alloc_locked(mode, context, classSize + PERSISTENT_CACHE_PREFIX, oldMemory, oldSize, options);
+                    *(win64_persistent_alloc_cache **) raw = cache;
+                    return (byte *) raw + PERSISTENT_CACHE_PREFIX;
+                }
+            }
+
+            void *result = cache->FreeLists[c];
+            cache->FreeLists[c] = *(void **) result;
+            --cache->Counts[c];
+            return result;
+        }
+        case allocator_mode::RESIZE: {
+            if (size > PERSISTENT_CACHE_MAX_SIZE && oldSize > PERSISTENT_CACHE_MAX_SIZE) break;
+
+            // Cached blocks have exactly the size of their class, so they can be resized in place only inside the same class.
+            // Same goes for large blocks shrinking into the cached range - they're moved so the free later goes to the right place.
+            if (size <= PERSISTENT_CACHE_MAX_SIZE && oldSize <= PERSISTENT_CACHE_MAX_SIZE && persistent_cache_class(size) == persistent_cache_class(oldSize)) {
+                return oldMemory;
+            }
+            return null;
+        }
+        case allocator_mode::FREE: {
+            if (oldSize > PERSISTENT_CACHE_MAX_SIZE) break;
+
+            s64 c = persistent_cache_class(oldSize);
+
+            auto *cache = PersistentAllocCache;
+            auto *owner = persistent_cache_owner(oldMemory);
+            if (owner != cache) {
+                // See :RemoteFree:
+                persistent_cache_remote_free(owner, context, c, oldMemory);
+                return null;
+            }
+
+            *(void **) oldMemory = cache->FreeLists[c];
+            cache->FreeLists[c] = oldMemory;
+            ++cache->Counts[c];
+
+            if (cache->Counts[c] > PERSISTENT_CACHE_CAPACITY) persistent_cache_release(cache, context, c, PERSISTENT_CACHE_BATCH);
+            return null;
+        }
+        case allocator_mode::FREE_ALL: {
+            // Global state of the library lives here (and the thread caches point into it), it's never freed all at once
+            return (void *) -1;
+        }
+        case allocator_mode::ALLOCATE_BATCH:
+        case allocator_mode::FREE_BATCH: {
+            if (size > PERSISTENT_CACHE_MAX_SIZE) break;
+
+            // Small blocks must go through the cache one by one (they must be allocated with the full size of their class)
+            return (void *) -1;
+        }
+        default:
+            break;
+    }
+
+    // Large blocks and everything else (adding pools, etc.)
+    return win64_persistent_alloc_locked(mode, context, size, oldMemory, oldSize, options);
 }
 
 void create_persistent_alloc_block(s64 size) {
     // We allocate the arena allocator data and the starting pool in one big block in order to reduce fragmentation.
     auto [data, pool] = os_allocate_packed<tlsf_allocator_data>(size);
     S->PersistentAlloc = {win64_persistent_alloc, data};
-    allocator_add_pool(S->PersistentAlloc, pool, size);
+    tlsf_allocator(allocator_mode::ADD_POOL, data, size, pool, 0, 0);
 }
 
 export namespace internal {
 // These functions are used by other windows platform files.
-allocator platform_get_persistent_allocator() { return S->PersistentAlloc; }
-allocator platform_get_temporary_allocator() { return S->TempAlloc; }
+allocator platform_get_persistent_allocator() {
+    platform_init_once(&S->PersistentAllocInit, [] { create_persistent_alloc_block(lstd_persistent_storage_starting_size()); });
+    return S->PersistentAlloc;
+}
+
+// See tlsf_trim(). Blocks in the thread caches count as used.
+s64 platform_trim_persistent_allocator() {
+    auto alloc = platform_get_persistent_allocator();
+
+    thread::scoped_lock _(&S->PersistentAllocMutex);
+    return tlsf_trim((tlsf_allocator_data *) alloc.Context);
+}
+
+allocator platform_get_temporary_allocator() {
+    platform_init_once(&S->TempAllocInit, [] {
+        S->TempAlloc.Function = win64_temp_alloc;
+        create_temp_storage_block(lstd_temporary_storage_starting_size());
+    });
+    return {S->TempAlloc.Function, atomic_load(&S->TempAlloc.Context)};
+}
+
+// Returns all blocks cached by the calling thread to the persistent allocator.
+// Called when a thread exits, otherwise its cache would leak.
+void platform_flush_persistent_allocator_cache() {
+    auto *cache = PersistentAllocCache;
+    if (!cache) return;
+
+    void *context = S->PersistentAlloc.Context;
+    For(range(PERSISTENT_CACHE_CLASS_COUNT)) {
+        persistent_cache_take_remote(cache, it);
+        if (cache->Counts[it]) persistent_cache_release(cache, context, it, cache->Counts[it]);
+    }
+
+    // Remote frees which arrive from now on are freed by the threads which do them (see :RemoteFree:).
+    // We mark first and then free what came in meanwhile, this way no block gets stuck in the cache.
+    atomic_swap(&cache->Orphaned, 1);
+    persistent_cache_free_orphan_remote(cache, context);
+
+    {
+        thread::scoped_lock _(&S->PersistentAllocMutex);
+        cache->NextOrphan = S->OrphanedPersistentCaches;
+        S->OrphanedPersistentCaches = cache;
+    }
+    PersistentAllocCache = null;
+}
 
 void platform_init_allocators() {
     S->TempAllocMutex.init();
     S->PersistentAllocMutex.init();
 
-    create_temp_storage_block(PLATFORM_TEMPORARY_STORAGE_STARTING_SIZE);
-    create_persistent_alloc_block(PLATFORM_PERSISTENT_STORAGE_STARTING_SIZE);
+    // The blocks are created when the allocators are first asked for
 }
 
 // Windows uses utf16.. Sigh...
@@ -201,32 +554,64 @@ void platform_init_allocators() {
 utf16 *platform_utf8_to_utf16(const string &str, allocator alloc = {}) {
     if (!str.Length) return null;
 
-    if (!alloc) alloc = S->TempAlloc;
+    if (!alloc) alloc = platform_get_temporary_allocator();
 
     utf16 *result;
     PUSH_ALLOC(alloc) {
-        // src.Length * 2 because one unicode character might take 2 wide chars.
-        // This is just an approximation, not all space will be used!
-        result = allocate_array<utf16>(str.Length * 2 + 1);
+        // Each byte makes at most one wide char and each code point at most two.
+        // This is just an upper bound, not all space will be used!
+        result = allocate_array<utf16>(min(str.Length * 2, str.Count) + 1);
     }
 
     utf8_to_utf16(str.Data, str.Length, result);
     return result;
 }
 
+// Converts to utf16 in a buffer on the stack, only strings longer than the buffer go to the temporary allocator.
+// Meant to be passed directly to an API call, e.g.
+//
+//     CreateFileW(platform_utf16_temp(path), ...)
+//
+// The temporary lives until the end of the full expression. Use platform_utf8_to_utf16() if you need to keep the result around.
+struct platform_utf16_temp {
+    static constexpr s64 STACK_SIZE = 512;  // Most paths fit (MAX_PATH is 260)
+
+    utf16 Stack[STACK_SIZE];
+    utf16 *Data = null;
+
+    platform_utf16_temp(const string &str) {
+        if (!str.Length) return;
+
+        // See platform_utf8_to_utf16()
+        if (min(str.Length * 2, str.Count) + 1 > STACK_SIZE) {
+            Data = platform_utf8_to_utf16(str);
+        } else {
+            Data = Stack;
+            utf8_to_utf16(str.Data, str.Length, Data);
+        }
+    }
+
+    // _Data_ may point to _Stack_, so this can't be copied
+    platform_utf16_temp(const platform_utf16_temp &) = delete;
+    platform_utf16_temp &operator=(const platform_utf16_temp &) = delete;
+
+    operator utf16 *() const { return Data; }
+};
+
 // This function uses the platform temporary allocator if no explicit allocator was specified.
 string platform_utf16_to_utf8(const utf16 *str, allocator alloc = {}) {
     string result;
 
-    if (!alloc) alloc = S->TempAlloc;
+    if (!alloc) alloc = platform_get_temporary_allocator();
 
+    s64 count = c_string_length(str);
     PUSH_ALLOC(alloc) {
-        // String length * 4 because one unicode character might take 4 bytes in utf8.
-        // This is just an approximation, not all space will be used!
-        string_reserve(result, c_string_length(str) * 4);
+        // Each wide char makes at most 3 bytes (a surrogate pair makes 4).
+        // This is just an upper bound, not all space will be used!
+        string_reserve(result, count * 3);
     }
 
-    utf16_to_utf8(str, (utf8 *) result.Data, &result.Count);
+    utf16_to_utf8(str, count, (utf8 *) result.Data, &result.Count);
     result.Length = utf8_length(result.Data, result.Count);
 
     return result;
@@ -261,6 +646,35 @@ void *try_heap_realloc(void *ptr, s64 newSize, bool *reportError) {
     return result;
 }
 
+// Large pages require SeLockMemoryPrivilege to be enabled for the process token.
+// We try only once, the result doesn't change while the program is running.
+bool enable_lock_memory_privilege() {
+    // 0 - not tried, 1 - enabled, 2 - failed
+    local_persist s32 Status = 0;
+
+    if (Status == 0) {
+        s32 status = 2;
+
+        HANDLE token;
+        if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            TOKEN_PRIVILEGES tp;
+            tp.PrivilegeCount = 1;
+            tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+            if (LookupPrivilegeValueW(null, L"SeLockMemoryPrivilege", &tp.Privileges[0].Luid)) {
+                // AdjustTokenPrivileges succeeds even if the privilege wasn't assigned, so we check GetLastError()
+                if (AdjustTokenPrivileges(token, false, &tp, 0, null, null) && GetLastError() != ERROR_NOT_ALL_ASSIGNED) {
+                    status = 1;
+                }
+            }
+            CloseHandle(token);
+        }
+
+        atomic_compare_and_swap(&Status, status, 0);
+    }
+    return Status == 1;
+}
+
 export {
     void *os_allocate_block(s64 size) {
         assert(size < MAX_ALLOCATION_REQUEST);
@@ -309,7 +723,7 @@ export {
     }
 
     void os_write_shared_block(const string &name, void *data, s64 size) {
-        utf16 *name16 = internal::platform_utf8_to_utf16(name, S->PersistentAlloc);
+        utf16 *name16 = internal::platform_utf8_to_utf16(name, internal::platform_get_persistent_allocator());
         defer(free(name16));
 
         CREATE_MAPPING_CHECKED(h, CreateFileMappingW(INVALID_HANDLE_VALUE, null, PAGE_READWRITE, 0, (DWORD) size, name16));
@@ -325,7 +739,7 @@ export {
     }
 
     void os_read_shared_block(const string &name, void *out, s64 size) {
-        utf16 *name16 = internal::platform_utf8_to_utf16(name, S->PersistentAlloc);
+        utf16 *name16 = internal::platform_utf8_to_utf16(name, internal::platform_get_persistent_allocator());
         defer(free(name16));
 
         CREATE_MAPPING_CHECKED(h, OpenFileMappingW(FILE_MAP_READ, false, name16));
@@ -344,6 +758,87 @@ export {
     void os_free_block(void *ptr) {
         WIN_CHECKBOOL(HeapFree(GetProcessHeap(), 0, ptr));
     }
+
+    void *os_reserve_memory(s64 size) {
+        assert(size > 0 && size < MAX_ALLOCATION_REQUEST);
+
+        void *result = VirtualAlloc(null, size, MEM_RESERVE, PAGE_NOACCESS);
+        if (!result) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "VirtualAlloc");
+        }
+        return result;
+    }
+
+    bool os_commit_memory(void *address, s64 size) {
+        assert(address);
+        return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != null;
+    }
+
+    void os_decommit_memory(void *address, s64 size) {
+        assert(address);
+        WIN_CHECKBOOL(VirtualFree(address, size, MEM_DECOMMIT));
+    }
+
+    s64 os_purge_memory(void *address, s64 size) {
+        assert(address);
+
+        s64 pageSize = os_get_page_size();
+
+        byte *begin = (byte *) (((u64) address + pageSize - 1) / pageSize * pageSize);
+        byte *end   = (byte *) ((u64) ((byte *) address + size) / pageSize * pageSize);
+        if (end <= begin) return 0;
+
+        // MEM_RESET means the pages don't get written to the page file, VirtualUnlock on unlocked pages
+        // takes them out of the working set (it "fails" with ERROR_NOT_LOCKED, which is what we want)
+        VirtualAlloc(begin, end - begin, MEM_RESET, PAGE_READWRITE);
+        VirtualUnlock(begin, end - begin);
+        return end - begin;
+    }
+
+    void os_release_memory(void *address) {
+        assert(address);
+        WIN_CHECKBOOL(VirtualFree(address, 0, MEM_RELEASE));
+    }
+
+    os_allocate_large_block_result os_allocate_large_block(s64 size) {
+        assert(size > 0 && size < MAX_ALLOCATION_REQUEST);
+
+        os_allocate_large_block_result result;
+
+        s64 largePageSize = GetLargePageMinimum();
+        if (largePageSize && enable_lock_memory_privilege()) {
+            s64 roundedSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+
+            result.Block = VirtualAlloc(null, roundedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (result.Block) {
+                result.PageSize = largePageSize;
+                return result;
+            }
+        }
+
+        // Fall back to normal pages
+        result.Block = VirtualAlloc(null, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!result.Block) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "VirtualAlloc");
+            return result;
+        }
+        result.PageSize = os_get_page_size();
+        return result;
+    }
+
+    void os_free_large_block(void *block) { os_release_memory(block); }
+
+    s64 os_get_page_size() {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwPageSize;
+    }
+
+    s64 os_get_allocation_granularity() {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwAllocationGranularity;
+    }
 }
 
 LSTD_END_NAMESPACE
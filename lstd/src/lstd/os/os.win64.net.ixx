@@ -0,0 +1,638 @@
+module;
+
+#include "lstd/io/socket_reader.h"
+#include "lstd/io/socket_writer.h"
+#include "lstd/memory/delegate.h"
+#include "lstd/memory/string.h"
+#include "lstd/thread.h"
+#include "lstd/types/windows.h"  // Declarations of Win32 functions
+
+//
+// TCP and UDP sockets.
+//
+// The plain functions block, like the ones in path.nt. They are enough for tools and for a thread per connection:
+//
+//     auto server = socket_listen("", 8080);
+//     defer(free(server));
+//
+//     auto client = socket_accept(server);
+//     defer(free(client));
+//
+//     socket_reader in(client.Handle);
+//     socket_writer out(client.Handle);
+//
+//     string line;
+//     while (read_line(&in, line)) {
+//         fmt_to_writer(&out, "echo: {}\n", line);
+//         flush(&out);
+//     }
+//
+// For many connections attach the sockets to a net_poller and give it requests instead. The poller is the
+// event loop: an I/O completion port here, epoll on Linux (see os.posix.net). Requests work like the ones of
+// async_io - caller owned, nothing is allocated per request, the callback runs on the thread which collected
+// the completion (a poller thread or one calling net_poll). task_recv/task_send in task.h await them from a coroutine.
+//
+//     net_poller poller;
+//     net_poller_init(poller);
+//     defer(free(poller));
+//
+//     net_poller_attach(poller, client);
+//
+//     net_request r;
+//     r.Socket   = &client;
+//     r.Op       = net_op::Recv;
+//     r.Data     = buffer;
+//     r.Size     = 64_KiB;
+//     r.Callback = &on_recv;
+//     net_submit(poller, &r);
+//
+// A recv completes with whatever arrived (0 bytes means the other side closed), a send completes when all of
+// it was sent. Keep at most one recv and one send in flight per socket so data isn't interleaved.
+//
+
+export module os.win64.net;
+
+import os.win64.memory;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    enum class socket_type {
+        TCP = 0,
+        UDP,
+    };
+
+    // An IPv4 or IPv6 address and a port (a sockaddr_in or sockaddr_in6)
+    struct net_address {
+        alignas(8) byte Data[28]{};
+        s32 Size = 0;  // 0 if resolving failed
+    };
+
+    struct net_socket {
+        s64 Handle       = -1;  // -1 if opening failed
+        socket_type Type = socket_type::TCP;
+    };
+
+    // Resolves _host_ (a name or a numeric address) to its first address. An empty _host_ means any local
+    // address (0.0.0.0), for binding. Use numeric addresses when you care about IPv4 vs IPv6 ("localhost" may be either).
+    bool net_address_resolve(net_address &out, const string &host, u16 port, socket_type type = socket_type::TCP);
+
+    u16 net_address_port(const net_address &address);
+
+    // Binds a TCP socket to _host_ and _port_ (0 picks a free one, see socket_get_address) and starts listening.
+    [[nodiscard("Leak")]] net_socket socket_listen(const string &host, u16 port, s32 backlog = 128);
+
+    // Blocks until a connection comes. _from_ gets the address of the other side.
+    [[nodiscard("Leak")]] net_socket socket_accept(net_socket &listener, net_address *from = null);
+
+    // Blocks until connected. Nagle's algorithm is off - socket_writer already combines small writes.
+    [[nodiscard("Leak")]] net_socket socket_connect(const string &host, u16 port);
+
+    // Opens a UDP socket bound to _host_ and _port_ (by default any address and a free port).
+    [[nodiscard("Leak")]] net_socket socket_udp_open(const string &host = "", u16 port = 0);
+
+    // The local address the socket is bound to
+    net_address socket_get_address(const net_socket &s);
+
+    // Block until all of it was sent. Return _size_ (the spans' total) or -1 on error.
+    s64 socket_send(net_socket &s, const byte *data, s64 size);
+    s64 socket_send_vectored(net_socket &s, const bytes *spans, s64 count);
+
+    // Blocks until something arrives, returns how many bytes were received (at most _size_),
+    // 0 if the other side closed the connection or -1 on error.
+    s64 socket_recv(net_socket &s, byte *dest, s64 size);
+
+    // One datagram. socket_recv_from drops what doesn't fit in _size_.
+    s64 socket_send_to(net_socket &s, const net_address &to, const byte *data, s64 size);
+    s64 socket_recv_from(net_socket &s, byte *dest, s64 size, net_address *from = null);
+
+    // Tells the other side we won't send more (its recv returns 0), we can still receive.
+    void socket_shutdown_send(net_socket &s);
+
+    // Requests in flight on the socket complete with an error.
+    void free(net_socket &s);
+
+    //
+    // Event-driven I/O:
+    //
+
+    enum class net_op {
+        Recv = 0,
+        Send,
+    };
+
+    struct net_poller;
+
+    //
+    // One recv or send on an attached socket. Owned by the caller, it must stay alive and not move until it's done.
+    // Submit one again to reuse it.
+    //
+    struct net_request {
+        // The OVERLAPPED the OS works with. It's first, so we get the request back from the completion.
+        alignas(8) byte PlatformRequest[32]{};
+
+        // Filled by the caller
+        net_socket *Socket = null;
+        net_op Op          = net_op::Recv;
+        byte *Data         = null;
+        s64 Size           = 0;  // Less than 4 GiB
+
+        // Runs on the thread which collected the completion (a poller thread or one calling net_poll)
+        delegate<void(net_request *)> Callback;
+        void *UserData = null;
+
+        // Results
+        s64 Transferred = 0;  // 0 for a recv means the other side closed the connection
+        u32 Error       = 0;  // Win32 error code, 0 on success
+
+        // Set (right before _Callback_ runs) when the request is done, read it with atomic_load
+        s32 Done = 0;
+
+        net_poller *Poller = null;  // Set by net_submit
+    };
+
+    struct net_poller {
+        void *Port = null;
+
+        s64 InFlight = 0;  // Submitted and not completed yet, atomic
+
+        thread::thread *Threads = null;
+        s64 ThreadCount         = 0;
+    };
+
+    // Creates the completion port and starts _threads_ threads which wait for completions and run callbacks.
+    // With 0 threads nothing completes until you call net_poll.
+    bool net_poller_init(net_poller &p, s64 threads = 1);
+
+    // Waits for the requests in flight (free the sockets first, that completes the ones which wait for data)
+    // and stops the threads.
+    void free(net_poller &p);
+
+    // Makes the socket's I/O complete on the poller. Blocking calls still work on an attached socket,
+    // but don't mix them with requests of the same direction.
+    bool net_poller_attach(net_poller &p, net_socket &s);
+
+    // Gives _request_ to the OS right away (sockets don't need batching the way files do).
+    void net_submit(net_poller &p, net_request *request);
+
+    // Collects completions on the calling thread and runs their callbacks. Waits up to _timeoutMs_ for the first one.
+    // Returns how many requests completed.
+    s64 net_poll(net_poller &p, u32 timeoutMs = 0);
+
+    // Blocks until _request_ is done (polls for it if there are no poller threads).
+    void net_wait(net_poller &p, net_request *request);
+}
+
+// Completion keys
+constexpr ULONG_PTR NET_KEY_IO     = 0;
+constexpr ULONG_PTR NET_KEY_FAILED = 1;  // Failed before reaching the OS, we posted it ourselves with _Error_ already set
+constexpr ULONG_PTR NET_KEY_STOP   = 2;  // Tells a poller thread to exit
+
+constexpr s64 NET_ENTRIES_PER_WAIT = 64;
+
+static_assert(sizeof(OVERLAPPED) <= sizeof(net_request::PlatformRequest));
+
+file_scope s32 WinsockInit = 0;
+
+file_scope void net_init() {
+    internal::platform_init_once(&WinsockInit, [] {
+        WSADATA data;
+        if (WSAStartup(0x0202, &data) != 0) windows_report_hresult_error(HRESULT_FROM_WIN32(WSAGetLastError()), "WSAStartup");
+    });
+}
+
+file_scope void net_report_error(const char *call, source_location loc = source_location::current()) {
+    windows_report_hresult_error(HRESULT_FROM_WIN32(WSAGetLastError()), call, loc);
+}
+
+file_scope SOCKET net_open(const net_address &address, socket_type type) {
+    net_init();
+
+    int family = ((sockaddr *) address.Data)->sa_family;
+    int kind   = type == socket_type::TCP ? SOCK_STREAM : SOCK_DGRAM;
+    int proto  = type == socket_type::TCP ? IPPROTO_TCP : IPPROTO_UDP;
+
+    // Overlapped, so the socket can be attached to a poller. Blocking calls work on it too.
+    SOCKET s = WSASocketW(family, kind, proto, null, 0, WSA_FLAG_OVERLAPPED);
+    if (s == INVALID_SOCKET) net_report_error("WSASocketW");
+    return s;
+}
+
+// getaddrinfo wants the port as a string
+file_scope const char *net_port_string(char *buffer, u16 port) {
+    char *p = buffer + 5;
+    *p = 0;
+    do {
+        *--p = '0' + port % 10;
+        port /= 10;
+    } while (port);
+    return p;
+}
+
+bool net_address_resolve(net_address &out, const string &host, u16 port, socket_type type) {
+    net_init();
+    out = {};
+
+    ADDRINFOA hints;
+    zero_memory(&hints, sizeof(hints));
+    hints.ai_family   = host ? AF_UNSPEC : AF_INET;
+    hints.ai_socktype = type == socket_type::TCP ? SOCK_STREAM : SOCK_DGRAM;
+    hints.ai_flags    = host ? 0 : AI_PASSIVE;
+
+    char service[6];
+
+    PADDRINFOA result = null;
+    if (getaddrinfo(host ? string_to_c_string_temp(host) : null, net_port_string(service, port), &hints, &result) != 0 || !result) {
+        net_report_error("getaddrinfo");
+        return false;
+    }
+    defer(freeaddrinfo(result));
+
+    if (result->ai_addrlen > sizeof(out.Data)) return false;
+
+    copy_memory(out.Data, result->ai_addr, result->ai_addrlen);
+    out.Size = (s32) result->ai_addrlen;
+    return true;
+}
+
+u16 net_address_port(const net_address &address) { return (u16) ((address.Data[2] << 8) | address.Data[3]); }
+
+[[nodiscard("Leak")]] net_socket socket_listen(const string &host, u16 port, s32 backlog) {
+    net_address address;
+    if (!net_address_resolve(address, host, port)) return {};
+
+    SOCKET s = net_open(address, socket_type::TCP);
+    if (s == INVALID_SOCKET) return {};
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse, sizeof(reuse));
+
+    if (bind(s, (sockaddr *) address.Data, address.Size) == SOCKET_ERROR) {
+        net_report_error("bind");
+        closesocket(s);
+        return {};
+    }
+
+    if (listen(s, backlog) == SOCKET_ERROR) {
+        net_report_error("listen");
+        closesocket(s);
+        return {};
+    }
+    return {s, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_accept(net_socket &listener, net_address *from) {
+    net_address address;
+    int size = sizeof(address.Data);
+
+    SOCKET s = accept(listener.Handle, (sockaddr *) address.Data, &size);
+    if (s == INVALID_SOCKET) {
+        net_report_error("accept");
+        return {};
+    }
+
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *) &noDelay, sizeof(noDelay));
+
+    if (from) {
+        *from      = address;
+        from->Size = size;
+    }
+    return {s, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_connect(const string &host, u16 port) {
+    net_address address;
+    if (!net_address_resolve(address, host, port)) return {};
+
+    SOCKET s = net_open(address, socket_type::TCP);
+    if (s == INVALID_SOCKET) return {};
+
+    if (connect(s, (sockaddr *) address.Data, address.Size) == SOCKET_ERROR) {
+        net_report_error("connect");
+        closesocket(s);
+        return {};
+    }
+
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *) &noDelay, sizeof(noDelay));
+    return {s, socket_type::TCP};
+}
+
+[[nodiscard("Leak")]] net_socket socket_udp_open(const string &host, u16 port) {
+    net_address address;
+    if (!net_address_resolve(address, host, port, socket_type::UDP)) return {};
+
+    SOCKET s = net_open(address, socket_type::UDP);
+    if (s == INVALID_SOCKET) return {};
+
+    if (bind(s, (sockaddr *) address.Data, address.Size) == SOCKET_ERROR) {
+        net_report_error("bind");
+        closesocket(s);
+        return {};
+    }
+    return {s, socket_type::UDP};
+}
+
+net_address socket_get_address(const net_socket &s) {
+    net_address result;
+    int size = sizeof(result.Data);
+    if (getsockname(s.Handle, (sockaddr *) result.Data, &size) == SOCKET_ERROR) {
+        net_report_error("getsockname");
+        return {};
+    }
+    result.Size = size;
+    return result;
+}
+
+s64 socket_send(net_socket &s, const byte *data, s64 size) {
+    bytes span((byte *) data, size);
+    return socket_send_vectored(s, &span, 1);
+}
+
+s64 socket_send_vectored(net_socket &s, const bytes *spans, s64 count) {
+    constexpr s64 MAX_BUFFERS = 64;
+
+    s64 total = 0;
+    For(range(count)) total += spans[it].Count;
+
+    // A blocking WSASend sends everything before returning, but the buffers it takes at once are limited
+    s64 first = 0;
+    while (first < count) {
+        WSABUF buffers[MAX_BUFFERS];
+
+        DWORD n = 0;
+        while (n < MAX_BUFFERS && first < count) {
+            auto &span = spans[first++];
+            if (!span.Count) continue;
+
+            assert(span.Count <= numeric_info<u32>::max() && "Span is too big for one WSASend");
+            buffers[n++] = {(ULONG) span.Count, (CHAR *) span.Data};
+        }
+        if (!n) break;
+
+        DWORD sent;
+        if (WSASend(s.Handle, buffers, n, &sent, 0, null, null) == SOCKET_ERROR) {
+            net_report_error("WSASend");
+            return -1;
+        }
+    }
+    return total;
+}
+
+s64 socket_recv(net_socket &s, byte *dest, s64 size) {
+    int n = recv(s.Handle, (char *) dest, (int) min(size, (s64) numeric_info<s32>::max()), 0);
+    if (n == SOCKET_ERROR) {
+        net_report_error("recv");
+        return -1;
+    }
+    return n;
+}
+
+s64 socket_send_to(net_socket &s, const net_address &to, const byte *data, s64 size) {
+    int n = sendto(s.Handle, (const char *) data, (int) size, 0, (sockaddr *) to.Data, to.Size);
+    if (n == SOCKET_ERROR) {
+        net_report_error("sendto");
+        return -1;
+    }
+    return n;
+}
+
+s64 socket_recv_from(net_socket &s, byte *dest, s64 size, net_address *from) {
+    net_address address;
+    int addressSize = sizeof(address.Data);
+
+    int n = recvfrom(s.Handle, (char *) dest, (int) min(size, (s64) numeric_info<s32>::max()), 0, (sockaddr *) address.Data, &addressSize);
+    if (n == SOCKET_ERROR) {
+        // WSAEMSGSIZE - the datagram didn't fit, the rest of it is dropped like on POSIX
+        if (WSAGetLastError() != 10040) {
+            net_report_error("recvfrom");
+            return -1;
+        }
+        n = (int) size;
+    }
+
+    if (from) {
+        *from      = address;
+        from->Size = addressSize;
+    }
+    return n;
+}
+
+void socket_shutdown_send(net_socket &s) {
+    if (s.Handle != -1) shutdown(s.Handle, SD_SEND);
+}
+
+void free(net_socket &s) {
+    if (s.Handle != -1) closesocket(s.Handle);
+    s = {};
+}
+
+//
+// socket_writer and socket_reader (see io/)
+//
+
+void socket_writer::write(const byte *data, s64 size) {
+    if (Count + size <= BUFFER_SIZE) {
+        copy_memory(Buffer + Count, data, size);
+        Count += size;
+        return;
+    }
+
+    bytes span((byte *) data, size);
+    write_vectored(&span, 1);
+}
+
+void socket_writer::write_vectored(const bytes *spans, s64 count) {
+    s64 total = 0;
+    For(range(count)) total += spans[it].Count;
+
+    if (Count + total <= BUFFER_SIZE) {
+        For(range(count)) {
+            copy_memory(Buffer + Count, spans[it].Data, spans[it].Count);
+            Count += spans[it].Count;
+        }
+        return;
+    }
+
+    // What's buffered and the new data go out in one call
+    bytes all[16];
+    all[0] = bytes(Buffer, Count);
+
+    net_socket s = {Socket, socket_type::TCP};
+
+    s64 first = 0;
+    while (first < count) {
+        s64 n = min(count - first, (s64) 15);
+        copy_memory(all + 1, spans + first, n * sizeof(bytes));
+        if (socket_send_vectored(s, all, n + 1) < 0) Failed = true;
+
+        all[0] = {};
+        first += n;
+    }
+    Count = 0;
+}
+
+void socket_writer::flush() {
+    if (!Count) return;
+
+    net_socket s = {Socket, socket_type::TCP};
+    if (socket_send(s, Buffer, Count) < 0) Failed = true;
+    Count = 0;
+}
+
+s64 socket_reader::read_source(byte *dest, s64 size) {
+    net_socket s = {Socket, socket_type::TCP};
+
+    s64 n = socket_recv(s, dest, size);
+    if (n < 0) {
+        Failed = true;
+        return 0;
+    }
+    return n;
+}
+
+//
+// Event-driven I/O
+//
+
+file_scope void net_complete(net_poller &p, const OVERLAPPED_ENTRY &entry) {
+    auto *r = (net_request *) entry.lpOverlapped;
+
+    r->Transferred = entry.dwNumberOfBytesTransferred;
+    if (entry.lpCompletionKey == NET_KEY_IO) {
+        DWORD transferred, flags;
+        r->Error = WSAGetOverlappedResult(r->Socket->Handle, entry.lpOverlapped, &transferred, false, &flags) ? 0 : WSAGetLastError();
+    }
+
+    atomic_add(&p.InFlight, (s64) -1);
+
+    atomic_store(&r->Done, 1);
+    if (r->Callback) r->Callback(r);
+}
+
+// Returns false if a stop packet was among the completions
+file_scope bool net_dequeue(net_poller &p, u32 timeoutMs, s64 *completed) {
+    OVERLAPPED_ENTRY entries[NET_ENTRIES_PER_WAIT];
+
+    ULONG count = 0;
+    if (!GetQueuedCompletionStatusEx((HANDLE) p.Port, entries, NET_ENTRIES_PER_WAIT, &count, timeoutMs, false)) return true;  // Timed out
+
+    bool stop = false;
+    For(range(count)) {
+        if (entries[it].lpCompletionKey == NET_KEY_STOP) {
+            stop = true;
+            continue;
+        }
+        net_complete(p, entries[it]);
+        if (completed) ++*completed;
+    }
+    return !stop;
+}
+
+file_scope void net_poller_thread(void *data) {
+    auto *p = (net_poller *) data;
+    while (net_dequeue(*p, INFINITE, null)) {
+    }
+}
+
+bool net_poller_init(net_poller &p, s64 threads) {
+    assert(!p.Port && "Already initialized, call free() first");
+
+    p.Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, null, 0, 0);
+    if (!p.Port) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateIoCompletionPort(INVALID_HANDLE_VALUE, null, 0, 0)");
+        return false;
+    }
+
+    p.InFlight    = 0;
+    p.ThreadCount = threads;
+    if (threads) {
+        p.Threads = allocate_array<thread::thread>(threads);
+        For(range(threads)) p.Threads[it].init_and_launch(net_poller_thread, &p);
+    }
+    return true;
+}
+
+void free(net_poller &p) {
+    if (!p.Port) return;
+
+    while (atomic_load(&p.InFlight)) {
+        if (p.ThreadCount) {
+            thread::sleep(1);
+        } else {
+            net_poll(p, 1);
+        }
+    }
+
+    For(range(p.ThreadCount)) PostQueuedCompletionStatus((HANDLE) p.Port, 0, NET_KEY_STOP, null);
+    For(range(p.ThreadCount)) p.Threads[it].wait();
+    free(p.Threads);
+
+    CloseHandle((HANDLE) p.Port);
+
+    p.Port        = null;
+    p.Threads     = null;
+    p.ThreadCount = 0;
+}
+
+bool net_poller_attach(net_poller &p, net_socket &s) {
+    if (!CreateIoCompletionPort((HANDLE) s.Handle, (HANDLE) p.Port, NET_KEY_IO, 0)) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateIoCompletionPort");
+        return false;
+    }
+    return true;
+}
+
+void net_submit(net_poller &p, net_request *r) {
+    assert(r->Socket && r->Socket->Handle != -1 && "Request has no socket");
+    assert(r->Size >= 0 && r->Size <= numeric_info<u32>::max() && "Request is too big for one WSARecv/WSASend");
+
+    r->Transferred = 0;
+    r->Error       = 0;
+    r->Done        = 0;
+    r->Poller      = &p;
+
+    atomic_add(&p.InFlight, (s64) 1);
+
+    auto *o = (OVERLAPPED *) r->PlatformRequest;
+    zero_memory(o, sizeof(OVERLAPPED));
+
+    WSABUF buffer = {(ULONG) r->Size, (CHAR *) r->Data};
+
+    int result;
+    if (r->Op == net_op::Recv) {
+        DWORD flags = 0;
+        result      = WSARecv(r->Socket->Handle, &buffer, 1, null, &flags, o, null);
+    } else {
+        result = WSASend(r->Socket->Handle, &buffer, 1, null, 0, o, null);
+    }
+
+    // Completing right away still posts to the port, so only failures need handling here.
+    // Don't touch _r_ after a successful call, it may be done and reused already.
+    if (result == SOCKET_ERROR) {
+        int error = WSAGetLastError();
+        if (error == WSA_IO_PENDING) return;
+
+        r->Error = error;
+        PostQueuedCompletionStatus((HANDLE) p.Port, 0, NET_KEY_FAILED, o);
+    }
+}
+
+s64 net_poll(net_poller &p, u32 timeoutMs) {
+    s64 completed = 0;
+    net_dequeue(p, timeoutMs, &completed);
+    return completed;
+}
+
+void net_wait(net_poller &p, net_request *request) {
+    while (!atomic_load(&request->Done)) {
+        if (p.ThreadCount) {
+            thread::sleep(0);
+        } else {
+            net_poll(p, 1);
+        }
+    }
+}
+
+LSTD_END_NAMESPACE
@@ -170,6 +170,95 @@ inline void advance_cp(string *p, s64 count) {
     p->Length -= count;
 }
 
+//
+// Fast paths for parse_int with the usual options - base 10 and 16 with one of the byte_to_digit functions above.
+// We load 8 bytes at once, check that they are all digits and convert them with a few multiplications (SWAR).
+// Overflow is checked once per chunk - if the chunk could overflow we leave it to the byte by byte loop,
+// which also handles whatever is left after the last full chunk.
+//
+namespace internal {
+constexpr u64 SWAR_ONES = 0x0101010101010101ull;
+constexpr u64 SWAR_HIGH = 0x8080808080808080ull;
+
+always_inline u64 swar_load_8(const byte *p) {
+    u64 result;
+    copy_memory(&result, p, 8);
+    return result;  // First byte in the lowest 8 bits
+}
+
+// 0x80 in each byte of _x_ which is in [lo, hi], bytes of _x_ must be < 0x80
+always_inline u64 swar_in_range(u64 x, byte lo, byte hi) {
+    return (x + SWAR_ONES * (0x80 - lo)) & ~(x + SWAR_ONES * (0x7F - hi)) & SWAR_HIGH;
+}
+
+always_inline bool swar_all_decimal_digits(u64 x) {
+    return ((x & 0xF0F0F0F0F0F0F0F0ull) | (((x + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// "12345678" -> 12345678
+always_inline u32 swar_parse_8_decimal_digits(u64 x) {
+    x -= 0x3030303030303030ull;
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FFull;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFFull;
+    x = (x * 10000 + (x >> 32)) & 0xFFFFFFFFull;
+    return (u32) x;
+}
+
+// Returns false if not all 8 bytes are hex digits (accepted letter case depends on _ByteToDigit_)
+template <byte_to_digit_t ByteToDigit>
+always_inline bool swar_parse_8_hex_digits(u64 x, u32 *out) {
+    if (x & SWAR_HIGH) return false;
+
+    u64 letters = 0;
+    if constexpr (ByteToDigit != byte_to_digit_force_upper) letters |= swar_in_range(x, 'a', 'f');
+    if constexpr (ByteToDigit != byte_to_digit_force_lower) letters |= swar_in_range(x, 'A', 'F');
+    if ((swar_in_range(x, '0', '9') | letters) != SWAR_HIGH) return false;
+
+    // 'a' and 'A' have 1 in the low nibble
+    x = (x & 0x0F0F0F0F0F0F0F0Full) + (letters >> 7) * 9;
+    x = ((x << 4) + (x >> 8)) & 0x00FF00FF00FF00FFull;
+    x = ((x << 8) + (x >> 16)) & 0x0000FFFF0000FFFFull;
+    x = ((x << 16) + (x >> 32)) & 0xFFFFFFFFull;
+    *out = (u32) x;
+    return true;
+}
+
+// Consumes whole chunks of 8 digits while the value can't overflow _IntT_, returns the number of digits consumed.
+// _value_ is the magnitude so far, the sign is applied by the caller.
+template <typename IntT, byte_to_digit_t ByteToDigit>
+s64 parse_int_chunks(bytes *p, IntT *value, u32 base) {
+    using U = types::make_unsigned_t<IntT>;
+
+    constexpr u64 MAX = (u64) numeric_info<IntT>::max();
+
+    u64 v = (u64) (U) *value;
+    const byte *begin = p->Data;
+    if (base == 10) {
+        constexpr u64 CUT_OFF = (MAX - 99999999) / 100000000;
+        while (p->Count >= 8 && v <= CUT_OFF) {
+            u64 x = swar_load_8(p->Data);
+            if (!swar_all_decimal_digits(x)) break;
+
+            v = v * 100000000 + swar_parse_8_decimal_digits(x);
+            advance_bytes(p, 8);
+        }
+    } else if (base == 16) {
+        while (p->Count >= 8 && v <= (MAX >> 32)) {
+            u32 chunk;
+            if (!swar_parse_8_hex_digits<ByteToDigit>(swar_load_8(p->Data), &chunk)) break;
+
+            u64 next = v << 32 | chunk;
+            if (next > MAX) break;  // Only possible for 32 bit types, which have no room above the chunk
+
+            v = next;
+            advance_bytes(p, 8);
+        }
+    }
+    *value = (IntT) v;
+    return p->Data - begin;
+}
+}  // namespace internal
+
 template <typename T>
 struct parse_result {
     T Value;
@@ -265,6 +354,14 @@ parse_result<IntT> parse_int(bytes buffer, u32 base = 10) {
 
     // Now we start parsing for real
     IntT value = 0;
+
+    // Decimal and hex with the default digit functions and no digit limit go 8 digits at a time first
+    constexpr bool FAST_PATH = sizeof(IntT) >= 4 && Options.MaxDigits == -1 &&
+                               (Options.ByteToDigit == byte_to_digit_default || Options.ByteToDigit == byte_to_digit_force_lower || Options.ByteToDigit == byte_to_digit_force_upper);
+    if constexpr (FAST_PATH) {
+        if (internal::parse_int_chunks<IntT, Options.ByteToDigit>(&p, &value, base)) firstDigit = false;
+    }
+
     while (true) {
         if constexpr (Options.MaxDigits != -1) {
             if (!maxDigits) break;
@@ -422,6 +519,584 @@ parse_result<bool> parse_bool(bytes buffer) {
     return {false, PARSE_INVALID, p};
 }
 
+// Similar to parse_int, these options compile different versions of parse_float and turn off certain code paths.
+struct parse_float_options {
+    bool ParseSign = true;           // If true, looks for +/- before trying to parse any digits. If '-' the result is negated.
+    bool AllowPlusSign = true;       // If true, allows explicit + as a sign, if false, results in parse failure.
+    bool ParseExponent = true;       // If true, parses an exponent after the digits - e/E followed by an optional sign and digits.
+    bool ParseSpecialValues = true;  // If true, parses "inf", "infinity" and "nan" (ignoring case).
+};
+
+namespace internal {
+// The binary format of the float type we are parsing, see parse_float
+template <typename F>
+struct parse_float_format;
+
+template <>
+struct parse_float_format<f64> {
+    using bits_t = u64;
+
+    static constexpr s32 MANTISSA_BITS  = numeric_info<f64>::bits_mantissa;
+    static constexpr s32 MIN_EXPONENT   = -numeric_info<f64>::exponent_bias;
+    static constexpr s32 INFINITE_POWER = 0x7FF;
+
+    // Below this w * 10^q is always 0, above it is always infinity (for any non-zero 64 bit w)
+    static constexpr s64 MIN_POWER_OF_TEN = -342;
+    static constexpr s64 MAX_POWER_OF_TEN = 308;
+
+    static constexpr s64 MAX_EXACT_POWER_OF_TEN = 22;  // 10^22 is the biggest power of 10 that fits exactly in a f64
+    static constexpr u64 MAX_EXACT_MANTISSA     = 1ull << (MANTISSA_BITS + 1);
+
+    // Only for these powers w * 10^q can be exactly halfway between two floats (when w is at most 64 bits)
+    static constexpr s64 MIN_ROUND_TO_EVEN_POWER = -4;
+    static constexpr s64 MAX_ROUND_TO_EVEN_POWER = 23;
+};
+
+template <>
+struct parse_float_format<f32> {
+    using bits_t = u32;
+
+    static constexpr s32 MANTISSA_BITS  = numeric_info<f32>::bits_mantissa;
+    static constexpr s32 MIN_EXPONENT   = -numeric_info<f32>::exponent_bias;
+    static constexpr s32 INFINITE_POWER = 0xFF;
+
+    static constexpr s64 MIN_POWER_OF_TEN = -64;
+    static constexpr s64 MAX_POWER_OF_TEN = 38;
+
+    static constexpr s64 MAX_EXACT_POWER_OF_TEN = 10;
+    static constexpr u64 MAX_EXACT_MANTISSA     = 1ull << (MANTISSA_BITS + 1);
+
+    static constexpr s64 MIN_ROUND_TO_EVEN_POWER = -17;
+    static constexpr s64 MAX_ROUND_TO_EVEN_POWER = 10;
+};
+
+constexpr f64 PARSE_FLOAT_EXACT_POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+constexpr s64 PARSE_FLOAT_POWERS_OF_FIVE_MIN = -342;
+
+constexpr u128 PARSE_FLOAT_POWERS_OF_FIVE[] = {
+#include "parse_float_powers.inl"
+};
+
+// The result before it gets turned into float bits - the mantissa without the implicit bit and the biased exponent
+struct parse_float_adjusted {
+    u64 Mantissa = 0;
+    s32 Power2 = 0;
+
+    bool operator==(const parse_float_adjusted &other) const { return Mantissa == other.Mantissa && Power2 == other.Power2; }
+};
+
+template <typename F>
+F parse_float_to_float(parse_float_adjusted am, bool negative) {
+    using format = parse_float_format<F>;
+    using bits_t = typename format::bits_t;
+
+    bits_t bits = (bits_t) am.Mantissa | ((bits_t) am.Power2 << format::MANTISSA_BITS);
+    if (negative) bits |= (bits_t) 1 << (sizeof(bits_t) * 8 - 1);
+    return types::bit_cast<F>(bits);
+}
+
+//
+// Eisel-Lemire: w * 10^q is computed as w * 5^q * 2^q with a 128 bit approximation of 5^q.
+// When w has at most 19 digits (it's exact) this is always correctly rounded (see "Fast Number Parsing Without Fallback"
+// by Noble Mushtak and Daniel Lemire). The caller takes care of longer inputs, see parse_float_compute.
+//
+template <typename F>
+parse_float_adjusted parse_float_eisel_lemire(s64 q, u64 w) {
+    using format = parse_float_format<F>;
+
+    parse_float_adjusted result;
+    if (!w || q < format::MIN_POWER_OF_TEN) return result;  // Zero
+    if (q > format::MAX_POWER_OF_TEN) {
+        result.Power2 = format::INFINITE_POWER;
+        return result;
+    }
+
+    s32 lz = 63 - msb(w);
+    w <<= lz;
+
+    // We need MANTISSA_BITS + 3 bits of the product, if they might be affected by what we truncated from 5^q, use more of it
+    constexpr u64 PRECISION_MASK = 0xFFFFFFFFFFFFFFFFull >> (format::MANTISSA_BITS + 3);
+
+    const u128 *power = PARSE_FLOAT_POWERS_OF_FIVE + (q - PARSE_FLOAT_POWERS_OF_FIVE_MIN);
+    u128 product = mul128(w, power->hi);
+    if ((product.hi & PRECISION_MASK) == PRECISION_MASK) {
+        u128 second = mul128(w, power->lo);
+        product.lo += second.hi;
+        if (second.hi > product.lo) ++product.hi;
+    }
+
+    s32 upperBit = (s32) (product.hi >> 63);
+    s32 shift = upperBit + 64 - format::MANTISSA_BITS - 3;
+
+    result.Mantissa = product.hi >> shift;
+
+    // floor(log2(10^q)) = floor(q * log2(10)), (152170 + 65536) / 2^16 is a close enough approximation of log2(10) for our range
+    s32 power2 = (s32) ((((152170 + 65536) * q) >> 16) + 63);
+    result.Power2 = power2 + upperBit - lz - format::MIN_EXPONENT;
+
+    if (result.Power2 <= 0) {
+        // Subnormal
+        if (-result.Power2 + 1 >= 64) return {};
+
+        result.Mantissa >>= -result.Power2 + 1;
+        result.Mantissa += result.Mantissa & 1;  // Round
+        result.Mantissa >>= 1;
+
+        // A subnormal may round up to the smallest normal number
+        result.Power2 = result.Mantissa < (1ull << format::MANTISSA_BITS) ? 0 : 1;
+        return result;
+    }
+
+    // Exactly halfway between two floats - we round to even, so don't round up if the lower one is even
+    if (product.lo <= 1 && q >= format::MIN_ROUND_TO_EVEN_POWER && q <= format::MAX_ROUND_TO_EVEN_POWER && (result.Mantissa & 3) == 1) {
+        if ((result.Mantissa << shift) == product.hi) result.Mantissa &= ~1ull;
+    }
+
+    result.Mantissa += result.Mantissa & 1;  // Round
+    result.Mantissa >>= 1;
+
+    if (result.Mantissa >= (2ull << format::MANTISSA_BITS)) {
+        // Rounding overflowed the mantissa
+        result.Mantissa = 1ull << format::MANTISSA_BITS;
+        ++result.Power2;
+    }
+    result.Mantissa &= ~(1ull << format::MANTISSA_BITS);
+
+    if (result.Power2 >= format::INFINITE_POWER) return {0, format::INFINITE_POWER};
+    return result;
+}
+
+//
+// The slow path, only for inputs with more than 19 significant digits which are too close to halfway between two floats.
+// The decimal digits are shifted by powers of 2 until the value is in [1, 2) and then rounded exactly
+// ("Simple Decimal Conversion" by Nigel Tao, used in Go and Wuffs). No tables and no allocations.
+//
+constexpr s32 PARSE_FLOAT_MAX_DIGITS = 800;  // More digits than this can't change the result, we only remember if they were non-zero
+constexpr s32 PARSE_FLOAT_MAX_SHIFT = 60;    // So digit * 2^shift + carry fits in 64 bits
+
+struct parse_float_decimal {
+    s32 DigitCount = 0;
+    s32 DecimalPoint = 0;  // The value is 0.Digits * 10^DecimalPoint
+    bool Truncated = false;
+    byte Digits[PARSE_FLOAT_MAX_DIGITS];
+};
+
+inline void parse_float_decimal_trim(parse_float_decimal &d) {
+    while (d.DigitCount && !d.Digits[d.DigitCount - 1]) --d.DigitCount;
+}
+
+inline void parse_float_decimal_right_shift(parse_float_decimal &d, s32 shift) {
+    s32 r = 0, w = 0;
+    u64 n = 0;
+
+    // Read enough leading digits to produce the first digit of the result
+    while (!(n >> shift)) {
+        if (r >= d.DigitCount) {
+            if (!n) {
+                d.DigitCount = 0;
+                return;
+            }
+            while (!(n >> shift)) {
+                n *= 10;
+                ++r;
+            }
+            break;
+        }
+        n = n * 10 + d.Digits[r++];
+    }
+    d.DecimalPoint -= r - 1;
+
+    u64 mask = (1ull << shift) - 1;
+    while (r < d.DigitCount) {
+        byte digit = (byte) (n >> shift);
+        n &= mask;
+        d.Digits[w++] = digit;
+        n = n * 10 + d.Digits[r++];
+    }
+    while (n) {
+        byte digit = (byte) (n >> shift);
+        n &= mask;
+        if (w < PARSE_FLOAT_MAX_DIGITS) {
+            d.Digits[w++] = digit;
+        } else if (digit) {
+            d.Truncated = true;
+        }
+        n *= 10;
+    }
+    d.DigitCount = w;
+    parse_float_decimal_trim(d);
+}
+
+inline void parse_float_decimal_left_shift(parse_float_decimal &d, s32 shift) {
+    if (!d.DigitCount) return;
+
+    // Multiply from the least significant digit, the result comes out reversed
+    byte reversed[PARSE_FLOAT_MAX_DIGITS + 20];
+    s32 count = 0;
+
+    u64 carry = 0;
+    for (s32 i = d.DigitCount - 1; i >= 0; --i) {
+        u64 n = ((u64) d.Digits[i] << shift) + carry;
+        reversed[count++] = (byte) (n % 10);
+        carry = n / 10;
+    }
+    while (carry) {
+        reversed[count++] = (byte) (carry % 10);
+        carry /= 10;
+    }
+
+    d.DecimalPoint += count - d.DigitCount;
+
+    s32 dropped = count > PARSE_FLOAT_MAX_DIGITS ? count - PARSE_FLOAT_MAX_DIGITS : 0;
+    For(range(dropped)) {
+        if (reversed[it]) d.Truncated = true;
+    }
+
+    d.DigitCount = count - dropped;
+    For(range(d.DigitCount)) d.Digits[it] = reversed[count - 1 - it];
+    parse_float_decimal_trim(d);
+}
+
+// The integral part of the decimal, rounded half to even
+inline u64 parse_float_decimal_round(const parse_float_decimal &d) {
+    if (!d.DigitCount || d.DecimalPoint < 0) return 0;
+    if (d.DecimalPoint > 18) return 0xFFFFFFFFFFFFFFFFull;
+
+    s32 point = d.DecimalPoint;
+
+    u64 n = 0;
+    For(range(point)) n = n * 10 + (it < d.DigitCount ? d.Digits[it] : 0);
+
+    bool up = false;
+    if (point < d.DigitCount) {
+        up = d.Digits[point] >= 5;
+        if (d.Digits[point] == 5 && point + 1 == d.DigitCount) {
+            up = d.Truncated || (point > 0 && (d.Digits[point - 1] & 1));
+        }
+    }
+    return up ? n + 1 : n;
+}
+
+template <typename F>
+parse_float_adjusted parse_float_decimal_to_binary(parse_float_decimal &d) {
+    using format = parse_float_format<F>;
+
+    constexpr parse_float_adjusted ZERO = {0, 0};
+    constexpr parse_float_adjusted INF = {0, format::INFINITE_POWER};
+
+    if (!d.DigitCount || d.DecimalPoint < -324) return ZERO;
+    if (d.DecimalPoint >= 310) return INF;
+
+    // How many bits we can shift to stay above/below 1 when the decimal point is at i (roughly log2(10^i))
+    constexpr s32 POWERS[] = {0, 3, 6, 9, 13, 16, 19, 23, 26, 29, 33, 36, 39, 43, 46, 49, 53, 56, 59};
+    constexpr s32 POWERS_COUNT = sizeof(POWERS) / sizeof(POWERS[0]);
+
+    s32 exp2 = 0;
+    while (d.DecimalPoint > 0) {
+        s32 n = d.DecimalPoint;
+        s32 shift = n < POWERS_COUNT ? POWERS[n] : PARSE_FLOAT_MAX_SHIFT;
+        parse_float_decimal_right_shift(d, shift);
+        if (d.DecimalPoint < -2047) return ZERO;
+        exp2 += shift;
+    }
+
+    // Now the value is in [0, 1), shift it to [1/2, 1)
+    while (d.DecimalPoint <= 0) {
+        s32 shift;
+        if (d.DecimalPoint == 0) {
+            if (d.Digits[0] >= 5) break;
+            shift = d.Digits[0] < 2 ? 2 : 1;
+        } else {
+            s32 n = -d.DecimalPoint;
+            shift = n < POWERS_COUNT ? POWERS[n] : PARSE_FLOAT_MAX_SHIFT;
+        }
+        parse_float_decimal_left_shift(d, shift);
+        if (d.DecimalPoint > 2047) return INF;
+        exp2 -= shift;
+    }
+
+    // ... and to [1, 2)
+    --exp2;
+
+    while (format::MIN_EXPONENT + 1 > exp2) {
+        s32 n = format::MIN_EXPONENT + 1 - exp2;
+        if (n > PARSE_FLOAT_MAX_SHIFT) n = PARSE_FLOAT_MAX_SHIFT;
+        parse_float_decimal_right_shift(d, n);
+        exp2 += n;
+    }
+    if (exp2 - format::MIN_EXPONENT >= format::INFINITE_POWER) return INF;
+
+    constexpr s32 MANTISSA_SIZE = format::MANTISSA_BITS + 1;
+    parse_float_decimal_left_shift(d, MANTISSA_SIZE);
+
+    u64 mantissa = parse_float_decimal_round(d);
+    if (mantissa >= (1ull << MANTISSA_SIZE)) {
+        // Rounding overflowed the mantissa
+        parse_float_decimal_right_shift(d, 1);
+        ++exp2;
+        mantissa = parse_float_decimal_round(d);
+        if (exp2 - format::MIN_EXPONENT >= format::INFINITE_POWER) return INF;
+    }
+
+    parse_float_adjusted result;
+    result.Power2 = exp2 - format::MIN_EXPONENT;
+    if (mantissa < (1ull << format::MANTISSA_BITS)) --result.Power2;  // Subnormal
+    result.Mantissa = mantissa & ((1ull << format::MANTISSA_BITS) - 1);
+    return result;
+}
+
+// The digits of the number as they appeared in the input (the fraction without the '.')
+struct parse_float_digits {
+    const byte *Integral = null;
+    s64 IntegralCount = 0;
+
+    const byte *Fraction = null;
+    s64 FractionCount = 0;
+
+    s64 Exponent = 0;  // The explicit exponent (after e/E)
+};
+
+template <typename F>
+parse_float_adjusted parse_float_slow(const parse_float_digits &digits) {
+    parse_float_decimal d;
+
+    auto push = [&](byte ch) {
+        if (d.DigitCount < PARSE_FLOAT_MAX_DIGITS) {
+            d.Digits[d.DigitCount++] = ch - '0';
+        } else if (ch != '0') {
+            d.Truncated = true;
+        }
+    };
+
+    For(range(digits.IntegralCount)) {
+        byte ch = digits.Integral[it];
+        if (!d.DigitCount && ch == '0') continue;
+        push(ch);
+        ++d.DecimalPoint;
+    }
+    For(range(digits.FractionCount)) {
+        byte ch = digits.Fraction[it];
+        if (!d.DigitCount && ch == '0') {
+            --d.DecimalPoint;
+            continue;
+        }
+        push(ch);
+    }
+
+    // The exponent was clamped when parsing it, anything past that is infinity or zero anyway
+    d.DecimalPoint += (s32) digits.Exponent;
+
+    parse_float_decimal_trim(d);
+    return parse_float_decimal_to_binary<F>(d);
+}
+
+// _w_ has the first 19 significant digits of the input, w * 10^q is the value. _truncated_ is true if there were more non-zero digits.
+template <typename F>
+F parse_float_compute(u64 w, s64 q, bool truncated, bool negative, const parse_float_digits &digits) {
+    using format = parse_float_format<F>;
+
+    // Clinger's fast path - w and 10^q are exact as floats, so the result of a single multiplication/division is correctly rounded
+    if (!truncated && w <= format::MAX_EXACT_MANTISSA && q >= -format::MAX_EXACT_POWER_OF_TEN && q <= format::MAX_EXACT_POWER_OF_TEN) {
+        F value = (F) w;
+        if (q < 0) {
+            value = value / (F) PARSE_FLOAT_EXACT_POWERS_OF_TEN[-q];
+        } else {
+            value = value * (F) PARSE_FLOAT_EXACT_POWERS_OF_TEN[q];
+        }
+        return negative ? -value : value;
+    }
+
+    parse_float_adjusted am = parse_float_eisel_lemire<F>(q, w);
+
+    // The real value is between w * 10^q and (w + 1) * 10^q, if both round to the same float that's the answer
+    if (truncated && !(am == parse_float_eisel_lemire<F>(q, w + 1))) am = parse_float_slow<F>(digits);
+
+    return parse_float_to_float<F>(am, negative);
+}
+
+template <typename F>
+parse_result<F> parse_float_special(bytes buffer, bytes p, bool negative) {
+    auto expect = [&](const char *word) {
+        while (*word) {
+            parse_status status = expect_byte<true>(&p, (byte) *word++);
+            if (status != PARSE_SUCCESS) return status;
+        }
+        return PARSE_SUCCESS;
+    };
+
+    F value;
+    if ((p[0] | 0x20) == 'i') {
+        parse_status status = expect("inf");
+        if (status == PARSE_INVALID) return {0, status, p};
+        if (status == PARSE_EXHAUSTED) return {0, status, buffer};
+
+        // "infinity" is optional, if it's not all there we stop after "inf"
+        bytes afterInf = p;
+        if (expect("inity") != PARSE_SUCCESS) p = afterInf;
+
+        value = numeric_info<F>::infinity();
+    } else {
+        parse_status status = expect("nan");
+        if (status == PARSE_INVALID) return {0, status, p};
+        if (status == PARSE_EXHAUSTED) return {0, status, buffer};
+
+        value = numeric_info<F>::quiet_NaN();
+    }
+    return {negative ? -value : value, PARSE_SUCCESS, p};
+}
+
+always_inline bool parse_float_is_digit(byte ch) { return (byte) (ch - '0') < 10; }
+}  // namespace internal
+
+// Attemps to parse a floating point number (f32 or f64), the result is correctly rounded (the nearest float, ties to even).
+//
+// Valid numbers are in the form (+|-)[digit]*(.[digit]*)((e|E)(+|-)[digit]+) with at least one digit before or after the '.',
+// as well as "inf", "infinity" and "nan" (ignoring case). The sign, the exponent and the special values can be turned off with options.
+// An 'e' which isn't followed by digits is not part of the number (it's left in the rest of the buffer), same as strtod.
+//
+// Most inputs are done with Clinger's fast path (a single float multiplication) or the Eisel-Lemire algorithm
+// (one or two 64x64 bit multiplications with a table of powers of 5). Only numbers with more than 19 significant
+// digits which are very close to halfway between two floats go through the slow exact path.
+//
+// This function doesn't eat white space from the beginning.
+//
+// Returns:
+//   * PARSE_SUCCESS          if a valid number was parsed. Numbers too big for the type become infinity, too small ones become 0,
+//   * PARSE_EXHAUSTED        if an empty buffer was passed or we parsed a sign (or the beginning of "inf"/"nan") but ran out of bytes,
+//   * PARSE_INVALID          if the function wasn't able to parse a valid number.
+//
+template <typename F, parse_float_options Options = parse_float_options{}>
+parse_result<F> parse_float(bytes buffer) {
+    static_assert(types::is_same<F, f32> || types::is_same<F, f64>, "Only f32 and f64 are supported");
+
+    if (!buffer) return {0, PARSE_EXHAUSTED, buffer};
+
+    bytes p = buffer;
+
+    bool negative = false;
+    if constexpr (Options.ParseSign) {
+        if (p[0] == '+') {
+            advance_bytes(&p, 1);
+            if constexpr (!Options.AllowPlusSign) {
+                return {0, PARSE_INVALID, p};
+            }
+        } else if (p[0] == '-') {
+            negative = true;
+            advance_bytes(&p, 1);
+        }
+        if (!p) return {0, PARSE_EXHAUSTED, buffer};
+    }
+
+    if constexpr (Options.ParseSpecialValues) {
+        byte lower = p[0] | 0x20;
+        if (lower == 'i' || lower == 'n') return internal::parse_float_special<F>(buffer, p, negative);
+    }
+
+    // We keep the first 19 significant digits in _w_ (they always fit in 64 bits)
+    u64 w = 0;
+    s32 significant = 0;
+    s64 exponent = 0;  // Of the last digit in _w_
+    bool truncated = false;
+
+    internal::parse_float_digits digits;
+
+    digits.Integral = p.Data;
+    while (p && internal::parse_float_is_digit(p[0])) {
+        // 8 digits at a time while they fit
+        if (w && significant <= 19 - 8 && p.Count >= 8) {
+            u64 x = internal::swar_load_8(p.Data);
+            if (internal::swar_all_decimal_digits(x)) {
+                w = w * 100000000 + internal::swar_parse_8_decimal_digits(x);
+                significant += 8;
+                advance_bytes(&p, 8);
+                continue;
+            }
+        }
+
+        byte digit = p[0] - '0';
+        if (significant < 19) {
+            if (w || digit) {
+                w = w * 10 + digit;
+                ++significant;
+            }
+        } else {
+            ++exponent;
+            if (digit) truncated = true;
+        }
+        advance_bytes(&p, 1);
+    }
+    digits.IntegralCount = p.Data - digits.Integral;
+
+    if (p && p[0] == '.') {
+        advance_bytes(&p, 1);
+
+        digits.Fraction = p.Data;
+        while (p && internal::parse_float_is_digit(p[0])) {
+            if (w && significant <= 19 - 8 && p.Count >= 8) {
+                u64 x = internal::swar_load_8(p.Data);
+                if (internal::swar_all_decimal_digits(x)) {
+                    w = w * 100000000 + internal::swar_parse_8_decimal_digits(x);
+                    significant += 8;
+                    exponent -= 8;
+                    advance_bytes(&p, 8);
+                    continue;
+                }
+            }
+
+            byte digit = p[0] - '0';
+            if (significant < 19) {
+                if (w || digit) {
+                    w = w * 10 + digit;
+                    ++significant;
+                }
+                --exponent;
+            } else {
+                if (digit) truncated = true;
+            }
+            advance_bytes(&p, 1);
+        }
+        digits.FractionCount = p.Data - digits.Fraction;
+    }
+
+    if (!digits.IntegralCount && !digits.FractionCount) {
+        if (!p) return {0, PARSE_EXHAUSTED, buffer};
+
+        advance_bytes(&p, 1);
+        return {0, PARSE_INVALID, p};
+    }
+
+    if constexpr (Options.ParseExponent) {
+        if (p && (p[0] | 0x20) == 'e') {
+            bytes e = p;
+            advance_bytes(&e, 1);
+
+            bool negativeExponent = false;
+            if (e && (e[0] == '+' || e[0] == '-')) {
+                negativeExponent = e[0] == '-';
+                advance_bytes(&e, 1);
+            }
+
+            if (e && internal::parse_float_is_digit(e[0])) {
+                s64 explicitExponent = 0;
+                while (e && internal::parse_float_is_digit(e[0])) {
+                    // Anything this big is infinity or zero anyway, we just have to not overflow
+                    if (explicitExponent < 0x10000000) explicitExponent = explicitExponent * 10 + (e[0] - '0');
+                    advance_bytes(&e, 1);
+                }
+                if (negativeExponent) explicitExponent = -explicitExponent;
+
+                digits.Exponent = explicitExponent;
+                exponent += explicitExponent;
+                p = e;
+            }
+        }
+    }
+
+    return {internal::parse_float_compute<F>(w, exponent, truncated, negative, digits), PARSE_SUCCESS, p};
+}
+
 struct eat_hex_byte_result {
     byte Value;
     parse_status Status;
@@ -596,8 +1271,30 @@ struct eat_bytes_result {
     bytes Rest;    // The rest of the buffer
 };
 
+namespace internal {
+// ASCII sets go through the nibble lookup which find_any_of() uses (defined in string.cpp, 16 or 32 bytes per iteration).
+// Bytes >= 0x80 are never in an ASCII set, so this is exact for arbitrary bytes too.
+// Returns false if the buffer is too short for it to pay off or the set isn't ASCII, otherwise _offset_ is the
+// first byte which is in the set (or isn't, with _notAnyOf_), or -1.
+inline bool eat_bytes_find_ascii_set(bytes buffer, bytes set, bool notAnyOf, s64 *offset) {
+    if (buffer.Count < 16 || !set) return false;
+    For(set) {
+        if (it >= 0x80) return false;
+    }
+
+    *offset = utf8_find_any_of_ascii_simd((const utf8 *) buffer.Data, buffer.Count, (const utf8 *) set.Data, set.Count, notAnyOf);
+    return true;
+}
+}  // namespace internal
+
 // Returns: the bytes read, a success flag (false if buffer was exhausted), and the rest of the buffer
 inline eat_bytes_result eat_bytes_until(bytes buffer, byte delim) {
+    s64 offset;
+    if (internal::eat_bytes_find_ascii_set(buffer, bytes(&delim, 1), false, &offset)) {
+        if (offset == -1) return {{}, false, buffer};
+        return {bytes(buffer.Data, offset), true, bytes(buffer.Data + offset, buffer.Count - offset)};
+    }
+
     bytes p = buffer;
     while (p.Count >= 4) {
         if (U32_HAS_BYTE(*(u32 *) p.Data, delim)) break;
@@ -612,7 +1309,12 @@ inline eat_bytes_result eat_bytes_until(bytes buffer, byte delim) {
 
 // Returns: the bytes read, a success flag (false if buffer was exhausted), and the rest of the buffer
 inline eat_bytes_result eat_bytes_until_any_of(bytes buffer, bytes anyOfTheseDelims) {
-    // @Speed Benchmark this!
+    s64 offset;
+    if (internal::eat_bytes_find_ascii_set(buffer, anyOfTheseDelims, false, &offset)) {
+        if (offset == -1) return {{}, false, buffer};
+        return {bytes(buffer.Data, offset), true, bytes(buffer.Data + offset, buffer.Count - offset)};
+    }
+
     byte minb = 255, maxb = 0;
     For(anyOfTheseDelims) {
         if (it < minb) minb = it;
@@ -638,6 +1340,12 @@ inline eat_bytes_result eat_bytes_until_any_of(bytes buffer, bytes anyOfTheseDel
 
 // Returns: the bytes read, a success flag (false if buffer was exhausted), and the rest of the buffer
 inline eat_bytes_result eat_bytes_while(bytes buffer, byte eats) {
+    s64 offset;
+    if (internal::eat_bytes_find_ascii_set(buffer, bytes(&eats, 1), true, &offset)) {
+        if (offset == -1) return {{}, false, buffer};
+        return {bytes(buffer.Data, offset), true, bytes(buffer.Data + offset, buffer.Count - offset)};
+    }
+
     bytes p = buffer;
     while (p.Count >= 4) {
         if (!(U32_HAS_BYTE(*(u32 *) p.Data, eats))) break;
@@ -652,7 +1360,12 @@ inline eat_bytes_result eat_bytes_while(bytes buffer, byte eats) {
 
 // Returns: the bytes read, a success flag (false if buffer was exhausted), and the rest of the buffer
 inline eat_bytes_result eat_bytes_while_any_of(bytes buffer, bytes anyOfTheseEats) {
-    // @Speed Benchmark this!
+    s64 offset;
+    if (internal::eat_bytes_find_ascii_set(buffer, anyOfTheseEats, true, &offset)) {
+        if (offset == -1) return {{}, false, buffer};
+        return {bytes(buffer.Data, offset), true, bytes(buffer.Data + offset, buffer.Count - offset)};
+    }
+
     byte minb = 255, maxb = 0;
     For(anyOfTheseEats) {
         if (it < minb) minb = it;
@@ -813,6 +1526,14 @@ struct eat_white_space_result {
 // Read the doc in _eat_code_points_until_!
 inline eat_white_space_result eat_white_space(const string &str) {
     bytes p = (bytes) str;
+
+    // White space is ASCII, skip it in blocks. The loop below validates the code point we stopped at.
+    s64 offset;
+    if (internal::eat_bytes_find_ascii_set(p, (bytes)(string) " \t\n\v\f\r", true, &offset)) {
+        if (offset == -1) return {PARSE_EXHAUSTED, str};
+        advance_bytes(&p, offset);
+    }
+
     while (true) {
         auto [cp, status, rest] = eat_code_point(p);
         if (status == PARSE_EXHAUSTED) return {PARSE_EXHAUSTED, str};
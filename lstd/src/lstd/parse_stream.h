@@ -0,0 +1,216 @@
+#pragma once
+
+#include "memory/delegate.h"
+#include "parse.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// The functions in parse.h work on one contiguous buffer. When input arrives in chunks (a socket, a file read
+// in pieces) a parse_stream sits in front of them so the chunks don't need to be concatenated first.
+//
+//     byte buffer[4_KiB];
+//     auto reader = [&]() -> bytes { s64 n = read_some(file, buffer, sizeof(buffer)); return bytes(buffer, n); };
+//
+//     parse_stream s;
+//     parse_stream_init(s, &reader);
+//     defer(free(s));
+//
+//     auto [value, status, rest] = parse_stream_int<s32>(s);
+//
+// _Read_ returns the next chunk, or an empty one at the end of the input. A chunk must stay valid until the next call to _Read_.
+//
+// Tokens are parsed in place in the chunk. Only when a token reaches the end of a chunk (and so may continue in
+// the next one), we copy its bytes to _Carry_, append bytes from the next chunk and parse again. The step doubles
+// each time so long tokens are scanned O(n) times in total. Once the carried bytes are consumed we go back to parsing
+// directly in the chunk. Memory used is bounded by the longest token (not the whole stream).
+//
+// Returned bytes/strings point either into a chunk or into _Carry_, they are valid until the next call on the stream.
+//
+// The statuses are the same as the buffer versions, except PARSE_EXHAUSTED which now means the stream ended.
+//
+struct parse_stream {
+    static constexpr s64 MIN_CARRY_STEP = 64;
+
+    delegate<bytes()> Read;
+
+    bytes Current;      // The bytes we parse next, points into a chunk or into _Carry_
+    bytes Chunk;        // The part of the current chunk not in _Current_ yet (only non-empty while _Current_ is in _Carry_)
+    array<byte> Carry;  // A token which spans chunks
+
+    bool Ended = false;  // _Read_ returned an empty chunk
+};
+
+inline void parse_stream_init(parse_stream &s, const delegate<bytes()> &read) {
+    s.Read    = read;
+    s.Current = {};
+    s.Chunk   = {};
+    s.Ended   = false;
+    array_reset(s.Carry);
+}
+
+inline void free(parse_stream &s) {
+    free(s.Carry);
+    s.Current = {};
+    s.Chunk   = {};
+}
+
+namespace internal {
+inline bytes parse_stream_read(parse_stream &s) {
+    if (s.Ended) return {};
+
+    bytes chunk = s.Read();
+    if (!chunk) s.Ended = true;
+    return chunk;
+}
+
+// Makes sure _Current_ isn't empty unless the stream has ended. Returns false at the end.
+inline bool parse_stream_fill(parse_stream &s) {
+    if (s.Current) return true;
+
+    if (!s.Chunk) s.Chunk = parse_stream_read(s);
+    s.Current = s.Chunk;
+    s.Chunk   = {};
+    return s.Current;
+}
+
+// _Current_ ran out in the middle of a token, moves it to the front of _Carry_ and appends bytes from the next chunk
+inline void parse_stream_grow(parse_stream &s) {
+    bool inCarry = s.Current.Data >= s.Carry.Data && s.Current.Data < s.Carry.Data + s.Carry.Count;
+    if (!inCarry) {
+        array_reset(s.Carry);
+        array_append(s.Carry, s.Current.Data, s.Current.Count);
+    } else if (s.Current.Data != s.Carry.Data) {
+        copy_memory(s.Carry.Data, s.Current.Data, s.Current.Count);
+        s.Carry.Count = s.Current.Count;
+    }
+
+    if (!s.Chunk) s.Chunk = parse_stream_read(s);
+
+    s64 step = min(s.Chunk.Count, max(s.Carry.Count, parse_stream::MIN_CARRY_STEP));
+    array_append(s.Carry, s.Chunk.Data, step);
+    advance_bytes(&s.Chunk, step);
+
+    s.Current = bytes(s.Carry.Data, s.Carry.Count);
+}
+
+template <typename T>
+bool parse_stream_exhausted(const parse_result<T> &r) { return r.Status == PARSE_EXHAUSTED; }
+inline bool parse_stream_exhausted(const eat_bytes_result &r) { return !r.Success; }
+inline bool parse_stream_exhausted(const parse_string_result &r) { return r.Status == PARSE_EXHAUSTED; }
+
+template <typename T>
+bytes parse_stream_rest(const parse_result<T> &r) { return r.Rest; }
+inline bytes parse_stream_rest(const eat_bytes_result &r) { return r.Rest; }
+inline bytes parse_stream_rest(const parse_string_result &r) { return (bytes) r.Rest; }
+}  // namespace internal
+
+// Calls _parse_ (which takes bytes and returns one of the parse.h result types) on the stream, retrying with more
+// bytes while it runs out of them. Use this to run parse functions which don't have a wrapper below.
+//
+// If _Greedy_, a token which ends exactly with the available bytes is also retried (an integer may have more digits in the
+// next chunk), otherwise it's returned right away (a matched sequence is complete regardless of what comes after it).
+template <bool Greedy = true, typename Parse>
+auto parse_stream_run(parse_stream &s, Parse &&parse) {
+    while (true) {
+        internal::parse_stream_fill(s);
+
+        auto r = parse(s.Current);
+
+        bool exhausted = internal::parse_stream_exhausted(r);
+        bytes rest     = internal::parse_stream_rest(r);
+
+        bool needsMore = exhausted || (Greedy && !rest);
+        bool hasMore   = s.Chunk || !s.Ended;
+        if (!needsMore || !hasMore) {
+            if (!exhausted) s.Current = rest;
+            return r;
+        }
+
+        internal::parse_stream_grow(s);
+    }
+}
+
+template <typename IntT, parse_int_options Options = parse_int_options{}>
+parse_result<IntT> parse_stream_int(parse_stream &s, u32 base = 10) {
+    return parse_stream_run(s, [base](bytes p) { return parse_int<IntT, Options>(p, base); });
+}
+
+template <typename F, parse_float_options Options = parse_float_options{}>
+parse_result<F> parse_stream_float(parse_stream &s) {
+    return parse_stream_run(s, [](bytes p) { return parse_float<F, Options>(p); });
+}
+
+template <parse_bool_options Options = parse_bool_options{}>
+parse_result<bool> parse_stream_bool(parse_stream &s) {
+    return parse_stream_run(s, [](bytes p) { return parse_bool<Options>(p); });
+}
+
+template <parse_guid_options Options = parse_guid_options{}>
+parse_result<guid> parse_stream_guid(parse_stream &s) {
+    return parse_stream_run(s, [](bytes p) { return parse_guid<Options>(p); });
+}
+
+// If _IgnoreCase_ is true, then _sequence_ must be lower case (to save on performance)
+template <bool IgnoreCase = false>
+parse_status parse_stream_expect_sequence(parse_stream &s, bytes sequence) {
+    auto r = parse_stream_run<false>(s, [sequence](bytes p) -> parse_result<bool> {
+        parse_status status = expect_sequence<IgnoreCase>(&p, sequence);
+        return {status == PARSE_SUCCESS, status, p};
+    });
+    return r.Status;
+}
+
+inline eat_bytes_result parse_stream_eat_bytes_until(parse_stream &s, byte delim) {
+    return parse_stream_run<false>(s, [delim](bytes p) { return eat_bytes_until(p, delim); });
+}
+
+inline eat_bytes_result parse_stream_eat_bytes_until_any_of(parse_stream &s, bytes anyOfTheseDelims) {
+    return parse_stream_run<false>(s, [anyOfTheseDelims](bytes p) { return eat_bytes_until_any_of(p, anyOfTheseDelims); });
+}
+
+inline eat_bytes_result parse_stream_eat_bytes_while(parse_stream &s, byte eats) {
+    return parse_stream_run(s, [eats](bytes p) { return eat_bytes_while(p, eats); });
+}
+
+inline eat_bytes_result parse_stream_eat_bytes_while_any_of(parse_stream &s, bytes anyOfTheseEats) {
+    return parse_stream_run(s, [anyOfTheseEats](bytes p) { return eat_bytes_while_any_of(p, anyOfTheseEats); });
+}
+
+inline parse_result<utf32> parse_stream_eat_code_point(parse_stream &s) {
+    return parse_stream_run<false>(s, [](bytes p) { return eat_code_point(p); });
+}
+
+inline parse_string_result parse_stream_eat_code_points_until(parse_stream &s, utf32 delim) {
+    return parse_stream_run<false>(s, [delim](bytes p) { return eat_code_points_until(p, delim); });
+}
+
+inline parse_string_result parse_stream_eat_code_points_until_any_of(parse_stream &s, const string &anyOfTheseDelims) {
+    return parse_stream_run<false>(s, [&anyOfTheseDelims](bytes p) { return eat_code_points_until_any_of(p, anyOfTheseDelims); });
+}
+
+// Unlike the other functions white space isn't a token - what we skipped is dropped right away instead of
+// carried, so a long run of white space doesn't take memory. Only a code point split between chunks gets carried.
+//
+// Status is: PARSE_SUCCESS, PARSE_INVALID (invalid utf8), PARSE_EXHAUSTED (the stream ended)
+inline parse_status parse_stream_eat_white_space(parse_stream &s) {
+    while (true) {
+        if (!internal::parse_stream_fill(s)) return PARSE_EXHAUSTED;
+
+        while (s.Current && s.Current[0] < 0x80 && is_space(s.Current[0])) advance_bytes(&s.Current, 1);
+        if (!s.Current) continue;
+        if (s.Current[0] < 0x80) return PARSE_SUCCESS;
+
+        // Non-ascii, eat it only if it's white space
+        auto r = parse_stream_run<false>(s, [](bytes p) -> parse_result<bool> {
+            auto [cp, status, rest] = eat_code_point(p);
+            if (status != PARSE_SUCCESS) return {false, status, rest};
+            if (!is_space(cp)) return {false, PARSE_SUCCESS, p};
+            return {true, PARSE_SUCCESS, rest};
+        });
+        if (r.Status != PARSE_SUCCESS) return r.Status;
+        if (!r.Value) return PARSE_SUCCESS;
+    }
+}
+
+LSTD_END_NAMESPACE
@@ -2,6 +2,7 @@ module;
 
 #include "../internal/context.h"
 #include "../memory/array.h"
+#include "../memory/delegate.h"
 #include "../memory/string.h"
 
 export module path.general;
@@ -70,6 +71,19 @@ export {
         bool Success;
     };
 
+    // Unbuffered reads go straight from the disk to the buffer, which has to be aligned to this
+    // and big enough for the file size rounded up to it (a sector multiple on every disk we care about).
+    constexpr s64 PATH_UNBUFFERED_ALIGNMENT = 4096;
+
+    // Used by _path_read_entire_file_.
+    struct path_read_options {
+        allocator Alloc = {};  // Where the result is allocated, Context.Alloc by default
+
+        // Bypass the OS file cache (FILE_FLAG_NO_BUFFERING / O_DIRECT).
+        // Use this for streaming huge files once, so they don't evict everything else from the page cache.
+        bool Unbuffered = false;
+    };
+
     // Used by _path_write_to_file_.
     enum path_write_mode {
         Append = 0,
@@ -80,6 +94,79 @@ export {
         Overwrite,
         Overwrite_Entire,
     };
+
+    // Used by _path_copy_ and _path_transfer_.
+    struct path_copy_options {
+        bool Overwrite = false;
+
+        // Don't go through the OS file cache, for huge files which would only push everything else out of it
+        bool Unbuffered = false;
+
+        // Called every now and then with how much was copied so far. Return false to cancel.
+        delegate<bool(s64 copied, s64 total)> Progress;
+    };
+
+    // A file or directory found while walking a tree, see _path_tree_walker_.
+    // The metadata comes with the directory listing, so reading it costs nothing extra.
+    struct path_entry {
+        string Path;  // Relative to the root of the walk, points into the walker's buffer (valid until the next entry)
+        string Name;  // The last component of _Path_
+
+        s64 Size = 0;
+        time_t CreationTime = 0, LastAccessTime = 0, LastModificationTime = 0;  // Same units as path_last_modification_time()
+
+        u32 Attributes = 0;  // Platform specific (FILE_ATTRIBUTE_* on Windows)
+        bool IsDirectory = false, IsSymbolicLink = false;
+
+        s64 Depth = 0;  // 0 for entries directly in the root
+    };
+
+    // Used by _path_watcher_.
+    enum class path_change {
+        Added = 0,
+        Removed,
+        Modified,
+        Renamed,  // _OldPath_ is the previous name
+    };
+
+    struct path_change_event {
+        string Path;     // Relative to the watched directory
+        string OldPath;  // Only for Renamed
+        path_change Kind = path_change::Modified;
+    };
+
+    // Used by _path_open_mapping_.
+    enum class path_map_mode {
+        Read_Only = 0,
+        Read_Write,  // Writes to a view go to the file
+    };
+
+    // Tells the OS how a mapped range is going to be accessed (madvise on POSIX), see _path_advise_view_.
+    enum class path_map_hint {
+        Normal = 0,
+        Sequential,  // Read ahead aggressively, pages behind can be dropped early
+        Random,      // Don't read ahead
+        Will_Need,   // Start paging the range in now
+        Dont_Need,   // The range isn't needed for a while, its pages can go first
+    };
+
+    // An open file which views can be mapped from, see _path_open_mapping_.
+    struct path_mapping {
+        void *File   = null;  // null if opening failed
+        void *Handle = null;  // The platform mapping object, null for empty files (there is nothing to map)
+
+        s64 Size = 0;  // Of the file
+        path_map_mode Mode = path_map_mode::Read_Only;
+    };
+
+    // A range of a file mapped into memory. Pages are read on first access.
+    struct path_mapped_view {
+        bytes Content;  // The range which was asked for
+
+        // Views have to start at a multiple of the allocation granularity, so what we actually mapped is a bit bigger.
+        void *Base    = null;
+        s64 BaseSize  = 0;
+    };
 }
 
 LSTD_END_NAMESPACE
\ No newline at end of file
@@ -0,0 +1,181 @@
+module;
+
+#include "../memory/hash_table_build.h"
+#include "../memory/hasher.h"
+#include "../memory/sort.h"
+#include "../memory/string.h"
+
+//
+// Hashing the contents of every file in a directory tree, for incremental builds (what changed since last time)
+// and deduplicating artifacts (which files are the same).
+//
+//     auto digests = path_hash_tree("build/");
+//     defer(free(digests));
+//
+//     For(digests.Failed) print("Couldn't read {}\n", it);
+//     u64 *d = find(digests.Digests, "bin/game.exe").Value;  // Paths are relative to the root
+//
+// The tree is listed first with a path_tree_walker (one pass, the sizes come with the listing), then the files are
+// hashed in parallel on the job system with hash_bytes() - XXH3, the SIMD stripe loop for long inputs.
+// Every job takes the next file from a shared cursor, biggest files first, so one huge file at the end doesn't
+// leave the other workers idle.
+//
+// Nothing is copied into a buffer per file. Small files are read into a buffer each job reuses (one read call),
+// bigger ones are mapped and hashed straight from the page cache (see path_open_mapping).
+//
+// A digest is hash_bytes(contents, size, Seed), the same as hashing a path_read_entire_file() result yourself.
+//
+
+export module path.hash_tree;
+
+import path;
+
+LSTD_BEGIN_NAMESPACE
+
+export {
+    struct path_hash_tree_options {
+        u64 Seed = 0;
+        bool Recursive = true;
+
+        // Files smaller than this are read, the rest are mapped (mapping costs a few syscalls and page faults)
+        s64 MapThreshold = 256_KiB;
+
+        bool Parallel = true;  // Use the job system (if it's running)
+    };
+
+    struct path_digests {
+        hash_table<string, u64> Digests;  // Relative path -> digest, the keys point into _Paths_
+        array<string> Failed;             // Files which couldn't be opened or read, also pointing into _Paths_
+
+        array<utf8> Paths;  // All relative paths back to back
+
+        path_digests() {}
+    };
+
+    // Lists _root_ and hashes every file in it. An empty result if _root_ can't be opened.
+    [[nodiscard("Leak")]] path_digests path_hash_tree(const string &root, path_hash_tree_options options = {});
+
+    void free(path_digests & digests);
+}
+
+// Hashes one file, _buffer_ is for files smaller than MapThreshold
+bool path_hash_file(const string &path, s64 size, const path_hash_tree_options &options, bytes buffer, u64 &digest) {
+    if (size < options.MapThreshold && buffer.Data) {
+        auto [content, success] = path_read_entire_file(path, buffer);
+        if (success) {
+            digest = hash_bytes(content.Data, content.Count, options.Seed);
+            return true;
+        }
+        // It grew since it was listed (or it's gone), mapping sorts out which
+    }
+
+    auto mapping = path_open_mapping(path, path_map_mode::Read_Only, path_map_hint::Sequential);
+    if (!mapping.File) return false;
+    defer(free(mapping));
+
+    auto view = path_map_view(mapping);
+    if (mapping.Handle && !view.Base) return false;  // Empty files have nothing to map
+    defer(path_unmap_view(view));
+
+    digest = hash_bytes(view.Content.Data, view.Content.Count, options.Seed);
+    return true;
+}
+
+path_digests path_hash_tree(const string &root, path_hash_tree_options options) {
+    path_digests result;
+
+    struct file {
+        s64 PathOffset, PathCount, PathLength;  // In _result.Paths_, it moves while we list
+        s64 Size;
+
+        u64 Digest;
+        bool Failed;
+    };
+
+    array<file> files;
+    defer(free(files));
+
+    path_tree_walker w;
+    defer(free(w));
+    if (!path_tree_walker_start(w, root, options.Recursive)) return result;
+
+    while (path_tree_walker_next(w)) {
+        if (w.Entry.IsDirectory) continue;
+
+        array_append(files, file{result.Paths.Count, w.Entry.Path.Count, w.Entry.Path.Length, w.Entry.Size, 0, false});
+        array_append(result.Paths, w.Entry.Path.Data, w.Entry.Path.Count);
+    }
+
+    array<string> keys;
+    defer(free(keys));
+    array_reserve(keys, files.Count);
+    For(files) {
+        string path;
+        path.Data   = result.Paths.Data + it.PathOffset;
+        path.Count  = it.PathCount;
+        path.Length = it.PathLength;
+        array_append(keys, path);
+    }
+
+    // Biggest first, see the top of the file
+    array<u32> order;
+    defer(free(order));
+    array_reserve(order, files.Count);
+    For(range(files.Count)) array_append(order, (u32) it);
+    sort(order, [&](u32 *a, u32 *b) {
+        s64 sa = files[*a].Size, sb = files[*b].Size;
+        return sb > sa ? 1 : (sb < sa ? -1 : 0);
+    });
+
+    s64 next = 0;
+    auto hash_files = [&](s64, s64) {
+        byte *buffer = options.MapThreshold > 0 ? allocate_array<byte>(options.MapThreshold) : null;
+        defer(free(buffer));
+
+        while (true) {
+            s64 i = atomic_add(&next, (s64) 1);
+            if (i >= files.Count) break;
+
+            u32 index = order[i];
+            file &f = files[index];
+
+            string path = path_join(root, keys[index]);
+            f.Failed = !path_hash_file(path, f.Size, options, bytes(buffer, options.MapThreshold), f.Digest);
+            free(path);
+        }
+    };
+
+    // Every piece pulls files until there are none left
+    s64 pieces = options.Parallel ? min(job_system_worker_count(), files.Count) : 0;
+    if (pieces > 1) {
+        job_parallel_for(pieces, 1, &hash_files);
+    } else {
+        hash_files(0, 1);
+    }
+
+    // The ones which were hashed go to the front, in the order they were listed
+    s64 hashed = 0;
+    array<u64> digests;
+    defer(free(digests));
+    array_reserve(digests, files.Count);
+    For(range(files.Count)) {
+        if (files[it].Failed) {
+            array_append(result.Failed, keys[it]);
+        } else {
+            keys[hashed++] = keys[it];
+            array_append(digests, files[it].Digest);
+        }
+    }
+    keys.Count = hashed;
+
+    hash_table_build(result.Digests, keys, digests);
+    return result;
+}
+
+void free(path_digests &digests) {
+    free(digests.Digests);
+    free(digests.Failed);
+    free(digests.Paths);
+}
+
+LSTD_END_NAMESPACE
@@ -1,5 +1,9 @@
 module;
 
+#include "../io/file_reader.h"
+#include "../io/file_writer.h"
+#include "../memory/hash_table.h"
+#include "../memory/signal.h"
 #include "../parse.h"
 #include "../types/windows.h"  // Declarations of API functions
 
@@ -68,6 +72,11 @@ export {
 
     [[nodiscard("Leak")]] string path_join(const string &one, const string &other);
 
+    // Appends the joined path to _out_ instead of allocating a new string.
+    // The size is computed first, so this grows _out_ at most once (and not at all if it has room).
+    void path_join_into(string &out, const array<string> &paths);
+    void path_join_into(string &out, const string &one, const string &other);
+
     // Normalize a pathname by collapsing redundant separators and up-level references so that A//B, A/B/, A/./B and A/foo/../B all become A/B.
     // This string manipulation may change the meaning of a path that contains symbolic links.
     //
@@ -75,8 +84,17 @@ export {
     //
     // There is an edge case in which the path ends with a slash, both /home/user/dir and /home/user/dir/ mean the same thing.
     // You can use other functions to check if they are really directories or files (by querying the OS).
-    [[nodiscard("Leak")]] string
-    path_normalize(const string &path);
+    [[nodiscard("Leak")]] string path_normalize(const string &path);
+
+    // Appends the normalized path to _out_, grows it at most once
+    void path_normalize_into(string &out, const string &path);
+
+    // Normalizes an allocated string without allocating (the result is never longer, except "" -> ".")
+    void path_normalize_in_place(string &path);
+
+    // The allocation-free core of the above: writes to _dest_ which needs room for path.Count + 1 bytes
+    // (e.g. a stack buffer) and returns how many bytes were written. _dest_ may be _path.Data_.
+    s64 path_normalize_to_buffer(utf8 *dest, const string &path);
 
     // Splits path into two components: head (everything up to the last '/') and tail (the rest).
     // The resulting head won't end in '/' unless it is the root.
@@ -119,8 +137,15 @@ export {
     // The following routines query the OS:
     //
 
-    // Reads entire file into memory (no async variant available at the moment).
-    [[nodiscard("Leak")]] path_read_entire_file_result path_read_entire_file(const string &path);
+    // Reads entire file into memory (for async reads see os.win64.async_io).
+    // Big files are read in chunks with a few reads in flight at once, so there is no limit on the size.
+    // The result is allocated with _options.Alloc_, see _path_read_options_ for unbuffered reading.
+    [[nodiscard("Leak")]] path_read_entire_file_result path_read_entire_file(const string &path, path_read_options options = {});
+
+    // Reads entire file into _buffer_ instead of allocating, fails if it doesn't fit. Content points into _buffer_.
+    // For an unbuffered read _buffer_ must be aligned to PATH_UNBUFFERED_ALIGNMENT and have room for the
+    // file size rounded up to it, if it's not aligned we fall back to a normal read. _options.Alloc_ is ignored.
+    path_read_entire_file_result path_read_entire_file(const string &path, bytes buffer, path_read_options options = {});
 
     // Write content to a file.
     // _mode_ determines if the content should be appended, overwritten entirely, or just overwritten.
@@ -133,6 +158,79 @@ export {
     // Returns true on success.
     bool path_write_to_file(const string &path, const string &contents, path_write_mode mode);
 
+    // Opens a file for memory mapping, map ranges of it with _path_map_view_. Nothing is read until a view is accessed,
+    // so this is the way to work with files which are too big to read up front (or of which you only need parts).
+    //
+    // With Read_Write the file is created if it doesn't exist and grown to _size_ if it's smaller.
+    // _hint_ Sequential or Random also tells the OS how we'll read the file (FILE_FLAG_SEQUENTIAL_SCAN/FILE_FLAG_RANDOM_ACCESS),
+    // on Windows that can't be changed per view later.
+    //
+    // Check _File_ in the result for failure. Call free() when done, views stay valid until they are unmapped.
+    [[nodiscard("Leak")]] path_mapping path_open_mapping(const string &path, path_map_mode mode = path_map_mode::Read_Only, path_map_hint hint = path_map_hint::Normal, s64 size = 0);
+
+    void free(path_mapping & mapping);
+
+    // Maps _size_ bytes (the rest of the file if -1) starting at _offset_. The result is empty on failure or if the range is empty.
+    // Call _path_unmap_view_ when done.
+    [[nodiscard("Leak")]] path_mapped_view path_map_view(const path_mapping &mapping, s64 offset = 0, s64 size = -1);
+
+    void path_unmap_view(path_mapped_view & view);
+
+    // Writes the modified pages of a Read_Write view to the file. Returns true on success.
+    bool path_flush_view(const path_mapped_view &view);
+
+    // Tells the OS how a range of the view (all of it by default) is going to be accessed. This is only a hint.
+    // Windows has no per range read ahead control, there Will_Need and Sequential prefetch the range and
+    // Dont_Need drops it from the working set (the pages stay in the file cache).
+    void path_advise_view(const path_mapped_view &view, path_map_hint hint, s64 offset = 0, s64 size = -1);
+
+    //
+    // Watches a directory (and everything under it if _Recursive_) for changes, instead of rescanning it with path_walk.
+    //
+    //     path_watcher w;
+    //     path_watcher_start(w, "data/");
+    //     w.Changed.connect(&on_assets_changed);
+    //
+    //     // Every frame, doesn't block
+    //     path_watcher_poll(w);
+    //
+    // The OS collects changes in the background, path_watcher_poll takes everything which happened since the last call
+    // as one batch. Events in a batch are coalesced per path - a file saved ten times is one Modified, created and
+    // then modified is just Added, created and deleted again doesn't show up at all.
+    //
+    // If changes come faster than we poll the OS may run out of room and drop them, then _Overflowed_ is set for
+    // the batch and you should rescan the directory.
+    //
+    struct path_watcher {
+        static constexpr s64 BUFFER_SIZE = 64_KiB;  // For notifications between two polls, 64 KiB is the limit for network drives
+
+        string Root;
+        bool Recursive = true;
+
+        void *Directory = null;  // null if starting failed
+        byte *Buffer    = null;
+
+        char PlatformRequest[sizeof(OVERLAPPED)]{};
+        bool Pending = false;
+
+        array<path_change_event> Events;  // The last batch, valid until the next poll
+        hash_table<string, s64> Index;    // Path -> index in _Events_, for coalescing
+
+        bool Overflowed = false;
+
+        // Emitted by path_watcher_poll (on the thread which polls) when the batch isn't empty or we overflowed
+        signal<void(const array<path_change_event> &)> Changed;
+    };
+
+    // Starts watching _directory_. Returns false if it couldn't be opened.
+    bool path_watcher_start(path_watcher & w, const string &directory, bool recursive = true);
+
+    void free(path_watcher & w);
+
+    // Collects what changed since the last poll, waiting up to _timeoutMs_ for something to happen.
+    // Emits _Changed_ with the batch and returns it.
+    const array<path_change_event> &path_watcher_poll(path_watcher & w, u32 timeoutMs = 0);
+
     bool path_exists(const string &path);  // == is_file() || is_directory()
     bool path_is_file(const string &path);
     bool path_is_directory(const string &path);
@@ -156,6 +254,16 @@ export {
     // or a directory - in which case the file name is kept the same or determined by the OS (in the case of duplicate files).
     bool path_copy(const string &path, const string &dest, bool overwrite);
 
+    // Like the above, with progress reporting and optionally unbuffered. The data never comes to our process,
+    // the OS copies it (CopyFileExW) and may offload it further - block cloning on ReFS, server side copies on network shares.
+    bool path_copy(const string &path, const string &dest, const path_copy_options &options);
+
+    // Sends _size_ bytes (the rest of the file if -1) of _path_ starting at _offset_ to _out_, for destinations which aren't files
+    // (sockets, compressors, hashers). The next chunk is read while _out_ takes the current one. _options.Overwrite_ is ignored.
+    //
+    // Returns how many bytes were sent, -1 if reading failed.
+    s64 path_transfer(const string &path, writer *out, s64 offset = 0, s64 size = -1, const path_copy_options &options = {});
+
     // @Robustness: We don't handle directories.
     //
     // Moves a file to destination.
@@ -223,6 +331,60 @@ export {
     // the path_walker API directly (take a look at the implementation of this function further down the file).
     // The reason we return an array is because that's what is most useful in the general case.
     [[nodiscard("Leak")]] array<string> path_walk(const string &path, bool recursively = false);
+
+    //
+    // Walks a directory tree without allocating per entry - one path buffer is reused for all of them.
+    // For scanning big trees, path_walk allocates every path and asking for sizes or times after that opens each file again.
+    //
+    //     path_tree_walker w;
+    //     path_tree_walker_start(w, "data/");
+    //     defer(free(w));
+    //
+    //     while (path_tree_walker_next(w)) {
+    //         if (w.Entry.IsDirectory && w.Entry.Name == ".git") path_tree_walker_skip(w);
+    //         total += w.Entry.Size;
+    //     }
+    //
+    // Directories come before their contents. We don't follow symbolic links (or other reparse points) to
+    // directories, so there are no cycles. Directories we can't open (no access) are skipped.
+    //
+    struct path_tree_walker : non_copyable {
+        path_entry Entry;  // The current entry, valid until the next call to path_tree_walker_next
+        bool Recursive = true;
+
+        struct level {
+            void *Handle;
+            s64 Path16Count;   // Of the directory this level reads
+            s64 RelativeCount;
+            bool First;        // The find data holds an entry from FindFirstFileExW which wasn't returned yet
+        };
+
+        array<utf16> Path16;       // The directory being read, relative path components appended as we go down
+        array<utf8> RelativePath;  // _Entry.Path_ points here
+        array<level> Levels;
+
+        bool Descend  = false;  // _Entry_ is a directory which the next call goes into
+        s64 BaseDepth = 0;      // Of the root, not 0 for the directories path_walk_parallel hands out
+
+        char PlatformFileInfo[sizeof(WIN32_FIND_DATAW)]{};
+    };
+
+    // Returns false if _root_ couldn't be opened.
+    bool path_tree_walker_start(path_tree_walker & w, const string &root, bool recursive = true);
+
+    // Moves to the next entry. Returns false when there are no more.
+    bool path_tree_walker_next(path_tree_walker & w);
+
+    // Don't go into the directory which was just returned.
+    void path_tree_walker_skip(path_tree_walker & w);
+
+    void free(path_tree_walker & w);
+
+    // Walks the tree on _threadCount_ threads. Each directory is read by one thread, the subdirectories it finds
+    // go to a shared queue for any thread to take, so wide trees get scanned in parallel.
+    //
+    // _callback_ is called for every entry from any of the threads, so it has to be thread safe. The entry is valid only during the call.
+    void path_walk_parallel(const string &root, const delegate<void(const path_entry &)> &callback, s64 threadCount = 8);
 }
 
 #define CREATE_FILE_HANDLE_CHECKED(handleName, call, returnOnFail)                                             \
@@ -253,7 +415,8 @@ string get_path_from_here_to(const string &here, const string &there) {
     }
 }
 
-utf16 *utf8_to_utf16(const string &str) { return internal::platform_utf8_to_utf16(str); }
+// Converts on the stack for short strings, only pass the result directly to an API call (see platform_utf16_temp).
+internal::platform_utf16_temp utf8_to_utf16(const string &str) { return internal::platform_utf16_temp(str); }
 
 constexpr path_split_drive_result path_split_drive(const string &path) {
     if (path.Length >= 2) {
@@ -291,54 +454,57 @@ constexpr bool path_is_absolute(const string &path) {
     return rest && path_is_sep(rest[0]);
 }
 
-[[nodiscard("Leak")]] string path_join(const array<string> &paths) {
+void path_join_into(string &out, const array<string> &paths) {
     assert(paths.Count >= 2);
 
-    auto [result_drive, result_path] = path_split_drive(paths[0]);
-
-    string result;
-    clone(&result, result_path);
+    // Find the part the result starts from (the last absolute one or the last one on another drive)
+    // and the drive it ends up with, so we know the size before writing anything.
+    auto [drive, _] = path_split_drive(paths[0]);
+    s64 first       = 0;
 
     For(range(1, paths.Count)) {
-        auto p                 = paths[it];
-        auto [p_drive, p_path] = path_split_drive(p);
+        auto [p_drive, p_path] = path_split_drive(paths[it]);
         if (p_path && path_is_sep(p_path[0])) {
-            // Second path is absolute
-            if (p_drive || !result_drive) {
-                result_drive = p_drive;  // These are just substrings so it's fine
-            }
-
-            free(result);
-            clone(&result, p_path);
-
-            continue;
-        } else if (p_drive && p_drive != result_drive) {
-            if (compare_ignore_case(p_drive, result_drive) != -1) {
-                // Different drives => ignore the first path entirely
-                result_drive = p_drive;
-
-                free(result);
-                clone(&result, p_path);
-
-                continue;
-            }
-            // Same drives, different case
-            result_drive = p_drive;
+            // Absolute
+            if (p_drive || !drive) drive = p_drive;
+            first = it;
+        } else if (p_drive && p_drive != drive) {
+            // Different drives => ignore the previous paths entirely, same drives with different case => keep them
+            if (compare_ignore_case(p_drive, drive) != -1) first = it;
+            drive = p_drive;
         }
+    }
 
-        // Second path is relative to the first
-        if (result && !path_is_sep(result[-1])) {
-            string_append(result, '\\');
-        }
-        string_append(result, p_path);
+    s64 size       = drive.Count + 1;
+    utf8 firstChar = 0;
+    For(range(first, paths.Count)) {
+        auto [p_drive, p_path] = path_split_drive(paths[it]);
+        size += p_path.Count + 1;
+        if (!firstChar && p_path) firstChar = p_path.Data[0];
     }
+    string_reserve(out, size, array_growth::EXACT);
+
+    string_append(out, drive);
 
     // Add separator between UNC and non-absolute path if needed
-    if (result && !path_is_sep(result[0]) && result_drive && result_drive[-1] != ':') {
-        string_insert_at(result, 0, '\\');
-    } else {
-        string_insert_at(result, 0, result_drive);
+    if (firstChar && !path_is_sep(firstChar) && drive && drive[-1] != ':') string_append(out, '\\');
+
+    s64 bodyStart = out.Count;
+    For(range(first, paths.Count)) {
+        auto [p_drive, p_path] = path_split_drive(paths[it]);
+        if (out.Count != bodyStart && !path_is_sep(out.Data[out.Count - 1])) string_append(out, '\\');
+        string_append(out, p_path);
     }
+}
+
+void path_join_into(string &out, const string &one, const string &other) {
+    auto arr = to_stack_array(one, other);
+    path_join_into(out, arr);
+}
+
+[[nodiscard("Leak")]] string path_join(const array<string> &paths) {
+    string result;
+    path_join_into(result, paths);
     return result;
 }
 
@@ -347,64 +513,86 @@ constexpr bool path_is_absolute(const string &path) {
     return path_join(arr);
 }
 
-[[nodiscard("Leak")]] string path_normalize(const string &path) {
-    string result;
-    string_reserve(result, path.Length);
+s64 path_normalize_to_buffer(utf8 *dest, const string &path) {
+    const utf8 *s = path.Data;
+    s64 n         = path.Count;
 
     if (match_beginning(path, "\\\\.\\") || match_beginning(path, "\\\\?\\")) {
         // In the case of paths with these prefixes:
         // \\.\ -> device names
         // \\?\ -> literal paths
         // do not do any normalization, but return the path unchanged.
-        clone(&result, path);
-        return result;
+        copy_memory(dest, s, n);
+        return n;
     }
 
-    auto [DriveOrUNC, rest] = path_split_drive(path);
-    if (DriveOrUNC) {
-        string_append(result, DriveOrUNC);
-    }
+    auto [DriveOrUNC, _] = path_split_drive(path);
+
+    // We only ever drop characters, so what we write is never ahead of what we read and _dest_ can be _path.Data_
+    s64 r = DriveOrUNC.Count, w = 0;
+    copy_memory(dest, s, r);
+    w = r;
 
     // Collapse leading slashes
-    if (path_is_sep(rest[0])) {
-        string_append(result, '\\');
-        while (path_is_sep(rest[0])) advance_cp(&rest, 1);
-    }
-
-    auto components = path_split_into_components(rest);
-    defer(free(components));
-
-    s64 i = 0;
-    while (i < components.Count) {
-        auto it = components[i];
-        if (!it || it == ".") {
-            array_remove_at(components, i);
-        } else if (it == "..") {
-            if (i > 0 && components[i - 1] != "..") {
-                array_remove_range(components, i - 1, i + 1);
-                --i;
-            } else if (i == 0 && result && path_is_sep(result[-1])) {
-                array_remove_at(components, i);
-            } else {
-                ++i;
+    bool rooted = false;
+    if (r < n && path_is_sep(s[r])) {
+        dest[w++] = '\\';
+        rooted    = true;
+        while (r < n && path_is_sep(s[r])) ++r;
+    }
+
+    s64 base = w;  // Components start here, ".." can't go before it
+    while (r < n) {
+        s64 start = r;
+        while (r < n && !path_is_sep(s[r])) ++r;
+        s64 length = r - start;
+        while (r < n && path_is_sep(s[r])) ++r;
+
+        if (!length || (length == 1 && s[start] == '.')) continue;
+
+        if (length == 2 && s[start] == '.' && s[start + 1] == '.') {
+            s64 last = w;
+            while (last > base && dest[last - 1] != '\\') --last;
+
+            bool lastIsUp = w - last == 2 && dest[last] == '.' && dest[last + 1] == '.';
+            if (w != base && !lastIsUp) {
+                w = last == base ? base : last - 1;  // Drop the last component and the separator before it
+                continue;
             }
-        } else {
-            ++i;
+            if (w == base && rooted) continue;  // The parent of the root is the root
         }
+
+        if (w != base) dest[w++] = '\\';
+        copy_memory(dest + w, s + start, length);
+        w += length;
     }
 
     // If the path is now empty, substitute "."
-    if (!result && !components) {
-        return ".";
-    }
+    if (!w) dest[w++] = '.';
+    return w;
+}
+
+void path_normalize_into(string &out, const string &path) {
+    string_reserve(out, path.Count + 1, array_growth::EXACT);
+
+    s64 count = path_normalize_to_buffer(out.Data + out.Count, path);
+    out.Length += utf8_length(out.Data + out.Count, count);
+    out.Count += count;
+}
 
-    For(components) {
-        string_append(result, it);
-        string_append(result, '\\');
+void path_normalize_in_place(string &path) {
+    if (!path.Count) {
+        string_append(path, '.');
+        return;
     }
-    // Remove the trailing slash we added in the final iteration of the loop
-    string_remove_at(result, -1);
 
+    path.Count  = path_normalize_to_buffer(path.Data, path);
+    path.Length = utf8_length(path.Data, path.Count);
+}
+
+[[nodiscard("Leak")]] string path_normalize(const string &path) {
+    string result;
+    path_normalize_into(result, path);
     return result;
 }
 
@@ -526,7 +714,7 @@ bool path_delete_directory(const string &path) {
 bool path_copy(const string &path, const string &dest, bool overwrite) {
     if (!path_is_file(path)) return false;
 
-    auto *u16 = utf8_to_utf16(path);
+    internal::platform_utf16_temp u16(path);
 
     if (path_is_directory(dest)) {
         auto p = path_join(dest, path_base_name(path));
@@ -537,6 +725,124 @@ bool path_copy(const string &path, const string &dest, bool overwrite) {
     return CopyFileW(u16, utf8_to_utf16(dest), !overwrite);
 }
 
+DWORD WINAPI path_copy_progress(LARGE_INTEGER total, LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID data) {
+    auto *options = (const path_copy_options *) data;
+    return options->Progress(transferred.QuadPart, total.QuadPart) ? PROGRESS_CONTINUE : PROGRESS_CANCEL;
+}
+
+bool path_copy(const string &path, const string &dest, const path_copy_options &options) {
+    if (!path_is_file(path)) return false;
+
+    DWORD flags = options.Overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS;
+    if (options.Unbuffered) flags |= COPY_FILE_NO_BUFFERING;
+
+    LPPROGRESS_ROUTINE progress = options.Progress ? path_copy_progress : null;
+
+    internal::platform_utf16_temp u16(path);
+
+    if (path_is_directory(dest)) {
+        auto p = path_join(dest, path_base_name(path));
+        defer(free(p));
+
+        return CopyFileExW(u16, utf8_to_utf16(p), progress, (void *) &options, null, flags);
+    }
+    return CopyFileExW(u16, utf8_to_utf16(dest), progress, (void *) &options, null, flags);
+}
+
+s64 path_transfer(const string &path, writer *out, s64 offset, s64 size, const path_copy_options &options) {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN;
+    if (options.Unbuffered) flags |= FILE_FLAG_NO_BUFFERING;
+
+    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, flags, null), -1);
+    defer(CloseHandle(file));
+
+    LARGE_INTEGER fileSize = {0};
+    if (!GetFileSizeEx(file, &fileSize)) return -1;
+
+    s64 end = size == -1 ? fileSize.QuadPart : min(offset + size, (s64) fileSize.QuadPart);
+    if (offset >= end) return 0;
+
+    // Two chunks, one is read while the other is written out
+    constexpr s64 CHUNK_SIZE = 1_MiB;  // A multiple of PATH_UNBUFFERED_ALIGNMENT
+
+    byte *buffer = allocate_array<byte>(2 * CHUNK_SIZE, {.Alignment = (u32) PATH_UNBUFFERED_ALIGNMENT});
+    defer(free(buffer));
+
+    OVERLAPPED requests[2];
+    s64 starts[2];
+    bool pending[2] = {};
+
+    HANDLE events[2] = {};
+    defer({
+        For(events) if (it) CloseHandle(it);
+    });
+
+    For(events) {
+        it = CreateEventW(null, true, false, null);
+        if (!it) return -1;
+    }
+
+    // Unbuffered reads have to start at a sector, we skip what's before _offset_
+    s64 readPos = options.Unbuffered ? offset / PATH_UNBUFFERED_ALIGNMENT * PATH_UNBUFFERED_ALIGNMENT : offset;
+
+    auto issue = [&](s64 slot) {
+        OVERLAPPED &r = requests[slot];
+        zero_memory(&r, sizeof(r));
+        r.DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset     = (DWORD) readPos;
+        r.DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD) (readPos >> 32);
+        r.hEvent                                    = events[slot];
+
+        if (!ReadFile(file, buffer + slot * CHUNK_SIZE, (DWORD) CHUNK_SIZE, null, &r) && GetLastError() != ERROR_IO_PENDING) return;
+
+        starts[slot]  = readPos;
+        pending[slot] = true;
+        readPos += CHUNK_SIZE;
+    };
+
+    s64 sent    = 0;
+    bool failed = false;
+
+    s64 slot = 0;
+    issue(slot);
+    while (pending[slot]) {
+        s64 other = 1 - slot;
+        if (readPos < end) issue(other);
+
+        DWORD got = 0;
+        bool ok   = GetOverlappedResult(file, &requests[slot], &got, true);
+        pending[slot] = false;
+
+        if (!ok && GetLastError() != ERROR_HANDLE_EOF) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "GetOverlappedResult(file, &requests[slot], &got, true)");
+            failed = true;
+            break;
+        }
+
+        s64 from = max(offset, starts[slot]);
+        s64 to   = min(end, starts[slot] + (s64) got);
+        if (to > from) {
+            out->write(buffer + slot * CHUNK_SIZE + (from - starts[slot]), to - from);
+            sent += to - from;
+        }
+
+        if (options.Progress && !options.Progress(sent, end - offset)) break;
+        if (got < CHUNK_SIZE) break;  // The file ended (or got shorter)
+
+        slot = other;
+    }
+
+    // A read still in flight writes to _buffer_, wait for it
+    For(range(2)) {
+        if (!pending[it]) continue;
+
+        DWORD ignored;
+        CancelIoEx(file, &requests[it]);
+        GetOverlappedResult(file, &requests[it], &ignored, true);
+    }
+
+    return failed ? -1 : sent;
+}
+
 // @Robustness: Handle directories?
 bool path_move(const string &path, const string &dest, bool overwrite) {
     if (!path_is_file(path)) return false;
@@ -580,7 +886,7 @@ void path_read_next_entry(path_walker &walker) {
                 string queryPath = path_join(walker.Path, "*");
                 defer(free(queryPath));
 
-                walker.Path16 = utf8_to_utf16(queryPath);
+                walker.Path16 = internal::platform_utf8_to_utf16(queryPath);
             }
 
             string path = walker.Path;
@@ -657,22 +963,322 @@ void path_walk_recursively_impl(const string &path, const string &first, array<s
     return result;
 }
 
-[[nodiscard("Leak")]] path_read_entire_file_result path_read_entire_file(const string &path) {
-    path_read_entire_file_result fail = {array<byte>{}, false};
-    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, null), fail);
+time_t filetime_to_time(FILETIME t) { return ((time_t) t.dwHighDateTime) << 32 | t.dwLowDateTime; }
+
+// Reads the directory _w.Path16_ points to (relative path _w.RelativePath_), returns false if it can't be opened
+bool path_tree_walker_push(path_tree_walker &w) {
+    s64 count = w.Path16.Count;
+    array_append(w.Path16, L"\\*", 3);  // With the null terminator
+
+    HANDLE h = FindFirstFileExW(w.Path16.Data, FindExInfoBasic, w.PlatformFileInfo, FindExSearchNameMatch, null, FIND_FIRST_EX_LARGE_FETCH);
+    w.Path16.Count = count;
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    array_append(w.Levels, path_tree_walker::level{h, count, w.RelativePath.Count, true});
+    return true;
+}
+
+// _relative_ is where _root_ is relative to the root of the whole walk (at _depth_), see path_walk_parallel
+bool path_tree_walker_start_at(path_tree_walker &w, const string &root, const string &relative, s64 depth, bool recursive) {
+    assert(!w.Levels.Count && "Walker already started, call free() first");
+
+    w.Recursive = recursive;
+    w.Descend   = false;
+    w.BaseDepth = depth;
+    w.Entry     = {};
+
+    array_reset(w.Path16);
+    auto *root16 = internal::platform_utf8_to_utf16(root);
+    array_append(w.Path16, root16, c_string_length(root16));
+
+    // We add the separator
+    while (w.Path16.Count && (w.Path16[-1] == '\\' || w.Path16[-1] == '/')) --w.Path16.Count;
+
+    array_reset(w.RelativePath);
+    array_append(w.RelativePath, relative.Data, relative.Count);
+
+    return path_tree_walker_push(w);
+}
+
+bool path_tree_walker_start(path_tree_walker &w, const string &root, bool recursive) {
+    return path_tree_walker_start_at(w, root, "", 0, recursive);
+}
+
+bool path_tree_walker_next(path_tree_walker &w) {
+    auto *data = (WIN32_FIND_DATAW *) w.PlatformFileInfo;
+
+    if (w.Descend) {
+        w.Descend = false;
+
+        // The find data still holds the directory we just returned
+        w.Path16.Count = w.Levels[-1].Path16Count;
+        array_append(w.Path16, (utf16) '\\');
+        array_append(w.Path16, data->cFileName, c_string_length(data->cFileName));
+        path_tree_walker_push(w);
+    }
+
+    while (w.Levels.Count) {
+        auto &level = w.Levels[-1];
+
+        if (level.First) {
+            level.First = false;
+        } else if (!FindNextFileW((HANDLE) level.Handle, data)) {
+            FindClose((HANDLE) level.Handle);
+            --w.Levels.Count;
+            continue;
+        }
+
+        const utf16 *name = data->cFileName;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+        // The entry's path is the directory's relative path + the name, converted straight into the buffer
+        w.RelativePath.Count = level.RelativeCount;
+        if (w.RelativePath.Count) array_append(w.RelativePath, OS_PATH_SEPARATOR);
+
+        s64 nameStart = w.RelativePath.Count;
+        s64 length16  = c_string_length(name);
+        array_reserve(w.RelativePath, length16 * 3);
+
+        s64 nameCount;
+        utf16_to_utf8(name, length16, w.RelativePath.Data + nameStart, &nameCount);
+        w.RelativePath.Count += nameCount;
+
+        auto &e = w.Entry;
+        e.Path  = string(w.RelativePath.Data, w.RelativePath.Count);
+        e.Name  = string(w.RelativePath.Data + nameStart, nameCount);
+
+        e.Size                 = ((s64) data->nFileSizeHigh) << 32 | data->nFileSizeLow;
+        e.CreationTime         = filetime_to_time(data->ftCreationTime);
+        e.LastAccessTime       = filetime_to_time(data->ftLastAccessTime);
+        e.LastModificationTime = filetime_to_time(data->ftLastWriteTime);
+
+        e.Attributes     = data->dwFileAttributes;
+        e.IsDirectory    = data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+        e.IsSymbolicLink = data->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT;
+        e.Depth          = w.BaseDepth + w.Levels.Count - 1;
+
+        w.Descend = w.Recursive && e.IsDirectory && !e.IsSymbolicLink;
+        return true;
+    }
+    return false;
+}
+
+void path_tree_walker_skip(path_tree_walker &w) { w.Descend = false; }
+
+void free(path_tree_walker &w) {
+    For(w.Levels) FindClose((HANDLE) it.Handle);
+    free(w.Levels);
+    free(w.Path16);
+    free(w.RelativePath);
+    w.Entry   = {};
+    w.Descend = false;
+}
+
+struct path_walk_parallel_state {
+    string Root;
+    delegate<void(const path_entry &)> Callback;
+
+    thread::mutex Mutex;
+    thread::condition_variable Condition;
+
+    struct directory {
+        string Path;  // Relative to _Root_
+        s64 Depth;    // Of its entries
+    };
+
+    array<directory> Queue;  // Left to read
+    s64 Busy = 0;            // Threads reading a directory right now, they may still add to _Queue_
+};
+
+void path_walk_parallel_worker(void *data) {
+    auto *state = (path_walk_parallel_state *) data;
+
+    path_tree_walker w;
+    defer(free(w));
+
+    array<path_walk_parallel_state::directory> found;
+    defer(free(found));
+
+    while (true) {
+        path_walk_parallel_state::directory next;
+        {
+            thread::scoped_lock _(&state->Mutex);
+            while (!state->Queue.Count) {
+                if (!state->Busy) return;  // Nothing queued and nobody is going to queue more
+                state->Condition.wait(&state->Mutex);
+            }
+
+            next = state->Queue[-1];
+            --state->Queue.Count;
+            ++state->Busy;
+        }
+
+        string dir = next.Path ? path_join(state->Root, next.Path) : state->Root;
+
+        // Read one level and hand the subdirectories out instead of going into them ourselves
+        if (path_tree_walker_start_at(w, dir, next.Path, next.Depth, false)) {
+            while (path_tree_walker_next(w)) {
+                state->Callback(w.Entry);
+                if (w.Entry.IsDirectory && !w.Entry.IsSymbolicLink) {
+                    path_walk_parallel_state::directory sub = {{}, next.Depth + 1};
+                    clone(&sub.Path, w.Entry.Path);
+                    array_append(found, sub);
+                }
+            }
+        }
+        free(w);
+
+        if (next.Path) {
+            free(dir);
+            free(next.Path);
+        }
+
+        thread::scoped_lock _(&state->Mutex);
+        array_append(state->Queue, found.Data, found.Count);
+        array_reset(found);
+        --state->Busy;
+        state->Condition.notify_all();
+    }
+}
+
+void path_walk_parallel(const string &root, const delegate<void(const path_entry &)> &callback, s64 threadCount) {
+    assert(threadCount > 0);
+
+    path_walk_parallel_state state;
+    state.Root     = root;
+    state.Callback = callback;
+    state.Mutex.init();
+    state.Condition.init();
+    array_append(state.Queue, path_walk_parallel_state::directory{"", 0});
+
+    auto *threads = allocate_array<thread::thread>(threadCount);
+    For(range(threadCount)) threads[it].init_and_launch(path_walk_parallel_worker, &state);
+    For(range(threadCount)) threads[it].wait();
+    free(threads);
+
+    free(state.Queue);
+    state.Condition.release();
+    state.Mutex.release();
+}
+
+// Reads _size_ bytes from the start of _file_ (opened with FILE_FLAG_OVERLAPPED) into _dest_. Returns how many were read (less if
+// the file ended earlier) or -1 on failure. ReadFile takes a 32 bit size so we go in chunks anyway, and with a few of them queued
+// the disk doesn't sit idle between one read finishing and us asking for the next one.
+s64 path_read_overlapped(HANDLE file, byte *dest, s64 size) {
+    constexpr s64 CHUNK_SIZE = 8_MiB;  // A multiple of PATH_UNBUFFERED_ALIGNMENT
+    constexpr s64 IN_FLIGHT  = 4;
+
+    OVERLAPPED requests[IN_FLIGHT];
+    s64 requestSizes[IN_FLIGHT];
+
+    HANDLE events[IN_FLIGHT] = {};
+    defer({
+        For(events) if (it) CloseHandle(it);
+    });
+
+    For(events) {
+        it = CreateEventW(null, true, false, null);
+        if (!it) return -1;
+    }
+
+    s64 issued = 0, read = 0;
+    s64 first = 0, inFlight = 0;
+
+    bool failed = false, ended = false;
+    while (true) {
+        while (!failed && !ended && inFlight < IN_FLIGHT && issued < size) {
+            s64 slot  = (first + inFlight) % IN_FLIGHT;
+            s64 chunk = min(CHUNK_SIZE, size - issued);
+
+            OVERLAPPED &r = requests[slot];
+            zero_memory(&r, sizeof(r));
+            r.DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset     = (DWORD) issued;
+            r.DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD) (issued >> 32);
+            r.hEvent                                    = events[slot];
+
+            if (!ReadFile(file, dest + issued, (DWORD) chunk, null, &r)) {
+                DWORD error = GetLastError();
+                if (error == ERROR_HANDLE_EOF) {
+                    ended = true;
+                    break;
+                }
+                if (error != ERROR_IO_PENDING) {
+                    windows_report_hresult_error(HRESULT_FROM_WIN32(error), "ReadFile(file, dest + issued, (DWORD) chunk, null, &r)");
+                    failed = true;
+                    break;
+                }
+            }
+
+            requestSizes[slot] = chunk;
+            issued += chunk;
+            ++inFlight;
+        }
+        if (!inFlight) break;
+
+        // Waiting in the order they were issued keeps _read_ a contiguous prefix of _dest_.
+        // After a failure we still wait for the rest, they write to _dest_.
+        DWORD bytesRead = 0;
+        if (!GetOverlappedResult(file, &requests[first], &bytesRead, true)) {
+            DWORD error = GetLastError();
+            if (error != ERROR_HANDLE_EOF && !failed) {
+                windows_report_hresult_error(HRESULT_FROM_WIN32(error), "GetOverlappedResult(file, &requests[first], &bytesRead, true)");
+                failed = true;
+                CancelIoEx(file, null);
+            }
+            bytesRead = 0;
+        }
+
+        if (!ended) read += bytesRead;
+        if (bytesRead < requestSizes[first]) ended = true;  // The file got shorter since we asked for its size
+
+        first = (first + 1) % IN_FLIGHT;
+        --inFlight;
+    }
+    return failed ? -1 : read;
+}
+
+// _buffer_ is null if the caller didn't provide one
+path_read_entire_file_result path_read_entire_file_impl(const string &path, bytes buffer, path_read_options options) {
+    path_read_entire_file_result fail = {bytes{}, false};
+
+    bool unbuffered = options.Unbuffered;
+    if (buffer.Data && (u64) buffer.Data % PATH_UNBUFFERED_ALIGNMENT) unbuffered = false;
+
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN;
+    if (unbuffered) flags |= FILE_FLAG_NO_BUFFERING;
+
+    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, flags, null), fail);
     defer(CloseHandle(file));
 
     LARGE_INTEGER size = {0};
-    GetFileSizeEx(file, &size);
+    if (!GetFileSizeEx(file, &size)) return fail;
+
+    // Unbuffered reads have to be whole sectors, the last one is read past the end of the file
+    s64 toRead = size.QuadPart;
+    if (unbuffered) toRead = (toRead + PATH_UNBUFFERED_ALIGNMENT - 1) / PATH_UNBUFFERED_ALIGNMENT * PATH_UNBUFFERED_ALIGNMENT;
+
+    byte *dest = buffer.Data;
+    if (dest) {
+        if (toRead > buffer.Count) return fail;
+    } else if (toRead) {
+        dest = allocate_array<byte>(toRead, {.Alloc = options.Alloc, .Alignment = unbuffered ? (u32) PATH_UNBUFFERED_ALIGNMENT : 0});
+    }
+
+    s64 read = toRead ? path_read_overlapped(file, dest, toRead) : 0;
+    if (read == -1) {
+        if (!buffer.Data) free(dest);
+        return fail;
+    }
+    return {bytes(dest, min(read, size.QuadPart)), true};
+}
 
-    array<byte> result;
-    array_reserve(result, size.QuadPart);
-    DWORD bytesRead;
-    if (!ReadFile(file, result.Data, (u32) size.QuadPart, &bytesRead, null)) return {{}, false};
-    assert(size.QuadPart == bytesRead);
+[[nodiscard("Leak")]] path_read_entire_file_result path_read_entire_file(const string &path, path_read_options options) {
+    return path_read_entire_file_impl(path, {}, options);
+}
 
-    result.Count += bytesRead;
-    return {result, true};
+path_read_entire_file_result path_read_entire_file(const string &path, bytes buffer, path_read_options options) {
+    if (!buffer.Data) return {bytes{}, false};
+    return path_read_entire_file_impl(path, buffer, options);
 }
 
 bool path_write_to_file(const string &path, const string &contents, path_write_mode mode) {
@@ -690,4 +1296,448 @@ bool path_write_to_file(const string &path, const string &contents, path_write_m
     return true;
 }
 
+bool file_writer_open(file_writer &w, const string &path, file_writer::open_mode mode, s64 bufferSize, allocator alloc) {
+    assert(!w.Handle && "Writer already open, call free() first");
+
+    DWORD disposition = mode == file_writer::APPEND ? OPEN_ALWAYS : CREATE_ALWAYS;
+    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), GENERIC_WRITE, FILE_SHARE_READ, null, disposition, FILE_ATTRIBUTE_NORMAL, null), false);
+
+    if (mode == file_writer::APPEND) {
+        LARGE_INTEGER pointer = {};
+        SetFilePointerEx(file, pointer, null, FILE_END);
+    }
+
+    w.Handle     = file;
+    w.Alloc      = alloc ? alloc : Context.Alloc;
+    w.BufferSize = bufferSize ? bufferSize : file_writer::DEFAULT_BUFFER_SIZE;
+    w.Buffer     = allocate_array<byte>(w.BufferSize, {.Alloc = w.Alloc});
+    w.Current    = w.Buffer;
+    w.Available  = w.BufferSize;
+    w.Failed     = false;
+    return true;
+}
+
+void free(file_writer &w) {
+    if (!w.Handle) return;
+
+    w.force_flush();
+    CloseHandle((HANDLE) w.Handle);
+    free(w.Buffer);
+
+    w.Handle = w.Buffer = w.Current = null;
+    w.Available = w.BufferSize = 0;
+}
+
+void internal::file_writer_write_file(file_writer &w, const byte *data, s64 size) {
+    while (size) {
+        DWORD chunk = (DWORD) min(size, (s64) 1_GiB);
+
+        DWORD written;
+        if (!WriteFile((HANDLE) w.Handle, data, chunk, &written, null) || written != chunk) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "WriteFile((HANDLE) w.Handle, data, chunk, &written, null)");
+            w.Failed = true;
+            return;
+        }
+
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+static_assert(sizeof(OVERLAPPED) <= sizeof(file_reader::PlatformRequest));
+
+// Starts reading the next chunk into the half _r.Half_
+void file_reader_issue(file_reader &r) {
+    auto *request = (OVERLAPPED *) r.PlatformRequest;
+
+    HANDLE event = request->hEvent;
+    zero_memory(request, sizeof(OVERLAPPED));
+    request->DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset     = (DWORD) r.Offset;
+    request->DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = (DWORD) (r.Offset >> 32);
+    request->hEvent                                    = event;
+
+    s64 half = r.BufferSize / 2;
+    if (!ReadFile((HANDLE) r.Handle, r.Buffer + r.Half * half, (DWORD) half, null, request)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_PENDING) {
+            if (error != ERROR_HANDLE_EOF) {
+                windows_report_hresult_error(HRESULT_FROM_WIN32(error), "ReadFile((HANDLE) r.Handle, r.Buffer + r.Half * half, (DWORD) half, null, request)");
+                r.Failed = true;
+            }
+            r.Ended = true;
+            return;
+        }
+    }
+    r.Pending = true;
+}
+
+bool file_reader_open(file_reader &r, const string &path, s64 bufferSize, allocator alloc) {
+    assert(!r.Handle && "Reader already open, call free() first");
+
+    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, null), false);
+
+    HANDLE event = CreateEventW(null, true, false, null);
+    if (!event) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateEventW(null, true, false, null)");
+        CloseHandle(file);
+        return false;
+    }
+
+    r.Handle     = file;
+    r.Alloc      = alloc ? alloc : Context.Alloc;
+    r.BufferSize = (bufferSize ? bufferSize : file_reader::DEFAULT_BUFFER_SIZE) & ~1ll;
+    r.Buffer     = allocate_array<byte>(r.BufferSize, {.Alloc = r.Alloc});
+    r.Current    = {};
+    r.Offset     = 0;
+    r.Half       = 0;
+    r.Pending    = false;
+    r.Ended      = false;
+    r.Failed     = false;
+
+    zero_memory(r.PlatformRequest, sizeof(r.PlatformRequest));
+    ((OVERLAPPED *) r.PlatformRequest)->hEvent = event;
+
+    file_reader_issue(r);
+    return true;
+}
+
+bytes file_reader_next(file_reader &r) {
+    r.Current = {};
+    if (!r.Pending) return {};
+
+    auto *request = (OVERLAPPED *) r.PlatformRequest;
+    r.Pending     = false;
+
+    DWORD bytesRead = 0;
+    if (!GetOverlappedResult((HANDLE) r.Handle, request, &bytesRead, true)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_HANDLE_EOF) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(error), "GetOverlappedResult((HANDLE) r.Handle, request, &bytesRead, true)");
+            r.Failed = true;
+        }
+        r.Ended = true;
+        return {};
+    }
+
+    s64 half    = r.BufferSize / 2;
+    byte *chunk = r.Buffer + r.Half * half;
+    r.Offset += bytesRead;
+
+    // Read ahead into the other half while the caller works on this one. A short read means we reached the end.
+    r.Half = 1 - r.Half;
+    if (bytesRead == half) {
+        file_reader_issue(r);
+    } else {
+        r.Ended = true;
+    }
+
+    r.Current = bytes(chunk, bytesRead);
+    return r.Current;
+}
+
+void free(file_reader &r) {
+    if (!r.Handle) return;
+
+    auto *request = (OVERLAPPED *) r.PlatformRequest;
+    if (r.Pending) {
+        // It writes to the buffer, so wait for it even after cancelling
+        DWORD ignored;
+        CancelIoEx((HANDLE) r.Handle, request);
+        GetOverlappedResult((HANDLE) r.Handle, request, &ignored, true);
+    }
+
+    CloseHandle(request->hEvent);
+    CloseHandle((HANDLE) r.Handle);
+    free(r.Buffer);
+
+    r.Handle  = r.Buffer = null;
+    r.Current = {};
+    r.Pending = false;
+}
+
+[[nodiscard("Leak")]] path_mapping path_open_mapping(const string &path, path_map_mode mode, path_map_hint hint, s64 size) {
+    bool write = mode == path_map_mode::Read_Write;
+
+    u32 access      = write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    u32 disposition = write ? OPEN_ALWAYS : OPEN_EXISTING;
+
+    u32 flags = FILE_ATTRIBUTE_NORMAL;
+    if (hint == path_map_hint::Sequential) flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    if (hint == path_map_hint::Random) flags |= FILE_FLAG_RANDOM_ACCESS;
+
+    CREATE_FILE_HANDLE_CHECKED(file, CreateFileW(utf8_to_utf16(path), access, FILE_SHARE_READ, null, disposition, flags, null), path_mapping{});
+
+    LARGE_INTEGER fileSize = {0};
+    GetFileSizeEx(file, &fileSize);
+
+    path_mapping result;
+    result.File = (void *) file;
+    result.Mode = mode;
+    result.Size = write ? max(fileSize.QuadPart, size) : fileSize.QuadPart;
+
+    // Mapping an empty file fails, there is nothing to view anyway
+    if (!result.Size) return result;
+
+    // A mapping bigger than a Read_Write file grows it
+    HANDLE mapping = CreateFileMappingW(file, null, write ? PAGE_READWRITE : PAGE_READONLY, (u32) (result.Size >> 32), (u32) result.Size, null);
+    if (!mapping) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateFileMappingW");
+        CloseHandle(file);
+        return {};
+    }
+
+    result.Handle = (void *) mapping;
+    return result;
+}
+
+void free(path_mapping &mapping) {
+    if (mapping.Handle) CloseHandle((HANDLE) mapping.Handle);
+    if (mapping.File) CloseHandle((HANDLE) mapping.File);
+    mapping = {};
+}
+
+[[nodiscard("Leak")]] path_mapped_view path_map_view(const path_mapping &mapping, s64 offset, s64 size) {
+    if (size == -1) size = mapping.Size - offset;
+    assert(offset >= 0 && size >= 0 && offset + size <= mapping.Size && "View is out of the file");
+
+    if (!mapping.Handle || !size) return {};
+
+    s64 granularity = os_get_allocation_granularity();
+    s64 base        = offset / granularity * granularity;
+    s64 baseSize    = offset - base + size;
+
+    u32 access = mapping.Mode == path_map_mode::Read_Write ? FILE_MAP_READ | FILE_MAP_WRITE : FILE_MAP_READ;
+
+    void *p = MapViewOfFile((HANDLE) mapping.Handle, access, (u32) (base >> 32), (u32) base, baseSize);
+    if (!p) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "MapViewOfFile");
+        return {};
+    }
+
+    path_mapped_view view;
+    view.Base     = p;
+    view.BaseSize = baseSize;
+    view.Content  = bytes((byte *) p + (offset - base), size);
+    return view;
+}
+
+void path_unmap_view(path_mapped_view &view) {
+    if (view.Base) WIN_CHECKBOOL(UnmapViewOfFile(view.Base));
+    view = {};
+}
+
+bool path_flush_view(const path_mapped_view &view) {
+    if (!view.Base) return true;
+    return FlushViewOfFile(view.Base, view.BaseSize);
+}
+
+void path_watcher_issue(path_watcher &w) {
+    auto *o = (OVERLAPPED *) w.PlatformRequest;
+
+    HANDLE event = o->hEvent;
+    zero_memory(o, sizeof(OVERLAPPED));
+    o->hEvent = event;
+
+    DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+    w.Pending = ReadDirectoryChangesW((HANDLE) w.Directory, w.Buffer, (DWORD) path_watcher::BUFFER_SIZE, w.Recursive, filter, null, o, null);
+    if (!w.Pending) windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "ReadDirectoryChangesW");
+}
+
+bool path_watcher_start(path_watcher &w, const string &directory, bool recursive) {
+    assert(!w.Directory && "Watcher already started, call free() first");
+
+    // Deleting and renaming things inside the directory must still work while we watch it
+    CREATE_FILE_HANDLE_CHECKED(dir, CreateFileW(utf8_to_utf16(directory), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, null, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, null), false);
+
+    HANDLE event = CreateEventW(null, true, false, null);
+    if (!event) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateEventW(null, true, false, null)");
+        CloseHandle(dir);
+        return false;
+    }
+
+    clone(&w.Root, directory);
+    w.Recursive = recursive;
+    w.Directory = dir;
+
+    // ReadDirectoryChangesW wants the buffer DWORD aligned
+    w.Buffer = allocate_array<byte>(path_watcher::BUFFER_SIZE, {.Alignment = 8});
+
+    zero_memory(w.PlatformRequest, sizeof(w.PlatformRequest));
+    ((OVERLAPPED *) w.PlatformRequest)->hEvent = event;
+
+    path_watcher_issue(w);
+    return true;
+}
+
+void path_watcher_reset_batch(path_watcher &w) {
+    For(w.Events) {
+        free(it.Path);
+        free(it.OldPath);
+    }
+    array_reset(w.Events);
+    reset(w.Index);
+    w.Overflowed = false;
+}
+
+void free(path_watcher &w) {
+    if (!w.Directory) return;
+
+    auto *o = (OVERLAPPED *) w.PlatformRequest;
+    if (w.Pending) {
+        // It writes to the buffer, so wait for it even after cancelling
+        DWORD ignored;
+        CancelIoEx((HANDLE) w.Directory, o);
+        GetOverlappedResult((HANDLE) w.Directory, o, &ignored, true);
+    }
+
+    CloseHandle(o->hEvent);
+    CloseHandle((HANDLE) w.Directory);
+    free(w.Buffer);
+
+    path_watcher_reset_batch(w);
+    free(w.Events);
+    free(w.Index);
+    free(w.Root);
+    w.Changed.release();
+
+    w.Directory = null;
+    w.Buffer    = null;
+    w.Pending   = false;
+}
+
+// Merges _kind_ with what we already have for _path_ in this batch. Takes ownership of the strings.
+void path_watcher_add(path_watcher &w, string path, path_change kind, string oldPath = {}) {
+    auto [key, index] = find(w.Index, path);
+    if (!index) {
+        array_append(w.Events, path_change_event{path, oldPath, kind});
+        add(w.Index, path, w.Events.Count - 1);
+        return;
+    }
+
+    auto &e = w.Events[*index];
+    path_change old = e.Kind;
+
+    if (kind == path_change::Modified && (old == path_change::Added || old == path_change::Renamed)) {
+        // Already tells the caller to look at the file again
+    } else if (kind == path_change::Removed && old == path_change::Added) {
+        // Came and went between two polls, the caller never knew about it. Dropped after the batch is complete.
+        e.Kind = (path_change) -1;
+    } else if (kind == path_change::Added && old == path_change::Removed) {
+        e.Kind = path_change::Modified;  // Replaced
+    } else {
+        e.Kind = kind;
+        if (kind == path_change::Renamed) {
+            free(e.OldPath);
+            e.OldPath = oldPath;
+            oldPath   = {};
+        }
+    }
+
+    free(path);
+    free(oldPath);
+}
+
+// Goes over the notifications the OS put in the buffer
+void path_watcher_collect(path_watcher &w) {
+    string renamedFrom;
+
+    byte *p = w.Buffer;
+    while (true) {
+        auto *info = (FILE_NOTIFY_INFORMATION *) p;
+
+        // Not null-terminated
+        s64 length = info->FileNameLength / sizeof(WCHAR);
+
+        string name;
+        string_reserve(name, length * 3);
+        utf16_to_utf8(info->FileName, length, (utf8 *) name.Data, &name.Count);  // @Constcast
+        name.Length = utf8_length(name.Data, name.Count);
+
+        switch (info->Action) {
+            case FILE_ACTION_ADDED: path_watcher_add(w, name, path_change::Added); break;
+            case FILE_ACTION_REMOVED: path_watcher_add(w, name, path_change::Removed); break;
+            case FILE_ACTION_MODIFIED: path_watcher_add(w, name, path_change::Modified); break;
+            case FILE_ACTION_RENAMED_OLD_NAME:
+                free(renamedFrom);
+                renamedFrom = name;
+                break;
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                path_watcher_add(w, name, path_change::Renamed, renamedFrom);
+                renamedFrom = {};
+                break;
+            default: free(name);
+        }
+
+        if (!info->NextEntryOffset) break;
+        p += info->NextEntryOffset;
+    }
+
+    // The new name was outside the watched tree, for us it's gone
+    if (renamedFrom) path_watcher_add(w, renamedFrom, path_change::Removed);
+}
+
+const array<path_change_event> &path_watcher_poll(path_watcher &w, u32 timeoutMs) {
+    path_watcher_reset_batch(w);
+    if (!w.Directory) return w.Events;
+
+    auto *o = (OVERLAPPED *) w.PlatformRequest;
+
+    // Wait only for the first notification, after that take what's already there
+    u32 wait = timeoutMs;
+    while (w.Pending && WaitForSingleObject(o->hEvent, wait) == WAIT_OBJECT_0) {
+        wait = 0;
+
+        DWORD size = 0;
+        if (!GetOverlappedResult((HANDLE) w.Directory, o, &size, false)) {
+            windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "GetOverlappedResult");
+            w.Pending = false;
+            break;
+        }
+
+        // The changes didn't fit in the buffer and were thrown away
+        if (!size) {
+            w.Overflowed = true;
+        } else {
+            path_watcher_collect(w);
+        }
+
+        // The next call reuses the buffer, so only after we are done with it
+        path_watcher_issue(w);
+    }
+
+    // Remove the events which cancelled out
+    s64 kept = 0;
+    For(w.Events) {
+        if (it.Kind == (path_change) -1) {
+            free(it.Path);
+            free(it.OldPath);
+            continue;
+        }
+        w.Events[kept++] = it;
+    }
+    w.Events.Count = kept;
+
+    if (w.Events.Count || w.Overflowed) w.Changed.emit(w.Events);
+    return w.Events;
+}
+
+void path_advise_view(const path_mapped_view &view, path_map_hint hint, s64 offset, s64 size) {
+    if (size == -1) size = view.Content.Count - offset;
+    assert(offset >= 0 && size >= 0 && offset + size <= view.Content.Count);
+
+    if (!size) return;
+
+    void *address = view.Content.Data + offset;
+    if (hint == path_map_hint::Will_Need || hint == path_map_hint::Sequential) {
+        // Best effort, not available before Windows 8
+        WIN32_MEMORY_RANGE_ENTRY range = {address, size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    } else if (hint == path_map_hint::Dont_Need) {
+        // Unlocking pages which aren't locked removes them from the working set
+        VirtualUnlock(address, size);
+    }
+}
+
 LSTD_END_NAMESPACE
@@ -1,8 +1,28 @@
 module;
 
 #include "../internal/common.h"
+#include "../io/file_reader.h"
+#include "../io/file_writer.h"
 #include "../memory/string.h"
 
+#include "../io/writer.h"
+#include "../memory/delegate.h"
+#include "../thread.h"
+
+#if OS != WINDOWS
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>  // rename
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if OS == LINUX
+#include <sys/syscall.h>
+#endif
+#endif
+
 export module path.posix;
 
 import path.general;
@@ -18,6 +38,24 @@ import path.general;
 
 LSTD_BEGIN_NAMESPACE
 
+#if OS != WINDOWS
+// write() may take less than asked for and get interrupted by signals
+bool path_write_all(int fd, const byte *data, s64 size) {
+    while (size) {
+        ssize_t n = write(fd, data, min(size, (s64) 1_GiB));
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+time_t timespec_to_time(timespec t) { return (time_t) t.tv_sec * 1000000000 + t.tv_nsec; }
+#endif
+
 export {
     constexpr char OS_PATH_SEPARATOR = '/';
 
@@ -33,12 +71,38 @@ export {
     //    data/myData         -> false
     constexpr bool path_is_absolute(const string &path) { return path_is_sep(path[0]); }
 
+    // Appends the joined path to _out_ instead of allocating a new string.
+    // The size is computed first, so this grows _out_ at most once (and not at all if it has room).
+    void path_join_into(string &out, const array<string> &paths) {
+        assert(paths.Count >= 2);
+
+        // Everything before the last absolute part is ignored
+        s64 first = 0;
+        For(range(1, paths.Count)) if (path_is_absolute(paths[it])) first = it;
+
+        s64 size = 0;
+        For(range(first, paths.Count)) size += paths[it].Count + 1;
+        string_reserve(out, size, array_growth::EXACT);
+
+        s64 start = out.Count;
+        For(range(first, paths.Count)) {
+            if (out.Count != start && !path_is_sep(out.Data[out.Count - 1])) string_append(out, '/');
+            string_append(out, paths[it]);
+        }
+    }
+
+    always_inline void path_join_into(string &out, const string &one, const string &other) {
+        auto arr = to_stack_array(one, other);
+        path_join_into(out, arr);
+    }
+
     // Joins two or more paths.
     // Ignore the previous parts if a part is absolute.
     // This is the de facto way to build paths. Takes care of slashes automatically.
     [[nodiscard("Leak")]] string path_join(const array<string> &paths) {
-        assert(false && "Not implemented");
-        return "";
+        string result;
+        path_join_into(result, paths);
+        return result;
     }
 
     [[nodiscard("Leak")]] always_inline string path_join(const string &one, const string &other) {
@@ -46,11 +110,79 @@ export {
         return path_join(arr);
     }
 
+    // The allocation-free core of path_normalize: writes to _dest_ which needs room for path.Count + 1 bytes
+    // (e.g. a stack buffer) and returns how many bytes were written. _dest_ may be _path.Data_, we only
+    // ever drop characters so what we write is never ahead of what we read.
+    s64 path_normalize_to_buffer(utf8 *dest, const string &path) {
+        const utf8 *s = path.Data;
+        s64 n         = path.Count;
+
+        s64 r = 0, w = 0;
+
+        // POSIX allows exactly two leading slashes to mean something implementation defined, three or more are one
+        if (n && path_is_sep(s[0])) {
+            while (r < n && path_is_sep(s[r])) ++r;
+            dest[w++] = '/';
+            if (r == 2) dest[w++] = '/';
+        }
+
+        s64 base = w;  // Components start here, ".." can't go before it
+        while (r < n) {
+            s64 start = r;
+            while (r < n && !path_is_sep(s[r])) ++r;
+            s64 length = r - start;
+            while (r < n && path_is_sep(s[r])) ++r;
+
+            if (!length || (length == 1 && s[start] == '.')) continue;
+
+            if (length == 2 && s[start] == '.' && s[start + 1] == '.') {
+                s64 last = w;
+                while (last > base && dest[last - 1] != '/') --last;
+
+                bool lastIsUp = w - last == 2 && dest[last] == '.' && dest[last + 1] == '.';
+                if (w != base && !lastIsUp) {
+                    w = last == base ? base : last - 1;  // Drop the last component and the slash before it
+                    continue;
+                }
+                if (w == base && base) continue;  // The parent of the root is the root
+            }
+
+            if (w != base) dest[w++] = '/';
+            copy_memory(dest + w, s + start, length);
+            w += length;
+        }
+
+        // If the path is now empty, substitute "."
+        if (!w) dest[w++] = '.';
+        return w;
+    }
+
+    // Appends the normalized path to _out_, grows it at most once
+    void path_normalize_into(string &out, const string &path) {
+        string_reserve(out, path.Count + 1, array_growth::EXACT);
+
+        s64 count = path_normalize_to_buffer(out.Data + out.Count, path);
+        out.Length += utf8_length(out.Data + out.Count, count);
+        out.Count += count;
+    }
+
+    // Normalizes an allocated string without allocating (the result is never longer, except "" -> ".")
+    void path_normalize_in_place(string &path) {
+        if (!path.Count) {
+            string_append(path, '.');
+            return;
+        }
+
+        path.Count  = path_normalize_to_buffer(path.Data, path);
+        path.Length = utf8_length(path.Data, path.Count);
+    }
+
     // Normalize a pathname by collapsing redundant separators and up-level references so that A//B, A/B/, A/./B and A/foo/../B all become A/B.
     // This string manipulation may change the meaning of a path that contains symbolic links.
-    string path_normalize(const string &path) {
-        assert(false && "Not implemented");
-        return "";
+    [[nodiscard("Leak")]] string path_normalize(const string &path) {
+        string result;
+        path_normalize_into(result, path);
+        return result;
     }
 
     // Splits path into two components: head (everything up to the last '/') and tail (the rest).
@@ -106,6 +238,838 @@ export {
     always_inline constexpr path_split_extension_result path_split_extension(const string &path) {
         return path_split_extension_general(path, '/', 0, '.');
     }
+
+#if OS != WINDOWS
+    //
+    // Reading whole files, see path.nt for the docs. pread may return less than asked for so we loop,
+    // Unbuffered uses O_DIRECT (where the platform has it, it's only a hint otherwise).
+    //
+
+    path_read_entire_file_result path_read_entire_file_impl(const string &path, bytes buffer, path_read_options options) {
+        path_read_entire_file_result fail = {bytes{}, false};
+
+        bool unbuffered = options.Unbuffered;
+        if (buffer.Data && (u64) buffer.Data % PATH_UNBUFFERED_ALIGNMENT) unbuffered = false;
+
+        int flags = O_RDONLY;
+#if defined O_DIRECT
+        if (unbuffered) flags |= O_DIRECT;
+#endif
+
+        int fd = open(string_to_c_string_temp(path), flags);
+        if (fd == -1) return fail;
+        defer(close(fd));
+
+        struct stat info;
+        if (fstat(fd, &info) == -1) return fail;
+
+        s64 size   = info.st_size;
+        s64 toRead = size;
+        if (unbuffered) toRead = (toRead + PATH_UNBUFFERED_ALIGNMENT - 1) / PATH_UNBUFFERED_ALIGNMENT * PATH_UNBUFFERED_ALIGNMENT;
+
+        byte *dest = buffer.Data;
+        if (dest) {
+            if (toRead > buffer.Count) return fail;
+        } else if (toRead) {
+            dest = allocate_array<byte>(toRead, {.Alloc = options.Alloc, .Alignment = unbuffered ? (u32) PATH_UNBUFFERED_ALIGNMENT : 0});
+        }
+
+        s64 read = 0;
+        while (read < toRead) {
+            ssize_t n = pread(fd, dest + read, min(toRead - read, (s64) 1_GiB), read);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                if (!buffer.Data) free(dest);
+                return fail;
+            }
+            if (!n) break;
+            read += n;
+        }
+
+        return {bytes(dest, min(read, size)), true};
+    }
+
+    [[nodiscard("Leak")]] path_read_entire_file_result path_read_entire_file(const string &path, path_read_options options = {}) {
+        return path_read_entire_file_impl(path, {}, options);
+    }
+
+    path_read_entire_file_result path_read_entire_file(const string &path, bytes buffer, path_read_options options = {}) {
+        if (!buffer.Data) return {bytes{}, false};
+        return path_read_entire_file_impl(path, buffer, options);
+    }
+
+    //
+    // File mapping, see path.nt for the docs. Here views can start at any page and hints go to madvise.
+    //
+
+    [[nodiscard("Leak")]] path_mapping path_open_mapping(const string &path, path_map_mode mode = path_map_mode::Read_Only, path_map_hint hint = path_map_hint::Normal, s64 size = 0) {
+        bool write = mode == path_map_mode::Read_Write;
+
+        int fd = open(string_to_c_string_temp(path), write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd == -1) return {};
+
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            close(fd);
+            return {};
+        }
+
+        s64 fileSize = info.st_size;
+        if (write && size > fileSize) {
+            if (ftruncate(fd, size) == -1) {
+                close(fd);
+                return {};
+            }
+            fileSize = size;
+        }
+
+        if (hint == path_map_hint::Sequential) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (hint == path_map_hint::Random) posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+
+        path_mapping result;
+        result.File   = (void *) (s64) (fd + 1);  // So descriptor 0 isn't null
+        result.Handle = fileSize ? result.File : null;
+        result.Size   = fileSize;
+        result.Mode   = mode;
+        return result;
+    }
+
+    void free(path_mapping & mapping) {
+        if (mapping.File) close((int) ((s64) mapping.File - 1));
+        mapping = {};
+    }
+
+    [[nodiscard("Leak")]] path_mapped_view path_map_view(const path_mapping &mapping, s64 offset = 0, s64 size = -1) {
+        if (size == -1) size = mapping.Size - offset;
+        assert(offset >= 0 && size >= 0 && offset + size <= mapping.Size && "View is out of the file");
+
+        if (!mapping.Handle || !size) return {};
+
+        s64 pageSize = sysconf(_SC_PAGESIZE);
+        s64 base     = offset / pageSize * pageSize;
+        s64 baseSize = offset - base + size;
+
+        int prot = mapping.Mode == path_map_mode::Read_Write ? PROT_READ | PROT_WRITE : PROT_READ;
+
+        void *p = mmap(null, baseSize, prot, MAP_SHARED, (int) ((s64) mapping.File - 1), base);
+        if (p == MAP_FAILED) return {};
+
+        path_mapped_view view;
+        view.Base     = p;
+        view.BaseSize = baseSize;
+        view.Content  = bytes((byte *) p + (offset - base), size);
+        return view;
+    }
+
+    void path_unmap_view(path_mapped_view & view) {
+        if (view.Base) munmap(view.Base, view.BaseSize);
+        view = {};
+    }
+
+    bool path_flush_view(const path_mapped_view &view) {
+        if (!view.Base) return true;
+        return msync(view.Base, view.BaseSize, MS_SYNC) == 0;
+    }
+
+    void path_advise_view(const path_mapped_view &view, path_map_hint hint, s64 offset = 0, s64 size = -1) {
+        if (size == -1) size = view.Content.Count - offset;
+        assert(offset >= 0 && size >= 0 && offset + size <= view.Content.Count);
+
+        if (!size) return;
+
+        // madvise wants a page aligned address
+        byte *begin = view.Content.Data + offset;
+        byte *page  = (byte *) view.Base + (begin - (byte *) view.Base) / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+
+        int advice = MADV_NORMAL;
+        if (hint == path_map_hint::Sequential) advice = MADV_SEQUENTIAL;
+        if (hint == path_map_hint::Random) advice = MADV_RANDOM;
+        if (hint == path_map_hint::Will_Need) advice = MADV_WILLNEED;
+        if (hint == path_map_hint::Dont_Need) advice = MADV_DONTNEED;
+        madvise(page, begin + size - page, advice);
+    }
+
+    // Writes _contents_ to _path_, creating the file if it doesn't exist.
+    bool path_write_to_file(const string &path, const string &contents, path_write_mode mode) {
+        int flags = O_WRONLY | O_CREAT;
+        if (mode == path_write_mode::Append) flags |= O_APPEND;
+        if (mode == path_write_mode::Overwrite_Entire) flags |= O_TRUNC;
+
+        int fd = open(string_to_c_string_temp(path), flags, 0644);
+        if (fd == -1) return false;
+        defer(close(fd));
+
+        return path_write_all(fd, (const byte *) contents.Data, contents.Count);
+    }
+
+    //
+    // Queries. Times are in nanoseconds since the Unix epoch (st_*tim), and since POSIX has no creation time,
+    // path_creation_time returns the time of the last status change.
+    //
+
+    bool path_exists(const string &path) {
+        struct stat info;
+        return stat(string_to_c_string_temp(path), &info) == 0;
+    }
+
+    bool path_is_file(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1) return false;
+        return !S_ISDIR(info.st_mode);
+    }
+
+    bool path_is_directory(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1) return false;
+        return S_ISDIR(info.st_mode);
+    }
+
+    bool path_is_symbolic_link(const string &path) {
+        struct stat info;
+        if (lstat(string_to_c_string_temp(path), &info) == -1) return false;
+        return S_ISLNK(info.st_mode);
+    }
+
+    s64 path_file_size(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1 || S_ISDIR(info.st_mode)) return 0;
+        return info.st_size;
+    }
+
+    time_t path_creation_time(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1) return 0;
+        return timespec_to_time(info.st_ctim);
+    }
+
+    time_t path_last_access_time(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1) return 0;
+        return timespec_to_time(info.st_atim);
+    }
+
+    time_t path_last_modification_time(const string &path) {
+        struct stat info;
+        if (stat(string_to_c_string_temp(path), &info) == -1) return 0;
+        return timespec_to_time(info.st_mtim);
+    }
+
+    bool path_create_directory(const string &path) { return mkdir(string_to_c_string_temp(path), 0755) == 0; }
+
+    bool path_delete_file(const string &path) {
+        if (!path_is_file(path)) return false;
+        return unlink(string_to_c_string_temp(path)) == 0;
+    }
+
+    bool path_delete_directory(const string &path) { return rmdir(string_to_c_string_temp(path)) == 0; }
+
+    // See path.nt. The data is copied inside the kernel with copy_file_range (it may even be reflinked or done on the
+    // server for network file systems), we fall back to a read/write loop where that isn't supported (e.g. across file systems on old kernels).
+    // Unbuffered drops the pages of both files from the cache as we go (O_DIRECT needs aligned buffers, which the kernel copy doesn't use).
+    bool path_copy(const string &path, const string &dest, const path_copy_options &options) {
+        int in = open(string_to_c_string_temp(path), O_RDONLY);
+        if (in == -1) return false;
+        defer(close(in));
+
+        struct stat info;
+        if (fstat(in, &info) == -1 || S_ISDIR(info.st_mode)) return false;
+
+        string target = dest;
+        if (path_is_directory(dest)) target = path_join(dest, path_base_name(path));
+        defer({
+            if (target.Data != dest.Data) free(target);
+        });
+
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | (options.Overwrite ? 0 : O_EXCL);
+
+        int out = open(string_to_c_string_temp(target), flags, info.st_mode & 0777);
+        if (out == -1) return false;
+        defer(close(out));
+
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        constexpr s64 STEP = 64_MiB;  // Between progress reports
+
+        s64 total = info.st_size, copied = 0;
+
+        bool kernelCopy = true;
+        bytes buffer;
+        defer(free(buffer.Data));
+
+        while (copied < total) {
+            s64 step  = min(total - copied, STEP);
+            ssize_t n = -1;
+
+#if OS == LINUX
+            if (kernelCopy) {
+                n = copy_file_range(in, null, out, null, step, 0);
+                if (n == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) kernelCopy = false;
+            }
+#else
+            kernelCopy = false;
+#endif
+            if (!kernelCopy) {
+                if (!buffer.Data) buffer = bytes(allocate_array<byte>(1_MiB), 1_MiB);
+
+                n = read(in, buffer.Data, min(step, buffer.Count));
+                if (n > 0 && !path_write_all(out, buffer.Data, n)) return false;
+            }
+
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (!n) break;  // The file got shorter
+
+            if (options.Unbuffered) {
+                posix_fadvise(in, copied, n, POSIX_FADV_DONTNEED);
+                fdatasync(out);  // Dirty pages can't be dropped
+                posix_fadvise(out, copied, n, POSIX_FADV_DONTNEED);
+            }
+            copied += n;
+
+            if (options.Progress && !options.Progress(copied, total)) {
+                unlink(string_to_c_string_temp(target));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool path_copy(const string &path, const string &dest, bool overwrite) {
+        path_copy_options options;
+        options.Overwrite = overwrite;
+        return path_copy(path, dest, options);
+    }
+
+    // See path.nt. The kernel reads ahead (POSIX_FADV_SEQUENTIAL) while _out_ takes the current chunk.
+    s64 path_transfer(const string &path, writer *out, s64 offset = 0, s64 size = -1, const path_copy_options &options = {}) {
+        int fd = open(string_to_c_string_temp(path), O_RDONLY);
+        if (fd == -1) return -1;
+        defer(close(fd));
+
+        struct stat info;
+        if (fstat(fd, &info) == -1) return -1;
+
+        s64 end = size == -1 ? (s64) info.st_size : min(offset + size, (s64) info.st_size);
+        if (offset >= end) return 0;
+
+        posix_fadvise(fd, offset, end - offset, POSIX_FADV_SEQUENTIAL);
+
+        constexpr s64 CHUNK_SIZE = 1_MiB;
+
+        byte *buffer = allocate_array<byte>(CHUNK_SIZE);
+        defer(free(buffer));
+
+        s64 sent = 0;
+        while (offset + sent < end) {
+            ssize_t n = pread(fd, buffer, min(end - offset - sent, CHUNK_SIZE), offset + sent);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            if (!n) break;
+
+            out->write(buffer, n);
+            if (options.Unbuffered) posix_fadvise(fd, offset + sent, n, POSIX_FADV_DONTNEED);
+            sent += n;
+
+            if (options.Progress && !options.Progress(sent, end - offset)) break;
+        }
+        return sent;
+    }
+
+    // See path.nt. rename() can't go across file systems, in that case we copy and delete.
+    bool path_move(const string &path, const string &dest, bool overwrite) {
+        if (!path_is_file(path)) return false;
+
+        string target = dest;
+        if (path_is_directory(dest)) target = path_join(dest, path_base_name(path));
+        defer({
+            if (target.Data != dest.Data) free(target);
+        });
+
+        if (!overwrite && path_exists(target)) return false;
+
+        char *from = string_to_c_string(path);
+        defer(free(from));
+
+        if (rename(from, string_to_c_string_temp(target)) == 0) return true;
+        if (errno != EXDEV) return false;
+
+        if (!path_copy(path, target, true)) return false;
+        return unlink(from) == 0;
+    }
+
+    bool path_rename(const string &path, const string &newName) {
+        if (!path_exists(path)) return false;
+
+        auto p = path_join(path_directory(path), newName);
+        defer(free(p));
+
+        char *from = string_to_c_string(path);
+        defer(free(from));
+
+        return rename(from, string_to_c_string_temp(p)) == 0;
+    }
+
+    // Creates _dest_ as another name of the file _path_
+    bool path_create_hard_link(const string &path, const string &dest) {
+        char *from = string_to_c_string(path);
+        defer(free(from));
+
+        return link(from, string_to_c_string_temp(dest)) == 0;
+    }
+
+    // Creates _dest_ as a symbolic link which points to _path_
+    bool path_create_symbolic_link(const string &path, const string &dest) {
+        char *from = string_to_c_string(path);
+        defer(free(from));
+
+        return symlink(from, string_to_c_string_temp(dest)) == 0;
+    }
+
+    // See path.nt
+    struct path_walker : non_copyable {
+        string Path;  // Doesn't get cloned, valid as long as the string passed in the constructor is valid
+
+        string CurrentFileName;  // Points into the directory stream, valid until the next call
+
+        void *Handle = null;  // A DIR*, null when there are no more files
+        s64 Index = 0;
+
+        bool Started = false;
+
+        path_walker() {}
+        path_walker(const string &path) : Path(path) {}
+    };
+
+    void free(path_walker & walker) {
+        if (walker.Handle) closedir((DIR *) walker.Handle);
+        walker.Handle = null;
+    }
+
+    void path_read_next_entry(path_walker & walker) {
+        if (!walker.Started) {
+            walker.Started = true;
+            walker.Handle  = opendir(string_to_c_string_temp(walker.Path));
+        }
+        if (!walker.Handle) return;
+
+        while (true) {
+            dirent *e = readdir((DIR *) walker.Handle);
+            if (!e) {
+                closedir((DIR *) walker.Handle);
+                walker.Handle = null;  // No more files.. terminate
+                return;
+            }
+
+            const char *name = e->d_name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+            ++walker.Index;
+            walker.CurrentFileName = string(name);
+            return;
+        }
+    }
+
+    [[nodiscard("Leak")]] array<string> path_walk(const string &path, bool recursively = false) {
+        assert(path_is_directory(path));
+
+        array<string> result;
+
+        auto walker = path_walker(path);
+        defer(free(walker));
+
+        while (true) {
+            path_read_next_entry(walker);
+            if (!walker.Handle) break;
+
+            string file = path_join(path, walker.CurrentFileName);
+            array_append(result, file);
+
+            if (recursively && path_is_directory(file)) {
+                auto sub = path_walk(file, true);
+                array_append(result, sub.Data, sub.Count);
+                free(sub);
+            }
+        }
+        return result;
+    }
+
+    //
+    // See path.nt. Directories are read with getdents64 into a big buffer per level - many entries per syscall,
+    // no DIR* streams and their small buffers. Subdirectories are opened relative to their parent (openat),
+    // so we never build absolute paths for the kernel to walk again.
+    //
+    // Unlike FindFirstFile the listing has only names and types, sizes and times cost an fstatat per entry.
+    // _Attributes_ is the st_mode.
+    //
+    struct path_tree_walker : non_copyable {
+        static constexpr s64 DIRENT_BUFFER_SIZE = 32_KiB;
+
+        path_entry Entry;
+        bool Recursive = true;
+
+        struct level {
+            s32 Handle;  // Of the directory
+            s64 RelativeCount;
+            s64 Position, End;  // Of the entries left in this level's piece of _Buffers_
+        };
+
+        array<utf8> RelativePath;  // _Entry.Path_ points here
+        array<level> Levels;
+        array<byte> Buffers;  // DIRENT_BUFFER_SIZE per level, kept between walks
+
+        bool Descend  = false;
+        s64 BaseDepth = 0;
+    };
+
+    bool path_tree_walker_start(path_tree_walker & w, const string &root, bool recursive = true);
+    bool path_tree_walker_next(path_tree_walker & w);
+    void path_tree_walker_skip(path_tree_walker & w);
+    void free(path_tree_walker & w);
+
+    void path_walk_parallel(const string &root, const delegate<void(const path_entry &)> &callback, s64 threadCount = 8);
+#endif
+}
+
+#if OS != WINDOWS
+#if OS == LINUX
+// What getdents64 fills the buffer with. glibc doesn't declare it (it's an internal of readdir).
+struct linux_dirent64 {
+    u64 d_ino;
+    s64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// Starts reading the directory _fd_ (appended as the deepest level)
+void path_tree_walker_push(path_tree_walker &w, int fd) {
+    s64 needed = (w.Levels.Count + 1) * path_tree_walker::DIRENT_BUFFER_SIZE;
+    if (w.Buffers.Count < needed) {
+        array_reserve(w.Buffers, needed - w.Buffers.Count);
+        w.Buffers.Count = needed;
+    }
+    array_append(w.Levels, path_tree_walker::level{fd, w.RelativePath.Count, 0, 0});
+}
+
+// See path.nt, _relative_ is where _root_ is in the whole walk
+bool path_tree_walker_start_at(path_tree_walker &w, const string &root, const string &relative, s64 depth, bool recursive) {
+    assert(!w.Levels.Count && "Walker already started, call free() first");
+
+    w.Recursive = recursive;
+    w.Descend   = false;
+    w.BaseDepth = depth;
+    w.Entry     = {};
+
+    int fd = open(string_to_c_string_temp(root), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    array_reset(w.RelativePath);
+    array_append(w.RelativePath, relative.Data, relative.Count);
+
+    path_tree_walker_push(w, fd);
+    return true;
+}
+
+bool path_tree_walker_start(path_tree_walker &w, const string &root, bool recursive) {
+    return path_tree_walker_start_at(w, root, "", 0, recursive);
+}
+
+// Fills _w.Buffers_ for the deepest level, returns false at the end of the directory (or on an error)
+bool path_tree_walker_read(path_tree_walker &w) {
+    auto &level  = w.Levels[-1];
+    byte *buffer = w.Buffers.Data + (w.Levels.Count - 1) * path_tree_walker::DIRENT_BUFFER_SIZE;
+
+    while (true) {
+#if OS == LINUX
+        s64 n = syscall(SYS_getdents64, level.Handle, buffer, path_tree_walker::DIRENT_BUFFER_SIZE);
+#else
+#error @Platform getdents64 is Linux only, implement with fdopendir/readdir
+#endif
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        level.Position = 0;
+        level.End      = n;
+        return true;
+    }
+}
+
+bool path_tree_walker_next(path_tree_walker &w) {
+    if (w.Descend) {
+        w.Descend = false;
+
+        // _Entry.Name_ is the directory we just returned, open it relative to its parent
+        s64 nameStart = w.Entry.Name.Data - w.RelativePath.Data;
+        array_append(w.RelativePath, '\0');
+        int fd = openat(w.Levels[-1].Handle, w.RelativePath.Data + nameStart, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        --w.RelativePath.Count;
+
+        if (fd != -1) path_tree_walker_push(w, fd);  // No access - skip it
+    }
+
+    while (w.Levels.Count) {
+        auto &level = w.Levels[-1];
+
+        if (level.Position >= level.End && !path_tree_walker_read(w)) {
+            close(level.Handle);
+            --w.Levels.Count;
+            continue;
+        }
+
+        byte *buffer = w.Buffers.Data + (w.Levels.Count - 1) * path_tree_walker::DIRENT_BUFFER_SIZE;
+
+        auto *d = (linux_dirent64 *) (buffer + level.Position);
+        level.Position += d->d_reclen;
+
+        const char *name = d->d_name;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+        w.RelativePath.Count = level.RelativeCount;
+        if (w.RelativePath.Count) array_append(w.RelativePath, OS_PATH_SEPARATOR);
+
+        s64 nameStart = w.RelativePath.Count;
+        s64 nameCount = c_string_length(name);
+        array_append(w.RelativePath, name, nameCount);
+
+        auto &e = w.Entry;
+        e.Path  = string(w.RelativePath.Data, w.RelativePath.Count);
+        e.Name  = string(w.RelativePath.Data + nameStart, nameCount);
+
+        struct stat info;
+        if (fstatat(level.Handle, name, &info, AT_SYMLINK_NOFOLLOW) == 0) {
+            e.Size                 = S_ISDIR(info.st_mode) ? 0 : info.st_size;
+            e.CreationTime         = timespec_to_time(info.st_ctim);
+            e.LastAccessTime       = timespec_to_time(info.st_atim);
+            e.LastModificationTime = timespec_to_time(info.st_mtim);
+            e.Attributes           = info.st_mode;
+        } else {
+            e.Size = e.CreationTime = e.LastAccessTime = e.LastModificationTime = 0;
+            e.Attributes = 0;
+        }
+
+        // Some file systems don't fill the type in, the stat has it then
+        if (d->d_type != DT_UNKNOWN) {
+            e.IsDirectory    = d->d_type == DT_DIR;
+            e.IsSymbolicLink = d->d_type == DT_LNK;
+        } else {
+            e.IsDirectory    = S_ISDIR(e.Attributes);
+            e.IsSymbolicLink = S_ISLNK(e.Attributes);
+        }
+        e.Depth = w.BaseDepth + w.Levels.Count - 1;
+
+        w.Descend = w.Recursive && e.IsDirectory && !e.IsSymbolicLink;
+        return true;
+    }
+    return false;
+}
+
+void path_tree_walker_skip(path_tree_walker &w) { w.Descend = false; }
+
+void free(path_tree_walker &w) {
+    For(w.Levels) close(it.Handle);
+    free(w.Levels);
+    free(w.Buffers);
+    free(w.RelativePath);
+    w.Entry   = {};
+    w.Descend = false;
+}
+
+// The same as in path.nt
+struct path_walk_parallel_state {
+    string Root;
+    delegate<void(const path_entry &)> Callback;
+
+    thread::mutex Mutex;
+    thread::condition_variable Condition;
+
+    struct directory {
+        string Path;  // Relative to _Root_
+        s64 Depth;    // Of its entries
+    };
+
+    array<directory> Queue;  // Left to read
+    s64 Busy = 0;            // Threads reading a directory right now, they may still add to _Queue_
+};
+
+void path_walk_parallel_worker(void *data) {
+    auto *state = (path_walk_parallel_state *) data;
+
+    path_tree_walker w;
+    defer(free(w));
+
+    array<path_walk_parallel_state::directory> found;
+    defer(free(found));
+
+    while (true) {
+        path_walk_parallel_state::directory next;
+        {
+            thread::scoped_lock _(&state->Mutex);
+            while (!state->Queue.Count) {
+                if (!state->Busy) return;  // Nothing queued and nobody is going to queue more
+                state->Condition.wait(&state->Mutex);
+            }
+
+            next = state->Queue[-1];
+            --state->Queue.Count;
+            ++state->Busy;
+        }
+
+        string dir = next.Path ? path_join(state->Root, next.Path) : state->Root;
+
+        // Read one level and hand the subdirectories out instead of going into them ourselves
+        if (path_tree_walker_start_at(w, dir, next.Path, next.Depth, false)) {
+            while (path_tree_walker_next(w)) {
+                state->Callback(w.Entry);
+                if (w.Entry.IsDirectory && !w.Entry.IsSymbolicLink) {
+                    path_walk_parallel_state::directory sub = {{}, next.Depth + 1};
+                    clone(&sub.Path, w.Entry.Path);
+                    array_append(found, sub);
+                }
+            }
+        }
+
+        // Keep the buffers for the next directory
+        For(w.Levels) close(it.Handle);
+        w.Levels.Count = 0;
+
+        if (next.Path) {
+            free(dir);
+            free(next.Path);
+        }
+
+        thread::scoped_lock _(&state->Mutex);
+        array_append(state->Queue, found.Data, found.Count);
+        array_reset(found);
+        --state->Busy;
+        state->Condition.notify_all();
+    }
+}
+
+void path_walk_parallel(const string &root, const delegate<void(const path_entry &)> &callback, s64 threadCount) {
+    assert(threadCount > 0);
+
+    path_walk_parallel_state state;
+    state.Root     = root;
+    state.Callback = callback;
+    state.Mutex.init();
+    state.Condition.init();
+    array_append(state.Queue, path_walk_parallel_state::directory{"", 0});
+
+    auto *threads = allocate_array<thread::thread>(threadCount);
+    For(range(threadCount)) threads[it].init_and_launch(path_walk_parallel_worker, &state);
+    For(range(threadCount)) threads[it].wait();
+    free(threads);
+
+    free(state.Queue);
+    state.Condition.release();
+    state.Mutex.release();
+}
+
+bool file_writer_open(file_writer &w, const string &path, file_writer::open_mode mode, s64 bufferSize, allocator alloc) {
+    assert(!w.Handle && "Writer already open, call free() first");
+
+    int flags = O_WRONLY | O_CREAT | (mode == file_writer::APPEND ? O_APPEND : O_TRUNC);
+
+    int fd = open(string_to_c_string_temp(path), flags, 0644);
+    if (fd == -1) return false;
+
+    w.Handle     = (void *) (s64) (fd + 1);  // So descriptor 0 isn't null
+    w.Alloc      = alloc ? alloc : Context.Alloc;
+    w.BufferSize = bufferSize ? bufferSize : file_writer::DEFAULT_BUFFER_SIZE;
+    w.Buffer     = allocate_array<byte>(w.BufferSize, {.Alloc = w.Alloc});
+    w.Current    = w.Buffer;
+    w.Available  = w.BufferSize;
+    w.Failed     = false;
+    return true;
+}
+
+void free(file_writer &w) {
+    if (!w.Handle) return;
+
+    w.force_flush();
+    close((int) ((s64) w.Handle - 1));
+    free(w.Buffer);
+
+    w.Handle = w.Buffer = w.Current = null;
+    w.Available = w.BufferSize = 0;
+}
+
+void internal::file_writer_write_file(file_writer &w, const byte *data, s64 size) {
+    while (size) {
+        ssize_t n = ::write((int) ((s64) w.Handle - 1), data, min(size, (s64) 1_GiB));
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            w.Failed = true;
+            return;
+        }
+
+        data += n;
+        size -= n;
+    }
+}
+
+bool file_reader_open(file_reader &r, const string &path, s64 bufferSize, allocator alloc) {
+    assert(!r.Handle && "Reader already open, call free() first");
+
+    int fd = open(string_to_c_string_temp(path), O_RDONLY);
+    if (fd == -1) return false;
+
+    // No overlapped reads here, the kernel reads ahead for us instead
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    r.Handle     = (void *) (s64) (fd + 1);
+    r.Alloc      = alloc ? alloc : Context.Alloc;
+    r.BufferSize = (bufferSize ? bufferSize : file_reader::DEFAULT_BUFFER_SIZE) & ~1ll;
+    r.Buffer     = allocate_array<byte>(r.BufferSize, {.Alloc = r.Alloc});
+    r.Current    = {};
+    r.Offset     = 0;
+    r.Half       = 0;
+    r.Ended      = false;
+    r.Failed     = false;
+    return true;
+}
+
+bytes file_reader_next(file_reader &r) {
+    r.Current = {};
+    if (r.Ended) return {};
+
+    s64 half    = r.BufferSize / 2;
+    byte *chunk = r.Buffer + r.Half * half;
+
+    s64 bytesRead = 0;
+    while (bytesRead < half) {
+        ssize_t n = read((int) ((s64) r.Handle - 1), chunk + bytesRead, half - bytesRead);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            r.Failed = true;
+            break;
+        }
+        if (!n) break;
+        bytesRead += n;
+    }
+
+    r.Offset += bytesRead;
+    r.Half = 1 - r.Half;
+    if (bytesRead < half) r.Ended = true;
+
+    r.Current = bytes(chunk, bytesRead);
+    return r.Current;
+}
+
+void free(file_reader &r) {
+    if (!r.Handle) return;
+
+    close((int) ((s64) r.Handle - 1));
+    free(r.Buffer);
+
+    r.Handle  = r.Buffer = null;
+    r.Current = {};
 }
+#endif
 
 LSTD_END_NAMESPACE
@@ -35,7 +35,7 @@
 #define ARCH VM
 #elif defined _M_X64 || defined __x86_64__ || defined _M_IX86 || defined __i386__
 #define ARCH X86
-#elif defined __arm__ || defined _M_ARM || __aarch64__
+#elif defined __arm__ || defined _M_ARM || defined __aarch64__ || defined _M_ARM64
 #define ARCH ARM
 #elif defined __mips__ || defined __mips64
 #define ARCH MIPS
@@ -55,11 +55,12 @@
 #define X86_SSE4_1 defined __SSE4_1__
 #define X86_SSE4_2 defined __SSE4_2__
 #define X86_AVX defined __AVX__
-#define x86_AVX2 defined __AVX2__
+#define X86_AVX2 defined __AVX2__
+#define X86_FMA (defined __FMA__ || (COMPILER == MSVC && defined __AVX2__))  // MSVC doesn't define __FMA__, /arch:AVX2 implies it
 #elif ARCH == ARM
-#define ANY_ARM_NEON defined __ARM_NEON__)
+#define ANY_ARM_NEON (defined __ARM_NEON || defined __ARM_NEON__ || defined _M_ARM64)  // Always there on AArch64
 #elif ARCH == MIPS
-#define MIPS_MSA defined __mips_msa)
+#define MIPS_MSA defined __mips_msa
 #endif
 
 #if defined _M_X64 || defined __x86_64__ || defined __aarch64__ || defined __mips64 || defined __powerpc64__ || \
@@ -105,6 +106,15 @@
 #endif
 #endif
 
+// GCC and Clang predefine this one (the libc macros above need a libc header to be included first)
+#if !defined ENDIAN && defined __BYTE_ORDER__
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ENDIAN BIG_ENDIAN
+#elif __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ENDIAN LITTLE_ENDIAN
+#endif
+#endif
+
 // Windows is always little-endian.
 #if !defined ENDIAN
 #if OS == WINDOWS
@@ -149,6 +159,9 @@
 #define no_alias __declspec(noalias)
 #define restrict __declspec(restrict)
 #else
-#define always_inline inline
-#error Defines
+#define always_inline inline __attribute__((always_inline))
+#define never_inline __attribute__((noinline))
+#define no_vtable
+#define no_alias
+#define restrict __attribute__((malloc))
 #endif
@@ -0,0 +1,269 @@
+#include "profiler.h"
+
+#include "memory/hash_table.h"
+
+import fmt;
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+struct profiler_state {
+    thread::fast_mutex Lock;  // Guards registering threads, the zones themselves are recorded without it
+    internal::profiler_thread *Threads = null;
+
+    s64 StartTime = 0;  // internal::profiler_now() when profiler_start() was called
+};
+
+file_scope profiler_state Profiler;
+
+s64 internal::profiler_now_slow() { return os_get_timestamp_ns(); }
+
+file_scope internal::profiler_thread *profiler_register_thread() {
+    auto *t = (internal::profiler_thread *) os_allocate_block(sizeof(internal::profiler_thread));
+    zero_memory(t, sizeof(internal::profiler_thread));
+    t->ThreadID = Context.ThreadID.Value;
+
+    thread::scoped_lock _(&Profiler.Lock);
+    t->Next = Profiler.Threads;
+    atomic_store(&Profiler.Threads, t);
+
+    internal::ProfilerThread = t;
+    return t;
+}
+
+internal::profiler_chunk *internal::profiler_new_chunk() {
+    auto *t = ProfilerThread;
+    if (!t) t = profiler_register_thread();
+
+    auto *c = (profiler_chunk *) os_allocate_block(sizeof(profiler_chunk));
+    c->Next = null;
+    c->Count = 0;
+
+    // The exports walk the chunks from _First_, link the new one in before we start filling it
+    if (t->Last) {
+        atomic_store(&t->Last->Next, c);
+    } else {
+        atomic_store(&t->First, c);
+    }
+    t->Last = c;
+    return c;
+}
+
+void profiler_start() {
+    // os_get_timestamp_ns() uses the time stamp counter when it's invariant, then so do we and convert on export
+    internal::ProfilerUsesCycleCounter = os_clock_uses_cycle_counter();
+
+    Profiler.StartTime = internal::profiler_now();
+    atomic_store(&internal::ProfilerRunning, 1);
+}
+
+void profiler_stop() { atomic_store(&internal::ProfilerRunning, 0); }
+
+void profiler_reset() {
+    thread::scoped_lock _(&Profiler.Lock);
+    for (auto *t = Profiler.Threads; t; t = t->Next) {
+        auto *c = t->First;
+        while (c) {
+            auto *next = c->Next;
+            os_free_block(c);
+            c = next;
+        }
+        t->First = t->Last = null;
+    }
+}
+
+void profiler_set_thread_name(const string &name) {
+    auto *t = internal::ProfilerThread;
+    if (!t) t = profiler_register_thread();
+
+    s64 size = min(name.Count, (s64) sizeof(t->Name) - 1);
+    copy_memory(t->Name, name.Data, size);
+    t->Name[size] = 0;
+}
+
+s64 profiler_zone_count() {
+    s64 result = 0;
+
+    thread::scoped_lock _(&Profiler.Lock);
+    for (auto *t = Profiler.Threads; t; t = t->Next) {
+        for (auto *c = atomic_load(&t->First); c; c = atomic_load(&c->Next)) result += atomic_load(&c->Count);
+    }
+    return result;
+}
+
+// Nanoseconds since profiler_start()
+file_scope s64 profiler_to_ns(s64 time) {
+    s64 elapsed = max((s64) 0, time - Profiler.StartTime);
+    return internal::ProfilerUsesCycleCounter ? os_cycles_to_nanoseconds((u64) elapsed) : elapsed;
+}
+
+// Calls _visit(zone)_ for every zone of _t_ recorded so far
+template <typename Visit>
+file_scope void profiler_for_each_zone(internal::profiler_thread *t, Visit &&visit) {
+    for (auto *c = atomic_load(&t->First); c; c = atomic_load(&c->Next)) {
+        s64 count = atomic_load(&c->Count);
+        For(range(count)) visit(c->Zones[it]);
+    }
+}
+
+file_scope void profiler_write_json_string(writer *out, const char *str) {
+    write(out, (const byte *) "\"", 1);
+
+    const char *run = str;
+    for (; *str; ++str) {
+        char ch = *str;
+        if (ch != '"' && ch != '\\' && (u8) ch >= 0x20) continue;
+
+        write(out, (const byte *) run, str - run);
+        run = str + 1;
+
+        if (ch == '"' || ch == '\\') {
+            utf8 escaped[2] = {'\\', (utf8) ch};
+            write(out, (const byte *) escaped, 2);
+        } else {
+            fmt_to_writer(out, "\\u{:04x}", (u32) (u8) ch);
+        }
+    }
+    write(out, (const byte *) run, str - run);
+
+    write(out, (const byte *) "\"", 1);
+}
+
+void profiler_write_chrome_trace(writer *out) {
+    // fmt and the allocator have zones, they may record while we hold the lock. Registering takes it, so do it now.
+    if (!internal::ProfilerThread) profiler_register_thread();
+
+    write(out, string("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"));
+
+    bool first = true;
+    auto separate = [&]() {
+        if (!first) write(out, string(",\n"));
+        first = false;
+    };
+
+    thread::scoped_lock _(&Profiler.Lock);
+    for (auto *t = Profiler.Threads; t; t = t->Next) {
+        if (t->Name[0]) {
+            separate();
+            fmt_to_writer(out, "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":", t->ThreadID);
+            profiler_write_json_string(out, t->Name);
+            write(out, string("}}"));
+        }
+
+        profiler_for_each_zone(t, [&](const internal::profiler_zone &z) {
+            s64 begin = profiler_to_ns(z.Begin);
+            s64 duration = profiler_to_ns(z.End) - begin;
+
+            separate();
+            write(out, string("{\"name\":"));
+            profiler_write_json_string(out, z.Site->Name);
+            fmt_to_writer(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{}.{:03},\"dur\":{}.{:03},\"args\":{{\"file\":", t->ThreadID, begin / 1000, begin % 1000, duration / 1000, duration % 1000);
+            profiler_write_json_string(out, z.Site->File);
+            fmt_to_writer(out, ",\"line\":{}}}}}", z.Site->Line);
+        });
+    }
+
+    write(out, string("\n]}\n"));
+}
+
+//
+// The binary format, see the comment in profiler.h
+//
+
+file_scope void profiler_write_u32(writer *out, u32 v) {
+    byte b[4] = {(byte) v, (byte) (v >> 8), (byte) (v >> 16), (byte) (v >> 24)};
+    write(out, b, 4);
+}
+
+file_scope void profiler_write_u64(writer *out, u64 v) {
+    profiler_write_u32(out, (u32) v);
+    profiler_write_u32(out, (u32) (v >> 32));
+}
+
+file_scope void profiler_write_sized(writer *out, const char *str) {
+    s64 size = c_string_length(str);
+    profiler_write_u32(out, (u32) size);
+    write(out, (const byte *) str, size);
+}
+
+// Appends a LEB128 varint to _p_, returns the end
+file_scope byte *profiler_put_varint(byte *p, u64 v) {
+    while (v >= 0x80) {
+        *p++ = (byte) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (byte) v;
+    return p;
+}
+
+void profiler_write_binary(writer *out) {
+    if (!internal::ProfilerThread) profiler_register_thread();  // See profiler_write_chrome_trace()
+
+    write(out, (const byte *) "LSTDPROF", 8);
+    profiler_write_u32(out, 1);
+
+    thread::scoped_lock _(&Profiler.Lock);
+
+    // Number the sites which have zones, the zones refer to them by index
+    hash_table<const profile_zone_site *, u32> indices;
+    array<const profile_zone_site *> sites;
+    defer(free(indices));
+    defer(free(sites));
+
+    for (auto *t = Profiler.Threads; t; t = t->Next) {
+        profiler_for_each_zone(t, [&](const internal::profiler_zone &z) {
+            if (has(indices, z.Site)) return;
+            add(indices, z.Site, (u32) sites.Count);
+            array_append(sites, z.Site);
+        });
+    }
+
+    profiler_write_u32(out, (u32) sites.Count);
+    For(sites) {
+        profiler_write_u32(out, (u32) it->Line);
+        profiler_write_sized(out, it->Name);
+        profiler_write_sized(out, it->File);
+    }
+
+    s64 threadCount = 0;
+    for (auto *t = Profiler.Threads; t; t = t->Next) ++threadCount;
+    profiler_write_u32(out, (u32) threadCount);
+
+    for (auto *t = Profiler.Threads; t; t = t->Next) {
+        // The zones we count here are the ones we write, the thread may have recorded more meanwhile
+        s64 zoneCount = 0;
+        for (auto *c = atomic_load(&t->First); c; c = atomic_load(&c->Next)) zoneCount += atomic_load(&c->Count);
+
+        profiler_write_u64(out, t->ThreadID);
+        profiler_write_sized(out, t->Name);
+        profiler_write_u64(out, zoneCount);
+
+        byte buffer[1024];
+        byte *p = buffer;
+
+        s64 previous = 0, written = 0;
+        for (auto *c = atomic_load(&t->First); c && written < zoneCount; c = atomic_load(&c->Next)) {
+            s64 count = min(atomic_load(&c->Count), zoneCount - written);
+            For(range(count)) {
+                auto &z = c->Zones[it];
+
+                s64 begin = profiler_to_ns(z.Begin);
+                s64 delta = begin - previous;
+                previous = begin;
+
+                p = profiler_put_varint(p, *find(indices, z.Site).Value);
+                p = profiler_put_varint(p, ((u64) delta << 1) ^ (u64) (delta >> 63));
+                p = profiler_put_varint(p, (u64) (profiler_to_ns(z.End) - begin));
+
+                if (p - buffer > (s64) sizeof(buffer) - 30) {  // Room for the 3 varints of the next zone
+                    write(out, buffer, p - buffer);
+                    p = buffer;
+                }
+            }
+            written += count;
+        }
+        if (p != buffer) write(out, buffer, p - buffer);
+    }
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "internal/context.h"
+#include "io/writer.h"
+
+#if ARCH == X86
+#if COMPILER == MSVC
+#include <intrin.h>  // __rdtsc
+#else
+#include <x86intrin.h>  // __rdtsc
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// :Profiler: Scoped zones which record when a piece of code starts and ends, for viewing the run as a timeline.
+//
+//     void update_world() {
+//         PROFILE_FUNCTION();                 // The whole function, named after it
+//
+//         For(Entities) {
+//             PROFILE_ZONE("update entity");  // Until the end of the block
+//             ...
+//         }
+//     }
+//
+//     profiler_start();
+//     ... run ...
+//     profiler_stop();
+//     profiler_write_chrome_trace(&file);  // Open it in chrome://tracing or https://ui.perfetto.dev
+//
+// The zones compile to nothing unless LSTD_PROFILER is defined (see premake5.lua), so they can stay in hot code
+// (general_allocate and fmt_parse_and_format have some). With it defined, a zone outside of profiler_start/stop
+// is a load and a branch at each end. A recorded one reads the time stamp counter twice (see os.clock)
+// and writes 24 bytes to the thread's own buffer, there are no locks and nothing is shared between threads.
+//
+// The buffers are chunks of about 2700 zones, allocated straight from the OS (so zones in the allocator don't
+// recurse) and kept until profiler_reset(). Zones are recorded when they end, so a zone which is still open
+// isn't in an export. The exports read the buffers while other threads keep recording, they see everything
+// recorded before they got to a thread.
+//
+// Zone names must be string literals (or otherwise live as long as the program), we only keep pointers.
+//
+
+#if defined LSTD_PROFILER
+#define PROFILE_ZONE(name)                                                                                  \
+    static const LSTD_NAMESPACE::profile_zone_site LINE_NAME(profileSite) = {name, __FILE__, __LINE__}; \
+    LSTD_NAMESPACE::internal::profile_zone LINE_NAME(profileZone)(&LINE_NAME(profileSite))
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+
+// One per PROFILE_ZONE in the source
+struct profile_zone_site {
+    const char *Name;
+    const char *File;
+    s64 Line;
+};
+
+// Starts recording zones (in every thread). Calibrates the clock if nobody did yet.
+void profiler_start();
+
+// Zones which begin after this aren't recorded. Ones which were already open are, when they end.
+void profiler_stop();
+
+// Frees the recorded zones. Call it only when nobody records (after profiler_stop() once the zones which were open are done).
+void profiler_reset();
+
+// Shows up as the name of the calling thread's track in the exports. _name_ is copied (and cut at 63 bytes).
+void profiler_set_thread_name(const string &name);
+
+// The number of zones recorded so far
+s64 profiler_zone_count();
+
+// The Chrome trace event format (JSON), which chrome://tracing, Perfetto and Speedscope open.
+// Every zone is a complete ("X") event, the time stamps are microseconds since profiler_start().
+void profiler_write_chrome_trace(writer *out);
+
+//
+// A compact binary dump, about 4-6 bytes per zone instead of about 130 in JSON. All integers are little endian,
+// "varint" is LEB128 and "zigzag" is a varint of (v << 1) ^ (v >> 63):
+//
+//    "LSTDPROF", u32 version (1)
+//    u32 site count, then per site: u32 line, u32 name size, the name, u32 file size, the file
+//    u32 thread count, then per thread: u64 id, u32 name size, the name, u64 zone count,
+//        then per zone: varint site index, zigzag start - start of the previous zone of the thread, varint duration
+//
+// Times are nanoseconds since profiler_start(). Zones are in the order they ended.
+//
+void profiler_write_binary(writer *out);
+
+namespace internal {
+
+constexpr s64 PROFILER_CHUNK_ZONES = 2720;  // A chunk is about 64 KiB
+
+struct profiler_zone {
+    const profile_zone_site *Site;
+    s64 Begin, End;  // Cycles or nanoseconds, see profiler_now()
+};
+
+struct profiler_chunk {
+    profiler_chunk *Next;
+    s64 Count;  // Written only by the owner thread, read by the exports
+    profiler_zone Zones[PROFILER_CHUNK_ZONES];
+};
+
+struct profiler_thread {
+    profiler_thread *Next;
+    u64 ThreadID;
+    char Name[64];
+
+    profiler_chunk *First, *Last;
+};
+
+inline s32 ProfilerRunning = 0;
+inline bool ProfilerUsesCycleCounter = false;  // Set by profiler_start() if the time stamp counter is usable
+
+inline thread_local profiler_thread *ProfilerThread = null;
+
+// os_get_timestamp_ns(), for when we can't read the counter ourselves
+s64 profiler_now_slow();
+
+always_inline s64 profiler_now() {
+#if ARCH == X86
+    if (ProfilerUsesCycleCounter) return (s64) __rdtsc();
+#endif
+    return profiler_now_slow();
+}
+
+// Registers the thread if it's the first zone it records and adds a chunk to its buffer
+profiler_chunk *profiler_new_chunk();
+
+always_inline void profiler_record(const profile_zone_site *site, s64 begin, s64 end) {
+    auto *t = ProfilerThread;
+
+    profiler_chunk *c = t ? t->Last : null;
+    if (!c || c->Count == PROFILER_CHUNK_ZONES) c = profiler_new_chunk();
+
+    c->Zones[c->Count] = {site, begin, end};
+    atomic_store(&c->Count, c->Count + 1);  // Publishes the zone to the exports
+}
+
+struct profile_zone : non_copyable {
+    const profile_zone_site *Site;
+    s64 Begin;  // 0 if we aren't recording
+
+    always_inline profile_zone(const profile_zone_site *site) : Site(site), Begin(atomic_load(&ProfilerRunning) ? profiler_now() : 0) {}
+
+    always_inline ~profile_zone() {
+        if (Begin) profiler_record(Site, Begin, profiler_now());
+    }
+};
+}  // namespace internal
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,311 @@
+#include "random.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSE2 and AVX2 intrinsics
+
+#if COMPILER == MSVC
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif ARCH == ARM && ANY_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope u64 splitmix64(u64 &x) {
+    u64 z = (x += 0x9E3779B97F4A7C15ull);
+    z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z     = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(rng &r, u64 seed) {
+    For(range(4)) r.S[it] = splitmix64(seed);
+}
+
+void rng_seed_os(rng &r) {
+    u64 seed[4];
+    internal::platform_random_bytes((byte *) seed, sizeof(seed));
+
+    // The state can't be all zeroes
+    For(range(4)) r.S[it] = seed[it];
+    if (!(r.S[0] | r.S[1] | r.S[2] | r.S[3])) rng_seed(r, 0);
+}
+
+file_scope thread_local rng ThreadRng;
+file_scope thread_local bool ThreadRngSeeded = false;
+
+rng &thread_rng() {
+    if (!ThreadRngSeeded) {
+        rng_seed_os(ThreadRng);
+        ThreadRngSeeded = true;
+    }
+    return ThreadRng;
+}
+
+// The state after 2^128 (or 2^192) calls is the sum (in GF(2)) of the states after the calls for the set bits of the jump polynomial
+file_scope void rng_jump_by(rng &r, const u64 (&polynomial)[4]) {
+    u64 s[4] = {};
+    For_as(word, polynomial) {
+        For_as(bit, range(64)) {
+            if (word & (1ull << bit)) {
+                For(range(4)) s[it] ^= r.S[it];
+            }
+            rng_next(r);
+        }
+    }
+    For(range(4)) r.S[it] = s[it];
+}
+
+void rng_jump(rng &r) {
+    local_persist const u64 JUMP[4] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull};
+    rng_jump_by(r, JUMP);
+}
+
+void rng_long_jump(rng &r) {
+    local_persist const u64 LONG_JUMP[4] = {0x76E15D3EFEFDCBBFull, 0xC5004E441C522FB3ull, 0x77710069854EE241ull, 0x39109BB02ACBE635ull};
+    rng_jump_by(r, LONG_JUMP);
+}
+
+//
+// Bulk fill. The kernels run 4 generators side by side, the state is S[word][stream].
+// Each round makes one number per stream, stream k goes to element k of the round (two elements 2k and 2k + 1 for f32).
+//
+
+enum rng_fill_kind { RNG_FILL_U64, RNG_FILL_F64, RNG_FILL_F32 };
+
+// Bytes one round writes (4 numbers)
+file_scope constexpr s64 RNG_FILL_ROUND = 32;
+
+// Jumping costs about as much as 1000 numbers, below this many numbers we just call rng_next()
+file_scope constexpr s64 RNG_FILL_STREAMS_MIN = 4096;
+
+using rng_fill_func = void (*)(u64 (&s)[4][4], byte *out, s64 rounds);
+
+// Also used for the tail of the SIMD versions, so everything writes the same numbers
+template <rng_fill_kind Kind>
+file_scope void rng_fill_baseline(u64 (&s)[4][4], byte *out, s64 rounds) {
+    For(range(rounds)) {
+        For_as(k, range(4)) {
+            u64 s1 = s[1][k];
+
+            u64 x = rotate_left_64(s1 * 5, 7) * 9;
+            u64 t = s1 << 17;
+
+            s[2][k] ^= s[0][k];
+            s[3][k] ^= s1;
+            s[1][k] ^= s[2][k];
+            s[0][k] ^= s[3][k];
+            s[2][k] ^= t;
+            s[3][k] = rotate_left_64(s[3][k], 45);
+
+            if constexpr (Kind == RNG_FILL_U64) {
+                ((u64 *) out)[k] = x;
+            } else if constexpr (Kind == RNG_FILL_F64) {
+                ((f64 *) out)[k] = (f64) (x >> 11) * 0x1.0p-53;
+            } else {
+                ((f32 *) out)[2 * k]     = (f32) ((u32) x >> 8) * 0x1.0p-24f;
+                ((f32 *) out)[2 * k + 1] = (f32) ((u32) (x >> 32) >> 8) * 0x1.0p-24f;
+            }
+        }
+        out += RNG_FILL_ROUND;
+    }
+}
+
+#if ARCH == X86
+// x * 5 and x * 9 are shifts and adds (there are no 64 bit multiplies before AVX-512)
+#define RNG_STEP(V, add, shl, shr, xor_, or_)                                    \
+    V t5 = add(s1, shl(s1, 2));                                                   \
+    V r7 = or_(shl(t5, 7), shr(t5, 57));                                          \
+    V x  = add(r7, shl(r7, 3));                                                   \
+    V t  = shl(s1, 17);                                                           \
+    s2   = xor_(s2, s0);                                                          \
+    s3   = xor_(s3, s1);                                                          \
+    s1   = xor_(s1, s2);                                                          \
+    s0   = xor_(s0, s3);                                                          \
+    s2   = xor_(s2, t);                                                           \
+    s3   = or_(shl(s3, 45), shr(s3, 19));
+
+template <rng_fill_kind Kind>
+TARGET_AVX2 file_scope void rng_fill_avx2(u64 (&s)[4][4], byte *out, s64 rounds) {
+    __m256i s0 = _mm256_loadu_si256((const __m256i *) s[0]);
+    __m256i s1 = _mm256_loadu_si256((const __m256i *) s[1]);
+    __m256i s2 = _mm256_loadu_si256((const __m256i *) s[2]);
+    __m256i s3 = _mm256_loadu_si256((const __m256i *) s[3]);
+
+    // (x >> 11) to f64 exactly: the low 52 bits with the exponent of 2^52 minus 2^52, then the top bit as +2^52
+    __m256i mantissa = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFll);
+    __m256i exponent = _mm256_set1_epi64x(0x4330000000000000ll);
+    __m256d two52    = _mm256_set1_pd(0x1.0p52);
+
+    For(range(rounds)) {
+        RNG_STEP(__m256i, _mm256_add_epi64, _mm256_slli_epi64, _mm256_srli_epi64, _mm256_xor_si256, _mm256_or_si256);
+
+        if constexpr (Kind == RNG_FILL_U64) {
+            _mm256_storeu_si256((__m256i *) out, x);
+        } else if constexpr (Kind == RNG_FILL_F64) {
+            __m256i v  = _mm256_srli_epi64(x, 11);
+            __m256d lo = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(v, mantissa), exponent)), two52);
+            __m256i hi = _mm256_and_si256(_mm256_sub_epi64(_mm256_setzero_si256(), _mm256_srli_epi64(v, 52)), exponent);
+            _mm256_storeu_pd((f64 *) out, _mm256_mul_pd(_mm256_add_pd(lo, _mm256_castsi256_pd(hi)), _mm256_set1_pd(0x1.0p-53)));
+        } else {
+            __m256 f = _mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8));
+            _mm256_storeu_ps((f32 *) out, _mm256_mul_ps(f, _mm256_set1_ps(0x1.0p-24f)));
+        }
+        out += RNG_FILL_ROUND;
+    }
+
+    _mm256_storeu_si256((__m256i *) s[0], s0);
+    _mm256_storeu_si256((__m256i *) s[1], s1);
+    _mm256_storeu_si256((__m256i *) s[2], s2);
+    _mm256_storeu_si256((__m256i *) s[3], s3);
+}
+
+// Two streams per register, streams 0-1 and 2-3 run one after the other
+template <rng_fill_kind Kind>
+file_scope void rng_fill_sse2(u64 (&s)[4][4], byte *out, s64 rounds) {
+    __m128i mantissa = _mm_set1_epi64x(0x000FFFFFFFFFFFFFll);
+    __m128i exponent = _mm_set1_epi64x(0x4330000000000000ll);
+    __m128d two52    = _mm_set1_pd(0x1.0p52);
+
+    For_as(half, range(2)) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *) (s[0] + 2 * half));
+        __m128i s1 = _mm_loadu_si128((const __m128i *) (s[1] + 2 * half));
+        __m128i s2 = _mm_loadu_si128((const __m128i *) (s[2] + 2 * half));
+        __m128i s3 = _mm_loadu_si128((const __m128i *) (s[3] + 2 * half));
+
+        byte *p = out + half * RNG_FILL_ROUND / 2;
+        For(range(rounds)) {
+            RNG_STEP(__m128i, _mm_add_epi64, _mm_slli_epi64, _mm_srli_epi64, _mm_xor_si128, _mm_or_si128);
+
+            if constexpr (Kind == RNG_FILL_U64) {
+                _mm_storeu_si128((__m128i *) p, x);
+            } else if constexpr (Kind == RNG_FILL_F64) {
+                __m128i v  = _mm_srli_epi64(x, 11);
+                __m128d lo = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(_mm_and_si128(v, mantissa), exponent)), two52);
+                __m128i hi = _mm_and_si128(_mm_sub_epi64(_mm_setzero_si128(), _mm_srli_epi64(v, 52)), exponent);
+                _mm_storeu_pd((f64 *) p, _mm_mul_pd(_mm_add_pd(lo, _mm_castsi128_pd(hi)), _mm_set1_pd(0x1.0p-53)));
+            } else {
+                __m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(x, 8));
+                _mm_storeu_ps((f32 *) p, _mm_mul_ps(f, _mm_set1_ps(0x1.0p-24f)));
+            }
+            p += RNG_FILL_ROUND;
+        }
+
+        _mm_storeu_si128((__m128i *) (s[0] + 2 * half), s0);
+        _mm_storeu_si128((__m128i *) (s[1] + 2 * half), s1);
+        _mm_storeu_si128((__m128i *) (s[2] + 2 * half), s2);
+        _mm_storeu_si128((__m128i *) (s[3] + 2 * half), s3);
+    }
+}
+
+#undef RNG_STEP
+#elif ARCH == ARM && ANY_ARM_NEON
+template <rng_fill_kind Kind>
+file_scope void rng_fill_neon(u64 (&s)[4][4], byte *out, s64 rounds) {
+    For_as(half, range(2)) {
+        uint64x2_t s0 = vld1q_u64(s[0] + 2 * half);
+        uint64x2_t s1 = vld1q_u64(s[1] + 2 * half);
+        uint64x2_t s2 = vld1q_u64(s[2] + 2 * half);
+        uint64x2_t s3 = vld1q_u64(s[3] + 2 * half);
+
+        byte *p = out + half * RNG_FILL_ROUND / 2;
+        For(range(rounds)) {
+            uint64x2_t t5 = vaddq_u64(s1, vshlq_n_u64(s1, 2));
+            uint64x2_t r7 = vsriq_n_u64(vshlq_n_u64(t5, 7), t5, 57);
+            uint64x2_t x  = vaddq_u64(r7, vshlq_n_u64(r7, 3));
+            uint64x2_t t  = vshlq_n_u64(s1, 17);
+
+            s2 = veorq_u64(s2, s0);
+            s3 = veorq_u64(s3, s1);
+            s1 = veorq_u64(s1, s2);
+            s0 = veorq_u64(s0, s3);
+            s2 = veorq_u64(s2, t);
+            s3 = vsriq_n_u64(vshlq_n_u64(s3, 45), s3, 19);
+
+            if constexpr (Kind == RNG_FILL_U64) {
+                vst1q_u64((u64 *) p, x);
+            } else if constexpr (Kind == RNG_FILL_F64) {
+                vst1q_f64((f64 *) p, vmulq_n_f64(vcvtq_f64_u64(vshrq_n_u64(x, 11)), 0x1.0p-53));
+            } else {
+                float32x4_t f = vcvtq_f32_u32(vshrq_n_u32(vreinterpretq_u32_u64(x), 8));
+                vst1q_f32((f32 *) p, vmulq_n_f32(f, 0x1.0p-24f));
+            }
+            p += RNG_FILL_ROUND;
+        }
+
+        vst1q_u64(s[0] + 2 * half, s0);
+        vst1q_u64(s[1] + 2 * half, s1);
+        vst1q_u64(s[2] + 2 * half, s2);
+        vst1q_u64(s[3] + 2 * half, s3);
+    }
+}
+#endif
+
+template <rng_fill_kind Kind>
+file_scope rng_fill_func rng_fill_pick(const cpu_features &cpu) {
+#if ARCH == X86
+    return cpu.AVX2 ? rng_fill_avx2<Kind> : rng_fill_sse2<Kind>;
+#elif ARCH == ARM && ANY_ARM_NEON
+    return rng_fill_neon<Kind>;
+#else
+    return rng_fill_baseline<Kind>;
+#endif
+}
+
+// _size_ is the size of _out_ in bytes
+template <rng_fill_kind Kind>
+file_scope void rng_fill_streams(rng &r, byte *out, s64 size) {
+    local_persist cpu_dispatch<rng_fill_func> kernel;
+    auto func = cpu_dispatch_get(kernel, rng_fill_pick<Kind>);
+
+    u64 s[4][4];
+    For_as(k, range(4)) {
+        For(range(4)) s[it][k] = r.S[it];
+        rng_jump(r);
+    }
+
+    s64 rounds = size / RNG_FILL_ROUND;
+    func(s, out, rounds);
+
+    // The last partial round
+    s64 done = rounds * RNG_FILL_ROUND;
+    if (done < size) {
+        byte last[RNG_FILL_ROUND];
+        rng_fill_baseline<Kind>(s, last, 1);
+        copy_memory(out + done, last, size - done);
+    }
+}
+
+void rng_fill(rng &r, array<u64> out) {
+    if (out.Count < RNG_FILL_STREAMS_MIN) {
+        For(out) it = rng_next(r);
+        return;
+    }
+    rng_fill_streams<RNG_FILL_U64>(r, (byte *) out.Data, out.Count * sizeof(u64));
+}
+
+void rng_fill(rng &r, array<f64> out) {
+    if (out.Count < RNG_FILL_STREAMS_MIN) {
+        For(out) it = rng_f64(r);
+        return;
+    }
+    rng_fill_streams<RNG_FILL_F64>(r, (byte *) out.Data, out.Count * sizeof(f64));
+}
+
+void rng_fill(rng &r, array<f32> out) {
+    if (out.Count / 2 < RNG_FILL_STREAMS_MIN) {
+        For(range(out.Count / 2)) {
+            u64 x           = rng_next(r);
+            out[2 * it]     = (f32) ((u32) x >> 8) * 0x1.0p-24f;
+            out[2 * it + 1] = (f32) ((u32) (x >> 32) >> 8) * 0x1.0p-24f;
+        }
+        if (out.Count & 1) out[out.Count - 1] = rng_f32(r);
+        return;
+    }
+    rng_fill_streams<RNG_FILL_F32>(r, (byte *) out.Data, out.Count * sizeof(f32));
+}
+
+LSTD_END_NAMESPACE
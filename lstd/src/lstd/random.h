@@ -0,0 +1,117 @@
+#pragma once
+
+#include "memory/array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Deterministic pseudo random numbers with xoshiro256** (https://prng.di.unimi.it/).
+// 256 bits of state, a period of 2^256 - 1, passes BigCrush and PractRand, and one number is a few shifts and adds.
+//
+//     rng r;
+//     rng_seed(r, 42);                       // The same seed gives the same numbers on every platform
+//     u64 x   = rng_next(r);
+//     s64 die = rng_range(r, 1, 7);          // [1, 7)
+//     f64 t   = rng_f64(r);                  // [0, 1)
+//
+//     f64 *samples = ...;
+//     rng_fill(r, array<f64>(samples, n));  // Bulk, with SIMD
+//
+//     u64 y = rng_next(thread_rng());        // Seeded from the OS, one per thread, no locking
+//
+// NOT cryptographically secure, the state can be recovered from a few outputs.
+//
+// Parallel streams: rng_jump() advances a generator by 2^128 numbers, so copies of one seeded generator which are
+// jumped 0, 1, 2, ... times give streams which never overlap, and the result doesn't depend on how work is scheduled:
+//
+//     rng base;
+//     rng_seed(base, 42);
+//     For(range(workers)) {
+//         streams[it] = base;
+//         rng_jump(base);
+//     }
+//
+// rng_long_jump() advances by 2^192, for a second level (e.g. one per machine, then rng_jump() for its threads).
+//
+struct rng {
+    u64 S[4];
+};
+
+// Expands _seed_ into the state with splitmix64 (any seed, including 0, gives a good state)
+void rng_seed(rng &r, u64 seed);
+
+// Seeds from the operating system's random generator
+void rng_seed_os(rng &r);
+
+// A generator for the calling thread, seeded with rng_seed_os() the first time it's used on that thread
+rng &thread_rng();
+
+void rng_jump(rng &r);
+void rng_long_jump(rng &r);
+
+always_inline u64 rng_next(rng &r) {
+    u64 result = rotate_left_64(r.S[1] * 5, 7) * 9;
+    u64 t      = r.S[1] << 17;
+
+    r.S[2] ^= r.S[0];
+    r.S[3] ^= r.S[1];
+    r.S[1] ^= r.S[2];
+    r.S[0] ^= r.S[3];
+    r.S[2] ^= t;
+    r.S[3] = rotate_left_64(r.S[3], 45);
+    return result;
+}
+
+// The high bits (all bits of xoshiro256** are good, but the upper ones are the best)
+always_inline u32 rng_next_u32(rng &r) { return (u32) (rng_next(r) >> 32); }
+
+// Uniform in [0, bound) without modulo bias, with Lemire's multiply-shift method
+// (https://arxiv.org/abs/1805.10941): the high half of next * bound, numbers in the biased part of the
+// low half are thrown away. The division to find that part only happens when the low half is small,
+// which for small bounds is almost never.
+always_inline u64 rng_below(rng &r, u64 bound) {
+    assert(bound > 0);
+
+    u128 m = mul128(rng_next(r), bound);
+    if (m.lo < bound) {
+        u64 threshold = (0 - bound) % bound;
+        while (m.lo < threshold) m = mul128(rng_next(r), bound);
+    }
+    return m.hi;
+}
+
+// Uniform in [lo, hi)
+always_inline s64 rng_range(rng &r, s64 lo, s64 hi) {
+    assert(lo < hi);
+    return lo + (s64) rng_below(r, (u64) hi - (u64) lo);
+}
+
+// Uniform in [0, 1), all 53 bits of the mantissa are random (a multiple of 2^-53)
+always_inline f64 rng_f64(rng &r) { return (f64) (rng_next(r) >> 11) * 0x1.0p-53; }
+
+// Uniform in [0, 1), a multiple of 2^-24
+always_inline f32 rng_f32(rng &r) { return (f32) (rng_next(r) >> 40) * 0x1.0p-24f; }
+
+// Uniform in [lo, hi)
+always_inline f64 rng_f64(rng &r, f64 lo, f64 hi) { return lo + (hi - lo) * rng_f64(r); }
+always_inline f32 rng_f32(rng &r, f32 lo, f32 hi) { return lo + (hi - lo) * rng_f32(r); }
+
+//
+// Fill arrays with random numbers (out.Count of them, the array isn't resized).
+//
+// Arrays of 4096 numbers or more are filled from 4 streams at once (_r_ jumped 0, 1, 2 and 3 times, interleaved) with AVX2, SSE2 or
+// NEON (picked at runtime with cpu_dispatch_get()), and _r_ is left jumped 4 times. The numbers don't depend on
+// the instruction set, only on the seed and the count, but they aren't the same as calling rng_next() out.Count times.
+//
+// The floats are the same as the ones from rng_f64(); with f32 each 64 bit number gives two floats (24 bits out of each half).
+//
+void rng_fill(rng &r, array<u64> out);
+void rng_fill(rng &r, array<f64> out);
+void rng_fill(rng &r, array<f32> out);
+
+namespace internal {
+// Implemented per platform, for rng_seed_os() (and guids, see memory/guid.h)
+void platform_random_bytes(byte *dest, s64 count);
+}  // namespace internal
+
+LSTD_END_NAMESPACE
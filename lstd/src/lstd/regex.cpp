@@ -0,0 +1,1059 @@
+#include "regex.h"
+
+#include "memory/hasher.h"
+#include "memory/sort.h"
+
+LSTD_BEGIN_NAMESPACE
+
+file_scope constexpr s32 REGEX_MAX_PROGRAM = 1 << 20;  // Instructions, x{1000}{1000} and friends stop here
+file_scope constexpr s32 REGEX_MAX_REPEAT  = 1000;
+file_scope constexpr s32 REGEX_MAX_DEPTH   = 1000;     // Nested groups, we parse and compile recursively
+
+file_scope constexpr u32 REGEX_MAX_CP = 0x10FFFF;
+
+// Flags of DFA states
+enum : u8 {
+    DFA_MATCH        = 1,  // A match ends here
+    DFA_MATCH_AT_END = 2,  // A match ends here if this is the end of the text (there was a $)
+    DFA_PREFILTER    = 4,  // The unanchored start state, the search can skip to where the prefix is
+};
+
+// Assertions which hold where a closure is taken
+enum : u32 { AT_BEGIN = 1, AT_END = 2 };
+
+//
+// Parsing. The pattern becomes a tree of nodes, which is compiled twice (forwards and backwards).
+//
+
+struct regex_range {
+    u32 Lo, Hi;
+};
+
+enum regex_node_kind : u8 { NODE_EMPTY, NODE_CLASS, NODE_CONCAT, NODE_ALT, NODE_REPEAT, NODE_BEGIN, NODE_END };
+
+struct regex_node {
+    regex_node_kind Kind;
+    bool Greedy;
+    s32 Min, Max;      // For repeats, Max is -1 if there is no upper bound
+    s32 First, Count;  // Children in _Kids_ (the child of a repeat is _First_), or for classes ranges in _Ranges_
+};
+
+struct regex_parser {
+    const utf8 *Begin, *P, *End;
+    bool CaseInsensitive;
+
+    array<regex_node> Nodes;
+    array<s32> Kids;
+    array<regex_range> Ranges;
+
+    string Error;
+    s64 ErrorOffset = -1;
+
+    s32 Depth = 0;
+};
+
+file_scope s32 parse_fail(regex_parser &p, const utf8 *at, const string &message) {
+    if (p.ErrorOffset == -1) {
+        p.Error       = message;
+        p.ErrorOffset = at - p.Begin;
+    }
+    return -1;
+}
+
+file_scope s32 parse_add_node(regex_parser &p, regex_node node) {
+    array_append(p.Nodes, node);
+    return (s32) p.Nodes.Count - 1;
+}
+
+file_scope s32 parse_add_list(regex_parser &p, regex_node_kind kind, const array<s32> &items) {
+    s32 first = (s32) p.Kids.Count;
+    For(items) array_append(p.Kids, it);
+    return parse_add_node(p, {.Kind = kind, .First = first, .Count = (s32) items.Count});
+}
+
+// Sorts and merges the ranges, adds the other case of ASCII letters if needed, and complements if _negate_
+file_scope s32 parse_add_class(regex_parser &p, array<regex_range> &ranges, bool negate) {
+    if (p.CaseInsensitive) {
+        s64 count = ranges.Count;
+        For(range(count)) {
+            regex_range r = ranges[it];
+
+            u32 lo = max(r.Lo, (u32) 'a'), hi = min(r.Hi, (u32) 'z');
+            if (lo <= hi) array_append(ranges, {lo - 32, hi - 32});
+
+            lo = max(r.Lo, (u32) 'A'), hi = min(r.Hi, (u32) 'Z');
+            if (lo <= hi) array_append(ranges, {lo + 32, hi + 32});
+        }
+    }
+
+    sort(ranges.Data, ranges.Data + ranges.Count, [](const regex_range *a, const regex_range *b) -> s32 {
+        return a->Lo < b->Lo ? -1 : (a->Lo > b->Lo ? 1 : 0);
+    });
+
+    s32 first = (s32) p.Ranges.Count;
+    if (!negate) {
+        For(ranges) {
+            if (p.Ranges.Count > first && it.Lo <= p.Ranges[-1].Hi + 1) {
+                p.Ranges[-1].Hi = max(p.Ranges[-1].Hi, it.Hi);
+            } else {
+                array_append(p.Ranges, it);
+            }
+        }
+    } else {
+        u32 next = 0;  // The first code point which isn't covered yet
+        For(ranges) {
+            if (it.Lo > next) array_append(p.Ranges, {next, it.Lo - 1});
+            if (it.Hi + 1 > next) next = it.Hi + 1;
+        }
+        if (next <= REGEX_MAX_CP) array_append(p.Ranges, {next, REGEX_MAX_CP});
+    }
+
+    return parse_add_node(p, {.Kind = NODE_CLASS, .First = first, .Count = (s32) (p.Ranges.Count - first)});
+}
+
+file_scope s32 parse_add_cp(regex_parser &p, u32 cp) {
+    array<regex_range> ranges;
+    defer(free(ranges));
+    array_append(ranges, {cp, cp});
+    return parse_add_class(p, ranges, false);
+}
+
+// Returns the code point, or -1 if the pattern ends or isn't valid UTF-8
+file_scope s64 parse_cp(regex_parser &p) {
+    if (p.P >= p.End) return parse_fail(p, p.P, "Unexpected end of pattern");
+
+    s64 size = get_size_of_cp(p.P);
+    if (size <= 0 || p.P + size > p.End) return parse_fail(p, p.P, "Invalid UTF-8 in pattern");
+
+    u32 cp = decode_cp(p.P);
+    p.P += size;
+    return cp;
+}
+
+file_scope void add_shorthand(array<regex_range> &ranges, utf8 c) {
+    array<regex_range> set;
+    defer(free(set));
+
+    utf8 lower = c | 0x20;
+    if (lower == 'd') {
+        array_append(set, {'0', '9'});
+    } else if (lower == 'w') {
+        array_append(set, {'0', '9'});
+        array_append(set, {'A', 'Z'});
+        array_append(set, {'_', '_'});
+        array_append(set, {'a', 'z'});
+    } else {
+        array_append(set, {'\t', '\r'});  // \t \n \v \f \r
+        array_append(set, {' ', ' '});
+    }
+
+    if (c == lower) {
+        For(set) array_append(ranges, it);
+    } else {
+        // The sets are sorted and don't touch
+        u32 next = 0;
+        For(set) {
+            if (it.Lo > next) array_append(ranges, {next, it.Lo - 1});
+            next = it.Hi + 1;
+        }
+        array_append(ranges, {next, REGEX_MAX_CP});
+    }
+}
+
+file_scope s64 parse_hex(regex_parser &p, s32 digits) {
+    u32 value = 0;
+    For(range(digits)) {
+        if (p.P >= p.End) return parse_fail(p, p.P, "Unexpected end of pattern");
+
+        utf8 c = *p.P;
+        s32 digit = c >= '0' && c <= '9' ? c - '0' : ((c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1);
+        if (digit == -1) {
+            if (digits == 8 && it > 0) break;  // \x{...} takes any number of digits
+            return parse_fail(p, p.P, "Invalid hex digit");
+        }
+        value = value * 16 + digit;
+        if (value > REGEX_MAX_CP) return parse_fail(p, p.P, "Code point out of range");
+        ++p.P;
+    }
+    return value;
+}
+
+// After a backslash. Returns the code point, or -2 if it was a shorthand class (added to _ranges_), or -1 on error.
+file_scope s64 parse_escape(regex_parser &p, array<regex_range> &ranges) {
+    const utf8 *at = p.P - 1;
+    if (p.P >= p.End) return parse_fail(p, at, "Trailing backslash");
+
+    if ((u8) *p.P >= 0x80) return parse_cp(p);  // Escaped non-ASCII is just the code point
+
+    utf8 c = *p.P++;
+    switch (c) {
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S':
+            add_shorthand(ranges, c);
+            return -2;
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'x': {
+            if (p.P < p.End && *p.P == '{') {
+                ++p.P;
+                s64 cp = parse_hex(p, 8);
+                if (cp < 0) return -1;
+                if (p.P >= p.End || *p.P != '}') return parse_fail(p, at, "Missing } in \\x{...}");
+                ++p.P;
+                return cp;
+            }
+            return parse_hex(p, 2);
+        }
+    }
+
+    // Punctuation is a literal, letters and digits are reserved (e.g. \b, \1 which we don't support)
+    if (!(c >= '0' && c <= '9') && !((c | 0x20) >= 'a' && (c | 0x20) <= 'z')) return c;
+    return parse_fail(p, at, "Unsupported escape sequence");
+}
+
+file_scope s32 parse_class(regex_parser &p) {
+    const utf8 *at = p.P++;  // [
+
+    bool negate = p.P < p.End && *p.P == '^';
+    if (negate) ++p.P;
+
+    array<regex_range> ranges;
+    defer(free(ranges));
+
+    bool first = true;
+    while (true) {
+        if (p.P >= p.End) return parse_fail(p, at, "Missing ]");
+        if (*p.P == ']' && !first) {
+            ++p.P;
+            break;
+        }
+        first = false;
+
+        const utf8 *itemAt = p.P;
+
+        s64 lo;
+        if (*p.P == '\\') {
+            ++p.P;
+            lo = parse_escape(p, ranges);
+            if (lo == -2) continue;
+        } else {
+            lo = parse_cp(p);
+        }
+        if (lo < 0) return -1;
+
+        s64 hi = lo;
+        if (p.P + 1 < p.End && *p.P == '-' && p.P[1] != ']') {
+            ++p.P;
+            if (*p.P == '\\') {
+                ++p.P;
+                hi = parse_escape(p, ranges);
+                if (hi == -2) return parse_fail(p, itemAt, "A class can't be the end of a range");
+            } else {
+                hi = parse_cp(p);
+            }
+            if (hi < 0) return -1;
+            if (hi < lo) return parse_fail(p, itemAt, "Invalid range, the end is before the beginning");
+        }
+        array_append(ranges, {(u32) lo, (u32) hi});
+    }
+    return parse_add_class(p, ranges, negate);
+}
+
+file_scope s32 parse_alternation(regex_parser &p);
+
+file_scope s32 parse_atom(regex_parser &p) {
+    const utf8 *at = p.P;
+
+    utf8 c = *p.P;
+    switch (c) {
+        case '(': {
+            ++p.P;
+            if (p.P < p.End && *p.P == '?') {
+                if (p.P + 1 < p.End && p.P[1] == ':') {
+                    p.P += 2;
+                } else {
+                    return parse_fail(p, at, "Unsupported group (only (?:...) is supported)");
+                }
+            }
+
+            if (++p.Depth > REGEX_MAX_DEPTH) return parse_fail(p, at, "Groups are nested too deep");
+            s32 result = parse_alternation(p);
+            --p.Depth;
+            if (result < 0) return -1;
+
+            if (p.P >= p.End || *p.P != ')') return parse_fail(p, at, "Missing )");
+            ++p.P;
+            return result;
+        }
+        case '*':
+        case '+':
+        case '?':
+            return parse_fail(p, at, "Nothing to repeat");
+        case '[':
+            return parse_class(p);
+        case '.': {
+            ++p.P;
+            array<regex_range> ranges;
+            defer(free(ranges));
+            array_append(ranges, {'\n', '\n'});
+            return parse_add_class(p, ranges, true);
+        }
+        case '^':
+            ++p.P;
+            return parse_add_node(p, {.Kind = NODE_BEGIN});
+        case '$':
+            ++p.P;
+            return parse_add_node(p, {.Kind = NODE_END});
+        case '\\': {
+            ++p.P;
+            array<regex_range> ranges;
+            defer(free(ranges));
+
+            s64 cp = parse_escape(p, ranges);
+            if (cp == -1) return -1;
+            if (cp == -2) return parse_add_class(p, ranges, false);
+            return parse_add_cp(p, (u32) cp);
+        }
+    }
+
+    s64 cp = parse_cp(p);
+    if (cp < 0) return -1;
+    return parse_add_cp(p, (u32) cp);
+}
+
+file_scope bool parse_number(regex_parser &p, s32 *out) {
+    if (p.P >= p.End || *p.P < '0' || *p.P > '9') return false;
+
+    s64 value = 0;
+    while (p.P < p.End && *p.P >= '0' && *p.P <= '9') {
+        value = min<s64>(value * 10 + (*p.P - '0'), REGEX_MAX_REPEAT + 1);
+        ++p.P;
+    }
+    *out = (s32) value;
+    return true;
+}
+
+// {n}, {n,} or {n,m}. If it's not one of these the { is a literal and we don't move.
+file_scope bool parse_braces(regex_parser &p, s32 *min, s32 *max) {
+    const utf8 *start = p.P++;
+
+    if (!parse_number(p, min)) {
+        p.P = start;
+        return false;
+    }
+
+    *max = *min;
+    if (p.P < p.End && *p.P == ',') {
+        ++p.P;
+        if (!parse_number(p, max)) *max = -1;
+    }
+
+    if (p.P >= p.End || *p.P != '}') {
+        p.P = start;
+        return false;
+    }
+    ++p.P;
+    return true;
+}
+
+file_scope s32 parse_repeat(regex_parser &p) {
+    s32 atom = parse_atom(p);
+
+    while (atom >= 0 && p.P < p.End) {
+        const utf8 *at = p.P;
+
+        s32 min, max;
+        if (*p.P == '*') {
+            min = 0, max = -1, ++p.P;
+        } else if (*p.P == '+') {
+            min = 1, max = -1, ++p.P;
+        } else if (*p.P == '?') {
+            min = 0, max = 1, ++p.P;
+        } else if (*p.P == '{' && parse_braces(p, &min, &max)) {
+            if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) return parse_fail(p, at, "Repeat count is too big");
+            if (max != -1 && max < min) return parse_fail(p, at, "Invalid repeat, the maximum is less than the minimum");
+        } else {
+            break;
+        }
+
+        bool greedy = true;
+        if (p.P < p.End && *p.P == '?') {
+            greedy = false;
+            ++p.P;
+        }
+        atom = parse_add_node(p, {.Kind = NODE_REPEAT, .Greedy = greedy, .Min = min, .Max = max, .First = atom});
+    }
+    return atom;
+}
+
+file_scope s32 parse_concatenation(regex_parser &p) {
+    array<s32> items;
+    defer(free(items));
+
+    while (p.P < p.End && *p.P != '|' && *p.P != ')') {
+        s32 item = parse_repeat(p);
+        if (item < 0) return -1;
+        array_append(items, item);
+    }
+
+    if (items.Count == 0) return parse_add_node(p, {.Kind = NODE_EMPTY});
+    if (items.Count == 1) return items[0];
+    return parse_add_list(p, NODE_CONCAT, items);
+}
+
+file_scope s32 parse_alternation(regex_parser &p) {
+    array<s32> items;
+    defer(free(items));
+
+    while (true) {
+        s32 item = parse_concatenation(p);
+        if (item < 0) return -1;
+        array_append(items, item);
+
+        if (p.P >= p.End || *p.P != '|') break;
+        ++p.P;
+    }
+
+    if (items.Count == 1) return items[0];
+    return parse_add_list(p, NODE_ALT, items);
+}
+
+//
+// Compiling. We emit instructions back to front: compile(node, next) returns the instruction which matches
+// _node_ and then continues at _next_. For the backwards program concatenations (and UTF-8 sequences) are reversed.
+//
+
+struct regex_compiler {
+    regex_parser *Parse;
+    array<regex_inst> *Out;
+    bool Reverse;
+    bool TooBig;
+};
+
+file_scope s32 emit(regex_compiler &c, regex_inst inst) {
+    if (c.Out->Count >= REGEX_MAX_PROGRAM) {
+        c.TooBig = true;
+        return 0;
+    }
+    array_append(*c.Out, inst);
+    return (s32) c.Out->Count - 1;
+}
+
+file_scope s32 emit_split(regex_compiler &c, s32 first, s32 second) { return emit(c, {.Op = REGEX_OP_SPLIT, .Out = first, .Out1 = second}); }
+
+// A sequence of byte ranges, what a range of code points with the same UTF-8 length and prefix becomes
+struct regex_utf8_sequence {
+    u8 Count;
+    u8 Lo[4], Hi[4];
+};
+
+// Splits [lo, hi] into sequences of byte ranges (from utf8-ranges by Russ Cox, the way RE2 and Go compile classes)
+file_scope void utf8_sequences(array<regex_utf8_sequence> &out, u32 lo, u32 hi) {
+    constexpr u32 MAX_OF_LENGTH[] = {0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
+
+    // Split by the length of the encoding
+    For(range(3)) {
+        u32 m = MAX_OF_LENGTH[it];
+        if (lo <= m && m < hi) {
+            utf8_sequences(out, lo, m);
+            utf8_sequences(out, m + 1, hi);
+            return;
+        }
+    }
+
+    // Split until every byte position is a range of its own
+    For(range(1, 4)) {
+        u32 m = (1u << (6 * it)) - 1;
+        if ((lo & ~m) != (hi & ~m)) {
+            if ((lo & m) != 0) {
+                utf8_sequences(out, lo, lo | m);
+                utf8_sequences(out, (lo | m) + 1, hi);
+                return;
+            }
+            if ((hi & m) != m) {
+                utf8_sequences(out, lo, (hi & ~m) - 1);
+                utf8_sequences(out, hi & ~m, hi);
+                return;
+            }
+        }
+    }
+
+    utf8 a[4], b[4];
+    encode_cp(a, lo);
+    encode_cp(b, hi);
+
+    regex_utf8_sequence seq;
+    seq.Count = (u8) get_size_of_cp(lo);
+    For(range(seq.Count)) seq.Lo[it] = (u8) a[it], seq.Hi[it] = (u8) b[it];
+    array_append(out, seq);
+}
+
+file_scope s32 compile_class(regex_compiler &c, const regex_node &node, s32 next) {
+    array<regex_utf8_sequence> sequences;
+    defer(free(sequences));
+
+    For(range(node.First, node.First + node.Count)) {
+        regex_range r = c.Parse->Ranges[it];
+        utf8_sequences(sequences, r.Lo, r.Hi);
+    }
+
+    // An empty class (e.g. [^\x00-\x{10FFFF}]) never matches
+    if (!sequences.Count) return emit(c, {.Op = REGEX_OP_RANGE, .Lo = 1, .Hi = 0, .Out = next});
+
+    s32 result = -1;
+    for (s64 i = sequences.Count - 1; i >= 0; --i) {
+        const regex_utf8_sequence &seq = sequences[i];
+
+        s32 t = next;
+        For(range(seq.Count)) {
+            s64 k = c.Reverse ? it : seq.Count - 1 - it;
+            t     = emit(c, {.Op = REGEX_OP_RANGE, .Lo = seq.Lo[k], .Hi = seq.Hi[k], .Out = t});
+        }
+        result = result == -1 ? t : emit_split(c, t, result);
+    }
+    return result;
+}
+
+file_scope s32 compile(regex_compiler &c, s32 index, s32 next) {
+    if (c.TooBig) return 0;
+
+    regex_node node = c.Parse->Nodes[index];
+    switch (node.Kind) {
+        case NODE_EMPTY:
+            return next;
+        case NODE_BEGIN:
+            return emit(c, {.Op = c.Reverse ? REGEX_OP_END : REGEX_OP_BEGIN, .Out = next});
+        case NODE_END:
+            return emit(c, {.Op = c.Reverse ? REGEX_OP_BEGIN : REGEX_OP_END, .Out = next});
+        case NODE_CLASS:
+            return compile_class(c, node, next);
+        case NODE_CONCAT: {
+            For(range(node.Count)) {
+                s64 k = c.Reverse ? it : node.Count - 1 - it;
+                next  = compile(c, c.Parse->Kids[node.First + k], next);
+            }
+            return next;
+        }
+        case NODE_ALT: {
+            s32 result = compile(c, c.Parse->Kids[node.First + node.Count - 1], next);
+            for (s64 i = node.Count - 2; i >= 0; --i) {
+                result = emit_split(c, compile(c, c.Parse->Kids[node.First + i], next), result);
+            }
+            return result;
+        }
+        case NODE_REPEAT: {
+            s32 t = next;
+            if (node.Max == -1) {
+                // x*, the body loops back to the split
+                s32 loop = emit_split(c, -1, -1);
+                s32 body = compile(c, node.First, loop);
+                if (c.TooBig) return 0;
+
+                (*c.Out)[loop].Out  = node.Greedy ? body : next;
+                (*c.Out)[loop].Out1 = node.Greedy ? next : body;
+                t = loop;
+            } else {
+                // x{0,2} is (x(x)?)?, built from the end
+                For(range(node.Max - node.Min)) {
+                    s32 body = compile(c, node.First, t);
+                    t        = node.Greedy ? emit_split(c, body, next) : emit_split(c, next, body);
+                }
+            }
+            For(range(node.Min)) t = compile(c, node.First, t);
+            return t;
+        }
+    }
+    return next;
+}
+
+// The literal bytes every match begins with
+file_scope void find_prefix(regex_parser &p, s32 root, array<byte> &prefix) {
+    const regex_node &node = p.Nodes[root];
+
+    s32 first = node.Kind == NODE_CONCAT ? node.First : -1;
+    s32 count = node.Kind == NODE_CONCAT ? node.Count : 1;
+    For(range(count)) {
+        const regex_node &n = first == -1 ? node : p.Nodes[p.Kids[first + it]];
+        if (n.Kind != NODE_CLASS || n.Count != 1) break;
+
+        regex_range r = p.Ranges[n.First];
+        if (r.Lo != r.Hi) break;
+
+        utf8 encoded[4];
+        encode_cp(encoded, r.Lo);
+        For_as(k, range(get_size_of_cp(r.Lo))) array_append(prefix, (byte) encoded[k]);
+    }
+}
+
+// The literal prefixes of the branches, if the pattern is an alternation (maybe followed by more) whose branches
+// all begin with literals. Empty otherwise.
+file_scope void find_branch_prefixes(regex_parser &p, s32 root, array<array<byte>> &prefixes) {
+    const regex_node *node = &p.Nodes[root];
+    if (node->Kind == NODE_CONCAT) node = &p.Nodes[p.Kids[node->First]];
+    if (node->Kind != NODE_ALT) return;
+
+    For(range(node->Count)) {
+        array<byte> prefix;
+        find_prefix(p, p.Kids[node->First + it], prefix);
+        array_append(prefixes, prefix);
+
+        if (!prefix.Count) {
+            For_as(b, prefixes) free(b);
+            array_reset(prefixes);
+            return;
+        }
+    }
+}
+
+//
+// The lazy DFA
+//
+
+struct sparse_set {
+    s32 *Dense, *Sparse;
+    s32 Count;
+};
+
+file_scope bool sparse_set_insert(sparse_set &s, s32 value) {
+    s32 i = s.Sparse[value];
+    if (i < s.Count && s.Dense[i] == value) return false;
+    s.Sparse[value]   = s.Count;
+    s.Dense[s.Count++] = value;
+    return true;
+}
+
+file_scope sparse_set dfa_set(regex_dfa &d, s32 which) {
+    s32 *base = d.Scratch + which * 2 * d.ProgramCount;
+    return {base, base + d.ProgramCount, 0};
+}
+
+file_scope s32 *dfa_stack(regex_dfa &d) { return d.Scratch + 4 * d.ProgramCount; }
+file_scope s32 *dfa_list(regex_dfa &d) { return d.Scratch + 6 * d.ProgramCount + 1; }
+
+// Appends the threads reachable from _pc_ to _list_, in priority order. Returns true if a thread matched
+// and we _cut_ the lower priority ones.
+file_scope bool dfa_closure(regex_dfa &d, sparse_set &set, s32 *list, s32 &count, s32 pc, u32 flags, bool cut) {
+    s32 *stack = dfa_stack(d);
+    s32 top    = 0;
+
+    stack[top++] = pc;
+    while (top) {
+        pc = stack[--top];
+        if (!sparse_set_insert(set, pc)) continue;
+
+        const regex_inst &inst = d.Program[pc];
+        switch (inst.Op) {
+            case REGEX_OP_SPLIT:
+                stack[top++] = inst.Out1;
+                stack[top++] = inst.Out;
+                break;
+            case REGEX_OP_BEGIN:
+                if (flags & AT_BEGIN) stack[top++] = inst.Out;
+                break;
+            case REGEX_OP_END:
+                if (flags & AT_END) {
+                    stack[top++] = inst.Out;
+                } else {
+                    list[count++] = pc;  // Waits for the end of the text (see DFA_MATCH_AT_END)
+                }
+                break;
+            case REGEX_OP_RANGE:
+                list[count++] = pc;
+                break;
+            case REGEX_OP_MATCH:
+                list[count++] = pc;
+                if (cut) return true;
+                break;
+        }
+    }
+    return false;
+}
+
+file_scope u8 dfa_flags(regex_dfa &d, const s32 *list, s32 count) {
+    u8 flags = 0;
+
+    sparse_set set = dfa_set(d, 1);
+    For(range(count)) {
+        const regex_inst &inst = d.Program[list[it]];
+        if (inst.Op == REGEX_OP_MATCH) {
+            flags |= DFA_MATCH | DFA_MATCH_AT_END;
+        } else if (inst.Op == REGEX_OP_END && !(flags & DFA_MATCH_AT_END)) {
+            // Only to see if MATCH is reachable, into the second list after the one we were given
+            s32 *rest = dfa_list(d) + d.ProgramCount;
+            s32 n     = 0;
+            dfa_closure(d, set, rest, n, inst.Out, AT_END, false);
+            For_as(k, range(n)) if (d.Program[rest[k]].Op == REGEX_OP_MATCH) flags |= DFA_MATCH_AT_END;
+        }
+    }
+
+    if (d.PrefilterCount == count && equal_memory(d.PrefilterList, list, count * sizeof(s32))) flags |= DFA_PREFILTER;
+    return flags;
+}
+
+file_scope void dfa_reset(regex_dfa &d) {
+    zero_memory(d.Slots, d.SlotCount * sizeof(s32));
+
+    // The dead state, with no threads, stays dead
+    d.StateCount   = 1;
+    d.ListsUsed    = 0;
+    d.ListBegin[0] = d.ListBegin[1] = 0;
+    d.Flags[0]     = 0;
+    For(range(d.Stride)) d.Next[it] = 0;
+
+    For(d.Starts) it = -1;
+}
+
+// Finds or adds the state with this list
+file_scope s32 dfa_add(regex_dfa &d, const s32 *list, s32 count) {
+    if (!count) return 0;
+
+    u64 mask = (u64) d.SlotCount - 1;
+    u64 slot = hash_bytes(list, count * sizeof(s32)) & mask;
+    while (d.Slots[slot]) {
+        s32 s = d.Slots[slot] - 1;
+        if (d.ListBegin[s + 1] - d.ListBegin[s] == count && equal_memory(d.Lists + d.ListBegin[s], list, count * sizeof(s32))) return s;
+        slot = (slot + 1) & mask;
+    }
+
+    if (d.StateCount == d.StateCap || d.ListsUsed + count > d.ListsCap) {
+        // Start over, the list isn't in the cache so it survives
+        dfa_reset(d);
+        ++d.Resets;
+        return dfa_add(d, list, count);
+    }
+
+    s32 s = d.StateCount++;
+    copy_memory(d.Lists + d.ListsUsed, list, count * sizeof(s32));
+    d.ListsUsed += count;
+    d.ListBegin[s + 1] = (s32) d.ListsUsed;
+
+    fill_memory(d.Next + (s64) s * d.Stride, (char) 0xFF, d.Stride * sizeof(s32));  // -1
+    d.Flags[s] = dfa_flags(d, list, count);
+
+    d.Slots[slot] = s + 1;
+    return s;
+}
+
+// The state the DFA moves to from _s_ on bytes of class _cls_
+file_scope s32 dfa_transition(const regex &re, regex_dfa &d, s32 s, s32 cls) {
+    u8 b = re.ClassByte[cls];
+
+    sparse_set set = dfa_set(d, 0);
+    s32 *list      = dfa_list(d);
+    s32 count      = 0;
+
+    For(range(d.ListBegin[s], d.ListBegin[s + 1])) {
+        const regex_inst &inst = d.Program[d.Lists[it]];
+        if (inst.Op == REGEX_OP_RANGE && b >= inst.Lo && b <= inst.Hi) {
+            if (dfa_closure(d, set, list, count, inst.Out, 0, d.Cut)) break;
+        }
+    }
+
+    // Without cutting the order doesn't matter, sorting makes equal sets the same state
+    if (!d.Cut) sort(list, list + count);
+
+    s64 resets = d.Resets;
+    s32 next   = dfa_add(d, list, count);
+    if (d.Resets == resets) d.Next[(s64) s * d.Stride + cls] = next;
+    return next;
+}
+
+file_scope s32 dfa_start(regex_dfa &d, bool anchored, bool atBegin) {
+    s32 &start = d.Starts[(anchored ? 2 : 0) + (atBegin ? 1 : 0)];
+    if (start >= 0) return start;
+
+    sparse_set set = dfa_set(d, 0);
+    s32 *list      = dfa_list(d);
+    s32 count      = 0;
+    dfa_closure(d, set, list, count, anchored ? d.AnchoredPc : d.UnanchoredPc, atBegin ? AT_BEGIN : 0, d.Cut);
+    if (!d.Cut) sort(list, list + count);
+
+    s32 s = dfa_add(d, list, count);  // May reset the cache (and all starts)
+    d.Starts[(anchored ? 2 : 0) + (atBegin ? 1 : 0)] = s;
+    return s;
+}
+
+// Runs forwards from _from_. Returns where the last match ended (or the first if _earliest_), -1 if there was none.
+file_scope s64 dfa_search_forward(const regex &re, regex_dfa &d, const byte *data, s64 count, s64 from, bool anchored, bool earliest) {
+    s32 s = dfa_start(d, anchored, from == 0);
+    u8 f  = d.Flags[s];
+
+    s64 last = -1;
+    if (f & DFA_MATCH) {
+        last = from;
+        if (earliest) return last;
+    }
+
+    s64 p = from;
+    while (p < count) {
+        if (f & DFA_PREFILTER) {
+            // Nothing has started, no match begins before the next place the prefix is
+            if (re.Prefix.Count) {
+                s64 offset = internal::utf8_find_substring_simd((const utf8 *) data + p, count - p, (const utf8 *) re.Prefix.Data, re.Prefix.Count);
+                if (offset == -1) return last;
+                p += offset;
+            } else {
+                multi_pattern_match m = multi_pattern_find(re.Prefixes, bytes((byte *) data, count), p);
+                if (!m) return last;
+                p = m.Begin;
+            }
+        }
+
+        s32 cls  = re.ByteClass[data[p]];
+        s32 next = d.Next[(s64) s * d.Stride + cls];
+        if (next < 0) next = dfa_transition(re, d, s, cls);
+
+        s = next;
+        ++p;
+        if (!s) return last;
+
+        f = d.Flags[s];
+        if (f & DFA_MATCH) {
+            last = p;
+            if (earliest) return last;
+        }
+    }
+
+    if (f & DFA_MATCH_AT_END) last = count;
+    return last;
+}
+
+// Runs the reverse program backwards from _end_ down to _from_. Returns where the longest match begins, -1 if there is none.
+file_scope s64 dfa_search_backward(const regex &re, regex_dfa &d, const byte *data, s64 count, s64 from, s64 end) {
+    s32 s = dfa_start(d, true, end == count);
+    u8 f  = d.Flags[s];
+
+    s64 last = f & DFA_MATCH ? end : -1;
+
+    s64 p = end;
+    while (p > from) {
+        s32 cls  = re.ByteClass[data[p - 1]];
+        s32 next = d.Next[(s64) s * d.Stride + cls];
+        if (next < 0) next = dfa_transition(re, d, s, cls);
+
+        s = next;
+        --p;
+        if (!s) return last;
+
+        f = d.Flags[s];
+        if (f & DFA_MATCH) last = p;
+    }
+
+    if (p == 0 && (f & DFA_MATCH_AT_END)) last = 0;
+    return last;
+}
+
+// Carves the memory of a DFA out of _memory_ at _offset_, returns the new offset. With null _memory_ it only measures.
+file_scope s64 dfa_layout(regex_dfa &d, const array<regex_inst> &program, s32 stride, s64 cacheSize, byte *memory, s64 offset) {
+    s64 programCount = program.Count;
+
+    // Transitions, flags, list offset, two hash slots and a guess of 8 NFA states in the list
+    s64 perState = stride * sizeof(s32) + 1 + sizeof(s32) + 2 * sizeof(s32) + 8 * sizeof(s32);
+    s64 stateCap = clamp(cacheSize / perState, (s64) 16, (s64) 1 << 24);
+    s64 listsCap = stateCap * 8 + 2 * programCount;  // Any one list fits after a reset
+    s64 slots    = ceil_pow_of_2(2 * stateCap);
+
+    auto take = [&](s64 size) {
+        byte *result = memory ? memory + offset : null;
+        offset += (size + 7) & ~7;
+        return result;
+    };
+
+    d.Next          = (s32 *) take(stateCap * stride * sizeof(s32));
+    d.Flags         = (u8 *) take(stateCap);
+    d.ListBegin     = (s32 *) take((stateCap + 1) * sizeof(s32));
+    d.Lists         = (s32 *) take(listsCap * sizeof(s32));
+    d.Slots         = (s32 *) take(slots * sizeof(s32));
+    d.PrefilterList = (s32 *) take(programCount * sizeof(s32));
+    d.Scratch       = (s32 *) take((8 * programCount + 1) * sizeof(s32));  // Two sets, the stack, two lists
+
+    d.Program      = program.Data;
+    d.ProgramCount = (s32) programCount;
+    d.Stride       = stride;
+    d.StateCap     = (s32) stateCap;
+    d.ListsCap     = listsCap;
+    d.SlotCount    = slots;
+    return offset;
+}
+
+file_scope void dfa_init(regex_dfa &d, s32 anchoredPc, s32 unanchoredPc, bool cut) {
+    d.AnchoredPc   = anchoredPc;
+    d.UnanchoredPc = unanchoredPc;
+    d.Cut          = cut;
+
+    // The sparse sets don't need to be cleared, but their memory must be initialized for the checks
+    zero_memory(d.Scratch, 4 * d.ProgramCount * sizeof(s32));
+
+    dfa_reset(d);
+    d.Resets = 0;
+}
+
+file_scope bool regex_build(regex &re, regex_parser &p, s32 root) {
+    regex_compiler forward = {&p, &re.Program, false, false};
+    s32 match              = emit(forward, {.Op = REGEX_OP_MATCH});
+    re.Start               = compile(forward, root, match);
+
+    // .*? in front, the lowest priority thread, which starts the match one byte later
+    re.UnanchoredStart = emit_split(forward, re.Start, -1);
+    s32 any            = emit(forward, {.Op = REGEX_OP_RANGE, .Lo = 0, .Hi = 255, .Out = re.UnanchoredStart});
+    if (!forward.TooBig) re.Program[re.UnanchoredStart].Out1 = any;
+
+    regex_compiler backward = {&p, &re.Reverse, true, false};
+    match                   = emit(backward, {.Op = REGEX_OP_MATCH});
+    re.ReverseStart         = compile(backward, root, match);
+
+    if (forward.TooBig || backward.TooBig) return false;
+
+    // Byte classes: a new class begins at every byte where some range begins or ends
+    bool boundary[257] = {};
+    For(re.Program) {
+        if (it.Op == REGEX_OP_RANGE && it.Lo <= it.Hi) boundary[it.Lo] = boundary[it.Hi + 1] = true;
+    }
+    re.ClassCount = 0;
+    For(range(256)) {
+        if (it && boundary[it]) ++re.ClassCount;
+        if (it == 0 || boundary[it]) re.ClassByte[re.ClassCount] = (u8) it;
+        re.ByteClass[it] = (u8) re.ClassCount;
+    }
+    ++re.ClassCount;
+
+    find_prefix(p, root, re.Prefix);
+    if (!re.Prefix.Count) {
+        array<array<byte>> prefixes;
+        defer({
+            For(prefixes) free(it);
+            free(prefixes);
+        });
+        find_branch_prefixes(p, root, prefixes);
+
+        if (prefixes.Count) {
+            array<string> literals;
+            defer(free(literals));
+            For(prefixes) array_append(literals, string((const utf8 *) it.Data, it.Count));
+            multi_pattern_compile(re.Prefixes, literals);
+        }
+    }
+
+    s64 size = 0;
+    size     = dfa_layout(re.Find, re.Program, re.ClassCount, re.Options.CacheSize, null, size);
+    size     = dfa_layout(re.Whole, re.Program, re.ClassCount, re.Options.CacheSize, null, size);
+    size     = dfa_layout(re.Backwards, re.Reverse, re.ClassCount, re.Options.CacheSize, null, size);
+
+    re.Cache = allocate_array<byte>(size);
+
+    s64 offset = 0;
+    offset     = dfa_layout(re.Find, re.Program, re.ClassCount, re.Options.CacheSize, (byte *) re.Cache, offset);
+    offset     = dfa_layout(re.Whole, re.Program, re.ClassCount, re.Options.CacheSize, (byte *) re.Cache, offset);
+    offset     = dfa_layout(re.Backwards, re.Reverse, re.ClassCount, re.Options.CacheSize, (byte *) re.Cache, offset);
+
+    dfa_init(re.Find, re.Start, re.UnanchoredStart, true);
+    dfa_init(re.Whole, re.Start, -1, false);
+    dfa_init(re.Backwards, re.ReverseStart, -1, false);
+
+    if (re.Prefix.Count || re.Prefixes.Patterns.Count) {
+        sparse_set set = dfa_set(re.Find, 0);
+        s32 count      = 0;
+        dfa_closure(re.Find, set, re.Find.PrefilterList, count, re.UnanchoredStart, 0, true);
+        re.Find.PrefilterCount = count;
+    }
+    return true;
+}
+
+bool regex_compile(regex &re, const string &pattern, regex_options options, allocator alloc) {
+    free(re);
+    re.Options = options;
+
+    regex_parser p;
+    p.Begin = p.P     = pattern.Data;
+    p.End             = pattern.Data + pattern.Count;
+    p.CaseInsensitive = options.CaseInsensitive;
+    defer({
+        free(p.Nodes);
+        free(p.Kids);
+        free(p.Ranges);
+    });
+
+    s32 root = parse_alternation(p);
+    if (root >= 0 && p.P != p.End) parse_fail(p, p.P, "Unmatched )");  // The only thing which stops the top level
+
+    if (p.ErrorOffset != -1) {
+        re.Error       = p.Error;
+        re.ErrorOffset = p.ErrorOffset;
+        return false;
+    }
+
+    bool built = false;
+    PUSH_ALLOC(alloc ? alloc : Context.Alloc) {
+        built = regex_build(re, p, root);
+        if (built) clone(&re.Pattern, pattern);
+    }
+
+    if (!built) {
+        free(re);
+        re.Error       = "Pattern is too big";
+        re.ErrorOffset = 0;
+    }
+    return built;
+}
+
+void free(regex &re) {
+    free(re.Pattern);
+    free(re.Program);
+    free(re.Reverse);
+    free(re.Prefix);
+    free(re.Prefixes);
+    if (re.Cache) free(re.Cache);
+    re = {};
+}
+
+regex *clone(regex *dest, const regex &src) {
+    regex_compile(*dest, src.Pattern, src.Options);
+    return dest;
+}
+
+bool regex_matches(regex &re, const string &text) {
+    if (!re.Cache) return false;
+    return dfa_search_forward(re, re.Whole, (const byte *) text.Data, text.Count, 0, true, false) == text.Count;
+}
+
+bool regex_search(regex &re, const string &text) {
+    if (!re.Cache) return false;
+    return dfa_search_forward(re, re.Find, (const byte *) text.Data, text.Count, 0, false, true) != -1;
+}
+
+regex_match regex_find(regex &re, const string &text, s64 start) {
+    if (!re.Cache || start < 0 || start > text.Count) return {};
+
+    auto *data = (const byte *) text.Data;
+
+    s64 end = dfa_search_forward(re, re.Find, data, text.Count, start, false, false);
+    if (end == -1) return {};
+
+    // No match begins before the leftmost one, so the longest match backwards from its end begins where it begins
+    s64 begin = dfa_search_backward(re, re.Backwards, data, text.Count, start, end);
+    assert(begin != -1);
+    return {begin, end};
+}
+
+s64 regex_find_all(regex &re, const string &text, array<regex_match> out) {
+    s64 found = 0, start = 0;
+    while (found < out.Count && start <= text.Count) {
+        regex_match m = regex_find(re, text, start);
+        if (!m) break;
+        out[found++] = m;
+
+        // After an empty match skip a code point, so we don't find it again
+        start = m.End;
+        if (m.End == m.Begin) start += m.End < text.Count ? max<s64>(get_size_of_cp(text.Data + m.End), 1) : 1;
+    }
+    return found;
+}
+
+LSTD_END_NAMESPACE
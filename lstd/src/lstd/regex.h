@@ -0,0 +1,154 @@
+#pragma once
+
+#include "memory/array.h"
+#include "memory/string.h"
+#include "multi_pattern.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Regular expressions which are matched in linear time (the approach of RE2): the pattern is compiled to a
+// Thompson NFA over bytes and searched with a DFA which is built lazily - a DFA state (a set of NFA states) is
+// only made when the search first reaches it, and the transitions are cached, so most bytes cost one table lookup.
+// There is no backtracking, so no pattern makes a search slower than (text size * pattern size).
+//
+//     regex re;
+//     if (!regex_compile(re, "ERROR .*timed? out")) { ... re.Error at re.ErrorOffset ... }
+//     defer(free(re));
+//
+//     if (regex_search(re, line)) { ... }                  // Anywhere in the line
+//     regex_match m = regex_find(re, text);                // m.Begin, m.End are byte offsets, -1 if there's no match
+//
+//     regex_match matches[64];
+//     s64 n = regex_find_all(re, text, array<regex_match>(matches, 64));
+//
+// Matching doesn't allocate: the DFA states live in a cache which is allocated when compiling (see _CacheSize_).
+// When it fills up it's cleared and the search goes on, patterns with a huge number of states just get slower.
+// Because of the cache a regex can't be used by two threads at the same time - clone it for each thread.
+//
+// If the pattern begins with a literal (e.g. "ERROR", not "[Ee]rror") the search jumps between the places where
+// the literal is with the SIMD find_substring (see string.cpp) and only runs the DFA from there. An alternation
+// whose branches all begin with literals (e.g. "ERROR|FATAL|panic: .*") jumps between them with a multi_pattern.
+//
+// Syntax:
+//     x  xy  x|y  (x)  (?:x)          Literals, concatenation, alternation, groups (they don't capture)
+//     x*  x+  x?  x{n}  x{n,}  x{n,m}  Repeats, greedy. With a ? after them (x*?) they are lazy
+//     .                                Any code point except \n
+//     [abc]  [a-z]  [^a-z]             Classes of code points (in UTF-8)
+//     \d \w \s  \D \W \S               ASCII digits, word characters and white space, and their complements
+//     \n \r \t \f \v \xHH \x{HHHH}     Escapes, \ before any punctuation makes it a literal
+//     ^  $                             The beginning and the end of the text (there's no multi-line mode)
+//
+// Matches are leftmost-first like in Perl and RE2: of the matches which start leftmost, it's the one which the
+// first alternative and the greedy/lazy choices prefer. Word boundaries, backreferences and lookaround aren't
+// supported (they don't fit a DFA).
+//
+
+struct regex_options {
+    bool CaseInsensitive = false;  // For ASCII letters
+
+    // Bytes for the states of each of the three DFAs (finding matches, whole-text matches, and the backwards
+    // search for where a match begins), allocated when compiling
+    s64 CacheSize = 256 * 1024;
+};
+
+struct regex_match {
+    s64 Begin = -1, End = -1;  // Byte offsets, the match is [Begin, End)
+
+    operator bool() const { return Begin != -1; }
+};
+
+// An instruction of the compiled program
+struct regex_inst {
+    u8 Op;
+    u8 Lo, Hi;  // For REGEX_OP_RANGE, the bytes it accepts
+    s32 Out;
+    s32 Out1;  // For REGEX_OP_SPLIT, the lower priority branch
+};
+
+enum regex_op : u8 {
+    REGEX_OP_RANGE = 0,
+    REGEX_OP_SPLIT,
+    REGEX_OP_MATCH,
+    REGEX_OP_BEGIN,  // Asserts we are at the beginning of the text (the end when running backwards)
+    REGEX_OP_END,
+};
+
+// A lazily built DFA. The memory is one block (see regex.cpp): the transitions, flags and NFA state lists of the
+// cached states, a hash table to find states by their list, and scratch space for building new ones.
+struct regex_dfa {
+    const regex_inst *Program = null;
+    s32 ProgramCount = 0;
+    s32 AnchoredPc = 0, UnanchoredPc = -1;
+
+    // Stop adding lower priority threads when one matches, so the search ends where the leftmost-first match ends.
+    // The other two DFAs keep every thread, they look for the longest match.
+    bool Cut = false;
+
+    s32 Stride = 0;         // The number of byte classes
+    s32 *Next = null;       // Stride entries for every state, -1 if we haven't been there yet. State 0 is dead.
+    u8 *Flags = null;       // See regex.cpp
+    s32 *Lists = null;      // The NFA states of every state, back to back
+    s32 *ListBegin = null;  // Where the list of each state begins in _Lists_ (and one more entry for the end)
+    s32 *Slots = null;      // The hash table, state index + 1, 0 if empty
+
+    s32 StateCount = 0, StateCap = 0;
+    s64 ListsUsed = 0, ListsCap = 0;
+    s64 SlotCount = 0;
+
+    s32 Starts[4] = {-1, -1, -1, -1};  // [anchored][at the beginning of the text], -1 if not made yet
+
+    // The list of the unanchored start state in the middle of the text, where the search may skip to the next
+    // place the literal prefix is. -1 if there's no prefix.
+    s32 *PrefilterList = null;
+    s32 PrefilterCount = -1;
+
+    s32 *Scratch = null;  // Two sparse sets, a stack and a list
+
+    s64 Resets = 0;  // How many times the cache filled up
+};
+
+struct regex {
+    string Pattern;  // A copy, for clone()
+    regex_options Options;
+
+    array<regex_inst> Program;  // Forwards. The unanchored program starts with .*? at _UnanchoredStart_.
+    array<regex_inst> Reverse;  // For matching backwards, from the end of a match to its beginning
+    s32 Start = 0, UnanchoredStart = 0, ReverseStart = 0;
+
+    // Bytes which no instruction tells apart share a class, the DFA has a transition per class
+    u8 ByteClass[256];
+    u8 ClassByte[256];  // A byte of every class
+    s32 ClassCount = 0;
+
+    array<byte> Prefix;     // Every match begins with these bytes
+    multi_pattern Prefixes;  // Or with one of these, if _Prefix_ is empty and the pattern is an alternation of literals
+
+    regex_dfa Find, Whole, Backwards;
+    void *Cache = null;
+
+    // When the pattern is invalid
+    string Error;
+    s64 ErrorOffset = -1;
+};
+
+// Returns false if the pattern is invalid (then _Error_ and _ErrorOffset_ are set and nothing is allocated).
+// Frees the old contents of _re_.
+bool regex_compile(regex &re, const string &pattern, regex_options options = {}, allocator alloc = {});
+
+void free(regex &re);
+regex *clone(regex *dest, const regex &src);
+
+// The whole text matches
+bool regex_matches(regex &re, const string &text);
+
+// There is a match somewhere in the text. Faster than regex_find(), it stops at the first place a match ends.
+bool regex_search(regex &re, const string &text);
+
+// The leftmost match which begins at byte _start_ or later
+regex_match regex_find(regex &re, const string &text, s64 start = 0);
+
+// Fills _out_ with the matches which don't overlap, from the left. Returns how many were found (at most out.Count).
+s64 regex_find_all(regex &re, const string &text, array<regex_match> out);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,430 @@
+#pragma once
+
+#include "io/writer.h"
+#include "memory/array.h"
+#include "memory/hash_table.h"
+#include "memory/string.h"
+#include "varint.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A compact binary format for snapshots of plain data and the library's containers.
+//
+//     binary_writer w = {&fileWriter};
+//     binary_write(w, header);     // A trivially copyable struct, written as it is in memory
+//     binary_write(w, entities);   // array<entity>, one copy_memory for all of them
+//     binary_write(w, names);      // hash_table<string, s32>
+//
+//     path_mapped_view view = path_map_view(mapping);
+//     binary_reader r = {view.Content};
+//     binary_read(r, &header);
+//     binary_read(r, &entities);   // A view into the mapped file, nothing is copied
+//     binary_read(r, &names);      // The table is allocated, its string keys point into the file
+//     if (r.Failed) { ... corrupted or truncated ... }
+//
+// What's written:
+// - Trivially copyable types (see binary_pod): the bytes of the object.
+// - Strings: the size in bytes and the length in code points (as varints), then the bytes.
+// - array<T>: the count (a varint), then each element. If T is a binary_pod the elements are one run of bytes,
+//   padded so it starts at a multiple of alignof(T) from the beginning of the output.
+// - hash_table<K, V>: the count, then the hash, the key and the value of every entry. Loading doesn't rehash the keys.
+// - Varints (binary_write_varint, binary_write_signed for zigzagged s64) and StreamVByte runs of u32
+//   (binary_write_streamvbyte) are written only when asked for, see varint.h.
+//
+// Reading is zero-copy: arrays of PODs and strings read as views into the data (Allocated == 0, so free() on them
+// does nothing), which stay valid as long as the data does - e.g. a mapped file (see path_map_view) or a buffer
+// loaded with path_read_entire_file. For the views to line up the data must begin at an address aligned
+// like the most aligned element type (mapped views begin at a page), otherwise those arrays are copied. Set _Copy_
+// for arrays and strings with their own memory (when the data is freed after loading).
+//
+// Like bloom_filter's serialization the bytes are as they are in memory, so the format is only portable between
+// machines with the same endianness and type layouts. There's no versioning - put a magic number and a version
+// at the beginning of your snapshot.
+//
+// Other types: overload binary_write() and binary_read() for them (found with ADL, so next to the type is fine).
+// Careful with structs which hold pointers or containers - they are trivially copyable too (we don't use destructors),
+// so without an overload the pointers get written, not what they point to.
+//
+//     void binary_write(binary_writer &w, const mesh &m) {
+//         binary_write(w, m.Name);
+//         binary_write(w, m.Vertices);
+//     }
+//
+//     bool binary_read(binary_reader &r, mesh *m) { return binary_read(r, &m->Name) && binary_read(r, &m->Vertices); }
+//
+struct binary_writer {
+    writer *Out = null;
+    s64 Offset = 0;  // How many bytes were written, runs of PODs are aligned relative to this
+};
+
+struct binary_reader {
+    bytes Data;
+    s64 Offset = 0;
+
+    // Arrays and strings get their own memory instead of pointing into _Data_
+    bool Copy = false;
+
+    // For hash tables, copies and arrays of non-POD elements, Context.Alloc by default.
+    // Nothing is freed when reading fails half-way, an arena is the easiest way to clean up after a snapshot.
+    allocator Alloc;
+
+    bool Failed = false;  // The data ended too early or a count didn't make sense. Reads after this don't do anything.
+};
+
+// Written as their bytes. Pointers and the library's containers are excluded, see the comment at the top.
+template <typename T>
+concept binary_pod = types::is_trivially_copyable<T> && !types::is_pointer<T> && !is_array<T> && !any_hash_table<T>;
+
+//
+// Writing
+//
+
+inline void binary_write_bytes(binary_writer &w, const void *data, s64 size) {
+    w.Out->write((const byte *) data, size);
+    w.Offset += size;
+}
+
+// LEB128, 7 bits per byte, small counts take one byte (see varint.h)
+inline void binary_write_varint(binary_writer &w, u64 value) {
+    byte buffer[VARINT_MAX_SIZE];
+    binary_write_bytes(w, buffer, varint_encode(buffer, value));
+}
+
+// Zigzag and then a varint, small negative values take one byte too
+inline void binary_write_signed(binary_writer &w, s64 value) { binary_write_varint(w, zigzag_encode(value)); }
+
+// The count (a varint) and the values as StreamVByte blocks, usually much smaller than the raw u32 run
+// which binary_write(array<u32>) writes, for ids and offsets which are mostly small. See write_streamvbyte().
+inline void binary_write_streamvbyte(binary_writer &w, const u32 *values, s64 count) {
+    w.Offset += write_streamvbyte(w.Out, values, count);
+}
+
+inline void binary_write_padding(binary_writer &w, s64 alignment) {
+    byte zeros[64] = {};
+
+    s64 padding = -w.Offset & (alignment - 1);
+    while (padding) {
+        s64 n = min<s64>(padding, sizeof(zeros));
+        binary_write_bytes(w, zeros, n);
+        padding -= n;
+    }
+}
+
+template <binary_pod T>
+void binary_write(binary_writer &w, const T &value) {
+    binary_write_bytes(w, &value, sizeof(T));
+}
+
+inline void binary_write(binary_writer &w, const string &s) {
+    binary_write_varint(w, s.Count);
+    binary_write_varint(w, s.Length);
+    binary_write_bytes(w, s.Data, s.Count);
+}
+
+template <typename T>
+void binary_write(binary_writer &w, const array<T> &arr) {
+    binary_write_varint(w, arr.Count);
+    if constexpr (binary_pod<T>) {
+        if (!arr.Count) return;
+        binary_write_padding(w, alignof(T));
+        binary_write_bytes(w, arr.Data, arr.Count * sizeof(T));
+    } else {
+        For(arr) binary_write(w, it);
+    }
+}
+
+template <typename K, typename V, bool BlockAlloc, typename Hash, typename Equal>
+void binary_write(binary_writer &w, const hash_table<K, V, BlockAlloc, Hash, Equal> &table) {
+    binary_write_varint(w, table.Count);
+    For(range(table.Allocated)) {
+        if (table.Hashes[it] < table.FIRST_VALID_HASH) continue;
+        binary_write(w, table.Hashes[it]);
+        binary_write(w, table.Keys[it]);
+        binary_write(w, table.Values[it]);
+    }
+}
+
+//
+// Reading. Each of these returns false (and sets _Failed_) if the data is invalid.
+//
+
+// Returns the next _size_ bytes of the data and skips them, null if there aren't that many left
+inline const byte *binary_take(binary_reader &r, s64 size) {
+    if (r.Failed || size < 0 || size > r.Data.Count - r.Offset) {
+        r.Failed = true;
+        return null;
+    }
+
+    const byte *result = r.Data.Data + r.Offset;
+    r.Offset += size;
+    return result;
+}
+
+inline bool binary_read_bytes(binary_reader &r, void *dest, s64 size) {
+    const byte *p = binary_take(r, size);
+    if (!p) return false;
+    copy_memory(dest, p, size);
+    return true;
+}
+
+inline u64 binary_read_varint(binary_reader &r) {
+    if (r.Failed) return 0;
+
+    u64 result;
+    s64 size = varint_decode(r.Data.Data + r.Offset, r.Data.Count - r.Offset, &result);
+    if (!size) {
+        r.Failed = true;  // Cut short or too long for a u64
+        return 0;
+    }
+    r.Offset += size;
+    return result;
+}
+
+inline s64 binary_read_signed(binary_reader &r) { return zigzag_decode(binary_read_varint(r)); }
+
+// A varint which counts things that take at least _minSize_ bytes each in the rest of the data
+inline s64 binary_read_count(binary_reader &r, s64 minSize) {
+    u64 count = binary_read_varint(r);
+    if (r.Failed) return 0;
+
+    if (count > (u64) (r.Data.Count - r.Offset) / (u64) minSize) {
+        r.Failed = true;
+        return 0;
+    }
+    return (s64) count;
+}
+
+inline bool binary_skip_padding(binary_reader &r, s64 alignment) {
+    return binary_take(r, -r.Offset & (alignment - 1)) != null;
+}
+
+template <binary_pod T>
+bool binary_read(binary_reader &r, T *out) {
+    return binary_read_bytes(r, out, sizeof(T));
+}
+
+inline bool binary_read(binary_reader &r, string *out) {
+    s64 count  = binary_read_count(r, 1);
+    s64 length = (s64) binary_read_varint(r);
+    if (length > count) r.Failed = true;
+
+    const byte *p = binary_take(r, count);
+    if (!p) return false;
+
+    free(*out);
+    if (r.Copy && count) {
+        PUSH_ALLOC(r.Alloc ? r.Alloc : Context.Alloc) {
+            array_reserve_exact(*out, count);
+        }
+        copy_memory(out->Data, p, count);
+    } else {
+        out->Data = (utf8 *) p;
+    }
+    out->Count  = count;
+    out->Length = length;
+    return true;
+}
+
+template <typename T>
+bool binary_read(binary_reader &r, array<T> *out) {
+    if constexpr (binary_pod<T>) {
+        s64 count = binary_read_count(r, sizeof(T));
+        if (r.Failed) return false;
+
+        free(*out);
+        if (!count) return true;
+
+        if (!binary_skip_padding(r, alignof(T))) return false;
+
+        const byte *p = binary_take(r, count * sizeof(T));
+        if (!p) return false;
+
+        if (!r.Copy && (u64) p % alignof(T) == 0) {
+            *out = array<T>((T *) p, count);
+        } else {
+            PUSH_ALLOC(r.Alloc ? r.Alloc : Context.Alloc) {
+                array_reserve_exact(*out, count);
+            }
+            copy_memory(out->Data, p, count * sizeof(T));
+            out->Count = count;
+        }
+        return true;
+    } else {
+        s64 count = binary_read_count(r, 1);
+        if (r.Failed) return false;
+
+        free(*out);
+        if (!count) return true;
+
+        PUSH_ALLOC(r.Alloc ? r.Alloc : Context.Alloc) {
+            array_reserve_exact(*out, count);
+        }
+        For(range(count)) {
+            T *element = new (out->Data + it) T();
+            if (!binary_read(r, element)) return false;
+            ++out->Count;
+        }
+        return true;
+    }
+}
+
+template <typename K, typename V, bool BlockAlloc, typename Hash, typename Equal>
+bool binary_read(binary_reader &r, hash_table<K, V, BlockAlloc, Hash, Equal> *out) {
+    s64 count = binary_read_count(r, sizeof(u64) + 1);
+    if (r.Failed) return false;
+
+    free(*out);
+    if (!count) return true;
+
+    // Big enough that adding doesn't grow the table (it grows when it's half full)
+    PUSH_ALLOC(r.Alloc ? r.Alloc : Context.Alloc) {
+        reserve(*out, 2 * count);
+    }
+
+    For(range(count)) {
+        u64 hash;
+        K key   = K();
+        V value = V();
+        if (!binary_read(r, &hash) || !binary_read(r, &key) || !binary_read(r, &value)) return false;
+        add_prehashed(*out, hash, key, value);
+    }
+    return true;
+}
+
+// Reads what binary_write_streamvbyte() wrote. The values are always decoded into memory from _Alloc_.
+inline bool binary_read_streamvbyte(binary_reader &r, array<u32> *out) {
+    s64 count = binary_read_count(r, 1);  // At least a data byte per value
+    if (r.Failed) return false;
+
+    free(*out);
+    if (!count) return true;
+
+    PUSH_ALLOC(r.Alloc ? r.Alloc : Context.Alloc) {
+        array_reserve_exact(*out, count);
+    }
+
+    for (s64 first = 0; first < count; first += STREAMVBYTE_BLOCK) {
+        s64 n    = min(STREAMVBYTE_BLOCK, count - first);
+        s64 size = streamvbyte_decode(out->Data + first, r.Data.Data + r.Offset, r.Data.Count - r.Offset, n);
+        if (size < 0) {
+            r.Failed = true;
+            return false;
+        }
+        r.Offset += size;
+        out->Count += n;
+    }
+    return true;
+}
+
+//
+// Images of hash tables which are used in place.
+//
+// Reading a big table back with binary_read() still means adding every entry. An image is the table's own arrays -
+// the hashes, the keys and the values of every slot - after a small header, with offsets from the beginning instead
+// of pointers. hash_table_image_open() just points a table at the arrays, so a mapped image can be queried with
+// find() and find_prehashed() right away and only the pages which lookups touch get read from the disk:
+//
+//     hash_table_image_write(&fileWriter, table);
+//
+//     path_mapping mapping = path_open_mapping("ids.table");
+//     path_mapped_view view = path_map_view(mapping);
+//
+//     hash_table<u64, entity_id> ids;
+//     if (!hash_table_image_open(&ids, view.Content)) { ... not an image of that type ... }
+//     auto [key, value] = find(ids, 42);
+//
+// The keys and values must be binary_pods (no strings, they would point outside the image) and the table's _Hash_
+// must give the same hash as when the image was written (our hashes are fixed, a custom one shouldn't be seeded).
+// The arrays begin at multiples of 64 bytes, so the data must be at least as aligned as K and V (mapped views are).
+//
+// The opened table doesn't own the memory: don't add to it, remove from it or free() it - unmap the view when done.
+// The slots which are empty are written as they are in memory.
+//
+
+namespace internal {
+constexpr u64 HASH_TABLE_IMAGE_MAGIC = 0x4C42544853544C31ull;  // "1LTSHTBL"
+constexpr s64 HASH_TABLE_IMAGE_ALIGNMENT = 64;
+
+struct hash_table_image_header {
+    u64 Magic;
+    u32 KeySize, ValueSize;
+    u32 KeyAlignment, ValueAlignment;
+    s64 Count, Allocated;
+    s64 HashesOffset, KeysOffset, ValuesOffset;  // From the beginning of the image
+    s64 Size;                                    // Of the whole image
+};
+
+// Where the arrays go for a table with _allocated_ slots
+template <typename K, typename V>
+constexpr hash_table_image_header hash_table_image_layout(s64 count, s64 allocated) {
+    auto align = [](s64 offset) { return (offset + HASH_TABLE_IMAGE_ALIGNMENT - 1) & ~(HASH_TABLE_IMAGE_ALIGNMENT - 1); };
+
+    hash_table_image_header h = {HASH_TABLE_IMAGE_MAGIC, sizeof(K), sizeof(V), alignof(K), alignof(V), count, allocated};
+    h.HashesOffset = align(sizeof(hash_table_image_header));
+    h.KeysOffset   = align(h.HashesOffset + allocated * (s64) sizeof(u64));
+    h.ValuesOffset = align(h.KeysOffset + allocated * (s64) sizeof(K));
+    h.Size         = h.ValuesOffset + allocated * (s64) sizeof(V);
+    return h;
+}
+}  // namespace internal
+
+// The size of the image hash_table_image_write() writes
+template <binary_pod K, binary_pod V, bool BlockAlloc, typename Hash, typename Equal>
+s64 hash_table_image_size(const hash_table<K, V, BlockAlloc, Hash, Equal> &table) {
+    return internal::hash_table_image_layout<K, V>(table.Count, table.Allocated).Size;
+}
+
+// Writes the header and the three arrays, each with one call to _w_.
+template <binary_pod K, binary_pod V, bool BlockAlloc, typename Hash, typename Equal>
+void hash_table_image_write(writer *w, const hash_table<K, V, BlockAlloc, Hash, Equal> &table) {
+    auto header = internal::hash_table_image_layout<K, V>(table.Count, table.Allocated);
+
+    binary_writer b = {w};
+    binary_write(b, header);
+
+    binary_write_padding(b, internal::HASH_TABLE_IMAGE_ALIGNMENT);
+    binary_write_bytes(b, table.Hashes, table.Allocated * sizeof(u64));
+    binary_write_padding(b, internal::HASH_TABLE_IMAGE_ALIGNMENT);
+    binary_write_bytes(b, table.Keys, table.Allocated * sizeof(K));
+    binary_write_padding(b, internal::HASH_TABLE_IMAGE_ALIGNMENT);
+    binary_write_bytes(b, table.Values, table.Allocated * sizeof(V));
+
+    assert(b.Offset == header.Size);
+}
+
+// Points _dest_ at the arrays in _image_ (nothing is copied, see the comment above).
+// Returns false if _image_ isn't an image of a table with these K and V, or it's not aligned enough.
+template <binary_pod K, binary_pod V, typename Hash, typename Equal>
+bool hash_table_image_open(hash_table<K, V, true, Hash, Equal> *dest, const bytes &image) {
+    internal::hash_table_image_header header;
+    if (image.Count < (s64) sizeof(header)) return false;
+    copy_memory(&header, image.Data, sizeof(header));
+
+    if (header.Magic != internal::HASH_TABLE_IMAGE_MAGIC) return false;
+    if (header.KeySize != sizeof(K) || header.ValueSize != sizeof(V)) return false;
+    if (header.KeyAlignment != alignof(K) || header.ValueAlignment != alignof(V)) return false;
+
+    // A power of 2 (find masks the hash with it) which isn't so big that the offsets overflow
+    if (header.Allocated < 0 || header.Allocated > (1ll << 40) || (header.Allocated & (header.Allocated - 1))) return false;
+    if (header.Count < 0 || header.Count > header.Allocated / 2) return false;
+
+    auto expected = internal::hash_table_image_layout<K, V>(header.Count, header.Allocated);
+    if (header.HashesOffset != expected.HashesOffset || header.KeysOffset != expected.KeysOffset) return false;
+    if (header.ValuesOffset != expected.ValuesOffset || header.Size != expected.Size || image.Count < header.Size) return false;
+
+    if ((u64) image.Data % max<s64>(max<s64>(alignof(K), alignof(V)), alignof(u64))) return false;
+
+    *dest = {};
+    if (!header.Allocated) return true;
+
+    dest->Count       = header.Count;
+    dest->SlotsFilled = header.Count;
+    dest->Allocated   = header.Allocated;
+    dest->Hashes      = (u64 *) (image.Data + header.HashesOffset);
+    dest->Keys        = (K *) (image.Data + header.KeysOffset);
+    dest->Values      = (V *) (image.Data + header.ValuesOffset);
+    return true;
+}
+
+LSTD_END_NAMESPACE
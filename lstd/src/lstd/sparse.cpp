@@ -0,0 +1,371 @@
+#include "sparse.h"
+
+#include "job_system.h"
+#include "memory/sort.h"
+#include "memory/sorted_search.h"
+#include "profiler.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // AVX2 and FMA intrinsics
+
+#if COMPILER == MSVC
+#define TARGET_AVX2_FMA
+#else
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+// Products with fewer nonzeros run on the calling thread, spawning jobs costs more than that
+file_scope constexpr s64 SPARSE_PARALLEL_NONZEROS = 1 << 16;
+
+// The vector operations of CG work on chunks of this many elements. Sums add up the chunks in order,
+// so they don't depend on which job got which chunk.
+file_scope constexpr s64 SPARSE_VECTOR_CHUNK = 16384;
+
+void sparse_mat_build(sparse_mat &m, s64 rows, s64 cols, const sparse_triplet *triplets, s64 count, allocator alloc) {
+    PROFILE_ZONE("sparse_mat_build");
+
+    assert(rows >= 0 && cols >= 0 && rows < S32_MAX && cols < S32_MAX);
+    free(m);
+
+    m.R = rows;
+    m.C = cols;
+    m.RowStart = allocate_array<s64>(rows + 1, {.Alloc = alloc});
+    zero_memory(m.RowStart, (rows + 1) * sizeof(s64));
+    if (!count) return;
+
+    // (row, column) in one key, so sorting the keys orders by row and then by column
+    auto *keys = allocate_array_uninitialized<u64>(count);
+    auto *values = allocate_array_uninitialized<f64>(count);
+    defer({
+        free(keys);
+        free(values);
+    });
+
+    For(range(count)) {
+        const sparse_triplet &t = triplets[it];
+        assert(t.Row >= 0 && t.Row < rows && t.Col >= 0 && t.Col < cols && "Triplet is out of range");
+
+        keys[it] = (u64) t.Row << 32 | (u64) t.Col;
+        values[it] = t.Value;
+    }
+
+    array<u64> keysView(keys, count);
+    array<f64> valuesView(values, count);
+    sort_by_key(keysView, valuesView);
+
+    // Ones which repeat are next to each other now
+    s64 nonZeros = 0;
+    For(range(count)) {
+        if (nonZeros && keys[nonZeros - 1] == keys[it]) {
+            values[nonZeros - 1] += values[it];
+        } else {
+            keys[nonZeros] = keys[it];
+            values[nonZeros] = values[it];
+            ++nonZeros;
+        }
+    }
+
+    m.NonZeros = nonZeros;
+    m.Cols = allocate_array_uninitialized<s32>(nonZeros, {.Alloc = alloc});
+    m.Values = allocate_array_uninitialized<f64>(nonZeros, {.Alloc = alloc});
+
+    For(range(nonZeros)) {
+        ++m.RowStart[(keys[it] >> 32) + 1];
+        m.Cols[it] = (s32) (keys[it] & 0xFFFFFFFF);
+        m.Values[it] = values[it];
+    }
+    For(range(rows)) m.RowStart[it + 1] += m.RowStart[it];
+}
+
+void free(sparse_mat &m) {
+    if (m.RowStart) free(m.RowStart);
+    if (m.Cols) free(m.Cols);
+    if (m.Values) free(m.Values);
+    m.RowStart = null;
+    m.Cols = null;
+    m.Values = null;
+    m.R = m.C = m.NonZeros = 0;
+}
+
+sparse_mat *clone(sparse_mat *dest, const sparse_mat &src) {
+    free(*dest);
+
+    dest->R = src.R;
+    dest->C = src.C;
+    dest->NonZeros = src.NonZeros;
+    if (src.RowStart) {
+        dest->RowStart = allocate_array_uninitialized<s64>(src.R + 1);
+        copy_elements(dest->RowStart, src.RowStart, src.R + 1);
+    }
+    if (src.NonZeros) {
+        dest->Cols = allocate_array_uninitialized<s32>(src.NonZeros);
+        dest->Values = allocate_array_uninitialized<f64>(src.NonZeros);
+        copy_elements(dest->Cols, src.Cols, src.NonZeros);
+        copy_elements(dest->Values, src.Values, src.NonZeros);
+    }
+    return dest;
+}
+
+f64 sparse_get(const sparse_mat &m, s64 i, s64 j) {
+    assert(i >= 0 && i < m.R && j >= 0 && j < m.C);
+
+    s64 start = m.RowStart[i];
+    s64 k = binary_search(array<s32>(m.Cols + start, m.RowStart[i + 1] - start), (s32) j);
+    return k == -1 ? 0 : m.Values[start + k];
+}
+
+// A counting sort by column. Going through the rows in order keeps the columns of _out_ increasing.
+void sparse_transpose(sparse_mat *out, const sparse_mat &m) {
+    assert(out != &m);
+    free(*out);
+
+    out->R = m.C;
+    out->C = m.R;
+    out->NonZeros = m.NonZeros;
+    out->RowStart = allocate_array<s64>(m.C + 1);
+    zero_memory(out->RowStart, (m.C + 1) * sizeof(s64));
+    if (!m.NonZeros) return;
+
+    out->Cols = allocate_array_uninitialized<s32>(m.NonZeros);
+    out->Values = allocate_array_uninitialized<f64>(m.NonZeros);
+
+    For(range(m.NonZeros)) ++out->RowStart[m.Cols[it] + 1];
+    For(range(m.C)) out->RowStart[it + 1] += out->RowStart[it];
+
+    // Where the next element of every row of _out_ goes, starts as a copy of RowStart
+    auto *cursor = allocate_array_uninitialized<s64>(m.C);
+    defer(free(cursor));
+    copy_elements(cursor, out->RowStart, m.C);
+
+    For_as(i, range(m.R)) {
+        For_as(k, range(m.RowStart[i], m.RowStart[i + 1])) {
+            s64 at = cursor[m.Cols[k]]++;
+            out->Cols[at] = (s32) i;
+            out->Values[at] = m.Values[k];
+        }
+    }
+}
+
+void sparse_to_dense(dense_mat *out, const sparse_mat &m, s64 row, s64 col, s64 rows, s64 cols) {
+    if (rows == -1) rows = m.R - row;
+    if (cols == -1) cols = m.C - col;
+    assert(row >= 0 && col >= 0 && rows >= 0 && cols >= 0 && row + rows <= m.R && col + cols <= m.C);
+
+    dense_mat_init(*out, rows, cols);
+    For_as(i, range(rows)) {
+        s64 start = m.RowStart[row + i], end = m.RowStart[row + i + 1];
+
+        f64 *r = out->row(i);
+        for (s64 k = start + lower_bound(array<s32>(m.Cols + start, end - start), (s32) col); k < end && m.Cols[k] < col + cols; ++k) {
+            r[m.Cols[k] - col] = m.Values[k];
+        }
+    }
+}
+
+//
+// The product: out[i] = sum of Values[k] * v[Cols[k]] over row i, for rows [begin, end)
+//
+using sparse_spmv_func = void (*)(f64 *out, const sparse_mat &m, const f64 *v, s64 begin, s64 end);
+
+file_scope void sparse_spmv_baseline(f64 *out, const sparse_mat &m, const f64 *v, s64 begin, s64 end) {
+    For_as(i, range(begin, end)) {
+        s64 k = m.RowStart[i], rowEnd = m.RowStart[i + 1];
+
+        // Two sums so a multiply-add doesn't wait for the one before it
+        f64 s0 = 0, s1 = 0;
+        for (; k + 2 <= rowEnd; k += 2) {
+            s0 += m.Values[k] * v[m.Cols[k]];
+            s1 += m.Values[k + 1] * v[m.Cols[k + 1]];
+        }
+        if (k < rowEnd) s0 += m.Values[k] * v[m.Cols[k]];
+        out[i] = s0 + s1;
+    }
+}
+
+#if ARCH == X86
+// Four nonzeros at a time, the elements of _v_ are gathered with the column indices
+TARGET_AVX2_FMA file_scope void sparse_spmv_avx2(f64 *out, const sparse_mat &m, const f64 *v, s64 begin, s64 end) {
+    For_as(i, range(begin, end)) {
+        s64 k = m.RowStart[i], rowEnd = m.RowStart[i + 1];
+
+        __m256d sum = _mm256_setzero_pd();
+        for (; k + 4 <= rowEnd; k += 4) {
+            __m128i cols = _mm_loadu_si128((const __m128i *) (m.Cols + k));
+            sum = _mm256_fmadd_pd(_mm256_loadu_pd(m.Values + k), _mm256_i32gather_pd(v, cols, 8), sum);
+        }
+
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        f64 total = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for (; k < rowEnd; ++k) total += m.Values[k] * v[m.Cols[k]];
+        out[i] = total;
+    }
+}
+#endif
+
+void dot(f64 *out, const sparse_mat &m, const f64 *v, sparse_options options) {
+    assert(out != v);
+
+    local_persist cpu_dispatch<sparse_spmv_func> kernel;
+    auto func = cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> sparse_spmv_func {
+#if ARCH == X86
+        return cpu.AVX2 && cpu.FMA ? sparse_spmv_avx2 : sparse_spmv_baseline;
+#else
+        return sparse_spmv_baseline;
+#endif
+    });
+
+    s64 workers = job_system_worker_count();
+    if (!options.Parallel || workers <= 0 || m.NonZeros < SPARSE_PARALLEL_NONZEROS || m.R < 2) {
+        func(out, m, v, 0, m.R);
+        return;
+    }
+
+    // Piece p starts at the first row which starts at or after p / pieces of the nonzeros
+    s64 pieces = min(m.R, workers * 4);
+    array<s64> rowStart(m.RowStart, m.R + 1);
+
+    auto piece = [&](s64 begin, s64 end) {
+        For(range(begin, end)) {
+            s64 first = lower_bound(rowStart, m.NonZeros * it / pieces);
+            s64 last = it + 1 == pieces ? m.R : lower_bound(rowStart, m.NonZeros * (it + 1) / pieces);
+            func(out, m, v, min(first, m.R), min(last, m.R));
+        }
+    };
+    job_parallel_for(pieces, 1, &piece);
+}
+
+//
+// Conjugate gradients, with the diagonal as the preconditioner M (or none, then M = I):
+//
+//     r = b - Ax, z = inverse(M) * r, p = z
+//     repeat:
+//         alpha = r'z / p'Ap
+//         x += alpha * p, r -= alpha * Ap
+//         z = inverse(M) * r
+//         p = z + (new r'z / old r'z) * p
+//
+// The vector updates which go over the same elements are done in one pass, together with the sums they need.
+//
+
+// Calls _body(chunk, begin, end)_ for chunks of SPARSE_VECTOR_CHUNK elements of [0, n)
+template <typename Body>
+file_scope void sparse_for_chunks(s64 n, bool parallel, Body &&body) {
+    s64 chunks = (n + SPARSE_VECTOR_CHUNK - 1) / SPARSE_VECTOR_CHUNK;
+
+    auto piece = [&](s64 begin, s64 end) {
+        For(range(begin, end)) body(it, it * SPARSE_VECTOR_CHUNK, min(n, (it + 1) * SPARSE_VECTOR_CHUNK));
+    };
+
+    if (parallel && chunks > 1 && job_system_worker_count() > 0) {
+        job_parallel_for(chunks, 1, &piece);
+    } else {
+        piece(0, chunks);
+    }
+}
+
+file_scope f64 sparse_sum(const f64 *partials, s64 count) {
+    f64 sum = 0;
+    For(range(count)) sum += partials[it];
+    return sum;
+}
+
+sparse_cg_result sparse_cg_solve(const sparse_mat &a, const f64 *b, f64 *x, sparse_cg_options options) {
+    PROFILE_ZONE("sparse_cg_solve");
+
+    assert(a.R == a.C);
+
+    s64 n = a.R;
+    if (!n) return {0, 0, true};
+
+    s64 maxIterations = options.MaxIterations > 0 ? options.MaxIterations : n;
+    sparse_options spmv = {.Parallel = options.Parallel};
+
+    s64 chunks = (n + SPARSE_VECTOR_CHUNK - 1) / SPARSE_VECTOR_CHUNK;
+
+    f64 *memory = allocate_array_uninitialized<f64>(5 * n + 3 * chunks);
+    defer(free(memory));
+
+    f64 *r = memory, *z = r + n, *p = z + n, *ap = p + n, *invDiagonal = ap + n;
+    f64 *partials = invDiagonal + n;  // Three sums per chunk
+
+    dot(ap, a, x, spmv);
+
+    // r = b - Ax, z = p = inverse(M) * r, with r'z, r'r and b'b
+    sparse_for_chunks(n, options.Parallel, [&](s64 c, s64 begin, s64 end) {
+        f64 rz = 0, rr = 0, bb = 0;
+        For(range(begin, end)) {
+            f64 d = options.Jacobi ? sparse_get(a, it, it) : 0;
+            invDiagonal[it] = d > 0 ? 1 / d : 1;
+
+            r[it] = b[it] - ap[it];
+            z[it] = p[it] = invDiagonal[it] * r[it];
+
+            rz += r[it] * z[it];
+            rr += r[it] * r[it];
+            bb += b[it] * b[it];
+        }
+        partials[c] = rz;
+        partials[chunks + c] = rr;
+        partials[2 * chunks + c] = bb;
+    });
+
+    f64 rz = sparse_sum(partials, chunks);
+    f64 bNorm = ::sqrt(sparse_sum(partials + 2 * chunks, chunks));
+    if (bNorm == 0) {
+        // The solution of Ax = 0 is 0
+        zero_memory(x, n * sizeof(f64));
+        return {0, 0, true};
+    }
+
+    sparse_cg_result result = {0, ::sqrt(sparse_sum(partials + chunks, chunks)) / bNorm, false};
+    result.Converged = result.Residual <= options.Tolerance;
+
+    while (!result.Converged && result.Iterations < maxIterations) {
+        dot(ap, a, p, spmv);
+
+        sparse_for_chunks(n, options.Parallel, [&](s64 c, s64 begin, s64 end) {
+            f64 pap = 0;
+            For(range(begin, end)) pap += p[it] * ap[it];
+            partials[c] = pap;
+        });
+
+        // Only happens if A isn't positive definite (or the residual is already 0)
+        f64 pap = sparse_sum(partials, chunks);
+        if (!(pap > 0)) break;
+
+        f64 alpha = rz / pap;
+        sparse_for_chunks(n, options.Parallel, [&](s64 c, s64 begin, s64 end) {
+            f64 rzNew = 0, rr = 0;
+            For(range(begin, end)) {
+                x[it] += alpha * p[it];
+                r[it] -= alpha * ap[it];
+                z[it] = invDiagonal[it] * r[it];
+
+                rzNew += r[it] * z[it];
+                rr += r[it] * r[it];
+            }
+            partials[c] = rzNew;
+            partials[chunks + c] = rr;
+        });
+
+        ++result.Iterations;
+        result.Residual = ::sqrt(sparse_sum(partials + chunks, chunks)) / bNorm;
+        result.Converged = result.Residual <= options.Tolerance;
+
+        f64 rzNew = sparse_sum(partials, chunks);
+        f64 beta = rzNew / rz;
+        rz = rzNew;
+
+        if (!result.Converged) {
+            sparse_for_chunks(n, options.Parallel, [&](s64, s64 begin, s64 end) {
+                For(range(begin, end)) p[it] = z[it] + beta * p[it];
+            });
+        }
+    }
+    return result;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "linalg.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Sparse f64 matrices in compressed sparse row form (CSR), the product with a vector (SpMV) and a conjugate
+// gradient solver, for the big systems finite elements, graphs and simulations produce (mostly zeros, where
+// dense_mat would need R * C elements).
+//
+//     array<sparse_triplet> entries;
+//     ... array_append(entries, {i, j, value});  // In any order, ones which repeat are summed
+//
+//     sparse_mat a;
+//     defer(free(a));
+//     sparse_mat_build(a, n, n, entries);
+//
+//     dot(y, a, x);                               // y = A * x
+//
+//     auto [iterations, residual, converged] = sparse_cg_solve(a, b, x);  // Ax = b for symmetric positive definite A
+//
+// Triplets are sorted with radix_sort() on (row, column) packed in one u64 - two or three passes for most sizes.
+//
+// The product splits the rows into pieces with the same number of nonzeros (not the same number of rows, a few dense
+// rows would leave one job doing all the work) and runs them on the job system when it's running. Every row is summed
+// by one kernel, AVX2 + FMA with gathers from _x_ or the scalar one, picked at runtime with cpu_dispatch_get().
+// Rows don't depend on how they were split, so the result is the same with or without the job system.
+//
+// Column storage (CSC) is the CSR of the transpose, see sparse_transpose().
+// Blocks which have filled in (e.g. a coupled sub-system) can be copied out with sparse_to_dense() and factored with dense_lu.
+//
+
+struct sparse_triplet {
+    s64 Row, Col;
+    f64 Value;
+};
+
+struct sparse_mat {
+    s64 R = 0, C = 0;
+    s64 NonZeros = 0;
+
+    s64 *RowStart = null;  // R + 1 elements, row i is [RowStart[i], RowStart[i + 1]) of _Cols_ and _Values_
+    s32 *Cols = null;      // Increasing in every row
+    f64 *Values = null;
+};
+
+// Builds a _rows_ x _cols_ matrix from triplets in any order, the values of ones with the same row and column are added up.
+// Explicit zeros are kept. Frees the old contents of _m_.
+void sparse_mat_build(sparse_mat &m, s64 rows, s64 cols, const sparse_triplet *triplets, s64 count, allocator alloc = {});
+
+template <is_array_like Arr>
+requires(types::is_same<array_data_t<Arr>, sparse_triplet>) void sparse_mat_build(sparse_mat &m, s64 rows, s64 cols, const Arr &triplets, allocator alloc = {}) {
+    sparse_mat_build(m, rows, cols, triplets.Data, triplets.Count, alloc);
+}
+
+void free(sparse_mat &m);
+sparse_mat *clone(sparse_mat *dest, const sparse_mat &src);
+
+// A(i, j), 0 if it isn't stored
+f64 sparse_get(const sparse_mat &m, s64 i, s64 j);
+
+// out = transpose(m), which is also _m_ stored column after column (CSC). _out_ may not be _m_.
+void sparse_transpose(sparse_mat *out, const sparse_mat &m);
+
+// Copies the _rows_ x _cols_ block at (_row_, _col_) into a dense matrix (resized), e.g. to factor it with dense_lu.
+// -1 means up to the last row (or column).
+void sparse_to_dense(dense_mat *out, const sparse_mat &m, s64 row = 0, s64 col = 0, s64 rows = -1, s64 cols = -1);
+
+struct sparse_options {
+    bool Parallel = true;  // Spread the rows on the job system (if it's running and the matrix is big enough)
+};
+
+// out = m * v, _v_ has m.C elements and _out_ has m.R (and may not be _v_)
+void dot(f64 *out, const sparse_mat &m, const f64 *v, sparse_options options = {});
+
+struct sparse_cg_options {
+    s64 MaxIterations = 0;   // 0 means the size of the system (in exact arithmetic CG is done by then)
+    f64 Tolerance = 1e-10;   // Stops when |b - Ax| <= Tolerance * |b|
+    bool Jacobi = true;      // Precondition with the diagonal, helps a lot when rows are scaled differently
+    bool Parallel = true;
+};
+
+struct sparse_cg_result {
+    s64 Iterations;
+    f64 Residual;  // |b - Ax| / |b| when it stopped
+    bool Converged;
+};
+
+// Solves Ax = b for a symmetric positive definite _a_ with (preconditioned) conjugate gradients.
+// _x_ is the starting guess (zeros are fine) and gets the solution. _b_ and _x_ have a.R elements.
+sparse_cg_result sparse_cg_solve(const sparse_mat &a, const f64 *b, f64 *x, sparse_cg_options options = {});
+
+LSTD_END_NAMESPACE
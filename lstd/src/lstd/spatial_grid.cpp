@@ -0,0 +1,266 @@
+#include "spatial_grid.h"
+
+#include "job_system.h"
+#include "profiler.h"
+
+LSTD_BEGIN_NAMESPACE
+
+// Below this many points the build isn't worth handing out to the job system
+file_scope constexpr s64 SPATIAL_GRID_PARALLEL_THRESHOLD = 16384;
+
+// Cell coordinates are clamped to this, so points far away (or infinite) don't overflow the conversion
+file_scope constexpr f32 SPATIAL_GRID_MAX_COORD = 1e9f;
+
+struct grid_cell {
+    s32 x, y, z;
+};
+
+// floor(v * invCellSize), without going through f64
+file_scope always_inline s32 grid_coord(f32 v, f32 invCellSize) {
+    f32 c = v * invCellSize;
+    if (!(c > -SPATIAL_GRID_MAX_COORD)) c = -SPATIAL_GRID_MAX_COORD;  // Also catches NaN
+    if (c > SPATIAL_GRID_MAX_COORD) c = SPATIAL_GRID_MAX_COORD;
+
+    s32 i = (s32) c;
+    return i - (s32) ((f32) i > c);
+}
+
+file_scope always_inline grid_cell grid_cell_of(const v3 &p, f32 invCellSize) {
+    return {grid_coord(p.x, invCellSize), grid_coord(p.y, invCellSize), grid_coord(p.z, invCellSize)};
+}
+
+file_scope always_inline u32 grid_bucket(s32 x, s32 y, s32 z, u32 mask) {
+    u32 h = ((u32) x * 73856093u) ^ ((u32) y * 19349663u) ^ ((u32) z * 83492791u);
+    h ^= h >> 16;
+    return h & mask;
+}
+
+template <typename Vec>
+file_scope void spatial_grid_build_impl(spatial_grid &grid, const Vec *points, s64 count, f32 cellSize, spatial_grid_build_options options) {
+    PROFILE_ZONE("spatial_grid_build");
+
+    assert(cellSize > 0);
+    assert(count >= 0 && count < (s64) U32_MAX);
+
+    grid.CellSize    = cellSize;
+    grid.InvCellSize = 1.0f / cellSize;
+    grid.Dimensions  = Vec::DIM;
+
+    // At least twice as many buckets as points keeps the chance of two cells sharing a bucket low
+    u32 buckets = 16;
+    while ((s64) buckets < count * 2) buckets <<= 1;
+    grid.BucketMask = buckets - 1;
+
+    grid.BucketStart.Count = 0;
+    array_reserve(grid.BucketStart, buckets + 1);
+    grid.BucketStart.Count = buckets + 1;
+
+    grid.Indices.Count = 0;
+    array_reserve(grid.Indices, count);
+    grid.Indices.Count = count;
+
+    grid.Points.Count = 0;
+    array_reserve(grid.Points, count);
+    grid.Points.Count = count;
+
+    grid.PointBuckets.Count = 0;
+    array_reserve(grid.PointBuckets, count);
+    grid.PointBuckets.Count = count;
+
+    u32 *starts       = grid.BucketStart.Data;
+    u32 *indices      = grid.Indices.Data;
+    v3 *sorted        = grid.Points.Data;
+    u32 *pointBuckets = grid.PointBuckets.Data;
+    f32 invCellSize   = grid.InvCellSize;
+    u32 mask          = grid.BucketMask;
+
+    bool parallel = options.Parallel && job_system_worker_count() > 0 && count >= SPATIAL_GRID_PARALLEL_THRESHOLD;
+    s64 grain     = parallel_grain(count, 0);
+
+    auto position = [&](s64 i) {
+        if constexpr (Vec::DIM == 2) {
+            return v3(points[i].x, points[i].y, 0);
+        } else {
+            return v3(points[i]);
+        }
+    };
+
+    For(range(buckets + 1)) starts[it] = 0;
+
+    //
+    // Counting sort: count the points in each bucket (shifted by one), prefix sum the counts into where each
+    // bucket starts, then scatter the indices - every bucket's cursor moves up to where the next one starts.
+    //
+    auto count_points = [&](s64 begin, s64 end) {
+        For(range(begin, end)) {
+            grid_cell c = grid_cell_of(position(it), invCellSize);
+
+            u32 b            = grid_bucket(c.x, c.y, c.z, mask);
+            pointBuckets[it] = b;
+
+            if (parallel) {
+                atomic_inc(starts + b + 1);
+            } else {
+                ++starts[b + 1];
+            }
+        }
+    };
+
+    auto scatter = [&](s64 begin, s64 end) {
+        For(range(begin, end)) {
+            u32 b = pointBuckets[it];
+
+            u32 slot      = parallel ? atomic_add(starts + b, 1u) : starts[b]++;
+            indices[slot] = (u32) it;
+        }
+    };
+
+    // Pieces scatter in whatever order they run, sort every bucket so the result doesn't depend on that.
+    // Buckets are a point or two on average, insertion sort is the right tool.
+    auto sort_buckets = [&](s64 begin, s64 end) {
+        For_as(b, range(begin, end)) {
+            u32 *first = indices + starts[b], *last = indices + starts[b + 1];
+            for (u32 *i = first + 1; i < last; ++i) {
+                u32 v  = *i;
+                u32 *j = i;
+                for (; j > first && j[-1] > v; --j) *j = j[-1];
+                *j = v;
+            }
+        }
+    };
+
+    auto gather = [&](s64 begin, s64 end) {
+        For(range(begin, end)) sorted[it] = position(indices[it]);
+    };
+
+    if (parallel) {
+        job_parallel_for(count, grain, &count_points);
+    } else {
+        count_points(0, count);
+    }
+
+    For(range(1, buckets + 1)) starts[it] += starts[it - 1];
+
+    if (parallel) {
+        job_parallel_for(count, grain, &scatter);
+    } else {
+        scatter(0, count);
+    }
+
+    // The cursors ended up at the start of the next bucket, shift them back
+    for (s64 b = buckets; b > 0; --b) starts[b] = starts[b - 1];
+    starts[0] = 0;
+
+    if (parallel) {
+        job_parallel_for(buckets, parallel_grain(buckets, 0), &sort_buckets);
+        job_parallel_for(count, grain, &gather);
+    } else {
+        gather(0, count);
+    }
+}
+
+void spatial_grid_build(spatial_grid &grid, const v3 *points, s64 count, f32 cellSize, spatial_grid_build_options options) {
+    spatial_grid_build_impl(grid, points, count, cellSize, options);
+}
+
+void spatial_grid_build(spatial_grid &grid, const v2 *points, s64 count, f32 cellSize, spatial_grid_build_options options) {
+    spatial_grid_build_impl(grid, points, count, cellSize, options);
+}
+
+//
+// Queries
+//
+
+// Calls _visit(sortedIndex, distanceSquared)_ for every point within _radius_ of _center_
+template <typename Visit>
+file_scope void spatial_grid_visit(const spatial_grid &grid, const v3 &center, f32 radius, Visit &&visit) {
+    if (!grid.Points.Count || !(radius >= 0)) return;
+
+    f32 r2          = radius * radius;
+    f32 invCellSize = grid.InvCellSize;
+
+    auto test = [&](s64 i) {
+        const v3 &p = grid.Points.Data[i];
+
+        f32 dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+        f32 d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 <= r2) visit(i, d2);
+    };
+
+    grid_cell lo = grid_cell_of(v3(center.x - radius, center.y - radius, center.z - radius), invCellSize);
+    grid_cell hi = grid_cell_of(v3(center.x + radius, center.y + radius, center.z + radius), invCellSize);
+    if (grid.Dimensions == 2) lo.z = hi.z = 0;
+
+    // When the query covers more cells than there are buckets it's cheaper to look at every point
+    f64 cells = ((f64) hi.x - lo.x + 1) * ((f64) hi.y - lo.y + 1) * ((f64) hi.z - lo.z + 1);
+    if (cells > (f64) grid.BucketMask + 1) {
+        For(range(grid.Points.Count)) test(it);
+        return;
+    }
+
+    const u32 *starts = grid.BucketStart.Data;
+    for (s32 z = lo.z; z <= hi.z; ++z) {
+        for (s32 y = lo.y; y <= hi.y; ++y) {
+            for (s32 x = lo.x; x <= hi.x; ++x) {
+                u32 b = grid_bucket(x, y, z, grid.BucketMask);
+                For(range(starts[b], starts[b + 1])) {
+                    const v3 &p = grid.Points.Data[it];
+
+                    // The bucket may hold points of other cells which hash to it. Those which are in range get
+                    // reported when we visit their own cell, skip them here so nothing is reported twice.
+                    grid_cell c = grid_cell_of(p, invCellSize);
+                    if (c.x != x || c.y != y || c.z != z) continue;
+
+                    test(it);
+                }
+            }
+        }
+    }
+}
+
+void spatial_grid_for_each(const spatial_grid &grid, const v3 &center, f32 radius, const delegate<void(u32 index, f32 distanceSquared)> &f) {
+    spatial_grid_visit(grid, center, radius, [&](s64 i, f32 d2) { f(grid.Indices[i], d2); });
+}
+
+void spatial_grid_for_each(const spatial_grid &grid, const v2 &center, f32 radius, const delegate<void(u32 index, f32 distanceSquared)> &f) {
+    spatial_grid_for_each(grid, v3(center.x, center.y, 0), radius, f);
+}
+
+s64 spatial_grid_query_radius(const spatial_grid &grid, const v3 &center, f32 radius, array<u32> &out) {
+    s64 before = out.Count;
+    spatial_grid_visit(grid, center, radius, [&](s64 i, f32) { array_append(out, grid.Indices[i]); });
+    return out.Count - before;
+}
+
+s64 spatial_grid_query_radius(const spatial_grid &grid, const v2 &center, f32 radius, array<u32> &out) {
+    return spatial_grid_query_radius(grid, v3(center.x, center.y, 0), radius, out);
+}
+
+s64 spatial_grid_nearest(const spatial_grid &grid, const v3 &center, f32 maxRadius) {
+    s64 best     = -1;
+    f32 bestDist = 0;
+    spatial_grid_visit(grid, center, maxRadius, [&](s64 i, f32 d2) {
+        s64 index = grid.Indices[i];
+
+        // Ties go to the smaller index, so the answer doesn't depend on the bucket layout
+        if (best == -1 || d2 < bestDist || (d2 == bestDist && index < best)) {
+            best     = index;
+            bestDist = d2;
+        }
+    });
+    return best;
+}
+
+s64 spatial_grid_nearest(const spatial_grid &grid, const v2 &center, f32 maxRadius) {
+    return spatial_grid_nearest(grid, v3(center.x, center.y, 0), maxRadius);
+}
+
+void free(spatial_grid &grid) {
+    free(grid.BucketStart);
+    free(grid.Indices);
+    free(grid.Points);
+    free(grid.PointBuckets);
+    grid.BucketMask = 0;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "math/vec.h"
+#include "memory/array.h"
+#include "memory/delegate.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A uniform grid over points for neighbor queries, for things which move every frame (particles, crowds).
+// Cheaper to rebuild than a bvh (see bvh.h) - a counting sort, two passes over the points - and as good
+// when the points are spread out evenly.
+//
+//     spatial_grid grid;
+//     defer(free(grid));
+//
+//     // Every tick
+//     spatial_grid_build(grid, positions.Data, positions.Count, interactionRadius);
+//
+//     array<u32> near;
+//     spatial_grid_query_radius(grid, positions[i], interactionRadius, near);  // Includes _i_ itself
+//
+// Space is split into cubes (squares in 2D) of _cellSize_ and every cell is hashed into one of a power of two
+// buckets (at least twice as many as there are points), so the grid has no bounds and the memory depends only
+// on the number of points. The points are counting-sorted by bucket: a bucket is a range of _Indices_ and
+// _Points_ holds the positions in the same order, so a query reads them sequentially instead of jumping
+// around the caller's array. Cells which land in the same bucket are told apart when querying.
+//
+// A radius close to the cell size is the sweet spot: a query looks at 27 cells (9 in 2D). A much bigger radius
+// visits many cells, a much smaller one checks many points which are too far.
+//
+// Big builds run on the job system when it's running (see job_system.h). The result is the same either way:
+// within a bucket the points are in the order of their indices.
+//
+// The buffers are kept between builds, rebuilding every frame doesn't allocate once they are big enough.
+// Queries don't write to the grid, so threads can query one grid at the same time.
+//
+
+struct spatial_grid {
+    f32 CellSize = 1, InvCellSize = 1;
+    s64 Dimensions = 3;  // 2 if it was built over v2 (_Points_ have z = 0 then)
+
+    u32 BucketMask = 0;      // The number of buckets - 1
+    array<u32> BucketStart;  // Bucket b holds _Indices_[BucketStart[b] .. BucketStart[b + 1]]
+    array<u32> Indices;      // Of the points, grouped by bucket
+    array<v3> Points;        // Their positions, in the same order as _Indices_
+
+    array<u32> PointBuckets;  // Of every point in the original order, used while building
+};
+
+struct spatial_grid_build_options {
+    bool Parallel = true;  // Build on the job system (if it's running and there are enough points)
+};
+
+// Builds (or rebuilds) the grid over _count_ points. _cellSize_ must be > 0.
+void spatial_grid_build(spatial_grid &grid, const v3 *points, s64 count, f32 cellSize, spatial_grid_build_options options = {});
+void spatial_grid_build(spatial_grid &grid, const v2 *points, s64 count, f32 cellSize, spatial_grid_build_options options = {});
+
+// Calls _f(index, distanceSquared)_ for every point within _radius_ of _center_ (inclusive), in no particular order
+void spatial_grid_for_each(const spatial_grid &grid, const v3 &center, f32 radius, const delegate<void(u32 index, f32 distanceSquared)> &f);
+void spatial_grid_for_each(const spatial_grid &grid, const v2 &center, f32 radius, const delegate<void(u32 index, f32 distanceSquared)> &f);
+
+// Appends the indices of the points within _radius_ of _center_ to _out_, returns how many were appended
+s64 spatial_grid_query_radius(const spatial_grid &grid, const v3 &center, f32 radius, array<u32> &out);
+s64 spatial_grid_query_radius(const spatial_grid &grid, const v2 &center, f32 radius, array<u32> &out);
+
+// The index of the closest point within _maxRadius_ of _center_, -1 if there is none
+s64 spatial_grid_nearest(const spatial_grid &grid, const v3 &center, f32 maxRadius);
+s64 spatial_grid_nearest(const spatial_grid &grid, const v2 &center, f32 maxRadius);
+
+void free(spatial_grid &grid);
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,122 @@
+#include "task.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+void internal::task_resume(void *address) { std::coroutine_handle<>::from_address(address).resume(); }
+
+//
+// Timers for task_sleep: a timer wheel and a thread which advances it. While there are timers the thread checks
+// every millisecond (10 if the nearest is far away), when there are none it sleeps on a condition variable.
+// The callbacks resume the coroutines as jobs.
+//
+struct task_timer_state {
+    s32 Running = 0;  // 0 - not started, 1 - starting, 2 - running
+    s32 Stop    = 0;
+
+    thread::mutex Mutex;
+    thread::condition_variable Condition;
+    timer_wheel Wheel;
+
+    thread::thread Thread;
+};
+
+file_scope task_timer_state TaskTimers;
+
+file_scope void task_timers_thread(void *) {
+    auto &s = TaskTimers;
+
+    while (true) {
+        {
+            thread::scoped_lock _(&s.Mutex);
+            while (!atomic_load(&s.Wheel.Count) && !atomic_load(&s.Stop)) s.Condition.wait(&s.Mutex);
+        }
+
+        // With no job system running the coroutines continue right here and may sleep again
+        if (atomic_load(&s.Stop)) {
+            timer_wheel_expire_all(s.Wheel);
+            break;
+        }
+        timer_wheel_advance(s.Wheel);
+
+        s64 wait = timer_wheel_time_until_next(s.Wheel);
+        if (wait > 0) thread::sleep(wait > 20000000 ? 10 : 1);
+    }
+}
+
+file_scope void task_sleep_done(timer *t) { job_run(internal::task_resume, t->UserData); }
+
+void task_sleep_awaiter::await_suspend(std::coroutine_handle<> h) {
+    auto &s = TaskTimers;
+
+    if (atomic_load(&s.Running) != 2) {
+        if (atomic_compare_and_swap(&s.Running, 1, 0) == 0) {
+            s.Mutex.init();
+            s.Condition.init();
+            timer_wheel_init(s.Wheel);
+            atomic_store(&s.Stop, 0);
+            s.Thread.init_and_launch(task_timers_thread, null);
+            atomic_store(&s.Running, 2);
+        }
+        while (atomic_load(&s.Running) != 2) thread::sleep(0);
+    }
+
+    Timer.Callback = task_sleep_done;
+    Timer.UserData = h.address();
+
+    // The timer may fire and resume us (freeing this awaiter) before timer_add returns, don't touch members after it
+    s64 delay = (s64) Ms * 1000000;
+    timer_add(s.Wheel, &Timer, delay);
+
+    thread::scoped_lock _(&s.Mutex);
+    s.Condition.notify_one();
+}
+
+void task_timers_stop() {
+    auto &s = TaskTimers;
+    if (atomic_load(&s.Running) != 2) return;
+
+    {
+        thread::scoped_lock _(&s.Mutex);
+        atomic_store(&s.Stop, 1);
+        s.Condition.notify_one();
+    }
+    s.Thread.wait();
+
+    s.Condition.release();
+    s.Mutex.release();
+    atomic_store(&s.Running, 0);
+}
+
+#if OS == WINDOWS
+file_scope void task_io_complete(async_io_request *r) { job_run(internal::task_resume, r->UserData); }
+
+void task_io_awaiter::await_suspend(std::coroutine_handle<> h) {
+    if (!Target) Target = &Request;
+
+    auto *r     = Target;
+    auto *io    = IO;
+    r->Callback = task_io_complete;
+    r->UserData = h.address();
+
+    // The request may complete and resume us (freeing this awaiter) before async_io_submit returns,
+    // so don't touch any members after queueing
+    async_io_queue(*io, r);
+    async_io_submit(*io);
+}
+#endif
+
+file_scope void task_net_complete(net_request *r) { job_run(internal::task_resume, r->UserData); }
+
+void task_net_awaiter::await_suspend(std::coroutine_handle<> h) {
+    auto *r     = &Request;
+    auto *p     = Poller;
+    r->Callback = task_net_complete;
+    r->UserData = h.address();
+
+    // May complete right away and resume us on a worker, don't touch members after submitting
+    net_submit(*p, r);
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "job_system.h"
+#include "timer_wheel.h"
+#include "types/coroutine.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Stackless coroutines for code which mostly waits: on files, on sockets, on timers, on jobs.
+//
+// A function which returns task<T> and uses co_await/co_return is a coroutine. Its locals live in a frame
+// allocated when it's called, and every co_await on something which isn't ready yet suspends it with no thread
+// blocked. It's resumed as a job on the job system's workers when the thing it waited for is done.
+//
+//     task<s64> load(async_io &io, async_io_file &file, byte *buffer) {
+//         s64 read = co_await task_read(io, file, 0, buffer, file.Size);
+//         co_await task_sleep(10);
+//
+//         job_counter parsed;
+//         For(range(8)) job_run(parse_chunk, buffer + it * (read / 8), &parsed);
+//         co_await task_wait(&parsed);
+//
+//         co_return read;
+//     }
+//
+//     s64 read = task_sync_wait(load(io, file, buffer));  // From normal code
+//
+// Tasks are lazy - nothing runs until the task is awaited (then it runs right away on the awaiting thread),
+// task_sync_wait-ed or handed to task_run.
+//
+// Frames are allocated with Context.Alloc of the thread which calls the coroutine and freed when the task handle
+// is freed (or when the coroutine finishes, for task_run). Since the rest of the coroutine may run on any worker,
+// don't make coroutines while Context.Alloc is the temporary allocator.
+//
+// Compared to jobs which job_wait with fibers: no stack per waiting job (a frame is only as big as the locals
+// which live across a co_await), but every function on the way to a co_await has to be a coroutine.
+// As with fibers, a coroutine may be on a different thread after a co_await, don't keep thread locals across it.
+//
+
+namespace internal {
+struct task_promise_base {
+    std::coroutine_handle<> Continuation;  // The coroutine which awaits us, resumed when we finish
+
+    job_counter *Counter = null;  // Signaled when we finish, see task_sync_wait and task_run
+    bool Detached        = false;  // Started with task_run, the frame frees itself
+
+    static void *operator new(size_t size) { return general_allocate(Context.Alloc, (s64) size, 0); }
+    static void operator delete(void *ptr) { general_free(ptr); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            auto &p = h.promise();
+
+            // Whoever waits on _Counter_ may free the frame as soon as it's signaled, so read everything first
+            auto continuation = p.Continuation;
+            auto *counter     = p.Counter;
+            if (p.Detached) h.destroy();
+            if (counter) job_counter_signal(counter);
+
+            if (continuation) return continuation;
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { assert(false && "We build without exceptions"); }
+};
+
+// Resumes the coroutine at _address_, the function we hand to job_run
+void task_resume(void *address);
+}  // namespace internal
+
+template <typename T = void>
+struct task;
+
+template <typename T>
+struct task_promise : internal::task_promise_base {
+    T Value;
+
+    task<T> get_return_object();
+    void return_value(const T &value) { Value = value; }
+};
+
+template <>
+struct task_promise<void> : internal::task_promise_base {
+    task<void> get_return_object();
+    void return_void() {}
+};
+
+//
+// Owns the coroutine's frame. This is the one place we use a destructor: _co_await load()_ makes a temporary task,
+// without it every such call would leak its frame.
+//
+template <typename T>
+struct task : non_copyable {
+    using promise_type = task_promise<T>;
+    using handle       = std::coroutine_handle<promise_type>;
+
+    handle Handle;
+
+    task() {}
+    explicit task(handle h) : Handle(h) {}
+
+    task(task &&other) : Handle(other.Handle) { other.Handle = {}; }
+
+    task &operator=(task &&other) {
+        if (this != &other) {
+            if (Handle) Handle.destroy();
+            Handle       = other.Handle;
+            other.Handle = {};
+        }
+        return *this;
+    }
+
+    ~task() {
+        if (Handle) Handle.destroy();
+    }
+
+    // Awaiting a task starts it on the awaiting thread and resumes the awaiter when it finishes
+    bool await_ready() const { return !Handle || Handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        Handle.promise().Continuation = awaiting;
+        return Handle;
+    }
+
+    T await_resume() {
+        if constexpr (!types::is_same<T, void>) return Handle.promise().Value;
+    }
+};
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() { return task<T>(task<T>::handle::from_promise(*this)); }
+
+inline task<void> task_promise<void>::get_return_object() { return task<void>(task<void>::handle::from_promise(*this)); }
+
+// Runs _t_ on the calling thread until it first suspends, then waits for it with job_wait (which runs jobs,
+// so the coroutine can be resumed on this thread too). Returns what the coroutine co_returned.
+template <typename T>
+T task_sync_wait(task<T> &&t) {
+    job_counter done;
+    job_counter_add(&done);
+
+    task<T> owned = (task<T> &&) t;
+    owned.Handle.promise().Counter = &done;
+    owned.Handle.resume();
+    job_wait(&done);
+
+    if constexpr (!types::is_same<T, void>) return owned.Handle.promise().Value;
+}
+
+// Starts _t_ as a job and lets it run on its own. The frame is freed when it finishes.
+// If _counter_ is given it's incremented now and signaled when the coroutine finishes.
+inline void task_run(task<void> &&t, job_counter *counter = null) {
+    auto h = t.Handle;
+    t.Handle = {};
+
+    h.promise().Detached = true;
+    h.promise().Counter  = counter;
+    if (counter) job_counter_add(counter);
+
+    job_run(internal::task_resume, h.address());
+}
+
+//
+// Awaitables:
+//
+
+// Continues on a worker. Handy at the start of a coroutine which was called from a thread which isn't one.
+struct task_switch_to_workers_awaiter {
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) const { job_run(internal::task_resume, h.address()); }
+    void await_resume() const {}
+};
+
+inline task_switch_to_workers_awaiter task_switch_to_workers() { return {}; }
+
+// Continues when _counter_ reaches zero, without taking a worker while waiting
+struct task_wait_awaiter {
+    job_counter *Counter;
+
+    bool await_ready() const {
+        if (Counter && atomic_load(&Counter->Value) > 0) return false;
+        if (Counter) {
+            // Let whoever brought it to zero finish with it, it may be a local of ours (see job_wait)
+            Counter->Lock.lock();
+            Counter->Lock.unlock();
+        }
+        return true;
+    }
+
+    // Resumed by a continuation job, the counter releases those after it's let go of
+    void await_suspend(std::coroutine_handle<> h) const { job_run(internal::task_resume, h.address(), null, Counter); }
+
+    void await_resume() const {}
+};
+
+inline task_wait_awaiter task_wait(job_counter *counter) { return {counter}; }
+
+// Continues on a worker after at least _ms_ milliseconds. The timers are on a timer wheel (see timer_wheel.h)
+// which a background thread started on first use advances (see task_timers_stop), it fires them within a few ms.
+struct task_sleep_awaiter {
+    u32 Ms;
+    timer Timer;  // In the coroutine's frame while we sleep, nothing is allocated
+
+    bool await_ready() const { return Ms == 0; }
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume() const {}
+};
+
+inline task_sleep_awaiter task_sleep(u32 ms) { return {ms}; }
+
+// Stops the timer thread, timers which haven't fired yet fire right away.
+void task_timers_stop();
+
+#if OS == WINDOWS
+//
+// Async file I/O (see os.win64.async_io). The request lives in the awaiter, which lives in the coroutine's frame,
+// so there is nothing to allocate or keep alive per read. Resumed as a job once the completion is collected.
+//
+struct task_io_awaiter {
+    async_io *IO;
+    async_io_request Request;
+    async_io_request *Target;  // One the caller owns, or null for _Request_ (set in await_suspend, the awaiter has moved by then)
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    // The number of bytes transferred or -1 on error (the Win32 code is in Target->Error)
+    s64 await_resume() const { return Target->Error ? -1 : Target->Transferred; }
+};
+
+// Queues and submits _request_ (its _Callback_ and _UserData_ are overwritten) and continues when it's done
+inline task_io_awaiter task_io(async_io &io, async_io_request *request) { return {&io, {}, request}; }
+
+inline task_io_awaiter task_read(async_io &io, async_io_file &file, s64 offset, void *data, s64 size) {
+    task_io_awaiter result = {&io, {}, null};
+    result.Request.File    = &file;
+    result.Request.Op      = async_io_op::Read;
+    result.Request.Offset  = offset;
+    result.Request.Data    = (byte *) data;
+    result.Request.Size    = size;
+    return result;
+}
+
+inline task_io_awaiter task_write(async_io &io, async_io_file &file, s64 offset, const void *data, s64 size) {
+    task_io_awaiter result = task_read(io, file, offset, (void *) data, size);
+    result.Request.Op      = async_io_op::Write;
+    return result;
+}
+#endif
+
+//
+// Socket I/O (see os.*platform*.net), like task_io the request lives in the awaiter. The socket must be attached
+// to _poller_. A connection handler which keeps no thread while it waits for the client:
+//
+//     task<void> serve(net_poller &poller, net_socket client) {
+//         defer(free(client));
+//
+//         byte buffer[4_KiB];
+//         while (true) {
+//             s64 n = co_await task_recv(poller, client, buffer, sizeof(buffer));
+//             if (n <= 0) break;
+//             if (co_await task_send(poller, client, buffer, n) < 0) break;
+//         }
+//     }
+//
+//     net_poller_attach(poller, client);
+//     task_run(serve(poller, client));
+//
+struct task_net_awaiter {
+    net_poller *Poller;
+    net_request Request;
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    // The number of bytes received (0 if the other side closed) or sent, -1 on error (the code is in Request.Error)
+    s64 await_resume() const { return Request.Error ? -1 : Request.Transferred; }
+};
+
+inline task_net_awaiter task_recv(net_poller &poller, net_socket &socket, void *data, s64 size) {
+    task_net_awaiter result = {&poller, {}};
+    result.Request.Socket   = &socket;
+    result.Request.Op       = net_op::Recv;
+    result.Request.Data     = (byte *) data;
+    result.Request.Size     = size;
+    return result;
+}
+
+// Continues when all of _data_ was sent
+inline task_net_awaiter task_send(net_poller &poller, net_socket &socket, const void *data, s64 size) {
+    task_net_awaiter result = task_recv(poller, socket, (void *) data, size);
+    result.Request.Op       = net_op::Send;
+    return result;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,433 @@
+#include "thread.h"
+
+#include "internal/context.h"
+#include "memory/sort.h"
+#include "memory/string_utils.h"
+
+import fmt;
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+namespace thread {
+
+// Rounds of spinning before a fast_mutex parks the thread. The pauses double every round, so that's
+// 1 + 2 + ... + 512 pauses, on the order of a few microseconds - longer than most critical sections we guard.
+constexpr s64 FAST_MUTEX_SPIN_ROUNDS = 10;
+
+// Spins one round with exponential backoff, returns false once we've run out of rounds
+file_scope bool spin_backoff(s64 *round) {
+    if (*round >= FAST_MUTEX_SPIN_ROUNDS) return false;
+
+    For(range(1ll << *round)) cpu_pause();
+    ++*round;
+    return true;
+}
+
+void fast_mutex::lock_contended() {
+    LOCK_PROFILE_START();
+
+    s64 round = 0;
+    do {
+        // Read before trying, so spinners share the cache line instead of taking it from each other
+        s32 state = atomic_load(&Lock);
+        if (state == 0 && atomic_compare_and_swap(&Lock, 1, 0) == 0) {
+            LOCK_PROFILE_WAITED(Profile);
+            return;
+        }
+        if (state == 2) break;  // Someone is parked already, the owner is taking long
+    } while (spin_backoff(&round));
+
+    // Mark the lock as contended and park. If the swap returns 0 the lock was free and it's ours
+    // (in the contended state, which costs one wake up at most).
+    while (atomic_swap(&Lock, 2) != 0) wait_on_address(&Lock, 2);
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+void condition_variable::init() {
+    Sequence = 0;
+    Waiters  = 0;
+}
+
+void condition_variable::release() {}
+
+s32 condition_variable::pre_wait() {
+    atomic_inc(&Waiters);
+    return atomic_load(&Sequence);
+}
+
+bool condition_variable::do_wait(s32 sequence, u32 timeoutMs) {
+    bool woken = wait_on_address(&Sequence, sequence, timeoutMs);
+    atomic_add(&Waiters, -1);
+    return woken;
+}
+
+void condition_variable::notify_one() {
+    atomic_inc(&Sequence);
+    if (atomic_load(&Waiters)) wake_by_address_one(&Sequence);
+}
+
+void condition_variable::notify_all() {
+    atomic_inc(&Sequence);
+    if (atomic_load(&Waiters)) wake_by_address_all(&Sequence);
+}
+
+void fast_shared_mutex::lock() {
+    LOCK_PROFILE_TRY(Profile, try_lock());
+
+    atomic_inc(&WritersWaiting);
+    s64 round = 0;
+    while (!try_lock()) {
+        if (!spin_backoff(&round)) sleep(0);
+    }
+    atomic_add(&WritersWaiting, -1);
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+void fast_shared_mutex::lock_shared() {
+    LOCK_PROFILE_TRY(Profile, try_lock_shared());
+
+    s64 round = 0;
+    while (!try_lock_shared()) {
+        if (!spin_backoff(&round)) sleep(0);
+    }
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+void semaphore::wait() {
+    s64 round = 0;
+    while (!try_wait()) {
+        if (spin_backoff(&round)) continue;
+
+        // signal() adds to _Count_ and then reads _Waiters_, we do the opposite,
+        // so either it sees us or we see its unit (both are full barriers)
+        atomic_inc(&Waiters);
+        while (!try_wait()) wait_on_address(&Count, 0);
+        atomic_add(&Waiters, -1);
+        return;
+    }
+}
+
+bool semaphore::wait_for(u32 timeoutMs) {
+    if (timeoutMs == WAIT_FOREVER) {
+        wait();
+        return true;
+    }
+
+    s64 round = 0;
+    while (spin_backoff(&round)) {
+        if (try_wait()) return true;
+    }
+
+    s64 start = os_time_to_nanoseconds(os_get_time());
+
+    atomic_inc(&Waiters);
+    bool taken;
+    while (!(taken = try_wait())) {
+        // Another waiter may take the unit we were woken for, then we go back to sleep for what's left
+        s64 elapsedMs = (os_time_to_nanoseconds(os_get_time()) - start) / 1000000;
+        if (elapsedMs >= timeoutMs) break;
+        wait_on_address(&Count, 0, timeoutMs - (u32) elapsedMs);
+    }
+    atomic_add(&Waiters, -1);
+    return taken;
+}
+
+void semaphore::signal(s32 count) {
+    atomic_add(&Count, count);
+    if (!atomic_load(&Waiters)) return;
+
+    if (count == 1) {
+        wake_by_address_one(&Count);
+    } else {
+        wake_by_address_all(&Count);
+    }
+}
+
+void latch::count_down(s32 n) {
+    s32 old = atomic_add(&Count, -n);
+    assert(old >= n && "Latch counted down more times than its count");
+
+    // Waiters may free the latch as soon as they see zero, so we don't read anything after the decrement.
+    // The latch is one-shot, a wake up with nobody waiting happens once.
+    if (old == n) wake_by_address_all(&Count);
+}
+
+void latch::wait() {
+    s64 round = 0;
+    while (true) {
+        s32 count = atomic_load(&Count);
+        if (!count) return;
+
+        if (!spin_backoff(&round)) wait_on_address(&Count, count);  // Returns right away if it changed meanwhile
+    }
+}
+
+bool barrier::arrive_and_wait() {
+    s32 phase = atomic_load(&Phase);
+
+    if (atomic_inc(&Arrived) == Expected) {
+        // Reset before the next phase starts, threads which see the new phase arrive for it right away
+        atomic_store(&Arrived, 0);
+        atomic_inc(&Phase);
+        if (atomic_load(&Sleepers)) wake_by_address_all(&Phase);
+        return true;
+    }
+
+    s64 round = 0;
+    while (atomic_load(&Phase) == phase) {
+        if (spin_backoff(&round)) continue;
+
+        // The last thread bumps _Phase_ and then reads _Sleepers_, we do the opposite (see semaphore::wait)
+        atomic_inc(&Sleepers);
+        while (atomic_load(&Phase) == phase) wait_on_address(&Phase, phase);
+        atomic_add(&Sleepers, -1);
+    }
+    return false;
+}
+
+//
+// :LockProfiling: The records live in a fixed table (no allocations, locks are made before the allocators are
+// set up), found by hashing where the lock was made. Slots are claimed with a compare and swap and never freed.
+//
+constexpr s64 LOCK_PROFILE_CAPACITY = 1024;
+
+struct lock_profile_slot {
+    s32 State = 0;  // 0 - empty, 1 - being filled, 2 - ready
+    lock_profile Profile;
+};
+
+file_scope lock_profile_slot LockProfiles[LOCK_PROFILE_CAPACITY];
+
+// The same header can give different pointers for __builtin_FILE() in different translation units, so we hash the text
+file_scope u64 lock_profile_hash(source_location loc, const char *kind) {
+    u64 h = 14695981039346656037ull;  // FNV-1a
+    for (const char *p = loc.File; *p; ++p) h = (h ^ (u8) *p) * 1099511628211ull;
+    for (const char *p = kind; *p; ++p) h = (h ^ (u8) *p) * 1099511628211ull;
+    return h ^ ((u64) loc.Line * 0x9E3779B97F4A7C15ull);
+}
+
+file_scope bool lock_profile_same(const lock_profile &p, source_location loc, const char *kind) {
+    return p.Loc.Line == loc.Line && compare_c_string(p.Loc.File, loc.File) == -1 && compare_c_string(p.Kind, kind) == -1;
+}
+
+void lock_profile_report(s64 top) {
+#if !defined LSTD_LOCK_PROFILING
+    print("Lock profiling is off, build with LSTD_LOCK_PROFILING defined.\n");
+#else
+    lock_profile *sorted[LOCK_PROFILE_CAPACITY];
+    s64 count = 0;
+    For(range(LOCK_PROFILE_CAPACITY)) {
+        if (atomic_load(&LockProfiles[it].State) == 2) sorted[count++] = &LockProfiles[it].Profile;
+    }
+
+    sort(sorted, sorted + count, [](lock_profile **a, lock_profile **b) { return (*b)->WaitNs > (*a)->WaitNs ? 1 : ((*b)->WaitNs < (*a)->WaitNs ? -1 : 0); });
+    if (top >= 0) count = min(count, top);
+
+    print("{:>12} {:>12} {:>7} {:>12} {:>12}  {}\n", "Locks", "Contended", "%", "Wait (ms)", "Max (us)", "Made at");
+    For(range(count)) {
+        auto *p = sorted[it];
+
+        f64 percent = p->Acquisitions ? 100.0 * p->Contended / p->Acquisitions : 0.0;
+        print("{:>12} {:>12} {:>7.1f} {:>12.3f} {:>12.1f}  {} {}:{}\n", p->Acquisitions, p->Contended, percent, p->WaitNs / 1e6, p->MaxWaitNs / 1e3, p->Kind, p->Loc.File, p->Loc.Line);
+    }
+#endif
+}
+
+void lock_profile_for_each(const delegate<void(const lock_profile &)> &f) {
+    For(range(LOCK_PROFILE_CAPACITY)) {
+        if (atomic_load(&LockProfiles[it].State) == 2) f(LockProfiles[it].Profile);
+    }
+}
+
+void lock_profile_reset() {
+    For(range(LOCK_PROFILE_CAPACITY)) {
+        auto &p = LockProfiles[it].Profile;
+        if (atomic_load(&LockProfiles[it].State) != 2) continue;
+
+        atomic_swap(&p.Acquisitions, 0ll);
+        atomic_swap(&p.Contended, 0ll);
+        atomic_swap(&p.WaitNs, 0ll);
+        atomic_swap(&p.MaxWaitNs, 0ll);
+    }
+}
+
+}  // namespace thread
+
+namespace internal {
+
+thread::lock_profile *lock_profile_get(source_location loc, const char *kind) {
+    u64 h = thread::lock_profile_hash(loc, kind);
+
+    For(range(thread::LOCK_PROFILE_CAPACITY)) {
+        auto &slot = thread::LockProfiles[(h + it) & (thread::LOCK_PROFILE_CAPACITY - 1)];
+
+        s32 state = atomic_load(&slot.State);
+        if (state == 0) {
+            if (atomic_compare_and_swap(&slot.State, 1, 0) == 0) {
+                slot.Profile.Loc  = loc;
+                slot.Profile.Kind = kind;
+                atomic_store(&slot.State, 2);
+                return &slot.Profile;
+            }
+            state = atomic_load(&slot.State);
+        }
+
+        while (state == 1) {  // Someone else is filling it, it may be our record
+            cpu_pause();
+            state = atomic_load(&slot.State);
+        }
+        if (thread::lock_profile_same(slot.Profile, loc, kind)) return &slot.Profile;
+    }
+    return null;
+}
+
+s64 lock_profile_now() { return os_get_timestamp_ns(); }
+
+void lock_profile_waited(thread::lock_profile *p, s64 startNs) {
+    if (!p) return;
+
+    s64 wait = os_get_timestamp_ns() - startNs;
+    atomic_inc(&p->Acquisitions);
+    atomic_inc(&p->Contended);
+    atomic_add(&p->WaitNs, wait);
+
+    s64 max = atomic_load(&p->MaxWaitNs);
+    while (wait > max) {
+        s64 old = atomic_compare_and_swap(&p->MaxWaitNs, wait, max);
+        if (old == max) break;
+        max = old;
+    }
+}
+
+// Records of threads which have finished. Never given back to the allocator, there are as many
+// as there were threads running at the same time at worst.
+thread::fast_mutex ThreadStartInfoLock;
+thread_start_info *ThreadStartInfoFree = null;
+
+thread_start_info *thread_start_info_acquire(const owning_delegate<void(void *)> &function, void *userData, thread::thread *t, u32 inherit) {
+    ThreadStartInfoLock.lock();
+    auto *ti = ThreadStartInfoFree;
+    if (ti) ThreadStartInfoFree = ti->NextFree;
+    ThreadStartInfoLock.unlock();
+
+    if (!ti) ti = allocate<thread_start_info>({.Alloc = platform_get_persistent_allocator(), .Options = LEAK});
+
+    ti->Function  = function;
+    ti->UserData  = userData;
+    ti->ThreadPtr = t;
+    ti->Module    = null;
+    ti->Inherit   = inherit;
+    ti->Parent    = Context;
+    ti->NextFree  = null;
+    return ti;
+}
+
+void thread_start_info_release(thread_start_info *ti) {
+    free(ti->Function);
+
+    ThreadStartInfoLock.lock();
+    ti->NextFree        = ThreadStartInfoFree;
+    ThreadStartInfoFree = ti;
+    ThreadStartInfoLock.unlock();
+}
+
+void thread_start_inherit_context(const thread_start_info *ti) {
+    auto &parent = ti->Parent;
+
+    auto newContext = Context;
+    if (ti->Inherit == thread::THREAD_INHERIT_ALL) {
+        // Everything after TempAlloc, see the comment in context
+        s64 firstByte = offset_of(context, TempAlloc) + sizeof(context::TempAlloc);
+        copy_memory((byte *) &newContext + firstByte, (byte *) &parent + firstByte, sizeof(context) - firstByte);
+    } else {
+        newContext.Alloc          = parent.Alloc;
+        newContext.AllocAlignment = parent.AllocAlignment;
+        newContext.AllocOptions   = parent.AllocOptions;
+
+        if (ti->Inherit & thread::THREAD_INHERIT_LOG) {
+            newContext.Log                  = parent.Log;
+            newContext.FmtParseErrorHandler = parent.FmtParseErrorHandler;
+            newContext.FmtDisableAnsiCodes  = parent.FmtDisableAnsiCodes;
+        }
+        if (ti->Inherit & thread::THREAD_INHERIT_PANIC_HANDLER) newContext.PanicHandler = parent.PanicHandler;
+    }
+
+    // If the parent thread was using the temporary allocator, the new thread uses one as well,
+    // but it needs to point to its own temp data (otherwise we are not thread-safe).
+    // Its pool is made the first time it allocates, a thread which never does costs nothing here.
+    if (parent.Alloc == parent.TempAlloc) newContext.Alloc = Context.TempAlloc;
+
+    OVERRIDE_CONTEXT(newContext);
+}
+
+}  // namespace internal
+
+using internal::CPU_TOPOLOGY_UNKNOWN;
+
+// Renumbers one id of every processor to 0, 1, 2... in the order they first appear, returns how many there are
+file_scope s64 cpu_topology_renumber(cpu_topology *t, u32 cpu_logical_processor::*member) {
+    u32 seen[MAX_LOGICAL_PROCESSORS];
+    s64 count = 0;
+
+    For(range(t->ProcessorCount)) {
+        u32 &id = t->Processors[it].*member;
+
+        s64 dense = -1;
+        if (id != CPU_TOPOLOGY_UNKNOWN) {
+            For_as(j, range(count)) {
+                if (seen[j] == id) {
+                    dense = j;
+                    break;
+                }
+            }
+        }
+
+        if (dense == -1) {
+            dense         = count;
+            seen[count++] = id;
+        }
+        id = (u32) dense;
+    }
+    return count;
+}
+
+file_scope void cpu_topology_finish(cpu_topology *t) {
+    if (!t->ProcessorCount) {
+        // The OS didn't tell us anything, assume a core per processor
+        t->ProcessorCount = min((s64) os_get_hardware_concurrency(), MAX_LOGICAL_PROCESSORS);
+        For(range(t->ProcessorCount)) {
+            t->Processors[it] = {CPU_TOPOLOGY_UNKNOWN, 0, 0, CPU_TOPOLOGY_UNKNOWN, CPU_TOPOLOGY_UNKNOWN, 0, (u16) it};
+        }
+    }
+
+    t->CoreCount    = cpu_topology_renumber(t, &cpu_logical_processor::Core);
+    t->PackageCount = cpu_topology_renumber(t, &cpu_logical_processor::Package);
+    cpu_topology_renumber(t, &cpu_logical_processor::L2);
+    cpu_topology_renumber(t, &cpu_logical_processor::L3);
+
+    // Node numbers stay what the OS calls them, that's what set_numa_node_affinity takes
+    t->NumaNodeCount = 0;
+    For(range(t->ProcessorCount)) t->NumaNodeCount = max(t->NumaNodeCount, (s64) t->Processors[it].NumaNode + 1);
+}
+
+file_scope cpu_topology CpuTopology;
+file_scope s32 CpuTopologyState;  // 0 - not read, 1 - reading, 2 - done
+
+const cpu_topology *os_get_cpu_topology() {
+    if (atomic_load(&CpuTopologyState) == 2) return &CpuTopology;
+
+    // Someone else is reading it, wait for them
+    if (atomic_compare_and_swap(&CpuTopologyState, 1, 0) != 0) {
+        while (atomic_load(&CpuTopologyState) != 2) thread::sleep(0);
+        return &CpuTopology;
+    }
+
+    internal::platform_read_cpu_topology(&CpuTopology);
+    cpu_topology_finish(&CpuTopology);
+
+    atomic_store(&CpuTopologyState, 2);
+    return &CpuTopology;
+}
+
+LSTD_END_NAMESPACE
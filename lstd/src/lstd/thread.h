@@ -4,7 +4,76 @@
 
 LSTD_BEGIN_NAMESPACE
 
+//
+// :LockProfiling: Define LSTD_LOCK_PROFILING (for the whole build, it changes the size of the locks) and every
+// mutex, shared_mutex, fast_mutex and fast_shared_mutex counts how many times it was locked, how many of those
+// had to wait and for how long. Locks are identified by where they were init()-ed (or constructed, for the fast
+// ones which don't have init - for a member that's usually the struct which contains it). Every lock made
+// at the same place adds to the same record, so e.g. the mutex of every instance of a struct shows up once.
+//
+//     thread::lock_profile_report();  // The locks with the most waiting, through print()
+//
+// try_lock() is never counted, it doesn't wait. Without the define the functions below do nothing.
+//
 namespace thread {
+struct lock_profile {
+    source_location Loc;
+    const char *Kind = "";  // "mutex", "fast_mutex", ...
+
+    s64 Acquisitions = 0;
+    s64 Contended    = 0;  // Acquisitions which didn't get the lock right away
+    s64 WaitNs = 0, MaxWaitNs = 0;
+};
+
+// Prints the _top_ records with the most total wait time. Pass -1 for all.
+void lock_profile_report(s64 top = 20);
+
+// Calls _f_ for every record (in no particular order)
+void lock_profile_for_each(const delegate<void(const lock_profile &)> &f);
+
+// Zeroes the numbers of every record (the records themselves stay)
+void lock_profile_reset();
+}  // namespace thread
+
+namespace internal {
+// Finds or makes the record for locks made at _loc_. Returns null if the table is full (such locks aren't profiled).
+thread::lock_profile *lock_profile_get(source_location loc, const char *kind);
+
+s64 lock_profile_now();
+void lock_profile_waited(thread::lock_profile *p, s64 startNs);
+
+always_inline void lock_profile_acquired(thread::lock_profile *p) {
+    if (p) atomic_inc(&p->Acquisitions);
+}
+}  // namespace internal
+
+// Used by the lock functions. LOCK_PROFILE_TRY is the fast path, it returns if _tryLock_ gets the lock right away,
+// with LSTD_LOCK_PROFILING it also counts that or otherwise starts the clock, which LOCK_PROFILE_WAITED stops
+// once we have the lock. Without the define the rest are nothing.
+#if defined LSTD_LOCK_PROFILING
+#define LOCK_PROFILE_INIT(profile, loc, kind) profile = LSTD_NAMESPACE::internal::lock_profile_get(loc, kind)
+#define LOCK_PROFILE_ACQUIRED(profile) LSTD_NAMESPACE::internal::lock_profile_acquired(profile)
+#define LOCK_PROFILE_START() s64 lockProfileStart = LSTD_NAMESPACE::internal::lock_profile_now()
+#define LOCK_PROFILE_TRY(profile, tryLock)                             \
+    if (tryLock) {                                                     \
+        LSTD_NAMESPACE::internal::lock_profile_acquired(profile);      \
+        return;                                                        \
+    }                                                                  \
+    LOCK_PROFILE_START()
+#define LOCK_PROFILE_WAITED(profile) LSTD_NAMESPACE::internal::lock_profile_waited(profile, lockProfileStart)
+#else
+#define LOCK_PROFILE_INIT(profile, loc, kind)
+#define LOCK_PROFILE_ACQUIRED(profile)
+#define LOCK_PROFILE_START()
+#define LOCK_PROFILE_TRY(profile, tryLock) \
+    if (tryLock) return
+#define LOCK_PROFILE_WAITED(profile)
+#endif
+
+namespace thread {
+
+// Pass as a timeout to wait without one
+constexpr u32 WAIT_FOREVER = 0xFFFFFFFF;
 
 // The thread ID is a unique identifier for each thread.
 struct id {
@@ -23,20 +92,30 @@ struct id {
 
 // Mutex class.
 // This is a mutual exclusion object for synchronizing access to shared
-// memory areas for several threads. The mutex can be recursive (i.e. a
-// program doesn't deadlock if the thread that owns a mutex object calls lock()
-// on that object).
+// memory areas for several threads. The mutex is not recursive.
+//
+// On Windows it's an SRWLOCK (a pointer sized word, locking without contention doesn't call the kernel),
+// on Linux a futex.
 struct mutex : non_assignable {
     union {
         struct alignas(64) {
-            char Handle[40]{};
+            void *Lock;  // SRWLOCK
         } Win32;
+
+        // A futex word: 0 - unlocked, 1 - locked, 2 - locked and someone may be sleeping on it
+        struct alignas(64) {
+            s32 State;
+        } Posix;
     } PlatformData{};
 
-    // This mutex won't work until init() is called.
+#if defined LSTD_LOCK_PROFILING
+    lock_profile *Profile = null;
+#endif
+
+    // This mutex won't work until init() is called. _loc_ identifies it with LSTD_LOCK_PROFILING (see :LockProfiling:).
     //
     // @POSIX pthread_mutex_init(&mHandle, NULL);
-    void init();
+    void init(source_location loc = source_location::current());
 
     // @POSIX pthread_mutex_destroy(&mHandle);
     void release();
@@ -145,16 +224,23 @@ inline scoped_lock<T> *clone(scoped_lock<T> *dest, const scoped_lock<T> &src) {
 //         ++count;
 //         cond.notify_all();
 //       }
+//
+// A waiter reads _Sequence_ before unlocking the mutex and sleeps (wait_on_address) only while it is unchanged,
+// so a notification between the unlock and the sleep isn't lost. notify_*() bump it and wake sleepers up,
+// and only call the kernel if there are _Waiters_. Waiting and notifying is one kernel call each at most.
+//
+// Works with any mutex type (it only calls lock() and unlock()), though a fast_mutex may spin for a while
+// when all the woken threads try to take it back.
+//
 struct condition_variable : non_assignable {
    private:
-#if OS == WINDOWS
-    // Implement platform specific Windows code for wait() in these functions,
-    // because wait() is templated
-    void pre_wait();
-    void do_wait();
-#endif
+    // Defined in thread.cpp. Returns the sequence number the waiter sleeps on.
+    s32 pre_wait();
+    bool do_wait(s32 sequence, u32 timeoutMs);
+
    public:
-    char Handle[64] = {0};  // pthread_cond_t
+    s32 Sequence = 0;
+    s32 Waiters  = 0;
 
     // This condition variable won't work until init() is called.
     //
@@ -174,13 +260,20 @@ struct condition_variable : non_assignable {
     // @POSIX pthread_cond_wait(&mHandle, &aMutex.mHandle);
     template <typename MutexT>
     void wait(MutexT *mutex) {
-        pre_wait();
+        wait_for(mutex, WAIT_FOREVER);
+    }
 
-        // Release the mutex while waiting for the condition (will decrease
-        // the number of waiters when done)...
+    // Like wait() but gives up after _timeoutMs_. Returns false if it timed out, the mutex is locked again either way.
+    // Callers loop on their condition anyway, so count the time left yourself if spurious wake ups matter.
+    //
+    // @POSIX pthread_cond_timedwait(&mHandle, &aMutex.mHandle, &timeout);
+    template <typename MutexT>
+    bool wait_for(MutexT *mutex, u32 timeoutMs) {
+        s32 sequence = pre_wait();
         mutex->unlock();
-        do_wait();
+        bool woken = do_wait(sequence, timeoutMs);
         mutex->lock();
+        return woken;
     }
 
     // Notify one thread that is waiting for the condition.
@@ -205,6 +298,26 @@ inline condition_variable *clone(condition_variable *dest, const condition_varia
     return null;
 }
 
+// What a new thread takes from the Context of the thread which launches it, see thread::init_and_launch.
+// The allocator (Alloc, AllocAlignment, AllocOptions) is always inherited, the rest is opt-in with these flags.
+// Whatever isn't inherited keeps the defaults every thread starts with (Log is cout, the default handlers...).
+enum thread_inherit : u32 {
+    THREAD_INHERIT_ALLOCATOR     = 0,
+    THREAD_INHERIT_LOG           = 1 << 0,  // Log, FmtParseErrorHandler, FmtDisableAnsiCodes
+    THREAD_INHERIT_PANIC_HANDLER = 1 << 1,
+    THREAD_INHERIT_ALL           = 0xFFFFFFFF,  // Every member after TempAlloc (the default)
+};
+
+// @Platform On Linux only Lowest, Low and Normal work without privileges (they map to SCHED_IDLE, SCHED_BATCH
+// and SCHED_OTHER), High and Highest ask for SCHED_RR and fail for normal users.
+enum class priority : s32 {
+    Lowest,
+    Low,
+    Normal,
+    High,
+    Highest,
+};
+
 struct thread : non_assignable {
     // Don't read this directly, use atomic operations - atomic_compare_exchange_pointer(&Handle, null, null).
     // You probably don't want this anyway?
@@ -213,7 +326,13 @@ struct thread : non_assignable {
     // Non-starting constructor.
     thread() {}
 
-    void init_and_launch(const delegate<void(void *)> &function, void *userData = null);
+    // Starts a thread which runs _function(userData)_. Launching doesn't allocate: what the new thread needs
+    // (including a copy of our Context, taken now, so we are free to change it right after) goes in a pooled record.
+    // _inherit_ picks what is copied into the new thread's Context, see thread_inherit.
+    //
+    // _function_ can be a lambda passed by value, its captures are copied into the record (see owning_delegate):
+    //     t.init_and_launch([=](void *) { ... });
+    void init_and_launch(const owning_delegate<void(void *)> &function, void *userData = null, u32 inherit = THREAD_INHERIT_ALL);
 
     void wait();
 
@@ -222,6 +341,15 @@ struct thread : non_assignable {
 
     id get_id() const;
 
+    // Restricts the thread to one logical processor, an index in os_get_cpu_topology()->Processors.
+    // These return false if the OS refused (or the index is out of range).
+    bool set_affinity(u32 processor);
+
+    // Lets the thread run on any logical processor of a NUMA node
+    bool set_numa_node_affinity(u32 node);
+
+    bool set_priority(priority p);
+
    private:
     // Unique thread ID. Used only on Windows.
     u32 Win32ThreadId = 0;
@@ -240,39 +368,59 @@ inline thread *clone(thread *dest, const thread &src) {
     return null;
 }
 
+// Sleeps while *address == expected. Returns after a wake_by_address_*() on _address_, or spuriously - callers
+// loop on their condition. WaitOnAddress on Windows, a futex on Linux. Only works between threads of one process.
+// Returns false if _timeoutMs_ passed first.
+bool wait_on_address(s32 *address, s32 expected, u32 timeoutMs = WAIT_FOREVER);
+
+void wake_by_address_one(s32 *address);
+void wake_by_address_all(s32 *address);
+
 // This is a mutual exclusion object for synchronizing access to shared
 // memory areas for several threads. It is similar to the thread::mutex object,
-// but instead of using system level functions, it is implemented as an atomic
-// spin lock with very low CPU overhead.
+// but it's 4 bytes, needs no init() and locking and unlocking it without contention is one atomic instruction inline.
 //
-// fast_mutex is NOT compatible with condition_variable.
-// It should also be noted that fast_mutex typically does not provide as
-// accurate thread scheduling as the standard mutex does.
+// It's adaptive: a thread which finds it locked first spins for a while (most critical sections are
+// a few instructions long and the owner is on its way out), with cpu_pause() and exponential backoff so
+// the spinners don't keep the cache line bouncing. If that doesn't work out it parks the thread in the
+// kernel (wait_on_address), so a contended lock doesn't burn a core. Unlocking only calls the kernel if
+// someone may be parked.
 //
-// Because of the limitations of this object, it should only be used in
-// situations where the mutex needs to be locked/unlocked very frequently.
+// fast_mutex is NOT compatible with condition_variable and is not fair - a thread which just unlocked
+// can take it again before a parked thread wakes up.
 struct fast_mutex : non_assignable {
-    s32 Lock = 0;
+    s32 Lock = 0;  // 0 - unlocked, 1 - locked, 2 - locked and someone may be parked on it
+
+#if defined LSTD_LOCK_PROFILING
+    lock_profile *Profile;
+
+    fast_mutex(source_location loc = source_location::current()) { LOCK_PROFILE_INIT(Profile, loc, "fast_mutex"); }
+#endif
 
     // Block the calling thread until a lock on the mutex can
     // be obtained. The mutex remains locked until unlock() is called.
-    // Defined in *platform*_thread.cpp although platform inspecific because we include this file in context.h
-    void lock();
+    always_inline void lock() {
+        if (atomic_compare_and_swap(&Lock, 1, 0) != 0) {
+            lock_contended();
+        } else {
+            LOCK_PROFILE_ACQUIRED(Profile);
+        }
+    }
 
     // Try to lock the mutex. If it fails, the function will
     // return immediately (non-blocking).
     //
     // Returns true if the lock was acquired
-    bool try_lock() {
-        s32 oldLock = atomic_swap(&Lock, 1);
-        return oldLock == 0;
-    }
+    bool try_lock() { return atomic_compare_and_swap(&Lock, 1, 0) == 0; }
 
     // Unlock the mutex.
     // If any threads are waiting for the lock on this mutex, one of them will be unblocked.
-    void unlock() {
-        atomic_swap(&Lock, 0);
+    always_inline void unlock() {
+        if (atomic_swap(&Lock, 0) == 2) wake_by_address_one(&Lock);
     }
+
+    // The spinning and parking, in thread.cpp
+    void lock_contended();
 };
 
 // @Pedantic We want to make sure the user doesn't clone things that don't make sense.
@@ -281,13 +429,264 @@ inline fast_mutex *clone(fast_mutex *dest, const fast_mutex &src) {
     return null;
 }
 
+// A reader/writer spin lock in the spirit of fast_mutex.
+// Any number of threads can hold it shared (for reading), or one thread can hold it exclusively (for writing).
+//
+// A writer which is waiting stops new readers from getting in, so writers don't get starved by a steady
+// stream of readers. Neither side is recursive.
+//
+// Useful for read-mostly data (e.g. global caches) where a fast_mutex would serialize the readers.
+struct fast_shared_mutex : non_assignable {
+    s32 State = 0;           // 0 - free, -1 - held by a writer, > 0 - number of readers
+    s32 WritersWaiting = 0;
+
+#if defined LSTD_LOCK_PROFILING
+    lock_profile *Profile;
+
+    fast_shared_mutex(source_location loc = source_location::current()) { LOCK_PROFILE_INIT(Profile, loc, "fast_shared_mutex"); }
+#endif
+
+    // Defined in thread.cpp, these spin (see fast_mutex) and then call sleep(0) between tries
+    void lock();
+    void lock_shared();
+
+    bool try_lock() { return atomic_compare_and_swap(&State, -1, 0) == 0; }
+
+    bool try_lock_shared() {
+        if (atomic_compare_and_swap(&WritersWaiting, 0, 0)) return false;
+
+        s32 state = atomic_compare_and_swap(&State, 0, 0);
+        if (state < 0) return false;
+        return atomic_compare_and_swap(&State, state + 1, state) == state;
+    }
+
+    void unlock() { atomic_swap(&State, 0); }
+    void unlock_shared() { atomic_add(&State, -1); }
+};
+
+inline fast_shared_mutex *clone(fast_shared_mutex *dest, const fast_shared_mutex &src) {
+    assert(false && "We don't deep copy mutexes");
+    return null;
+}
+
+//
+// A reader/writer lock which puts threads to sleep instead of spinning: SRWLOCK on Windows, a futex on Linux.
+// Use it for read-mostly data where the writers may hold it for a while (fast_shared_mutex burns CPU then).
+//
+// Like fast_shared_mutex, a waiting writer keeps new readers out (on Windows SRWLOCK decides, it doesn't
+// starve writers either). Not recursive, and a reader can't upgrade to a writer.
+//
+//     shared_mutex m;
+//     m.init();
+//
+//     { thread::shared_lock _(&m); read(); }
+//     { thread::scoped_lock _(&m); write(); }
+//
+struct shared_mutex : non_assignable {
+    union {
+        struct {
+            void *Lock;  // SRWLOCK
+        } Win32;
+
+        struct {
+            s32 State;           // 0 - free, -1 - held by a writer, > 0 - number of readers
+            s32 WritersWaiting;  // Readers don't get in while this is > 0
+            s32 Sequence;        // The futex word sleepers wait on, bumped when the lock is released
+            s32 Sleepers;
+        } Posix;
+    } PlatformData{};
+
+#if defined LSTD_LOCK_PROFILING
+    lock_profile *Profile = null;
+#endif
+
+    // This mutex won't work until init() is called. _loc_ is for :LockProfiling:.
+    void init(source_location loc = source_location::current());
+    void release();
+
+    // Exclusive, for writing
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    // Shared, for reading
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+};
+
+inline shared_mutex *clone(shared_mutex *dest, const shared_mutex &src) {
+    assert(false && "We don't deep copy mutexes");
+    return null;
+}
+
+//
+// Semaphores, latches and barriers. Like fast_mutex these are a few ints which need no init(): a waiter spins
+// for a while (the signal is often a few instructions away) and then parks on wait_on_address. Signaling only
+// calls the kernel when someone may be parked.
+//
+
+// A counting semaphore: wait() takes one unit, blocking while there are none, signal() adds units.
+//
+//     thread::semaphore slots(4);  // At most 4 threads in here at a time
+//     slots.wait();
+//     ...
+//     slots.signal();
+//
+struct semaphore : non_assignable {
+    s32 Count   = 0;
+    s32 Waiters = 0;  // Parked or about to park, signal() skips the wake up when it's 0
+
+    semaphore() {}
+    explicit semaphore(s32 count) : Count(count) {}
+
+    // Takes a unit if there is one, doesn't block
+    bool try_wait() {
+        s32 count = atomic_load(&Count);
+        while (count > 0) {
+            s32 old = atomic_compare_and_swap(&Count, count - 1, count);
+            if (old == count) return true;
+            count = old;
+        }
+        return false;
+    }
+
+    // In thread.cpp
+    void wait();
+
+    // Returns false if no unit came in _timeoutMs_
+    bool wait_for(u32 timeoutMs);
+
+    void signal(s32 count = 1);
+};
+
+// A one-shot countdown: threads wait until count_down() has been called _count_ times in total.
+// Unlike a barrier it can't be reused, but the threads counting down don't have to wait.
+//
+//     thread::latch loaded(assetCount);
+//     For(assets) job_run(load_asset, it, ...);  // Each calls loaded.count_down() when it's done
+//     loaded.wait();
+//
+// A thread may return from wait() as soon as the count reaches zero, so the latch can be freed right after,
+// count_down() doesn't touch it after the last decrement (apart from waking the address).
+struct latch : non_assignable {
+    s32 Count = 0;
+
+    explicit latch(s32 count) : Count(count) {}
+
+    // In thread.cpp
+    void count_down(s32 n = 1);
+
+    bool try_wait() { return atomic_load(&Count) == 0; }
+    void wait();
+
+    void arrive_and_wait(s32 n = 1) {
+        count_down(n);
+        wait();
+    }
+};
+
+// A reusable rendezvous for a fixed number of threads: arrive_and_wait() returns once all _count_ have called it,
+// then the barrier is ready for the next phase. Meant for code which steps in lock step, e.g. a simulation
+// where every thread finishes a phase before anyone starts the next one.
+//
+//     thread::barrier step(threadCount);
+//     while (running) {
+//         simulate(mySlice);
+//         if (step.arrive_and_wait()) swap_buffers();  // One thread does the serial part...
+//         step.arrive_and_wait();                      // ... and everyone waits for it
+//     }
+//
+// Free it only once every thread is past its last arrive_and_wait().
+struct barrier : non_assignable {
+    s32 Expected;
+    s32 Arrived  = 0;
+    s32 Phase    = 0;  // Bumped when the last thread arrives, the others wait for it to change
+    s32 Sleepers = 0;
+
+    explicit barrier(s32 count) : Expected(count) {}
+
+    // Returns true in exactly one of the threads (the last to arrive) in every phase
+    bool arrive_and_wait();
+};
+
+inline semaphore *clone(semaphore *dest, const semaphore &src) {
+    assert(false && "We don't deep copy semaphores");
+    return null;
+}
+
+inline latch *clone(latch *dest, const latch &src) {
+    assert(false && "We don't deep copy latches");
+    return null;
+}
+
+inline barrier *clone(barrier *dest, const barrier &src) {
+    assert(false && "We don't deep copy barriers");
+    return null;
+}
+
+// Holds a shared_mutex or a fast_shared_mutex shared for the lifetime of the object (scoped_lock takes it exclusively).
+template <typename T>
+struct shared_lock : non_assignable {
+    T *Mutex;
+
+    explicit shared_lock(T *mutex) : Mutex(mutex) { Mutex->lock_shared(); }
+    ~shared_lock() { Mutex->unlock_shared(); }
+};
+
 // Blocks the calling thread for at least a given period of time in ms.
 // sleep(0) supposedly tells the os to yield execution to another thread.
 void sleep(u32 ms);
 
+// The same as the thread members, for the calling thread (which may not have been started by us)
+bool set_current_affinity(u32 processor);
+bool set_current_numa_node_affinity(u32 node);
+bool set_current_priority(priority p);
+
 }  // namespace thread
 
 // The number of threads which can execute concurrently on the current hardware (may be different from the number of cores because of hyperthreads).
 u32 os_get_hardware_concurrency();
 
+//
+// Where the logical processors (hardware threads) are: which are hyperthreads of the same core, which share
+// a cache, which socket and NUMA node they belong to. Memory is attached to a NUMA node, reading it from
+// another node's processor crosses the socket interconnect, so threads which share data should stay on one node.
+//
+// The ids in cpu_logical_processor are small numbers counted from 0 (Core goes up to CoreCount - 1, etc.).
+// Two processors with the same L3 value share an L3 cache. If the OS didn't tell us about a cache level
+// each processor gets its own value.
+//
+
+// Processors past this aren't reported (and can't be used with set_affinity)
+constexpr s64 MAX_LOGICAL_PROCESSORS = 256;
+
+struct cpu_logical_processor {
+    u32 Core;
+    u32 Package;  // The socket
+    u32 NumaNode;
+    u32 L2, L3;
+
+    // What the OS calls it. On Windows processors come in groups of up to 64, on Linux the group is always 0
+    // and the number is the CPU number (offline CPUs are skipped, so that's not always the index).
+    u16 Group;
+    u16 Number;
+};
+
+struct cpu_topology {
+    s64 ProcessorCount, CoreCount, PackageCount, NumaNodeCount;
+    cpu_logical_processor Processors[MAX_LOGICAL_PROCESSORS];
+};
+
+// Asks the OS the first time and returns the same result after that
+const cpu_topology *os_get_cpu_topology();
+
+namespace internal {
+// Marks an id the OS didn't give us, then each processor gets its own
+constexpr u32 CPU_TOPOLOGY_UNKNOWN = 0xFFFFFFFF;
+
+// Implemented in windows_thread.cpp and posix_thread.cpp. The ids may be anything, thread.cpp renumbers them.
+void platform_read_cpu_topology(cpu_topology *t);
+}  // namespace internal
+
 LSTD_END_NAMESPACE
@@ -0,0 +1,230 @@
+#include "timer_wheel.h"
+
+#include "job_system.h"
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+constexpr s64 TIMER_WHEEL_BITS = 6;  // log2(TIMER_WHEEL_SLOTS)
+constexpr s64 TIMER_WHEEL_MASK = TIMER_WHEEL_SLOTS - 1;
+
+// Further than this we place the timer as if it was this far, it's placed again when it gets here
+constexpr s64 TIMER_WHEEL_MAX_DELTA = 1ll << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS - 1);
+
+file_scope void timer_list_init(timer_link *head) { head->Next = head->Prev = head; }
+
+file_scope void timer_list_append(timer_link *head, timer_link *l) {
+    l->Prev          = head->Prev;
+    l->Next          = head;
+    head->Prev->Next = l;
+    head->Prev       = l;
+}
+
+file_scope void timer_unlink(timer_wheel &w, timer *t) {
+    t->Prev->Next = t->Next;
+    t->Next->Prev = t->Prev;
+    t->Next = t->Prev = null;
+
+    timer_link *head = w.Slots + t->Slot;
+    if (head->Next == head) w.Occupied[t->Slot / TIMER_WHEEL_SLOTS] &= ~(1ull << (t->Slot % TIMER_WHEEL_SLOTS));
+}
+
+// Puts _t_ on the lowest wheel on which its deadline is in a different slot than now, but no earlier than tick _earliest_.
+// Every tick above that wheel's slot matches now, so the slot comes around (and is cascaded) before the deadline.
+file_scope void timer_place(timer_wheel &w, timer *t, s64 earliest) {
+    s64 deadline = max(t->Deadline, earliest);
+    if (deadline - w.Now > TIMER_WHEEL_MAX_DELTA) deadline = w.Now + TIMER_WHEEL_MAX_DELTA;
+
+    s64 level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && (deadline >> (TIMER_WHEEL_BITS * (level + 1))) != (w.Now >> (TIMER_WHEEL_BITS * (level + 1)))) ++level;
+
+    s64 slot = (deadline >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+
+    t->Slot = (s32) (level * TIMER_WHEEL_SLOTS + slot);
+    timer_list_append(w.Slots + t->Slot, t);
+    w.Occupied[level] |= 1ull << slot;
+}
+
+// Moves the timers of a slot to _expired_ (or places them again if they aren't due yet)
+file_scope void timer_expire_slot(timer_wheel &w, s64 slot, timer_link *expired, bool all) {
+    timer_link *head = w.Slots + slot;
+    while (head->Next != head) {
+        auto *t = (timer *) head->Next;
+        timer_unlink(w, t);
+
+        if (all || t->Deadline <= w.Now) {
+            t->Slot = TIMER_FIRING;
+            timer_list_append(expired, t);
+            atomic_add(&w.Count, (s64) -1);
+        } else {
+            timer_place(w, t, w.Now);
+        }
+    }
+}
+
+// Called when the lowest wheel starts a new revolution. Spreads the slot which comes up on each wheel over the
+// ones below, going up as long as the wheel below wrapped around too.
+file_scope void timer_cascade(timer_wheel &w) {
+    for (s64 level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+        s64 index = (w.Now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        s64 slot  = level * TIMER_WHEEL_SLOTS + index;
+
+        // This tick's slot of the lowest wheel hasn't been expired yet, so timers may land on it
+        timer_link *head = w.Slots + slot;
+        while (head->Next != head) {
+            auto *t = (timer *) head->Next;
+            timer_unlink(w, t);
+            timer_place(w, t, w.Now);
+        }
+
+        if (index) break;
+    }
+}
+
+// The next tick after now which has something to do: a slot of the lowest wheel with timers in it or a slot of a higher
+// wheel coming up to be cascaded. A wheel's slots come up before anything on the wheels above it does,
+// so the first wheel with timers after its current slot decides. Ticks in between are skipped, that's what keeps
+// advancing over a long quiet stretch cheap.
+file_scope s64 timer_next_work(timer_wheel &w) {
+    For(range(TIMER_WHEEL_LEVELS)) {
+        s64 shift = TIMER_WHEEL_BITS * it;
+
+        s64 index = (w.Now >> shift) & TIMER_WHEEL_MASK;
+        u64 later = index == TIMER_WHEEL_MASK ? 0 : w.Occupied[it] & (~0ull << (index + 1));
+        if (later) return (((w.Now >> shift) & ~TIMER_WHEEL_MASK) + lsb(later)) << shift;
+
+        // Only the top wheel has slots behind the current one (timers clamped to TIMER_WHEEL_MAX_DELTA),
+        // they come up when it wraps around
+        if (w.Occupied[it]) return ((w.Now >> (shift + TIMER_WHEEL_BITS)) + 1) << (shift + TIMER_WHEEL_BITS);
+    }
+    return numeric_info<s64>::max();
+}
+
+file_scope void timer_fire(void *data) {
+    auto *t = (timer *) data;
+    t->Callback(t);
+}
+
+// Runs the callbacks outside the lock. A callback may add its timer again (even to this wheel),
+// so we are done with a timer before it runs.
+file_scope s64 timer_run_expired(timer_wheel &w, timer_link *expired) {
+    s64 count = 0;
+
+    timer_link *l = expired->Next;
+    while (l != expired) {
+        auto *t = (timer *) l;
+        l       = l->Next;
+
+        t->Next = t->Prev = null;
+        atomic_store(&t->Slot, TIMER_IDLE);
+
+        if (t->Callback) {
+            if (w.RunOnJobs) {
+                job_run(timer_fire, t);
+            } else {
+                t->Callback(t);
+            }
+        }
+        ++count;
+    }
+    return count;
+}
+
+void timer_wheel_init(timer_wheel &w, s64 tickNs) {
+    assert(tickNs > 0);
+
+    w.TickNs  = tickNs;
+    w.StartNs = os_get_timestamp_ns();
+    w.Now     = 0;
+    w.Count   = 0;
+
+    For(w.Slots) timer_list_init(&it);
+    zero_memory(w.Occupied, sizeof(w.Occupied));
+}
+
+void timer_add(timer_wheel &w, timer *t, s64 delayNs) { timer_add_at(w, t, os_get_timestamp_ns() + delayNs); }
+
+void timer_add_at(timer_wheel &w, timer *t, s64 timestampNs) {
+    assert(atomic_load(&t->Slot) != TIMER_FIRING && "Adding a timer whose callback hasn't run yet (only its callback may add it again)");
+
+    // Rounded up, a timer never fires early
+    s64 ticks    = max(timestampNs - w.StartNs, (s64) 0);
+    s64 deadline = (ticks + w.TickNs - 1) / w.TickNs;
+
+    thread::scoped_lock _(&w.Lock);
+
+    if (t->Slot >= 0) {
+        timer_unlink(w, t);
+    } else {
+        atomic_add(&w.Count, (s64) 1);
+    }
+
+    // The slot of the current tick was expired already
+    t->Deadline = deadline;
+    timer_place(w, t, w.Now + 1);
+}
+
+bool timer_cancel(timer_wheel &w, timer *t) {
+    thread::scoped_lock _(&w.Lock);
+    if (t->Slot < 0) return false;
+
+    timer_unlink(w, t);
+    t->Slot = TIMER_IDLE;
+    atomic_add(&w.Count, (s64) -1);
+    return true;
+}
+
+s64 timer_wheel_advance(timer_wheel &w, s64 nowNs) {
+    s64 to = (nowNs - w.StartNs) / w.TickNs;
+
+    timer_link expired;
+    timer_list_init(&expired);
+    {
+        thread::scoped_lock _(&w.Lock);
+
+        while (w.Now < to) {
+            if (!w.Count) {
+                w.Now = to;
+                break;
+            }
+
+            s64 next = timer_next_work(w);
+            if (next > to) {
+                w.Now = to;
+                break;
+            }
+
+            w.Now = next;
+            if (!(w.Now & TIMER_WHEEL_MASK)) timer_cascade(w);
+
+            timer_expire_slot(w, w.Now & TIMER_WHEEL_MASK, &expired, false);
+        }
+    }
+    return timer_run_expired(w, &expired);
+}
+
+s64 timer_wheel_advance(timer_wheel &w) { return timer_wheel_advance(w, os_get_timestamp_ns()); }
+
+s64 timer_wheel_expire_all(timer_wheel &w) {
+    timer_link expired;
+    timer_list_init(&expired);
+    {
+        thread::scoped_lock _(&w.Lock);
+        For(range(TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)) timer_expire_slot(w, it, &expired, true);
+    }
+    return timer_run_expired(w, &expired);
+}
+
+s64 timer_wheel_time_until_next(timer_wheel &w) {
+    s64 next;
+    {
+        thread::scoped_lock _(&w.Lock);
+        if (!w.Count) return -1;
+
+        next = timer_next_work(w);
+    }
+    return max(w.StartNs + next * w.TickNs - os_get_timestamp_ns(), (s64) 0);
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "memory/delegate.h"
+#include "thread.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// A hierarchical timing wheel, for lots of timeouts which are mostly cancelled before they fire
+// (idle connections, retries with backoff, task_sleep).
+//
+// Time is counted in ticks of _TickNs_ (1 ms by default) on os_get_timestamp_ns(), the cycle counter clock.
+// There are TIMER_WHEEL_LEVELS wheels of 64 slots, a wheel's slot spans a whole revolution of the wheel below it.
+// A timer goes to the lowest wheel which can tell its slot apart from now, so adding and cancelling is
+// unlinking from a list - O(1), no matter how many timers there are. When the wheel below finishes a revolution
+// the next slot up is spread over the lower wheels ("cascading"), each timer moves at most once per level.
+//
+//     timer_wheel wheel;
+//     timer_wheel_init(wheel);
+//
+//     timer t;
+//     t.Callback = &on_idle;  // void on_idle(timer *t) { close_connection(t->UserData); }
+//     t.UserData = connection;
+//     timer_add(wheel, &t, 30 * 1000000000ll);  // 30 s
+//     ...
+//     timer_cancel(wheel, &t);  // It saw some data, false if it had fired already
+//
+//     // In a loop, e.g. the one which calls net_poll
+//     timer_wheel_advance(wheel);
+//
+// Timers are owned by the caller (nothing is allocated), they must not move while they are pending.
+// A timer never fires before its deadline and fires at most a tick after it, plus however late the next advance is.
+//
+// Expired timers are collected in one pass under the lock and their callbacks run after it's released,
+// on the thread which advances, or as jobs on the job system if _RunOnJobs_ is set. A callback may add its
+// timer again. The wheel is thread-safe, any thread can add and cancel.
+//
+
+constexpr s64 TIMER_WHEEL_LEVELS = 6;  // 36 bits of ticks, more than two years in ms
+constexpr s64 TIMER_WHEEL_SLOTS  = 64;
+
+// Slots are circular lists, these are their links (and the sentinels)
+struct timer_link {
+    timer_link *Next = null, *Prev = null;
+};
+
+constexpr s32 TIMER_IDLE   = -1;
+constexpr s32 TIMER_FIRING = -2;  // Expired, its callback is about to run
+
+struct timer : timer_link {
+    delegate<void(timer *)> Callback;
+    void *UserData = null;
+
+    s64 Deadline = 0;  // In ticks of the wheel, set by timer_add
+
+    // The slot it's in while it's pending, or TIMER_IDLE/TIMER_FIRING. A timer which is firing can be added again
+    // from its callback, not from another thread before the callback starts.
+    s32 Slot = TIMER_IDLE;
+};
+
+struct timer_wheel {
+    s64 TickNs  = 1000000;
+    s64 StartNs = 0;  // Tick 0
+
+    s64 Now = 0;  // The last tick we advanced to
+
+    timer_link Slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];  // level * TIMER_WHEEL_SLOTS + slot
+    u64 Occupied[TIMER_WHEEL_LEVELS];  // A bit for every slot which isn't empty, so we skip empty ones quickly
+
+    s64 Count = 0;  // Pending timers, atomic
+
+    bool RunOnJobs = false;  // Callbacks are job_run instead of called by whoever advances
+
+    thread::fast_mutex Lock;
+};
+
+// Starts the wheel at the current time. _tickNs_ is the resolution, timers are rounded up to it.
+void timer_wheel_init(timer_wheel &w, s64 tickNs = 1000000);
+
+// Schedules _t_ to fire in _delayNs_ (or at _timestampNs_, in os_get_timestamp_ns() units).
+// A timer which is pending already is moved.
+void timer_add(timer_wheel &w, timer *t, s64 delayNs);
+void timer_add_at(timer_wheel &w, timer *t, s64 timestampNs);
+
+// Returns false if _t_ wasn't pending (it fired already, maybe its callback is running right now).
+bool timer_cancel(timer_wheel &w, timer *t);
+
+inline bool timer_is_pending(timer *t) { return atomic_load(&t->Slot) >= 0; }
+
+// Fires the timers which are due at _nowNs_. Returns how many.
+s64 timer_wheel_advance(timer_wheel &w, s64 nowNs);
+s64 timer_wheel_advance(timer_wheel &w);  // Now
+
+// Fires all pending timers regardless of their deadlines. Returns how many.
+s64 timer_wheel_expire_all(timer_wheel &w);
+
+// Nanoseconds until the next tick which has something to do (a timer or a cascade, which may turn out to have
+// nothing due yet), -1 if nothing is pending. For choosing how long to sleep.
+s64 timer_wheel_time_until_next(timer_wheel &w);
+
+LSTD_END_NAMESPACE
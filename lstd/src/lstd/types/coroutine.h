@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../internal/common.h"
+
+//
+// This file defines the types the compiler needs for C++20 coroutines (co_await, co_return...):
+// coroutine_traits, coroutine_handle, noop_coroutine, suspend_always and suspend_never.
+//
+
+// :AvoidSTDs:
+// Normally <coroutine> provides the needed definitions but if we avoid using headers from the C++ STD we define our own implementation here.
+// Note: You must tell us with a macro: LSTD_DONT_DEFINE_STD.
+//
+// By default we avoid STDs (like in real life) but if e.g. a library relies on it we would get definition errors.
+// In general this library can work WITH or WITHOUT the normal standard library.
+#if defined LSTD_DONT_DEFINE_STD
+#include <coroutine>
+#else
+// Note: If you get many compile errors (but you have defined LSTD_DONT_DEFINE_STD).
+// You probably need to define it globally, because not all headers from this library see the macro.
+
+// MSVC, Clang and GCC implement coroutines with the same builtins. They differ on the alignment
+// __builtin_coro_promise takes, MSVC wants 0.
+#if COMPILER == MSVC
+#define LSTD_CORO_PROMISE_ALIGN(P) 0
+#else
+#define LSTD_CORO_PROMISE_ALIGN(P) alignof(P)
+#endif
+
+namespace std {
+template <typename R, typename... Args>
+struct coroutine_traits {
+    using promise_type = typename R::promise_type;
+};
+
+template <typename Promise = void>
+struct coroutine_handle;
+
+template <>
+struct coroutine_handle<void> {
+    constexpr coroutine_handle() noexcept = default;
+    constexpr coroutine_handle(decltype(nullptr)) noexcept {}
+
+    constexpr void *address() const noexcept { return Ptr; }
+
+    static constexpr coroutine_handle from_address(void *address) noexcept {
+        coroutine_handle result;
+        result.Ptr = address;
+        return result;
+    }
+
+    constexpr explicit operator bool() const noexcept { return Ptr != nullptr; }
+
+    bool done() const noexcept { return __builtin_coro_done(Ptr); }
+
+    void operator()() const { resume(); }
+    void resume() const { __builtin_coro_resume(Ptr); }
+    void destroy() const { __builtin_coro_destroy(Ptr); }
+
+   protected:
+    void *Ptr = nullptr;
+};
+
+template <typename Promise>
+struct coroutine_handle : coroutine_handle<> {
+    using coroutine_handle<>::coroutine_handle;
+
+    static coroutine_handle from_promise(Promise &promise) noexcept {
+        coroutine_handle result;
+        result.Ptr = __builtin_coro_promise((char *) &promise, LSTD_CORO_PROMISE_ALIGN(Promise), true);
+        return result;
+    }
+
+    static constexpr coroutine_handle from_address(void *address) noexcept {
+        coroutine_handle result;
+        result.Ptr = address;
+        return result;
+    }
+
+    Promise &promise() const { return *(Promise *) __builtin_coro_promise(Ptr, LSTD_CORO_PROMISE_ALIGN(Promise), false); }
+};
+
+constexpr bool operator==(coroutine_handle<> lhs, coroutine_handle<> rhs) noexcept { return lhs.address() == rhs.address(); }
+
+struct noop_coroutine_promise {};
+
+#if COMPILER == GCC
+// GCC has no __builtin_coro_noop, a frame is two function pointers (resume and destroy) and the promise
+struct noop_coroutine_frame {
+    static void do_nothing() {}
+
+    void (*Resume)()  = do_nothing;
+    void (*Destroy)() = do_nothing;
+    noop_coroutine_promise Promise;
+};
+
+inline noop_coroutine_frame NoopCoroutineFrame;
+#endif
+
+// Resuming it does nothing. Returned from await_suspend when there is nothing to transfer to.
+template <>
+struct coroutine_handle<noop_coroutine_promise> : coroutine_handle<> {
+    constexpr explicit operator bool() const noexcept { return true; }
+    constexpr bool done() const noexcept { return false; }
+
+    constexpr void operator()() const noexcept {}
+    constexpr void resume() const noexcept {}
+    constexpr void destroy() const noexcept {}
+
+    noop_coroutine_promise &promise() const noexcept {
+        return *(noop_coroutine_promise *) __builtin_coro_promise(Ptr, LSTD_CORO_PROMISE_ALIGN(noop_coroutine_promise), false);
+    }
+
+   private:
+    friend coroutine_handle noop_coroutine() noexcept;
+#if COMPILER == GCC
+    coroutine_handle() noexcept { Ptr = &NoopCoroutineFrame; }
+#else
+    coroutine_handle() noexcept { Ptr = __builtin_coro_noop(); }
+#endif
+};
+
+using noop_coroutine_handle = coroutine_handle<noop_coroutine_promise>;
+
+inline noop_coroutine_handle noop_coroutine() noexcept { return noop_coroutine_handle(); }
+
+struct suspend_never {
+    constexpr bool await_ready() const noexcept { return true; }
+    constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+    constexpr void await_resume() const noexcept {}
+};
+
+struct suspend_always {
+    constexpr bool await_ready() const noexcept { return false; }
+    constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+    constexpr void await_resume() const noexcept {}
+};
+}  // namespace std
+
+#undef LSTD_CORO_PROMISE_ALIGN
+#endif
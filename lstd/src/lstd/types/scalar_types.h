@@ -5,11 +5,8 @@
 
 LSTD_BEGIN_NAMESPACE
 // Replacement for the std::is_constant_evaluated
-#if COMPILER == MSVC
+// MSVC, GCC (9+) and Clang all have the builtin
 [[nodiscard]] constexpr bool is_constant_evaluated() noexcept { return __builtin_is_constant_evaluated(); }
-#else
-#error Implement.
-#endif
 LSTD_END_NAMESPACE
 
 //
@@ -22,7 +22,7 @@
 // - is_fundamental, is_union, is_class, is_enum, is_object
 // - is_member_pointer, is_member_object_pointer, is_member_function_pointer
 // - is_scalar
-// - is_constructible, is_convertible
+// - is_constructible, is_convertible, is_trivially_copyable, is_trivially_default_constructible, is_trivially_destructible
 //
 // Info about arrays:
 // - rank (returns the number of dimensions of the array, e.g s32[][][] -> 3)
@@ -44,6 +44,9 @@
 //
 // - bit_cast (converts one type to another by reinterpreting the bits, uses an union if the two types have the same alingment, otherwise calls copy_memory)
 //
+// Reflection of aggregates:
+// - field_count, field_t, fields_t, field_index, visit_fields (the fields of a plain struct, see the bottom of the types namespace)
+//
 
 LSTD_BEGIN_NAMESPACE
 
@@ -571,6 +574,23 @@ concept is_convertible = __is_convertible_to(From, To);
 template <typename T, typename... Args>
 concept is_constructible = __is_constructible(T, Args...);
 
+// Can be copied byte by byte with copy_memory (no user copy constructors, assignment or destructor).
+// Note that the library's containers are trivially copyable too (they don't have destructors) - copying one copies the pointer, not the data.
+template <typename T>
+concept is_trivially_copyable = __is_trivially_copyable(T);
+
+// The default constructor does nothing (no user constructor, no default member initializers), so "new (p) T" leaves the memory as is.
+template <typename T>
+concept is_trivially_default_constructible = __is_trivially_constructible(T);
+
+#if COMPILER == GCC
+template <typename T>
+concept is_trivially_destructible = __has_trivial_destructor(T);  // GCC doesn't have the newer built-in
+#else
+template <typename T>
+concept is_trivially_destructible = __is_trivially_destructible(T);
+#endif
+
 //
 // Gets the underlying type of an enum
 //
@@ -873,6 +893,130 @@ using common_type_t = typename common_type<T...>::type;
 // struct common_comparison_category {
 //     using type = common_comparison_category_t<Types...>;
 // };
+
+//
+// The fields of an aggregate (a plain struct without constructors or base classes), found at compile time
+// without registering them anywhere:
+//
+//     struct particle { v3 Position; v3 Velocity; f32 Life; };
+//
+//     field_count<particle>                          // 3
+//     field_t<particle, 2>                           // f32
+//     field_index<&particle::Velocity>               // 1
+//     visit_fields(p, [](auto &...fields) { ... });  // References to p.Position, p.Velocity, p.Life
+//
+// The count is the most values which convert to anything that T can be brace initialized with, the fields
+// come from structured bindings. Up to 16 fields. A field which is a C array takes one value per element
+// with brace elision and throws the count off - wrap it in a struct (or use stack_array).
+//
+template <typename T>
+concept is_aggregate = __is_aggregate(T);
+
+constexpr s64 MAX_REFLECTED_FIELDS = 16;
+
+// A list of types which is never instantiated, used to carry the types of fields around
+template <typename... Types>
+struct type_pack {
+    static constexpr s64 COUNT = sizeof...(Types);
+};
+
+namespace internal {
+// Converts to any type, only in unevaluated contexts
+struct any_field {
+    template <typename T>
+    constexpr operator T() const;
+};
+
+template <typename T, typename... Fields>
+constexpr s64 field_count_impl() {
+    if constexpr (sizeof...(Fields) < MAX_REFLECTED_FIELDS && requires { T{Fields{}..., any_field{}}; }) {
+        return field_count_impl<T, Fields..., any_field>();
+    } else {
+        return sizeof...(Fields);
+    }
+}
+
+template <s64 I, typename F, typename... Rest>
+struct type_at {
+    using type = typename type_at<I - 1, Rest...>::type;
+};
+
+template <typename F, typename... Rest>
+struct type_at<0, F, Rest...> {
+    using type = F;
+};
+
+template <s64 I, typename Pack>
+struct type_pack_at;
+
+template <s64 I, typename... Types>
+struct type_pack_at<I, type_pack<Types...>> {
+    using type = typename type_at<I, Types...>::type;
+};
+
+struct field_types_visitor {
+    template <typename... Fields>
+    type_pack<remove_cv_t<Fields>...> operator()(Fields &...) const;
+};
+
+template <typename T>
+struct member_pointer_class;
+
+template <typename M, typename C>
+struct member_pointer_class<M C::*> {
+    using type = C;
+};
+}  // namespace internal
+
+template <is_aggregate T>
+constexpr s64 field_count = internal::field_count_impl<remove_cv_t<T>>();
+
+// Calls _f_ with references to all fields of _object_ in order (const if _object_ is) and returns what it returns
+template <typename T, typename F>
+requires(is_aggregate<remove_cvref_t<T>>) constexpr decltype(auto) visit_fields(T &&object, F &&f) {
+    constexpr s64 n = field_count<remove_cvref_t<T>>;
+    static_assert(n > 0, "No fields (or more than MAX_REFLECTED_FIELDS)");
+
+    // clang-format off
+    if constexpr (n == 1) { auto &[a] = object; return f(a); }
+    else if constexpr (n == 2) { auto &[a, b] = object; return f(a, b); }
+    else if constexpr (n == 3) { auto &[a, b, c] = object; return f(a, b, c); }
+    else if constexpr (n == 4) { auto &[a, b, c, d] = object; return f(a, b, c, d); }
+    else if constexpr (n == 5) { auto &[a, b, c, d, e] = object; return f(a, b, c, d, e); }
+    else if constexpr (n == 6) { auto &[a, b, c, d, e, g] = object; return f(a, b, c, d, e, g); }
+    else if constexpr (n == 7) { auto &[a, b, c, d, e, g, h] = object; return f(a, b, c, d, e, g, h); }
+    else if constexpr (n == 8) { auto &[a, b, c, d, e, g, h, i] = object; return f(a, b, c, d, e, g, h, i); }
+    else if constexpr (n == 9) { auto &[a, b, c, d, e, g, h, i, j] = object; return f(a, b, c, d, e, g, h, i, j); }
+    else if constexpr (n == 10) { auto &[a, b, c, d, e, g, h, i, j, k] = object; return f(a, b, c, d, e, g, h, i, j, k); }
+    else if constexpr (n == 11) { auto &[a, b, c, d, e, g, h, i, j, k, l] = object; return f(a, b, c, d, e, g, h, i, j, k, l); }
+    else if constexpr (n == 12) { auto &[a, b, c, d, e, g, h, i, j, k, l, m] = object; return f(a, b, c, d, e, g, h, i, j, k, l, m); }
+    else if constexpr (n == 13) { auto &[a, b, c, d, e, g, h, i, j, k, l, m, o] = object; return f(a, b, c, d, e, g, h, i, j, k, l, m, o); }
+    else if constexpr (n == 14) { auto &[a, b, c, d, e, g, h, i, j, k, l, m, o, p] = object; return f(a, b, c, d, e, g, h, i, j, k, l, m, o, p); }
+    else if constexpr (n == 15) { auto &[a, b, c, d, e, g, h, i, j, k, l, m, o, p, q] = object; return f(a, b, c, d, e, g, h, i, j, k, l, m, o, p, q); }
+    else { auto &[a, b, c, d, e, g, h, i, j, k, l, m, o, p, q, r] = object; return f(a, b, c, d, e, g, h, i, j, k, l, m, o, p, q, r); }
+    // clang-format on
+}
+
+// type_pack<...> of the types of the fields of T
+template <is_aggregate T>
+using fields_t = decltype(visit_fields(declval<T &>(), internal::field_types_visitor{}));
+
+template <is_aggregate T, s64 I>
+using field_t = typename internal::type_pack_at<I, fields_t<T>>::type;
+
+// The position of the field _Member_ points to (e.g. &particle::Velocity). T must be default constructible at compile time.
+template <auto Member>
+requires(is_member_object_pointer<decltype(Member)>) constexpr s64 field_index = [] {
+    using T = typename internal::member_pointer_class<decltype(Member)>::type;
+
+    T probe{};
+    const void *target = &(probe.*Member);
+    return visit_fields(probe, [&](auto &...fields) {
+        s64 index = 0, result = -1;
+        ((result = (const void *) &fields == target ? index : result, ++index), ...);
+        return result;
+    });
+}();
 }  // namespace types
 
 // Use this macro to declare your custom type as an integral
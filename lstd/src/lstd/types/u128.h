@@ -1,6 +1,10 @@
 #pragma once
 #include "scalar_types.h"
 
+#if COMPILER == MSVC
+#include <intrin.h>  // _umul128, _udiv128, __umulh
+#endif
+
 struct s128;
 
 // Casts from unsigned to signed while preserving the underlying binary representation.
@@ -294,7 +298,7 @@ namespace std {template <>class numeric_limits<s128> {   public:    static const
 
 constexpr u128 operator-(u128 val) {
     u64 hi = ~val.hi;
-    u64 lo = ~val.lo;
+    u64 lo = ~val.lo + 1;
     if (lo == 0) ++hi;  // carry
     return u128(hi, lo);
 }
@@ -353,14 +357,39 @@ constexpr u128 operator-(u128 lhs, u128 rhs) {
     return result;
 }
 
+// Multiplies two 64 bit numbers and returns the full 128 bit result.
+// At runtime this is one instruction (mul/mulx on x64, mul + umulh on ARM64).
+constexpr always_inline u128 mul128(u64 lhs, u64 rhs) {
+    LSTD_USING_NAMESPACE;
+
+    if (!is_constant_evaluated()) {
+#if COMPILER == MSVC && ARCH == X86
+        u64 hi;
+        u64 lo = _umul128(lhs, rhs, &hi);
+        return u128(hi, lo);
+#elif COMPILER == MSVC && ARCH == ARM
+        return u128(__umulh(lhs, rhs), lhs * rhs);
+#else
+        unsigned __int128 product = (unsigned __int128) lhs * rhs;
+        return u128((u64) (product >> 64), (u64) product);
+#endif
+    }
+
+    u64 loLo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    u64 hiLo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+    u64 loHi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    u64 hiHi = (lhs >> 32) * (rhs >> 32);
+
+    u64 cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    u64 hi    = (hiLo >> 32) + (cross >> 32) + hiHi;
+    u64 lo    = (cross << 32) | (loLo & 0xFFFFFFFF);
+    return u128(hi, lo);
+}
+
 constexpr u128 operator*(u128 lhs, u128 rhs) {
-    u64 a32     = lhs.lo >> 32;
-    u64 a00     = lhs.lo & 0xffffffff;
-    u64 b32     = rhs.lo >> 32;
-    u64 b00     = rhs.lo & 0xffffffff;
-    u128 result = u128(lhs.hi * rhs.lo + lhs.lo * rhs.hi + a32 * b32, a00 * b00);
-    result += u128(a32 * b00) << 32;
-    result += u128(a00 * b32) << 32;
+    // The cross products only affect the high half, and lhs.hi * rhs.hi is shifted out completely
+    u128 result = mul128(lhs.lo, rhs.lo);
+    result.hi += lhs.hi * rhs.lo + lhs.lo * rhs.hi;
     return result;
 }
 
@@ -522,12 +551,75 @@ template <typename T>
 constexpr always_inline s32 msb(T x);
 LSTD_END_NAMESPACE
 
-// Long division/modulo for u128 implemented using the shift-subtract division algorithm adapted from:
-// https://stackoverflow.com/questions/5386377/division-without-using
+// Divides the 128 bit number (hi, lo) by _divisor_. The quotient must fit in 64 bits (hi < divisor).
+// At runtime this is one divq on x64. The constant evaluated (and the ARM) version divides
+// in 32 bit digits (Knuth's algorithm D, as in Hacker's Delight's divlu).
+constexpr always_inline u64 div128(u64 hi, u64 lo, u64 divisor, u64 *remainder) {
+    LSTD_USING_NAMESPACE;
+
+    if (!is_constant_evaluated()) {
+#if COMPILER == MSVC && ARCH == X86
+        return _udiv128(hi, lo, divisor, remainder);
+#elif COMPILER != MSVC && ARCH == X86
+        u64 quotient;
+        asm("divq %[v]" : "=a"(quotient), "=d"(*remainder) : [v] "r"(divisor), "a"(lo), "d"(hi));
+        return quotient;
+#endif
+    }
+
+    constexpr u64 b = 1ull << 32;
+
+    // Normalize so the top bit of the divisor is set, then the estimated digits are off by at most 2
+    s32 s = 63 - msb(divisor);
+    divisor <<= s;
+    u64 vn1 = divisor >> 32, vn0 = divisor & 0xFFFFFFFF;
+
+    u64 un32 = (hi << s) | (s ? lo >> (64 - s) : 0);
+    u64 un10 = lo << s;
+    u64 un1 = un10 >> 32, un0 = un10 & 0xFFFFFFFF;
+
+    u64 q1 = un32 / vn1, rhat = un32 - q1 * vn1;
+    while (q1 >= b || q1 * vn0 > b * rhat + un1) {
+        --q1, rhat += vn1;
+        if (rhat >= b) break;
+    }
+
+    u64 un21 = un32 * b + un1 - q1 * divisor;
+
+    u64 q0 = un21 / vn1;
+    rhat   = un21 - q0 * vn1;
+    while (q0 >= b || q0 * vn0 > b * rhat + un0) {
+        --q0, rhat += vn1;
+        if (rhat >= b) break;
+    }
+
+    *remainder = (un21 * b + un0 - q0 * divisor) >> s;
+    return q1 * b + q0;
+}
+
+// Division/modulo for u128. Divisors which fit in 64 bits take one or two div128() steps, larger ones
+// are normalized so the quotient estimate from one div128() is off by at most one (Hacker's Delight's divDU).
 constexpr void div_mod(u128 dividend, u128 divisor, u128 *quotient_ret, u128 *remainder_ret) {
     LSTD_USING_NAMESPACE;
 
-    if (divisor = 0) return;
+    if (divisor == 0) return;  // Undefined, like for the built-in types
+
+    if (divisor.hi == 0) {
+        u64 d = divisor.lo, r = 0;
+        if (dividend.hi == 0) {
+            *quotient_ret  = dividend.lo / d;
+            *remainder_ret = dividend.lo % d;
+        } else if (dividend.hi < d) {
+            *quotient_ret  = div128(dividend.hi, dividend.lo, d, &r);
+            *remainder_ret = r;
+        } else {
+            u64 qhi        = dividend.hi / d;
+            u64 qlo        = div128(dividend.hi % d, dividend.lo, d, &r);
+            *quotient_ret  = u128(qhi, qlo);
+            *remainder_ret = r;
+        }
+        return;
+    }
 
     if (divisor > dividend) {
         *quotient_ret  = 0;
@@ -535,30 +627,24 @@ constexpr void div_mod(u128 dividend, u128 divisor, u128 *quotient_ret, u128 *re
         return;
     }
 
-    if (divisor == dividend) {
-        *quotient_ret  = 1;
-        *remainder_ret = 0;
-        return;
-    }
+    s32 n = 63 - msb(divisor.hi);
+    u64 v1 = (divisor << n).hi;
 
-    u128 denominator = divisor;
-    u128 quotient    = 0;
+    // Halving the dividend keeps the high part below v1 (whose top bit is set)
+    u128 u1 = dividend >> 1;
+    u64 r = 0;
+    u64 q1 = div128(u1.hi, u1.lo, v1, &r);
 
-    // Left aligns the MSB of the denominator and the dividend.
-    s32 shift = msb(dividend) - msb(denominator);
-    denominator <<= shift;
+    // Undo the normalization and the halving, the estimate is the quotient or one above it
+    u64 q0 = (u128(q1) << n >> 63).lo;
+    if (q0 != 0) --q0;
 
-    // Uses shift-subtract algorithm to divide dividend by denominator. The
-    // remainder will be left in dividend.
-    for (s32 i = 0; i <= shift; ++i) {
-        quotient <<= 1;
-        if (dividend >= denominator) {
-            dividend -= denominator;
-            quotient |= 1;
-        }
-        denominator >>= 1;
+    u128 remainder = dividend - u128(q0) * divisor;
+    if (remainder >= divisor) {
+        ++q0;
+        remainder -= divisor;
     }
 
-    *quotient_ret  = quotient;
-    *remainder_ret = dividend;
+    *quotient_ret  = q0;
+    *remainder_ret = remainder;
 }
@@ -468,6 +468,19 @@ typedef struct _LARGE_INTEGER {
     };
 } LARGE_INTEGER, *PLARGE_INTEGER;
 
+typedef struct _PROCESS_MEMORY_COUNTERS {
+    DWORD cb;
+    DWORD PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+} PROCESS_MEMORY_COUNTERS, *PPROCESS_MEMORY_COUNTERS;
+
 typedef struct _OVERLAPPED {
     ULONG_PTR Internal;
     ULONG_PTR InternalHigh;
@@ -662,6 +675,9 @@ typedef struct tagMSG {
 
 extern "C" {
 DWORD GetCurrentThreadId();
+void GetSystemTimeAsFileTime(LPFILETIME lpSystemTimeAsFileTime);
+void GetSystemTimePreciseAsFileTime(LPFILETIME lpSystemTimeAsFileTime);
+BOOL FileTimeToLocalFileTime(const FILETIME *lpFileTime, LPFILETIME lpLocalFileTime);
 
 BOOL DestroyWindow(HWND hWnd);
 HMODULE LoadLibraryW(LPCWSTR lpLibFileName);
@@ -781,8 +797,76 @@ BOOL ReadFile(
     DWORD nNumberOfBytesToRead,
     LPDWORD lpNumberOfBytesRead,
     LPOVERLAPPED lpOverlapped);
+
+BOOL GetOverlappedResult(
+    HANDLE hFile,
+    LPOVERLAPPED lpOverlapped,
+    LPDWORD lpNumberOfBytesTransferred,
+    BOOL bWait);
+
+BOOL CancelIoEx(
+    HANDLE hFile,
+    LPOVERLAPPED lpOverlapped);
+
+typedef struct _OVERLAPPED_ENTRY {
+    ULONG_PTR lpCompletionKey;
+    LPOVERLAPPED lpOverlapped;
+    ULONG_PTR Internal;
+    DWORD dwNumberOfBytesTransferred;
+} OVERLAPPED_ENTRY, *LPOVERLAPPED_ENTRY;
+
+HANDLE CreateIoCompletionPort(
+    HANDLE FileHandle,
+    HANDLE ExistingCompletionPort,
+    ULONG_PTR CompletionKey,
+    DWORD NumberOfConcurrentThreads);
+
+BOOL GetQueuedCompletionStatusEx(
+    HANDLE CompletionPort,
+    LPOVERLAPPED_ENTRY lpCompletionPortEntries,
+    ULONG ulCount,
+    ULONG *ulNumEntriesRemoved,
+    DWORD dwMilliseconds,
+    BOOL fAlertable);
+
+BOOL PostQueuedCompletionStatus(
+    HANDLE CompletionPort,
+    DWORD dwNumberOfBytesTransferred,
+    ULONG_PTR dwCompletionKey,
+    LPOVERLAPPED lpOverlapped);
+
+typedef struct _FILE_NOTIFY_INFORMATION {
+    DWORD NextEntryOffset;
+    DWORD Action;
+    DWORD FileNameLength;  // In bytes
+    WCHAR FileName[1];
+} FILE_NOTIFY_INFORMATION, *PFILE_NOTIFY_INFORMATION;
+
+BOOL ReadDirectoryChangesW(
+    HANDLE hDirectory,
+    LPVOID lpBuffer,
+    DWORD nBufferLength,
+    BOOL bWatchSubtree,
+    DWORD dwNotifyFilter,
+    LPDWORD lpBytesReturned,
+    LPOVERLAPPED lpOverlapped,
+    LPVOID lpCompletionRoutine);
 }
 
+#define FILE_LIST_DIRECTORY 0x0001
+
+#define FILE_NOTIFY_CHANGE_FILE_NAME 0x00000001
+#define FILE_NOTIFY_CHANGE_DIR_NAME 0x00000002
+#define FILE_NOTIFY_CHANGE_SIZE 0x00000008
+#define FILE_NOTIFY_CHANGE_LAST_WRITE 0x00000010
+#define FILE_NOTIFY_CHANGE_CREATION 0x00000040
+
+#define FILE_ACTION_ADDED 0x00000001
+#define FILE_ACTION_REMOVED 0x00000002
+#define FILE_ACTION_MODIFIED 0x00000003
+#define FILE_ACTION_RENAMED_OLD_NAME 0x00000004
+#define FILE_ACTION_RENAMED_NEW_NAME 0x00000005
+
 typedef struct _DEV_BROADCAST_DEVICEINTERFACE_W {
     DWORD dbcc_size;
     DWORD dbcc_devicetype;
@@ -1108,6 +1192,81 @@ LPVOID HeapReAlloc(
 #define HEAP_GENERATE_EXCEPTIONS 0x00000004
 #define HEAP_NO_SERIALIZE 0x00000001
 #define HEAP_REALLOC_IN_PLACE_ONLY 0x00000010
+
+extern "C" {
+LPVOID VirtualAlloc(
+    LPVOID lpAddress,
+    SIZE_T dwSize,
+    DWORD flAllocationType,
+    DWORD flProtect);
+
+BOOL VirtualFree(
+    LPVOID lpAddress,
+    SIZE_T dwSize,
+    DWORD dwFreeType);
+
+BOOL VirtualUnlock(
+    LPVOID lpAddress,
+    SIZE_T dwSize);
+}
+
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_DECOMMIT 0x00004000
+#define MEM_RELEASE 0x00008000
+#define MEM_RESET 0x00080000
+
+#define PAGE_NOACCESS 0x01
+#define MEM_LARGE_PAGES 0x20000000
+
+typedef struct _LUID {
+    DWORD LowPart;
+    LONG HighPart;
+} LUID, *PLUID;
+
+typedef struct _LUID_AND_ATTRIBUTES {
+    LUID Luid;
+    DWORD Attributes;
+} LUID_AND_ATTRIBUTES;
+
+typedef struct _TOKEN_PRIVILEGES {
+    DWORD PrivilegeCount;
+    LUID_AND_ATTRIBUTES Privileges[1];
+} TOKEN_PRIVILEGES, *PTOKEN_PRIVILEGES;
+
+#define TOKEN_QUERY 0x0008
+#define TOKEN_ADJUST_PRIVILEGES 0x0020
+
+#define SE_PRIVILEGE_ENABLED 0x00000002
+
+#define ERROR_NOT_ALL_ASSIGNED 1300
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_TIMEOUT 1460
+#define ERROR_HANDLE_EOF 38
+#define ERROR_IO_PENDING 997
+#define ERROR_IO_INCOMPLETE 996
+
+extern "C" {
+SIZE_T GetLargePageMinimum();
+
+BOOL OpenProcessToken(
+    HANDLE ProcessHandle,
+    DWORD DesiredAccess,
+    HANDLE *TokenHandle);
+
+BOOL LookupPrivilegeValueW(
+    LPCWSTR lpSystemName,
+    LPCWSTR lpName,
+    PLUID lpLuid);
+
+BOOL AdjustTokenPrivileges(
+    HANDLE TokenHandle,
+    BOOL DisableAllPrivileges,
+    PTOKEN_PRIVILEGES NewState,
+    DWORD BufferLength,
+    PTOKEN_PRIVILEGES PreviousState,
+    DWORD *ReturnLength);
+}
 #define HEAP_ZERO_MEMORY 0x00000008
 
 #define STATUS_NONCONTINUABLE_EXCEPTION 0xC0000025
@@ -1165,6 +1324,25 @@ LPVOID MapViewOfFile(
 BOOL UnmapViewOfFile(
     LPCVOID lpBaseAddress);
 
+BOOL FlushViewOfFile(
+    LPCVOID lpBaseAddress,
+    SIZE_T dwNumberOfBytesToFlush);
+
+typedef struct _WIN32_MEMORY_RANGE_ENTRY {
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+} WIN32_MEMORY_RANGE_ENTRY, *PWIN32_MEMORY_RANGE_ENTRY;
+
+BOOL PrefetchVirtualMemory(
+    HANDLE hProcess,
+    ULONG_PTR NumberOfEntries,
+    PWIN32_MEMORY_RANGE_ENTRY VirtualAddresses,
+    ULONG Flags);
+
+BOOL VirtualUnlock(
+    LPVOID lpAddress,
+    SIZE_T dwSize);
+
 HANDLE OpenFileMappingW(
     DWORD dwDesiredAccess,
     BOOL bInheritHandle,
@@ -1225,11 +1403,18 @@ HANDLE SetClipboardData(
 BOOL EmptyClipboard();
 
 DWORD GetCurrentProcessId();
+
+// The kernel32 version of GetProcessMemoryInfo (so we don't need to link psapi)
+BOOL K32GetProcessMemoryInfo(
+    HANDLE Process,
+    PPROCESS_MEMORY_COUNTERS ppsmemCounters,
+    DWORD cb);
 }
 
 #define FILE_MAP_WRITE 0x0002
 #define FILE_MAP_READ 0x0004
 
+#define PAGE_READONLY 0x02
 #define PAGE_READWRITE 0x04
 
 #define CF_UNICODETEXT 13
@@ -1552,6 +1737,12 @@ BOOL IMAGEAPI SymGetLineFromAddrW64(
 
 LPTOP_LEVEL_EXCEPTION_FILTER SetUnhandledExceptionFilter(
     LPTOP_LEVEL_EXCEPTION_FILTER lpTopLevelExceptionFilter);
+
+WORD RtlCaptureStackBackTrace(
+    DWORD FramesToSkip,
+    DWORD FramesToCapture,
+    PVOID *BackTrace,
+    PDWORD BackTraceHash);
 }
 
 #define MAX_SYM_NAME 2000
@@ -1611,6 +1802,15 @@ typedef struct _BY_HANDLE_FILE_INFORMATION {
 #define FILE_FLAG_OVERLAPPED 0x40000000
 
 #define FILE_FLAG_BACKUP_SEMANTICS 0x02000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_FLAG_RANDOM_ACCESS 0x10000000
+#define FILE_FLAG_NO_BUFFERING 0x20000000
+
+#define COPY_FILE_FAIL_IF_EXISTS 0x00000001
+#define COPY_FILE_NO_BUFFERING 0x00001000
+
+#define PROGRESS_CONTINUE 0
+#define PROGRESS_CANCEL 1
 
 #define FILE_ATTRIBUTE_READONLY 0x00000001
 #define FILE_ATTRIBUTE_DIRECTORY 0x00000010
@@ -1666,6 +1866,29 @@ HANDLE FindFirstFileW(
     LPCWSTR lpFileName,
     LPWIN32_FIND_DATAW lpFindFileData);
 
+typedef enum _FINDEX_INFO_LEVELS {
+    FindExInfoStandard,
+    FindExInfoBasic,  // Doesn't fill cAlternateFileName, which is slow to look up
+    FindExInfoMaxInfoLevel
+} FINDEX_INFO_LEVELS;
+
+typedef enum _FINDEX_SEARCH_OPS {
+    FindExSearchNameMatch,
+    FindExSearchLimitToDirectories,
+    FindExSearchLimitToDevices,
+    FindExSearchMaxSearchOp
+} FINDEX_SEARCH_OPS;
+
+#define FIND_FIRST_EX_LARGE_FETCH 0x00000002
+
+HANDLE FindFirstFileExW(
+    LPCWSTR lpFileName,
+    FINDEX_INFO_LEVELS fInfoLevelId,
+    LPVOID lpFindFileData,
+    FINDEX_SEARCH_OPS fSearchOp,
+    LPVOID lpSearchFilter,
+    DWORD dwAdditionalFlags);
+
 BOOL GetFileInformationByHandle(
     HANDLE hFile,
     LPBY_HANDLE_FILE_INFORMATION lpFileInformation);
@@ -1694,6 +1917,25 @@ BOOL CopyFileW(
     LPCWSTR lpNewFileName,
     BOOL bFailIfExists);
 
+typedef DWORD(WINAPI *LPPROGRESS_ROUTINE)(
+    LARGE_INTEGER TotalFileSize,
+    LARGE_INTEGER TotalBytesTransferred,
+    LARGE_INTEGER StreamSize,
+    LARGE_INTEGER StreamBytesTransferred,
+    DWORD dwStreamNumber,
+    DWORD dwCallbackReason,
+    HANDLE hSourceFile,
+    HANDLE hDestinationFile,
+    LPVOID lpData);
+
+BOOL CopyFileExW(
+    LPCWSTR lpExistingFileName,
+    LPCWSTR lpNewFileName,
+    LPPROGRESS_ROUTINE lpProgressRoutine,
+    LPVOID lpData,
+    LPBOOL pbCancel,
+    DWORD dwCopyFlags);
+
 BOOL CreateHardLinkW(
     LPCWSTR lpFileName,
     LPCWSTR lpExistingFileName,
@@ -1921,6 +2163,13 @@ typedef RTL_CRITICAL_SECTION CRITICAL_SECTION;
 using LPCRITICAL_SECTION = CRITICAL_SECTION *;
 using PCRITICAL_SECTION = CRITICAL_SECTION *;
 
+typedef struct _RTL_SRWLOCK {
+    PVOID Ptr;
+} RTL_SRWLOCK, *PRTL_SRWLOCK;
+
+typedef RTL_SRWLOCK SRWLOCK;
+using PSRWLOCK = SRWLOCK *;
+
 typedef struct _SYSTEM_INFO {
     union {
         DWORD dwOemId;
@@ -1943,6 +2192,70 @@ typedef struct _SYSTEM_INFO {
 typedef DWORD(__stdcall *LPTHREAD_START_ROUTINE)(
     LPVOID lpThreadParameter);
 
+using KAFFINITY = u64;
+
+typedef struct _GROUP_AFFINITY {
+    KAFFINITY Mask;
+    WORD Group;
+    WORD Reserved[3];
+} GROUP_AFFINITY, *PGROUP_AFFINITY;
+
+typedef enum _LOGICAL_PROCESSOR_RELATIONSHIP {
+    RelationProcessorCore,
+    RelationNumaNode,
+    RelationCache,
+    RelationProcessorPackage,
+    RelationGroup,
+    RelationProcessorDie,
+    RelationNumaNodeEx,
+    RelationProcessorModule,
+    RelationAll = 0xffff
+} LOGICAL_PROCESSOR_RELATIONSHIP;
+
+typedef struct _PROCESSOR_RELATIONSHIP {
+    BYTE Flags;
+    BYTE EfficiencyClass;
+    BYTE Reserved[20];
+    WORD GroupCount;
+    GROUP_AFFINITY GroupMask[1];
+} PROCESSOR_RELATIONSHIP, *PPROCESSOR_RELATIONSHIP;
+
+typedef struct _NUMA_NODE_RELATIONSHIP {
+    DWORD NodeNumber;
+    BYTE Reserved[18];
+    WORD GroupCount;
+    GROUP_AFFINITY GroupMask;  // A union with GroupMasks[GroupCount] since Windows 11, GroupCount is 0 before
+} NUMA_NODE_RELATIONSHIP, *PNUMA_NODE_RELATIONSHIP;
+
+typedef struct _CACHE_RELATIONSHIP {
+    BYTE Level;
+    BYTE Associativity;
+    WORD LineSize;
+    DWORD CacheSize;
+    DWORD Type;  // PROCESSOR_CACHE_TYPE
+    BYTE Reserved[18];
+    WORD GroupCount;
+    GROUP_AFFINITY GroupMask;  // Same as above
+} CACHE_RELATIONSHIP, *PCACHE_RELATIONSHIP;
+
+typedef struct _SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX {
+    LOGICAL_PROCESSOR_RELATIONSHIP Relationship;
+    DWORD Size;
+    union {
+        PROCESSOR_RELATIONSHIP Processor;
+        NUMA_NODE_RELATIONSHIP NumaNode;
+        CACHE_RELATIONSHIP Cache;
+    } DUMMYUNIONNAME;
+} SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, *PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX;
+
+#define THREAD_PRIORITY_LOWEST -2
+#define THREAD_PRIORITY_BELOW_NORMAL -1
+#define THREAD_PRIORITY_NORMAL 0
+#define THREAD_PRIORITY_ABOVE_NORMAL 1
+#define THREAD_PRIORITY_HIGHEST 2
+
+#define ALL_PROCESSOR_GROUPS 0xffff
+
 extern "C" {
 void InitializeCriticalSection(
     LPCRITICAL_SECTION lpCriticalSection);
@@ -1959,6 +2272,27 @@ void LeaveCriticalSection(
 BOOL TryEnterCriticalSection(
     LPCRITICAL_SECTION lpCriticalSection);
 
+void InitializeSRWLock(
+    PSRWLOCK SRWLock);
+
+void AcquireSRWLockExclusive(
+    PSRWLOCK SRWLock);
+
+void AcquireSRWLockShared(
+    PSRWLOCK SRWLock);
+
+void ReleaseSRWLockExclusive(
+    PSRWLOCK SRWLock);
+
+void ReleaseSRWLockShared(
+    PSRWLOCK SRWLock);
+
+BOOLEAN TryAcquireSRWLockExclusive(
+    PSRWLOCK SRWLock);
+
+BOOLEAN TryAcquireSRWLockShared(
+    PSRWLOCK SRWLock);
+
 HANDLE CreateEventW(
     LPSECURITY_ATTRIBUTES lpEventAttributes,
     BOOL bManualReset,
@@ -1980,6 +2314,33 @@ BOOL ResetEvent(
 void ExitThread(
     DWORD dwExitCode);
 
+void FreeLibraryAndExitThread(
+    HMODULE hLibModule,
+    DWORD dwExitCode);
+
+BOOL GetLogicalProcessorInformationEx(
+    LOGICAL_PROCESSOR_RELATIONSHIP RelationshipType,
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Buffer,
+    DWORD *ReturnedLength);
+
+WORD GetActiveProcessorGroupCount();
+
+DWORD GetActiveProcessorCount(
+    WORD GroupNumber);
+
+BOOL SetThreadGroupAffinity(
+    HANDLE hThread,
+    const GROUP_AFFINITY *GroupAffinity,
+    PGROUP_AFFINITY PreviousGroupAffinity);
+
+BOOL GetNumaNodeProcessorMaskEx(
+    WORD Node,
+    PGROUP_AFFINITY ProcessorMask);
+
+BOOL SetThreadPriority(
+    HANDLE hThread,
+    s32 nPriority);
+
 BOOL GetModuleHandleExW(
     DWORD dwFlags,
     LPCWSTR lpModuleName,
@@ -1997,6 +2358,38 @@ DWORD WaitForSingleObject(
     HANDLE hHandle,
     DWORD dwMilliseconds);
 
+typedef void(__stdcall *LPFIBER_START_ROUTINE)(
+    LPVOID lpFiberParameter);
+
+LPVOID ConvertThreadToFiber(
+    LPVOID lpParameter);
+
+BOOL ConvertFiberToThread();
+
+LPVOID CreateFiber(
+    SIZE_T dwStackSize,
+    LPFIBER_START_ROUTINE lpStartAddress,
+    LPVOID lpParameter);
+
+void DeleteFiber(
+    LPVOID lpFiber);
+
+void SwitchToFiber(
+    LPVOID lpFiber);
+
+// Synchronization.lib
+BOOL WaitOnAddress(
+    volatile void *Address,
+    PVOID CompareAddress,
+    SIZE_T AddressSize,
+    DWORD dwMilliseconds);
+
+void WakeByAddressSingle(
+    PVOID Address);
+
+void WakeByAddressAll(
+    PVOID Address);
+
 BOOL TerminateThread(
     HANDLE hThread,
     DWORD dwExitCode);
@@ -2820,3 +3213,128 @@ BOOL ImmReleaseContext(
 }
 
 #define CFS_FORCE_POSITION 32
+
+//
+// Winsock (ws2_32.lib), used by os.win64.net
+//
+using SOCKET = ULONG_PTR;
+
+#define INVALID_SOCKET ((SOCKET) (~0))
+#define SOCKET_ERROR (-1)
+
+#define AF_UNSPEC 0
+#define AF_INET 2
+#define AF_INET6 23
+
+#define SOCK_STREAM 1
+#define SOCK_DGRAM 2
+
+#define IPPROTO_TCP 6
+#define IPPROTO_UDP 17
+
+#define AI_PASSIVE 0x00000001
+
+#define SOL_SOCKET 0xffff
+#define SO_REUSEADDR 0x0004
+#define TCP_NODELAY 0x0001
+
+#define SD_SEND 1
+
+#define WSA_FLAG_OVERLAPPED 0x01
+#define WSA_IO_PENDING 997
+
+typedef struct WSAData {
+    WORD wVersion;
+    WORD wHighVersion;
+    unsigned short iMaxSockets;
+    unsigned short iMaxUdpDg;
+    char *lpVendorInfo;
+    char szDescription[257];
+    char szSystemStatus[129];
+} WSADATA, *LPWSADATA;
+
+struct sockaddr {
+    u16 sa_family;
+    CHAR sa_data[14];
+};
+
+typedef struct addrinfo {
+    int ai_flags;
+    int ai_family;
+    int ai_socktype;
+    int ai_protocol;
+    u64 ai_addrlen;
+    char *ai_canonname;
+    struct sockaddr *ai_addr;
+    struct addrinfo *ai_next;
+} ADDRINFOA, *PADDRINFOA;
+
+typedef struct _WSABUF {
+    ULONG len;
+    CHAR *buf;
+} WSABUF, *LPWSABUF;
+
+extern "C" {
+int WINAPI WSAStartup(
+    WORD wVersionRequested,
+    LPWSADATA lpWSAData);
+
+int WINAPI WSAGetLastError(void);
+
+SOCKET WINAPI WSASocketW(
+    int af,
+    int type,
+    int protocol,
+    void *lpProtocolInfo,
+    u32 g,
+    DWORD dwFlags);
+
+int WINAPI closesocket(SOCKET s);
+int WINAPI shutdown(SOCKET s, int how);
+
+int WINAPI bind(SOCKET s, const struct sockaddr *name, int namelen);
+int WINAPI listen(SOCKET s, int backlog);
+SOCKET WINAPI accept(SOCKET s, struct sockaddr *addr, int *addrlen);
+int WINAPI connect(SOCKET s, const struct sockaddr *name, int namelen);
+
+int WINAPI send(SOCKET s, const char *buf, int len, int flags);
+int WINAPI recv(SOCKET s, char *buf, int len, int flags);
+int WINAPI sendto(SOCKET s, const char *buf, int len, int flags, const struct sockaddr *to, int tolen);
+int WINAPI recvfrom(SOCKET s, char *buf, int len, int flags, struct sockaddr *from, int *fromlen);
+
+int WINAPI getsockname(SOCKET s, struct sockaddr *name, int *namelen);
+int WINAPI setsockopt(SOCKET s, int level, int optname, const char *optval, int optlen);
+
+int WINAPI WSASend(
+    SOCKET s,
+    LPWSABUF lpBuffers,
+    DWORD dwBufferCount,
+    LPDWORD lpNumberOfBytesSent,
+    DWORD dwFlags,
+    LPOVERLAPPED lpOverlapped,
+    LPVOID lpCompletionRoutine);
+
+int WINAPI WSARecv(
+    SOCKET s,
+    LPWSABUF lpBuffers,
+    DWORD dwBufferCount,
+    LPDWORD lpNumberOfBytesRecvd,
+    LPDWORD lpFlags,
+    LPOVERLAPPED lpOverlapped,
+    LPVOID lpCompletionRoutine);
+
+BOOL WINAPI WSAGetOverlappedResult(
+    SOCKET s,
+    LPOVERLAPPED lpOverlapped,
+    LPDWORD lpcbTransfer,
+    BOOL fWait,
+    LPDWORD lpdwFlags);
+
+int WINAPI getaddrinfo(
+    PCSTR pNodeName,
+    PCSTR pServiceName,
+    const ADDRINFOA *pHints,
+    PADDRINFOA *ppResult);
+
+void WINAPI freeaddrinfo(PADDRINFOA pAddrInfo);
+}
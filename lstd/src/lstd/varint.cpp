@@ -0,0 +1,204 @@
+#include "varint.h"
+
+#if ARCH == X86
+#include <immintrin.h>  // SSSE3 intrinsics
+
+// MSVC lets us use newer instructions without enabling them for the whole file, GCC and Clang need to be told.
+#if COMPILER == MSVC
+#define TARGET_SSSE3
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Every control byte has the lengths minus 1 of 4 values, 2 bits each, the first value in the low bits.
+// For each of the 256 we precompute how many data bytes the 4 values take and the shuffle which moves
+// them from the packed bytes into 4 u32 lanes (0x80 zeroes the byte).
+//
+struct streamvbyte_tables {
+    u8 Lengths[256];
+    alignas(16) u8 Shuffles[256][16];
+};
+
+file_scope constexpr streamvbyte_tables make_streamvbyte_tables() {
+    streamvbyte_tables result = {};
+    For_as(control, range(256)) {
+        u8 offset = 0;
+        For_as(lane, range(4)) {
+            u8 length = (u8) (((control >> (2 * lane)) & 3) + 1);
+            For(range(4)) result.Shuffles[control][4 * lane + it] = it < length ? (u8) (offset + it) : 0x80;
+            offset += length;
+        }
+        result.Lengths[control] = offset;
+    }
+    return result;
+}
+
+file_scope constexpr streamvbyte_tables StreamVByteTables = make_streamvbyte_tables();
+
+always_inline u32 streamvbyte_length(u32 value) { return value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4; }
+
+template <typename T>
+file_scope s64 streamvbyte_encode_impl(byte *out, const T *values, s64 count) {
+    byte *control = out;
+    byte *data    = out + (count + 3) / 4;
+
+    for (s64 i = 0; i < count; i += 4) {
+        u8 c = 0;
+        for (s64 lane = 0; lane < 4 && i + lane < count; ++lane) {
+            u32 v;
+            if constexpr (types::is_same<T, s32>) {
+                v = zigzag_encode(values[i + lane]);
+            } else {
+                v = values[i + lane];
+            }
+
+            u32 length = streamvbyte_length(v);
+            c |= (u8) ((length - 1) << (2 * lane));
+
+            // Always 4 bytes, the next value overwrites the ones we didn't need. There is always room
+            // since everything before this value took at most 4 bytes per value.
+            data[0] = (byte) v;
+            data[1] = (byte) (v >> 8);
+            data[2] = (byte) (v >> 16);
+            data[3] = (byte) (v >> 24);
+            data += length;
+        }
+        *control++ = c;
+    }
+    return data - out;
+}
+
+s64 streamvbyte_encode(byte *out, const u32 *values, s64 count) { return streamvbyte_encode_impl(out, values, count); }
+s64 streamvbyte_encode(byte *out, const s32 *values, s64 count) { return streamvbyte_encode_impl(out, values, count); }
+
+s64 streamvbyte_encoded_size(const byte *control, s64 count) {
+    s64 controls = (count + 3) / 4;
+
+    s64 size = controls;
+    For(range(count / 4)) size += StreamVByteTables.Lengths[(u8) control[it]];
+
+    // The lanes past the end of a partial last group don't have data
+    For(range(count % 4)) size += (((u8) control[controls - 1] >> (2 * it)) & 3) + 1;
+    return size;
+}
+
+//
+// Kernels: decode _count_ values, the control bytes are at _control_ and the data is at _data_ and all there.
+// Returns where the data ended.
+//
+using streamvbyte_decode_func = const byte *(*) (u32 *out, const byte *control, const byte *data, const byte *end, s64 count, bool zigzag);
+
+file_scope const byte *streamvbyte_decode_scalar(u32 *out, const byte *control, const byte *data, const byte *end, s64 count, bool zigzag) {
+    For(range(count)) {
+        u32 length = (((u8) control[it / 4] >> (2 * (it % 4))) & 3) + 1;
+
+        u32 v = 0;
+        For_as(k, range(length)) v |= (u32) (u8) data[k] << (8 * k);
+        data += length;
+
+        out[it] = zigzag ? (u32) zigzag_decode(v) : v;
+    }
+    return data;
+}
+
+#if ARCH == X86
+template <bool ZigZag>
+TARGET_SSSE3 file_scope const byte *streamvbyte_decode_ssse3_impl(u32 *out, const byte *control, const byte *data, const byte *end, s64 count) {
+    __m128i one = _mm_set1_epi32(1);
+
+    // The 16 byte load reads past the 4 values, so the last groups go through the scalar loop
+    s64 groups = count / 4, g = 0;
+    for (; g < groups && end - data >= 16; ++g) {
+        u8 c = (u8) control[g];
+
+        __m128i v = _mm_loadu_si128((const __m128i *) data);
+        v         = _mm_shuffle_epi8(v, _mm_load_si128((const __m128i *) StreamVByteTables.Shuffles[c]));
+
+        if constexpr (ZigZag) {
+            v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+        }
+        _mm_storeu_si128((__m128i *) (out + 4 * g), v);
+
+        data += StreamVByteTables.Lengths[c];
+    }
+    return streamvbyte_decode_scalar(out + 4 * g, control + g, data, end, count - 4 * g, ZigZag);
+}
+
+TARGET_SSSE3 file_scope const byte *streamvbyte_decode_ssse3(u32 *out, const byte *control, const byte *data, const byte *end, s64 count, bool zigzag) {
+    return zigzag ? streamvbyte_decode_ssse3_impl<true>(out, control, data, end, count) : streamvbyte_decode_ssse3_impl<false>(out, control, data, end, count);
+}
+#endif
+
+file_scope streamvbyte_decode_func streamvbyte_get_decode() {
+    local_persist cpu_dispatch<streamvbyte_decode_func> kernel;
+    return cpu_dispatch_get(kernel, [](const cpu_features &cpu) -> streamvbyte_decode_func {
+#if ARCH == X86
+        return cpu.SSSE3 ? streamvbyte_decode_ssse3 : streamvbyte_decode_scalar;
+#else
+        return streamvbyte_decode_scalar;
+#endif
+    });
+}
+
+file_scope s64 streamvbyte_decode_impl(u32 *out, const byte *in, s64 size, s64 count, bool zigzag) {
+    s64 controls = (count + 3) / 4;
+    if (size < controls) return -1;
+
+    // Checked up front, so the kernels don't have to
+    s64 encoded = streamvbyte_encoded_size(in, count);
+    if (size < encoded) return -1;
+
+    streamvbyte_get_decode()(out, in, in + controls, in + size, count, zigzag);
+    return encoded;
+}
+
+s64 streamvbyte_decode(u32 *out, const byte *in, s64 size, s64 count) { return streamvbyte_decode_impl(out, in, size, count, false); }
+s64 streamvbyte_decode(s32 *out, const byte *in, s64 size, s64 count) { return streamvbyte_decode_impl((u32 *) out, in, size, count, true); }
+
+//
+// Writers and readers
+//
+
+s64 write_streamvbyte(writer *w, const u32 *values, s64 count) {
+    byte buffer[VARINT_MAX_SIZE + streamvbyte_max_size(STREAMVBYTE_BLOCK)];
+
+    s64 written = varint_encode(buffer, (u64) count);
+    w->write(buffer, written);
+
+    for (s64 first = 0; first < count; first += STREAMVBYTE_BLOCK) {
+        s64 size = streamvbyte_encode(buffer, values + first, min(STREAMVBYTE_BLOCK, count - first));
+        w->write(buffer, size);
+        written += size;
+    }
+    return written;
+}
+
+bool read_streamvbyte(reader *r, array<u32> *out) {
+    u64 count;
+    if (!read_varint(r, &count)) return false;
+
+    for (u64 first = 0; first < count; first += STREAMVBYTE_BLOCK) {
+        s64 n = (s64) min<u64>(STREAMVBYTE_BLOCK, count - first);
+
+        s64 controls = (n + 3) / 4;
+        bytes block  = peek(r, controls);
+        if (block.Count < controls) return false;
+
+        s64 size = streamvbyte_encoded_size(block.Data, n);
+        block    = peek(r, size);
+        if (block.Count < size) return false;
+
+        array_reserve(*out, n);
+        streamvbyte_decode(out->Data + out->Count, block.Data, size, n);
+        out->Count += n;
+
+        skip(r, size);
+    }
+    return true;
+}
+
+LSTD_END_NAMESPACE
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "io/reader.h"
+#include "io/writer.h"
+#include "memory/array.h"
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Variable length integers, for streams of numbers which are mostly small (counts, ids, deltas of sorted lists).
+//
+// LEB128 varints take 7 bits per byte, the high bit says another byte follows - 1 byte below 128, at most 10.
+// Signed values go through zigzag first (0, -1, 1, -2, 2... map to 0, 1, 2, 3, 4...), so small negatives stay small.
+//
+//     byte buffer[VARINT_MAX_SIZE];
+//     s64 n = varint_encode(buffer, zigzag_encode(-42));
+//
+//     write_varint(&out, count);   // To a writer, read back with read_varint()
+//
+// Decoding varints one byte at a time is a branch per byte. Arrays of u32 are better off with StreamVByte
+// ("Stream VByte: Faster Byte-Oriented Integer Compression", Lemire, Kurz, Rupp, 2017): the lengths (1 - 4 bytes)
+// of 4 values are packed into one control byte and the bytes of the values follow all the control bytes.
+// The decoder loads 16 bytes and moves the 4 values into place with one shuffle (SSSE3) looked up by the control byte,
+// no branches on the data at all.
+//
+//     byte *encoded = allocate_array<byte>(streamvbyte_max_size(count));
+//     s64 size = streamvbyte_encode(encoded, values, count);
+//     streamvbyte_decode(values, encoded, size, count);
+//
+//     write_streamvbyte(&out, values, count);  // Blocks of STREAMVBYTE_BLOCK values, see read_streamvbyte()
+//
+// The binary serializer uses these too (see binary_write_varint, binary_write_signed and binary_write_streamvbyte in serialize.h).
+//
+
+constexpr s64 VARINT_MAX_SIZE = 10;
+
+constexpr u64 zigzag_encode(s64 value) { return ((u64) value << 1) ^ (u64) (value >> 63); }
+constexpr s64 zigzag_decode(u64 value) { return (s64) (value >> 1) ^ -(s64) (value & 1); }
+
+constexpr u32 zigzag_encode(s32 value) { return ((u32) value << 1) ^ (u32) (value >> 31); }
+constexpr s32 zigzag_decode(u32 value) { return (s32) (value >> 1) ^ -(s32) (value & 1); }
+
+// The number of bytes varint_encode() writes for _value_
+constexpr s64 varint_size(u64 value) { return 1 + msb(value | 1) / 7; }
+
+// Writes _value_ to _out_ (which has room for VARINT_MAX_SIZE bytes), returns the number of bytes written
+inline s64 varint_encode(byte *out, u64 value) {
+    s64 size = 0;
+    while (value >= 0x80) {
+        out[size++] = (byte) (value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (byte) value;
+    return size;
+}
+
+// Reads a varint from the _size_ bytes at _in_. Returns the number of bytes it took,
+// 0 if it doesn't end before _size_ or doesn't fit in a u64.
+inline s64 varint_decode(const byte *in, s64 size, u64 *value) {
+    u64 result = 0;
+
+    s64 n = min(size, VARINT_MAX_SIZE);
+    For(range(n)) {
+        byte b = in[it];
+        if (it == VARINT_MAX_SIZE - 1 && b > 1) return 0;  // Bits past 64
+
+        result |= (u64) (b & 0x7F) << (7 * it);
+        if (!(b & 0x80)) {
+            *value = result;
+            return it + 1;
+        }
+    }
+    return 0;
+}
+
+//
+// StreamVByte, see the top of the file
+//
+
+// The most bytes streamvbyte_encode() writes for _count_ values
+constexpr s64 streamvbyte_max_size(s64 count) { return (count + 3) / 4 + 4 * count; }
+
+// Writes the control bytes and then the data to _out_ (which has room for streamvbyte_max_size(count)).
+// Returns the number of bytes written. The s32 version zigzags the values first.
+s64 streamvbyte_encode(byte *out, const u32 *values, s64 count);
+s64 streamvbyte_encode(byte *out, const s32 *values, s64 count);
+
+// Reads _count_ values from the _size_ bytes at _in_. Returns the number of bytes read, -1 if _size_ is
+// less than the control bytes say the values take.
+s64 streamvbyte_decode(u32 *out, const byte *in, s64 size, s64 count);
+s64 streamvbyte_decode(s32 *out, const byte *in, s64 size, s64 count);
+
+// How many bytes _count_ encoded values take, from their control bytes (the first (count + 3) / 4 bytes)
+s64 streamvbyte_encoded_size(const byte *control, s64 count);
+
+//
+// Writers and readers
+//
+
+// write_streamvbyte() encodes this many values at a time, so a reader never needs more than a block in its buffer
+constexpr s64 STREAMVBYTE_BLOCK = 1024;
+
+inline void write_varint(writer *w, u64 value) {
+    byte buffer[VARINT_MAX_SIZE];
+    w->write(buffer, varint_encode(buffer, value));
+}
+
+inline void write_varint_signed(writer *w, s64 value) { write_varint(w, zigzag_encode(value)); }
+
+// Returns false at the end of the input or if the varint is malformed (then nothing is consumed)
+inline bool read_varint(reader *r, u64 *value) {
+    bytes available = peek(r, VARINT_MAX_SIZE);
+
+    s64 n = varint_decode(available.Data, available.Count, value);
+    if (!n) return false;
+
+    skip(r, n);
+    return true;
+}
+
+inline bool read_varint_signed(reader *r, s64 *value) {
+    u64 v;
+    if (!read_varint(r, &v)) return false;
+    *value = zigzag_decode(v);
+    return true;
+}
+
+// Writes the count as a varint and then the values, STREAMVBYTE_BLOCK at a time (each block has its control bytes
+// and then its data). Returns the number of bytes written.
+s64 write_streamvbyte(writer *w, const u32 *values, s64 count);
+
+// Reads what write_streamvbyte() wrote and appends the values to _out_.
+// Returns false if the input ended too early (the blocks which were read completely stay in _out_).
+bool read_streamvbyte(reader *r, array<u32> *out);
+
+LSTD_END_NAMESPACE
@@ -1,106 +1,71 @@
-#include "lstd/common.hpp"
+#include "lstd/internal/common.h"
 
-// @Platform
-// UNMAINTAINED
-// UNMAINTAINED
-// UNMAINTAINED
+#if OS != WINDOWS
 
-#if IS_OS_POSIX
+#include "lstd/io.h"
+#include "lstd/memory/guid.h"
+#include "lstd/random.h"
 
-#if defined LSTD_NO_CRT
-#error LSTD_NO_CRT is Windows-only
-#endif
-
-#include "io.hpp"
-
-#include "memory/array.hpp"
-#include "string/string.hpp"
-
-#include <sys/mman.h>
-#include <sys/time.h>
-
-#include <stdlib.h>
-
-#include <termios.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 
-#include <csignal>
-
-CPPU_BEGIN_NAMESPACE
-
-void os_exit_program(s32 code) { _exit(code); }
-
-void os_assert_failed(const char *file, s64 line, const char *condition) {
-    fmt::print("{}>>> {}:{}, Assert failed: {}{}\n", fmt::FG::Red, file, line, condition, fmt::FG::Reset);
-#if COMPILER == GCC || COMPILER == CLANG
-    std::raise(SIGINT);
-#else
-    os_exit_program(-1);
-#endif
+import path;
+import fmt;
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// On Windows we put callbacks in the CRT sections. GCC and Clang have attributes for the same thing:
+// constructors run before main (and before the constructors of global variables without a priority),
+// destructors after main returns or exit() is called.
+//
+// The priority is the smallest one which isn't reserved for the implementation, so we come before any user code.
+//
+// Note: threads which weren't launched with thread::thread don't get their context initialized,
+// there is no TLS callback here (see wrapper_function in posix_thread.cpp).
+//
+__attribute__((constructor(101))) file_scope void c_init() {
+    // :PlatformStateInit
+    internal::platform_init_context();
+    internal::platform_init_global_state();
 }
 
-#define CONSOLE_BUFFER_SIZE 1_KiB
-
-io::Console_Writer::Console_Writer() {
-    Buffer = New<byte>(CONSOLE_BUFFER_SIZE);
-    Current = Buffer;
-    Available = CONSOLE_BUFFER_SIZE;
+__attribute__((destructor(101))) file_scope void pre_termination() {
+    // :PlatformExitTermination
+    exit_call_scheduled_functions();
+    internal::platform_uninit_state();
 }
 
-void io::Console_Writer::write(const Memory_View &str) {
-    if (str.Count > Available) {
-        flush();
+// Weak, so a definition in the executable replaces them. See the comment above the stubs in windows_common.cpp.
+extern "C" __attribute__((weak)) s64 lstd_persistent_storage_starting_size() { return PLATFORM_PERSISTENT_STORAGE_STARTING_SIZE; }
+extern "C" __attribute__((weak)) s64 lstd_temporary_storage_starting_size() { return PLATFORM_TEMPORARY_STORAGE_STARTING_SIZE; }
+extern "C" __attribute__((weak)) bool lstd_profile_startup() { return false; }
+
+// For rng_seed_os() (see random.h)
+void internal::platform_random_bytes(byte *dest, s64 count) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    assert(fd != -1);
+    defer(close(fd));
+
+    s64 got = 0;
+    while (got < count) {
+        ssize_t n = read(fd, dest + got, count - got);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
     }
-
-    copy_memory(Current, str.Data, str.Count);
-    Current += str.Count;
-    Available -= str.Count;
+    assert(got == count);
 }
 
-void io::Console_Writer::flush() {
-    ::write(STDOUT_FILENO, Buffer, CONSOLE_BUFFER_SIZE - Available);
-
-    Current = Buffer;
-    Available = CONSOLE_BUFFER_SIZE;
+u64 internal::platform_unix_time_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64) ts.tv_sec * 1000 + (u64) ts.tv_nsec / 1000000;
 }
 
-io::Console_Reader::Console_Reader() {
-    // Leak, but doesn't matter since the object is global
-    Buffer = New<byte>(CONSOLE_BUFFER_SIZE);
-    Current = Buffer;
-}
+LSTD_END_NAMESPACE
 
-byte io::Console_Reader::request_byte() {
-    assert(Available == 0);  // Sanity
-
-    size_t read = ::read(STDIN_FILENO, (char *) Buffer, CONSOLE_BUFFER_SIZE);
-
-    Current = Buffer;
-    Available = read;
-
-    return (read == 0) ? io::eof : (*Current);
-}
-
-f64 os_get_wallclock_in_seconds() {
-    timeval time;
-    assert(!gettimeofday(&time, 0));
-    return (f64) time.tv_sec + (f64) time.tv_usec * 0.000001;
-}
-
-bool fmt::internal::does_terminal_support_color() {
-    const char *env = getenv("TERM");
-    if (!env) return false;
-
-    auto terms = to_array(string_view("ansi"), "color", "console", "cygwin", "gnome", "konsole", "kterm", "linux",
-        "msys", "putty", "rxvt", "screen", "vt100", "xterm");
-    For(terms) {
-        if (string_view(env).match_beginning(it)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-CPPU_END_NAMESPACE
-
-#endif  // OS == LINUX || OS == MAC
\ No newline at end of file
+#endif
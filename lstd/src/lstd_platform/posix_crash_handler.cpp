@@ -0,0 +1,84 @@
+#include "lstd/internal/common.h"
+
+#if OS != WINDOWS
+
+#include "lstd/internal/os_function_call.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// We walk the frame pointers instead of calling backtrace(): it takes a few nanoseconds per frame,
+// doesn't allocate, doesn't take locks and is safe to call from a signal handler or an allocator.
+// Every frame starts with the frame pointer of its caller followed by the return address.
+//
+// This needs the code to be compiled with frame pointers (-fno-omit-frame-pointer), a function without them
+// ends the walk early (or skips its caller). We never follow a pointer outside of the stack of the thread,
+// so a broken chain can't make us crash.
+//
+file_scope thread_local byte *StackLow, *StackHigh;
+
+file_scope void get_stack_bounds() {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr)) return;
+    defer(pthread_attr_destroy(&attr));
+
+    void *address;
+    size_t size;
+    if (pthread_attr_getstack(&attr, &address, &size)) return;
+
+    StackLow  = (byte *) address;
+    StackHigh = (byte *) address + size;
+}
+
+s64 os_capture_call_stack(void **frames, s64 maxFrames, s64 framesToSkip) {
+    if (!StackHigh) get_stack_bounds();
+
+    auto **fp = (void **) __builtin_frame_address(0);
+
+    s64 count = 0;
+    while (count < maxFrames) {
+        if ((byte *) fp < StackLow || (byte *) (fp + 2) > StackHigh || (u64) fp % sizeof(void *)) break;
+
+        void *returnAddress = fp[1];
+        if (!returnAddress) break;
+
+        // The first return address is in our caller, like RtlCaptureStackBackTrace with this function skipped
+        if (framesToSkip) {
+            --framesToSkip;
+        } else {
+            frames[count++] = returnAddress;
+        }
+
+        // The stack grows down, so callers have higher frames
+        auto **next = (void **) fp[0];
+        if (next <= fp) break;
+        fp = next;
+    }
+    return count;
+}
+
+// dladdr only knows exported symbols (link with -rdynamic to see all of them) and has no line info,
+// for files and lines resolve the addresses offline (addr2line, llvm-symbolizer).
+os_function_call os_resolve_function_call(void *address) {
+    os_function_call call;
+
+    // A return address points after the call, which may be the first instruction of the next function
+    Dl_info info;
+    if (dladdr((byte *) address - 1, &info)) {
+        if (info.dli_sname) clone(&call.Name, string(info.dli_sname));
+        if (info.dli_fname) clone(&call.File, string(info.dli_fname));
+    }
+    if (call.Name.Length == 0) clone(&call.Name, string("UnknownFunction"));
+    if (call.File.Length == 0) clone(&call.File, string("UnknownFile"));
+
+    return call;
+}
+
+LSTD_END_NAMESPACE
+
+#endif
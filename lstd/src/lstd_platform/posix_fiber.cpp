@@ -0,0 +1,179 @@
+#include "lstd/internal/common.h"
+
+#if OS != WINDOWS
+
+#include "lstd/fiber.h"
+
+#if !(OS == LINUX && ARCH == X86 && BITS == 64)
+#include <ucontext.h>
+#endif
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+//
+// Stacks are reserved with os_reserve_memory() and all but the lowest page is committed, so running off the end
+// faults instead of writing over whatever is below. Pages are backed lazily by the kernel as the stack grows.
+//
+file_scope bool fiber_allocate_stack(fiber *f, s64 stackSize) {
+    s64 pageSize = os_get_page_size();
+    stackSize    = (stackSize + pageSize - 1) / pageSize * pageSize + pageSize;  // + the guard page
+
+    void *stack = os_reserve_memory(stackSize);
+    if (!stack) return false;
+
+    if (!os_commit_memory((byte *) stack + pageSize, stackSize - pageSize)) {
+        os_release_memory(stack);
+        return false;
+    }
+
+    f->Stack     = stack;
+    f->StackSize = stackSize;
+    return true;
+}
+
+file_scope void fiber_main(fiber *f) {
+    f->Function(f->UserData);
+    assert(false && "A fiber function returned, switch to another fiber instead");
+}
+
+#if OS == LINUX && ARCH == X86 && BITS == 64
+
+//
+// The switch saves what the System V ABI says a callee must preserve: rbp, rbx, r12-r15, the x87 control word
+// and the SSE control bits in MXCSR. Everything else the compiler already assumes is clobbered by a call.
+// The stack pointer is then stored in _*fromSp_ and the one in _toSp_ popped from.
+//
+// That's ~20 instructions and no syscall, ucontext's swapcontext also saves the signal mask (a syscall every switch).
+//
+extern "C" void lstd_fiber_switch_context(void **fromSp, void *toSp);
+extern "C" void lstd_fiber_entry();
+extern "C" void lstd_fiber_main(fiber *f) { fiber_main(f); }
+
+asm(R"(
+.text
+.globl lstd_fiber_switch_context
+.type lstd_fiber_switch_context, @function
+lstd_fiber_switch_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+.size lstd_fiber_switch_context, .-lstd_fiber_switch_context
+
+.globl lstd_fiber_entry
+.type lstd_fiber_entry, @function
+lstd_fiber_entry:
+    movq %r12, %rdi
+    call lstd_fiber_main
+    ud2
+.size lstd_fiber_entry, .-lstd_fiber_entry
+)");
+
+void fiber_convert_thread(fiber *f) {
+    f->Handle   = null;  // Filled by the first switch away
+    f->IsThread = true;
+}
+
+void fiber_revert_thread(fiber *f) { assert(f->IsThread); }
+
+bool fiber_create(fiber *f, const delegate<void(void *)> &function, void *userData, s64 stackSize) {
+    f->Function = function;
+    f->UserData = userData;
+    if (!fiber_allocate_stack(f, stackSize)) return false;
+
+    // Lay out the stack as if lstd_fiber_switch_context had been called from lstd_fiber_entry,
+    // so the first switch to the fiber "returns" into it. _f_ goes in r12.
+    u64 *top = (u64 *) ((byte *) f->Stack + f->StackSize);  // Page aligned, so 16 aligned
+
+    top[-1] = (u64) lstd_fiber_entry;  // The return address. rsp is 16-aligned + 8 after it's popped, like after a call.
+    top[-2] = 0;                       // rbp
+    top[-3] = 0;                       // rbx
+    top[-4] = (u64) f;                 // r12
+    top[-5] = 0;                       // r13
+    top[-6] = 0;                       // r14
+    top[-7] = 0;                       // r15
+    top[-8] = 0x1F80 | ((u64) 0x037F << 32);  // MXCSR and the x87 control word, the defaults
+
+    f->Handle = top - 8;
+    return true;
+}
+
+void fiber_switch(fiber *from, fiber *to) { lstd_fiber_switch_context(&from->Handle, to->Handle); }
+
+#else
+
+// @Platform ucontext. Slower (swapcontext saves the signal mask with a syscall) but everywhere.
+
+file_scope void fiber_ucontext_main(u32 lo, u32 hi) { fiber_main((fiber *) (((u64) hi << 32) | lo)); }
+
+void fiber_convert_thread(fiber *f) {
+    f->Handle   = allocate<ucontext_t>({.Alloc = internal::platform_get_persistent_allocator()});
+    f->IsThread = true;
+}
+
+void fiber_revert_thread(fiber *f) {
+    assert(f->IsThread);
+    free(f->Handle);
+    f->Handle = null;
+}
+
+bool fiber_create(fiber *f, const delegate<void(void *)> &function, void *userData, s64 stackSize) {
+    f->Function = function;
+    f->UserData = userData;
+    if (!fiber_allocate_stack(f, stackSize)) return false;
+
+    auto *uc = allocate<ucontext_t>({.Alloc = internal::platform_get_persistent_allocator()});
+    getcontext(uc);
+
+    s64 pageSize          = os_get_page_size();
+    uc->uc_stack.ss_sp    = (byte *) f->Stack + pageSize;
+    uc->uc_stack.ss_size  = f->StackSize - pageSize;
+    uc->uc_link           = null;
+
+    // makecontext only passes ints
+    makecontext(uc, (void (*)()) fiber_ucontext_main, 2, (u32) (u64) f, (u32) ((u64) f >> 32));
+
+    f->Handle = uc;
+    return true;
+}
+
+void fiber_switch(fiber *from, fiber *to) { swapcontext((ucontext_t *) from->Handle, (ucontext_t *) to->Handle); }
+
+#endif
+
+void fiber_release(fiber *f) {
+    if (f->IsThread) return;
+
+#if !(OS == LINUX && ARCH == X86 && BITS == 64)
+    free(f->Handle);
+#endif
+    if (f->Stack) os_release_memory(f->Stack);
+
+    f->Handle = null;
+    f->Stack  = null;
+}
+
+LSTD_END_NAMESPACE
+
+#endif
@@ -1,15 +1,451 @@
-#include "lstd/common.hpp"
+#include "lstd/internal/common.h"
 
-// @Platform
-// UNMAINTAINED
-// UNMAINTAINED
-// UNMAINTAINED
+#if OS != WINDOWS
 
-#if IS_OS_POSIX
+#include "lstd/internal/context.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
-#include <signal.h>
 #include <sched.h>
+#include <time.h>
 #include <unistd.h>
 
-#endif
\ No newline at end of file
+#if OS == LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+namespace thread {
+
+//
+// Futexes: sleep while *address == expected, wake up to _count_ sleepers.
+// Private - we don't share mutexes between processes, so the kernel can skip looking up the mapping.
+//
+#if OS == LINUX
+// Returns false if it timed out. The timeout is relative for FUTEX_WAIT.
+file_scope bool futex_wait(s32 *address, s32 expected, u32 timeoutMs = WAIT_FOREVER) {
+    timespec ts = {(time_t) (timeoutMs / 1000), (long) (timeoutMs % 1000) * 1000000};
+
+    long result = syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, timeoutMs == WAIT_FOREVER ? null : &ts, null, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+file_scope void futex_wake(s32 *address, s32 count) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, null, null, 0);
+}
+#else
+// @Platform No futex, we yield instead. Works, but waiters burn some CPU.
+// With a timeout we poll every millisecond until the value changes.
+file_scope bool futex_wait(s32 *address, s32 expected, u32 timeoutMs = WAIT_FOREVER) {
+    if (timeoutMs == WAIT_FOREVER) {
+        if (atomic_load(address) == expected) sched_yield();
+        return true;
+    }
+
+    For(range(timeoutMs)) {
+        if (atomic_load(address) != expected) return true;
+        sleep(1);
+    }
+    return atomic_load(address) != expected;
+}
+
+file_scope void futex_wake(s32 *, s32) {}
+#endif
+
+bool wait_on_address(s32 *address, s32 expected, u32 timeoutMs) { return futex_wait(address, expected, timeoutMs); }
+
+void wake_by_address_one(s32 *address) { futex_wake(address, 1); }
+
+void wake_by_address_all(s32 *address) { futex_wake(address, numeric_info<s32>::max()); }
+
+//
+// Mutexes:
+//
+// The classic three state futex mutex (Drepper, "Futexes Are Tricky"): 0 - unlocked, 1 - locked, 2 - locked with waiters.
+// Locking and unlocking without contention is one atomic instruction, no syscall. Unlocking only wakes someone up
+// if the state says there may be a sleeper.
+//
+// Before sleeping we spin a little, most critical sections are short and the owner is already on its way out.
+//
+constexpr s32 MUTEX_SPIN_COUNT = 100;
+
+void mutex::init(source_location loc) {
+    PlatformData.Posix.State = 0;
+    LOCK_PROFILE_INIT(Profile, loc, "mutex");
+}
+
+void mutex::release() {}
+
+void mutex::lock() {
+    s32 *state = &PlatformData.Posix.State;
+    LOCK_PROFILE_TRY(Profile, atomic_compare_and_swap(state, 1, 0) == 0);
+
+    For(range(MUTEX_SPIN_COUNT)) {
+        if (atomic_compare_and_swap(state, 1, 0) == 0) {
+            LOCK_PROFILE_WAITED(Profile);
+            return;
+        }
+        if (atomic_load(state) == 2) break;  // There are sleepers already, no point spinning
+    }
+
+    // Mark the mutex as contended, the owner will wake us when it unlocks.
+    // If the swap returns 0 the mutex was free and we got it (in the contended state, which costs one extra wake at most).
+    while (atomic_swap(state, 2) != 0) futex_wait(state, 2);
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+bool mutex::try_lock() { return atomic_compare_and_swap(&PlatformData.Posix.State, 1, 0) == 0; }
+
+void mutex::unlock() {
+    s32 *state = &PlatformData.Posix.State;
+    if (atomic_swap(state, 0) == 2) futex_wake(state, 1);
+}
+
+//
+// Reader/writer lock:
+//
+// _State_ says who holds it. Threads which can't get in sleep on _Sequence_, releasing bumps it and wakes
+// all sleepers (readers can all get in at once, so waking one isn't enough), who then compete again.
+// A sleeper reads _Sequence_ before checking _State_ one last time, so a release in between isn't lost.
+// _Sleepers_ lets releasing skip the syscall when nobody sleeps.
+//
+void shared_mutex::init(source_location loc) {
+    zero_memory(&PlatformData.Posix, sizeof(PlatformData.Posix));
+    LOCK_PROFILE_INIT(Profile, loc, "shared_mutex");
+}
+
+void shared_mutex::release() {}
+
+file_scope void shared_mutex_wake(shared_mutex *m) {
+    auto &p = m->PlatformData.Posix;
+    if (!atomic_load(&p.Sleepers)) return;
+
+    atomic_inc(&p.Sequence);
+    futex_wake(&p.Sequence, numeric_info<s32>::max());
+}
+
+// Spins a little and then sleeps until _try_ succeeds
+template <typename F>
+file_scope void shared_mutex_wait(shared_mutex *m, F try_) {
+    auto &p = m->PlatformData.Posix;
+
+    For(range(MUTEX_SPIN_COUNT)) {
+        if (try_()) return;
+        cpu_pause();
+    }
+
+    while (true) {
+        atomic_inc(&p.Sleepers);
+        s32 sequence = atomic_load(&p.Sequence);
+        if (try_()) {
+            atomic_add(&p.Sleepers, -1);
+            return;
+        }
+        futex_wait(&p.Sequence, sequence);
+        atomic_add(&p.Sleepers, -1);
+    }
+}
+
+bool shared_mutex::try_lock() { return atomic_compare_and_swap(&PlatformData.Posix.State, -1, 0) == 0; }
+
+void shared_mutex::lock() {
+    LOCK_PROFILE_TRY(Profile, try_lock());
+
+    auto &p = PlatformData.Posix;
+    atomic_inc(&p.WritersWaiting);
+    shared_mutex_wait(this, [this]() { return try_lock(); });
+    atomic_add(&p.WritersWaiting, -1);
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+void shared_mutex::unlock() {
+    atomic_swap(&PlatformData.Posix.State, 0);  // A full barrier, we read _Sleepers_ next
+    shared_mutex_wake(this);
+}
+
+bool shared_mutex::try_lock_shared() {
+    auto &p = PlatformData.Posix;
+    if (atomic_load(&p.WritersWaiting)) return false;
+
+    s32 state = atomic_load(&p.State);
+    return state >= 0 && atomic_compare_and_swap(&p.State, state + 1, state) == state;
+}
+
+void shared_mutex::lock_shared() {
+    LOCK_PROFILE_TRY(Profile, try_lock_shared());
+    shared_mutex_wait(this, [this]() { return try_lock_shared(); });
+    LOCK_PROFILE_WAITED(Profile);
+}
+
+void shared_mutex::unlock_shared() {
+    // The last reader out lets the writers in
+    if (atomic_add(&PlatformData.Posix.State, -1) == 1) shared_mutex_wake(this);
+}
+
+//
+// Thread:
+//
+
+void *thread::wrapper_function(void *data) {
+    auto *ti = (internal::thread_start_info *) data;
+
+    // There is no TLS callback like on Windows, so we set up the context here
+    internal::platform_init_context();
+    internal::thread_start_inherit_context(ti);
+
+    ti->Function(ti->UserData);
+
+    internal::thread_start_info_release(ti);
+
+    internal::platform_flush_persistent_allocator_cache();
+
+    return null;
+}
+
+void thread::init_and_launch(const owning_delegate<void(void *)> &function, void *userData, u32 inherit) {
+    auto *ti = internal::thread_start_info_acquire(function, userData, this, inherit);
+
+    pthread_t handle;
+    if (pthread_create(&handle, null, wrapper_function, ti) != 0) {
+        internal::thread_start_info_release(ti);
+        Handle = null;
+        return;
+    }
+    Handle = (void *) handle;
+}
+
+void thread::wait() {
+    assert(get_id() != Context.ThreadID);  // A thread cannot wait for itself!
+    pthread_join((pthread_t) Handle, null);
+}
+
+void thread::terminate() {
+    if (Handle) {
+        pthread_cancel((pthread_t) Handle);
+    }
+}
+
+::LSTD_NAMESPACE::thread::id thread::get_id() const {
+    return id((u64) Handle);  // Same as pthread_self() in the thread, see platform_init_context()
+}
+
+void sleep(u32 ms) {
+    if (!ms) {
+        sched_yield();
+        return;
+    }
+
+    timespec ts = {(time_t) (ms / 1000), (long) (ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+#if OS == LINUX
+file_scope bool set_thread_cpus(pthread_t handle, const cpu_set_t &cpus) { return pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpus) == 0; }
+
+file_scope bool set_thread_affinity(pthread_t handle, u32 processor) {
+    auto *t = os_get_cpu_topology();
+    if (processor >= t->ProcessorCount) return false;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(t->Processors[processor].Number, &cpus);
+    return set_thread_cpus(handle, cpus);
+}
+
+file_scope bool set_thread_numa_node_affinity(pthread_t handle, u32 node) {
+    auto *t = os_get_cpu_topology();
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    bool any = false;
+    For(range(t->ProcessorCount)) {
+        if (t->Processors[it].NumaNode != node) continue;
+        CPU_SET(t->Processors[it].Number, &cpus);
+        any = true;
+    }
+    return any && set_thread_cpus(handle, cpus);
+}
+
+file_scope bool set_thread_priority(pthread_t handle, priority p) {
+    sched_param param = {};
+
+    s32 policy = SCHED_OTHER;
+    if (p == priority::Lowest) policy = SCHED_IDLE;
+    if (p == priority::Low) policy = SCHED_BATCH;
+    if (p == priority::High || p == priority::Highest) {
+        policy = SCHED_RR;
+
+        s32 low = sched_get_priority_min(SCHED_RR), high = sched_get_priority_max(SCHED_RR);
+        param.sched_priority = p == priority::High ? low : (low + high) / 2;
+    }
+    return pthread_setschedparam(handle, policy, &param) == 0;
+}
+#else
+// @Platform Affinity needs thread_policy_set on macOS, not implemented
+file_scope bool set_thread_affinity(pthread_t, u32) { return false; }
+file_scope bool set_thread_numa_node_affinity(pthread_t, u32) { return false; }
+file_scope bool set_thread_priority(pthread_t, priority) { return false; }
+#endif
+
+bool thread::set_affinity(u32 processor) { return set_thread_affinity((pthread_t) Handle, processor); }
+bool thread::set_numa_node_affinity(u32 node) { return set_thread_numa_node_affinity((pthread_t) Handle, node); }
+bool thread::set_priority(priority p) { return set_thread_priority((pthread_t) Handle, p); }
+
+bool set_current_affinity(u32 processor) { return set_thread_affinity(pthread_self(), processor); }
+bool set_current_numa_node_affinity(u32 node) { return set_thread_numa_node_affinity(pthread_self(), node); }
+bool set_current_priority(priority p) { return set_thread_priority(pthread_self(), p); }
+
+}  // namespace thread
+
+u32 os_get_hardware_concurrency() { return (u32) sysconf(_SC_NPROCESSORS_ONLN); }
+
+namespace internal {
+
+#if OS == LINUX
+//
+// The topology is in sysfs, in small text files. We read them with plain syscalls into buffers on the stack,
+// this runs once and shouldn't depend on the allocators or the path module.
+//
+
+// Appends _str_ or the decimal _value_ to a path being built in _p_
+file_scope char *sys_path_append(char *p, const char *str) {
+    while (*str) *p++ = *str++;
+    *p = 0;
+    return p;
+}
+
+file_scope char *sys_path_append(char *p, u32 value) {
+    char digits[10];
+    s64 count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    while (count) *p++ = digits[--count];
+    *p = 0;
+    return p;
+}
+
+// Reads a whole (small) file into _buffer_ and null-terminates it. Returns false if it doesn't exist.
+file_scope bool sys_read(const char *path, char *buffer, s64 size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return false;
+
+    ssize_t n = read(fd, buffer, size - 1);
+    close(fd);
+    if (n < 0) return false;
+
+    buffer[n] = 0;
+    return true;
+}
+
+file_scope u32 sys_parse_u32(const char **p) {
+    u32 value = 0;
+    while (**p >= '0' && **p <= '9') value = value * 10 + (u32) (*(*p)++ - '0');
+    return value;
+}
+
+// Calls _f(cpu)_ for every CPU in a list like "0-3,8,10-11"
+template <typename F>
+file_scope void sys_for_each_cpu(const char *list, F &&f) {
+    const char *p = list;
+    while (*p >= '0' && *p <= '9') {
+        u32 first = sys_parse_u32(&p), last = first;
+        if (*p == '-') {
+            ++p;
+            last = sys_parse_u32(&p);
+        }
+        for (u32 cpu = first; cpu <= last; ++cpu) f(cpu);
+
+        if (*p != ',') break;
+        ++p;
+    }
+}
+
+// The first CPU in a list, used as the id of a group of CPUs which share something
+file_scope u32 sys_first_cpu(const char *path) {
+    char buffer[256];
+    if (!sys_read(path, buffer, sizeof(buffer))) return CPU_TOPOLOGY_UNKNOWN;
+
+    const char *p = buffer;
+    if (*p < '0' || *p > '9') return CPU_TOPOLOGY_UNKNOWN;
+    return sys_parse_u32(&p);
+}
+
+void platform_read_cpu_topology(cpu_topology *t) {
+    char path[128], buffer[256];
+
+    // Our index of every CPU number, -1 for offline (or past MAX_LOGICAL_PROCESSORS)
+    s64 indexOf[MAX_LOGICAL_PROCESSORS];
+    For(range(MAX_LOGICAL_PROCESSORS)) indexOf[it] = -1;
+
+    s64 configured = min((s64) sysconf(_SC_NPROCESSORS_CONF), MAX_LOGICAL_PROCESSORS);
+
+    t->ProcessorCount = 0;
+    For(range(configured)) {
+        auto cpu = (u32) it;
+
+        char *cpuDir = sys_path_append(sys_path_append(path, "/sys/devices/system/cpu/cpu"), cpu);
+
+        // cpu0 usually has no "online" file, it can't be taken offline
+        sys_path_append(cpuDir, "/online");
+        if (sys_read(path, buffer, sizeof(buffer)) && buffer[0] == '0') continue;
+
+        auto &p = t->Processors[t->ProcessorCount];
+        p       = {CPU_TOPOLOGY_UNKNOWN, CPU_TOPOLOGY_UNKNOWN, 0, CPU_TOPOLOGY_UNKNOWN, CPU_TOPOLOGY_UNKNOWN, 0, (u16) cpu};
+
+        sys_path_append(cpuDir, "/topology/thread_siblings_list");
+        p.Core = sys_first_cpu(path);
+
+        sys_path_append(cpuDir, "/topology/physical_package_id");
+        if (sys_read(path, buffer, sizeof(buffer)) && buffer[0] >= '0' && buffer[0] <= '9') {
+            const char *b = buffer;
+            p.Package     = sys_parse_u32(&b);
+        }
+
+        For_as(index, range(8)) {
+            char *cacheDir = sys_path_append(sys_path_append(cpuDir, "/cache/index"), (u32) index);
+
+            sys_path_append(cacheDir, "/type");
+            if (!sys_read(path, buffer, sizeof(buffer))) break;
+            if (buffer[0] == 'I') continue;  // Instruction, the data and unified ones tell who shares memory
+
+            sys_path_append(cacheDir, "/level");
+            if (!sys_read(path, buffer, sizeof(buffer))) continue;
+
+            sys_path_append(cacheDir, "/shared_cpu_list");
+            if (buffer[0] == '2') p.L2 = sys_first_cpu(path);
+            if (buffer[0] == '3') p.L3 = sys_first_cpu(path);
+        }
+
+        indexOf[cpu] = t->ProcessorCount++;
+    }
+
+    // Without NUMA support in the kernel there is no node directory and everything stays on node 0
+    For(range(MAX_LOGICAL_PROCESSORS)) {
+        auto node = (u32) it;
+        sys_path_append(sys_path_append(sys_path_append(path, "/sys/devices/system/node/node"), node), "/cpulist");
+        if (!sys_read(path, buffer, sizeof(buffer))) continue;
+
+        sys_for_each_cpu(buffer, [&](u32 cpu) {
+            if (cpu < MAX_LOGICAL_PROCESSORS && indexOf[cpu] != -1) t->Processors[indexOf[cpu]].NumaNode = node;
+        });
+    }
+}
+#else
+void platform_read_cpu_topology(cpu_topology *t) { t->ProcessorCount = 0; }  // @Platform Everything is guessed in thread.cpp
+#endif
+
+}  // namespace internal
+
+LSTD_END_NAMESPACE
+
+#endif
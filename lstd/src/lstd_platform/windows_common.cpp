@@ -4,6 +4,7 @@
 
 #include "lstd/io.h"
 #include "lstd/memory/guid.h"
+#include "lstd/random.h"
 #include "lstd/types/windows.h"  // Declarations of Win32 functions
 
 import path;
@@ -36,6 +37,25 @@ extern "C" bool lstd_init_global_stub() { return true; }
 
 LSTD_BEGIN_NAMESPACE
 
+//
+// The same trick as lstd_init_global lets you pick the starting sizes of the platform allocators at link time, without rebuilding lstd.
+// Define these in your executable and the linker takes yours, otherwise it uses the stubs, which return what
+// premake5.lua passes as PLATFORM_PERSISTENT_STORAGE_STARTING_SIZE and PLATFORM_TEMPORARY_STORAGE_STARTING_SIZE:
+//
+//     extern "C" s64 lstd_persistent_storage_starting_size() { return 64_KiB; }  // A small tool which allocates little
+//
+// The blocks are allocated the first time the platform allocators are used (not at startup), so a program which
+// never touches them never pays for them.
+//
+extern "C" s64 lstd_persistent_storage_starting_size_stub() { return PLATFORM_PERSISTENT_STORAGE_STARTING_SIZE; }
+extern "C" s64 lstd_temporary_storage_starting_size_stub() { return PLATFORM_TEMPORARY_STORAGE_STARTING_SIZE; }
+#pragma comment(linker, "/ALTERNATENAME:lstd_persistent_storage_starting_size=lstd_persistent_storage_starting_size_stub")
+#pragma comment(linker, "/ALTERNATENAME:lstd_temporary_storage_starting_size=lstd_temporary_storage_starting_size_stub")
+
+// Return true to record the startup with the profiler, see :StartupProfile: in os.win64.common
+extern "C" bool lstd_profile_startup_stub() { return false; }
+#pragma comment(linker, "/ALTERNATENAME:lstd_profile_startup=lstd_profile_startup_stub")
+
 void win64_crash_handler_init();
 
 // If we are building with NO CRT we call these functions in our entry point - main_no_crt.
@@ -84,20 +104,26 @@ __declspec(allocate(".CRT$XPU")) cb *lstd_preterm = pre_termination;
 #endif
 #endif
 
-guid guid_new() {
-    GUID g;
-    CoCreateGuid(&g);
-
-    auto data = to_stack_array((byte)((g.Data1 >> 24) & 0xFF), (byte)((g.Data1 >> 16) & 0xFF),
-                               (byte)((g.Data1 >> 8) & 0xFF), (byte)((g.Data1) & 0xff),
-
-                               (byte)((g.Data2 >> 8) & 0xFF), (byte)((g.Data2) & 0xff),
+// For rng_seed_os() (see random.h). CoCreateGuid gives us 122 random bits from the system's generator per call.
+void internal::platform_random_bytes(byte *dest, s64 count) {
+    while (count > 0) {
+        GUID g;
+        CoCreateGuid(&g);
+
+        s64 n = min(count, (s64) sizeof(GUID));
+        copy_memory(dest, &g, n);
+        dest += n;
+        count -= n;
+    }
+}
 
-                               (byte)((g.Data3 >> 8) & 0xFF), (byte)((g.Data3) & 0xFF),
+// FILETIME counts 100 nanosecond intervals since 1601-01-01
+u64 internal::platform_unix_time_ms() {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
 
-                               (byte) g.Data4[0], (byte) g.Data4[1], (byte) g.Data4[2], (byte) g.Data4[3],
-                               (byte) g.Data4[4], (byte) g.Data4[5], (byte) g.Data4[6], (byte) g.Data4[7]);
-    return guid(data);
+    u64 ticks = (u64) ft.dwHighDateTime << 32 | ft.dwLowDateTime;
+    return (ticks - 116444736000000000ull) / 10000;
 }
 
 LSTD_END_NAMESPACE
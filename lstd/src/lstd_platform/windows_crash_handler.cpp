@@ -15,17 +15,22 @@ LSTD_BEGIN_NAMESPACE
 
 file_scope DWORD MachineType;
 
-// @TODO: Factor the stack walking part of this function into a os_get_call_stack() which can be used anywhere in the program.
-
-file_scope LONG exception_filter(LPEXCEPTION_POINTERS e) {
-    u32 exceptionCode = e->ExceptionRecord->ExceptionCode;
-
-    HANDLE hProcess = INVALID_HANDLE_VALUE;
-    defer(SymCleanup(hProcess));
-
-    if (!SymInitialize(GetCurrentProcess(), null, true)) return EXCEPTION_EXECUTE_HANDLER;
+// DbgHelp functions are not thread-safe. We initialize the symbol handler once and never clean it up,
+// since resolving is usually done many times in a row.
+file_scope thread::fast_mutex SymMutex;
+file_scope bool SymInitialized = false;
+
+// Expects _SymMutex_ to be held
+file_scope bool sym_init() {
+    if (!SymInitialized) SymInitialized = SymInitialize(GetCurrentProcess(), null, true);
+    return SymInitialized;
+}
 
-    auto c = e->ContextRecord;
+// Walks the stack at the point of the exception (not the stack of the handler, which is what
+// os_capture_call_stack() would see). Only the addresses, we resolve them after the walk.
+file_scope s64 walk_exception_stack(CONTEXT *c, void **frames, s64 maxFrames) {
+    thread::scoped_lock<thread::fast_mutex> _(&SymMutex);
+    if (!sym_init()) return 0;
 
     STACKFRAME64 sf;
     fill_memory(&sf, 0, sizeof(STACKFRAME64));
@@ -37,43 +42,25 @@ file_scope LONG exception_filter(LPEXCEPTION_POINTERS e) {
     sf.AddrStack.Mode = AddrModeFlat;
     sf.AddrFrame.Mode = AddrModeFlat;
 
-    array<os_function_call> callStack;
-
-    while (StackWalk64(MachineType, GetCurrentProcess(), GetCurrentThread(), &sf, c, 0, SymFunctionTableAccess64, SymGetModuleBase64, null)) {
-        if (sf.AddrFrame.Offset == 0 || callStack.Count >= CALLSTACK_DEPTH) break;
+    // StackWalk64 may modify the context
+    CONTEXT context = *c;
 
-        constexpr auto s = (sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR) + sizeof(ULONG64) - 1) / sizeof(ULONG64);
-        ULONG64 symbolBuffer[s];
-
-        PSYMBOL_INFO symbol = (PSYMBOL_INFO) symbolBuffer;
-        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-        symbol->MaxNameLen = MAX_SYM_NAME;
-
-        os_function_call call;
-
-        DWORD64 symDisplacement = 0;
-        if (SymFromAddr(hProcess, sf.AddrPC.Offset, &symDisplacement, symbol)) {
-            call.Name = string(symbol->Name);
-            if (call.Name.Length == 0) {
-                free(call.Name);
-                call.Name = "UnknownFunction";
-            }
-        }
+    s64 count = 0;
+    while (count < maxFrames && StackWalk64(MachineType, GetCurrentProcess(), GetCurrentThread(), &sf, &context, 0, SymFunctionTableAccess64, SymGetModuleBase64, null)) {
+        if (sf.AddrFrame.Offset == 0) break;
+        frames[count++] = (void *) sf.AddrPC.Offset;
+    }
+    return count;
+}
 
-        IMAGEHLP_LINEW64 lineInfo = {sizeof(IMAGEHLP_LINEW64)};
+file_scope LONG exception_filter(LPEXCEPTION_POINTERS e) {
+    u32 exceptionCode = e->ExceptionRecord->ExceptionCode;
 
-        DWORD lineDisplacement = 0;
-        if (SymGetLineFromAddrW64(hProcess, sf.AddrPC.Offset, &lineDisplacement, &lineInfo)) {
-            call.File = internal::platform_utf16_to_utf8(lineInfo.FileName, internal::platform_get_persistent_allocator());
-            if (call.File.Length == 0) {
-                free(call.File);
-                call.File = "UnknownFile";
-            }
-            call.LineNumber = lineInfo.LineNumber;
-        }
+    void *frames[CALLSTACK_DEPTH];
+    s64 frameCount = walk_exception_stack(e->ContextRecord, frames, CALLSTACK_DEPTH);
 
-        array_append(callStack, call);
-    }
+    array<os_function_call> callStack;
+    For(range(frameCount)) array_append(callStack, os_resolve_function_call(frames[it]));
 
 #define CODE_DESCR(code) \
     if (exceptionCode = code) desc = #code
@@ -119,6 +106,44 @@ file_scope LONG exception_filter(LPEXCEPTION_POINTERS e) {
     return EXCEPTION_EXECUTE_HANDLER;
 }
 
+s64 os_capture_call_stack(void **frames, s64 maxFrames, s64 framesToSkip) {
+    // Skip this function as well
+    return RtlCaptureStackBackTrace((DWORD) framesToSkip + 1, (DWORD) maxFrames, frames, null);
+}
+
+os_function_call os_resolve_function_call(void *address) {
+    thread::scoped_lock<thread::fast_mutex> _(&SymMutex);
+    sym_init();
+
+    HANDLE hProcess = GetCurrentProcess();
+
+    os_function_call call;
+
+    constexpr auto s = (sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR) + sizeof(ULONG64) - 1) / sizeof(ULONG64);
+    ULONG64 symbolBuffer[s];
+
+    PSYMBOL_INFO symbol = (PSYMBOL_INFO) symbolBuffer;
+    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    symbol->MaxNameLen = MAX_SYM_NAME;
+
+    DWORD64 symDisplacement = 0;
+    if (SymInitialized && SymFromAddr(hProcess, (DWORD64) address, &symDisplacement, symbol)) {
+        clone(&call.Name, string(symbol->Name));
+    }
+    if (call.Name.Length == 0) clone(&call.Name, string("UnknownFunction"));
+
+    IMAGEHLP_LINEW64 lineInfo = {sizeof(IMAGEHLP_LINEW64)};
+
+    DWORD lineDisplacement = 0;
+    if (SymInitialized && SymGetLineFromAddrW64(hProcess, (DWORD64) address, &lineDisplacement, &lineInfo)) {
+        call.File = internal::platform_utf16_to_utf8(lineInfo.FileName, Context.Alloc);
+        call.LineNumber = lineInfo.LineNumber;
+    }
+    if (call.File.Length == 0) clone(&call.File, string("UnknownFile"));
+
+    return call;
+}
+
 void win64_crash_handler_init() {
     const DWORD bufferSize = 65535;
     utf16 buffer[bufferSize];
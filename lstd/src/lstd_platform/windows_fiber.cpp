@@ -0,0 +1,52 @@
+#include "lstd/internal/common.h"
+
+#if OS == WINDOWS
+
+#include "lstd/fiber.h"
+#include "lstd/types/windows.h"  // Declarations of Win32 functions
+
+import os;
+
+LSTD_BEGIN_NAMESPACE
+
+void fiber_convert_thread(fiber *f) {
+    f->Handle = ConvertThreadToFiber(f);
+    if (!f->Handle) windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "ConvertThreadToFiber");
+    f->IsThread = true;
+}
+
+void fiber_revert_thread(fiber *f) {
+    assert(f->IsThread);
+    WIN_CHECKBOOL(ConvertFiberToThread());
+    f->Handle = null;
+}
+
+file_scope void __stdcall fiber_start(void *data) {
+    auto *f = (fiber *) data;
+    f->Function(f->UserData);
+    assert(false && "A fiber function returned, switch to another fiber instead");
+}
+
+bool fiber_create(fiber *f, const delegate<void(void *)> &function, void *userData, s64 stackSize) {
+    f->Function  = function;
+    f->UserData  = userData;
+    f->StackSize = stackSize;
+
+    f->Handle = CreateFiber(stackSize, fiber_start, f);
+    if (!f->Handle) {
+        windows_report_hresult_error(HRESULT_FROM_WIN32(GetLastError()), "CreateFiber");
+        return false;
+    }
+    return true;
+}
+
+void fiber_release(fiber *f) {
+    if (f->Handle && !f->IsThread) DeleteFiber(f->Handle);
+    f->Handle = null;
+}
+
+void fiber_switch(fiber *from, fiber *to) { SwitchToFiber(to->Handle); }
+
+LSTD_END_NAMESPACE
+
+#endif
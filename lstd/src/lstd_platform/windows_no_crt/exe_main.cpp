@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "lstd/internal/context.h"
+#include "lstd/profiler.h"
 #include "lstd/types/windows.h"  // For definitions
 
 import os;
@@ -164,12 +165,16 @@ extern "C" void main_no_crt() {
     LSTD_NAMESPACE::internal::platform_init_global_state();
     LSTD_NAMESPACE::win64_crash_handler_init();
 
-    // These call the tables that the linker has filled with initialization routines for global variables
-    if (lstd_initterm_e(__xi_a, __xi_z) != 0) {
-        debug_break();
-        return;
+    // These call the tables that the linker has filled with initialization routines for global variables.
+    // Recorded if the startup is being profiled (see :StartupProfile: in os.win64.common).
+    {
+        PROFILE_ZONE("global initializers");
+        if (lstd_initterm_e(__xi_a, __xi_z) != 0) {
+            debug_break();
+            return;
+        }
+        lstd_initterm(__xc_a, __xc_z);
     }
-    lstd_initterm(__xc_a, __xc_z);
 
     // Defined in tls.cpp.
     extern bool __cdecl __scrt_is_nonwritable_in_current_image(void const *const target);
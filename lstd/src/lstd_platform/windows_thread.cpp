@@ -11,169 +11,92 @@ LSTD_BEGIN_NAMESPACE
 
 namespace thread {
 
-// Block the calling thread until a lock on the mutex can
-// be obtained. The mutex remains locked until unlock() is called.
-void fast_mutex::lock() {
-    while (!try_lock()) sleep(0);
+// WaitOnAddress compares and sleeps atomically, a wake between our check and the sleep isn't lost.
+// It spins a little in user mode before going to the kernel, and a wake with nobody sleeping is cheap.
+bool wait_on_address(s32 *address, s32 expected, u32 timeoutMs) {
+    if (WaitOnAddress(address, &expected, sizeof(s32), timeoutMs)) return true;
+    return GetLastError() != ERROR_TIMEOUT;
 }
 
-//
-// Mutexes:
-//
-void mutex::init() { InitializeCriticalSection((CRITICAL_SECTION *) PlatformData.Win32.Handle); }
+void wake_by_address_one(s32 *address) { WakeByAddressSingle(address); }
 
-void mutex::release() {
-    auto *p = (CRITICAL_SECTION *) PlatformData.Win32.Handle;
-    if (p) DeleteCriticalSection(p);
-}
-
-void mutex::lock() {
-    EnterCriticalSection((CRITICAL_SECTION *) PlatformData.Win32.Handle);
-}
-
-bool mutex::try_lock() {
-    return TryEnterCriticalSection((CRITICAL_SECTION *) PlatformData.Win32.Handle);
-}
-
-void mutex::unlock() {
-    LeaveCriticalSection((CRITICAL_SECTION *) PlatformData.Win32.Handle);
-}
+void wake_by_address_all(s32 *address) { WakeByAddressAll(address); }
 
 //
-// Condition variable:
+// Mutexes:
 //
+// SRW locks instead of critical sections: one pointer instead of 40 bytes, nothing to delete, and the
+// uncontended paths are a single interlocked instruction. Unlike critical sections they aren't recursive.
+static_assert(sizeof(SRWLOCK) == sizeof(void *));
 
-struct CV_Data {
-    // Signal and broadcast event HANDLEs.
-    HANDLE Events[2];
-
-    // Count of the number of waiters.
-    u32 WaitersCount;
-
-    // Serialize access to mWaitersCount.
-    CRITICAL_SECTION WaitersCountLock;
-};
-
-#define _CONDITION_EVENT_ONE 0
-#define _CONDITION_EVENT_ALL 1
+void mutex::init(source_location loc) {
+    InitializeSRWLock((SRWLOCK *) &PlatformData.Win32.Lock);
+    LOCK_PROFILE_INIT(Profile, loc, "mutex");
+}
 
-void condition_variable::init() {
-    auto *data = (CV_Data *) Handle;
+void mutex::release() {}
 
-    data->Events[_CONDITION_EVENT_ONE] = CreateEventW(null, 0, 0, null);
-    data->Events[_CONDITION_EVENT_ALL] = CreateEventW(null, 1, 0, null);
-    InitializeCriticalSection(&data->WaitersCountLock);
+void mutex::lock() {
+    LOCK_PROFILE_TRY(Profile, TryAcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock));
+    AcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock);
+    LOCK_PROFILE_WAITED(Profile);
 }
 
-void condition_variable::release() {
-    auto *data = (CV_Data *) Handle;
-    if (data) {
-        CloseHandle(data->Events[_CONDITION_EVENT_ONE]);
-        CloseHandle(data->Events[_CONDITION_EVENT_ALL]);
-        DeleteCriticalSection(&data->WaitersCountLock);
-    }
-}
+bool mutex::try_lock() { return TryAcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock); }
 
-void condition_variable::pre_wait() {
-    auto *data = (CV_Data *) Handle;
+void mutex::unlock() { ReleaseSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock); }
 
-    // Increment number of waiters
-    EnterCriticalSection(&data->WaitersCountLock);
-    ++data->WaitersCount;
-    LeaveCriticalSection(&data->WaitersCountLock);
+void shared_mutex::init(source_location loc) {
+    InitializeSRWLock((SRWLOCK *) &PlatformData.Win32.Lock);
+    LOCK_PROFILE_INIT(Profile, loc, "shared_mutex");
 }
 
-void condition_variable::do_wait() {
-    auto *data = (CV_Data *) Handle;
+void shared_mutex::release() {}
 
-    // Wait for either event to become signaled due to notify_one() or notify_all() being called
-    s32 result = WaitForMultipleObjects(2, data->Events, 0, INFINITE);
-
-    // Check if we are the last waiter
-    EnterCriticalSection(&data->WaitersCountLock);
-    --data->WaitersCount;
-    bool lastWaiter = (result == (WAIT_OBJECT_0 + _CONDITION_EVENT_ALL)) && (data->WaitersCount == 0);
-    LeaveCriticalSection(&data->WaitersCountLock);
-
-    // If we are the last waiter to be notified to stop waiting, reset the event
-    if (lastWaiter) ResetEvent(data->Events[_CONDITION_EVENT_ALL]);
+void shared_mutex::lock() {
+    LOCK_PROFILE_TRY(Profile, TryAcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock));
+    AcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock);
+    LOCK_PROFILE_WAITED(Profile);
 }
 
-void condition_variable::notify_one() {
-    auto *data = (CV_Data *) Handle;
+bool shared_mutex::try_lock() { return TryAcquireSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock); }
 
-    // Are there any waiters?
-    EnterCriticalSection(&data->WaitersCountLock);
-    bool haveWaiters = (data->WaitersCount > 0);
-    LeaveCriticalSection(&data->WaitersCountLock);
+void shared_mutex::unlock() { ReleaseSRWLockExclusive((SRWLOCK *) &PlatformData.Win32.Lock); }
 
-    // If we have any waiting threads, send them a signal
-    if (haveWaiters) SetEvent(data->Events[_CONDITION_EVENT_ONE]);
+void shared_mutex::lock_shared() {
+    LOCK_PROFILE_TRY(Profile, TryAcquireSRWLockShared((SRWLOCK *) &PlatformData.Win32.Lock));
+    AcquireSRWLockShared((SRWLOCK *) &PlatformData.Win32.Lock);
+    LOCK_PROFILE_WAITED(Profile);
 }
 
-void condition_variable::notify_all() {
-    auto *data = (CV_Data *) Handle;
-
-    // Are there any waiters?
-    EnterCriticalSection(&data->WaitersCountLock);
-    bool haveWaiters = (data->WaitersCount > 0);
-    LeaveCriticalSection(&data->WaitersCountLock);
+bool shared_mutex::try_lock_shared() { return TryAcquireSRWLockShared((SRWLOCK *) &PlatformData.Win32.Lock); }
 
-    // If we have any waiting threads, send them a signal
-    if (haveWaiters) SetEvent(data->Events[_CONDITION_EVENT_ALL]);
-}
+void shared_mutex::unlock_shared() { ReleaseSRWLockShared((SRWLOCK *) &PlatformData.Win32.Lock); }
 
 //
 // Thread:
 //
 
-// Information to pass to the new thread (what to run).
-struct thread_start_info {
-    delegate<void(void *)> Function;
-    void *UserData = null;
-
-    thread *ThreadPtr = null;
-
-    // We have to make sure the module the thread is executing in
-    // doesn't get unloaded while the thread is still doing work.
-    // The CRT usually does that for us but we avoid using the CRT.
-    HMODULE Module = null;
-
-    // Pointer to the implicit context in the "parent" thread.
-    // We copy its members to the newly created thread.
-    const context *ContextPtr = null;
-};
-
 u32 __stdcall thread::wrapper_function(void *data) {
-    auto *ti = (thread_start_info *) data;
-
-    // Initialize the default context for a new thread
-    // win64_common_init_context();
-    // The context has been initialized already (see tls_init in windows_common.cpp).
-
-    // @TODO: Make this optional:
-    // Now we copy the context variables from the parent thread
-    s64 firstByte = offset_of(context, TempAlloc) + sizeof(context::TempAlloc);
-    copy_memory((byte *) &Context + firstByte, (byte *) ti->ContextPtr + firstByte, sizeof(context) - firstByte);
-
-    // If the parent thread was using the temporary allocator, set the new thread to also use the temporary allocator,
-    // but it needs to point to its own temp data (otherwise we are not thread-safe).
-    if (ti->ContextPtr->Alloc == ti->ContextPtr->TempAlloc) {
-        auto newContext = Context;
-        newContext.Alloc = Context.TempAlloc;
-        OVERRIDE_CONTEXT(newContext);
-    }
+    auto *ti = (internal::thread_start_info *) data;
+
+    // The context has been initialized already with the defaults (see tls_init in windows_common.cpp),
+    // now we copy what the parent asked for.
+    internal::thread_start_inherit_context(ti);
 
     ti->Function(ti->UserData);  // Call the thread function with the user data
 
-    // Do we need this?
-    // CloseHandle(ti->ThreadPtr->Handle);
+    // Read before the record goes back to the pool, another launch may take it right away
+    auto module = (HMODULE) ti->Module;
+    internal::thread_start_info_release(ti);
 
-    free(ti);
+    // Give back the blocks this thread has cached from the persistent allocator
+    internal::platform_flush_persistent_allocator_cache();
 
 #if defined LSTD_NO_CRT
+    // ExitThread doesn't return, so the module has to be released by the same call
+    if (module) FreeLibraryAndExitThread(module, 0);
     ExitThread(0);
-    if (ti->Module) FreeLibrary(ti->Module);
 #else
     _endthreadex(0);
 #endif
@@ -181,19 +104,14 @@ u32 __stdcall thread::wrapper_function(void *data) {
     return 0;
 }
 
-void thread::init_and_launch(const delegate<void(void *)> &function, void *userData) {
-    // Passed to the thread wrapper, which will eventually free it
-    // @TODO @Speed @Memory Fragmentation! We should have a dedicated pool allocator for thread_start_info 
-    // because threads could be created/destroyed very often.
-    auto *ti = allocate<thread_start_info>({.Alloc = internal::platform_get_persistent_allocator()});
-    ti->Function = function;
-    ti->UserData = userData;
-    ti->ThreadPtr = this;
-    ti->ContextPtr = &Context;
+void thread::init_and_launch(const owning_delegate<void(void *)> &function, void *userData, u32 inherit) {
+    // Passed to the thread wrapper, which puts it back in the pool when the thread is done
+    auto *ti = internal::thread_start_info_acquire(function, userData, this, inherit);
 
 #if defined LSTD_NO_CRT
-    // Create the thread
-    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR) wrapper_function, &ti->Module);
+    // We have to make sure the module the thread is executing in doesn't get unloaded
+    // while the thread is still doing work. The CRT usually does that for us but we avoid using the CRT.
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR) wrapper_function, (HMODULE *) &ti->Module);
     auto handle = CreateThread(null, 0, (LPTHREAD_START_ROUTINE) wrapper_function, ti, 0, (DWORD *) &Win32ThreadId);
 #else
     auto handle = _beginthreadex(null, 0, wrapper_function, ti, 0, &Win32ThreadId);
@@ -201,8 +119,11 @@ void thread::init_and_launch(const delegate<void(void *)> &function, void *userD
     Handle = (void *) handle;
 
     if (!handle || (void *) handle == INVALID_HANDLE_VALUE) {
-        // We free this directly since thread wrapper never even ran
-        free(ti);
+        // The thread wrapper never ran
+#if defined LSTD_NO_CRT
+        if (ti->Module) FreeLibrary((HMODULE) ti->Module);
+#endif
+        internal::thread_start_info_release(ti);
     }
 }
 
@@ -224,14 +145,134 @@ void thread::terminate() {
 
 void sleep(u32 ms) { Sleep((DWORD) ms); }
 
+file_scope bool set_thread_affinity(HANDLE handle, u32 processor) {
+    auto *t = os_get_cpu_topology();
+    if (processor >= t->ProcessorCount) return false;
+
+    auto &p              = t->Processors[processor];
+    GROUP_AFFINITY mask = {};
+    mask.Mask           = 1ull << p.Number;
+    mask.Group          = p.Group;
+    return SetThreadGroupAffinity(handle, &mask, null);
+}
+
+file_scope bool set_thread_numa_node_affinity(HANDLE handle, u32 node) {
+    // A node with processors in more than one group only gives its first group here, a thread can't span groups anyway
+    GROUP_AFFINITY mask = {};
+    if (!GetNumaNodeProcessorMaskEx((WORD) node, &mask) || !mask.Mask) return false;
+    return SetThreadGroupAffinity(handle, &mask, null);
+}
+
+file_scope bool set_thread_priority(HANDLE handle, priority p) {
+    s32 values[] = {THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_HIGHEST};
+    return SetThreadPriority(handle, values[(s32) p]);
+}
+
+bool thread::set_affinity(u32 processor) { return set_thread_affinity(Handle, processor); }
+bool thread::set_numa_node_affinity(u32 node) { return set_thread_numa_node_affinity(Handle, node); }
+bool thread::set_priority(priority p) { return set_thread_priority(Handle, p); }
+
+bool set_current_affinity(u32 processor) { return set_thread_affinity(GetCurrentThread(), processor); }
+bool set_current_numa_node_affinity(u32 node) { return set_thread_numa_node_affinity(GetCurrentThread(), node); }
+bool set_current_priority(priority p) { return set_thread_priority(GetCurrentThread(), p); }
+
 }  // namespace thread
 
 u32 os_get_hardware_concurrency() {
-    SYSTEM_INFO si;
-    GetSystemInfo(&si);
-    return (u32) si.dwNumberOfProcessors;
+    // GetSystemInfo only counts the processors in our group (at most 64)
+    return (u32) GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+namespace internal {
+
+// Calls _f(index)_ for every processor in _mask_, _groupStart_ is where each group starts in our numbering
+template <typename F>
+file_scope void for_each_processor(const GROUP_AFFINITY &mask, const s64 *groupStart, s64 groupCount, F &&f) {
+    if (mask.Group >= groupCount) return;
+    For(range(64)) {
+        if (!(mask.Mask & (1ull << it))) continue;
+
+        s64 index = groupStart[mask.Group] + it;
+        if (index < MAX_LOGICAL_PROCESSORS) f(index);
+    }
+}
+
+void platform_read_cpu_topology(cpu_topology *t) {
+    // Processors are numbered group by group (the bits in a group's mask are contiguous)
+    s64 groupStart[64];
+    s64 groupCount = min((s64) GetActiveProcessorGroupCount(), (s64) 64);
+
+    s64 count = 0;
+    For(range(groupCount)) {
+        groupStart[it] = count;
+
+        s64 inGroup = GetActiveProcessorCount((WORD) it);
+        For_as(n, range(inGroup)) {
+            if (count + n >= MAX_LOGICAL_PROCESSORS) break;
+            t->Processors[count + n] = {CPU_TOPOLOGY_UNKNOWN, 0, 0, CPU_TOPOLOGY_UNKNOWN, CPU_TOPOLOGY_UNKNOWN, (u16) it, (u16) n};
+        }
+        count += inGroup;
+    }
+    t->ProcessorCount = min(count, MAX_LOGICAL_PROCESSORS);
+
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationAll, null, &size);
+    if (!size) return;
+
+    auto *buffer = (byte *) os_allocate_block(size);
+    defer(os_free_block(buffer));
+
+    if (!GetLogicalProcessorInformationEx(RelationAll, (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *) buffer, &size)) return;
+
+    u32 cores = 0, packages = 0, caches = 0;
+    for (DWORD offset = 0; offset < size;) {
+        auto *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *) (buffer + offset);
+        offset += info->Size;
+
+        if (info->Relationship == RelationProcessorCore || info->Relationship == RelationProcessorPackage) {
+            bool core = info->Relationship == RelationProcessorCore;
+            u32 id    = core ? cores++ : packages++;
+
+            For(range(info->Processor.GroupCount)) {
+                for_each_processor(info->Processor.GroupMask[it], groupStart, groupCount, [&](s64 index) {
+                    if (core) {
+                        t->Processors[index].Core = id;
+                    } else {
+                        t->Processors[index].Package = id;
+                    }
+                });
+            }
+        } else if (info->Relationship == RelationNumaNode) {
+            auto &node = info->NumaNode;
+
+            // Before Windows 11 there is one mask and GroupCount is 0
+            s64 masks = max((s64) node.GroupCount, (s64) 1);
+            For(range(masks)) {
+                for_each_processor((&node.GroupMask)[it], groupStart, groupCount, [&](s64 index) { t->Processors[index].NumaNode = node.NodeNumber; });
+            }
+        } else if (info->Relationship == RelationCache) {
+            auto &cache = info->Cache;
+            if (cache.Type == 1) continue;  // Instruction caches, the data and unified ones tell who shares memory
+            if (cache.Level != 2 && cache.Level != 3) continue;
+
+            u32 id = caches++;
+
+            s64 masks = max((s64) cache.GroupCount, (s64) 1);
+            For(range(masks)) {
+                for_each_processor((&cache.GroupMask)[it], groupStart, groupCount, [&](s64 index) {
+                    if (cache.Level == 2) {
+                        t->Processors[index].L2 = id;
+                    } else {
+                        t->Processors[index].L3 = id;
+                    }
+                });
+            }
+        }
+    }
 }
 
+}  // namespace internal
+
 LSTD_END_NAMESPACE
 
 #endif
\ No newline at end of file
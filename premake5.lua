@@ -29,6 +29,15 @@ function common_settings()
 	
 	-- Uncomment this to use a custom namespace name for the library
 	-- defines { "LSTD_NAMESPACE=my_lstd" }
+
+	-- Uncomment this to count acquisitions, contention and wait times of every lock (see :LockProfiling: in thread.h)
+	-- defines { "LSTD_LOCK_PROFILING" }
+
+	-- Uncomment this to record PROFILE_ZONE timings (see :Profiler: in profiler.h)
+	-- defines { "LSTD_PROFILER" }
+
+	-- Uncomment this to use the 256 bit simd<> specializations (see simd_avx.h). The binary then needs a CPU with AVX2 and FMA.
+	-- vectorextensions "AVX2"
 	
     
     includedirs { "%{prj.name}/src" }
@@ -36,18 +45,18 @@ function common_settings()
         systemversion "latest"
         buildoptions { "/utf-8" }
         
-        excludes "%{prj.name}/**/posix_*.cpp"
+        excludes { "%{prj.name}/**/posix_*.cpp", "%{prj.name}/**/os.posix.*.ixx", "%{prj.name}/**/path.posix.ixx" }
 
         -- We need _CRT_SUPPRESS_RESTRICT for some dumb reason
         defines { "LSTD_NO_CRT", "NOMINMAX", "WIN32_LEAN_AND_MEAN", "_CRT_SUPPRESS_RESTRICT" } 
     
         buildoptions { "/Gs9999999" }
         
-        links { "dwmapi.lib", "dbghelp.lib" }
+        links { "dwmapi.lib", "dbghelp.lib", "synchronization.lib", "ws2_32.lib" }
         flags { "OmitDefaultLibrary", "NoRuntimeChecks", "NoBufferSecurityCheck" }
     filter { "system:windows", "not kind:StaticLib" }
         linkoptions { "/nodefaultlib", "/subsystem:windows", "/stack:\"0x100000\",\"0x100000\"" }
-        links { "kernel32", "shell32", "winmm", "ole32" }
+        links { "kernel32", "shell32", "winmm", "ole32", "advapi32" }
         
     -- Setup entry point
     filter { "system:windows", "kind:SharedLib" }
@@ -55,6 +64,10 @@ function common_settings()
     filter { "system:windows", "kind:ConsoleApp or WindowedApp" }
         entrypoint "main_no_crt"
 
+    filter "system:not windows"
+        excludes { "%{prj.name}/**/windows_*.cpp", "%{prj.name}/**/windows_no_crt/**", "%{prj.name}/**/os.win64.*.ixx", "%{prj.name}/**/path.nt.ixx" }
+        links { "pthread", "dl" }
+
     -- Setup configurations and optimization level
     filter "configurations:Debug"
         defines "DEBUG"
@@ -98,6 +111,9 @@ project "lstd"
     -- Note: Feel free to modify the library source code however you like. We just try to be as general as possible.
     --
     -- (KiB and MiB are literal operators that are defined in the library, 1_KiB = 1024, 1_MiB = 1024 * 1024)
+    --
+    -- These are only the defaults, an executable can pick its own sizes at link time by defining
+    -- lstd_persistent_storage_starting_size() / lstd_temporary_storage_starting_size() (see windows_common.cpp).
     defines { "PLATFORM_TEMPORARY_STORAGE_STARTING_SIZE=16_KiB", "PLATFORM_PERSISTENT_STORAGE_STARTING_SIZE=1_MiB" }
 	
     common_settings()
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "test.h"
+
+//
+// Micro benchmarks. They live in benchmarks/ and get registered by build_tests.py exactly like tests do
+// (into build_benchmark_table() in build_test_table.cpp). Run the test suite with --bench to run them instead of the tests.
+//
+//     BENCHMARK(array_append) {
+//         For(range(state->Iterations)) {
+//             ...
+//             do_not_optimize(result);
+//         }
+//     }
+//
+// The runner picks _Iterations_ so that a call takes at least a millisecond, calls the benchmark for a while to
+// warm up the caches and the branch predictors, then times a number of calls (samples) and reports the median,
+// the 99th percentile, the mean and the standard deviation of the time per iteration (see benchmarks/runner.cpp).
+//
+// Setup which shouldn't be measured goes between state->pause() and state->resume(). Set _BytesPerIteration_
+// to get the throughput too.
+//
+// Command line options:
+//     --bench                  Run the benchmarks (and the allocator benchmarks)
+//     --bench-filter=<text>    Only run benchmarks whose "file/name" contains <text>
+//     --bench-json=<path>      Also write the results as JSON
+//     --bench-csv=<path>       Also write the results as CSV (one row per benchmark, with a header)
+//
+
+struct benchmark_state {
+    s64 Iterations = 1;         // Run the measured code this many times
+    s64 BytesPerIteration = 0;  // If set, the results have a throughput
+
+    s64 PausedNs = 0;  // Excluded from the measurement
+    s64 PauseStart = 0;
+
+    void pause() { PauseStart = os_get_timestamp_ns(); }
+    void resume() { PausedNs += os_get_timestamp_ns() - PauseStart; }
+};
+
+using benchmark_func = void (*)(benchmark_state *state);
+
+struct benchmark {
+    string Name;
+    benchmark_func Function = null;
+};
+
+// Same as g_TestTable, key is a file
+inline hash_table<string, array<benchmark>> g_BenchmarkTable;
+
+void build_benchmark_table();
+
+// @Volatile: The identifier must match the one in build_tests.py
+#define BENCHMARK(name) void bench_##name(benchmark_state *state)
+
+struct benchmark_options {
+    string Filter;
+    string JsonPath;
+    string CsvPath;
+};
+
+void run_benchmarks(const benchmark_options &options);
+
+//
+// Keep the compiler from removing work whose result is otherwise unused, or from hoisting it out of the loop.
+//
+// do_not_optimize(value) makes the compiler think _value_ is read (and its memory may be written).
+// clobber_memory() makes it think all memory may be read and written, so stores before it have to happen.
+//
+
+// Defined in benchmarks/runner.cpp, the compiler can't see what it does with the pointer
+void benchmark_use_pointer(const volatile char *p);
+
+template <typename T>
+always_inline void do_not_optimize(const T &value) {
+#if COMPILER == MSVC
+    benchmark_use_pointer(&reinterpret_cast<const volatile char &>(value));
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+always_inline void clobber_memory() {
+#if COMPILER == MSVC
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
@@ -0,0 +1,280 @@
+#include "../test.h"
+
+//
+// Allocator benchmarks. Run the test suite with --bench to run these instead of the tests.
+//
+// Every workload runs on a freshly created allocator and reports the average time of an operation
+// and the peak RSS of the process after the workload (the peak never goes down, so look at how much it grew).
+//
+
+file_scope constexpr s64 POOL_SIZE = 256_MiB;
+
+struct bench_allocator {
+    const char *Name;
+
+    allocator (*Create)();
+    void (*Destroy)(allocator alloc);
+
+    s64 MaxSize;      // The largest allocation the allocator can serve, 0 means no limit
+    bool ThreadSafe;  // Whether we can use it in the cross thread workload
+};
+
+file_scope void *PoolBlock;
+
+file_scope tlsf_allocator_data TlsfData;
+file_scope arena_allocator_data ArenaData;
+file_scope arena_allocator_data TempData;
+file_scope slab_allocator_data SlabData;
+file_scope pool_allocator_data PoolData;
+file_scope virtual_arena_allocator_data VirtualArenaData;
+
+file_scope allocator create_tlsf() {
+    TlsfData = {};
+    PoolBlock = os_allocate_block(POOL_SIZE);
+    allocator alloc = {tlsf_allocator, &TlsfData};
+    allocator_add_pool(alloc, PoolBlock, POOL_SIZE);
+    return alloc;
+}
+
+// The first pool also holds the tlsf control structure, so we don't remove it, we just free the memory
+file_scope void destroy_tlsf(allocator) { os_free_block(PoolBlock); }
+
+file_scope allocator create_arena() {
+    ArenaData = {};
+    PoolBlock = os_allocate_block(POOL_SIZE);
+    allocator alloc = {arena_allocator, &ArenaData};
+    allocator_add_pool(alloc, PoolBlock, POOL_SIZE);
+    return alloc;
+}
+
+file_scope allocator create_slab() {
+    SlabData = {};
+    PoolBlock = os_allocate_block(POOL_SIZE);
+    allocator alloc = {slab_allocator, &SlabData};
+    allocator_add_pool(alloc, PoolBlock, POOL_SIZE);
+    return alloc;
+}
+
+// Serves every size up to 256 bytes from a single element size
+file_scope allocator create_pool() {
+    PoolData = {};
+    PoolData.ElementSize = pool_allocator_element_size(256, 16);
+    PoolBlock = os_allocate_block(POOL_SIZE);
+    allocator alloc = {pool_allocator, &PoolData};
+    allocator_add_pool(alloc, PoolBlock, POOL_SIZE);
+    return alloc;
+}
+
+file_scope void destroy_pooled(allocator alloc) {
+    free_all(alloc);  // Slab and pool don't let us remove a pool which has been used
+    allocator_remove_pool(alloc, PoolBlock);
+    os_free_block(PoolBlock);
+}
+
+// The temporary allocator adds its own pools, we free those here
+file_scope allocator create_temp() {
+    TempData = {};
+    return {default_temp_allocator, &TempData};
+}
+
+file_scope void destroy_temp(allocator alloc) {
+    auto *p = TempData.Base;
+    while (p) {
+        auto *next = p->Next;
+        allocator_remove_pool(alloc, p);
+        os_free_block(p);
+        p = next;
+    }
+}
+
+file_scope allocator create_virtual_arena() {
+    VirtualArenaData = {};
+    return {virtual_arena_allocator, &VirtualArenaData};
+}
+
+file_scope void destroy_virtual_arena(allocator) { virtual_arena_release(&VirtualArenaData); }
+
+file_scope allocator create_persistent() { return internal::platform_get_persistent_allocator(); }
+file_scope void destroy_persistent(allocator) {}
+
+file_scope bench_allocator BenchAllocators[] = {
+    {"tlsf", create_tlsf, destroy_tlsf, 0, false},
+    {"arena", create_arena, destroy_pooled, 0, false},
+    {"default_temp", create_temp, destroy_temp, 0, false},
+    {"slab", create_slab, destroy_pooled, SLAB_MAX_BLOCK_SIZE / 2, false},  // Leave space for the header and alignment
+    {"pool (256 bytes)", create_pool, destroy_pooled, 256, false},
+    {"virtual_arena", create_virtual_arena, destroy_virtual_arena, 0, false},
+    {"persistent (thread cached tlsf)", create_persistent, destroy_persistent, 0, true},
+};
+
+// xorshift64, deterministic so every allocator sees the same sequence of sizes
+file_scope u64 bench_random(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+file_scope s64 bench_random_size(u64 *state, s64 min, s64 max) { return min + (s64) (bench_random(state) % (u64) (max - min + 1)); }
+
+file_scope void report(const char *workload, const bench_allocator &b, time_t start, s64 ops) {
+    f64 ns = os_time_to_seconds(os_get_time() - start) * 1e9 / (f64) ops;
+    print("    {:<14} {:<32} {!YELLOW}{:8.1f}{!} ns/op    peak RSS: {:.1f} MiB\n", workload, b.Name, ns, (f64) os_get_peak_memory_usage() / 1_MiB);
+}
+
+//
+// Small object churn - keep a window of live objects and keep replacing random ones.
+//
+file_scope void bench_small_churn(const bench_allocator &b) {
+    constexpr s64 LIVE = 4096;
+    constexpr s64 OPS = 200000;
+
+    auto alloc = b.Create();
+
+    void *live[LIVE] = {};
+    u64 rng = 0x12345678;
+
+    time_t start = os_get_time();
+    For(range(OPS)) {
+        s64 slot = (s64) (bench_random(&rng) % LIVE);
+        general_free(live[slot]);
+        live[slot] = general_allocate(alloc, bench_random_size(&rng, 8, 256), 0);
+    }
+    For(range(LIVE)) general_free(live[it]);
+    report("small_churn", b, start, OPS);
+
+    b.Destroy(alloc);
+}
+
+//
+// Array growth - grow blocks by 1.5x up to 64 KiB, like array_append does.
+//
+file_scope void bench_realloc_growth(const bench_allocator &b) {
+    constexpr s64 ROUNDS = 2000;
+    constexpr s64 MAX_SIZE = 64_KiB;
+
+    if (b.MaxSize && b.MaxSize < MAX_SIZE) return;
+
+    auto alloc = b.Create();
+
+    s64 ops = 0;
+
+    time_t start = os_get_time();
+    For(range(ROUNDS)) {
+        s64 size = 16;
+        void *p = general_allocate(alloc, size, 0);
+        while (size < MAX_SIZE) {
+            size += size / 2;
+            p = general_reallocate(p, size);
+            ++ops;
+        }
+        general_free(p);
+        ops += 2;
+    }
+    report("realloc_growth", b, start, ops);
+
+    b.Destroy(alloc);
+}
+
+//
+// Fragmentation - fill with mixed sizes, free every other block and allocate larger ones in the holes, repeatedly.
+//
+file_scope void bench_fragmentation(const bench_allocator &b) {
+    constexpr s64 COUNT = 20000;
+    constexpr s64 ROUNDS = 8;
+
+    s64 maxSize = b.MaxSize ? b.MaxSize : 4_KiB;
+
+    auto alloc = b.Create();
+
+    auto *blocks = allocate_array<void *>(COUNT);
+    defer(free(blocks));
+
+    u64 rng = 0xDEADBEEF;
+    s64 ops = 0;
+
+    time_t start = os_get_time();
+    For(range(COUNT)) blocks[it] = general_allocate(alloc, bench_random_size(&rng, 16, maxSize / 4), 0);
+    ops += COUNT;
+
+    For_as(round, range(ROUNDS)) {
+        for (s64 i = round & 1; i < COUNT; i += 2) {
+            general_free(blocks[i]);
+            blocks[i] = general_allocate(alloc, bench_random_size(&rng, 16, maxSize), 0);
+            ops += 2;
+        }
+    }
+
+    For(range(COUNT)) general_free(blocks[it]);
+    ops += COUNT;
+    report("fragmentation", b, start, ops);
+
+    b.Destroy(alloc);
+}
+
+//
+// Producer/consumer - one thread allocates, another one frees (through a single-producer single-consumer ring).
+//
+struct bench_cross_thread_ring {
+    static constexpr s64 CAPACITY = 4096;
+    static constexpr s64 OPS = 200000;
+
+    void *Slots[CAPACITY];
+    s64 Head;  // Written by the producer
+    s64 Tail;  // Written by the consumer
+};
+
+file_scope bench_cross_thread_ring Ring;
+
+file_scope void bench_consumer(void *) {
+    s64 consumed = 0;
+    while (consumed < Ring.OPS) {
+        s64 head = atomic_compare_and_swap(&Ring.Head, 0ll, 0ll);
+        while (Ring.Tail < head) {
+            general_free(Ring.Slots[Ring.Tail % Ring.CAPACITY]);
+            atomic_inc(&Ring.Tail);
+            ++consumed;
+        }
+    }
+}
+
+file_scope void bench_cross_thread(const bench_allocator &b) {
+    if (!b.ThreadSafe) return;
+
+    auto alloc = b.Create();
+
+    Ring.Head = Ring.Tail = 0;
+    u64 rng = 0xC0FFEE;
+
+    time_t start = os_get_time();
+
+    thread::thread consumer;
+    consumer.init_and_launch(bench_consumer);
+
+    For(range(Ring.OPS)) {
+        void *p = general_allocate(alloc, bench_random_size(&rng, 16, 512), 0);
+        while (Ring.Head - atomic_compare_and_swap(&Ring.Tail, 0ll, 0ll) >= Ring.CAPACITY) {
+        }
+        Ring.Slots[Ring.Head % Ring.CAPACITY] = p;
+        atomic_inc(&Ring.Head);
+    }
+    consumer.wait();
+
+    report("cross_thread", b, start, Ring.OPS * 2);
+
+    b.Destroy(alloc);
+}
+
+void run_allocator_benchmarks() {
+    print("\n{!GRAY}Allocator benchmarks:{!}\n");
+
+    For(BenchAllocators) bench_small_churn(it);
+    print("\n");
+    For(BenchAllocators) bench_realloc_growth(it);
+    print("\n");
+    For(BenchAllocators) bench_fragmentation(it);
+    print("\n");
+    For(BenchAllocators) bench_cross_thread(it);
+    print("\n");
+}
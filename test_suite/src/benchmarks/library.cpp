@@ -0,0 +1,259 @@
+#include <lstd/compress.h>
+#include <lstd/linalg.h>
+#include <lstd/parse.h>
+#include <lstd/random.h>
+#include <lstd/regex.h>
+
+#include "../bench.h"
+
+//
+// Benchmarks of the library's hot paths. Each one is small on purpose, so a regression points at one thing.
+//
+
+// xorshift64, deterministic so every run measures the same data
+file_scope u64 bench_next(u64 *state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+//
+// Containers
+//
+
+BENCHMARK(array_append) {
+    For(range(state->Iterations)) {
+        array<s64> arr;
+        For_as(i, range(1000)) array_append(arr, i);
+        do_not_optimize(arr.Data[999]);
+        free(arr);
+    }
+}
+
+BENCHMARK(hash_table_add_find) {
+    For(range(state->Iterations)) {
+        hash_table<s64, s64> table;
+        For_as(i, range(1000)) add(table, i * 7, i);
+
+        s64 sum = 0;
+        For_as(i, range(1000)) sum += *find(table, i * 7).Value;
+        do_not_optimize(sum);
+        free(table);
+    }
+}
+
+BENCHMARK(sort_10000) {
+    array<s64> arr;
+    defer(free(arr));
+    array_reserve(arr, 10000);
+    For(range(10000)) array_append(arr, (s64) 0);
+
+    u64 rng = 0x12345678;
+    For(range(state->Iterations)) {
+        state->pause();
+        For_as(i, range(arr.Count)) arr[i] = (s64) bench_next(&rng);
+        state->resume();
+
+        sort(arr);
+        do_not_optimize(arr.Data[0]);
+    }
+    state->BytesPerIteration = arr.Count * sizeof(s64);
+}
+
+//
+// fmt
+//
+
+BENCHMARK(fmt_integers_and_floats) {
+    counting_writer out;
+    For(range(state->Iterations)) {
+        fmt_to_writer(&out, "{} {} {:.3f} {}\n", (s64) it, (u32) -1, (f64) it * 0.1, -42);
+    }
+    do_not_optimize(out.Count);
+}
+
+BENCHMARK(fmt_strings) {
+    counting_writer out;
+    string name = "a somewhat longer string";
+    For(range(state->Iterations)) {
+        fmt_to_writer(&out, "{:<30}|{:^30}|\n", name, name);
+    }
+    do_not_optimize(out.Count);
+}
+
+//
+// parse
+//
+
+BENCHMARK(parse_int) {
+    string input = "-1234567890123";
+    For(range(state->Iterations)) {
+        auto [value, status, rest] = parse_int<s64>(input);
+        do_not_optimize(value);
+    }
+    state->BytesPerIteration = input.Count;
+}
+
+BENCHMARK(parse_float) {
+    string input = "3.14159265358979e-12";
+    For(range(state->Iterations)) {
+        auto [value, status, rest] = parse_float<f64>(input);
+        do_not_optimize(value);
+    }
+    state->BytesPerIteration = input.Count;
+}
+
+//
+// Math
+//
+
+BENCHMARK(m44_dot) {
+    m44 a = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    m44 b = a;
+    For(range(state->Iterations)) {
+        do_not_optimize(a);
+        b = dot(b, a) * 0.01f;
+    }
+    do_not_optimize(b);
+}
+
+BENCHMARK(v3_normalize_cross) {
+    v3 a = {1, 2, 3}, b = {-3, 0.5f, 2};
+    For(range(state->Iterations)) {
+        do_not_optimize(a);
+        a = normalize(cross(a, b) + b);
+    }
+    do_not_optimize(a);
+}
+
+BENCHMARK(transform_points_aos) {
+    array<v3> points;
+    defer(free(points));
+    array_reserve(points, 1000);
+    For(range(1000)) array_append(points, v3((f32) it, 1.0f, -(f32) it));
+
+    m44 m = {0.5f, 1, 0, 0, -1, 0.5f, 0, 0, 0, 0, 2, 0, 5, 6, 7, 1};
+    For(range(state->Iterations)) {
+        transform_points(points.Data, points.Data, points.Count, m);
+        do_not_optimize(points.Data[0]);
+    }
+    state->BytesPerIteration = points.Count * sizeof(v3);
+}
+
+BENCHMARK(transform_points_soa) {
+    array<f32> x, y, z;
+    defer(free(x));
+    defer(free(y));
+    defer(free(z));
+    For(range(1000)) array_append(x, (f32) it), array_append(y, 1.0f), array_append(z, -(f32) it);
+
+    m44 m = {0.5f, 1, 0, 0, -1, 0.5f, 0, 0, 0, 0, 2, 0, 5, 6, 7, 1};
+    For(range(state->Iterations)) {
+        transform_points(soa_v3_view(x.Data, y.Data, z.Data), soa_v3{x.Data, y.Data, z.Data}, x.Count, m);
+        do_not_optimize(x.Data[0]);
+    }
+    state->BytesPerIteration = x.Count * 3 * sizeof(f32);
+}
+
+BENCHMARK(simd_sincos_f32x8) {
+    simd<f32, 8> x, s, c;
+    For(range(8)) x.reg[it] = 0.1f * (f32) it;
+    For(range(state->Iterations)) {
+        do_not_optimize(x);
+        simd_sincos(x, &s, &c);
+        do_not_optimize(s);
+        do_not_optimize(c);
+    }
+}
+
+// One iteration is 4096 doubles, the smallest fill which takes the SIMD path
+BENCHMARK(rng_fill_f64_4096) {
+    f64 *samples = allocate_array<f64>(4096);
+    defer(free(samples));
+
+    rng r;
+    rng_seed(r, 42);
+    For(range(state->Iterations)) {
+        rng_fill(r, array<f64>(samples, 4096));
+        do_not_optimize(samples[4095]);
+    }
+}
+
+// 64 KiB of log lines with one match at the end, most of it is skipped by the literal prefix
+BENCHMARK(regex_find_log_64k) {
+    string text;
+    defer(free(text));
+    while (text.Count < 64 * 1024) string_append(text, "INFO request handled in 12 ms\n");
+    string_append(text, "ERROR upstream timed out\n");
+
+    regex re;
+    regex_compile(re, "ERROR .*timed? out");
+    defer(free(re));
+
+    For(range(state->Iterations)) {
+        regex_match m = regex_find(re, text);
+        do_not_optimize(m.End);
+    }
+}
+
+// 1 MiB of text-like data (words from a small vocabulary), the kind of thing logs are made of
+BENCHMARK(lz_compress_1mb) {
+    constexpr s64 N = 1024 * 1024;
+    const char *words[] = {"request ", "handled ", "in ", "12 ", "ms ", "user ", "id=", "42 ", "ok\n"};
+
+    byte *text = allocate_array<byte>(N);
+    defer(free(text));
+    u64 seed = 0x9E3779B97F4A7C15ull;
+    for (s64 i = 0; i < N;) {
+        const char *word = words[bench_next(&seed) % 9];
+        for (s64 j = 0; word[j] && i < N; ++j) text[i++] = (byte) word[j];
+    }
+
+    byte *packed = allocate_array<byte>(lz_compress_bound(N));
+    defer(free(packed));
+
+    For(range(state->Iterations)) {
+        s64 size = lz_compress(packed, text, N);
+        do_not_optimize(size);
+    }
+}
+
+// The size of the calibration systems
+BENCHMARK(dense_lu_solve_200) {
+    constexpr s64 N = 200;
+
+    u64 seed = 0x9E3779B97F4A7C15ull;
+    dense_mat a;
+    dense_mat_init(a, N, N);
+    defer(free(a));
+    For_as(i, range(N)) For_as(j, range(N)) a(i, j) = (f64) (bench_next(&seed) >> 11) / (f64) (1ull << 53) + (i == j ? N : 0);
+
+    f64 b[N], x[N];
+    For(range(N)) b[it] = (f64) it;
+
+    For(range(state->Iterations)) {
+        dense_solve(a, b, x);
+        do_not_optimize(x[0]);
+    }
+}
+
+//
+// Threading (uncontended, these are the costs every call pays)
+//
+
+BENCHMARK(atomic_inc) {
+    s64 counter = 0;
+    For(range(state->Iterations)) atomic_inc(&counter);
+    do_not_optimize(counter);
+}
+
+BENCHMARK(fast_mutex_lock_unlock) {
+    thread::fast_mutex mutex;
+    For(range(state->Iterations)) {
+        mutex.lock();
+        clobber_memory();
+        mutex.unlock();
+    }
+}
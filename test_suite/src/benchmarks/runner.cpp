@@ -0,0 +1,154 @@
+#include "../bench.h"
+
+//
+// Runs the benchmarks registered in build_benchmark_table(), see bench.h.
+//
+// For every benchmark:
+// * Calibrate: start with 1 iteration and grow until a call takes at least MIN_SAMPLE_NS.
+// * Warm up: keep calling it until WARMUP_NS have passed (at least once).
+// * Measure: SAMPLE_COUNT calls, each gives one sample of the time per iteration.
+//
+// The median is the number to compare between runs, it's not moved by the odd sample which got preempted.
+// The 99th percentile and the standard deviation show how noisy the machine (or the code) was.
+//
+
+file_scope constexpr s64 MIN_SAMPLE_NS = 1000000;
+file_scope constexpr s64 WARMUP_NS = 50000000;
+file_scope constexpr s64 SAMPLE_COUNT = 31;
+file_scope constexpr s64 MAX_ITERATIONS = 1000000000;
+
+void benchmark_use_pointer(const volatile char *) {}
+
+struct benchmark_result {
+    string File, Name;
+
+    s64 Iterations;  // Per sample
+    s64 BytesPerIteration;
+
+    // Nanoseconds per iteration
+    f64 Median, P99, Mean, StdDev, Min;
+};
+
+file_scope s64 benchmark_call(benchmark_func function, s64 iterations, s64 bytesPerIteration, s64 *bytesOut = null) {
+    benchmark_state state;
+    state.Iterations = iterations;
+    state.BytesPerIteration = bytesPerIteration;
+
+    s64 start = os_get_timestamp_ns();
+    function(&state);
+    s64 elapsed = os_get_timestamp_ns() - start - state.PausedNs;
+
+    if (bytesOut) *bytesOut = state.BytesPerIteration;
+    return max(elapsed, (s64) 1);
+}
+
+file_scope benchmark_result benchmark_measure(benchmark_func function) {
+    benchmark_result result = {};
+
+    // Calibrate. Jump straight to roughly the right count once a call takes long enough to estimate from.
+    s64 iterations = 1;
+    while (true) {
+        s64 elapsed = benchmark_call(function, iterations, 0);
+        if (elapsed >= MIN_SAMPLE_NS || iterations >= MAX_ITERATIONS) break;
+
+        s64 factor = elapsed > MIN_SAMPLE_NS / 100 ? (s64) ((f64) MIN_SAMPLE_NS * 1.2 / (f64) elapsed) + 1 : 10;
+        iterations = min(iterations * clamp(factor, (s64) 2, (s64) 10), MAX_ITERATIONS);
+    }
+    result.Iterations = iterations;
+
+    s64 warmupStart = os_get_timestamp_ns();
+    do {
+        benchmark_call(function, iterations, 0);
+    } while (os_get_timestamp_ns() - warmupStart < WARMUP_NS);
+
+    f64 samples[SAMPLE_COUNT];
+    For(range(SAMPLE_COUNT)) {
+        samples[it] = (f64) benchmark_call(function, iterations, 0, &result.BytesPerIteration) / (f64) iterations;
+    }
+    sort(samples, samples + SAMPLE_COUNT);
+
+    f64 sum = 0;
+    For(samples) sum += it;
+    result.Mean = sum / SAMPLE_COUNT;
+
+    f64 squares = 0;
+    For(samples) squares += (it - result.Mean) * (it - result.Mean);
+    result.StdDev = ::sqrt(squares / (SAMPLE_COUNT - 1));
+
+    result.Min = samples[0];
+    result.Median = samples[SAMPLE_COUNT / 2];
+    result.P99 = samples[(s64) ::ceil(0.99 * SAMPLE_COUNT) - 1];  // Nearest rank
+
+    return result;
+}
+
+// Bytes per second from nanoseconds per iteration
+file_scope f64 benchmark_throughput(const benchmark_result &r) { return r.BytesPerIteration ? (f64) r.BytesPerIteration * 1e9 / r.Median : 0; }
+
+file_scope void benchmark_write_json(const array<benchmark_result> &results, const string &path) {
+    string_builder_writer out;
+    defer(free(out));
+
+    fmt_to_writer(&out, "{{\n  \"hardware_concurrency\": {},\n  \"benchmarks\": [\n", os_get_hardware_concurrency());
+    For_as(index, range(results.Count)) {
+        auto &r = results[index];
+        fmt_to_writer(&out,
+                      "    {{\"file\": \"{}\", \"name\": \"{}\", \"iterations\": {}, \"samples\": {}, "
+                      "\"median_ns\": {:.3f}, \"p99_ns\": {:.3f}, \"mean_ns\": {:.3f}, \"stddev_ns\": {:.3f}, \"min_ns\": {:.3f}, "
+                      "\"bytes_per_second\": {:.0f}}}{}\n",
+                      r.File, r.Name, r.Iterations, SAMPLE_COUNT, r.Median, r.P99, r.Mean, r.StdDev, r.Min, benchmark_throughput(r), index + 1 < results.Count ? "," : "");
+    }
+    write(&out, string("  ]\n}\n"));
+
+    string contents = string_builder_combine(out.Builder);
+    defer(free(contents));
+    if (!path_write_to_file(path, contents, Overwrite_Entire)) print("{!RED}Couldn't write \"{}\"{!}\n", path);
+}
+
+file_scope void benchmark_write_csv(const array<benchmark_result> &results, const string &path) {
+    string_builder_writer out;
+    defer(free(out));
+
+    write(&out, string("file,name,iterations,samples,median_ns,p99_ns,mean_ns,stddev_ns,min_ns,bytes_per_second\n"));
+    For(results) {
+        fmt_to_writer(&out, "{},{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.0f}\n", it.File, it.Name, it.Iterations, SAMPLE_COUNT,
+                      it.Median, it.P99, it.Mean, it.StdDev, it.Min, benchmark_throughput(it));
+    }
+
+    string contents = string_builder_combine(out.Builder);
+    defer(free(contents));
+    if (!path_write_to_file(path, contents, Overwrite_Entire)) print("{!RED}Couldn't write \"{}\"{!}\n", path);
+}
+
+void run_benchmarks(const benchmark_options &options) {
+    build_benchmark_table();
+
+    array<benchmark_result> results;
+    defer(free(results));
+
+    print("\n{!GRAY}Benchmarks ({} samples each, nanoseconds per iteration):{!}\n", SAMPLE_COUNT);
+    print("    {:<40} {:>12} {:>12} {:>10} {:>12}\n", "", "median", "p99", "stddev", "iterations");
+
+    for (auto [fileName, benchmarks] : g_BenchmarkTable) {
+        For(*benchmarks) {
+            string fullName = sprint("{}/{}", *fileName, it.Name);
+            defer(free(fullName));
+
+            if (options.Filter && find_substring(fullName, options.Filter) == -1) continue;
+            if (!it.Function) continue;
+
+            auto r = benchmark_measure(it.Function);
+            r.File = *fileName;
+            r.Name = it.Name;
+            array_append(results, r);
+
+            print("    {:<40} {!YELLOW}{:12.1f}{!} {:12.1f} {:10.1f} {:12}", fullName, r.Median, r.P99, r.StdDev, r.Iterations);
+            if (r.BytesPerIteration) print("    {:.1f} MiB/s", benchmark_throughput(r) / 1_MiB);
+            print("\n");
+        }
+    }
+    print("\n");
+
+    if (options.JsonPath) benchmark_write_json(results, options.JsonPath);
+    if (options.CsvPath) benchmark_write_csv(results, options.CsvPath);
+}
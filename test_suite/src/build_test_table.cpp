@@ -1,14 +1,42 @@
-#include "test.h"
+#include "bench.h"
 
 void build_test_table() {
     // extern void test_msb();
     // array_append(*g_TestTable[string("bits.cpp")], {"msb", test_msb});
     // extern void test_lsb();
     // array_append(*g_TestTable[string("bits.cpp")], {"lsb", test_lsb});
+    extern void test_u128_arithmetic();
+    array_append(*g_TestTable[string("bits.cpp")], {"u128_arithmetic", test_u128_arithmetic});
+    extern void test_call_stack_intern();
+    array_append(*g_TestTable[string("call_stack.cpp")], {"call_stack_intern", test_call_stack_intern});
+    extern void test_call_stack_capture();
+    array_append(*g_TestTable[string("call_stack.cpp")], {"call_stack_capture", test_call_stack_capture});
+    extern void test_lz_roundtrip();
+    array_append(*g_TestTable[string("compress.cpp")], {"lz_roundtrip", test_lz_roundtrip});
+    extern void test_compress_stream();
+    array_append(*g_TestTable[string("compress.cpp")], {"compress_stream", test_compress_stream});
     // extern void test_path_manipulation();
     // array_append(*g_TestTable[string("file.cpp")], {"path_manipulation", test_path_manipulation});
+    extern void test_path_manipulation_into();
+    array_append(*g_TestTable[string("file.cpp")], {"path_manipulation_into", test_path_manipulation_into});
     // extern void test_file_size();
     // array_append(*g_TestTable[string("file.cpp")], {"file_size", test_file_size});
+    extern void test_file_mapping();
+    array_append(*g_TestTable[string("file.cpp")], {"file_mapping", test_file_mapping});
+    extern void test_file_read();
+    array_append(*g_TestTable[string("file.cpp")], {"file_read", test_file_read});
+    extern void test_file_writer_reader();
+    array_append(*g_TestTable[string("file.cpp")], {"file_writer_reader", test_file_writer_reader});
+    extern void test_async_io();
+    array_append(*g_TestTable[string("file.cpp")], {"async_io", test_async_io});
+    extern void test_path_watcher();
+    array_append(*g_TestTable[string("file.cpp")], {"path_watcher", test_path_watcher});
+    extern void test_path_tree_walker();
+    array_append(*g_TestTable[string("file.cpp")], {"path_tree_walker", test_path_tree_walker});
+    extern void test_path_hash_tree();
+    array_append(*g_TestTable[string("file.cpp")], {"path_hash_tree", test_path_hash_tree});
+    extern void test_path_copy_transfer();
+    array_append(*g_TestTable[string("file.cpp")], {"path_copy_transfer", test_path_copy_transfer});
     extern void test_write_bool();
     array_append(*g_TestTable[string("fmt.cpp")], {"write_bool", test_write_bool});
     extern void test_write_integer_16();
@@ -31,6 +59,8 @@ void build_test_table() {
     array_append(*g_TestTable[string("fmt.cpp")], {"format_int_decimal", test_format_int_decimal});
     extern void test_format_int_hexadecimal();
     array_append(*g_TestTable[string("fmt.cpp")], {"format_int_hexadecimal", test_format_int_hexadecimal});
+    extern void test_format_int_large();
+    array_append(*g_TestTable[string("fmt.cpp")], {"format_int_large", test_format_int_large});
     extern void test_format_int_localeish();
     array_append(*g_TestTable[string("fmt.cpp")], {"format_int_localeish", test_format_int_localeish});
     extern void test_format_f32();
@@ -45,6 +75,10 @@ void build_test_table() {
     array_append(*g_TestTable[string("fmt.cpp")], {"format_custom", test_format_custom});
     extern void test_precision_rounding();
     array_append(*g_TestTable[string("fmt.cpp")], {"precision_rounding", test_precision_rounding});
+    extern void test_precision_rounding_exact();
+    array_append(*g_TestTable[string("fmt.cpp")], {"precision_rounding_exact", test_precision_rounding_exact});
+    extern void test_precision_rounding_random();
+    array_append(*g_TestTable[string("fmt.cpp")], {"precision_rounding_random", test_precision_rounding_random});
     extern void test_prettify_float();
     array_append(*g_TestTable[string("fmt.cpp")], {"prettify_float", test_prettify_float});
     extern void test_escape_brackets();
@@ -91,7 +125,55 @@ void build_test_table() {
     array_append(*g_TestTable[string("fmt.cpp")], {"dynamic_precision", test_dynamic_precision});
     extern void test_colors_and_emphasis();
     array_append(*g_TestTable[string("fmt.cpp")], {"colors_and_emphasis", test_colors_and_emphasis});
+    extern void test_compiled_format_string();
+    array_append(*g_TestTable[string("fmt.cpp")], {"compiled_format_string", test_compiled_format_string});
+    extern void test_runtime_compiled_format_string();
+    array_append(*g_TestTable[string("fmt.cpp")], {"runtime_compiled_format_string", test_runtime_compiled_format_string});
+    extern void test_fmt_to_buffer();
+    array_append(*g_TestTable[string("fmt.cpp")], {"fmt_to_buffer", test_fmt_to_buffer});
+    extern void test_deferred_log();
+    array_append(*g_TestTable[string("fmt.cpp")], {"deferred_log", test_deferred_log});
+    extern void test_calculate_and_estimate_length();
+    array_append(*g_TestTable[string("fmt.cpp")], {"calculate_and_estimate_length", test_calculate_and_estimate_length});
+    extern void test_repeated_specs();
+    array_append(*g_TestTable[string("fmt.cpp")], {"repeated_specs", test_repeated_specs});
+    extern void test_hex_bytes();
+    array_append(*g_TestTable[string("fmt.cpp")], {"hex_bytes", test_hex_bytes});
+    extern void test_write_list();
+    array_append(*g_TestTable[string("fmt.cpp")], {"write_list", test_write_list});
+    extern void test_cached_text_styles();
+    array_append(*g_TestTable[string("fmt.cpp")], {"cached_text_styles", test_cached_text_styles});
+    extern void test_date_time();
+    array_append(*g_TestTable[string("fmt.cpp")], {"date_time", test_date_time});
+    extern void test_reader();
+    array_append(*g_TestTable[string("fmt.cpp")], {"reader", test_reader});
+    extern void test_json_structure();
+    array_append(*g_TestTable[string("json.cpp")], {"json_structure", test_json_structure});
+    extern void test_json_values();
+    array_append(*g_TestTable[string("json.cpp")], {"json_values", test_json_values});
+    extern void test_json_strings();
+    array_append(*g_TestTable[string("json.cpp")], {"json_strings", test_json_strings});
+    extern void test_json_iteration();
+    array_append(*g_TestTable[string("json.cpp")], {"json_iteration", test_json_iteration});
+    extern void test_dense_lu();
+    array_append(*g_TestTable[string("linalg.cpp")], {"dense_lu", test_dense_lu});
+    extern void test_dense_qr();
+    array_append(*g_TestTable[string("linalg.cpp")], {"dense_qr", test_dense_qr});
+    extern void test_sparse_mat();
+    array_append(*g_TestTable[string("linalg.cpp")], {"sparse_mat", test_sparse_mat});
+    extern void test_sparse_cg();
+    array_append(*g_TestTable[string("linalg.cpp")], {"sparse_cg", test_sparse_cg});
     /*
+    extern void test_batch_intersections();
+    array_append(*g_TestTable[string("geometry.cpp")], {"batch_intersections", test_batch_intersections});
+    extern void test_frustum_from_matrix();
+    array_append(*g_TestTable[string("geometry.cpp")], {"frustum_from_matrix", test_frustum_from_matrix});
+    extern void test_bvh_queries();
+    array_append(*g_TestTable[string("geometry.cpp")], {"bvh_queries", test_bvh_queries});
+    extern void test_bvh_triangles();
+    array_append(*g_TestTable[string("geometry.cpp")], {"bvh_triangles", test_bvh_triangles});
+    extern void test_spatial_grid();
+    array_append(*g_TestTable[string("geometry.cpp")], {"spatial_grid", test_spatial_grid});
     extern void test_ctor_and_index();
     array_append(*g_TestTable[string("mat.cpp")], {"ctor_and_index", test_ctor_and_index});
     extern void test_thin_mat_from_vec();
@@ -142,6 +224,10 @@ void build_test_table() {
     array_append(*g_TestTable[string("mat.cpp")], {"inverse_small", test_inverse_small});
     extern void test_inverse();
     array_append(*g_TestTable[string("mat.cpp")], {"inverse", test_inverse});
+    extern void test_mat44_kernels();
+    array_append(*g_TestTable[string("mat.cpp")], {"mat44_kernels", test_mat44_kernels});
+    extern void test_affine3();
+    array_append(*g_TestTable[string("mat.cpp")], {"affine3", test_affine3});
     extern void test_norm();
     array_append(*g_TestTable[string("mat.cpp")], {"norm", test_norm});
     extern void test_lu_decomposition();
@@ -182,8 +268,22 @@ void build_test_table() {
     array_append(*g_TestTable[string("parse.cpp")], {"int", test_int});
     extern void test_bool();
     array_append(*g_TestTable[string("parse.cpp")], {"bool", test_bool});
+    extern void test_float();
+    array_append(*g_TestTable[string("parse.cpp")], {"float", test_float});
+    extern void test_float_rounding();
+    array_append(*g_TestTable[string("parse.cpp")], {"float_rounding", test_float_rounding});
     extern void test_guid();
     array_append(*g_TestTable[string("parse.cpp")], {"guid", test_guid});
+    extern void test_guid_generation();
+    array_append(*g_TestTable[string("parse.cpp")], {"guid_generation", test_guid_generation});
+    extern void test_eat();
+    array_append(*g_TestTable[string("parse.cpp")], {"eat", test_eat});
+    extern void test_stream();
+    array_append(*g_TestTable[string("parse.cpp")], {"stream", test_stream});
+    extern void test_base64();
+    array_append(*g_TestTable[string("parse.cpp")], {"base64", test_base64});
+    extern void test_hex();
+    array_append(*g_TestTable[string("parse.cpp")], {"hex", test_hex});
     extern void test_quat_ctor();
     array_append(*g_TestTable[string("quat.cpp")], {"quat_ctor", test_quat_ctor});
     extern void test_axis_angle();
@@ -208,12 +308,42 @@ void build_test_table() {
     array_append(*g_TestTable[string("quat.cpp")], {"exp_ln", test_exp_ln});
     extern void test_pow();
     array_append(*g_TestTable[string("quat.cpp")], {"pow", test_pow});
+    extern void test_slerp_nlerp();
+    array_append(*g_TestTable[string("quat.cpp")], {"slerp_nlerp", test_slerp_nlerp});
+    extern void test_batch_quats();
+    array_append(*g_TestTable[string("quat.cpp")], {"batch_quats", test_batch_quats});
+    extern void test_rng_sequence();
+    array_append(*g_TestTable[string("random.cpp")], {"rng_sequence", test_rng_sequence});
+    extern void test_rng_bounded();
+    array_append(*g_TestTable[string("random.cpp")], {"rng_bounded", test_rng_bounded});
+    extern void test_rng_fill();
+    array_append(*g_TestTable[string("random.cpp")], {"rng_fill", test_rng_fill});
     extern void test_basic();
     array_append(*g_TestTable[string("range.cpp")], {"basic", test_basic});
     extern void test_variable_steps();
     array_append(*g_TestTable[string("range.cpp")], {"variable_steps", test_variable_steps});
     extern void test_reverse();
     array_append(*g_TestTable[string("range.cpp")], {"reverse", test_reverse});
+    extern void test_regex_syntax();
+    array_append(*g_TestTable[string("regex.cpp")], {"regex_syntax", test_regex_syntax});
+    extern void test_regex_find();
+    array_append(*g_TestTable[string("regex.cpp")], {"regex_find", test_regex_find});
+    extern void test_regex_cache_reset();
+    array_append(*g_TestTable[string("regex.cpp")], {"regex_cache_reset", test_regex_cache_reset});
+    extern void test_multi_pattern();
+    array_append(*g_TestTable[string("regex.cpp")], {"multi_pattern", test_multi_pattern});
+    extern void test_regex_alternation_prefilter();
+    array_append(*g_TestTable[string("regex.cpp")], {"regex_alternation_prefilter", test_regex_alternation_prefilter});
+    extern void test_binary_roundtrip();
+    array_append(*g_TestTable[string("serialize.cpp")], {"binary_roundtrip", test_binary_roundtrip});
+    extern void test_binary_copy_and_truncated();
+    array_append(*g_TestTable[string("serialize.cpp")], {"binary_copy_and_truncated", test_binary_copy_and_truncated});
+    extern void test_hash_table_image();
+    array_append(*g_TestTable[string("serialize.cpp")], {"hash_table_image", test_hash_table_image});
+    extern void test_varint();
+    array_append(*g_TestTable[string("serialize.cpp")], {"varint", test_varint});
+    extern void test_streamvbyte();
+    array_append(*g_TestTable[string("serialize.cpp")], {"streamvbyte", test_streamvbyte});
     extern void test_global_function();
     array_append(*g_TestTable[string("signal.cpp")], {"global_function", test_global_function});
     extern void test_member_function();
@@ -224,18 +354,156 @@ void build_test_table() {
     array_append(*g_TestTable[string("signal.cpp")], {"member_function_delegate", test_member_function_delegate});
     extern void test_functor_delegate();
     array_append(*g_TestTable[string("signal.cpp")], {"functor_delegate", test_functor_delegate});
+    extern void test_owning_delegate();
+    array_append(*g_TestTable[string("signal.cpp")], {"owning_delegate", test_owning_delegate});
+    extern void test_concurrent_signal();
+    array_append(*g_TestTable[string("signal.cpp")], {"concurrent_signal", test_concurrent_signal});
+    extern void test_event_queue();
+    array_append(*g_TestTable[string("signal.cpp")], {"event_queue", test_event_queue});
     extern void test_stack_array();
     array_append(*g_TestTable[string("storage.cpp")], {"stack_array", test_stack_array});
+    extern void test_copy_memory_large();
+    array_append(*g_TestTable[string("storage.cpp")], {"copy_memory_large", test_copy_memory_large});
     extern void test_array();
     array_append(*g_TestTable[string("storage.cpp")], {"array", test_array});
+    extern void test_array_growth();
+    array_append(*g_TestTable[string("storage.cpp")], {"array_growth", test_array_growth});
+    extern void test_array_bulk();
+    array_append(*g_TestTable[string("storage.cpp")], {"array_bulk", test_array_bulk});
+    extern void test_bound_allocator();
+    array_append(*g_TestTable[string("storage.cpp")], {"bound_allocator", test_bound_allocator});
+    extern void test_allocate_construct();
+    array_append(*g_TestTable[string("storage.cpp")], {"allocate_construct", test_allocate_construct});
+    extern void test_guard_page_allocator();
+    array_append(*g_TestTable[string("storage.cpp")], {"guard_page_allocator", test_guard_page_allocator});
+    extern void test_memory_tags();
+    array_append(*g_TestTable[string("storage.cpp")], {"memory_tags", test_memory_tags});
+    extern void test_allocator_registry();
+    array_append(*g_TestTable[string("storage.cpp")], {"allocator_registry", test_allocator_registry});
+    extern void test_slab_allocator();
+    array_append(*g_TestTable[string("storage.cpp")], {"slab_allocator", test_slab_allocator});
+    extern void test_persistent_allocator_cache();
+    array_append(*g_TestTable[string("storage.cpp")], {"persistent_allocator_cache", test_persistent_allocator_cache});
+    extern void test_allocation_headers();
+    array_append(*g_TestTable[string("storage.cpp")], {"allocation_headers", test_allocation_headers});
+    extern void test_arena_mark_rewind();
+    array_append(*g_TestTable[string("storage.cpp")], {"arena_mark_rewind", test_arena_mark_rewind});
+    extern void test_virtual_arena();
+    array_append(*g_TestTable[string("storage.cpp")], {"virtual_arena", test_virtual_arena});
+    extern void test_debug_memory();
+    array_append(*g_TestTable[string("storage.cpp")], {"debug_memory", test_debug_memory});
+    extern void test_allocator_stats();
+    array_append(*g_TestTable[string("storage.cpp")], {"allocator_stats", test_allocator_stats});
+    extern void test_pool_allocator();
+    array_append(*g_TestTable[string("storage.cpp")], {"pool_allocator", test_pool_allocator});
+    extern void test_object_pool();
+    array_append(*g_TestTable[string("storage.cpp")], {"object_pool", test_object_pool});
+    extern void test_allocate_batch();
+    array_append(*g_TestTable[string("storage.cpp")], {"allocate_batch", test_allocate_batch});
+    extern void test_frame_allocator();
+    array_append(*g_TestTable[string("storage.cpp")], {"frame_allocator", test_frame_allocator});
+    extern void test_remote_free();
+    array_append(*g_TestTable[string("storage.cpp")], {"remote_free", test_remote_free});
     extern void test_hash_table();
     array_append(*g_TestTable[string("storage.cpp")], {"hash_table", test_hash_table});
     extern void test_hash_table_clone();
     array_append(*g_TestTable[string("storage.cpp")], {"hash_table_clone", test_hash_table_clone});
     extern void test_hash_table_alignment();
     array_append(*g_TestTable[string("storage.cpp")], {"hash_table_alignment", test_hash_table_alignment});
+    extern void test_hash_table_remove();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_table_remove", test_hash_table_remove});
+    extern void test_hash_scalar_keys();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_scalar_keys", test_hash_scalar_keys});
+    extern void test_hash_table_find_batch();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_table_find_batch", test_hash_table_find_batch});
+    extern void test_hash_table_lookup_key();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_table_lookup_key", test_hash_table_lookup_key});
+    extern void test_hash_table_custom_hash();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_table_custom_hash", test_hash_table_custom_hash});
+    extern void test_hash_table_build();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_table_build", test_hash_table_build});
+    extern void test_hash_set();
+    array_append(*g_TestTable[string("storage.cpp")], {"hash_set", test_hash_set});
+    extern void test_static_hash_map();
+    array_append(*g_TestTable[string("storage.cpp")], {"static_hash_map", test_static_hash_map});
+    extern void test_swiss_table();
+    array_append(*g_TestTable[string("storage.cpp")], {"swiss_table", test_swiss_table});
+    extern void test_int_hash_table();
+    array_append(*g_TestTable[string("storage.cpp")], {"int_hash_table", test_int_hash_table});
+    extern void test_incremental_hash_table();
+    array_append(*g_TestTable[string("storage.cpp")], {"incremental_hash_table", test_incremental_hash_table});
+    extern void test_lru_cache();
+    array_append(*g_TestTable[string("storage.cpp")], {"lru_cache", test_lru_cache});
+    extern void test_clock_cache();
+    array_append(*g_TestTable[string("storage.cpp")], {"clock_cache", test_clock_cache});
+    extern void test_sharded_cache();
+    array_append(*g_TestTable[string("storage.cpp")], {"sharded_cache", test_sharded_cache});
+    extern void test_intrusive_list();
+    array_append(*g_TestTable[string("storage.cpp")], {"intrusive_list", test_intrusive_list});
+    extern void test_intrusive_hash_table();
+    array_append(*g_TestTable[string("storage.cpp")], {"intrusive_hash_table", test_intrusive_hash_table});
+    extern void test_concurrent_hash_table();
+    array_append(*g_TestTable[string("storage.cpp")], {"concurrent_hash_table", test_concurrent_hash_table});
+    extern void test_slot_map();
+    array_append(*g_TestTable[string("storage.cpp")], {"slot_map", test_slot_map});
+    extern void test_soa_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"soa_array", test_soa_array});
+    extern void test_bucket_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"bucket_array", test_bucket_array});
+    extern void test_small_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"small_array", test_small_array});
+    extern void test_ring_buffer();
+    array_append(*g_TestTable[string("storage.cpp")], {"ring_buffer", test_ring_buffer});
+    extern void test_deque();
+    array_append(*g_TestTable[string("storage.cpp")], {"deque", test_deque});
+    extern void test_spsc_queue();
+    array_append(*g_TestTable[string("storage.cpp")], {"spsc_queue", test_spsc_queue});
+    extern void test_mpmc_queue();
+    array_append(*g_TestTable[string("storage.cpp")], {"mpmc_queue", test_mpmc_queue});
+    extern void test_bitset();
+    array_append(*g_TestTable[string("storage.cpp")], {"bitset", test_bitset});
+    extern void test_bit_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"bit_array", test_bit_array});
+    extern void test_packed_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"packed_array", test_packed_array});
+    extern void test_packed_for_array();
+    array_append(*g_TestTable[string("storage.cpp")], {"packed_for_array", test_packed_for_array});
+    extern void test_sort();
+    array_append(*g_TestTable[string("storage.cpp")], {"sort", test_sort});
+    extern void test_radix_sort();
+    array_append(*g_TestTable[string("storage.cpp")], {"radix_sort", test_radix_sort});
+    extern void test_sort_by_key();
+    array_append(*g_TestTable[string("storage.cpp")], {"sort_by_key", test_sort_by_key});
+    extern void test_parallel_sort();
+    array_append(*g_TestTable[string("storage.cpp")], {"parallel_sort", test_parallel_sort});
+    extern void test_sorted_search();
+    array_append(*g_TestTable[string("storage.cpp")], {"sorted_search", test_sorted_search});
+    extern void test_array_algorithms();
+    array_append(*g_TestTable[string("storage.cpp")], {"array_algorithms", test_array_algorithms});
+    extern void test_priority_queue();
+    array_append(*g_TestTable[string("storage.cpp")], {"priority_queue", test_priority_queue});
+    extern void test_priority_queue_4_ary();
+    array_append(*g_TestTable[string("storage.cpp")], {"priority_queue_4_ary", test_priority_queue_4_ary});
+    extern void test_btree_map();
+    array_append(*g_TestTable[string("storage.cpp")], {"btree_map", test_btree_map});
+    extern void test_btree_map_bulk_load();
+    array_append(*g_TestTable[string("storage.cpp")], {"btree_map_bulk_load", test_btree_map_bulk_load});
+    extern void test_bloom_filter();
+    array_append(*g_TestTable[string("storage.cpp")], {"bloom_filter", test_bloom_filter});
+    extern void test_cuckoo_filter();
+    array_append(*g_TestTable[string("storage.cpp")], {"cuckoo_filter", test_cuckoo_filter});
     extern void test_code_point_size();
     array_append(*g_TestTable[string("string.cpp")], {"code_point_size", test_code_point_size});
+    extern void test_utf8_length_long();
+    array_append(*g_TestTable[string("string.cpp")], {"utf8_length_long", test_utf8_length_long});
+    extern void test_utf8_validation();
+    array_append(*g_TestTable[string("string.cpp")], {"utf8_validation", test_utf8_validation});
+    extern void test_utf16_conversion();
+    array_append(*g_TestTable[string("string.cpp")], {"utf16_conversion", test_utf16_conversion});
+    extern void test_utf32_conversion();
+    array_append(*g_TestTable[string("string.cpp")], {"utf32_conversion", test_utf32_conversion});
+    extern void test_string_index();
+    array_append(*g_TestTable[string("string.cpp")], {"string_index", test_string_index});
     extern void test_substring();
     array_append(*g_TestTable[string("string.cpp")], {"substring", test_substring});
     extern void test_substring_mixed_sizes();
@@ -248,6 +516,8 @@ void build_test_table() {
     array_append(*g_TestTable[string("string.cpp")], {"remove", test_remove});
     extern void test_trim();
     array_append(*g_TestTable[string("string.cpp")], {"trim", test_trim});
+    extern void test_split();
+    array_append(*g_TestTable[string("string.cpp")], {"split", test_split});
     extern void test_match_beginning();
     array_append(*g_TestTable[string("string.cpp")], {"match_beginning", test_match_beginning});
     extern void test_match_end();
@@ -262,14 +532,40 @@ void build_test_table() {
     array_append(*g_TestTable[string("string.cpp")], {"count", test_count});
     extern void test_builder();
     array_append(*g_TestTable[string("string.cpp")], {"builder", test_builder});
+    extern void test_builder_many_buffers();
+    array_append(*g_TestTable[string("string.cpp")], {"builder_many_buffers", test_builder_many_buffers});
+    extern void test_stack_string_writer();
+    array_append(*g_TestTable[string("string.cpp")], {"stack_string_writer", test_stack_string_writer});
     extern void test_remove_all();
     array_append(*g_TestTable[string("string.cpp")], {"remove_all", test_remove_all});
     extern void test_replace_all();
     array_append(*g_TestTable[string("string.cpp")], {"replace_all", test_replace_all});
     extern void test_find();
     array_append(*g_TestTable[string("string.cpp")], {"find", test_find});
+    extern void test_find_long();
+    array_append(*g_TestTable[string("string.cpp")], {"find_long", test_find_long});
+    extern void test_cpu_fallbacks();
+    array_append(*g_TestTable[string("string.cpp")], {"cpu_fallbacks", test_cpu_fallbacks});
+    extern void test_compare_long();
+    array_append(*g_TestTable[string("string.cpp")], {"compare_long", test_compare_long});
+    extern void test_case_conversion();
+    array_append(*g_TestTable[string("string.cpp")], {"case_conversion", test_case_conversion});
+    extern void test_hashed_string();
+    array_append(*g_TestTable[string("string.cpp")], {"hashed_string", test_hashed_string});
+    extern void test_hash_bytes();
+    array_append(*g_TestTable[string("string.cpp")], {"hash_bytes", test_hash_bytes});
+    extern void test_string_pool();
+    array_append(*g_TestTable[string("string.cpp")], {"string_pool", test_string_pool});
+    extern void test_rope();
+    array_append(*g_TestTable[string("string.cpp")], {"rope", test_rope});
+    extern void test_string_builder();
+    array_append(*g_TestTable[string("string.cpp")], {"string_builder", test_string_builder});
+    extern void test_shared_buffer();
+    array_append(*g_TestTable[string("string.cpp")], {"shared_buffer", test_shared_buffer});
     extern void test_hardware_concurrency();
     array_append(*g_TestTable[string("thread.cpp")], {"hardware_concurrency", test_hardware_concurrency});
+    extern void test_cpu_topology();
+    array_append(*g_TestTable[string("thread.cpp")], {"cpu_topology", test_cpu_topology});
     extern void test_ids();
     array_append(*g_TestTable[string("thread.cpp")], {"ids", test_ids});
     extern void test_thread_local_storage();
@@ -280,10 +576,52 @@ void build_test_table() {
     array_append(*g_TestTable[string("thread.cpp")], {"mutex_lock", test_mutex_lock});
     extern void test_fast_mutex_lock();
     array_append(*g_TestTable[string("thread.cpp")], {"fast_mutex_lock", test_fast_mutex_lock});
+    extern void test_lock_profile();
+    array_append(*g_TestTable[string("thread.cpp")], {"lock_profile", test_lock_profile});
+    extern void test_shared_mutex();
+    array_append(*g_TestTable[string("thread.cpp")], {"shared_mutex", test_shared_mutex});
+    extern void test_atomic();
+    array_append(*g_TestTable[string("thread.cpp")], {"atomic", test_atomic});
     extern void test_condition_variable();
     array_append(*g_TestTable[string("thread.cpp")], {"condition_variable", test_condition_variable});
+    extern void test_condition_variable_timed();
+    array_append(*g_TestTable[string("thread.cpp")], {"condition_variable_timed", test_condition_variable_timed});
+    extern void test_semaphore_latch_barrier();
+    array_append(*g_TestTable[string("thread.cpp")], {"semaphore_latch_barrier", test_semaphore_latch_barrier});
     extern void test_context();
     array_append(*g_TestTable[string("thread.cpp")], {"context", test_context});
+    extern void test_context_inherit();
+    array_append(*g_TestTable[string("thread.cpp")], {"context_inherit", test_context_inherit});
+    extern void test_async_log_writer();
+    array_append(*g_TestTable[string("thread.cpp")], {"async_log_writer", test_async_log_writer});
+    extern void test_async_log_writer_stress();
+    array_append(*g_TestTable[string("thread.cpp")], {"async_log_writer_stress", test_async_log_writer_stress});
+    extern void test_os_channel();
+    array_append(*g_TestTable[string("thread.cpp")], {"os_channel", test_os_channel});
+    extern void test_clock();
+    array_append(*g_TestTable[string("thread.cpp")], {"clock", test_clock});
+    extern void test_profiler();
+    array_append(*g_TestTable[string("thread.cpp")], {"profiler", test_profiler});
+    extern void test_job_system();
+    array_append(*g_TestTable[string("thread.cpp")], {"job_system", test_job_system});
+    extern void test_parallel_for_reduce();
+    array_append(*g_TestTable[string("thread.cpp")], {"parallel_for_reduce", test_parallel_for_reduce});
+    extern void test_fiber_switch();
+    array_append(*g_TestTable[string("thread.cpp")], {"fiber_switch", test_fiber_switch});
+    extern void test_job_system_fibers();
+    array_append(*g_TestTable[string("thread.cpp")], {"job_system_fibers", test_job_system_fibers});
+    extern void test_task();
+    array_append(*g_TestTable[string("thread.cpp")], {"task", test_task});
+    extern void test_timer_wheel();
+    array_append(*g_TestTable[string("thread.cpp")], {"timer_wheel", test_timer_wheel});
+    extern void test_metrics();
+    array_append(*g_TestTable[string("thread.cpp")], {"metrics", test_metrics});
+    extern void test_reclaim();
+    array_append(*g_TestTable[string("thread.cpp")], {"reclaim", test_reclaim});
+    extern void test_concurrent_arena();
+    array_append(*g_TestTable[string("thread.cpp")], {"concurrent_arena", test_concurrent_arena});
+    extern void test_sockets();
+    array_append(*g_TestTable[string("thread.cpp")], {"sockets", test_sockets});
     extern void test_vec_ctor();
     array_append(*g_TestTable[string("vec.cpp")], {"vec_ctor", test_vec_ctor});
     extern void test_ctor_array();
@@ -506,5 +844,52 @@ void build_test_table() {
     array_append(*g_TestTable[string("vec.cpp")], {"cross", test_cross});
     extern void test_cross_nd();
     array_append(*g_TestTable[string("vec.cpp")], {"cross_nd", test_cross_nd});
+    extern void test_simd_backends();
+    array_append(*g_TestTable[string("vec.cpp")], {"simd_backends", test_simd_backends});
+    extern void test_batch_kernels();
+    array_append(*g_TestTable[string("vec.cpp")], {"batch_kernels", test_batch_kernels});
+    extern void test_simd_math();
+    array_append(*g_TestTable[string("vec.cpp")], {"simd_math", test_simd_math});
+    extern void test_half_precision();
+    array_append(*g_TestTable[string("vec.cpp")], {"half_precision", test_half_precision});
     */
 }
+
+void build_benchmark_table() {
+    extern void bench_array_append(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"array_append", bench_array_append});
+    extern void bench_hash_table_add_find(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"hash_table_add_find", bench_hash_table_add_find});
+    extern void bench_sort_10000(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"sort_10000", bench_sort_10000});
+    extern void bench_fmt_integers_and_floats(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"fmt_integers_and_floats", bench_fmt_integers_and_floats});
+    extern void bench_fmt_strings(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"fmt_strings", bench_fmt_strings});
+    extern void bench_parse_int(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"parse_int", bench_parse_int});
+    extern void bench_parse_float(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"parse_float", bench_parse_float});
+    extern void bench_m44_dot(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"m44_dot", bench_m44_dot});
+    extern void bench_v3_normalize_cross(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"v3_normalize_cross", bench_v3_normalize_cross});
+    extern void bench_transform_points_aos(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"transform_points_aos", bench_transform_points_aos});
+    extern void bench_transform_points_soa(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"transform_points_soa", bench_transform_points_soa});
+    extern void bench_simd_sincos_f32x8(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"simd_sincos_f32x8", bench_simd_sincos_f32x8});
+    extern void bench_rng_fill_f64_4096(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"rng_fill_f64_4096", bench_rng_fill_f64_4096});
+    extern void bench_regex_find_log_64k(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"regex_find_log_64k", bench_regex_find_log_64k});
+    extern void bench_lz_compress_1mb(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"lz_compress_1mb", bench_lz_compress_1mb});
+    extern void bench_dense_lu_solve_200(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"dense_lu_solve_200", bench_dense_lu_solve_200});
+    extern void bench_atomic_inc(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"atomic_inc", bench_atomic_inc});
+    extern void bench_fast_mutex_lock_unlock(benchmark_state *state);
+    array_append(*g_BenchmarkTable[string("library.cpp")], {"fast_mutex_lock_unlock", bench_fast_mutex_lock_unlock});
+}
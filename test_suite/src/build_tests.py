@@ -28,6 +28,7 @@ def get_short_file_path(path):
     return path[index:]
     
 build_test_table_contents = ""
+build_benchmark_table_contents = ""
 
 def output_test(file, test_name):
     global build_test_table_contents
@@ -37,6 +38,25 @@ def output_test(file, test_name):
     build_test_table_contents += f"    extern void {func_name}();\n"
     build_test_table_contents += f'    array_append(*g_TestTable[string("{file}")], {{"{test_name}", {func_name}}});\n'
     
+def output_benchmark(file, benchmark_name):
+    global build_benchmark_table_contents
+
+    func_name = "bench_" + benchmark_name
+
+    build_benchmark_table_contents += f"    extern void {func_name}(benchmark_state *state);\n"
+    build_benchmark_table_contents += f'    array_append(*g_BenchmarkTable[string("{file}")], {{"{benchmark_name}", {func_name}}});\n'
+
+def handle_benchmark_file(path, file_name):
+    with open(path, "r", encoding = "utf8") as f :
+        contents = comment_remover(f.read())
+
+    # @Volatile: Identifier must match the macro in bench.h
+    for b in re.finditer(r"(?<![x\w])BENCHMARK(\(.*?\))", contents):
+        benchmark_name = b.group(1)[1:-1]
+        output_benchmark(get_short_file_path(path), benchmark_name)
+
+        print(file_name, benchmark_name)
+
 def handle_file(path, file_name):
     global build_test_table_contents
     
@@ -99,12 +119,21 @@ for root, dirs, files in os.walk("./tests"):
     for file in files:
         if file.endswith(".cpp"):
             handle_file(os.path.join(root, file), file)
+
+for root, dirs, files in os.walk("./benchmarks"):
+    for file in files:
+        if file.endswith(".cpp"):
+            handle_benchmark_file(os.path.join(root, file), file)
            
 file_content = (''
-'#include "test.h"\n'
+'#include "bench.h"\n'
 '\n'
 'void build_test_table() {\n'
 f'{build_test_table_contents}\n'
+'}\n'
+'\n'
+'void build_benchmark_table() {\n'
+f'{build_benchmark_table_contents}'
 '}\n')
 
 with open("build_test_table.cpp", "w") as f:
@@ -1,4 +1,4 @@
-#include "test.h"
+#include "bench.h"
 
 import lstd.big_integer;
 
@@ -110,9 +110,26 @@ s32 main() {
 
     OVERRIDE_CONTEXT(newContext);
 
+    // Run with --bench to run the benchmarks instead of the tests (see bench.h for the other options)
+    bool benchmark = false;
+    benchmark_options benchmarkOptions;
+    For(os_get_command_line_arguments()) {
+        if (it == "--bench") benchmark = true;
+        if (match_beginning(it, "--bench-filter=")) benchmarkOptions.Filter = substring(it, 15, it.Length);
+        if (match_beginning(it, "--bench-json=")) benchmarkOptions.JsonPath = substring(it, 13, it.Length);
+        if (match_beginning(it, "--bench-csv=")) benchmarkOptions.CsvPath = substring(it, 12, it.Length);
+    }
+
     PUSH_CONTEXT(newContext) {
-        build_test_table();
-        run_tests();
+        if (benchmark) {
+            run_benchmarks(benchmarkOptions);
+
+            extern void run_allocator_benchmarks();
+            if (!benchmarkOptions.Filter) run_allocator_benchmarks();
+        } else {
+            build_test_table();
+            run_tests();
+        }
     }
     print("\nFinished tests, time taken: {:f} seconds, bytes used: {}, pools used: {}\n\n", os_time_to_seconds(os_get_time() - start), __TempAllocData.TotalUsed, __TempAllocData.PoolsCount);
 
@@ -3,4 +3,33 @@
 #include <lstd/io.h>
 #include <lstd/math.h>
 #include <lstd/memory/array.h>
+#include <lstd/memory/hash_set.h>
 #include <lstd/memory/hash_table.h>
+#include <lstd/memory/hash_table_build.h>
+#include <lstd/memory/static_hash_map.h>
+#include <lstd/memory/swiss_table.h>
+#include <lstd/memory/incremental_hash_table.h>
+#include <lstd/memory/int_hash_table.h>
+#include <lstd/memory/concurrent_hash_table.h>
+#include <lstd/memory/lru_cache.h>
+#include <lstd/memory/intrusive_list.h>
+#include <lstd/memory/intrusive_hash_table.h>
+#include <lstd/memory/slot_map.h>
+#include <lstd/memory/soa_array.h>
+#include <lstd/memory/bucket_array.h>
+#include <lstd/memory/small_array.h>
+#include <lstd/memory/ring_buffer.h>
+#include <lstd/memory/deque.h>
+#include <lstd/memory/lock_free_queue.h>
+#include <lstd/memory/bitset.h>
+#include <lstd/memory/packed_array.h>
+#include <lstd/memory/sort.h>
+#include <lstd/memory/sorted_search.h>
+#include <lstd/memory/array_algorithms.h>
+#include <lstd/memory/priority_queue.h>
+#include <lstd/memory/btree_map.h>
+#include <lstd/memory/bloom_filter.h>
+#include <lstd/memory/cuckoo_filter.h>
+#include <lstd/memory/string_pool.h>
+#include <lstd/memory/string_index.h>
+#include <lstd/memory/rope.h>
@@ -58,4 +58,33 @@ TEST(lsb) {
     assert_eq(lsb(u128(0b0000000000000000000000000000000000000000000000000000000000000001ull, 0b1110101010000000010000001000101100000000000000000000000000000000ull)), 32);
     assert_eq(lsb(u128(0b0000000000000000000000000000000000000000000000000000000000000011ull, 0b0000000000000000000000000000000000000000000000000000000000000000ull)), 64);
     assert_eq(lsb(u128(0b1000000000000000000000000000000000000000000000000000000000000000ull, 0b0000000000000000000000000000000000000000000000000000000000000000ull)), 127);
-}
\ No newline at end of file
+}
+// u128 arithmetic, constant evaluated (the portable paths)
+static_assert(mul128(0xFFFFFFFFFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull) == u128(0xFFFFFFFFFFFFFFFEull, 1));
+static_assert(u128(3, 0xFFFFFFFFFFFFFFFFull) * u128(0, 10) == u128(39, 0xFFFFFFFFFFFFFFF6ull));
+static_assert(u128(0x123456789ABCDEFull, 0xFEDCBA9876543210ull) / u128(0, 1000) == u128(0x4A90BE587DE6ull, 0xE55FF6F878F348C1ull));
+static_assert(u128(0x123456789ABCDEFull, 0xFEDCBA9876543210ull) % u128(0, 1000) == 40);
+static_assert(u128(0x123456789ABCDEFull, 0xFEDCBA9876543210ull) / u128(0x1234ull, 0x5678ull) == u128(0, 0x10004C016906ull));
+static_assert(-u128(1) == u128(0xFFFFFFFFFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull));
+static_assert(s128(-7) / s128(2) == s128(-3) && s128(-7) % s128(2) == s128(-1));
+
+TEST(u128_arithmetic) {
+    // The same cases at runtime, which use the intrinsics
+    u64 max = 0xFFFFFFFFFFFFFFFFull;
+    assert_true(mul128(max, max) == u128(0xFFFFFFFFFFFFFFFEull, 1));
+
+    u128 a = u128(0x123456789ABCDEFull, 0xFEDCBA9876543210ull);
+    assert_true(a / u128(0, 1000) == u128(0x4A90BE587DE6ull, 0xE55FF6F878F348C1ull));
+    assert_true(a % u128(0, 1000) == 40);
+    assert_true(a / u128(0x1234ull, 0x5678ull) == u128(0, 0x10004C016906ull));
+
+    // Divisors with and without the high half, quotients with and without it
+    For_as(d, to_stack_array(u128(0, 3), u128(0, max), u128(1, 0), u128(0x8000000000000000ull, 1), u128(12345, 678910))) {
+        u128 q = a / d, r = a % d;
+        assert_true(r < d);
+        assert_true(q * d + r == a);
+    }
+
+    assert_true(s128(-7) / s128(2) == s128(-3));
+    assert_true(s128(-7) % s128(2) == s128(-1));
+}
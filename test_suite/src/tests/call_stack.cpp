@@ -0,0 +1,44 @@
+#include <lstd/call_stack.h>
+
+#include "../test.h"
+
+// Two call sites, so the return addresses (and the stacks) differ
+file_scope never_inline u64 capture_here() { return call_stack_capture(); }
+file_scope never_inline u64 capture_there() { return call_stack_capture(); }
+
+TEST(call_stack_intern) {
+    void *frames[] = {(void *) 0x1000, (void *) 0x2000, (void *) 0x3000};
+
+    u64 id = call_stack_intern(frames, 3);
+    assert_true(id != 0);
+    assert_eq(call_stack_intern(frames, 3), id);
+    assert_true(call_stack_intern(frames, 2) != id);
+    assert_eq(call_stack_intern(frames, 0), 0);
+
+    call_stack stack;
+    assert_true(call_stack_get(id, &stack));
+    assert_eq(stack.Count, 3);
+    assert_eq(stack.Frames[2], (void *) 0x3000);
+
+    assert_false(call_stack_get(id + 1, &stack));
+}
+
+TEST(call_stack_capture) {
+    u64 a = 0, b = 0;
+    For(range(2)) {
+        u64 here = capture_here();
+        if (it == 0) a = here;
+        assert_eq(here, a);  // The same stack every time
+        b = capture_there();
+    }
+    assert_true(a != 0);
+    assert_true(a != b);
+
+    call_stack stack;
+    assert_true(call_stack_get(a, &stack));
+    assert_gt(stack.Count, 1);
+
+    auto call = call_stack_resolve(stack.Frames[0]);
+    assert_true(call.Name.Length > 0);
+    assert_eq(call_stack_resolve(stack.Frames[0]).Name.Data, call.Name.Data);  // Cached
+}
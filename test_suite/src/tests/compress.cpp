@@ -0,0 +1,113 @@
+#include <lstd/compress.h>
+
+#include "../test.h"
+
+struct compressed_output : writer {
+    bytes Out;
+    s64 Flushes = 0;
+
+    void write(const byte *data, s64 size) override { array_append(Out, data, size); }
+    void flush() override { ++Flushes; }
+};
+
+// Text-like data which compresses: words from a small vocabulary, with xorshift picking them
+file_scope void make_text(bytes &out, s64 size, u64 seed) {
+    const char *words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog, ", "and\n"};
+    while (out.Count < size) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        const char *word = words[seed % 9];
+        array_append(out, (const byte *) word, min(c_string_length(word), size - out.Count));
+    }
+}
+
+TEST(lz_roundtrip) {
+    s64 sizes[] = {0, 1, 12, 13, 100, 70000, 300000};
+    For_as(size, sizes) {
+        bytes text;
+        defer(free(text));
+        make_text(text, size, 42 + size);
+
+        byte *packed = allocate_array<byte>(lz_compress_bound(size) + 1);
+        defer(free(packed));
+        s64 packedSize = lz_compress(packed, text.Data, size);
+        assert_le(packedSize, lz_compress_bound(size));
+        if (size >= 70000) assert_lt(packedSize, size / 3);
+
+        byte *raw = allocate_array<byte>(size + 1);
+        defer(free(raw));
+        assert_eq(lz_decompress(raw, size, packed, packedSize), size);
+        assert_true(equal_memory(raw, text.Data, size));
+
+        // Doesn't fit
+        if (size) assert_eq(lz_decompress(raw, size - 1, packed, packedSize), -1);
+    }
+
+    // Runs which overlap their source (offset 1 and 3)
+    byte runs[1000];
+    For(range(500)) runs[it] = 'a';
+    For(range(500, 1000)) runs[it] = (byte) ("xyz"[it % 3]);
+
+    byte packed[lz_compress_bound(1000)], raw[1000];
+    s64 packedSize = lz_compress(packed, runs, 1000);
+    assert_lt(packedSize, 50);
+    assert_eq(lz_decompress(raw, 1000, packed, packedSize), 1000);
+    assert_true(equal_memory(raw, runs, 1000));
+
+    // An offset before the beginning of the output
+    byte bad[] = {0x10, 'a', 5, 0};
+    assert_eq(lz_decompress(raw, 1000, bad, sizeof(bad)), -1);
+}
+
+TEST(compress_stream) {
+    bytes text;
+    defer(free(text));
+    make_text(text, 1000000, 7);
+
+    compressed_output out;
+    defer(free(out.Out));
+
+    // Small blocks and 4 of them at a time, so compressing goes through the job system more than once
+    compress_writer w;
+    compress_writer_init(w, &out, 64_KiB, 4);
+    for (s64 i = 0; i < text.Count; i += 1000) write(&w, text.Data + i, min<s64>(1000, text.Count - i));
+    assert_eq(w.RawBytes, text.Count);
+    free(w);
+
+    assert_lt(out.Out.Count, text.Count / 3);
+    assert_eq(out.Flushes, 1);
+
+    // Read back in chunks which don't line up with the blocks
+    s64 offset = 0, chunk = 777;
+    auto read = [&]() {
+        bytes result = bytes(out.Out.Data + offset, min(chunk, out.Out.Count - offset));
+        offset += result.Count;
+        return result;
+    };
+
+    decompress_reader r;
+    assert_true(decompress_reader_init(r, &read));
+    defer(free(r));
+
+    byte *back = allocate_array<byte>(text.Count + 1);
+    defer(free(back));
+    assert_eq(decompress_reader_read(r, back, text.Count + 1), text.Count);
+    assert_true(equal_memory(back, text.Data, text.Count));
+    assert_false(r.Failed);
+
+    // Cut short
+    out.Out.Count -= 100;
+    offset = 0;
+    assert_true(decompress_reader_init(r, &read));
+    while (decompress_reader_next(r)) {}
+    assert_true(r.Failed);
+
+    // A flipped bit is caught by the block's checksum (or the decoder)
+    out.Out.Count += 100;
+    out.Out[1000] ^= 4;
+    offset = 0;
+    assert_true(decompress_reader_init(r, &read));
+    while (decompress_reader_next(r)) {}
+    assert_true(r.Failed);
+}
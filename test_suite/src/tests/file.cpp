@@ -1,4 +1,5 @@
 import path;
+import path.hash_tree;
 
 #include "../test.h"
 
@@ -41,6 +42,70 @@ TEST(path_manipulation) {
     }
 }
 
+TEST(path_manipulation_into) {
+    string out;
+    defer(free(out));
+
+    string_append(out, "prefix ");
+    path_join_into(out, path_normalize("/home/data"), "bin");
+
+    string expected = path_normalize("/home/data/bin");
+    defer(free(expected));
+    assert_eq(out[{0, 7}], "prefix ");
+    assert_eq(out[{7, out.Length}], expected);
+
+    // Joining again reuses the space when there is enough
+    s64 allocated = out.Allocated;
+    out.Count = out.Length = 0;
+    path_join_into(out, "a", "b");
+    assert_eq(out.Allocated, allocated);
+
+    string dots;
+    clone(&dots, "../../data/bin/release-x64/../debug-x64/../debug/lstd.exe");
+    defer(free(dots));
+
+    string normalized = path_normalize(dots);
+    defer(free(normalized));
+
+    path_normalize_in_place(dots);
+    assert_eq(dots, normalized);
+
+    utf8 buffer[64];
+    s64 count = path_normalize_to_buffer(buffer, "a/./b//../c/");
+    assert_eq(string(buffer, count), path_normalize("a/c"));
+
+    count = path_normalize_to_buffer(buffer, "a/..");
+    assert_eq(string(buffer, count), ".");
+}
+
+// Tests which touch the disk work in a directory of their own in the system's temp folder, so they
+// don't depend on where the suite is run from. The text file is generated instead of read from data/.
+file_scope constexpr s64 TEST_TEXT_SIZE = 277;
+
+file_scope string test_make_temp_dir(const string &name) {
+#if OS == WINDOWS
+    auto [base, success] = os_get_env("TEMP", true);
+#else
+    auto [base, success] = os_get_env("TMPDIR", true);
+#endif
+    string dir = path_join(success ? base : string("/tmp"), tsprint("lstd_test_{}_{}", os_get_pid(), name));
+    if (success) free(base);
+
+    path_create_directory(dir);
+    return dir;
+}
+
+file_scope string test_write_text(const string &dir) {
+    string text = path_join(dir, "text");
+
+    string contents;
+    defer(free(contents));
+    For(range(TEST_TEXT_SIZE)) string_append(contents, (utf32)(it % 40 == 39 ? '\n' : 'a' + it % 26));
+
+    path_write_to_file(text, contents, path_write_mode::Overwrite_Entire);
+    return text;
+}
+
 TEST(file_size) {
     auto thisFile = string(__FILE__);
     string dataFolder = path_join(path_directory(thisFile), "data");
@@ -56,6 +121,395 @@ TEST(file_size) {
     assert_eq(path_file_size(text), 277);
 }
 
+TEST(file_mapping) {
+    string dir  = test_make_temp_dir("file_mapping");
+    string text = test_write_text(dir);
+    defer({
+        path_delete_file(text);
+        path_delete_directory(dir);
+        free(text);
+        free(dir);
+    });
+
+    auto [contents, success] = path_read_entire_file(text);
+    assert(success);
+    defer(free(contents.Data));
+
+    auto mapping = path_open_mapping(text, path_map_mode::Read_Only, path_map_hint::Random);
+    assert(mapping.File);
+    defer(free(mapping));
+
+    assert_eq(mapping.Size, TEST_TEXT_SIZE);
+
+    auto all = path_map_view(mapping);
+    defer(path_unmap_view(all));
+    assert_eq(all.Content, contents);
+
+    // Not at a page boundary
+    auto part = path_map_view(mapping, 100, 50);
+    defer(path_unmap_view(part));
+    assert_eq(part.Content, bytes(contents.Data + 100, 50));
+
+    path_advise_view(part, path_map_hint::Will_Need);
+
+    auto empty = path_map_view(mapping, TEST_TEXT_SIZE, 0);
+    assert_eq(empty.Content.Count, 0);
+}
+
+TEST(file_read) {
+    string dir  = test_make_temp_dir("file_read");
+    string text = test_write_text(dir);
+    defer({
+        path_delete_file(text);
+        path_delete_directory(dir);
+        free(text);
+        free(dir);
+    });
+
+    auto [contents, success] = path_read_entire_file(text);
+    assert(success);
+    defer(free(contents.Data));
+    assert_eq(contents.Count, TEST_TEXT_SIZE);
+
+    // Into our buffer, aligned and with room for the last sector so the read is unbuffered
+    byte *storage = allocate_array<byte>(PATH_UNBUFFERED_ALIGNMENT, {.Alignment = (u32) PATH_UNBUFFERED_ALIGNMENT});
+    defer(free(storage));
+
+    auto [direct, directSuccess] = path_read_entire_file(text, bytes(storage, PATH_UNBUFFERED_ALIGNMENT), {.Unbuffered = true});
+    assert_true(directSuccess);
+    assert_true(direct.Data == storage);
+    assert_eq(direct, contents);
+
+    // Unaligned falls back to a normal read
+    auto [unaligned, unalignedSuccess] = path_read_entire_file(text, bytes(storage + 1, 300), {.Unbuffered = true});
+    assert_true(unalignedSuccess);
+    assert_eq(unaligned, contents);
+
+    // Too small
+    assert_false(path_read_entire_file(text, bytes(storage, 100)).Success);
+}
+
+TEST(file_writer_reader) {
+    string dir = test_make_temp_dir("file_writer_reader");
+    string out = path_join(dir, "writer_output");
+    defer({
+        path_delete_file(out);
+        path_delete_directory(dir);
+        free(out);
+        free(dir);
+    });
+
+    // Small buffers so writes and reads cross them
+    file_writer w;
+    assert_true(file_writer_open(w, out, file_writer::OVERWRITE_ENTIRE, 16));
+
+    For(range(10)) fmt_to_writer(&w, "line {}\n", it);
+    write(&w, string("a write which is bigger than the whole buffer\n"));
+    free(w);
+
+    file_reader r;
+    assert_true(file_reader_open(r, out, 16));
+
+    string result;
+    byte piece[5];
+    while (true) {
+        s64 n = file_reader_read(r, piece, 5);
+        string_append(result, (const utf8 *) piece, n);
+        if (n < 5) break;
+    }
+    assert_false(r.Failed);
+    free(r);
+    defer(free(result));
+
+    assert_eq(result, "line 0\nline 1\nline 2\nline 3\nline 4\nline 5\nline 6\nline 7\nline 8\nline 9\na write which is bigger than the whole buffer\n");
+}
+
+TEST(async_io) {
+    string dir  = test_make_temp_dir("async_io");
+    string text = test_write_text(dir);
+    defer({
+        path_delete_file(text);
+        path_delete_directory(dir);
+        free(text);
+        free(dir);
+    });
+
+    auto [contents, success] = path_read_entire_file(text);
+    assert(success);
+    defer(free(contents.Data));
+
+    // No completion threads - everything completes in async_io_poll/async_io_wait on this thread.
+    // A small limit so most requests wait in the queue and get submitted as others complete.
+    async_io io;
+    assert_true(async_io_init(io, 0, 4));
+    defer(free(io));
+
+    auto file = async_io_open(io, text);
+    assert_true(file.Handle != null);
+    defer(free(file));
+    assert_eq(file.Size, TEST_TEXT_SIZE);
+
+    constexpr s64 PIECE = 10;
+    constexpr s64 PIECES = 30;  // 300 bytes, the last ones read past the end
+
+    byte data[PIECE * PIECES];
+    async_io_request requests[PIECES];
+
+    s64 callbacks = 0;
+    auto onDone = [&](async_io_request *) { ++callbacks; };
+
+    For(range(PIECES)) {
+        auto *r     = requests + it;
+        r->File     = &file;
+        r->Offset   = it * PIECE;
+        r->Data     = data + it * PIECE;
+        r->Size     = PIECE;
+        r->Callback = &onDone;
+        async_io_queue(io, r);
+    }
+    async_io_submit(io);
+
+    s64 total = 0;
+    For(requests) {
+        async_io_wait(io, &it);
+        assert_eq(it.Error, 0);
+        total += it.Transferred;
+    }
+
+    assert_eq(callbacks, PIECES);
+    assert_eq(total, TEST_TEXT_SIZE);
+    assert_eq(bytes(data, TEST_TEXT_SIZE), contents);
+}
+
+TEST(path_watcher) {
+    string dir = test_make_temp_dir("path_watcher");
+    defer(free(dir));
+    defer(path_delete_directory(dir));
+
+    path_watcher w;
+    assert_true(path_watcher_start(w, dir));
+    defer(free(w));
+
+    s64 emitted = 0;
+    auto onChanged = [&](const array<path_change_event> &) { ++emitted; };
+    w.Changed.connect(&onChanged);
+
+    string file = path_join(dir, "a.txt");
+    defer(free(file));
+
+    // Created and written to - coalesced into one Added
+    path_write_to_file(file, "first", path_write_mode::Overwrite_Entire);
+    path_write_to_file(file, "second", path_write_mode::Append);
+
+    auto &added = path_watcher_poll(w, 1000);
+    assert_eq(added.Count, 1);
+    assert_eq(added[0].Path, "a.txt");
+    assert_true(added[0].Kind == path_change::Added);
+    assert_eq(emitted, 1);
+
+    path_write_to_file(file, "third", path_write_mode::Append);
+
+    auto &modified = path_watcher_poll(w, 1000);
+    assert_eq(modified.Count, 1);
+    assert_true(modified[0].Kind == path_change::Modified);
+
+    path_delete_file(file);
+
+    auto &removed = path_watcher_poll(w, 1000);
+    assert_eq(removed.Count, 1);
+    assert_true(removed[0].Kind == path_change::Removed);
+
+    // Nothing happened since
+    assert_eq(path_watcher_poll(w).Count, 0);
+    assert_eq(emitted, 3);
+}
+
+TEST(path_tree_walker) {
+    string root = test_make_temp_dir("path_tree_walker");
+    defer(free(root));
+
+    string sub = path_join(root, "sub");
+    defer(free(sub));
+
+    string a = path_join(root, "a.txt");
+    string b = path_join(sub, "b.txt");
+    defer(free(a));
+    defer(free(b));
+
+    path_create_directory(sub);
+    path_write_to_file(a, "hello", path_write_mode::Overwrite_Entire);
+    path_write_to_file(b, "hi", path_write_mode::Overwrite_Entire);
+    defer({
+        path_delete_file(b);
+        path_delete_file(a);
+        path_delete_directory(sub);
+        path_delete_directory(root);
+    });
+
+    s64 files = 0, dirs = 0, size = 0;
+
+    path_tree_walker w;
+    assert_true(path_tree_walker_start(w, root));
+    while (path_tree_walker_next(w)) {
+        if (w.Entry.IsDirectory) {
+            ++dirs;
+            assert_eq(w.Entry.Name, "sub");
+            assert_eq(w.Entry.Depth, 0);
+        } else {
+            ++files;
+            size += w.Entry.Size;
+            if (w.Entry.Name == "b.txt") assert_eq(w.Entry.Depth, 1);
+        }
+    }
+    free(w);
+
+    assert_eq(files, 2);
+    assert_eq(dirs, 1);
+    assert_eq(size, 7);
+
+    // Skipping the directory
+    files = 0;
+    assert_true(path_tree_walker_start(w, root));
+    while (path_tree_walker_next(w)) {
+        if (w.Entry.IsDirectory) path_tree_walker_skip(w);
+        else ++files;
+    }
+    free(w);
+    assert_eq(files, 1);
+
+    s64 parallelFiles = 0, parallelBytes = 0;
+    auto count = [&](const path_entry &e) {
+        if (e.IsDirectory) return;
+        atomic_inc(&parallelFiles);
+        atomic_add(&parallelBytes, e.Size);
+    };
+    path_walk_parallel(root, &count, 4);
+
+    assert_eq(parallelFiles, 2);
+    assert_eq(parallelBytes, 7);
+}
+
+TEST(path_hash_tree) {
+    string root = test_make_temp_dir("path_hash_tree");
+    defer(free(root));
+
+    string sub = path_join(root, "sub");
+    defer(free(sub));
+
+    string a = path_join(root, "a.txt");
+    string b = path_join(sub, "b.txt");
+    string empty = path_join(root, "empty");
+    defer(free(a));
+    defer(free(b));
+    defer(free(empty));
+
+    path_create_directory(sub);
+    path_write_to_file(a, "hello", path_write_mode::Overwrite_Entire);
+    path_write_to_file(b, "hi", path_write_mode::Overwrite_Entire);
+    path_write_to_file(empty, "", path_write_mode::Overwrite_Entire);
+    defer({
+        path_delete_file(empty);
+        path_delete_file(b);
+        path_delete_file(a);
+        path_delete_directory(sub);
+        path_delete_directory(root);
+    });
+
+    string subB = path_join("sub", "b.txt");
+    defer(free(subB));
+
+    // Read into the buffer, then everything mapped
+    For(range(2)) {
+        path_hash_tree_options options;
+        options.Seed = 7;
+        options.MapThreshold = it ? 0 : 256_KiB;
+
+        auto digests = path_hash_tree(root, options);
+        defer(free(digests));
+
+        assert_eq(digests.Digests.Count, 3);
+        assert_eq(digests.Failed.Count, 0);
+        assert_eq(*find(digests.Digests, "a.txt").Value, hash_bytes("hello", 5, 7));
+        assert_eq(*find(digests.Digests, subB).Value, hash_bytes("hi", 2, 7));
+        assert_eq(*find(digests.Digests, "empty").Value, hash_bytes(null, 0, 7));
+    }
+
+    // Not recursive
+    path_hash_tree_options options;
+    options.Recursive = false;
+
+    auto top = path_hash_tree(root, options);
+    defer(free(top));
+    assert_eq(top.Digests.Count, 2);
+    assert_false(has(top.Digests, subB));
+}
+
+TEST(path_copy_transfer) {
+    string dir  = test_make_temp_dir("path_copy_transfer");
+    string src  = test_write_text(dir);
+    string dest = path_join(dir, "text_copy");
+    defer({
+        path_delete_file(src);
+        path_delete_directory(dir);
+        free(src);
+        free(dest);
+        free(dir);
+    });
+
+    s64 lastCopied = 0, lastTotal = 0;
+    auto progress = [&](s64 copied, s64 total) {
+        lastCopied = copied;
+        lastTotal  = total;
+        return true;
+    };
+
+    path_copy_options options;
+    options.Progress = &progress;
+
+    assert_true(path_copy(src, dest, options));
+    defer(path_delete_file(dest));
+
+    assert_eq(path_file_size(dest), TEST_TEXT_SIZE);
+    assert_eq(lastCopied, TEST_TEXT_SIZE);
+    assert_eq(lastTotal, TEST_TEXT_SIZE);
+
+    // Fails since it exists and we didn't ask to overwrite
+    assert_false(path_copy(src, dest, path_copy_options{}));
+
+    // Cancelling
+    auto cancel = [](s64, s64) { return false; };
+    path_copy_options cancelling;
+    cancelling.Overwrite = true;
+    cancelling.Progress  = &cancel;
+    assert_false(path_copy(src, dest, cancelling));
+
+    string_builder_writer all;
+    defer(free(all));
+    assert_eq(path_transfer(src, &all), TEST_TEXT_SIZE);
+
+    auto [contents, success] = path_read_entire_file(src);
+    assert(success);
+    defer(free(contents.Data));
+
+    string allString = string_builder_combine(all.Builder);
+    defer(free(allString));
+    assert_eq(bytes((byte *) allString.Data, allString.Count), contents);
+
+    counting_writer part;
+    assert_eq(path_transfer(src, &part, 100, 50), 50);
+    assert_eq(part.Count, 50);
+
+    path_copy_options unbuffered;
+    unbuffered.Unbuffered = true;
+
+    string_builder_writer tail;
+    defer(free(tail));
+    assert_eq(path_transfer(src, &tail, 270, -1, unbuffered), 7);
+    string tailString = string_builder_combine(tail.Builder);
+    defer(free(tailString));
+    assert_eq(bytes((byte *) tailString.Data, tailString.Count), bytes(contents.Data + 270, 7));
+}
+
 /* Just wearing out the SSD :*
 TEST(writing_hello_250_times) {
     auto thisFile = string(__FILE__);
@@ -1,3 +1,7 @@
+import fmt.format_float.specs;
+import fmt.format_float.fallback;
+import fmt.format_float.grisu;
+
 #include <lstd/types/numeric_info.h>
 
 #include "../test.h"
@@ -159,6 +163,26 @@ TEST(format_int_hexadecimal) {
 // format\(([^)]*)\)
 
 // @Locale
+TEST(format_int_large) {
+    CHECK_WRITE("99999999", "{}", 99999999ull);
+    CHECK_WRITE("100000000", "{}", 100000000ull);
+    CHECK_WRITE("1234567890123456", "{}", 1234567890123456ull);
+    CHECK_WRITE("9999999999999999", "{}", 9999999999999999ull);
+    CHECK_WRITE("10000000000000000", "{}", 10000000000000000ull);
+    CHECK_WRITE("12345678901234567890", "{}", 12345678901234567890ull);
+    CHECK_WRITE("18446744073709551615", "{}", 18446744073709551615ull);
+    CHECK_WRITE("-9223372036854775808", "{}", numeric_info<s64>::min());
+    CHECK_WRITE("-1000000000000000000", "{}", -1000000000000000000ll);
+    CHECK_WRITE("deadbeefcafebabe", "{:x}", 0xDEADBEEFCAFEBABEull);
+    CHECK_WRITE("DEADBEEFCAFEBABE", "{:X}", 0xDEADBEEFCAFEBABEull);
+    CHECK_WRITE("100", "{:x}", 0x100ull);
+    CHECK_WRITE("100", "{:X}", 0x100ull);
+    CHECK_WRITE("1010010111110000", "{:b}", 0xA5F0ull);
+    CHECK_WRITE("1000000000000000000000000000000000000000000000000000000000000001", "{:b}", 0x8000000000000001ull);
+    CHECK_WRITE("111111111", "{:b}", 0x1FFull);
+    CHECK_WRITE("1777777777777777777777", "{:o}", numeric_info<u64>::max());
+}
+
 TEST(format_int_localeish) {
     CHECK_WRITE("123", "{:n}", 123);
     CHECK_WRITE("1,234", "{:n}", 1234);
@@ -170,6 +194,12 @@ TEST(format_f32) {
     CHECK_WRITE("0", "{}", 0.0f);
     CHECK_WRITE("392.500000", "{0:f}", 392.5f);
     CHECK_WRITE("12.500000%", "{0:%}", 0.125f);
+
+    // Shortest representation of the f32, not of the f64 it converts to
+    CHECK_WRITE("3.14159", "{}", 3.14159f);
+    CHECK_WRITE("1e-45", "{}", 1e-45f);
+    CHECK_WRITE("3.4028235e+38", "{}", numeric_info<f32>::max());
+    CHECK_WRITE("0.10000000149011612", "{:.17}", 0.1f);
 }
 
 TEST(format_f64) {
@@ -258,6 +288,55 @@ TEST(precision_rounding) {
     CHECK_WRITE("3788512123356.985352", "{:f}", 3788512123356.985352);
 }
 
+TEST(precision_rounding_exact) {
+    // Exact ties, Grisu can't round these and we fall back to exact digit generation (half to even)
+    CHECK_WRITE("0.12", "{:.2f}", 0.125);
+    CHECK_WRITE("0.38", "{:.2f}", 0.375);
+    CHECK_WRITE("0", "{:.0f}", 0.5);
+    CHECK_WRITE("2", "{:.0f}", 1.5);
+    CHECK_WRITE("2", "{:.0f}", 2.5);
+    CHECK_WRITE("2.2e+00", "{:.1e}", 2.25);
+
+    // More digits than Grisu can produce
+    CHECK_WRITE("0.100000000000000005551115123126", "{:.30f}", 0.1);
+    CHECK_WRITE("0.33333333333333331483", "{:.20}", 1.0 / 3);
+}
+
+TEST(precision_rounding_random) {
+    // Grisu either gives the correctly rounded digits or gives up and we fall back to exact digit generation,
+    // so for any value and precision it must agree with exact_to_decimal().
+    u64 seed = 42;
+    For(range(100000)) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        // Fixed formatting with exponents around 1, so there are digits before and after the point
+        bool fixed    = seed & 1;
+        u64 exponent  = fixed ? 1023 - 64 + (seed >> 1) % 128 : 1 + (seed >> 1) % 2046;
+        f64 value     = types::bit_cast<f64>((exponent << 52) | (seed >> 12));
+        s32 precision = (s32) ((seed >> 20) % (fixed ? 30 : 40)) + !fixed;
+
+        fmt_float_specs specs = {.ShowPoint = true, .Format = fixed ? fmt_float_specs::FIXED : fmt_float_specs::EXP};
+
+        string_builder grisu, exact;
+        defer(free(grisu));
+        defer(free(exact));
+
+        s32 grisuExp = grisu_to_decimal(grisu, value, precision, specs);
+        s32 exactExp = exact_to_decimal(exact, value, precision, fixed);
+
+        string grisuDigits = string_builder_combine(grisu);
+        string exactDigits = string_builder_combine(exact);
+        defer(free(grisuDigits));
+        defer(free(exactDigits));
+
+        // When no digit fits in the precision Grisu writes nothing and the fallback writes "0", both print as zeroes
+        if (!grisuDigits.Count && exactDigits == "0") continue;
+
+        assert_eq(grisuDigits, exactDigits);
+        assert_eq(grisuExp, exactExp);
+    }
+}
+
 TEST(prettify_float) {
     CHECK_WRITE("0.0001", "{}", 1e-4);
     CHECK_WRITE("1e-05", "{}", 1e-5);
@@ -417,6 +496,13 @@ TEST(fill) {
     CHECK_WRITE(u8"ФФ42", u8"{0:Ф>4}", 42);
     CHECK_WRITE(u8"\u0904\u090442", u8"{0:\u0904>4}", 42);
     CHECK_WRITE(u8"\U0002070E\U0002070E42", u8"{0:\U0002070E>4}", 42);
+
+    // More padding than one write_vectored() batch holds
+    string expected;
+    For(range(1198)) string_append(expected, U'Ф');
+    string_append(expected, "42");
+    CHECK_WRITE(expected, u8"{0:Ф>1200}", 42);
+    free(expected);
 }
 
 TEST(plus_sign) {
@@ -719,4 +805,388 @@ TEST(colors_and_emphasis) {
     CHECK_WRITE("\x1b[46m", "{!tCYAN;BG}");
     CHECK_WRITE("\x1b[92m", "{!tBRIGHT_GREEN}");
     CHECK_WRITE("\x1b[105m", "{!tBRIGHT_MAGENTA;BG}");
-}
\ No newline at end of file
+}
+
+TEST(compiled_format_string) {
+    CHECK_WRITE("", ""_fmt);
+    CHECK_WRITE("42", "{}"_fmt, 42);
+    CHECK_WRITE("answer = 42", "{0} = {1}"_fmt, "answer", 42);
+    CHECK_WRITE("first second first", "{0} {1} {0}"_fmt, "first", "second");
+    CHECK_WRITE("{42}", "{{{0}}}"_fmt, 42);
+    CHECK_WRITE("before { after }", "before {{ after }}"_fmt);
+
+    CHECK_WRITE("42  ", "{0:<4}"_fmt, 42);
+    CHECK_WRITE("**42", "{0:*>4}"_fmt, 42);
+    CHECK_WRITE("+0000392.6", "{0:+010.4g}"_fmt, 392.649);
+    CHECK_WRITE("12.34%", "{:.2%}"_fmt, 0.1234432);
+    CHECK_WRITE("1.2", "{:.{}}"_fmt, 1.2345, 2);
+    CHECK_WRITE("   42", "{0:{1}}"_fmt, 42, 5);
+
+    CHECK_WRITE("\x1b[38;2;000;000;255mblue\x1b[1m", "{!BLUE}{}{!B}"_fmt, "blue");
+
+    // Should match the runtime parser
+    string a = sprint("{:>8} | {:<6.2f} | {:#x} | {!}", "name", 3.14159, 255u);
+    string b = sprint("{:>8} | {:<6.2f} | {:#x} | {!}"_fmt, "name", 3.14159, 255u);
+    assert_eq(a, b);
+    free(a);
+    free(b);
+
+    assert_eq(fmt_calculate_length("{} {}"_fmt, "hello", "world"), 11);
+}
+
+TEST(runtime_compiled_format_string) {
+    string templ = "{0:>6} | {1:<6.2f} | {2:#x}";
+
+    fmt_compiled row = fmt_compile(templ);
+    defer(free(row));
+    assert_eq(row.Valid, true);
+
+    CHECK_WRITE("  name | 3.14   | 0xff", row, "name", 3.14159, 255u);
+    CHECK_WRITE(" other | 2.50   | 0x10", row, "other", 2.5, 16u);
+
+    fmt_compiled escaped = fmt_compile("{{{}}} ");
+    defer(free(escaped));
+    CHECK_WRITE("{42} ", escaped, 42);
+
+    auto newContext = Context;
+    newContext.FmtParseErrorHandler = test_parse_error_handler;
+    PUSH_CONTEXT(newContext) {
+        fmt_compiled bad = fmt_compile("{0} {}");
+        assert_eq(bad.Valid, false);
+        assert_eq(LAST_ERROR, "Cannot switch from manual to automatic argument indexing");
+        LAST_ERROR = "";
+
+        // The arguments can only be checked when formatting
+        fmt_compiled sign = fmt_compile("{:+}");
+        defer(free(sign));
+        assert_eq(sign.Valid, true);
+
+        counting_writer dummy;
+        fmt_to_writer(&dummy, sign, "string");
+        assert_eq(LAST_ERROR, "Format specifier requires an arithmetic argument");
+        LAST_ERROR = "";
+
+        fmt_to_writer(&dummy, sign);
+        assert_eq(LAST_ERROR, "Argument index out of range");
+        LAST_ERROR = "";
+    }
+}
+
+TEST(fmt_to_buffer) {
+    byte buffer[16];
+
+    s64 needed = fmt_to_buffer(buffer, sizeof(buffer), "{} + {} = {}", 1, 2, 3);
+    assert_eq(needed, 9);
+    assert_eq(string(buffer, needed), "1 + 2 = 3");
+
+    // Truncated, but we still get the full length
+    fill_memory(buffer, 0, sizeof(buffer));
+    needed = fmt_to_buffer(buffer, 8, "{:>12}|"_fmt, "right");
+    assert_eq(needed, 13);
+    assert_eq(string(buffer, 8), "       r");
+    assert_eq(buffer[8], 0);
+
+    needed = fmt_to_buffer(buffer, 0, "nothing fits");
+    assert_eq(needed, 12);
+}
+
+TEST(deferred_log) {
+    string_builder_writer records;
+    defer(free(records));
+
+    For(range(3)) deferred_log(&records, "{} {:.2f} {}|{:x}\n", it, 1.5f + it, it == 1, 255u);
+    deferred_log(&records, "[{:>6}] {}\n", "tag", string("copied"));
+
+    string data = string_builder_combine(records.Builder);
+    defer(free(data));
+
+    string expected = "0 1.50 false|ff\n1 2.50 true|ff\n2 3.50 false|ff\n[   tag] copied\n";
+
+    // Fed a byte at a time, so records get split between writes
+    string_builder_writer out;
+    defer(free(out));
+
+    deferred_log_decoder decoder(&out);
+    defer(free(decoder));
+    For(range(data.Count)) decoder.write((const byte *) data.Data + it, 1);
+    assert_eq(decoder.Pending.Count, 0);
+
+    string result = string_builder_combine(out.Builder);
+    defer(free(result));
+    assert_eq(result, expected);
+
+    // Decoding with a loaded site table (the format strings get parsed at runtime)
+    bytes sites = deferred_log_serialize_sites();
+    defer(free(sites));
+
+    string_builder_writer offlineOut;
+    defer(free(offlineOut));
+
+    deferred_log_decoder offline(&offlineOut);
+    defer(free(offline));
+    assert_true(deferred_log_decoder_load_sites(offline, sites));
+    offline.write((const byte *) data.Data, data.Count);
+
+    string offlineResult = string_builder_combine(offlineOut.Builder);
+    defer(free(offlineResult));
+    assert_eq(offlineResult, expected);
+
+    bytes truncated;
+    clone(&truncated, sites);
+    defer(free(truncated));
+    --truncated.Count;
+    assert_false(deferred_log_decoder_load_sites(offline, truncated));
+}
+
+#define CHECK_LENGTH(fmtString, ...)                                               \
+    {                                                                              \
+        string t = sprint(fmtString, ##__VA_ARGS__);                               \
+        assert_eq(fmt_calculate_length(fmtString, ##__VA_ARGS__), t.Count);        \
+        assert_ge(fmt_estimate_length(fmtString, ##__VA_ARGS__), t.Count);         \
+        free(t);                                                                   \
+    }
+
+TEST(calculate_and_estimate_length) {
+    CHECK_LENGTH("{} {} {} {}"_fmt, -1234567, 18446744073709551615ull, true, "string");
+    CHECK_LENGTH("{} {}"_fmt, (void *) 0xdeadbeef, false);
+    CHECK_LENGTH("{:+#x} {:#b} {:#o} {:n} {:c}"_fmt, 255, 5u, 8, 1234567890, 'x');
+    CHECK_LENGTH("{:08} {:*^9} {:<6}|"_fmt, -42, 3, true);
+    CHECK_LENGTH("{:*>12} {:.2}"_fmt, "pad", "precision");
+    CHECK_LENGTH("{} {} {} {}"_fmt, 0.1, -1.2345678901234567e-300, 1e300, 1.5f);
+    CHECK_LENGTH("{:.3f} {:.0f} {:.10e} {:%} {:g}"_fmt, 123456.789, 1e300, -0.000123, 0.987654, 1e-5);
+    CHECK_LENGTH("{:.20f} {:#.8g} {:20.3}"_fmt, 9.999999, 1.0, 2.5f);
+    CHECK_LENGTH("{} {:f} {:+}"_fmt, numeric_info<f64>::infinity(), numeric_info<f64>::quiet_NaN(), -numeric_info<f64>::infinity());
+
+    // Dynamic widths aren't estimated
+    assert_eq(fmt_estimate_length("{:{}}"_fmt, 1, 10), -1);
+    assert_eq(fmt_calculate_length("{:{}}"_fmt, 1, 10), 10);
+
+    // Long output goes to the heap right away, the result is still correct
+    string longer = sprint("{:>1000}|"_fmt, 42);
+    assert_eq(longer.Count, 1001);
+    assert_eq(longer[-2], '2');
+    free(longer);
+}
+
+TEST(repeated_specs) {
+    CHECK_WRITE("  1.00|  2.50|  3.25|", "{:>6.2f}|{:>6.2f}|{:>6.2f}|", 1.0, 2.5, 3.25);
+
+    // Same specs text, different argument types
+    CHECK_WRITE("ab    |12    |", "{:<6}|{:<6}|", "ab", 12);
+    CHECK_WRITE("+1|+2|", "{:+}|{:+}|", 1, 2);
+
+    // Dynamic widths are read again for every field
+    CHECK_WRITE(" 1|   2|", "{:>{}}|{:>{}}|", 1, 2, 2, 4);
+
+    // Specs which reported an error aren't reused, every field reports it
+    counting_writer dummy;
+
+    auto newContext                 = Context;
+    newContext.FmtParseErrorHandler = test_parse_error_handler;
+    PUSH_CONTEXT(newContext) {
+        auto args = fmt_args_on_the_stack(fmt_context{}, string("a"), string("b"));
+        auto f    = fmt_context(&dummy, "{:+}{:+}", args);
+        fmt_parse_and_format(&f);
+        assert_eq(f.Parse.ErrorCount, 2);
+    }
+    LAST_ERROR = "";
+}
+
+TEST(hex_bytes) {
+    string hello = "Hello, world!\n";
+    auto data    = bytes((byte *) hello.Data, hello.Count);
+
+    CHECK_WRITE("48656c6c6f2c20776f726c64210a", "{:x}", data);
+    CHECK_WRITE("48656C6C6F2C20776F726C64210A", "{:X}", data);
+    CHECK_WRITE("00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a       Hello, world!.\n", "{:#x}", data);
+
+    // More than the 16 bytes done at once and more than one line
+    byte all[40];
+    For(range(40)) all[it] = (byte) (it * 7);
+
+    CHECK_WRITE("00070e151c232a31383f464d545b626970777e858c939aa1a8afb6bdc4cbd2d9e0e7eef5fc030a11", "{:x}", bytes(all, 40));
+    CHECK_WRITE(
+        "00000000: 0007 0e15 1c23 2a31 383f 464d 545b 6269  .....#*18?FMT[bi\n"
+        "00000010: 7077 7e85 8c93 9aa1 a8af b6bd c4cb d2d9  pw~.............\n"
+        "00000020: e0e7 eef5 fc03 0a11                      ........\n",
+        "{:#x}", bytes(all, 40));
+
+    CHECK_WRITE("SGVsbG8sIHdvcmxkIQo=", "{:b}", data);
+    CHECK_WRITE("AAcOFRwjKjE4P0ZNVFtiaXB3foWMk5qhqK-2vcTL0tng5-71_AMKEQ", "{:#b}", bytes(all, 40));
+
+    // Without a hex specifier bytes are still a list
+    byte small[] = {1, 2};
+    CHECK_WRITE("[1, 2]", "{}", bytes(small, 2));
+}
+
+// A CSV row, through write_list() in a custom formatter
+struct csv_row {
+    array<f32> Values;
+};
+
+template <>
+struct formatter<csv_row> {
+    void format(const csv_row &row, fmt_context *f) { write_list(f, row.Values.Data, row.Values.Count, ","); }
+};
+
+TEST(write_list) {
+    s32 small[] = {-3, 0, 17};
+    CHECK_WRITE("[-3, 0, 17]", "{}", array<s32>(small, 3));
+    CHECK_WRITE("[  -3,    0,   17]", "{:>4}", array<s32>(small, 3));
+    CHECK_WRITE("[-3, 0, 11]", "{:x}", array<s32>(small, 3));
+
+    f32 floats[] = {0.5f, 1.25f, -2.0f};
+    CHECK_WRITE("[0.5, 1.25, -2]", "{}", array<f32>(floats, 3));
+    CHECK_WRITE("[0.50, 1.25, -2.00]", "{:.2f}", array<f32>(floats, 3));
+    CHECK_WRITE("0.5,1.25,-2", "{}", csv_row{array<f32>(floats, 3)});
+
+    string words[] = {"a", "bc"};
+    CHECK_WRITE("[a, bc]", "{}", array<string>(words, 2));
+    CHECK_WRITE("[ a, bc]", "{:>2}", array<string>(words, 2));
+
+    CHECK_WRITE("[]", "{}", array<s64>());
+
+    // Many times the size of a chunk, against formatting every number on its own
+    array<s64> numbers;
+    defer(free(numbers));
+
+    string expected;
+    defer(free(expected));
+
+    string_append(expected, "[");
+    For(range(5000)) {
+        s64 v = (it % 2 ? -1 : 1) * it * 7919 * 104729;
+        array_append(numbers, v);
+
+        string n = sprint("{}", v);
+        if (it) string_append(expected, ", ");
+        string_append(expected, n);
+        free(n);
+    }
+    string_append(expected, "]");
+
+    CHECK_WRITE(expected, "{}", numbers);
+}
+
+TEST(cached_text_styles) {
+    if (Context.FmtDisableAnsiCodes) return;
+
+    // Each style of a call site gets encoded once, same output every time
+    For(range(3)) CHECK_WRITE("\x1b[38;2;000;000;255m42\x1b[1m\x1b[0m", "{!BLUE}{}{!B}{!}"_fmt, 42);
+
+    fmt_compiled styled = fmt_compile("{!RED;B}{}{!}");
+    defer(free(styled));
+    assert_eq(styled.Styles.Count, 2);
+    CHECK_WRITE("\x1b[38;2;255;000;000m\x1b[1mred\x1b[0m", styled, "red");
+    CHECK_WRITE("\x1b[38;2;255;000;000m\x1b[1mred\x1b[0m", styled, "red");
+
+    // The error is reported once and formatting stops at the style, like with the runtime parser
+    auto newContext                 = Context;
+    newContext.FmtParseErrorHandler = test_parse_error_handler;
+    PUSH_CONTEXT(newContext) {
+        fmt_compiled bad = fmt_compile("a{!L}b");
+        defer(free(bad));
+        assert_eq(bad.Valid, true);
+        assert_eq(LAST_ERROR,
+                  "Invalid emphasis character - "
+                  "valid ones are: B (bold), I (italic), U (underline) and S (strikethrough)");
+        LAST_ERROR = "";
+
+        CHECK_WRITE("a", bad);
+        assert_eq(LAST_ERROR, "");
+    }
+
+    // Disabled codes skip the styles entirely
+    newContext                     = Context;
+    newContext.FmtDisableAnsiCodes = true;
+    PUSH_CONTEXT(newContext) {
+        CHECK_WRITE("42", "{!BLUE}{}{!B}{!}"_fmt, 42);
+        CHECK_WRITE("red", styled, "red");
+        CHECK_WRITE("plain", "{!GREEN}{}{!}", "plain");
+    }
+}
+
+// Gives out the string a few bytes at a time, like a pipe
+struct chunked_string_reader : reader {
+    string Source;
+    s64 Position = 0, ChunkSize = 3;
+
+    s64 read_source(byte *dest, s64 size) override {
+        s64 n = min(min(size, ChunkSize), Source.Count - Position);
+        copy_memory(dest, Source.Data + Position, n);
+        Position += n;
+        return n;
+    }
+};
+
+TEST(date_time) {
+    // 2026-10-14T07:30:05.123456789Z, a Wednesday
+    s64 t = 1791963005123456789;
+
+    date_time utc = date_time_from_unix_ns(t);
+    assert_eq(utc.Year, 2026);
+    assert_eq(utc.Month, 10);
+    assert_eq(utc.Day, 14);
+    assert_eq(utc.Hour, 7);
+    assert_eq(utc.Weekday, 3);
+    assert_eq(date_time_to_unix_ns(utc), t);
+
+    CHECK_WRITE("2026-10-14T07:30:05.123Z", "{}", utc);
+    CHECK_WRITE("2026-10-14T07:30:05Z", "{:.0}", utc);
+    CHECK_WRITE("2026-10-14T09:30:05.123456+02:00", "{:.6}", date_time_from_unix_ns(t, 2 * 3600));
+    CHECK_WRITE("2026-10-14T02:00:05.123-05:30", "{}", date_time_from_unix_ns(t, -(5 * 3600 + 30 * 60)));
+
+    // Before the epoch, across a leap day and around the start of the calendar shift
+    CHECK_WRITE("1969-12-31T23:59:59.999Z", "{}", date_time_from_unix_ns(-1));
+    assert_eq(days_from_civil(2000, 3, 1) - days_from_civil(2000, 2, 28), 2);
+    assert_eq(days_from_civil(1900, 3, 1) - days_from_civil(1900, 2, 28), 1);
+    For(range(-800000, 800000, 997)) {
+        civil_date d = civil_from_days(it);
+        assert_eq(days_from_civil(d.Year, d.Month, d.Day), it);
+    }
+
+    // The cached prefix is reused within a second and replaced after it
+    utf8 buffer[DATE_TIME_ISO8601_MAX_SIZE];
+    s64 n = date_time_format_iso8601(buffer, t, 0, 3);
+    assert_eq(string(buffer, n), "2026-10-14T07:30:05.123Z");
+    n = date_time_format_iso8601(buffer, t + 500000000, 0, 9);
+    assert_eq(string(buffer, n), "2026-10-14T07:30:05.623456789Z");
+    n = date_time_format_iso8601(buffer, t + 1000000000, 0, 1);
+    assert_eq(string(buffer, n), "2026-10-14T07:30:06.1Z");
+    n = date_time_format_iso8601(buffer, t + 1000000000, 3600, 1);
+    assert_eq(string(buffer, n), "2026-10-14T08:30:06.1+01:00");
+}
+
+TEST(reader) {
+    chunked_string_reader r;
+    r.Source = "first\r\nsecond line\n\nlast";
+    r.BufferSize = 8;  // Smaller than "second line", the buffer has to grow
+    defer(free(&r));
+
+    bytes peeked = peek(&r, 5);
+    assert_eq(string((utf8 *) peeked.Data, peeked.Count), "first");
+
+    string line;
+    assert_true(read_line(&r, line));
+    assert_eq(line, "first");
+    assert_true(read_line(&r, line));
+    assert_eq(line, "second line");
+    assert_true(read_line(&r, line));
+    assert_eq(line, "");
+    assert_true(read_line(&r, line));
+    assert_eq(line, "last");
+    assert_false(read_line(&r, line));
+
+    // Reads bigger than the buffer skip it
+    chunked_string_reader big;
+    big.Source = "0123456789abcdefghijklmnopqrstuvwxyz";
+    big.ChunkSize = 100;
+    big.BufferSize = 4;
+    defer(free(&big));
+
+    byte out[36];
+    assert_eq(read(&big, out, 2), 2);
+    assert_eq(read(&big, out + 2, 34), 34);
+    assert_eq(string((utf8 *) out, 36), big.Source);
+    assert_eq(read(&big, out, 1), 0);
+}
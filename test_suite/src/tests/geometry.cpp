@@ -0,0 +1,275 @@
+#include <lstd/bvh.h>
+#include <lstd/math/geometry.h>
+#include <lstd/spatial_grid.h>
+
+#include "../test.h"
+#include "math.h"
+
+// The single tests are the reference for the batch ones
+TEST(batch_intersections) {
+    // 150 covers two full words of hits and a partial one
+    constexpr s64 N = 150;
+
+    aabb3 boxes[N];
+    sphere3 spheres[N];
+    For(range(N)) {
+        v3 c = v3((f32) (it % 10) - 5, (f32) (it / 10 % 5) - 2, (f32) (it / 50) * 3 - 3);
+        f32 e = 0.25f + (it % 3) * 0.25f;
+        boxes[it] = aabb3(c - v3(e), c + v3(e));
+        spheres[it] = sphere3(c, e);
+    }
+
+    u64 hits[3];
+
+    // Along +x through y = 0, z = 0, which is the middle row of the middle layer
+    ray<f32, 3> r(v3(-10, 0.1f, 0.1f), v3(1, 0, 0));
+    s64 count = intersect_batch(r, boxes, N, hits);
+    s64 expected = 0;
+    For(range(N)) {
+        auto &b = boxes[it];
+        bool hit = b.Min.y <= 0.1f && 0.1f <= b.Max.y && b.Min.z <= 0.1f && 0.1f <= b.Max.z;
+        assert_eq((bool) (hits[it / 64] & (1ull << (it % 64))), hit);
+        expected += hit;
+    }
+    assert_eq(count, expected);
+    assert_nq(count, 0);
+
+    // Too short to reach the boxes past x = 0
+    count = intersect_batch(r, boxes, N, hits, 10.0f);
+    For(range(N)) if (hits[it / 64] & (1ull << (it % 64))) assert_lt(boxes[it].Min.x, 0.0f + 1e-4f);
+
+    // A box frustum: -2 <= x, y, z <= 2
+    frustumf f;
+    f.Planes[frustumf::Left] = v4(1, 0, 0, 2);
+    f.Planes[frustumf::Right] = v4(-1, 0, 0, 2);
+    f.Planes[frustumf::Bottom] = v4(0, 1, 0, 2);
+    f.Planes[frustumf::Top] = v4(0, -1, 0, 2);
+    f.Planes[frustumf::Near] = v4(0, 0, 1, 2);
+    f.Planes[frustumf::Far] = v4(0, 0, -1, 2);
+
+    count = intersect_batch(f, boxes, N, hits);
+    expected = 0;
+    For(range(N)) {
+        bool hit = f.overlaps(boxes[it]);
+        assert_eq((bool) (hits[it / 64] & (1ull << (it % 64))), hit);
+        expected += hit;
+    }
+    assert_eq(count, expected);
+
+    count = intersect_batch(f, spheres, N, hits);
+    expected = 0;
+    For(range(N)) {
+        bool hit = f.overlaps(spheres[it]);
+        assert_eq((bool) (hits[it / 64] & (1ull << (it % 64))), hit);
+        expected += hit;
+    }
+    assert_eq(count, expected);
+    assert_nq(count, N);
+}
+
+TEST(frustum_from_matrix) {
+    m44 projection = perspective((f32) (TAU / 4), 1.0f, 1.0f, 100.0f);
+    frustumf f(projection);
+
+    // The camera looks down -z
+    assert_true(f.contains(v3(0, 0, -10)));
+    assert_true(f.contains(v3(9, -9, -10)));
+    assert_false(f.contains(v3(11, 0, -10)));
+    assert_false(f.contains(v3(0, 0, -0.5f)));
+    assert_false(f.contains(v3(0, 0, -101)));
+    assert_false(f.contains(v3(0, 0, 10)));
+}
+
+// Slab distance to a box, infinity if missed
+file_scope f32 ray_box_distance(const ray<f32, 3> &r, const aabb3 &box) {
+    f32 tNear = 0, tFar = numeric_info<f32>::infinity();
+    For(range(3)) {
+        f32 inv = 1.0f / r.Direction[it];
+        f32 t1 = (box.Min[it] - r.Base[it]) * inv, t2 = (box.Max[it] - r.Base[it]) * inv;
+        tNear = max(tNear, min(t1, t2));
+        tFar = min(tFar, max(t1, t2));
+    }
+    return tNear <= tFar ? tNear : numeric_info<f32>::infinity();
+}
+
+TEST(bvh_queries) {
+    // A jittered grid of small boxes, enough of them for a few levels
+    array<aabb3> boxes;
+    defer(free(boxes));
+
+    u64 rng = 0x9E3779B97F4A7C15ull;
+    auto next = [&]() {
+        rng ^= rng << 13, rng ^= rng >> 7, rng ^= rng << 17;
+        return (f32) (rng % 1000) / 1000.0f;
+    };
+
+    For(range(2000)) {
+        v3 c = v3(next() * 50, next() * 50, next() * 50);
+        f32 e = 0.1f + next() * 0.5f;
+        array_append(boxes, aabb3(c - v3(e), c + v3(e)));
+    }
+
+    bvh tree;
+    bvh_build(tree, boxes.Data, boxes.Count, {.MaxLeafSize = 4});
+    defer(free(tree));
+
+    assert_nq(tree.Nodes.Count, 0);
+    assert_eq(tree.Indices.Count, boxes.Count);
+
+    // Every primitive is in exactly one leaf
+    array<s32> seen;
+    defer(free(seen));
+    For(range(boxes.Count)) array_append(seen, 0);
+    For(tree.Indices) seen[it] += 1;
+    For(seen) assert_eq(it, 1);
+
+    For(range(20)) {
+        v3 origin = v3(-5, next() * 50, next() * 50);
+        ray<f32, 3> r(origin, normalize(v3(1, next() - 0.5f, next() - 0.5f)));
+
+        auto intersect = [&](u32 primitive, f32) { return ray_box_distance(r, boxes[primitive]); };
+        auto hit = bvh_raycast(tree, r, &intersect);
+
+        s64 closest = -1;
+        f32 closestDistance = numeric_info<f32>::infinity();
+        For_as(i, range(boxes.Count)) {
+            f32 d = ray_box_distance(r, boxes[i]);
+            if (d < closestDistance) closestDistance = d, closest = i;
+        }
+
+        if (closest == -1) {
+            assert_eq(hit.Primitive, -1);
+        } else {
+            assert_eq(hit.Distance, approx(closestDistance));
+        }
+    }
+
+    For(range(20)) {
+        v3 c = v3(next() * 50, next() * 50, next() * 50);
+        aabb3 query = aabb3(c - v3(3), c + v3(3));
+
+        array<u32> found;
+        defer(free(found));
+        s64 count = bvh_overlaps(tree, query, found);
+
+        s64 expected = 0;
+        For(boxes) expected += it.overlaps(query);
+        assert_eq(count, expected);
+        For(found) assert_true(boxes[it].overlaps(query));
+    }
+}
+
+TEST(bvh_triangles) {
+    // A floor at y = 0 made of two triangles and a wall at x = 5
+    Triangle3D<f32> triangles[] = {
+        {v3(-10, 0, -10), v3(10, 0, -10), v3(10, 0, 10)},
+        {v3(-10, 0, -10), v3(10, 0, 10), v3(-10, 0, 10)},
+        {v3(5, -10, -10), v3(5, 10, -10), v3(5, 10, 10)},
+        {v3(5, -10, -10), v3(5, 10, 10), v3(5, -10, 10)},
+    };
+
+    bvh tree;
+    bvh_build(tree, triangles, 4, {.MaxLeafSize = 1});
+    defer(free(tree));
+
+    auto down = bvh_raycast(tree, triangles, ray<f32, 3>(v3(1, 3, 2), v3(0, -1, 0)));
+    assert_true(down.Primitive == 0 || down.Primitive == 1);
+    assert_eq(down.Distance, approx(3));
+
+    auto side = bvh_raycast(tree, triangles, ray<f32, 3>(v3(0, 1, 0), v3(1, 0, 0)));
+    assert_true(side.Primitive == 2 || side.Primitive == 3);
+    assert_eq(side.Distance, approx(5));
+
+    // Too short, and pointing away
+    assert_eq(bvh_raycast(tree, triangles, ray<f32, 3>(v3(0, 1, 0), v3(1, 0, 0)), 4.0f).Primitive, -1);
+    assert_eq(bvh_raycast(tree, triangles, ray<f32, 3>(v3(0, 1, 0), v3(0, 1, 0))).Primitive, -1);
+}
+
+TEST(spatial_grid) {
+    u64 rng = 0x2545F4914F6CDD1Dull;
+    auto next = [&]() {
+        rng ^= rng << 13, rng ^= rng >> 7, rng ^= rng << 17;
+        return (f32) (rng % 10000) / 10000.0f;
+    };
+
+    // Negative coordinates too, the cells on both sides of 0 are different
+    array<v3> points;
+    defer(free(points));
+    For(range(3000)) array_append(points, v3(next() * 40 - 20, next() * 40 - 20, next() * 40 - 20));
+
+    array<v2> flat;
+    defer(free(flat));
+    For(points) array_append(flat, v2(it.x, it.y));
+
+    // Summed in the same order as the grid does, so the points right on the radius agree
+    auto distance_sq = [](v3 a, v3 b) { return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z); };
+
+    spatial_grid grid, grid2D;
+    defer(free(grid));
+    defer(free(grid2D));
+
+    spatial_grid_build(grid, points.Data, points.Count, 2.0f);
+    spatial_grid_build(grid2D, flat.Data, flat.Count, 2.0f);
+
+    assert_eq(grid.Indices.Count, points.Count);
+    assert_eq(grid2D.Dimensions, 2);
+
+    // Near the cell size, much smaller, and big enough to go through every point
+    f32 radii[] = {2.0f, 0.5f, 5.0f, 100.0f};
+
+    For_as(r, radii) {
+        For(range(10)) {
+            v3 c = v3(next() * 40 - 20, next() * 40 - 20, next() * 40 - 20);
+
+            array<u32> found;
+            defer(free(found));
+            s64 count = spatial_grid_query_radius(grid, c, r, found);
+
+            s64 expected = 0, closest = -1;
+            f32 closestDistance = 0;
+            For_as(i, range(points.Count)) {
+                f32 d = distance_sq(points[i], c);
+                if (d > r * r) continue;
+
+                ++expected;
+                if (closest == -1 || d < closestDistance) closestDistance = d, closest = i;
+            }
+            assert_eq(count, expected);
+            For(found) assert_true(distance_sq(points[it], c) <= r * r);
+
+            // Nothing is reported twice
+            array<s32> seen;
+            defer(free(seen));
+            For(range(points.Count)) array_append(seen, 0);
+            For(found) seen[it] += 1;
+            For(seen) assert_true(it <= 1);
+
+            assert_eq(spatial_grid_nearest(grid, c, r), closest);
+
+            found.Count = 0;
+            count = spatial_grid_query_radius(grid2D, v2(c.x, c.y), r, found);
+
+            expected = 0;
+            For(flat) expected += distance_sq(v3(it.x, it.y, 0), v3(c.x, c.y, 0)) <= r * r;
+            assert_eq(count, expected);
+        }
+    }
+
+    // The job system builds the same grid
+    array<v3> many;
+    defer(free(many));
+    For(range(40000)) array_append(many, v3(next() * 200, next() * 200, next() * 10));
+
+    spatial_grid serial, parallel;
+    defer(free(serial));
+    defer(free(parallel));
+
+    spatial_grid_build(serial, many.Data, many.Count, 1.0f, {.Parallel = false});
+    spatial_grid_build(parallel, many.Data, many.Count, 1.0f);
+
+    assert_eq(serial.BucketStart.Count, parallel.BucketStart.Count);
+    For(range(serial.BucketStart.Count)) assert_eq(serial.BucketStart[it], parallel.BucketStart[it]);
+    For(range(serial.Indices.Count)) assert_eq(serial.Indices[it], parallel.Indices[it]);
+
+    assert_eq(spatial_grid_nearest(serial, v3(-5), 1.0f), -1);
+}
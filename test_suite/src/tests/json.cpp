@@ -0,0 +1,134 @@
+#include <lstd/json.h>
+#include <lstd/memory/string_builder.h>
+
+#include "../test.h"
+
+#define test_json_parse(input, expectedStatus, expectedErrorOffset) \
+    {                                                               \
+        json_document doc;                                          \
+        assert_eq(json_parse(doc, (bytes)(string) input), expectedStatus); \
+        assert_eq(doc.ErrorOffset, (s64) expectedErrorOffset);      \
+        free(doc);                                                  \
+    }
+
+TEST(json_structure) {
+    test_json_parse("{\"a\": [1, 2, {\"b\": null}]}", PARSE_SUCCESS, -1);
+    test_json_parse("  42  ", PARSE_SUCCESS, -1);
+    test_json_parse("\"}]\\\"[{\"", PARSE_SUCCESS, -1);  // Brackets and escaped quotes inside a string
+
+    test_json_parse("", PARSE_EXHAUSTED, 0);
+    test_json_parse("   ", PARSE_EXHAUSTED, 3);
+    test_json_parse("[1, 2", PARSE_EXHAUSTED, 5);
+    test_json_parse("[\"abc\\\"]", PARSE_EXHAUSTED, 8);
+
+    test_json_parse("[1, 2}", PARSE_INVALID, 5);
+    test_json_parse("]", PARSE_INVALID, 0);
+    test_json_parse("[1] [2]", PARSE_INVALID, 4);
+    test_json_parse("[\"a\x01\"]", PARSE_INVALID, 3);
+    test_json_parse("[\"\xff\"]", PARSE_INVALID, 2);
+}
+
+TEST(json_values) {
+    string input = "[true, false, null, 0, -12, 3.5e2, 1e400, 9223372036854775808, 01, 1., trueish, \"x\"]";
+
+    json_document doc;
+    assert_eq(json_parse(doc, (bytes) input), PARSE_SUCCESS);
+    defer(free(doc));
+
+    auto root = json_root(doc);
+    assert_eq(json_get_type(root), JSON_ARRAY);
+
+    assert_true(json_get_bool(json_at(root, 0)).Value);
+    assert_eq(json_get_bool(json_at(root, 1)).Status, PARSE_SUCCESS);
+    assert_false(json_get_bool(json_at(root, 1)).Value);
+    assert_true(json_is_null(json_at(root, 2)));
+
+    assert_eq(json_get_s64(json_at(root, 3)).Value, 0);
+    assert_eq(json_get_s64(json_at(root, 4)).Value, -12);
+    assert_eq(json_get_f64(json_at(root, 4)).Value, -12.0);
+    assert_eq(json_get_f64(json_at(root, 5)).Value, 350.0);
+    assert_eq(json_get_s64(json_at(root, 5)).Status, PARSE_INVALID);
+    assert_eq(json_get_f64(json_at(root, 6)).Value, numeric_info<f64>::infinity());
+    assert_eq(json_get_s64(json_at(root, 7)).Status, PARSE_TOO_MANY_DIGITS);
+
+    // Not JSON numbers/literals
+    assert_eq(json_get_f64(json_at(root, 8)).Status, PARSE_INVALID);
+    assert_eq(json_get_f64(json_at(root, 9)).Status, PARSE_INVALID);
+    assert_eq(json_get_bool(json_at(root, 10)).Status, PARSE_INVALID);
+
+    assert_eq(json_get_type(json_at(root, 11)), JSON_STRING);
+    assert_eq(json_get_type(json_at(root, 12)), JSON_NONE);
+    assert_eq(json_get_s64(json_at(root, 12)).Status, PARSE_INVALID);
+}
+
+TEST(json_strings) {
+    string input = "[\"plain\", \"a\\\"b\\\\c\\/\\n\", \"\\u00e9\\u20AC\\ud83d\\ude00\", \"\\ud83d\", \"\\x\"]";
+
+    json_document doc;
+    assert_eq(json_parse(doc, (bytes) input), PARSE_SUCCESS);
+    defer(free(doc));
+
+    auto root = json_root(doc);
+
+    // No escapes - a view into the input
+    auto [plain, plainStatus] = json_get_string(json_at(root, 0));
+    assert_eq(plainStatus, PARSE_SUCCESS);
+    assert_eq(plain, "plain");
+    assert_true(plain.Data > input.Data && plain.Data < input.Data + input.Count);
+
+    assert_eq(json_get_string(json_at(root, 1)).Value, "a\"b\\c/\n");
+    assert_eq(json_get_string(json_at(root, 2)).Value, (string) u8"\u00e9\u20AC\U0001F600");
+
+    // A lone surrogate and an unknown escape
+    assert_eq(json_get_string(json_at(root, 3)).Status, PARSE_INVALID);
+    assert_eq(json_get_string(json_at(root, 4)).Status, PARSE_INVALID);
+}
+
+TEST(json_iteration) {
+    string_builder builder;
+    defer(free(builder));
+
+    // Long enough to cross many 64 byte blocks, with structural bytes and quotes inside strings
+    string_append(builder, "{\"items\": [");
+    For(range(200)) {
+        if (it) string_append(builder, ", ");
+        string item = sprint("{{\"id\": {}, \"name\": \"item {{{}}} [\\\"x\\\"]\", \"tags\": [[], {{}}, [1, [2]]]}}", it, it);
+        string_append(builder, item);
+        free(item);
+    }
+    string_append(builder, "], \"count\": 200}");
+
+    string input = string_builder_combine(builder);
+    defer(free(input));
+
+    json_document doc;
+    assert_eq(json_parse(doc, (bytes) input), PARSE_SUCCESS);
+    defer(free(doc));
+
+    auto root = json_root(doc);
+    assert_eq(json_get_s64(json_find(root, "count")).Value, 200);
+    assert_eq(json_get_type(json_find(root, "missing")), JSON_NONE);
+
+    s64 index = 0;
+    For(json_array(json_find(root, "items"))) {
+        assert_eq(json_get_s64(json_find(it, "id")).Value, index);
+
+        string expected = sprint("item {{{}}} [\"x\"]", index);
+        assert_eq(json_get_string(json_find(it, "name")).Value, expected);
+        free(expected);
+
+        ++index;
+    }
+    assert_eq(index, 200);
+    assert_eq(doc.ErrorOffset, -1);
+
+    // Malformed fields are only found while iterating
+    json_document bad;
+    assert_eq(json_parse(bad, (bytes)(string) "[1 2, 3]"), PARSE_SUCCESS);
+    defer(free(bad));
+
+    s64 count = 0;
+    For(json_array(json_root(bad))) ++count;
+    assert_eq(count, 1);
+    assert_eq(bad.ErrorOffset, 3);
+}
@@ -0,0 +1,263 @@
+#include <lstd/linalg.h>
+#include <lstd/sparse.h>
+
+#include "../test.h"
+
+// Deterministic values in [-1, 1)
+file_scope f64 next_value(u64 &state) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return (f64) (state >> 11) / (f64) (1ull << 52) - 1;
+}
+
+file_scope void fill_random(dense_mat &m, u64 &state) {
+    For_as(i, range(m.R)) For_as(j, range(m.C)) m(i, j) = next_value(state);
+}
+
+// Sizes which aren't multiples of the block size or of the SIMD width
+TEST(dense_lu) {
+    u64 state = 42;
+
+    For_as(n, to_stack_array<s64>(1, 7, 65, 200)) {
+        dense_mat a;
+        dense_mat_init(a, n, n);
+        defer(free(a));
+        fill_random(a, state);
+
+        f64 *expected = allocate_array<f64>(n), *b = allocate_array<f64>(n), *x = allocate_array<f64>(n);
+        defer(free(expected));
+        defer(free(b));
+        defer(free(x));
+
+        For(range(n)) expected[it] = next_value(state);
+        dot(b, a, expected);
+
+        // Small blocks run many panels, the default ones a single panel for the smaller sizes
+        For_as(blockSize, to_stack_array<s64>(8, 64)) {
+            assert_true(dense_solve(a, b, x, {.BlockSize = blockSize}));
+            For(range(n)) assert_lt(abs(x[it] - expected[it]), 1e-9);
+        }
+
+        dense_lu lu;
+        defer(free(lu));
+        assert_true(dense_lu_decompose(lu, a));
+
+        dense_mat many;
+        dense_mat_init(many, n, 5);
+        defer(free(many));
+        For_as(i, range(n)) For_as(j, range(5)) many(i, j) = b[i] * (f64) (j + 1);
+
+        dense_lu_solve(lu, many);
+        For_as(i, range(n)) For_as(j, range(5)) assert_lt(abs(many(i, j) - expected[i] * (f64) (j + 1)), 1e-9);
+    }
+
+    // The first pivot is 0, the rows get swapped
+    dense_mat a;
+    dense_mat_init(a, 2, 2);
+    defer(free(a));
+    a(0, 0) = 0, a(0, 1) = 2;
+    a(1, 0) = 3, a(1, 1) = 1;
+
+    dense_lu lu;
+    defer(free(lu));
+    assert_true(dense_lu_decompose(lu, a));
+    assert_eq(lu.Pivots[0], 1);
+    assert_lt(abs(determinant(lu) + 6), 1e-12);
+
+    a(0, 0) = 3, a(0, 1) = 1;
+    assert_false(dense_lu_decompose(lu, a));
+    assert_true(lu.Singular);
+}
+
+TEST(dense_qr) {
+    u64 state = 7;
+
+    For_as(n, to_stack_array<s64>(1, 9, 70)) {
+        s64 rows = n + 13;
+
+        dense_mat a;
+        dense_mat_init(a, rows, n);
+        defer(free(a));
+        fill_random(a, state);
+
+        dense_qr qr;
+        defer(free(qr));
+        dense_qr_decompose(qr, a, {.BlockSize = 16});
+
+        // A = Q * R and Q' * Q = I
+        dense_mat q, r, product;
+        defer(free(q));
+        defer(free(r));
+        defer(free(product));
+
+        dense_qr_q(&q, qr);
+        dense_mat_init(r, n, n);
+        For_as(i, range(n)) For_as(j, range(i, n)) r(i, j) = qr.QR(i, j);
+
+        dot(&product, q, r);
+        For_as(i, range(rows)) For_as(j, range(n)) assert_lt(abs(product(i, j) - a(i, j)), 1e-10);
+
+        For_as(i, range(n)) For_as(j, range(n)) {
+            f64 sum = 0;
+            For_as(k, range(rows)) sum += q(k, i) * q(k, j);
+            assert_lt(abs(sum - (i == j ? 1 : 0)), 1e-10);
+        }
+
+        // b is in the range of A, so the least squares solution is exact
+        f64 *expected = allocate_array<f64>(n), *b = allocate_array<f64>(rows), *x = allocate_array<f64>(n);
+        defer(free(expected));
+        defer(free(b));
+        defer(free(x));
+
+        For(range(n)) expected[it] = next_value(state);
+        dot(b, a, expected);
+
+        assert_true(dense_qr_solve(qr, b, x));
+        For(range(n)) assert_lt(abs(x[it] - expected[it]), 1e-9);
+    }
+
+    // The second column is twice the first
+    dense_mat a;
+    dense_mat_init(a, 4, 2);
+    defer(free(a));
+    For(range(4)) a(it, 0) = (f64) it, a(it, 1) = (f64) (2 * it);
+
+    dense_qr qr;
+    defer(free(qr));
+    dense_qr_decompose(qr, a);
+
+    f64 b[4] = {0, 1, 2, 3}, x[2];
+    assert_false(dense_qr_solve(qr, b, x));
+}
+
+TEST(sparse_mat) {
+    u64 state = 3;
+
+    // Big enough for the product to be split between jobs, with a few dense rows so the pieces have different sizes
+    s64 rows = 2000, cols = 1500;
+
+    array<sparse_triplet> triplets;
+    defer(free(triplets));
+    For_as(i, range(rows)) {
+        s64 count = i % 397 == 0 ? cols / 2 : 40;
+        For(range(count)) {
+            s64 j = (s64) ((next_value(state) + 1) / 2 * (f64) cols);
+            array_append(triplets, sparse_triplet{i, j, next_value(state)});
+        }
+    }
+
+    // Repeats are summed
+    array_append(triplets, sparse_triplet{5, 7, 1.5});
+    array_append(triplets, sparse_triplet{5, 7, 2.5});
+
+    sparse_mat m;
+    defer(free(m));
+    sparse_mat_build(m, rows, cols, triplets);
+
+    assert_eq(m.RowStart[rows], m.NonZeros);
+    assert_le(m.NonZeros, triplets.Count);
+    For_as(i, range(rows)) For_as(k, range(m.RowStart[i] + 1, m.RowStart[i + 1])) assert_lt(m.Cols[k - 1], m.Cols[k]);
+
+    f64 *v = allocate_array<f64>(cols), *expected = allocate_array<f64>(rows), *out = allocate_array<f64>(rows);
+    defer(free(v));
+    defer(free(expected));
+    defer(free(out));
+
+    For(range(cols)) v[it] = next_value(state);
+    For(range(rows)) expected[it] = 0;
+    For(triplets) expected[it.Row] += it.Value * v[it.Col];
+
+    For_as(parallel, to_stack_array(true, false)) {
+        dot(out, m, v, {.Parallel = parallel});
+        For(range(rows)) assert_lt(abs(out[it] - expected[it]), 1e-10);
+    }
+
+    // Column storage and dense blocks
+    sparse_mat t;
+    defer(free(t));
+    sparse_transpose(&t, m);
+    assert_eq(t.R, cols);
+    assert_eq(t.NonZeros, m.NonZeros);
+
+    dense_mat block;
+    defer(free(block));
+    sparse_to_dense(&block, m, 390, 100, 20, 300);
+
+    For_as(i, range(390, 410)) For_as(j, range(100, 400)) {
+        assert_eq(sparse_get(t, j, i), sparse_get(m, i, j));
+        assert_eq(block(i - 390, j - 100), sparse_get(m, i, j));
+    }
+
+    f64 repeated = 0;
+    For(triplets) if (it.Row == 5 && it.Col == 7) repeated += it.Value;
+    assert_lt(abs(sparse_get(m, 5, 7) - repeated), 1e-12);
+
+    sparse_mat empty;
+    defer(free(empty));
+    sparse_mat_build(empty, 3, 3, (const sparse_triplet *) null, 0);
+    dot(out, empty, v);
+    For(range(3)) assert_eq(out[it], 0.0);
+}
+
+TEST(sparse_cg) {
+    u64 state = 11;
+
+    // The 5 point Laplacian on a grid, symmetric positive definite, with the rows scaled differently
+    // (the Jacobi preconditioner undoes that)
+    s64 side = 40, n = side * side;
+
+    array<sparse_triplet> triplets;
+    defer(free(triplets));
+    For_as(y, range(side)) For_as(x, range(side)) {
+        s64 i = y * side + x;
+        f64 s = 1 + (f64) (i % 7);
+
+        array_append(triplets, sparse_triplet{i, i, 4 * s * s});
+        if (x > 0) array_append(triplets, sparse_triplet{i, i - 1, -s * (1 + (f64) ((i - 1) % 7))});
+        if (x + 1 < side) array_append(triplets, sparse_triplet{i, i + 1, -s * (1 + (f64) ((i + 1) % 7))});
+        if (y > 0) array_append(triplets, sparse_triplet{i, i - side, -s * (1 + (f64) ((i - side) % 7))});
+        if (y + 1 < side) array_append(triplets, sparse_triplet{i, i + side, -s * (1 + (f64) ((i + side) % 7))});
+    }
+
+    sparse_mat a;
+    defer(free(a));
+    sparse_mat_build(a, n, n, triplets);
+
+    f64 *expected = allocate_array<f64>(n), *b = allocate_array<f64>(n), *x = allocate_array<f64>(n);
+    defer(free(expected));
+    defer(free(b));
+    defer(free(x));
+
+    For(range(n)) expected[it] = next_value(state);
+    dot(b, a, expected);
+
+    For_as(jacobi, to_stack_array(true, false)) {
+        For(range(n)) x[it] = 0;
+
+        auto [iterations, residual, converged] = sparse_cg_solve(a, b, x, {.Tolerance = 1e-12, .Jacobi = jacobi});
+        assert_true(converged);
+        assert_le(residual, 1e-12);
+        assert_le(iterations, n);
+        For(range(n)) assert_lt(abs(x[it] - expected[it]), 1e-8);
+    }
+
+    // Starting from the solution takes no iterations
+    auto result = sparse_cg_solve(a, b, x, {.Tolerance = 1e-6});
+    assert_eq(result.Iterations, 0);
+    assert_true(result.Converged);
+
+    // A corner block solved densely gives what the whole system does when the rest of x is known
+    s64 k = side;
+    dense_mat block;
+    defer(free(block));
+    sparse_to_dense(&block, a, 0, 0, k, k);
+
+    f64 *rhs = allocate_array<f64>(k), *blockX = allocate_array<f64>(k);
+    defer(free(rhs));
+    defer(free(blockX));
+    For_as(i, range(k)) {
+        rhs[i] = b[i];
+        For_as(p, range(a.RowStart[i], a.RowStart[i + 1])) if (a.Cols[p] >= k) rhs[i] -= a.Values[p] * expected[a.Cols[p]];
+    }
+    assert_true(dense_solve(block, rhs, blockX));
+    For(range(k)) assert_lt(abs(blockX[it] - expected[it]), 1e-9);
+}
@@ -324,6 +324,64 @@ TEST(inverse) {
     assert_eq(approx_vec(idenexp), iden);
 }
 
+TEST(mat44_kernels) {
+    matf<4, 4> a = {1, 3, 2, 0, 4, 5, 6, 0, 7, 8, 9, 0, 10, 11, 12, 1};  // Affine
+    matf<4, 4> b = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+    matf<4, 4> abexp = {34, 40, 46, 52, 83, 98, 113, 128, 128, 152, 176, 200, 186, 220, 254, 288};
+    assert_eq(dot(a, b), abexp);
+
+    vecf<4> v(1, 2, 3, 4);
+    assert_eq(dot(v, b), (vecf<4>(90, 100, 110, 120)));
+
+    // Packed matrices go through the same kernels
+    mat<f32, 4, 4, true> pa = {1, 3, 2, 0, 4, 5, 6, 0, 7, 8, 9, 0, 10, 11, 12, 1};
+    mat<f32, 4, 4, true> pb = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    assert_eq(dot(pa, pb), abexp);
+
+    matf<4, 4> iden = identity();
+    assert_eq(approx_vec(dot(a, affine_inverse(a))), iden);
+    assert_eq(approx_vec(dot(a, inverse(a))), iden);
+
+    // The generic version for other types
+    mat<f64, 4, 4> d = {1, 3, 2, 0, 4, 5, 6, 0, 7, 8, 9, 0, 10, 11, 12, 1};
+    mat<f64, 4, 4> idend = identity();
+    assert_eq(approx_vec(dot(d, affine_inverse(d))), idend);
+}
+
+TEST(affine3) {
+    quat q = normalize(quat(0.8f, normalize(vecf<3>(1, 2, 3)) * 0.6f));
+    vecf<3> t(5, -2, 1), sc(2, 0.5f, 3);
+
+    affine32 a(t, q, sc);
+    matf<4, 4> m = dot(dot((matf<4, 4>) scale(sc), (matf<4, 4>) q), (matf<4, 4>) translation(t));
+    assert_eq(approx_vec((matf<4, 4>) a), m);
+
+    vecf<3> p(1, 2, 3);
+    assert_eq(approx_vec(dot(p, a)), dot(p, m));
+    assert_eq(approx_vec(transform_direction(p, a)), (vecf<3>(dot(vecf<4>(p, 0), m))));
+
+    // Composing matches the product of the matrices
+    affine32 b(vecf<3>(0, 1, 0), normalize(quat(0.6f, vecf<3>(0, 0, 0.8f))), vecf<3>(1));
+    matf<4, 4> ab = dot(m, (matf<4, 4>) b);
+    assert_eq(approx_vec((matf<4, 4>) dot(a, b)), ab);
+    assert_eq(approx_vec(dot(p, dot(a, b))), dot(dot(p, a), b));
+
+    matf<4, 4> iden = identity();
+    assert_eq(approx_vec((matf<4, 4>) dot(a, inverse(a))), iden);
+    assert_eq(approx_vec((matf<4, 4>) dot(inverse(b), b)), iden);
+    assert_eq(approx_vec((matf<4, 4>) rigid_inverse(b)), (matf<4, 4>) inverse(b));
+
+    // Through a matrix and back
+    affine32 c(ab);
+    assert_eq(approx_vec((matf<4, 3>) c), (matf<4, 3>) dot(a, b));
+
+    affine64 d = identity();
+    d.set_translation(vec<f64, 3>(1, 2, 3));
+    assert_eq(dot(vec<f64, 3>(1, 1, 1), d), (vec<f64, 3>(2, 3, 4)));
+    assert_eq(sizeof(affine32), 48);
+}
+
 TEST(norm) {
     vec<f32, 8> v(1, 2, 3, 4, 5, 6, 7, 8);
     matf<2, 4> m = {1, 2, 3, 4, 5, 6, 7, 8};
@@ -1,4 +1,6 @@
+#include <lstd/base64.h>
 #include <lstd/parse.h>
+#include <lstd/parse_stream.h>
 
 #include "../test.h"
 
@@ -39,6 +41,22 @@ TEST(int) {
 
     test_parse_int(s32, parse_int_options{.TooManyDigitsBehaviour = parse_int_options::CONTINUE}, 10, "1000000000000000000000000", -1593835520, PARSE_SUCCESS, "");
     test_parse_int(s32, parse_int_options{.TooManyDigitsBehaviour = parse_int_options::CONTINUE}, 10, "-1000000000000000000000000", 1593835520, PARSE_SUCCESS, "");
+
+    // Long runs of digits go through the 8 digits at a time path, these check the chunk boundaries and the overflow checks around it
+    test_parse_int(u64, parse_int_options{}, 10, "18446744073709551615", numeric_info<u64>::max(), PARSE_SUCCESS, "");
+    test_parse_int(u64, parse_int_options{}, 10, "18446744073709551616", numeric_info<u64>::max(), PARSE_TOO_MANY_DIGITS, "");
+    test_parse_int(s64, parse_int_options{}, 10, "-9223372036854775807,", -9223372036854775807ll, PARSE_SUCCESS, ",");
+    test_parse_int(s64, parse_int_options{}, 10, "1234567812345678x", 1234567812345678ll, PARSE_SUCCESS, "x");
+    test_parse_int(s64, parse_int_options{}, 10, "12345678123456789", 12345678123456789ll, PARSE_SUCCESS, "");
+    test_parse_int(s32, parse_int_options{}, 10, "2147483647 ", numeric_info<s32>::max(), PARSE_SUCCESS, " ");
+    test_parse_int(s32, parse_int_options{}, 10, "2147483648", numeric_info<s32>::max(), PARSE_TOO_MANY_DIGITS, "");
+    test_parse_int(s32, parse_int_options{}, 10, "1234a5678", 1234, PARSE_SUCCESS, "a5678");
+
+    test_parse_int(u64, parse_int_options{}, 16, "FFFFFFFFffffffff", numeric_info<u64>::max(), PARSE_SUCCESS, "");
+    test_parse_int(s32, parse_int_options{}, 16, "7fffffff", numeric_info<s32>::max(), PARSE_SUCCESS, "");
+    test_parse_int(s32, parse_int_options{}, 16, "80000000", numeric_info<s32>::max(), PARSE_TOO_MANY_DIGITS, "");
+    test_parse_int(u64, parse_int_options{.ByteToDigit = byte_to_digit_force_lower}, 16, "deadbeefCAFE", 0xdeadbeef, PARSE_SUCCESS, "CAFE");
+    test_parse_int(u64, parse_int_options{.ByteToDigit = byte_to_digit_force_upper}, 16, "DEADBEEFcafe", 0xdeadbeef, PARSE_SUCCESS, "cafe");
 }
 
 #define test_parse_bool(options, buffer, expectedValue, expectedStatus, expectedRest) \
@@ -83,6 +101,132 @@ TEST(bool) {
     test_parse_bool(parse_bool_options{.ParseWords = false}, "false", false, PARSE_INVALID, "false");
 }
 
+// Compares the bits, so -0.0 and 0.0 are different
+#define test_parse_float(F, options, buffer, expectedValue, expectedStatus, expectedRest)            \
+    {                                                                                                \
+        auto [value, status, rest] = parse_float<F, options>((string) buffer);                       \
+        assert_eq(types::bit_cast<u64>((f64) value), types::bit_cast<u64>((f64) (F) expectedValue)); \
+        assert_eq(status, expectedStatus);                                                           \
+        assert_eq(rest, (bytes)(string) expectedRest);                                               \
+    }
+
+TEST(float) {
+    test_parse_float(f64, parse_float_options{}, "", 0.0, PARSE_EXHAUSTED, "");
+    test_parse_float(f64, parse_float_options{}, "-", 0.0, PARSE_EXHAUSTED, "-");
+    test_parse_float(f64, parse_float_options{}, "-.", 0.0, PARSE_EXHAUSTED, "-.");
+    test_parse_float(f64, parse_float_options{}, "-x", 0.0, PARSE_INVALID, "");
+    test_parse_float(f64, parse_float_options{}, ".e5", 0.0, PARSE_INVALID, "5");
+
+    test_parse_float(f64, parse_float_options{}, "0", 0.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "-0", -0.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1.5,", 1.5, PARSE_SUCCESS, ",");
+    test_parse_float(f64, parse_float_options{}, ".5", 0.5, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "5.", 5.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "+0.1", 0.1, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "-12.25e2", -1225.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1E-5", 1e-5, PARSE_SUCCESS, "");
+
+    // An 'e' without digits isn't part of the number
+    test_parse_float(f64, parse_float_options{}, "1e", 1.0, PARSE_SUCCESS, "e");
+    test_parse_float(f64, parse_float_options{}, "1e+x", 1.0, PARSE_SUCCESS, "e+x");
+    test_parse_float(f64, parse_float_options{.ParseExponent = false}, "1e5", 1.0, PARSE_SUCCESS, "e5");
+
+    test_parse_float(f64, parse_float_options{.ParseSign = false}, "-1", 0.0, PARSE_INVALID, "1");
+    test_parse_float(f64, parse_float_options{.AllowPlusSign = false}, "+1", 0.0, PARSE_INVALID, "1");
+
+    // Past Clinger's fast path (Eisel-Lemire)
+    test_parse_float(f64, parse_float_options{}, "1e23", 1e23, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "9007199254740993", 9007199254740992.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "2.2250738585072014e-308", 2.2250738585072014e-308, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1.7976931348623157e308", 1.7976931348623157e308, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "12345678.12345678e-3", 12345.67812345678, PARSE_SUCCESS, "");
+
+    // Subnormals, overflow and underflow
+    test_parse_float(f64, parse_float_options{}, "4.9406564584124654e-324", 4.9406564584124654e-324, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "2.4703282292062327e-324", 0.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1e-400", 0.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1.7976931348623159e308", numeric_info<f64>::infinity(), PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "-1e99999999999", -numeric_info<f64>::infinity(), PARSE_SUCCESS, "");
+
+    // More than 19 digits, exactly halfway between 1 and the next double - ties go to even (the slow path)
+    test_parse_float(f64, parse_float_options{}, "1.00000000000000011102230246251565404236316680908203125", 1.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "1.00000000000000011102230246251565404236316680908203126", 1.0000000000000002, PARSE_SUCCESS, "");
+    // 2^-1075 written out exactly, halfway between 0 and the smallest subnormal
+    test_parse_float(f64, parse_float_options{}, "2.4703282292062327208828439643411068618252990130716238221279284125033775363510437593264991818081799618989828234772285886546332835517796989819938739800539093906315035659515570226392290858392449105184435931802849936536152500319370457678249219365623669863658480757001585769269903706311928279558551332927834338409351978015531246597263579574622766465272827220056374006485499977096599470454020828166226237857393450736339007967761930577506740176324673600968951340535537458516661134223766678604162159680461914467291840300530057530849048765391711386591646239524912623653881879636239373280423891018672348497668235089863388587925628302755995657524455507255189313690836254779186948667994968324049705821028513185451396213837722826145437693412532098591327667236328125e-324",
+                     0.0, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996189898282347722858865463328355177969898199387398005390939063150356595155702263922908583924491051844359318028499365361525003193704576782492193656236698636584807570015857692699037063119282795585513329278343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378573934507363390079677619305775067401763246736009689513405355374585166611342237666786041621596804619144672918403005300575308490487653917113865916462395249126236538818796362393732804238910186723484976682350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854513962138377228261454376934125320985913276672363281250000001e-324",
+                     4.9406564584124654e-324, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "123456789012345678901234567890", 1.2345678901234568e29, PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "0000000000000000000000000001.5", 1.5, PARSE_SUCCESS, "");
+
+    test_parse_float(f32, parse_float_options{}, "3.4028235e38", 3.4028235e38f, PARSE_SUCCESS, "");
+    test_parse_float(f32, parse_float_options{}, "3.4028236e38", 3.4028236e38f, PARSE_SUCCESS, "");
+    test_parse_float(f32, parse_float_options{}, "1.4e-45", 1.4e-45f, PARSE_SUCCESS, "");
+    test_parse_float(f32, parse_float_options{}, "7e-46", 0.0f, PARSE_SUCCESS, "");
+    test_parse_float(f32, parse_float_options{}, "0.1", 0.1f, PARSE_SUCCESS, "");
+
+    test_parse_float(f64, parse_float_options{}, "inf", numeric_info<f64>::infinity(), PARSE_SUCCESS, "");
+    test_parse_float(f64, parse_float_options{}, "-Infinity!", -numeric_info<f64>::infinity(), PARSE_SUCCESS, "!");
+    test_parse_float(f64, parse_float_options{}, "infin", numeric_info<f64>::infinity(), PARSE_SUCCESS, "in");
+    test_parse_float(f64, parse_float_options{}, "in", 0.0, PARSE_EXHAUSTED, "in");
+    test_parse_float(f64, parse_float_options{.ParseSpecialValues = false}, "inf", 0.0, PARSE_INVALID, "nf");
+
+    auto [nan, status, rest] = parse_float<f64>((string) "NaN");
+    assert_true(nan != nan);
+    assert_eq(status, PARSE_SUCCESS);
+
+    // Round trips through fmt
+    u64 seed = 42;
+    For(range(10000)) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        f64 value = types::bit_cast<f64>(seed >> 2);  // Positive and finite
+        string formatted = sprint("{}", value);
+        defer(free(formatted));
+
+        auto [parsed, parsedStatus, parsedRest] = parse_float<f64>(formatted);
+        assert_eq(types::bit_cast<u64>(parsed), types::bit_cast<u64>(value));
+        assert_eq(parsedStatus, PARSE_SUCCESS);
+    }
+}
+
+TEST(float_rounding) {
+    u64 seed = 42;
+    For(range(10000)) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        // Exactly halfway between two f32, written out with all its digits (an f64 holds it exactly).
+        // Ties go to the even one and anything above the half goes up.
+        u32 bits  = (u32) ((127 - 30 + (seed >> 33) % 60) << 23) | (u32) ((seed >> 8) & 0x7FFFFF);
+        f32 lower = types::bit_cast<f32>(bits);
+        f32 upper = types::bit_cast<f32>(bits + 1);
+
+        string half = sprint("{:.120e}", ((f64) lower + (f64) upper) / 2);
+        defer(free(half));
+
+        auto [parsedHalf, halfStatus, halfRest] = parse_float<f32>(half);
+        assert_eq(types::bit_cast<u32>(parsedHalf), bits & 1 ? bits + 1 : bits);
+        assert_eq(halfStatus, PARSE_SUCCESS);
+
+        s64 e            = find_cp(half, 'e');
+        string aboveHalf = sprint("{}1{}", substring(half, 0, e), substring(half, e, half.Length));
+        defer(free(aboveHalf));
+
+        auto [parsedAbove, aboveStatus, aboveRest] = parse_float<f32>(aboveHalf);
+        assert_eq(types::bit_cast<u32>(parsedAbove), bits + 1);
+
+        // More than 19 significant digits for f64 (past Eisel-Lemire) and 9 for f32 (always enough to round trip)
+        f64 value       = types::bit_cast<f64>(seed >> 2);
+        string long64   = sprint("{:.25e}", value);
+        string digits32 = sprint("{:.8e}", lower);
+        defer(free(long64));
+        defer(free(digits32));
+
+        assert_eq(types::bit_cast<u64>(parse_float<f64>(long64).Value), types::bit_cast<u64>(value));
+        assert_eq(types::bit_cast<u32>(parse_float<f32>(digits32).Value), bits);
+    }
+}
+
 TEST(guid) {
     guid guid = guid_new();
 
@@ -106,3 +250,224 @@ TEST(guid) {
         }
     }
 }
+
+TEST(guid_generation) {
+    auto check_bits = [](const guid &g, byte version) {
+        assert_eq(g.Data[6] >> 4, version);
+        assert_eq(g.Data[8] >> 6, 2);  // Variant 1
+    };
+
+    guid v4[1000];
+    guid_new_batch(array<guid>(v4, 1000));
+
+    hash_table<guid, s64> seen;
+    defer(free(seen));
+
+    For(range(1000)) {
+        check_bits(v4[it], 4);
+        assert_false((void *) find(seen, v4[it]).Value);
+        set(seen, v4[it], it);
+    }
+
+    guid one = guid_new();
+    check_bits(one, 4);
+    assert_false((void *) find(seen, one).Value);
+
+    // More than fit in the counter of a millisecond, so the ones after that borrow the next one
+    guid v7[5000];
+    guid_new_v7_batch(array<guid>(v7, 5000));
+    v7[4999] = guid_new_v7();
+
+    For(range(5000)) {
+        check_bits(v7[it], 7);
+        if (it) assert_true(v7[it - 1] < v7[it]);
+    }
+}
+
+TEST(eat) {
+    // Long enough for the SIMD paths, the interesting byte in different places
+    For(range(40)) {
+        string spaces = sprint("{:{}}", "", it);
+        defer(free(spaces));
+
+        string input = sprint("{}\t\r\n x = 1; y", spaces);
+        defer(free(input));
+
+        auto [wsStatus, wsRest] = eat_white_space(input);
+        assert_eq(wsStatus, PARSE_SUCCESS);
+        assert_eq(wsRest, "x = 1; y");
+
+        auto [until, untilSuccess, untilRest] = eat_bytes_until_any_of(input, (bytes)(string) ";=");
+        assert_true(untilSuccess);
+        assert_eq(untilRest, (bytes)(string) "= 1; y");
+
+        auto [skipped, whileSuccess, whileRest] = eat_bytes_while_any_of(input, (bytes)(string) " \t\r\n");
+        assert_true(whileSuccess);
+        assert_eq(skipped.Count, it + 4);
+
+        auto [single, singleSuccess, singleRest] = eat_bytes_until(input, 'y');
+        assert_eq(singleRest, (bytes)(string) "y");
+    }
+
+    auto [allStatus, allRest] = eat_white_space("                        \n\n");
+    assert_eq(allStatus, PARSE_EXHAUSTED);
+
+    // Non-ascii code points are not white space but are still validated
+    auto [cpStatus, cpRest] = eat_white_space("                        \xe2\x82\xac");
+    assert_eq(cpStatus, PARSE_SUCCESS);
+    assert_eq(cpRest, "\xe2\x82\xac");
+
+    auto [noneSkipped, noneSuccess, noneRest] = eat_bytes_until("abcdefghijklmnopqrstuvwxyz", '!');
+    assert_false(noneSuccess);
+}
+
+TEST(stream) {
+    string input = "123 -4567\t3.25e2 hello, world;  \n CAFE 99999999999";
+
+    // Every chunk size puts the boundaries in different places, tokens end up split in all kinds of ways
+    for (s64 chunkSize = 1; chunkSize <= 8; ++chunkSize) {
+        byte chunk[8];
+        s64 index = 0;
+
+        // Reuses the same buffer for every chunk, so anything we didn't carry gets overwritten
+        auto reader = [&]() -> bytes {
+            s64 n = min(chunkSize, input.Count - index);
+            copy_memory(chunk, input.Data + index, n);
+            index += n;
+            return bytes(chunk, n);
+        };
+
+        parse_stream s;
+        parse_stream_init(s, &reader);
+        defer(free(s));
+
+        auto [a, aStatus, aRest] = parse_stream_int<s32>(s);
+        assert_eq(a, 123);
+        assert_eq(aStatus, PARSE_SUCCESS);
+        assert_eq(parse_stream_eat_white_space(s), PARSE_SUCCESS);
+
+        auto [b, bStatus, bRest] = parse_stream_int<s32>(s);
+        assert_eq(b, -4567);
+        assert_eq(bStatus, PARSE_SUCCESS);
+        assert_eq(parse_stream_eat_white_space(s), PARSE_SUCCESS);
+
+        auto [c, cStatus, cRest] = parse_stream_float<f64>(s);
+        assert_eq(c, 325.0);
+        assert_eq(cStatus, PARSE_SUCCESS);
+        assert_eq(parse_stream_eat_white_space(s), PARSE_SUCCESS);
+
+        assert_eq(parse_stream_expect_sequence(s, (string) "hello"), PARSE_SUCCESS);
+
+        auto [d, dSuccess, dRest] = parse_stream_eat_bytes_until(s, ';');
+        assert_eq(d, (bytes)(string) ", world");
+        assert_true(dSuccess);
+
+        assert_eq(parse_stream_expect_sequence(s, (string) ";"), PARSE_SUCCESS);
+        assert_eq(parse_stream_eat_white_space(s), PARSE_SUCCESS);
+        assert_eq(parse_stream_expect_sequence<true>(s, (string) "cafe"), PARSE_SUCCESS);
+        assert_eq(parse_stream_eat_white_space(s), PARSE_SUCCESS);
+
+        auto [e, eStatus, eRest] = parse_stream_int<s64>(s);
+        assert_eq(e, 99999999999ll);
+        assert_eq(eStatus, PARSE_SUCCESS);
+
+        auto [f, fStatus, fRest] = parse_stream_int<s64>(s);
+        assert_eq(fStatus, PARSE_EXHAUSTED);
+    }
+}
+
+// RFC 4648 test vectors, then every length up to a few vectors with every CPU path
+TEST(base64) {
+    auto vectors = to_stack_array<string>("", "f", "fo", "foo", "foob", "fooba", "foobar");
+    auto encoded = to_stack_array<string>("", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy");
+    For(range(vectors.Count)) {
+        string e = base64_encode((bytes) vectors[it]);
+        defer(free(e));
+        assert_eq(e, encoded[it]);
+
+        auto [decoded, status, rest] = parse_base64((bytes) encoded[it]);
+        defer(free(decoded));
+        assert_eq(status, PARSE_SUCCESS);
+        assert_eq(decoded, (bytes) vectors[it]);
+        assert_eq(rest.Count, 0);
+    }
+
+    byte data[300];
+    For(range(300)) data[it] = (byte) (it * 37 + (it >> 3));
+
+    For_as(pass, range(2)) {
+        if (pass == 0) cpu_features_override({});
+        if (pass == 1) cpu_features_reset();
+
+        For_as(n, range(300)) {
+            For_as(options, to_stack_array(base64_options{}, base64_options{.UrlSafe = true, .Padding = false})) {
+                utf8 text[400];
+                s64 size = base64_encode(text, data, n, options);
+                assert_eq(size, base64_encoded_size(n, options));
+
+                // The URL-safe alphabet doesn't have '+' or '/'
+                if (options.UrlSafe) For(range(size)) assert_true(text[it] != '+' && text[it] != '/');
+
+                byte out[300];
+                auto [written, status, rest] = parse_base64(out, bytes((byte *) text, size), options);
+                assert_eq(status, PARSE_SUCCESS);
+                assert_eq(written, n);
+                assert_eq(rest.Count, 0);
+                For(range(n)) assert_eq(out[it], data[it]);
+            }
+        }
+    }
+
+    // Stops at the first byte which isn't base64, the padding is optional
+    byte out[16];
+    auto [written, status, rest] = parse_base64(out, (bytes) string("SGVsbG8=\", 1"));
+    assert_eq(status, PARSE_SUCCESS);
+    assert_eq(written, 5);
+    assert_eq(rest, (bytes) string("\", 1"));
+    assert_eq(parse_base64(out, (bytes) string("SGVsbG8")).Value, 5);
+
+    // One character too many for a group, short padding and unused bits which aren't 0
+    assert_eq(parse_base64(out, (bytes) string("SGVsb")).Status, PARSE_INVALID);
+    assert_eq(parse_base64(out, (bytes) string("SGVsbA=")).Status, PARSE_INVALID);
+    assert_eq(parse_base64(out, (bytes) string("SGVsbB==")).Status, PARSE_INVALID);
+
+    // Each alphabet stops at the other one's characters
+    assert_eq(parse_base64(out, (bytes) string("aQ+/")).Rest.Count, 0);
+    assert_eq(parse_base64(out, (bytes) string("aQ+/"), {.UrlSafe = true}).Rest.Count, 2);
+}
+
+TEST(hex) {
+    byte data[100];
+    For(range(100)) data[it] = (byte) (it * 53);
+
+    For_as(pass, range(2)) {
+        if (pass == 0) cpu_features_override({});
+        if (pass == 1) cpu_features_reset();
+
+        For_as(n, range(100)) {
+            utf8 text[200];
+            assert_eq(hex_encode(text, data, n, n % 2), 2 * n);
+
+            byte out[100];
+            auto [written, status, rest] = parse_hex(out, bytes((byte *) text, 2 * n));
+            assert_eq(status, PARSE_SUCCESS);
+            assert_eq(written, n);
+            For(range(n)) assert_eq(out[it], data[it]);
+        }
+    }
+
+    auto [decoded, status, rest] = parse_hex((bytes) string("DEADbeef0102 tail"));
+    defer(free(decoded));
+    assert_eq(status, PARSE_SUCCESS);
+    assert_eq(decoded.Count, 6);
+    assert_eq(decoded[0], 0xDE);
+    assert_eq(decoded[3], 0xEF);
+    assert_eq(rest, (bytes) string(" tail"));
+
+    // An odd number of digits, the rest starts at the lone one
+    byte out[8];
+    auto odd = parse_hex(out, (bytes) string("abc"));
+    assert_eq(odd.Status, PARSE_INVALID);
+    assert_eq(odd.Value, 1);
+    assert_eq(odd.Rest, (bytes) string("c"));
+}
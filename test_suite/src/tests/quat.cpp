@@ -164,3 +164,58 @@ TEST(pow) {
 
     assert_eq(approx_vec(p), pexp);
 }
+
+TEST(slerp_nlerp) {
+    quat a = quat(1, 0, 0, 0);
+    quat b = normalize(quat(0.7071068f, 0, 0.7071068f, 0));  // 90 degrees around y
+
+    assert_eq(approx_vec(slerp(a, b, 0.0f)), a);
+    assert_eq(approx_vec(slerp(a, b, 1.0f)), b);
+
+    // Halfway is 45 degrees
+    quat half = slerp(a, b, 0.5f);
+    assert_eq(half.w, approx((f32) cos(TAU / 16)));
+    assert_eq(half.y, approx((f32) sin(TAU / 16)));
+
+    // -b is the same rotation, both take the shorter arc
+    quat minusB = quat(-b.w, -b.x, -b.y, -b.z);
+    assert_eq(approx_vec(slerp(a, minusB, 0.5f)), half);
+    assert_eq(approx_vec(nlerp(a, minusB, 0.5f)), half);  // At 0.5 both are on the bisector
+}
+
+TEST(batch_quats) {
+    // 21 isn't a multiple of any batch width
+    constexpr s64 N = 21;
+
+    quat a[N], b[N], r[N];
+    f32 t[N];
+    For(range(N)) {
+        a[it] = normalize(quat(1.0f + it, 0.5f * it, -0.25f * it, 2.0f));
+        b[it] = normalize(quat(-2.0f, 1.0f, (f32) it, 0.1f * it));  // Dot with a is negative for some
+        t[it] = (f32) it / (N - 1);
+    }
+
+    // The batch slerp is a polynomial, it's close but not exact
+    slerp(a, b, t, r, N);
+    For(range(N)) {
+        quat expected = slerp(a[it], b[it], t[it]);
+        For_as(k, range(4)) assert_lt(abs(r[it].Vec[k] - expected.Vec[k]), 1e-4f);
+    }
+
+    nlerp(a, b, 0.3f, r, N);
+    For(range(N)) assert_eq(approx_vec(r[it]), nlerp(a[it], b[it], 0.3f));
+
+    qmul(a, b, r, N);
+    For(range(N)) assert_eq(approx_vec(r[it]), qmul(a[it], b[it]));
+
+    m44 m[N];
+    to_mat(a, m, N);
+    For(range(N)) assert_eq(approx_vec(m[it]), (m44) a[it]);
+
+    // SoA agrees with AoS, and works in-place
+    f32 w[N], x[N], y[N], z[N];
+    For(range(N)) w[it] = a[it].w * 3, x[it] = a[it].x * 3, y[it] = a[it].y * 3, z[it] = a[it].z * 3;
+
+    normalize(soa_quat_view(w, x, y, z), soa_quat{w, x, y, z}, N);
+    For(range(N)) assert_eq(approx_vec(quat(w[it], x[it], y[it], z[it])), a[it]);
+}
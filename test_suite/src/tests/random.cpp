@@ -0,0 +1,104 @@
+#include <lstd/random.h>
+
+#include "../test.h"
+
+TEST(rng_sequence) {
+    // The reference implementation from https://prng.di.unimi.it/xoshiro256starstar.c with this state
+    rng r = {{1, 2, 3, 4}};
+    assert_eq(rng_next(r), 11520);
+    assert_eq(rng_next(r), 0);
+    assert_eq(rng_next(r), 1509978240);
+    assert_eq(rng_next(r), 1215971899390074240);
+
+    // Same seed, same numbers
+    rng a, b;
+    rng_seed(a, 42);
+    rng_seed(b, 42);
+    For(range(100)) assert_eq(rng_next(a), rng_next(b));
+
+    // A jumped copy starts somewhere else
+    rng_jump(b);
+    assert_true(rng_next(a) != rng_next(b));
+}
+
+TEST(rng_bounded) {
+    rng r;
+    rng_seed(r, 7);
+
+    s64 counts[6] = {};
+    For(range(60000)) {
+        s64 die = rng_range(r, 1, 7);
+        assert_true(die >= 1 && die < 7);
+        ++counts[die - 1];
+    }
+    For(counts) assert_true(it > 9500 && it < 10500);
+
+    assert_eq(rng_range(r, -5, -4), -5);
+    For(range(1000)) assert_lt(rng_below(r, 3), 3);
+
+    // Bounds close to 2^64, where most of the low halves are rejected
+    For(range(1000)) assert_lt(rng_below(r, (1ull << 63) + 1), (1ull << 63) + 1);
+
+    For(range(10000)) {
+        f64 d = rng_f64(r);
+        assert_true(d >= 0 && d < 1);
+
+        f32 f = rng_f32(r, -2.0f, 2.0f);
+        assert_true(f >= -2.0f && f < 2.0f);
+    }
+}
+
+// The bulk fill gives the same numbers with every SIMD path turned off
+TEST(rng_fill) {
+    constexpr s64 N = 10001;  // Not a multiple of the 4 streams
+
+    u64 *numbers[2];
+    f64 *doubles[2];
+    f32 *floats[2];
+    For(range(2)) {
+        if (it == 0) cpu_features_override({});
+        if (it == 1) cpu_features_reset();
+
+        numbers[it] = allocate_array<u64>(N);
+        doubles[it] = allocate_array<f64>(N);
+        floats[it]  = allocate_array<f32>(N);
+
+        rng r;
+        rng_seed(r, 123);
+        rng_fill(r, array<u64>(numbers[it], N));
+        rng_fill(r, array<f64>(doubles[it], N));
+        rng_fill(r, array<f32>(floats[it], N));
+    }
+    defer({
+        For(range(2)) {
+            free(numbers[it]);
+            free(doubles[it]);
+            free(floats[it]);
+        }
+    });
+
+    For(range(N)) {
+        assert_eq(numbers[0][it], numbers[1][it]);
+        assert_eq(doubles[0][it], doubles[1][it]);
+        assert_eq(floats[0][it], floats[1][it]);
+        assert_true(doubles[0][it] >= 0 && doubles[0][it] < 1);
+        assert_true(floats[0][it] >= 0 && floats[0][it] < 1);
+    }
+
+    // The streams are _r_ jumped 0, 1, 2 and 3 times
+    rng streams[4];
+    rng_seed(streams[0], 123);
+    For(range(1, 4)) {
+        streams[it] = streams[it - 1];
+        rng_jump(streams[it]);
+    }
+    For(range(N)) assert_eq(numbers[0][it], rng_next(streams[it % 4]));
+
+    // Small arrays are filled in order
+    u64 few[10];
+    rng r, expected;
+    rng_seed(r, 5);
+    rng_seed(expected, 5);
+    rng_fill(r, array<u64>(few, 10));
+    For(few) assert_eq(it, rng_next(expected));
+}
@@ -0,0 +1,189 @@
+#include <lstd/regex.h>
+
+#include "../test.h"
+
+file_scope regex_match find(const string &pattern, const string &text, bool caseInsensitive = false) {
+    regex re;
+    assert_true(regex_compile(re, pattern, {.CaseInsensitive = caseInsensitive}));
+    defer(free(re));
+    return regex_find(re, text);
+}
+
+#define assert_match(pattern, text, begin, end)         \
+    {                                                    \
+        regex_match m = find(pattern, text);             \
+        assert_eq(m.Begin, begin);                       \
+        assert_eq(m.End, end);                           \
+    }
+
+TEST(regex_syntax) {
+    assert_match("b+", "aabbbc", 2, 5);
+    assert_match("(?:ab)+c", "ababxababc", 5, 10);
+    assert_match("a{2,3}", "aaaa", 0, 3);
+    assert_match("a{2,3}?", "aaaa", 0, 2);
+    assert_match("[^a-z]+", "abc123def", 3, 6);
+    assert_match("\\d+", "ab 12345 c", 3, 8);
+    assert_match("\\w+\\s\\w+", "  hi there ", 2, 10);
+    assert_match("a.c", "a\nc abc", 4, 7);
+    assert_match("\\x41", "zA", 1, 2);
+    assert_match("^x$", "x", 0, 1);
+    assert_match("^x$", "xx", -1, -1);
+    assert_match("a$", "aba", 2, 3);
+
+    // UTF-8
+    assert_match("é", "caféx", 3, 5);
+    assert_match("[é-ë]", "zê", 1, 3);
+    assert_match("\\x{e9}", "café", 3, 5);
+
+    regex_match m = find("HELLO", "say hello", true);
+    assert_eq(m.Begin, 4);
+    assert_eq(m.End, 9);
+
+    regex re;
+    assert_false(regex_compile(re, "("));
+    assert_false(regex_compile(re, "a{3,2}"));
+    assert_false(regex_compile(re, "[z-a]"));
+    assert_false(regex_compile(re, "*a"));
+    assert_false(regex_compile(re, "\\"));
+}
+
+TEST(regex_find) {
+    // Leftmost-first, not longest
+    assert_match("a|ab", "xab", 1, 2);
+    assert_match("ab|a", "xab", 1, 3);
+    assert_match("cat|dog", "hotdog", 3, 6);
+
+    // A literal prefix, the search jumps to it
+    assert_match("ERROR .*out", "foo ERROR it timed out!", 4, 22);
+    assert_match("ERROR[0-9]", "ERRORx ERROR5", 7, 13);
+    assert_match("ERROR", "no", -1, -1);
+
+    // Empty matches
+    assert_match("a*", "bbb", 0, 0);
+    assert_match("x*", "", 0, 0);
+
+    regex re;
+    assert_true(regex_compile(re, "a+b"));
+    assert_true(regex_matches(re, "aaab"));
+    assert_false(regex_matches(re, "aaabc"));
+    assert_true(regex_search(re, "xxaabx"));
+    assert_false(regex_search(re, "aaa"));
+    assert_eq(regex_find(re, "ab ab", 1).Begin, 3);
+
+    regex copy;
+    clone(&copy, re);
+    free(re);
+    assert_true(regex_matches(copy, "ab"));
+    free(copy);
+
+    // After an empty match the next one begins a code point later
+    assert_true(regex_compile(re, "a*"));
+    regex_match matches[8];
+    assert_eq(regex_find_all(re, "baac", array<regex_match>(matches, 8)), 4);
+    assert_eq(matches[1].Begin, 1);
+    assert_eq(matches[1].End, 3);
+    assert_eq(matches[3].Begin, 4);
+    free(re);
+}
+
+TEST(regex_cache_reset) {
+    // [ab]*a[ab]{8} needs 2^9 states, with a tiny cache it's cleared over and over and the result is the same
+    string text;
+    defer(free(text));
+
+    u32 x = 1;
+    For(range(20000)) {
+        x = x * 1103515245 + 12345;
+        string_append(text, (x >> 16) & 1 ? 'a' : 'b');
+    }
+
+    regex small, big;
+    assert_true(regex_compile(small, "[ab]*a[ab]{8}", {.CacheSize = 2048}));
+    assert_true(regex_compile(big, "[ab]*a[ab]{8}"));
+    defer(free(small));
+    defer(free(big));
+
+    regex_match a = regex_find(small, text), b = regex_find(big, text);
+    assert_eq(a.Begin, b.Begin);
+    assert_eq(a.End, b.End);
+    assert_gt(small.Find.Resets, 0);
+}
+
+TEST(multi_pattern) {
+    string words[] = {"he", "she", "his", "hers", "shell"};
+
+    multi_pattern m;
+    assert_true(multi_pattern_compile(m, array<string>(words, 5)));
+    defer(free(m));
+
+    // Once without SIMD (the automaton), once with the best Teddy kernel
+    For(range(2)) {
+        if (it == 0) cpu_features_override({});
+        if (it == 1) cpu_features_reset();
+
+        // Leftmost, then longest
+        multi_pattern_match match = multi_pattern_find(m, "ushers");
+        assert_eq(match.Pattern, 1);
+        assert_eq(match.Begin, 1);
+        assert_eq(match.End, 4);
+
+        match = multi_pattern_find(m, "a shell of his");
+        assert_eq(match.Pattern, 4);
+        assert_eq(match.Begin, 2);
+        assert_eq(match.End, 7);
+
+        assert_false(multi_pattern_find(m, "nothing to see"));
+
+        // Long enough to go through full SIMD blocks before the match
+        string text = "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxhis and hers";
+        multi_pattern_match all[8];
+        assert_eq(multi_pattern_find_all(m, text, array<multi_pattern_match>(all, 8)), 2);
+        assert_eq(all[0].Pattern, 2);
+        assert_eq(all[1].Pattern, 3);
+        assert_eq(all[1].Begin, text.Count - 4);
+    }
+
+    // More patterns than Teddy takes
+    string many[40];
+    utf8 storage[40][4];
+    For(range(40)) {
+        storage[it][0] = 'k';
+        storage[it][1] = (utf8) ('a' + it / 10);
+        storage[it][2] = (utf8) ('0' + it % 10);
+        many[it]       = string(storage[it], 3);
+    }
+
+    multi_pattern big;
+    assert_true(multi_pattern_compile(big, array<string>(many, 40)));
+    defer(free(big));
+    assert_false(big.Teddy);
+
+    multi_pattern_match match = multi_pattern_find(big, "key kd7 kb3");
+    assert_eq(match.Pattern, 37);
+    assert_eq(match.Begin, 4);
+
+    string empty[] = {"a", ""};
+    multi_pattern bad;
+    assert_false(multi_pattern_compile(bad, array<string>(empty, 2)));
+}
+
+TEST(regex_alternation_prefilter) {
+    regex re;
+    assert_true(regex_compile(re, "(?:ERROR|FATAL): \\w+"));
+    defer(free(re));
+    assert_eq(re.Prefixes.Patterns.Count, 2);
+
+    regex_match m = regex_find(re, "info: ok, FATAL: disk, ERROR: net");
+    assert_eq(m.Begin, 10);
+    assert_eq(m.End, 21);
+
+    regex_match matches[4];
+    assert_eq(regex_find_all(re, "ERROR: a FATAL b FATAL: c", array<regex_match>(matches, 4)), 2);
+    assert_eq(matches[1].Begin, 17);
+
+    // A branch without a literal prefix turns it off
+    regex loose;
+    assert_true(regex_compile(loose, "ERROR|\\d+"));
+    defer(free(loose));
+    assert_eq(loose.Prefixes.Patterns.Count, 0);
+}
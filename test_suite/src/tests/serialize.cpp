@@ -0,0 +1,358 @@
+#include <lstd/serialize.h>
+
+#include "../test.h"
+
+struct bytes_writer : writer {
+    bytes Out;
+
+    void write(const byte *data, s64 size) override { array_append(Out, data, size); }
+};
+
+struct snapshot_header {
+    u32 Magic;
+    u16 Version;
+    f64 Time;
+};
+
+file_scope bool is_inside(const void *p, const bytes &data) { return p >= data.Data && p < data.Data + data.Count; }
+
+TEST(binary_roundtrip) {
+    bytes_writer out;
+    defer(free(out.Out));
+
+    f64 *samples = allocate_array<f64>(100, {.Alignment = 16});
+    defer(free(samples));
+    For(range(100)) samples[it] = (f64) it * 0.5;
+
+    string names[] = {"one", "два", ""};
+
+    hash_table<string, s32> ids;
+    defer(free(ids));
+    For(range(50)) add(ids, sprint("id{}", it), (s32) it);  // The keys are freed below
+    defer({
+        For(ids) free(*it.Key);
+    });
+
+    binary_writer w = {&out};
+    binary_write(w, snapshot_header{0x534E4150, 3, 1.5});
+    binary_write(w, array<f64>(samples, 100));
+    binary_write(w, array<string>(names, 3));
+    binary_write(w, ids);
+    assert_eq(w.Offset, out.Out.Count);
+
+    // The allocator's blocks are aligned, so the f64 run lines up and is read as a view
+    binary_reader r = {out.Out};
+
+    snapshot_header header;
+    assert_true(binary_read(r, &header));
+    assert_eq(header.Magic, 0x534E4150);
+    assert_eq(header.Version, 3);
+    assert_eq(header.Time, 1.5);
+
+    array<f64> readSamples;
+    assert_true(binary_read(r, &readSamples));
+    assert_eq(readSamples.Count, 100);
+    assert_true(is_inside(readSamples.Data, out.Out));
+    assert_eq(readSamples.Allocated, 0);
+    For(range(100)) assert_eq(readSamples[it], (f64) it * 0.5);
+
+    array<string> readNames;
+    assert_true(binary_read(r, &readNames));
+    defer(free(readNames));
+    assert_eq(readNames.Count, 3);
+    assert_eq(readNames[1], "два");
+    assert_eq(readNames[1].Length, 3);
+    assert_true(is_inside(readNames[0].Data, out.Out));
+    assert_eq(readNames[2].Count, 0);
+
+    hash_table<string, s32> readIds;
+    assert_true(binary_read(r, &readIds));
+    defer(free(readIds));
+    assert_eq(readIds.Count, 50);
+    For(range(50)) {
+        string name = sprint("id{}", it);
+        defer(free(name));
+
+        auto [key, value] = find(readIds, name);
+        assert_true(value != null);
+        assert_eq(*value, it);
+        assert_true(is_inside(key->Data, out.Out));
+    }
+
+    assert_false(r.Failed);
+    assert_eq(r.Offset, out.Out.Count);
+}
+
+TEST(binary_copy_and_truncated) {
+    bytes_writer out;
+    defer(free(out.Out));
+
+    u32 values[] = {1, 2, 3, 4, 5};
+    binary_writer w = {&out};
+    binary_write(w, (u8) 7);  // So the u32 run needs padding
+    binary_write(w, array<u32>(values, 5));
+    binary_write(w, string("hello"));
+
+    // With _Copy_ nothing points into the data
+    binary_reader r = {.Data = out.Out, .Copy = true};
+    u8 first;
+    array<u32> readValues;
+    string hello;
+    assert_true(binary_read(r, &first));
+    assert_true(binary_read(r, &readValues));
+    assert_true(binary_read(r, &hello));
+    defer(free(readValues));
+    defer(free(hello));
+
+    assert_eq(first, 7);
+    assert_eq(readValues.Count, 5);
+    assert_gt(readValues.Allocated, 0);
+    assert_eq(readValues[4], 5);
+    assert_eq(hello, "hello");
+    assert_false(is_inside(hello.Data, out.Out));
+
+    // Every prefix of the data is invalid
+    For(range(out.Out.Count)) {
+        binary_reader t = {bytes(out.Out.Data, it)};
+        u8 a;
+        array<u32> b;
+        string c;
+        bool ok = binary_read(t, &a) && binary_read(t, &b) && binary_read(t, &c);
+        assert_false(ok);
+        assert_true(t.Failed);
+    }
+
+    // A count which is bigger than the data
+    bytes_writer bad;
+    defer(free(bad.Out));
+    binary_writer bw = {&bad};
+    binary_write_varint(bw, 1ull << 40);
+
+    binary_reader br = {bad.Out};
+    array<u64> huge;
+    assert_false(binary_read(br, &huge));
+    assert_eq(huge.Count, 0);
+}
+
+TEST(hash_table_image) {
+    hash_table<s64, f64> table;
+    defer(free(table));
+    For(range(1000)) add(table, it * 7, (f64) it / 4);
+
+    bytes_writer out;
+    defer(free(out.Out));
+    hash_table_image_write(&out, table);
+    assert_eq(out.Out.Count, hash_table_image_size(table));
+
+    // Queried in a mapped file, nothing is read into memory first
+    auto thisFile = string(__FILE__);
+    string file = path_join(path_directory(thisFile), "data/table.image");
+    defer(free(file));
+
+    path_write_to_file(file, string(out.Out.Data, out.Out.Count), path_write_mode::Overwrite_Entire);
+    defer(path_delete_file(file));
+
+    auto mapping = path_open_mapping(file);
+    assert(mapping.File);
+    defer(free(mapping));
+
+    auto view = path_map_view(mapping);
+    defer(path_unmap_view(view));
+
+    hash_table<s64, f64> image;
+    assert_true(hash_table_image_open(&image, view.Content));
+    assert_eq(image.Count, 1000);
+    assert_true(is_inside(image.Keys, view.Content));
+
+    For(range(1000)) {
+        auto [key, value] = find(image, it * 7);
+        assert_true(value != null);
+        assert_eq(*value, (f64) it / 4);
+    }
+    assert_true(find(image, 3).Value == null);
+
+    // Not an image of this type, cut short or corrupted
+    hash_table<s32, f64> other;
+    assert_false(hash_table_image_open(&other, view.Content));
+    assert_false(hash_table_image_open(&image, bytes(view.Content.Data, view.Content.Count - 1)));
+
+    out.Out[8] ^= 1;  // The key size
+    assert_false(hash_table_image_open(&image, out.Out));
+}
+
+// Gives out the bytes a few at a time, so values get split between reads
+struct chunked_bytes_reader : reader {
+    bytes Source;
+    s64 Position = 0, ChunkSize = 7;
+
+    s64 read_source(byte *dest, s64 size) override {
+        s64 n = min(min(size, ChunkSize), Source.Count - Position);
+        copy_memory(dest, Source.Data + Position, n);
+        Position += n;
+        return n;
+    }
+};
+
+TEST(varint) {
+    u64 values[] = {0, 1, 127, 128, 300, 16383, 16384, 0xFFFFFFFF, 1ull << 56, 0xFFFFFFFFFFFFFFFF};
+    s64 sizes[]  = {1, 1, 1, 2, 2, 2, 3, 5, 9, 10};
+
+    For(range(10)) {
+        byte buffer[VARINT_MAX_SIZE];
+        s64 n = varint_encode(buffer, values[it]);
+        assert_eq(n, sizes[it]);
+        assert_eq(varint_size(values[it]), n);
+
+        u64 decoded;
+        assert_eq(varint_decode(buffer, n, &decoded), n);
+        assert_eq(decoded, values[it]);
+
+        // Cut short
+        assert_eq(varint_decode(buffer, n - 1, &decoded), 0);
+    }
+
+    // 11 bytes, and 10 bytes with bits past 64
+    byte tooLong[11]  = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+    byte overflow[10] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02};
+    u64 decoded;
+    assert_eq(varint_decode(tooLong, 11, &decoded), 0);
+    assert_eq(varint_decode(overflow, 10, &decoded), 0);
+
+    assert_eq(zigzag_encode((s64) 0), 0);
+    assert_eq(zigzag_encode((s64) -1), 1);
+    assert_eq(zigzag_encode((s64) 1), 2);
+    assert_eq(zigzag_encode((s32) -2), 3u);
+    For_as(v, to_stack_array<s64>(0, -1, 63, -64, 1ll << 40, S64_MIN, S64_MAX)) assert_eq(zigzag_decode(zigzag_encode(v)), v);
+    For_as(v, to_stack_array<s32>(0, -1, S32_MIN, S32_MAX)) assert_eq(zigzag_decode(zigzag_encode(v)), v);
+
+    // Through a writer and a reader which splits the varints
+    bytes_writer out;
+    defer(free(out.Out));
+    For(values) write_varint(&out, it);
+    write_varint_signed(&out, -5);
+    write_varint_signed(&out, S64_MIN);
+
+    chunked_bytes_reader in;
+    in.Source = out.Out;
+    defer(free(&in));
+
+    For(values) {
+        assert_true(read_varint(&in, &decoded));
+        assert_eq(decoded, it);
+    }
+    s64 signedValue;
+    assert_true(read_varint_signed(&in, &signedValue));
+    assert_eq(signedValue, -5);
+    assert_true(read_varint_signed(&in, &signedValue));
+    assert_eq(signedValue, S64_MIN);
+    assert_false(read_varint(&in, &decoded));
+
+    // And the binary serializer
+    bytes_writer bin;
+    defer(free(bin.Out));
+    binary_writer w = {&bin};
+    binary_write_signed(w, -300);
+    binary_write_varint(w, 0xFFFFFFFFFFFFFFFF);
+    assert_eq(w.Offset, 2 + 10);
+
+    binary_reader r = {bin.Out};
+    assert_eq(binary_read_signed(r), -300);
+    assert_eq(binary_read_varint(r), 0xFFFFFFFFFFFFFFFF);
+    assert_false(r.Failed);
+    binary_read_varint(r);
+    assert_true(r.Failed);
+}
+
+TEST(streamvbyte) {
+    // Every length in every lane, and a count which isn't a multiple of 4 or of the block
+    constexpr s64 N = 2 * STREAMVBYTE_BLOCK + 37;
+
+    u32 *values   = allocate_array<u32>(N);
+    s32 *signedV  = allocate_array<s32>(N);
+    u32 *decoded  = allocate_array<u32>(N);
+    s32 *decodedS = allocate_array<s32>(N);
+    byte *encoded = allocate_array<byte>(streamvbyte_max_size(N));
+    defer(free(values));
+    defer(free(signedV));
+    defer(free(decoded));
+    defer(free(decodedS));
+    defer(free(encoded));
+
+    u64 state = 5;
+    For(range(N)) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u32 bits    = (u32) (state >> 59) + 1;  // 1 - 32
+        values[it]  = (u32) (state >> 16) >> (32 - bits);
+        signedV[it] = (s32) values[it] >> (it % 3);
+    }
+
+    For_as(pass, range(2)) {
+        if (pass == 0) cpu_features_override({});
+        if (pass == 1) cpu_features_reset();
+
+        For_as(count, to_stack_array<s64>(0, 1, 3, 4, 5, 17, N)) {
+            s64 size = streamvbyte_encode(encoded, values, count);
+            assert_le(size, streamvbyte_max_size(count));
+            assert_eq(streamvbyte_encoded_size(encoded, count), size);
+
+            assert_eq(streamvbyte_decode(decoded, encoded, size, count), size);
+            For(range(count)) assert_eq(decoded[it], values[it]);
+
+            if (count) assert_eq(streamvbyte_decode(decoded, encoded, size - 1, count), -1);
+
+            size = streamvbyte_encode(encoded, signedV, count);
+            assert_eq(streamvbyte_decode(decodedS, encoded, size, count), size);
+            For(range(count)) assert_eq(decodedS[it], signedV[it]);
+        }
+    }
+
+    // Small values take a byte each and a control byte per 4
+    u32 small[8] = {1, 2, 3, 4, 5, 6, 7, 255};
+    assert_eq(streamvbyte_encode(encoded, small, 8), 2 + 8);
+
+    // Through a writer and a reader, block by block
+    bytes_writer out;
+    defer(free(out.Out));
+    s64 written = write_streamvbyte(&out, values, N);
+    assert_eq(written, out.Out.Count);
+
+    chunked_bytes_reader in;
+    in.Source    = out.Out;
+    in.ChunkSize = 1000;
+    defer(free(&in));
+
+    array<u32> read;
+    defer(free(read));
+    assert_true(read_streamvbyte(&in, &read));
+    assert_eq(read.Count, N);
+    For(range(N)) assert_eq(read[it], values[it]);
+
+    chunked_bytes_reader cut;
+    cut.Source = bytes(out.Out.Data, out.Out.Count - 1);
+    defer(free(&cut));
+    array<u32> partial;
+    defer(free(partial));
+    assert_false(read_streamvbyte(&cut, &partial));
+    assert_eq(partial.Count, 2 * STREAMVBYTE_BLOCK);
+
+    // And the binary serializer, which is the same bytes
+    bytes_writer bin;
+    defer(free(bin.Out));
+    binary_writer w = {&bin};
+    binary_write_streamvbyte(w, values, N);
+    assert_eq(w.Offset, written);
+    assert_true(bin.Out == out.Out);
+
+    binary_reader r = {bin.Out};
+    array<u32> fromBinary;
+    defer(free(fromBinary));
+    assert_true(binary_read_streamvbyte(r, &fromBinary));
+    assert_eq(r.Offset, written);
+    For(range(N)) assert_eq(fromBinary[it], values[it]);
+
+    binary_reader truncated = {bytes(bin.Out.Data, bin.Out.Count - 1)};
+    array<u32> none;
+    defer(free(none));
+    assert_false(binary_read_streamvbyte(truncated, &none));
+    assert_true(truncated.Failed);
+}
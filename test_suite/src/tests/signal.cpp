@@ -1,4 +1,5 @@
-#include <lstd/memory/signal.h>
+#include <lstd/memory/concurrent_signal.h>
+#include <lstd/memory/event_queue.h>
 
 #include "../test.h"
 
@@ -74,3 +75,175 @@ TEST(functor_delegate) {
     auto delegate0 = delegate<s32()>(&functor);
     assert_eq(delegate0(), functor.i);
 }
+
+TEST(owning_delegate) {
+    // Small captures are stored inline
+    s32 a = 1, b = 2;
+    owning_delegate<s32(s32)> small = [a, b](s32 x) { return x + a + b; };
+    assert_true(small.Heap == null);
+    assert_eq(small(10), 13);
+
+    // Bigger ones are copied to the heap
+    s64 big[16];
+    For(range(16)) big[it] = it * 2;
+
+    owning_delegate<s64(s64)> large = [big](s64 i) { return big[i]; };
+    assert_true(large.Heap != null);
+    assert_eq(large(7), 14);
+    free(large);
+    assert_true(large == null);
+
+    // Everything a delegate takes works too
+    owning_delegate<s32(s32)> function = my_callback1;
+    assert_eq(function(1), 2);
+
+    Member_Test myStruct;
+    owning_delegate<s32(s32)> method = {&myStruct, &Member_Test::member_callback};
+    assert_eq(method(1), myStruct.value + 1);
+
+    functor_test functor;
+    owning_delegate<s32()> pointer = &functor;  // Not copied
+    pointer();
+    assert_eq(functor.i, 20);
+
+    // Signals and threads keep their own copy of the closure
+    signal<s32(s32), collector_array<s32>> signal;
+    For(range(3)) {
+        s32 factor = (s32) it;
+        signal.connect([factor](s32 x) { return x * factor; });
+    }
+
+    array<s32> result = signal.emit(2);
+    assert_eq(result, to_stack_array<s32>(0, 2, 4));
+    free(result);
+    signal.release();
+
+    s32 sum = 0;
+    s32 *out = &sum;
+
+    thread::thread t;
+    t.init_and_launch([out, a, b](void *) { *out = a + b; });
+    t.wait();
+    assert_eq(sum, a + b);
+}
+
+TEST(concurrent_signal) {
+    concurrent_signal<s32(s32), collector_array<s32>> signal;
+    signal.Alloc = internal::platform_get_persistent_allocator();
+    defer(signal.release());
+
+    s64 id0 = signal.connect(my_callback);
+    s64 id1 = signal.connect(my_callback1);
+    s64 id2 = signal.connect(my_callback2);
+    signal.connect(my_callback3);
+
+    // Disconnected callbacks leave no holes and ids stay valid for the ones after them
+    assert_true(signal.disconnect(id1));
+    assert_false(signal.disconnect(id1));
+    assert_eq(signal.count(), 3);
+
+    array<s32> result = signal.emit(20);
+    assert_eq(result, to_stack_array<s32>(20, 22, 23));
+    free(result);
+
+    assert_true(signal.disconnect(id2));
+    assert_true(signal.disconnect(id0));
+
+    result = signal.emit(20);
+    assert_eq(result, to_stack_array<s32>(23));
+    free(result);
+
+    // Emit from many threads while others connect and disconnect
+    concurrent_signal<void(s32 *)> counter;
+    counter.Alloc = internal::platform_get_persistent_allocator();
+    defer(counter.release());
+
+    auto increment = [](s32 *hits) { atomic_inc(hits); };
+    counter.connect(&increment);  // Always connected, so every emit counts at least once
+
+    constexpr s32 EMITTERS = 4, EMITS = 10000;
+
+    s32 hits = 0, stop = 0;
+
+    array<thread::thread> threads;
+    defer(free(threads));
+
+    auto emitter = [&](void *) {
+        For(range(EMITS)) counter.emit(&hits);
+    };
+
+    auto churn = [&](void *) {
+        while (!atomic_load(&stop)) {
+            s64 id = counter.connect(&increment);
+            counter.disconnect(id);
+        }
+    };
+
+    array_append(threads)->init_and_launch(&churn);
+    For(range(EMITTERS)) array_append(threads)->init_and_launch(&emitter);
+
+    For(range(1, threads.Count)) threads[it].wait();
+    atomic_store(&stop, 1);
+    threads[0].wait();
+
+    assert_ge(hits, EMITTERS * EMITS);
+    assert_eq(counter.count(), 1);
+
+    // Once nobody emits the replaced lists can all be freed
+    counter.synchronize();
+    assert_true(counter.Retired == null);
+}
+
+TEST(event_queue) {
+    event_queue events;
+    events.Alloc = internal::platform_get_persistent_allocator();
+    defer(events.release());
+
+    s32 wakes = 0;
+    events.Wake = [&wakes]() { ++wakes; };
+
+    s64 sum = 0;
+    thread::id dispatcher = Context.ThreadID;
+
+    auto add = [&](s64 value) {
+        assert_true(Context.ThreadID == dispatcher);  // Callbacks run on the thread which dispatches
+        sum += value;
+    };
+
+    signal<void(s64)> added;
+    added.connect(&add);
+    defer(added.release());
+
+    // Post from many threads, nothing runs until the dispatch
+    constexpr s64 THREADS = 4, POSTS = 1000;
+
+    array<thread::thread> threads;
+    defer(free(threads));
+
+    auto poster = [&](void *) {
+        For(range(POSTS)) events.post(&added, it);
+    };
+    For(range(THREADS)) array_append(threads)->init_and_launch(&poster);
+    For(threads) it.wait();
+
+    assert_eq(sum, 0);
+    assert_eq(events.pending(), THREADS * POSTS);
+    assert_eq(wakes, 1);  // Only the first post into an empty batch wakes the owner
+
+    assert_eq(events.dispatch(), THREADS * POSTS);
+    assert_eq(sum, THREADS * (POSTS - 1) * POSTS / 2);
+    assert_eq(events.pending(), 0);
+
+    // Coalescing
+    sum = 0;
+    events.post_coalesced(&added, (s64) 5);
+    events.post_coalesced(&added, (s64) 5);  // Dropped, the same event is waiting
+    events.post_coalesced(&added, (s64) 7);
+
+    events.post_coalesced_by(0, &added, (s64) 100);
+    events.post_coalesced_by(0, &added, (s64) 200);  // Replaces the one before
+
+    assert_eq(events.dispatch(), 3);
+    assert_eq(sum, 5 + 7 + 200);
+    assert_eq(wakes, 2);
+}
@@ -1,3 +1,5 @@
+#include <lstd/memory/object_pool.h>
+
 #include "../test.h"
 
 TEST(stack_array) {
@@ -21,6 +23,39 @@ TEST(stack_array) {
     assert_eq(find(a, 0), 0);
 }
 
+TEST(copy_memory_large) {
+    // Make the streaming and rep movsb paths kick in without allocating megabytes
+    u64 oldThreshold = NonTemporalThreshold;
+    NonTemporalThreshold = 64 * 1024;
+    defer(NonTemporalThreshold = oldThreshold);
+
+    s64 size = 200 * 1024 + 13;
+    auto *a = allocate_array<byte>(size + 64);
+    auto *b = allocate_array<byte>(size + 64);
+    defer(free(a));
+    defer(free(b));
+
+    For(range(3)) {
+        s64 n = it == 0 ? 3000 : size;  // rep movsb, streaming and streaming clipped by an odd offset
+        s64 offset = it == 2 ? 7 : 0;
+
+        For_as(i, range(n)) a[i] = (byte)(i * 31 + 7);
+        copy_memory(b + offset, a, n);
+        assert_eq(compare_memory(b + offset, a, n), -1);
+
+        fill_memory(b + offset, 0x5A, n);
+        s64 wrong = 0;
+        For_as(i, range(n)) if (b[offset + i] != 0x5A) ++wrong;
+        assert_eq(wrong, 0);
+    }
+
+    // Overlapping copies still work like memmove
+    For_as(i, range(size)) a[i] = (byte)(i * 31 + 7);
+    copy_memory(a + 1, a, size - 1);
+    assert_eq(a[0], (byte) 7);
+    assert_eq(a[size - 1], (byte)((size - 2) * 31 + 7));
+}
+
 TEST(array) {
     array<s64> a;
     defer(free(a));
@@ -133,4 +168,2451 @@ TEST(hash_table_alignment) {
 
     add(simdTable, {1, 2}, {1, 2, 3});
     add(simdTable, {1, 3}, {4, 7, 9});
-}
\ No newline at end of file
+}
+
+TEST(hash_table_remove) {
+    hash_table<s64, s64> t;
+    defer(free(t));
+
+    For(range(100)) add(t, it, it);
+
+    // Churn with a stable count shouldn't make the table grow
+    s64 allocated = t.Allocated;
+    For(range(100, 10000)) {
+        assert_true(remove(t, it - 100));
+        add(t, it, it);
+    }
+    assert_eq(t.Count, 100);
+    assert_eq(t.Allocated, allocated);
+
+    For(range(9900, 10000)) assert_eq(*find(t, it).Value, it);
+    assert_false(has(t, 9899));
+
+    // Loops go through _Occupied_, which has to follow the entries moved back by removes
+    s64 loopIterations = 0, sum = 0;
+    for (auto [key, value] : t) {
+        assert_eq(*key, *value);
+        ++loopIterations, sum += *key;
+    }
+    assert_eq(loopIterations, 100);
+    assert_eq(sum, (s64) 100 * (9900 + 9999) / 2);
+}
+
+TEST(hash_scalar_keys) {
+    // 64 byte aligned pointers and sequential IDs should still land in different slots of a 2048 slot table
+    hash_set<u64> slotsPointers, slotsIds;
+    defer(free(slotsPointers));
+    defer(free(slotsIds));
+
+    For(range(1000)) {
+        set_add(slotsPointers, get_hash((void *) (0x10000 + it * 64)) & 2047);
+        set_add(slotsIds, get_hash(it) & 2047);
+    }
+    assert_gt(slotsPointers.Count, 500);
+    assert_gt(slotsIds.Count, 500);
+
+    // Keys which differ only in the high half spread over the low bits, the high bits spread too
+    // (swiss_table and concurrent_hash_table use them), and the two halves of a hash are independent
+    hash_set<u64> slotsHigh, topBits, halves;
+    defer(free(slotsHigh));
+    defer(free(topBits));
+    defer(free(halves));
+
+    For(range(1000)) {
+        u64 h = get_hash((u64) it);
+        set_add(slotsHigh, get_hash((u64) it << 32) & 2047);
+        set_add(topBits, h >> 53);
+        set_add(halves, (h >> 32) ^ (h & 0xFFFFFFFF));
+    }
+    assert_gt(slotsHigh.Count, 500);
+    assert_gt(topBits.Count, 500);
+    assert_gt(halves.Count, 500);
+}
+
+TEST(hash_table_find_batch) {
+    hash_table<s64, s64> t;
+    defer(free(t));
+
+    For(range(1000)) add(t, it * 3, it);
+
+    // Every third key is in the table
+    s64 keys[100];
+    key_value_pair<hash_table<s64, s64>> results[100];
+    For(range(100)) keys[it] = it;
+
+    find_batch(t, keys, 100, results);
+    For(range(100)) {
+        if (it % 3 == 0) {
+            assert((void *) results[it].Value);
+            assert_eq(*results[it].Value, it / 3);
+        } else {
+            assert(!results[it].Value);
+        }
+    }
+}
+
+TEST(hash_table_lookup_key) {
+    hash_table<string, s32> t;
+    defer(free(t));
+
+    add(t, string("alpha"), 1);
+    add(t, string("gamma"), 3);
+
+    // Literals and views of bytes are hashed and compared as they are
+    assert_eq(*find(t, "alpha").Value, 1);
+    assert_false(has(t, "beta"));
+
+    const utf8 *gamma = "gamma";
+    assert_eq(*find(t, bytes((byte *) gamma, 5)).Value, 3);
+    assert_true(has(t, array<utf8>((utf8 *) gamma, 5)));
+    assert_false(has(t, array<utf8>((utf8 *) gamma, 4)));
+
+    assert_true(remove(t, "alpha"));
+    assert_false(has(t, "alpha"));
+    assert_eq(t.Count, 1);
+}
+
+// Everything lands in 7 runs, so lookups have to compare the keys
+struct storage_mod_7_hash {
+    u64 operator()(s64 key) const { return (u64) key % 7; }
+};
+
+TEST(hash_table_custom_hash) {
+    hash_table<s64, s64, true, storage_mod_7_hash> t;
+    defer(free(t));
+
+    For(range(1000)) add(t, it, it);
+    For(range(0, 1000, 2)) assert_true(remove(t, it));
+    For(range(1000)) assert_eq(has(t, it), it % 2 == 1);
+
+    // The hash passed to the _prehashed functions comes from the policy
+    assert_eq(*find_prehashed(t, 3, 3).Value, 3);
+}
+
+// Against set() one pair at a time, keys repeat so the last value has to win
+TEST(hash_table_build) {
+    array<s64> keys, values;
+    defer(free(keys));
+    defer(free(values));
+
+    For(range(50000)) {
+        array_append(keys, (s64) (sort_random() % 20000));
+        array_append(values, it);
+    }
+
+    hash_table<s64, s64> expected, t;
+    defer(free(expected));
+    defer(free(t));
+
+    For(range(keys.Count)) set(expected, keys[it], values[it]);
+
+    hash_table_build(t, keys, values);
+    assert_eq(t.Count, expected.Count);
+    for (auto [k, v] : expected) assert_eq(*find(t, *k).Value, *v);
+
+    // Building again replaces everything and keeps the arrays
+    hash_table<s64, s64> few;
+    defer(free(few));
+    For(range(10)) set(few, keys[it], values[it]);
+
+    auto *hashes = t.Hashes;
+    hash_table_build(t, keys.Data, values.Data, 10);
+    assert_true(t.Hashes == hashes);
+    assert_eq(t.Count, few.Count);
+    for (auto [k, v] : few) assert_eq(*find(t, *k).Value, *v);
+    assert_false(has(t, keys[20]) && !has(few, keys[20]));
+
+    // Same table as adding them, so it keeps working normally afterwards
+    add(t, -1, 42);
+    assert_eq(*find(t, -1).Value, 42);
+
+    // Long runs which wrap around the end of the table
+    hash_table<s64, s64, true, storage_mod_7_hash> clustered;
+    defer(free(clustered));
+
+    hash_table_build(clustered, keys.Data, values.Data, 1000);
+    For(range(1000)) assert_true(has(clustered, keys[it]));
+}
+
+TEST(hash_set) {
+    hash_set<string> names;
+    defer(free(names));
+
+    assert_true(set_add(names, "apple"));
+    assert_true(set_add(names, "banana"));
+    assert_false(set_add(names, "apple"));
+    assert_eq(names.Count, 2);
+
+    assert_true(has(names, "banana"));
+    assert_false(has(names, "cherry"));
+
+    hash_set<s64> s;
+    defer(free(s));
+
+    // Grow past a few reserves
+    For(range(1000)) add(s, it);
+    assert_eq(s.Count, 1000);
+
+    For(range(0, 1000, 2)) assert_true(remove(s, it));
+    assert_false(remove(s, 0));
+    assert_eq(s.Count, 500);
+
+    For(range(1000)) assert_eq(has(s, it), it % 2 == 1);
+
+    s64 loopIterations = 0;
+    for (auto *key : s) {
+        assert_eq(*key % 2, 1);
+        ++loopIterations;
+    }
+    assert_eq(loopIterations, s.Count);
+}
+
+file_scope constexpr auto StaticCommands = make_static_hash_map<string, s32>({
+    {"help", 1},
+    {"quit", 2},
+    {"print", 3},
+    {"load", 4},
+    {"save", 5},
+    {"continue", 6},
+    {"a very long command name which goes through another path of the hasher", 7},
+});
+
+// Looked up at compile time, this also checks that the compile time and runtime hashes agree (below)
+static_assert(*find(StaticCommands, "quit") == 2);
+static_assert(!has(StaticCommands, "exit"));
+
+TEST(static_hash_map) {
+    string names[] = {"help", "quit", "print", "load", "save", "continue", "a very long command name which goes through another path of the hasher"};
+    For(range(7)) {
+        string name;
+        clone(&name, names[it]);  // Make sure we don't just compare pointers to the literals
+        defer(free(name));
+
+        auto *value = find(StaticCommands, name);
+        assert((void *) value);
+        assert_eq(*value, it + 1);
+    }
+    assert_false(has(StaticCommands, "hel"));
+    assert_false(has(StaticCommands, ""));
+}
+
+TEST(swiss_table) {
+    swiss_table<s64, s64> t;
+    defer(free(t));
+
+    // Enough to go through a few rehashes
+    For(range(1000)) add(t, it, it * 2);
+    assert_eq(t.Count, 1000);
+
+    For(range(1000)) {
+        auto *v = find(t, it).Value;
+        assert((void *) v);
+        assert_eq(*v, it * 2);
+    }
+    assert_false(has(t, 1000));
+
+    For(range(0, 1000, 2)) assert_true(remove(t, it));
+    assert_eq(t.Count, 500);
+
+    For(range(1000)) assert_eq(has(t, it), it % 2 == 1);
+
+    set(t, 1, 42);
+    assert_eq(*find(t, 1).Value, 42);
+    assert_eq(t.Count, 500);
+
+    s64 loopIterations = 0;
+    for (auto [key, value] : t) {
+        assert_eq(*key % 2, 1);
+        ++loopIterations;
+    }
+    assert_eq(loopIterations, t.Count);
+
+    // Keys added with a hash which isn't get_hash() of the key stay where find_prehashed() looks after the table grows
+    swiss_table<s64, s64> prehashed;
+    defer(free(prehashed));
+
+    auto custom_hash = [](s64 key) { return (u64) key * 0x9E3779B97F4A7C15ull + 1; };
+
+    add_prehashed(prehashed, custom_hash(0), 0, 0);
+    s64 allocated = prehashed.Allocated;
+
+    For(range(1, 1000)) set_prehashed(prehashed, custom_hash(it), it, it * 3);
+    assert_gt(prehashed.Allocated, allocated);
+
+    For(range(1000)) {
+        auto *v = find_prehashed(prehashed, custom_hash(it), it).Value;
+        assert((void *) v);
+        assert_eq(*v, it * 3);
+    }
+    assert_true(remove_prehashed(prehashed, custom_hash(500), 500));
+    assert_false(has_prehashed(prehashed, custom_hash(500), 500));
+}
+
+TEST(int_hash_table) {
+    int_hash_table<u64, s64> t;
+    defer(free(t));
+
+    // Enough to go through a few rehashes
+    For(range(1000)) add(t, (u64) it, it * 2);
+    assert_eq(t.Count, 1000);
+    For(range(1000)) assert_eq(*find(t, (u64) it).Value, it * 2);
+    assert_false(has(t, (u64) 1000));
+
+    // The key which marks empty slots is never found
+    assert_false(has(t, t.EMPTY));
+
+    For(range(0, 1000, 2)) assert_true(remove(t, (u64) it));
+    assert_eq(t.Count, 500);
+    For(range(1000)) assert_eq(has(t, (u64) it), it % 2 == 1);
+
+    set(t, 1, 42);
+    assert_eq(*find(t, 1).Value, 42);
+    assert_eq(t.Count, 500);
+
+    s64 loopIterations = 0;
+    for (auto [key, value] : t) {
+        assert_eq(*key % 2, 1);
+        ++loopIterations;
+    }
+    assert_eq(loopIterations, t.Count);
+
+    // Pointer keys use null for empty slots
+    int_hash_table<const s64 *, s64> pointers;
+    defer(free(pointers));
+
+    s64 values[100];
+    For(range(100)) add(pointers, values + it, it);
+    For(range(100)) assert_eq(*find(pointers, values + it).Value, it);
+    assert_false(has(pointers, (const s64 *) null));
+}
+
+TEST(incremental_hash_table) {
+    incremental_hash_table<s64, s64> t;
+    defer(free(t));
+
+    // Add until a growth is under way
+    s64 n = 0;
+    while (!t.Old.Allocated) {
+        add(t, n, n * 2);
+        ++n;
+    }
+    assert_false(t.Next.Allocated);
+
+    // Everything is found while the entries are moved, in whichever arrays they are
+    For(range(n)) assert_eq(*find(t, it).Value, it * 2);
+
+    // Remove and set keys in the new and in the old arrays
+    assert_true(remove(t, 0));
+    assert_true(remove(t, n - 1));
+    assert_false(remove(t, n - 1));
+    set(t, 1, 42);
+    set(t, n - 2, 43);
+    assert_eq(t.Count, n - 2);
+
+    s64 loopIterations = 0;
+    for (auto [key, value] : t) ++loopIterations;
+    assert_eq(loopIterations, t.Count);
+
+    while (!migrate(t)) {
+    }
+    assert_false(t.Old.Allocated);
+
+    assert_false(has(t, 0));
+    assert_false(has(t, n - 1));
+    assert_eq(*find(t, 1).Value, 42);
+    assert_eq(*find(t, n - 2).Value, 43);
+    For(range(2, n - 2)) assert_eq(*find(t, it).Value, it * 2);
+
+    // A few more growths
+    For(range(n, 10000)) add(t, it, it * 2);
+    assert_eq(t.Count, 10000 - 2);
+    For(range(1, 10000)) assert_eq(has(t, it), it != n - 1);
+}
+
+file_scope s64 CacheEvictedSum;
+file_scope void cache_test_evicted(s64 &key, s64 &value) { CacheEvictedSum += value; }
+
+TEST(lru_cache) {
+    lru_cache<s64, s64> c;
+    defer(free(c));
+
+    c.MaxCount = 3;
+    c.Evicted = &cache_test_evicted;
+    CacheEvictedSum = 0;
+
+    put(c, 1, 10);
+    put(c, 2, 20);
+    put(c, 3, 30);
+    assert_eq(*get(c, 1), 10);  // 2 is now the least recently used
+
+    put(c, 4, 40);
+    assert_false(has(c, 2));
+    assert_eq(CacheEvictedSum, 20);
+    assert_eq(c.Count, 3);
+
+    // Replacing evicts the old value and makes the key the most recently used
+    put(c, 3, 31);
+    assert_eq(CacheEvictedSum, 50);
+    put(c, 5, 50);
+    assert_false(has(c, 1));
+    assert_eq(*get(c, 3), 31);
+
+    s64 value;
+    assert_true(remove(c, 4, &value));
+    assert_eq(value, 40);
+    assert_false(remove(c, 4));
+    assert_eq(c.Count, 2);
+
+    // Byte budget, an entry bigger than all of it still goes in alone
+    reset(c);
+    c.MaxCount = 0;
+    c.MaxBytes = 100;
+    For(range(10)) put(c, it, it, 30);
+    assert_eq(c.Count, 3);
+    assert_eq(c.Bytes, 90);
+    For(range(7, 10)) assert_true(has(c, it));
+
+    put(c, 100, 100, 500);
+    assert_eq(c.Count, 1);
+    assert_eq(*get(c, 100), 100);
+}
+
+TEST(clock_cache) {
+    clock_cache<s64, s64> c;
+    defer(free(c));
+
+    c.MaxCount = 4;
+    For(range(4)) put(c, it, it * 10);
+
+    // Used entries get a second chance, the sweep takes the first one which wasn't
+    get(c, 0);
+    get(c, 2);
+    put(c, 4, 40);
+    assert_false(has(c, 1));
+    For(range(5)) assert_eq(has(c, it), it != 1);
+
+    put(c, 5, 50);
+    assert_false(has(c, 3));
+    assert_true(has(c, 2));
+    assert_eq(c.Count, 4);
+
+    // Byte budget
+    reset(c);
+    c.MaxCount = 0;
+    c.MaxBytes = 100;
+    For(range(100)) {
+        put(c, it, it, 1 + it % 10);
+        assert_true(c.Bytes <= 100);
+    }
+    assert_eq(*get(c, 99), 99);
+}
+
+file_scope sharded_cache<clock_cache<s64, s64>> ShardedCache;
+
+file_scope void sharded_cache_worker(void *userData) {
+    s64 first = (s64) userData * 100;
+    For(range(10000)) {
+        s64 key = first + it % 500, value;
+        if (get(ShardedCache, key, &value)) {
+            assert(value == key * 2);
+        } else {
+            put(ShardedCache, key, key * 2);
+        }
+    }
+}
+
+TEST(sharded_cache) {
+    ShardedCache.Alloc = internal::platform_get_persistent_allocator();
+    sharded_cache_set_limits(ShardedCache, 1024, 0);
+    defer(free(ShardedCache));
+
+    thread::thread threads[4];
+    For(range(4)) threads[it].init_and_launch(sharded_cache_worker, (void *) it);
+    For(threads) it.wait();
+
+    assert_true(count(ShardedCache) <= 1024);
+}
+
+struct intrusive_test_object {
+    s64 Id;
+    string Name;
+
+    list_link<intrusive_test_object> AllLink, OddLink;
+    slist_link<intrusive_test_object> StackLink;
+    hash_link<intrusive_test_object> ByIdLink, ByNameLink;
+};
+
+TEST(intrusive_list) {
+    intrusive_test_object objects[10];
+    For(range(10)) objects[it].Id = it;
+
+    intrusive_list<intrusive_test_object, &intrusive_test_object::AllLink> all;
+    intrusive_list<intrusive_test_object, &intrusive_test_object::OddLink> odd;
+    intrusive_slist<intrusive_test_object, &intrusive_test_object::StackLink> stack;
+
+    // The same objects in three lists
+    For(range(10)) {
+        push_back(all, objects + it);
+        if (it % 2) push_front(odd, objects + it);
+        push_front(stack, objects + it);
+    }
+    assert_eq(all.Count, 10);
+    assert_eq(odd.Count, 5);
+    assert_eq(stack.Count, 10);
+
+    s64 expected = 0;
+    for (auto *o : all) assert_eq(o->Id, expected++);
+
+    expected = 9;
+    for (auto *o : odd) {
+        assert_eq(o->Id, expected);
+        expected -= 2;
+    }
+
+    // Removing from one list leaves the others alone
+    remove(all, objects + 5);
+    remove(all, objects);
+    assert_eq(all.Count, 8);
+    assert_eq(all.Head, objects + 1);
+    assert_eq(odd.Count, 5);
+
+    assert_true(remove(stack, objects + 3));
+    assert_false(remove(stack, objects + 3));
+    assert_eq(pop_front(stack), objects + 9);
+    assert_eq(stack.Count, 8);
+
+    assert_eq(remove_if(all, [](intrusive_test_object *o) { return o->Id % 3 == 0; }), 2);
+    for (auto *o : all) assert_true(o->Id % 3 != 0);
+
+    insert_after(all, objects + 1, objects);
+    assert_eq(objects[1].AllLink.Next, objects);
+
+    assert_eq(pop_back(odd), objects + 1);
+    while (pop_front(odd)) {
+    }
+    assert_eq(odd.Count, 0);
+    assert_false(odd.Tail);
+}
+
+TEST(intrusive_hash_table) {
+    intrusive_test_object objects[1000];
+    For(range(1000)) {
+        objects[it].Id = it;
+        objects[it].Name = sprint("object {}", it);
+    }
+    defer(For(objects) free(it.Name));
+
+    intrusive_hash_table<intrusive_test_object, s64, &intrusive_test_object::Id, &intrusive_test_object::ByIdLink> byId;
+    intrusive_hash_table<intrusive_test_object, string, &intrusive_test_object::Name, &intrusive_test_object::ByNameLink> byName;
+    defer(free(byId));
+    defer(free(byName));
+
+    // Enough to grow a few times
+    For(objects) {
+        add(byId, &it);
+        add(byName, &it);
+    }
+    assert_eq(byId.Count, 1000);
+
+    For(range(1000)) assert_eq(find(byId, it), objects + it);
+    assert_eq(find(byName, "object 42"), objects + 42);
+    assert_false(has(byName, "object 1000"));
+
+    For(range(0, 1000, 2)) assert_true(remove(byId, objects + it));
+    assert_false(remove(byId, objects));
+    assert_eq(byId.Count, 500);
+    For(range(1000)) assert_eq(has(byId, it), it % 2 == 1);
+
+    // The other index still has everything
+    assert_eq(byName.Count, 1000);
+    assert_eq(find(byName, "object 0"), objects);
+
+    s64 loopIterations = 0;
+    for (auto *o : byId) {
+        assert_eq(o->Id % 2, 1);
+        ++loopIterations;
+    }
+    assert_eq(loopIterations, byId.Count);
+}
+
+file_scope concurrent_hash_table<s64, s64> ConcurrentTable;
+
+// Each thread adds its own range of keys and looks up everything that is already there
+file_scope void concurrent_hash_table_worker(void *userData) {
+    s64 first = (s64) userData * 1000;
+    For(range(first, first + 1000)) {
+        add(ConcurrentTable, it, it * 2);
+
+        s64 value;
+        assert(find(ConcurrentTable, it, &value));
+        assert(value == it * 2);
+    }
+}
+
+TEST(concurrent_hash_table) {
+    ConcurrentTable.Alloc = internal::platform_get_persistent_allocator();
+    defer(free(ConcurrentTable));
+
+    thread::thread threads[4];
+    For(range(4)) threads[it].init_and_launch(concurrent_hash_table_worker, (void *) it);
+    For(threads) it.wait();
+
+    assert_eq(count(ConcurrentTable), 4000);
+
+    For(range(4000)) {
+        s64 value = -1;
+        assert_true(find(ConcurrentTable, it, &value));
+        assert_eq(value, it * 2);
+    }
+
+    assert_true(set(ConcurrentTable, 1, 42));
+    assert_false(set(ConcurrentTable, 4000, 1));
+    assert_false(add_if_missing(ConcurrentTable, 1, 0));
+
+    For(range(0, 4001, 2)) assert_true(remove(ConcurrentTable, it));
+    assert_eq(count(ConcurrentTable), 2000);
+    assert_false(has(ConcurrentTable, 2));
+    assert_true(has(ConcurrentTable, 3));
+}
+
+TEST(slot_map) {
+    slot_map<s64> map;
+    defer(free(map));
+
+    assert_false(has(map, slot_map_handle{}));
+
+    slot_map_handle handles[10];
+    For(range(10)) handles[it] = add(map, it * 10);
+    assert_eq(count(map), 10);
+
+    For(range(10)) assert_eq(*find(map, handles[it]), it * 10);
+
+    assert_true(remove(map, handles[3]));
+    assert_false(remove(map, handles[3]));
+    assert_false(has(map, handles[3]));
+    assert_eq(count(map), 9);
+
+    // The last element was moved into the gap, its handle still works
+    assert_eq(*find(map, handles[9]), 90);
+
+    // Reuses the slot, but the old handle stays stale
+    auto reused = add(map, 333);
+    assert_eq(reused.Index, handles[3].Index);
+    assert_false(has(map, handles[3]));
+    assert_eq(*find(map, reused), 333);
+
+    s64 sum = 0;
+    For(map) sum += it;
+    assert_eq(sum, 450 - 30 + 333);
+
+    For(range(map.Data.Count)) assert_eq(*find(map, get_handle(map, it)), map.Data[it]);
+
+    reset(map);
+    assert_eq(count(map), 0);
+    assert_false(has(map, reused));
+    assert_false(has(map, handles[0]));
+}
+
+struct soa_particle {
+    f32 X, Y, Z;
+    u8 Flags;
+    f64 Life;
+};
+
+static_assert(types::field_count<soa_particle> == 5);
+static_assert(types::is_same<types::field_t<soa_particle, 3>, u8>);
+static_assert(types::field_index<&soa_particle::Life> == 4);
+
+TEST(soa_array) {
+    soa_array<soa_particle> particles;
+    defer(free(particles));
+
+    For(range(100)) add(particles, {(f32) it, (f32) it * 2, 0, (u8) (it % 3), 1.0});
+    assert_eq(count(particles), 100);
+
+    // Every field is its own aligned stream
+    auto xs = soa_field<&soa_particle::X>(particles);
+    auto life = soa_field<4>(particles);
+    assert_eq(xs.Count, 100);
+    assert_eq((u64) xs.Data % SOA_ARRAY_ALIGNMENT, 0);
+    assert_eq((u64) life.Data % SOA_ARRAY_ALIGNMENT, 0);
+    For(range(100)) assert_eq(xs[it], (f32) it);
+
+    For(life) it -= 0.25;
+    For(particles) it.field<&soa_particle::Z>() = it.field<&soa_particle::X>() + it.field<1>();
+
+    soa_particle p = particles[10];
+    assert_eq(p.Z, 30.0f);
+    assert_eq(p.Flags, 1);
+    assert_eq(p.Life, 0.75);
+
+    p.Flags = 7;
+    particles[10] = p;
+    assert_eq(soa_field<&soa_particle::Flags>(particles)[10], 7);
+
+    // The last element moves into the gap
+    remove_unordered(particles, 10);
+    assert_eq(count(particles), 99);
+    assert_eq(get(particles, 10).X, 99.0f);
+
+    soa_array<soa_particle> copy;
+    defer(free(copy));
+    clone(&copy, particles);
+    assert_eq(count(copy), 99);
+    For(range(99)) {
+        assert_eq(get(copy, it).Z, get(particles, it).Z);
+        assert_eq(get(copy, it).Flags, get(particles, it).Flags);
+    }
+
+    reset(particles);
+    assert_eq(count(particles), 0);
+}
+
+TEST(bucket_array) {
+    bucket_array<s64, 100> arr;
+    defer(free(arr));
+
+    For(range(250)) {
+        s64 index;
+        add(arr, it, {}, &index);
+        assert_eq(index, it);
+    }
+    assert_eq(arr.Count, 250);
+    assert_eq(bucket_count(arr), 3);
+
+    For(range(250)) assert_eq(*get(arr, it), it);
+    assert_false(get(arr, 250));
+
+    auto *p = get(arr, 150);
+    assert_true(remove(arr, 50));
+    assert_true(remove(arr, 120));
+    assert_false(remove(arr, 120));
+    assert_false(get(arr, 50));
+    assert_eq(p, get(arr, 150));  // Elements don't move
+    assert_eq(index_of(arr, p), 150);
+
+    s64 sum = 0;
+    For(arr) sum += it;
+    assert_eq(sum, 249 * 250 / 2 - 50 - 120);
+
+    // Free slots get reused before we allocate a new bucket
+    s64 index;
+    add(arr, -1, {}, &index);
+    assert_eq(index, 50);
+    add(arr, -2, {}, &index);
+    assert_eq(index, 120);
+    add(arr, -3, {}, &index);
+    assert_eq(index, 250);
+    assert_eq(bucket_count(arr), 3);
+
+    // Ranges of buckets together go through every element exactly once
+    s64 seen = 0;
+    for (auto &it : get_range(arr, 0, 1)) ++seen;
+    for (auto &it : get_range(arr, 1, 3)) ++seen;
+    assert_eq(seen, arr.Count);
+
+    auto *found = find(arr, [](s64 *x) { return *x == -2; });
+    assert_eq(index_of(arr, found), 120);
+}
+
+TEST(small_array) {
+    small_array<s64, 4> arr;
+    defer(free(arr));
+
+    For(range(4)) array_append(arr, it);
+    assert_true(array_is_inline(arr));
+    assert_eq(arr.Count, 4);
+
+    // Copies of an inline array get their own storage
+    auto copy = arr;
+    copy[0] = 42;
+    assert_eq(arr[0], 0);
+    assert_true(array_is_inline(copy));
+
+    array_append(arr, 4);
+    assert_false(array_is_inline(arr));
+    For(range(5)) assert_eq(arr[it], it);
+
+    array_insert_at(arr, 0, -1);
+    array_remove_at(arr, 1);
+    array_remove_unordered(arr, 1);
+    assert_eq(arr.Count, 4);
+    assert_eq(arr[0], -1);
+    assert_eq(arr[1], 4);
+
+    free(arr);
+    assert_true(array_is_inline(arr));
+    assert_eq(arr.Count, 0);
+
+    array_append(arr, 7);
+    assert_true(array_is_inline(arr));
+    assert_eq(arr[0], 7);
+}
+
+TEST(array_growth) {
+    assert_eq(array_grow_target(0, 5, sizeof(s64), array_growth::DOUBLE), 8);
+    assert_eq(array_grow_target(8, 9, sizeof(s64), array_growth::DOUBLE), 16);
+    assert_eq(array_grow_target(100, 101, sizeof(s64), array_growth::ONE_AND_HALF), 150);
+    assert_eq(array_grow_target(100, 101, sizeof(s64), array_growth::EXACT), 101);
+
+    // Large buffers grow by 1.5x in whole pages
+    s64 large = array_grow_target(1_MiB, 1_MiB + 1, 1, array_growth::DEFAULT);
+    assert_true(large >= 1_MiB + 512_KiB);
+    assert_eq(large % ARRAY_PAGE_SIZE, 0);
+
+    array<s64> a;
+    defer(free(a));
+
+    array_reserve_exact(a, 100);
+    assert_eq(a.Allocated, 100);
+
+    auto *data = a.Data;
+    For(range(100)) array_append(a, it);
+    assert_eq(a.Data, data);  // Filling up to the exact size doesn't reallocate
+    assert_eq(a.Allocated, 100);
+
+    array_append(a, 100);
+    assert_gt(a.Allocated, 100);
+    For(range(101)) assert_eq(a[it], it);
+}
+
+TEST(array_bulk) {
+    array<s64> a;
+    defer(free(a));
+
+    auto *p = array_append_uninitialized(a, 5);
+    For(range(5)) p[it] = it;
+    assert_eq(a, to_stack_array<s64>(0, 1, 2, 3, 4));
+
+    p = array_insert_uninitialized(a, 2, 2);
+    p[0] = 10, p[1] = 11;
+    assert_eq(a, to_stack_array<s64>(0, 1, 10, 11, 2, 3, 4));
+
+    array_remove_range(a, 2, 4);
+    assert_eq(a, to_stack_array<s64>(0, 1, 2, 3, 4));
+
+    // Growing, shrinking and same size replacements
+    array_replace_all(a, 1, to_stack_array<s64>(7, 7, 7));
+    assert_eq(a, to_stack_array<s64>(0, 7, 7, 7, 2, 3, 4));
+
+    array_replace_all(a, to_stack_array<s64>(7, 7), to_stack_array<s64>(8));
+    assert_eq(a, to_stack_array<s64>(0, 8, 7, 2, 3, 4));
+
+    array_replace_all(a, 8, 9);
+    assert_eq(a, to_stack_array<s64>(0, 9, 7, 2, 3, 4));
+
+    array_remove_all(a, 9);
+    assert_eq(a, to_stack_array<s64>(0, 7, 2, 3, 4));
+}
+
+TEST(bound_allocator) {
+    // Containers grow with the allocator they were first reserved with, whatever the Context says later
+    array<s64> a;
+    array_reserve(a, 4, array_growth::DEFAULT, Context.TempAlloc);
+    For(range(100)) array_append(a, it);
+    assert_true(allocation_get_allocator(a.Data) == Context.TempAlloc);
+
+    hash_table<s64, s64> t;
+    reserve(t, 4, 0, Context.TempAlloc);
+    For(range(40)) add(t, it, it);
+    assert_true(allocation_get_allocator(t.Hashes) == Context.TempAlloc);
+    assert_eq(*find(t, 20).Value, 20);
+
+    // Only the pushed variable is saved and restored
+    auto oldAlloc = Context.Alloc;
+    auto oldAlignment = Context.AllocAlignment;
+    PUSH_ALLOC(Context.TempAlloc) {
+        assert_true(Context.Alloc == Context.TempAlloc);
+        PUSH_CONTEXT_VAR(AllocAlignment, 16) { assert_eq(Context.AllocAlignment, 16); }
+        assert_eq(Context.AllocAlignment, oldAlignment);
+    }
+    assert_true(Context.Alloc == oldAlloc);
+}
+
+TEST(allocate_construct) {
+    static_assert(no_init_constructible<s64>);
+    static_assert(no_init_constructible<v4>);
+    static_assert(zero_constructible<string>);
+    static_assert(!no_init_constructible<hash_table<s64, s64>>);
+
+    // Zero constructible elements come out of one zero_memory()
+    auto *strings = allocate_array<string>(8, {.Alloc = Context.TempAlloc});
+    For(range(8)) {
+        assert_eq(strings[it].Data, (utf8 *) null);
+        assert_eq(strings[it].Count, 0);
+        assert_eq(strings[it].Length, 0);
+    }
+
+    // The tail is constructed when growing
+    strings = reallocate_array(strings, 16);
+    For(range(8, 16)) assert_eq(strings[it].Count, 0);
+
+    auto *values = allocate_array_uninitialized<s64>(64, {.Alloc = Context.TempAlloc});
+    For(range(64)) values[it] = it;
+    assert_eq(values[63], 63);
+}
+
+TEST(guard_page_allocator) {
+    // 1000 u64s are a multiple of the alignment, so the last one ends as close to the guard page as we can get
+    auto *values = allocate_array<s64>(1000, {.Alloc = guard_page_allocator, .Alignment = 16});
+    For(range(1000)) values[it] = it;
+
+    s64 tail = 0;
+#if defined DEBUG_MEMORY
+    tail = 16;  // No man's land, rounded up to the alignment
+#endif
+    assert_eq(((u64) (values + 1000) + tail) % os_get_page_size(), 0);
+
+    // Reallocating always moves the block to new pages with its own guard page
+    values = reallocate_array(values, 1500);
+    For(range(1000)) assert_eq(values[it], it);
+    assert_eq(((u64) (values + 1500) + tail) % os_get_page_size(), 0);
+
+    free(values);
+
+#if defined DEBUG_MEMORY
+    auto *skipped = allocate_array<byte>(64, {.Alloc = Context.TempAlloc, .Options = DEBUG_NO_FILL});
+    assert_true(((allocation_header *) skipped - 1)->DEBUG_NoFill);
+
+    auto *filled = allocate_array<byte>(64, {.Alloc = Context.TempAlloc});
+    assert_false(((allocation_header *) filled - 1)->DEBUG_NoFill);
+    For(range(64)) assert_eq(filled[it], CLEAN_LAND_FILL);
+
+    // Above the threshold nothing is filled
+    DEBUG_memory->FillMaxSize = 32;
+    defer(DEBUG_memory->FillMaxSize = -1);
+
+    auto *big = allocate_array<byte>(64, {.Alloc = Context.TempAlloc});
+    assert_true(((allocation_header *) big - 1)->DEBUG_NoFill);
+#endif
+}
+
+TEST(memory_tags) {
+    u8 tag = memory_tag_get("test_memory_tags");
+    assert_eq(memory_tag_get("test_memory_tags"), tag);
+    assert_eq(memory_tag_get("untagged"), 0);
+
+    auto before = memory_tag_get_stats(tag);
+
+    s64 *values;
+    MEMORY_TAG("test_memory_tags") {
+        assert_eq(Context.MemoryTag, tag);
+        values = allocate_array<s64>(10);
+    }
+    assert_eq(Context.MemoryTag, 0);
+    assert_eq(allocation_get_tag(values), tag);
+
+    auto stats = memory_tag_get_stats(tag);
+    assert_eq(stats.CurrentBytes - before.CurrentBytes, 80);
+    assert_eq(stats.AllocationCount - before.AllocationCount, 1);
+
+    // Growing outside of the scope still counts against the tag of the allocation
+    values = reallocate_array(values, 20);
+    assert_eq(allocation_get_tag(values), tag);
+    assert_eq(memory_tag_get_stats(tag).CurrentBytes - before.CurrentBytes, 160);
+
+    free(values);
+    stats = memory_tag_get_stats(tag);
+    assert_eq(stats.CurrentBytes, before.CurrentBytes);
+    assert_eq(stats.FreeCount - before.FreeCount, 1);
+}
+
+TEST(allocator_registry) {
+    // More short-lived arenas (each at its own address) than the registry has slots, each gives its slot back
+    auto *arenas = allocate_array<arena_allocator_data>(ALLOCATOR_REGISTRY_SIZE + 100, {.Alloc = Context.TempAlloc});
+
+    byte pool[256];
+
+    s64 firstIndex = -1;
+    For(range(ALLOCATOR_REGISTRY_SIZE + 100)) {
+        allocator arena = {arena_allocator, arenas + it};
+        allocator_add_pool(arena, pool, sizeof(pool));
+
+        s64 index = allocator_registry_find_or_add(arena);
+        assert_nq(index, -1);
+        if (it == 0) firstIndex = index;
+
+        auto *values = allocate_array<s64>(4, {.Alloc = arena});
+        assert_true(allocation_get_allocator(values) == arena);
+#if !defined FORCE_NO_ALLOCATOR_STATS
+        // Not the stats of the arena which had the slot before
+        if (index < ALLOCATOR_STATS_COUNT) assert_eq(allocator_get_stats(arena).AllocationCount, 1);
+#endif
+
+        free_all(arena);
+        allocator_registry_remove(arena);
+        allocator_remove_pool(arena, pool);
+    }
+
+    // Nothing else registers while the test runs, so the slot of the first one was reused every time
+    allocator last = {arena_allocator, arenas + ALLOCATOR_REGISTRY_SIZE + 99};
+    assert_eq(allocator_registry_find_or_add(last), firstIndex);
+    allocator_registry_remove(last);
+}
+
+TEST(slab_allocator) {
+    slab_allocator_data data;
+    data.SlabSize = 2 * SLAB_MAX_BLOCK_SIZE;
+
+    // Room for exactly one slab per size class
+    s64 poolSize = sizeof(allocator_pool) + SLAB_SIZE_CLASS_COUNT * data.SlabSize;
+    void *pool = os_allocate_block(poolSize);
+    defer(os_free_block(pool));
+
+    allocator slab = {slab_allocator, &data};
+    allocator_add_pool(slab, pool, poolSize);
+
+    // Two blocks of a class are next to each other in its slab. The second one asks for the smallest size which still goes to the class.
+    s64 classes[SLAB_SIZE_CLASS_COUNT] = {16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+
+    byte *first[SLAB_SIZE_CLASS_COUNT];
+    For(range(SLAB_SIZE_CLASS_COUNT)) {
+        s64 smallest = it ? classes[it - 1] + 1 : 1;
+
+        first[it] = (byte *) slab_allocator(allocator_mode::ALLOCATE, &data, classes[it], null, 0, 0);
+        auto *second = (byte *) slab_allocator(allocator_mode::ALLOCATE, &data, smallest, null, 0, 0);
+        assert_true(first[it] != null);
+        assert_eq(second - first[it], classes[it]);
+    }
+
+    // Every class has taken its slab, so one which filled it has nowhere to go, the others still have room
+    assert_true(slab_allocator(allocator_mode::ALLOCATE, &data, 4096, null, 0, 0) == null);
+    assert_true(slab_allocator(allocator_mode::ALLOCATE, &data, 16, null, 0, 0) != null);
+    assert_true(slab_allocator(allocator_mode::ALLOCATE, &data, SLAB_MAX_BLOCK_SIZE + 1, null, 0, 0) == null);
+
+    // A freed block comes out first for any size in its class, resizing stays in place only inside the class
+    slab_allocator(allocator_mode::FREE, &data, 0, first[3], 48, 0);
+    assert_true(slab_allocator(allocator_mode::ALLOCATE, &data, 40, null, 0, 0) == first[3]);
+    assert_true(slab_allocator(allocator_mode::RESIZE, &data, 33, first[3], 40, 0) == first[3]);
+    assert_true(slab_allocator(allocator_mode::RESIZE, &data, 49, first[3], 40, 0) == null);
+
+    // Through general_allocate(), which adds the header and the alignment padding to the size
+    free_all(slab);
+
+    auto *values = allocate_array<s64>(20, {.Alloc = slab, .Alignment = 64});
+    assert_eq((u64) values % 64, 0);
+    For(range(20)) values[it] = it;
+
+    values = reallocate_array(values, 22);  // Same class
+    For(range(20)) assert_eq(values[it], it);
+    free(values);
+
+    auto *again = allocate_array<s64>(22, {.Alloc = slab, .Alignment = 64});
+    assert_true(again == values);
+    free(again);
+
+    free_all(slab);
+    allocator_registry_remove(slab);
+    allocator_remove_pool(slab, pool);
+}
+
+file_scope s64 PersistentCacheMismatches;
+
+// Allocates and frees more small blocks of each size class than a thread's cache holds, so it refills from the heap
+// and gives batches back. Whatever is left in the cache is flushed when the thread exits.
+file_scope void persistent_cache_worker(void *userData) {
+    s64 seed = (s64) userData;
+    auto alloc = internal::platform_get_persistent_allocator();
+
+    s64 *blocks[200];
+    For_as(pass, range(10)) {
+        For(range(200)) {
+            s64 count = 1 + (it * 7 + seed) % 100;
+            blocks[it] = allocate_array<s64>(count, {.Alloc = alloc});
+            For_as(j, range(count)) blocks[it][j] = seed + it + j;
+        }
+
+        For(range(200)) {
+            s64 count = 1 + (it * 7 + seed) % 100;
+            For_as(j, range(count)) if (blocks[it][j] != seed + it + j) atomic_inc(&PersistentCacheMismatches);
+            free(blocks[it]);
+        }
+    }
+}
+
+TEST(persistent_allocator_cache) {
+#if OS == WINDOWS
+    // A freed small block goes to the cache of the thread and is the first one handed out again for its size class
+    auto alloc = internal::platform_get_persistent_allocator();
+
+    auto *a = allocate_array<byte>(40, {.Alloc = alloc});
+    free(a);
+
+    auto *b = allocate_array<byte>(40, {.Alloc = alloc});
+    assert_true(a == b);
+    free(b);
+#endif
+
+    // Twice, the second round of threads picks up the caches which the first one flushed and left behind
+    For(range(2)) {
+        PersistentCacheMismatches = 0;
+
+        thread::thread threads[4];
+        For_as(t, range(4)) threads[t].init_and_launch(persistent_cache_worker, (void *) t);
+        For_as(t, threads) t.wait();
+
+        assert_eq(PersistentCacheMismatches, 0);
+    }
+}
+
+TEST(allocation_headers) {
+    arena_allocator_data data;
+    allocator arena = {arena_allocator, &data};
+
+    s64 poolSize = 256_KiB;
+    void *pool = os_allocate_block(poolSize);
+    defer(os_free_block(pool));
+    allocator_add_pool(arena, pool, poolSize);
+
+    s64 index = allocator_registry_find_or_add(arena);
+    assert_nq(index, -1);
+
+    // Larger than what fits in the size of a small header (ALLOCATION_SMALL_MAX_SIZE without DEBUG_MEMORY)
+    constexpr s64 LARGE = 70000;
+
+    auto *small = allocate_array<byte>(100, {.Alloc = arena, .Alignment = 32});
+    auto *large = allocate_array<byte>(LARGE, {.Alloc = arena, .Alignment = 32});
+#if !defined DEBUG_MEMORY
+    assert_true(allocation_is_small(small));
+    assert_false(allocation_is_small(large));
+#endif
+
+    // Both kinds read back the same
+    assert_eq(allocation_get_size(small), 100);
+    assert_eq(allocation_get_size(large), LARGE);
+    assert_eq(allocation_get_alignment(small), 32u);
+    assert_eq(allocation_get_alignment(large), 32u);
+    assert_eq((u64) small % 32, 0);
+    assert_eq((u64) large % 32, 0);
+    assert_true(allocation_get_allocator(small) == arena);
+    assert_true(allocation_get_allocator(large) == arena);
+
+    // Freeing works out the size of the block from the header it finds. The arena takes the last block back only when
+    // that size is right, so if it reads the wrong kind, the space isn't reclaimed.
+    free(large);
+    free(small);
+    assert_eq(data.TotalUsed, 0);
+
+    // Growing past what a small header can hold moves the allocation to a full header
+    small = allocate_array<byte>(100, {.Alloc = arena});
+    For(range(100)) small[it] = (byte) it;
+
+    auto *grown = reallocate_array(small, LARGE);
+#if !defined DEBUG_MEMORY
+    assert_false(allocation_is_small(grown));
+    assert_true(grown != small);
+#endif
+    assert_eq(allocation_get_size(grown), LARGE);
+    For(range(100)) assert_eq(grown[it], (byte) it);
+    free(grown);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    // Full headers keep the registry index too, so a large block is counted against its allocator when it's freed
+    if (index < ALLOCATOR_STATS_COUNT) {
+        allocator_reset_stats(arena);
+
+        auto *big = allocate_array<byte>(LARGE, {.Alloc = arena});
+        assert_eq(allocator_get_stats(arena).CurrentBytes, LARGE);
+        free(big);
+
+        auto stats = allocator_get_stats(arena);
+        assert_eq(stats.CurrentBytes, 0);
+        assert_eq(stats.AllocationCount, 1);
+        assert_eq(stats.FreeCount, 1);
+    }
+#endif
+
+    free_all(arena);
+    allocator_registry_remove(arena);
+    allocator_remove_pool(arena, pool);
+}
+
+TEST(arena_mark_rewind) {
+    arena_allocator_data data;
+    allocator arena = {arena_allocator, &data};
+
+    byte pool[4096];
+    allocator_add_pool(arena, pool, sizeof(pool));
+
+    auto *first = allocate_array<s64>(4, {.Alloc = arena});
+    s64 used = data.TotalUsed;
+
+    auto mark = arena_mark(arena);
+    {
+        auto *scratch = allocate_array<s64>(16, {.Alloc = arena});
+        For(range(16)) scratch[it] = it;
+        assert_gt(data.TotalUsed, used);
+
+        // Nested
+        auto inner = arena_mark(arena);
+        s64 innerUsed = data.TotalUsed;
+        allocate_array<s64>(32, {.Alloc = arena});
+        arena_rewind(arena, inner);
+        assert_eq(data.TotalUsed, innerUsed);
+        For(range(16)) assert_eq(scratch[it], it);
+    }
+    arena_rewind(arena, mark);
+    assert_eq(data.TotalUsed, used);
+
+    // Rewinding to a mark of an empty arena frees everything
+    auto empty = arena_marker{};
+    allocate_array<s64>(8, {.Alloc = arena});
+    arena_rewind(arena, empty);
+    assert_eq(data.TotalUsed, 0);
+
+    // The last block grows and shrinks in place, others get moved
+    first = allocate_array<s64>(4, {.Alloc = arena});
+    For(range(4)) first[it] = it;
+
+    auto *grown = reallocate_array(first, 64);
+    assert_true(grown == first);
+
+    auto *second = allocate_array<s64>(4, {.Alloc = arena});
+    s64 secondUsed = data.TotalUsed;
+
+    auto *moved = reallocate_array(grown, 128);
+    assert_true(moved != grown);
+    For(range(4)) assert_eq(moved[it], it);
+
+    // Freeing the last block gives its space back, freeing one before it doesn't do anything
+    s64 beforeFree = data.TotalUsed;
+    free(second);
+    assert_eq(data.TotalUsed, beforeFree);
+    free(moved);
+    assert_eq(data.TotalUsed, secondUsed);
+
+    free_all(arena);
+    assert_eq(data.TotalUsed, 0);
+
+    // A block can be resized to fill the pool exactly
+    auto *block = (byte *) arena_allocator(allocator_mode::ALLOCATE, &data, 100, null, 0, 0);
+    s64 rest = data.Base->Size;
+    assert_true(arena_allocator(allocator_mode::RESIZE, &data, rest + 1, block, 100, 0) == null);
+    assert_true(arena_allocator(allocator_mode::RESIZE, &data, rest, block, 100, 0) == block);
+    assert_eq(data.TotalUsed, rest);
+
+    free_all(arena);
+    allocator_registry_remove(arena);
+    allocator_remove_pool(arena, pool);
+}
+
+TEST(virtual_arena) {
+    virtual_arena_allocator_data data;
+    allocator arena = {virtual_arena_allocator, &data};
+
+    virtual_arena_reserve(&data, 1_MiB);
+    assert_true(data.Base != null);
+    assert_ge(data.Reserved, 1_MiB);
+    assert_eq(data.Committed, 0);
+
+    // Pages are committed as they're needed, a granule at a time
+    auto *small = allocate_array<byte>(100, {.Alloc = arena});
+    assert_eq(data.Committed, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+
+    auto *big = allocate_array<byte>(200_KiB, {.Alloc = arena});
+    assert_ge(data.Committed, data.Used);
+    assert_lt(data.Committed, data.Used + VIRTUAL_ARENA_COMMIT_GRANULARITY);
+    assert_eq(data.Committed % VIRTUAL_ARENA_COMMIT_GRANULARITY, 0);
+
+    // All of it is usable
+    fill_memory(small, 1, 100);
+    fill_memory(big, 2, 200_KiB);
+    assert_eq(big[200_KiB - 1], 2);
+
+    // The last block grows in place (committing more) and gives its space back when freed
+    auto *grown = reallocate_array(big, 400_KiB);
+    assert_true(grown == big);
+    assert_ge(data.Committed, data.Used);
+    fill_memory(grown, 3, 400_KiB);
+
+    s64 committed = data.Committed;
+    s64 used = data.Used;
+    free(grown);
+    assert_le(data.Used, used - 400_KiB);
+
+    // Freeing doesn't decommit, decommitting keeps what's in use
+    assert_eq(data.Committed, committed);
+    virtual_arena_decommit(&data);
+    assert_eq(data.Committed, VIRTUAL_ARENA_COMMIT_GRANULARITY);
+    assert_eq(small[99], 1);
+
+    // Past the end of the reservation
+    assert_true(virtual_arena_allocator(allocator_mode::ALLOCATE, &data, data.Reserved, null, 0, 0) == null);
+
+    free_all(arena);
+    assert_eq(data.Used, 0);
+
+    virtual_arena_release(&data);
+    assert_true(data.Base == null);
+    assert_eq(data.Committed, 0);
+}
+
+#if defined DEBUG_MEMORY
+file_scope arena_allocator_data DebugMemoryArenas[4];
+file_scope void *DebugMemoryBlocks[4][64];
+
+// Counts the live headers of allocations made with _alloc_ and in how many shards they are
+file_scope s64 debug_memory_count_headers(allocator alloc, s64 *shardsUsed = null) {
+    s64 count = 0, shards = 0;
+    For_as(i, range(DEBUG_MEMORY_SHARD_COUNT)) {
+        auto *shard = &DEBUG_memory->Shards[i];
+        thread::scoped_lock<thread::mutex> _(&shard->Mutex);
+
+        s64 inShard = 0;
+        for (auto *h = shard->Head; h; h = h->DEBUG_Next) {
+            if (h->Alloc == alloc) ++inShard;
+        }
+        count += inShard;
+        if (inShard) ++shards;
+    }
+    if (shardsUsed) *shardsUsed = shards;
+    return count;
+}
+
+// Every thread allocates from an arena of its own, the headers all go to the same shards
+file_scope void debug_memory_worker(void *userData) {
+    s64 index = (s64) userData;
+    allocator arena = {arena_allocator, DebugMemoryArenas + index};
+
+    For(range(64)) DebugMemoryBlocks[index][it] = allocate_array<byte>(32, {.Alloc = arena});
+}
+#endif
+
+TEST(debug_memory) {
+#if defined DEBUG_MEMORY
+    For(range(4)) allocator_add_pool({arena_allocator, DebugMemoryArenas + it}, os_allocate_block(32_KiB), 32_KiB);
+
+    thread::thread threads[4];
+    For(range(4)) threads[it].init_and_launch(debug_memory_worker, (void *) it);
+    For(threads) it.wait();
+
+    // Every header got linked and they are spread over the shards
+    For(range(4)) {
+        s64 shards = 0;
+        assert_eq(debug_memory_count_headers({arena_allocator, DebugMemoryArenas + it}, &shards), 64);
+        assert_gt(shards, 1);
+    }
+    DEBUG_memory->verify_heap();
+
+    // Unlinked when freed (on another thread than the one which allocated them)
+    For_as(t, range(4)) {
+        For(range(0, 64, 2)) free(DebugMemoryBlocks[t][it]);
+        assert_eq(debug_memory_count_headers({arena_allocator, DebugMemoryArenas + t}), 32);
+    }
+
+    // Rewinding an arena unlinks the headers in the range it released, free_all unlinks the ones of the allocator
+    allocator first = {arena_allocator, DebugMemoryArenas};
+    auto mark = arena_mark(first);
+    For(range(8)) allocate_array<byte>(32, {.Alloc = first});
+    assert_eq(debug_memory_count_headers(first), 40);
+    arena_rewind(first, mark);
+    assert_eq(debug_memory_count_headers(first), 32);
+
+    free_all(first);
+    assert_eq(debug_memory_count_headers(first), 0);
+
+    // A leak shows up in the report, an allocation marked with LEAK doesn't
+    auto *leak = allocate_array<byte>(12345, {.Alloc = Context.TempAlloc});
+    auto *marked = allocate_array<byte>(12346, {.Alloc = Context.TempAlloc, .Options = LEAK});
+
+    string_builder_writer report;
+    defer(free(report));
+    PUSH_CONTEXT_VAR(FmtDisableAnsiCodes, true) {
+        PUSH_CONTEXT_VAR(Log, &report) { DEBUG_memory->report_leaks(); }
+    }
+
+    string text = string_builder_combine(report.Builder);
+    defer(free(text));
+    assert_nq(find_substring(text, "requested 12345 bytes"), -1);
+    assert_eq(find_substring(text, "requested 12346 bytes"), -1);
+
+    free(marked);
+    free(leak);
+
+    For(range(4)) {
+        allocator arena = {arena_allocator, DebugMemoryArenas + it};
+        free_all(arena);
+        allocator_registry_remove(arena);
+
+        void *pool = DebugMemoryArenas[it].Base;
+        allocator_remove_pool(arena, pool);
+        os_free_block(pool);
+    }
+#endif
+}
+
+TEST(allocator_stats) {
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    arena_allocator_data data;
+    allocator arena = {arena_allocator, &data};
+
+    byte pool[4096];
+    allocator_add_pool(arena, pool, sizeof(pool));
+
+    s64 index = allocator_registry_find_or_add(arena);
+    assert_lt(index, ALLOCATOR_STATS_COUNT);
+
+    auto *a = allocate_array<byte>(100, {.Alloc = arena});
+    auto *b = allocate_array<byte>(1000, {.Alloc = arena});
+    auto *c = allocate_array<byte>(1, {.Alloc = arena});
+
+    auto stats = allocator_get_stats(arena);
+    assert_eq(stats.AllocationCount, 3);
+    assert_eq(stats.CurrentBytes, 1101);
+    assert_eq(stats.PeakBytes, 1101);
+
+    // Bucket i counts sizes in [2^i, 2^(i + 1))
+    assert_eq(stats.SizeHistogram[0], 1);
+    assert_eq(stats.SizeHistogram[6], 1);
+    assert_eq(stats.SizeHistogram[9], 1);
+
+    // Reallocating changes the bytes but not the histogram
+    c = reallocate_array(c, 50);
+    free(a);
+
+    stats = allocator_get_stats(arena);
+    assert_eq(stats.ReallocationCount, 1);
+    assert_eq(stats.FreeCount, 1);
+    assert_eq(stats.CurrentBytes, 1050);
+    assert_eq(stats.PeakBytes, 1150);
+    assert_eq(stats.SizeHistogram[5], 0);
+
+    // Another allocator doesn't touch these
+    allocate_array<byte>(64, {.Alloc = Context.TempAlloc});
+    assert_eq(allocator_get_stats(arena).AllocationCount, 3);
+
+    // free_all() can't know what was freed, so only the current bytes go to 0
+    free_all(arena);
+    stats = allocator_get_stats(arena);
+    assert_eq(stats.CurrentBytes, 0);
+    assert_eq(stats.PeakBytes, 1150);
+
+    allocator_reset_stats(arena);
+    stats = allocator_get_stats(arena);
+    assert_eq(stats.AllocationCount, 0);
+    assert_eq(stats.PeakBytes, 0);
+
+    allocator_registry_remove(arena);
+    allocator_remove_pool(arena, pool);
+#endif
+}
+
+TEST(pool_allocator) {
+    pool_allocator_data data;
+    data.ElementSize = pool_allocator_element_size(48, 16);
+
+    // Room for 4 elements
+    s64 poolSize = sizeof(allocator_pool) + 4 * data.ElementSize;
+    void *pool = os_allocate_block(poolSize);
+    defer(os_free_block(pool));
+
+    allocator alloc = {pool_allocator, &data};
+    allocator_add_pool(alloc, pool, poolSize);
+
+    assert_true(pool_allocator(allocator_mode::ALLOCATE, &data, data.ElementSize + 1, null, 0, 0) == null);
+
+    byte *blocks[4];
+    For(range(4)) {
+        assert_true(pool_allocator_has_room(&data));
+        blocks[it] = allocate_array<byte>(48, {.Alloc = alloc, .Alignment = 16});
+        assert_eq((u64) blocks[it] % 16, 0);
+        fill_memory(blocks[it], (byte) it, 48);
+    }
+    assert_false(pool_allocator_has_room(&data));
+    assert_true(pool_allocator(allocator_mode::ALLOCATE, &data, data.ElementSize, null, 0, 0) == null);
+
+    For(range(4)) {
+        assert_eq(blocks[it][0], (byte) it);
+        assert_eq(blocks[it][47], (byte) it);
+    }
+
+    // Stays in place as long as it fits in the element
+    auto *shrunk = reallocate_array(blocks[0], 40);
+    assert_true(shrunk == blocks[0]);
+
+    // A freed element is the next one handed out
+    free(blocks[2]);
+    assert_true(pool_allocator_has_room(&data));
+    assert_true(allocate_array<byte>(48, {.Alloc = alloc, .Alignment = 16}) == blocks[2]);
+
+    free_all(alloc);
+    assert_true(pool_allocator_has_room(&data));
+
+    allocator_registry_remove(alloc);
+    allocator_remove_pool(alloc, pool);
+}
+
+struct object_pool_node {
+    s64 Value = 42;
+    object_pool_node *Next = null;
+};
+
+TEST(object_pool) {
+    object_pool<object_pool_node> nodes;
+    nodes.ObjectsPerBlock = 8;
+
+    object_pool_node *all[20];
+    For(range(20)) {
+        all[it] = pool_allocate(nodes);
+        assert_eq(all[it]->Value, 42);  // Constructed
+        all[it]->Value = it;
+    }
+
+    // The pool grew by itself, a block of 8 at a time
+    s64 blocks = 0;
+    for (auto *p = nodes.Data.Base; p; p = p->Next) ++blocks;
+    assert_eq(blocks, 3);
+
+    // The normal free() puts an object back in the pool
+    assert_true(allocation_get_allocator(all[5]) == object_pool_get_allocator(nodes));
+    free(all[5]);
+    assert_true(pool_allocate(nodes) == all[5]);
+
+    For(range(20)) {
+        if (it != 5) assert_eq(all[it]->Value, it);
+    }
+
+    free(nodes);
+    assert_true(nodes.Data.Base == null);
+    allocator_registry_remove(object_pool_get_allocator(nodes));
+}
+
+TEST(allocate_batch) {
+    arena_allocator_data data;
+    allocator arena = {arena_allocator, &data};
+
+    s64 poolSize = 64_KiB;
+    void *pool = os_allocate_block(poolSize);
+    defer(os_free_block(pool));
+    allocator_add_pool(arena, pool, poolSize);
+
+    s64 index = allocator_registry_find_or_add(arena);
+    assert_nq(index, -1);
+
+    void *blocks[50];
+    general_allocate_batch(blocks, 50, arena, 24, 32);
+    For(range(50)) {
+        assert_eq((u64) blocks[it] % 32, 0);
+        assert_eq(allocation_get_size(blocks[it]), 24);
+        assert_true(allocation_get_allocator(blocks[it]) == arena);
+        if (it) assert_ge((byte *) blocks[it] - (byte *) blocks[it - 1], 24);
+
+        fill_memory(blocks[it], (byte) it, 24);
+    }
+    For(range(50)) assert_eq(((byte *) blocks[it])[23], (byte) it);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    if (index < ALLOCATOR_STATS_COUNT) {
+        auto stats = allocator_get_stats(arena);
+        assert_eq(stats.AllocationCount, 50);
+        assert_eq(stats.CurrentBytes, 1200);
+    }
+#endif
+
+    // The arena frees a batch from the back, so the one which was allocated last is taken back entirely
+    general_free_batch(blocks, 50);
+    assert_eq(data.TotalUsed, 0);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    if (index < ALLOCATOR_STATS_COUNT) {
+        auto stats = allocator_get_stats(arena);
+        assert_eq(stats.FreeCount, 50);
+        assert_eq(stats.CurrentBytes, 0);
+    }
+#endif
+
+    // Runs of blocks from different allocators and of different sizes, nulls are skipped
+    void *mixed[] = {
+        allocate_array<byte>(16, {.Alloc = arena}),
+        null,
+        allocate_array<byte>(16, {.Alloc = Context.TempAlloc}),
+        allocate_array<byte>(32, {.Alloc = Context.TempAlloc}),
+        null,
+        allocate_array<byte>(16, {.Alloc = arena}),
+    };
+    general_free_batch(mixed, 6);
+
+#if !defined FORCE_NO_ALLOCATOR_STATS
+    if (index < ALLOCATOR_STATS_COUNT) assert_eq(allocator_get_stats(arena).FreeCount, 52);
+#endif
+
+    // The guard page allocator doesn't do batches, we fall back to one call per block
+    void *guarded[4];
+    general_allocate_batch(guarded, 4, guard_page_allocator, 64, 16);
+    For(range(4)) {
+        fill_memory(guarded[it], 0xAB, 64);
+        if (it) assert_true(guarded[it] != guarded[it - 1]);
+    }
+    general_free_batch(guarded, 4);
+
+    free_all(arena);
+    allocator_registry_remove(arena);
+    allocator_remove_pool(arena, pool);
+}
+
+TEST(frame_allocator) {
+    frame_allocator_data data;
+    data.BufferCount = 3;
+
+    allocator frame = {frame_allocator, &data};
+
+    // What a frame allocated stays alive for the next two frames, then its buffer is cleared and reused
+    s64 *values[6];
+    For(range(6)) {
+        assert_eq(data.Current, it % 3);
+
+        values[it] = allocate_array<s64>(16, {.Alloc = frame});
+        For_as(j, range(16)) values[it][j] = it;
+
+        For_as(older, range(it >= 2 ? it - 2 : 0, it)) {
+            For_as(j, range(16)) assert_eq(values[older][j], older);
+        }
+
+        if (it >= 3) assert_true(values[it] == values[it - 3]);
+
+        free_all(frame);
+        assert_eq(frame_allocator_current_arena(&data)->TotalUsed, 0);
+    }
+
+    // Marks work on the arena of the current frame
+    auto *arena = frame_allocator_current_arena(&data);
+    allocate_array<s64>(4, {.Alloc = frame});
+
+    s64 used = arena->TotalUsed;
+    auto mark = arena_mark(arena);
+    allocate_array<s64>(64, {.Alloc = frame});
+    arena_rewind(arena, mark);
+    assert_eq(arena->TotalUsed, used);
+
+    // Clear every buffer and give the pools back
+    For(range(data.BufferCount)) free_all(frame);
+    allocator_registry_remove(frame);
+
+    For(data.Arenas) {
+        while (it.Base) {
+            auto *pool = it.Base;
+            allocator_remove_pool({arena_allocator, &it}, pool);
+            os_free_block(pool);
+        }
+    }
+}
+
+file_scope byte *RemoteFreeBlocks[1000];
+
+// Sizes which spread over the small size classes of the persistent allocator
+file_scope s64 remote_free_size(s64 index) { return 16 + index * 7 % 600; }
+
+file_scope s64 remote_free_mismatches(byte **blocks, byte expected) {
+    s64 result = 0;
+    For_as(i, range(1000)) {
+        For_as(j, range(remote_free_size(i))) {
+            if (blocks[i][j] != (byte) (expected + i)) ++result;
+        }
+    }
+    return result;
+}
+
+file_scope void remote_free_worker(void *) {
+    For(RemoteFreeBlocks) free(it);
+}
+
+file_scope void remote_allocate_worker(void *) {
+    auto alloc = internal::platform_get_persistent_allocator();
+    For(range(1000)) {
+        RemoteFreeBlocks[it] = allocate_array<byte>(remote_free_size(it), {.Alloc = alloc});
+        fill_memory(RemoteFreeBlocks[it], (byte) it, remote_free_size(it));
+    }
+}
+
+TEST(remote_free) {
+    auto alloc = internal::platform_get_persistent_allocator();
+
+    byte *mine[1000];
+    For(range(3)) {
+        // We allocate and another thread frees, the blocks go back to our cache while we keep allocating from the same classes
+        For_as(i, range(1000)) RemoteFreeBlocks[i] = allocate_array<byte>(remote_free_size(i), {.Alloc = alloc});
+
+        thread::thread t;
+        t.init_and_launch(remote_free_worker);
+
+        For_as(i, range(1000)) {
+            mine[i] = allocate_array<byte>(remote_free_size(i), {.Alloc = alloc});
+            fill_memory(mine[i], (byte) (i + 1), remote_free_size(i));
+        }
+        t.wait();
+
+        assert_eq(remote_free_mismatches(mine, 1), 0);
+        For_as(i, range(1000)) free(mine[i]);
+    }
+
+    // Another thread allocates and exits, then we free its blocks (the cache which owns them is orphaned by then)
+    thread::thread t;
+    t.init_and_launch(remote_allocate_worker);
+    t.wait();
+
+    assert_eq(remote_free_mismatches(RemoteFreeBlocks, 0), 0);
+    For(RemoteFreeBlocks) free(it);
+
+    // What went back to the heap is handed out fine again
+    For(range(1000)) {
+        mine[it] = allocate_array<byte>(remote_free_size(it), {.Alloc = alloc});
+        fill_memory(mine[it], (byte) (it + 2), remote_free_size(it));
+    }
+    assert_eq(remote_free_mismatches(mine, 2), 0);
+    For(mine) free(it);
+}
+
+TEST(ring_buffer) {
+    ring_buffer<s64> rb;
+    defer(free(rb));
+
+    For(range(6)) push_back(rb, it);
+    assert_eq(pop_front(rb), 0);
+    assert_eq(pop_front(rb), 1);
+
+    // Wrap around the end of the buffer (the capacity is 8)
+    For(range(6, 9)) push_back(rb, it);
+    push_front(rb, 1);
+    assert_eq(rb.Allocated, 8);
+    assert_eq(rb.Count, 8);
+
+    For(range(rb.Count)) assert_eq(rb[it], it + 1);
+    assert_eq(rb[-1], 8);
+
+    // Grows and unwraps
+    s64 more[] = {9, 10, 11};
+    push_back(rb, more, 3);
+    assert_eq(rb.Allocated, 16);
+    assert_eq(rb.Head, 0);
+
+    s64 expected = 1;
+    For(rb) assert_eq(it, expected++);
+
+    assert_eq(pop_back(rb), 11);
+
+    s64 sum = 0;
+    while (rb.Count) {
+        auto span = front_span(rb);
+        For(span) sum += it;
+        consume(rb, span.Count);
+    }
+    assert_eq(sum, 55);
+}
+
+TEST(deque) {
+    deque<s64, 4> dq;
+    defer(free(dq));
+
+    For(range(10)) push_back(dq, it);
+    auto *stable = &dq[5];
+    For(range(1, 6)) push_front(dq, -it);
+
+    assert_eq(dq.Count, 15);
+    assert_eq(stable, &dq[10]);  // Elements never move
+    For(range(dq.Count)) assert_eq(dq[it], it - 5);
+
+    assert_eq(pop_front(dq), -5);
+    assert_eq(pop_back(dq), 9);
+    assert_eq(dq.Count, 13);
+
+    auto span = front_span(dq);
+    assert_true(span.Count >= 1 && span.Count <= 4);
+    assert_eq(span[0], -4);
+    consume(dq, span.Count);
+
+    while (dq.Count) pop_back(dq);
+    assert_eq(dq.Blocks.Count, 0);
+
+    push_front(dq, 42);
+    assert_eq(dq[0], 42);
+}
+
+file_scope spsc_queue<s64, 256> SPSCQueue;
+
+file_scope void spsc_queue_producer(void *) {
+    s64 batch[16];
+    s64 next = 0;
+    while (next < 100000) {
+        s64 n = min<s64>(16, 100000 - next);
+        For(range(n)) batch[it] = next + it;
+
+        s64 pushed = try_push_batch(SPSCQueue, batch, n);
+        next += pushed;
+        if (!pushed) thread::sleep(0);
+    }
+}
+
+TEST(spsc_queue) {
+    thread::thread producer;
+    producer.init_and_launch(spsc_queue_producer, null);
+
+    // Elements must come out in the same order
+    s64 expected = 0;
+    while (expected < 100000) {
+        s64 value;
+        if (try_pop(SPSCQueue, &value)) {
+            assert_eq(value, expected);
+            ++expected;
+        }
+    }
+    producer.wait();
+
+    s64 value;
+    assert_false(try_pop(SPSCQueue, &value));
+}
+
+file_scope mpmc_queue<s64, 1024> MPMCQueue;
+file_scope s64 MPMCPopped = 0;
+file_scope s64 MPMCSum = 0;
+
+file_scope void mpmc_queue_producer(void *userData) {
+    s64 first = (s64) userData * 10000;
+    For(range(first, first + 10000)) {
+        while (!try_push(MPMCQueue, it)) thread::sleep(0);
+    }
+}
+
+file_scope void mpmc_queue_consumer(void *) {
+    while (atomic_load(&MPMCPopped) < 40000) {
+        s64 value;
+        if (try_pop(MPMCQueue, &value)) {
+            atomic_add(&MPMCSum, value);
+            atomic_add(&MPMCPopped, 1ll);
+        }
+    }
+}
+
+TEST(mpmc_queue) {
+    thread::thread threads[8];
+    For(range(4)) threads[it].init_and_launch(mpmc_queue_producer, (void *) it);
+    For(range(4, 8)) threads[it].init_and_launch(mpmc_queue_consumer, null);
+    For(threads) it.wait();
+
+    // Every element was popped exactly once
+    assert_eq(MPMCPopped, 40000);
+    assert_eq(MPMCSum, 39999ll * 40000 / 2);
+
+    s64 value;
+    assert_false(try_pop(MPMCQueue, &value));
+    assert_true(try_push(MPMCQueue, 1));
+    assert_eq(try_pop_batch(MPMCQueue, &value, 1), 1);
+}
+
+TEST(bitset) {
+    bitset<200> a, b;
+
+    set(a, 3);
+    set(a, 64);
+    set(a, 199);
+    assert_true(get(a, 64));
+    assert_false(get(a, 65));
+    assert_eq(count_set(a), 3);
+
+    s64 expected[] = {3, 64, 199};
+    s64 i = 0;
+    For(a) assert_eq(it, expected[i++]);
+    assert_eq(i, 3);
+
+    set_range(b, 60, 130);
+    assert_eq(count_set(b), 70);
+    assert_eq(find_first_set(b), 60);
+    assert_eq(find_first_set(b, 100), 100);
+    assert_eq(find_first_set(b, 130), -1);
+
+    bitset<200> c;
+    bits_and(c, a, b);
+    assert_eq(count_set(c), 1);
+    assert_true(get(c, 64));
+
+    bits_or(c, a, b);
+    assert_eq(count_set(c), 72);
+
+    bits_and_not(c, b, a);
+    assert_eq(count_set(c), 69);
+    assert_false(get(c, 64));
+
+    bits_xor(c, c, c);
+    assert_false(any(c));
+
+    clear_range(b, 61, 129);
+    assert_eq(count_set(b), 2);
+}
+
+TEST(bit_array) {
+    bit_array a;
+    defer(free(a));
+
+    resize(a, 1000);
+    set_range(a, 0, 1000);
+    assert_eq(count_set(a), 1000);
+
+    resize(a, 10);
+    assert_eq(count_set(a), 10);
+
+    // Bits which come back after growing again are 0
+    resize(a, 1000);
+    assert_eq(count_set(a), 10);
+    assert_eq(find_first_set(a, 10), -1);
+
+    bit_array b;
+    defer(free(b));
+    clone(&b, a);
+    assert_true(a == b);
+    toggle(b, 500);
+    assert_true(a != b);
+}
+
+TEST(packed_array) {
+    u32 values[1000], out[1000];
+
+    // Every width, with runs which don't start on a multiple of 8 (the SIMD batch)
+    for (u32 width = 1; width <= 32; ++width) {
+        u64 mask = (1ull << width) - 1;
+        For(range(1000)) values[it] = (u32) (((u64) it * 2654435761u) & mask);
+
+        packed_array a;
+        defer(free(a));
+        packed_array_pack(a, values, 1000, width);
+        assert_eq(a.BitWidth, width);
+
+        For(range(1000)) assert_eq(get(a, it), values[it]);
+
+        packed_array_unpack(out, a, 3, 997);
+        For(range(997)) assert_eq(out[it], values[it + 3]);
+
+        set(a, 500, (u32) mask);
+        set(a, 501, 0);
+        assert_eq(get(a, 499), values[499]);
+        assert_eq(get(a, 500), (u32) mask);
+        assert_eq(get(a, 501), 0u);
+        assert_eq(get(a, 502), values[502]);
+    }
+
+    // Picks the width from the largest value
+    For(range(1000)) values[it] = (u32) it % 600;
+    packed_array a;
+    defer(free(a));
+    packed_array_pack(a, values, 1000);
+    assert_eq(a.BitWidth, 10u);
+
+    packed_array b;
+    defer(free(b));
+    clone(&b, a);
+    For(range(1000)) assert_eq(get(b, it), values[it]);
+
+    // Values which come back after growing again are 0
+    resize(b, 10);
+    add(b, 1023);
+    resize(b, 20);
+    assert_eq(get(b, 9), values[9]);
+    assert_eq(get(b, 10), 1023u);
+    For(range(11, 20)) assert_eq(get(b, it), 0u);
+}
+
+TEST(packed_for_array) {
+    u32 values[1000], out[1000];
+
+    // Sorted, like the ids in a posting list, with a run of equal values (a block which takes no bits)
+    u32 v = 1000000;
+    For(range(1000)) {
+        if (it < 256 || it >= 384) v += 1 + (u32) (it * 7919 % 3);
+        values[it] = v;
+    }
+
+    packed_for_array a;
+    defer(free(a));
+    packed_for_pack(a, values, 1000);
+
+    assert_eq(a.Blocks[2].BitWidth, 0u);
+    assert_le(packed_for_size(a), (s64) sizeof(values) / 3);
+
+    For(range(1000)) assert_eq(get(a, it), values[it]);
+
+    packed_for_unpack(out, a, 100, 900);
+    For(range(900)) assert_eq(out[it], values[it + 100]);
+
+    packed_for_array b;
+    defer(free(b));
+    clone(&b, a);
+    packed_for_unpack(out, b, 0, 1000);
+    For(range(1000)) assert_eq(out[it], values[it]);
+
+    // The whole range in one block
+    values[998] = 0;
+    values[999] = 0xFFFFFFFF;
+    packed_for_pack(a, values, 1000);
+    assert_eq(a.Blocks[7].BitWidth, 32u);
+
+    packed_for_unpack(out, a, 0, 1000);
+    For(range(1000)) assert_eq(out[it], values[it]);
+}
+
+// Small LCG so the sort tests are deterministic
+file_scope u64 SortSeed = 12345;
+file_scope u64 sort_random() {
+    SortSeed = SortSeed * 6364136223846793005ull + 1442695040888963407ull;
+    return SortSeed >> 16;
+}
+
+template <typename T>
+file_scope bool is_sorted(const array<T> &arr) {
+    For(range(1, arr.Count)) if (arr[it] < arr[it - 1]) return false;
+    return true;
+}
+
+TEST(sort) {
+    array<s64> a;
+    defer(free(a));
+
+    For(range(1000)) array_append(a, (s64) (sort_random() % 100) - 50);
+    sort(a);
+    assert_true(is_sorted(a));
+
+    // Descending with a custom comparison
+    sort(a, [](const s64 *x, const s64 *y) { return (s32) (*y - *x); });
+    assert_true(a[0] >= a[-1]);
+
+    // Already sorted and all equal inputs are the bad cases for naive quick sort
+    For(a) it = 7;
+    sort(a);
+    assert_eq(a[0], 7);
+    assert_eq(a[-1], 7);
+
+    For(range(a.Count)) a[it] = it;
+    sort(a);
+    assert_true(is_sorted(a));
+}
+
+TEST(radix_sort) {
+    array<s32> a;
+    defer(free(a));
+
+    For(range(5000)) array_append(a, (s32) sort_random());
+    radix_sort(a);
+    assert_true(is_sorted(a));
+
+    array<f32> f;
+    defer(free(f));
+
+    For(range(5000)) array_append(f, (f32) ((s64) (sort_random() % 20000) - 10000) / 7.0f);
+    radix_sort(f);
+    assert_true(is_sorted(f));
+
+    // Sorting by an extracted key is stable
+    struct item {
+        u8 Key;
+        s64 Order;
+    };
+
+    array<item> items;
+    defer(free(items));
+
+    For(range(1000)) array_append(items, item{(u8) (sort_random() % 10), it});
+    radix_sort(items, [](const item &i) { return i.Key; });
+    For(range(1, items.Count)) {
+        assert_true(items[it - 1].Key <= items[it].Key);
+        if (items[it - 1].Key == items[it].Key) assert_true(items[it - 1].Order < items[it].Order);
+    }
+}
+
+TEST(sort_by_key) {
+    array<u64> keys;
+    defer(free(keys));
+
+    array<s64> values;
+    defer(free(values));
+
+    For(range(1000)) {
+        u64 key = sort_random();
+        array_append(keys, key);
+        array_append(values, (s64) (key % 1000));
+    }
+
+    sort_by_key(keys, values);
+    assert_true(is_sorted(keys));
+    For(range(keys.Count)) assert_eq(values[it], (s64) (keys[it] % 1000));
+}
+
+TEST(parallel_sort) {
+    array<s64> a;
+    defer(free(a));
+
+    s64 count = 4 * PARALLEL_SORT_MIN_CHUNK + 123;
+    array_reserve(a, count);
+    For(range(count)) array_append(a, (s64) sort_random());
+
+    parallel_sort(a, internal::default_sort_comparison<s64>{}, 4);
+    assert_true(is_sorted(a));
+    assert_eq(a.Count, count);
+}
+
+// Against a plain linear scan, with duplicates and values before and after everything
+TEST(sorted_search) {
+    auto check = [](auto &keys, auto value) {
+        s64 lower = 0, upper = 0;
+        For(keys) lower += it < value, upper += !(value < it);
+
+        assert_eq(lower_bound(keys, value), lower);
+        assert_eq(upper_bound(keys, value), upper);
+        assert_eq(binary_search(keys, value), lower < upper ? lower : -1);
+        return lower;
+    };
+
+    array<s32> ints;
+    defer(free(ints));
+
+    array<u32> big;  // Above 2^31 too, SSE2 only compares signed integers
+    defer(free(big));
+
+    array<f32> floats;
+    defer(free(floats));
+
+    array<s64> wide;  // No SIMD path
+    defer(free(wide));
+
+    For(range(1000)) {
+        s64 v = (s64) (sort_random() % 400) - 200;
+        array_append(ints, (s32) v);
+        array_append(big, (u32) (sort_random() >> 32));
+        array_append(floats, (f32) v * 0.5f);
+        array_append(wide, v * 3);
+    }
+    sort(ints);
+    sort(big);
+    sort(floats);
+    sort(wide);
+
+    // Every size up to a few times the SIMD threshold, then the whole array
+    For_as(n, range(40)) {
+        array<s32> prefix(ints.Data, n);
+        For(range(-205, 205, 5)) check(prefix, (s32) it);
+    }
+
+    For(range(-205, 205)) {
+        check(ints, (s32) it);
+        check(floats, (f32) it * 0.5f + 0.25f);
+        check(wide, (s64) it * 3);
+    }
+    For(range(200)) check(big, (u32) (sort_random() >> 32));
+    For(big) check(big, it);
+
+    array<string> names;
+    defer(free(names));
+    array_append(names, string("apple"));
+    array_append(names, string("banana"));
+    array_append(names, string("cherry"));
+    assert_eq(binary_search(names, string("banana")), 1);
+    assert_eq(binary_search(names, string("blueberry")), -1);
+    assert_eq(lower_bound(names, string("blueberry")), 2);
+
+    // The Eytzinger layout gives the same answers, as indices into the sorted input
+    eytzinger_array<s32> e;
+    defer(free(e));
+
+    For_as(n, range(1, 70)) {
+        array<s32> prefix(ints.Data, n);
+        eytzinger_build(e, prefix);
+        For(range(-205, 205, 3)) {
+            s64 lower = check(prefix, (s32) it);
+            assert_eq(lower_bound(e, (s32) it), lower);
+            assert_eq(upper_bound(e, (s32) it), upper_bound(prefix, (s32) it));
+            assert_eq(find(e, (s32) it), binary_search(prefix, (s32) it));
+        }
+    }
+
+    eytzinger_build(e, ints);
+    For(range(-205, 205)) {
+        assert_eq(lower_bound(e, (s32) it), lower_bound(ints, (s32) it));
+        assert_eq(has(e, (s32) it), binary_search(ints, (s32) it) != -1);
+    }
+
+    array<s32> none;
+    eytzinger_build(e, none);
+    assert_eq(lower_bound(e, 5), 0);
+    assert_eq(find(e, 5), -1);
+    assert_eq(lower_bound(none, 5), 0);
+}
+
+TEST(array_algorithms) {
+    array<s64> a;
+    defer(free(a));
+    For(range(1000)) array_append(a, (s64) (sort_random() % 50));
+
+    // Against the quadratic versions
+    array<s64> expected;
+    defer(free(expected));
+    For(a) if (!has(expected, it)) array_append(expected, it);
+
+    array<s64> unique;
+    defer(free(unique));
+    array_append(unique, a);
+    assert_eq(array_unique(unique), a.Count - expected.Count);
+    assert_true(unique == expected);
+
+    array<s64> sorted;
+    defer(free(sorted));
+    array_append(sorted, a);
+    sort(sorted);
+    array_unique_sorted(sorted);
+    sort(expected);
+    assert_true(sorted == expected);
+
+    auto even = [](s64 v) { return v % 2 == 0; };
+
+    array<s64> p;
+    defer(free(p));
+    array_append(p, a);
+    s64 evens = array_partition(p, even);
+
+    s64 expectedEvens = 0;
+    For(a) expectedEvens += even(it);
+    assert_eq(evens, expectedEvens);
+    For(range(p.Count)) assert_eq(even(p[it]), it < evens);
+
+    // Stable: both halves are the subsequences of the input
+    array_reset(p);
+    array_append(p, a);
+    assert_eq(array_stable_partition(p, even), expectedEvens);
+
+    s64 nextEven = 0, nextOdd = evens;
+    For(a) {
+        if (even(it)) {
+            assert_eq(p[nextEven++], it);
+        } else {
+            assert_eq(p[nextOdd++], it);
+        }
+    }
+
+    hash_table<s64, array<s64>> groups;
+    defer({
+        for (auto [key, value] : groups) free(*value);
+        free(groups);
+    });
+    group_by(a, [](s64 v) { return v % 7; }, groups);
+
+    assert_eq(groups.Count, 7);
+    s64 total = 0;
+    for (auto [key, value] : groups) {
+        total += value->Count;
+        For(*value) assert_eq(it % 7, *key);
+    }
+    assert_eq(total, a.Count);
+
+    // The sets: multiples of 2 and of 3, as u32 (SIMD), u64 (SIMD) and s64 (scalar)
+    array<u32> twos, threes, result;
+    defer(free(twos));
+    defer(free(threes));
+    defer(free(result));
+
+    for (u32 v = 0; v < 1000; v += 2) array_append(twos, v);
+    for (u32 v = 0; v < 1000; v += 3) array_append(threes, v);
+
+    assert_eq(sorted_intersection(twos, threes, result), 167);
+    For(range(result.Count)) assert_eq(result[it], (u32) it * 6);
+
+    array_reset(result);
+    assert_eq(sorted_union(twos, threes, result), 667);
+    For(range(1, result.Count)) assert_true(result[it - 1] < result[it]);
+    For(result) assert_true(it % 2 == 0 || it % 3 == 0);
+
+    array_reset(result);
+    assert_eq(sorted_difference(twos, threes, result), 500 - 167);
+    For(result) assert_true(it % 2 == 0 && it % 3 != 0);
+
+    array<u64> wideTwos, wideThrees, wideResult;
+    defer(free(wideTwos));
+    defer(free(wideThrees));
+    defer(free(wideResult));
+    For(twos) array_append(wideTwos, ((u64) it << 32) + it);
+    For(threes) array_append(wideThrees, ((u64) it << 32) + it);
+
+    // The same low halves with different high halves must not match
+    array_append(wideTwos, (1000ull << 32) + 7);
+    array_append(wideThrees, (1001ull << 32) + 7);
+
+    assert_eq(sorted_intersection(wideTwos, wideThrees, wideResult), 167);
+    For(range(wideResult.Count)) assert_eq(wideResult[it], ((u64) it * 6 << 32) + it * 6);
+
+    array<s64> x, y, z;
+    defer(free(x));
+    defer(free(y));
+    defer(free(z));
+    For(twos) array_append(x, (s64) it - 500);
+    For(threes) array_append(y, (s64) it - 500);
+    assert_eq(sorted_intersection(x, y, z), 167);
+}
+
+TEST(priority_queue) {
+    priority_queue<s64> pq;
+    defer(free(pq));
+
+    s64 handles[100];
+    For(range(100)) handles[it] = push(pq, (s64) (sort_random() % 1000));
+
+    // Decrease-key moves the element to the top
+    update(pq, handles[50], -1);
+    assert_eq(top(pq), -1);
+    assert_eq(top_handle(pq), handles[50]);
+
+    assert_true(remove(pq, handles[50]));
+    assert_false(has(pq, handles[50]));
+    assert_eq(count(pq), 99);
+
+    s64 last = -1;
+    while (count(pq)) {
+        s64 value = pop(pq);
+        assert_true(value >= last);
+        last = value;
+    }
+}
+
+TEST(priority_queue_4_ary) {
+    auto greater = [](const s64 *a, const s64 *b) { return (s32) (*b - *a); };
+    priority_queue<s64, 4, decltype(greater)> pq(greater);
+    defer(free(pq));
+
+    array<s64> elements;
+    defer(free(elements));
+    For(range(1000)) array_append(elements, (s64) (sort_random() % 1000));
+
+    heapify(pq, elements);
+    assert_eq(count(pq), 1000);
+    assert_eq(get(pq, 10), elements[10]);
+
+    // Increase some elements past everything else, they should come out first (this is a max-heap)
+    update(pq, 10, 5000);
+    update(pq, 20, 4000);
+    assert_eq(pop(pq), 5000);
+    assert_eq(pop(pq), 4000);
+
+    s64 last = 1000;
+    while (count(pq)) {
+        s64 value = pop(pq);
+        assert_true(value <= last);
+        last = value;
+    }
+}
+
+TEST(btree_map) {
+    btree_map<s64, s64, 64> map;  // Small nodes so we get a few levels
+    defer(free(map));
+
+    For(range(1000)) set(map, (it * 7919) % 1000, it);
+    assert_eq(count(map), 1000);
+
+    s64 expected = 0;
+    For(map) {
+        assert_eq(*it.Key, expected);
+        assert_eq(*it.Value * 7919 % 1000, expected);
+        ++expected;
+    }
+
+    set(map, 500, -1);
+    assert_eq(*find(map, 500), -1);
+    assert_eq(count(map), 1000);
+
+    assert_true(remove(map, 500));
+    assert_false(has(map, 500));
+    assert_false(remove(map, 500));
+
+    assert_eq(*(*lower_bound(map, 500)).Key, 501);
+    assert_eq(*(*upper_bound(map, 501)).Key, 502);
+    assert_true(lower_bound(map, 1000) == map.end());
+
+    s64 n = 0;
+    For(get_range(map, 490, 510)) {
+        assert_true(*it.Key >= 490 && *it.Key < 510 && *it.Key != 500);
+        ++n;
+    }
+    assert_eq(n, 19);
+}
+
+TEST(btree_map_bulk_load) {
+    array<s64> keys, values;
+    defer(free(keys));
+    defer(free(values));
+
+    For(range(10000)) {
+        array_append(keys, it * 2);
+        array_append(values, it);
+    }
+
+    btree_map<s64, s64> map;
+    defer(free(map));
+
+    bulk_load(map, keys, values);
+    assert_eq(count(map), 10000);
+    assert_eq(*find(map, 1234), 617);
+    assert_true(find(map, 1235) == null);
+
+    // Inserting after a bulk load splits the full nodes
+    set(map, 1235, -1);
+    assert_eq(*(*upper_bound(map, 1234)).Key, 1235);
+
+    btree_map<s64, s64> copy;
+    defer(free(copy));
+    clone(&copy, map);
+    assert_eq(count(copy), 10001);
+    assert_eq(*find(copy, 1235), -1);
+}
+
+TEST(bloom_filter) {
+    bloom_filter filter;
+    defer(free(filter));
+    bloom_filter_init(filter, 10000);
+
+    For(range(10000)) add(filter, (s64) it);
+    For(range(10000)) assert_true(has(filter, (s64) it));
+
+    s64 falsePositives = 0;
+    For(range(10000, 110000)) falsePositives += has(filter, (s64) it);
+    assert_true(falsePositives < 2000);  // ~0.5% expected with 12 bits per key
+
+    bytes data = serialize(filter);
+    defer(free(data));
+
+    bloom_filter loaded;
+    defer(free(loaded));
+    assert_true(deserialize(&loaded, data));
+    For(range(10000)) assert_true(has(loaded, (s64) it));
+
+    assert_false(deserialize(&loaded, bytes(data.Data, data.Count - 1)));
+
+    reset(filter);
+    assert_false(has(filter, (s64) 5));
+}
+
+TEST(cuckoo_filter) {
+    cuckoo_filter filter;
+    defer(free(filter));
+    cuckoo_filter_init(filter, 10000);
+
+    s64 n = 0;
+    while (add(filter, n)) ++n;
+    assert_true(n >= 10000);
+    assert_eq(count(filter), n);
+
+    For(range(n)) assert_true(has(filter, it));
+
+    s64 falsePositives = 0;
+    For(range(1000000, 1100000)) falsePositives += has(filter, (s64) it);
+    assert_true(falsePositives < 100);
+
+    // Remove the even keys, the odd ones must stay
+    for (s64 i = 0; i < n; i += 2) assert_true(remove(filter, i));
+    for (s64 i = 1; i < n; i += 2) assert_true(has(filter, i));
+    assert_eq(count(filter), n / 2);
+
+    bytes data = serialize(filter);
+    defer(free(data));
+
+    cuckoo_filter loaded;
+    defer(free(loaded));
+    assert_true(deserialize(&loaded, data));
+    assert_eq(count(loaded), count(filter));
+    for (s64 i = 1; i < n; i += 2) assert_true(has(loaded, i));
+
+    // There is room again after removing
+    assert_true(add(filter, (s64) -1));
+    assert_true(has(filter, (s64) -1));
+}
@@ -1,3 +1,4 @@
+#include <lstd/memory/shared_buffer.h>
 #include <lstd/memory/string_builder.h>
 
 #include "../test.h"
@@ -29,6 +30,148 @@ TEST(code_point_size) {
     assert_eq(mixed.Length, 3 + 3 + 3 + 3);
 }
 
+TEST(utf8_length_long) {
+    // Long enough for the SIMD paths (and their 8 bit counters to overflow into the totals), with a scalar tail
+    string s;
+    defer(free(s));
+    For(range(3001)) string_append(s, u8"a\u0431\u0904\U0002070E");  // 10 bytes, 4 code points
+
+    assert_eq(utf8_length(s.Data, s.Count), 3001 * 4);
+    assert_eq(utf8_length(s.Data + 1, s.Count - 1), 3001 * 4 - 1);
+    assert_eq(utf8_length(s.Data, 15), 7);
+
+    string view = string(s.Data, s.Count);
+    assert_eq(view.Length, 3001 * 4);
+
+    // At compile time we take the scalar path
+    static_assert(utf8_length("\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1\xD0\xB1", 20) == 10);
+}
+
+TEST(utf8_validation) {
+    assert_eq(utf8_find_invalid("abc", 3), -1);
+    assert_eq(utf8_find_invalid("\xC0\x80", 2), 0);                    // Overlong
+    assert_eq(utf8_find_invalid("a\xED\xA0\x80", 4), 1);                // Surrogate
+    assert_eq(utf8_find_invalid("ab\xF4\x90\x80\x80", 6), 2);          // Above U+10FFFF
+    assert_eq(utf8_find_invalid("abc\xE0\xA4", 5), 3);                  // Truncated
+    static_assert(utf8_find_invalid("\xE0\x80\x80", 3) == 0);
+
+    // Long enough for the SIMD paths
+    string s;
+    defer(free(s));
+    For(range(100)) string_append(s, u8"a\u0431\u0904\U0002070E");
+    assert_true(is_valid_utf8(s.Data, s.Count));
+
+    s.Data[502] = 'x';  // Second byte of a 2 byte sequence
+    assert_eq(utf8_find_invalid(s.Data, s.Count), 501);
+
+    s64 invalidAt;
+    string valid = make_validated_string(s.Data, s.Count, &invalidAt);
+    assert_eq(invalidAt, 501);
+    assert_eq(valid.Count, 501);
+    assert_eq(valid.Length, 201);
+
+    valid = make_validated_string(s.Data, 501, &invalidAt);
+    assert_eq(invalidAt, -1);
+    assert_eq(valid.Count, 501);
+}
+
+TEST(utf16_conversion) {
+    string s;
+    defer(free(s));
+    For(range(20)) string_append(s, "C:/Users/some/long/path/");
+    string_append(s, u8"\u0431\u0904\U0002070E.txt");
+
+    // Each byte makes at most one utf16 code unit
+    auto *s16 = allocate_array<utf16>(s.Count + 1);
+    defer(free(s16));
+    utf8_to_utf16(s.Data, s.Length, s16);
+
+    s64 count16 = c_string_length(s16);
+    assert_eq(count16, s.Length + 1);  // U+2070E is a surrogate pair
+    assert_eq((u32) s16[20 * 24], 0x431u);
+    assert_eq((u32) s16[20 * 24 + 2], 0xD841u);
+    assert_eq((u32) s16[20 * 24 + 3], 0xDF0Eu);
+
+    string back;
+    defer(free(back));
+    string_reserve(back, count16 * 3);
+    utf16_to_utf8(s16, (utf8 *) back.Data, &back.Count);
+    back.Length = utf8_length(back.Data, back.Count);
+    assert_eq(back, s);
+}
+
+TEST(utf32_conversion) {
+    string s;
+    defer(free(s));
+    For(range(20)) string_append(s, "plain ascii text ");
+    string_append(s, u8"\u0431\u0904\U0002070E end");
+
+    auto *s32 = allocate_array<utf32>(s.Length + 1);
+    defer(free(s32));
+    utf8_to_utf32(s.Data, s.Length, s32);
+
+    assert_eq(c_string_length(s32), s.Length);
+    assert_eq((u32) s32[20 * 17], 0x431u);
+    assert_eq((u32) s32[20 * 17 + 2], 0x2070Eu);
+
+    string back;
+    defer(free(back));
+    string_reserve(back, s.Length * 4);
+    utf32_to_utf8(s32, s.Length, (utf8 *) back.Data, &back.Count);
+    back.Length = utf8_length(back.Data, back.Count);
+    assert_eq(back, s);
+
+    // Decoding in blocks gives the same code points, whatever the block size
+    For_as(capacity, range(1, 40)) {
+        const utf8 *p = s.Data;
+        s64 decoded = 0;
+        utf32 block[40];
+        while (s64 count = utf8_to_utf32_block(&p, s.Data + s.Count, block, capacity)) {
+            For(range(count)) assert_eq(block[it], s32[decoded + it]);
+            decoded += count;
+        }
+        assert_eq(decoded, s.Length);
+    }
+
+    // A sequence cut off by the end is replaced, not read past
+    const utf8 *p = (const utf8 *) u8"a\u0431";
+    utf32 cut[4];
+    assert_eq(utf8_to_utf32_block(&p, p + 2, cut, 4), 2);
+    assert_eq((u32) cut[1], 0xFFFDu);
+
+    s64 index = 0;
+    For(code_points(s)) assert_eq(it, s32[index++]);
+    assert_eq(index, s.Length);
+
+    s64 none = 0;
+    For(code_points("")) ++none;
+    assert_eq(none, 0);
+}
+
+TEST(string_index) {
+    string s;
+    defer(free(s));
+    For(range(500)) string_append(s, u8"a\u0431\u0904\U0002070E");
+
+    string_index index;
+    defer(free(index));
+
+    For(range(s.Length)) assert_eq(string_index_get(index, s, it), s[it]);
+    assert_eq(string_index_get(index, s, -1), 0x2070E);
+    assert_eq(string_index_get_offset(index, s, s.Length), s.Count);
+
+    assert_eq(string_index_substring(index, s, 1001, 1003), substring(s, 1001, 1003));
+
+    // Appending invalidates the index
+    string_append(s, u8"\u0431");
+    assert_eq(string_index_get(index, s, -1), 0x431);
+
+    // ASCII strings are indexed directly
+    string ascii = "Hello, world!";
+    assert_eq(string_index_get(index, ascii, 7), 'w');
+    assert_eq(string_index_substring(index, ascii, 0, 5), "Hello");
+}
+
 TEST(substring) {
     string a = "Hello, world!";
     assert_eq((a[{2, 5}]), "llo");
@@ -103,6 +246,40 @@ TEST(trim) {
     assert_eq(trim(a), "Hello, everyone!");
 }
 
+TEST(split) {
+    string pieces[] = {"a", "", "b", "c", ""};
+    s64 i = 0;
+    For(split("a,,b;c,", ",;")) assert_eq(it, pieces[i++]);
+    assert_eq(i, 5);
+
+    i = 0;
+    For(split("", ",")) {
+        assert_eq(it, "");
+        ++i;
+    }
+    assert_eq(i, 1);
+
+    string words[] = {"Hello,", "everyone!", u8"\u0431\u0904"};
+    i = 0;
+    For(split_whitespace(u8"\t\t    Hello,  everyone!   \t\t \u0431\u0904  \n")) assert_eq(it, words[i++]);
+    assert_eq(i, 3);
+
+    i = 0;
+    For(split_whitespace(" \t \n ")) ++i;
+    assert_eq(i, 0);
+
+    string lineList[] = {"first", "", "third"};
+    i = 0;
+    For(lines("first\r\n\nthird\n")) assert_eq(it, lineList[i++]);
+    assert_eq(i, 3);
+
+    // Non-ASCII delimiters
+    string parts[] = {"a", "b", "c"};
+    i = 0;
+    For(split(u8"a\u0904b\u0904c", u8"\u0904")) assert_eq(it, parts[i++]);
+    assert_eq(i, 3);
+}
+
 TEST(match_beginning) {
     string a = "Hello, world!";
     assert_true(match_beginning(a, "Hello"));
@@ -233,6 +410,63 @@ TEST(builder) {
     assert_eq(result, "Hello, world!");
 }
 
+TEST(builder_many_buffers) {
+    string_builder builder;
+    defer(free(builder));
+
+    For(range(1000)) string_append(builder, u8"ab\u00e9");  // 4 bytes, 3 code points
+    assert_eq(builder.Count, 4000);
+    assert_gt(builder.IndirectionCount, 0);
+
+    string result = string_builder_combine(builder);
+    defer(free(result));
+    assert_eq(result.Count, 4000);
+    assert_eq(result.Length, 3000);
+    assert_eq(result.Allocated, 4000);
+
+    // Writing streams the buffers, the result is the same
+    string_builder_writer w;
+    defer(free(w));
+    write(&w, builder);
+    assert_eq(w.Builder.Count, 4000);
+
+    // Reset keeps the buffers and appending reuses them
+    s64 indirections = builder.IndirectionCount;
+    string_builder_reset(builder);
+    For(range(1000)) string_append(builder, u8"ab\u00e9");
+    assert_eq(builder.IndirectionCount, indirections);
+}
+
+TEST(stack_string_writer) {
+    // Fits on the stack, allocated once at the exact size
+    stack_string_writer w;
+    write(&w, string(u8"Hello, w\u00f6rld!"));
+    assert_eq(w.StackCount, 14);
+    assert_eq(w.Heap.Allocated, 0);
+
+    string small = stack_string_writer_combine(w);
+    defer(free(small));
+    assert_eq(small, u8"Hello, w\u00f6rld!");
+    assert_eq(small.Length, 13);
+    assert_eq(small.Allocated, 14);
+
+    // Spills to the heap and keeps growing
+    For(range(300)) write(&w, string(u8"ab\u00e9"));
+    assert_gt(w.Heap.Allocated, 0);
+
+    string big = stack_string_writer_combine(w);
+    defer(free(big));
+    assert_eq(big.Count, 1200);
+    assert_eq(big.Length, 900);
+    For(range(300)) assert_eq(substring(big, it * 3, it * 3 + 3), u8"ab\u00e9");
+
+    // sprint goes through it
+    string formatted = sprint("{} + {} = {}", 1, 2, 3);
+    defer(free(formatted));
+    assert_eq(formatted, "1 + 2 = 3");
+    assert_eq(formatted.Allocated, 9);
+}
+
 TEST(remove_all) {
     string a = "Hello world!";
     string b = a;
@@ -374,3 +608,305 @@ TEST(find) {
 
     assert_eq(-1, find_any_of(a, "QRT"));
 }
+
+TEST(find_long) {
+    // Long enough for the SIMD searches, with non-ASCII text so byte offsets differ from code point indices
+    string s;
+    defer(free(s));
+    For(range(40)) string_append(s, u8"\u0431\u0432 word, ");  // 11 bytes, 9 code points
+    string_append(s, "needle; end");
+
+    assert_eq(find_substring(s, "needle"), 40 * 9);
+    assert_eq(find_substring(s, "needle", 100), 40 * 9);
+    assert_eq(find_substring(s, "needles"), -1);
+    assert_eq(find_cp(s, ';'), 40 * 9 + 6);
+    assert_eq(find_cp(s, 0x432), 1);
+    assert_eq(find_cp(s, 0x432, 2), 10);
+
+    assert_eq(find_any_of(s, ";!?"), 40 * 9 + 6);
+    assert_eq(find_any_of(s, ",;", 5), 7);
+    assert_eq(find_any_of(s, "xyz"), -1);
+    assert_eq(find_not_any_of(s, u8"\u0431"), 1);
+    assert_eq(find_not_any_of(s, "word, ", 2), 9);
+}
+
+TEST(cpu_fallbacks) {
+    string s;
+    defer(free(s));
+    For(range(40)) string_append(s, u8"\u0431\u0432 word, ");
+    string_append(s, "needle; end");
+
+    // Run the same searches with every SIMD path turned off, then with everything the CPU has
+    For(range(2)) {
+        if (it == 0) cpu_features_override({});
+        if (it == 1) cpu_features_reset();
+
+        assert_eq(utf8_length(s.Data, s.Count), 40 * 9 + 11);
+        assert_true(is_valid_utf8(s.Data, s.Count));
+        assert_eq(find_substring(s, "needle"), 40 * 9);
+        assert_eq(find_any_of(s, ";!?"), 40 * 9 + 6);
+        assert_eq(find_not_any_of(s, "word, ", 2), 9);
+
+        string copy;
+        defer(free(copy));
+        clone(&copy, s);
+        assert_eq(copy, s);
+    }
+}
+
+TEST(compare_long) {
+    string a, b;
+    defer(free(a));
+    defer(free(b));
+    For(range(20)) string_append(a, u8"key \u0431\u0432 ");  // 9 bytes, 7 code points
+    clone(&b, a);
+
+    assert_true(a == b);
+    assert_eq(compare(a, b), -1);
+    assert_eq(compare_lexicographically(a, b), 0);
+
+    string_set(b, 7 * 15 + 5, 0x433);  // The second byte of \u0432 changes
+    assert_false(a == b);
+    assert_eq(compare(a, b), 7 * 15 + 5);
+    assert_eq(compare_lexicographically(a, b), -1);
+    assert_eq(compare_lexicographically(b, a), 1);
+
+    // A prefix
+    string prefix = substring(a, 0, 7 * 19);
+    assert_false(prefix == a);
+    assert_eq(compare(prefix, a), 7 * 19 - 1);
+    assert_eq(compare_lexicographically(prefix, a), -1);
+    assert_true(match_beginning(a, prefix));
+    assert_true(match_end(a, substring(a, 7, a.Length)));
+}
+
+TEST(case_conversion) {
+    string s;
+    defer(free(s));
+    For(range(10)) string_append(s, u8"Hello, World! \u0391\u03B2 ");  // 19 bytes, 17 code points
+
+    string upper;
+    defer(free(upper));
+    clone(&upper, s);
+    string_to_upper(upper);
+    assert_eq(substring(upper, 0, 17), u8"HELLO, WORLD! \u0391\u0392 ");
+    assert_eq(upper.Length, s.Length);
+
+    string lower;
+    defer(free(lower));
+    clone(&lower, s);
+    string_to_lower(lower);
+    assert_eq(substring(lower, -17, lower.Length), u8"hello, world! \u03B1\u03B2 ");
+
+    assert_eq(compare_ignore_case(upper, lower), -1);
+    assert_eq(compare_ignore_case(upper, s), -1);
+    assert_eq(compare_lexicographically_ignore_case(upper, lower), 0);
+
+    string_set(lower, 8 * 17 + 1, 'x');  // 'e' in the 9th copy
+    assert_eq(compare_ignore_case(upper, lower), 8 * 17 + 1);
+    assert_eq(compare_lexicographically_ignore_case(upper, lower), -1);
+    assert_eq(compare_lexicographically_ignore_case(lower, upper), 1);
+
+    // Converting a view copies it first
+    string view = "abcdefghijklmnopqrstuvwxyz";
+    string_to_upper(view);
+    defer(free(view));
+    assert_eq(view, "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+}
+
+TEST(hashed_string) {
+    hashed_string a = "symbol";
+    hashed_string b = string("symbol");
+    hashed_string c = "symbols";
+
+    assert_eq(a.Hash, get_hash(string("symbol")));
+    assert_true(a == b);
+    assert_false(a == c);
+
+    // Short (one-shot path) and long strings must hash the same as the streaming hasher
+    string long_ = "a string which is definitely longer than one stripe of the hasher";
+    For_as(length, range(long_.Count)) {
+        hasher h(0);
+        h.add((const char *) long_.Data, length);
+        assert_eq(hash_bytes(long_.Data, length), h.hash());
+    }
+
+    hash_table<hashed_string, s32> t;
+    defer(free(t));
+
+    add(t, a, 1);
+    add(t, c, 2);
+    assert_eq(*find(t, b).Value, 1);
+    assert_eq(*find_prehashed(t, c.Hash, c).Value, 2);
+}
+
+TEST(hash_bytes) {
+    assert_eq(hash_bytes("", 0), 0x2D06800538D394C2ull);  // XXH3_64bits of an empty input
+
+    // Every length through the short paths and a few blocks, fed to the streaming hasher in uneven chunks
+    byte data[3000];
+    For(range(3000)) data[it] = (byte) (it * 31 + 7);
+
+    for (s64 length = 0; length < 3000; length += 13) {
+        hasher h(42);
+        for (s64 i = 0; i < length; i += 100) h.add((const char *) data + i, min((s64) 100, length - i));
+        assert_eq(h.hash(), hash_bytes(data, length, 42));
+    }
+}
+
+TEST(string_pool) {
+    string_pool pool;
+    defer(free(pool));
+
+    string name = "position";
+    auto a = intern(pool, "position");
+    auto b = intern(pool, name);
+    auto c = intern(pool, "velocity");
+
+    assert_true(a == b);
+    assert_true(a != c);
+    assert_eq(count(pool), 2);
+    assert_eq(a.Hash, (u32) (get_hash(name) >> 32));
+
+    // The pool has its own copy, zero terminated
+    string s = get_string(pool, a);
+    assert_eq(s, name);
+    assert_true(s.Data != name.Data);
+    assert_eq(s.Data[s.Count], '\0');
+
+    assert_true(find_interned(pool, "velocity") == c);
+    assert_eq(find_interned(pool, "scale").ID, 0);
+    assert_eq(count(pool), 2);
+
+    assert_eq(intern(pool, "").ID, 0);
+    assert_eq(get_string(pool, {}), "");
+
+    // Big strings get their own block
+    string big = string((utf32) 'x', STRING_POOL_CHUNK_SIZE);
+    defer(free(big));
+    assert_eq(get_string(pool, intern(pool, big)), big);
+}
+
+TEST(rope) {
+    rope r;
+    defer(free(r));
+
+    rope_append(r, "Hello world");
+    rope_insert_at(r, 5, ",");
+    rope_insert_at(r, -5, "big ");
+    assert_eq(rope_length(r), 16);
+    assert_eq(rope_get(r, 5), ',');
+    assert_eq(rope_get(r, -1), 'd');
+
+    string s = rope_to_string(r);
+    assert_eq(s, "Hello, big world");
+    free(s);
+
+    rope_remove_range(r, 5, 10);
+    s = rope_to_string(r);
+    assert_eq(s, "Hello world");
+    free(s);
+
+    // Big inserts span many chunks, code points are never split
+    string big = string(U'ж', 3 * ROPE_CHUNK_SIZE);
+    defer(free(big));
+
+    rope_insert_at(r, 6, big);
+    assert_eq(rope_length(r), 11 + big.Length);
+    assert_eq(rope_count(r), 11 + big.Count);
+    assert_eq(rope_get(r, 6 + big.Length / 2), U'ж');
+    assert_eq(rope_get(r, 6 + big.Length), 'w');
+
+    rope_remove_range(r, 6, 6 + big.Length);
+
+    rope copy;
+    defer(free(copy));
+    clone(&copy, r);
+
+    string_builder_writer w;
+    defer(free(w));
+    write(&w, copy);
+
+    s = string_builder_combine(w.Builder);
+    assert_eq(s, "Hello world");
+    free(s);
+}
+
+TEST(string_builder) {
+    string_builder builder;
+    defer(free(builder));
+
+    // 1 MiB in 100 byte appends, the buffers double so there are only a few of them
+    utf8 chunk[100];
+    For(range(100)) chunk[it] = 'a' + it % 26;
+
+    For(range(10486)) string_append(builder, chunk, 100);
+    assert_eq(builder.Count, 1048600);
+    assert_true(builder.IndirectionCount <= 11);
+
+    string s = string_builder_combine(builder);
+    assert_eq(s.Count, 1048600);
+    assert_eq(s[1048599], chunk[99]);
+    free(s);
+
+    // After a reset the buffers are reused, a reserve which fits in them doesn't allocate
+    string_builder_reset(builder);
+    s64 indirections = builder.IndirectionCount;
+    string_builder_reserve(builder, 1_MiB);
+    assert_eq(builder.IndirectionCount, indirections);
+
+    // More than that takes exactly one allocation
+    string_builder_reserve(builder, 8_MiB);
+    assert_eq(builder.IndirectionCount, indirections + 1);
+
+    For(range(8_MiB / 100)) string_append(builder, chunk, 100);
+    assert_eq(builder.IndirectionCount, indirections + 1);
+}
+
+TEST(shared_buffer) {
+    string text = u8"Здравей, свят";
+    shared_buffer a = make_shared_buffer(text);
+    defer(free(a));
+
+    assert_eq(shared_buffer_ref_count(a), 1);
+    assert_eq(a.count(), text.Count);
+
+    // A view of the same bytes, with the length carried over
+    string view = a;
+    assert_eq(view, text);
+    assert_eq(view.Length, text.Length);
+    assert_true(view.Data != text.Data);
+    assert_eq(view.Data[view.Count], '\0');
+
+    shared_buffer b;
+    clone(&b, a);
+    assert_eq(shared_buffer_ref_count(a), 2);
+    assert_true(b.data() == a.data());
+    assert_true(a == b);
+
+    free(b);
+    assert_true(!b.Header);
+    assert_eq(shared_buffer_ref_count(a), 1);
+
+    // Binary contents get their length computed when a string view is asked for
+    byte raw[] = {'a', 'b', 0xD0, 0x97, 'c'};
+    shared_buffer c = make_shared_buffer(raw, 5);
+    defer(free(c));
+    assert_eq(c.Header->Length, -1);
+    assert_eq(((string) c).Length, 4);
+
+    bytes view2 = c;
+    assert_eq(view2.Count, 5);
+    assert_eq(view2[2], 0xD0);
+
+    auto fill = [](byte *data) { For(range(4)) data[it] = (byte) ('w' + it); };
+    shared_buffer d = make_shared_buffer(4, &fill);
+    defer(free(d));
+    assert_eq((string) d, "wxyz");
+    assert_false(c == d);
+
+    shared_buffer empty;
+    assert_eq((string) empty, "");
+    assert_eq(shared_buffer_ref_count(empty), 0);
+    free(empty);
+}
@@ -1,3 +1,15 @@
+#include <lstd/atomic.h>
+#include <lstd/fiber.h>
+#include <lstd/io/socket_reader.h>
+#include <lstd/io/socket_writer.h>
+#include <lstd/io/string_writer.h>
+#include <lstd/job_system.h>
+#include <lstd/memory/reclaim.h>
+#include <lstd/metrics.h>
+#include <lstd/profiler.h>
+#include <lstd/task.h>
+#include <lstd/timer_wheel.h>
+
 #include "../test.h"
 
 TEST(hardware_concurrency) {
@@ -5,6 +17,33 @@ TEST(hardware_concurrency) {
     For(range(45)) print(" ");
 }
 
+TEST(cpu_topology) {
+    auto *t = os_get_cpu_topology();
+    assert_eq(t->ProcessorCount, min((s64) os_get_hardware_concurrency(), MAX_LOGICAL_PROCESSORS));
+    assert_le(t->CoreCount, t->ProcessorCount);
+    assert_ge(t->PackageCount, 1);
+    assert_ge(t->NumaNodeCount, 1);
+
+    For(range(t->ProcessorCount)) {
+        auto &p = t->Processors[it];
+        assert_lt((s64) p.Core, t->CoreCount);
+        assert_lt((s64) p.Package, t->PackageCount);
+        assert_lt((s64) p.NumaNode, t->NumaNodeCount);
+    }
+
+    // Pin a thread (not this one) to the last processor and the first node
+    auto pinned = [&](void *) {
+        assert_true(thread::set_current_affinity((u32) t->ProcessorCount - 1));
+        assert_true(thread::set_current_numa_node_affinity(t->Processors[0].NumaNode));
+        assert_true(thread::set_current_priority(thread::priority::Low));
+        assert_false(thread::set_current_affinity((u32) t->ProcessorCount));  // Out of range
+    };
+
+    thread::thread t1;
+    t1.init_and_launch(&pinned);
+    t1.wait();
+}
+
 file_scope void thread_ids(void *) { print("\t\tMy thread id is {}.\n", Context.ThreadID); }
 
 TEST(ids) {
@@ -117,6 +156,119 @@ TEST(fast_mutex_lock) {
     assert_eq(Count, 100 * 10000);
 }
 
+file_scope thread::shared_mutex SharedMutex;
+file_scope s64 SharedPair[2];  // Writers keep both equal, readers check that they are
+
+file_scope void thread_shared_reader_writer(void *data) {
+    bool writer = data != null;
+    For(range(10000)) {
+        if (writer && it % 10 == 0) {
+            thread::scoped_lock _(&SharedMutex);
+            ++SharedPair[0];
+            ++SharedPair[1];
+        } else {
+            thread::shared_lock _(&SharedMutex);
+            if (SharedPair[0] != SharedPair[1]) atomic_inc(&Count);
+        }
+    }
+}
+
+TEST(lock_profile) {
+    auto loc = source_location::current();
+
+    // Locks made at the same place share a record
+    auto *p = internal::lock_profile_get(loc, "test_lock");
+    assert_true(p);
+    assert_eq(p, internal::lock_profile_get(loc, "test_lock"));
+    assert_false(p == internal::lock_profile_get(loc, "other_lock"));
+
+    internal::lock_profile_acquired(p);
+    internal::lock_profile_waited(p, internal::lock_profile_now() - 1000);
+    assert_eq(p->Acquisitions, 2);
+    assert_eq(p->Contended, 1);
+    assert_ge(p->WaitNs, 1000);
+    assert_ge(p->MaxWaitNs, 1000);
+
+    thread::lock_profile_reset();
+    assert_eq(p->Acquisitions, 0);
+
+#if defined LSTD_LOCK_PROFILING
+    thread::fast_mutex m;
+    assert_true(m.Profile);
+
+    For(range(10)) {
+        m.lock();
+        m.unlock();
+    }
+    assert_ge(m.Profile->Acquisitions, 10);
+#endif
+}
+
+TEST(shared_mutex) {
+    Count = 0;
+    SharedPair[0] = SharedPair[1] = 0;
+
+    SharedMutex.init();
+    defer(SharedMutex.release());
+
+    array<thread::thread> threads;
+    defer(free(threads));
+    For(range(16)) {
+        array_append(threads)->init_and_launch(thread_shared_reader_writer, it % 4 == 0 ? (void *) 1 : null);
+    }
+
+    For(threads) {
+        it.wait();
+    }
+
+    assert_eq(Count, 0);  // No reader saw a half done write
+    assert_eq(SharedPair[0], 4 * 1000);
+}
+
+file_scope padded_atomic<s64> AtomicCounters[4];
+file_scope atomic<s64> AtomicMax;
+
+file_scope void thread_atomic_counters(void *data) {
+    s64 index = (s64) data;
+    For(range(10000)) {
+        AtomicCounters[index % 4].fetch_add(1, memory_order::Relaxed);
+
+        // A CAS loop which keeps the biggest value seen
+        s64 value = index * 10000 + it;
+        s64 seen  = AtomicMax.load(memory_order::Relaxed);
+        while (seen < value && !AtomicMax.compare_exchange(seen, value, memory_order::AcquireRelease)) {
+        }
+    }
+}
+
+TEST(atomic) {
+    assert_eq(sizeof(AtomicCounters), 4 * CACHE_LINE_SIZE);
+    assert_eq((u64) &AtomicCounters[1] % CACHE_LINE_SIZE, 0);
+
+    For(AtomicCounters) it.store(0);
+    AtomicMax.store(0);
+
+    array<thread::thread> threads;
+    defer(free(threads));
+    For(range(8)) {
+        array_append(threads)->init_and_launch(thread_atomic_counters, (void *) it);
+    }
+
+    For(threads) {
+        it.wait();
+    }
+
+    For(AtomicCounters) assert_eq(it.load(memory_order::Acquire), 2 * 10000);
+    assert_eq(AtomicMax.load(), 7 * 10000 + 9999);
+
+    atomic<u32> flags = 0b0101;
+    assert_eq(flags.fetch_or(0b0010), 0b0101u);
+    assert_eq(flags.fetch_and(0b0011), 0b0111u);
+    assert_eq(flags.exchange(9), 0b0011u);
+    assert_eq(flags.fetch_sub(4), 9u);
+    assert_eq(flags.load(), 5u);
+}
+
 file_scope thread::condition_variable Cond;
 
 file_scope void thread_condition_notifier(void *) {
@@ -160,6 +312,89 @@ TEST(condition_variable) {
     Mutex.release();
 }
 
+file_scope void thread_condition_delayed_notifier(void *) {
+    thread::sleep(20);
+    Mutex.lock();
+    Count = 1;
+    Cond.notify_one();
+    Mutex.unlock();
+}
+
+TEST(condition_variable_timed) {
+    Count = 0;
+
+    Mutex.init();
+    defer(Mutex.release());
+    Cond.init();
+    defer(Cond.release());
+
+    Mutex.lock();
+    time_t start = os_get_time();
+    assert_false(Cond.wait_for(&Mutex, 10));  // Nobody notifies
+    assert_ge(os_time_to_seconds(os_get_time() - start), 0.009);
+
+    thread::thread t;
+    t.init_and_launch(thread_condition_delayed_notifier);
+    while (!Count) Cond.wait_for(&Mutex, 1000);
+    Mutex.unlock();
+
+    t.wait();
+    assert_eq(Count, 1);
+}
+
+TEST(semaphore_latch_barrier) {
+    array<thread::thread> threads;
+    defer(free(threads));
+
+    // Semaphore: the threads block until we hand out units
+    thread::semaphore units;
+    s32 taken = 0;
+
+    auto taker = [&](void *) {
+        units.wait();
+        atomic_inc(&taken);
+    };
+    For(range(8)) array_append(threads)->init_and_launch(&taker);
+
+    units.signal(8);
+    For(threads) it.wait();
+    threads.Count = 0;
+
+    assert_eq(taken, 8);
+    assert_false(units.try_wait());
+    assert_false(units.wait_for(10));  // Nobody signals
+
+    // Latch: count down from many threads, wait once
+    thread::latch done(8);
+    auto counter = [&](void *) { done.count_down(); };
+    For(range(8)) array_append(threads)->init_and_launch(&counter);
+
+    done.wait();
+    assert_true(done.try_wait());
+    For(threads) it.wait();
+    threads.Count = 0;
+
+    // Barrier: every thread sees all increments of a phase before anyone starts the next one
+    constexpr s32 THREADS = 4, PHASES = 1000;
+
+    thread::barrier step(THREADS);
+    s32 sum = 0, serial = 0;
+
+    auto stepper = [&](void *) {
+        For(range(PHASES)) {
+            atomic_inc(&sum);
+            if (step.arrive_and_wait()) ++serial;  // The one thread which got true, the others wait below
+            assert_eq(atomic_load(&sum), (s32) (it + 1) * THREADS);
+            step.arrive_and_wait();
+        }
+    };
+    For(range(THREADS)) array_append(threads)->init_and_launch(&stepper);
+    For(threads) it.wait();
+
+    assert_eq(sum, THREADS * PHASES);
+    assert_eq(serial, PHASES);
+}
+
 TEST(context) {
     auto *old = Context.Alloc.Function;
 
@@ -182,3 +417,802 @@ TEST(context) {
     }
     assert_eq((void *) Context.Alloc.Function, (void *) old);
 }
+
+TEST(context_inherit) {
+    allocator differentAlloc = {};
+
+    array<thread::thread> threads;
+    defer(free(threads));
+
+    auto newContext                = Context;
+    newContext.Alloc               = differentAlloc;
+    newContext.FmtDisableAnsiCodes = !Context.FmtDisableAnsiCodes;
+
+    bool defaultAnsi = Context.FmtDisableAnsiCodes;
+
+    auto allocatorOnly = [&](void *) {
+        assert_eq((void *) Context.Alloc.Function, (void *) differentAlloc.Function);
+        assert_eq(Context.FmtDisableAnsiCodes, false);  // Not inherited, the default
+    };
+
+    auto everything = [&](void *) {
+        assert_eq((void *) Context.Alloc.Function, (void *) differentAlloc.Function);
+        assert_eq(Context.FmtDisableAnsiCodes, !defaultAnsi);
+    };
+
+    // The threads copy our Context at launch, so it doesn't matter that it's restored before they run.
+    // Launching more than once also reuses the start records of the threads which finished.
+    For(range(20)) {
+        PUSH_CONTEXT(newContext) {
+            array_append(threads)->init_and_launch(&allocatorOnly, null, thread::THREAD_INHERIT_ALLOCATOR);
+            array_append(threads)->init_and_launch(&everything);
+        }
+    }
+
+    For(threads) it.wait();
+}
+
+file_scope async_log_writer AsyncLog;
+
+file_scope void thread_async_log(void *id) {
+    For(range(1000)) fmt_to_writer(&AsyncLog, "{} {}\n", (s64) id, it);
+}
+
+TEST(async_log_writer) {
+    string_builder_writer out;
+    defer(free(out));
+
+    // Small buffers so the writers have to wait for the background thread
+    async_log_writer_init(AsyncLog, &out, 1_KiB);
+
+    thread::thread threads[4];
+    For(range(4)) threads[it].init_and_launch(thread_async_log, (void *) it);
+    For(range(4)) threads[it].wait();
+
+    async_log_writer_drain(AsyncLog);
+    assert_eq(AsyncLog.Dropped, 0);
+    free(AsyncLog);
+
+    string result = string_builder_combine(out.Builder);
+    defer(free(result));
+
+    // Every line arrived whole and the lines of each thread are in order
+    s64 next[4] = {};
+    s64 lines   = 0;
+
+    const utf8 *p = result.Data, *end = result.Data + result.Count;
+    while (p != end) {
+        s64 id = *p++ - '0';
+        assert_eq(*p++, ' ');
+
+        s64 n = 0;
+        while (*p != '\n') n = n * 10 + (*p++ - '0');
+        ++p;
+
+        assert_eq(n, next[id]++);
+        ++lines;
+    }
+    assert_eq(lines, 4000);
+
+    // With DROP a record which doesn't fit is thrown away as a whole
+    string_builder_writer dropOut;
+    defer(free(dropOut));
+
+    async_log_writer_init(AsyncLog, &dropOut, 64, async_log_policy::DROP);
+    fmt_to_writer(&AsyncLog, "{}\n", "This line is longer than the 64 bytes the buffer of each thread has room for");
+    fmt_to_writer(&AsyncLog, "fits\n");
+    async_log_writer_drain(AsyncLog);
+    assert_eq(AsyncLog.Dropped, 1);
+    free(AsyncLog);
+
+    string dropped = string_builder_combine(dropOut.Builder);
+    defer(free(dropped));
+    assert_eq(dropped, "fits\n");
+}
+
+// Records of 4 to 100 bytes, so they wrap around the end of the ring buffers at every offset
+file_scope const s64 ASYNC_LOG_STRESS_RECORDS = 100000;
+
+file_scope void thread_async_log_stress(void *id) {
+    utf8 padding[64];
+    fill_memory(padding, 'x', sizeof(padding));
+
+    For(range(ASYNC_LOG_STRESS_RECORDS)) fmt_to_writer(&AsyncLog, "{} {} {}\n", (s64) id, it, string(padding, it % 64));
+}
+
+// Checks that every line is whole and that the lines of each thread are in order. Returns how many lines there were.
+// With _consecutive_ no line may be missing.
+file_scope s64 check_async_log_stress_output(const string &result, bool consecutive) {
+    s64 next[4] = {};
+    s64 lines   = 0;
+
+    const utf8 *p = result.Data, *end = result.Data + result.Count;
+    while (p != end) {
+        s64 id = *p++ - '0';
+        assert_true(id >= 0 && id < 4);
+        assert_eq(*p++, ' ');
+
+        s64 n = 0;
+        while (*p != ' ') n = n * 10 + (*p++ - '0');
+        ++p;
+
+        s64 padding = 0;
+        while (*p == 'x') ++padding, ++p;
+        assert_eq(*p++, '\n');
+        assert_eq(padding, n % 64);
+
+        if (consecutive) {
+            assert_eq(n, next[id]);
+        } else {
+            assert_true(n >= next[id]);
+        }
+        next[id] = n + 1;
+        ++lines;
+    }
+    return lines;
+}
+
+TEST(async_log_writer_stress) {
+    // BLOCK: nothing is lost or reordered even though the buffers are always full
+    {
+        string_builder_writer out;
+        defer(free(out));
+
+        thread::thread threads[4];
+        async_log_writer_init(AsyncLog, &out, 256);
+
+        For(range(4)) threads[it].init_and_launch(thread_async_log_stress, (void *) it);
+        For(range(4)) threads[it].wait();
+
+        async_log_writer_drain(AsyncLog);
+        assert_eq(AsyncLog.Dropped, 0);
+        free(AsyncLog);
+
+        string result = string_builder_combine(out.Builder);
+        defer(free(result));
+        assert_eq(check_async_log_stress_output(result, true), 4 * ASYNC_LOG_STRESS_RECORDS);
+    }
+
+    // DROP: the records which arrive are whole and in order, and together with the dropped ones they are all of them
+    {
+        string_builder_writer out;
+        defer(free(out));
+
+        thread::thread threads[4];
+        async_log_writer_init(AsyncLog, &out, 256, async_log_policy::DROP);
+
+        For(range(4)) threads[it].init_and_launch(thread_async_log_stress, (void *) it);
+        For(range(4)) threads[it].wait();
+
+        async_log_writer_drain(AsyncLog);
+        s64 dropped = AsyncLog.Dropped;
+        free(AsyncLog);
+
+        string result = string_builder_combine(out.Builder);
+        defer(free(result));
+        assert_eq(check_async_log_stress_output(result, false) + dropped, 4 * ASYNC_LOG_STRESS_RECORDS);
+    }
+}
+
+file_scope void thread_channel_send(void *data) {
+    auto ch = os_channel_open("lstd_test_channel");
+    defer(free(ch));
+
+    For(range(10000)) {
+        bool sent = os_channel_send(ch, &it, sizeof(it));
+        assert(sent);
+    }
+}
+
+TEST(os_channel) {
+    // Small, so the sender fills it and has to wait for us
+    auto ch = os_channel_create("lstd_test_channel", 16, 64);
+    defer(free(ch));
+    assert_true(ch.Header);
+    assert_eq(os_channel_message_size(ch), 64);
+
+    // Nothing sent yet
+    byte buffer[64];
+    assert_eq(os_channel_receive(ch, buffer, 0), -1);
+
+    // The other end is opened by name, in another process it works the same
+    thread::thread sender;
+    sender.init_and_launch(thread_channel_send, null);
+
+    For(range(10000)) {
+        assert_eq(os_channel_receive(ch, buffer), (s64) sizeof(s64));
+        assert_eq(*(s64 *) buffer, it);
+    }
+    sender.wait();
+}
+
+TEST(clock) {
+    s64 a = os_get_timestamp_ns();
+    thread::sleep(20);
+    s64 b = os_get_timestamp_ns();
+
+    // Sleeps are never shorter, and a loaded machine can make them a lot longer
+    assert_ge(b - a, 19000000);
+    assert_lt(b - a, 2000000000);
+
+    // Agrees with the OS clock
+    time_t t0 = os_get_time();
+    u64 c0    = os_read_cycle_counter();
+    thread::sleep(20);
+    s64 osElapsed    = os_time_to_nanoseconds(os_get_time() - t0);
+    s64 cycleElapsed = os_clock_uses_cycle_counter() ? os_cycles_to_nanoseconds(os_read_cycle_counter() - c0) : osElapsed;
+    assert_lt(abs(cycleElapsed - osElapsed), osElapsed / 20);
+
+    os_coarse_clock_start();
+    s64 coarse = os_get_coarse_timestamp_ns();
+    thread::sleep(50);
+    assert_gt(os_get_coarse_timestamp_ns(), coarse);
+    os_coarse_clock_stop();
+}
+
+file_scope void job_add(void *data) { atomic_inc((s64 *) data); }
+
+// Spawns more jobs from inside a job, so workers push to their own deques and steal from each other
+file_scope void job_spawn(void *data) {
+    job_counter inner;
+    For(range(100)) job_run(job_add, data, &inner);
+    job_wait(&inner);
+}
+
+file_scope s64 JobDependencySeen;
+
+file_scope void job_check_dependency(void *data) { JobDependencySeen = atomic_load((s64 *) data); }
+
+TEST(job_system) {
+    job_system_init(4);
+    defer(job_system_release());
+
+    assert_eq(job_system_worker_count(), 4);
+    assert_eq(job_system_worker_index(), -1);
+
+    s64 sum = 0;
+
+    job_counter done;
+    For(range(50)) job_run(job_spawn, &sum, &done);
+
+    // Runs only after all of the above (and the jobs they spawned, since they wait for them)
+    job_counter after;
+    job_run(job_check_dependency, &sum, &after, &done);
+
+    job_wait(&done);
+    job_wait(&after);
+    assert_eq(sum, 5000);
+    assert_eq(JobDependencySeen, 5000);
+
+    s64 total = 0;
+    job_parallel_for(100000, 1000, [&](s64 begin, s64 end) {
+        s64 local = 0;
+        For(range(begin, end)) local += it;
+        atomic_add(&total, local);
+    });
+    assert_eq(total, (s64) 100000 * 99999 / 2);
+}
+
+TEST(parallel_for_reduce) {
+    job_system_init(4);
+    defer(job_system_release());
+
+    array<s64> values;
+    defer(free(values));
+    For(range(10000)) array_append(values, it);
+
+    parallel_for(values, 0, [](s64 &v, s64 index) { v *= 2; });
+    assert_eq(values[9999], 19998);
+
+    s64 sum = parallel_reduce(values, 0, (s64) 0, [](s64 acc, s64 v) { return acc + v; }, [](s64 a, s64 b) { return a + b; });
+    assert_eq(sum, (s64) 9999 * 10000);
+
+    // Steps and negative ranges, and a grain which doesn't divide the count
+    s64 odd = parallel_reduce(range(1, 1000, 2), 7, (s64) 0, [](s64 acc, s64 it) { return acc + it; }, [](s64 a, s64 b) { return a + b; });
+    assert_eq(odd, (s64) 500 * 500);
+
+    s64 down = parallel_reduce(range(10, 0, -1), 3, (s64) 0, [](s64 acc, s64 it) { return acc + it; }, [](s64 a, s64 b) { return a + b; });
+    assert_eq(down, 55);
+
+    s64 touched = 0;
+    parallel_for(range(0, 100, 5), 1, [&](s64 it) { atomic_add(&touched, it); });
+    assert_eq(touched, 950);
+
+    hash_table<s64, s64> table;
+    defer(free(table));
+    For(range(10000)) add(table, it, it);
+    For(range(0, 10000, 3)) remove(table, it);
+
+    s64 entries = 0, tableSum = 0;
+    parallel_for(table, 100, [&](s64 key, s64 &value) {
+        value = -key;
+        atomic_inc(&entries);
+        atomic_add(&tableSum, key);
+    });
+    assert_eq(entries, table.Count);
+    assert_eq(tableSum, (s64) 9999 * 10000 / 2 - (s64) 3 * 3333 * 3334 / 2);
+    For(table) assert_eq(*it.Value, -*it.Key);
+}
+
+file_scope void fiber_ping(void *data) {
+    auto **fibers = (fiber **) data;
+    For(range(3)) {
+        atomic_inc((s64 *) fibers[2]);
+        fiber_switch(fibers[1], fibers[0]);
+    }
+    while (true) fiber_switch(fibers[1], fibers[0]);
+}
+
+TEST(fiber_switch) {
+    fiber self, other;
+    fiber_convert_thread(&self);
+    defer(fiber_revert_thread(&self));
+
+    s64 count = 0;
+    fiber *fibers[3] = {&self, &other, (fiber *) &count};
+    assert(fiber_create(&other, fiber_ping, fibers));
+    defer(fiber_release(&other));
+
+    For(range(3)) {
+        fiber_switch(&self, &other);
+        assert_eq(count, it + 1);
+    }
+}
+
+TEST(job_system_fibers) {
+    job_system_init(4, true);
+    defer(job_system_release());
+
+    // Every job_spawn waits on its own counter, with fibers it's parked instead of running the others on its stack
+    s64 sum = 0;
+    job_counter done;
+    For(range(200)) job_run(job_spawn, &sum, &done);
+    job_wait(&done);
+    assert_eq(sum, 20000);
+
+    s64 total = 0;
+    job_parallel_for(10000, 100, [&](s64 begin, s64 end) { atomic_add(&total, end - begin); });
+    assert_eq(total, 10000);
+}
+
+file_scope task<s64> task_double(s64 x) { co_return x * 2; }
+
+file_scope task<s64> task_chain(s64 *sum) {
+    s64 a = co_await task_double(5);
+    s64 b = co_await task_double(a);
+
+    co_await task_switch_to_workers();
+
+    job_counter added;
+    For(range(100)) job_run(job_add, sum, &added);
+    co_await task_wait(&added);
+
+    s64 before = os_get_timestamp_ns();
+    co_await task_sleep(5);
+    assert_ge(os_get_timestamp_ns() - before, (s64) 5000000);
+
+    co_return a + b;
+}
+
+file_scope task<void> task_add(s64 *sum) {
+    co_await task_sleep(1);
+    atomic_inc(sum);
+}
+
+TEST(task) {
+    job_system_init(4);
+    defer(job_system_release());
+    defer(task_timers_stop());
+
+    s64 sum = 0;
+    assert_eq(task_sync_wait(task_chain(&sum)), 30);
+    assert_eq(sum, 100);
+
+    job_counter done;
+    For(range(50)) task_run(task_add(&sum), &done);
+    job_wait(&done);
+    assert_eq(sum, 150);
+}
+
+TEST(timer_wheel) {
+    timer_wheel w;
+    timer_wheel_init(w, 1000);  // 1 us ticks, we advance by hand
+
+    auto at = [&](s64 tick) { return w.StartNs + tick * 1000; };
+
+    // Deadlines on every level, spread so some share slots
+    constexpr s64 N = 2000;
+    timer timers[N];
+    s64 deadlines[N], fired[N];
+
+    s64 now = 0;
+    auto record = [&](timer *t) { *(s64 *) t->UserData = now; };
+
+    For(range(N)) {
+        deadlines[it] = 1 + (it * it * 7919) % 20000000;
+        fired[it]     = -1;
+
+        timers[it].UserData = fired + it;
+        timers[it].Callback = &record;
+        timer_add_at(w, timers + it, at(deadlines[it]));
+    }
+    assert_eq(w.Count, N);
+
+    For(range(0, N, 5)) assert_true(timer_cancel(w, timers + it));
+    assert_false(timer_cancel(w, timers));
+
+    // Uneven steps, every timer fires on the first advance which reaches its deadline
+    s64 step = 1;
+    while (w.Count) {
+        s64 before = now;
+        now += step;
+        step = step * 3 % 100003 + 1;
+        timer_wheel_advance(w, at(now));
+
+        For(range(N)) {
+            if (it % 5 == 0) continue;
+            if (deadlines[it] > before && deadlines[it] <= now) assert_eq(fired[it], now);
+        }
+    }
+    For(range(N)) {
+        if (it % 5 == 0) assert_eq(fired[it], -1);
+        assert_false(timer_is_pending(timers + it));
+    }
+
+    // A callback which adds its timer again
+    s64 repeats = 0;
+    auto repeat = [&](timer *t) {
+        if (++repeats < 3) timer_add_at(w, t, at(now + 10));
+    };
+
+    timer again;
+    again.Callback = &repeat;
+    timer_add_at(w, &again, at(now + 10));
+    For(range(40)) timer_wheel_advance(w, at(++now));
+    assert_eq(repeats, 3);
+
+    // Far away, placed again on the way without firing early
+    bool farFired = false;
+    auto fire = [&](timer *) { farFired = true; };
+
+    timer far;
+    far.Callback = &fire;
+    timer_add_at(w, &far, at(now + (1ll << 40)));
+    timer_wheel_advance(w, at(now + (1ll << 40) - 1));
+    assert_false(farFired);
+    timer_wheel_advance(w, at(now + (1ll << 40)));
+    assert_true(farFired);
+
+    timer_add(w, &far, 1000000000);
+    assert_eq(timer_wheel_expire_all(w), 1);
+    assert_eq(w.Count, 0);
+
+    // Callbacks as jobs
+    job_system_init(2);
+    defer(job_system_release());
+
+    w.RunOnJobs = true;
+
+    s64 sum = 0;
+    auto add = [&](timer *) { atomic_inc(&sum); };
+
+    timer jobs[8];
+    For(jobs) {
+        it.Callback = &add;
+        timer_add(w, &it, 0);
+    }
+    while (atomic_load(&sum) != 8) {
+        timer_wheel_advance(w);
+        thread::sleep(0);
+    }
+}
+
+// Constructs the zones directly, so it runs without LSTD_PROFILER too
+static const profile_zone_site ProfilerTestSite = {"test \"zone\"", __FILE__, __LINE__};
+
+static void profiler_record_zones() {
+    For(range(3000)) {  // More than a chunk
+        internal::profile_zone zone(&ProfilerTestSite);
+    }
+}
+
+TEST(profiler) {
+    profiler_reset();
+
+    { internal::profile_zone ignored(&ProfilerTestSite); }  // Not running yet
+    assert_eq(profiler_zone_count(), 0);
+
+    profiler_start();
+    profiler_set_thread_name("main");
+
+    thread::thread threads[3];
+    For(threads) it.init_and_launch(&profiler_record_zones);
+    profiler_record_zones();
+    For(threads) it.wait();
+
+    profiler_stop();
+    assert_eq(profiler_zone_count(), 4 * 3000);
+
+    string_builder_writer json;
+    defer(free(json));
+    profiler_write_chrome_trace(&json);
+
+    string jsonString = string_builder_combine(json.Builder);
+    defer(free(jsonString));
+    assert_eq(find_substring(jsonString, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+    assert_nq(find_substring(jsonString, "\"thread_name\""), -1);
+    assert_nq(find_substring(jsonString, "\"name\":\"test \\\"zone\\\"\",\"ph\":\"X\""), -1);
+
+    string_builder_writer binary;
+    defer(free(binary));
+    profiler_write_binary(&binary);
+
+    string binaryString = string_builder_combine(binary.Builder);
+    defer(free(binaryString));
+    assert_eq(find_substring(binaryString, "LSTDPROF"), 0);
+    assert_lt(binaryString.Count, jsonString.Count / 10);
+
+    profiler_reset();
+    assert_eq(profiler_zone_count(), 0);
+}
+
+file_scope s64 ReclaimFreed;
+file_scope void reclaim_test_free(void *block) {
+    atomic_inc(&ReclaimFreed);
+    general_free(block);
+}
+
+// Pops nodes from a shared stack and retires them while the other threads are still reading
+struct reclaim_test_node {
+    s64 Value;
+    reclaim_test_node *Next;
+};
+
+file_scope reclaim_test_node *ReclaimStack;
+
+file_scope void reclaim_test_worker(void *useHazards) {
+    For(range(1000)) {
+        if (useHazards) {
+            reclaim_test_node *node;
+            while (true) {
+                node = (reclaim_test_node *) hazard_protect(0, (void **) &ReclaimStack);
+                if (!node || atomic_compare_and_swap(&ReclaimStack, node->Next, node) == node) break;
+            }
+            hazard_clear(0);
+            hazard_retire(node, reclaim_test_free);
+        } else {
+            reclaim_test_node *node;
+            {
+                reclaim_guard _;
+                do {
+                    node = atomic_load(&ReclaimStack);
+                } while (node && atomic_compare_and_swap(&ReclaimStack, node->Next, node) != node);
+            }
+            reclaim_retire(node, reclaim_test_free);
+        }
+    }
+    reclaim_thread_release();
+}
+
+TEST(reclaim) {
+    For(range(2)) {
+        ReclaimFreed = 0;
+        For_as(i, range(4000)) {
+            auto *node = allocate<reclaim_test_node>({.Alloc = internal::platform_get_persistent_allocator()});
+            node->Value = i;
+            node->Next = ReclaimStack;
+            ReclaimStack = node;
+        }
+
+        thread::thread threads[4];
+        For_as(t, threads) t.init_and_launch(reclaim_test_worker, (void *) it);
+        For_as(t, threads) t.wait();
+        assert_false(ReclaimStack);
+
+        // What the threads couldn't free before they exited was handed over
+        reclaim_flush();
+        reclaim_flush();
+        reclaim_flush();
+        assert_eq(ReclaimFreed, 4000);
+    }
+
+    // A guard holds back blocks retired while it's active
+    ReclaimFreed = 0;
+    {
+        reclaim_guard _;
+        reclaim_retire(allocate<s64>(), reclaim_test_free);
+        reclaim_flush();
+        reclaim_flush();
+        assert_eq(ReclaimFreed, 0);
+    }
+    reclaim_flush();
+    reclaim_flush();
+    assert_eq(ReclaimFreed, 1);
+    reclaim_thread_release();
+}
+
+TEST(concurrent_arena) {
+    job_system_init(4);
+    defer(job_system_release());
+
+    concurrent_arena_allocator_data data;
+    data.PoolSize = 64_KiB;  // Small, so the workers add pools while they race
+    defer(concurrent_arena_release(&data));
+
+    allocator arena = {concurrent_arena_allocator, &data};
+
+    // Every element gets a block shared by the whole job group, filled with its index
+    s64 *blocks[2000];
+    parallel_for(range(2000), 16, [&](s64 it) {
+        s64 count = 1 + it % 50;
+        blocks[it] = allocate_array<s64>(count, {.Alloc = arena});
+        For_as(i, range(count)) blocks[it][i] = it;
+    });
+
+    // No two blocks overlap
+    For(range(2000)) {
+        For_as(i, range(1 + it % 50)) assert_eq(blocks[it][i], it);
+    }
+    assert_true(data.PoolsCount > 1);
+
+    free_all(arena);
+    assert_eq(data.TotalUsed, 0);
+
+    s64 *again = allocate<s64>({.Alloc = arena});
+    assert_true((byte *) again > (byte *) (data.Base + 1) && (byte *) again < (byte *) (data.Base + 1) + data.Base->Size);
+}
+
+file_scope task<void> socket_echo(net_poller *poller, net_socket *client) {
+    byte buffer[256];
+    while (true) {
+        s64 n = co_await task_recv(*poller, *client, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        if (co_await task_send(*poller, *client, buffer, n) < 0) break;
+    }
+}
+
+TEST(sockets) {
+    auto server = socket_listen("127.0.0.1", 0);
+    defer(free(server));
+    assert_true(server.Handle != -1);
+
+    u16 port = net_address_port(socket_get_address(server));
+    assert_true(port != 0);
+
+    net_socket client;
+    thread::thread connector;
+    connector.init_and_launch([&](void *) { client = socket_connect("127.0.0.1", port); });
+
+    auto accepted = socket_accept(server);
+    connector.wait();
+    assert_true(accepted.Handle != -1 && client.Handle != -1);
+
+    // Blocking, through the writer and reader. More than fits in the writer's buffer.
+    {
+        socket_writer out(client.Handle);
+        For(range(1000)) fmt_to_writer(&out, "line {}\n", it);
+        flush(&out);
+        assert_false(out.Failed);
+
+        socket_reader in(accepted.Handle);
+        defer(free(&in));
+
+        string line;
+        For(range(1000)) {
+            assert_true(read_line(&in, line));
+            assert_eq(line, tsprint("line {}", it));
+        }
+    }
+
+    // Event-driven, a coroutine echoes what the client sends
+    {
+        job_system_init(2);
+        defer(job_system_release());
+
+        net_poller poller;
+        assert_true(net_poller_init(poller));
+        defer(free(poller));
+
+        assert_true(net_poller_attach(poller, accepted));
+
+        job_counter done;
+        task_run(socket_echo(&poller, &accepted), &done);
+
+        byte message[1000];
+        For(range(1000)) message[it] = (byte) it;
+        assert_eq(socket_send(client, message, 1000), 1000);
+
+        byte echoed[1000];
+        s64 received = 0;
+        while (received < 1000) {
+            s64 n = socket_recv(client, echoed + received, 1000 - received);
+            assert_true(n > 0);
+            received += n;
+        }
+        assert_true(equal_memory(message, echoed, 1000));
+
+        // The other side sees the end of the input and the coroutine finishes
+        socket_shutdown_send(client);
+        job_wait(&done);
+
+        free(accepted);
+    }
+    free(client);
+
+    // UDP
+    auto a = socket_udp_open("127.0.0.1");
+    auto b = socket_udp_open("127.0.0.1");
+    defer(free(a));
+    defer(free(b));
+
+    assert_eq(socket_send_to(a, socket_get_address(b), (const byte *) "ping", 4), 4);
+
+    byte datagram[16];
+    net_address from;
+    assert_eq(socket_recv_from(b, datagram, sizeof(datagram), &from), 4);
+    assert_eq(string((const char *) datagram, 4), "ping");
+    assert_eq(net_address_port(from), net_address_port(socket_get_address(a)));
+}
+
+TEST(metrics) {
+    // Exact below the sub buckets, then 16 buckets per power of two
+    assert_eq(metric_histogram_bucket(-5), 0);
+    assert_eq(metric_histogram_bucket(15), 15);
+    assert_eq(metric_histogram_bucket(16), 16);
+    assert_eq(metric_histogram_bucket(33), 32);
+    assert_eq(metric_histogram_bucket(numeric_info<s64>::max()), METRIC_HISTOGRAM_BUCKETS - 1);
+    For(range(1, 100000, 997)) {
+        s64 b = metric_histogram_bucket(it);
+        assert_true(metric_histogram_bucket_lower_bound(b) <= it);
+        assert_true(metric_histogram_bucket_lower_bound(b + 1) > it);
+    }
+
+    static metric_counter requests;
+    static metric_gauge inFlight;
+    static metric_histogram latency;
+    assert_true(metric_register(requests, "test_requests_total", "Requests"));
+    assert_true(metric_register(inFlight, "test_in_flight"));
+    assert_true(metric_register(latency, "test_latency_ns", "Latency"));
+
+    For(range(1000)) metric_add(requests);
+    metric_add(requests, 24);
+    assert_eq(metric_get(requests), 1024);
+
+    metric_set(inFlight, 10);
+    metric_add(inFlight, -3);
+    assert_eq(metric_get(inFlight), 7);
+
+    For(range(1, 1001)) metric_record(latency, it);
+
+    auto s = metric_get(latency);
+    assert_eq(s.Count, 1000);
+    assert_eq(s.Sum, 500500);
+    assert_eq(s.Min, 1);
+    assert_eq(s.Max, 1000);
+
+    // Never below the real value, at most a bucket (1/16) above it
+    s64 p50 = metric_histogram_percentile(s, 50);
+    assert_true(p50 >= 500 && p50 <= 500 + 500 / 16);
+    assert_eq(metric_histogram_percentile(s, 100), 1000);
+    assert_eq(metric_histogram_percentile(s, 0), 1);
+
+    auto merged = s;
+    metric_histogram_merge(merged, s);
+    assert_eq(merged.Count, 2000);
+    assert_eq(metric_histogram_percentile(merged, 50), p50);
+
+    string_builder_writer out;
+    defer(free(out));
+    metrics_write_prometheus(&out);
+
+    string text = string_builder_combine(out.Builder);
+    defer(free(text));
+    assert_true(has(text, "# TYPE test_requests_total counter\ntest_requests_total 1024\n"));
+    assert_true(has(text, "test_in_flight 7\n"));
+    assert_true(has(text, "test_latency_ns_bucket{le=\"15\"} 15\n"));
+    assert_true(has(text, "test_latency_ns_bucket{le=\"+Inf\"} 1000\n"));
+    assert_true(has(text, "test_latency_ns_sum 500500\n"));
+
+    metric_reset(latency);
+    assert_eq(metric_get(latency).Count, 0);
+}
@@ -804,4 +804,173 @@ TEST(cross_nd) {
     auto d = abs(dot(a4, r4)) + abs(dot(b4, r4)) + abs(dot(c4, r4));
     assert_lt(d, 1e-5f);
 }
- 
\ No newline at end of file
+ 
+TEST(simd_backends) {
+    vec<s32, 4> a(1, -2, 3, 4), b(5, 6, -7, 8);
+    assert_eq(a + b, (vec<s32, 4>(6, 4, -4, 12)));
+    assert_eq(a * b, (vec<s32, 4>(5, -12, -21, 32)));
+    assert_eq(b / a, (vec<s32, 4>(5, -3, -2, 2)));
+    assert_eq(dot(a, b), 4);
+    assert_eq((vec<s32, 4>(a.wzyx)), (vec<s32, 4>(4, 3, -2, 1)));
+
+    vec<s64, 2> c(3000000000ll, -7), d(2, 3);
+    assert_eq(c * d, (vec<s64, 2>(6000000000ll, -21)));
+    assert_eq((vec<s64, 2>(c.yx)), (vec<s64, 2>(-7, 3000000000ll)));
+
+    vec<f64, 4> e(1, 2, 3, 4), f(0.5, 0.25, 2, -1);
+    assert_eq(dot(e, f), 3.0);
+    assert_eq(mul_add(e, f, e), (vec<f64, 4>(1.5, 2.5, 9, 0)));
+    assert_eq((vec<f64, 4>(e.wzyx)), (vec<f64, 4>(4, 3, 2, 1)));
+
+    vecf<8> g(1, 2, 3, 4, 5, 6, 7, 8);
+    assert_eq(dot(g, g), 204.0f);
+    assert_eq(mul_add(g, vecf<8>(2), vecf<8>(1)), (vecf<8>(3, 5, 7, 9, 11, 13, 15, 17)));
+}
+
+TEST(batch_kernels) {
+    // 19 isn't a multiple of any batch width, so the tails get tested too
+    constexpr s64 N = 19;
+
+    m44 m = {0.5f, 1, 0, 0, -1, 0.5f, 0, 0, 0, 0, 2, 0, 5, 6, 7, 1};
+
+    v3 a[N], b[N], r[N];
+    f32 x[N], y[N], z[N], rx[N], ry[N], rz[N], d[N];
+    For(range(N)) {
+        a[it] = v3((f32) it, 2.0f * it + 1, -(f32) it);
+        b[it] = v3(1.0f, (f32) it, 0.5f * it);
+        x[it] = a[it].x, y[it] = a[it].y, z[it] = a[it].z;
+    }
+
+    transform_points(a, r, N, m);
+    For(range(N)) assert_eq(r[it], approx_vec(v3(dot(v4(a[it], 1), m).xyz)));
+
+    transform_points(soa_v3_view(x, y, z), soa_v3{rx, ry, rz}, N, m);
+    For(range(N)) assert_eq(v3(rx[it], ry[it], rz[it]), approx_vec(r[it]));
+
+    transform_directions(a, r, N, m);
+    For(range(N)) assert_eq(r[it], approx_vec(v3(dot(v4(a[it], 0), m).xyz)));
+
+    cross(a, b, r, N);
+    For(range(N)) assert_eq(r[it], approx_vec(cross(a[it], b[it])));
+
+    dot(a, b, d, N);
+    For(range(N)) assert_eq(d[it], approx(dot(a[it], b[it])));
+
+    // In-place
+    normalize(a, a, N);
+    For(range(N)) assert_eq(len(a[it]), approx(1));
+
+    normalize(soa_v3_view(x, y, z), soa_v3{x, y, z}, N);
+    For(range(N)) assert_eq(v3(x[it], y[it], z[it]), approx_vec(a[it]));
+}
+
+TEST(simd_math) {
+    // 6 elements: one full lane and a padded one with SSE, a padded 256 bit lane with AVX
+    f64 angles[] = {0, 0.5, -1.25, 3, 100, -1000};
+
+    simd<f32, 8> x32;
+    simd<f64, 4> x64;
+    For(range(8)) x32.reg[it] = (f32) angles[it % 6];
+    For(range(4)) x64.reg[it] = angles[it];
+
+    simd<f32, 8> s32, c32;
+    simd_sincos(x32, &s32, &c32);
+    For(range(8)) {
+        f64 x = x32.reg[it];
+        assert_lt(abs(s32.reg[it] - sin(x)), 1e-6);
+        assert_lt(abs(c32.reg[it] - cos(x)), 1e-6);
+        assert_lt(abs(simd_sin_fast(x32).reg[it] - sin(x)), 1e-4);
+    }
+
+    simd<f64, 4> s64, c64;
+    simd_sincos(x64, &s64, &c64);
+    For(range(4)) {
+        assert_lt(abs(s64.reg[it] - sin(angles[it])), 1e-15);
+        assert_lt(abs(c64.reg[it] - cos(angles[it])), 1e-15);
+        assert_eq(simd_cos(angles[it]), c64.reg[it]);
+    }
+
+    For(range(4)) {
+        f64 v = angles[it] * 0.1;
+        assert_lt(abs(simd_exp(v) / exp(v) - 1), 1e-15);
+        assert_lt(abs(simd_exp((f32) v) / exp((f32) v) - 1), 1e-6);
+        assert_lt(abs(simd_exp_fast((f32) v) / exp((f32) v) - 1), 1e-4);
+
+        f64 p = abs(angles[it]) + 0.1;
+        assert_lt(abs(simd_log(p) - log(p)), 1e-15);
+        assert_lt(abs(simd_log((f32) p) - log((f32) p)), 1e-6);
+        assert_lt(abs(simd_log_fast((f32) p) - log((f32) p)), 1e-4);
+
+        assert_lt(abs(simd_rsqrt(p) * sqrt(p) - 1), 1e-15);
+        assert_lt(abs(simd_rsqrt_fast((f32) p) * sqrt(p) - 1), 1e-6);
+    }
+
+    f64 inf = numeric_info<f64>::infinity();
+    assert_eq(simd_exp(1000.0), inf);
+    assert_eq(simd_exp(-1000.0), 0.0);
+    assert_eq(simd_log(0.0), -inf);
+    assert_true(is_nan(simd_log(-1.0)));
+
+    // [-PI, PI], cephes' atan2 is in [0, TAU]
+    For_as(y, to_stack_array<f64>(0, 1, -2, 1e-5)) {
+        For_as(x, to_stack_array<f64>(1, -3, 1e-5, -1e-5)) {
+            f64 expected = atan2(y, x);
+            if (expected > PI) expected -= TAU;
+            assert_lt(abs(simd_atan2(y, x) - expected), 1e-15);
+            assert_lt(abs(simd_atan2((f32) y, (f32) x) - expected), 1e-6);
+            assert_lt(abs(simd_atan2_fast((f32) y, (f32) x) - expected), 2e-3);
+        }
+    }
+    assert_eq(simd_atan2(0.0, -1.0), PI);
+    assert_eq(simd_atan2(-2.0, 0.0), -PI / 2);
+}
+
+TEST(half_precision) {
+    assert_eq(f16(1.0f).Bits, 0x3C00);
+    assert_eq(f16(-2.0f).Bits, 0xC000);
+    assert_eq(f16(65504.0f).Bits, 0x7BFF);
+    assert_eq(f16(65520.0f).Bits, 0x7C00);  // Rounds up to infinity
+    assert_eq(f16(0.1f).Bits, 0x2E66);
+    assert_eq(f16(6e-8f).Bits, 0x0001);  // The smallest subnormal
+    assert_eq(f16(1e-8f).Bits, 0x0000);
+    assert_eq((f32) f16::from_bits(0x3555), 0.33325195f);
+    assert_true(is_nan((f32) f16(numeric_info<f32>::quiet_NaN())));
+
+    assert_eq(bf16(1.0f).Bits, 0x3F80);
+    assert_eq(bf16(0.1f).Bits, 0x3DCD);
+    assert_eq((f32) bf16::from_bits(0xC2F7), -123.5f);
+
+    vec<f16, 4> v(1, 2, 3, 4);
+    v += v;
+    v *= 0.5f;
+    assert_eq((f32) v.w, 4.0f);
+    assert_eq(sizeof(v), 8);
+
+    // The same bits whichever path converts them (and the tails of odd counts)
+    f32 values[37];
+    For(range(37)) values[it] = (f32) (it - 18) * 1234.567f / (f32) (it + 1);
+    values[5] = numeric_info<f32>::infinity();
+
+    For_as(pass, range(2)) {
+        if (pass == 0) cpu_features_override({});
+        if (pass == 1) cpu_features_reset();
+
+        f16 h[37];
+        bf16 b[37];
+        f32 back[37];
+
+        f32_to_f16(values, 37, h);
+        f16_to_f32(h, 37, back);
+        For(range(37)) {
+            assert_eq(h[it].Bits, f16(values[it]).Bits);
+            assert_eq(back[it], (f32) h[it]);
+        }
+
+        f32_to_bf16(values, 37, b);
+        bf16_to_f32(b, 37, back);
+        For(range(37)) {
+            assert_eq(b[it].Bits, bf16(values[it]).Bits);
+            assert_eq(back[it], (f32) b[it]);
+        }
+    }
+}